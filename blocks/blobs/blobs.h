@@ -22,40 +22,176 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 *******************************************************************************/
 
+
+// A blob is a file holding the `CurrentTypeID<T>()` signature of `T`, followed by a flat array of `T`-s.
+//
+// The signature is padded to `alignof(T)` when `T` is aligned more strictly than the signature itself,
+// so that the elements of a memory-mapped blob are properly aligned. For all other types, and these are
+// the only types for which the elements could be accessed before, the layout is unchanged.
+//
+// `Blob<T>` memory-maps the file, so opening even a huge blob neither copies it nor reads it upfront.
+// `BlobWriter<T>` streams the elements into the file, optionally appending to an existing blob.
+
 #ifndef CURRENT_BLOCKS_BLOBS_BLOBS_H
 #define CURRENT_BLOCKS_BLOBS_BLOBS_H
 
 #include "../../port.h"
 
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <type_traits>
+#include <vector>
 
 #include "../../bricks/file/file.h"
+#include "../../bricks/file/mmap.h"
 #include "../../typesystem/reflection/typeid.h"
 
 namespace current {
 
+struct BlobException : Exception {
+  using Exception::Exception;
+};
+
+struct BlobWrongTypeException : BlobException {
+  using BlobException::BlobException;
+};
+
+struct BlobWrongSizeException : BlobException {
+  using BlobException::BlobException;
+};
+
+struct BlobCannotWriteException : BlobException {
+  using BlobException::BlobException;
+};
+
+enum class BlobWriteMode : bool { Truncate = false, Append = true };
+
+namespace impl {
+
+template <class T>
+constexpr size_t BlobHeaderSize() {
+  static_assert(std::is_trivially_copyable<T>::value, "Blobs can only hold trivially copyable types.");
+  return alignof(T) > sizeof(reflection::TypeID) ? alignof(T) : sizeof(reflection::TypeID);
+}
+
+// Returns the number of elements in the blob, throws if its header or its size do not match `T`.
+template <class T>
+size_t ValidateBlob(const std::string& filename, const char* header, size_t file_size) {
+  constexpr size_t header_size = BlobHeaderSize<T>();
+  if (file_size < header_size) {
+    CURRENT_THROW(BlobWrongSizeException("Wrong file size of blob `" + filename + "`."));
+  }
+  reflection::TypeID signature;
+  std::memcpy(&signature, header, sizeof(signature));
+  if (signature != reflection::CurrentTypeID<T>()) {
+    CURRENT_THROW(BlobWrongTypeException("Wrong type of blob `" + filename + "`."));
+  }
+  const size_t n = (file_size - header_size) / sizeof(T);
+  if (header_size + n * sizeof(T) != file_size) {
+    CURRENT_THROW(BlobWrongSizeException("Wrong file size of blob `" + filename + "`."));
+  }
+  return n;
+}
+
+}  // namespace impl
+
+// The read-only, memory-mapped, view of a blob, usable as a container: `size()`, `[]`, `for (const T& x : blob)`.
+template <class T>
+class Blob final {
+ public:
+  explicit Blob(const std::string& filename, MemoryAccessHint hint = MemoryAccessHint::Normal)
+      : file_(std::make_unique<MemoryMappedFile>(filename)) {
+    size_ = impl::ValidateBlob<T>(filename, file_->data(), file_->file_size());
+    data_ = reinterpret_cast<const T*>(file_->data() + impl::BlobHeaderSize<T>());
+    file_->Advise(hint);
+  }
+
+  const T* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return !size_; }
+
+  const T& operator[](size_t i) const { return data_[i]; }
+  const T* begin() const { return data_; }
+  const T* end() const { return data_ + size_; }
+
+  void Advise(MemoryAccessHint hint) const { file_->Advise(hint); }
+
+ private:
+  std::unique_ptr<MemoryMappedFile> file_;
+  const T* data_ = nullptr;
+  size_t size_ = 0u;
+};
+
+// Streams `T`-s into a blob. With `BlobWriteMode::Append`, an existing blob of the same `T` is continued.
+template <class T>
+class BlobWriter final {
+ public:
+  explicit BlobWriter(const std::string& filename, BlobWriteMode mode = BlobWriteMode::Truncate)
+      : filename_(filename) {
+    constexpr size_t header_size = impl::BlobHeaderSize<T>();
+    if (mode == BlobWriteMode::Append) {
+      std::ifstream existing(filename, std::ios::binary | std::ios::ate);
+      if (existing && existing.tellg() > 0) {
+        const size_t file_size = static_cast<size_t>(existing.tellg());
+        char header[header_size];
+        existing.seekg(0);
+        existing.read(header, static_cast<std::streamsize>(std::min(header_size, file_size)));
+        size_ = impl::ValidateBlob<T>(filename, header, file_size);
+        file_.open(filename, std::ios::binary | std::ios::app);
+        CheckStream();
+        return;
+      }
+    }
+    file_.open(filename, std::ios::binary | std::ios::trunc);
+    char header[header_size] = {0};
+    const auto signature = reflection::CurrentTypeID<T>();
+    std::memcpy(header, &signature, sizeof(signature));
+    file_.write(header, header_size);
+    CheckStream();
+  }
+
+  BlobWriter& Append(const T* data, size_t n) {
+    if (n) {
+      file_.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(sizeof(T) * n));
+      CheckStream();
+      size_ += n;
+    }
+    return *this;
+  }
+  BlobWriter& Append(const T& x) { return Append(&x, 1u); }
+  BlobWriter& Append(const std::vector<T>& data) { return Append(data.data(), data.size()); }
+
+  void Flush() {
+    file_.flush();
+    CheckStream();
+  }
+
+  // The total number of elements in the blob, including the ones that were there before appending.
+  size_t size() const { return size_; }
+
+ private:
+  void CheckStream() const {
+    if (!file_) {
+      CURRENT_THROW(BlobCannotWriteException("Cannot write blob `" + filename_ + "`."));
+    }
+  }
+
+  const std::string filename_;
+  std::ofstream file_;
+  size_t size_ = 0u;
+};
+
 template <class T>
 void WriteBlob(const std::vector<T>& data, const std::string& filename) {
-  std::ofstream file(filename, std::ios::binary);
-  const auto signature = current::reflection::CurrentTypeID<T>();
-  file.write(reinterpret_cast<const char*>(&signature), sizeof(signature));
-  file.write(reinterpret_cast<const char*>(&data[0]), sizeof(T) * data.size());
+  BlobWriter<T>(filename).Append(data).Flush();
 }
 
 template <class T, class F>
 void ProcessBlob(const std::string& filename, F&& f) {
-  const std::string contents = current::FileSystem::ReadFileAsString(filename);
-  const auto signature = *reinterpret_cast<const current::reflection::TypeID*>(contents.c_str());
-  if (signature != current::reflection::CurrentTypeID<T>()) {
-    throw current::Exception("Wrong type.");
-  }
-  size_t length = contents.length();
-  size_t n = (length - sizeof(signature)) / sizeof(T);
-  if (sizeof(signature) + n * sizeof(T) != length) {
-    throw current::Exception("Wrong file size.");
-  }
-  // TODO(dkorolev): Add a wrapper class so that it has `.size()`, iteration via `for (element : elements)`, etc.
-  f(reinterpret_cast<const T*>(contents.c_str() + sizeof(signature)), n);
+  const Blob<T> blob(filename);
+  f(blob.data(), blob.size());
 }
 
 }  // namespace current
@@ -0,0 +1,369 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2023 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// A snapshot is a blob of `CURRENT_STRUCT`-s, the fields of which are all trivially copyable, or are the nested
+// `CURRENT_STRUCT`-s of such fields; the allowed field types are checked at compile time.
+//
+// The `CURRENT_STRUCT`-s themselves are polymorphic, and thus are not trivially copyable, so each record is "cooked"
+// into the flat array of the leaf fields, laid out as in a plain C struct, with no virtual table pointer.
+// Loading the snapshot memory-maps it, and involves no parsing: `snapshot[i]` copies the fields of the record out,
+// and `snapshot.Column<U>("name")` accesses one field of all the records in place.
+//
+// The header holds the `CurrentTypeID<T>()`, the hash of the layout, and the layout itself, one line per leaf field,
+// as in "8 4 uint32_t point.x", for the offset, the size, the type and the name. A snapshot written for another
+// schema is rejected on load, with the lines of the layout that differ, as "-" the written ones, "+" the ones of `T`.
+
+#ifndef CURRENT_BLOCKS_BLOBS_SNAPSHOT_H
+#define CURRENT_BLOCKS_BLOBS_SNAPSHOT_H
+
+#include "../../port.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "blobs.h"
+
+#include "../../bricks/file/mmap.h"
+#include "../../bricks/strings/split.h"
+#include "../../typesystem/reflection/reflection.h"
+
+namespace current {
+
+struct BlobSchemaMismatchException : BlobWrongTypeException {
+  using BlobWrongTypeException::BlobWrongTypeException;
+};
+
+namespace impl {
+
+constexpr static char kSnapshotMagic[8] = {'C', 'S', 'N', 'A', 'P', 'S', 'H', '1'};
+
+struct SnapshotHeader final {
+  char magic[8];
+  reflection::TypeID type_id;
+  uint64_t layout_hash;
+  uint64_t record_size;
+  uint64_t record_alignment;
+  uint64_t layout_length;
+};
+
+static_assert(sizeof(SnapshotHeader) == 48u, "");
+
+inline size_t AlignUp(size_t offset, size_t alignment) { return (offset + alignment - 1u) / alignment * alignment; }
+
+template <typename U>
+U SnapshotFieldType(reflection::TypeSelector<U>);
+
+// Visits the leaf fields of `T`, the ones of its base structs first, with their offsets in the cooked record.
+// With `OBJECT` being `void`, the fields are visited without an object, to build the layout.
+template <typename F>
+class SnapshotFieldsVisitor final {
+ public:
+  explicit SnapshotFieldsVisitor(F& f) : f_(f) {}
+
+  template <typename U, typename X>
+  void Visit(const std::string& name, X* object) {
+    if constexpr (IS_CURRENT_STRUCT(U)) {
+      VisitStruct<U, U>(name, object);
+    } else {
+      static_assert(std::is_trivially_copyable_v<U>,
+                    "The fields of snapshot records must be trivially copyable, or `CURRENT_STRUCT`-s of such fields.");
+      offset_ = AlignUp(offset_, alignof(U));
+      alignment_ = std::max(alignment_, alignof(U));
+      f_.template Leaf<U>(name, offset_, object);
+      offset_ += sizeof(U);
+    }
+  }
+
+  size_t RecordSize() const { return AlignUp(offset_, alignment_); }
+  size_t RecordAlignment() const { return alignment_; }
+
+ private:
+  static std::string Join(const std::string& prefix, const char* name) {
+    return prefix.empty() ? std::string(name) : prefix + '.' + name;
+  }
+
+  template <typename U, typename S, typename X>
+  void VisitStruct(const std::string& prefix, X* object) {
+    if constexpr (!std::is_same_v<S, CurrentStruct>) {
+      VisitStruct<U, reflection::SuperType<S>>(prefix, object);
+      if constexpr (std::is_void_v<X>) {
+        reflection::VisitAllFields<S, reflection::FieldTypeAndNameAndIndex>::WithoutObject(
+            [this, &prefix](auto type, const char* name, auto) {
+              Visit<decltype(SnapshotFieldType(type)), void>(Join(prefix, name), nullptr);
+            });
+      } else {
+        using field_t = std::conditional_t<std::is_const_v<X>,
+                                           reflection::FieldNameAndImmutableValue,
+                                           reflection::FieldNameAndMutableValue>;
+        reflection::VisitAllFields<S, field_t>::WithObject(
+            static_cast<std::conditional_t<std::is_const_v<X>, const S&, S&>>(*object),
+            [this, &prefix](const char* name, auto& value) {
+              Visit<current::decay_t<decltype(value)>>(Join(prefix, name), &value);
+            });
+      }
+    }
+  }
+
+  F& f_;
+  size_t offset_ = 0u;
+  size_t alignment_ = 1u;
+};
+
+template <typename T>
+struct SnapshotLayout final {
+  std::string text;
+  uint64_t hash;
+  size_t record_size;
+  size_t record_alignment;
+  std::vector<std::string> names;
+  std::vector<std::string> types;
+  std::vector<size_t> offsets;
+
+  static const SnapshotLayout& Instance() {
+    static const SnapshotLayout instance;
+    return instance;
+  }
+
+  template <typename U>
+  void Leaf(const std::string& name, size_t offset, void*) {
+    const char* type = reflection::CurrentTypeName<U>();
+    text += current::ToString(offset) + ' ' + current::ToString(sizeof(U)) + ' ' + type + ' ' + name + '\n';
+    names.push_back(name);
+    types.push_back(type);
+    offsets.push_back(offset);
+  }
+
+  // Returns the lines of the `written` layout that are not in this one, prefixed by "-", and the lines of this one
+  // that are not in the `written` one, prefixed by "+".
+  std::string Diff(const std::string& written) const {
+    const auto before = strings::Split<strings::ByLines>(written);
+    const auto after = strings::Split<strings::ByLines>(text);
+    std::string diff;
+    for (const auto& line : before) {
+      if (std::find(after.begin(), after.end(), line) == after.end()) {
+        diff += "-" + line + '\n';
+      }
+    }
+    for (const auto& line : after) {
+      if (std::find(before.begin(), before.end(), line) == before.end()) {
+        diff += "+" + line + '\n';
+      }
+    }
+    return diff;
+  }
+
+ private:
+  SnapshotLayout() {
+    static_assert(IS_CURRENT_STRUCT(T), "Snapshots can only hold `CURRENT_STRUCT`-s.");
+    SnapshotFieldsVisitor<SnapshotLayout> visitor(*this);
+    visitor.template Visit<T, void>("", nullptr);
+    record_size = visitor.RecordSize();
+    record_alignment = visitor.RecordAlignment();
+    text = "record " + current::ToString(record_size) + ' ' + current::ToString(record_alignment) + '\n' + text;
+    // FNV-1a.
+    hash = 0xcbf29ce484222325ull;
+    for (const char c : text) {
+      hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+    }
+  }
+};
+
+struct SnapshotPacker final {
+  char* record;
+  template <typename U>
+  void Leaf(const std::string&, size_t offset, const U* value) {
+    std::memcpy(record + offset, value, sizeof(U));
+  }
+};
+
+struct SnapshotUnpacker final {
+  const char* record;
+  template <typename U>
+  void Leaf(const std::string&, size_t offset, U* value) {
+    std::memcpy(value, record + offset, sizeof(U));
+  }
+};
+
+}  // namespace impl
+
+// The strided view of one field of all the records of a snapshot, in place.
+template <typename U>
+class SnapshotColumn final {
+ public:
+  SnapshotColumn(const char* data, size_t stride, size_t size) : data_(data), stride_(stride), size_(size) {}
+
+  size_t size() const { return size_; }
+  U operator[](size_t i) const {
+    U result;
+    std::memcpy(&result, data_ + i * stride_, sizeof(U));
+    return result;
+  }
+
+ private:
+  const char* const data_;
+  const size_t stride_;
+  const size_t size_;
+};
+
+// The read-only, memory-mapped, snapshot of `T`-s.
+template <class T>
+class Snapshot final {
+ public:
+  explicit Snapshot(const std::string& filename, MemoryAccessHint hint = MemoryAccessHint::Normal)
+      : file_(std::make_unique<MemoryMappedFile>(filename)) {
+    const auto& layout = impl::SnapshotLayout<T>::Instance();
+    impl::SnapshotHeader header;
+    if (file_->file_size() < sizeof(header)) {
+      CURRENT_THROW(BlobWrongSizeException("Wrong file size of snapshot `" + filename + "`."));
+    }
+    std::memcpy(&header, file_->data(), sizeof(header));
+    if (std::memcmp(header.magic, impl::kSnapshotMagic, sizeof(header.magic)) ||
+        header.layout_length > file_->file_size() - sizeof(header)) {
+      CURRENT_THROW(BlobWrongTypeException("Not a snapshot `" + filename + "`."));
+    }
+    if (header.type_id != reflection::CurrentTypeID<T>() || header.layout_hash != layout.hash) {
+      const std::string written(file_->data() + sizeof(header), static_cast<size_t>(header.layout_length));
+      CURRENT_THROW(BlobSchemaMismatchException("Snapshot `" + filename + "` is not of `" +
+                                                reflection::CurrentTypeName<T>() + "`:\n" + layout.Diff(written)));
+    }
+    const size_t data_offset = impl::AlignUp(sizeof(header) + layout.text.length(), layout.record_alignment);
+    if (data_offset > file_->file_size() || (file_->file_size() - data_offset) % layout.record_size) {
+      CURRENT_THROW(BlobWrongSizeException("Wrong file size of snapshot `" + filename + "`."));
+    }
+    data_ = file_->data() + data_offset;
+    size_ = (file_->file_size() - data_offset) / layout.record_size;
+    file_->Advise(hint);
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return !size_; }
+
+  T operator[](size_t i) const {
+    T result;
+    impl::SnapshotUnpacker unpacker{data_ + i * impl::SnapshotLayout<T>::Instance().record_size};
+    impl::SnapshotFieldsVisitor<impl::SnapshotUnpacker>(unpacker).template Visit<T>("", &result);
+    return result;
+  }
+
+  // The field "name", or "outer.inner" for the fields of nested structs, of the type `U`.
+  template <typename U>
+  SnapshotColumn<U> Column(const std::string& name) const {
+    const auto& layout = impl::SnapshotLayout<T>::Instance();
+    const auto it = std::find(layout.names.begin(), layout.names.end(), name);
+    if (it == layout.names.end()) {
+      CURRENT_THROW(BlobWrongTypeException("No field `" + name + "` in `" + reflection::CurrentTypeName<T>() + "`."));
+    }
+    const size_t i = static_cast<size_t>(it - layout.names.begin());
+    if (layout.types[i] != reflection::CurrentTypeName<U>()) {
+      CURRENT_THROW(BlobWrongTypeException("Field `" + name + "` is of `" + layout.types[i] + "`."));
+    }
+    return SnapshotColumn<U>(data_ + layout.offsets[i], layout.record_size, size_);
+  }
+
+  void Advise(MemoryAccessHint hint) const { file_->Advise(hint); }
+
+ private:
+  std::unique_ptr<MemoryMappedFile> file_;
+  const char* data_ = nullptr;
+  size_t size_ = 0u;
+};
+
+// Streams `T`-s into a snapshot.
+template <class T>
+class SnapshotWriter final {
+ public:
+  explicit SnapshotWriter(const std::string& filename)
+      : filename_(filename),
+        layout_(impl::SnapshotLayout<T>::Instance()),
+        file_(filename, std::ios::binary | std::ios::trunc),
+        record_(layout_.record_size) {
+    impl::SnapshotHeader header;
+    std::memcpy(header.magic, impl::kSnapshotMagic, sizeof(header.magic));
+    header.type_id = reflection::CurrentTypeID<T>();
+    header.layout_hash = layout_.hash;
+    header.record_size = layout_.record_size;
+    header.record_alignment = layout_.record_alignment;
+    header.layout_length = layout_.text.length();
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file_.write(layout_.text.data(), static_cast<std::streamsize>(layout_.text.length()));
+    const size_t padding = impl::AlignUp(sizeof(header) + layout_.text.length(), layout_.record_alignment) -
+                           (sizeof(header) + layout_.text.length());
+    const std::vector<char> zeroes(padding);
+    file_.write(zeroes.data(), static_cast<std::streamsize>(padding));
+    CheckStream();
+  }
+
+  SnapshotWriter& Append(const T& x) {
+    // The padding bytes are zeroed, so that the snapshots of the same records are the same files.
+    std::fill(record_.begin(), record_.end(), '\0');
+    impl::SnapshotPacker packer{record_.data()};
+    impl::SnapshotFieldsVisitor<impl::SnapshotPacker>(packer).template Visit<T>("", &x);
+    file_.write(record_.data(), static_cast<std::streamsize>(record_.size()));
+    CheckStream();
+    ++size_;
+    return *this;
+  }
+
+  SnapshotWriter& Append(const std::vector<T>& data) {
+    for (const T& x : data) {
+      Append(x);
+    }
+    return *this;
+  }
+
+  void Flush() {
+    file_.flush();
+    CheckStream();
+  }
+
+  size_t size() const { return size_; }
+
+ private:
+  void CheckStream() const {
+    if (!file_) {
+      CURRENT_THROW(BlobCannotWriteException("Cannot write snapshot `" + filename_ + "`."));
+    }
+  }
+
+  const std::string filename_;
+  const impl::SnapshotLayout<T>& layout_;
+  std::ofstream file_;
+  std::vector<char> record_;
+  size_t size_ = 0u;
+};
+
+template <class T>
+void WriteSnapshot(const std::vector<T>& data, const std::string& filename) {
+  SnapshotWriter<T>(filename).Append(data).Flush();
+}
+
+}  // namespace current
+
+#endif  // CURRENT_BLOCKS_BLOBS_SNAPSHOT_H
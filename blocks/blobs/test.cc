@@ -0,0 +1,236 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2023 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "blobs.h"
+#include "snapshot.h"
+
+#include "../../typesystem/reflection/reflection.h"
+#include "../../typesystem/serialization/json.h"
+
+#include "../../bricks/dflags/dflags.h"
+#include "../../bricks/file/file.h"
+#include "../../3rdparty/gtest/gtest-main-with-dflags.h"
+
+DEFINE_string(blobs_test_tmpdir, ".current", "Local path for the test to create temporary files in.");
+
+namespace blobs_test {
+
+struct alignas(32) FeatureRow {
+  float values[8];
+};
+
+}  // namespace blobs_test
+
+CURRENT_INJECT_TYPE_ID(blobs_test::FeatureRow, 0x9000000000000001ull);
+
+TEST(Blobs, WriteAndRead) {
+  const std::string filename = current::FileSystem::JoinPath(FLAGS_blobs_test_tmpdir, "blob");
+  const auto file_remover = current::FileSystem::ScopedRmFile(filename);
+
+  current::WriteBlob(std::vector<uint64_t>({1u, 2u, 3u}), filename);
+  EXPECT_EQ(sizeof(uint64_t) * 4u, current::FileSystem::ReadFileAsString(filename).length());
+
+  const current::Blob<uint64_t> blob(filename, current::MemoryAccessHint::Sequential);
+  ASSERT_EQ(3u, blob.size());
+  EXPECT_FALSE(blob.empty());
+  EXPECT_EQ(2u, blob[1]);
+  uint64_t sum = 0u;
+  for (uint64_t x : blob) {
+    sum += x;
+  }
+  EXPECT_EQ(6u, sum);
+
+  size_t processed = 0u;
+  current::ProcessBlob<uint64_t>(filename, [&processed](const uint64_t* data, size_t n) {
+    ASSERT_EQ(3u, n);
+    EXPECT_EQ(3u, data[2]);
+    processed = n;
+  });
+  EXPECT_EQ(3u, processed);
+
+  current::WriteBlob(std::vector<uint64_t>(), filename);
+  EXPECT_TRUE(current::Blob<uint64_t>(filename).empty());
+}
+
+TEST(Blobs, StreamingAppend) {
+  const std::string filename = current::FileSystem::JoinPath(FLAGS_blobs_test_tmpdir, "blob");
+  const auto file_remover = current::FileSystem::ScopedRmFile(filename);
+
+  {
+    current::BlobWriter<uint32_t> writer(filename, current::BlobWriteMode::Append);
+    for (uint32_t i = 0u; i < 1000u; ++i) {
+      writer.Append(i);
+    }
+    EXPECT_EQ(1000u, writer.size());
+  }
+  {
+    current::BlobWriter<uint32_t> writer(filename, current::BlobWriteMode::Append);
+    EXPECT_EQ(1000u, writer.size());
+    writer.Append(std::vector<uint32_t>({1000u, 1001u}));
+    EXPECT_EQ(1002u, writer.size());
+  }
+
+  const current::Blob<uint32_t> blob(filename);
+  ASSERT_EQ(1002u, blob.size());
+  for (uint32_t i = 0u; i < 1002u; ++i) {
+    ASSERT_EQ(i, blob[i]);
+  }
+
+  current::BlobWriter<uint32_t>(filename).Append(42u);
+  ASSERT_EQ(1u, current::Blob<uint32_t>(filename).size());
+  EXPECT_EQ(42u, current::Blob<uint32_t>(filename)[0]);
+}
+
+TEST(Blobs, Alignment) {
+  const std::string filename = current::FileSystem::JoinPath(FLAGS_blobs_test_tmpdir, "blob");
+  const auto file_remover = current::FileSystem::ScopedRmFile(filename);
+
+  std::vector<blobs_test::FeatureRow> rows(3u);
+  for (size_t i = 0u; i < rows.size(); ++i) {
+    for (size_t j = 0u; j < 8u; ++j) {
+      rows[i].values[j] = static_cast<float>(i * 10u + j);
+    }
+  }
+  current::WriteBlob(rows, filename);
+  EXPECT_EQ(32u + 3u * sizeof(blobs_test::FeatureRow), current::FileSystem::ReadFileAsString(filename).length());
+
+  const current::Blob<blobs_test::FeatureRow> blob(filename);
+  ASSERT_EQ(3u, blob.size());
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(blob.data()) % alignof(blobs_test::FeatureRow));
+  EXPECT_EQ(27.0f, blob[2].values[7]);
+}
+
+TEST(Blobs, Errors) {
+  const std::string filename = current::FileSystem::JoinPath(FLAGS_blobs_test_tmpdir, "blob");
+  const auto file_remover = current::FileSystem::ScopedRmFile(filename);
+
+  current::WriteBlob(std::vector<uint64_t>({1u, 2u}), filename);
+  EXPECT_THROW(current::Blob<int64_t>{filename}, current::BlobWrongTypeException);
+  EXPECT_THROW(current::BlobWriter<int64_t>(filename, current::BlobWriteMode::Append),
+               current::BlobWrongTypeException);
+
+  current::FileSystem::WriteStringToFile(current::FileSystem::ReadFileAsString(filename) + "x", filename.c_str());
+  EXPECT_THROW(current::Blob<uint64_t>{filename}, current::BlobWrongSizeException);
+  EXPECT_THROW(current::BlobWriter<uint64_t>(filename, current::BlobWriteMode::Append),
+               current::BlobWrongSizeException);
+
+  current::FileSystem::WriteStringToFile("", filename.c_str());
+  EXPECT_THROW(current::Blob<uint64_t>{filename}, current::BlobWrongSizeException);
+  EXPECT_THROW(current::Blob<uint64_t>{filename + ".missing"}, current::CannotReadFileException);
+}
+
+namespace blobs_test {
+
+namespace v1 {
+CURRENT_STRUCT(Point) {
+  CURRENT_FIELD(x, float);
+  CURRENT_FIELD(y, float);
+};
+CURRENT_STRUCT(RideBase) { CURRENT_FIELD(id, uint64_t); };
+CURRENT_STRUCT(Ride, RideBase) {
+  CURRENT_FIELD(passengers, uint8_t);
+  CURRENT_FIELD(pickup, Point);
+  CURRENT_FIELD(duration, std::chrono::microseconds);
+  CURRENT_FIELD(fare, double);
+};
+}  // namespace v1
+
+namespace v2 {
+CURRENT_STRUCT(Point) {
+  CURRENT_FIELD(x, float);
+  CURRENT_FIELD(y, float);
+};
+CURRENT_STRUCT(RideBase) { CURRENT_FIELD(id, uint64_t); };
+CURRENT_STRUCT(Ride, RideBase) {
+  CURRENT_FIELD(passengers, uint32_t);
+  CURRENT_FIELD(pickup, Point);
+  CURRENT_FIELD(duration, std::chrono::microseconds);
+  CURRENT_FIELD(fare, double);
+};
+}  // namespace v2
+
+}  // namespace blobs_test
+
+TEST(Blobs, Snapshot) {
+  using blobs_test::v1::Ride;
+  const std::string filename = current::FileSystem::JoinPath(FLAGS_blobs_test_tmpdir, "snapshot");
+  const auto file_remover = current::FileSystem::ScopedRmFile(filename);
+
+  std::vector<Ride> rides(1000u);
+  for (size_t i = 0u; i < rides.size(); ++i) {
+    rides[i].id = 1000000u + i;
+    rides[i].passengers = static_cast<uint8_t>(1u + i % 4u);
+    rides[i].pickup.x = 0.5f * static_cast<float>(i);
+    rides[i].pickup.y = -0.25f * static_cast<float>(i);
+    rides[i].duration = std::chrono::microseconds(i * 1000000u);
+    rides[i].fare = 2.5 + 0.01 * static_cast<double>(i);
+  }
+  current::WriteSnapshot(rides, filename);
+  // The 8-byte `id`, the 1-byte `passengers`, the two 4-byte floats of `pickup` at offset 12, and two more 8-byte
+  // fields, with no virtual table pointers, per record.
+  EXPECT_EQ(40u, current::impl::SnapshotLayout<Ride>::Instance().record_size);
+  EXPECT_EQ(
+      "record 40 8\n"
+      "0 8 uint64_t id\n"
+      "8 1 uint8_t passengers\n"
+      "12 4 float pickup.x\n"
+      "16 4 float pickup.y\n"
+      "24 8 std::chrono::microseconds duration\n"
+      "32 8 double fare\n",
+      current::impl::SnapshotLayout<Ride>::Instance().text);
+
+  const current::Snapshot<Ride> snapshot(filename, current::MemoryAccessHint::Sequential);
+  ASSERT_EQ(1000u, snapshot.size());
+  for (size_t i = 0u; i < rides.size(); ++i) {
+    EXPECT_EQ(JSON(rides[i]), JSON(snapshot[i])) << i;
+  }
+  const auto fares = snapshot.Column<double>("fare");
+  const auto x = snapshot.Column<float>("pickup.x");
+  ASSERT_EQ(1000u, fares.size());
+  EXPECT_EQ(rides[123].fare, fares[123]);
+  EXPECT_EQ(rides[999].pickup.x, x[999]);
+  ASSERT_THROW(snapshot.Column<float>("fare"), current::BlobWrongTypeException);
+  ASSERT_THROW(snapshot.Column<double>("nope"), current::BlobWrongTypeException);
+
+  try {
+    current::Snapshot<blobs_test::v2::Ride> mismatched(filename);
+    ASSERT_TRUE(false);
+  } catch (const current::BlobSchemaMismatchException& e) {
+    EXPECT_NE(std::string::npos, e.OriginalDescription().find("-8 1 uint8_t passengers\n")) << e.OriginalDescription();
+    EXPECT_NE(std::string::npos, e.OriginalDescription().find("+8 4 uint32_t passengers\n"))
+        << e.OriginalDescription();
+    EXPECT_EQ(std::string::npos, e.OriginalDescription().find("fare")) << e.OriginalDescription();
+  }
+  ASSERT_THROW(current::Snapshot<blobs_test::v2::Ride>{filename}, current::BlobWrongTypeException);
+
+  std::string truncated = current::FileSystem::ReadFileAsString(filename);
+  truncated.resize(truncated.size() - 1u);
+  current::FileSystem::WriteStringToFile(truncated, filename.c_str());
+  ASSERT_THROW(current::Snapshot<Ride>{filename}, current::BlobWrongSizeException);
+}
@@ -52,6 +52,79 @@ struct HTMLGeneratorHTTPResponseScope final : HTMLGeneratorScope {
   std::ostream& OutputStream() override { return html_contents; }
 };
 
+// Streams the page into a chunked HTTP response as it is being generated, so that the browser gets the first bytes
+// before the rest of the page is ready. The HTML is buffered in blocks of up to `flush_threshold` bytes, and each
+// full block is sent right away as an HTTP chunk; `Flush()` sends what is buffered early, say, after the `<head>`.
+struct HTMLGeneratorHTTPChunkedResponseScope final : HTMLGeneratorScope {
+  constexpr static size_t kDefaultFlushThreshold = 16 * 1024;
+
+  using sender_t = decltype(std::declval<Request&>().SendChunkedResponse());
+
+  // Collects the HTML into a fixed-size buffer, sending it as a chunk every time it fills up.
+  // The `std::ostream` using it swallows the exception if the client is gone, and stops accepting more output.
+  class ChunkingStreamBuffer final : public std::streambuf {
+   public:
+    ChunkingStreamBuffer(sender_t& sender, size_t flush_threshold)
+        : sender_(sender), buffer_(std::max(flush_threshold, static_cast<size_t>(1))) {
+      setp(buffer_.data(), buffer_.data() + buffer_.size());
+    }
+
+   protected:
+    int_type overflow(int_type c) override {
+      SendBuffered();
+      if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+      }
+      return traits_type::not_eof(c);
+    }
+
+    int sync() override {
+      SendBuffered();
+      return 0;
+    }
+
+   private:
+    void SendBuffered() {
+      if (pptr() != pbase()) {
+        chunk_.assign(pbase(), pptr());
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+        sender_.Send(chunk_, current::net::ChunkFlush::Flush);
+      }
+    }
+
+    sender_t& sender_;
+    std::vector<char> buffer_;
+    std::string chunk_;
+  };
+
+  Request request;
+  sender_t sender;
+  ChunkingStreamBuffer buffer;
+  std::ostream html_contents;
+
+  explicit HTMLGeneratorHTTPChunkedResponseScope(Request input_request,
+                                                 size_t flush_threshold = kDefaultFlushThreshold)
+      : request(std::move(input_request)),
+        sender(request.SendChunkedResponse(HTTPResponseCode.OK,
+                                           current::net::http::Headers(),
+                                           current::net::constants::kDefaultHTMLContentType)),
+        buffer(sender, flush_threshold),
+        html_contents(&buffer) {
+    ThreadLocalSingleton<HTMLGeneratorThreadLocalSingleton>().RegisterSelfAsScope(this);
+  }
+
+  ~HTMLGeneratorHTTPChunkedResponseScope() {
+    ThreadLocalSingleton<HTMLGeneratorThreadLocalSingleton>().UnregisterSelfAsScope(this);
+    Flush();
+    // The destructor of `sender` then completes the chunked response.
+  }
+
+  void Flush() { html_contents.flush(); }
+
+  std::ostream& OutputStream() override { return html_contents; }
+};
+
 }  // namespace html
 }  // namespace current
 
@@ -283,3 +283,49 @@ TEST(HTMLTest, HTTPIntegration) {
       response.body);
   EXPECT_EQ("text/html; charset=utf-8", response.headers.GetOrDefault("Content-Type", "N/A"));
 }
+
+TEST(HTMLTest, HTTPChunkedIntegration) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  const auto http_route_scope = HTTP(std::move(reserved_port)).Register("/", [](Request r) {
+    const current::html::HTMLGeneratorHTTPChunkedResponseScope html_scope(std::move(r), 64u);
+    HTML(html);
+    {
+      HTML(head);
+      HTML(title);
+      HTML(_) << "Yo!";
+    }
+    {
+      HTML(body);
+      for (int i = 0; i < 100; ++i) {
+        HTML(p);
+        HTML(_) << "Paragraph " << i << '.';
+      }
+    }
+  });
+
+  std::string expected = "<html><head><title>Yo!</title></head><body>";
+  for (int i = 0; i < 100; ++i) {
+    expected += "<p>Paragraph " + current::ToString(i) + ".</p>";
+  }
+  expected += "</body></html>";
+
+  std::vector<std::string> chunks;
+  std::string content_type;
+  const auto response = HTTP(ChunkedGET(
+      Printf("http://localhost:%d/", port),
+      [&content_type](const std::string& k, const std::string& v) {
+        if (k == "Content-Type") {
+          content_type = v;
+        }
+      },
+      [&chunks](const std::string& s) { chunks.push_back(s); },
+      []() {}));
+  EXPECT_EQ(200, static_cast<int>(response));
+  EXPECT_EQ("text/html; charset=utf-8", content_type);
+  EXPECT_EQ(expected, current::strings::Join(chunks, ""));
+  ASSERT_GT(chunks.size(), 1u);
+  for (const auto& chunk : chunks) {
+    EXPECT_LE(chunk.length(), 64u);
+  }
+}
@@ -0,0 +1,159 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// `HTTPAdmissionControl` bounds how many requests the HTTP server has in flight, in total and per route, from
+// the moment a request has been received to the moment it has been responded to, including the time it waits
+// for a thread of the worker pool, if any. The requests over the limits are responded to with
+// "503 SERVICE UNAVAILABLE" and `Retry-After` right away, keeping the latency of the admitted ones bounded.
+//
+// Use `HTTPServerPOSIX::SetAdmissionLimits()` to enable it; see also the `max_queue_time` of `HTTPWorkerPool`.
+
+#ifndef BLOCKS_HTTP_ADMISSION_CONTROL_H
+#define BLOCKS_HTTP_ADMISSION_CONTROL_H
+
+#include "../../port.h"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "request.h"
+
+#include "../../typesystem/struct.h"
+
+namespace current {
+namespace http {
+
+struct HTTPAdmissionLimits final {
+  // The requests in flight at once, in total. Zero is no limit.
+  size_t max_in_flight = 0u;
+  // The requests in flight at once to each route, unless the route has a limit of its own. Zero is no limit.
+  size_t max_in_flight_per_route = 0u;
+  // The limits of the specific routes, by the path they are registered at.
+  std::map<std::string, size_t> max_in_flight_by_route;
+  // What to tell the clients of the rejected requests to wait for before retrying. Zero omits `Retry-After`.
+  std::chrono::seconds retry_after = std::chrono::seconds(1);
+};
+
+CURRENT_STRUCT(HTTPAdmissionMetrics) {
+  CURRENT_FIELD(in_flight, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(in_flight, "The requests admitted and not responded to yet.");
+  CURRENT_FIELD(admitted, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(admitted, "The requests admitted in total.");
+  CURRENT_FIELD(rejected, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(rejected, "The requests responded to with 503, as too many were in flight in total.");
+  CURRENT_FIELD(rejected_by_route, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(rejected_by_route, "The requests responded to with 503, as too many were to their route.");
+};
+
+// Responds with "503 SERVICE UNAVAILABLE", asking the client to retry in `retry_after`, unless it is zero.
+inline void RespondServiceUnavailable(Request r, std::chrono::seconds retry_after) {
+  current::net::http::Headers headers;
+  if (retry_after.count() > 0) {
+    headers.Set("Retry-After", std::to_string(retry_after.count()));
+  }
+  r(current::net::DefaultServiceUnavailableMessage(),
+    HTTPResponseCode.ServiceUnavailable,
+    headers,
+    current::net::constants::kDefaultHTMLContentType);
+}
+
+class HTTPAdmissionControl final : public std::enable_shared_from_this<HTTPAdmissionControl> {
+ public:
+  // Held for as long as the request admitted is in flight.
+  class Ticket final {
+   public:
+    Ticket(std::shared_ptr<HTTPAdmissionControl> control, const std::string& route, bool counted_by_route)
+        : control_(std::move(control)), route_(route), counted_by_route_(counted_by_route) {}
+    ~Ticket() { control_->Release(route_, counted_by_route_); }
+
+   private:
+    Ticket(const Ticket&) = delete;
+    Ticket& operator=(const Ticket&) = delete;
+
+    const std::shared_ptr<HTTPAdmissionControl> control_;
+    const std::string route_;
+    const bool counted_by_route_;
+  };
+
+  explicit HTTPAdmissionControl(HTTPAdmissionLimits limits) : limits_(std::move(limits)) {}
+
+  // Returns the ticket to hold while the request to `route` is in flight, or `nullptr` if it is to be rejected.
+  std::unique_ptr<Ticket> Admit(const std::string& route) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (limits_.max_in_flight && metrics_.in_flight >= limits_.max_in_flight) {
+      ++metrics_.rejected;
+      return nullptr;
+    }
+    const auto cit = limits_.max_in_flight_by_route.find(route);
+    const size_t route_limit =
+        (cit != limits_.max_in_flight_by_route.end()) ? cit->second : limits_.max_in_flight_per_route;
+    if (route_limit) {
+      size_t& route_in_flight = in_flight_by_route_[route];
+      if (route_in_flight >= route_limit) {
+        ++metrics_.rejected_by_route;
+        return nullptr;
+      }
+      ++route_in_flight;
+    }
+    ++metrics_.in_flight;
+    ++metrics_.admitted;
+    return std::make_unique<Ticket>(shared_from_this(), route, route_limit != 0u);
+  }
+
+  std::chrono::seconds RetryAfter() const { return limits_.retry_after; }
+
+  HTTPAdmissionMetrics Metrics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return metrics_;
+  }
+
+ private:
+  HTTPAdmissionControl(const HTTPAdmissionControl&) = delete;
+  HTTPAdmissionControl& operator=(const HTTPAdmissionControl&) = delete;
+
+  void Release(const std::string& route, bool counted_by_route) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --metrics_.in_flight;
+    if (counted_by_route) {
+      const auto it = in_flight_by_route_.find(route);
+      if (!--it->second) {
+        in_flight_by_route_.erase(it);
+      }
+    }
+  }
+
+  const HTTPAdmissionLimits limits_;
+  mutable std::mutex mutex_;
+  std::map<std::string, size_t> in_flight_by_route_;
+  HTTPAdmissionMetrics metrics_;
+};
+
+}  // namespace http
+}  // namespace current
+
+#endif  // BLOCKS_HTTP_ADMISSION_CONTROL_H
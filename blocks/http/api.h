@@ -47,6 +47,7 @@ SOFTWARE.
 #include "impl/posix_client.h"
 #include "impl/posix_server.h"
 #include "chunked_response_parser.h"
+#include "async_client.h"
 using HTTP_CLIENT = current::http::HTTPClientPOSIX;
 using CHUNKED_HTTP_CLIENT = current::http::GenericHTTPClientPOSIX<ChunkByChunkHTTPResponseReceiver>;
 #elif defined(CURRENT_APPLE) && !defined(CURRENT_APPLE_HTTP_CLIENT_POSIX)
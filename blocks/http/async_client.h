@@ -0,0 +1,408 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// `HTTPAsyncClient` sends many HTTP requests at once, and waits for all their responses on a small pool of threads,
+// instead of occupying a thread per outstanding request, as `HTTP(GET(url))` does. The requests and the responses
+// are the same as those of `HTTP()`; the responses are delivered via callbacks, or via `std::future`-s.
+//
+//   current::http::HTTPAsyncClient client;
+//   auto a = client.Send(GET(url_a));
+//   auto b = client.Send(POST(url_b, body));
+//   use(a.get().body, b.get().body);
+//
+// Each request is sent on one of the threads of the client, which then moves on, while the responses are waited
+// upon via `epoll` on Linux and via `kqueue` on macOS. The connections of `HTTPClientConnections()`, once enabled,
+// are reused, as they are by `HTTP()`. Connecting to the server and sending the request are still blocking,
+// but they are quick compared to waiting for the response; so is reading the rest of a chunked response, once its
+// first bytes have arrived. Elsewhere, each request is made in a blocking way on one of the threads of the client.
+//
+// The callbacks are called on the threads of the client, and should not block for long.
+
+#ifndef BLOCKS_HTTP_ASYNC_CLIENT_H
+#define BLOCKS_HTTP_ASYNC_CLIENT_H
+
+#include "../../port.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "impl/posix_client.h"
+#include "impl/posix_server_event_loop.h"
+
+#include "../../bricks/net/exceptions.h"
+
+namespace current {
+namespace http {
+
+class HTTPAsyncClient final {
+ public:
+  using on_response_t = std::function<void(HTTPResponseWithBuffer&&)>;
+  using on_error_t = std::function<void(std::exception_ptr)>;
+
+  // The requests not responded to within `timeout` fail with `HTTPResponseTimeoutException`.
+  explicit HTTPAsyncClient(size_t threads = 2u, std::chrono::milliseconds timeout = std::chrono::seconds(30))
+      : timeout_(timeout) {
+    const size_t threads_count = threads ? threads : 1u;
+    threads_.reserve(threads_count);
+    for (size_t i = 0u; i < threads_count; ++i) {
+      threads_.emplace_back(&HTTPAsyncClient::Thread, this);
+    }
+  }
+
+  // The requests not responded to yet fail with `HTTPClientShutDownException`.
+  ~HTTPAsyncClient() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      terminating_ = true;
+    }
+    condition_variable_.notify_all();
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+    std::vector<std::unique_ptr<PendingRequest>> outstanding;
+    for (auto& pending : to_send_) {
+      outstanding.push_back(std::move(pending));
+    }
+    for (auto& waiting : waiting_) {
+      outstanding.push_back(std::move(waiting.second));
+    }
+    for (auto& pending : outstanding) {
+      Fail(std::move(pending), std::make_exception_ptr(current::net::HTTPClientShutDownException()));
+    }
+  }
+
+  size_t ThreadsCount() const { return threads_.size(); }
+
+  // The requests sent, the responses to which have not been delivered yet.
+  size_t InFlight() const { return in_flight_; }
+
+  // Sends `GET`, `HEAD`, `POST`, `POSTFromFile`, `PUT`, `PATCH` or `DELETE`, and calls back with its response,
+  // or with the exception the request has failed with, such as the ones `HTTP()` would throw.
+  template <typename REQUEST>
+  void Send(const REQUEST& request, on_response_t on_response, on_error_t on_error) {
+    auto pending = std::make_unique<PendingRequest>(std::move(on_response), std::move(on_error));
+    ++in_flight_;
+    try {
+      ImplWrapper<HTTPClientPOSIX>::PrepareInput(request, pending->client);
+      pending->url = pending->client.BeginRequest();
+    } catch (const current::Exception&) {
+      Fail(std::move(pending), std::current_exception());
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      to_send_.push_back(std::move(pending));
+    }
+    condition_variable_.notify_one();
+#if defined(CURRENT_HTTP_SERVER_EVENT_LOOP_EPOLL) || defined(CURRENT_HTTP_SERVER_EVENT_LOOP_KQUEUE)
+    WakeUp();
+#endif
+  }
+
+  template <typename REQUEST>
+  std::future<HTTPResponseWithBuffer> Send(const REQUEST& request) {
+    auto promise = std::make_shared<std::promise<HTTPResponseWithBuffer>>();
+    std::future<HTTPResponseWithBuffer> future = promise->get_future();
+    Send(request,
+         [promise](HTTPResponseWithBuffer&& response) { promise->set_value(std::move(response)); },
+         [promise](std::exception_ptr e) { promise->set_exception(e); });
+    return future;
+  }
+
+ private:
+  HTTPAsyncClient(const HTTPAsyncClient&) = delete;
+  HTTPAsyncClient& operator=(const HTTPAsyncClient&) = delete;
+
+  struct PendingRequest final {
+    HTTPClientPOSIX client;
+    const on_response_t on_response;
+    const on_error_t on_error;
+    URL url;
+    std::set<std::string> all_urls;
+    int port = 0;
+    bool keep_alive = false;
+    // Sent over a connection kept open after another response, which the server may have closed meanwhile.
+    bool reused = false;
+    std::unique_ptr<current::net::Connection> connection;
+    std::string data;
+    std::chrono::steady_clock::time_point deadline;
+    PendingRequest(on_response_t on_response, on_error_t on_error)
+        : client(HTTPClientPOSIX::http_helper_t::ConstructionParams()),
+          on_response(std::move(on_response)),
+          on_error(std::move(on_error)) {}
+  };
+
+  constexpr static int kPollIntervalMS = 50;
+  constexpr static size_t kReadChunkSize = 16 * 1024;
+
+  void Respond(std::unique_ptr<PendingRequest> pending) {
+    HTTPResponseWithBuffer response;
+    ImplWrapper<HTTPClientPOSIX>::ParseOutput(
+        KeepResponseInMemory(), KeepResponseInMemory(), pending->client, response);
+    pending->connection = nullptr;
+    // Before the callback, so that the request is no longer in flight once its response has been delivered.
+    --in_flight_;
+    try {
+      pending->on_response(std::move(response));
+    } catch (const current::Exception& e) {  // LCOV_EXCL_LINE
+      std::cerr << "HTTP client callback failed in user code: " << e.what() << '\n';  // LCOV_EXCL_LINE
+    }
+  }
+
+  void Fail(std::unique_ptr<PendingRequest> pending, std::exception_ptr e) {
+    pending->connection = nullptr;
+    --in_flight_;
+    try {
+      pending->on_error(e);
+    } catch (const current::Exception& e) {  // LCOV_EXCL_LINE
+      std::cerr << "HTTP client callback failed in user code: " << e.what() << '\n';  // LCOV_EXCL_LINE
+    }
+  }
+
+#if defined(CURRENT_HTTP_SERVER_EVENT_LOOP_EPOLL) || defined(CURRENT_HTTP_SERVER_EVENT_LOOP_KQUEUE)
+  void WakeUp() { poller_.WakeUp(); }
+
+  void WaitForData(int fd, bool first_time) { poller_.WaitUntilReadable(fd, first_time); }
+
+  // The connection may be reused for the next request, to be waited upon anew.
+  void StopWaitingForData(int fd) { poller_.StopWaiting(fd); }
+
+  void Thread() {
+    while (!terminating_) {
+      poller_.Poll(std::chrono::milliseconds(kPollIntervalMS), [this](int fd) {
+        if (!terminating_) {
+          OnDataAvailable(fd);
+        }
+      });
+      SendQueuedRequests();
+      FailTimedOutRequests();
+    }
+  }
+
+  void SendQueuedRequests() {
+    while (!terminating_) {
+      std::unique_ptr<PendingRequest> pending;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (to_send_.empty()) {
+          return;
+        }
+        pending = std::move(to_send_.front());
+        to_send_.pop_front();
+      }
+      SendRequest(std::move(pending), true);
+    }
+  }
+
+  // Sends the request, or the next one after a redirect, and waits for its response. Unless `new_hop`,
+  // sends the same request again, over a new connection, as the one it was sent over has turned out to be closed.
+  void SendRequest(std::unique_ptr<PendingRequest> pending, bool new_hop) {
+    try {
+      HTTPClientPOSIX& client = pending->client;
+      pending->connection = nullptr;
+      pending->reused = false;
+      if (new_hop) {
+        client.BeginHop(pending->url, pending->all_urls);
+        pending->port = HTTPClientPOSIX::Port(pending->url);
+        pending->keep_alive = client.KeepAlive();
+        if (pending->keep_alive) {
+          pending->connection = HTTPClientConnections().Take(pending->url.host, pending->port);
+          if (pending->connection) {
+            try {
+              client.SendRequest(*pending->connection, pending->url, true);
+              pending->reused = true;
+            } catch (const current::net::SocketException&) {
+              pending->connection = nullptr;
+            }
+          }
+        }
+      }
+      if (!pending->connection) {
+        pending->connection = std::make_unique<current::net::Connection>(
+            current::net::Connection(current::net::ClientSocket(pending->url.host, pending->port)));
+        client.SendRequest(*pending->connection, pending->url, pending->keep_alive);
+      }
+    } catch (const current::Exception&) {
+      Fail(std::move(pending), std::current_exception());
+      return;
+    }
+    pending->data.clear();
+    pending->deadline = std::chrono::steady_clock::now() + timeout_;
+    const int fd = static_cast<int>(pending->connection->socket);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      waiting_[fd] = std::move(pending);
+    }
+    WaitForData(fd, true);
+  }
+
+  // Whether the response can be parsed without waiting for more data. The `HEAD` responses are waited upon
+  // until the server closes the connection, as their `Content-Length` is not followed by the body.
+  static bool IsResponseComplete(const PendingRequest& pending, bool closed) {
+    if (pending.client.request_method_ == "HEAD") {
+      return closed;
+    }
+    return closed || impl::IsPrefetchedHTTPRequestComplete(pending.data);
+  }
+
+  void OnDataAvailable(int fd) {
+    std::unique_ptr<PendingRequest> pending;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const auto it = waiting_.find(fd);
+      if (it == waiting_.end()) {
+        return;
+      }
+      pending = std::move(it->second);
+      waiting_.erase(it);
+    }
+    bool closed = false;
+    try {
+      char buffer[kReadChunkSize];
+      size_t read_count;
+      while ((read_count = pending->connection->NonBlockingRead(buffer, sizeof(buffer)))) {
+        pending->data.append(buffer, read_count);
+      }
+    } catch (const current::net::SocketException&) {
+      closed = true;
+    }
+    if (!IsResponseComplete(*pending, closed)) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        waiting_[fd] = std::move(pending);
+      }
+      WaitForData(fd, false);
+      return;
+    }
+    StopWaitingForData(fd);
+    if (pending->data.empty()) {
+      if (pending->reused) {
+        // The server has closed the idle connection just as it was being reused. Retry on a new one.
+        SendRequest(std::move(pending), false);
+      } else {
+        Fail(std::move(pending), std::make_exception_ptr(current::net::EmptyConnectionResetByPeer()));
+      }
+      return;
+    }
+    bool redirected;
+    try {
+      HTTPClientPOSIX& client = pending->client;
+      pending->connection->SetPrefetchedData(std::move(pending->data));
+      client.ReceiveResponse(*pending->connection);
+      if (pending->keep_alive && !closed && client.ConnectionReusable() &&
+          pending->connection->TakePrefetchedData().empty()) {
+        HTTPClientConnections().Put(pending->url.host, pending->port, std::move(pending->connection));
+      }
+      redirected = client.EndHop(pending->url);
+    } catch (const current::Exception&) {
+      Fail(std::move(pending), std::current_exception());
+      return;
+    }
+    if (redirected) {
+      SendRequest(std::move(pending), true);
+    } else {
+      Respond(std::move(pending));
+    }
+  }
+
+  void FailTimedOutRequests() {
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<std::unique_ptr<PendingRequest>> timed_out;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (now < next_timeouts_check_) {
+        return;
+      }
+      next_timeouts_check_ = now + std::chrono::milliseconds(kPollIntervalMS);
+      for (auto it = waiting_.begin(); it != waiting_.end();) {
+        if (it->second->deadline <= now) {
+          timed_out.push_back(std::move(it->second));
+          it = waiting_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+    // Closing the connections also removes them from the poller.
+    for (auto& pending : timed_out) {
+      Fail(std::move(pending), std::make_exception_ptr(current::net::HTTPResponseTimeoutException()));
+    }
+  }
+#else
+  // No readiness notifications on this platform: make each request on one of the threads, blocking.
+  void Thread() {
+    while (true) {
+      std::unique_ptr<PendingRequest> pending;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_variable_.wait(lock, [this]() { return terminating_ || !to_send_.empty(); });
+        if (terminating_) {
+          return;
+        }
+        pending = std::move(to_send_.front());
+        to_send_.pop_front();
+      }
+      try {
+        pending->client.Go();
+      } catch (const current::Exception&) {
+        Fail(std::move(pending), std::current_exception());
+        continue;
+      }
+      Respond(std::move(pending));
+    }
+  }
+#endif
+
+  const std::chrono::milliseconds timeout_;
+#ifdef CURRENT_SOCKET_POLLER
+  current::net::SocketPoller poller_;
+#endif
+  std::atomic_bool terminating_{false};
+  std::atomic_size_t in_flight_{0u};
+  std::mutex mutex_;
+  std::condition_variable condition_variable_;
+  std::deque<std::unique_ptr<PendingRequest>> to_send_;
+  std::unordered_map<int, std::unique_ptr<PendingRequest>> waiting_;
+  std::chrono::steady_clock::time_point next_timeouts_check_;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace http
+}  // namespace current
+
+#endif  // BLOCKS_HTTP_ASYNC_CLIENT_H
@@ -27,6 +27,10 @@ SOFTWARE.
 
 #include "../../port.h"
 
+#include <functional>
+#include <string>
+#include <string_view>
+
 #include "../../bricks/net/http/headers/headers.h"
 
 class ChunkByChunkHTTPResponseReceiver {
@@ -34,6 +38,9 @@ class ChunkByChunkHTTPResponseReceiver {
   struct ConstructionParams {
     std::function<void(const std::string&, const std::string&)> header_callback;
     std::function<void(const std::string&)> chunk_callback;
+    // If set, called instead of `chunk_callback`, with the chunk as it is in the receive buffer, without copying it.
+    // The view is only valid during the call, as the buffer is reused for the data received next.
+    std::function<void(std::string_view)> chunk_view_callback;
     std::function<void()> done_callback;
 
     ConstructionParams() = delete;
@@ -43,6 +50,13 @@ class ChunkByChunkHTTPResponseReceiver {
                        std::function<void()> done_callback)
         : header_callback(header_callback), chunk_callback(chunk_callback), done_callback(done_callback) {}
 
+    ConstructionParams(std::function<void(const std::string&, const std::string&)> header_callback,
+                       std::function<void(std::string_view)> chunk_view_callback,
+                       std::function<void()> done_callback)
+        : header_callback(header_callback),
+          chunk_view_callback(chunk_view_callback),
+          done_callback(done_callback) {}
+
     ConstructionParams(const ConstructionParams& rhs) = default;
   };
 
@@ -57,7 +71,13 @@ class ChunkByChunkHTTPResponseReceiver {
  protected:
   inline void OnHeader(const char* key, const char* value) { params.header_callback(key, value); }
 
-  inline void OnChunk(const char* chunk, size_t length) { params.chunk_callback(std::string(chunk, length)); }
+  inline void OnChunk(const char* chunk, size_t length) {
+    if (params.chunk_view_callback) {
+      params.chunk_view_callback(std::string_view(chunk, length));
+    } else {
+      params.chunk_callback(std::string(chunk, length));
+    }
+  }
 
   inline void OnChunkedBodyDone(const char*& begin, const char*& end) {
     params.done_callback();
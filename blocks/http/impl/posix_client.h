@@ -30,18 +30,126 @@ SOFTWARE.
 
 #include "../types.h"
 
+#include <chrono>
+#include <deque>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <set>
+#include <utility>
 
 #include "../../url/url.h"
 
 #include "../../../bricks/net/http/http.h"
 #include "../../../bricks/file/file.h"
+#include "../../../bricks/util/singleton.h"
 
 namespace current {
 namespace http {
 
+// The connections the servers have kept open after the responses, to send the next requests to the same host over,
+// instead of opening a new connection per request. Shared by all the requests made via `HTTPClientPOSIX`.
+class HTTPClientConnectionPool final {
+ public:
+  // Zero, the default, disables keeping the connections open: the server closes each one after its response.
+  void SetMaxIdleConnectionsPerHost(size_t max_idle_connections_per_host) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_idle_connections_per_host_ = max_idle_connections_per_host;
+    for (auto& host : idle_) {
+      while (host.second.size() > max_idle_connections_per_host_) {
+        host.second.pop_front();
+      }
+    }
+  }
+
+  // The connections idle for longer are not reused, as the server may be about to close them.
+  void SetIdleTimeout(std::chrono::milliseconds idle_timeout) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_timeout_ = idle_timeout;
+  }
+
+  bool Enabled() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return max_idle_connections_per_host_ > 0u;
+  }
+
+  size_t IdleConnectionsCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t result = 0u;
+    for (const auto& host : idle_) {
+      result += host.second.size();
+    }
+    return result;
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_.clear();
+  }
+
+  // Returns the most recently used idle connection to `host:port`, or `nullptr` if there is none.
+  std::unique_ptr<current::net::Connection> Take(const std::string& host, int port) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = idle_.find(std::make_pair(host, port));
+    if (it == idle_.end()) {
+      return nullptr;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    std::unique_ptr<current::net::Connection> result;
+    while (!result && !it->second.empty()) {
+      IdleConnection idle = std::move(it->second.back());
+      it->second.pop_back();
+      if (now - idle.since < idle_timeout_ && IsStillOpen(*idle.connection)) {
+        result = std::move(idle.connection);
+      }
+    }
+    if (it->second.empty()) {
+      idle_.erase(it);
+    }
+    return result;
+  }
+
+  void Put(const std::string& host, int port, std::unique_ptr<current::net::Connection> connection) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (max_idle_connections_per_host_) {
+      auto& idle = idle_[std::make_pair(host, port)];
+      if (idle.size() == max_idle_connections_per_host_) {
+        idle.pop_front();
+      }
+      idle.push_back(IdleConnection{std::move(connection), std::chrono::steady_clock::now()});
+    }
+  }
+
+ private:
+  struct IdleConnection final {
+    std::unique_ptr<current::net::Connection> connection;
+    std::chrono::steady_clock::time_point since;
+  };
+
+  // Nothing is expected from the server before the next request; if anything is there, it is closing the connection.
+  static bool IsStillOpen(current::net::Connection& connection) {
+#ifndef CURRENT_WINDOWS
+    try {
+      char byte;
+      return connection.NonBlockingRead(&byte, 1u) == 0u;
+    } catch (const current::net::SocketException&) {
+      return false;
+    }
+#else
+    static_cast<void>(connection);
+    return true;
+#endif  // CURRENT_WINDOWS
+  }
+
+  mutable std::mutex mutex_;
+  size_t max_idle_connections_per_host_ = 0u;
+  std::chrono::milliseconds idle_timeout_ = std::chrono::seconds(5);
+  std::map<std::pair<std::string, int>, std::deque<IdleConnection>> idle_;
+};
+
+inline HTTPClientConnectionPool& HTTPClientConnections() { return current::Singleton<HTTPClientConnectionPool>(); }
+
 namespace impl {
 struct HTTPRedirectHelper : current::net::HTTPDefaultHelper {
   struct ConstructionParams {};
@@ -71,89 +179,168 @@ class GenericHTTPClientPOSIX final {
 
   // The actual implementation.
   bool Go() {
-    // TODO(dkorolev): Always use the URL returned by the server here.
-    response_url_after_redirects_ = request_url_;
-    URL parsed_url(request_url_);
+    URL parsed_url = BeginRequest();
     std::set<std::string> all_urls;
-    bool redirected;
     do {
-      redirected = false;
-      const std::string composed_url = parsed_url.ComposeURL();
-      if (all_urls.count(composed_url)) {
-        const std::string loop = (current::strings::Join(all_urls, ' ') + " " + composed_url);
-        CURRENT_THROW(current::net::HTTPRedirectLoopException(loop));
-      }
-      all_urls.insert(composed_url);
-      // The `URL` class' concern is to parse the URL string as is: if the port is missing, it becomes zero.
-      // `URL::DefaultPortForScheme` will return zero anyway if the schema is unknown.
-      // So, to make sure we don't try to connect to port zero, the defaulting logic has to be here in the HTTP client.
-      int port = parsed_url.port;
-      if (port == 0) {
-        port = URL::DefaultPortForScheme(parsed_url.scheme);
-        if (port == 0) {
-          port = 80;
+      BeginHop(parsed_url, all_urls);
+      const int port = Port(parsed_url);
+      const bool keep_alive = KeepAlive();
+      std::unique_ptr<current::net::Connection> connection;
+      if (keep_alive) {
+        connection = HTTPClientConnections().Take(parsed_url.host, port);
+        if (connection) {
+          try {
+            SendRequest(*connection, parsed_url, true);
+            ReceiveResponse(*connection);
+          } catch (const current::net::SocketException&) {
+            // The server may have closed the idle connection just as it was being reused. Retry on a new one.
+            connection = nullptr;
+          }
         }
       }
-      current::net::Connection connection(current::net::Connection(current::net::ClientSocket(parsed_url.host, port)));
-      connection.BlockingWrite(
-          request_method_ + ' ' + parsed_url.path + parsed_url.ComposeParameters() + " HTTP/1.1\r\n", true);
-      connection.BlockingWrite("Host: " + parsed_url.host + "\r\n", true);
-      if (!request_user_agent_.empty()) {
-        connection.BlockingWrite("User-Agent: " + request_user_agent_ + "\r\n", true);
+      if (!connection) {
+        connection = std::make_unique<current::net::Connection>(
+            current::net::Connection(current::net::ClientSocket(parsed_url.host, port)));
+        SendRequest(*connection, parsed_url, keep_alive);
+        ReceiveResponse(*connection);
       }
-      for (const auto& h : request_headers_) {
-        connection.BlockingWrite(h.header + ": " + h.value + "\r\n", true);
+      if (keep_alive && ConnectionReusable()) {
+        HTTPClientConnections().Put(parsed_url.host, port, std::move(connection));
       }
-      if (!request_headers_.cookies.empty()) {
-        connection.BlockingWrite("Cookie: " + request_headers_.CookiesAsString() + "\r\n", true);
+    } while (EndHop(parsed_url));
+    return true;
+  }
+
+  // The steps of `Go()`, also taken by `HTTPAsyncClient`, which waits for the responses without blocking.
+  URL BeginRequest() {
+    // TODO(dkorolev): Always use the URL returned by the server here.
+    response_url_after_redirects_ = request_url_;
+    return URL(request_url_);
+  }
+
+  void BeginHop(const URL& parsed_url, std::set<std::string>& all_urls) const {
+    const std::string composed_url = parsed_url.ComposeURL();
+    if (all_urls.count(composed_url)) {
+      const std::string loop = (current::strings::Join(all_urls, ' ') + " " + composed_url);
+      CURRENT_THROW(current::net::HTTPRedirectLoopException(loop));
+    }
+    all_urls.insert(composed_url);
+  }
+
+  static int Port(const URL& parsed_url) {
+    // The `URL` class' concern is to parse the URL string as is: if the port is missing, it becomes zero.
+    // `URL::DefaultPortForScheme` will return zero anyway if the schema is unknown.
+    // So, to make sure we don't try to connect to port zero, the defaulting logic has to be here in the HTTP client.
+    int port = parsed_url.port;
+    if (port == 0) {
+      port = URL::DefaultPortForScheme(parsed_url.scheme);
+      if (port == 0) {
+        port = 80;
       }
-      if (!request_body_content_type_.empty()) {
-        connection.BlockingWrite("Content-Type: " + request_body_content_type_ + "\r\n", true);
+    }
+    return port;
+  }
+
+  // With `HTTPClientConnections()` enabled, ask the server to keep the connection open, and reuse it.
+  // The `HEAD` responses carry `Content-Length` with no body following it, so they close the connection.
+  bool KeepAlive() const { return HTTPClientConnections().Enabled() && request_method_ != "HEAD"; }
+
+  // Whether the connection the response has been received over can be reused for the next request.
+  bool ConnectionReusable() const { return http_request_->KeepAliveRequested() && http_request_->ReadAhead().empty(); }
+
+  // Returns whether the response is a redirect to follow, to `parsed_url`.
+  bool EndHop(URL& parsed_url) {
+    // TODO(dkorolev): Rename `Path()`, it's only called so now because of HTTP request/response format.
+    // Elaboration:
+    // HTTP request  message is: `GET /path HTTP/1.1`, "/path" is the second component of it.
+    // HTTP response message is: `HTTP/1.1 200 OK`, "200" is the second component of it.
+    // Thus, since the same code is used for request and response parsing as of now,
+    // the numerical response code "200" can be accessed with the same method as the "/path".
+    const int response_code_as_int = atoi(http_request_->RawPath().c_str());
+    response_code_ = HTTPResponseCode(response_code_as_int);
+    // Follow the redirects automatically.
+    // Note: This is by no means a complete redirect implementation.
+    if (response_code_as_int >= 300 && response_code_as_int <= 399 && !http_request_->location.empty()) {
+      if (!allow_redirects_) {
+        CURRENT_THROW(current::net::HTTPRedirectNotAllowedException());
       }
-      if (!request_body_contents_.empty() || current::net::NeedContentLengthHeader(request_method_)) {
-        // NOTE(dkorolev): The `try/catch/throw` combo here is a hack for the unit test for HTTP 413 to pass.
-        // It swallows the `SocketWriteException` exception for huge payloads, as Current's HTTP server logic
-        // does intentionally close the HTTP connection prematurely if `Content-Length` exceeds a reasonable limit.
-        try {
+      parsed_url = URL::MakeRedirectedURL(parsed_url, http_request_->location);
+      response_url_after_redirects_ = parsed_url.ComposeURL();
+      return true;
+    }
+    return false;
+  }
+
+  void SendRequest(current::net::Connection& connection, const URL& parsed_url, bool keep_alive) {
+    // The request line and the headers are composed into a single buffer, to be written, along with the body,
+    // with a single system call.
+    std::string header;
+    header.reserve(256u + parsed_url.path.length() + request_user_agent_.length());
+    header += request_method_;
+    header += ' ';
+    header += parsed_url.path;
+    header += parsed_url.ComposeParameters();
+    header += " HTTP/1.1\r\nHost: ";
+    header += parsed_url.host;
+    header += "\r\n";
+    if (keep_alive) {
+      header += current::net::constants::kConnectionHeaderKey;
+      header += ": ";
+      header += current::net::constants::kConnectionKeepAliveValue;
+      header += "\r\n";
+    }
+    if (request_accept_compressed_) {
+      header += current::net::constants::kAcceptEncodingHeaderKey;
+      header += ": gzip, deflate\r\n";
+    }
+    if (!request_user_agent_.empty()) {
+      header += "User-Agent: ";
+      header += request_user_agent_;
+      header += "\r\n";
+    }
+    for (const auto& h : request_headers_) {
+      header += h.header;
+      header += ": ";
+      header += h.value;
+      header += "\r\n";
+    }
+    if (!request_headers_.cookies.empty()) {
+      header += "Cookie: ";
+      header += request_headers_.CookiesAsString();
+      header += "\r\n";
+    }
+    if (!request_body_content_type_.empty()) {
+      header += "Content-Type: ";
+      header += request_body_content_type_;
+      header += "\r\n";
+    }
+    if (!request_body_contents_.empty() || current::net::NeedContentLengthHeader(request_method_)) {
+      header += "Content-Length: ";
+      header += std::to_string(request_body_contents_.length());
+      header += "\r\n\r\n";
+      // NOTE(dkorolev): The `try/catch/throw` combo here is a hack for the unit test for HTTP 413 to pass.
+      // It swallows the `SocketWriteException` exception for huge payloads, as Current's HTTP server logic
+      // does intentionally close the HTTP connection prematurely if `Content-Length` exceeds a reasonable limit.
+      try {
 #ifndef CURRENT_WINDOWS
-          connection.BlockingWrite("Content-Length: " + std::to_string(request_body_contents_.length()) + "\r\n", true);
-          connection.BlockingWrite("\r\n", true);
-          connection.BlockingWrite(request_body_contents_, false);
+        connection.BlockingWriteV({header, request_body_contents_}, false);
 #else
-          // TODO(grixa): this fix for the PayloadTooLarge test on Windows is temporary, need to revisit it.
-          connection.BlockingWrite("Content-Length: " + std::to_string(request_body_contents_.length()) + "\r\n\r\n" +
-                                       request_body_contents_,
-                                   false);
+        // TODO(grixa): this fix for the PayloadTooLarge test on Windows is temporary, need to revisit it.
+        connection.BlockingWrite(header + request_body_contents_, false);
 #endif
-        } catch (const net::SocketWriteException&) {
-          if (request_body_contents_.length() <= net::constants::kMaxHTTPPayloadSizeInBytes) {
-            throw;
-          }
+      } catch (const net::SocketWriteException&) {
+        if (request_body_contents_.length() <= net::constants::kMaxHTTPPayloadSizeInBytes) {
+          throw;
         }
-      } else {
-        connection.BlockingWrite("\r\n", false);
       }
-      http_request_.reset(new CustomHTTPRequestData(connection, request_data_construction_params_));
-      // TODO(dkorolev): Rename `Path()`, it's only called so now because of HTTP request/response format.
-      // Elaboration:
-      // HTTP request  message is: `GET /path HTTP/1.1`, "/path" is the second component of it.
-      // HTTP response message is: `HTTP/1.1 200 OK`, "200" is the second component of it.
-      // Thus, since the same code is used for request and response parsing as of now,
-      // the numerical response code "200" can be accessed with the same method as the "/path".
-      const int response_code_as_int = atoi(http_request_->RawPath().c_str());
-      response_code_ = HTTPResponseCode(response_code_as_int);
-      // Follow the redirects automatically.
-      // Note: This is by no means a complete redirect implementation.
-      if (response_code_as_int >= 300 && response_code_as_int <= 399 && !http_request_->location.empty()) {
-        if (!allow_redirects_) {
-          CURRENT_THROW(current::net::HTTPRedirectNotAllowedException());
-        }
-        redirected = true;
-        parsed_url = URL::MakeRedirectedURL(parsed_url, http_request_->location);
-        response_url_after_redirects_ = parsed_url.ComposeURL();
-      }
-    } while (redirected);
-    return true;
+    } else {
+      header += "\r\n";
+      connection.BlockingWrite(header, false);
+    }
+  }
+
+  void ReceiveResponse(current::net::Connection& connection) {
+    http_request_.reset(new CustomHTTPRequestData(connection, request_data_construction_params_));
   }
 
   const CustomHTTPRequestData& HTTPRequest() const { return *http_request_.get(); }
@@ -168,6 +355,8 @@ class GenericHTTPClientPOSIX final {
   current::net::http::Headers request_headers_;
   const typename HTTP_HELPER::ConstructionParams request_data_construction_params_;
   bool allow_redirects_ = false;
+  // Whether to ask for the response to be compressed, for `ImplWrapper` to decompress it transparently.
+  bool request_accept_compressed_ = false;
 
   // Output parameters.
   current::net::HTTPResponseCodeValue response_code_ = HTTPResponseCode.InvalidCode;
@@ -187,6 +376,7 @@ struct ImplWrapper<HTTPClientPOSIX> {
     client.request_user_agent_ = request.custom_user_agent;
     client.request_headers_ = request.custom_headers;
     client.allow_redirects_ = request.allow_redirects;
+    AcceptCompressed(request, client);
   }
 
   inline static void PrepareInput(const HEAD& request, HTTPClientPOSIX& client) {
@@ -205,6 +395,7 @@ struct ImplWrapper<HTTPClientPOSIX> {
     client.request_body_contents_ = request.body;
     client.request_body_content_type_ = request.content_type;
     client.allow_redirects_ = request.allow_redirects;
+    AcceptCompressed(request, client);
   }
 
   inline static void PrepareInput(const POSTFromFile& request, HTTPClientPOSIX& client) {
@@ -216,6 +407,7 @@ struct ImplWrapper<HTTPClientPOSIX> {
         current::FileSystem::ReadFileAsString(request.file_name);  // Can throw FileException.
     client.request_body_content_type_ = request.content_type;
     client.allow_redirects_ = request.allow_redirects;
+    AcceptCompressed(request, client);
   }
 
   inline static void PrepareInput(const PUT& request, HTTPClientPOSIX& client) {
@@ -226,6 +418,7 @@ struct ImplWrapper<HTTPClientPOSIX> {
     client.request_body_contents_ = request.body;
     client.request_body_content_type_ = request.content_type;
     client.allow_redirects_ = request.allow_redirects;
+    AcceptCompressed(request, client);
   }
 
   inline static void PrepareInput(const PATCH& request, HTTPClientPOSIX& client) {
@@ -236,6 +429,7 @@ struct ImplWrapper<HTTPClientPOSIX> {
     client.request_body_contents_ = request.body;
     client.request_body_content_type_ = request.content_type;
     client.allow_redirects_ = request.allow_redirects;
+    AcceptCompressed(request, client);
   }
 
   inline static void PrepareInput(const DELETE& request, HTTPClientPOSIX& client) {
@@ -244,10 +438,30 @@ struct ImplWrapper<HTTPClientPOSIX> {
     client.request_user_agent_ = request.custom_user_agent;  // LCOV_EXCL_LINE  -- tested in GET above.
     client.request_headers_ = request.custom_headers;
     client.allow_redirects_ = request.allow_redirects;
+    AcceptCompressed(request, client);
   }
 
   inline static void PrepareInput(const KeepResponseInMemory&, HTTPClientPOSIX&) {}
 
+  // Unless the user has set `Accept-Encoding` by hand, in which case the response is returned as is.
+  template <typename T>
+  inline static void AcceptCompressed(const T& request, HTTPClientPOSIX& client) {
+    client.request_accept_compressed_ =
+        request.accept_compressed && !request.custom_headers.Has(current::net::constants::kAcceptEncodingHeaderKey);
+  }
+
+  inline static std::string ResponseBody(const HTTPClientPOSIX& response) {
+    const auto& http_request = response.HTTPRequest();
+    const auto& headers = http_request.headers();
+    if (response.request_accept_compressed_ && headers.Has(current::net::constants::kContentEncodingHeaderKey)) {
+      return current::net::DecompressHTTPBody(http_request.Body(),
+                                              headers.Get(current::net::constants::kContentEncodingHeaderKey),
+                                              current::net::constants::kMaxHTTPDecompressedBodySizeInBytes);
+    } else {
+      return http_request.Body();
+    }
+  }
+
   inline static void PrepareInput(const SaveResponseToFile& save_to_file_request, HTTPClientPOSIX&) {
     CURRENT_ASSERT(!save_to_file_request.file_name.empty());
   }
@@ -271,8 +485,7 @@ struct ImplWrapper<HTTPClientPOSIX> {
                                  const HTTPClientPOSIX& response,
                                  HTTPResponseWithBuffer& output) {
     ParseOutput(request_params, response_params, response, static_cast<HTTPResponse&>(output));
-    const auto& http_request = response.HTTPRequest();
-    output.body = http_request.Body();
+    output.body = ResponseBody(response);
   }
 
   template <typename REQUEST_PARAMS, typename RESPONSE_PARAMS>
@@ -282,8 +495,7 @@ struct ImplWrapper<HTTPClientPOSIX> {
                                  HTTPResponseWithResultingFileName& output) {
     ParseOutput(request_params, response_params, response, static_cast<HTTPResponse&>(output));
     // TODO(dkorolev): This is doubly inefficient. Should write the buffer or write in chunks instead.
-    const auto& http_request = response.HTTPRequest();
-    current::FileSystem::WriteStringToFile(http_request.Body(), response_params.file_name.c_str());
+    current::FileSystem::WriteStringToFile(ResponseBody(response), response_params.file_name.c_str());
     output.body_file_name = response_params.file_name;
   }
 };
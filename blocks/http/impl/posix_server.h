@@ -26,15 +26,27 @@ SOFTWARE.
 #define BLOCKS_HTTP_IMPL_POSIX_SERVER_H
 
 #include <atomic>
+#include <condition_variable>
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <thread>
 #include <iostream>  // TODO(dkorolev): More robust logging here.
 
 #include "../types.h"
+#include "../admission_control.h"
+#include "../phase_timings.h"
 #include "../request.h"
 
+#include "posix_server_event_loop.h"
+#include "posix_server_http2.h"
+#include "routes_trie.h"
+#include "static_files.h"
+#include "../worker_pool.h"
+
+#include "../../metrics/metrics.h"
 #include "../../url/url.h"
 
 #include "../../../typesystem/optional.h"
@@ -43,8 +55,15 @@ SOFTWARE.
 #include "../../../bricks/net/http/http.h"
 #include "../../../bricks/strings/printf.h"
 #include "../../../bricks/sync/owned_borrowed.h"
+#include "../../../bricks/system/placement.h"
 #include "../../../bricks/time/chrono.h"
 #include "../../../bricks/util/accumulative_scoped_deleter.h"
+#include "../../../bricks/util/crc32.h"
+
+#if defined(CURRENT_POSIX) && !defined(CURRENT_APPLE)
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace current {
 namespace http {
@@ -97,6 +116,13 @@ struct ServeStaticFilesFromOptions {
   // Names of files to serve if a directory URL is requested, in the priority order (first found will be served).
   std::vector<std::string> index_filenames;
 
+  // Keep the files open and send them with `sendfile()`, instead of reading them into memory once.
+  bool use_sendfile = false;
+
+  // Serve `file.gz` and `file.br`, if present next to `file`, as precompressed `file` to the clients accepting these
+  // encodings, instead of registering them as the files of their own.
+  bool serve_precompressed = false;
+
   explicit ServeStaticFilesFromOptions(std::string route_prefix_in = "/",
                                        std::string public_url_prefix_in = "",
                                        std::vector<std::string> index_filenames_in = {"index.html", "index.htm"})
@@ -106,9 +132,45 @@ struct ServeStaticFilesFromOptions {
 };
 
 // Helper to serve a static file.
+// Supports `ETag` with `If-None-Match`, a single `Range`, and the precompressed representations of the file.
 // TODO(dkorolev): Expose it externally under a better name, and add a comment/example.
 struct StaticFileServer {
-  std::string content;
+  // One way of serving the file: as is, or precompressed, in which case `content_encoding` is not empty.
+  struct Representation {
+    std::string content_encoding;
+    std::string content;                           // The contents, unless they are sent from `file`.
+    std::shared_ptr<impl::OpenStaticFile> file;  // Set if the contents are to be sent from the file.
+    std::string etag;
+
+    uint64_t Size() const { return file ? file->Size() : static_cast<uint64_t>(content.length()); }
+
+    static Representation FromContent(std::string content, std::string content_encoding = "") {
+      Representation result;
+      result.etag = strings::Printf("\"%08x-%llx%s%s\"",
+                                    CRC32(content),
+                                    static_cast<unsigned long long>(content.length()),
+                                    content_encoding.empty() ? "" : "-",
+                                    content_encoding.c_str());
+      result.content_encoding = std::move(content_encoding);
+      result.content = std::move(content);
+      return result;
+    }
+
+    static Representation FromFile(const std::string& pathname, std::string content_encoding = "") {
+      Representation result;
+      result.file = std::make_shared<impl::OpenStaticFile>(pathname);
+      result.etag = strings::Printf("\"%llx-%llx%s%s\"",
+                                    static_cast<unsigned long long>(result.file->ModificationTime()),
+                                    static_cast<unsigned long long>(result.file->Size()),
+                                    content_encoding.empty() ? "" : "-",
+                                    content_encoding.c_str());
+      result.content_encoding = std::move(content_encoding);
+      return result;
+    }
+  };
+
+  // The file as is first, followed by its precompressed representations, in the order of preference.
+  std::vector<Representation> representations;
   std::string content_type;
   bool serves_directory;
   std::string trailing_slash_redirect_url;
@@ -117,7 +179,16 @@ struct StaticFileServer {
                    std::string content_type,
                    bool serves_directory,
                    std::string trailing_slash_redirect_url = "")
-      : content(std::move(content)),
+      : representations({Representation::FromContent(std::move(content))}),
+        content_type(content_type),
+        serves_directory(serves_directory),
+        trailing_slash_redirect_url(trailing_slash_redirect_url) {}
+
+  StaticFileServer(std::vector<Representation> representations,
+                   std::string content_type,
+                   bool serves_directory,
+                   std::string trailing_slash_redirect_url = "")
+      : representations(std::move(representations)),
         content_type(content_type),
         serves_directory(serves_directory),
         trailing_slash_redirect_url(trailing_slash_redirect_url) {}
@@ -129,7 +200,7 @@ struct StaticFileServer {
         // (`static` is a directory, not a file).
         // 2) Respond with the content if we're serving a file and don't have a trailing slash. Example:
         // `/static/index.html`, `/static/file.png`.
-        r.connection.SendHTTPResponse(content, HTTPResponseCode.OK, net::http::Headers(), content_type);
+        RespondWithContent(r);
       } else if (!serves_directory && r.url_path_had_trailing_slash) {
         // Respond with HTTP 404 Not Found if we're serving a file and have a trailing slash. Example:
         // `/static/index.html/`.
@@ -154,6 +225,74 @@ struct StaticFileServer {
                                     current::net::constants::kDefaultHTMLContentType);
     }
   }
+
+ private:
+  const Representation& ChooseRepresentation(const Request& r) const {
+    const std::string accept_encoding = r.headers.GetOrDefault("Accept-Encoding", "");
+    if (!accept_encoding.empty()) {
+      for (size_t i = 1u; i < representations.size(); ++i) {
+        if (impl::AcceptsEncoding(accept_encoding, representations[i].content_encoding)) {
+          return representations[i];
+        }
+      }
+    }
+    return representations.front();
+  }
+
+  void RespondWithContent(Request& r) const {
+    const Representation& representation = ChooseRepresentation(r);
+    const bool as_is = representation.content_encoding.empty();
+    const uint64_t size = representation.Size();
+
+    current::net::http::Headers headers({{"ETag", representation.etag}});
+    if (representations.size() > 1u) {
+      headers.Set("Vary", "Accept-Encoding");
+    }
+    if (as_is) {
+      // The ranges of the precompressed representations are not served, as they are rarely of any use.
+      headers.Set("Accept-Ranges", "bytes");
+    } else {
+      headers.Set("Content-Encoding", representation.content_encoding);
+    }
+
+    if (r.headers.Has("If-None-Match") &&
+        impl::IfNoneMatchMatches(r.headers.Get("If-None-Match"), representation.etag)) {
+      r.connection.SendHTTPResponse("", HTTPResponseCode.NotModified, headers, content_type);
+      return;
+    }
+
+    current::net::HTTPResponseCodeValue code = HTTPResponseCode.OK;
+    uint64_t begin = 0u;
+    uint64_t end = size;
+    if (as_is && r.headers.Has("Range") &&
+        (!r.headers.Has("If-Range") || r.headers.Get("If-Range") == representation.etag)) {
+      const impl::StaticFileRange range = impl::ParseStaticFileRange(r.headers.Get("Range"), size, begin, end);
+      if (range == impl::StaticFileRange::NotSatisfiable) {
+        headers.Set("Content-Range", strings::Printf("bytes */%llu", static_cast<unsigned long long>(size)));
+        r.connection.SendHTTPResponse("", HTTPResponseCode.RequestedRangeNotSatisfiable, headers, content_type);
+        return;
+      } else if (range == impl::StaticFileRange::Satisfiable) {
+        code = HTTPResponseCode.PartialContent;
+        headers.Set("Content-Range",
+                    strings::Printf("bytes %llu-%llu/%llu",
+                                    static_cast<unsigned long long>(begin),
+                                    static_cast<unsigned long long>(end - 1u),
+                                    static_cast<unsigned long long>(size)));
+      } else {
+        begin = 0u;
+        end = size;
+      }
+    }
+
+    if (representation.file) {
+      r.connection.SendHTTPResponseFromFile(
+          representation.file->FD(), begin, end - begin, code, headers, content_type);
+    } else {
+      const auto content_begin = representation.content.begin() + static_cast<std::ptrdiff_t>(begin);
+      const auto content_end = representation.content.begin() + static_cast<std::ptrdiff_t>(end);
+      r.connection.SendHTTPResponse(content_begin, content_end, code, headers, content_type);
+    }
+  }
 };
 
 // HTTP server bound to a specific port.
@@ -178,6 +317,8 @@ class HTTPServerPOSIX final {
   // unregistering all handlers will still keep the listening thread up, and it will serve 404-s.
   ~HTTPServerPOSIX() {
     terminating_ = true;
+    // Stop the additional listeners first, for the terminating request below to reach the primary one.
+    StopAdditionalListeners(0u);
     // Notify the server thread that it should terminate.
     // Effectively, call `HTTP(GET("/healthz"))`, but in a way that avoids client <=> server dependency.
     // LCOV_EXCL_START
@@ -196,6 +337,208 @@ class HTTPServerPOSIX final {
     if (thread_.joinable()) {
       thread_.join();
     }
+    {
+      std::lock_guard<std::mutex> lock(event_loop_mutex_);
+      event_loop_ = nullptr;
+    }
+    StopHTTP2Sessions();
+    DisableHTTP2();
+    SetWorkerThreads(0u);
+  }
+
+  // By default, the connections are accepted on a single thread, from the socket bound to the port first.
+  // `SetListeners(n)` has `n - 1` more sockets bound to the same port with `SO_REUSEPORT`, each accepting
+  // the connections on its own thread, for the kernel to spread the incoming connections across them, instead of
+  // queueing them all for one thread. The connections accepted are then served the same way, on the thread that
+  // has accepted them, or in the event loop, if any, see `SetIOThreads()`. With `pin_to_cpus`, the thread of the
+  // `i`-th listener only runs on the CPU `i`, modulo the number of CPUs. Linux only; elsewhere, `SetListeners()`
+  // has no effect. `SetListeners(1)` reverts to the default; the connections queued for the listeners stopped,
+  // if not accepted yet, are reset by the kernel. Must not be called from a handler.
+  void SetListeners(size_t listeners, bool pin_to_cpus = false) {
+#if defined(CURRENT_POSIX) && !defined(CURRENT_APPLE)
+    std::unique_lock<std::mutex> lock(listeners_mutex_);
+    // Wait for the primary listener to have started, to share the port with it.
+    listeners_condition_variable_.wait(lock, [this]() { return primary_listener_ != nullptr || terminating_; });
+    if (terminating_) {
+      return;
+    }
+    lock.unlock();
+    StopAdditionalListeners(listeners ? listeners - 1u : 0u);
+    lock.lock();
+    if (listeners > 1u) {
+      primary_listener_->EnableReusePort();
+    }
+    while (additional_listeners_.size() + 1u < listeners) {
+      auto listener = std::make_unique<AdditionalListener>(
+          current::net::Socket(current::net::BarePort(port_),
+                               current::net::kDefaultNagleAlgorithmPolicy,
+                               current::net::kMaxServerQueuedConnections,
+                               current::net::ReusePort::Yes));
+      if (const auto socket_options = SocketOptions()) {
+        SetListenerOptions(listener->socket, *socket_options);
+      }
+      AdditionalListener& l = *listener;
+      l.thread = std::thread([this, &l]() {
+        current::bricks::system::ThreadPlacementPolicy().PlaceCurrentThread(
+            current::bricks::system::ThreadRole::HTTPServer);
+        AcceptConnections(l.socket, l.stopping);
+      });
+      additional_listeners_.push_back(std::move(listener));
+    }
+    const size_t cpus = std::thread::hardware_concurrency();
+    if (cpus) {
+      PinToCPU(thread_, pin_to_cpus, 0u, cpus);
+      for (size_t i = 0u; i < additional_listeners_.size(); ++i) {
+        PinToCPU(additional_listeners_[i]->thread, pin_to_cpus, (i + 1u) % cpus, cpus);
+      }
+    }
+#else
+    static_cast<void>(listeners);
+    static_cast<void>(pin_to_cpus);
+#endif
+  }
+
+  size_t Listeners() const {
+    std::lock_guard<std::mutex> lock(listeners_mutex_);
+    return additional_listeners_.size() + 1u;
+  }
+
+  // By default, the requests are read and served one by one, on the thread accepting the connections.
+  // `SetIOThreads(n)` makes the subsequently accepted connections be read without blocking, and the requests
+  // be served on `n` threads, once each has been received in full; see `posix_server_event_loop.h`. This way,
+  // a slow client does not hold back the others, but the handlers must then be safe to run concurrently.
+  // The requests not received in full within `request_timeout` are dropped. `SetIOThreads(0)` reverts to
+  // the default. Must not be called from a handler, as it waits for the threads of the previous setting
+  // to finish, dropping the connections they have not received the requests from in full yet.
+  void SetIOThreads(size_t io_threads, std::chrono::milliseconds request_timeout = std::chrono::seconds(10)) {
+    std::unique_ptr<impl::HTTPServerEventLoop> event_loop;
+    if (io_threads) {
+      event_loop = std::make_unique<impl::HTTPServerEventLoop>(
+          io_threads, request_timeout, [this](current::net::Connection&& c, size_t requests_served) {
+            ServeConnection(std::move(c), requests_served);
+          });
+    }
+    std::lock_guard<std::mutex> lock(event_loop_mutex_);
+    std::swap(event_loop, event_loop_);
+  }
+
+  size_t IOThreads() const {
+    std::lock_guard<std::mutex> lock(event_loop_mutex_);
+    return event_loop_ ? event_loop_->ThreadsCount() : 0u;
+  }
+
+  // `SetWorkerThreads(n)` makes the handlers of all the routes run on a pool of `n` threads, with up to
+  // `max_queued_requests` waiting for a thread, and the ones over it responded to with 503; see `worker_pool.h`.
+  // The requests that have waited for a thread for longer than a non-zero `max_queue_time` are shed with 503.
+  // `SetWorkerThreads(0)` reverts to running the handlers on the thread that has received the request, once
+  // the requests being served on the pool are done, responding with 503 to the ones still queued.
+  void SetWorkerThreads(size_t threads,
+                        size_t max_queued_requests = 1000u,
+                        std::chrono::milliseconds max_queue_time = std::chrono::milliseconds(0),
+                        std::chrono::seconds retry_after = std::chrono::seconds(1)) {
+    std::shared_ptr<HTTPWorkerPool> worker_pool;
+    if (threads) {
+      worker_pool = std::make_shared<HTTPWorkerPool>(threads, max_queued_requests, max_queue_time, retry_after);
+    }
+    std::lock_guard<std::mutex> lock(worker_pool_mutex_);
+    std::swap(worker_pool, worker_pool_);
+  }
+
+  size_t WorkerThreads() const {
+    std::lock_guard<std::mutex> lock(worker_pool_mutex_);
+    return worker_pool_ ? worker_pool_->ThreadsCount() : 0u;
+  }
+
+  HTTPWorkerPoolMetrics WorkerPoolMetrics() const {
+    std::lock_guard<std::mutex> lock(worker_pool_mutex_);
+    return worker_pool_ ? worker_pool_->Metrics() : HTTPWorkerPoolMetrics();
+  }
+
+  // Limits how many requests are in flight at once, in total and per route, responding with 503 and `Retry-After`
+  // to the ones over the limits right away; see `admission_control.h`. The routes are identified by the paths
+  // they are registered at. Setting the limits again starts the counters over; the default limits are no limits.
+  void SetAdmissionLimits(HTTPAdmissionLimits limits) {
+    auto admission_control = std::make_shared<HTTPAdmissionControl>(std::move(limits));
+    std::lock_guard<std::mutex> lock(admission_control_mutex_);
+    admission_control_ = std::move(admission_control);
+  }
+
+  HTTPAdmissionMetrics AdmissionMetrics() const {
+    std::lock_guard<std::mutex> lock(admission_control_mutex_);
+    return admission_control_ ? admission_control_->Metrics() : HTTPAdmissionMetrics();
+  }
+
+  // The timings of the phases of the requests served so far, per route, see `phase_timings.h`. Always on.
+  HTTPPhaseTimingsSnapshot PhaseTimings() const { return phase_timings_->Snapshot(); }
+  void ResetPhaseTimings() { phase_timings_->Clear(); }
+
+  // Compresses the responses with gzip or deflate, as per the `Accept-Encoding` header of the request, for the
+  // responses of the content types allowed by `options`, of at least `options.min_size` bytes, and for the chunked
+  // responses of these content types, flushing the compressed data with every flushed chunk. The responses that
+  // already have a `Content-Encoding` header are sent as is. Off by default, `DisableCompression()` turns it off.
+  void SetCompression(current::net::HTTPCompressionOptions options = current::net::HTTPCompressionOptions()) {
+    auto compression = std::make_shared<const current::net::HTTPCompressionOptions>(std::move(options));
+    std::lock_guard<std::mutex> lock(compression_mutex_);
+    compression_ = std::move(compression);
+  }
+
+  void DisableCompression() {
+    std::lock_guard<std::mutex> lock(compression_mutex_);
+    compression_ = nullptr;
+  }
+
+  // Tunes the TCP sockets, see `current::net::SocketOptions`: the listening sockets right away, the ones added by
+  // `SetListeners()` later as well, and each connection accepted from now on. The options of the connections are
+  // set on the listening sockets too, to throw `SocketOptionException` here if they can not be set. The options
+  // not set in `options` are left as they are. Must not be called from a handler.
+  void SetSocketOptions(current::net::SocketOptions options) {
+    auto socket_options = std::make_shared<const current::net::SocketOptions>(std::move(options));
+    std::unique_lock<std::mutex> lock(listeners_mutex_);
+    listeners_condition_variable_.wait(lock, [this]() { return primary_listener_ != nullptr || terminating_; });
+    if (terminating_) {
+      return;
+    }
+    SetListenerOptions(*primary_listener_, *socket_options);
+    for (auto& listener : additional_listeners_) {
+      SetListenerOptions(listener->socket, *socket_options);
+    }
+    std::lock_guard<std::mutex> socket_options_lock(socket_options_mutex_);
+    socket_options_ = std::move(socket_options);
+  }
+
+  // Keeps the connections open after the responses, as HTTP/1.1 clients expect by default, for them to send
+  // more requests over the same connection. Only in the event loop mode on Linux and macOS, see `SetIOThreads()`,
+  // where waiting for the next request does not occupy a thread. A connection is closed once it has been idle
+  // for `idle_timeout`, or once it has served `max_requests_per_connection` requests, as well as after a chunked
+  // response. `SetKeepAlive(std::chrono::milliseconds(0))` reverts to closing it after each response, the default.
+  void SetKeepAlive(std::chrono::milliseconds idle_timeout, size_t max_requests_per_connection = 100u) {
+    std::lock_guard<std::mutex> lock(event_loop_mutex_);
+    keep_alive_idle_timeout_ = idle_timeout;
+    keep_alive_max_requests_ = max_requests_per_connection;
+  }
+
+  // Serves HTTP/2 over the connections that start with its preface, i.e. over the ones of the clients that know
+  // the server speaks it, such as `curl --http2-prior-knowledge`. Also the way to serve HTTP/2 to the browsers, which
+  // only speak it over TLS: have the TLS terminator in front of the server negotiate `h2` via ALPN, and pass
+  // the connections on as they are. The HTTP/1.1 connections are served as before. See `posix_server_http2.h`.
+  // Each HTTP/2 connection is read on a thread of its own, with the requests of its streams served concurrently,
+  // by the same handlers, on a pool of `options.handler_threads` threads shared by all the HTTP/2 connections.
+  // Applies to the connections accepted from now on. Not on Windows.
+  void EnableHTTP2(HTTP2Options options = HTTP2Options()) {
+    // The streams waiting for a thread are not limited by the pool, as they are by `max_concurrent_streams` already.
+    auto worker_pool = std::make_shared<HTTPWorkerPool>(options.handler_threads, std::numeric_limits<size_t>::max());
+    auto http2_options = std::make_shared<const HTTP2Options>(std::move(options));
+    std::lock_guard<std::mutex> lock(http2_mutex_);
+    http2_options_ = std::move(http2_options);
+    std::swap(worker_pool, http2_worker_pool_);
+  }
+
+  // The connections being served over HTTP/2 keep being served, as does the pool of threads of their handlers.
+  void DisableHTTP2() {
+    std::shared_ptr<HTTPWorkerPool> worker_pool;
+    std::lock_guard<std::mutex> lock(http2_mutex_);
+    http2_options_ = nullptr;
+    std::swap(worker_pool, http2_worker_pool_);
   }
 
   // The bare `Join()` method is only used by small scripts to run the server indefinitely,
@@ -254,6 +597,44 @@ class HTTPServerPOSIX final {
     return DoRegisterHandler(path, handler, URLPathArgs::CountMask::None, POLICY);
   }
 
+  // Registers a handler that is called once the headers of the request have been received, before its body,
+  // to read the body with `Request::ReadBody()` as it is being received, and with no limit on its size.
+  // For the uploads too large to keep in memory; `Request::body` is empty for these handlers.
+  template <ReRegisterRoute POLICY = ReRegisterRoute::ThrowOnAttempt>
+  [[nodiscard]]
+  HTTPRoutesScopeEntry RegisterWithStreamedBody(const std::string& path,
+                                                const URLPathArgs::CountMask path_args_count_mask,
+                                                std::function<void(Request)> handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return DoRegisterHandler(path, handler, path_args_count_mask, POLICY, true);
+  }
+  template <ReRegisterRoute POLICY = ReRegisterRoute::ThrowOnAttempt>
+  [[nodiscard]]
+  HTTPRoutesScopeEntry RegisterWithStreamedBody(const std::string& path, std::function<void(Request)> handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return DoRegisterHandler(path, handler, URLPathArgs::CountMask::None, POLICY, true);
+  }
+
+  // Serves `PhaseTimings()` as JSON at `path`, e.g. `scope += http_server.ServePhaseTimings("/.timings");`.
+  [[nodiscard]]
+  HTTPRoutesScopeEntry ServePhaseTimings(const std::string& path) {
+    return Register(path, [this](Request r) { r(PhaseTimings()); });
+  }
+
+  // Serves the process-wide metrics, `current::metrics::ProcessMetrics()`, which include the metrics of every HTTP
+  // server, as JSON at `path`, or, with `?format=prometheus`, in the Prometheus text format.
+  [[nodiscard]]
+  HTTPRoutesScopeEntry ServeMetrics(const std::string& path) {
+    return Register(path, [](Request r) {
+      const current::metrics::MetricsSnapshot snapshot = current::metrics::ProcessMetrics().Snapshot();
+      if (r.url.query["format"] == "prometheus") {
+        r(Response(current::metrics::PrometheusText(snapshot)).ContentType("text/plain; version=0.0.4"));
+      } else {
+        r(snapshot);
+      }
+    });
+  }
+
   void UnRegister(const std::string& path,
                   const URLPathArgs::CountMask path_args_count_mask = URLPathArgs::CountMask::None) {
     std::lock_guard<std::mutex> lock(mutex_);
@@ -270,8 +651,11 @@ class HTTPServerPOSIX final {
           CURRENT_THROW(HandlerDoesNotExistException(path));
         }
         map.erase(it2);
+        streamed_body_handlers_.erase(std::make_pair(path, i));
+        has_streamed_body_handlers_ = !streamed_body_handlers_.empty();
         if (map.empty()) {
           // Maintain the value of `PathHandlersCount()` invariant.
+          routes_.Erase(path);
           handlers_.erase(it1);
         }
       }
@@ -282,74 +666,121 @@ class HTTPServerPOSIX final {
                                        const ServeStaticFilesFromOptions& options = ServeStaticFilesFromOptions()) {
     ValidateRoute(options.route_prefix);
 
-    HTTPRoutesScope scope;
+    // The precompressed `file.gz` and `file.br` are only told apart from the regular files once all the files
+    // are known, so the directory is scanned first, and the files are registered afterwards, in the same order.
+    struct ScannedFile {
+      std::string pathname;
+      std::string basename;
+      std::vector<std::string> path_components;
+    };
+    std::vector<ScannedFile> scanned_files;
+    std::set<std::string> pathnames;
     current::FileSystem::ScanDir(
         dir,
-        [this, &options, &scope](const current::FileSystem::ScanDirItemInfo& item_info) {
-          // Ignore files named with a leading dot (means hidden in POSIX) before checking MIME type.
-          if (item_info.basename.front() == '.') {
-            return;
-          }
-
-          const std::string content_type(current::net::GetFileMimeType(item_info.basename, ""));
-          if (!content_type.empty()) {
-            const bool path_components_empty = item_info.path_components_cref.empty();
-            const std::string path_components_joined = current::strings::Join(item_info.path_components_cref, '/');
+        [&scanned_files, &pathnames](const current::FileSystem::ScanDirItemInfo& item_info) {
+          scanned_files.push_back({item_info.pathname, item_info.basename, item_info.path_components_cref});
+          pathnames.insert(item_info.pathname);
+        },
+        FileSystem::ScanDirParameters::ListFilesOnly,
+        FileSystem::ScanDirRecursive::Yes);
 
-            // `route_for_directory` must have leading slash and must not have trailing slash except if it's a root.
-            const std::string route_for_directory =
-                options.route_prefix + ((options.route_prefix == "/" || path_components_empty) ? "" : "/") +
-                path_components_joined;
-            CURRENT_ASSERT(route_for_directory == "/" ||
-                           (route_for_directory.front() == '/' && route_for_directory.back() != '/'));
+    // The precompressed files to look for next to each file, in the order of preference.
+    const std::vector<std::pair<std::string, std::string>> precompressed_extensions_and_encodings = {{".br", "br"},
+                                                                                                     {".gz", "gzip"}};
+    const auto is_precompressed = [&](const std::string& pathname) {
+      for (const auto& extension_and_encoding : precompressed_extensions_and_encodings) {
+        const std::string& extension = extension_and_encoding.first;
+        if (pathname.length() > extension.length() &&
+            !pathname.compare(pathname.length() - extension.length(), extension.length(), extension) &&
+            pathnames.count(pathname.substr(0u, pathname.length() - extension.length()))) {
+          return true;
+        }
+      }
+      return false;
+    };
 
-            // Ignore files nested in directories named with a leading dot (means hidden in POSIX).
-            if (route_for_directory.find("/.") != std::string::npos) {
-              return;
-            }
+    HTTPRoutesScope scope;
+    for (const ScannedFile& item_info : scanned_files) {
+      // Ignore files named with a leading dot (means hidden in POSIX) before checking MIME type.
+      if (item_info.basename.front() == '.') {
+        continue;
+      }
 
-            // `route_for_file` must have leading slash and must not have trailing slash.
-            const std::string route_for_file =
-                route_for_directory + (route_for_directory == "/" ? "" : "/") + item_info.basename;
-            CURRENT_ASSERT(route_for_file.front() == '/' && route_for_file.back() != '/');
-
-            const bool is_index_file =
-                (std::find(options.index_filenames.begin(), options.index_filenames.end(), item_info.basename) !=
-                 options.index_filenames.end());
-
-            // TODO(dkorolev): Wrap keeping file contents into a singleton
-            // that keeps a map from a (SHA256) hash to the contents.
-            std::string content = current::FileSystem::ReadFileAsString(item_info.pathname);
-
-            // If it's an index file, serve it additionally at the route without the filename (i.e. the directory
-            // route).
-            if (is_index_file) {
-              if (handlers_.find(route_for_directory) != handlers_.end()) {
-                CURRENT_THROW(ServeStaticFilesFromCannotServeMoreThanOneIndexFile(route_for_directory + ' ' +
-                                                                                  item_info.basename));
-              }
+      if (options.serve_precompressed && is_precompressed(item_info.pathname)) {
+        continue;
+      }
 
-              // `trailing_slash_redirect_url` must have trailing slash.
-              std::string trailing_slash_redirect_url = options.public_url_prefix +
-                                                        (options.public_url_prefix.back() == '/' ? "" : "/") +
-                                                        (path_components_empty ? "" : path_components_joined + "/");
-              CURRENT_ASSERT(trailing_slash_redirect_url.length() > 0 && trailing_slash_redirect_url.back() == '/');
+      const std::string content_type(current::net::GetFileMimeType(item_info.basename, ""));
+      if (!content_type.empty()) {
+        const bool path_components_empty = item_info.path_components.empty();
+        const std::string path_components_joined = current::strings::Join(item_info.path_components, '/');
+
+        // `route_for_directory` must have leading slash and must not have trailing slash except if it's a root.
+        const std::string route_for_directory =
+            options.route_prefix + ((options.route_prefix == "/" || path_components_empty) ? "" : "/") +
+            path_components_joined;
+        CURRENT_ASSERT(route_for_directory == "/" ||
+                       (route_for_directory.front() == '/' && route_for_directory.back() != '/'));
+
+        // Ignore files nested in directories named with a leading dot (means hidden in POSIX).
+        if (route_for_directory.find("/.") != std::string::npos) {
+          continue;
+        }
 
-              auto static_file_server =
-                  std::make_unique<StaticFileServer>(content, content_type, true, trailing_slash_redirect_url);
-              scope += Register(route_for_directory, *static_file_server);
-              static_file_servers_.push_back(std::move(static_file_server));
+        // `route_for_file` must have leading slash and must not have trailing slash.
+        const std::string route_for_file =
+            route_for_directory + (route_for_directory == "/" ? "" : "/") + item_info.basename;
+        CURRENT_ASSERT(route_for_file.front() == '/' && route_for_file.back() != '/');
+
+        const bool is_index_file =
+            (std::find(options.index_filenames.begin(), options.index_filenames.end(), item_info.basename) !=
+             options.index_filenames.end());
+
+        // TODO(dkorolev): Wrap keeping file contents into a singleton
+        // that keeps a map from a (SHA256) hash to the contents.
+        const auto representation = [&options](const std::string& pathname, const std::string& content_encoding) {
+          return options.use_sendfile ? StaticFileServer::Representation::FromFile(pathname, content_encoding)
+                                      : StaticFileServer::Representation::FromContent(
+                                            current::FileSystem::ReadFileAsString(pathname), content_encoding);
+        };
+        std::vector<StaticFileServer::Representation> representations = {representation(item_info.pathname, "")};
+        if (options.serve_precompressed) {
+          for (const auto& extension_and_encoding : precompressed_extensions_and_encodings) {
+            const std::string precompressed_pathname = item_info.pathname + extension_and_encoding.first;
+            if (pathnames.count(precompressed_pathname)) {
+              representations.push_back(representation(precompressed_pathname, extension_and_encoding.second));
             }
+          }
+        }
 
-            auto static_file_server = std::make_unique<StaticFileServer>(std::move(content), content_type, false);
-            scope += Register(route_for_file, *static_file_server);
-            static_file_servers_.push_back(std::move(static_file_server));
-          } else {
-            CURRENT_THROW(ServeStaticFilesFromCanNotServeStaticFilesOfUnknownMIMEType(item_info.basename));
+        // If it's an index file, serve it additionally at the route without the filename (i.e. the directory
+        // route).
+        if (is_index_file) {
+          if (handlers_.find(route_for_directory) != handlers_.end()) {
+            CURRENT_THROW(ServeStaticFilesFromCannotServeMoreThanOneIndexFile(route_for_directory + ' ' +
+                                                                              item_info.basename));
           }
-        },
-        FileSystem::ScanDirParameters::ListFilesOnly,
-        FileSystem::ScanDirRecursive::Yes);
+
+          // `trailing_slash_redirect_url` must have trailing slash.
+          std::string trailing_slash_redirect_url = options.public_url_prefix +
+                                                    (options.public_url_prefix.back() == '/' ? "" : "/") +
+                                                    (path_components_empty ? "" : path_components_joined + "/");
+          CURRENT_ASSERT(trailing_slash_redirect_url.length() > 0 && trailing_slash_redirect_url.back() == '/');
+
+          auto static_file_server =
+              std::make_unique<StaticFileServer>(representations, content_type, true, trailing_slash_redirect_url);
+          scope += Register(route_for_directory, *static_file_server);
+          static_file_servers_.push_back(std::move(static_file_server));
+        }
+
+        auto static_file_server =
+            std::make_unique<StaticFileServer>(std::move(representations), content_type, false);
+        scope += Register(route_for_file, *static_file_server);
+        static_file_servers_.push_back(std::move(static_file_server));
+      } else {
+        CURRENT_THROW(ServeStaticFilesFromCanNotServeStaticFilesOfUnknownMIMEType(item_info.basename));
+      }
+    }
     return scope;
   }
 
@@ -366,7 +797,7 @@ class HTTPServerPOSIX final {
   // Note: If the user code handles the request synchronously, the scoped HTTP registerers will do the job.
   // If the user handles the request from another thread, it's the responsibility of the user to make sure
   // the very object ("this") does not get destroyed while the request is being handled.
-  Optional<Borrowed<std::function<void(Request)>>> FindHandler(const std::string& path,
+  Optional<Borrowed<std::function<void(Request)>>> FindHandler(std::string_view path,
                                                                URLPathArgs& output_url_args) const {
     std::lock_guard<std::mutex> lock(mutex_);
 
@@ -381,99 +812,398 @@ class HTTPServerPOSIX final {
     }
     // LCOV_EXCL_STOP
 
-    // Work with the path by trying to match the full one, then the one with the last component removed,
-    // then the one with two last components removed, etc.
-    // As a component is removed, it's removed from `base_path` and is added to `url_args`.
-    std::string& remaining_path = output_url_args.base_path;
-    remaining_path = path;
+    // The deepest path registered along the path requested, with a handler taking as many URL path arguments
+    // as there are path components past it, is the one to serve the request.
+    const auto handlers = routes_.Match(
+        path,
+        [](const handlers_per_path_t& handlers, size_t args_count) { return handlers.count(args_count) > 0u; },
+        output_url_args);
+    if (handlers) {
+      return Borrowed<std::function<void(Request)>>(handlers->at(output_url_args.size()));
+    }
 
-    // Friendly reminder: `remaining_path[0]` is guaranteed to be '/'.
-    while (true) {
-      while (remaining_path.length() > 1 && remaining_path.back() == '/') {
-        remaining_path.resize(remaining_path.length() - 1);
-      }
+    return nullptr;
+  }
 
-      const auto cit = handlers_.find(remaining_path);
-      if (cit != handlers_.end()) {
-        const auto cit2 = cit->second.find(output_url_args.size());
-        if (cit2 != cit->second.end()) {
-          return Borrowed<std::function<void(Request)>>(cit2->second);
+  // Whether the request for `raw_path` is to be handled by a handler registered with `RegisterWithStreamedBody()`.
+  bool StreamsRequestBody(const std::string& raw_path) const {
+    URLPathArgs url_path_args;
+    if (!Exists(FindHandler(current::url::URLView(raw_path).path, url_path_args))) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    return streamed_body_handlers_.count(std::make_pair(url_path_args.base_path, url_path_args.size())) > 0u;
+  }
+
+  void Thread(current::net::Socket socket) {
+    current::bricks::system::ThreadPlacementPolicy().PlaceCurrentThread(
+        current::bricks::system::ThreadRole::HTTPServer);
+    {
+      std::lock_guard<std::mutex> lock(listeners_mutex_);
+      primary_listener_ = &socket;
+    }
+    listeners_condition_variable_.notify_all();
+    const std::atomic_bool never_stopping(false);
+    AcceptConnections(socket, never_stopping);
+    std::lock_guard<std::mutex> lock(listeners_mutex_);
+    primary_listener_ = nullptr;
+  }
+
+  void AcceptConnections(current::net::Socket& socket, const std::atomic_bool& stopping) {
+    // TODO(dkorolev): Benchmark QPS.
+    while (!terminating_ && !stopping) {
+      try {
+        current::net::Connection connection = socket.Accept();
+        if (const auto socket_options = SocketOptions()) {
+          connection.SetConnectionOptions(*socket_options);
+        }
+        if (!terminating_ && PassToEventLoop(connection)) {
+          continue;
+        }
+        if (!ServeConnection(std::move(connection))) {
+          break;
+        }
+      } catch (const current::Exception& e) {  // LCOV_EXCL_LINE
+        if (!stopping) {
+          std::cerr << "HTTP accept failed: " << e.what() << '\n';  // LCOV_EXCL_LINE
         }
       }
+    }
+  }
+
+  std::shared_ptr<const current::net::SocketOptions> SocketOptions() const {
+    std::lock_guard<std::mutex> lock(socket_options_mutex_);
+    return socket_options_;
+  }
 
-      if (remaining_path == "/") {
-        break;
+  static void SetListenerOptions(current::net::Socket& socket, const current::net::SocketOptions& options) {
+    socket.SetListeningOptions(options);
+    socket.SetConnectionOptions(options);
+  }
+
+  // The socket bound to the port with `SO_REUSEPORT` in addition to the primary one, see `SetListeners()`.
+  struct AdditionalListener final {
+    current::net::Socket socket;
+    std::atomic_bool stopping;
+    std::thread thread;
+    explicit AdditionalListener(current::net::Socket&& socket) : socket(std::move(socket)), stopping(false) {}
+  };
+
+  // Stops and closes the additional listeners past the first `keep` ones, once they are done serving.
+  void StopAdditionalListeners(size_t keep) {
+    std::vector<std::unique_ptr<AdditionalListener>> stopped;
+    {
+      std::lock_guard<std::mutex> lock(listeners_mutex_);
+      while (additional_listeners_.size() > keep) {
+        stopped.push_back(std::move(additional_listeners_.back()));
+        additional_listeners_.pop_back();
       }
+    }
+    for (auto& listener : stopped) {
+      listener->stopping = true;
+      listener->socket.StopAccepting();
+    }
+    for (auto& listener : stopped) {
+      listener->thread.join();
+    }
+  }
 
-      const size_t arg_begin_index = remaining_path.rfind('/') + 1;
-      output_url_args.add(URL::DecodeURIComponent(remaining_path.substr(arg_begin_index)));
-      remaining_path.resize(arg_begin_index);
+#if defined(CURRENT_POSIX) && !defined(CURRENT_APPLE)
+  static void PinToCPU(std::thread& thread, bool pin, size_t cpu, size_t cpus) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (size_t i = 0u; i < cpus; ++i) {
+      if (!pin || i == cpu) {
+        CPU_SET(i, &cpu_set);
+      }
+    }
+    ::pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set), &cpu_set);
+  }
+#endif
+
+  // Returns whether the connection has been passed to the event loop, i.e. if there is one.
+  bool PassToEventLoop(current::net::Connection& connection) {
+    std::lock_guard<std::mutex> lock(event_loop_mutex_);
+    if (event_loop_) {
+      event_loop_->Add(std::move(connection));
+      return true;
+    } else {
+      return false;
     }
+  }
 
-    return nullptr;
+  // The connection kept open after the request served on this thread, if the next request has been received
+  // along with it, i.e. pipelined, and the handler has responded before returning.
+  struct PipelinedRequest final {
+    std::mutex mutex;
+    bool serving = true;
+    std::unique_ptr<current::net::Connection> connection;
+  };
+
+  // Has the connection the request of which is being served wait for the next request in the event loop,
+  // once the response has been sent, unless it has served enough requests already. The next request is served
+  // right away on the same thread instead if it has been received already, and this one has been served.
+  // Not for the requests of the HTTP/2 streams, which come with no `pipelined`.
+  void KeepAliveIfEnabled(current::net::HTTPServerConnection& connection,
+                          size_t requests_served,
+                          std::shared_ptr<PipelinedRequest> pipelined) {
+    std::lock_guard<std::mutex> lock(event_loop_mutex_);
+    if (pipelined && event_loop_ && event_loop_->SupportsKeepAlive() && keep_alive_idle_timeout_.count() > 0 &&
+        requests_served + 1u < keep_alive_max_requests_) {
+      connection.KeepAlive(
+          [this, requests_served, pipelined](current::net::Connection&& c, std::string&& read_ahead) {
+            if (impl::IsPrefetchedHTTPRequestComplete(read_ahead)) {
+              std::lock_guard<std::mutex> lock(pipelined->mutex);
+              if (pipelined->serving) {
+                pipelined->connection = std::make_unique<current::net::Connection>(std::move(c));
+                pipelined->connection->SetPrefetchedData(std::move(read_ahead));
+                return;
+              }
+            }
+            std::lock_guard<std::mutex> lock(event_loop_mutex_);
+            if (event_loop_ && !terminating_) {
+              event_loop_->Reuse(
+                  std::move(c), std::move(read_ahead), requests_served + 1u, keep_alive_idle_timeout_);
+            }
+          });
+    }
   }
 
-  void Thread(current::net::Socket socket) {
-    // TODO(dkorolev): Benchmark QPS.
-    while (!terminating_) {
-      try {
-        auto connection = std::make_unique<current::net::HTTPServerConnection>(socket.Accept());
-        if (terminating_) {
-          // Already terminating. Will not send the response, and this
-          // lack of response should not result in an exception.
-          connection->DoNotSendAnyResponse();
-          break;
-        }
-        URLPathArgs url_path_args;
-        const auto handler = FindHandler(connection->HTTPRequest().URL().path, url_path_args);
-        if (Exists(handler)) {
-          // OK, here's the tricky part with error handling and exceptions in this multithreaded world.
-          // * On the one hand, the connection should be std::move-d into the request,
-          //   since it might end up being served in another thread, via a message queue, etc.
-          //   Thus, the user code is responsible for closing the connection.
-          //   Not to mention that the std::move-d away connection can easily outlive this scope.
-          // * On the other hand, if an exception occurs in user code, we need to return a 500,
-          //   which should obviously happen before the connection object is destructed.
-          //   This seems like a good reason to not std::move it away, or move it away with some flag,
-          //   but I thought hard of it, and don't think it's a good choice -- D.K.
-          //
-          // Solution: Do nothing here. No matter how tempting it is, it won't work across threads. Period.
-          //
-          // The implementation of HTTP connection will return an "INTERNAL SERVER ERROR"
-          // if no response was sent. That's what the user gets. In debugger, they can put a breakpoint there
-          // and see what caused the error.
-          //
-          // It is the job of the user of this library to ensure no exceptions leave their code.
-          // In practice, a top-level try-catch for `const current::Exception& e` is good enough.
-          try {
-            (*Value(handler))(Request(std::move(connection), url_path_args));
-          } catch (const current::Exception& e) {  // LCOV_EXCL_LINE
-            // WARNING: This `catch` is really not sufficient, it just logs a message
-            // if a user exception occurred in the same thread that ran the handler.
-            // DO NOT COUNT ON IT.
-            std::cerr << "HTTP route failed in user code: " << e.what() << '\n';  // LCOV_EXCL_LINE
+  // Serves the request, and then the pipelined ones following it, if any; see `PipelinedRequest`.
+  // Returns `false` if the server is terminating, and the request was not served.
+  bool ServeConnection(current::net::Connection&& c, size_t requests_served = 0u) {
+#ifndef CURRENT_WINDOWS
+    if (!requests_served) {
+      std::shared_ptr<const HTTP2Options> http2_options;
+      std::shared_ptr<HTTPWorkerPool> http2_worker_pool;
+      {
+        std::lock_guard<std::mutex> lock(http2_mutex_);
+        http2_options = http2_options_;
+        http2_worker_pool = http2_worker_pool_;
+      }
+      if (http2_options && StartsWithHTTP2Preface(c)) {
+        StartHTTP2Session(std::move(c), *http2_options, std::move(http2_worker_pool));
+        return true;
+      }
+    }
+#endif  // CURRENT_WINDOWS
+    auto pipelined = std::make_shared<PipelinedRequest>();
+    if (!ServeRequest(std::move(c), requests_served, pipelined)) {
+      return false;
+    }
+    while (true) {
+      std::unique_ptr<current::net::Connection> next;
+      {
+        std::lock_guard<std::mutex> lock(pipelined->mutex);
+        pipelined->serving = false;
+        next = std::move(pipelined->connection);
+      }
+      if (!next) {
+        return true;
+      }
+      pipelined = std::make_shared<PipelinedRequest>();
+      if (!ServeRequest(std::move(*next), ++requests_served, pipelined)) {
+        return false;
+      }
+    }
+  }
+
+  // Reads the request, and serves it. Returns `false` if the server is terminating, and the request was not served.
+  bool ServeRequest(current::net::Connection&& c,
+                    size_t requests_served,
+                    const std::shared_ptr<PipelinedRequest>& pipelined) {
+    try {
+      current::net::HTTPDefaultHelper::ConstructionParams params;
+      if (has_streamed_body_handlers_) {
+        params.stream_body = [this](const std::string& raw_path) { return StreamsRequestBody(raw_path); };
+      }
+      auto connection = std::make_unique<current::net::HTTPServerConnection>(std::move(c), params);
+      if (terminating_) {
+        // Already terminating. Will not send the response, and this
+        // lack of response should not result in an exception.
+        connection->DoNotSendAnyResponse();
+        return false;
+      }
+      KeepAliveIfEnabled(*connection, requests_served, pipelined);
+      RouteRequest(std::move(connection));
+    } catch (const current::net::ChunkSizeNotAValidHEXValue&) {
+      // The `ChunkSizeNotAValidHEXValue` situation, if emerged, is already handled with a "400 BAD REQUEST" response.
+    } catch (const current::net::HTTPPayloadTooLarge&) {
+      // The `HTTPPayloadTooLarge` situation, if emerged, is already handled with a "413 ENTITY TOO LARGE" response.
+    } catch (const current::net::HTTPRequestBodyLengthNotProvided&) {
+      // The `HTTPRequestBodyLengthNotProvided` situation, if emerged, is already handled with "411 LENGTH REQUIRED".
+    } catch (const current::net::EmptySocketException&) {  // LCOV_EXCL_LINE
+      // Silently discard errors if no data was sent in.
+    } catch (const current::Exception& e) {  // LCOV_EXCL_LINE
+      // TODO(dkorolev): More reliable logging.
+      std::cerr << "HTTP route failed: " << e.what() << '\n';  // LCOV_EXCL_LINE
+    }
+    return true;
+  }
+
+  // Hands the request received over to its handler, or responds with 404. The request is either received
+  // as HTTP/1.1, see `ServeRequest()`, or as a stream of HTTP/2, see `ServeHTTP2Request()`.
+  void RouteRequest(std::unique_ptr<current::net::HTTPServerConnection>&& connection) {
+    {
+      std::lock_guard<std::mutex> lock(compression_mutex_);
+      if (compression_) {
+        connection->CompressResponses(compression_);
+      }
+    }
+    {
+      URLPathArgs url_path_args;
+      const auto handler = FindHandler(connection->HTTPRequest().URLView().path, url_path_args);
+      if (Exists(handler)) {
+        // OK, here's the tricky part with error handling and exceptions in this multithreaded world.
+        // * On the one hand, the connection should be std::move-d into the request,
+        //   since it might end up being served in another thread, via a message queue, etc.
+        //   Thus, the user code is responsible for closing the connection.
+        //   Not to mention that the std::move-d away connection can easily outlive this scope.
+        // * On the other hand, if an exception occurs in user code, we need to return a 500,
+        //   which should obviously happen before the connection object is destructed.
+        //   This seems like a good reason to not std::move it away, or move it away with some flag,
+        //   but I thought hard of it, and don't think it's a good choice -- D.K.
+        //
+        // Solution: Do nothing here. No matter how tempting it is, it won't work across threads. Period.
+        //
+        // The implementation of HTTP connection will return an "INTERNAL SERVER ERROR"
+        // if no response was sent. That's what the user gets. In debugger, they can put a breakpoint there
+        // and see what caused the error.
+        //
+        // It is the job of the user of this library to ensure no exceptions leave their code.
+        // In practice, a top-level try-catch for `const current::Exception& e` is good enough.
+        try {
+          std::shared_ptr<HTTPAdmissionControl> admission_control;
+          std::shared_ptr<HTTPWorkerPool> worker_pool;
+          {
+            std::lock_guard<std::mutex> lock(admission_control_mutex_);
+            admission_control = admission_control_;
+          }
+          {
+            std::lock_guard<std::mutex> lock(worker_pool_mutex_);
+            worker_pool = worker_pool_;
+          }
+          Request request(std::move(connection), url_path_args);
+          const auto phases = phase_timings_->StartRecording(url_path_args.base_path);
+          request.connection.TimePhases(phases);
+          if (admission_control) {
+            request.admission_ticket = admission_control->Admit(url_path_args.base_path);
+            if (!request.admission_ticket) {
+              RespondServiceUnavailable(std::move(request), admission_control->RetryAfter());
+              return;
+            }
           }
-        } else {
-          connection->SendHTTPResponse(current::net::DefaultNotFoundMessage(),
-                                       HTTPResponseCode.NotFound,
-                                       current::net::http::Headers(),
-                                       current::net::constants::kDefaultHTMLContentType);
+          if (worker_pool) {
+            worker_pool->Dispatch(
+                [phases, handle = *Value(handler)](Request r) {
+                  phases->handler_started = std::chrono::steady_clock::now();
+                  handle(std::move(r));
+                  phases->handler_finished = std::chrono::steady_clock::now();
+                },
+                std::move(request));
+          } else {
+            phases->handler_started = std::chrono::steady_clock::now();
+            (*Value(handler))(std::move(request));
+            phases->handler_finished = std::chrono::steady_clock::now();
+          }
+        } catch (const current::Exception& e) {  // LCOV_EXCL_LINE
+          // WARNING: This `catch` is really not sufficient, it just logs a message
+          // if a user exception occurred in the same thread that ran the handler.
+          // DO NOT COUNT ON IT.
+          std::cerr << "HTTP route failed in user code: " << e.what() << '\n';  // LCOV_EXCL_LINE
         }
-      } catch (const current::net::ChunkSizeNotAValidHEXValue&) {
-        // The `ChunkSizeNotAValidHEXValue` situation, if emerged, is already handled with a "400 BAD REQUEST" response.
-      } catch (const current::net::HTTPPayloadTooLarge&) {
-        // The `HTTPPayloadTooLarge` situation, if emerged, is already handled with a "413 ENTITY TOO LARGE" response.
-      } catch (const current::net::HTTPRequestBodyLengthNotProvided&) {
-        // The `HTTPRequestBodyLengthNotProvided` situation, if emerged, is already handled with "411 LENGTH REQUIRED".
-      } catch (const current::net::EmptySocketException&) {  // LCOV_EXCL_LINE
-        // Silently discard errors if no data was sent in.
-      } catch (const current::Exception& e) {  // LCOV_EXCL_LINE
-        // TODO(dkorolev): More reliable logging.
-        std::cerr << "HTTP route failed: " << e.what() << '\n';  // LCOV_EXCL_LINE
+      } else {
+        connection->SendHTTPResponse(current::net::DefaultNotFoundMessage(),
+                                     HTTPResponseCode.NotFound,
+                                     current::net::http::Headers(),
+                                     current::net::constants::kDefaultHTMLContentType);
       }
     }
   }
 
+#ifndef CURRENT_WINDOWS
+  // Whether the client has started with the preface of HTTP/2. Waits for the first bytes of the request, which
+  // the HTTP/1.1 parser would wait for anyway. The event loop has them read already, as the preface parses as
+  // an HTTP/1.1 request with no body.
+  static bool StartsWithHTTP2Preface(current::net::Connection& c) {
+    const std::string_view preface_start(current::net::http2::kConnectionPreface, 4u);  // "PRI ".
+    std::string prefetched = c.TakePrefetchedData();
+    bool result;
+    if (!prefetched.empty()) {
+      result = (std::string_view(prefetched).substr(0u, preface_start.length()) == preface_start);
+    } else {
+      char buffer[4];
+      result = (::recv(c.socket, buffer, sizeof(buffer), MSG_PEEK | MSG_WAITALL) == sizeof(buffer) &&
+                std::string_view(buffer, sizeof(buffer)) == preface_start);
+    }
+    c.SetPrefetchedData(std::move(prefetched));
+    return result;
+  }
+
+  void StartHTTP2Session(current::net::Connection&& c,
+                         const HTTP2Options& options,
+                         std::shared_ptr<HTTPWorkerPool> worker_pool) {
+    auto session = std::make_unique<impl::HTTP2Session>(
+        std::move(c),
+        options,
+        [this, worker_pool](std::unique_ptr<current::net::HTTPServerConnection>&& connection) {
+          // The pool runs the `Request`, which is then taken apart, as the handler to serve it is yet to be found.
+          worker_pool->Dispatch([this](Request r) { ServeHTTP2Request(std::move(r.unique_connection)); },
+                                Request(std::move(connection)));
+        });
+    std::lock_guard<std::mutex> lock(http2_mutex_);
+    // Join the threads of the sessions done with first, for the threads not to pile up.
+    for (auto it = http2_sessions_.begin(); it != http2_sessions_.end();) {
+      if (it->first->Done()) {
+        it->second.join();
+        it = http2_sessions_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    if (terminating_) {
+      return;
+    }
+    impl::HTTP2Session& s = *session;
+    std::thread thread([&s]() {
+      current::bricks::system::ThreadPlacementPolicy().PlaceCurrentThread(
+          current::bricks::system::ThreadRole::HTTPServer);
+      s.Run();
+    });
+    http2_sessions_.emplace_back(std::move(session), std::move(thread));
+  }
+
+  // Serves the request of a stream of HTTP/2, on a thread of the pool of `EnableHTTP2()`.
+  void ServeHTTP2Request(std::unique_ptr<current::net::HTTPServerConnection>&& connection) {
+    try {
+      if (terminating_) {
+        // The stream is reset once the connection is gone.
+        connection->DoNotSendAnyResponse();
+        return;
+      }
+      RouteRequest(std::move(connection));
+    } catch (const current::Exception& e) {  // LCOV_EXCL_LINE
+      std::cerr << "HTTP route failed: " << e.what() << '\n';  // LCOV_EXCL_LINE
+    }
+  }
+#endif  // CURRENT_WINDOWS
+
+  void StopHTTP2Sessions() {
+#ifndef CURRENT_WINDOWS
+    std::vector<std::pair<std::unique_ptr<impl::HTTP2Session>, std::thread>> sessions;
+    {
+      std::lock_guard<std::mutex> lock(http2_mutex_);
+      std::swap(sessions, http2_sessions_);
+    }
+    for (auto& session : sessions) {
+      session.first->Stop();
+    }
+    for (auto& session : sessions) {
+      session.second.join();
+    }
+#endif  // CURRENT_WINDOWS
+  }
+
   void ValidateRoute(const std::string& path) {
     if (path.empty() || path[0] != '/') {
       CURRENT_THROW(PathDoesNotStartWithSlash("HTTP URL path does not start with a slash: `" + path + "`."));
@@ -489,7 +1219,8 @@ class HTTPServerPOSIX final {
   HTTPRoutesScopeEntry DoRegisterHandler(const std::string& path,
                                          std::function<void(Request)> handler,
                                          const URLPathArgs::CountMask path_args_count_mask,
-                                         const ReRegisterRoute policy) {
+                                         const ReRegisterRoute policy,
+                                         bool streamed_body = false) {
     // LCOV_EXCL_START
     if (static_cast<uint16_t>(path_args_count_mask) == 0) {
       return HTTPRoutesScopeEntry();
@@ -523,12 +1254,19 @@ class HTTPServerPOSIX final {
     {
       // Step 2: Update.
       auto& handlers_per_path = handlers_[path];
+      routes_.Insert(path, &handlers_per_path);
       URLPathArgs::CountMask mask = URLPathArgs::CountMask::None;  // `None` == 1 == (1 << 0).
       for (size_t i = 0; i <= URLPathArgs::MaxArgsCount; ++i, mask = mask << 1) {
         if ((path_args_count_mask & mask) == mask) {
           handlers_per_path[i] = MakeOwned<std::function<void(Request)>>(handler);
+          if (streamed_body) {
+            streamed_body_handlers_.insert(std::make_pair(path, i));
+          } else {
+            streamed_body_handlers_.erase(std::make_pair(path, i));
+          }
         }
       }
+      has_streamed_body_handlers_ = !streamed_body_handlers_.empty();
     }
 
     if (policy == ReRegisterRoute::SilentlyUpdateExisting) {
@@ -540,15 +1278,99 @@ class HTTPServerPOSIX final {
 
   HTTPServerPOSIX() = delete;
 
+  // Publishes the phase timings per route, and the metrics of the worker pool and of the admission control,
+  // if any, into the process-wide metrics registry, labeled by the port.
+  current::metrics::CollectorScope PublishMetrics() {
+    return current::metrics::ProcessMetrics().AddCollector([this](current::metrics::MetricsSnapshot& snapshot) {
+      using namespace current::metrics;
+      const std::string port = std::to_string(port_);
+      const std::vector<std::pair<std::string, const HTTPPhaseHistogram HTTPRoutePhaseTimings::*>> phases = {
+          {"first_byte", &HTTPRoutePhaseTimings::first_byte},
+          {"headers", &HTTPRoutePhaseTimings::headers},
+          {"body", &HTTPRoutePhaseTimings::body},
+          {"queue", &HTTPRoutePhaseTimings::queue},
+          {"handler", &HTTPRoutePhaseTimings::handler},
+          {"response", &HTTPRoutePhaseTimings::response},
+          {"total", &HTTPRoutePhaseTimings::total}};
+      for (const auto& route : PhaseTimings().routes) {
+        for (const auto& phase : phases) {
+          const HTTPPhaseHistogram& histogram = route.second.*(phase.second);
+          AddPowersOfTwoMicrosecondsHistogram(snapshot,
+                                              "http_phase_us",
+                                              {{"port", port}, {"route", route.first}, {"phase", phase.first}},
+                                              histogram.buckets,
+                                              histogram.total,
+                                              "The time the HTTP requests have spent in each phase, per route.");
+        }
+      }
+      {
+        std::lock_guard<std::mutex> lock(worker_pool_mutex_);
+        if (worker_pool_) {
+          const HTTPWorkerPoolMetrics metrics = worker_pool_->Metrics();
+          const labels_t labels = {{"port", port}};
+          AddGauge(snapshot, "http_worker_pool_threads", labels, metrics.threads, "The worker threads.");
+          AddGauge(snapshot, "http_worker_pool_queued", labels, metrics.queued, "The requests waiting for a worker.");
+          AddGauge(snapshot, "http_worker_pool_running", labels, metrics.running, "The requests being handled.");
+          AddCounter(snapshot, "http_worker_pool_served_total", labels, metrics.served, "The requests handled.");
+          AddCounter(
+              snapshot, "http_worker_pool_rejected_total", labels, metrics.rejected, "The requests rejected, 503.");
+          AddCounter(snapshot, "http_worker_pool_shed_total", labels, metrics.shed, "The requests shed as stale.");
+        }
+      }
+      {
+        std::lock_guard<std::mutex> lock(admission_control_mutex_);
+        if (admission_control_) {
+          const HTTPAdmissionMetrics metrics = admission_control_->Metrics();
+          const labels_t labels = {{"port", port}};
+          AddGauge(snapshot, "http_admission_in_flight", labels, metrics.in_flight, "The requests admitted now.");
+          AddCounter(snapshot, "http_admission_admitted_total", labels, metrics.admitted, "The requests admitted.");
+          AddCounter(snapshot, "http_admission_rejected_total", labels, metrics.rejected, "The requests rejected.");
+        }
+      }
+    });
+  }
+
   std::atomic_bool terminating_;
   const uint16_t port_;
+  // Declared before `thread_`, as the thread passes the accepted connections to the event loop, if any.
+  mutable std::mutex event_loop_mutex_;
+  std::unique_ptr<impl::HTTPServerEventLoop> event_loop_;
+  std::chrono::milliseconds keep_alive_idle_timeout_ = std::chrono::milliseconds(0);
+  size_t keep_alive_max_requests_ = 0u;
+  mutable std::mutex worker_pool_mutex_;
+  std::shared_ptr<HTTPWorkerPool> worker_pool_;
+  mutable std::mutex admission_control_mutex_;
+  std::shared_ptr<HTTPAdmissionControl> admission_control_;
+  const std::shared_ptr<HTTPPhaseTimings> phase_timings_ = std::make_shared<HTTPPhaseTimings>();
+  std::mutex compression_mutex_;
+  std::shared_ptr<const current::net::HTTPCompressionOptions> compression_;
+  mutable std::mutex socket_options_mutex_;
+  std::shared_ptr<const current::net::SocketOptions> socket_options_;
+  std::mutex http2_mutex_;
+  std::shared_ptr<const HTTP2Options> http2_options_;
+  std::shared_ptr<HTTPWorkerPool> http2_worker_pool_;  // Runs the handlers of the streams, see `EnableHTTP2()`.
+#ifndef CURRENT_WINDOWS
+  // The HTTP/2 connections being served, and the threads serving them.
+  std::vector<std::pair<std::unique_ptr<impl::HTTP2Session>, std::thread>> http2_sessions_;
+#endif  // CURRENT_WINDOWS
+  mutable std::mutex listeners_mutex_;
+  std::condition_variable listeners_condition_variable_;
+  current::net::Socket* primary_listener_ = nullptr;  // Owned by `thread_`, set while it is accepting connections.
+  std::vector<std::unique_ptr<AdditionalListener>> additional_listeners_;
   std::thread thread_;
 
   // TODO(dkorolev): Look into read-write mutexes here.
   mutable std::mutex mutex_;
 
-  std::map<std::string, std::map<size_t, Owned<std::function<void(Request)>>>> handlers_;
+  using handlers_per_path_t = std::map<size_t, Owned<std::function<void(Request)>>>;
+  std::map<std::string, handlers_per_path_t> handlers_;
+  impl::HTTPRoutesTrie<handlers_per_path_t> routes_;
+  // The path and the number of URL path arguments of the handlers registered with `RegisterWithStreamedBody()`.
+  std::set<std::pair<std::string, size_t>> streamed_body_handlers_;
+  std::atomic_bool has_streamed_body_handlers_{false};
   std::vector<std::unique_ptr<StaticFileServer>> static_file_servers_;
+  // Declared last, to stop publishing the metrics before anything they are collected from is destroyed.
+  const current::metrics::CollectorScope metrics_collector_ = PublishMetrics();
 };
 
 }  // namespace http
@@ -0,0 +1,352 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// The event loop of `HTTPServerPOSIX`, which reads the requests of many connections at once, without blocking,
+// and serves each of them on one of its threads once it has been received in full. With it, a client that is slow
+// to send its request does not hold back the requests of the other clients; see `HTTPServerPOSIX::SetIOThreads()`.
+// The connections kept open after the responses wait for their next requests in the same way, with no thread
+// occupied by an idle connection; see `HTTPServerPOSIX::SetKeepAlive()`.
+//
+// The readiness of the connections is waited upon via `epoll` on Linux and via `kqueue` on macOS. Elsewhere,
+// the requests are read in a blocking way, and the event loop only adds the threads to serve them on.
+
+#ifndef BLOCKS_HTTP_IMPL_POSIX_SERVER_EVENT_LOOP_H
+#define BLOCKS_HTTP_IMPL_POSIX_SERVER_EVENT_LOOP_H
+
+#include "../../../port.h"
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../../../bricks/net/exceptions.h"
+#include "../../../bricks/net/http/http.h"
+#include "../../../bricks/net/tcp/poller.h"
+#include "../../../bricks/system/placement.h"
+
+#if defined(CURRENT_SOCKET_POLLER_EPOLL)
+#define CURRENT_HTTP_SERVER_EVENT_LOOP_EPOLL
+#elif defined(CURRENT_SOCKET_POLLER_KQUEUE)
+#define CURRENT_HTTP_SERVER_EVENT_LOOP_KQUEUE
+#endif
+
+namespace current {
+namespace http {
+
+namespace impl {
+
+// Whether the request read so far can be parsed without waiting for more data: the headers have been received,
+// and so has the body of `Content-Length` bytes. The chunked bodies, as well as the requests larger than the server
+// accepts, are left to the parser to read further, or to reject.
+inline bool IsPrefetchedHTTPRequestComplete(const std::string& data) {
+  const std::string crlf = current::net::constants::kCRLF;
+  // Skip the blank lines before the first one, as the parser does.
+  size_t begin = 0u;
+  while (data.compare(begin, crlf.length(), crlf) == 0) {
+    begin += crlf.length();
+  }
+  const size_t headers_end = data.find(crlf + crlf, begin);
+  if (headers_end == std::string::npos) {
+    return data.length() > net::constants::kMaxHTTPPayloadSizeInBytes;
+  }
+  const size_t body_begin = headers_end + 2u * crlf.length();
+
+  size_t content_length = 0u;
+  for (size_t line_begin = data.find(crlf, begin) + crlf.length(); line_begin < body_begin;) {
+    const size_t line_end = data.find(crlf, line_begin);
+    const size_t colon = data.find(net::constants::kHeaderKeyValueSeparator, line_begin);
+    if (colon < line_end) {
+      std::string key = data.substr(line_begin, colon - line_begin);
+      for (char& c : key) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+      }
+      if (key == "content-length") {
+        content_length = static_cast<size_t>(std::strtoull(data.c_str() + colon + 1u, nullptr, 10));
+      } else if (key == "transfer-encoding") {
+        return true;
+      }
+    }
+    line_begin = line_end + crlf.length();
+  }
+
+  return content_length > net::constants::kMaxHTTPPayloadSizeInBytes || data.length() - body_begin >= content_length;
+}
+
+class HTTPServerEventLoop final {
+ public:
+  // Called on the threads of the event loop, with the connections the request of which has been received, and with
+  // the number of requests served on this connection before, as it may be kept open for more, see `Reuse()`.
+  using serve_t = std::function<void(current::net::Connection&&, size_t requests_served)>;
+
+  HTTPServerEventLoop(size_t threads, std::chrono::milliseconds request_timeout, serve_t serve)
+      : request_timeout_(request_timeout), serve_(std::move(serve)) {
+    const size_t threads_count = threads ? threads : 1u;
+    threads_.reserve(threads_count);
+    for (size_t i = 0u; i < threads_count; ++i) {
+      threads_.emplace_back(&HTTPServerEventLoop::Thread, this);
+    }
+  }
+
+  // The connections the request of which has not been received in full yet are dropped.
+  ~HTTPServerEventLoop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      terminating_ = true;
+    }
+    wait_condition_variable_.notify_all();
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  size_t ThreadsCount() const { return threads_.size(); }
+
+  // Whether the idle connections can be waited upon without occupying a thread each, to keep them open.
+  static constexpr bool SupportsKeepAlive() {
+#if defined(CURRENT_HTTP_SERVER_EVENT_LOOP_EPOLL) || defined(CURRENT_HTTP_SERVER_EVENT_LOOP_KQUEUE)
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  void Add(current::net::Connection&& connection) {
+    auto pending = std::make_unique<PendingConnection>(std::move(connection));
+    pending->deadline = std::chrono::steady_clock::now() + request_timeout_;
+    Wait(std::move(pending));
+  }
+
+  // Waits for the next request on the connection kept open after `requests_served` requests, for up to
+  // `idle_timeout` until it begins. The next request may have been received, in part or in full, already.
+  void Reuse(current::net::Connection&& connection,
+             std::string&& read_ahead,
+             size_t requests_served,
+             std::chrono::milliseconds idle_timeout) {
+    auto pending = std::make_unique<PendingConnection>(std::move(connection));
+    pending->data = std::move(read_ahead);
+    pending->requests_served = requests_served;
+    pending->idle = pending->data.empty();
+    pending->deadline = std::chrono::steady_clock::now() + (pending->idle ? idle_timeout : request_timeout_);
+    Wait(std::move(pending));
+  }
+
+ private:
+  HTTPServerEventLoop(const HTTPServerEventLoop&) = delete;
+  HTTPServerEventLoop& operator=(const HTTPServerEventLoop&) = delete;
+
+  struct PendingConnection final {
+    current::net::Connection connection;
+    std::string data;
+    size_t requests_served = 0u;
+    // Kept open after a request, and not a single byte of the next one has been received yet.
+    bool idle = false;
+    std::chrono::steady_clock::time_point deadline;
+    explicit PendingConnection(current::net::Connection&& connection) : connection(std::move(connection)) {}
+  };
+
+  // How often do the threads check for termination, and for the connections that are too slow.
+  constexpr static int kPollIntervalMS = 50;
+  constexpr static size_t kReadChunkSize = 16 * 1024;
+
+  void Wait(std::unique_ptr<PendingConnection> pending) {
+#if defined(CURRENT_HTTP_SERVER_EVENT_LOOP_EPOLL) || defined(CURRENT_HTTP_SERVER_EVENT_LOOP_KQUEUE)
+    const int fd = static_cast<int>(pending->connection.socket);
+    if (IsPrefetchedHTTPRequestComplete(pending->data)) {
+      // Pipelined: the next request has been received along with the previous one, no need to wait for it.
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready_.push_back(std::move(pending));
+      }
+      WakeUp();
+    } else {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_[fd] = std::move(pending);
+      }
+      WaitForData(fd, true);
+    }
+#else
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ready_.push_back(std::move(pending));
+    }
+    wait_condition_variable_.notify_one();
+#endif
+  }
+
+#if defined(CURRENT_HTTP_SERVER_EVENT_LOOP_EPOLL) || defined(CURRENT_HTTP_SERVER_EVENT_LOOP_KQUEUE)
+  // Has a thread waiting on the poller serve the ready connections right away, not after the poll interval.
+  void WakeUp() { poller_.WakeUp(); }
+
+  // Asks for the one next notification of `fd` having data to read, for one thread to be notified of it.
+  void WaitForData(int fd, bool first_time) { poller_.WaitUntilReadable(fd, first_time); }
+
+  // The connection may outlive the serving of the request, as the handler may move it into another thread.
+  void StopWaitingForData(int fd) { poller_.StopWaiting(fd); }
+
+  void Thread() {
+    current::bricks::system::ThreadPlacementPolicy().PlaceCurrentThread(
+        current::bricks::system::ThreadRole::HTTPServer);
+    while (!terminating_) {
+      poller_.Poll(std::chrono::milliseconds(kPollIntervalMS), [this](int fd) {
+        if (!terminating_) {
+          OnDataAvailable(fd);
+        }
+      });
+      ServeReadyConnections();
+      DropTimedOutConnections();
+    }
+  }
+
+  void ServeReadyConnections() {
+    while (!terminating_) {
+      std::unique_ptr<PendingConnection> ready;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ready_.empty()) {
+          return;
+        }
+        ready = std::move(ready_.front());
+        ready_.pop_front();
+      }
+      Serve(*ready);
+    }
+  }
+
+  void OnDataAvailable(int fd) {
+    // Take the connection out while reading from it, for it not to be dropped as timed out meanwhile.
+    std::unique_ptr<PendingConnection> pending;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const auto it = pending_.find(fd);
+      if (it == pending_.end()) {
+        return;
+      }
+      pending = std::move(it->second);
+      pending_.erase(it);
+    }
+    try {
+      char buffer[kReadChunkSize];
+      size_t read_count;
+      while ((read_count = pending->connection.NonBlockingRead(buffer, sizeof(buffer)))) {
+        pending->data.append(buffer, read_count);
+      }
+    } catch (const current::net::SocketException&) {
+      // The client has gone away before sending its request in full.
+      return;
+    }
+    if (IsPrefetchedHTTPRequestComplete(pending->data)) {
+      StopWaitingForData(fd);
+      Serve(*pending);
+    } else {
+      if (pending->idle && !pending->data.empty()) {
+        // The next request has begun on the connection kept open, it is now subject to the regular timeout.
+        pending->idle = false;
+        pending->deadline = std::chrono::steady_clock::now() + request_timeout_;
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_[fd] = std::move(pending);
+      }
+      WaitForData(fd, false);
+    }
+  }
+
+  void DropTimedOutConnections() {
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<std::unique_ptr<PendingConnection>> timed_out;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (now < next_timeouts_check_) {
+        return;
+      }
+      next_timeouts_check_ = now + std::chrono::milliseconds(kPollIntervalMS);
+      for (auto it = pending_.begin(); it != pending_.end();) {
+        if (it->second->deadline <= now) {
+          timed_out.push_back(std::move(it->second));
+          it = pending_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+    // Closing the connections outside the lock. Closing the socket also removes it from the poller.
+  }
+#else
+  // No readiness notifications on this platform: read and serve each request on one of the threads, blocking.
+  void Thread() {
+    current::bricks::system::ThreadPlacementPolicy().PlaceCurrentThread(
+        current::bricks::system::ThreadRole::HTTPServer);
+    while (true) {
+      std::unique_ptr<PendingConnection> pending;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wait_condition_variable_.wait(lock, [this]() { return terminating_ || !ready_.empty(); });
+        if (terminating_) {
+          return;
+        }
+        pending = std::move(ready_.front());
+        ready_.pop_front();
+      }
+      Serve(*pending);
+    }
+  }
+#endif
+
+  void Serve(PendingConnection& pending) {
+    pending.connection.SetPrefetchedData(std::move(pending.data));
+    serve_(std::move(pending.connection), pending.requests_served);
+  }
+
+  const std::chrono::milliseconds request_timeout_;
+  const serve_t serve_;
+#ifdef CURRENT_SOCKET_POLLER
+  current::net::SocketPoller poller_;
+#endif
+  std::atomic_bool terminating_{false};
+  std::mutex mutex_;
+  std::condition_variable wait_condition_variable_;
+  std::unordered_map<int, std::unique_ptr<PendingConnection>> pending_;
+  std::deque<std::unique_ptr<PendingConnection>> ready_;
+  std::chrono::steady_clock::time_point next_timeouts_check_;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace impl
+
+}  // namespace http
+}  // namespace current
+
+#endif  // BLOCKS_HTTP_IMPL_POSIX_SERVER_EVENT_LOOP_H
@@ -0,0 +1,756 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// The HTTP/2 mode of `HTTPServerPOSIX`, see `HTTPServerPOSIX::EnableHTTP2()`: many requests, the streams of HTTP/2,
+// served at once over a single connection, with the headers compressed with HPACK, and with the flow control.
+//
+// Once a stream has been received in full, its request is built right out of its decoded headers and its body, and
+// is handed over to the very handler that would serve it over HTTP/1.1, on the pool of threads the server runs the
+// handlers of the streams on. The response is not written as HTTP/1.1: the `HTTPResponseSink` of the `Connection` of
+// the request sends it on as the `HEADERS` and the `DATA` of the stream, as the flow control allows. This way every
+// handler, including the ones that respond with chunks for as long as they like, such as the pubsub ones, works over
+// HTTP/2 as is; each chunk goes out as it is flushed.
+//
+// There is the thread that reads the frames of the connection, and the threads of the pool that run the handlers.
+// The request bodies are received in full before the handler is called, up to `HTTP2Options::max_request_body_size`,
+// as with `Register()`; the streamed bodies are not streamed.
+
+#ifndef BLOCKS_HTTP_IMPL_POSIX_SERVER_HTTP2_H
+#define BLOCKS_HTTP_IMPL_POSIX_SERVER_HTTP2_H
+
+#include "../../../port.h"
+
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "../../../bricks/net/exceptions.h"
+#include "../../../bricks/net/http/http.h"
+#include "../../../bricks/net/http/http2.h"
+#include "../../../bricks/strings/util.h"
+
+#ifndef CURRENT_WINDOWS
+#include <sys/socket.h>
+#endif  // CURRENT_WINDOWS
+
+namespace current {
+namespace http {
+
+struct HTTP2Options final {
+  // The streams served at once over a connection. The ones past it are refused, for the client to retry them later.
+  uint32_t max_concurrent_streams = 100u;
+  // How much of the request body the client may send ahead, per stream, before the server has read it.
+  uint32_t initial_window_size = 1024u * 1024u;
+  // The limit on the size of the headers of a request, decompressed.
+  uint32_t max_header_list_size = 256u * 1024u;
+  // The requests with larger bodies are responded to with 413.
+  size_t max_request_body_size = current::net::constants::kMaxHTTPPayloadSizeInBytes;
+  // The threads of the pool that runs the handlers of the streams of all the HTTP/2 connections. The handlers that
+  // respond in chunks for as long as they like take up a thread each for as long as they do.
+  size_t handler_threads = 16u;
+};
+
+#ifndef CURRENT_WINDOWS
+
+namespace impl {
+
+class HTTP2Session final {
+ public:
+  // Serves the request of a stream, received in full. Called by the thread that reads the frames, so it is to hand
+  // the request over to another thread, not to serve it right away.
+  using serve_t = std::function<void(std::unique_ptr<current::net::HTTPServerConnection>&&)>;
+
+  HTTP2Session(current::net::Connection&& connection, HTTP2Options options, serve_t serve)
+      : connection_(std::move(connection)),
+        options_(options),
+        serve_(std::move(serve)),
+        decoder_(current::net::http2::kDefaultHeaderTableSize, options_.max_header_list_size) {}
+
+  // Serves the connection until it is closed by either side, and then waits for the streams being served to be done.
+  void Run() {
+    using namespace current::net::http2;
+    try {
+      ReadPreface();
+      WriteFrame(FrameType::Settings,
+                 0u,
+                 0u,
+                 SettingsPayload({{Setting::MaxConcurrentStreams, options_.max_concurrent_streams},
+                                  {Setting::InitialWindowSize, options_.initial_window_size},
+                                  {Setting::MaxHeaderListSize, options_.max_header_list_size}}));
+      // The window of the connection as a whole is not a setting, and starts at the default.
+      if (options_.initial_window_size > kDefaultInitialWindowSize) {
+        WriteFrame(FrameType::WindowUpdate,
+                   0u,
+                   0u,
+                   UInt32Payload(options_.initial_window_size - kDefaultInitialWindowSize));
+      }
+      ReadFrames();
+    } catch (const HTTP2ConnectionError& e) {
+      try {
+        WriteFrame(FrameType::GoAway, 0u, 0u, GoAwayPayload(last_stream_id_, e.error_code));
+      } catch (const current::Exception&) {
+      }
+    } catch (const current::Exception&) {
+      // The connection has been closed, or has failed.
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    CloseLocked();
+    streams_done_.wait(lock, [this]() { return !active_streams_; });
+    // The socket is closed once the session is destroyed; until then, the client is told the connection is over.
+    ::shutdown(connection_.socket, SHUT_RDWR);
+    done_ = true;
+  }
+
+  // Makes `Run()` return, once the handlers being run have returned. Thread-safe. The client is not sent `GOAWAY`,
+  // as with another stream writing to a client that does not read, it would block.
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      CloseLocked();
+    }
+    ::shutdown(connection_.socket, SHUT_RDWR);
+  }
+
+  bool Done() const { return done_; }
+
+ private:
+  struct Stream final {
+    const uint32_t id;
+    current::net::http2::HeaderList headers;
+    std::string body;
+    bool head_request = false;
+    // Set once the request has been received, and handed over to the handler. Accessed by the reading thread only.
+    bool dispatched = false;
+    // Guarded by `mutex_`.
+    int64_t send_window;
+    bool reset = false;
+
+    Stream(uint32_t id, int64_t send_window) : id(id), send_window(send_window) {}
+  };
+
+  // Sends the response of the stream on as its `HEADERS` and `DATA`. Held by the `Connection` of the request of
+  // the stream, and, once destroyed, resets the stream, unless the response has been sent in full.
+  class ResponseSink final : public current::net::HTTPResponseSink {
+   public:
+    ResponseSink(HTTP2Session& session, std::shared_ptr<Stream> stream)
+        : session_(session), stream_(std::move(stream)) {
+      std::lock_guard<std::mutex> lock(session_.mutex_);
+      ++session_.active_streams_;
+    }
+
+    ~ResponseSink() override {
+      using namespace current::net::http2;
+      if (!ended_) {
+        // The handler has failed, or has not responded. The client is told so, unless it is done with the stream.
+        if (!session_.ResetOrClosed(*stream_)) {
+          try {
+            session_.WriteFrame(FrameType::RSTStream,
+                                0u,
+                                stream_->id,
+                                UInt32Payload(static_cast<uint32_t>(ErrorCode::InternalError)));
+          } catch (const current::Exception&) {
+          }
+        }
+        session_.EraseStream(stream_->id);
+      }
+      // Notified under the lock, as the session may be gone right after it is released.
+      std::lock_guard<std::mutex> lock(session_.mutex_);
+      --session_.active_streams_;
+      session_.streams_done_.notify_all();
+    }
+
+    void SendHead(current::net::HTTPResponseCodeValue code,
+                  const current::net::HTTPHeaderFields& headers,
+                  bool end) override {
+      if (session_.ResetOrClosed(*stream_)) {
+        CURRENT_THROW(current::net::SocketWriteException());
+      }
+      const int status = static_cast<int>(code);
+      // The body of the response to `HEAD`, if any, is not sent.
+      no_body_ = stream_->head_request || status == 204 || status == 304;
+      current::net::http2::HeaderList fields = {{":status", std::to_string(status)}};
+      for (const auto& header : headers) {
+        std::string name = current::strings::ToLower(header.first);
+        // The headers of the connection are not a part of HTTP/2, RFC 7540 Section 8.1.2.2.
+        if (name != "connection" && name != "keep-alive" && name != "proxy-connection" &&
+            name != "transfer-encoding" && name != "upgrade") {
+          fields.emplace_back(std::move(name), header.second);
+        }
+      }
+      session_.WriteHeaders(stream_->id, fields, end || no_body_);
+      if (end || no_body_) {
+        End();
+      }
+    }
+
+    void SendBody(const char* data, size_t length, bool end) override {
+      if (!no_body_) {
+        session_.SendData(*stream_, data, length, end);
+        if (end) {
+          End();
+        }
+      }
+    }
+
+   private:
+    void End() {
+      ended_ = true;
+      session_.EraseStream(stream_->id);
+    }
+
+    HTTP2Session& session_;
+    const std::shared_ptr<Stream> stream_;
+    bool no_body_ = false;
+    bool ended_ = false;
+  };
+
+  void CloseLocked() {
+    closed_ = true;
+    send_window_updated_.notify_all();
+  }
+
+  bool ResetOrClosed(const Stream& stream) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stream.reset || closed_;
+  }
+
+  static current::net::http2::HTTP2ConnectionError ProtocolError(const std::string& message) {
+    return current::net::http2::HTTP2ConnectionError(current::net::http2::ErrorCode::ProtocolError, message);
+  }
+
+  void ReadPreface() {
+    using namespace current::net::http2;
+    char preface[kConnectionPrefaceLength];
+    connection_.BlockingRead(preface, kConnectionPrefaceLength, current::net::Connection::FillFullBuffer);
+    if (std::string_view(preface, kConnectionPrefaceLength) != kConnectionPreface) {
+      CURRENT_THROW(ProtocolError("HTTP/2: invalid connection preface."));
+    }
+  }
+
+  void ReadFrames() {
+    using namespace current::net::http2;
+    uint8_t header_bytes[kFrameHeaderLength];
+    std::string payload;
+    while (true) {
+      connection_.BlockingRead(header_bytes, kFrameHeaderLength, current::net::Connection::FillFullBuffer);
+      const FrameHeader frame = FrameHeader::Parse(header_bytes);
+      if (frame.length > kDefaultMaxFrameSize) {
+        CURRENT_THROW(HTTP2ConnectionError(ErrorCode::FrameSizeError, "HTTP/2: frame too large."));
+      }
+      payload.resize(frame.length);
+      if (frame.length) {
+        connection_.BlockingRead(&payload[0], frame.length, current::net::Connection::FillFullBuffer);
+      }
+      if (continuation_stream_id_ && frame.type != FrameType::Continuation) {
+        CURRENT_THROW(ProtocolError("HTTP/2: `CONTINUATION` expected."));
+      }
+      switch (frame.type) {
+        case FrameType::Data:
+          OnData(frame, payload);
+          break;
+        case FrameType::Headers:
+          OnHeaders(frame, payload);
+          break;
+        case FrameType::Continuation:
+          if (!continuation_stream_id_ || frame.stream_id != continuation_stream_id_) {
+            CURRENT_THROW(ProtocolError("HTTP/2: unexpected `CONTINUATION`."));
+          }
+          header_block_ += payload;
+          if (header_block_.length() > options_.max_header_list_size) {
+            CURRENT_THROW(HTTP2ConnectionError(ErrorCode::EnhanceYourCalm, "HTTP/2: header block too large."));
+          }
+          if (frame.HasFlag(kFlagEndHeaders)) {
+            continuation_stream_id_ = 0u;
+            OnHeaderBlock();
+          }
+          break;
+        case FrameType::RSTStream:
+          if (!frame.stream_id || frame.stream_id > last_stream_id_) {
+            CURRENT_THROW(ProtocolError("HTTP/2: `RST_STREAM` of an idle stream."));
+          }
+          if (frame.length != 4u) {
+            CURRENT_THROW(HTTP2ConnectionError(ErrorCode::FrameSizeError, "HTTP/2: invalid `RST_STREAM`."));
+          }
+          OnReset(frame.stream_id);
+          break;
+        case FrameType::Settings:
+          OnSettings(frame, payload);
+          break;
+        case FrameType::Ping:
+          if (frame.stream_id) {
+            CURRENT_THROW(ProtocolError("HTTP/2: `PING` of a stream."));
+          }
+          if (frame.length != 8u) {
+            CURRENT_THROW(HTTP2ConnectionError(ErrorCode::FrameSizeError, "HTTP/2: invalid `PING`."));
+          }
+          if (!frame.HasFlag(kFlagAck)) {
+            WriteFrame(FrameType::Ping, kFlagAck, 0u, payload);
+          }
+          break;
+        case FrameType::WindowUpdate:
+          OnWindowUpdate(frame, payload);
+          break;
+        case FrameType::PushPromise:
+          CURRENT_THROW(ProtocolError("HTTP/2: `PUSH_PROMISE` from the client."));
+        case FrameType::GoAway:
+        case FrameType::Priority:
+        default:
+          // The client is done opening the streams, which is fine, as are the priorities and the unknown frames.
+          break;
+      }
+    }
+  }
+
+  // Strips the padding, and the priority, if any, off the payload of `DATA` or `HEADERS`.
+  static std::string_view Unpadded(const current::net::http2::FrameHeader& frame, std::string_view payload) {
+    using namespace current::net::http2;
+    size_t padding = 0u;
+    if (frame.HasFlag(kFlagPadded)) {
+      if (payload.empty()) {
+        CURRENT_THROW(ProtocolError("HTTP/2: invalid padding."));
+      }
+      padding = static_cast<uint8_t>(payload[0]);
+      payload.remove_prefix(1u);
+    }
+    if (frame.type == FrameType::Headers && frame.HasFlag(kFlagPriority)) {
+      if (payload.length() < 5u) {
+        CURRENT_THROW(ProtocolError("HTTP/2: invalid priority."));
+      }
+      payload.remove_prefix(5u);
+    }
+    if (padding > payload.length()) {
+      CURRENT_THROW(ProtocolError("HTTP/2: invalid padding."));
+    }
+    payload.remove_suffix(padding);
+    return payload;
+  }
+
+  std::shared_ptr<Stream> FindStream(uint32_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = streams_.find(id);
+    return it != streams_.end() ? it->second : nullptr;
+  }
+
+  void EraseStream(uint32_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    streams_.erase(id);
+  }
+
+  void OnHeaders(const current::net::http2::FrameHeader& frame, const std::string& payload) {
+    using namespace current::net::http2;
+    if (!frame.stream_id) {
+      CURRENT_THROW(ProtocolError("HTTP/2: `HEADERS` of no stream."));
+    }
+    header_block_.assign(Unpadded(frame, payload));
+    header_block_stream_id_ = frame.stream_id;
+    header_block_ends_stream_ = frame.HasFlag(kFlagEndStream);
+    if (frame.HasFlag(kFlagEndHeaders)) {
+      OnHeaderBlock();
+    } else {
+      continuation_stream_id_ = frame.stream_id;
+    }
+  }
+
+  void OnHeaderBlock() {
+    using namespace current::net::http2;
+    HeaderList headers;
+    try {
+      // Decoded even if the stream is refused, to keep the dynamic table in sync with the one of the client.
+      headers = decoder_.Decode(header_block_);
+    } catch (const HPACKDecodingException& e) {
+      CURRENT_THROW(HTTP2ConnectionError(ErrorCode::CompressionError, e.OriginalDescription()));
+    }
+    const uint32_t id = header_block_stream_id_;
+    std::shared_ptr<Stream> stream = FindStream(id);
+    if (stream) {
+      // The trailers, which end the stream, and which are of no use to the handlers.
+      if (stream->dispatched || !header_block_ends_stream_) {
+        CURRENT_THROW(HTTP2ConnectionError(ErrorCode::StreamClosed, "HTTP/2: `HEADERS` of a closed stream."));
+      }
+      Dispatch(stream);
+      return;
+    }
+    if (!(id % 2u) || id <= last_stream_id_) {
+      CURRENT_THROW(ProtocolError("HTTP/2: invalid stream ID."));
+    }
+    last_stream_id_ = id;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (streams_.size() < options_.max_concurrent_streams) {
+        stream = std::make_shared<Stream>(id, peer_initial_window_size_);
+        streams_[id] = stream;
+      }
+    }
+    if (!stream) {
+      WriteFrame(FrameType::RSTStream, 0u, id, UInt32Payload(static_cast<uint32_t>(ErrorCode::RefusedStream)));
+      return;
+    }
+    stream->headers = std::move(headers);
+    if (header_block_ends_stream_) {
+      Dispatch(stream);
+    }
+  }
+
+  void OnData(const current::net::http2::FrameHeader& frame, const std::string& payload) {
+    using namespace current::net::http2;
+    if (!frame.stream_id) {
+      CURRENT_THROW(ProtocolError("HTTP/2: `DATA` of no stream."));
+    }
+    const std::string_view data = Unpadded(frame, payload);
+    // The window is given back right away, as it is the size of the request bodies that is limited, not the pace.
+    if (frame.length) {
+      WriteFrame(FrameType::WindowUpdate, 0u, 0u, UInt32Payload(frame.length));
+    }
+    const std::shared_ptr<Stream> stream = FindStream(frame.stream_id);
+    if (!stream || stream->dispatched) {
+      if (frame.stream_id > last_stream_id_) {
+        CURRENT_THROW(ProtocolError("HTTP/2: `DATA` of an idle stream."));
+      }
+      // The stream has been reset, or refused.
+      return;
+    }
+    if (stream->body.length() + data.length() > options_.max_request_body_size) {
+      stream->dispatched = true;
+      EraseStream(stream->id);
+      WriteHeaders(stream->id, {{":status", "413"}, {"content-length", "0"}}, true);
+      WriteFrame(FrameType::RSTStream, 0u, stream->id, UInt32Payload(static_cast<uint32_t>(ErrorCode::NoError)));
+      return;
+    }
+    stream->body.append(data.data(), data.length());
+    if (frame.HasFlag(kFlagEndStream)) {
+      Dispatch(stream);
+    } else if (frame.length) {
+      WriteFrame(FrameType::WindowUpdate, 0u, stream->id, UInt32Payload(frame.length));
+    }
+  }
+
+  void OnReset(uint32_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = streams_.find(id);
+    if (it != streams_.end()) {
+      Stream& stream = *it->second;
+      stream.reset = true;
+      if (!stream.dispatched) {
+        streams_.erase(it);
+      }
+      send_window_updated_.notify_all();
+    }
+  }
+
+  void OnSettings(const current::net::http2::FrameHeader& frame, const std::string& payload) {
+    using namespace current::net::http2;
+    if (frame.stream_id) {
+      CURRENT_THROW(ProtocolError("HTTP/2: `SETTINGS` of a stream."));
+    }
+    if (frame.HasFlag(kFlagAck)) {
+      if (frame.length) {
+        CURRENT_THROW(HTTP2ConnectionError(ErrorCode::FrameSizeError, "HTTP/2: invalid `SETTINGS` ACK."));
+      }
+      return;
+    }
+    if (frame.length % 6u) {
+      CURRENT_THROW(HTTP2ConnectionError(ErrorCode::FrameSizeError, "HTTP/2: invalid `SETTINGS`."));
+    }
+    for (size_t i = 0u; i < payload.length(); i += 6u) {
+      const uint8_t* p = reinterpret_cast<const uint8_t*>(payload.data()) + i;
+      const Setting setting = static_cast<Setting>((p[0] << 8) | p[1]);
+      const uint32_t value = ReadUInt32(p + 2);
+      if (setting == Setting::HeaderTableSize) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        encoder_.SetMaxTableSize(value);
+      } else if (setting == Setting::EnablePush) {
+        if (value > 1u) {
+          CURRENT_THROW(ProtocolError("HTTP/2: invalid `SETTINGS_ENABLE_PUSH`."));
+        }
+      } else if (setting == Setting::InitialWindowSize) {
+        if (value > kMaxWindowSize) {
+          CURRENT_THROW(HTTP2ConnectionError(ErrorCode::FlowControlError, "HTTP/2: invalid initial window size."));
+        }
+        // Applies to the windows of the streams open already too, RFC 7540 Section 6.9.2.
+        std::lock_guard<std::mutex> lock(mutex_);
+        const int64_t delta = static_cast<int64_t>(value) - peer_initial_window_size_;
+        peer_initial_window_size_ = value;
+        for (auto& stream : streams_) {
+          stream.second->send_window += delta;
+          if (stream.second->send_window > kMaxWindowSize) {
+            CURRENT_THROW(HTTP2ConnectionError(ErrorCode::FlowControlError, "HTTP/2: window too large."));
+          }
+        }
+        send_window_updated_.notify_all();
+      } else if (setting == Setting::MaxFrameSize) {
+        if (value < kDefaultMaxFrameSize || value > kMaxAllowedFrameSize) {
+          CURRENT_THROW(ProtocolError("HTTP/2: invalid `SETTINGS_MAX_FRAME_SIZE`."));
+        }
+        peer_max_frame_size_ = value;
+      }
+    }
+    WriteFrame(FrameType::Settings, kFlagAck, 0u);
+  }
+
+  void OnWindowUpdate(const current::net::http2::FrameHeader& frame, const std::string& payload) {
+    using namespace current::net::http2;
+    if (frame.length != 4u) {
+      CURRENT_THROW(HTTP2ConnectionError(ErrorCode::FrameSizeError, "HTTP/2: invalid `WINDOW_UPDATE`."));
+    }
+    const uint32_t increment = ReadUInt32(reinterpret_cast<const uint8_t*>(payload.data())) & kMaxWindowSize;
+    if (!increment) {
+      CURRENT_THROW(ProtocolError("HTTP/2: zero `WINDOW_UPDATE`."));
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t* window = &send_window_;
+    if (frame.stream_id) {
+      const auto it = streams_.find(frame.stream_id);
+      if (it == streams_.end()) {
+        // The stream is done with already.
+        return;
+      }
+      window = &it->second->send_window;
+    }
+    *window += increment;
+    if (*window > kMaxWindowSize) {
+      CURRENT_THROW(HTTP2ConnectionError(ErrorCode::FlowControlError, "HTTP/2: window too large."));
+    }
+    send_window_updated_.notify_all();
+  }
+
+  // Moves the method, the path, and the headers of the request off the headers of the stream. Returns `false` if
+  // the request is malformed, RFC 7540 Section 8.1.2.
+  static bool TakeRequestHeaders(Stream& stream,
+                                 std::string& method,
+                                 std::string& path,
+                                 current::net::HTTPHeaderFields& headers) {
+    std::string authority;
+    std::string cookie;
+    bool regular_header_seen = false;
+    for (auto& header : stream.headers) {
+      std::string& name = header.first;
+      std::string& value = header.second;
+      if (name.empty() || !IsValidHeaderText(name) || !IsValidHeaderText(value)) {
+        return false;
+      }
+      if (name[0] == ':') {
+        std::string* pseudo_header = nullptr;
+        if (name == ":method") {
+          pseudo_header = &method;
+        } else if (name == ":path") {
+          pseudo_header = &path;
+        } else if (name == ":authority") {
+          pseudo_header = &authority;
+        } else if (name != ":scheme") {
+          return false;
+        }
+        if (regular_header_seen || (pseudo_header && !pseudo_header->empty())) {
+          return false;
+        }
+        if (pseudo_header) {
+          *pseudo_header = std::move(value);
+        }
+        continue;
+      }
+      regular_header_seen = true;
+      for (const char c : name) {
+        if (std::isupper(static_cast<unsigned char>(c)) || c == ':' || c == ' ') {
+          return false;
+        }
+      }
+      if (name == "connection" || name == "keep-alive" || name == "proxy-connection" ||
+          name == "transfer-encoding" || name == "upgrade") {
+        return false;
+      } else if (name == "content-length" || name == "te") {
+        // The length of the body received is the one that counts.
+      } else if (name == "host") {
+        if (authority.empty()) {
+          authority = std::move(value);
+        }
+      } else if (name == "cookie") {
+        // The cookies may be split into several header fields, RFC 7540 Section 8.1.2.5.
+        cookie += (cookie.empty() ? "" : "; ") + value;
+      } else {
+        headers.emplace_back(std::move(name), std::move(value));
+      }
+    }
+    if (method.empty() || path.empty() || (path[0] != '/' && path != "*")) {
+      return false;
+    }
+    if (!authority.empty()) {
+      headers.emplace(headers.begin(), "host", std::move(authority));
+    }
+    if (!cookie.empty()) {
+      headers.emplace_back("cookie", std::move(cookie));
+    }
+    headers.emplace_back("content-length", std::to_string(stream.body.length()));
+    return true;
+  }
+
+  // No line breaks, nor NULs, are allowed in the headers, RFC 7540 Section 10.3. The NULs would also cut the headers
+  // of the request short, as they are kept '\0'-terminated.
+  static bool IsValidHeaderText(const std::string& s) {
+    return s.find_first_of(std::string("\r\n\0", 3u)) == std::string::npos;
+  }
+
+  // Builds the request of the stream received in full, and hands it over to be served, see `serve_t`.
+  void Dispatch(const std::shared_ptr<Stream>& stream) {
+    using namespace current::net::http2;
+    stream->dispatched = true;
+    std::string method;
+    std::string path;
+    current::net::HTTPHeaderFields headers;
+    if (!TakeRequestHeaders(*stream, method, path, headers)) {
+      EraseStream(stream->id);
+      WriteFrame(FrameType::RSTStream, 0u, stream->id, UInt32Payload(static_cast<uint32_t>(ErrorCode::ProtocolError)));
+      return;
+    }
+    stream->head_request = (method == "HEAD");
+    // The handler sees the addresses of the client and of the server, as it would over HTTP/1.1.
+    current::net::Connection connection(current::net::SocketHandle(current::net::SocketHandle::NoSocket()),
+                                        current::net::IPAndPort(connection_.LocalIPAndPort()),
+                                        current::net::IPAndPort(connection_.RemoteIPAndPort()));
+    connection.RestartTimings(true);
+    connection.SetHTTPResponseSink(std::make_shared<ResponseSink>(*this, stream));
+    auto request = std::make_unique<current::net::HTTPServerConnection>(
+        std::move(connection), method, path, headers, stream->body);
+    stream->headers.clear();
+    stream->body.clear();
+    stream->body.shrink_to_fit();
+    serve_(std::move(request));
+  }
+
+  // Sends the data as `DATA` frames, as the flow control windows allow. Throws if the stream or the connection is gone.
+  void SendData(Stream& stream, const char* data, size_t length, bool end_stream) {
+    using namespace current::net::http2;
+    if (!length && !end_stream) {
+      return;
+    }
+    while (true) {
+      size_t frame_length;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        send_window_updated_.wait(lock, [&]() {
+          return stream.reset || closed_ || !length || (send_window_ > 0 && stream.send_window > 0);
+        });
+        if (stream.reset || closed_) {
+          CURRENT_THROW(current::net::SocketWriteException());
+        }
+        frame_length = std::min({length,
+                                 static_cast<size_t>(peer_max_frame_size_),
+                                 static_cast<size_t>(std::max(send_window_, int64_t(0))),
+                                 static_cast<size_t>(std::max(stream.send_window, int64_t(0)))});
+        send_window_ -= frame_length;
+        stream.send_window -= frame_length;
+      }
+      const bool last = end_stream && frame_length == length;
+      WriteFrame(FrameType::Data, last ? kFlagEndStream : 0u, stream.id, std::string_view(data, frame_length));
+      data += frame_length;
+      length -= frame_length;
+      if (!length) {
+        return;
+      }
+    }
+  }
+
+  // Encodes the headers, and sends them as `HEADERS` followed by `CONTINUATION`-s if need be. The blocks must go out
+  // in the order they have been encoded in, so both happen under the same lock.
+  void WriteHeaders(uint32_t stream_id, const current::net::http2::HeaderList& headers, bool end_stream) {
+    using namespace current::net::http2;
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    const std::string block = encoder_.Encode(headers);
+    const size_t max_frame_size = peer_max_frame_size_;
+    std::string frames;
+    size_t offset = 0u;
+    do {
+      const size_t length = std::min(block.length() - offset, max_frame_size);
+      const bool last = (offset + length == block.length());
+      const uint8_t flags = (last ? kFlagEndHeaders : 0u) | ((!offset && end_stream) ? kFlagEndStream : 0u);
+      frames += SerializeFrame(offset ? FrameType::Continuation : FrameType::Headers,
+                               flags,
+                               stream_id,
+                               std::string_view(block.data() + offset, length));
+      offset += length;
+    } while (offset < block.length());
+    WriteLocked({frames});
+  }
+
+  void WriteFrame(current::net::http2::FrameType type,
+                  uint8_t flags,
+                  uint32_t stream_id,
+                  std::string_view payload = "") {
+    uint8_t header[current::net::http2::kFrameHeaderLength];
+    current::net::http2::FrameHeader(static_cast<uint32_t>(payload.length()), type, flags, stream_id).Write(header);
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    WriteLocked({{header, sizeof(header)}, {payload.data(), payload.length()}});
+  }
+
+  // Once a write has failed, the connection is closed, for the reading thread to be done with it as well.
+  void WriteLocked(std::initializer_list<current::net::WriteBuffer> buffers) {
+    try {
+      connection_.BlockingWriteV(buffers, false);
+    } catch (const current::Exception&) {
+      Stop();
+      throw;
+    }
+  }
+
+  current::net::Connection connection_;
+  const HTTP2Options options_;
+  const serve_t serve_;
+  std::atomic_bool done_{false};
+
+  // The state of reading the frames, accessed by the reading thread only.
+  current::net::http2::HPACKDecoder decoder_;
+  uint32_t last_stream_id_ = 0u;
+  std::string header_block_;
+  uint32_t header_block_stream_id_ = 0u;
+  bool header_block_ends_stream_ = false;
+  uint32_t continuation_stream_id_ = 0u;  // Non-zero if the header block is to be continued.
+
+  // The state of writing the frames. Never locked while holding `mutex_`.
+  std::mutex write_mutex_;
+  current::net::http2::HPACKEncoder encoder_;
+  std::atomic<uint32_t> peer_max_frame_size_{current::net::http2::kDefaultMaxFrameSize};
+
+  // The state shared with the threads serving the streams.
+  std::mutex mutex_;
+  std::condition_variable send_window_updated_;
+  std::condition_variable streams_done_;
+  std::map<uint32_t, std::shared_ptr<Stream>> streams_;
+  int64_t send_window_ = current::net::http2::kDefaultInitialWindowSize;
+  int64_t peer_initial_window_size_ = current::net::http2::kDefaultInitialWindowSize;
+  size_t active_streams_ = 0u;  // The streams handed over to be served, the `ResponseSink`-s of which are alive.
+  bool closed_ = false;
+};
+
+}  // namespace impl
+
+#endif  // CURRENT_WINDOWS
+
+}  // namespace http
+}  // namespace current
+
+#endif  // BLOCKS_HTTP_IMPL_POSIX_SERVER_HTTP2_H
@@ -0,0 +1,185 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// `HTTPRoutesTrie` finds the handler for the URL path of an HTTP request in a single pass over the path, with no
+// memory allocated, and then extracts the URL path arguments for it, if any. The trie has one node per component
+// of the paths registered, and the node of the path the handler of which is found is the deepest one along the
+// path that has a handler for as many URL path arguments as there are components of the path left past it.
+
+#ifndef BLOCKS_HTTP_IMPL_ROUTES_TRIE_H
+#define BLOCKS_HTTP_IMPL_ROUTES_TRIE_H
+
+#include "../../../port.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "../../url/url.h"
+
+namespace current {
+namespace http {
+namespace impl {
+
+// `T` is what the handlers for each path are kept in, and must outlive the trie, or be `Erase()`-d from it first.
+// The `has_handler` of `Match()` is called as `has_handler(const T&, size_t url_path_args_count)`.
+template <typename T>
+class HTTPRoutesTrie final {
+ public:
+  void Insert(const std::string& path, const T* handlers) { FindOrCreateNode(path)->handlers = handlers; }
+
+  void Erase(const std::string& path) {
+    Node* node = &root_;
+    if (path != "/") {
+      PathComponents components(path);
+      std::string_view component;
+      while (components.Next(component)) {
+        const auto it = node->children.find(component);
+        if (it == node->children.end()) {
+          return;
+        }
+        node = it->second.get();
+      }
+    }
+    node->handlers = nullptr;
+    // NOTE(dkorolev): The nodes are not pruned, as there are only as many of them as the components of the paths
+    // ever registered, and keeping them makes re-registering the routes, which the tests do a lot, cheaper.
+  }
+
+  // Returns the handlers for the path, or `nullptr`, and populates `output_url_args`.
+  template <typename HAS_HANDLER>
+  const T* Match(std::string_view path, HAS_HANDLER&& has_handler, url::URLPathArgs& output_url_args) const {
+    // Count the non-empty components first, as every one past the node matched is a URL path argument.
+    size_t args_left = 0u;
+    {
+      PathComponents components(path);
+      std::string_view component;
+      while (components.Next(component)) {
+        args_left += !component.empty();
+      }
+    }
+
+    const T* result = nullptr;
+    size_t result_prefix_length = 0u;
+    const auto Consider = [&](const Node& node, size_t prefix_length) {
+      if (node.handlers && args_left <= url::URLPathArgs::MaxArgsCount && has_handler(*node.handlers, args_left)) {
+        result = node.handlers;
+        result_prefix_length = prefix_length;
+      }
+    };
+
+    // The root is the "/" path, and it is followed by the path components.
+    const Node* node = &root_;
+    Consider(*node, 0u);
+    PathComponents components(path);
+    std::string_view component;
+    while (components.Next(component)) {
+      const auto it = node->children.find(component);
+      if (it == node->children.end()) {
+        break;
+      }
+      node = it->second.get();
+      if (!component.empty()) {
+        --args_left;
+        // The trailing slashes past a path are not part of it, so the paths ending with a slash are not considered.
+        Consider(*node, static_cast<size_t>(component.data() + component.length() - path.data()));
+      }
+    }
+
+    if (result) {
+      output_url_args = url::URLPathArgs();
+      output_url_args.base_path = result_prefix_length ? std::string(path.substr(0u, result_prefix_length)) : "/";
+      // The URL path arguments are kept starting from the last one.
+      std::string_view args(path.data() + result_prefix_length, path.length() - result_prefix_length);
+      while (!args.empty()) {
+        const size_t slash = args.rfind('/');
+        const std::string_view arg = args.substr(slash + 1u);
+        if (!arg.empty()) {
+          output_url_args.add(url::URL::DecodeURIComponent(arg));
+        }
+        args = args.substr(0u, slash == std::string_view::npos ? 0u : slash);
+      }
+    }
+    return result;
+  }
+
+ private:
+  struct Node final {
+    const T* handlers = nullptr;
+    std::map<std::string, std::unique_ptr<Node>, std::less<>> children;
+  };
+
+  // The components of "/a/b" are "a" and "b", the one of "/" is the empty one, and so are the two of "//".
+  class PathComponents final {
+   public:
+    explicit PathComponents(std::string_view path)
+        : remaining_(path.empty() ? std::string_view() : path.substr(1u)), done_(path.empty()) {}
+
+    bool Next(std::string_view& component) {
+      if (done_) {
+        return false;
+      }
+      const size_t slash = remaining_.find('/');
+      if (slash == std::string_view::npos) {
+        component = remaining_;
+        done_ = true;
+      } else {
+        component = remaining_.substr(0u, slash);
+        remaining_ = remaining_.substr(slash + 1u);
+      }
+      return true;
+    }
+
+   private:
+    std::string_view remaining_;
+    bool done_;
+  };
+
+  Node* FindOrCreateNode(const std::string& path) {
+    Node* node = &root_;
+    if (path != "/") {
+      PathComponents components(path);
+      std::string_view component;
+      while (components.Next(component)) {
+        auto& child = node->children[std::string(component)];
+        if (!child) {
+          child = std::make_unique<Node>();
+        }
+        node = child.get();
+      }
+    }
+    return node;
+  }
+
+  Node root_;
+};
+
+}  // namespace impl
+}  // namespace http
+}  // namespace current
+
+#endif  // BLOCKS_HTTP_IMPL_ROUTES_TRIE_H
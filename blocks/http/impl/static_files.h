@@ -0,0 +1,171 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// The helpers for `ServeStaticFilesFrom()`: the files kept open to be served with `sendfile()`,
+// and the parsing of the `Range`, `If-None-Match`, and `Accept-Encoding` request headers.
+
+#ifndef BLOCKS_HTTP_IMPL_STATIC_FILES_H
+#define BLOCKS_HTTP_IMPL_STATIC_FILES_H
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../../../bricks/file/exceptions.h"
+#include "../../../bricks/strings/split.h"
+#include "../../../bricks/strings/util.h"
+
+namespace current {
+namespace http {
+namespace impl {
+
+// A file kept open to be served with `sendfile()`, closed once no `StaticFileServer` refers to it anymore.
+class OpenStaticFile final {
+ public:
+  explicit OpenStaticFile(const std::string& pathname) : fd_(::open(pathname.c_str(), O_RDONLY)) {
+    if (fd_ < 0) {
+      CURRENT_THROW(CannotReadFileException(pathname));  // LCOV_EXCL_LINE
+    }
+    struct stat info;
+    if (::fstat(fd_, &info)) {
+      ::close(fd_);                                      // LCOV_EXCL_LINE
+      CURRENT_THROW(CannotReadFileException(pathname));  // LCOV_EXCL_LINE
+    }
+    size_ = static_cast<uint64_t>(info.st_size);
+    modification_time_ = static_cast<int64_t>(info.st_mtime);
+  }
+
+  ~OpenStaticFile() { ::close(fd_); }
+
+  int FD() const { return fd_; }
+  uint64_t Size() const { return size_; }
+  int64_t ModificationTime() const { return modification_time_; }
+
+ private:
+  OpenStaticFile(const OpenStaticFile&) = delete;
+  OpenStaticFile& operator=(const OpenStaticFile&) = delete;
+
+  const int fd_;
+  uint64_t size_;
+  int64_t modification_time_;
+};
+
+enum class StaticFileRange : int { None, Satisfiable, NotSatisfiable };
+
+// Parses the value of the `Range` header for a resource of `size` bytes. Only a single range is supported,
+// `bytes=first-last`, `bytes=first-`, or `bytes=-suffix_length`; the multiple ranges, as well as the malformed ones,
+// are ignored, and the full resource is served. On success, the range to serve is `[begin, end)`.
+inline StaticFileRange ParseStaticFileRange(const std::string& value, uint64_t size, uint64_t& begin, uint64_t& end) {
+  const std::string prefix = "bytes=";
+  if (value.compare(0u, prefix.length(), prefix) || value.find(',') != std::string::npos) {
+    return StaticFileRange::None;
+  }
+  const std::string range = strings::Trim(value.substr(prefix.length()));
+  const size_t dash = range.find('-');
+  if (dash == std::string::npos) {
+    return StaticFileRange::None;
+  }
+  const std::string first = range.substr(0u, dash);
+  const std::string last = range.substr(dash + 1u);
+  const auto is_number = [](const std::string& s) {
+    return !s.empty() && s.length() <= 18u && s.find_first_not_of("0123456789") == std::string::npos;
+  };
+  if (first.empty()) {
+    if (!is_number(last)) {
+      return StaticFileRange::None;
+    }
+    const uint64_t suffix_length = std::strtoull(last.c_str(), nullptr, 10);
+    if (!suffix_length || !size) {
+      return StaticFileRange::NotSatisfiable;
+    }
+    begin = suffix_length < size ? size - suffix_length : 0u;
+    end = size;
+    return StaticFileRange::Satisfiable;
+  }
+  if (!is_number(first) || !(last.empty() || is_number(last))) {
+    return StaticFileRange::None;
+  }
+  begin = std::strtoull(first.c_str(), nullptr, 10);
+  end = last.empty() ? std::max(size, begin + 1u) : std::strtoull(last.c_str(), nullptr, 10) + 1u;
+  if (end <= begin) {
+    return StaticFileRange::None;
+  }
+  if (begin >= size) {
+    return StaticFileRange::NotSatisfiable;
+  }
+  if (end > size) {
+    end = size;
+  }
+  return StaticFileRange::Satisfiable;
+}
+
+// Whether the value of the `If-None-Match` header, a comma-separated list of entity tags or `*`, matches `etag`.
+// Uses the weak comparison, as RFC 7232 requires for `If-None-Match`.
+inline bool IfNoneMatchMatches(const std::string& value, const std::string& etag) {
+  const auto strip_weak = [](const std::string& tag) { return tag.compare(0u, 2u, "W/") ? tag : tag.substr(2u); };
+  for (const std::string& tag : strings::Split(value, ',')) {
+    const std::string trimmed = strings::Trim(tag);
+    if (trimmed == "*" || strip_weak(trimmed) == strip_weak(etag)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Whether the value of the `Accept-Encoding` header lists `encoding`, or `*`, with a non-zero `q`.
+inline bool AcceptsEncoding(const std::string& value, const std::string& encoding) {
+  for (const std::string& element : strings::Split(value, ',')) {
+    const std::vector<std::string> parts = strings::Split(element, ';');
+    if (parts.empty()) {
+      continue;
+    }
+    const std::string name = strings::ToLower(strings::Trim(parts.front()));
+    if (name != encoding && name != "*") {
+      continue;
+    }
+    bool acceptable = true;
+    for (size_t i = 1u; i < parts.size(); ++i) {
+      const std::string parameter = strings::Trim(parts[i]);
+      if (!parameter.compare(0u, 2u, "q=")) {
+        acceptable = std::strtod(parameter.c_str() + 2u, nullptr) > 0.0;
+      }
+    }
+    return acceptable;
+  }
+  return false;
+}
+
+}  // namespace impl
+}  // namespace http
+}  // namespace current
+
+#endif  // BLOCKS_HTTP_IMPL_STATIC_FILES_H
@@ -0,0 +1,194 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// `HTTPPhaseTimings` times the phases each request served by the HTTP server goes through, per route, into
+// histograms, to tell whether the slow requests are slow to be sent by the clients, slow to be parsed, wait for
+// a thread to be served on, or are slow to be handled and responded to. Always on, at the cost of a few reads of
+// the clock, and of a short critical section, per request.
+//
+// The phases are the time from the connection having been accepted, or, once kept alive, having started to wait
+// for the next request, to:
+// * `first_byte`: the first byte of the request having been received, i.e. the wait for the client,
+// * `headers`: the headers having been received and parsed, since the first byte,
+// * `body`: the body having been received, since the headers,
+// * `queue`: the handler having started, since the body, i.e. the wait for a thread to run the handler on,
+// * `handler`: the handler having returned, since it has started,
+// * `response`: the response having been sent in full, since the handler has started,
+// * `total`: both the handler having returned and the response having been sent, since the connection accepted.
+//
+// Use `HTTPServerPOSIX::PhaseTimings()`, or serve them with `HTTPServerPOSIX::ServePhaseTimings(path)`.
+
+#ifndef BLOCKS_HTTP_PHASE_TIMINGS_H
+#define BLOCKS_HTTP_PHASE_TIMINGS_H
+
+#include "../../port.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../../bricks/net/http/http.h"
+#include "../../typesystem/struct.h"
+
+namespace current {
+namespace http {
+
+CURRENT_STRUCT(HTTPPhaseHistogram) {
+  CURRENT_FIELD(count, uint64_t, 0u);
+  CURRENT_FIELD(total, std::chrono::microseconds, std::chrono::microseconds(0));
+  CURRENT_FIELD(max, std::chrono::microseconds, std::chrono::microseconds(0));
+  CURRENT_FIELD(buckets, std::vector<uint64_t>);
+  CURRENT_FIELD_DESCRIPTION(buckets, "The counts by duration: under 1us, 2us, 4us, etc., the last one the rest.");
+};
+
+CURRENT_STRUCT(HTTPRoutePhaseTimings) {
+  CURRENT_FIELD(first_byte, HTTPPhaseHistogram);
+  CURRENT_FIELD(headers, HTTPPhaseHistogram);
+  CURRENT_FIELD(body, HTTPPhaseHistogram);
+  CURRENT_FIELD(queue, HTTPPhaseHistogram);
+  CURRENT_FIELD(handler, HTTPPhaseHistogram);
+  CURRENT_FIELD(response, HTTPPhaseHistogram);
+  CURRENT_FIELD(total, HTTPPhaseHistogram);
+};
+
+CURRENT_STRUCT(HTTPPhaseTimingsSnapshot) {
+  CURRENT_FIELD(routes, (std::map<std::string, HTTPRoutePhaseTimings>));
+  CURRENT_FIELD_DESCRIPTION(routes, "By the path the route is registered at.");
+};
+
+class HTTPPhaseTimings final : public std::enable_shared_from_this<HTTPPhaseTimings> {
+ public:
+  constexpr static size_t kBuckets = 32u;
+
+  // Reported into the timings of `route` once released by both the server and the connection.
+  class Recorder final : public current::net::HTTPRequestPhases {
+   public:
+    Recorder(std::shared_ptr<HTTPPhaseTimings> timings, const std::string& route)
+        : timings_(std::move(timings)), route_(route) {}
+    ~Recorder() { timings_->Record(route_, *this); }
+
+   private:
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    const std::shared_ptr<HTTPPhaseTimings> timings_;
+    const std::string route_;
+  };
+
+  std::shared_ptr<Recorder> StartRecording(const std::string& route) {
+    return std::make_shared<Recorder>(shared_from_this(), route);
+  }
+
+  HTTPPhaseTimingsSnapshot Snapshot() const {
+    HTTPPhaseTimingsSnapshot snapshot;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& route : routes_) {
+      HTTPRoutePhaseTimings& timings = snapshot.routes[route.first];
+      const Route& r = route.second;
+      r.first_byte.Export(timings.first_byte);
+      r.headers.Export(timings.headers);
+      r.body.Export(timings.body);
+      r.queue.Export(timings.queue);
+      r.handler.Export(timings.handler);
+      r.response.Export(timings.response);
+      r.total.Export(timings.total);
+    }
+    return snapshot;
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    routes_.clear();
+  }
+
+ private:
+  using time_point_t = current::net::HTTPRequestPhases::time_point_t;
+
+  struct Histogram final {
+    uint64_t count = 0u;
+    uint64_t total_us = 0u;
+    uint64_t max_us = 0u;
+    uint64_t buckets[kBuckets] = {};
+
+    // Does nothing unless both points in time have been recorded.
+    void Add(time_point_t from, time_point_t to) {
+      if (from != time_point_t() && to != time_point_t()) {
+        const uint64_t us = static_cast<uint64_t>(
+            std::max(std::chrono::duration_cast<std::chrono::microseconds>(to - from).count(), int64_t(0)));
+        ++count;
+        total_us += us;
+        max_us = std::max(max_us, us);
+        size_t bucket = 0u;
+        while (bucket + 1u < kBuckets && (us >> bucket)) {
+          ++bucket;
+        }
+        ++buckets[bucket];
+      }
+    }
+
+    void Export(HTTPPhaseHistogram& output) const {
+      output.count = count;
+      output.total = std::chrono::microseconds(total_us);
+      output.max = std::chrono::microseconds(max_us);
+      output.buckets.assign(buckets, buckets + kBuckets);
+    }
+  };
+
+  struct Route final {
+    Histogram first_byte;
+    Histogram headers;
+    Histogram body;
+    Histogram queue;
+    Histogram handler;
+    Histogram response;
+    Histogram total;
+  };
+
+  void Record(const std::string& route, const current::net::HTTPRequestPhases& phases) {
+    const time_point_t done = (phases.response_flushed == time_point_t())
+                                  ? time_point_t()
+                                  : std::max(phases.handler_finished, phases.response_flushed);
+    std::lock_guard<std::mutex> lock(mutex_);
+    Route& r = routes_[route];
+    r.first_byte.Add(phases.accepted, phases.first_byte);
+    r.headers.Add(phases.first_byte, phases.headers_parsed);
+    r.body.Add(phases.headers_parsed, phases.body_received);
+    r.queue.Add(phases.body_received, phases.handler_started);
+    r.handler.Add(phases.handler_started, phases.handler_finished);
+    r.response.Add(phases.handler_started, phases.response_flushed);
+    r.total.Add(phases.accepted, done);
+  }
+
+  mutable std::mutex mutex_;
+  std::map<std::string, Route> routes_;
+};
+
+}  // namespace http
+}  // namespace current
+
+#endif  // BLOCKS_HTTP_PHASE_TIMINGS_H
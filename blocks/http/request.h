@@ -25,6 +25,7 @@ SOFTWARE.
 #ifndef BLOCKS_HTTP_REQUEST_H
 #define BLOCKS_HTTP_REQUEST_H
 
+#include <memory>
 #include <string>
 #include <type_traits>
 #include <vector>
@@ -47,12 +48,18 @@ struct IHasDoRespondViaHTTP {
 
 // The only parameter to be passed to HTTP handlers.
 struct Request final {
+  // Held until the request has been responded to, see `HTTPAdmissionControl`. Declared before
+  // `unique_connection`, to be released after the connection is done with the response.
+  std::shared_ptr<void> admission_ticket;
   std::unique_ptr<current::net::HTTPServerConnection> unique_connection;
 
   current::net::HTTPServerConnection& connection;
   const current::net::HTTPRequestData&
       http_data;  // Accessor to use `r.http_data` instead of `r.connection->HTTPRequest()`.
   const current::url::URL url;
+  // The zero-copy counterpart of `url`, into the request received, with the query parameters decoded on demand.
+  // Unlike `url.path`, `url_view.path` is the full path requested.
+  const current::url::URLView url_view;
   // `url_path_had_trailing_slash` is needed to distinguish requests with and without a trailing slash
   // and redirect the latter to the former.
   // Do not store the original `url` to avoid taking extra memory.
@@ -69,6 +76,7 @@ struct Request final {
         connection(*unique_connection.get()),
         http_data(unique_connection->HTTPRequest()),
         url(http_data.URL()),
+        url_view(http_data.URLView()),
         url_path_had_trailing_slash(!url.path.empty() && url.path.back() == '/'),
         url_path_args(url_path_args),
         method(http_data.Method()),
@@ -84,10 +92,12 @@ struct Request final {
 
   // It is essential to move `unique_connection` so that the socket outlives the destruction of `rhs`.
   Request(Request&& rhs)
-      : unique_connection(std::move(rhs.unique_connection)),
+      : admission_ticket(std::move(rhs.admission_ticket)),
+        unique_connection(std::move(rhs.unique_connection)),
         connection(*unique_connection.get()),
         http_data(unique_connection->HTTPRequest()),
         url(rhs.url),
+        url_view(rhs.url_view),
         url_path_had_trailing_slash(rhs.url_path_had_trailing_slash),
         url_path_args(rhs.url_path_args),
         method(http_data.Method()),
@@ -124,6 +134,15 @@ struct Request final {
     return connection.SendChunkedHTTPResponse<CACHE_SIZE>(code, headers, content_type);
   }
 
+  // Reads up to `max_length` more bytes of the body, for the handlers registered with `RegisterWithStreamedBody()`,
+  // waiting for at least one of them to be received. Returns zero once all of the body has been read.
+  size_t ReadBody(void* output, size_t max_length) {
+    if (!unique_connection) {
+      CURRENT_THROW(net::AttemptedToSendHTTPResponseMoreThanOnce());
+    }
+    return connection.ReadBody(output, max_length);
+  }
+
   Request(const Request&) = delete;
   void operator=(const Request&) = delete;
   void operator=(Request&&) = delete;
@@ -33,10 +33,17 @@ SOFTWARE.
 #include "docu/server/docu_03httpserver_04_test.cc"
 #include "docu/server/docu_03httpserver_05_test.cc"
 
+#include <algorithm>
+#include <future>
+#include <map>
+#include <numeric>
+#include <set>
 #include <string>
 
 #include "api.h"
 
+#include "../../bricks/net/http/http2.h"
+
 #include "../url/url.h"
 
 #include "../../typesystem/struct.h"
@@ -185,6 +192,119 @@ TEST(HTTPAPI, RegisterWithURLPathParams) {
   EXPECT_EQ("/ (foo, bar/baz, meh) ", run("/foo/bar%2Fbaz/meh"));
 }
 
+TEST(HTTPAPI, RoutesTrie) {
+  using handlers_t = std::set<size_t>;
+  const handlers_t root_any = {0u, 1u, 2u, 3u};
+  const handlers_t none = {0u};
+  const handlers_t one = {1u};
+  std::vector<handlers_t> many(300u, none);
+
+  current::http::impl::HTTPRoutesTrie<handlers_t> trie;
+  trie.Insert("/", &root_any);
+  trie.Insert("/a", &one);
+  trie.Insert("/a//b", &none);
+  for (size_t i = 0u; i < many.size(); ++i) {
+    trie.Insert("/route/" + current::ToString(i), &many[i]);
+  }
+
+  const auto Match = [&trie](const std::string& path) -> std::string {
+    URLPathArgs args;
+    const handlers_t* handlers =
+        trie.Match(path, [](const handlers_t& h, size_t n) { return h.count(n) > 0u; }, args);
+    return (handlers ? args.base_path : "none") + " (" + current::strings::Join(args, ", ") + ')';
+  };
+
+  EXPECT_EQ("/ ()", Match("/"));
+  EXPECT_EQ("/ (a)", Match("/a"));
+  EXPECT_EQ("/a (x)", Match("/a/x"));
+  EXPECT_EQ("/a (x)", Match("/a///x//"));
+  EXPECT_EQ("/ (a, x, y)", Match("/a/x/y"));
+  EXPECT_EQ("/a//b ()", Match("/a//b/"));
+  EXPECT_EQ("/a (b)", Match("/a/b"));
+  EXPECT_EQ("/ (x, a)", Match("//x/a"));
+  EXPECT_EQ("/ (x y)", Match("/x%20y"));
+  EXPECT_EQ("/route/299 ()", Match("/route/299"));
+  EXPECT_EQ("/ (route, 300)", Match("/route/300"));
+  EXPECT_EQ("none ()", Match("/a/b/c/d"));
+
+  trie.Erase("/a");
+  trie.Erase("/");
+  EXPECT_EQ("none ()", Match("/a/x"));
+  EXPECT_EQ("/a//b ()", Match("/a//b"));
+  EXPECT_EQ("/route/7 ()", Match("/route/7"));
+}
+
+TEST(HTTPAPI, ReusePortListeners) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  std::atomic_int served(0);
+  const auto scope = http_server.Register("/listeners", [&served](Request r) {
+    ++served;
+    r("OK\n");
+  });
+  EXPECT_EQ(1u, http_server.Listeners());
+#if defined(CURRENT_POSIX) && !defined(CURRENT_APPLE)
+  http_server.SetListeners(4u, true);
+  EXPECT_EQ(4u, http_server.Listeners());
+#endif
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ("OK\n", HTTP(GET(Printf("http://localhost:%d/listeners", port))).body);
+  }
+  http_server.SetIOThreads(2u);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ("OK\n", HTTP(GET(Printf("http://localhost:%d/listeners", port))).body);
+  }
+  http_server.SetIOThreads(0u);
+  http_server.SetListeners(2u);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ("OK\n", HTTP(GET(Printf("http://localhost:%d/listeners", port))).body);
+  }
+  http_server.SetListeners(1u);
+  EXPECT_EQ(1u, http_server.Listeners());
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ("OK\n", HTTP(GET(Printf("http://localhost:%d/listeners", port))).body);
+  }
+  EXPECT_EQ(400, served);
+}
+
+TEST(HTTPAPI, SocketOptions) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  const auto scope = http_server.Register("/options", [](Request r) {
+    const current::net::Connection& connection = r.connection.RawConnection();
+    r(Printf("%d\n", connection.GetIntegerOption(IPPROTO_TCP, TCP_NODELAY) ? 1 : 0));
+  });
+  const std::string url = Printf("http://localhost:%d/options", port);
+  EXPECT_EQ("0\n", HTTP(GET(url)).body);
+
+  current::net::SocketOptions options;
+  options.nagle_algorithm = current::net::NagleAlgorithm::Disable;
+  options.receive_buffer_size = 256 * 1024;
+  options.max_queued_connections = current::net::MaxServerQueuedConnectionsValue(128);
+#if defined(CURRENT_POSIX) && !defined(CURRENT_APPLE)
+  options.quick_ack = true;
+  options.defer_accept = std::chrono::seconds(1);
+#endif
+  http_server.SetSocketOptions(options);
+  EXPECT_EQ("1\n", HTTP(GET(url)).body);
+#if defined(CURRENT_POSIX) && !defined(CURRENT_APPLE)
+  // The listeners added later are set up the same way.
+  http_server.SetListeners(3u);
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_EQ("1\n", HTTP(GET(url)).body);
+  }
+  http_server.SetListeners(1u);
+#endif
+
+  // The options not set in the options set later are left as they are.
+  options = current::net::SocketOptions();
+  options.send_buffer_size = 64 * 1024;
+  http_server.SetSocketOptions(options);
+  EXPECT_EQ("1\n", HTTP(GET(url)).body);
+}
+
 TEST(HTTPAPI, ComposeURLPathWithURLPathArgs) {
   auto reserved_port = current::net::ReserveLocalPort();
   const int port = reserved_port;
@@ -1041,6 +1161,24 @@ TEST(HTTPAPI, ChunkedBodySemantics) {
     EXPECT_EQ(200, static_cast<int>(response));
     EXPECT_EQ("foo,meh,baz", current::strings::Join(parsed_body_pieces, ','));
   }
+
+  {
+    // The chunks as views into the receive buffer, alone, and along with the chunks as strings.
+    std::vector<std::string> chunk_views;
+    std::vector<std::string> chunks;
+    const auto response = HTTP(
+        ChunkedGET(url).OnChunkView([&chunk_views](std::string_view s) { chunk_views.emplace_back(s); }));
+    EXPECT_EQ(200, static_cast<int>(response));
+    EXPECT_EQ("{\"s\":|\"foo\"|}\n{\"s\":\"bar\"}\n|{\"s\":\"baz\"}", current::strings::Join(chunk_views, '|'));
+    chunk_views.clear();
+    const auto response_with_both =
+        HTTP(ChunkedPOST(url, "both")
+                 .OnChunkView([&chunk_views](std::string_view s) { chunk_views.emplace_back(s); })
+                 .OnChunk([&chunks](const std::string& s) { chunks.push_back(s); }));
+    EXPECT_EQ(200, static_cast<int>(response_with_both));
+    EXPECT_EQ("{\"s\":|\"foo\"|}\n{\"s\":\"both\"}\n|{\"s\":\"baz\"}", current::strings::Join(chunk_views, '|'));
+    EXPECT_EQ(current::strings::Join(chunk_views, '|'), current::strings::Join(chunks, '|'));
+  }
 }
 
 TEST(HTTPAPI, PostFromBufferToBuffer) {
@@ -1536,6 +1674,122 @@ TEST(HTTPAPI, ServeStaticFilesFrom) {
   EXPECT_EQ(405, static_cast<int>(HTTP(DELETE(Printf("http://localhost:%d/file.html", port))).code));
 }
 
+TEST(HTTPAPI, ServeStaticFilesFromWithSendfileRangesETagsAndPrecompressedFiles) {
+  using namespace current::http;
+
+  FileSystem::MkDir(FLAGS_net_api_test_tmpdir, FileSystem::MkDirParameters::Silent);
+  const std::string dir = FileSystem::JoinPath(FLAGS_net_api_test_tmpdir, "static_sendfile");
+  const auto dir_remover = current::FileSystem::ScopedRmDir(dir);
+  FileSystem::MkDir(dir, FileSystem::MkDirParameters::Silent);
+  FileSystem::WriteStringToFile("<h1>HTML index</h1>", FileSystem::JoinPath(dir, "index.html").c_str());
+  FileSystem::WriteStringToFile("0123456789", FileSystem::JoinPath(dir, "digits.txt").c_str());
+  FileSystem::WriteStringToFile("alert('JavaScript')", FileSystem::JoinPath(dir, "file.js").c_str());
+  FileSystem::WriteStringToFile("fake gzip", FileSystem::JoinPath(dir, "file.js.gz").c_str());
+  FileSystem::WriteStringToFile("fake brotli", FileSystem::JoinPath(dir, "file.js.br").c_str());
+
+  for (bool use_sendfile : {false, true}) {
+    auto reserved_port = current::net::ReserveLocalPort();
+    const int port = reserved_port;
+    auto& http_server = HTTP(std::move(reserved_port));
+
+    ServeStaticFilesFromOptions options;
+    options.use_sendfile = use_sendfile;
+    options.serve_precompressed = true;
+    const auto scope = http_server.ServeStaticFilesFrom(dir, options);
+
+    // The files served as is, along with their entity tags.
+    const auto index_response = HTTP(GET(Printf("http://localhost:%d/", port)));
+    EXPECT_EQ(200, static_cast<int>(index_response.code));
+    EXPECT_EQ("<h1>HTML index</h1>", index_response.body);
+    EXPECT_EQ("text/html", index_response.headers.Get("Content-Type"));
+    ASSERT_TRUE(index_response.headers.Has("ETag"));
+    const std::string etag = index_response.headers.Get("ETag");
+    EXPECT_EQ(etag, HTTP(GET(Printf("http://localhost:%d/index.html", port))).headers.Get("ETag"));
+    EXPECT_FALSE(index_response.headers.Has("Vary"));
+
+    // The conditional requests.
+    {
+      const auto response = HTTP(GET(Printf("http://localhost:%d/", port)).SetHeader("If-None-Match", etag));
+      EXPECT_EQ(304, static_cast<int>(response.code));
+      EXPECT_EQ("", response.body);
+    }
+    {
+      const auto response =
+          HTTP(GET(Printf("http://localhost:%d/", port)).SetHeader("If-None-Match", "\"other\", W/" + etag));
+      EXPECT_EQ(304, static_cast<int>(response.code));
+    }
+    {
+      const auto response = HTTP(GET(Printf("http://localhost:%d/", port)).SetHeader("If-None-Match", "\"other\""));
+      EXPECT_EQ(200, static_cast<int>(response.code));
+      EXPECT_EQ("<h1>HTML index</h1>", response.body);
+    }
+
+    // The ranges.
+    const auto Range = [port](const std::string& range) {
+      return HTTP(GET(Printf("http://localhost:%d/digits.txt", port)).SetHeader("Range", range));
+    };
+    {
+      const auto response = Range("bytes=2-4");
+      EXPECT_EQ(206, static_cast<int>(response.code));
+      EXPECT_EQ("234", response.body);
+      EXPECT_EQ("bytes 2-4/10", response.headers.Get("Content-Range"));
+      EXPECT_EQ("text/plain", response.headers.Get("Content-Type"));
+    }
+    EXPECT_EQ("789", Range("bytes=7-").body);
+    EXPECT_EQ("89", Range("bytes=-2").body);
+    EXPECT_EQ("0123456789", Range("bytes=-20").body);
+    EXPECT_EQ("56789", Range("bytes=5-100").body);
+    EXPECT_EQ("bytes 5-9/10", Range("bytes=5-100").headers.Get("Content-Range"));
+    {
+      const auto response = Range("bytes=10-");
+      EXPECT_EQ(416, static_cast<int>(response.code));
+      EXPECT_EQ("bytes */10", response.headers.Get("Content-Range"));
+    }
+    // The multiple and the malformed ranges result in the full file.
+    EXPECT_EQ(200, static_cast<int>(Range("bytes=0-1,3-4").code));
+    EXPECT_EQ("0123456789", Range("bytes=0-1,3-4").body);
+    EXPECT_EQ("0123456789", Range("bytes=4-2").body);
+    EXPECT_EQ("0123456789", Range("lines=1-2").body);
+    // The range is ignored if the file has changed since the client has seen it.
+    EXPECT_EQ("0123456789",
+              HTTP(GET(Printf("http://localhost:%d/digits.txt", port))
+                       .SetHeader("Range", "bytes=2-4")
+                       .SetHeader("If-Range", "\"outdated\""))
+                  .body);
+
+    // The precompressed files are served in place of the original one, and are not served on their own.
+    const auto Get = [port](const std::string& accept_encoding) {
+      auto request = GET(Printf("http://localhost:%d/file.js", port));
+      if (!accept_encoding.empty()) {
+        request.SetHeader("Accept-Encoding", accept_encoding);
+      }
+      return HTTP(request);
+    };
+    {
+      const auto response = Get("");
+      EXPECT_EQ("alert('JavaScript')", response.body);
+      EXPECT_EQ("Accept-Encoding", response.headers.Get("Vary"));
+      EXPECT_FALSE(response.headers.Has("Content-Encoding"));
+    }
+    {
+      const auto response = Get("gzip, deflate");
+      EXPECT_EQ("fake gzip", response.body);
+      EXPECT_EQ("gzip", response.headers.Get("Content-Encoding"));
+      EXPECT_EQ("application/javascript", response.headers.Get("Content-Type"));
+      EXPECT_NE(etag, response.headers.Get("ETag"));
+    }
+    {
+      const auto response = Get("gzip, deflate, br");
+      EXPECT_EQ("fake brotli", response.body);
+      EXPECT_EQ("br", response.headers.Get("Content-Encoding"));
+    }
+    EXPECT_EQ("fake gzip", Get("br;q=0, gzip;q=0.5").body);
+    EXPECT_EQ("alert('JavaScript')", Get("identity").body);
+    EXPECT_EQ(404, static_cast<int>(HTTP(GET(Printf("http://localhost:%d/file.js.gz", port))).code));
+    EXPECT_EQ(404, static_cast<int>(HTTP(GET(Printf("http://localhost:%d/file.js.br", port))).code));
+  }
+}
+
 TEST(HTTPAPI, ServeStaticFilesFromOptionsCustomRoutePrefix) {
   using namespace current::http;
 
@@ -1951,6 +2205,1027 @@ TEST(HTTPAPI, PayloadTooLarge) {
   }
 }
 
+TEST(HTTPAPI, ServesViaEventLoop) {
+  using current::http::impl::IsPrefetchedHTTPRequestComplete;
+  EXPECT_FALSE(IsPrefetchedHTTPRequestComplete("GET / HTTP/1.1\r\nHost: localhost\r\n"));
+  EXPECT_TRUE(IsPrefetchedHTTPRequestComplete("GET / HTTP/1.1\r\nHost: localhost\r\n\r\n"));
+  EXPECT_TRUE(IsPrefetchedHTTPRequestComplete("\r\nGET / HTTP/1.1\r\n\r\n"));
+  EXPECT_FALSE(IsPrefetchedHTTPRequestComplete("POST / HTTP/1.1\r\nContent-Length: 5\r\n\r\nabc"));
+  EXPECT_TRUE(IsPrefetchedHTTPRequestComplete("POST / HTTP/1.1\r\ncontent-length: 5\r\n\r\nabcde"));
+  EXPECT_TRUE(IsPrefetchedHTTPRequestComplete("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"));
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  EXPECT_EQ(0u, http_server.IOThreads());
+
+  std::atomic_bool first_started(false);
+  std::atomic_bool second_served(false);
+  HTTPRoutesScope scope;
+  scope += http_server.Register("/first", [&](Request r) {
+    first_started = true;
+    while (!second_served) {
+      std::this_thread::yield();
+    }
+    r("first\n");
+  });
+  scope += http_server.Register("/second", [&](Request r) {
+    second_served = true;
+    r("second\n");
+  });
+  scope += http_server.Register("/echo", [](Request r) { r(r.body); });
+
+  const auto ReadResponse = [](current::net::Connection& connection) {
+    std::string response;
+    char buffer[1024];
+    try {
+      size_t read_count;
+      while ((read_count = connection.BlockingRead(buffer, sizeof(buffer)))) {
+        response.append(buffer, read_count);
+      }
+    } catch (const current::Exception&) {
+      // The server closes the connection once it has responded.
+    }
+    return response;
+  };
+
+  // The requests are served concurrently.
+  http_server.SetIOThreads(4u);
+  EXPECT_EQ(4u, http_server.IOThreads());
+  {
+    std::thread first([port]() { EXPECT_EQ("first\n", HTTP(GET(Printf("http://localhost:%d/first", port))).body); });
+    while (!first_started) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ("second\n", HTTP(GET(Printf("http://localhost:%d/second", port))).body);
+    first.join();
+  }
+
+  // A client slow to send its request does not hold back the others, even with a single thread to serve them.
+  http_server.SetIOThreads(1u, std::chrono::milliseconds(200));
+  {
+    current::net::Connection slow(current::net::ClientSocket("localhost", port));
+    slow.BlockingWrite("POST /echo HTTP/1.1\r\nContent-Length: 5\r\n\r\nab", true);
+    EXPECT_EQ("second\n", HTTP(GET(Printf("http://localhost:%d/second", port))).body);
+    EXPECT_EQ("Posted.", HTTP(POST(Printf("http://localhost:%d/echo", port), "Posted.")).body);
+    slow.BlockingWrite("cde", false);
+    const std::string response = ReadResponse(slow);
+    EXPECT_EQ("HTTP/1.1 200 OK\r\n", response.substr(0u, 17u));
+    EXPECT_EQ("\r\n\r\nabcde", response.substr(response.length() - 9u));
+  }
+
+  // A client that does not send its request in full in time is disconnected.
+  {
+    current::net::Connection slow(current::net::ClientSocket("localhost", port));
+    slow.BlockingWrite("GET /second HTTP/1.1\r\n", false);
+    EXPECT_EQ("", ReadResponse(slow));
+  }
+
+  http_server.SetIOThreads(0u);
+  EXPECT_EQ(0u, http_server.IOThreads());
+  EXPECT_EQ("second\n", HTTP(GET(Printf("http://localhost:%d/second", port))).body);
+}
+
+TEST(HTTPAPI, KeepAlive) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+
+  HTTPRoutesScope scope;
+  scope += http_server.Register("/port", [](Request r) {
+    r(current::ToString(r.connection.RemoteIPAndPort().port));
+  });
+  scope += http_server.Register("/chunked", [](Request r) { r.connection.SendChunkedHTTPResponse().Send("chunk"); });
+
+  const auto ReadResponses = [](current::net::Connection& connection) {
+    std::string response;
+    char buffer[1024];
+    try {
+      size_t read_count;
+      while ((read_count = connection.BlockingRead(buffer, sizeof(buffer)))) {
+        response.append(buffer, read_count);
+      }
+    } catch (const current::Exception&) {
+      // The server closes the connection once it is done with it.
+    }
+    return response;
+  };
+  const auto CountOccurrences = [](const std::string& haystack, const std::string& needle) {
+    size_t result = 0u;
+    for (size_t i = haystack.find(needle); i != std::string::npos; i = haystack.find(needle, i + 1u)) {
+      ++result;
+    }
+    return result;
+  };
+
+  // Not kept open by default.
+  http_server.SetIOThreads(2u);
+  {
+    current::net::Connection connection(current::net::ClientSocket("localhost", port));
+    connection.BlockingWrite("GET /port HTTP/1.1\r\n\r\nGET /port HTTP/1.1\r\n\r\n", false);
+    const std::string response = ReadResponses(connection);
+    EXPECT_EQ(1u, CountOccurrences(response, "HTTP/1.1 200 OK")) << response;
+    EXPECT_EQ(1u, CountOccurrences(response, "Connection: close")) << response;
+  }
+
+  // The pipelined requests are served in order on the connection kept open, until the client asks to close it.
+  http_server.SetKeepAlive(std::chrono::seconds(10));
+  {
+    current::net::Connection connection(current::net::ClientSocket("localhost", port));
+    connection.BlockingWrite(
+        "GET /port HTTP/1.1\r\n\r\nGET /port HTTP/1.1\r\n\r\nGET /port HTTP/1.1\r\nConnection: close\r\n\r\n", false);
+    const std::string response = ReadResponses(connection);
+    EXPECT_EQ(3u, CountOccurrences(response, "HTTP/1.1 200 OK")) << response;
+    EXPECT_EQ(2u, CountOccurrences(response, "Connection: keep-alive")) << response;
+    EXPECT_EQ(1u, CountOccurrences(response, "Connection: close")) << response;
+    EXPECT_EQ(3u, CountOccurrences(response, "\r\n\r\n" + current::ToString(connection.LocalIPAndPort().port)))
+        << response;
+  }
+
+  // A burst of pipelined requests is served in order, both by the handlers that respond right away and by those
+  // that respond later, from another thread.
+  scope += http_server.Register("/index", [](Request r) { r(r.url.query["i"]); });
+  scope += http_server.Register("/later", [](Request r) {
+    std::thread([](Request r) { r(r.url.query["i"]); }, std::move(r)).detach();
+  });
+  for (const std::string path : {"/index", "/later"}) {
+    current::net::Connection connection(current::net::ClientSocket("localhost", port));
+    std::string requests;
+    std::string expected_bodies;
+    for (int i = 0; i < 50; ++i) {
+      requests += "GET " + path + "?i=" + current::ToString(i) + " HTTP/1.1\r\n";
+      requests += (i == 49) ? "Connection: close\r\n\r\n" : "\r\n";
+      expected_bodies += current::ToString(i) + ',';
+    }
+    connection.BlockingWrite(requests, false);
+    const std::string response = ReadResponses(connection);
+    EXPECT_EQ(50u, CountOccurrences(response, "HTTP/1.1 200 OK")) << response;
+    std::string bodies;
+    for (size_t i = response.find("\r\n\r\n"); i != std::string::npos; i = response.find("\r\n\r\n", i + 1u)) {
+      const size_t end = response.find("HTTP/1.1", i);
+      bodies += response.substr(i + 4u, (end == std::string::npos ? response.length() : end) - i - 4u) + ',';
+    }
+    EXPECT_EQ(expected_bodies, bodies) << path;
+  }
+
+  // HTTP/1.0 clients have to ask for the connection to be kept open, and the chunked responses close it.
+  {
+    current::net::Connection connection(current::net::ClientSocket("localhost", port));
+    connection.BlockingWrite(
+        "GET /port HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\nGET /chunked HTTP/1.1\r\n\r\nGET /port HTTP/1.1\r\n\r\n",
+        false);
+    const std::string response = ReadResponses(connection);
+    EXPECT_EQ(2u, CountOccurrences(response, "HTTP/1.1 200 OK")) << response;
+    EXPECT_EQ(1u, CountOccurrences(response, "\r\nchunk\r\n")) << response;
+  }
+  {
+    current::net::Connection connection(current::net::ClientSocket("localhost", port));
+    connection.BlockingWrite("GET /port HTTP/1.0\r\n\r\nGET /port HTTP/1.0\r\n\r\n", false);
+    const std::string response = ReadResponses(connection);
+    EXPECT_EQ(1u, CountOccurrences(response, "HTTP/1.1 200 OK")) << response;
+    EXPECT_EQ(1u, CountOccurrences(response, "Connection: close")) << response;
+  }
+
+  // The client reuses the connections kept open.
+  auto& pool = current::http::HTTPClientConnections();
+  pool.SetMaxIdleConnectionsPerHost(2u);
+  {
+    const std::string url = Printf("http://localhost:%d/port", port);
+    const std::string first = HTTP(GET(url)).body;
+    EXPECT_EQ(first, HTTP(GET(url)).body);
+    EXPECT_EQ(first, HTTP(POST(url, "body")).body);
+    EXPECT_EQ(1u, pool.IdleConnectionsCount());
+
+    // Up to the maximum number of requests per connection.
+    http_server.SetKeepAlive(std::chrono::seconds(10), 2u);
+    pool.Clear();
+    const std::string second = HTTP(GET(url)).body;
+    EXPECT_NE(first, second);
+    EXPECT_EQ(second, HTTP(GET(url)).body);
+    EXPECT_EQ(0u, pool.IdleConnectionsCount());
+    const std::string third = HTTP(GET(url)).body;
+    EXPECT_NE(second, third);
+
+    // The connections closed by the server as idle are not reused.
+    http_server.SetKeepAlive(std::chrono::milliseconds(50));
+    pool.Clear();
+    const std::string fourth = HTTP(GET(url)).body;
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    const std::string fifth = HTTP(GET(url)).body;
+    EXPECT_NE(fourth, fifth);
+  }
+  pool.SetMaxIdleConnectionsPerHost(0u);
+  EXPECT_EQ(0u, pool.IdleConnectionsCount());
+
+  http_server.SetKeepAlive(std::chrono::milliseconds(0));
+  http_server.SetIOThreads(0u);
+}
+
+// A bare HTTP/2 client, to test the HTTP/2 mode of the server frame by frame.
+class HTTP2TestClient final {
+ public:
+  struct StreamResponse {
+    std::string status;
+    std::string body;
+    bool ended = false;
+  };
+
+  explicit HTTP2TestClient(int port, const std::string& settings_payload = "")
+      : connection_(current::net::ClientSocket("localhost", static_cast<uint16_t>(port))) {
+    using namespace current::net::http2;
+    connection_.BlockingWrite(kConnectionPreface + SerializeFrame(FrameType::Settings, 0u, 0u, settings_payload),
+                              false);
+  }
+
+  void Request(uint32_t stream_id,
+               const std::string& method,
+               const std::string& path,
+               const std::string& body = "",
+               const current::net::http2::HeaderList& extra_headers = {}) {
+    using namespace current::net::http2;
+    HeaderList headers = {{":method", method}, {":scheme", "http"}, {":path", path}, {":authority", "localhost"}};
+    headers.insert(headers.end(), extra_headers.begin(), extra_headers.end());
+    std::string frames = SerializeFrame(
+        FrameType::Headers, kFlagEndHeaders | (body.empty() ? kFlagEndStream : 0u), stream_id, encoder_.Encode(headers));
+    if (!body.empty()) {
+      frames += SerializeFrame(FrameType::Data, kFlagEndStream, stream_id, body);
+    }
+    connection_.BlockingWrite(frames, false);
+  }
+
+  void WindowUpdate(uint32_t stream_id, uint32_t increment) {
+    using namespace current::net::http2;
+    connection_.BlockingWrite(SerializeFrame(FrameType::WindowUpdate, 0u, stream_id, UInt32Payload(increment)), false);
+  }
+
+  // Reads the frames until `stream_id` has received `body_bytes` of its body, or has ended, if zero.
+  // Returns the IDs of the streams in the order they have ended in.
+  std::vector<uint32_t> ReadUntil(uint32_t stream_id, size_t body_bytes = 0u) {
+    using namespace current::net::http2;
+    std::vector<uint32_t> ended;
+    while (!(body_bytes ? responses[stream_id].body.length() >= body_bytes : responses[stream_id].ended)) {
+      uint8_t header[kFrameHeaderLength];
+      connection_.BlockingRead(header, kFrameHeaderLength, Connection::FillFullBuffer);
+      const FrameHeader frame = FrameHeader::Parse(header);
+      std::string payload(frame.length, '\0');
+      if (frame.length) {
+        connection_.BlockingRead(&payload[0], frame.length, Connection::FillFullBuffer);
+      }
+      if (frame.type == FrameType::Headers) {
+        for (const auto& h : decoder_.Decode(payload)) {
+          if (h.first == ":status") {
+            responses[frame.stream_id].status = h.second;
+          }
+        }
+      } else if (frame.type == FrameType::Data) {
+        responses[frame.stream_id].body += payload;
+      } else if (frame.type == FrameType::RSTStream) {
+        responses[frame.stream_id].status = "RST_STREAM " + current::ToString(ReadUInt32(
+            reinterpret_cast<const uint8_t*>(payload.data())));
+        responses[frame.stream_id].ended = true;
+        ended.push_back(frame.stream_id);
+      }
+      if ((frame.type == FrameType::Headers || frame.type == FrameType::Data) && frame.HasFlag(kFlagEndStream)) {
+        responses[frame.stream_id].ended = true;
+        ended.push_back(frame.stream_id);
+      }
+    }
+    return ended;
+  }
+
+  std::map<uint32_t, StreamResponse> responses;
+
+ private:
+  Connection connection_;
+  current::net::http2::HPACKEncoder encoder_;
+  current::net::http2::HPACKDecoder decoder_;
+};
+
+TEST(HTTPAPI, HTTP2) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  http_server.EnableHTTP2();
+
+  HTTPRoutesScope scope;
+  std::promise<void> b_called;
+  std::shared_future<void> b_called_future = b_called.get_future().share();
+  // `/a` only responds once `/b` has responded, so both have to be served at once over the same connection.
+  scope += http_server.Register("/a", [b_called_future](Request r) {
+    b_called_future.wait();
+    r("a");
+  });
+  scope += http_server.Register("/b", [&b_called](Request r) {
+    r("b");
+    b_called.set_value();
+  });
+  scope += http_server.Register("/chunks", [](Request r) {
+    auto response = r.connection.SendChunkedHTTPResponse();
+    response.Send("one\n");
+    response.Send("two\n");
+  });
+  scope += http_server.Register("/echo", [](Request r) {
+    r(r.method + ' ' + r.body + ' ' + r.headers.GetOrDefault("X-Test", "") + ' ' + r.headers.Get("Host"));
+  });
+  scope += http_server.Register("/large", [](Request r) { r(std::string(100000u, 'x')); });
+
+  {
+    HTTP2TestClient client(port);
+    client.Request(1u, "GET", "/a");
+    client.Request(3u, "GET", "/b");
+    client.Request(5u, "GET", "/chunks");
+    client.Request(7u, "POST", "/echo", "body", {{"x-test", "passed"}});
+    client.Request(9u, "GET", "/nope");
+    std::vector<uint32_t> ended = client.ReadUntil(1u);
+    EXPECT_TRUE(std::find(ended.begin(), ended.end(), 3u) < std::find(ended.begin(), ended.end(), 1u));
+    for (uint32_t stream_id : {3u, 5u, 7u, 9u}) {
+      client.ReadUntil(stream_id);
+    }
+    EXPECT_EQ("200", client.responses[1u].status);
+    EXPECT_EQ("a", client.responses[1u].body);
+    EXPECT_EQ("200", client.responses[3u].status);
+    EXPECT_EQ("b", client.responses[3u].body);
+    EXPECT_EQ("200", client.responses[5u].status);
+    EXPECT_EQ("one\ntwo\n", client.responses[5u].body);
+    EXPECT_EQ("200", client.responses[7u].status);
+    EXPECT_EQ("POST body passed localhost", client.responses[7u].body);
+    EXPECT_EQ("404", client.responses[9u].status);
+
+    // The headers with the characters not allowed in the field values, RFC 7540 §10.3, are rejected.
+    client.Request(11u, "GET", "/b", "", {{"x-test", "1\r\n\r\nGET /a HTTP/1.1"}});
+    client.ReadUntil(11u);
+    EXPECT_EQ("RST_STREAM 1", client.responses[11u].status);
+
+    // The response to `HEAD` is the headers alone.
+    client.Request(13u, "HEAD", "/large");
+    client.ReadUntil(13u);
+    EXPECT_EQ("200", client.responses[13u].status);
+    EXPECT_EQ("", client.responses[13u].body);
+  }
+
+  // The response is only sent as fast as the client lets it, via the flow control.
+  {
+    HTTP2TestClient client(port,
+                           current::net::http2::SettingsPayload({{current::net::http2::Setting::InitialWindowSize, 1000u}}));
+    client.Request(1u, "GET", "/large");
+    client.ReadUntil(1u, 1000u);
+    EXPECT_FALSE(client.responses[1u].ended);
+    EXPECT_EQ(1000u, client.responses[1u].body.length());
+    // The window of the connection, of 65535 bytes, is the limit past the one of the stream.
+    client.WindowUpdate(1u, 1000000u);
+    client.ReadUntil(1u, 65535u);
+    EXPECT_FALSE(client.responses[1u].ended);
+    EXPECT_EQ(65535u, client.responses[1u].body.length());
+    client.WindowUpdate(0u, 1000000u);
+    client.ReadUntil(1u);
+    EXPECT_EQ(std::string(100000u, 'x'), client.responses[1u].body);
+  }
+}
+
+TEST(HTTPAPI, WorkerPool) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+
+  std::atomic_bool release(false);
+  std::atomic_int blocked(0);
+  std::atomic_int limited_running(0);
+  std::atomic_int limited_max_running(0);
+  const auto Block = [&]() {
+    ++blocked;
+    while (!release) {
+      std::this_thread::yield();
+    }
+    --blocked;
+  };
+
+  {
+    current::http::HTTPWorkerPool pool(3u, 2u);
+    EXPECT_EQ(3u, pool.ThreadsCount());
+    HTTPRoutesScope scope;
+    scope += http_server.Register("/limited", pool.Route([&](Request r) {
+      const int running = ++limited_running;
+      int max_running = limited_max_running;
+      while (running > max_running && !limited_max_running.compare_exchange_weak(max_running, running)) {
+      }
+      Block();
+      --limited_running;
+      r("limited\n");
+    }, 1u));
+    scope += http_server.Register("/free", pool.Route([](Request r) { r("free\n"); }));
+    http_server.SetIOThreads(4u);
+    const auto LimitedRequest = [port]() {
+      EXPECT_EQ("limited\n", HTTP(GET(Printf("http://localhost:%d/limited", port))).body);
+    };
+
+    // The second request to the route limited to one at a time waits, while the other routes are served.
+    std::thread first([&LimitedRequest]() { LimitedRequest(); });
+    while (blocked != 1) {
+      std::this_thread::yield();
+    }
+    std::thread second([&LimitedRequest]() { LimitedRequest(); });
+    while (pool.Metrics().queued != 1u) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ("free\n", HTTP(GET(Printf("http://localhost:%d/free", port))).body);
+
+    // The queue holds up to two requests, the ones over it are rejected with 503.
+    std::thread third([&LimitedRequest]() { LimitedRequest(); });
+    while (pool.Metrics().queued != 2u) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ(503, static_cast<int>(HTTP(GET(Printf("http://localhost:%d/free", port))).code));
+
+    release = true;
+    first.join();
+    second.join();
+    third.join();
+    EXPECT_EQ(1, limited_max_running);
+
+    // The handlers respond before they return, and only once they return are their requests counted as served.
+    while (pool.Metrics().served != 4u) {
+      std::this_thread::yield();
+    }
+    const auto metrics = pool.Metrics();
+    EXPECT_EQ(3u, metrics.threads);
+    EXPECT_EQ(0u, metrics.queued);
+    EXPECT_EQ(0u, metrics.running);
+    EXPECT_EQ(4u, metrics.served);
+    EXPECT_EQ(1u, metrics.rejected);
+    EXPECT_LE(metrics.max_queue_time, metrics.total_queue_time);
+    EXPECT_GT(metrics.max_queue_time.count(), 0);
+  }
+
+  // All the routes of the server can be run on the pool as well.
+  {
+    const auto serving_thread = std::this_thread::get_id();
+    HTTPRoutesScope scope;
+    scope += http_server.Register("/thread", [serving_thread](Request r) {
+      r(std::this_thread::get_id() == serving_thread ? "same\n" : "other\n");
+    });
+    EXPECT_EQ(0u, http_server.WorkerThreads());
+    http_server.SetWorkerThreads(2u);
+    EXPECT_EQ(2u, http_server.WorkerThreads());
+    EXPECT_EQ("other\n", HTTP(GET(Printf("http://localhost:%d/thread", port))).body);
+    EXPECT_EQ("other\n", HTTP(GET(Printf("http://localhost:%d/thread", port))).body);
+    while (http_server.WorkerPoolMetrics().served != 2u) {
+      std::this_thread::yield();
+    }
+    http_server.SetWorkerThreads(0u);
+    EXPECT_EQ(0u, http_server.WorkerThreads());
+    EXPECT_EQ(0u, http_server.WorkerPoolMetrics().served);
+  }
+  http_server.SetIOThreads(0u);
+}
+
+TEST(HTTPAPI, AdmissionControlAndLoadShedding) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+
+  std::mutex held_mutex;
+  std::vector<std::unique_ptr<Request>> held;
+  const auto Hold = [&](Request r) {
+    std::lock_guard<std::mutex> lock(held_mutex);
+    held.push_back(std::make_unique<Request>(std::move(r)));
+  };
+  const auto HeldCount = [&]() {
+    std::lock_guard<std::mutex> lock(held_mutex);
+    return held.size();
+  };
+
+  {
+    HTTPRoutesScope scope;
+    scope += http_server.Register("/held", Hold);
+    scope += http_server.Register("/other", Hold);
+    scope += http_server.Register("/free", [](Request r) { r("free\n"); });
+    http_server.SetIOThreads(4u);
+    current::http::HTTPAdmissionLimits limits;
+    limits.max_in_flight = 3u;
+    limits.max_in_flight_by_route["/held"] = 2u;
+    limits.retry_after = std::chrono::seconds(7);
+    http_server.SetAdmissionLimits(limits);
+
+    const auto Get = [port](const std::string& path) { return HTTP(GET(Printf("http://localhost:%d", port) + path)); };
+    std::vector<std::thread> clients;
+    for (int i = 0; i < 2; ++i) {
+      clients.emplace_back([&Get]() { EXPECT_EQ("held\n", Get("/held").body); });
+    }
+    while (HeldCount() != 2u) {
+      std::this_thread::yield();
+    }
+
+    // The route is at its own limit, while the others are not.
+    const auto rejected_by_route = Get("/held");
+    EXPECT_EQ(503, static_cast<int>(rejected_by_route.code));
+    EXPECT_EQ("7", rejected_by_route.headers.Get("Retry-After"));
+    EXPECT_EQ("free\n", Get("/free").body);
+
+    // With one more request in flight the server is at its total limit, and rejects the requests to any route.
+    clients.emplace_back([&Get]() { EXPECT_EQ("held\n", Get("/other").body); });
+    while (HeldCount() != 3u) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ(503, static_cast<int>(Get("/free").code));
+    EXPECT_EQ(3u, http_server.AdmissionMetrics().in_flight);
+
+    // Once responded to, the requests are no longer in flight.
+    {
+      std::lock_guard<std::mutex> lock(held_mutex);
+      for (auto& r : held) {
+        (*r)("held\n");
+      }
+      held.clear();
+    }
+    for (std::thread& client : clients) {
+      client.join();
+    }
+    EXPECT_EQ("free\n", Get("/free").body);
+    const auto metrics = http_server.AdmissionMetrics();
+    EXPECT_EQ(0u, metrics.in_flight);
+    EXPECT_EQ(5u, metrics.admitted);
+    EXPECT_EQ(1u, metrics.rejected);
+    EXPECT_EQ(1u, metrics.rejected_by_route);
+  }
+
+  // The requests that have waited for a thread of the worker pool for too long are shed.
+  {
+    std::atomic_bool release(false);
+    std::atomic_bool blocked(false);
+    HTTPRoutesScope scope;
+    scope += http_server.Register("/slow", [&](Request r) {
+      blocked = true;
+      while (!release) {
+        std::this_thread::yield();
+      }
+      r("slow\n");
+    });
+    http_server.SetWorkerThreads(1u, 1000u, std::chrono::milliseconds(50), std::chrono::seconds(2));
+    std::thread first([port]() { EXPECT_EQ("slow\n", HTTP(GET(Printf("http://localhost:%d/slow", port))).body); });
+    while (!blocked) {
+      std::this_thread::yield();
+    }
+    std::thread second([port]() {
+      const auto response = HTTP(GET(Printf("http://localhost:%d/slow", port)));
+      EXPECT_EQ(503, static_cast<int>(response.code));
+      EXPECT_EQ("2", response.headers.Get("Retry-After"));
+    });
+    while (http_server.WorkerPoolMetrics().queued != 1u) {
+      std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    release = true;
+    first.join();
+    second.join();
+    EXPECT_EQ(1u, http_server.WorkerPoolMetrics().shed);
+    http_server.SetWorkerThreads(0u);
+  }
+
+  http_server.SetAdmissionLimits(current::http::HTTPAdmissionLimits());
+  http_server.SetIOThreads(0u);
+}
+
+TEST(HTTPAPI, AsyncClient) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  const std::string base_url = Printf("http://localhost:%d", port);
+
+  std::mutex held_mutex;
+  std::vector<std::unique_ptr<Request>> held;
+  const auto HeldCount = [&]() {
+    std::lock_guard<std::mutex> lock(held_mutex);
+    return held.size();
+  };
+  HTTPRoutesScope scope;
+  scope += http_server.Register("/held", [&](Request r) {
+    std::lock_guard<std::mutex> lock(held_mutex);
+    held.push_back(std::make_unique<Request>(std::move(r)));
+  });
+  scope += http_server.Register("/echo", [](Request r) { r(r.method + ' ' + r.body + r.url.query["q"]); });
+  scope += http_server.Register("/port", [](Request r) { r(current::ToString(r.connection.RemoteIPAndPort().port)); });
+  scope += http_server.Register("/redirect", [](Request r) {
+    r("", HTTPResponseCode.Found, current::net::http::Headers({{"Location", "/echo?q=redirected"}}));
+  });
+  http_server.SetIOThreads(4u);
+
+  // Many requests are outstanding at once on the two threads of the client.
+  {
+    current::http::HTTPAsyncClient client(2u);
+    std::vector<std::future<current::http::HTTPResponseWithBuffer>> responses;
+    for (int i = 0; i < 50; ++i) {
+      responses.push_back(client.Send(GET(base_url + "/held")));
+    }
+    while (HeldCount() != 50u) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ(50u, client.InFlight());
+    {
+      std::lock_guard<std::mutex> lock(held_mutex);
+      for (size_t i = 0u; i < held.size(); ++i) {
+        (*held[i])(current::ToString(i));
+      }
+      held.clear();
+    }
+    std::set<std::string> bodies;
+    for (auto& response : responses) {
+      const auto r = response.get();
+      EXPECT_EQ(200, static_cast<int>(r.code));
+      bodies.insert(r.body);
+    }
+    EXPECT_EQ(50u, bodies.size());
+    EXPECT_EQ(0u, client.InFlight());
+
+    // The requests and the responses are those of `HTTP()`.
+    EXPECT_EQ("POST body", client.Send(POST(base_url + "/echo", "body")).get().body);
+    EXPECT_EQ("GET redirected", client.Send(GET(base_url + "/redirect").AllowRedirects()).get().body);
+    EXPECT_EQ(base_url + "/echo?q=redirected", client.Send(GET(base_url + "/redirect").AllowRedirects()).get().url);
+    EXPECT_THROW(client.Send(GET(base_url + "/redirect")).get(), current::net::HTTPRedirectNotAllowedException);
+    EXPECT_EQ(200, static_cast<int>(client.Send(HEAD(base_url + "/echo")).get().code));
+    EXPECT_EQ(404, static_cast<int>(client.Send(GET(base_url + "/nope")).get().code));
+
+    // The callbacks are called on the threads of the client.
+    std::promise<std::string> callback;
+    client.Send(PUT(base_url + "/echo", "put"),
+                [&callback](current::http::HTTPResponseWithBuffer&& response) { callback.set_value(response.body); },
+                [&callback](std::exception_ptr e) { callback.set_exception(e); });
+    EXPECT_EQ("PUT put", callback.get_future().get());
+  }
+
+  // The connections kept open are reused.
+  {
+    http_server.SetKeepAlive(std::chrono::seconds(10));
+    auto& pool = current::http::HTTPClientConnections();
+    pool.SetMaxIdleConnectionsPerHost(2u);
+    current::http::HTTPAsyncClient client(1u);
+    const std::string first = client.Send(GET(base_url + "/port")).get().body;
+    EXPECT_EQ(first, client.Send(GET(base_url + "/port")).get().body);
+    EXPECT_EQ(first, HTTP(GET(base_url + "/port")).body);
+    EXPECT_EQ(1u, pool.IdleConnectionsCount());
+    pool.SetMaxIdleConnectionsPerHost(0u);
+    http_server.SetKeepAlive(std::chrono::milliseconds(0));
+  }
+
+  // The requests not responded to in time, or at all, fail.
+  {
+    current::http::HTTPAsyncClient client(1u, std::chrono::milliseconds(100));
+    auto timed_out = client.Send(GET(base_url + "/held"));
+    EXPECT_THROW(timed_out.get(), current::net::HTTPResponseTimeoutException);
+    std::lock_guard<std::mutex> lock(held_mutex);
+    held.clear();
+  }
+  {
+    std::future<current::http::HTTPResponseWithBuffer> shut_down;
+    {
+      current::http::HTTPAsyncClient client(1u);
+      shut_down = client.Send(GET(base_url + "/held"));
+      while (HeldCount() != 1u) {
+        std::this_thread::yield();
+      }
+    }
+    EXPECT_THROW(shut_down.get(), current::net::HTTPClientShutDownException);
+    std::lock_guard<std::mutex> lock(held_mutex);
+    held.clear();
+  }
+  {
+    current::http::HTTPAsyncClient client(1u);
+    EXPECT_THROW(client.Send(GET("http://999.999.999.999/")).get(), SocketResolveAddressException);
+  }
+
+  http_server.SetIOThreads(0u);
+}
+
+TEST(HTTPAPI, ResponseCompression) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  const std::string base_url = Printf("http://localhost:%d", port);
+  const auto ContentEncoding = [](const current::net::http::Headers& headers) {
+    return headers.GetOrDefault("Content-Encoding", "identity");
+  };
+
+  std::string large;
+  for (int i = 0; i < 1000; ++i) {
+    large += "{\"index\":" + current::ToString(i) + ",\"text\":\"Repetitive, and thus well compressible.\"}\n";
+  }
+  HTTPRoutesScope scope;
+  scope += http_server.Register("/large", [&large](Request r) { r(large, HTTPResponseCode.OK, "application/json"); });
+  scope += http_server.Register("/small", [](Request r) { r("small\n", HTTPResponseCode.OK, "application/json"); });
+  scope += http_server.Register("/binary",
+                                [&large](Request r) { r(large, HTTPResponseCode.OK, "application/octet-stream"); });
+  scope += http_server.Register("/chunked", [](Request r) {
+    auto response =
+        r.connection.SendChunkedHTTPResponse(HTTPResponseCode.OK, current::net::http::Headers(), "text/plain");
+    for (int i = 0; i < 100; ++i) {
+      response.Send("Chunk " + current::ToString(i) + ", flushed for the client to decompress right away.\n");
+    }
+  });
+
+  // Not compressed by default.
+  EXPECT_EQ("identity", ContentEncoding(HTTP(GET(base_url + "/large").AcceptCompressed()).headers));
+
+  http_server.SetCompression();
+  {
+    // The client asks for the compressed response, and decompresses it. Not unless asked to, though.
+    const auto response = HTTP(GET(base_url + "/large").AcceptCompressed());
+    EXPECT_EQ(200, static_cast<int>(response.code));
+    EXPECT_EQ("gzip", ContentEncoding(response.headers));
+    EXPECT_EQ("Accept-Encoding", response.headers.Get("Vary"));
+    EXPECT_EQ(large, response.body);
+    EXPECT_EQ("identity", ContentEncoding(HTTP(GET(base_url + "/large")).headers));
+  }
+  {
+    // With `Accept-Encoding` set by the user, the response is returned as is.
+    const auto response = HTTP(GET(base_url + "/large").SetHeader("Accept-Encoding", "deflate;q=0.5, br"));
+    EXPECT_EQ("deflate", ContentEncoding(response.headers));
+    EXPECT_LT(response.body.length() * 10u, large.length());
+    EXPECT_EQ(large, current::DeflateDecompress(response.body, current::DeflateFormat::Zlib));
+  }
+  {
+    const auto response = HTTP(GET(base_url + "/large").SetHeader("Accept-Encoding", "identity"));
+    EXPECT_EQ("identity", ContentEncoding(response.headers));
+    EXPECT_EQ(large, response.body);
+  }
+  {
+    // The small responses, and the responses of the content types not allowed, are not compressed.
+    const auto small = HTTP(GET(base_url + "/small").AcceptCompressed());
+    EXPECT_EQ("identity", ContentEncoding(small.headers));
+    EXPECT_EQ("small\n", small.body);
+    const auto binary = HTTP(GET(base_url + "/binary").AcceptCompressed());
+    EXPECT_EQ("identity", ContentEncoding(binary.headers));
+    EXPECT_EQ(large, binary.body);
+  }
+  {
+    // The chunked responses are compressed as one stream, flushed with every chunk.
+    std::map<std::string, std::string> headers;
+    std::vector<std::string> chunks;
+    current::http::GenericHTTPClientPOSIX<ChunkByChunkHTTPResponseReceiver> client(
+        ChunkByChunkHTTPResponseReceiver::ConstructionParams(
+            [&headers](const std::string& k, const std::string& v) { headers[k] = v; },
+            [&chunks](const std::string& s) { chunks.push_back(s); },
+            []() {}));
+    client.request_method_ = "GET";
+    client.request_url_ = base_url + "/chunked";
+    client.request_headers_.Set("Accept-Encoding", "gzip");
+    ASSERT_TRUE(client.Go());
+    EXPECT_EQ("gzip", headers["Content-Encoding"]);
+    ASSERT_EQ(101u, chunks.size());
+    const std::string sync_flush("\x00\x00\xff\xff", 4u);
+    for (size_t i = 0u; i < 100u; ++i) {
+      EXPECT_EQ(sync_flush, chunks[i].substr(chunks[i].length() - 4u)) << i;
+    }
+    const std::string decompressed = current::DeflateDecompress(current::strings::Join(chunks, ""));
+    EXPECT_EQ(100, std::count(decompressed.begin(), decompressed.end(), '\n'));
+    EXPECT_EQ("Chunk 0, flushed for the client to decompress right away.\n", decompressed.substr(0u, 58u));
+  }
+
+  // The options can be changed, and compression can be turned off.
+  current::net::HTTPCompressionOptions options;
+  options.content_types = {"application/octet-stream"};
+  http_server.SetCompression(options);
+  EXPECT_EQ("gzip", ContentEncoding(HTTP(GET(base_url + "/binary").AcceptCompressed()).headers));
+  EXPECT_EQ(large, HTTP(GET(base_url + "/binary").AcceptCompressed()).body);
+  EXPECT_EQ("identity", ContentEncoding(HTTP(GET(base_url + "/large").AcceptCompressed()).headers));
+  http_server.DisableCompression();
+  EXPECT_EQ("identity", ContentEncoding(HTTP(GET(base_url + "/binary").AcceptCompressed()).headers));
+}
+
+CURRENT_STRUCT(HTTPAPITestObjects) { CURRENT_FIELD(items, std::vector<HTTPAPITestObject>); };
+
+TEST(HTTPAPI, LargeJSONResponseIsSentAsItIsSerialized) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  const std::string base_url = Printf("http://localhost:%d", port);
+
+  HTTPAPITestObjects large;
+  for (int i = 0; i < 10000; ++i) {
+    large.items.emplace_back(i, "Item " + current::ToString(i), std::vector<int>{i, i + 1});
+  }
+  const std::string large_json = JSON(large) + '\n';
+  ASSERT_GT(large_json.length(), static_cast<size_t>(4 * CURRENT_BRICKS_HTTP_JSON_RESPONSE_PIECE_SIZE));
+
+  HTTPRoutesScope scope;
+  scope += http_server.Register("/small", [](Request r) { r(HTTPAPITestObject()); });
+  scope += http_server.Register("/large", [&large](Request r) { r(large, HTTPResponseCode.Created); });
+
+  {
+    // The JSON that fits in one piece is responded with as is.
+    const auto response = HTTP(GET(base_url + "/small"));
+    EXPECT_EQ(200, static_cast<int>(response.code));
+    EXPECT_EQ(JSON(HTTPAPITestObject()) + '\n', response.body);
+    EXPECT_EQ("application/json; charset=utf-8", response.headers.Get("Content-Type"));
+    EXPECT_TRUE(response.headers.Has("Content-Length"));
+  }
+  {
+    // The larger JSON goes out in chunks, as it is written.
+    const auto response = HTTP(GET(base_url + "/large"));
+    EXPECT_EQ(201, static_cast<int>(response.code));
+    EXPECT_EQ(large_json, response.body);
+    EXPECT_EQ("application/json; charset=utf-8", response.headers.Get("Content-Type"));
+    EXPECT_FALSE(response.headers.Has("Content-Length"));
+    EXPECT_EQ(10000u, ParseJSON<HTTPAPITestObjects>(response.body).items.size());
+  }
+  http_server.SetCompression();
+  {
+    // And is compressed on the fly, if it should be.
+    const auto response = HTTP(GET(base_url + "/large").SetHeader("Accept-Encoding", "gzip"));
+    EXPECT_EQ(201, static_cast<int>(response.code));
+    EXPECT_EQ("gzip", response.headers.Get("Content-Encoding"));
+    EXPECT_LT(response.body.length() * 4u, large_json.length());
+    EXPECT_EQ(large_json, current::DeflateDecompress(response.body));
+    EXPECT_EQ(large_json, HTTP(GET(base_url + "/large").AcceptCompressed()).body);
+  }
+  http_server.DisableCompression();
+}
+
+TEST(HTTPAPI, PhaseTimings) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+
+  HTTPRoutesScope scope;
+  scope += http_server.Register("/slow", [](Request r) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    r("slow\n");
+  });
+  scope += http_server.ServePhaseTimings("/.timings");
+
+  const auto Timings = [&http_server](const std::string& route, uint64_t count) {
+    // The timings are recorded once the handler has returned, which may be after the response has been received.
+    while (true) {
+      const auto timings = http_server.PhaseTimings();
+      const auto it = timings.routes.find(route);
+      if (it != timings.routes.end() && it->second.total.count >= count) {
+        return it->second;
+      }
+      std::this_thread::yield();
+    }
+  };
+  const auto AtLeast = [](const current::http::HTTPPhaseHistogram& histogram, int ms) {
+    return histogram.max >= std::chrono::milliseconds(ms);
+  };
+
+  // The client slow to send the request, and the handler slow to respond, are told apart.
+  {
+    current::net::Connection connection(current::net::ClientSocket("localhost", port));
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    connection.BlockingWrite("POST /slow HTTP/1.1\r\nContent-Length: 4\r\n", false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    connection.BlockingWrite("\r\nbo", false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    connection.BlockingWrite("dy", false);
+    char buffer[1024];
+    EXPECT_NE(0u, connection.BlockingRead(buffer, sizeof(buffer)));
+  }
+  {
+    const auto timings = Timings("/slow", 1u);
+    EXPECT_EQ(1u, timings.first_byte.count);
+    EXPECT_TRUE(AtLeast(timings.first_byte, 30));
+    EXPECT_TRUE(AtLeast(timings.headers, 30));
+    EXPECT_TRUE(AtLeast(timings.body, 30));
+    EXPECT_FALSE(AtLeast(timings.queue, 20));
+    EXPECT_TRUE(AtLeast(timings.handler, 20));
+    EXPECT_TRUE(AtLeast(timings.response, 20));
+    EXPECT_TRUE(AtLeast(timings.total, 110));
+    EXPECT_EQ(current::http::HTTPPhaseTimings::kBuckets, timings.handler.buckets.size());
+    const auto& buckets = timings.handler.buckets;
+    EXPECT_EQ(1u, std::accumulate(buckets.begin(), buckets.end(), uint64_t(0)));
+    // Twenty milliseconds and more take at least 15 bits of microseconds, as `1 << 14` is 16.384 milliseconds.
+    EXPECT_EQ(0u, std::accumulate(buckets.begin(), buckets.begin() + 15, uint64_t(0)));
+  }
+
+  // On the worker pool, the time waiting for a thread is the queue phase.
+  http_server.SetWorkerThreads(1u);
+  {
+    std::vector<std::thread> clients;
+    for (int i = 0; i < 3; ++i) {
+      clients.emplace_back([port]() { EXPECT_EQ("slow\n", HTTP(GET(Printf("http://localhost:%d/slow", port))).body); });
+    }
+    for (std::thread& client : clients) {
+      client.join();
+    }
+    const auto timings = Timings("/slow", 4u);
+    EXPECT_EQ(4u, timings.handler.count);
+    EXPECT_TRUE(AtLeast(timings.queue, 20));
+  }
+  http_server.SetWorkerThreads(0u);
+
+  // The timings are served as JSON, and can be reset.
+  const auto served = ParseJSON<current::http::HTTPPhaseTimingsSnapshot>(
+      HTTP(GET(Printf("http://localhost:%d/.timings", port))).body);
+  ASSERT_TRUE(served.routes.count("/slow"));
+  EXPECT_EQ(4u, served.routes.at("/slow").total.count);
+  http_server.ResetPhaseTimings();
+  EXPECT_FALSE(http_server.PhaseTimings().routes.count("/slow"));
+}
+
+TEST(HTTPAPI, ServeMetrics) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+
+  HTTPRoutesScope scope;
+  scope += http_server.Register("/ok", [](Request r) { r("OK\n"); });
+  scope += http_server.ServeMetrics("/.metrics");
+  http_server.SetWorkerThreads(2u);
+
+  auto& counter = current::metrics::ProcessMetrics().GetCounter("test_http_served_total", {{"route", "/ok"}});
+  EXPECT_EQ("OK\n", HTTP(GET(Printf("http://localhost:%d/ok", port))).body);
+  counter.Increment();
+  while (http_server.PhaseTimings().routes["/ok"].total.count < 1u) {
+    std::this_thread::yield();
+  }
+
+  const auto snapshot = ParseJSON<current::metrics::MetricsSnapshot>(
+      HTTP(GET(Printf("http://localhost:%d/.metrics", port))).body);
+  const std::string port_label = current::ToString(port);
+  const auto Find = [&snapshot](const std::string& name, const current::metrics::labels_t& labels) {
+    for (const auto& metric : snapshot.metrics) {
+      if (metric.name == name && metric.labels == labels) {
+        return metric;
+      }
+    }
+    return current::metrics::MetricValue();
+  };
+  EXPECT_EQ(1.0, Find("test_http_served_total", {{"route", "/ok"}}).value);
+  const auto total = Find("http_phase_us", {{"port", port_label}, {"route", "/ok"}, {"phase", "total"}});
+  EXPECT_EQ("histogram", total.type);
+  EXPECT_EQ(1u, total.count);
+  EXPECT_EQ(current::http::HTTPPhaseTimings::kBuckets - 1u, total.buckets.size());
+  EXPECT_EQ(2.0, Find("http_worker_pool_threads", {{"port", port_label}}).value);
+
+  const auto prometheus = HTTP(GET(Printf("http://localhost:%d/.metrics?format=prometheus", port)));
+  EXPECT_EQ("text/plain; version=0.0.4", prometheus.headers.Get("Content-Type"));
+  EXPECT_NE(std::string::npos, prometheus.body.find("# TYPE http_phase_us histogram\n"));
+  EXPECT_NE(std::string::npos, prometheus.body.find("test_http_served_total{route=\"/ok\"} 1\n"));
+  EXPECT_NE(std::string::npos,
+            prometheus.body.find("http_phase_us_count{phase=\"total\",port=\"" + port_label + "\",route=\"/ok\"} 1\n"));
+  http_server.SetWorkerThreads(0u);
+}
+
+TEST(HTTPAPI, StreamedRequestBody) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+
+  std::atomic_bool first_chunk_read(false);
+  HTTPRoutesScope scope;
+  scope += http_server.RegisterWithStreamedBody("/upload", URLPathArgs::CountMask::None | URLPathArgs::CountMask::One,
+                                                [&first_chunk_read](Request r) {
+    EXPECT_TRUE(r.body.empty());
+    size_t total = 0u;
+    std::string head;
+    char buffer[64 * 1024];
+    while (const size_t n = r.ReadBody(buffer, sizeof(buffer))) {
+      total += n;
+      head += std::string(buffer, std::min(n, static_cast<size_t>(6u) - head.length()));
+      first_chunk_read = true;
+    }
+    const std::string arg = r.url_path_args.size() ? r.url_path_args[0] : "-";
+    r(Printf("%s %d %s", arg.c_str(), static_cast<int>(total), head.c_str()));
+  });
+  scope += http_server.Register("/buffered", [](Request r) { r(r.body); });
+
+  // Larger than the server accepts for the routes the body of which is received in full before the handler runs.
+  const size_t size = current::net::constants::kMaxHTTPPayloadSizeInBytes + 1;
+  {
+    const auto response = HTTP(POST(Printf("http://localhost:%d/upload/big", port), "hello," + std::string(size, 'x')));
+    EXPECT_EQ(200, static_cast<int>(response.code));
+    EXPECT_EQ(Printf("big %d hello,", static_cast<int>(size + 6u)), response.body);
+  }
+  EXPECT_EQ(413,
+            static_cast<int>(HTTP(POST(Printf("http://localhost:%d/buffered", port), std::string(size, 'x'))).code));
+  EXPECT_EQ("small", HTTP(POST(Printf("http://localhost:%d/buffered", port), "small")).body);
+  EXPECT_EQ("- 0 ", HTTP(POST(Printf("http://localhost:%d/upload", port), "")).body);
+
+  // The chunked body is read by the handler as it is received.
+  {
+    current::net::Connection connection(current::net::ClientSocket("localhost", port));
+    connection.BlockingWrite("POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n6\r\nchunk,\r\n", false);
+    while (!first_chunk_read) {
+      std::this_thread::yield();
+    }
+    connection.BlockingWrite("2\r\nab", false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    connection.BlockingWrite("\r", false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    connection.BlockingWrite("\n1", false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    connection.BlockingWrite("0\r\n0123456789abcdef\r\n0\r\n\r\n", false);
+    std::string response;
+    char buffer[1024];
+    try {
+      while (const size_t n = connection.BlockingRead(buffer, sizeof(buffer))) {
+        response.append(buffer, n);
+      }
+    } catch (const current::net::SocketException&) {
+    }
+    EXPECT_NE(std::string::npos, response.find("HTTP/1.1 200 OK")) << response;
+    EXPECT_EQ("- 24 chunk,", response.substr(response.length() - 11u)) << response;
+  }
+}
+
 CURRENT_STRUCT_T(HTTPAPITemplatedTestObject) {
   CURRENT_FIELD(text, std::string, "OK");
   CURRENT_FIELD(data, T);
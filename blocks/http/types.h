@@ -32,6 +32,7 @@ SOFTWARE.
 #include <memory>
 #include <map>
 #include <string>
+#include <string_view>
 #include <functional>
 
 #include "../../bricks/net/exceptions.h"
@@ -59,6 +60,7 @@ struct HTTPRequestBase {
   std::string custom_user_agent = "";
   current::net::http::Headers custom_headers;
   bool allow_redirects = false;
+  bool accept_compressed = false;
 
   HTTPRequestBase(const std::string& url) : url(url) {}
 
@@ -72,6 +74,13 @@ struct HTTPRequestBase {
     return static_cast<T&>(*this);
   }
 
+  // Asks the server to compress the response with gzip or deflate, and decompresses it transparently.
+  // The `Content-Encoding` header of the response is kept, to tell the compressed responses apart.
+  T& AcceptCompressed(bool accept_compressed_setting = true) {
+    accept_compressed = accept_compressed_setting;
+    return static_cast<T&>(*this);
+  }
+
   T& SetHeader(const std::string& key, const std::string& value) {
     custom_headers.emplace_back(key, value);
     return static_cast<T&>(*this);
@@ -94,18 +103,21 @@ struct ChunkedBase {
 
   const std::function<void(const std::string&, const std::string&)> header_callback;
   const std::function<void(const std::string&)> chunk_callback;
+  const std::function<void(std::string_view)> chunk_view_callback;
   const std::function<void()> done_callback;
 
   std::vector<std::unique_ptr<current::strings::StatefulGroupByLines>> group_by_lines_;
 
   std::function<void(const std::string&, const std::string&)> header_callback_impl;
   std::function<void(const std::string&)> chunk_callback_impl;
+  std::function<void(std::string_view)> chunk_view_callback_impl;
   std::function<void()> done_callback_impl;
 
   explicit ChunkedBase(std::string url)
       : url(std::move(url)),
         header_callback([this](const std::string& k, const std::string& v) { header_callback_wrapper(k, v); }),
         chunk_callback([this](const std::string& c) { chunk_callback_wrapper(c); }),
+        chunk_view_callback([this](std::string_view c) { chunk_view_callback_wrapper(c); }),
         done_callback([this]() { done_callback_wrapper(); }) {}
 
   explicit ChunkedBase(
@@ -127,6 +139,12 @@ struct ChunkedBase {
     this->chunk_callback_impl = chunk_callback;
     return static_cast<T&>(*this);
   }
+  // Receives each chunk as a view into the receive buffer, valid during the call only, instead of as a copy.
+  // The chunk is only copied if `OnChunk()` or `OnLine()` are set as well.
+  T& OnChunkView(std::function<void(std::string_view)> chunk_view_callback) {
+    this->chunk_view_callback_impl = chunk_view_callback;
+    return static_cast<T&>(*this);
+  }
   T& OnDone(std::function<void()> done_callback) {
     this->done_callback_impl = done_callback;
     group_by_lines_.clear();
@@ -155,6 +173,15 @@ struct ChunkedBase {
     }
   }
 
+  void chunk_view_callback_wrapper(std::string_view c) {
+    if (chunk_view_callback_impl) {
+      chunk_view_callback_impl(c);
+    }
+    if (chunk_callback_impl || !group_by_lines_.empty()) {
+      chunk_callback_wrapper(std::string(c));
+    }
+  }
+
   void done_callback_wrapper() {
     if (done_callback_impl) {
       done_callback_impl();
@@ -370,7 +397,7 @@ struct HTTPImpl {
 
   inline net::HTTPResponseCodeValue operator()(const ChunkedGET& request_params) const {
     typename chunked_client_impl_t::http_helper_t::ConstructionParams impl_params(
-        request_params.header_callback, request_params.chunk_callback, request_params.done_callback);
+        request_params.header_callback, request_params.chunk_view_callback, request_params.done_callback);
     chunked_client_impl_t impl(impl_params);
     impl.request_method_ = "GET";
     impl.request_url_ = request_params.url;
@@ -384,7 +411,7 @@ struct HTTPImpl {
 
   inline net::HTTPResponseCodeValue operator()(const ChunkedPOST& request_params) const {
     typename chunked_client_impl_t::http_helper_t::ConstructionParams impl_params(
-        request_params.header_callback, request_params.chunk_callback, request_params.done_callback);
+        request_params.header_callback, request_params.chunk_view_callback, request_params.done_callback);
     chunked_client_impl_t impl(impl_params);
     impl.request_method_ = "POST";
     impl.request_url_ = request_params.url;
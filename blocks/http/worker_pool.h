@@ -0,0 +1,239 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// `HTTPWorkerPool` runs the HTTP handlers on a bounded pool of threads, instead of on the thread of the server
+// that has received the request. The requests wait in a queue of bounded depth; once it is full, the requests
+// that do not fit are responded to with "503 SERVICE UNAVAILABLE" right away. With `max_queue_time` set, the
+// requests that have waited for longer than it by the time a thread is free are shed with 503 as well, since
+// their clients are likely to have given up on them already.
+//
+// Use `pool.Route(handler)` as the handler to register a route to run on the pool, optionally limiting how many
+// requests to this route may be served at once, or `HTTPServerPOSIX::SetWorkerThreads()` for all the routes.
+// The pool must outlive the routes registered with it.
+
+#ifndef BLOCKS_HTTP_WORKER_POOL_H
+#define BLOCKS_HTTP_WORKER_POOL_H
+
+#include "../../port.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "admission_control.h"
+#include "request.h"
+
+#include "../../bricks/system/placement.h"
+
+#include "../../typesystem/struct.h"
+
+namespace current {
+namespace http {
+
+CURRENT_STRUCT(HTTPWorkerPoolMetrics) {
+  CURRENT_FIELD(threads, uint64_t, 0u);
+  CURRENT_FIELD(queued, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(queued, "The requests waiting for a thread now.");
+  CURRENT_FIELD(running, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(running, "The requests being served now.");
+  CURRENT_FIELD(served, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(served, "The requests the handlers of which have returned.");
+  CURRENT_FIELD(rejected, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(rejected, "The requests responded to with 503, as the queue was full.");
+  CURRENT_FIELD(shed, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(shed, "The requests responded to with 503, as they had been queued for too long.");
+  CURRENT_FIELD(total_queue_time, std::chrono::microseconds, std::chrono::microseconds(0));
+  CURRENT_FIELD_DESCRIPTION(total_queue_time, "The time the requests have waited in the queue, in total.");
+  CURRENT_FIELD(max_queue_time, std::chrono::microseconds, std::chrono::microseconds(0));
+  CURRENT_FIELD_DESCRIPTION(max_queue_time, "The longest time a request has waited in the queue.");
+};
+
+class HTTPWorkerPool final {
+ public:
+  using handler_t = std::function<void(Request)>;
+
+  // A zero `max_queue_time` is no limit; a zero `retry_after` omits `Retry-After` from the 503 responses.
+  explicit HTTPWorkerPool(size_t threads,
+                          size_t max_queued_requests = 1000u,
+                          std::chrono::milliseconds max_queue_time = std::chrono::milliseconds(0),
+                          std::chrono::seconds retry_after = std::chrono::seconds(1))
+      : max_queued_requests_(max_queued_requests), max_queue_time_(max_queue_time), retry_after_(retry_after) {
+    const size_t threads_count = threads ? threads : 1u;
+    threads_.reserve(threads_count);
+    for (size_t i = 0u; i < threads_count; ++i) {
+      threads_.emplace_back(&HTTPWorkerPool::Thread, this);
+    }
+  }
+
+  // Waits for the requests being served, and responds with 503 to the ones still queued.
+  ~HTTPWorkerPool() {
+    std::deque<Task> queued;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      terminating_ = true;
+      queued.swap(queue_);
+    }
+    condition_variable_.notify_all();
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+    for (Task& task : queued) {
+      RespondServiceUnavailable(std::move(*task.request), retry_after_);
+    }
+  }
+
+  size_t ThreadsCount() const { return threads_.size(); }
+
+  // The handler to register for the route to be served on this pool, with no more than `max_concurrency`
+  // of its requests served at once: the requests over the limit wait, letting those to other routes through.
+  // Zero, the default, is no limit beyond the number of threads of the pool.
+  handler_t Route(handler_t handler, size_t max_concurrency = 0u) {
+    auto route = std::make_shared<RouteState>(std::move(handler), max_concurrency);
+    return [this, route](Request r) { Enqueue(route, std::move(r)); };
+  }
+
+  // Queues the request to be served by `handler` on this pool, with no concurrency limit of its own.
+  void Dispatch(handler_t handler, Request r) {
+    Enqueue(std::make_shared<RouteState>(std::move(handler), 0u), std::move(r));
+  }
+
+  HTTPWorkerPoolMetrics Metrics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    HTTPWorkerPoolMetrics metrics = metrics_;
+    metrics.threads = threads_.size();
+    metrics.queued = queue_.size();
+    return metrics;
+  }
+
+ private:
+  HTTPWorkerPool(const HTTPWorkerPool&) = delete;
+  HTTPWorkerPool& operator=(const HTTPWorkerPool&) = delete;
+
+  struct RouteState final {
+    const handler_t handler;
+    const size_t max_concurrency;
+    size_t running = 0u;  // Guarded by the mutex of the pool.
+    RouteState(handler_t handler, size_t max_concurrency)
+        : handler(std::move(handler)), max_concurrency(max_concurrency) {}
+    bool CanRunOneMore() const { return !max_concurrency || running < max_concurrency; }
+  };
+
+  struct Task final {
+    std::shared_ptr<RouteState> route;
+    std::unique_ptr<Request> request;
+    std::chrono::steady_clock::time_point queued_at;
+  };
+
+  void Enqueue(std::shared_ptr<RouteState> route, Request r) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!terminating_ && queue_.size() < max_queued_requests_) {
+        queue_.push_back(
+            Task{std::move(route), std::make_unique<Request>(std::move(r)), std::chrono::steady_clock::now()});
+        condition_variable_.notify_one();
+        return;
+      }
+      ++metrics_.rejected;
+    }
+    RespondServiceUnavailable(std::move(r), retry_after_);
+  }
+
+  void Thread() {
+    current::bricks::system::ThreadPlacementPolicy().PlaceCurrentThread(
+        current::bricks::system::ThreadRole::HTTPServer);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      auto task = queue_.end();
+      condition_variable_.wait(lock, [this, &task]() {
+        if (terminating_) {
+          return true;
+        }
+        task = std::find_if(queue_.begin(), queue_.end(), [](const Task& t) { return t.route->CanRunOneMore(); });
+        return task != queue_.end();
+      });
+      if (terminating_) {
+        return;
+      }
+      Task current = std::move(*task);
+      queue_.erase(task);
+      const auto queue_time = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - current.queued_at);
+      metrics_.total_queue_time += queue_time;
+      metrics_.max_queue_time = std::max(metrics_.max_queue_time, queue_time);
+      if (max_queue_time_.count() > 0 && queue_time > max_queue_time_) {
+        ++metrics_.shed;
+        lock.unlock();
+        try {
+          RespondServiceUnavailable(std::move(*current.request), retry_after_);
+        } catch (const current::Exception&) {  // LCOV_EXCL_LINE
+          // The client may well have disconnected by now.
+        }
+        current.request = nullptr;
+        lock.lock();
+        continue;
+      }
+      ++metrics_.running;
+      ++current.route->running;
+      const bool limited = (current.route->max_concurrency != 0u);
+      lock.unlock();
+      try {
+        current.route->handler(std::move(*current.request));
+      } catch (const current::Exception& e) {  // LCOV_EXCL_LINE
+        std::cerr << "HTTP route failed in user code: " << e.what() << '\n';  // LCOV_EXCL_LINE
+      }
+      current.request = nullptr;
+      lock.lock();
+      --metrics_.running;
+      ++metrics_.served;
+      --current.route->running;
+      if (limited) {
+        // The requests to this route held back by its limit may be served now, and not necessarily by this thread.
+        condition_variable_.notify_all();
+      }
+    }
+  }
+
+  const size_t max_queued_requests_;
+  const std::chrono::milliseconds max_queue_time_;
+  const std::chrono::seconds retry_after_;
+  mutable std::mutex mutex_;
+  std::condition_variable condition_variable_;
+  bool terminating_ = false;
+  std::deque<Task> queue_;
+  HTTPWorkerPoolMetrics metrics_;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace http
+}  // namespace current
+
+#endif  // BLOCKS_HTTP_WORKER_POOL_H
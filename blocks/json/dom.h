@@ -0,0 +1,448 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2020 Dmitry "Dima" Korolev, <dmitry.korolev@gmail.com>.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// A compact, read-only counterpart of `JSONValue`, for dynamic JSON that is mostly parsed, inspected, and passed on.
+//
+// The whole document lives in a few flat buffers: 16-byte tagged nodes, the characters of the strings too long
+// to be stored inline, and the sorted key indexes of the larger objects. Array elements and object members
+// are contiguous runs of nodes, in their original order. Parsing is done directly from RapidJSON's SAX events,
+// with no intermediate DOM, and costs a handful of allocations regardless of the size of the document.
+
+#ifndef BLOCKS_JSON_DOM_H
+#define BLOCKS_JSON_DOM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string_view>
+
+#include "json.h"
+
+namespace current {
+namespace json {
+
+struct JSONDocumentTypeMismatchException : Exception {
+  using Exception::Exception;
+};
+
+enum class JSONNodeType : uint8_t { Null = 0, Boolean, Number, String, Array, Object };
+
+class JSONDocument final {
+ public:
+  // Strings of up to this many bytes are stored within the node itself.
+  constexpr static size_t kSmallStringCapacity = 14u;
+  // Objects with more members than this get a sorted index of their keys; the smaller ones are scanned.
+  constexpr static size_t kMaxLinearLookupMembers = 8u;
+
+  class View;
+
+  JSONDocument() = default;
+
+  static JSONDocument Parse(const std::string& json) {
+    JSONDocument document;
+    Builder builder(document);
+    rapidjson::Reader reader;
+    rapidjson::StringStream stream(json.c_str());
+    if (reader.Parse(stream, builder).IsError()) {
+      CURRENT_THROW(TypeSystemParseJSONException());
+    }
+    builder.Done();
+    return document;
+  }
+
+  static JSONDocument FromJSONValue(const JSONValue& value) {
+    JSONDocument document;
+    Builder builder(document);
+    value.Call(JSONValueVisitor{builder});
+    builder.Done();
+    return document;
+  }
+
+  View Root() const;
+  JSONValue ToJSONValue() const;
+  void DoAppendToJSON(std::ostream& os) const;
+  std::string AsJSON() const;
+
+ private:
+  struct alignas(8) Node final {
+    JSONNodeType type;
+    // The length of the string stored inline in `payload`, if it is one.
+    uint8_t small_size;
+    // Depending on `type`: the boolean in byte 0; the number in bytes 6 .. 13; the inline string;
+    // or up to three `uint32_t`-s at bytes 2, 6 and 10, see `U32()` below.
+    char payload[14];
+
+    uint32_t U32(size_t i) const {
+      uint32_t value;
+      std::memcpy(&value, payload + 2 + 4 * i, sizeof(value));
+      return value;
+    }
+    void SetU32(size_t i, uint32_t value) { std::memcpy(payload + 2 + 4 * i, &value, sizeof(value)); }
+  };
+  static_assert(sizeof(Node) == 16u, "`JSONDocument::Node` must be 16 bytes.");
+
+  static Node MakeNode(JSONNodeType type) {
+    Node node;
+    std::memset(&node, 0, sizeof(node));
+    node.type = type;
+    return node;
+  }
+
+  static const Node& NullNode() {
+    static const Node null = MakeNode(JSONNodeType::Null);
+    return null;
+  }
+
+  // Long strings: U32(0) is the offset into `chars_`, U32(1) is the length.
+  // Arrays: U32(0) is the index of the first element in `nodes_`, U32(1) is the number of elements.
+  // Objects: U32(0) is the index of the first member in `nodes_`, where each member is the key node followed by
+  // the value node, U32(1) is the number of members, and U32(2) is the offset of their sorted index in `sorted_`.
+  std::string_view StringOf(const Node& node) const {
+    if (node.small_size || !node.U32(1)) {
+      return std::string_view(node.payload, node.small_size);
+    } else {
+      return std::string_view(chars_.data() + node.U32(0), node.U32(1));
+    }
+  }
+
+  // Builds the document bottom-up: values are pushed onto a stack, and, as an array or an object is closed,
+  // its elements or members are moved from the top of the stack into `nodes_` as one contiguous run.
+  // Serves both as the RapidJSON SAX handler and as the sink for converting `JSONValue`-s.
+  class Builder final {
+   public:
+    explicit Builder(JSONDocument& document) : document_(document) {}
+
+    bool Null() { return Push(MakeNode(JSONNodeType::Null)); }
+    bool Bool(bool value) {
+      Node node = MakeNode(JSONNodeType::Boolean);
+      node.payload[0] = value;
+      return Push(node);
+    }
+    bool Int(int value) { return Double(static_cast<double>(value)); }
+    bool Uint(unsigned value) { return Double(static_cast<double>(value)); }
+    bool Int64(int64_t value) { return Double(static_cast<double>(value)); }
+    bool Uint64(uint64_t value) { return Double(static_cast<double>(value)); }
+    bool Double(double value) {
+      Node node = MakeNode(JSONNodeType::Number);
+      std::memcpy(node.payload + 6, &value, sizeof(value));
+      return Push(node);
+    }
+    bool RawNumber(const char*, rapidjson::SizeType, bool) { return false; }  // Only with `kParseNumbersAsStrings`.
+    bool String(const char* value, rapidjson::SizeType length, bool = true) {
+      Node node = MakeNode(JSONNodeType::String);
+      if (length <= kSmallStringCapacity) {
+        node.small_size = static_cast<uint8_t>(length);
+        std::memcpy(node.payload, value, length);
+      } else {
+        node.SetU32(0, static_cast<uint32_t>(document_.chars_.size()));
+        node.SetU32(1, static_cast<uint32_t>(length));
+        document_.chars_.insert(document_.chars_.end(), value, value + length);
+      }
+      return Push(node);
+    }
+    bool StartObject() { return true; }
+    bool Key(const char* key, rapidjson::SizeType length, bool = true) { return String(key, length); }
+    bool EndObject(rapidjson::SizeType members) {
+      Node node = MakeNode(JSONNodeType::Object);
+      const uint32_t begin = Flush(2u * members);
+      node.SetU32(0, begin);
+      node.SetU32(1, static_cast<uint32_t>(members));
+      if (members > kMaxLinearLookupMembers) {
+        std::vector<uint32_t>& sorted = document_.sorted_;
+        const size_t offset = sorted.size();
+        node.SetU32(2, static_cast<uint32_t>(offset));
+        for (uint32_t i = 0u; i < members; ++i) {
+          sorted.push_back(i);
+        }
+        const JSONDocument& document = document_;
+        const Node* keys = document.nodes_.data() + begin;
+        // Stable, so that, should the keys repeat, the lookup finds the first one, as `JSONObject` does.
+        std::stable_sort(sorted.begin() + offset, sorted.end(), [&document, keys](uint32_t a, uint32_t b) {
+          return document.StringOf(keys[2u * a]) < document.StringOf(keys[2u * b]);
+        });
+      }
+      return Push(node);
+    }
+    bool StartArray() { return true; }
+    bool EndArray(rapidjson::SizeType elements) {
+      Node node = MakeNode(JSONNodeType::Array);
+      node.SetU32(0, Flush(elements));
+      node.SetU32(1, static_cast<uint32_t>(elements));
+      return Push(node);
+    }
+
+    // The root goes last into `nodes_`.
+    void Done() {
+      CURRENT_ASSERT(stack_.size() == 1u);
+      Flush(1u);
+    }
+
+   private:
+    bool Push(const Node& node) {
+      stack_.push_back(node);
+      return true;
+    }
+
+    uint32_t Flush(size_t count) {
+      const uint32_t begin = static_cast<uint32_t>(document_.nodes_.size());
+      document_.nodes_.insert(document_.nodes_.end(), stack_.end() - count, stack_.end());
+      stack_.resize(stack_.size() - count);
+      return begin;
+    }
+
+    JSONDocument& document_;
+    std::vector<Node> stack_;
+  };
+
+  struct JSONValueVisitor final {
+    Builder& builder;
+    void operator()(const JSONString& value) const {
+      builder.String(value.string.data(), static_cast<rapidjson::SizeType>(value.string.length()));
+    }
+    void operator()(const JSONNumber& value) const { builder.Double(value.number); }
+    void operator()(const JSONBoolean& value) const { builder.Bool(value.boolean); }
+    void operator()(const JSONNull&) const { builder.Null(); }
+    void operator()(const JSONArray& value) const {
+      for (const JSONValue& element : value.elements) {
+        element.Call(*this);
+      }
+      builder.EndArray(static_cast<rapidjson::SizeType>(value.elements.size()));
+    }
+    void operator()(const JSONObject& value) const {
+      for (const std::string& key : value.keys) {
+        builder.Key(key.data(), static_cast<rapidjson::SizeType>(key.length()));
+        value.fields.at(key).Call(*this);
+      }
+      builder.EndObject(static_cast<rapidjson::SizeType>(value.keys.size()));
+    }
+  };
+
+  std::vector<Node> nodes_;
+  std::vector<char> chars_;
+  std::vector<uint32_t> sorted_;
+};
+
+// A lightweight handle to a value within a `JSONDocument`, valid for as long as the document itself is.
+class JSONDocument::View final {
+ public:
+  JSONNodeType Type() const { return node_->type; }
+  bool IsNull() const { return node_->type == JSONNodeType::Null; }
+  bool IsBoolean() const { return node_->type == JSONNodeType::Boolean; }
+  bool IsNumber() const { return node_->type == JSONNodeType::Number; }
+  bool IsString() const { return node_->type == JSONNodeType::String; }
+  bool IsArray() const { return node_->type == JSONNodeType::Array; }
+  bool IsObject() const { return node_->type == JSONNodeType::Object; }
+
+  bool Boolean() const { return Expect(JSONNodeType::Boolean).payload[0]; }
+  double Number() const {
+    double value;
+    std::memcpy(&value, Expect(JSONNodeType::Number).payload + 6, sizeof(value));
+    return value;
+  }
+  std::string_view String() const { return document_->StringOf(Expect(JSONNodeType::String)); }
+
+  // The number of elements of an array or members of an object, zero for other types.
+  size_t size() const { return (IsArray() || IsObject()) ? node_->U32(1) : 0u; }
+  bool empty() const { return !size(); }
+
+  // Array elements. Out of range indexes yield `null`, as with `JSONArray`.
+  View operator[](size_t i) const {
+    const Node& array = Expect(JSONNodeType::Array);
+    return i < array.U32(1) ? View(document_, &document_->nodes_[array.U32(0) + i]) : View(document_, &NullNode());
+  }
+
+  // Object members, in their original order.
+  std::string_view Key(size_t i) const { return document_->StringOf(Member(i)[0]); }
+  View Value(size_t i) const { return View(document_, &Member(i)[1]); }
+
+  // Object lookup. Missing keys yield `null`, as with `JSONObject`.
+  bool HasKey(std::string_view key) const { return Find(key) != nullptr; }
+  View operator[](std::string_view key) const {
+    const Node* value = Find(key);
+    return View(document_, value ? value : &NullNode());
+  }
+  template <size_t N>
+  View operator[](const char (&key)[N]) const {
+    return operator[](std::string_view(key, N - 1u));
+  }
+
+  JSONValue ToJSONValue() const {
+    switch (node_->type) {
+      case JSONNodeType::Boolean:
+        return JSONBoolean(Boolean());
+      case JSONNodeType::Number:
+        return JSONNumber(Number());
+      case JSONNodeType::String:
+        return JSONString(std::string(String()));
+      case JSONNodeType::Array: {
+        JSONArray array;
+        const size_t n = size();
+        array.elements.reserve(n);
+        for (size_t i = 0u; i < n; ++i) {
+          array.elements.push_back(operator[](i).ToJSONValue());
+        }
+        return array;
+      }
+      case JSONNodeType::Object: {
+        JSONObject object;
+        const size_t n = size();
+        object.keys.reserve(n);
+        for (size_t i = 0u; i < n; ++i) {
+          std::string key(Key(i));
+          object.keys.push_back(key);
+          object.fields.emplace(std::move(key), Value(i).ToJSONValue());
+        }
+        return object;
+      }
+      default:
+        return JSONNull();
+    }
+  }
+
+  template <class WRITER>
+  void Write(WRITER& writer) const {
+    switch (node_->type) {
+      case JSONNodeType::Null:
+        writer.Null();
+        break;
+      case JSONNodeType::Boolean:
+        writer.Bool(Boolean());
+        break;
+      case JSONNodeType::Number: {
+        // Same formatting as `JSONNumber`: integers are written as such.
+        const double number = Number();
+        if (number == std::floor(number) && number >= static_cast<double>(std::numeric_limits<int64_t>::min()) &&
+            number < static_cast<double>(std::numeric_limits<uint64_t>::max())) {
+          if (number < 0) {
+            writer.Int64(static_cast<int64_t>(number));
+          } else {
+            writer.Uint64(static_cast<uint64_t>(number));
+          }
+        } else {
+          writer.Double(number);
+        }
+        break;
+      }
+      case JSONNodeType::String: {
+        const std::string_view string = String();
+        writer.String(string.data(), static_cast<rapidjson::SizeType>(string.length()));
+        break;
+      }
+      case JSONNodeType::Array: {
+        writer.StartArray();
+        const size_t n = size();
+        for (size_t i = 0u; i < n; ++i) {
+          operator[](i).Write(writer);
+        }
+        writer.EndArray(static_cast<rapidjson::SizeType>(n));
+        break;
+      }
+      case JSONNodeType::Object: {
+        writer.StartObject();
+        const size_t n = size();
+        for (size_t i = 0u; i < n; ++i) {
+          const std::string_view key = Key(i);
+          writer.Key(key.data(), static_cast<rapidjson::SizeType>(key.length()));
+          Value(i).Write(writer);
+        }
+        writer.EndObject(static_cast<rapidjson::SizeType>(n));
+        break;
+      }
+    }
+  }
+
+  std::string AsJSON() const {
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    Write(writer);
+    return std::string(buffer.GetString(), buffer.GetSize());
+  }
+
+  void DoAppendToJSON(std::ostream& os) const { os << AsJSON(); }
+
+ private:
+  friend class JSONDocument;
+  View(const JSONDocument* document, const Node* node) : document_(document), node_(node) {}
+
+  const Node& Expect(JSONNodeType type) const {
+    if (node_->type != type) {
+      CURRENT_THROW(JSONDocumentTypeMismatchException());
+    }
+    return *node_;
+  }
+
+  const Node* Member(size_t i) const {
+    const Node& object = Expect(JSONNodeType::Object);
+    if (i >= object.U32(1)) {
+      CURRENT_THROW(JSONDocumentTypeMismatchException("Object member index out of range."));
+    }
+    return &document_->nodes_[object.U32(0) + 2u * i];
+  }
+
+  const Node* Find(std::string_view key) const {
+    const Node& object = Expect(JSONNodeType::Object);
+    const Node* members = &document_->nodes_[0] + object.U32(0);
+    const size_t n = object.U32(1);
+    if (n <= kMaxLinearLookupMembers) {
+      for (size_t i = 0u; i < n; ++i) {
+        if (document_->StringOf(members[2u * i]) == key) {
+          return &members[2u * i + 1u];
+        }
+      }
+      return nullptr;
+    } else {
+      const uint32_t* sorted = document_->sorted_.data() + object.U32(2);
+      const uint32_t* it = std::lower_bound(sorted, sorted + n, key, [this, members](uint32_t i, std::string_view k) {
+        return document_->StringOf(members[2u * i]) < k;
+      });
+      return (it != sorted + n && document_->StringOf(members[2u * *it]) == key) ? &members[2u * *it + 1u] : nullptr;
+    }
+  }
+
+  const JSONDocument* document_;
+  const Node* node_;
+};
+
+inline JSONDocument::View JSONDocument::Root() const {
+  return View(this, nodes_.empty() ? &NullNode() : &nodes_.back());
+}
+inline JSONValue JSONDocument::ToJSONValue() const { return Root().ToJSONValue(); }
+inline void JSONDocument::DoAppendToJSON(std::ostream& os) const { Root().DoAppendToJSON(os); }
+inline std::string JSONDocument::AsJSON() const { return Root().AsJSON(); }
+
+template <>
+inline std::string AsJSON(const JSONDocument& document) {
+  return document.AsJSON();
+}
+
+template <>
+inline std::string AsJSON(const JSONDocument::View& view) {
+  return view.AsJSON();
+}
+
+}  // namespace current::json
+}  // namespace current
+
+#endif  // BLOCKS_JSON_DOM_H
@@ -23,6 +23,7 @@ SOFTWARE.
 *******************************************************************************/
 
 #include "json.h"
+#include "dom.h"
 
 #include "../../3rdparty/gtest/gtest-main-with-dflags.h"
 
@@ -141,3 +142,72 @@ TEST(UniversalJSON, FloatingPoint) {
     EXPECT_EQ(json, AsJSON(ParseJSONUniversally(json)));
   }
 }
+
+TEST(UniversalJSON, Document) {
+  using namespace current::json;
+
+  for (const std::string json : {"\"foo\"",
+                                 "42",
+                                 "-0.15",
+                                 "1e-15",
+                                 "true",
+                                 "null",
+                                 "[]",
+                                 "{}",
+                                 "[1,\"bar\",null,true,[],{}]",
+                                 "{\"a\":101,\"c\":\"the order is preserved\",\"b\":null}",
+                                 "{\"x\":1234.56,\"y\":[{\"z\":9876543210}],\"s\":\"a \\\"quoted\\\" string\\n\"}"}) {
+    const JSONDocument document = JSONDocument::Parse(json);
+    EXPECT_EQ(AsJSON(ParseJSONUniversally(json)), AsJSON(document)) << json;
+    EXPECT_EQ(AsJSON(document), AsJSON(document.ToJSONValue())) << json;
+    EXPECT_EQ(AsJSON(document), AsJSON(JSONDocument::FromJSONValue(ParseJSONUniversally(json)))) << json;
+  }
+
+  ASSERT_THROW(JSONDocument::Parse("{"), TypeSystemParseJSONException);
+  ASSERT_THROW(JSONDocument::Parse("[] []"), TypeSystemParseJSONException);
+}
+
+TEST(UniversalJSON, DocumentAccess) {
+  using namespace current::json;
+
+  const JSONDocument document = JSONDocument::Parse(
+      "{\"short\":\"fourteen chars\",\"long\":\"fifteen chars!!\",\"n\":[1,2.5,true,null],\"o\":{\"x\":\"y\"}}");
+  const JSONDocument::View root = document.Root();
+  ASSERT_TRUE(root.IsObject());
+  ASSERT_EQ(4u, root.size());
+  EXPECT_EQ("short", root.Key(0));
+  EXPECT_EQ("o", root.Key(3));
+  EXPECT_EQ("fourteen chars", root["short"].String());
+  EXPECT_EQ("fifteen chars!!", root["long"].String());
+  EXPECT_TRUE(root.HasKey("n"));
+  EXPECT_FALSE(root.HasKey("nope"));
+  EXPECT_TRUE(root["nope"].IsNull());
+
+  const JSONDocument::View n = root["n"];
+  ASSERT_TRUE(n.IsArray());
+  ASSERT_EQ(4u, n.size());
+  EXPECT_EQ(1.0, n[0].Number());
+  EXPECT_EQ(2.5, n[1].Number());
+  EXPECT_TRUE(n[2].Boolean());
+  EXPECT_TRUE(n[3].IsNull());
+  EXPECT_TRUE(n[4].IsNull());
+  EXPECT_EQ("{\"x\":\"y\"}", AsJSON(root["o"]));
+  EXPECT_EQ("y", root["o"]["x"].String());
+
+  ASSERT_THROW(n.String(), JSONDocumentTypeMismatchException);
+  ASSERT_THROW(n["x"], JSONDocumentTypeMismatchException);
+
+  // Objects above the linear lookup threshold are looked up via their sorted key index.
+  std::string json = "{";
+  for (int i = 99; i >= 0; --i) {
+    json += (i == 99 ? "\"k" : ",\"k") + current::ToString(i) + "\":" + current::ToString(i);
+  }
+  json += ",\"k42\":\"dup\"}";
+  const JSONDocument large = JSONDocument::Parse(json);
+  ASSERT_EQ(101u, large.Root().size());
+  EXPECT_EQ("k99", large.Root().Key(0));
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(static_cast<double>(i), large.Root()["k" + current::ToString(i)].Number());
+  }
+  EXPECT_FALSE(large.Root().HasKey("k100"));
+}
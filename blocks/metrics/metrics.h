@@ -0,0 +1,483 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// A process-wide registry of metrics: counters, gauges, and histograms, each identified by its name and labels.
+// The counters and the histograms are sharded by thread onto cache lines of their own, so that updating them
+// from the hot paths costs a relaxed atomic add, most likely not contended; the shards are added up on export.
+// Get the metric once, and keep the reference, as the lookup by name and labels takes a mutex:
+//
+//   auto& served = current::metrics::ProcessMetrics().GetCounter("requests_total", {{"route", "/foo"}});
+//   served.Increment();
+//
+// The components with metrics of their own publish them via collectors, called on every export, e.g. MMQ via
+// `current::mmq::PublishMMQMetrics()`, streams via `stream.PublishMetrics()`, RipCurrent flows via
+// `current::ripcurrent::PublishRipCurrentMetrics()`, and every `HTTPServerPOSIX` does so on its own.
+//
+// All of them are served by `scope += HTTP(port).ServeMetrics("/.metrics");`, as JSON, or, with `?format=prometheus`,
+// in the Prometheus text format. The `MetricsSnapshot` is a `CURRENT_STRUCT`, to be reported via Claire status too.
+
+#ifndef BLOCKS_METRICS_METRICS_H
+#define BLOCKS_METRICS_METRICS_H
+
+#include "../../port.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../../bricks/exception.h"
+#include "../../bricks/util/singleton.h"
+#include "../../typesystem/struct.h"
+
+namespace current {
+namespace metrics {
+
+using labels_t = std::map<std::string, std::string>;
+
+CURRENT_STRUCT(MetricHistogramBucket) {
+  CURRENT_FIELD(le, double, 0.0);
+  CURRENT_FIELD_DESCRIPTION(le, "The upper bound of the bucket, inclusive.");
+  CURRENT_FIELD(count, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(count, "The number of values up to `le`, cumulative, as in Prometheus.");
+};
+
+CURRENT_STRUCT(MetricValue) {
+  CURRENT_FIELD(name, std::string);
+  CURRENT_FIELD(type, std::string);
+  CURRENT_FIELD_DESCRIPTION(type, "One of \"counter\", \"gauge\", and \"histogram\".");
+  CURRENT_FIELD(help, std::string);
+  CURRENT_FIELD(labels, labels_t);
+  CURRENT_FIELD(value, double, 0.0);
+  CURRENT_FIELD_DESCRIPTION(value, "The value of the counter or of the gauge, or the sum of the histogram values.");
+  CURRENT_FIELD(count, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(count, "The number of the histogram values.");
+  CURRENT_FIELD(buckets, std::vector<MetricHistogramBucket>);
+  CURRENT_FIELD_DESCRIPTION(buckets, "The histogram buckets, the one for the values above the last `le` implied.");
+};
+
+CURRENT_STRUCT(MetricsSnapshot) {
+  CURRENT_FIELD(metrics, std::vector<MetricValue>);
+  CURRENT_FIELD_DESCRIPTION(metrics, "Ordered by name, so that the metrics of the same name go together.");
+};
+
+struct MetricTypeMismatchException final : Exception {
+  using Exception::Exception;
+};
+
+// For the collectors to add the metrics of their components to the snapshot being exported.
+inline void AddCounter(
+    MetricsSnapshot& snapshot, const std::string& name, const labels_t& labels, double value, const std::string& help) {
+  snapshot.metrics.emplace_back();
+  MetricValue& metric = snapshot.metrics.back();
+  metric.name = name;
+  metric.type = "counter";
+  metric.help = help;
+  metric.labels = labels;
+  metric.value = value;
+}
+
+inline void AddGauge(
+    MetricsSnapshot& snapshot, const std::string& name, const labels_t& labels, double value, const std::string& help) {
+  AddCounter(snapshot, name, labels, value, help);
+  snapshot.metrics.back().type = "gauge";
+}
+
+// Adds the histogram from `counts`, which are not cumulative, with `counts[i]` being the number of values up to
+// `upper_bounds[i]`, and the extra last one being the number of values above all of them.
+inline void AddHistogram(MetricsSnapshot& snapshot,
+                         const std::string& name,
+                         const labels_t& labels,
+                         const std::vector<double>& upper_bounds,
+                         const std::vector<uint64_t>& counts,
+                         double sum,
+                         const std::string& help) {
+  AddCounter(snapshot, name, labels, sum, help);
+  MetricValue& metric = snapshot.metrics.back();
+  metric.type = "histogram";
+  uint64_t total = 0u;
+  for (size_t i = 0u; i < counts.size(); ++i) {
+    total += counts[i];
+    if (i < upper_bounds.size()) {
+      metric.buckets.emplace_back();
+      metric.buckets.back().le = upper_bounds[i];
+      metric.buckets.back().count = total;
+    }
+  }
+  metric.count = total;
+}
+
+// Adds the histogram of the microseconds as kept by MMQ and by the HTTP server: the counts of the values under 1us,
+// under 2us, under 4us, etc., with the last one counting the rest.
+inline void AddPowersOfTwoMicrosecondsHistogram(MetricsSnapshot& snapshot,
+                                                const std::string& name,
+                                                const labels_t& labels,
+                                                const std::vector<uint64_t>& counts,
+                                                std::chrono::microseconds total,
+                                                const std::string& help) {
+  std::vector<double> upper_bounds;
+  for (size_t i = 0u; i + 1u < counts.size(); ++i) {
+    upper_bounds.push_back(static_cast<double>(1ull << i));
+  }
+  AddHistogram(snapshot, name, labels, upper_bounds, counts, static_cast<double>(total.count()), help);
+}
+
+namespace impl {
+
+constexpr static size_t kShards = 16u;
+
+// The threads are assigned the shards round-robin, as they first update a sharded metric.
+struct ThreadShard final {
+  const size_t index;
+  ThreadShard() : index(NextIndex()) {}
+  static size_t NextIndex() {
+    static std::atomic<size_t> next(0u);
+    return next++ % kShards;
+  }
+};
+
+inline size_t CurrentShard() { return ThreadLocalSingleton<ThreadShard>().index; }
+
+inline void AtomicAdd(std::atomic<double>& value, double delta) {
+  double current = value.load(std::memory_order_relaxed);
+  while (!value.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {
+  }
+}
+
+}  // namespace impl
+
+class Counter final {
+ public:
+  void Increment(uint64_t delta = 1u) {
+    shards_[impl::CurrentShard()].value.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+  uint64_t Value() const {
+    uint64_t value = 0u;
+    for (const Shard& shard : shards_) {
+      value += shard.value.load(std::memory_order_relaxed);
+    }
+    return value;
+  }
+
+ private:
+  struct alignas(64) Shard final {
+    std::atomic<uint64_t> value{0u};
+  };
+  Shard shards_[impl::kShards];
+};
+
+class Gauge final {
+ public:
+  void Set(double value) { value_.store(value, std::memory_order_relaxed); }
+  void Add(double delta) { impl::AtomicAdd(value_, delta); }
+  double Value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<double> value_{0.0};
+};
+
+class Histogram final {
+ public:
+  // The upper bounds of the buckets, inclusive, ascending; there is one more bucket for the values above the last.
+  explicit Histogram(std::vector<double> upper_bounds = ExponentialBounds(1.0, 2.0, 24u))
+      : upper_bounds_(std::move(upper_bounds)), shards_(impl::kShards) {
+    for (Shard& shard : shards_) {
+      shard.counts.reset(new std::atomic<uint64_t>[upper_bounds_.size() + 1u]());
+    }
+  }
+
+  // `count` bounds: `start`, `start * factor`, `start * factor^2`, etc.
+  static std::vector<double> ExponentialBounds(double start, double factor, size_t count) {
+    std::vector<double> bounds;
+    for (double bound = start; bounds.size() < count; bound *= factor) {
+      bounds.push_back(bound);
+    }
+    return bounds;
+  }
+
+  void Record(double value) {
+    const size_t bucket = static_cast<size_t>(std::lower_bound(upper_bounds_.begin(), upper_bounds_.end(), value) -
+                                              upper_bounds_.begin());
+    Shard& shard = shards_[impl::CurrentShard()];
+    shard.counts[bucket].fetch_add(1u, std::memory_order_relaxed);
+    impl::AtomicAdd(shard.sum, value);
+  }
+
+  const std::vector<double>& UpperBounds() const { return upper_bounds_; }
+
+  // The counts per bucket, not cumulative, and the sum of the values.
+  std::pair<std::vector<uint64_t>, double> Snapshot() const {
+    std::pair<std::vector<uint64_t>, double> result(std::vector<uint64_t>(upper_bounds_.size() + 1u), 0.0);
+    for (const Shard& shard : shards_) {
+      for (size_t i = 0u; i <= upper_bounds_.size(); ++i) {
+        result.first[i] += shard.counts[i].load(std::memory_order_relaxed);
+      }
+      result.second += shard.sum.load(std::memory_order_relaxed);
+    }
+    return result;
+  }
+
+ private:
+  struct alignas(64) Shard final {
+    std::unique_ptr<std::atomic<uint64_t>[]> counts;
+    std::atomic<double> sum{0.0};
+  };
+  const std::vector<double> upper_bounds_;
+  std::vector<Shard> shards_;
+};
+
+namespace impl {
+
+struct Collectors final {
+  std::mutex mutex;
+  std::map<uint64_t, std::function<void(MetricsSnapshot&)>> collectors;
+  uint64_t last_id = 0u;
+};
+
+}  // namespace impl
+
+// Unregisters the collector once destroyed. Shares the list of the collectors with the registry, to not depend
+// on the order in which the singletons, the registry and the owners of the scopes, are destroyed.
+class CollectorScope final {
+ public:
+  CollectorScope() = default;
+  CollectorScope(std::shared_ptr<impl::Collectors> collectors, uint64_t id)
+      : collectors_(std::move(collectors)), id_(id) {}
+  CollectorScope(CollectorScope&& rhs) = default;
+  CollectorScope& operator=(CollectorScope&& rhs) {
+    if (this != &rhs) {
+      Release();
+      collectors_ = std::move(rhs.collectors_);
+      id_ = rhs.id_;
+    }
+    return *this;
+  }
+  ~CollectorScope() { Release(); }
+
+  void Release() {
+    if (collectors_) {
+      std::lock_guard<std::mutex> lock(collectors_->mutex);
+      collectors_->collectors.erase(id_);
+      collectors_ = nullptr;
+    }
+  }
+
+ private:
+  CollectorScope(const CollectorScope&) = delete;
+  CollectorScope& operator=(const CollectorScope&) = delete;
+
+  std::shared_ptr<impl::Collectors> collectors_;
+  uint64_t id_ = 0u;
+};
+
+class Registry final {
+ public:
+  using collector_t = std::function<void(MetricsSnapshot&)>;
+
+  Counter& GetCounter(const std::string& name, const labels_t& labels = labels_t(), const std::string& help = "") {
+    Entry& entry = GetEntry(name, "counter", labels, help);
+    if (!entry.counter) {
+      entry.counter = std::make_unique<Counter>();
+    }
+    return *entry.counter;
+  }
+
+  Gauge& GetGauge(const std::string& name, const labels_t& labels = labels_t(), const std::string& help = "") {
+    Entry& entry = GetEntry(name, "gauge", labels, help);
+    if (!entry.gauge) {
+      entry.gauge = std::make_unique<Gauge>();
+    }
+    return *entry.gauge;
+  }
+
+  // The buckets are set by the first call for these name and labels.
+  Histogram& GetHistogram(const std::string& name,
+                          const labels_t& labels = labels_t(),
+                          const std::string& help = "",
+                          std::vector<double> upper_bounds = Histogram::ExponentialBounds(1.0, 2.0, 24u)) {
+    Entry& entry = GetEntry(name, "histogram", labels, help);
+    if (!entry.histogram) {
+      entry.histogram = std::make_unique<Histogram>(std::move(upper_bounds));
+    }
+    return *entry.histogram;
+  }
+
+  // The collector is called on every export, until the returned scope is destroyed, to add its metrics.
+  // It is called with the list of the collectors locked, so it must not add or remove collectors itself.
+  [[nodiscard]] CollectorScope AddCollector(collector_t collector) {
+    std::lock_guard<std::mutex> lock(collectors_->mutex);
+    const uint64_t id = ++collectors_->last_id;
+    collectors_->collectors.emplace(id, std::move(collector));
+    return CollectorScope(collectors_, id);
+  }
+
+  MetricsSnapshot Snapshot() const {
+    MetricsSnapshot snapshot;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (const auto& e : entries_) {
+        const std::string& name = e.first.first;
+        const labels_t& labels = e.first.second;
+        const Entry& entry = e.second;
+        if (entry.counter) {
+          AddCounter(snapshot, name, labels, static_cast<double>(entry.counter->Value()), entry.help);
+        } else if (entry.gauge) {
+          AddGauge(snapshot, name, labels, entry.gauge->Value(), entry.help);
+        } else if (entry.histogram) {
+          const auto histogram = entry.histogram->Snapshot();
+          AddHistogram(
+              snapshot, name, labels, entry.histogram->UpperBounds(), histogram.first, histogram.second, entry.help);
+        }
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(collectors_->mutex);
+      for (const auto& collector : collectors_->collectors) {
+        collector.second(snapshot);
+      }
+    }
+    std::stable_sort(snapshot.metrics.begin(),
+                     snapshot.metrics.end(),
+                     [](const MetricValue& lhs, const MetricValue& rhs) { return lhs.name < rhs.name; });
+    return snapshot;
+  }
+
+ private:
+  struct Entry final {
+    std::string help;
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Gauge> gauge;
+    std::unique_ptr<Histogram> histogram;
+  };
+
+  Entry& GetEntry(const std::string& name, const char* type, const labels_t& labels, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto type_cit = types_.find(name);
+    if (type_cit == types_.end()) {
+      types_[name] = type;
+    } else if (type_cit->second != type) {
+      CURRENT_THROW(MetricTypeMismatchException("`" + name + "` is a " + type_cit->second + ", not a " + type + '.'));
+    }
+    Entry& entry = entries_[std::make_pair(name, labels)];
+    if (entry.help.empty()) {
+      entry.help = help;
+    }
+    return entry;
+  }
+
+  mutable std::mutex mutex_;
+  std::map<std::string, std::string> types_;
+  std::map<std::pair<std::string, labels_t>, Entry> entries_;
+  const std::shared_ptr<impl::Collectors> collectors_ = std::make_shared<impl::Collectors>();
+};
+
+inline Registry& ProcessMetrics() { return Singleton<Registry>(); }
+
+namespace impl {
+
+inline std::string PrometheusNumber(double value) {
+  if (std::isnan(value)) {
+    return "NaN";
+  } else if (std::isinf(value)) {
+    return value > 0 ? "+Inf" : "-Inf";
+  } else if (value == std::floor(value) && std::fabs(value) < 1e15) {
+    return std::to_string(static_cast<int64_t>(value));
+  } else {
+    std::ostringstream os;
+    os << std::setprecision(17) << value;
+    return os.str();
+  }
+}
+
+inline std::string PrometheusLabels(const labels_t& labels, const std::string& le = "") {
+  std::string result;
+  const auto append = [&result](const std::string& key, const std::string& value) {
+    result += result.empty() ? '{' : ',';
+    result += key + "=\"";
+    for (char c : value) {
+      if (c == '\\' || c == '"') {
+        result += '\\';
+        result += c;
+      } else if (c == '\n') {
+        result += "\\n";
+      } else {
+        result += c;
+      }
+    }
+    result += '"';
+  };
+  for (const auto& label : labels) {
+    append(label.first, label.second);
+  }
+  if (!le.empty()) {
+    append("le", le);
+  }
+  return result.empty() ? result : result + '}';
+}
+
+}  // namespace impl
+
+// The Prometheus text exposition format, version 0.0.4.
+inline std::string PrometheusText(const MetricsSnapshot& snapshot) {
+  std::ostringstream os;
+  const std::string* family = nullptr;
+  for (const MetricValue& metric : snapshot.metrics) {
+    if (!family || *family != metric.name) {
+      family = &metric.name;
+      if (!metric.help.empty()) {
+        os << "# HELP " << metric.name << ' ' << metric.help << '\n';
+      }
+      os << "# TYPE " << metric.name << ' ' << metric.type << '\n';
+    }
+    if (metric.type == "histogram") {
+      for (const MetricHistogramBucket& bucket : metric.buckets) {
+        os << metric.name << "_bucket" << impl::PrometheusLabels(metric.labels, impl::PrometheusNumber(bucket.le))
+           << ' ' << bucket.count << '\n';
+      }
+      os << metric.name << "_bucket" << impl::PrometheusLabels(metric.labels, "+Inf") << ' ' << metric.count << '\n';
+      os << metric.name << "_sum" << impl::PrometheusLabels(metric.labels) << ' '
+         << impl::PrometheusNumber(metric.value) << '\n';
+      os << metric.name << "_count" << impl::PrometheusLabels(metric.labels) << ' ' << metric.count << '\n';
+    } else {
+      os << metric.name << impl::PrometheusLabels(metric.labels) << ' ' << impl::PrometheusNumber(metric.value)
+         << '\n';
+    }
+  }
+  return os.str();
+}
+
+}  // namespace metrics
+}  // namespace current
+
+#endif  // BLOCKS_METRICS_METRICS_H
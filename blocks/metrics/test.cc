@@ -0,0 +1,157 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+#include "metrics.h"
+
+#include "../mmq/mmq.h"
+
+#include <thread>
+
+#include "../../3rdparty/gtest/gtest-main.h"
+
+using current::metrics::MetricsSnapshot;
+using current::metrics::MetricValue;
+using current::metrics::Registry;
+
+namespace metrics_test {
+
+inline MetricValue Find(const MetricsSnapshot& snapshot,
+                        const std::string& name,
+                        const current::metrics::labels_t& labels = current::metrics::labels_t()) {
+  for (const MetricValue& metric : snapshot.metrics) {
+    if (metric.name == name && metric.labels == labels) {
+      return metric;
+    }
+  }
+  return MetricValue();
+}
+
+}  // namespace metrics_test
+
+TEST(Metrics, CountersAndGauges) {
+  using metrics_test::Find;
+  Registry registry;
+
+  auto& counter = registry.GetCounter("requests_total", {{"route", "/a"}}, "The requests.");
+  EXPECT_EQ(&counter, &registry.GetCounter("requests_total", {{"route", "/a"}}));
+  EXPECT_NE(&counter, &registry.GetCounter("requests_total", {{"route", "/b"}}));
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&counter]() {
+      for (int j = 0; j < 10000; ++j) {
+        counter.Increment();
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(80000u, counter.Value());
+
+  auto& gauge = registry.GetGauge("temperature");
+  gauge.Set(36.6);
+  gauge.Add(0.5);
+  EXPECT_DOUBLE_EQ(37.1, gauge.Value());
+
+  ASSERT_THROW(registry.GetGauge("requests_total"), current::metrics::MetricTypeMismatchException);
+
+  const MetricsSnapshot snapshot = registry.Snapshot();
+  ASSERT_EQ(3u, snapshot.metrics.size());
+  EXPECT_EQ("requests_total", snapshot.metrics[0].name);
+  EXPECT_EQ("requests_total", snapshot.metrics[1].name);
+  EXPECT_EQ("temperature", snapshot.metrics[2].name);
+  EXPECT_EQ("counter", Find(snapshot, "requests_total", {{"route", "/a"}}).type);
+  EXPECT_EQ("The requests.", Find(snapshot, "requests_total", {{"route", "/a"}}).help);
+  EXPECT_EQ(80000.0, Find(snapshot, "requests_total", {{"route", "/a"}}).value);
+  EXPECT_EQ(0.0, Find(snapshot, "requests_total", {{"route", "/b"}}).value);
+  EXPECT_EQ("gauge", Find(snapshot, "temperature").type);
+}
+
+TEST(Metrics, Histograms) {
+  Registry registry;
+  auto& histogram = registry.GetHistogram("latency_ms", {}, "", {1.0, 10.0, 100.0});
+  for (double value : {0.5, 1.0, 5.0, 50.0, 500.0}) {
+    histogram.Record(value);
+  }
+
+  const MetricValue metric = metrics_test::Find(registry.Snapshot(), "latency_ms");
+  EXPECT_EQ("histogram", metric.type);
+  EXPECT_EQ(5u, metric.count);
+  EXPECT_DOUBLE_EQ(556.5, metric.value);
+  ASSERT_EQ(3u, metric.buckets.size());
+  EXPECT_EQ(1.0, metric.buckets[0].le);
+  EXPECT_EQ(2u, metric.buckets[0].count);
+  EXPECT_EQ(3u, metric.buckets[1].count);
+  EXPECT_EQ(4u, metric.buckets[2].count);
+
+  EXPECT_EQ(
+      "# TYPE latency_ms histogram\n"
+      "latency_ms_bucket{le=\"1\"} 2\n"
+      "latency_ms_bucket{le=\"10\"} 3\n"
+      "latency_ms_bucket{le=\"100\"} 4\n"
+      "latency_ms_bucket{le=\"+Inf\"} 5\n"
+      "latency_ms_sum 556.5\n"
+      "latency_ms_count 5\n",
+      current::metrics::PrometheusText(registry.Snapshot()));
+}
+
+TEST(Metrics, Collectors) {
+  Registry registry;
+  registry.GetCounter("events_total", {{"kind", "say \"hi\""}}, "The events.").Increment(3u);
+  {
+    const auto scope = registry.AddCollector([](MetricsSnapshot& snapshot) {
+      current::metrics::AddGauge(snapshot, "collected", {}, 42, "");
+    });
+    EXPECT_EQ(42.0, metrics_test::Find(registry.Snapshot(), "collected").value);
+    EXPECT_EQ(
+        "# TYPE collected gauge\n"
+        "collected 42\n"
+        "# HELP events_total The events.\n"
+        "# TYPE events_total counter\n"
+        "events_total{kind=\"say \\\"hi\\\"\"} 3\n",
+        current::metrics::PrometheusText(registry.Snapshot()));
+  }
+  EXPECT_EQ(1u, registry.Snapshot().metrics.size());
+}
+
+TEST(Metrics, PublishMMQMetrics) {
+  struct ConsumerImpl {
+    current::ss::EntryResponse operator()(int, idxts_t, idxts_t) { return current::ss::EntryResponse::More; }
+  };
+  using Consumer = current::ss::EntrySubscriber<ConsumerImpl, int>;
+  Consumer consumer;
+  current::mmq::MMQ<int, Consumer> mmq(consumer);
+  Registry registry;
+  const auto scope = current::mmq::PublishMMQMetrics("numbers", mmq, registry);
+  mmq.Publish(1);
+  mmq.Publish(2);
+  while (mmq.Metrics().consumed < 2u) {
+    std::this_thread::yield();
+  }
+  const MetricsSnapshot snapshot = registry.Snapshot();
+  EXPECT_EQ(2.0, metrics_test::Find(snapshot, "mmq_published_total", {{"queue", "numbers"}}).value);
+  EXPECT_EQ(2u, metrics_test::Find(snapshot, "mmq_consumer_latency_us", {{"queue", "numbers"}}).count);
+}
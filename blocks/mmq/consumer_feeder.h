@@ -0,0 +1,86 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+          (c) 2015 Maxim Zhurovich <zhurovich@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#ifndef BLOCKS_MMQ_CONSUMER_FEEDER_H
+#define BLOCKS_MMQ_CONSUMER_FEEDER_H
+
+#include <type_traits>
+#include <vector>
+
+#include "../ss/ss.h"
+
+namespace current {
+namespace mmq {
+namespace impl {
+
+// Feeds the runs of messages drained at once from the queue to its consumer: as a single `ss::EntriesBatch`,
+// if the consumer accepts batches, or one by one otherwise.
+// The entries of the queue are anything with the `message_body` and `index_timestamp` fields.
+template <typename MESSAGE, typename CONSUMER>
+class ConsumerFeeder final {
+ public:
+  explicit ConsumerFeeder(CONSUMER& consumer) : consumer_(consumer) {}
+
+  // The messages are moved from, unless passed in a batch.
+  template <typename ENTRY>
+  void Feed(const std::vector<ENTRY*>& entries, idxts_t last) {
+    if (!entries.empty()) {
+      FeedImpl(entries, last);
+    }
+  }
+
+ private:
+  constexpr static bool kPassMessagesInBatches = ss::IsBatchEntrySubscriber<CONSUMER, MESSAGE>::value;
+
+  template <typename ENTRY, bool IN_BATCHES = kPassMessagesInBatches>
+  std::enable_if_t<IN_BATCHES> FeedImpl(const std::vector<ENTRY*>& entries, idxts_t last) {
+    messages_.clear();
+    idx_ts_.clear();
+    for (const ENTRY* e : entries) {
+      messages_.push_back(&e->message_body);
+      idx_ts_.push_back(e->index_timestamp);
+    }
+    consumer_(ss::EntriesBatch<MESSAGE>(messages_.data(), idx_ts_.data(), messages_.size()), last);
+  }
+
+  template <typename ENTRY, bool IN_BATCHES = kPassMessagesInBatches>
+  std::enable_if_t<!IN_BATCHES> FeedImpl(const std::vector<ENTRY*>& entries, idxts_t last) {
+    for (ENTRY* e : entries) {
+      consumer_(std::move(e->message_body), e->index_timestamp, last);
+    }
+  }
+
+  CONSUMER& consumer_;
+
+  // Reused from one batch to the next.
+  std::vector<const MESSAGE*> messages_;
+  std::vector<idxts_t> idx_ts_;
+};
+
+}  // namespace impl
+}  // namespace mmq
+}  // namespace current
+
+#endif  // BLOCKS_MMQ_CONSUMER_FEEDER_H
@@ -0,0 +1,251 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+          (c) 2015 Maxim Zhurovich <zhurovich@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#ifndef BLOCKS_MMQ_LOCK_FREE_MMQ_H
+#define BLOCKS_MMQ_LOCK_FREE_MMQ_H
+
+// The lock-free version of MMQ, with the same interface, indexes, timestamps, and overflow strategies, see "mmq.h".
+//
+// The messages are kept in a ring of the size of the power of two, holding up to `buffer_size` messages.
+// No mutex is taken while publishing, unless the consumer thread is parked waiting for the messages, or the ring
+// is full and the overflow policy is to wait for the room in it.
+//
+// The indexes and the timestamps follow the positions in the ring, so that they keep increasing. Each slot keeps
+// the timestamp of the message it was last claimed for, and, as the timestamps are strictly increasing, the slot for
+// the position `p` is claimed once its timestamp is past the one of the position `p - 1`. So a publisher claims
+// the position, its index, and its timestamp, at once, with a single compare-and-swap of the timestamp of the slot.
+// The head position is then advanced by whoever gets to it first, the publisher itself or the next one, so that
+// a publisher preempted at any point never stalls the other publishers. The messages are then copied or moved
+// into their slots concurrently, and each slot is marked ready for the consumer by its own sequence number.
+// A message which fails to be published due to an inconsistent timestamp claims no position.
+//
+// The ring itself, along with the parking of the consumer and of the publishers, is in "ring.h".
+//
+// The metrics are kept in atomic counters, see "metrics.h", and exposed via `Metrics()`, as with MMQ.
+
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "consumer_feeder.h"
+#include "metrics.h"
+#include "ring.h"
+
+#include "../ss/ss.h"
+
+#include "../../bricks/system/placement.h"
+#include "../../bricks/time/chrono.h"
+
+namespace current {
+namespace mmq {
+
+template <typename MESSAGE, typename CONSUMER, size_t DEFAULT_BUFFER_SIZE = 1024, bool DROP_ON_OVERFLOW = false>
+class LockFreeMMQImpl {
+  static_assert(current::ss::IsEntrySubscriber<CONSUMER, MESSAGE>::value, "");
+
+ public:
+  // The type of messages to store and dispatch.
+  using message_t = MESSAGE;
+
+  // Consumer's `operator()` will be called from a dedicated thread, which is spawned and owned
+  // by the instance of LockFreeMMQImpl. See "blocks/ss/ss.h" and its test for possible callee signatures.
+  using consumer_t = CONSUMER;
+
+  LockFreeMMQImpl(consumer_t& consumer, size_t buffer_size = DEFAULT_BUFFER_SIZE)
+      : consumer_(consumer),
+        ring_(buffer_size),
+        metrics_(buffer_size),
+        consumer_thread_(&LockFreeMMQImpl::ConsumerThread, this) {
+    consumer_thread_created_ = true;
+  }
+
+  // The destructor waits for the consumer thread to terminate.
+  ~LockFreeMMQImpl() {
+    if (consumer_thread_created_) {
+      CURRENT_ASSERT(consumer_thread_.joinable());
+      ring_.Stop();
+      consumer_thread_.join();
+    }
+  }
+
+  // THREAD SAFE. A snapshot of the counters and histograms of this queue.
+  MMQMetrics Metrics() const { return metrics_.Snapshot(); }
+
+ protected:
+  // Adds a message to the buffer.
+  // Supports both copy and move semantics.
+  // THREAD SAFE. Does not block the calling thread unless the buffer is full and `DROP_ON_OVERFLOW` is `false`.
+  template <current::locks::MutexLockStatus, typename E, typename TIMESTAMP>  // `MutexLockStatus` is unused by MMQ.
+  idxts_t PublisherPublishImpl(E&& message, TIMESTAMP&& timestamp) {
+    static_assert(time::IsTimestamp<std::decay_t<TIMESTAMP>>::value, "");
+    uint64_t position;
+    idxts_t result;
+    if (!ClaimPosition(timestamp, position, result)) {
+      return idxts_t();
+    }
+    Slot& slot = ring_[position];
+    slot.index_timestamp = result;
+    slot.published_at = impl::MMQMetricsRecorder::Now();
+    metrics_.Published();
+    slot.message_body = std::forward<E>(message);
+    ring_.MarkReady(position);
+    return result;
+  }
+
+ private:
+  LockFreeMMQImpl(const LockFreeMMQImpl&) = delete;
+  LockFreeMMQImpl(LockFreeMMQImpl&&) = delete;
+  void operator=(const LockFreeMMQImpl&) = delete;
+  void operator=(LockFreeMMQImpl&&) = delete;
+
+  // Before any message is published, the "previous" timestamp is `-1`, as with MMQ, and the slots are free.
+  constexpr static int64_t kInitialLastUs = -1;
+  constexpr static int64_t kFreeSlotUs = std::numeric_limits<int64_t>::min();
+
+  // The slot of the ring for the message at the position `p` is claimed once `claimed_us` is past the timestamp
+  // of the position `p - 1`, and is ready to be consumed once `ready == p + 1`, see "ring.h".
+  struct Slot {
+    std::atomic<int64_t> claimed_us{kFreeSlotUs};
+    std::atomic<uint64_t> ready{0u};
+    idxts_t index_timestamp;
+    impl::MMQMetricsRecorder::clock_t::time_point published_at;
+    message_t message_body;
+  };
+
+  // Claims the position for the next message, along with its index and timestamp, see the top of this file.
+  // Returns `false` if the message is dropped due to the overflow, or if the queue is being destructed.
+  // Throws, claiming nothing, if the timestamp is not past the timestamp of the previous message.
+  template <typename TIMESTAMP>
+  bool ClaimPosition(const TIMESTAMP user_timestamp, uint64_t& position, idxts_t& result) {
+    while (true) {
+      if (ring_.Stopping()) {
+        return false;  // LCOV_EXCL_LINE
+      }
+      position = head_.load();
+      const int64_t last_us = position ? ring_[position - 1u].claimed_us.load() : kInitialLastUs;
+      if (head_.load() != position) {
+        continue;  // The slot of `position - 1` may have been claimed again meanwhile, for `position - 1 + ring size`.
+      }
+      Slot& slot = ring_[position];
+      int64_t slot_us = slot.claimed_us.load();
+      if (slot_us > last_us) {
+        // Claimed by another publisher, which is yet to advance the head. Do it for them.
+        uint64_t expected_position = position;
+        head_.compare_exchange_strong(expected_position, position + 1u);
+        continue;
+      }
+      if (!ring_.HasRoom(position)) {
+        if (!WaitForRoom(position)) {
+          return false;
+        }
+        continue;
+      }
+      // Taken here, after `last_us` is known, so that the default timestamp, `Now()`, is past it.
+      const auto timestamp = current::time::TimestampAsMicroseconds(user_timestamp);
+      if (!(timestamp.count() > last_us)) {
+        CURRENT_THROW(ss::InconsistentTimestampException(std::chrono::microseconds(last_us + 1), timestamp));
+      }
+      if (slot.claimed_us.compare_exchange_strong(slot_us, timestamp.count())) {
+        uint64_t expected_position = position;
+        head_.compare_exchange_strong(expected_position, position + 1u);
+        result = idxts_t(position + 1u, timestamp);
+        return true;
+      }
+    }
+  }
+
+  // Waits for the room in the ring for the message at `position`, or returns `false` if it is to be dropped.
+  template <bool DROP = DROP_ON_OVERFLOW>
+  std::enable_if_t<DROP, bool> WaitForRoom(uint64_t) {
+    metrics_.Dropped();
+    return false;  // Overflow. Discarding the message.
+  }
+
+  template <bool DROP = DROP_ON_OVERFLOW>
+  std::enable_if_t<!DROP, bool> WaitForRoom(uint64_t position) {
+    const auto wait_begin = impl::MMQMetricsRecorder::Now();
+    // Also done waiting if the position has been claimed meanwhile, as the next one is then to be tried.
+    const bool result =
+        ring_.WaitForRoom([this, position]() { return ring_.HasRoom(position) || head_.load() != position; });
+    metrics_.Blocked(wait_begin);
+    return result;
+  }
+
+  // The index and the timestamp of the most recently claimed message, to pass to the consumer as `last`.
+  // The slot of that message can not be claimed again before the consumer has gone past it.
+  idxts_t LastIndexAndTimestamp() const {
+    const uint64_t head = head_.load();
+    return idxts_t(head, std::chrono::microseconds(ring_[head - 1u].claimed_us.load()));
+  }
+
+  // The thread which extracts fully populated messages from the tail of the ring and feeds them to the consumer.
+  void ConsumerThread() {
+    current::bricks::system::ThreadPlacementPolicy().PlaceCurrentThread(
+        current::bricks::system::ThreadRole::MMQConsumer, ring_.Data(), ring_.DataSize());
+    // The `tail` position is local to the procesing thread.
+    uint64_t tail = 0u;
+    std::vector<Slot*> run;
+    impl::ConsumerFeeder<message_t, consumer_t> feeder(consumer_);
+
+    while (true) {
+      ring_.WaitForReady(tail);
+      if (ring_.Stopping()) {
+        return;  // LCOV_EXCL_LINE
+      }
+      tail = ring_.CollectReady(tail, run);
+      metrics_.Consuming(run);
+      feeder.Feed(run, LastIndexAndTimestamp());
+      run.clear();
+      ring_.Release(tail);
+    }
+  }
+
+  bool consumer_thread_created_ = false;
+
+  // The instance of the consuming side of the FIFO buffer.
+  consumer_t& consumer_;
+
+  impl::MPSCRing<Slot> ring_;
+
+  // The position to be claimed by the next message, possibly lagging by one, see `ClaimPosition()`.
+  alignas(64) std::atomic<uint64_t> head_{0u};
+
+  impl::MMQMetricsRecorder metrics_;
+
+  // The thread in which the consuming process is running.
+  std::thread consumer_thread_;
+};
+
+template <typename MESSAGE, typename CONSUMER, size_t DEFAULT_BUFFER_SIZE = 1024, bool DROP_ON_OVERFLOW = false>
+using LockFreeMMQ =
+    ss::EntryPublisher<LockFreeMMQImpl<MESSAGE, CONSUMER, DEFAULT_BUFFER_SIZE, DROP_ON_OVERFLOW>, MESSAGE>;
+
+}  // namespace mmq
+}  // namespace current
+
+#endif  // BLOCKS_MMQ_LOCK_FREE_MMQ_H
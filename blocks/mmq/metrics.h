@@ -0,0 +1,230 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+          (c) 2015 Maxim Zhurovich <zhurovich@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// The metrics of MMQ, MMPQ, and the lock-free MMQ, to size their buffers by: how full they get, how long
+// the publishers wait for room in them, how long the messages wait to be consumed, and how many are dropped.
+// Always on, at the cost of a read of the clock per message published, and per run of messages consumed,
+// and of a few atomic counters, so that no mutex is added to the publishing path.
+//
+// Use `Metrics()` of the queue, serve them as JSON with `ServeMMQMetrics(HTTP(port), path, queue)`, or publish them
+// into the process-wide metrics registry with `PublishMMQMetrics(name, queue)`.
+
+#ifndef BLOCKS_MMQ_METRICS_H
+#define BLOCKS_MMQ_METRICS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../../typesystem/struct.h"
+#include "../metrics/metrics.h"
+
+namespace current {
+namespace mmq {
+
+CURRENT_STRUCT(MMQLatencyHistogram) {
+  CURRENT_FIELD(count, uint64_t, 0u);
+  CURRENT_FIELD(total, std::chrono::microseconds, std::chrono::microseconds(0));
+  CURRENT_FIELD(max, std::chrono::microseconds, std::chrono::microseconds(0));
+  CURRENT_FIELD(buckets, std::vector<uint64_t>);
+  CURRENT_FIELD_DESCRIPTION(buckets, "The counts by duration: under 1us, 2us, 4us, etc., the last one the rest.");
+};
+
+CURRENT_STRUCT(MMQMetrics) {
+  CURRENT_FIELD(capacity, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(capacity, "The number of messages the buffer holds, zero if it is unbounded.");
+  CURRENT_FIELD(depth, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(depth, "The messages published and not yet passed to the consumer now.");
+  CURRENT_FIELD(max_depth, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(max_depth, "The high-water mark of `depth`.");
+  CURRENT_FIELD(published, uint64_t, 0u);
+  CURRENT_FIELD(consumed, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(consumed, "The messages passed to the consumer.");
+  CURRENT_FIELD(dropped, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(dropped, "The messages discarded, as the buffer was full.");
+  CURRENT_FIELD(blocked, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(blocked, "The messages the publishers of which had to wait for room in the buffer.");
+  CURRENT_FIELD(uptime, std::chrono::microseconds, std::chrono::microseconds(0));
+  CURRENT_FIELD(consumed_per_second, double, 0.0);
+  CURRENT_FIELD_DESCRIPTION(consumed_per_second, "The throughput, averaged over the uptime.");
+  CURRENT_FIELD(publisher_wait, MMQLatencyHistogram);
+  CURRENT_FIELD_DESCRIPTION(publisher_wait, "The time the publishers have waited for room in the buffer, if at all.");
+  CURRENT_FIELD(consumer_latency, MMQLatencyHistogram);
+  CURRENT_FIELD_DESCRIPTION(consumer_latency, "The time from a message being published to it being dispatched.");
+};
+
+// Serves the metrics of `queue` as JSON at `path`, e.g. `scope += ServeMMQMetrics(HTTP(port), "/.mmq", mmq);`.
+template <typename HTTP_SERVER, typename QUEUE>
+[[nodiscard]] auto ServeMMQMetrics(HTTP_SERVER& server, const std::string& path, const QUEUE& queue) {
+  return server.Register(path, [&queue](auto r) { r(queue.Metrics()); });
+}
+
+// Adds `metrics` to the snapshot of the metrics registry, as `mmq_*` metrics labeled by `labels`.
+inline void AddMMQMetrics(current::metrics::MetricsSnapshot& snapshot,
+                          const current::metrics::labels_t& labels,
+                          const MMQMetrics& metrics) {
+  using namespace current::metrics;
+  AddGauge(snapshot, "mmq_capacity", labels, metrics.capacity, "The number of messages the buffer holds.");
+  AddGauge(snapshot, "mmq_depth", labels, metrics.depth, "The messages published and not yet consumed.");
+  AddGauge(snapshot, "mmq_max_depth", labels, metrics.max_depth, "The high-water mark of `mmq_depth`.");
+  AddCounter(snapshot, "mmq_published_total", labels, metrics.published, "The messages published.");
+  AddCounter(snapshot, "mmq_consumed_total", labels, metrics.consumed, "The messages passed to the consumer.");
+  AddCounter(snapshot, "mmq_dropped_total", labels, metrics.dropped, "The messages discarded, as the buffer was full.");
+  AddCounter(snapshot, "mmq_blocked_total", labels, metrics.blocked, "The messages the publishers of which waited.");
+  AddPowersOfTwoMicrosecondsHistogram(snapshot,
+                                      "mmq_publisher_wait_us",
+                                      labels,
+                                      metrics.publisher_wait.buckets,
+                                      metrics.publisher_wait.total,
+                                      "The time the publishers have waited for room in the buffer.");
+  AddPowersOfTwoMicrosecondsHistogram(snapshot,
+                                      "mmq_consumer_latency_us",
+                                      labels,
+                                      metrics.consumer_latency.buckets,
+                                      metrics.consumer_latency.total,
+                                      "The time from a message being published to it being dispatched.");
+}
+
+// Publishes the metrics of `queue`, labeled `queue="<name>"`, for as long as the returned scope is alive.
+template <typename QUEUE>
+[[nodiscard]] current::metrics::CollectorScope PublishMMQMetrics(
+    const std::string& name,
+    const QUEUE& queue,
+    current::metrics::Registry& registry = current::metrics::ProcessMetrics()) {
+  return registry.AddCollector([name, &queue](current::metrics::MetricsSnapshot& snapshot) {
+    AddMMQMetrics(snapshot, {{"queue", name}}, queue.Metrics());
+  });
+}
+
+namespace impl {
+
+class MMQMetricsRecorder final {
+ public:
+  using clock_t = std::chrono::steady_clock;
+  constexpr static size_t kBuckets = 32u;
+
+  explicit MMQMetricsRecorder(uint64_t capacity) : capacity_(capacity), started_(clock_t::now()) {}
+
+  static clock_t::time_point Now() { return clock_t::now(); }
+
+  void Published() {
+    const uint64_t depth = ++published_ - consumed_.load();
+    uint64_t max_depth = max_depth_.load();
+    while (depth > max_depth && !max_depth_.compare_exchange_weak(max_depth, depth)) {
+    }
+  }
+
+  void Dropped() { ++dropped_; }
+
+  // To be called by the publisher once it has waited for the room in the buffer since `since`.
+  void Blocked(clock_t::time_point since) {
+    ++blocked_;
+    publisher_wait_.Add(since, Now());
+  }
+
+  // To be called right before the run of entries, with their `published_at` times, is passed to the consumer.
+  // The clock is read once per run, so the time the consumer spends on the earlier messages of the run is not
+  // counted towards the latency of the later ones.
+  template <typename ENTRY>
+  void Consuming(const std::vector<ENTRY*>& entries) {
+    if (!entries.empty()) {
+      const clock_t::time_point now = Now();
+      for (const ENTRY* e : entries) {
+        consumer_latency_.Add(e->published_at, now);
+      }
+      consumed_ += entries.size();
+    }
+  }
+
+  MMQMetrics Snapshot() const {
+    MMQMetrics metrics;
+    metrics.capacity = capacity_;
+    metrics.consumed = consumed_.load();
+    metrics.published = published_.load();
+    metrics.depth = metrics.published > metrics.consumed ? metrics.published - metrics.consumed : 0u;
+    metrics.max_depth = max_depth_.load();
+    metrics.dropped = dropped_.load();
+    metrics.blocked = blocked_.load();
+    metrics.uptime = std::chrono::duration_cast<std::chrono::microseconds>(Now() - started_);
+    if (metrics.uptime.count() > 0) {
+      metrics.consumed_per_second = 1e6 * metrics.consumed / metrics.uptime.count();
+    }
+    publisher_wait_.Export(metrics.publisher_wait);
+    consumer_latency_.Export(metrics.consumer_latency);
+    return metrics;
+  }
+
+ private:
+  struct Histogram final {
+    std::atomic<uint64_t> count{0u};
+    std::atomic<uint64_t> total_us{0u};
+    std::atomic<uint64_t> max_us{0u};
+    std::atomic<uint64_t> buckets[kBuckets] = {};
+
+    void Add(clock_t::time_point from, clock_t::time_point to) {
+      const uint64_t us = static_cast<uint64_t>(
+          std::max(std::chrono::duration_cast<std::chrono::microseconds>(to - from).count(), int64_t(0)));
+      ++count;
+      total_us += us;
+      uint64_t max = max_us.load();
+      while (us > max && !max_us.compare_exchange_weak(max, us)) {
+      }
+      size_t bucket = 0u;
+      while (bucket + 1u < kBuckets && (us >> bucket)) {
+        ++bucket;
+      }
+      ++buckets[bucket];
+    }
+
+    void Export(MMQLatencyHistogram& output) const {
+      output.count = count.load();
+      output.total = std::chrono::microseconds(total_us.load());
+      output.max = std::chrono::microseconds(max_us.load());
+      output.buckets.clear();
+      for (const auto& bucket : buckets) {
+        output.buckets.push_back(bucket.load());
+      }
+    }
+  };
+
+  const uint64_t capacity_;
+  const clock_t::time_point started_;
+  // Updated by the publishers and by the consumer respectively, hence on cache lines of their own.
+  alignas(64) std::atomic<uint64_t> published_{0u};
+  alignas(64) std::atomic<uint64_t> consumed_{0u};
+  alignas(64) std::atomic<uint64_t> max_depth_{0u};
+  std::atomic<uint64_t> dropped_{0u};
+  std::atomic<uint64_t> blocked_{0u};
+  Histogram publisher_wait_;
+  Histogram consumer_latency_;
+};
+
+}  // namespace impl
+}  // namespace mmq
+}  // namespace current
+
+#endif  // BLOCKS_MMQ_METRICS_H
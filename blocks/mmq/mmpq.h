@@ -26,15 +26,29 @@ SOFTWARE.
 #define BLOCKS_MMQ_MMPQ_H
 
 // MMPQ is an in-memory priority queue, with the external interface loosely resembling the one of the original MMQ.
+// As with MMQ, the consumers that accept batches are fed all the messages up to the head at once.
+// The depth, and the times from the messages being published to them being consumed, are exposed via `Metrics()`.
+//
+// The messages are kept in the order of their timestamps, then indexes, in a queue built for the timestamps
+// which mostly come in order, see "reorder_queue.h", so that no allocation is made per message.
+//
+// With the maximum lateness set, the head is also moved automatically, to that much before the most recent
+// timestamp published, so that the messages are released once they are that late, whether `UpdateHead()` is called
+// or not. The messages published later than that are released right away, and thus out of order.
 
 #include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <thread>
-#include <set>
+#include <vector>
+
+#include "consumer_feeder.h"
+#include "metrics.h"
+#include "reorder_queue.h"
 
 #include "../ss/ss.h"
 
+#include "../../bricks/system/placement.h"
 #include "../../bricks/time/chrono.h"
 
 namespace current {
@@ -52,7 +66,11 @@ class MMPQImpl {
   // by the instance of MMPQImpl. See "blocks/ss/ss.h" and its test for possible callee signatures.
   using consumer_t = CONSUMER;
 
-  MMPQImpl(consumer_t& consumer) : consumer_(consumer), consumer_thread_(&MMPQImpl::ConsumerThread, this) {
+  MMPQImpl(consumer_t& consumer, Optional<std::chrono::microseconds> max_lateness = nullptr)
+      : consumer_(consumer),
+        max_lateness_(max_lateness),
+        metrics_(0u),
+        consumer_thread_(&MMPQImpl::ConsumerThread, this) {
     consumer_thread_created_ = true;
   }
 
@@ -69,6 +87,9 @@ class MMPQImpl {
     }
   }
 
+  // THREAD SAFE. A snapshot of the counters and histograms of this queue, which is unbounded, and never drops.
+  MMQMetrics Metrics() const { return metrics_.Snapshot(); }
+
   // Adds a message to the buffer. Supports both copy and move semantics. THREAD SAFE.
   template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock,
             class E,
@@ -80,7 +101,11 @@ class MMPQImpl {
     // Does not update `last_idx_ts_.us` at all. `UpdateHead()` must be called.
     // This is to ensure the regular `Publish`, coming through the interface defined in `Blocks/ss/pubsub.h`,
     // can publish into the future and utilize the full power of MMPQ.
-    queue_.emplace(std::forward<E>(entry), idxts_t(last_idx_ts_.index, us));
+    queue_.Push(Entry(std::forward<E>(entry), idxts_t(last_idx_ts_.index, us)));
+    if (us > max_published_us_) {
+      max_published_us_ = us;
+    }
+    metrics_.Published();
     condition_variable_.notify_all();
     return last_idx_ts_;
   }
@@ -104,21 +129,49 @@ class MMPQImpl {
   void operator=(const MMPQImpl&) = delete;
   void operator=(MMPQImpl&&) = delete;
 
+  // The user-provided head, or the one the maximum lateness allows, whichever is further.
+  std::chrono::microseconds Head() const {
+    if (Exists(max_lateness_) && max_published_us_ - Value(max_lateness_) > last_idx_ts_.us) {
+      return max_published_us_ - Value(max_lateness_);
+    } else {
+      return last_idx_ts_.us;
+    }
+  }
+
+  // Takes all the entries up to the head out of the queue at once, and feeds them to the consumer outside the lock.
   void ConsumerThread() {
+    current::bricks::system::ThreadPlacementPolicy().PlaceCurrentThread(
+        current::bricks::system::ThreadRole::MMQConsumer);
+    std::vector<Entry> entries;
+    std::vector<Entry*> run;
+    impl::ConsumerFeeder<message_t, consumer_t> feeder(consumer_);
+
     while (true) {
-      std::unique_lock<std::mutex> lock(mutex_);
+      idxts_t last_idx_ts;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        condition_variable_.wait(
+            lock, [this] { return (!queue_.Empty() && queue_.Front().index_timestamp.us <= Head()) || destructing_; });
 
-      condition_variable_.wait(lock, [this] {
-        return (!queue_.empty() && queue_.begin()->index_timestamp.us <= last_idx_ts_.us) || destructing_;
-      });
+        if (destructing_) {
+          return;  // LCOV_EXCL_LINE
+        }
 
-      if (destructing_) {
-        return;  // LCOV_EXCL_LINE
+        const std::chrono::microseconds head = Head();
+        while (!queue_.Empty() && queue_.Front().index_timestamp.us <= head) {
+          entries.push_back(queue_.PopFront());
+        }
+        last_idx_ts = idxts_t(last_idx_ts_.index, head);
       }
 
-      auto it = queue_.begin();
-      consumer_(std::move(const_cast<Entry&>(*it).message_body), it->index_timestamp, last_idx_ts_);
-      queue_.erase(it);
+      for (Entry& entry : entries) {
+        run.push_back(&entry);
+      }
+      metrics_.Consuming(run);
+      feeder.Feed(run, last_idx_ts);
+      run.clear();
+      entries.clear();
     }
   }
 
@@ -131,21 +184,30 @@ class MMPQImpl {
   struct Entry {
     idxts_t index_timestamp;
     message_t message_body;
+    impl::MMQMetricsRecorder::clock_t::time_point published_at = impl::MMQMetricsRecorder::Now();
     Entry() = default;
     Entry(Entry&&) = default;
+    Entry& operator=(Entry&&) = default;
     Entry(message_t&& message_body, idxts_t index_timestamp)
         : index_timestamp(index_timestamp), message_body(std::move(message_body)) {}
-    bool operator<(const Entry& rhs) const { return index_timestamp.us < rhs.index_timestamp.us; }
+    bool operator<(const Entry& rhs) const {
+      return index_timestamp.us < rhs.index_timestamp.us ||
+             (index_timestamp.us == rhs.index_timestamp.us && index_timestamp.index < rhs.index_timestamp.index);
+    }
   };
 
-  std::set<Entry> queue_;
+  impl::ReorderQueue<Entry> queue_;
   idxts_t last_idx_ts_ = idxts_t(0, std::chrono::microseconds(-1));
+  const Optional<std::chrono::microseconds> max_lateness_;
+  std::chrono::microseconds max_published_us_ = std::chrono::microseconds(-1);
   std::mutex mutex_;
   std::condition_variable condition_variable_;
 
   // For safe thread destruction.
   bool destructing_ = false;
 
+  impl::MMQMetricsRecorder metrics_;
+
   // The thread in which the consuming process is running.
   std::thread consumer_thread_;
 };
@@ -30,7 +30,8 @@ SOFTWARE.
 // One of the objectives of MMQ is to minimize the time for which the thread publishing the message is blocked.
 //
 // Messages can be published into a MMQ via standard `Publish()` interface defined in `Blocks/ss/ss.h`.
-// The consumer is run in a separate thread, and is fed one message at a time via `OnMessage()`.
+// The consumer is run in a separate thread, and is fed the messages one at a time, or, if it accepts batches,
+// all the messages published contiguously since the previous call at once, as `ss::EntriesBatch`.
 //
 // The buffer size, i.e. the number of the messages MMQ can hold, is defined by the constructor argument
 // `buffer_size`. For usability reasons the default value for it can be set via `DEFAULT_BUFFER_SIZE`
@@ -45,6 +46,9 @@ SOFTWARE.
 //      the messages will be added in the order in which the functions were called. However, for any particular
 //      thread, MMQ DOES GUARANTEE that the order of messages published from this thread will be respected.
 //  Default behavior of MMQ is non-dropping and can be controlled via the `DROP_ON_OVERFLOW` template argument.
+//
+// The depth, the drops, and the times the publishers and the messages wait are exposed via `Metrics()`,
+// see "metrics.h".
 
 #include <chrono>
 #include <condition_variable>
@@ -54,8 +58,12 @@ SOFTWARE.
 #include <type_traits>
 #include <vector>
 
+#include "consumer_feeder.h"
+#include "metrics.h"
+
 #include "../ss/ss.h"
 
+#include "../../bricks/system/placement.h"
 #include "../../bricks/time/chrono.h"
 
 namespace current {
@@ -77,6 +85,7 @@ class MMQImpl {
       : consumer_(consumer),
         circular_buffer_size_(buffer_size),
         circular_buffer_(circular_buffer_size_),
+        metrics_(circular_buffer_size_),
         consumer_thread_(&MMQImpl::ConsumerThread, this) {
     consumer_thread_created_ = true;
   }
@@ -94,6 +103,9 @@ class MMQImpl {
     }
   }
 
+  // THREAD SAFE. A snapshot of the counters and histograms of this queue.
+  MMQMetrics Metrics() const { return metrics_.Snapshot(); }
+
  protected:
   // Adds a message to the buffer.
   // Supports both copy and move semantics.
@@ -133,13 +145,19 @@ class MMQImpl {
 
   // The thread which extracts fully populated messages from the tail of the buffer and feeds them to the consumer.
   void ConsumerThread() {
+    current::bricks::system::ThreadPlacementPolicy().PlaceCurrentThread(
+        current::bricks::system::ThreadRole::MMQConsumer,
+        circular_buffer_.data(),
+        sizeof(Entry) * circular_buffer_.size());
     // The `tail` pointer is local to the procesing thread.
     size_t tail = 0u;
     idxts_t save_last_idx_ts;
+    std::vector<Entry*> run;
+    impl::ConsumerFeeder<message_t, consumer_t> feeder(consumer_);
 
     while (true) {
       {
-        // Get the next message, which is `READY` to be exported.
+        // Get all the contiguous messages, which are `READY` to be exported.
         // MUTEX-LOCKED, except for the condition variable part.
         std::unique_lock<std::mutex> lock(mutex_);
         condition_variable_.wait(
@@ -147,29 +165,34 @@ class MMQImpl {
         if (destructing_) {
           return;  // LCOV_EXCL_LINE
         }
-        circular_buffer_[tail].status = Entry::BEING_EXPORTED;
+        for (size_t i = tail; circular_buffer_[i].status == Entry::READY; Increment(i)) {
+          circular_buffer_[i].status = Entry::BEING_EXPORTED;
+          run.push_back(&circular_buffer_[i]);
+        }
         save_last_idx_ts = last_idx_ts_;
       }
+      metrics_.Consuming(run);
 
       {
-        // Then, export the message.
+        // Then, export the messages.
         // NO MUTEX REQUIRED.
-        consumer_(
-            std::move(circular_buffer_[tail].message_body), circular_buffer_[tail].index_timestamp, save_last_idx_ts);
+        feeder.Feed(run, save_last_idx_ts);
       }
 
       {
-        // Finally, mark the message entry in the buffer as `FREE` for overwriting.
+        // Finally, mark the message entries in the buffer as `FREE` for overwriting, all at once.
         // MUTEX-LOCKED.
         {
           std::lock_guard<std::mutex> lock(mutex_);
-          circular_buffer_[tail].status = Entry::FREE;
+          for (Entry* entry : run) {
+            entry->status = Entry::FREE;
+          }
         }
-        Increment(tail);
+        tail = (tail + run.size()) % circular_buffer_size_;
+        run.clear();
 
-        // Need to notify message publishers that, in case they were waiting, a new slot is now available.
-        // TODO(dkorolev) + TODO(mzhurovich): Think whether this might be a performance bottleneck.
-        condition_variable_.notify_one();
+        // Need to notify message publishers that, in case they were waiting, new slots are now available.
+        condition_variable_.notify_all();
       }
     }
   }
@@ -193,9 +216,12 @@ class MMQImpl {
       Increment(head_);
       circular_buffer_[index].status = Entry::BEING_IMPORTED;
       circular_buffer_[index].index_timestamp = last_idx_ts_;
+      circular_buffer_[index].published_at = impl::MMQMetricsRecorder::Now();
+      metrics_.Published();
       return std::make_pair(true, index);
     } else {
       // Overflow. Discarding the message.
+      metrics_.Dropped();
       return std::make_pair(false, 0u);
     }
   }
@@ -216,13 +242,15 @@ class MMQImpl {
     if (!(timestamp > last_idx_ts_.us)) {
       CURRENT_THROW(ss::InconsistentTimestampException(last_idx_ts_.us + std::chrono::microseconds(1), timestamp));
     }
-    while (circular_buffer_[head_].status != Entry::FREE) {
+    if (circular_buffer_[head_].status != Entry::FREE) {
       // Waiting for the next empty slot in the buffer.
+      const auto wait_begin = impl::MMQMetricsRecorder::Now();
       condition_variable_.wait(lock,
                                [this] { return (circular_buffer_[head_].status == Entry::FREE) || destructing_; });
       if (destructing_) {
         return std::make_pair(false, 0u);  // LCOV_EXCL_LINE
       }
+      metrics_.Blocked(wait_begin);
     }
     const size_t index = head_;
     ++last_idx_ts_.index;
@@ -230,6 +258,8 @@ class MMQImpl {
     Increment(head_);
     circular_buffer_[index].status = Entry::BEING_IMPORTED;
     circular_buffer_[index].index_timestamp = last_idx_ts_;
+    circular_buffer_[index].published_at = impl::MMQMetricsRecorder::Now();
+    metrics_.Published();
     return std::make_pair(true, index);
   }
 
@@ -253,6 +283,7 @@ class MMQImpl {
   // The `Entry` struct keeps the entries along with their timestamps and completion status.
   struct Entry {
     idxts_t index_timestamp;
+    impl::MMQMetricsRecorder::clock_t::time_point published_at;
     message_t message_body;
     enum { FREE, BEING_IMPORTED, READY, BEING_EXPORTED } status = Entry::FREE;
   };
@@ -269,6 +300,8 @@ class MMQImpl {
   // For safe thread destruction.
   bool destructing_ = false;
 
+  impl::MMQMetricsRecorder metrics_;
+
   // The thread in which the consuming process is running.
   std::thread consumer_thread_;
 };
@@ -0,0 +1,108 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+          (c) 2015 Maxim Zhurovich <zhurovich@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#ifndef BLOCKS_MMQ_REORDER_QUEUE_H
+#define BLOCKS_MMQ_REORDER_QUEUE_H
+
+#include <algorithm>
+#include <vector>
+
+namespace current {
+namespace mmq {
+namespace impl {
+
+// The priority queue for the entries which mostly come in order, ordered by their `operator<`.
+//
+// The entries not less than the most recent one in order are appended to a ring, and the rest go to a heap,
+// which thus stays as small as the number of the entries out of order. Both reuse their memory once grown,
+// so no allocation is made per entry, and the ones in order are only moved twice, in and out.
+template <typename ENTRY>
+class ReorderQueue final {
+ public:
+  bool Empty() const { return !ring_size_ && heap_.empty(); }
+  size_t Size() const { return ring_size_ + heap_.size(); }
+
+  // The number of the entries which have come out of order, and are kept in the heap.
+  size_t OutOfOrder() const { return heap_.size(); }
+
+  void Push(ENTRY&& entry) {
+    if (!ring_size_ || !(entry < ring_[(ring_begin_ + ring_size_ - 1u) & ring_mask_])) {
+      if (ring_size_ == ring_.size()) {
+        Grow();
+      }
+      ring_[(ring_begin_ + ring_size_) & ring_mask_] = std::move(entry);
+      ++ring_size_;
+    } else {
+      heap_.push_back(std::move(entry));
+      std::push_heap(heap_.begin(), heap_.end(), Greater);
+    }
+  }
+
+  // The least entry; the queue must not be empty.
+  const ENTRY& Front() const { return FrontIsInHeap() ? heap_.front() : ring_[ring_begin_]; }
+
+  // Moves the least entry out of the queue; the queue must not be empty.
+  ENTRY PopFront() {
+    if (FrontIsInHeap()) {
+      std::pop_heap(heap_.begin(), heap_.end(), Greater);
+      ENTRY result = std::move(heap_.back());
+      heap_.pop_back();
+      return result;
+    } else {
+      ENTRY result = std::move(ring_[ring_begin_]);
+      ring_begin_ = (ring_begin_ + 1u) & ring_mask_;
+      --ring_size_;
+      return result;
+    }
+  }
+
+ private:
+  static bool Greater(const ENTRY& lhs, const ENTRY& rhs) { return rhs < lhs; }
+
+  bool FrontIsInHeap() const { return !heap_.empty() && (!ring_size_ || heap_.front() < ring_[ring_begin_]); }
+
+  // Doubles the ring, keeping its size the power of two, and moves the entries to its beginning.
+  void Grow() {
+    std::vector<ENTRY> ring(std::max(ring_.size() * 2u, size_t(16u)));
+    for (size_t i = 0u; i < ring_size_; ++i) {
+      ring[i] = std::move(ring_[(ring_begin_ + i) & ring_mask_]);
+    }
+    ring_.swap(ring);
+    ring_begin_ = 0u;
+    ring_mask_ = ring_.size() - 1u;
+  }
+
+  std::vector<ENTRY> ring_;
+  size_t ring_begin_ = 0u;
+  size_t ring_size_ = 0u;
+  size_t ring_mask_ = 0u;
+  std::vector<ENTRY> heap_;
+};
+
+}  // namespace impl
+}  // namespace mmq
+}  // namespace current
+
+#endif  // BLOCKS_MMQ_REORDER_QUEUE_H
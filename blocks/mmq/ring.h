@@ -0,0 +1,180 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+          (c) 2015 Maxim Zhurovich <zhurovich@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// The multiple-producers-single-consumer ring of slots behind `LockFreeMMQ` and the RipCurrent inter-block queues.
+//
+// The ring is of the size of the power of two, and holds up to `capacity` messages. The messages are at the
+// increasing positions, and the slot for the position `p` is ready to be consumed once its `ready == p + 1`.
+// How the publishers claim the positions is up to the user of the ring; the ring tells whether there is room
+// for a position, marks the slots ready, and parks and wakes up the consumer and the publishers waiting for room.
+//
+// The consumer spins for a while before parking, so that it is not woken up for each message under steady load,
+// and takes all the contiguous ready messages at once, releasing their slots together.
+
+#ifndef BLOCKS_MMQ_RING_H
+#define BLOCKS_MMQ_RING_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace current {
+namespace mmq {
+namespace impl {
+
+// The `SLOT` is the user-defined struct with the `std::atomic<uint64_t> ready{0u};` field.
+template <typename SLOT>
+class MPSCRing final {
+ public:
+  explicit MPSCRing(size_t capacity)
+      : capacity_(capacity ? capacity : 1u), ring_mask_(RingSize(capacity_) - 1u), slots_(RingSize(capacity_)) {}
+
+  SLOT& operator[](uint64_t position) { return slots_[position & ring_mask_]; }
+  const SLOT& operator[](uint64_t position) const { return slots_[position & ring_mask_]; }
+
+  // For the placement of the memory of the ring, see "bricks/system/placement.h".
+  const SLOT* Data() const { return slots_.data(); }
+  size_t DataSize() const { return sizeof(SLOT) * slots_.size(); }
+
+  bool HasRoom(uint64_t position) const { return position < released_.load() + capacity_; }
+
+  // Blocks the publisher until `condition()`, normally a check of `HasRoom()`, holds.
+  // Returns `false` if the ring has been stopped meanwhile.
+  template <typename F>
+  bool WaitForRoom(F&& condition) {
+    if (!SpinUntil(condition)) {
+      ++parked_publishers_;
+      std::unique_lock<std::mutex> lock(parking_mutex_);
+      publishers_condition_variable_.wait(lock, [this, &condition]() { return condition() || stopping_; });
+      --parked_publishers_;
+    }
+    return !stopping_;
+  }
+
+  void MarkReady(uint64_t position) {
+    (*this)[position].ready.store(position + 1u);
+    if (consumer_parked_) {
+      std::lock_guard<std::mutex> lock(parking_mutex_);
+      consumer_condition_variable_.notify_one();
+    }
+  }
+
+  // Blocks the consumer until the slot for `tail` is ready, or the ring has been stopped.
+  // Returns whether the slot is ready, which it may well be even if the ring has been stopped.
+  bool WaitForReady(uint64_t tail) {
+    const SLOT& slot = (*this)[tail];
+    const auto ready = [&slot, tail]() { return slot.ready.load() == tail + 1u; };
+    if (!SpinUntil(ready)) {
+      std::unique_lock<std::mutex> lock(parking_mutex_);
+      consumer_parked_ = true;
+      consumer_condition_variable_.wait(lock, [this, &ready]() { return ready() || stopping_; });
+      consumer_parked_ = false;
+    }
+    return ready();
+  }
+
+  // Appends the contiguous ready slots starting from `tail` to `run`, and returns the position past them.
+  // No slot past the ones claimed can look ready, as it is still holding the message from the previous lap.
+  uint64_t CollectReady(uint64_t tail, std::vector<SLOT*>& run) {
+    while ((*this)[tail].ready.load() == tail + 1u) {
+      run.push_back(&(*this)[tail]);
+      ++tail;
+    }
+    return tail;
+  }
+
+  // Frees the slots before `tail`, and notifies the publishers waiting for the room in the ring, if there are any.
+  void Release(uint64_t tail) {
+    released_.store(tail);
+    if (parked_publishers_) {
+      std::lock_guard<std::mutex> lock(parking_mutex_);
+      publishers_condition_variable_.notify_all();
+    }
+  }
+
+  // Wakes up the consumer and the publishers, for the owner of the ring to shut it down.
+  void Stop() {
+    std::lock_guard<std::mutex> lock(parking_mutex_);
+    stopping_ = true;
+    consumer_condition_variable_.notify_all();
+    publishers_condition_variable_.notify_all();
+  }
+
+  bool Stopping() const { return stopping_; }
+
+ private:
+  MPSCRing(const MPSCRing&) = delete;
+  MPSCRing(MPSCRing&&) = delete;
+  void operator=(const MPSCRing&) = delete;
+  void operator=(MPSCRing&&) = delete;
+
+  // How many times the waiting threads yield before parking.
+  constexpr static int kSpinsBeforeParking = 64;
+
+  static size_t RingSize(size_t capacity) {
+    size_t result = 1u;
+    while (result < capacity) {
+      result *= 2u;
+    }
+    return result;
+  }
+
+  template <typename F>
+  static bool SpinUntil(F&& condition) {
+    for (int i = 0; i < kSpinsBeforeParking; ++i) {
+      if (condition()) {
+        return true;
+      }
+      std::this_thread::yield();
+    }
+    return condition();
+  }
+
+  // The number of messages the ring is allowed to hold, and the mask to map positions onto its slots.
+  const uint64_t capacity_;
+  const uint64_t ring_mask_;
+
+  std::vector<SLOT> slots_;
+
+  // The number of positions consumed and released, on its own cache line.
+  alignas(64) std::atomic<uint64_t> released_{0u};
+
+  // For parking the consumer and the publishers waiting for the room in the ring.
+  std::mutex parking_mutex_;
+  std::condition_variable consumer_condition_variable_;
+  std::condition_variable publishers_condition_variable_;
+  std::atomic_bool consumer_parked_{false};
+  std::atomic<size_t> parked_publishers_{0u};
+
+  std::atomic_bool stopping_{false};
+};
+
+}  // namespace impl
+}  // namespace mmq
+}  // namespace current
+
+#endif  // BLOCKS_MMQ_RING_H
@@ -0,0 +1,296 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+          (c) 2015 Maxim Zhurovich <zhurovich@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#ifndef BLOCKS_MMQ_SHARDED_MMQ_H
+#define BLOCKS_MMQ_SHARDED_MMQ_H
+
+// The multi-consumer version of MMQ, for the consumers too slow for a single thread to keep up with the publishers.
+//
+// The messages are spread over N shards, each with its own ring and its own consumer thread, by the hash of
+// the key the `SHARD_KEY` functor returns for each of them. The messages with the same key go to the same shard,
+// and are consumed in the order in which they were published; no order is kept across the shards.
+//
+// The indexes and the timestamps are assigned across all the shards, so they keep increasing as with MMQ,
+// but each consumer only sees the indexes of its own shard, and `last` is the most recently published message.
+//
+// There is one consumer per shard, or one consumer for all of them, which is then called from N threads at once,
+// and must be thread safe. The overflow strategies are the ones of MMQ, applied to each shard on its own.
+//
+// Example:
+//   struct ByUser { const std::string& operator()(const Event& e) const { return e.user; } };
+//   ShardedMMQ<Event, Enricher, ByUser> mmq(enricher, 8u);  // `Enricher` must be thread safe.
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "consumer_feeder.h"
+#include "metrics.h"
+
+#include "../ss/ss.h"
+
+#include "../../bricks/system/placement.h"
+#include "../../bricks/time/chrono.h"
+
+namespace current {
+namespace mmq {
+
+template <typename MESSAGE,
+          typename CONSUMER,
+          typename SHARD_KEY,
+          size_t DEFAULT_BUFFER_SIZE = 1024,
+          bool DROP_ON_OVERFLOW = false>
+class ShardedMMQImpl {
+  static_assert(current::ss::IsEntrySubscriber<CONSUMER, MESSAGE>::value, "");
+
+ public:
+  // The type of messages to store and dispatch.
+  using message_t = MESSAGE;
+
+  // Consumers' `operator()` will be called from the dedicated threads, one per shard, which are spawned and owned
+  // by the instance of ShardedMMQImpl. See "blocks/ss/ss.h" and its test for possible callee signatures.
+  using consumer_t = CONSUMER;
+
+  // The functor returning the key of the message, of any type `std::hash` is defined for.
+  using shard_key_t = SHARD_KEY;
+
+  // One consumer for all the `shards`, called from as many threads at once.
+  ShardedMMQImpl(consumer_t& consumer,
+                 size_t shards,
+                 size_t buffer_size = DEFAULT_BUFFER_SIZE,
+                 shard_key_t shard_key = shard_key_t())
+      : ShardedMMQImpl(std::vector<consumer_t*>(shards, &consumer), buffer_size, std::move(shard_key)) {}
+
+  // One shard per consumer.
+  ShardedMMQImpl(const std::vector<consumer_t*>& consumers,
+                 size_t buffer_size = DEFAULT_BUFFER_SIZE,
+                 shard_key_t shard_key = shard_key_t())
+      : shard_key_(std::move(shard_key)), metrics_(consumers.size() * buffer_size) {
+    CURRENT_ASSERT(!consumers.empty());
+    for (consumer_t* consumer : consumers) {
+      shards_.emplace_back(std::make_unique<Shard>(*consumer, buffer_size));
+    }
+    for (auto& shard : shards_) {
+      shard->consumer_thread = std::thread(&ShardedMMQImpl::ConsumerThread, this, std::ref(*shard));
+    }
+  }
+
+  // The destructor waits for the consumer threads to terminate, which implies committing all the queued messages.
+  ~ShardedMMQImpl() {
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      shard->destructing = true;
+      shard->condition_variable.notify_all();
+    }
+    for (auto& shard : shards_) {
+      CURRENT_ASSERT(shard->consumer_thread.joinable());
+      shard->consumer_thread.join();
+    }
+  }
+
+  size_t ShardsCount() const { return shards_.size(); }
+
+  // THREAD SAFE. A snapshot of the counters and histograms of all the shards together.
+  MMQMetrics Metrics() const { return metrics_.Snapshot(); }
+
+ protected:
+  // Adds a message to the buffer of its shard.
+  // Supports both copy and move semantics.
+  // THREAD SAFE. Blocks the calling thread for as short period of time as possible.
+  template <current::locks::MutexLockStatus, typename E, typename TIMESTAMP>  // `MutexLockStatus` is unused by MMQ.
+  idxts_t PublisherPublishImpl(E&& message, TIMESTAMP&& timestamp) {
+    Shard& shard = *shards_[std::hash<std::decay_t<decltype(shard_key_(message))>>()(shard_key_(message)) %
+                            shards_.size()];
+    const std::pair<bool, size_t> index = Allocate(shard, std::forward<TIMESTAMP>(timestamp));
+    if (index.first) {
+      shard.circular_buffer[index.second].message_body = std::forward<E>(message);
+      Commit(shard, index.second);
+      return shard.circular_buffer[index.second].index_timestamp;
+    } else {
+      return idxts_t();
+    }
+  }
+
+ private:
+  ShardedMMQImpl(const ShardedMMQImpl&) = delete;
+  ShardedMMQImpl(ShardedMMQImpl&&) = delete;
+  void operator=(const ShardedMMQImpl&) = delete;
+  void operator=(ShardedMMQImpl&&) = delete;
+
+  // The `Entry` struct keeps the entries along with their timestamps and completion status.
+  struct Entry {
+    idxts_t index_timestamp;
+    impl::MMQMetricsRecorder::clock_t::time_point published_at;
+    message_t message_body;
+    enum { FREE, BEING_IMPORTED, READY, BEING_EXPORTED } status = Entry::FREE;
+  };
+
+  // The circular buffer of the shard, with `head` owned by the publishers and `tail` local to its consumer thread.
+  struct Shard {
+    consumer_t& consumer;
+    std::vector<Entry> circular_buffer;
+    size_t head = 0u;
+    std::mutex mutex;
+    std::condition_variable condition_variable;
+    bool destructing = false;
+    std::thread consumer_thread;
+    Shard(consumer_t& consumer, size_t buffer_size) : consumer(consumer), circular_buffer(buffer_size) {}
+    void Increment(size_t& i) const { i = (i + 1) % circular_buffer.size(); }
+  };
+
+  // Returns { successful allocation flag, circular buffer index }.
+  // MUTEX-LOCKED, in the order of the mutex of the shard first, and then the one of the indexes and timestamps,
+  // so that the indexes in each shard follow the order of its entries.
+  template <typename TIMESTAMP>
+  std::pair<bool, size_t> Allocate(Shard& shard, const TIMESTAMP user_timestamp) {
+    static_assert(time::IsTimestamp<TIMESTAMP>::value, "");
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    if (shard.destructing) {
+      return std::make_pair(false, 0u);  // LCOV_EXCL_LINE
+    }
+    if (shard.circular_buffer[shard.head].status != Entry::FREE) {
+      if (DROP_ON_OVERFLOW) {
+        // Overflow. Discarding the message.
+        metrics_.Dropped();
+        return std::make_pair(false, 0u);
+      }
+      // Waiting for the next empty slot in the buffer.
+      const auto wait_begin = impl::MMQMetricsRecorder::Now();
+      shard.condition_variable.wait(
+          lock, [&shard] { return (shard.circular_buffer[shard.head].status == Entry::FREE) || shard.destructing; });
+      if (shard.destructing) {
+        return std::make_pair(false, 0u);  // LCOV_EXCL_LINE
+      }
+      metrics_.Blocked(wait_begin);
+    }
+    const size_t index = shard.head;
+    {
+      std::lock_guard<std::mutex> index_lock(last_idx_ts_mutex_);
+      const auto timestamp = current::time::TimestampAsMicroseconds(user_timestamp);
+      if (!(timestamp > last_idx_ts_.us)) {
+        CURRENT_THROW(ss::InconsistentTimestampException(last_idx_ts_.us + std::chrono::microseconds(1), timestamp));
+      }
+      ++last_idx_ts_.index;
+      last_idx_ts_.us = timestamp;
+      shard.circular_buffer[index].index_timestamp = last_idx_ts_;
+    }
+    shard.Increment(shard.head);
+    shard.circular_buffer[index].status = Entry::BEING_IMPORTED;
+    shard.circular_buffer[index].published_at = impl::MMQMetricsRecorder::Now();
+    metrics_.Published();
+    return std::make_pair(true, index);
+  }
+
+  void Commit(Shard& shard, const size_t index) {
+    // After the message has been copied over, mark it as `READY` for consumer.
+    // MUTEX-LOCKED.
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.circular_buffer[index].status = Entry::READY;
+    shard.condition_variable.notify_all();
+  }
+
+  idxts_t LastIndexAndTimestamp() {
+    std::lock_guard<std::mutex> lock(last_idx_ts_mutex_);
+    return last_idx_ts_;
+  }
+
+  // The thread which extracts fully populated messages from the tail of the shard and feeds them to its consumer.
+  void ConsumerThread(Shard& shard) {
+    current::bricks::system::ThreadPlacementPolicy().PlaceCurrentThread(
+        current::bricks::system::ThreadRole::MMQConsumer,
+        shard.circular_buffer.data(),
+        sizeof(Entry) * shard.circular_buffer.size());
+    // The `tail` pointer is local to the procesing thread.
+    size_t tail = 0u;
+    std::vector<Entry*> run;
+    impl::ConsumerFeeder<message_t, consumer_t> feeder(shard.consumer);
+
+    while (true) {
+      {
+        // Get all the contiguous messages, which are `READY` to be exported.
+        // MUTEX-LOCKED, except for the condition variable part.
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        shard.condition_variable.wait(
+            lock, [&shard, tail] { return (shard.circular_buffer[tail].status == Entry::READY) || shard.destructing; });
+        if (shard.destructing) {
+          return;  // LCOV_EXCL_LINE
+        }
+        for (size_t i = tail; shard.circular_buffer[i].status == Entry::READY; shard.Increment(i)) {
+          shard.circular_buffer[i].status = Entry::BEING_EXPORTED;
+          run.push_back(&shard.circular_buffer[i]);
+        }
+      }
+
+      // Then, export the messages.
+      // NO MUTEX REQUIRED.
+      metrics_.Consuming(run);
+      feeder.Feed(run, LastIndexAndTimestamp());
+
+      {
+        // Finally, mark the message entries in the buffer as `FREE` for overwriting, all at once.
+        // MUTEX-LOCKED.
+        {
+          std::lock_guard<std::mutex> lock(shard.mutex);
+          for (Entry* entry : run) {
+            entry->status = Entry::FREE;
+          }
+        }
+        tail = (tail + run.size()) % shard.circular_buffer.size();
+        run.clear();
+
+        // Need to notify message publishers that, in case they were waiting, new slots are now available.
+        shard.condition_variable.notify_all();
+      }
+    }
+  }
+
+  const shard_key_t shard_key_;
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  // The index and the timestamp of the most recently published message, across all the shards.
+  std::mutex last_idx_ts_mutex_;
+  idxts_t last_idx_ts_ = idxts_t(0, std::chrono::microseconds(-1));
+
+  impl::MMQMetricsRecorder metrics_;
+};
+
+template <typename MESSAGE,
+          typename CONSUMER,
+          typename SHARD_KEY,
+          size_t DEFAULT_BUFFER_SIZE = 1024,
+          bool DROP_ON_OVERFLOW = false>
+using ShardedMMQ =
+    ss::EntryPublisher<ShardedMMQImpl<MESSAGE, CONSUMER, SHARD_KEY, DEFAULT_BUFFER_SIZE, DROP_ON_OVERFLOW>, MESSAGE>;
+
+}  // namespace mmq
+}  // namespace current
+
+#endif  // BLOCKS_MMQ_SHARDED_MMQ_H
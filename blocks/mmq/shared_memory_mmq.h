@@ -0,0 +1,500 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+          (c) 2015 Maxim Zhurovich <zhurovich@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#ifndef BLOCKS_MMQ_SHARED_MEMORY_MMQ_H
+#define BLOCKS_MMQ_SHARED_MEMORY_MMQ_H
+
+// The cross-process version of MMQ, for the publishers and the consumer running as separate processes on the same box.
+//
+// The ring is a shared memory mapping of a file, best kept on `tmpfs`, such as "/dev/shm/ingest.mmq". The consumer
+// process creates it, with `SharedMemoryMMQConsumer`, and removes it once done; the publisher processes attach to it,
+// with `SharedMemoryMMQ`, which has the `Publish()` interface of MMQ, and can be attached to from many threads.
+//
+// The messages are kept in the ring in the binary format, see "typesystem/serialization/binary.h", as the records
+// of variable size, addressed by their offsets, and are deserialized by the consumer straight from the ring.
+// The schema of the messages is checked once, when attaching. The publishers take turns via a lock kept in the ring,
+// so the indexes are contiguous and the timestamps increase, as with MMQ; the messages are serialized before that.
+//
+// On Linux, the waiting publishers and the idle consumer sleep on futexes, which work across processes;
+// elsewhere they poll. A publisher process dying while publishing leaves the ring locked.
+//
+// There are two possible strategies in case the ring is full, as with MMQ: to drop the message, or to wait for room.
+// Once the consumer is gone, the messages are dropped. Not available on Windows.
+
+#include "../../port.h"
+
+#ifndef CURRENT_WINDOWS
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef CURRENT_POSIX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif  // CURRENT_POSIX
+
+#include "consumer_feeder.h"
+
+#include "../ss/ss.h"
+
+#include "../../bricks/exception.h"
+#include "../../bricks/system/placement.h"
+#include "../../bricks/time/chrono.h"
+#include "../../typesystem/serialization/binary.h"
+
+namespace current {
+namespace mmq {
+
+struct SharedMemoryMMQException : Exception {
+  using Exception::Exception;
+};
+
+struct SharedMemoryMMQCannotOpenException final : SharedMemoryMMQException {
+  using SharedMemoryMMQException::SharedMemoryMMQException;
+};
+
+struct SharedMemoryMMQSchemaMismatchException final : SharedMemoryMMQException {
+  using SharedMemoryMMQException::SharedMemoryMMQException;
+};
+
+struct SharedMemoryMMQMessageTooLargeException final : SharedMemoryMMQException {
+  using SharedMemoryMMQException::SharedMemoryMMQException;
+};
+
+namespace impl {
+
+// Sleeps while `*value == expected`, or for up to `kSharedMemoryMMQMaxSleep`, whichever is shorter.
+constexpr static std::chrono::milliseconds kSharedMemoryMMQMaxSleep = std::chrono::milliseconds(100);
+
+inline void FutexWait(std::atomic<uint32_t>& value, uint32_t expected) {
+#ifdef CURRENT_POSIX
+  struct timespec timeout;
+  timeout.tv_sec = 0;
+  timeout.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(kSharedMemoryMMQMaxSleep).count();
+  ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&value), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+#else
+  if (value.load() == expected) {
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+#endif  // CURRENT_POSIX
+}
+
+inline void FutexWakeAll(std::atomic<uint32_t>& value) {
+#ifdef CURRENT_POSIX
+  ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&value), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+#else
+  static_cast<void>(value);
+#endif  // CURRENT_POSIX
+}
+
+// The lock shared by the publisher processes: zero if free, one if locked, two if locked and waited for.
+class SharedMemoryMMQLock final {
+ public:
+  explicit SharedMemoryMMQLock(std::atomic<uint32_t>& state) : state_(state) {
+    uint32_t c = 0u;
+    if (!state_.compare_exchange_strong(c, 1u)) {
+      if (c != 2u) {
+        c = state_.exchange(2u);
+      }
+      while (c != 0u) {
+        FutexWait(state_, 2u);
+        c = state_.exchange(2u);
+      }
+    }
+  }
+  ~SharedMemoryMMQLock() {
+    if (state_.exchange(0u) == 2u) {
+      FutexWakeAll(state_);
+    }
+  }
+
+ private:
+  std::atomic<uint32_t>& state_;
+};
+
+// The header of the ring, followed by the data, at `kSharedMemoryMMQDataOffset`. All the offsets only grow,
+// and are taken modulo the capacity to address the data. `[tail, head)` are the records not yet consumed.
+struct SharedMemoryMMQHeader final {
+  constexpr static uint64_t kMagic = 0x31514d4d4d485343ull;  // "CSHMMMQ1".
+
+  std::atomic<uint64_t> magic;  // Set last, once the ring is ready to be attached to.
+  uint64_t type_id;
+  uint64_t capacity;
+
+  alignas(64) std::atomic<uint64_t> head;
+  std::atomic<uint32_t> data_sequence;  // Incremented once the records up to the new `head` can be consumed.
+  std::atomic<uint32_t> consumer_waiting;
+
+  alignas(64) std::atomic<uint64_t> tail;
+  std::atomic<uint32_t> room_sequence;  // Incremented once the records up to the new `tail` have been consumed.
+  std::atomic<uint32_t> publisher_waiting;
+  std::atomic<uint32_t> closed;
+
+  alignas(64) std::atomic<uint32_t> publishers_lock;
+  uint64_t last_index;  // Under `publishers_lock`.
+  int64_t last_us;      // Under `publishers_lock`.
+};
+
+constexpr static size_t kSharedMemoryMMQDataOffset = 4096u;
+static_assert(sizeof(SharedMemoryMMQHeader) <= kSharedMemoryMMQDataOffset, "");
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free, "");
+
+// The header of each record. A padding record only has `size` and `kind` set, and takes up the rest of the ring.
+struct SharedMemoryMMQRecord final {
+  enum : uint32_t { kMessage = 1u, kPadding = 2u };
+  uint32_t size;  // The size of the serialized message, or the number of bytes to skip for the padding record.
+  uint32_t kind;
+  uint64_t index;
+  int64_t us;
+};
+
+// The records are aligned by eight bytes, so that there is always room for `size` and `kind` before the wrap.
+inline uint64_t SharedMemoryMMQRecordBytes(size_t payload_size) {
+  return (sizeof(SharedMemoryMMQRecord) + payload_size + 7u) & ~uint64_t(7u);
+}
+
+// The mapping of the file with the ring, created by the consumer, or attached to by the publisher.
+class SharedMemoryMMQMapping final {
+ public:
+  SharedMemoryMMQMapping(const std::string& file_name, size_t capacity, uint64_t type_id) : file_name_(file_name) {
+    const uint64_t aligned_capacity = (std::max(capacity, size_t(64u)) + 7u) & ~size_t(7u);
+    // A new file, so that the publishers still attached to the previous ring, if any, are not affected.
+    ::unlink(file_name.c_str());
+    Map(::open(file_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600), kSharedMemoryMMQDataOffset + aligned_capacity);
+    SharedMemoryMMQHeader& header = *new (data_) SharedMemoryMMQHeader();
+    header.type_id = type_id;
+    header.capacity = aligned_capacity;
+    header.head = 0u;
+    header.data_sequence = 0u;
+    header.consumer_waiting = 0u;
+    header.tail = 0u;
+    header.room_sequence = 0u;
+    header.publisher_waiting = 0u;
+    header.closed = 0u;
+    header.publishers_lock = 0u;
+    header.last_index = 0u;
+    header.last_us = -1;
+    header.magic = SharedMemoryMMQHeader::kMagic;
+  }
+
+  SharedMemoryMMQMapping(const std::string& file_name, uint64_t type_id) : file_name_(file_name) {
+    const int fd = ::open(file_name.c_str(), O_RDWR);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) || static_cast<size_t>(st.st_size) <= kSharedMemoryMMQDataOffset) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      CURRENT_THROW(SharedMemoryMMQCannotOpenException(file_name));
+    }
+    Map(fd, static_cast<size_t>(st.st_size));
+    if (Header().magic.load() != SharedMemoryMMQHeader::kMagic ||
+        kSharedMemoryMMQDataOffset + Header().capacity != size_) {
+      Unmap();
+      CURRENT_THROW(SharedMemoryMMQCannotOpenException(file_name));
+    }
+    if (Header().type_id != type_id) {
+      Unmap();
+      CURRENT_THROW(SharedMemoryMMQSchemaMismatchException(file_name));
+    }
+  }
+
+  ~SharedMemoryMMQMapping() { Unmap(); }
+
+  SharedMemoryMMQHeader& Header() const { return *reinterpret_cast<SharedMemoryMMQHeader*>(data_); }
+  char* Data() const { return data_ + kSharedMemoryMMQDataOffset; }
+  const std::string& FileName() const { return file_name_; }
+
+ private:
+  SharedMemoryMMQMapping(const SharedMemoryMMQMapping&) = delete;
+  void operator=(const SharedMemoryMMQMapping&) = delete;
+
+  void Map(int fd, size_t size) {
+    if (fd < 0) {
+      CURRENT_THROW(SharedMemoryMMQCannotOpenException(file_name_));
+    }
+    if (::ftruncate(fd, static_cast<off_t>(size))) {
+      ::close(fd);
+      CURRENT_THROW(SharedMemoryMMQCannotOpenException(file_name_));  // LCOV_EXCL_LINE
+    }
+    void* ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+      CURRENT_THROW(SharedMemoryMMQCannotOpenException(file_name_));  // LCOV_EXCL_LINE
+    }
+    data_ = static_cast<char*>(ptr);
+    size_ = size;
+  }
+
+  void Unmap() {
+    if (data_) {
+      ::munmap(data_, size_);
+      data_ = nullptr;
+    }
+  }
+
+  const std::string file_name_;
+  char* data_ = nullptr;
+  size_t size_ = 0u;
+};
+
+}  // namespace impl
+
+template <typename MESSAGE, bool DROP_ON_OVERFLOW = false>
+class SharedMemoryMMQImpl {
+ public:
+  // The type of messages to serialize into the ring.
+  using message_t = MESSAGE;
+
+  // Attaches to the ring created by the `SharedMemoryMMQConsumer` of the very same `MESSAGE`,
+  // throws `SharedMemoryMMQCannotOpenException` or `SharedMemoryMMQSchemaMismatchException` otherwise.
+  explicit SharedMemoryMMQImpl(const std::string& file_name)
+      : mapping_(file_name, static_cast<uint64_t>(serialization::binary::BinarySchemaTypeID<message_t>())) {}
+
+ protected:
+  // Serializes the message into the ring.
+  // THREAD SAFE, and safe to call from several processes at once. Blocks the calling thread only to copy
+  // the serialized message into the ring, unless the ring is full and `DROP_ON_OVERFLOW` is `false`.
+  template <current::locks::MutexLockStatus, typename E, typename TIMESTAMP>  // `MutexLockStatus` is unused by MMQ.
+  idxts_t PublisherPublishImpl(const E& message, TIMESTAMP&& timestamp) {
+    thread_local std::string payload;
+    payload.clear();
+    serialization::binary::BinarySerializer serializer(payload);
+    serialization::Serialize(serializer, static_cast<const message_t&>(message));
+
+    impl::SharedMemoryMMQHeader& header = mapping_.Header();
+    const uint64_t record_bytes = impl::SharedMemoryMMQRecordBytes(payload.size());
+    if (record_bytes > header.capacity) {
+      CURRENT_THROW(SharedMemoryMMQMessageTooLargeException(current::ToString(payload.size())));
+    }
+
+    // MUTEX-LOCKED, across the processes.
+    impl::SharedMemoryMMQLock lock(header.publishers_lock);
+    const uint64_t head = header.head.load();
+    const uint64_t offset = head % header.capacity;
+    const uint64_t padding = (header.capacity - offset < record_bytes) ? header.capacity - offset : 0u;
+    if (!WaitForRoom(header, head + padding + record_bytes)) {
+      return idxts_t();
+    }
+    const auto us = current::time::TimestampAsMicroseconds(timestamp);
+    if (!(us.count() > header.last_us)) {
+      CURRENT_THROW(ss::InconsistentTimestampException(std::chrono::microseconds(header.last_us + 1), us));
+    }
+    ++header.last_index;
+    header.last_us = us.count();
+
+    if (padding) {
+      impl::SharedMemoryMMQRecord& record = *reinterpret_cast<impl::SharedMemoryMMQRecord*>(mapping_.Data() + offset);
+      record.size = static_cast<uint32_t>(padding);
+      record.kind = impl::SharedMemoryMMQRecord::kPadding;
+    }
+    char* destination = mapping_.Data() + (head + padding) % header.capacity;
+    impl::SharedMemoryMMQRecord& record = *reinterpret_cast<impl::SharedMemoryMMQRecord*>(destination);
+    record.size = static_cast<uint32_t>(payload.size());
+    record.kind = impl::SharedMemoryMMQRecord::kMessage;
+    record.index = header.last_index;
+    record.us = header.last_us;
+    std::memcpy(destination + sizeof(impl::SharedMemoryMMQRecord), payload.data(), payload.size());
+
+    header.head.store(head + padding + record_bytes);
+    ++header.data_sequence;
+    if (header.consumer_waiting.load()) {
+      impl::FutexWakeAll(header.data_sequence);
+    }
+    return idxts_t(header.last_index, us);
+  }
+
+ private:
+  // Waits until the records up to `end` fit into the ring, if not dropping.
+  // Returns `false` if the message is to be dropped, as the ring is full, or as the consumer is gone.
+  static bool WaitForRoom(impl::SharedMemoryMMQHeader& header, uint64_t end) {
+    if (header.closed.load()) {
+      return false;
+    }
+    if (end <= header.tail.load() + header.capacity) {
+      return true;
+    }
+    if (DROP_ON_OVERFLOW) {
+      return false;
+    }
+    // Only the publisher holding the lock waits for room, so the flag is not shared with the other publishers.
+    header.publisher_waiting = 1u;
+    while (true) {
+      const uint32_t sequence = header.room_sequence.load();
+      if (header.closed.load()) {
+        header.publisher_waiting = 0u;
+        return false;
+      }
+      if (end <= header.tail.load() + header.capacity) {
+        header.publisher_waiting = 0u;
+        return true;
+      }
+      impl::FutexWait(header.room_sequence, sequence);
+    }
+  }
+
+  impl::SharedMemoryMMQMapping mapping_;
+};
+
+template <typename MESSAGE, bool DROP_ON_OVERFLOW = false>
+using SharedMemoryMMQ = ss::EntryPublisher<SharedMemoryMMQImpl<MESSAGE, DROP_ON_OVERFLOW>, MESSAGE>;
+
+// Creates the ring of `buffer_bytes` at `file_name`, removing it in the destructor, and feeds the messages published
+// into it to the consumer, from a dedicated thread, in batches if the consumer accepts them, as with MMQ.
+// The `last` index and timestamp passed to the consumer are the ones of the most recent message it is fed.
+template <typename MESSAGE, typename CONSUMER>
+class SharedMemoryMMQConsumer final {
+  static_assert(current::ss::IsEntrySubscriber<CONSUMER, MESSAGE>::value, "");
+
+ public:
+  using message_t = MESSAGE;
+  using consumer_t = CONSUMER;
+
+  constexpr static size_t kDefaultBufferBytes = 1024u * 1024u;
+
+  SharedMemoryMMQConsumer(const std::string& file_name,
+                          consumer_t& consumer,
+                          size_t buffer_bytes = kDefaultBufferBytes)
+      : consumer_(consumer),
+        mapping_(file_name,
+                 buffer_bytes,
+                 static_cast<uint64_t>(serialization::binary::BinarySchemaTypeID<message_t>())),
+        consumer_thread_(&SharedMemoryMMQConsumer::ConsumerThread, this) {}
+
+  // Stops the consumer thread, releases the publishers waiting for room, if any, and removes the file.
+  // The messages not yet consumed are discarded.
+  ~SharedMemoryMMQConsumer() {
+    impl::SharedMemoryMMQHeader& header = mapping_.Header();
+    destructing_ = true;
+    ++header.data_sequence;
+    impl::FutexWakeAll(header.data_sequence);
+    consumer_thread_.join();
+    header.closed = 1u;
+    ++header.room_sequence;
+    impl::FutexWakeAll(header.room_sequence);
+    ::unlink(mapping_.FileName().c_str());
+  }
+
+ private:
+  SharedMemoryMMQConsumer(const SharedMemoryMMQConsumer&) = delete;
+  void operator=(const SharedMemoryMMQConsumer&) = delete;
+
+  // How many times the consumer yields before sleeping.
+  constexpr static int kSpinsBeforeSleeping = 64;
+
+  struct Entry {
+    idxts_t index_timestamp;
+    message_t message_body;
+  };
+
+  // Returns the new `head` once it is past `tail`, or `tail` if destructing.
+  uint64_t WaitForData(impl::SharedMemoryMMQHeader& header, uint64_t tail) {
+    for (int i = 0; i < kSpinsBeforeSleeping; ++i) {
+      const uint64_t head = header.head.load();
+      if (head != tail || destructing_) {
+        return head;
+      }
+      std::this_thread::yield();
+    }
+    header.consumer_waiting = 1u;
+    while (true) {
+      const uint32_t sequence = header.data_sequence.load();
+      const uint64_t head = header.head.load();
+      if (head != tail || destructing_) {
+        header.consumer_waiting = 0u;
+        return head;
+      }
+      impl::FutexWait(header.data_sequence, sequence);
+    }
+  }
+
+  // Deserializes all the records published since the previous run straight from the ring, frees their room,
+  // and then feeds them to the consumer.
+  void ConsumerThread() {
+    current::bricks::system::ThreadPlacementPolicy().PlaceCurrentThread(
+        current::bricks::system::ThreadRole::MMQConsumer);
+    impl::SharedMemoryMMQHeader& header = mapping_.Header();
+    std::vector<Entry> entries;
+    std::vector<Entry*> run;
+    impl::ConsumerFeeder<message_t, consumer_t> feeder(consumer_);
+    uint64_t tail = header.tail.load();
+
+    while (true) {
+      const uint64_t head = WaitForData(header, tail);
+      if (destructing_) {
+        return;
+      }
+      while (tail != head) {
+        const char* source = mapping_.Data() + tail % header.capacity;
+        const impl::SharedMemoryMMQRecord& record = *reinterpret_cast<const impl::SharedMemoryMMQRecord*>(source);
+        if (record.kind == impl::SharedMemoryMMQRecord::kPadding) {
+          tail += record.size;
+        } else {
+          entries.emplace_back();
+          entries.back().index_timestamp = idxts_t(record.index, std::chrono::microseconds(record.us));
+          serialization::binary::impl::LoadPayloadFromBinary(
+              std::string_view(source + sizeof(impl::SharedMemoryMMQRecord), record.size),
+              entries.back().message_body);
+          tail += impl::SharedMemoryMMQRecordBytes(record.size);
+        }
+      }
+      header.tail.store(tail);
+      ++header.room_sequence;
+      if (header.publisher_waiting.load()) {
+        impl::FutexWakeAll(header.room_sequence);
+      }
+
+      for (Entry& entry : entries) {
+        run.push_back(&entry);
+      }
+      if (!entries.empty()) {
+        feeder.Feed(run, entries.back().index_timestamp);
+      }
+      run.clear();
+      entries.clear();
+    }
+  }
+
+  consumer_t& consumer_;
+  impl::SharedMemoryMMQMapping mapping_;
+  std::atomic_bool destructing_{false};
+  std::thread consumer_thread_;
+};
+
+}  // namespace mmq
+}  // namespace current
+
+#endif  // CURRENT_WINDOWS
+
+#endif  // BLOCKS_MMQ_SHARED_MEMORY_MMQ_H
@@ -27,18 +27,39 @@ SOFTWARE.
 
 #include "mmq.h"
 #include "mmpq.h"
+#include "lock_free_mmq.h"
+#include "sharded_mmq.h"
+#include "shared_memory_mmq.h"
+
+#include "../http/api.h"
 
 #include <atomic>
 #include <chrono>
+#include <map>
 #include <thread>
 
+#ifndef CURRENT_WINDOWS
+#include <sys/wait.h>
+#endif  // CURRENT_WINDOWS
+
 #include "../../bricks/strings/printf.h"
 #include "../../bricks/strings/join.h"
+#include "../../bricks/strings/util.h"
+#include "../../bricks/dflags/dflags.h"
+#include "../../bricks/file/file.h"
+
+#include "../../3rdparty/gtest/gtest-main-with-dflags.h"
 
-#include "../../3rdparty/gtest/gtest-main.h"
+#ifndef CURRENT_WINDOWS
+DEFINE_string(mmq_test_tmpdir, ".current", "Local path for the test to create temporary files in.");
+#else
+DEFINE_string(mmq_test_tmpdir, ".", "Local path for the test to create temporary files in.");
+#endif
 
+using current::mmq::LockFreeMMQ;
 using current::mmq::MMPQ;
 using current::mmq::MMQ;
+using current::mmq::ShardedMMQ;
 using current::ss::EntryResponse;
 
 TEST(InMemoryMQ, SmokeTest) {
@@ -78,6 +99,21 @@ TEST(InMemoryMQ, SmokeTest) {
     EXPECT_EQ(0u, c.dropped_messages_);
   }
 
+  {
+    Consumer c;
+    LockFreeMMQ<std::string, Consumer> mmq(c);
+    static_assert(current::ss::IsPublisher<decltype(mmq)>::value, "");
+    static_assert(current::ss::IsEntryPublisher<decltype(mmq), std::string>::value, "");
+    mmq.Publish("one");
+    mmq.Publish("two");
+    mmq.Publish("three");
+    while (c.processed_messages_ != 3) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ("one\ntwo\nthree\n", c.messages_);
+    EXPECT_EQ(0u, c.dropped_messages_);
+  }
+
   {
     Consumer c;
     MMPQ<std::string, Consumer> mmpq(c);
@@ -123,13 +159,14 @@ struct SuspendableConsumerImpl {
 
 using SuspendableConsumer = current::ss::EntrySubscriber<SuspendableConsumerImpl, std::string>;
 
-TEST(InMemoryMQ, DropOnOverflowTest) {
+template <template <typename, typename, size_t, bool> class MQ>
+void RunDropOnOverflowTest() {
   current::time::ResetToZero();
 
   SuspendableConsumer c;
 
   // Queue with 10 at most messages in the buffer.
-  MMQ<std::string, SuspendableConsumer, 10, true> mmq(c);
+  MQ<std::string, SuspendableConsumer, 10, true> mmq(c);
   static_assert(current::ss::IsPublisher<decltype(mmq)>::value, "");
   static_assert(current::ss::IsEntryPublisher<decltype(mmq), std::string>::value, "");
 
@@ -173,16 +210,33 @@ TEST(InMemoryMQ, DropOnOverflowTest) {
   // Also confirm they are all unique.
   EXPECT_EQ(11u, c.messages_.size());
   EXPECT_EQ(11u, std::set<std::string>(begin(c.messages_), end(c.messages_)).size());
+
+  // Confirm the drops and the high-water mark are reflected in the metrics.
+  const current::mmq::MMQMetrics metrics = mmq.Metrics();
+  EXPECT_EQ(10u, metrics.capacity);
+  EXPECT_EQ(11u, metrics.published);
+  EXPECT_EQ(11u, metrics.consumed);
+  EXPECT_EQ(15u, metrics.dropped);
+  EXPECT_EQ(0u, metrics.depth);
+  EXPECT_EQ(10u, metrics.max_depth);
+  EXPECT_EQ(0u, metrics.blocked);
+  EXPECT_EQ(11u, metrics.consumer_latency.count);
+  EXPECT_EQ(current::mmq::impl::MMQMetricsRecorder::kBuckets, metrics.consumer_latency.buckets.size());
 }
 
-TEST(InMemoryMQ, WaitOnOverflowTest) {
+TEST(InMemoryMQ, DropOnOverflowTest) { RunDropOnOverflowTest<MMQ>(); }
+
+TEST(InMemoryMQ, LockFreeDropOnOverflowTest) { RunDropOnOverflowTest<LockFreeMMQ>(); }
+
+template <template <typename, typename, size_t, bool> class MQ>
+void RunWaitOnOverflowTest() {
   current::time::ResetToZero();
 
   SuspendableConsumer c;
   c.SetProcessingDelayMillis(1u);
 
   // Queue with 10 events in the buffer. Don't drop events on overflow.
-  MMQ<std::string, SuspendableConsumer, 10, false> mmq(c);
+  MQ<std::string, SuspendableConsumer, 10, false> mmq(c);
   static_assert(current::ss::IsPublisher<decltype(mmq)>::value, "");
   static_assert(current::ss::IsEntryPublisher<decltype(mmq), std::string>::value, "");
 
@@ -217,8 +271,482 @@ TEST(InMemoryMQ, WaitOnOverflowTest) {
   // Ensure that all processed messages are indeed unique.
   std::set<std::string> messages(begin(c.messages_), end(c.messages_));
   EXPECT_EQ(100u, std::set<std::string>(c.messages_.begin(), c.messages_.end()).size());
+
+  // Confirm the publishers have been blocked, as the consumer is slower than them, and nothing was dropped.
+  const current::mmq::MMQMetrics metrics = mmq.Metrics();
+  EXPECT_EQ(100u, metrics.published);
+  EXPECT_EQ(100u, metrics.consumed);
+  EXPECT_EQ(0u, metrics.dropped);
+  EXPECT_LE(metrics.max_depth, 10u);
+  EXPECT_GT(metrics.blocked, 0u);
+  EXPECT_EQ(metrics.blocked, metrics.publisher_wait.count);
+  EXPECT_GT(metrics.publisher_wait.total.count(), 0);
+  EXPECT_EQ(100u, metrics.consumer_latency.count);
+  EXPECT_GT(metrics.consumed_per_second, 0.0);
 }
 
+TEST(InMemoryMQ, WaitOnOverflowTest) { RunWaitOnOverflowTest<MMQ>(); }
+
+TEST(InMemoryMQ, LockFreeWaitOnOverflowTest) { RunWaitOnOverflowTest<LockFreeMMQ>(); }
+
+struct BatchConsumerImpl {
+  std::vector<std::string> messages_;
+  std::vector<size_t> batch_sizes_;
+  uint64_t expected_next_message_index_ = 1u;
+  std::atomic_size_t processed_messages_;
+  std::atomic_bool in_batch_;
+  std::atomic_bool suspend_processing_;
+  BatchConsumerImpl() : processed_messages_(0u), in_batch_(false), suspend_processing_(false) {}
+  EntryResponse operator()(const current::ss::EntriesBatch<std::string>& batch, idxts_t last) {
+    in_batch_ = true;
+    while (suspend_processing_) {
+      std::this_thread::yield();
+    }
+    batch_sizes_.push_back(batch.Size());
+    for (const auto& e : batch) {
+      EXPECT_EQ(expected_next_message_index_, e.idx_ts.index);
+      EXPECT_GE(last.index, e.idx_ts.index);
+      ++expected_next_message_index_;
+      messages_.push_back(e.entry);
+    }
+    in_batch_ = false;
+    processed_messages_ += batch.Size();
+    return EntryResponse::More;
+  }
+};
+
+using BatchConsumer = current::ss::EntrySubscriber<BatchConsumerImpl, std::string>;
+
+// The messages published while the consumer is busy are passed to it in one batch.
+template <template <typename, typename, size_t, bool> class MQ>
+void RunBatchConsumerTest() {
+  current::time::ResetToZero();
+
+  BatchConsumer c;
+  static_assert(current::ss::IsBatchEntrySubscriber<BatchConsumer, std::string>::value, "");
+  MQ<std::string, BatchConsumer, 10, false> mmq(c);
+
+  c.suspend_processing_ = true;
+  mmq.Publish("first");
+  while (!c.in_batch_) {
+    std::this_thread::yield();
+  }
+  for (int i = 0; i < 5; ++i) {
+    mmq.Publish(current::strings::Printf("M%02d", i));
+  }
+  c.suspend_processing_ = false;
+  while (c.processed_messages_ != 6u) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ("1,5", current::strings::Join(c.batch_sizes_, ','));
+  EXPECT_EQ("first,M00,M01,M02,M03,M04", current::strings::Join(c.messages_, ','));
+}
+
+TEST(InMemoryMQ, BatchConsumerTest) { RunBatchConsumerTest<MMQ>(); }
+
+TEST(InMemoryMQ, LockFreeBatchConsumerTest) { RunBatchConsumerTest<LockFreeMMQ>(); }
+
+TEST(InMemoryMQ, MMPQBatchConsumerTest) {
+  current::time::ResetToZero();
+
+  BatchConsumer c;
+  MMPQ<std::string, BatchConsumer> mmpq(c);
+
+  c.suspend_processing_ = true;
+  mmpq.Publish("first", std::chrono::microseconds(1));
+  mmpq.UpdateHead(std::chrono::microseconds(1));
+  while (!c.in_batch_) {
+    std::this_thread::yield();
+  }
+  for (int i = 0; i < 5; ++i) {
+    mmpq.Publish(current::strings::Printf("M%02d", i), std::chrono::microseconds(2 + i));
+  }
+  mmpq.UpdateHead(std::chrono::microseconds(10));
+  c.suspend_processing_ = false;
+  while (c.processed_messages_ != 6u) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ("1,5", current::strings::Join(c.batch_sizes_, ','));
+  EXPECT_EQ("first,M00,M01,M02,M03,M04", current::strings::Join(c.messages_, ','));
+}
+
+TEST(InMemoryMQ, MMPQMetrics) {
+  SuspendableConsumer c;
+  MMPQ<std::string, SuspendableConsumer> mmpq(c);
+
+  c.suspend_processing_ = true;
+  mmpq.Publish("one", std::chrono::microseconds(1));
+  mmpq.Publish("two", std::chrono::microseconds(2));
+  mmpq.Publish("three", std::chrono::microseconds(3));
+  // The messages are held until the head is updated, and count towards the depth.
+  EXPECT_EQ(3u, mmpq.Metrics().depth);
+  EXPECT_EQ(3u, mmpq.Metrics().max_depth);
+  mmpq.UpdateHead(std::chrono::microseconds(3));
+  c.suspend_processing_ = false;
+  while (c.processed_messages_ != 3u) {
+    std::this_thread::yield();
+  }
+
+  const current::mmq::MMQMetrics metrics = mmpq.Metrics();
+  EXPECT_EQ(0u, metrics.capacity);
+  EXPECT_EQ(3u, metrics.published);
+  EXPECT_EQ(3u, metrics.consumed);
+  EXPECT_EQ(0u, metrics.depth);
+  EXPECT_EQ(3u, metrics.max_depth);
+  EXPECT_EQ(3u, metrics.consumer_latency.count);
+}
+
+TEST(InMemoryMQ, MetricsServedOverHTTP) {
+  SuspendableConsumer c;
+  MMQ<std::string, SuspendableConsumer> mmq(c);
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  const auto scope = current::mmq::ServeMMQMetrics(HTTP(std::move(reserved_port)), "/.mmq", mmq);
+
+  mmq.Publish("one");
+  mmq.Publish("two");
+  while (c.processed_messages_ != 2u) {
+    std::this_thread::yield();
+  }
+
+  const auto response = HTTP(GET(current::strings::Printf("http://localhost:%d/.mmq", port)));
+  EXPECT_EQ(200, static_cast<int>(response.code));
+  const auto metrics = ParseJSON<current::mmq::MMQMetrics>(response.body);
+  EXPECT_EQ(1024u, metrics.capacity);
+  EXPECT_EQ(2u, metrics.published);
+  EXPECT_EQ(2u, metrics.consumed);
+  EXPECT_EQ(0u, metrics.dropped);
+  EXPECT_EQ(2u, metrics.consumer_latency.count);
+}
+
+TEST(InMemoryMQ, LockFreeKeepsIndexesAndTimestampsOrderedAcrossPublishers) {
+  current::time::ResetToZero();
+
+  struct ConsumerImpl {
+    std::atomic_size_t processed_messages_;
+    uint64_t expected_next_message_index_ = 1u;
+    std::chrono::microseconds last_timestamp_ = std::chrono::microseconds(-1);
+    std::map<char, int> next_per_publisher_;
+    bool ordered_ = true;
+    ConsumerImpl() : processed_messages_(0u) {}
+    EntryResponse operator()(const std::string& s, idxts_t current, idxts_t last) {
+      // Indexes are contiguous, timestamps increase, and each publisher's messages are in the order of publishing.
+      ordered_ &= (current.index == expected_next_message_index_) && (current.us > last_timestamp_) &&
+                  (last.index >= current.index) && (current::FromString<int>(s.substr(1)) == next_per_publisher_[s[0]]);
+      ++expected_next_message_index_;
+      last_timestamp_ = current.us;
+      ++next_per_publisher_[s[0]];
+      ++processed_messages_;
+      return EntryResponse::More;
+    }
+  };
+
+  using Consumer = current::ss::EntrySubscriber<ConsumerImpl, std::string>;
+
+  Consumer c;
+  LockFreeMMQ<std::string, Consumer, 64> mmq(c);
+
+  std::vector<std::thread> producers;
+  for (size_t i = 0; i < 8; ++i) {
+    producers.emplace_back([&mmq, i]() {
+      for (int j = 0; j < 1000; ++j) {
+        mmq.Publish(current::strings::Printf("%c%d", static_cast<char>('a' + i), j));
+      }
+    });
+  }
+  for (auto& p : producers) {
+    p.join();
+  }
+  while (c.processed_messages_ != 8000u) {
+    std::this_thread::yield();
+  }
+  EXPECT_TRUE(c.ordered_);
+}
+
+// The key of the messages is what precedes the colon.
+struct KeyBeforeColon {
+  std::string operator()(const std::string& s) const { return s.substr(0u, s.find(':')); }
+};
+
+TEST(InMemoryMQ, ShardedKeepsOrderPerKey) {
+  current::time::ResetToZero();
+
+  struct ConsumerImpl {
+    std::atomic_size_t processed_messages_;
+    uint64_t last_index_ = 0u;
+    std::map<std::string, std::vector<int>> sequences_per_key_;
+    bool ordered_ = true;
+    ConsumerImpl() : processed_messages_(0u) {}
+    EntryResponse operator()(const std::string& s, idxts_t current, idxts_t last) {
+      // The indexes of each shard increase, and do not exceed the last one published across all the shards.
+      ordered_ &= (current.index > last_index_) && (last.index >= current.index);
+      last_index_ = current.index;
+      const size_t colon = s.find(':');
+      sequences_per_key_[s.substr(0u, colon)].push_back(current::FromString<int>(s.substr(colon + 1u)));
+      ++processed_messages_;
+      return EntryResponse::More;
+    }
+  };
+
+  using Consumer = current::ss::EntrySubscriber<ConsumerImpl, std::string>;
+
+  std::vector<Consumer> consumers(4u);
+  std::vector<Consumer*> consumer_pointers;
+  for (Consumer& c : consumers) {
+    consumer_pointers.push_back(&c);
+  }
+  ShardedMMQ<std::string, Consumer, KeyBeforeColon, 16> mmq(consumer_pointers);
+  static_assert(current::ss::IsEntryPublisher<decltype(mmq), std::string>::value, "");
+  EXPECT_EQ(4u, mmq.ShardsCount());
+
+  // Each of the four publishers publishes 100 messages for each of its eight keys, interleaved.
+  std::vector<std::thread> producers;
+  for (int i = 0; i < 4; ++i) {
+    producers.emplace_back([&mmq, i]() {
+      for (int j = 0; j < 100; ++j) {
+        for (int k = 0; k < 8; ++k) {
+          mmq.Publish(current::strings::Printf("k%d:%d", i * 8 + k, j));
+        }
+      }
+    });
+  }
+  for (auto& p : producers) {
+    p.join();
+  }
+  const auto processed = [&consumers]() {
+    size_t total = 0u;
+    for (const Consumer& c : consumers) {
+      total += c.processed_messages_;
+    }
+    return total;
+  };
+  while (processed() != 3200u) {
+    std::this_thread::yield();
+  }
+
+  // Each key has been consumed by one consumer only, in the order of publishing.
+  std::map<std::string, size_t> consumers_per_key;
+  for (const Consumer& c : consumers) {
+    EXPECT_TRUE(c.ordered_);
+    for (const auto& key_and_sequence : c.sequences_per_key_) {
+      ++consumers_per_key[key_and_sequence.first];
+      ASSERT_EQ(100u, key_and_sequence.second.size());
+      for (int j = 0; j < 100; ++j) {
+        EXPECT_EQ(j, key_and_sequence.second[j]);
+      }
+    }
+  }
+  EXPECT_EQ(32u, consumers_per_key.size());
+  for (const auto& key_and_count : consumers_per_key) {
+    EXPECT_EQ(1u, key_and_count.second) << key_and_count.first;
+  }
+
+  const current::mmq::MMQMetrics metrics = mmq.Metrics();
+  EXPECT_EQ(64u, metrics.capacity);
+  EXPECT_EQ(3200u, metrics.published);
+  EXPECT_EQ(3200u, metrics.consumed);
+  EXPECT_EQ(0u, metrics.dropped);
+}
+
+TEST(InMemoryMQ, ShardedConsumesInParallel) {
+  current::time::ResetToZero();
+
+  // A thread safe consumer, the first calls to which return only once it is being called from four threads at once.
+  struct ConsumerImpl {
+    std::atomic_size_t threads_entered_;
+    std::atomic_size_t processed_messages_;
+    ConsumerImpl() : threads_entered_(0u), processed_messages_(0u) {}
+    EntryResponse operator()(const std::string&, idxts_t, idxts_t) {
+      thread_local bool entered = false;
+      if (!entered) {
+        entered = true;
+        ++threads_entered_;
+        while (threads_entered_ < 4u) {
+          std::this_thread::yield();
+        }
+      }
+      ++processed_messages_;
+      return EntryResponse::More;
+    }
+  };
+
+  using Consumer = current::ss::EntrySubscriber<ConsumerImpl, std::string>;
+
+  Consumer c;
+  ShardedMMQ<std::string, Consumer, KeyBeforeColon> mmq(c, 4u);
+
+  // With 64 keys, each of the four shards gets some of them.
+  for (int i = 0; i < 64; ++i) {
+    mmq.Publish(current::strings::Printf("k%d:0", i));
+  }
+  while (c.processed_messages_ != 64u) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(4u, c.threads_entered_);
+}
+
+#ifndef CURRENT_WINDOWS
+
+CURRENT_STRUCT(SharedMemoryMMQTestMessage) {
+  CURRENT_FIELD(publisher, uint32_t, 0u);
+  CURRENT_FIELD(sequence, uint32_t, 0u);
+  CURRENT_FIELD(text, std::string);
+};
+
+CURRENT_STRUCT(SharedMemoryMMQOtherMessage) { CURRENT_FIELD(text, std::string); };
+
+struct SharedMemoryConsumerImpl {
+  std::atomic_size_t processed_messages_;
+  uint64_t expected_next_message_index_ = 1u;
+  std::chrono::microseconds last_timestamp_ = std::chrono::microseconds(-1);
+  std::map<uint32_t, uint32_t> next_per_publisher_;
+  bool ordered_ = true;
+  std::atomic_bool suspend_processing_;
+  SharedMemoryConsumerImpl() : processed_messages_(0u), suspend_processing_(false) {}
+  EntryResponse operator()(const SharedMemoryMMQTestMessage& m, idxts_t current, idxts_t last) {
+    while (suspend_processing_) {
+      std::this_thread::yield();
+    }
+    // Indexes are contiguous, timestamps increase, and each publisher's messages are in the order of publishing.
+    ordered_ &= (current.index == expected_next_message_index_) && (current.us > last_timestamp_) &&
+                (last.index >= current.index) && (m.sequence == next_per_publisher_[m.publisher]) &&
+                (m.text == current::strings::Printf("%u:%u", m.publisher, m.sequence));
+    ++expected_next_message_index_;
+    last_timestamp_ = current.us;
+    ++next_per_publisher_[m.publisher];
+    ++processed_messages_;
+    return EntryResponse::More;
+  }
+};
+
+using SharedMemoryConsumer = current::ss::EntrySubscriber<SharedMemoryConsumerImpl, SharedMemoryMMQTestMessage>;
+
+inline SharedMemoryMMQTestMessage MakeSharedMemoryMMQTestMessage(uint32_t publisher, uint32_t sequence) {
+  SharedMemoryMMQTestMessage m;
+  m.publisher = publisher;
+  m.sequence = sequence;
+  m.text = current::strings::Printf("%u:%u", publisher, sequence);
+  return m;
+}
+
+TEST(InMemoryMQ, SharedMemoryMMQ) {
+  using current::mmq::SharedMemoryMMQ;
+  using current::mmq::SharedMemoryMMQConsumer;
+
+  current::time::ResetToZero();
+  const std::string file_name = current::FileSystem::JoinPath(FLAGS_mmq_test_tmpdir, "shared_memory_mmq");
+
+  ASSERT_THROW(SharedMemoryMMQ<SharedMemoryMMQTestMessage>{file_name},
+               current::mmq::SharedMemoryMMQCannotOpenException);
+
+  SharedMemoryConsumer c;
+  {
+    // A small ring, to have it wrap around, and have the publishers wait for room.
+    SharedMemoryMMQConsumer<SharedMemoryMMQTestMessage, SharedMemoryConsumer> consumer(file_name, c, 1024u);
+
+    ASSERT_THROW(SharedMemoryMMQ<SharedMemoryMMQOtherMessage>{file_name},
+                 current::mmq::SharedMemoryMMQSchemaMismatchException);
+
+    SharedMemoryMMQ<SharedMemoryMMQTestMessage> mmq(file_name);
+    static_assert(current::ss::IsEntryPublisher<decltype(mmq), SharedMemoryMMQTestMessage>::value, "");
+
+    SharedMemoryMMQTestMessage too_large;
+    too_large.text = std::string(2000u, '.');
+    ASSERT_THROW(mmq.Publish(too_large), current::mmq::SharedMemoryMMQMessageTooLargeException);
+
+    std::vector<std::thread> producers;
+    for (uint32_t i = 0; i < 4; ++i) {
+      producers.emplace_back([&mmq, i]() {
+        for (uint32_t j = 0; j < 1000; ++j) {
+          mmq.Publish(MakeSharedMemoryMMQTestMessage(i, j));
+        }
+      });
+    }
+    for (auto& p : producers) {
+      p.join();
+    }
+    while (c.processed_messages_ != 4000u) {
+      std::this_thread::yield();
+    }
+    EXPECT_TRUE(c.ordered_);
+  }
+
+  // The consumer removes the file, and the publishers can no longer attach.
+  ASSERT_THROW(current::FileSystem::GetFileSize(file_name), current::FileException);
+}
+
+TEST(InMemoryMQ, SharedMemoryMMQDropOnOverflow) {
+  using current::mmq::SharedMemoryMMQ;
+  using current::mmq::SharedMemoryMMQConsumer;
+
+  current::time::ResetToZero();
+  const std::string file_name = current::FileSystem::JoinPath(FLAGS_mmq_test_tmpdir, "shared_memory_mmq_drop");
+
+  SharedMemoryConsumer c;
+  c.suspend_processing_ = true;
+  SharedMemoryMMQConsumer<SharedMemoryMMQTestMessage, SharedMemoryConsumer> consumer(file_name, c, 1024u);
+  SharedMemoryMMQ<SharedMemoryMMQTestMessage, true> mmq(file_name);
+
+  // The suspended consumer takes at most one ringful of the messages, and the ring then fits another one,
+  // some tens of the messages each.
+  size_t accepted = 0u;
+  size_t dropped = 0u;
+  for (uint32_t j = 0; j < 1000; ++j) {
+    if (mmq.Publish(MakeSharedMemoryMMQTestMessage(0u, static_cast<uint32_t>(accepted))).index) {
+      ++accepted;
+    } else {
+      ++dropped;
+    }
+  }
+  EXPECT_LT(accepted, 100u);
+  EXPECT_EQ(1000u, accepted + dropped);
+
+  c.suspend_processing_ = false;
+  while (c.processed_messages_ != accepted) {
+    std::this_thread::yield();
+  }
+  EXPECT_TRUE(c.ordered_);
+}
+
+TEST(InMemoryMQ, SharedMemoryMMQAcrossProcesses) {
+  using current::mmq::SharedMemoryMMQ;
+  using current::mmq::SharedMemoryMMQConsumer;
+
+  const std::string file_name = current::FileSystem::JoinPath(FLAGS_mmq_test_tmpdir, "shared_memory_mmq_fork");
+
+  SharedMemoryConsumer c;
+  SharedMemoryMMQConsumer<SharedMemoryMMQTestMessage, SharedMemoryConsumer> consumer(file_name, c, 4096u);
+
+  const pid_t child = ::fork();
+  ASSERT_GE(child, 0);
+  if (!child) {
+    // The publishing process.
+    int exit_code = 0;
+    try {
+      SharedMemoryMMQ<SharedMemoryMMQTestMessage> mmq(file_name);
+      for (uint32_t j = 0; j < 10000; ++j) {
+        mmq.Publish(MakeSharedMemoryMMQTestMessage(42u, j), std::chrono::microseconds(j + 1));
+      }
+    } catch (const current::Exception&) {
+      exit_code = 1;
+    }
+    ::_exit(exit_code);
+  }
+
+  int status = 0;
+  ASSERT_EQ(child, ::waitpid(child, &status, 0));
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+  while (c.processed_messages_ != 10000u) {
+    std::this_thread::yield();
+  }
+  EXPECT_TRUE(c.ordered_);
+  EXPECT_EQ(10000u, c.next_per_publisher_[42u]);
+}
+
+#endif  // CURRENT_WINDOWS
+
 TEST(InMemoryMQ, TimeShouldNotGoBack) {
   current::time::ResetToZero();
 
@@ -249,6 +777,20 @@ TEST(InMemoryMQ, TimeShouldNotGoBack) {
     EXPECT_EQ("one\nthree\n", c.messages_);
   }
 
+  {
+    // The message failed to be published takes no index, and does not reach the consumer.
+    Consumer c;
+    LockFreeMMQ<std::string, Consumer> mmq(c);
+    EXPECT_EQ(1u, mmq.Publish("one", std::chrono::microseconds(1)).index);
+    EXPECT_EQ(2u, mmq.Publish("three", std::chrono::microseconds(3)).index);
+    ASSERT_THROW(mmq.Publish("two", std::chrono::microseconds(2)), current::ss::InconsistentTimestampException);
+    EXPECT_EQ(3u, mmq.Publish("four", std::chrono::microseconds(4)).index);
+    while (c.processed_messages_ != 3) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ("one\nthree\nfour\n", c.messages_);
+  }
+
   {
     Consumer c;
     MMPQ<std::string, Consumer> mmpq(c);
@@ -413,3 +955,86 @@ TEST(InMemoryMQ, MMPQSupportsUpdateHead) {
   EXPECT_EQ("three @ 3, seven @ 7, ace @ 100, king @ 101, queen @ 102, jack @ 103, joker @ 1000",
             current::strings::Join(c.messages_by_timestamps_, ", "));
 }
+
+TEST(InMemoryMQ, MMPQOrdersJitteredTimestamps) {
+  current::time::ResetToZero();
+
+  struct ConsumerImpl {
+    std::atomic_size_t processed_messages_;
+    idxts_t previous_ = idxts_t(0u, std::chrono::microseconds(-1));
+    bool ordered_ = true;
+    ConsumerImpl() : processed_messages_(0u) {}
+    EntryResponse operator()(const std::string& s, idxts_t current, idxts_t) {
+      // By timestamps first, then, for the equal ones, by indexes.
+      ordered_ &= (current.us > previous_.us || (current.us == previous_.us && current.index > previous_.index)) &&
+                  (s == current::ToString(current.us.count()));
+      previous_ = current;
+      ++processed_messages_;
+      return EntryResponse::More;
+    }
+  };
+
+  using Consumer = current::ss::EntrySubscriber<ConsumerImpl, std::string>;
+
+  Consumer c;
+  MMPQ<std::string, Consumer> mmpq(c);
+
+  // Mostly in order, some up to thirty microseconds late, some at the same timestamps.
+  uint64_t random = 42u;
+  for (int i = 0; i < 10000; ++i) {
+    random = random * 6364136223846793005ull + 1442695040888963407ull;
+    const int64_t us = 10 * (i + 3) - ((random >> 33) % 4 == 0 ? static_cast<int64_t>((random >> 40) % 31) : 0);
+    mmpq.Publish(current::ToString(us), std::chrono::microseconds(us));
+    if (i % 100 == 99) {
+      mmpq.UpdateHead(std::chrono::microseconds(10 * (i + 3) - 50));
+    }
+  }
+  mmpq.UpdateHead(std::chrono::microseconds(1000000));
+  while (c.processed_messages_ != 10000u) {
+    std::this_thread::yield();
+  }
+  EXPECT_TRUE(c.ordered_);
+}
+
+TEST(InMemoryMQ, MMPQMaxLateness) {
+  current::time::ResetToZero();
+
+  struct ConsumerImpl {
+    std::vector<std::string> messages_;
+    std::atomic_size_t processed_messages_;
+    ConsumerImpl() : processed_messages_(0u) {}
+    EntryResponse operator()(const std::string& s, idxts_t idxts, idxts_t last) {
+      messages_.push_back(s + " @ " + current::ToString(idxts.us) + ", head " + current::ToString(last.us));
+      ++processed_messages_;
+      return EntryResponse::More;
+    }
+  };
+
+  using Consumer = current::ss::EntrySubscriber<ConsumerImpl, std::string>;
+
+  Consumer c;
+  MMPQ<std::string, Consumer> mmpq(c, std::chrono::microseconds(10));
+
+  // With no `UpdateHead()`, the messages are released once they are ten microseconds behind the most recent one.
+  mmpq.Publish("five", std::chrono::microseconds(5));
+  mmpq.Publish("three", std::chrono::microseconds(3));
+  mmpq.Publish("twenty", std::chrono::microseconds(20));
+  while (c.processed_messages_ != 2u) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ("three @ 3, head 10, five @ 5, head 10", current::strings::Join(c.messages_, ", "));
+
+  // The message later than that is released right away.
+  mmpq.Publish("one", std::chrono::microseconds(1));
+  while (c.processed_messages_ != 3u) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ("one @ 1, head 10", c.messages_.back());
+
+  // `UpdateHead()` still releases the messages before they are that late.
+  mmpq.UpdateHead(std::chrono::microseconds(20));
+  while (c.processed_messages_ != 4u) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ("twenty @ 20, head 20", c.messages_.back());
+}
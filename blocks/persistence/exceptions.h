@@ -42,10 +42,24 @@ struct MalformedEntryException : PersistenceException {
   using PersistenceException::PersistenceException;
 };
 
+struct FrameChecksumMismatchException : MalformedEntryException {
+  explicit FrameChecksumMismatchException(uint64_t index)
+      : MalformedEntryException(
+            current::strings::Printf("Frame checksum mismatch for index %lld.", static_cast<long long>(index))) {}
+};
+
 struct InvalidIterableRangeException : PersistenceException {
   using PersistenceException::PersistenceException;
 };
 
+struct EntryDroppedByRetentionException : InvalidIterableRangeException {
+  explicit EntryDroppedByRetentionException(uint64_t index, uint64_t first_available_index)
+      : InvalidIterableRangeException(
+            current::strings::Printf("Entry %lld has been dropped, the first available one is %lld.",
+                                     static_cast<long long>(index),
+                                     static_cast<long long>(first_available_index))) {}
+};
+
 struct NoEntriesPublishedYet : PersistenceException {
   using PersistenceException::PersistenceException;
 };
@@ -64,6 +78,11 @@ struct PersistenceFileNotWritable : PersistenceException {
       : PersistenceException("Persistence file not writable: `" + filename + "`.") {}
 };
 
+struct InvalidSegmentedFileManifest : PersistenceException {
+  explicit InvalidSegmentedFileManifest(const std::string& filename)
+      : PersistenceException("Invalid segmented file manifest: `" + filename + "`.") {}
+};
+
 struct UnsafePublishBadIndexTimestampException : PersistenceException {
   explicit UnsafePublishBadIndexTimestampException(uint64_t expected, uint64_t found)
       : PersistenceException(current::strings::Printf(
@@ -25,35 +25,136 @@ SOFTWARE.
 
 // A simple, reference, implementation of an file-based persister.
 // The file is replayed at startup to check its integriry and to extract the most recent index/timestamp.
-// Each iterator opens the same file again, to read its first N lines.
+// The iterators read the entries via the memory mapping of the file, shared between all of them.
 // Iterators never outlive the persister.
 
 #ifndef BLOCKS_PERSISTENCE_FILE_H
 #define BLOCKS_PERSISTENCE_FILE_H
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <fstream>
 #include <functional>
+#include <memory>
+#include <thread>
+
+#ifndef CURRENT_WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#endif  // CURRENT_WINDOWS
 
 #ifdef CURRENT_BUILD_WITH_PARANOIC_RUNTIME_CHECKS
 #include <iostream>
 #endif  // CURRENT_BUILD_WITH_PARANOIC_RUNTIME_CHECKS
 
 #include "exceptions.h"
+#include "record_index.h"
 
 #include "../ss/persister.h"
 #include "../ss/signature.h"
 
+#include "../../bricks/file/file.h"
+#include "../../bricks/file/mmap.h"
 #include "../../bricks/sync/locks.h"
 #include "../../bricks/sync/owned_borrowed.h"
+#include "../../bricks/sync/waitable_atomic.h"
 #include "../../bricks/time/chrono.h"
 #include "../../bricks/util/atomic_that_works.h"
+#include "../../bricks/util/crc32.h"
 #include "../../typesystem/schema/schema.h"
+#include "../../typesystem/serialization/binary.h"
 #include "../../typesystem/serialization/json.h"
 
 namespace current {
 namespace persistence {
 
+// The on-disk formats of the file persister, used as the `FORMAT` template parameter of `impl::FilePersister`.
+namespace file_format {
+// One `JSON(idxts) '\t' JSON(entry)` line per entry. Human-readable, and the default.
+struct JSONLines {};
+// One length-prefixed, checksummed binary frame per entry. Replaying the file does not involve parsing JSON.
+// The published entries are kept in Current's binary format, see "typesystem/serialization/binary.h", so iterating
+// over them does not involve parsing JSON either. The entries that come already serialized into JSON, via
+// `PublishSerialized()` or as raw log lines, are kept as JSON frames, and both kinds of frames are read back.
+// Directives (`#signature`, `#head`) remain text lines, so the two formats share the structure of the file.
+struct Framed {};
+}  // namespace file_format
+
+// The durability policy of the file persister, the optional last constructor argument of `File` and `FramedFile`.
+// * `FlushEachEntry`: Hand each entry over to the OS as it is published, no `fdatasync`. The default.
+// * `GroupCommit`: Buffer the entries, and have a dedicated thread flush and `fdatasync` the file
+//   every `max_delay`, or as soon as `max_bytes` are pending, whichever comes first.
+// * `NoSyncUntilClose`: Buffer the entries, and only `fdatasync` the file when the persister is destructed,
+//   or when `WaitUntilDurable()` is called.
+// Regardless of the policy, the published entries are visible to the iterators right away,
+// and `WaitUntilDurable(index)` blocks until all the entries up to and including `index` have been `fdatasync`-ed.
+// With `GroupCommit`, the first waiter requests the group commit right away, and the waiters arriving while it is
+// in progress join it, or the one right after it, so that many publishers waiting on their own entries still share
+// the `fdatasync`-s.
+struct FileDurability {
+  enum class Policy : int { FlushEachEntry = 0, GroupCommit = 1, NoSyncUntilClose = 2 };
+  Policy policy = Policy::FlushEachEntry;
+  std::chrono::microseconds max_delay = std::chrono::milliseconds(5);
+  size_t max_bytes = 1024 * 1024;
+
+  static FileDurability FlushEachEntry() { return FileDurability(); }
+  static FileDurability GroupCommit(std::chrono::microseconds max_delay = std::chrono::milliseconds(5),
+                                    size_t max_bytes = 1024 * 1024) {
+    FileDurability result;
+    result.policy = Policy::GroupCommit;
+    result.max_delay = max_delay;
+    result.max_bytes = max_bytes;
+    return result;
+  }
+  static FileDurability NoSyncUntilClose() {
+    FileDurability result;
+    result.policy = Policy::NoSyncUntilClose;
+    return result;
+  }
+};
+
+// The optional index sidecar of the file persister, the optional constructor argument following `FileDurability`.
+// When enabled, the offsets and timestamps of the entries are also appended to `<filename>.idx`, in checksummed
+// blocks of `checkpoint_every` entries, each block also recording the length of the log file it covers.
+// At startup, the sidecar is validated against the log file, and only the tail of the log, written after the last
+// valid block, is replayed. If the sidecar is missing or does not match the log file, the log is replayed in full,
+// and the sidecar is rebuilt.
+struct FileIndexSidecar {
+  bool enabled = false;
+  uint64_t checkpoint_every = 1024u;
+
+  static FileIndexSidecar Disabled() { return FileIndexSidecar(); }
+  static FileIndexSidecar Enabled(uint64_t checkpoint_every = 1024u) {
+    FileIndexSidecar result;
+    result.enabled = true;
+    result.checkpoint_every = checkpoint_every;
+    return result;
+  }
+};
+
+// The startup replay mode of the file persister, the optional constructor argument following `FileIndexSidecar`.
+// By default, the file, or its tail not covered by the index sidecar, is replayed sequentially.
+// With `Parallel(threads)`, the file is split into up to `threads` chunks at record boundaries, of at least
+// `min_bytes_per_thread` each, which are parsed and validated concurrently, and then stitched together in order,
+// verifying the continuity of indexes and the monotonicity of timestamps across the chunks.
+// Should any chunk fail to validate, the file is replayed sequentially, to report the very same error
+// as the sequential replay would.
+struct FileRecovery {
+  size_t threads = 1u;
+  size_t min_bytes_per_thread = 1024 * 1024;
+
+  static FileRecovery Sequential() { return FileRecovery(); }
+  static FileRecovery Parallel(size_t threads = std::thread::hardware_concurrency(),
+                               size_t min_bytes_per_thread = 1024 * 1024) {
+    FileRecovery result;
+    result.threads = threads;
+    result.min_bytes_per_thread = min_bytes_per_thread;
+    return result;
+  }
+};
+
 namespace impl {
 
 namespace constants {
@@ -61,13 +162,336 @@ constexpr char kDirectiveMarker = '#';
 constexpr char kSignatureDirective[] = "#signature";
 constexpr char kHeadDirective[] = "#head";
 constexpr char kHeadFormatString[] = "%020lld";
+// The frame marker byte, `'\x1E'`, is the ASCII "record separator". Never the first byte of a directive or JSON.
+constexpr char kFrameMarker = '\x1E';
+// The encoding of the payload of a frame: JSON, or Current's binary format, with its header and schema TypeID.
+constexpr char kFramePayloadJSON = 'J';
+constexpr char kFramePayloadBinary = 'B';
+// Marker (1) + payload encoding (1) + payload size (4) + index (8) + timestamp (8) + CRC32C (4).
+constexpr size_t kFrameHeaderSize = 26;
+// The iterators map the file with the size rounded up to a power of two, and at least this large.
+constexpr size_t kMinFileMappingSize = 1u << 20;
+// The raw entries are passed on in spans of at most this many bytes, unless a single entry is larger.
+constexpr size_t kMaxRawEntriesSpanSize = 1u << 20;
+// The index sidecar: the file name suffix, and the magic number each block of it starts with.
+constexpr char kIndexSidecarSuffix[] = ".idx";
+constexpr uint32_t kIndexBlockMagic = 0x58444943;  // "CIDX".
+// Magic (4) + entry count (4) + first index (8).
+constexpr size_t kIndexBlockHeaderSize = 16;
+// Per entry: offset (8) + timestamp (8).
+constexpr size_t kIndexBlockEntrySize = 16;
+// Log length (8) + head (8) + head offset (8) + CRC32C (4).
+constexpr size_t kIndexBlockTrailerSize = 28;
 }  // namespace constants
 
 typedef int64_t head_value_t;
 
-// An iterator to read a file line by line, extracting tab-separated `idxts_t index` and `const char* data`.
-// Validates the entries come in the right order of 0-based indexes, and with strictly increasing timestamps.
+// Parses the decimal number of at most 18 digits starting at `p`, advancing `p` past it.
+// Returns `false` if there is no such number there, leaving `p` wherever it stopped.
+inline bool ParseIdxTsDigits(const char*& p, const char* end, uint64_t& value) {
+  const char* const begin = p;
+  value = 0u;
+  while (p < end && *p >= '0' && *p <= '9' && p - begin < 18) {
+    value = value * 10u + static_cast<uint64_t>(*p - '0');
+    ++p;
+  }
+  return p != begin && !(*begin == '0' && p - begin > 1) && !(p < end && *p >= '0' && *p <= '9');
+}
+
+// Parses the `JSON(idxts)` prefix of an entry, given as `[begin, end)`. The form `JSON()` writes it in,
+// `{"index":N,"us":T}`, is parsed in place, as this is done for every entry when the file is replayed.
+// Anything else, such as whitespace or the keys in the other order, is left to `ParseJSON()`, as are the errors.
+inline idxts_t ParseIdxTs(const char* begin, const char* end) {
+  static constexpr char kIndex[] = "{\"index\":";
+  static constexpr char kUs[] = ",\"us\":";
+  const char* p = begin + (sizeof(kIndex) - 1u);
+  uint64_t index;
+  uint64_t us;
+  if (end - begin > static_cast<ptrdiff_t>(sizeof(kIndex) + sizeof(kUs)) &&
+      !std::memcmp(begin, kIndex, sizeof(kIndex) - 1u) && ParseIdxTsDigits(p, end, index) &&
+      end - p > static_cast<ptrdiff_t>(sizeof(kUs) - 1u) && !std::memcmp(p, kUs, sizeof(kUs) - 1u)) {
+    p += sizeof(kUs) - 1u;
+    const bool negative = (*p == '-');
+    p += negative;
+    if (ParseIdxTsDigits(p, end, us) && p + 1 == end && *p == '}') {
+      const int64_t signed_us = negative ? -static_cast<int64_t>(us) : static_cast<int64_t>(us);
+      return idxts_t(index, std::chrono::microseconds(signed_us));
+    }
+  }
+  return ParseJSON<idxts_t>(std::string(begin, end));
+}
+
+// A record read from the file: either an entry, with its `idxts` and the null-terminated payload,
+// or a directive, in which case `payload` points to the whole directive line.
+// The `payload` points into the buffer owned by the reader, and is only valid until the next record is read.
+// It is null-terminated, unless it is binary, which is what `payload_size` is for.
+struct PersistedRecord {
+  bool is_directive = false;
+  idxts_t idxts;
+  const char* payload = nullptr;
+  size_t payload_size = 0u;
+  bool binary = false;
+};
+
 template <typename ENTRY>
+ENTRY ParseEntryPayload(const PersistedRecord& record) {
+  if (record.binary) {
+    return LoadFromBinary<ENTRY>(std::string_view(record.payload, record.payload_size));
+  } else {
+    return ParseJSON<ENTRY>(record.payload);
+  }
+}
+
+// The implementations of the on-disk formats. Each provides:
+// * `kOpenMode`: extra flags to open the file with,
+// * `kBinaryPayloads`: whether the entries are published in the binary format, as opposed to JSON,
+// * `AppendEntry(os, idxts, payload, binary)`: appends an entry, given its `idxts` and serialized payload,
+// * `AppendRawEntry(os, raw_log_line, idxts, tab_pos)`: appends an entry given as the `JSON(idxts)\tJSON(entry)` line,
+//   both `Append*()` methods return the number of bytes written,
+// * `ReadRecord(is, buffer, record)`: reads the next entry or directive, returns `false` at the end of the file,
+// * `NextRecord(begin, end, is_directive)`: finds where the record starting at `begin` in memory ends,
+// * `ParseEntry(begin, next, record, buffer)`: parses the entry in memory, copying its payload into `buffer`,
+// * `RawEntry<ENTRY>(begin, next, line)`: returns the entry in memory as the `JSON(idxts)\tJSON(entry)` line,
+// * `ParseIndexAndTimestamp(begin, next)`: validates the entry in memory and returns its `idxts`, copying nothing,
+// * `RecordBoundary(begin, target, end)`: finds the first record at or after `target`, given one starts at `begin`.
+template <typename FORMAT>
+struct FileFormatImpl;
+
+template <>
+struct FileFormatImpl<file_format::JSONLines> {
+  static constexpr std::ios_base::openmode kOpenMode = std::ios_base::openmode();
+  static constexpr bool kBinaryPayloads = false;
+
+  static size_t AppendEntry(std::ostream& os, const idxts_t& idxts, const std::string& payload, bool binary) {
+    CURRENT_ASSERT(!binary);
+    const std::string idxts_json = JSON(idxts);
+    os << idxts_json << '\t' << payload << '\n';
+    return idxts_json.length() + payload.length() + 2;
+  }
+
+  static size_t AppendRawEntry(std::ostream& os, const std::string& raw_log_line, const idxts_t&, size_t) {
+    os << raw_log_line << '\n';
+    return raw_log_line.length() + 1;
+  }
+
+  static bool ReadRecord(std::istream& fi, std::string& buffer, PersistedRecord& record) {
+    if (!std::getline(fi, buffer)) {
+      return false;
+    }
+    // A directive always starts with kDirectiveMarker ('#'),
+    // an entry - with JSON-serialized `idxts_t` object
+    if (buffer[0] != constants::kDirectiveMarker) {
+      const size_t tab_pos = buffer.find('\t');
+      if (tab_pos == std::string::npos) {
+        CURRENT_THROW(MalformedEntryException(buffer));
+      }
+      record.is_directive = false;
+      record.idxts = ParseIdxTs(buffer.data(), buffer.data() + tab_pos);
+      record.payload = buffer.c_str() + tab_pos + 1;
+      record.payload_size = buffer.length() - tab_pos - 1;
+    } else {
+      record.is_directive = true;
+      record.payload = buffer.c_str();
+    }
+    return true;
+  }
+
+  static const char* NextRecord(const char* begin, const char* end, bool& is_directive) {
+    const char* eol = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+    if (!eol) {
+      CURRENT_THROW(MalformedEntryException(std::string(begin, end)));
+    }
+    is_directive = (*begin == constants::kDirectiveMarker);
+    return eol + 1;
+  }
+
+  static void ParseEntry(const char* begin, const char* next, PersistedRecord& record, std::string& buffer) {
+    const char* tab = static_cast<const char*>(std::memchr(begin, '\t', next - begin));
+    if (!tab) {
+      CURRENT_THROW(MalformedEntryException(std::string(begin, next - 1)));
+    }
+    record.is_directive = false;
+    record.idxts = ParseIdxTs(begin, tab);
+    buffer.assign(tab + 1, next - 1);
+    record.payload = buffer.c_str();
+    record.payload_size = buffer.length();
+  }
+
+  template <typename ENTRY>
+  static void RawEntry(const char* begin, const char* next, std::string& line) {
+    line.assign(begin, next - 1);
+  }
+
+  static idxts_t ParseIndexAndTimestamp(const char* begin, const char* next) {
+    const char* tab = static_cast<const char*>(std::memchr(begin, '\t', next - begin));
+    if (!tab) {
+      CURRENT_THROW(MalformedEntryException(std::string(begin, next - 1)));
+    }
+    return ParseIdxTs(begin, tab);
+  }
+
+  // Each record is a line, and no line contains a newline character, so the search can start anywhere.
+  static const char* RecordBoundary(const char*, const char* target, const char* end) {
+    if (*(target - 1) == '\n') {
+      return target;
+    }
+    const char* eol = static_cast<const char*>(std::memchr(target, '\n', end - target));
+    return eol ? eol + 1 : end;
+  }
+};
+
+// The frame is `kFrameHeaderSize` bytes of header followed by the payload. The header fields are stored
+// in the host byte order, and the CRC32C covers the header fields following the marker as well as the payload.
+template <>
+struct FileFormatImpl<file_format::Framed> {
+  static constexpr std::ios_base::openmode kOpenMode = std::ios_base::binary;
+  static constexpr bool kBinaryPayloads = true;
+
+  static size_t AppendEntry(std::ostream& os, const idxts_t& idxts, const std::string& payload, bool binary) {
+    char header[constants::kFrameHeaderSize];
+    const uint32_t payload_size = static_cast<uint32_t>(payload.length());
+    const uint64_t index = idxts.index;
+    const int64_t us = idxts.us.count();
+    header[0] = constants::kFrameMarker;
+    header[1] = binary ? constants::kFramePayloadBinary : constants::kFramePayloadJSON;
+    std::memcpy(header + 2, &payload_size, sizeof(payload_size));
+    std::memcpy(header + 6, &index, sizeof(index));
+    std::memcpy(header + 14, &us, sizeof(us));
+    const uint32_t crc = CRC32C(CRC32C(0, header + 1, 21), payload.c_str(), payload.length());
+    std::memcpy(header + 22, &crc, sizeof(crc));
+    os.write(header, constants::kFrameHeaderSize);
+    os.write(payload.c_str(), payload.length());
+    return constants::kFrameHeaderSize + payload.length();
+  }
+
+  static size_t AppendRawEntry(std::ostream& os, const std::string& raw_log_line, const idxts_t& idxts, size_t tab_pos) {
+    return AppendEntry(os, idxts, raw_log_line.substr(tab_pos + 1), false);
+  }
+
+  static bool ReadRecord(std::istream& fi, std::string& buffer, PersistedRecord& record) {
+    const int c = fi.peek();
+    if (c == std::char_traits<char>::eof()) {
+      return false;
+    } else if (c == constants::kDirectiveMarker) {
+      std::getline(fi, buffer);
+      record.is_directive = true;
+      record.payload = buffer.c_str();
+      return true;
+    } else if (c != constants::kFrameMarker) {
+      CURRENT_THROW(MalformedEntryException("Expected a frame or a directive."));
+    }
+    char header[constants::kFrameHeaderSize];
+    if (!fi.read(header, constants::kFrameHeaderSize)) {
+      CURRENT_THROW(MalformedEntryException("Truncated frame header."));
+    }
+    CheckPayloadEncoding(header[1]);
+    uint32_t payload_size;
+    uint64_t index;
+    int64_t us;
+    uint32_t crc;
+    std::memcpy(&payload_size, header + 2, sizeof(payload_size));
+    std::memcpy(&index, header + 6, sizeof(index));
+    std::memcpy(&us, header + 14, sizeof(us));
+    std::memcpy(&crc, header + 22, sizeof(crc));
+    buffer.resize(payload_size);
+    if (payload_size && !fi.read(&buffer[0], payload_size)) {
+      CURRENT_THROW(MalformedEntryException("Truncated frame payload."));
+    }
+    if (CRC32C(CRC32C(0, header + 1, 21), buffer.c_str(), buffer.length()) != crc) {
+      CURRENT_THROW(FrameChecksumMismatchException(index));
+    }
+    record.is_directive = false;
+    record.idxts = idxts_t(index, std::chrono::microseconds(us));
+    record.payload = buffer.c_str();
+    record.payload_size = buffer.length();
+    record.binary = (header[1] == constants::kFramePayloadBinary);
+    return true;
+  }
+
+  static const char* NextRecord(const char* begin, const char* end, bool& is_directive) {
+    if (*begin == constants::kDirectiveMarker) {
+      return FileFormatImpl<file_format::JSONLines>::NextRecord(begin, end, is_directive);
+    }
+    uint32_t payload_size;
+    if (*begin != constants::kFrameMarker || end - begin < static_cast<std::ptrdiff_t>(constants::kFrameHeaderSize)) {
+      CURRENT_THROW(MalformedEntryException("Expected a frame or a directive."));
+    }
+    std::memcpy(&payload_size, begin + 2, sizeof(payload_size));
+    if (end - begin < static_cast<std::ptrdiff_t>(constants::kFrameHeaderSize + payload_size)) {
+      CURRENT_THROW(MalformedEntryException("Truncated frame payload."));
+    }
+    is_directive = false;
+    return begin + constants::kFrameHeaderSize + payload_size;
+  }
+
+  // NOTE: The checksum is not verified here. It is verified once, when the file is replayed at startup.
+  static void ParseEntry(const char* begin, const char* next, PersistedRecord& record, std::string& buffer) {
+    uint64_t index;
+    int64_t us;
+    std::memcpy(&index, begin + 6, sizeof(index));
+    std::memcpy(&us, begin + 14, sizeof(us));
+    record.is_directive = false;
+    record.idxts = idxts_t(index, std::chrono::microseconds(us));
+    buffer.assign(begin + constants::kFrameHeaderSize, next);
+    record.payload = buffer.c_str();
+    record.payload_size = buffer.length();
+    record.binary = (begin[1] == constants::kFramePayloadBinary);
+  }
+
+  // The binary payloads are converted into JSON, as the raw entries are `JSON(idxts)\tJSON(entry)` lines.
+  template <typename ENTRY>
+  static void RawEntry(const char* begin, const char* next, std::string& line) {
+    std::string buffer;
+    PersistedRecord record;
+    ParseEntry(begin, next, record, buffer);
+    line = JSON(record.idxts) + '\t' + (record.binary ? JSON(ParseEntryPayload<ENTRY>(record)) : buffer);
+  }
+
+  // Unlike `ParseEntry`, verifies the checksum, as this is what replaying the file at startup uses.
+  static idxts_t ParseIndexAndTimestamp(const char* begin, const char* next) {
+    CheckPayloadEncoding(begin[1]);
+    uint64_t index;
+    int64_t us;
+    uint32_t crc;
+    std::memcpy(&index, begin + 6, sizeof(index));
+    std::memcpy(&us, begin + 14, sizeof(us));
+    std::memcpy(&crc, begin + 22, sizeof(crc));
+    const char* payload = begin + constants::kFrameHeaderSize;
+    if (CRC32C(CRC32C(0, begin + 1, 21), payload, static_cast<size_t>(next - payload)) != crc) {
+      CURRENT_THROW(FrameChecksumMismatchException(index));
+    }
+    return idxts_t(index, std::chrono::microseconds(us));
+  }
+
+  static void CheckPayloadEncoding(char encoding) {
+    if (encoding != constants::kFramePayloadJSON && encoding != constants::kFramePayloadBinary) {
+      CURRENT_THROW(MalformedEntryException("Unsupported frame payload encoding."));
+    }
+  }
+
+  // The payload of a frame may contain any bytes, so the frames are skipped over one by one, reading their headers.
+  static const char* RecordBoundary(const char* begin, const char* target, const char* end) {
+    bool is_directive;
+    while (begin < target) {
+      begin = NextRecord(begin, end, is_directive);
+    }
+    return begin;
+  }
+};
+
+// The payload of an entry published into a file of the `FORMAT`, see `kBinaryPayloads`.
+template <typename FORMAT, typename ENTRY>
+std::string SerializeEntryPayload(const ENTRY& entry) {
+  if constexpr (FileFormatImpl<FORMAT>::kBinaryPayloads) {
+    return SaveIntoBinary(entry);
+  } else {
+    return JSON(entry);
+  }
+}
+
+// An iterator to read a file record by record, extracting `idxts_t index` and `const char* data`.
+// Validates the entries come in the right order of 0-based indexes, and with strictly increasing timestamps.
+template <typename ENTRY, typename FORMAT>
 class IteratorOverFileOfPersistedEntries {
  public:
   IteratorOverFileOfPersistedEntries(std::istream& fi, std::streampos offset, uint64_t index_at_offset)
@@ -80,15 +504,10 @@ class IteratorOverFileOfPersistedEntries {
 
   template <typename F1, typename F2>
   bool ProcessNextEntry(F1&& on_entry, F2&& on_directive) {
-    if (std::getline(fi_, line_)) {
-      // A directive always starts with kDirectiveMarker ('#'),
-      // an entry - with JSON-serialized `idxts_t` object
-      if (line_[0] != constants::kDirectiveMarker) {
-        const size_t tab_pos = line_.find('\t');
-        if (tab_pos == std::string::npos) {
-          CURRENT_THROW(MalformedEntryException(line_));
-        }
-        const auto current = ParseJSON<idxts_t>(line_.substr(0, tab_pos));
+    PersistedRecord record;
+    if (FileFormatImpl<FORMAT>::ReadRecord(fi_, buffer_, record)) {
+      if (!record.is_directive) {
+        const auto& current = record.idxts;
         if (current.index != next_.index) {
           // Indexes must be strictly continuous.
           CURRENT_THROW(ss::InconsistentIndexException(next_.index, current.index));
@@ -97,12 +516,12 @@ class IteratorOverFileOfPersistedEntries {
           // Timestamps must monotonically increase.
           CURRENT_THROW(ss::InconsistentTimestampException(next_.us, current.us));
         }
-        on_entry(current, line_.c_str() + tab_pos + 1);
+        on_entry(current, record.payload);
         next_ = current;
         ++next_.index;
         ++next_.us;
       } else {
-        on_directive(line_);
+        on_directive(buffer_);
       }
       return true;
     } else {
@@ -115,7 +534,7 @@ class IteratorOverFileOfPersistedEntries {
 
  private:
   std::istream& fi_;
-  std::string line_;
+  std::string buffer_;
   idxts_t next_;
 };
 
@@ -132,8 +551,8 @@ struct MakeSureTheRightTypeIsSerialized<T, T> {
   static const T& DoIt(const T& x) { return x; }
 };
 
-// The implementation of a persister based exclusively on appending to and reading one text flie.
-template <typename ENTRY>
+// The implementation of a persister based exclusively on appending to and reading one flie.
+template <typename ENTRY, typename FORMAT = file_format::JSONLines>
 class FilePersister {
  protected:
   // { last_published_index + 1, last_published_us, current_head_us }, or { 0, -1us, -1us } for an empty persister.
@@ -147,21 +566,46 @@ class FilePersister {
  private:
   struct FilePersisterImpl final {
     const std::string filename_;
-    std::ofstream file_appender_;
+    mutable std::ofstream file_appender_;  // `mutable`, as iterating flushes the buffered entries, see `FileDurability`.
     std::fstream head_rewriter_;
 
-    // `record_offset_.size() == end.next_index`,
-    // and `record_offset_[i]` is the record_offset_ in bytes where the line for index `i` begins.
-    std::mutex& publish_mutex_ref_;  // Guards `record_offset_`, `head_offset_` and `record_timestamp_`.
-    std::vector<std::streampos> record_offset_;
+    // `record_index_.size() == end.next_index`, and `record_index_.Offset(i)` is the offset in bytes
+    // where the line for index `i` begins, with `record_index_.Timestamp(i)` being its timestamp.
+    std::mutex& publish_mutex_ref_;  // Guards `record_index_` and `head_offset_`.
+    CompactRecordIndex record_index_;
     std::streampos head_offset_;
-    std::vector<std::chrono::microseconds> record_timestamp_;
 
     // Just `std::atomic<end_t> end_;` won't work in g++ until 5.1, ref.
     // http://stackoverflow.com/questions/29824570/segfault-in-stdatomic-load/29824840#29824840
     // std::atomic<end_t> end_;
     current::atomic_that_works<end_t> end_;
 
+    // The durability-related state. `unflushed_` and `uncommitted_bytes_` are guarded by `publish_mutex_ref_`.
+    const FileDurability durability_;
+    mutable bool unflushed_ = false;
+    mutable size_t uncommitted_bytes_ = 0u;
+    int sync_fd_ = -1;
+    mutable std::mutex commit_mutex_;                 // Only one commit at a time.
+    mutable WaitableAtomic<uint64_t> durable_size_;   // The number of entries known to be `fdatasync`-ed.
+    mutable std::mutex group_commit_mutex_;           // Guards `group_commit_*` below. Locked after `publish_mutex_ref_`.
+    mutable std::condition_variable group_commit_cv_;
+    mutable bool group_commit_requested_ = false;
+    mutable uint64_t group_commit_covers_ = 0u;  // The `next_index` of the most recent commit, once it has started.
+    bool group_commit_terminating_ = false;
+    std::thread group_commit_thread_;
+
+    // The shared read-only mapping of the file for the iterators. Guarded by `publish_mutex_ref_`.
+    mutable std::shared_ptr<const MemoryMappedFile> mapping_;
+
+    // The index sidecar, see `FileIndexSidecar`. Guarded by `publish_mutex_ref_`.
+    // The entries starting from `index_sidecar_next_` are not yet saved into the sidecar.
+    const FileIndexSidecar index_sidecar_;
+    std::ofstream index_sidecar_appender_;
+    uint64_t index_sidecar_next_ = 0u;
+
+    // The startup replay mode, see `FileRecovery`.
+    const FileRecovery recovery_;
+
     FilePersisterImpl() = delete;
     FilePersisterImpl(const FilePersisterImpl&) = delete;
     FilePersisterImpl(FilePersisterImpl&&) = delete;
@@ -170,81 +614,225 @@ class FilePersister {
 
     FilePersisterImpl(std::mutex& publish_mutex_ref,
                       const ss::StreamNamespaceName& namespace_name,
-                      const std::string& filename)
+                      const std::string& filename,
+                      FileDurability durability,
+                      FileIndexSidecar index_sidecar,
+                      FileRecovery recovery)
         : filename_(filename),
-          file_appender_(filename, std::ofstream::app | std::ofstream::ate),
-          head_rewriter_(filename, std::ofstream::in | std::ofstream::out),
+          file_appender_(filename, std::ofstream::app | std::ofstream::ate | FileFormatImpl<FORMAT>::kOpenMode),
+          head_rewriter_(filename, std::ofstream::in | std::ofstream::out | FileFormatImpl<FORMAT>::kOpenMode),
           publish_mutex_ref_(publish_mutex_ref),
-          head_offset_(0) {
+          head_offset_(0),
+          durability_(durability),
+          durable_size_(0u),
+          index_sidecar_(index_sidecar),
+          recovery_(recovery) {
       ValidateFileAndInitializeHead(namespace_name);
       if (file_appender_.bad() || head_rewriter_.bad()) {
         CURRENT_THROW(PersistenceFileNotWritable(filename));
       }
+#ifndef CURRENT_WINDOWS
+      sync_fd_ = ::open(filename.c_str(), O_WRONLY);
+      if (sync_fd_ < 0) {
+        CURRENT_THROW(PersistenceFileNotWritable(filename));
+      }
+#endif  // CURRENT_WINDOWS
+      // What was there in the file at startup is considered durable.
+      durable_size_.SetValue(end_.load().next_index);
+      if (durability_.policy == FileDurability::Policy::GroupCommit) {
+        group_commit_thread_ = std::thread([this]() { GroupCommitThread(); });
+      }
+    }
+
+    ~FilePersisterImpl() {
+      if (group_commit_thread_.joinable()) {
+        {
+          std::lock_guard<std::mutex> lock(group_commit_mutex_);
+          group_commit_terminating_ = true;
+        }
+        group_commit_cv_.notify_one();
+        group_commit_thread_.join();
+      }
+      if (durability_.policy != FileDurability::Policy::FlushEachEntry) {
+        Commit();
+      }
+      SaveIndexSidecarBlock();
+#ifndef CURRENT_WINDOWS
+      if (sync_fd_ >= 0) {
+        ::close(sync_fd_);
+      }
+#endif  // CURRENT_WINDOWS
+    }
+
+    // To be called with `publish_mutex_ref_` locked, after appending `bytes` to the file.
+    void OnAppended(size_t bytes) {
+      if (durability_.policy == FileDurability::Policy::FlushEachEntry) {
+        file_appender_.flush();
+      } else {
+        unflushed_ = true;
+      }
+      uncommitted_bytes_ += bytes;
+      if (durability_.policy == FileDurability::Policy::GroupCommit && uncommitted_bytes_ >= durability_.max_bytes) {
+        RequestGroupCommit();
+      }
+    }
+
+    // To be called with `publish_mutex_ref_` locked, before reading or rewriting the file.
+    void FlushIfNeeded() const {
+      if (unflushed_) {
+        file_appender_.flush();
+        unflushed_ = false;
+      }
+    }
+
+    void RequestGroupCommit() const {
+      {
+        std::lock_guard<std::mutex> lock(group_commit_mutex_);
+        group_commit_requested_ = true;
+      }
+      group_commit_cv_.notify_one();
+    }
+
+    // Requests the group commit for the entries up to and including `index`, unless the commit in progress already
+    // covers them, or the next one has already been requested. The group commit thread starts the requested commit
+    // as soon as the one in progress, if any, is done.
+    void RequestGroupCommitCovering(uint64_t index) const {
+      {
+        std::lock_guard<std::mutex> lock(group_commit_mutex_);
+        if (index < group_commit_covers_ || group_commit_requested_) {
+          return;
+        }
+        group_commit_requested_ = true;
+      }
+      group_commit_cv_.notify_one();
+    }
+
+    void GroupCommitThread() {
+      std::unique_lock<std::mutex> lock(group_commit_mutex_);
+      while (!group_commit_terminating_) {
+        group_commit_cv_.wait_for(lock, durability_.max_delay, [this]() {
+          return group_commit_requested_ || group_commit_terminating_;
+        });
+        group_commit_requested_ = false;
+        lock.unlock();
+        Commit();
+        lock.lock();
+      }
+    }
+
+    // Returns the shared mapping of the file covering at least its first `bytes`. The mapping is recreated with
+    // some headroom as the file grows, so that it rarely needs to be recreated. The iterators hold on to the mapping
+    // they were created with, so the older mappings are released once no iterators are using them.
+    // To be called with `publish_mutex_ref_` locked.
+    std::shared_ptr<const MemoryMappedFile> MappingCovering(size_t bytes) const {
+      if (!mapping_ || mapping_->live_size() < bytes) {
+        size_t size = constants::kMinFileMappingSize;
+        while (size < bytes) {
+          size *= 2u;
+        }
+        mapping_ = std::make_shared<const MemoryMappedFile>(filename_, size);
+      }
+      return mapping_;
+    }
+
+    // Flushes the appended entries and `fdatasync`-s the file. Must be called with `publish_mutex_ref_` unlocked.
+    void Commit() const {
+      std::lock_guard<std::mutex> commit_lock(commit_mutex_);
+      uint64_t next_index;
+      bool needs_sync;
+      {
+        std::lock_guard<std::mutex> lock(publish_mutex_ref_);
+        FlushIfNeeded();
+        next_index = end_.load().next_index;
+        needs_sync = (uncommitted_bytes_ != 0u);
+        uncommitted_bytes_ = 0u;
+        std::lock_guard<std::mutex> group_commit_lock(group_commit_mutex_);
+        group_commit_covers_ = next_index;
+      }
+      if (needs_sync) {
+#ifndef CURRENT_WINDOWS
+#ifdef CURRENT_APPLE
+        ::fsync(sync_fd_);
+#else
+        ::fdatasync(sync_fd_);
+#endif  // CURRENT_APPLE
+#endif  // CURRENT_WINDOWS
+      }
+      durable_size_.SetValueIf([next_index](uint64_t value) { return value < next_index; }, next_index);
     }
 
     // Replay the file but ignore its contents. Used to initialize `end_` at startup.
+    // With the index sidecar enabled, only the tail of the file not covered by the sidecar is replayed.
     void ValidateFileAndInitializeHead(const ss::StreamNamespaceName& namespace_name) {
-      std::ifstream fi(filename_);
+      std::ifstream fi(filename_, std::ifstream::in | FileFormatImpl<FORMAT>::kOpenMode);
       if (!fi.bad()) {
-        // Read through all the lines.
-        // Let `IteratorOverFileOfPersistedEntries` maintain its own `next_`, which later becomes `this->end_`.
-        // While reading the file, record the offset of each record and store it in `record_offset_`.
-        IteratorOverFileOfPersistedEntries<ENTRY> cit(fi, 0, 0);
         const std::streampos offset_zero(0);
-        auto current_offset = offset_zero;
         auto head = std::chrono::microseconds(-1);
         reflection::StructSchema struct_schema;
         struct_schema.AddType<ENTRY>();
         const auto signature = JSON(ss::StreamSignature(namespace_name, struct_schema.GetSchemaInfo()));
-        while (cit.ProcessNextEntry(
-            [&](const idxts_t& current, const char*) {
-              CURRENT_ASSERT(current.index == record_offset_.size());
-              CURRENT_ASSERT(current.index == record_timestamp_.size());
-              if (!(current.us > head)) {
-                CURRENT_THROW(ss::InconsistentTimestampException(head + std::chrono::microseconds(1), current.us));
-              }
-              record_offset_.push_back(current_offset);
-              record_timestamp_.push_back(current.us);
-              current_offset = fi.tellg();
-              head = current.us;
-              head_offset_ = 0;
-            },
-            [&](const std::string& value) {
-              static const auto head_key_length = strlen(constants::kHeadDirective);
-              static const auto signature_key_length = strlen(constants::kSignatureDirective);
-              head_offset_ = 0;
-              if (!value.compare(0, head_key_length, constants::kHeadDirective)) {
-                auto offset = head_key_length;
-                while (std::isspace(value[offset])) {
-                  ++offset;
-                }
-                const auto us = std::chrono::microseconds(current::FromString<head_value_t>(value.c_str() + offset));
-                if (!(us > head)) {
-                  CURRENT_THROW(ss::InconsistentTimestampException(head + std::chrono::microseconds(1), us));
-                }
-                head = us;
-                head_offset_ = std::streampos(static_cast<size_t>(current_offset) + offset);
-              } else if (!value.compare(0, signature_key_length, constants::kSignatureDirective)) {
-                // The signature, if present, should be at the beginning of the file.
-                if (current_offset != offset_zero) {
-                  CURRENT_THROW(InvalidSignatureLocation());
-                }
-                auto offset = signature_key_length;
-                while (std::isspace(value[offset])) {
-                  ++offset;
+
+        auto current_offset = offset_zero;
+        if (index_sidecar_.enabled) {
+          current_offset = LoadIndexSidecar(fi, head);
+          if (current_offset != offset_zero) {
+            // The signature is not replayed, but it should still be validated.
+            std::string first_line;
+            fi.seekg(0, std::ios_base::beg);
+            if (std::getline(fi, first_line) &&
+                !first_line.compare(0, strlen(constants::kSignatureDirective), constants::kSignatureDirective)) {
+              ValidateSignature(signature, first_line);
+            }
+            fi.clear();
+          }
+        }
+
+        // Read through all the lines, unless the file was replayed in parallel.
+        // Let `IteratorOverFileOfPersistedEntries` maintain its own `next_`, which later becomes `this->end_`.
+        // While reading the file, record the offset and the timestamp of each record in `record_index_`.
+        if (!ReplayInParallel(signature, current_offset, head)) {
+          IteratorOverFileOfPersistedEntries<ENTRY, FORMAT> cit(fi, current_offset, record_index_.size());
+          while (cit.ProcessNextEntry(
+              [&](const idxts_t& current, const char*) {
+                CURRENT_ASSERT(current.index == record_index_.size());
+                if (!(current.us > head)) {
+                  CURRENT_THROW(ss::InconsistentTimestampException(head + std::chrono::microseconds(1), current.us));
                 }
-                if (value.compare(offset, signature.length(), signature)) {
-                  CURRENT_THROW(InvalidStreamSignature(signature, value.substr(offset)));
+                record_index_.push_back(static_cast<uint64_t>(current_offset), current.us);
+                current_offset = fi.tellg();
+                head = current.us;
+                head_offset_ = 0;
+              },
+              [&](const std::string& value) {
+                static const auto head_key_length = strlen(constants::kHeadDirective);
+                static const auto signature_key_length = strlen(constants::kSignatureDirective);
+                head_offset_ = 0;
+                if (!value.compare(0, head_key_length, constants::kHeadDirective)) {
+                  auto offset = head_key_length;
+                  while (std::isspace(value[offset])) {
+                    ++offset;
+                  }
+                  const auto us = std::chrono::microseconds(current::FromString<head_value_t>(value.c_str() + offset));
+                  if (!(us > head)) {
+                    CURRENT_THROW(ss::InconsistentTimestampException(head + std::chrono::microseconds(1), us));
+                  }
+                  head = us;
+                  head_offset_ = std::streampos(static_cast<size_t>(current_offset) + offset);
+                } else if (!value.compare(0, signature_key_length, constants::kSignatureDirective)) {
+                  // The signature, if present, should be at the beginning of the file.
+                  if (current_offset != offset_zero) {
+                    CURRENT_THROW(InvalidSignatureLocation());
+                  }
+                  ValidateSignature(signature, value);
                 }
-              }
-              current_offset = fi.tellg();
-            })) {
-          ;
+                current_offset = fi.tellg();
+              })) {
+            ;
+          }
         }
-        const auto& next = cit.Next();
-        // The `next.us` stores the closest possible next entry timestamp,
-        // so the last processed entry timestamp is always 1us less.
-        end_.store({next.index, next.us - std::chrono::microseconds(1), head});
+        end_.store({record_index_.size(),
+                    record_index_.empty() ? std::chrono::microseconds(-1) : record_index_.LastTimestamp(),
+                    head});
         // Append the signature if there is neither entries nor directives in the file.
         if (!current_offset) {
           file_appender_ << constants::kSignatureDirective << ' ' << signature << std::endl;
@@ -252,6 +840,320 @@ class FilePersister {
       } else {
         end_.store({0ull, std::chrono::microseconds(-1), std::chrono::microseconds(-1)});
       }
+      if (index_sidecar_.enabled) {
+        // Whatever was not loaded from the sidecar, or all of it if the sidecar was rejected, is saved right away.
+        index_sidecar_appender_.open(
+            filename_ + constants::kIndexSidecarSuffix,
+            std::ofstream::binary | (index_sidecar_next_ ? std::ofstream::app : std::ofstream::trunc));
+        SaveIndexSidecarBlock();
+      }
+    }
+
+    static void ValidateSignature(const std::string& signature, const std::string& value) {
+      static const auto signature_key_length = strlen(constants::kSignatureDirective);
+      auto offset = signature_key_length;
+      while (std::isspace(value[offset])) {
+        ++offset;
+      }
+      if (value.compare(offset, signature.length(), signature)) {
+        CURRENT_THROW(InvalidStreamSignature(signature, value.substr(offset)));
+      }
+    }
+
+    // The result of replaying the chunk `[begin, end)` of the file, see `FileRecovery`. The indexes and timestamps
+    // are validated within the chunk, while the checks against the state preceding the chunk are left to stitching:
+    // that the first entry has the expected index, and that the first entry or `#head` comes after the head.
+    struct RecoveryChunk {
+      size_t begin;
+      size_t end;
+      bool valid = false;
+      bool has_records = false;
+      bool has_entries = false;
+      bool has_events = false;  // Entries or `#head` directives.
+      uint64_t first_index = 0u;
+      int64_t first_event_us = 0;
+      int64_t last_event_us = 0;
+      size_t head_offset = 0u;  // The offset of the `#head` value, if the chunk ends with a `#head` directive.
+      CompactRecordIndex entries;
+    };
+
+    static void ReplayChunk(const char* data, const std::string& signature, RecoveryChunk& chunk) {
+      static const auto head_key_length = strlen(constants::kHeadDirective);
+      static const auto signature_key_length = strlen(constants::kSignatureDirective);
+      try {
+        const char* const end = data + chunk.end;
+        const char* p = data + chunk.begin;
+        while (p < end) {
+          bool is_directive;
+          const char* const next = FileFormatImpl<FORMAT>::NextRecord(p, end, is_directive);
+          const size_t offset = static_cast<size_t>(p - data);
+          int64_t us = 0;
+          bool is_event = true;
+          chunk.head_offset = 0u;
+          if (!is_directive) {
+            const idxts_t idxts = FileFormatImpl<FORMAT>::ParseIndexAndTimestamp(p, next);
+            if (!chunk.has_entries) {
+              chunk.has_entries = true;
+              chunk.first_index = idxts.index;
+            } else if (idxts.index != chunk.first_index + chunk.entries.size()) {
+              return;
+            }
+            us = idxts.us.count();
+          } else {
+            const std::string value(p, next - 1);
+            if (!value.compare(0, head_key_length, constants::kHeadDirective)) {
+              auto value_offset = head_key_length;
+              while (std::isspace(value[value_offset])) {
+                ++value_offset;
+              }
+              us = current::FromString<head_value_t>(value.c_str() + value_offset);
+              chunk.head_offset = offset + value_offset;
+            } else {
+              is_event = false;
+              if (!value.compare(0, signature_key_length, constants::kSignatureDirective)) {
+                if (offset) {
+                  return;
+                }
+                ValidateSignature(signature, value);
+              }
+            }
+          }
+          if (is_event) {
+            if (!chunk.has_events) {
+              chunk.has_events = true;
+              chunk.first_event_us = us;
+            } else if (!(us > chunk.last_event_us)) {
+              return;
+            }
+            chunk.last_event_us = us;
+            if (!is_directive) {
+              chunk.entries.push_back(offset, std::chrono::microseconds(us));
+            }
+          }
+          chunk.has_records = true;
+          p = next;
+        }
+        chunk.valid = true;
+      } catch (...) {
+        // Leave `chunk.valid` as `false`, the sequential replay will report the error.
+      }
+    }
+
+    // Replays the file starting from `offset` in parallel, see `FileRecovery`. Returns `false` if the file was not
+    // replayed, either because the parallel replay is not enabled or not worth it, or because some chunk of the file
+    // did not validate. Otherwise, populates `record_index_`, `head_offset_`, and updates `offset` and `head`.
+    bool ReplayInParallel(const std::string& signature, std::streampos& offset, std::chrono::microseconds& head) {
+      if (recovery_.threads < 2u) {
+        return false;
+      }
+      std::unique_ptr<MemoryMappedFile> mapping;
+      try {
+        mapping = std::make_unique<MemoryMappedFile>(filename_);
+      } catch (const current::Exception&) {
+        return false;
+      }
+      const char* const data = mapping->data();
+      const size_t begin = static_cast<size_t>(offset);
+      const size_t size = mapping->file_size();
+      if (size <= begin) {
+        return false;
+      }
+      const size_t chunks_count =
+          std::min(recovery_.threads, (size - begin) / std::max(recovery_.min_bytes_per_thread, size_t(1)));
+      if (chunks_count < 2u) {
+        return false;
+      }
+
+      std::vector<RecoveryChunk> chunks(chunks_count);
+      try {
+        size_t chunk_begin = begin;
+        for (size_t i = 0; i < chunks_count; ++i) {
+          const size_t target = begin + (size - begin) * (i + 1u) / chunks_count;
+          size_t chunk_end = size;
+          if (i + 1u < chunks_count) {
+            chunk_end = (target <= chunk_begin)
+                            ? chunk_begin
+                            : static_cast<size_t>(FileFormatImpl<FORMAT>::RecordBoundary(
+                                                      data + chunk_begin, data + target, data + size) -
+                                                  data);
+          }
+          chunks[i].begin = chunk_begin;
+          chunks[i].end = chunk_end;
+          chunk_begin = chunk_end;
+        }
+      } catch (const current::Exception&) {
+        return false;
+      }
+
+      std::vector<std::thread> threads;
+      for (size_t i = 1u; i < chunks_count; ++i) {
+        threads.emplace_back([data, &signature, &chunks, i]() { ReplayChunk(data, signature, chunks[i]); });
+      }
+      ReplayChunk(data, signature, chunks[0]);
+      for (auto& thread : threads) {
+        thread.join();
+      }
+
+      // Stitch the chunks together, first making sure they all fit, so that nothing needs to be rolled back.
+      uint64_t next_index = record_index_.size();
+      int64_t head_us = head.count();
+      for (const RecoveryChunk& chunk : chunks) {
+        if (!chunk.valid || (chunk.has_entries && chunk.first_index != next_index) ||
+            (chunk.has_events && !(chunk.first_event_us > head_us))) {
+          return false;
+        }
+        next_index += chunk.entries.size();
+        if (chunk.has_events) {
+          head_us = chunk.last_event_us;
+        }
+      }
+      for (const RecoveryChunk& chunk : chunks) {
+        chunk.entries.ForEach([this](uint64_t record_offset, std::chrono::microseconds us) {
+          record_index_.push_back(record_offset, us);
+        });
+        if (chunk.has_records) {
+          head_offset_ = std::streampos(static_cast<std::streamoff>(chunk.head_offset));
+          offset = std::streampos(static_cast<std::streamoff>(chunk.end));
+        }
+      }
+      head = std::chrono::microseconds(head_us);
+      return true;
+    }
+
+    // Loads the offsets and timestamps of the entries from the index sidecar, as long as it matches the log file.
+    // Returns the offset in the log file to continue replaying it from, or zero if the sidecar was not usable.
+    std::streampos LoadIndexSidecar(std::istream& fi, std::chrono::microseconds& head) {
+      std::string contents;
+      try {
+        contents = FileSystem::ReadFileAsString(filename_ + constants::kIndexSidecarSuffix);
+      } catch (const FileException&) {
+        return 0;
+      }
+      fi.seekg(0, std::ios_base::end);
+      const uint64_t log_size = static_cast<uint64_t>(fi.tellg());
+
+      const char* p = contents.data();
+      const char* const end = p + contents.length();
+      uint64_t log_length = 0u;
+      int64_t head_us = -1;
+      int64_t head_offset = 0;
+      while (end - p >= static_cast<std::ptrdiff_t>(constants::kIndexBlockHeaderSize)) {
+        uint32_t magic;
+        uint32_t count;
+        uint64_t first_index;
+        std::memcpy(&magic, p, sizeof(magic));
+        std::memcpy(&count, p + 4, sizeof(count));
+        std::memcpy(&first_index, p + 8, sizeof(first_index));
+        const size_t block_size = constants::kIndexBlockHeaderSize + count * constants::kIndexBlockEntrySize +
+                                  constants::kIndexBlockTrailerSize;
+        if (magic != constants::kIndexBlockMagic || first_index != record_index_.size() ||
+            static_cast<size_t>(end - p) < block_size) {
+          break;
+        }
+        const char* trailer = p + block_size - constants::kIndexBlockTrailerSize;
+        uint64_t block_log_length;
+        uint32_t crc;
+        std::memcpy(&block_log_length, trailer, sizeof(block_log_length));
+        std::memcpy(&crc, trailer + 24, sizeof(crc));
+        if (CRC32C(0, p, block_size - 4) != crc || block_log_length > log_size || block_log_length < log_length) {
+          break;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+          const char* entry = p + constants::kIndexBlockHeaderSize + i * constants::kIndexBlockEntrySize;
+          int64_t offset;
+          int64_t us;
+          std::memcpy(&offset, entry, sizeof(offset));
+          std::memcpy(&us, entry + 8, sizeof(us));
+          record_index_.push_back(static_cast<uint64_t>(offset), std::chrono::microseconds(us));
+        }
+        log_length = block_log_length;
+        std::memcpy(&head_us, trailer + 8, sizeof(head_us));
+        std::memcpy(&head_offset, trailer + 16, sizeof(head_offset));
+        p += block_size;
+      }
+
+      // Cross-check the last indexed entry and the head against the log file itself.
+      bool valid = (log_length > 0u);
+      if (valid && !record_index_.empty()) {
+        std::string buffer;
+        PersistedRecord record;
+        fi.seekg(static_cast<std::streamoff>(record_index_.LastOffset()), std::ios_base::beg);
+        try {
+          valid = FileFormatImpl<FORMAT>::ReadRecord(fi, buffer, record) && !record.is_directive &&
+                  record.idxts.index + 1u == record_index_.size() && record.idxts.us == record_index_.LastTimestamp();
+        } catch (const current::Exception&) {
+          valid = false;
+        }
+      }
+      if (valid && head_offset) {
+        // The `#head` directive may have been rewritten in place since the block was saved.
+        char head_str[21] = {0};
+        fi.seekg(head_offset, std::ios_base::beg);
+        valid = static_cast<bool>(fi.read(head_str, 20));
+        head_us = current::FromString<head_value_t>(head_str);
+      }
+      if (valid && !record_index_.empty() && !(head_us >= record_index_.LastTimestamp().count())) {
+        valid = false;
+      }
+      fi.clear();
+      // The sidecar is rebuilt if any part of it is rejected.
+      index_sidecar_next_ = (valid && p == end) ? record_index_.size() : 0u;
+      if (!valid) {
+        record_index_.clear();
+        fi.seekg(0, std::ios_base::beg);
+        return 0;
+      }
+      head = std::chrono::microseconds(head_us);
+      head_offset_ = std::streampos(head_offset);
+      return std::streampos(log_length);
+    }
+
+    // Appends the entries not yet saved into the index sidecar as a single block.
+    // To be called with `publish_mutex_ref_` locked, or from the constructor or the destructor.
+    void SaveIndexSidecarBlock() {
+      if (!index_sidecar_.enabled) {
+        return;
+      }
+      const uint64_t first_index = index_sidecar_next_;
+      const uint32_t count = static_cast<uint32_t>(record_index_.size() - first_index);
+      if (!count && first_index) {
+        return;
+      }
+      // The sidecar must never claim more of the log than what has been handed over to the OS.
+      FlushIfNeeded();
+      const uint64_t log_length = static_cast<uint64_t>(file_appender_.tellp());
+      std::string block(constants::kIndexBlockHeaderSize + count * constants::kIndexBlockEntrySize +
+                            constants::kIndexBlockTrailerSize,
+                        '\0');
+      char* p = &block[0];
+      std::memcpy(p, &constants::kIndexBlockMagic, 4);
+      std::memcpy(p + 4, &count, 4);
+      std::memcpy(p + 8, &first_index, 8);
+      for (uint32_t i = 0; i < count; ++i) {
+        char* entry = p + constants::kIndexBlockHeaderSize + i * constants::kIndexBlockEntrySize;
+        const int64_t offset = static_cast<int64_t>(record_index_.Offset(static_cast<size_t>(first_index + i)));
+        const int64_t us = record_index_.Timestamp(static_cast<size_t>(first_index + i)).count();
+        std::memcpy(entry, &offset, 8);
+        std::memcpy(entry + 8, &us, 8);
+      }
+      char* trailer = p + block.length() - constants::kIndexBlockTrailerSize;
+      const int64_t head_us = end_.load().head.count();
+      const int64_t head_offset = static_cast<int64_t>(head_offset_);
+      std::memcpy(trailer, &log_length, 8);
+      std::memcpy(trailer + 8, &head_us, 8);
+      std::memcpy(trailer + 16, &head_offset, 8);
+      const uint32_t crc = CRC32C(0, p, block.length() - 4);
+      std::memcpy(trailer + 24, &crc, 4);
+      index_sidecar_appender_.write(block.data(), block.length());
+      index_sidecar_appender_.flush();
+      index_sidecar_next_ = record_index_.size();
+    }
+
+    // To be called with `publish_mutex_ref_` locked, after publishing an entry.
+    void OnPublished() {
+      if (index_sidecar_.enabled && record_index_.size() - index_sidecar_next_ >= index_sidecar_.checkpoint_every) {
+        SaveIndexSidecarBlock();
+      }
     }
   };
 
@@ -264,10 +1166,69 @@ class FilePersister {
 
   FilePersister(std::mutex& publish_mutex_ref,
                 const ss::StreamNamespaceName& namespace_name,
-                const std::string& filename)
-      : file_persister_impl_(MakeOwned<FilePersisterImpl>(publish_mutex_ref, namespace_name, filename)) {}
+                const std::string& filename,
+                FileDurability durability = FileDurability(),
+                FileIndexSidecar index_sidecar = FileIndexSidecar(),
+                FileRecovery recovery = FileRecovery())
+      : file_persister_impl_(MakeOwned<FilePersisterImpl>(
+            publish_mutex_ref, namespace_name, filename, durability, index_sidecar, recovery)) {}
+
+  // The iterators share the memory mapping of the file, and walk it sequentially, from the offset of the first entry
+  // of the range. `cursor_` points to the beginning of the entry with the index `cursor_index_`, or to a directive
+  // preceding it. The entries being skipped over are not parsed.
+  class IteratorBase {
+   public:
+    IteratorBase(Borrowed<FilePersisterImpl> file_persister_impl,
+                 std::shared_ptr<const MemoryMappedFile> mapping,
+                 uint64_t i,
+                 size_t offset,
+                 size_t end_offset)
+        : file_persister_impl_(std::move(file_persister_impl)),
+          mapping_(std::move(mapping)),
+          i_(i),
+          cursor_index_(i),
+          cursor_(mapping_ ? mapping_->data() + offset : nullptr),
+          end_(mapping_ ? mapping_->data() + end_offset : nullptr) {}
+
+    IteratorBase(IteratorBase&&) = default;
+    IteratorBase& operator=(IteratorBase&&) = default;
+
+    bool operator==(const IteratorBase& rhs) const { return i_ == rhs.i_; }
+    bool operator!=(const IteratorBase& rhs) const { return !operator==(rhs); }
+    operator bool() const { return file_persister_impl_; }
 
-  class Iterator final {
+   protected:
+    // Returns the beginning of the entry with the index `i_`, and sets `next` to where it ends.
+    const char* Seek(const char*& next) const {
+      while (true) {
+        if (!(cursor_ < end_)) {
+          // End of file. Should never happen as long as the user only iterates over valid ranges.
+          CURRENT_THROW(current::Exception());  // LCOV_EXCL_LINE
+        }
+        bool is_directive;
+        next = FileFormatImpl<FORMAT>::NextRecord(cursor_, end_, is_directive);
+        if (!is_directive) {
+          if (cursor_index_ == i_) {
+            const char* result = cursor_;
+            cursor_ = next;
+            ++cursor_index_;
+            return result;
+          }
+          ++cursor_index_;
+        }
+        cursor_ = next;
+      }
+    }
+
+    Borrowed<FilePersisterImpl> file_persister_impl_;
+    std::shared_ptr<const MemoryMappedFile> mapping_;
+    uint64_t i_;
+    mutable uint64_t cursor_index_;
+    mutable const char* cursor_;
+    const char* end_;
+  };
+
+  class Iterator final : public IteratorBase {
    public:
     struct Entry {
       idxts_t idx_ts;
@@ -281,59 +1242,35 @@ class FilePersister {
     Iterator(Iterator&&) = default;
     Iterator& operator=(Iterator&&) = default;
 
-    Iterator(Borrowed<FilePersisterImpl> file_persister_impl,
-             const std::string& filename,
-             uint64_t i,
-             std::streampos offset,
-             uint64_t index_at_offset)
-        : file_persister_impl_(std::move(file_persister_impl)), i_(i) {
-      if (!filename.empty()) {
-        fi_ = std::make_unique<std::ifstream>(filename);
-        cit_ = std::make_unique<IteratorOverFileOfPersistedEntries<ENTRY>>(*fi_, offset, index_at_offset);
-      }
-    }
+    using IteratorBase::IteratorBase;
 
     // `operator*` relies on the fact each entry will be requested at most once.
     // The range-based for-loop works fine. -- D.K.
     Entry operator*() const {
-      Entry result;
-      bool found = false;
-      while (!found) {
-        if (!(cit_->ProcessNextEntry(
-                [this, &found, &result](const idxts_t& cursor, const char* json) {
-                  if (cursor.index == i_) {
-                    found = true;
-                    result.idx_ts = cursor;
-                    result.entry = ParseJSON<ENTRY>(json);
-                  } else if (cursor.index > i_) {                                     // LCOV_EXCL_LINE
-                    CURRENT_THROW(ss::InconsistentIndexException(i_, cursor.index));  // LCOV_EXCL_LINE
-                  }
-                },
-                [](const std::string&) {}))) {
-          // End of file. Should never happen as long as the user only iterates over valid ranges.
-          CURRENT_THROW(current::Exception());  // LCOV_EXCL_LINE
-        }
+      const char* next;
+      const char* begin = IteratorBase::Seek(next);
+      PersistedRecord record;
+      FileFormatImpl<FORMAT>::ParseEntry(begin, next, record, buffer_);
+      if (record.idxts.index != IteratorBase::i_) {
+        CURRENT_THROW(ss::InconsistentIndexException(IteratorBase::i_, record.idxts.index));  // LCOV_EXCL_LINE
       }
+      Entry result;
+      result.idx_ts = record.idxts;
+      result.entry = ParseEntryPayload<ENTRY>(record);
       return result;
     }
 
     Iterator& operator++() {
       // By convention, iterating over data, being an immutable operation, does not throw.
-      ++i_;
+      ++IteratorBase::i_;
       return *this;
     }
-    bool operator==(const Iterator& rhs) const { return i_ == rhs.i_; }
-    bool operator!=(const Iterator& rhs) const { return !operator==(rhs); }
-    operator bool() const { return file_persister_impl_; }
 
    private:
-    const Borrowed<FilePersisterImpl> file_persister_impl_;
-    std::unique_ptr<std::ifstream> fi_;
-    std::unique_ptr<IteratorOverFileOfPersistedEntries<ENTRY>> cit_;
-    uint64_t i_;
+    mutable std::string buffer_;
   };
 
-  class IteratorUnsafe final {
+  class IteratorUnsafe final : public IteratorBase {
    public:
     IteratorUnsafe() = delete;
     IteratorUnsafe(const IteratorUnsafe&) = delete;
@@ -341,88 +1278,68 @@ class FilePersister {
     IteratorUnsafe& operator=(const IteratorUnsafe&) = delete;
     IteratorUnsafe& operator=(IteratorUnsafe&&) = default;
 
-    IteratorUnsafe(Borrowed<FilePersisterImpl> file_persister_impl,
-                   const std::string& filename,
-                   uint64_t i,
-                   std::streampos offset,
-                   uint64_t)
-        : file_persister_impl_(std::move(file_persister_impl)), i_(i), current_offset_(offset) {
-      if (!filename.empty()) {
-        fi_ = std::make_unique<std::ifstream>(filename);
-        CURRENT_ASSERT(!fi_->bad());
-        if (offset) {
-          fi_->seekg(offset, std::ios_base::beg);
-        }
-      }
-    }
+    using IteratorBase::IteratorBase;
 
     // `operator*` relies on the fact each entry will be requested at most once.
     // The range-based for-loop works fine. -- D.K.
     std::string operator*() const {
       if (current_entry_.empty()) {
-        const auto offset = file_persister_impl_->record_offset_[static_cast<size_t>(i_)];
-        if (offset != current_offset_) {
-          fi_->seekg(offset, std::ios_base::beg);
-          current_offset_ = offset;
-        }
-        if (std::getline(*fi_, current_entry_)) {
-          CURRENT_ASSERT(current_entry_[0] != constants::kDirectiveMarker);
-        } else {
-          // End of file. Should never happen as long as the user only iterates over valid ranges.
-          CURRENT_THROW(current::Exception());  // LCOV_EXCL_LINE
-        }
+        const char* next;
+        const char* begin = IteratorBase::Seek(next);
+        FileFormatImpl<FORMAT>::template RawEntry<ENTRY>(begin, next, current_entry_);
       }
       return current_entry_;
     }
 
     IteratorUnsafe& operator++() {
-      ++i_;
+      ++IteratorBase::i_;
       current_entry_.clear();
       return *this;
     }
-    bool operator==(const IteratorUnsafe& rhs) const { return i_ == rhs.i_; }
-    bool operator!=(const IteratorUnsafe& rhs) const { return !operator==(rhs); }
-    operator bool() const { return file_persister_impl_; }
 
    private:
-    Borrowed<FilePersisterImpl> file_persister_impl_;
-    bool valid_ = true;
-    std::unique_ptr<std::ifstream> fi_;
-    uint64_t i_;
     mutable std::string current_entry_;
-    mutable std::streampos current_offset_;
   };
 
   template <typename ITERATOR>
   class IterableRangeImpl {
    public:
     IterableRangeImpl(Borrowed<FilePersisterImpl> file_persister_impl,
+                      std::shared_ptr<const MemoryMappedFile> mapping,
                       uint64_t begin,
                       uint64_t end,
-                      std::streampos begin_offset)
-        : file_persister_impl_(std::move(file_persister_impl)), begin_(begin), end_(end), begin_offset_(begin_offset) {}
+                      size_t begin_offset,
+                      size_t end_offset)
+        : file_persister_impl_(std::move(file_persister_impl)),
+          mapping_(std::move(mapping)),
+          begin_(begin),
+          end_(end),
+          begin_offset_(begin_offset),
+          end_offset_(end_offset) {}
 
     IterableRangeImpl(IterableRangeImpl&& rhs)
         : file_persister_impl_(std::move(rhs.file_persister_impl_)),
+          mapping_(std::move(rhs.mapping_)),
           begin_(rhs.begin_),
           end_(rhs.end_),
-          begin_offset_(rhs.begin_offset_) {}
+          begin_offset_(rhs.begin_offset_),
+          end_offset_(rhs.end_offset_) {}
 
     ITERATOR begin() const {
       // By convention, iterating over data, being an immutable operation, does not throw.
       if (begin_ == end_) {
-        return ITERATOR(file_persister_impl_, "", 0, 0, 0);  // No need in accessing the file for a null iterator.
+        return ITERATOR(file_persister_impl_, nullptr, 0, 0, 0);  // No need in accessing the file for a null iterator.
       } else {
-        return ITERATOR(file_persister_impl_, file_persister_impl_->filename_, begin_, begin_offset_, begin_);
+        return ITERATOR(file_persister_impl_, mapping_, begin_, begin_offset_, end_offset_);
       }
     }
     ITERATOR end() const {
       // By convention, iterating over data, being an immutable operation, does not throw.
       if (begin_ == end_) {
-        return ITERATOR(file_persister_impl_, "", 0, 0, 0);  // No need in accessing the file for a null iterator.
+        return ITERATOR(file_persister_impl_, nullptr, 0, 0, 0);  // No need in accessing the file for a null iterator.
       } else {
-        return ITERATOR(
-            file_persister_impl_, "", end_, 0, 0);  // No need in accessing the file for a no-op `end` iterator.
+        // No need in accessing the file for a no-op `end` iterator.
+        return ITERATOR(file_persister_impl_, nullptr, end_, 0, 0);
       }
     }
 
@@ -430,14 +1347,34 @@ class FilePersister {
 
    private:
     const Borrowed<FilePersisterImpl> file_persister_impl_;
+    std::shared_ptr<const MemoryMappedFile> mapping_;
     const uint64_t begin_;
     const uint64_t end_;
-    const std::streampos begin_offset_;
+    const size_t begin_offset_;
+    const size_t end_offset_;
   };
 
   // `TIMESTAMP` can be `std::chrono::microseconds` or `current::time::DefaultTimeArgument`.
+  // The entry is serialized before the publishing mutex is locked, if it is to be locked here.
   template <current::locks::MutexLockStatus MLS, typename E, typename TIMESTAMP>
   idxts_t PersisterPublishImpl(E&& entry, const TIMESTAMP provided_timestamp) {
+    // Explicit `MakeSureTheRightTypeIsSerialized` is essential, otherwise the `Variant`'s case
+    // would be serialized in an unwrapped way when passed directly.
+    return PersisterPublishPayloadImpl<MLS>(
+        SerializeEntryPayload<FORMAT, ENTRY>(
+            MakeSureTheRightTypeIsSerialized<ENTRY, decay_t<E>>::DoIt(std::forward<E>(entry))),
+        provided_timestamp,
+        FileFormatImpl<FORMAT>::kBinaryPayloads);
+  }
+
+  // See `EntryPersister::PublishSerialized()`.
+  template <current::locks::MutexLockStatus MLS, typename TIMESTAMP>
+  idxts_t PersisterPublishSerializedImpl(const std::string& entry_json, const TIMESTAMP provided_timestamp) {
+    return PersisterPublishPayloadImpl<MLS>(entry_json, provided_timestamp, false);
+  }
+
+  template <current::locks::MutexLockStatus MLS, typename TIMESTAMP>
+  idxts_t PersisterPublishPayloadImpl(const std::string& payload, const TIMESTAMP provided_timestamp, bool binary) {
     current::locks::SmartMutexLockGuard<MLS> lock(file_persister_impl_->publish_mutex_ref_);
 
     end_t iterator = file_persister_impl_->end_.load();
@@ -451,20 +1388,16 @@ class FilePersister {
 
     iterator.last_entry_us = iterator.head = timestamp;
     const auto idxts = idxts_t(iterator.next_index, iterator.last_entry_us);
-    CURRENT_ASSERT(file_persister_impl_->record_offset_.size() == iterator.next_index);
-    CURRENT_ASSERT(file_persister_impl_->record_timestamp_.size() == iterator.next_index);
-    file_persister_impl_->record_offset_.push_back(file_persister_impl_->file_appender_.tellp());
-    file_persister_impl_->record_timestamp_.push_back(timestamp);
+    CURRENT_ASSERT(file_persister_impl_->record_index_.size() == iterator.next_index);
+    file_persister_impl_->record_index_.push_back(static_cast<uint64_t>(file_persister_impl_->file_appender_.tellp()),
+                                                  timestamp);
 
-    // Explicit `MakeSureTheRightTypeIsSerialized` is essential, otherwise the `Variant`'s case
-    // would be serialized in an unwrapped way when passed directly.
-    file_persister_impl_->file_appender_ << JSON(idxts) << '\t'
-                                         << JSON(MakeSureTheRightTypeIsSerialized<ENTRY, decay_t<E>>::DoIt(
-                                                std::forward<E>(entry)))
-                                         << std::endl;
+    file_persister_impl_->OnAppended(
+        FileFormatImpl<FORMAT>::AppendEntry(file_persister_impl_->file_appender_, idxts, payload, binary));
     ++iterator.next_index;
     file_persister_impl_->head_offset_ = 0;
     file_persister_impl_->end_.store(iterator);
+    file_persister_impl_->OnPublished();
 
     return idxts;
   }
@@ -478,7 +1411,7 @@ class FilePersister {
     if (tab_pos == std::string::npos) {
       CURRENT_THROW(MalformedEntryException(raw_log_line));
     }
-    const idxts_t idxts = ParseJSON<idxts_t>(raw_log_line.substr(0, tab_pos));
+    const idxts_t idxts = ParseIdxTs(raw_log_line.data(), raw_log_line.data() + tab_pos);
     if (idxts.index != iterator.next_index) {
       CURRENT_THROW(UnsafePublishBadIndexTimestampException(iterator.next_index, idxts.index));
     }
@@ -487,19 +1420,88 @@ class FilePersister {
     }
 
     iterator.last_entry_us = iterator.head = idxts.us;
-    CURRENT_ASSERT(file_persister_impl_->record_offset_.size() == idxts.index);
-    CURRENT_ASSERT(file_persister_impl_->record_timestamp_.size() == idxts.index);
-    file_persister_impl_->record_offset_.push_back(file_persister_impl_->file_appender_.tellp());
-    file_persister_impl_->record_timestamp_.push_back(idxts.us);
+    CURRENT_ASSERT(file_persister_impl_->record_index_.size() == idxts.index);
+    file_persister_impl_->record_index_.push_back(static_cast<uint64_t>(file_persister_impl_->file_appender_.tellp()),
+                                                  idxts.us);
 
-    file_persister_impl_->file_appender_ << raw_log_line << std::endl;
+    file_persister_impl_->OnAppended(
+        FileFormatImpl<FORMAT>::AppendRawEntry(file_persister_impl_->file_appender_, raw_log_line, idxts, tab_pos));
     ++iterator.next_index;
     file_persister_impl_->head_offset_ = 0;
     file_persister_impl_->end_.store(iterator);
+    file_persister_impl_->OnPublished();
 
     return idxts;
   }
 
+  // See `EntryPersister::PublishRawEntries()`. All the lines are checked before any of them is written, so that a bad
+  // batch leaves the persister as it was. For `JSONLines` the batch is then written as is, with a single write.
+  template <current::locks::MutexLockStatus MLS>
+  idxts_t PersisterPublishRawEntriesImpl(std::string_view raw_entries) {
+    current::locks::SmartMutexLockGuard<MLS> lock(file_persister_impl_->publish_mutex_ref_);
+
+    struct RawLine {
+      size_t begin;
+      size_t length;
+      size_t tab_pos;
+      idxts_t idxts;
+    };
+    std::vector<RawLine> lines;
+    end_t iterator = file_persister_impl_->end_.load();
+    std::chrono::microseconds head = iterator.head;
+    size_t begin = 0u;
+    while (begin < raw_entries.length()) {
+      const size_t eol = raw_entries.find('\n', begin);
+      const std::string_view line = raw_entries.substr(begin, eol == std::string_view::npos ? eol : eol - begin);
+      const size_t tab_pos = line.find('\t');
+      if (eol == std::string_view::npos || tab_pos == std::string_view::npos) {
+        CURRENT_THROW(MalformedEntryException(std::string(line)));
+      }
+      const idxts_t idxts = ParseIdxTs(line.data(), line.data() + tab_pos);
+      const uint64_t expected_index = iterator.next_index + lines.size();
+      if (idxts.index != expected_index) {
+        CURRENT_THROW(UnsafePublishBadIndexTimestampException(expected_index, idxts.index));
+      }
+      if (!(idxts.us > head)) {
+        CURRENT_THROW(ss::InconsistentTimestampException(head + std::chrono::microseconds(1), idxts.us));
+      }
+      head = idxts.us;
+      lines.push_back(RawLine{begin, line.length(), tab_pos, idxts});
+      begin = eol + 1u;
+    }
+    if (lines.empty()) {
+      CURRENT_THROW(MalformedEntryException(std::string()));
+    }
+
+    auto& file_appender = file_persister_impl_->file_appender_;
+    CompactRecordIndex& record_index = file_persister_impl_->record_index_;
+    CURRENT_ASSERT(record_index.size() == iterator.next_index);
+    size_t bytes = 0u;
+    if constexpr (std::is_same_v<FORMAT, file_format::JSONLines>) {
+      const uint64_t offset = static_cast<uint64_t>(file_appender.tellp());
+      for (const RawLine& line : lines) {
+        record_index.push_back(offset + line.begin, line.idxts.us);
+      }
+      file_appender.write(raw_entries.data(), static_cast<std::streamsize>(raw_entries.length()));
+      bytes = raw_entries.length();
+    } else {
+      for (const RawLine& line : lines) {
+        record_index.push_back(static_cast<uint64_t>(file_appender.tellp()), line.idxts.us);
+        bytes += FileFormatImpl<FORMAT>::AppendRawEntry(
+            file_appender, std::string(raw_entries.substr(line.begin, line.length)), line.idxts, line.tab_pos);
+      }
+    }
+    file_persister_impl_->OnAppended(bytes);
+
+    iterator.next_index += lines.size();
+    iterator.last_entry_us = iterator.head = head;
+    file_persister_impl_->head_offset_ = 0;
+    file_persister_impl_->end_.store(iterator);
+    file_persister_impl_->OnPublished();
+
+    return lines.back().idxts;
+  }
+
   template <current::locks::MutexLockStatus MLS, typename TIMESTAMP>
   void PersisterUpdateHeadImpl(const TIMESTAMP provided_timestamp) {
     current::locks::SmartMutexLockGuard<MLS> lock(file_persister_impl_->publish_mutex_ref_);
@@ -512,18 +1514,39 @@ class FilePersister {
     iterator.head = timestamp;
     const auto head_str = Printf(constants::kHeadFormatString, static_cast<long long>(timestamp.count()));
     if (file_persister_impl_->head_offset_) {
+      // The `#head` directive being rewritten may still be in the buffer of the appender.
+      file_persister_impl_->FlushIfNeeded();
       auto& rewriter = file_persister_impl_->head_rewriter_;
       rewriter.seekp(file_persister_impl_->head_offset_, std::ios_base::beg);
       rewriter << head_str << std::endl;
+      file_persister_impl_->uncommitted_bytes_ += head_str.length() + 1;
     } else {
       auto& file_appender_ = file_persister_impl_->file_appender_;
       file_appender_ << constants::kHeadDirective << ' ';
       file_persister_impl_->head_offset_ = file_appender_.tellp();
-      file_appender_ << head_str << std::endl;
+      file_appender_ << head_str << '\n';
+      file_persister_impl_->OnAppended(strlen(constants::kHeadDirective) + 1 + head_str.length() + 1);
     }
     file_persister_impl_->end_.store(iterator);
   }
 
+  // Blocks until the entries up to and including `index` are durable, see `FileDurability`.
+  // Must not be called from under the publish mutex.
+  void PersisterWaitUntilDurableImpl(uint64_t index) const {
+    const FilePersisterImpl& impl = *file_persister_impl_;
+    if (!(index < impl.end_.load().next_index)) {
+      CURRENT_THROW(InvalidIterableRangeException());
+    }
+    if (!(index < impl.durable_size_.GetValue())) {
+      if (impl.durability_.policy == FileDurability::Policy::GroupCommit) {
+        impl.RequestGroupCommitCovering(index);
+        impl.durable_size_.Wait([index](uint64_t durable_size) { return index < durable_size; });
+      } else {
+        impl.Commit();
+      }
+    }
+  }
+
   template <current::locks::MutexLockStatus MLS>
   bool PersisterEmptyImpl() const {
     return !file_persister_impl_->end_.load().next_index;
@@ -564,27 +1587,27 @@ class FilePersister {
                                                                         std::chrono::microseconds till) const {
     std::pair<uint64_t, uint64_t> result{static_cast<uint64_t>(-1), static_cast<uint64_t>(-1)};
     current::locks::SmartMutexLockGuard<MLS> lock(file_persister_impl_->publish_mutex_ref_);
-    const auto begin_it =
-        std::lower_bound(file_persister_impl_->record_timestamp_.begin(),
-                         file_persister_impl_->record_timestamp_.end(),
-                         from,
-                         [](std::chrono::microseconds entry_t, std::chrono::microseconds t) { return entry_t < t; });
-    if (begin_it != file_persister_impl_->record_timestamp_.end()) {
-      result.first = std::distance(file_persister_impl_->record_timestamp_.begin(), begin_it);
+    const CompactRecordIndex& record_index = file_persister_impl_->record_index_;
+    const size_t begin = record_index.LowerBoundByTimestamp(from);
+    if (begin != record_index.size()) {
+      result.first = begin;
     }
     if (till.count() > 0) {
-      const auto end_it =
-          std::upper_bound(file_persister_impl_->record_timestamp_.begin(),
-                           file_persister_impl_->record_timestamp_.end(),
-                           till,
-                           [](std::chrono::microseconds t, std::chrono::microseconds entry_t) { return t < entry_t; });
-      if (end_it != file_persister_impl_->record_timestamp_.end()) {
-        result.second = std::distance(file_persister_impl_->record_timestamp_.begin(), end_it);
+      const size_t end = record_index.UpperBoundByTimestamp(till);
+      if (end != record_index.size()) {
+        result.second = end;
       }
     }
     return result;
   }
 
+  // The number of bytes appended to the file so far, including the ones not yet flushed.
+  template <current::locks::MutexLockStatus MLS>
+  uint64_t PersisterFileSizeImpl() const {
+    current::locks::SmartMutexLockGuard<MLS> lock(file_persister_impl_->publish_mutex_ref_);
+    return static_cast<uint64_t>(file_persister_impl_->file_appender_.tellp());
+  }
+
   using IterableRange = IterableRangeImpl<Iterator>;
   using IterableRangeUnsafe = IterableRangeImpl<IteratorUnsafe>;
 
@@ -608,6 +1631,51 @@ class FilePersister {
     return PersisterIterateImpl<MLS, IterableRangeUnsafe>(from, till);
   }
 
+  // The `JSONLines` file holds the entries exactly as they are served raw, so the runs of them between the directives
+  // are passed to `f` as spans of the memory-mapped file. The spans are capped in size, for `f` to be able to stop.
+  template <current::locks::MutexLockStatus MLS,
+            typename F,
+            typename T = FORMAT,
+            class = std::enable_if_t<std::is_same_v<T, file_format::JSONLines>>>
+  void PersisterIterateRawSpans(uint64_t begin_index, uint64_t end_index, F&& f) const {
+    const uint64_t current_size = file_persister_impl_->end_.load().next_index;
+    if (end_index == static_cast<uint64_t>(-1)) {
+      end_index = current_size;
+    }
+    if (end_index > current_size || end_index < begin_index) {
+      CURRENT_THROW(InvalidIterableRangeException());
+    }
+    if (begin_index == end_index) {
+      return;
+    }
+    const RangeInFile range = LocateRange<MLS>(begin_index, end_index, current_size);
+    const char* p = range.mapping->data() + range.begin_offset;
+    const char* const end = range.mapping->data() + range.end_offset;
+    const char* span_begin = p;
+    uint64_t index = begin_index;
+    uint64_t span_begin_index = index;
+    while (p < end) {
+      bool is_directive;
+      const char* const next = FileFormatImpl<FORMAT>::NextRecord(p, end, is_directive);
+      if (is_directive || static_cast<size_t>(next - span_begin) > constants::kMaxRawEntriesSpanSize) {
+        if (p != span_begin &&
+            !f(ss::RawEntriesSpan{span_begin, static_cast<size_t>(p - span_begin), span_begin_index, index})) {
+          return;
+        }
+        span_begin = is_directive ? next : p;
+        span_begin_index = index;
+      }
+      if (!is_directive) {
+        ++index;
+      }
+      p = next;
+    }
+    CURRENT_ASSERT(index == end_index);
+    if (p != span_begin) {
+      f(ss::RawEntriesSpan{span_begin, static_cast<size_t>(p - span_begin), span_begin_index, index});
+    }
+  }
+
  private:
   template <current::locks::MutexLockStatus MLS, typename ITERABLE>
   ITERABLE PersisterIterateImpl(uint64_t begin_index, uint64_t end_index) const {
@@ -620,21 +1688,47 @@ class FilePersister {
       CURRENT_THROW(InvalidIterableRangeException());
     }
     if (begin_index == end_index) {
-      return ITERABLE(file_persister_impl_, 0, 0, 0);  // OK, even for an empty persister, where 0 is an invalid index.
+      return ITERABLE(file_persister_impl_, nullptr, 0, 0, 0, 0);  // OK, even for an empty persister.
     }
     if (end_index < begin_index) {
       CURRENT_THROW(InvalidIterableRangeException());
     }
 
-    current::locks::SmartMutexLockGuard<MLS> lock(file_persister_impl_->publish_mutex_ref_);
-
-    // ">" is OK, as this call is multithreading-friendly, and more entries could have been added during this call.
-    CURRENT_ASSERT(file_persister_impl_->record_offset_.size() >= current_size);
-
+    const RangeInFile range = LocateRange<MLS>(begin_index, end_index, current_size);
     return ITERABLE(file_persister_impl_,
+                    range.mapping,
                     static_cast<size_t>(begin_index),
                     static_cast<size_t>(end_index),
-                    file_persister_impl_->record_offset_[static_cast<size_t>(begin_index)]);
+                    range.begin_offset,
+                    range.end_offset);
+  }
+
+  // Where the non-empty range of entries `[begin_index, end_index)` is in the file, along with the mapping covering it.
+  struct RangeInFile {
+    std::shared_ptr<const MemoryMappedFile> mapping;
+    size_t begin_offset;
+    size_t end_offset;
+  };
+
+  template <current::locks::MutexLockStatus MLS>
+  RangeInFile LocateRange(uint64_t begin_index, uint64_t end_index, uint64_t current_size) const {
+    current::locks::SmartMutexLockGuard<MLS> lock(file_persister_impl_->publish_mutex_ref_);
+
+    // ">" is OK, as this call is multithreading-friendly, and more entries could have been added during this call.
+    CURRENT_ASSERT(file_persister_impl_->record_index_.size() >= current_size);
+
+    // The iterators read the file directly, so the entries still buffered by the appender should be flushed first.
+    file_persister_impl_->FlushIfNeeded();
+
+    const CompactRecordIndex& record_index = file_persister_impl_->record_index_;
+    RangeInFile result;
+    result.begin_offset = static_cast<size_t>(record_index.Offset(static_cast<size_t>(begin_index)));
+    const uint64_t end_offset64 = end_index < record_index.size()
+                                      ? record_index.Offset(static_cast<size_t>(end_index))
+                                      : static_cast<uint64_t>(file_persister_impl_->file_appender_.tellp());
+    result.end_offset = static_cast<size_t>(end_offset64);
+    result.mapping = file_persister_impl_->MappingCovering(result.end_offset);
+    return result;
   }
 
   template <current::locks::MutexLockStatus MLS, typename ITERABLE>
@@ -647,7 +1741,7 @@ class FilePersister {
     if (index_range.first != static_cast<uint64_t>(-1)) {
       return PersisterIterateImpl<MLS, ITERABLE>(index_range.first, index_range.second);
     } else {  // No entries found in the requested range.
-      return ITERABLE(file_persister_impl_, 0, 0, 0);
+      return ITERABLE(file_persister_impl_, nullptr, 0, 0, 0, 0);
     }
   }
 
@@ -660,6 +1754,10 @@ class FilePersister {
 template <typename ENTRY>
 using File = ss::EntryPersister<impl::FilePersister<ENTRY>, ENTRY>;
 
+// Same as `File`, but keeps the entries in the binary framed format, see `file_format::Framed`.
+template <typename ENTRY>
+using FramedFile = ss::EntryPersister<impl::FilePersister<ENTRY, file_format::Framed>, ENTRY>;
+
 }  // namespace persistence
 }  // namespace current
 
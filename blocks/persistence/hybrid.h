@@ -0,0 +1,367 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// A persister that keeps all the entries in a file, via `FilePersister`, and the most recent ones also in memory,
+// as deserialized objects. The in-memory tail is bounded by the number of entries and, optionally, by the number
+// of bytes these entries take in the file, see `HybridMemoryTail`.
+//
+// The iterators serve each entry from the tail if it is still there, and from the file otherwise, so that the
+// subscribers keeping up with the stream neither read nor parse the file, while the historical replays still work.
+// The tail is empty at startup, and gets populated as the entries are published.
+//
+// NOTE: The "unsafe" iterators always read the file: the raw log lines are right there in it, while serializing
+// the entries from the tail back into JSON would only make them slower.
+
+#ifndef BLOCKS_PERSISTENCE_HYBRID_H
+#define BLOCKS_PERSISTENCE_HYBRID_H
+
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "file.h"
+
+namespace current {
+namespace persistence {
+
+// The bounds of the in-memory tail of `Hybrid`, the optional constructor argument following the file name.
+// The oldest entries are evicted from the tail as soon as it holds more than `max_entries`,
+// or, if `max_bytes` is not zero, as soon as these entries take more than `max_bytes` in the file.
+struct HybridMemoryTail {
+  size_t max_entries = 10000u;
+  size_t max_bytes = 0u;
+
+  static HybridMemoryTail Entries(size_t max_entries) {
+    HybridMemoryTail result;
+    result.max_entries = max_entries;
+    return result;
+  }
+  static HybridMemoryTail Bytes(size_t max_bytes, size_t max_entries = static_cast<size_t>(-1)) {
+    HybridMemoryTail result;
+    result.max_entries = max_entries;
+    result.max_bytes = max_bytes;
+    return result;
+  }
+};
+
+namespace impl {
+
+template <typename ENTRY, typename FORMAT = file_format::JSONLines>
+class HybridPersister {
+ public:
+  using file_persister_t = FilePersister<ENTRY, FORMAT>;
+
+ private:
+  struct TailEntry {
+    std::chrono::microseconds us;
+    std::shared_ptr<const ENTRY> entry;
+    size_t bytes;
+  };
+
+  struct Container {
+    std::mutex& publish_mutex_ref_;
+    file_persister_t file_;
+    const HybridMemoryTail limits_;
+
+    // Guarded by `tail_mutex_`, which is only locked after `publish_mutex_ref_`, or on its own.
+    // The tail holds the entries with indexes from `tail_begin_` to the size of the persister.
+    mutable std::mutex tail_mutex_;
+    std::deque<TailEntry> tail_;
+    uint64_t tail_begin_;
+    size_t tail_bytes_ = 0u;
+
+    Container(std::mutex& publish_mutex_ref,
+              const ss::StreamNamespaceName& namespace_name,
+              const std::string& filename,
+              HybridMemoryTail limits,
+              FileDurability durability,
+              FileIndexSidecar index_sidecar,
+              FileRecovery recovery)
+        : publish_mutex_ref_(publish_mutex_ref),
+          file_(publish_mutex_ref, namespace_name, filename, durability, index_sidecar, recovery),
+          limits_(limits),
+          tail_begin_(file_.template PersisterSizeImpl<current::locks::MutexLockStatus::NeedToLock>()) {}
+
+    // To be called with `publish_mutex_ref_` locked, right after the entry with the index `index` was published.
+    void AppendToTail(uint64_t index, std::chrono::microseconds us, std::shared_ptr<const ENTRY> entry, size_t bytes) {
+      std::lock_guard<std::mutex> lock(tail_mutex_);
+      if (index != tail_begin_ + tail_.size()) {
+        // Some entries have not made it into the tail, so it starts over.
+        tail_.clear();
+        tail_begin_ = index;
+        tail_bytes_ = 0u;
+      }
+      tail_.push_back(TailEntry{us, std::move(entry), bytes});
+      tail_bytes_ += bytes;
+      while (!tail_.empty() &&
+             (tail_.size() > limits_.max_entries || (limits_.max_bytes && tail_bytes_ > limits_.max_bytes))) {
+        tail_bytes_ -= tail_.front().bytes;
+        tail_.pop_front();
+        ++tail_begin_;
+      }
+    }
+
+    // Returns the entry with the index `index` if it is in the tail, or `nullptr` otherwise.
+    std::shared_ptr<const ENTRY> FromTail(uint64_t index, std::chrono::microseconds& us) const {
+      std::lock_guard<std::mutex> lock(tail_mutex_);
+      if (index >= tail_begin_ && index - tail_begin_ < tail_.size()) {
+        const TailEntry& e = tail_[static_cast<size_t>(index - tail_begin_)];
+        us = e.us;
+        return e.entry;
+      }
+      return nullptr;
+    }
+  };
+
+ public:
+  HybridPersister(std::mutex& publish_mutex_ref,
+                  const ss::StreamNamespaceName& namespace_name,
+                  const std::string& filename,
+                  HybridMemoryTail limits = HybridMemoryTail(),
+                  FileDurability durability = FileDurability(),
+                  FileIndexSidecar index_sidecar = FileIndexSidecar(),
+                  FileRecovery recovery = FileRecovery())
+      : container_(MakeOwned<Container>(
+            publish_mutex_ref, namespace_name, filename, limits, durability, index_sidecar, recovery)) {}
+
+  class Iterator final {
+   public:
+    // The entry is kept alive by `holder`, be it in the tail or just read from the file.
+    struct Entry {
+      std::shared_ptr<const ENTRY> holder;
+      const idxts_t idx_ts;
+      const ENTRY& entry;
+
+      Entry() = delete;
+      Entry(idxts_t idx_ts, std::shared_ptr<const ENTRY> input)
+          : holder(std::move(input)), idx_ts(idx_ts), entry(*holder) {}
+    };
+
+    Iterator(Borrowed<Container> container, uint64_t i, uint64_t end)
+        : container_(std::move(container)), i_(i), end_(end) {}
+
+    Iterator() = delete;
+    Iterator(const Iterator&) = delete;
+    Iterator(Iterator&&) = default;
+    Iterator& operator=(const Iterator&) = delete;
+    Iterator& operator=(Iterator&&) = default;
+
+    Entry operator*() const {
+      std::chrono::microseconds us;
+      std::shared_ptr<const ENTRY> entry = container_->FromTail(i_, us);
+      if (entry) {
+        return Entry(idxts_t(i_, us), std::move(entry));
+      }
+      // The file iterators walk the file forward, and each entry can only be requested from them once,
+      // so the range is re-created if the entry requested is not the next one for it.
+      // The entries evicted from the tail always form a prefix, so, normally, a range once created is walked through.
+      if (!file_iterator_ || file_index_ != i_) {
+        file_iterator_ = nullptr;
+        file_range_ = std::make_unique<typename file_persister_t::IterableRange>(
+            container_->file_.template PersisterIterate<current::locks::MutexLockStatus::NeedToLock>(i_, end_));
+        file_iterator_ = std::make_unique<typename file_persister_t::Iterator>(file_range_->begin());
+        file_index_ = i_;
+      }
+      auto file_entry = **file_iterator_;
+      ++(*file_iterator_);
+      ++file_index_;
+      return Entry(file_entry.idx_ts, std::make_shared<const ENTRY>(std::move(file_entry.entry)));
+    }
+
+    Iterator& operator++() {
+      ++i_;
+      return *this;
+    }
+    bool operator==(const Iterator& rhs) const { return i_ == rhs.i_; }
+    bool operator!=(const Iterator& rhs) const { return !operator==(rhs); }
+    operator bool() const { return container_; }
+
+   private:
+    Borrowed<Container> container_;
+    uint64_t i_;
+    uint64_t end_;
+    mutable std::unique_ptr<typename file_persister_t::IterableRange> file_range_;
+    mutable std::unique_ptr<typename file_persister_t::Iterator> file_iterator_;
+    mutable uint64_t file_index_ = 0u;
+  };
+
+  class IterableRange {
+   public:
+    IterableRange(Borrowed<Container> container, uint64_t begin, uint64_t end)
+        : container_(std::move(container)), begin_(begin), end_(end) {}
+
+    IterableRange(IterableRange&& rhs) : container_(std::move(rhs.container_)), begin_(rhs.begin_), end_(rhs.end_) {}
+
+    Iterator begin() const { return Iterator(container_, begin_, end_); }
+    Iterator end() const { return Iterator(container_, end_, end_); }
+    operator bool() const { return container_; }
+
+   private:
+    const Borrowed<Container> container_;
+    const uint64_t begin_;
+    const uint64_t end_;
+  };
+
+  using IterableRangeUnsafe = typename file_persister_t::IterableRangeUnsafe;
+
+  template <current::locks::MutexLockStatus MLS, typename E, typename TIMESTAMP>
+  idxts_t PersisterPublishImpl(E&& e, const TIMESTAMP user_timestamp) {
+    current::locks::SmartMutexLockGuard<MLS> lock(container_->publish_mutex_ref_);
+    constexpr auto kLocked = current::locks::MutexLockStatus::AlreadyLocked;
+    auto entry = std::make_shared<const ENTRY>(std::forward<E>(e));
+    const uint64_t file_size = container_->file_.template PersisterFileSizeImpl<kLocked>();
+    const idxts_t result = container_->file_.template PersisterPublishImpl<kLocked>(*entry, user_timestamp);
+    const uint64_t bytes = container_->file_.template PersisterFileSizeImpl<kLocked>() - file_size;
+    container_->AppendToTail(result.index, result.us, std::move(entry), static_cast<size_t>(bytes));
+    return result;
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  idxts_t PersisterPublishUnsafeImpl(const std::string& raw_log_line) {
+    current::locks::SmartMutexLockGuard<MLS> lock(container_->publish_mutex_ref_);
+    constexpr auto kLocked = current::locks::MutexLockStatus::AlreadyLocked;
+    const uint64_t file_size = container_->file_.template PersisterFileSizeImpl<kLocked>();
+    const idxts_t result = container_->file_.template PersisterPublishUnsafeImpl<kLocked>(raw_log_line);
+    const uint64_t bytes = container_->file_.template PersisterFileSizeImpl<kLocked>() - file_size;
+    std::shared_ptr<const ENTRY> entry;
+    try {
+      entry = std::make_shared<const ENTRY>(ParseJSON<ENTRY>(raw_log_line.substr(raw_log_line.find('\t') + 1)));
+    } catch (const current::Exception&) {
+      // The file persister does not validate the raw entries. This one is left for the file to serve.
+    }
+    if (entry) {
+      container_->AppendToTail(result.index, result.us, std::move(entry), static_cast<size_t>(bytes));
+    }
+    return result;
+  }
+
+  template <current::locks::MutexLockStatus MLS, typename TIMESTAMP>
+  void PersisterUpdateHeadImpl(const TIMESTAMP user_timestamp) {
+    container_->file_.template PersisterUpdateHeadImpl<MLS>(user_timestamp);
+  }
+
+  void PersisterWaitUntilDurableImpl(uint64_t index) const { container_->file_.PersisterWaitUntilDurableImpl(index); }
+
+  template <current::locks::MutexLockStatus MLS>
+  bool PersisterEmptyImpl() const {
+    return container_->file_.template PersisterEmptyImpl<MLS>();
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  uint64_t PersisterSizeImpl() const {
+    return container_->file_.template PersisterSizeImpl<MLS>();
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  idxts_t PersisterLastPublishedIndexAndTimestampImpl() const {
+    return container_->file_.template PersisterLastPublishedIndexAndTimestampImpl<MLS>();
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  head_optidxts_t PersisterHeadAndLastPublishedIndexAndTimestampImpl() const {
+    return container_->file_.template PersisterHeadAndLastPublishedIndexAndTimestampImpl<MLS>();
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  std::chrono::microseconds PersisterCurrentHeadImpl() const {
+    return container_->file_.template PersisterCurrentHeadImpl<MLS>();
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  std::pair<uint64_t, uint64_t> PersisterIndexRangeByTimestampRangeImpl(std::chrono::microseconds from,
+                                                                        std::chrono::microseconds till) const {
+    return container_->file_.template PersisterIndexRangeByTimestampRangeImpl<MLS>(from, till);
+  }
+
+  // The number of the most recent entries currently held in memory.
+  size_t MemoryTailSize() const {
+    std::lock_guard<std::mutex> lock(container_->tail_mutex_);
+    return container_->tail_.size();
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  IterableRange PersisterIterate(uint64_t begin, uint64_t end) const {
+    const uint64_t size = container_->file_.template PersisterSizeImpl<MLS>();
+    if (end == static_cast<uint64_t>(-1)) {
+      end = size;
+    }
+    if (end > size) {
+      CURRENT_THROW(InvalidIterableRangeException());
+    }
+    if (begin == end) {
+      return IterableRange(container_, 0, 0);
+    }
+    if (end < begin) {
+      CURRENT_THROW(InvalidIterableRangeException());
+    }
+    return IterableRange(container_, begin, end);
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  IterableRange PersisterIterate(std::chrono::microseconds from, std::chrono::microseconds till) const {
+    if (till.count() > 0 && till < from) {
+      CURRENT_THROW(InvalidIterableRangeException());
+    }
+    const auto index_range = PersisterIndexRangeByTimestampRangeImpl<MLS>(from, till);
+    if (index_range.first != static_cast<uint64_t>(-1)) {
+      return PersisterIterate<MLS>(index_range.first, index_range.second);
+    } else {  // No entries found in the requested range.
+      return IterableRange(container_, 0, 0);
+    }
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  IterableRangeUnsafe PersisterIterateUnsafe(uint64_t begin, uint64_t end) const {
+    return container_->file_.template PersisterIterateUnsafe<MLS>(begin, end);
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  IterableRangeUnsafe PersisterIterateUnsafe(std::chrono::microseconds from, std::chrono::microseconds till) const {
+    return container_->file_.template PersisterIterateUnsafe<MLS>(from, till);
+  }
+
+  template <current::locks::MutexLockStatus MLS,
+            typename F,
+            typename T = FORMAT,
+            class = std::enable_if_t<std::is_same_v<T, file_format::JSONLines>>>
+  void PersisterIterateRawSpans(uint64_t begin, uint64_t end, F&& f) const {
+    container_->file_.template PersisterIterateRawSpans<MLS>(begin, end, std::forward<F>(f));
+  }
+
+ private:
+  Owned<Container> container_;  // `Owned`, as iterators borrow it.
+};
+
+}  // namespace impl
+
+template <typename ENTRY>
+using Hybrid = ss::EntryPersister<impl::HybridPersister<ENTRY>, ENTRY>;
+
+template <typename ENTRY>
+using FramedHybrid = ss::EntryPersister<impl::HybridPersister<ENTRY, file_format::Framed>, ENTRY>;
+
+}  // namespace persistence
+}  // namespace current
+
+#endif  // BLOCKS_PERSISTENCE_HYBRID_H
@@ -0,0 +1,401 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// An in-memory persister with lock-free reads, a drop-in replacement for `Memory`.
+//
+// The entries are stored in chunks of geometrically growing sizes, the first one holding `kFirstChunkSize` entries,
+// and each next one holding twice as many as the previous one. The chunks are never reallocated, so the entries
+// never move once published. Publishing is serialized via `publish_mutex_ref`, the way `FilePersister` does it,
+// and each entry is made visible with a single release-store of the number of entries.
+// The readers, the iterators as well as `Size()`, `CurrentHead()`, `LastPublishedIndexAndTimestamp()` and the rest,
+// never lock: they acquire-load the number of entries, and only access the entries below it.
+// Iterators never outlive the persister.
+
+#ifndef BLOCKS_PERSISTENCE_LOCK_FREE_MEMORY_H
+#define BLOCKS_PERSISTENCE_LOCK_FREE_MEMORY_H
+
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+
+#ifdef CURRENT_WINDOWS
+#include <intrin.h>
+#endif  // CURRENT_WINDOWS
+
+#include "exceptions.h"
+
+#include "../ss/persister.h"
+#include "../ss/signature.h"
+
+#include "../../bricks/sync/locks.h"
+#include "../../bricks/sync/owned_borrowed.h"
+#include "../../bricks/time/chrono.h"
+
+namespace current {
+namespace persistence {
+
+namespace impl {
+
+template <typename ENTRY>
+class LockFreeMemoryPersister {
+ private:
+  struct Container {
+    using entry_t = std::pair<std::chrono::microseconds, ENTRY>;
+    using storage_t = typename std::aligned_storage<sizeof(entry_t), alignof(entry_t)>::type;
+
+    constexpr static size_t kFirstChunkSizeLog = 10u;
+    constexpr static uint64_t kFirstChunkSize = static_cast<uint64_t>(1u) << kFirstChunkSizeLog;
+    constexpr static size_t kMaxChunks = 64u - kFirstChunkSizeLog;
+
+    std::mutex& publish_mutex_ref_;  // Guards the publishers, the readers never lock it.
+
+    // The chunks are only allocated by the publisher, and only accessed by the readers below `size_`, so the
+    // release-store of `size_` by the publisher, and its acquire-load by the readers are what synchronizes them.
+    storage_t* chunks_[kMaxChunks] = {};
+    std::atomic<uint64_t> size_;
+    std::atomic<int64_t> head_;
+
+    explicit Container(std::mutex& publish_mutex_ref) : publish_mutex_ref_(publish_mutex_ref), size_(0u), head_(-1) {}
+
+    ~Container() {
+      const uint64_t size = size_.load();
+      for (uint64_t i = 0; i < size; ++i) {
+        At(i).~entry_t();
+      }
+      for (storage_t* chunk : chunks_) {
+        delete[] chunk;
+      }
+    }
+
+    // Entry `i` is the `i + kFirstChunkSize`-th one counting from `kFirstChunkSize`, so that the chunk it belongs to
+    // is given by the position of the highest set bit of this sum.
+    static size_t HighestBit(uint64_t x) {
+#ifdef CURRENT_WINDOWS
+      unsigned long result;
+      _BitScanReverse64(&result, x);
+      return static_cast<size_t>(result);
+#else
+      return static_cast<size_t>(63 - __builtin_clzll(x));
+#endif  // CURRENT_WINDOWS
+    }
+
+    storage_t& Slot(uint64_t i) const {
+      const uint64_t j = i + kFirstChunkSize;
+      const size_t chunk = HighestBit(j) - kFirstChunkSizeLog;
+      return chunks_[chunk][j - (kFirstChunkSize << chunk)];
+    }
+
+    const entry_t& At(uint64_t i) const { return *reinterpret_cast<const entry_t*>(&Slot(i)); }
+    entry_t& At(uint64_t i) { return *reinterpret_cast<entry_t*>(&Slot(i)); }
+
+    // To be called by the publisher, with `publish_mutex_ref_` locked. `i` is the current `size_`.
+    template <typename... ARGS>
+    void Emplace(uint64_t i, ARGS&&... args) {
+      const uint64_t j = i + kFirstChunkSize;
+      const size_t chunk = HighestBit(j) - kFirstChunkSizeLog;
+      if (!chunks_[chunk]) {
+        chunks_[chunk] = new storage_t[static_cast<size_t>(kFirstChunkSize << chunk)];
+      }
+      new (&chunks_[chunk][j - (kFirstChunkSize << chunk)]) entry_t(std::forward<ARGS>(args)...);
+    }
+
+    // The head is stored before the size, so that the head loaded after the size is never behind the last entry.
+    void Publish(uint64_t index, std::chrono::microseconds us) {
+      head_.store(us.count(), std::memory_order_relaxed);
+      size_.store(index + 1u, std::memory_order_release);
+    }
+
+    uint64_t Size() const { return size_.load(std::memory_order_acquire); }
+    std::chrono::microseconds Head() const { return std::chrono::microseconds(head_.load(std::memory_order_relaxed)); }
+  };
+
+ public:
+  LockFreeMemoryPersister(std::mutex& publish_mutex_ref, const ss::StreamNamespaceName&)
+      : container_(MakeOwned<Container>(publish_mutex_ref)) {}
+
+  class Iterator {
+   public:
+    Iterator(Borrowed<Container> container, uint64_t i) : container_(std::move(container)), i_(i) {}
+
+    struct Entry {
+      const idxts_t idx_ts;
+      const ENTRY& entry;
+
+      Entry() = delete;
+      Entry(uint64_t index, const std::pair<std::chrono::microseconds, ENTRY>& input)
+          : idx_ts(index, input.first), entry(input.second) {}
+    };
+
+    Iterator() = delete;
+    Iterator(const Iterator&) = delete;
+    Iterator(Iterator&& rhs) : container_(std::move(rhs.container_)), i_(rhs.i_) {}
+    Iterator& operator=(const Iterator&) = delete;
+    Iterator& operator=(Iterator&&) = default;
+
+    Entry operator*() const { return Entry(i_, container_->At(i_)); }
+    Iterator& operator++() {
+      ++i_;
+      return *this;
+    }
+    bool operator==(const Iterator& rhs) const { return i_ == rhs.i_; }
+    bool operator!=(const Iterator& rhs) const { return !operator==(rhs); }
+    operator bool() const { return container_; }
+
+   private:
+    mutable Borrowed<Container> container_;
+    uint64_t i_;
+  };
+
+  class IteratorUnsafe {
+   public:
+    IteratorUnsafe(Borrowed<Container> container, uint64_t i) : container_(std::move(container)), i_(i) {}
+
+    std::string operator*() const {
+      const auto& entry = container_->At(i_);
+      return JSON(idxts_t(i_, entry.first)) + '\t' + JSON(entry.second);
+    }
+    IteratorUnsafe& operator++() {
+      ++i_;
+      return *this;
+    }
+    bool operator==(const IteratorUnsafe& rhs) const { return i_ == rhs.i_; }
+    bool operator!=(const IteratorUnsafe& rhs) const { return !operator==(rhs); }
+    operator bool() const { return container_; }
+
+   private:
+    mutable Borrowed<Container> container_;
+    uint64_t i_;
+  };
+
+  template <class ITERATOR>
+  class IterableRangeImpl {
+   public:
+    IterableRangeImpl(Borrowed<Container> container, uint64_t begin, uint64_t end)
+        : container_(std::move(container)), begin_(begin), end_(end) {}
+
+    IterableRangeImpl(IterableRangeImpl&& rhs)
+        : container_(std::move(rhs.container_)), begin_(rhs.begin_), end_(rhs.end_) {}
+
+    ITERATOR begin() const { return ITERATOR(container_, begin_); }
+    ITERATOR end() const { return ITERATOR(container_, end_); }
+    operator bool() const { return container_; }
+
+   private:
+    const Borrowed<Container> container_;
+    const uint64_t begin_;
+    const uint64_t end_;
+  };
+
+  template <current::locks::MutexLockStatus MLS, typename E, typename TIMESTAMP>
+  idxts_t PersisterPublishImpl(E&& entry, const TIMESTAMP user_timestamp) {
+    current::locks::SmartMutexLockGuard<MLS> lock(container_->publish_mutex_ref_);
+    const auto head = container_->Head();
+    const auto timestamp = current::time::TimestampAsMicroseconds(user_timestamp);
+    if (!(timestamp > head)) {
+      CURRENT_THROW(ss::InconsistentTimestampException(head + std::chrono::microseconds(1), timestamp));
+    }
+    const uint64_t index = container_->size_.load(std::memory_order_relaxed);
+    container_->Emplace(index, timestamp, std::forward<E>(entry));
+    container_->Publish(index, timestamp);
+    return idxts_t(index, timestamp);
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  idxts_t PersisterPublishUnsafeImpl(const std::string& raw_log_line) {
+    current::locks::SmartMutexLockGuard<MLS> lock(container_->publish_mutex_ref_);
+    const auto head = container_->Head();
+    const auto tab_pos = raw_log_line.find('\t');
+    if (tab_pos == std::string::npos) {
+      CURRENT_THROW(MalformedEntryException(raw_log_line));
+    }
+    const auto idxts = ParseJSON<idxts_t>(raw_log_line.substr(0, tab_pos));
+    const uint64_t expected_index = container_->size_.load(std::memory_order_relaxed);
+    if (idxts.index != expected_index) {
+      CURRENT_THROW(UnsafePublishBadIndexTimestampException(expected_index, idxts.index));
+    }
+    if (!(idxts.us > head)) {
+      CURRENT_THROW(ss::InconsistentTimestampException(head + std::chrono::microseconds(1), idxts.us));
+    }
+    container_->Emplace(expected_index, idxts.us, ParseJSON<ENTRY>(raw_log_line.substr(tab_pos + 1)));
+    container_->Publish(expected_index, idxts.us);
+    return idxts;
+  }
+
+  template <current::locks::MutexLockStatus MLS, typename TIMESTAMP>
+  void PersisterUpdateHeadImpl(const TIMESTAMP user_timestamp) {
+    current::locks::SmartMutexLockGuard<MLS> lock(container_->publish_mutex_ref_);
+    const auto timestamp = current::time::TimestampAsMicroseconds(user_timestamp);
+    const auto head = container_->Head();
+    if (!(timestamp > head)) {
+      CURRENT_THROW(ss::InconsistentTimestampException(head + std::chrono::microseconds(1), timestamp));
+    }
+    container_->head_.store(timestamp.count(), std::memory_order_release);
+  }
+
+  template <current::locks::MutexLockStatus>
+  bool PersisterEmptyImpl() const {
+    return !container_->Size();
+  }
+
+  template <current::locks::MutexLockStatus>
+  uint64_t PersisterSizeImpl() const {
+    return container_->Size();
+  }
+
+  template <current::locks::MutexLockStatus>
+  idxts_t PersisterLastPublishedIndexAndTimestampImpl() const {
+    const uint64_t size = container_->Size();
+    if (size) {
+      return idxts_t(size - 1u, container_->At(size - 1u).first);
+    } else {
+      CURRENT_THROW(NoEntriesPublishedYet());
+    }
+  }
+
+  template <current::locks::MutexLockStatus>
+  head_optidxts_t PersisterHeadAndLastPublishedIndexAndTimestampImpl() const {
+    const uint64_t size = container_->Size();
+    const auto head = container_->Head();
+    if (size) {
+      const auto last_entry_us = container_->At(size - 1u).first;
+      CURRENT_ASSERT(head >= last_entry_us);
+      return head_optidxts_t(head, size - 1u, last_entry_us);
+    } else {
+      return head_optidxts_t(head);
+    }
+  }
+
+  template <current::locks::MutexLockStatus>
+  std::chrono::microseconds PersisterCurrentHeadImpl() const {
+    return container_->Head();
+  }
+
+  template <current::locks::MutexLockStatus>
+  std::pair<uint64_t, uint64_t> PersisterIndexRangeByTimestampRangeImpl(std::chrono::microseconds from,
+                                                                        std::chrono::microseconds till) const {
+    std::pair<uint64_t, uint64_t> result{static_cast<uint64_t>(-1), static_cast<uint64_t>(-1)};
+    const uint64_t size = container_->Size();
+    const uint64_t begin = PartitionPoint(size, [from](std::chrono::microseconds t) { return t < from; });
+    if (begin != size) {
+      result.first = begin;
+    }
+    if (till.count() > 0) {
+      const uint64_t end = PartitionPoint(size, [till](std::chrono::microseconds t) { return t <= till; });
+      if (end != size) {
+        result.second = end;
+      }
+    }
+    return result;
+  }
+
+  using IterableRange = IterableRangeImpl<Iterator>;
+  using IterableRangeUnsafe = IterableRangeImpl<IteratorUnsafe>;
+
+  template <current::locks::MutexLockStatus MLS>
+  IterableRange PersisterIterate(uint64_t begin, uint64_t end) const {
+    return PersisterIterateImpl<MLS, IterableRange>(begin, end);
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  IterableRangeUnsafe PersisterIterateUnsafe(uint64_t begin, uint64_t end) const {
+    return PersisterIterateImpl<MLS, IterableRangeUnsafe>(begin, end);
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  IterableRange PersisterIterate(std::chrono::microseconds from, std::chrono::microseconds till) const {
+    return PersisterIterateImpl<MLS, IterableRange>(from, till);
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  IterableRangeUnsafe PersisterIterateUnsafe(std::chrono::microseconds from, std::chrono::microseconds till) const {
+    return PersisterIterateImpl<MLS, IterableRangeUnsafe>(from, till);
+  }
+
+ private:
+  // The index of the first entry for which `pred(timestamp)` is false, given the timestamps are increasing.
+  template <typename PRED>
+  uint64_t PartitionPoint(uint64_t size, PRED&& pred) const {
+    uint64_t begin = 0u;
+    uint64_t end = size;
+    while (begin < end) {
+      const uint64_t middle = begin + (end - begin) / 2u;
+      if (pred(container_->At(middle).first)) {
+        begin = middle + 1u;
+      } else {
+        end = middle;
+      }
+    }
+    return begin;
+  }
+
+  template <current::locks::MutexLockStatus, typename ITERABLE>
+  ITERABLE PersisterIterateImpl(uint64_t begin, uint64_t end) const {
+    const uint64_t size = container_->Size();
+
+    if (end == static_cast<uint64_t>(-1)) {
+      end = size;
+    }
+
+    if (end > size) {
+      CURRENT_THROW(InvalidIterableRangeException());
+    }
+    if (begin == end) {
+      return ITERABLE(container_, 0, 0);
+    }
+    if (begin >= size) {
+      CURRENT_THROW(InvalidIterableRangeException());
+    }
+    if (end < begin) {
+      CURRENT_THROW(InvalidIterableRangeException());
+    }
+
+    return ITERABLE(container_, begin, end);
+  }
+
+  template <current::locks::MutexLockStatus MLS, typename ITERABLE>
+  ITERABLE PersisterIterateImpl(std::chrono::microseconds from, std::chrono::microseconds till) const {
+    if (till.count() > 0 && till < from) {
+      CURRENT_THROW(InvalidIterableRangeException());
+    }
+    const auto index_range = PersisterIndexRangeByTimestampRangeImpl<MLS>(from, till);
+    if (index_range.first != static_cast<uint64_t>(-1)) {
+      return PersisterIterateImpl<MLS, ITERABLE>(index_range.first, index_range.second);
+    } else {  // No entries found in the given range.
+      return ITERABLE(container_, 0, 0);
+    }
+  }
+
+ private:
+  Owned<Container> container_;  // `Owned`, as iterators borrow it.
+};
+
+}  // namespace impl
+
+template <typename ENTRY>
+using LockFreeMemory = ss::EntryPersister<impl::LockFreeMemoryPersister<ENTRY>, ENTRY>;
+
+}  // namespace persistence
+}  // namespace current
+
+#endif  // BLOCKS_PERSISTENCE_LOCK_FREE_MEMORY_H
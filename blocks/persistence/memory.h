@@ -28,7 +28,7 @@ SOFTWARE.
 // and accesses this "deque" by indexes from under a mutex when iterating over the entries.
 // Iterators never outlive the persister.
 
-// NOTE(dkorolev): I took the liberty to use a dedicated `std::mutex` in `MemoryPersister`.
+// NOTE(dkorolev): I took the liberty to use a dedicated `std::shared_mutex` in `MemoryPersister`.
 // Rationale: While it's possible to optimize mutex usage for thread-safety, I've concluded
 // that's what `FilePersister` does. The `MemoryPersister` one is just for safe unit-testing;
 // its primary goal is to help find issues unrelated to the persister itself. Thus,
@@ -40,6 +40,7 @@ SOFTWARE.
 #include <deque>
 #include <functional>
 #include <mutex>
+#include <shared_mutex>
 
 #include "exceptions.h"
 
@@ -61,7 +62,8 @@ class MemoryPersister {
   struct Container {
     using entry_t = std::pair<std::chrono::microseconds, ENTRY>;
 
-    mutable std::mutex memory_persister_container_mutex_;
+    // Shared by the readers, so that the iterators and the accessors of the size and the head do not contend.
+    mutable std::shared_mutex memory_persister_container_mutex_;
     std::deque<entry_t> entries_;
     std::chrono::microseconds head_ = std::chrono::microseconds(-1);
 
@@ -94,7 +96,7 @@ class MemoryPersister {
     Iterator& operator=(Iterator&&) = default;
 
     Entry operator*() const {
-      std::lock_guard<std::mutex> lock(container_->memory_persister_container_mutex_);
+      std::shared_lock<std::shared_mutex> lock(container_->memory_persister_container_mutex_);
       return Entry(i_, container_->entries_[static_cast<size_t>(i_)]);
     }
     Iterator& operator++() {
@@ -115,7 +117,7 @@ class MemoryPersister {
     IteratorUnsafe(Borrowed<Container> container, uint64_t i) : container_(std::move(container)), i_(i) {}
 
     std::string operator*() const {
-      std::lock_guard<std::mutex> lock(container_->memory_persister_container_mutex_);
+      std::shared_lock<std::shared_mutex> lock(container_->memory_persister_container_mutex_);
       const auto& entry = container_->entries_[static_cast<size_t>(i_)];
       return JSON(idxts_t(i_, entry.first)) + '\t' + JSON(entry.second);
     }
@@ -153,7 +155,7 @@ class MemoryPersister {
 
   template <current::locks::MutexLockStatus MLS, typename E, typename TIMESTAMP>
   idxts_t PersisterPublishImpl(E&& entry, const TIMESTAMP user_timestamp) {
-    current::locks::SmartMutexLockGuard<MLS> lock(container_->memory_persister_container_mutex_);
+    current::locks::SmartMutexLockGuard<MLS, std::shared_mutex> lock(container_->memory_persister_container_mutex_);
     const auto head = container_->head_;
     const auto timestamp = current::time::TimestampAsMicroseconds(user_timestamp);
     if (!(timestamp > head)) {
@@ -168,7 +170,7 @@ class MemoryPersister {
 
   template <current::locks::MutexLockStatus MLS>
   idxts_t PersisterPublishUnsafeImpl(const std::string& raw_log_line) {
-    current::locks::SmartMutexLockGuard<MLS> lock(container_->memory_persister_container_mutex_);
+    current::locks::SmartMutexLockGuard<MLS, std::shared_mutex> lock(container_->memory_persister_container_mutex_);
     const auto head = container_->head_;
     const auto tab_pos = raw_log_line.find('\t');
     if (tab_pos == std::string::npos) {
@@ -190,7 +192,7 @@ class MemoryPersister {
 
   template <current::locks::MutexLockStatus MLS, typename TIMESTAMP>
   void PersisterUpdateHeadImpl(const TIMESTAMP user_timestamp) {
-    current::locks::SmartMutexLockGuard<MLS> lock(container_->memory_persister_container_mutex_);
+    current::locks::SmartMutexLockGuard<MLS, std::shared_mutex> lock(container_->memory_persister_container_mutex_);
 
     const auto timestamp = current::time::TimestampAsMicroseconds(user_timestamp);
     const auto head = container_->head_;
@@ -202,19 +204,19 @@ class MemoryPersister {
 
   template <current::locks::MutexLockStatus MLS>
   bool PersisterEmptyImpl() const {
-    current::locks::SmartMutexLockGuard<MLS> lock(container_->memory_persister_container_mutex_);
+    current::locks::SmartSharedMutexLockGuard<MLS> lock(container_->memory_persister_container_mutex_);
     return container_->entries_.empty();
   }
 
   template <current::locks::MutexLockStatus MLS>
   uint64_t PersisterSizeImpl() const {
-    current::locks::SmartMutexLockGuard<MLS> lock(container_->memory_persister_container_mutex_);
+    current::locks::SmartSharedMutexLockGuard<MLS> lock(container_->memory_persister_container_mutex_);
     return static_cast<uint64_t>(container_->entries_.size());
   }
 
   template <current::locks::MutexLockStatus MLS>
   idxts_t PersisterLastPublishedIndexAndTimestampImpl() const {
-    current::locks::SmartMutexLockGuard<MLS> lock(container_->memory_persister_container_mutex_);
+    current::locks::SmartSharedMutexLockGuard<MLS> lock(container_->memory_persister_container_mutex_);
     if (!container_->entries_.empty()) {
       CURRENT_ASSERT(container_->head_ >= container_->entries_.back().first);
       return idxts_t(container_->entries_.size() - 1, container_->entries_.back().first);
@@ -225,7 +227,7 @@ class MemoryPersister {
 
   template <current::locks::MutexLockStatus MLS>
   head_optidxts_t PersisterHeadAndLastPublishedIndexAndTimestampImpl() const {
-    current::locks::SmartMutexLockGuard<MLS> lock(container_->memory_persister_container_mutex_);
+    current::locks::SmartSharedMutexLockGuard<MLS> lock(container_->memory_persister_container_mutex_);
     if (!container_->entries_.empty()) {
       CURRENT_ASSERT(container_->head_ >= container_->entries_.back().first);
       return head_optidxts_t(container_->head_, container_->entries_.size() - 1, container_->entries_.back().first);
@@ -236,14 +238,14 @@ class MemoryPersister {
 
   template <current::locks::MutexLockStatus MLS>
   std::chrono::microseconds PersisterCurrentHeadImpl() const {
-    current::locks::SmartMutexLockGuard<MLS> lock(container_->memory_persister_container_mutex_);
+    current::locks::SmartSharedMutexLockGuard<MLS> lock(container_->memory_persister_container_mutex_);
     return container_->head_;
   }
 
   template <current::locks::MutexLockStatus MLS>
   std::pair<uint64_t, uint64_t> PersisterIndexRangeByTimestampRangeImpl(std::chrono::microseconds from,
                                                                         std::chrono::microseconds till) const {
-    current::locks::SmartMutexLockGuard<MLS> lock(container_->memory_persister_container_mutex_);
+    current::locks::SmartSharedMutexLockGuard<MLS> lock(container_->memory_persister_container_mutex_);
     std::pair<uint64_t, uint64_t> result{static_cast<uint64_t>(-1), static_cast<uint64_t>(-1)};
     const auto begin_it =
         std::lower_bound(container_->entries_.begin(),
@@ -293,7 +295,7 @@ class MemoryPersister {
   template <current::locks::MutexLockStatus MLS, typename ITERABLE>
   ITERABLE PersisterIterateImpl(uint64_t begin, uint64_t end) const {
     const uint64_t size = [this]() {
-      current::locks::SmartMutexLockGuard<MLS> lock(container_->memory_persister_container_mutex_);
+      current::locks::SmartSharedMutexLockGuard<MLS> lock(container_->memory_persister_container_mutex_);
       return static_cast<uint64_t>(container_->entries_.size());
     }();
 
@@ -0,0 +1,228 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// `CompactRecordIndex` is the in-memory index of the persisted records: the byte offset and the timestamp of each.
+//
+// Both the offsets and the timestamps are non-decreasing, so the index stores them as varint-encoded deltas,
+// a few bytes per record instead of the 24+ bytes of a `std::streampos` and a `std::chrono::microseconds`.
+// The records are grouped into blocks of `kBlockSize`. The sparse skip table keeps the first offset and timestamp
+// of each block along with where its deltas begin, so that:
+// * appending is O(1), amortized,
+// * accessing the record by index decodes at most `kBlockSize` deltas, and
+// * the lower and upper bounds by timestamp are a binary search over the skip table plus a scan of a single block.
+//
+// The deltas are stored in fixed-size pages, so that the index never gets reallocated and copied as a whole,
+// and so that each block is contiguous in memory.
+
+#ifndef BLOCKS_PERSISTENCE_RECORD_INDEX_H
+#define BLOCKS_PERSISTENCE_RECORD_INDEX_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../../port.h"
+
+namespace current {
+namespace persistence {
+namespace impl {
+
+class CompactRecordIndex final {
+ public:
+  constexpr static size_t kBlockSize = 64u;
+  constexpr static size_t kPageSize = 1u << 14;
+  // Two varints of up to ten bytes each per record, with the first record of each block kept in the skip table.
+  constexpr static size_t kMaxEncodedBlockSize = (kBlockSize - 1u) * 20u;
+  static_assert(kMaxEncodedBlockSize <= kPageSize, "");
+
+  void push_back(uint64_t offset, std::chrono::microseconds us) {
+    const int64_t us_count = us.count();
+    if (!(size_ % kBlockSize)) {
+      if (pages_.empty() || kPageSize - page_used_ < kMaxEncodedBlockSize) {
+        pages_.emplace_back(new uint8_t[kPageSize]);
+        page_used_ = 0u;
+      }
+      skip_.push_back(SkipEntry{offset, us_count, static_cast<uint32_t>(pages_.size() - 1u), page_used_});
+    } else {
+      CURRENT_ASSERT(offset >= last_offset_);
+      CURRENT_ASSERT(us_count >= last_us_);
+      uint8_t* page = pages_.back().get();
+      AppendVarint(page, offset - last_offset_);
+      AppendVarint(page, static_cast<uint64_t>(us_count - last_us_));
+    }
+    last_offset_ = offset;
+    last_us_ = us_count;
+    ++size_;
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return !size_; }
+
+  void clear() {
+    skip_.clear();
+    pages_.clear();
+    page_used_ = 0u;
+    size_ = 0u;
+    last_offset_ = 0u;
+    last_us_ = 0;
+  }
+
+  uint64_t Offset(size_t i) const {
+    uint64_t offset;
+    int64_t us;
+    Decode(i, offset, us);
+    return offset;
+  }
+
+  std::chrono::microseconds Timestamp(size_t i) const {
+    uint64_t offset;
+    int64_t us;
+    Decode(i, offset, us);
+    return std::chrono::microseconds(us);
+  }
+
+  uint64_t LastOffset() const {
+    CURRENT_ASSERT(size_);
+    return last_offset_;
+  }
+
+  std::chrono::microseconds LastTimestamp() const {
+    CURRENT_ASSERT(size_);
+    return std::chrono::microseconds(last_us_);
+  }
+
+  // Calls `f(offset, us)` for each record, in order, decoding each delta once.
+  template <typename F>
+  void ForEach(F&& f) const {
+    for (size_t block_index = 0; block_index < skip_.size(); ++block_index) {
+      const SkipEntry& block = skip_[block_index];
+      const size_t count = std::min(kBlockSize, size_ - block_index * kBlockSize);
+      const uint8_t* p = pages_[block.page].get() + block.position;
+      uint64_t offset = block.offset;
+      int64_t us = block.us;
+      f(offset, std::chrono::microseconds(us));
+      for (size_t k = 1u; k < count; ++k) {
+        offset += ReadVarint(p);
+        us += static_cast<int64_t>(ReadVarint(p));
+        f(offset, std::chrono::microseconds(us));
+      }
+    }
+  }
+
+  // The index of the first record with the timestamp not less than `us`, or `size()` if there is none.
+  size_t LowerBoundByTimestamp(std::chrono::microseconds us) const {
+    return PartitionPoint([us](int64_t t) { return t < us.count(); });
+  }
+
+  // The index of the first record with the timestamp greater than `us`, or `size()` if there is none.
+  size_t UpperBoundByTimestamp(std::chrono::microseconds us) const {
+    return PartitionPoint([us](int64_t t) { return t <= us.count(); });
+  }
+
+  // The number of bytes allocated, for the tests and for the curious.
+  size_t MemoryUsed() const {
+    return pages_.size() * kPageSize + skip_.capacity() * sizeof(SkipEntry) +
+           pages_.capacity() * sizeof(std::unique_ptr<uint8_t[]>);
+  }
+
+ private:
+  struct SkipEntry {
+    uint64_t offset;
+    int64_t us;
+    uint32_t page;
+    uint32_t position;
+  };
+
+  void AppendVarint(uint8_t* page, uint64_t value) {
+    while (value >= 0x80u) {
+      page[page_used_++] = static_cast<uint8_t>(value | 0x80u);
+      value >>= 7;
+    }
+    page[page_used_++] = static_cast<uint8_t>(value);
+  }
+
+  static uint64_t ReadVarint(const uint8_t*& p) {
+    uint64_t result = 0u;
+    int shift = 0;
+    while (*p & 0x80u) {
+      result |= static_cast<uint64_t>(*p++ & 0x7fu) << shift;
+      shift += 7;
+    }
+    result |= static_cast<uint64_t>(*p++) << shift;
+    return result;
+  }
+
+  void Decode(size_t i, uint64_t& offset, int64_t& us) const {
+    CURRENT_ASSERT(i < size_);
+    const SkipEntry& block = skip_[i / kBlockSize];
+    offset = block.offset;
+    us = block.us;
+    const uint8_t* p = pages_[block.page].get() + block.position;
+    for (size_t k = i % kBlockSize; k; --k) {
+      offset += ReadVarint(p);
+      us += static_cast<int64_t>(ReadVarint(p));
+    }
+  }
+
+  // Returns the index of the first record for which `pred(timestamp)` is false,
+  // given `pred` is true for some prefix of the records and false for the rest.
+  template <typename PRED>
+  size_t PartitionPoint(PRED&& pred) const {
+    const auto it =
+        std::partition_point(skip_.begin(), skip_.end(), [&pred](const SkipEntry& e) { return pred(e.us); });
+    if (it == skip_.begin()) {
+      return 0u;
+    }
+    // The answer is within the block preceding `it`, past its first record, or is the first record of `it`.
+    const size_t block_index = static_cast<size_t>(std::distance(skip_.begin(), it)) - 1u;
+    const SkipEntry& block = skip_[block_index];
+    const size_t begin = block_index * kBlockSize;
+    const size_t end = std::min(begin + kBlockSize, size_);
+    const uint8_t* p = pages_[block.page].get() + block.position;
+    int64_t us = block.us;
+    for (size_t i = begin + 1u; i < end; ++i) {
+      ReadVarint(p);
+      us += static_cast<int64_t>(ReadVarint(p));
+      if (!pred(us)) {
+        return i;
+      }
+    }
+    return end;
+  }
+
+  std::vector<SkipEntry> skip_;
+  std::vector<std::unique_ptr<uint8_t[]>> pages_;
+  uint32_t page_used_ = 0u;
+  size_t size_ = 0u;
+  uint64_t last_offset_ = 0u;
+  int64_t last_us_ = 0;
+};
+
+}  // namespace impl
+}  // namespace persistence
+}  // namespace current
+
+#endif  // BLOCKS_PERSISTENCE_RECORD_INDEX_H
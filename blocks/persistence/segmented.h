@@ -0,0 +1,1177 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// A file-based persister that keeps the stream in a directory of segments.
+// Each segment is a file in the format of `FilePersister`: it starts with the signature of the stream, and contains
+// the entries with their stream-wide indexes, so that each segment can be validated, backed up or replicated alone.
+// The active segment is appended to until it grows too large or spans too long a period of time, at which point it is
+// sealed, made read-only, and a new active segment is started. The oldest sealed segments can be dropped, or moved
+// into an archive directory, where they remain available to the iterators. The sealed segments can also be compressed,
+// in independently decompressible blocks, so that the iterators only decompress the blocks they need.
+// The list of segments is kept in the manifest, which is rewritten atomically whenever the segments change.
+// Iterators never outlive the persister.
+
+#ifndef BLOCKS_PERSISTENCE_SEGMENTED_H
+#define BLOCKS_PERSISTENCE_SEGMENTED_H
+
+#include <deque>
+#include <sstream>
+
+#ifndef CURRENT_WINDOWS
+#include <sys/stat.h>
+#endif  // CURRENT_WINDOWS
+
+#include "file.h"
+
+#include "../../bricks/util/lz.h"
+#include "../../typesystem/struct.h"
+
+namespace current {
+namespace persistence {
+
+// How the segmented file persister splits the stream into segments, and which sealed segments it retains.
+struct FileSegmentation {
+  // The active segment is sealed before publishing an entry once it has grown to at least `max_segment_bytes`,
+  // or once the entry would be `max_segment_duration` or more past the first entry of the segment.
+  uint64_t max_segment_bytes = 64ull << 20;
+  std::chrono::microseconds max_segment_duration = std::chrono::microseconds(0);  // Zero stands for no time bound.
+
+  // Once there are more than `max_sealed_segments` sealed segments in the directory of the stream, the oldest ones
+  // are moved into `archive_directory`, or dropped if it is empty. Zero stands for retaining all the segments.
+  uint64_t max_sealed_segments = 0u;
+  std::string archive_directory;
+
+  // If non-zero, the sealed segments are compressed, in blocks of about `compression_block_size` bytes each.
+  size_t compression_block_size = 0u;
+
+  static FileSegmentation BySize(uint64_t max_segment_bytes) {
+    FileSegmentation result;
+    result.max_segment_bytes = max_segment_bytes;
+    return result;
+  }
+  static FileSegmentation ByDuration(std::chrono::microseconds max_segment_duration) {
+    FileSegmentation result;
+    result.max_segment_duration = max_segment_duration;
+    return result;
+  }
+  FileSegmentation Retaining(uint64_t max_sealed_segments, const std::string& archive_directory = "") const {
+    FileSegmentation result = *this;
+    result.max_sealed_segments = max_sealed_segments;
+    result.archive_directory = archive_directory;
+    return result;
+  }
+  FileSegmentation Compressed(size_t compression_block_size = 256u << 10) const {
+    FileSegmentation result = *this;
+    result.compression_block_size = compression_block_size;
+    return result;
+  }
+};
+
+// The manifest of the segmented file persister, kept as JSON in `manifest.json` in the directory of the stream.
+CURRENT_STRUCT(SegmentedFileSegment) {
+  CURRENT_FIELD(name, std::string);
+  CURRENT_FIELD(begin_index, uint64_t, 0u);
+  // The fields below are only set for the sealed segments.
+  CURRENT_FIELD(end_index, uint64_t, 0u);
+  CURRENT_FIELD(head, std::chrono::microseconds, std::chrono::microseconds(-1));
+  CURRENT_FIELD(sealed, bool, false);
+  CURRENT_FIELD(archived, bool, false);
+  CURRENT_FIELD(compressed, bool, false);
+};
+
+CURRENT_STRUCT(SegmentedFileManifest) {
+  // Ordered by `begin_index`, the last one being the active segment.
+  CURRENT_FIELD(segments, std::vector<SegmentedFileSegment>);
+};
+
+namespace impl {
+
+namespace constants {
+constexpr char kSegmentedFileManifestName[] = "manifest.json";
+constexpr char kSegmentedFileManifestTmpName[] = "manifest.json.tmp";
+constexpr char kSegmentFileNameFormatString[] = "segment.%020lld";
+constexpr char kCompressedSegmentSuffix[] = ".lz";
+constexpr uint32_t kCompressedSegmentMagic = 0x535a4c43;  // "CLZS".
+// Per block: file offset (8) + compressed size (4) + raw size (4) + raw offset (8) + first index (8) + CRC32C (4).
+constexpr size_t kCompressedSegmentBlockInfoSize = 36;
+// Block index offset (8) + block count (4) + magic (4).
+constexpr size_t kCompressedSegmentTrailerSize = 16;
+}  // namespace constants
+
+// A compressed sealed segment: the blocks of the segment file, each compressed on its own, followed by the block index.
+// Each block holds whole records, `raw_offset` is where the block begins in the original segment file, and
+// `first_index` is the index of the first entry at or after `raw_offset`.
+struct CompressedSegmentBlock {
+  uint64_t file_offset;
+  uint32_t compressed_size;
+  uint32_t raw_size;
+  uint64_t raw_offset;
+  uint64_t first_index;
+  uint32_t crc;
+};
+
+class CompressedSegment final {
+ public:
+  // Loads the block index of the compressed segment file.
+  explicit CompressedSegment(const std::string& path) : mapping_(std::make_shared<const MemoryMappedFile>(path)) {
+    const char* data = mapping_->data();
+    const size_t size = mapping_->size();
+    if (size < constants::kCompressedSegmentTrailerSize) {
+      CURRENT_THROW(MalformedEntryException("Truncated compressed segment: `" + path + "`."));
+    }
+    uint64_t index_offset;
+    uint32_t count;
+    uint32_t magic;
+    const char* trailer = data + size - constants::kCompressedSegmentTrailerSize;
+    std::memcpy(&index_offset, trailer, sizeof(index_offset));
+    std::memcpy(&count, trailer + 8, sizeof(count));
+    std::memcpy(&magic, trailer + 12, sizeof(magic));
+    if (magic != constants::kCompressedSegmentMagic ||
+        index_offset + count * constants::kCompressedSegmentBlockInfoSize + constants::kCompressedSegmentTrailerSize !=
+            size) {
+      CURRENT_THROW(MalformedEntryException("Malformed compressed segment: `" + path + "`."));
+    }
+    blocks_.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+      const char* p = data + index_offset + i * constants::kCompressedSegmentBlockInfoSize;
+      CompressedSegmentBlock& block = blocks_[i];
+      std::memcpy(&block.file_offset, p, 8);
+      std::memcpy(&block.compressed_size, p + 8, 4);
+      std::memcpy(&block.raw_size, p + 12, 4);
+      std::memcpy(&block.raw_offset, p + 16, 8);
+      std::memcpy(&block.first_index, p + 24, 8);
+      std::memcpy(&block.crc, p + 32, 4);
+      if (block.file_offset + block.compressed_size > index_offset) {
+        CURRENT_THROW(MalformedEntryException("Malformed compressed segment: `" + path + "`."));
+      }
+    }
+  }
+
+  const std::vector<CompressedSegmentBlock>& blocks() const { return blocks_; }
+
+  // Returns the index of the block containing the byte at `raw_offset` of the original segment file.
+  size_t BlockOf(size_t raw_offset) const {
+    const auto it = std::upper_bound(
+        blocks_.begin(), blocks_.end(), raw_offset, [](size_t offset, const CompressedSegmentBlock& block) {
+          return offset < block.raw_offset;
+        });
+    CURRENT_ASSERT(it != blocks_.begin());
+    return static_cast<size_t>(std::distance(blocks_.begin(), it) - 1);
+  }
+
+  // NOTE: The checksum is only verified when `verify_checksum` is set, which is the case as the segment is replayed
+  // at startup. The decompression itself never reads or writes out of bounds, even if the block is corrupted.
+  void DecompressBlock(size_t i, std::string& output, bool verify_checksum = false) const {
+    const CompressedSegmentBlock& block = blocks_[i];
+    const char* data = mapping_->data() + block.file_offset;
+    if (verify_checksum && CRC32C(0, data, block.compressed_size) != block.crc) {
+      CURRENT_THROW(MalformedEntryException(current::strings::Printf(
+          "Compressed segment block checksum mismatch for index %lld.", static_cast<long long>(block.first_index))));
+    }
+    LZDecompressInto(data, block.compressed_size, block.raw_size, output);
+  }
+
+  // Decompresses the whole segment, verifying the checksums.
+  std::string Decompress() const {
+    std::string result;
+    std::string block;
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+      DecompressBlock(i, block, true);
+      result += block;
+    }
+    return result;
+  }
+
+  // Writes the compressed version of the segment file `raw` into `path`. The blocks are split at record boundaries.
+  template <typename FORMAT>
+  static void Write(const std::string& raw, uint64_t begin_index, size_t block_size, const std::string& path) {
+    std::ofstream fo(path, std::ofstream::binary | std::ofstream::trunc);
+    std::vector<CompressedSegmentBlock> blocks;
+    const char* const begin = raw.data();
+    const char* const end = begin + raw.length();
+    const char* block_begin = begin;
+    uint64_t index = begin_index;
+    uint64_t file_offset = 0u;
+    while (block_begin < end) {
+      CompressedSegmentBlock block;
+      block.raw_offset = static_cast<uint64_t>(block_begin - begin);
+      block.first_index = index;
+      const char* block_end = block_begin;
+      while (block_end < end && static_cast<size_t>(block_end - block_begin) < block_size) {
+        bool is_directive;
+        block_end = FileFormatImpl<FORMAT>::NextRecord(block_end, end, is_directive);
+        if (!is_directive) {
+          ++index;
+        }
+      }
+      const std::string compressed = LZCompress(block_begin, static_cast<size_t>(block_end - block_begin));
+      block.file_offset = file_offset;
+      block.compressed_size = static_cast<uint32_t>(compressed.length());
+      block.raw_size = static_cast<uint32_t>(block_end - block_begin);
+      block.crc = CRC32C(0, compressed.data(), compressed.length());
+      fo.write(compressed.data(), compressed.length());
+      file_offset += compressed.length();
+      blocks.push_back(block);
+      block_begin = block_end;
+    }
+    for (const auto& block : blocks) {
+      char p[constants::kCompressedSegmentBlockInfoSize];
+      std::memcpy(p, &block.file_offset, 8);
+      std::memcpy(p + 8, &block.compressed_size, 4);
+      std::memcpy(p + 12, &block.raw_size, 4);
+      std::memcpy(p + 16, &block.raw_offset, 8);
+      std::memcpy(p + 24, &block.first_index, 8);
+      std::memcpy(p + 32, &block.crc, 4);
+      fo.write(p, sizeof(p));
+    }
+    char trailer[constants::kCompressedSegmentTrailerSize];
+    const uint32_t count = static_cast<uint32_t>(blocks.size());
+    std::memcpy(trailer, &file_offset, 8);
+    std::memcpy(trailer + 8, &count, 4);
+    std::memcpy(trailer + 12, &constants::kCompressedSegmentMagic, 4);
+    fo.write(trailer, sizeof(trailer));
+    fo.close();
+    if (fo.fail()) {
+      CURRENT_THROW(PersistenceFileNotWritable(path));
+    }
+  }
+
+ private:
+  std::shared_ptr<const MemoryMappedFile> mapping_;
+  std::vector<CompressedSegmentBlock> blocks_;
+};
+
+// The implementation of a persister appending to the active segment file, and reading via the memory mappings
+// of the segment files.
+template <typename ENTRY, typename FORMAT = file_format::JSONLines>
+class SegmentedFilePersister {
+ protected:
+  // { last_published_index + 1, last_published_us, current_head_us }, or { 0, -1us, -1us } for an empty persister.
+  struct end_t {
+    uint64_t next_index;
+    std::chrono::microseconds last_entry_us;
+    std::chrono::microseconds head;
+  };
+
+ private:
+  struct Segment final {
+    SegmentedFileSegment info;
+    std::string path;
+    size_t size = 0u;  // The size of the original, uncompressed, segment file.
+    mutable std::shared_ptr<const MemoryMappedFile> mapping;
+    std::shared_ptr<const CompressedSegment> compressed;  // Set for the compressed segments instead of `mapping`.
+
+    // Returns the shared mapping of the segment covering at least its first `bytes`, see `FilePersister`.
+    std::shared_ptr<const MemoryMappedFile> MappingCovering(size_t bytes) const {
+      if (!mapping || mapping->live_size() < bytes) {
+        if (info.sealed) {
+          mapping = std::make_shared<const MemoryMappedFile>(path);
+        } else {
+          size_t mapping_size = constants::kMinFileMappingSize;
+          while (mapping_size < bytes) {
+            mapping_size *= 2u;
+          }
+          mapping = std::make_shared<const MemoryMappedFile>(path, mapping_size);
+        }
+      }
+      return mapping;
+    }
+  };
+
+  struct SegmentedFilePersisterImpl final {
+    const std::string directory_;
+    const FileSegmentation segmentation_;
+    const std::string signature_;
+
+    std::mutex& publish_mutex_ref_;  // Guards everything below except `end_`.
+
+    // Never empty, the last segment is the active one. The segments dropped by retention are removed from the front.
+    std::deque<Segment> segments_;
+    // For the entries starting from `segments_.front().info.begin_index`: the offset where the entry begins
+    // within its segment, and its timestamp.
+    std::deque<size_t> record_offset_;
+    std::deque<std::chrono::microseconds> record_timestamp_;
+
+    // The active segment.
+    std::ofstream segment_appender_;
+    std::fstream head_rewriter_;
+    std::streampos head_offset_;
+    int sync_fd_ = -1;
+
+    current::atomic_that_works<end_t> end_;
+
+    SegmentedFilePersisterImpl() = delete;
+    SegmentedFilePersisterImpl(const SegmentedFilePersisterImpl&) = delete;
+    SegmentedFilePersisterImpl(SegmentedFilePersisterImpl&&) = delete;
+    SegmentedFilePersisterImpl& operator=(const SegmentedFilePersisterImpl&) = delete;
+    SegmentedFilePersisterImpl& operator=(SegmentedFilePersisterImpl&&) = delete;
+
+    SegmentedFilePersisterImpl(std::mutex& publish_mutex_ref,
+                               const ss::StreamNamespaceName& namespace_name,
+                               const std::string& directory,
+                               FileSegmentation segmentation)
+        : directory_(directory),
+          segmentation_(std::move(segmentation)),
+          signature_(Signature(namespace_name)),
+          publish_mutex_ref_(publish_mutex_ref),
+          head_offset_(0) {
+      FileSystem::MkDir(directory_, FileSystem::MkDirParameters::Silent);
+      if (!segmentation_.archive_directory.empty()) {
+        FileSystem::MkDir(segmentation_.archive_directory, FileSystem::MkDirParameters::Silent);
+      }
+      LoadManifestAndReplaySegments();
+      OpenActiveSegment();
+    }
+
+    ~SegmentedFilePersisterImpl() { CloseActiveSegment(); }
+
+    static std::string Signature(const ss::StreamNamespaceName& namespace_name) {
+      reflection::StructSchema struct_schema;
+      struct_schema.AddType<ENTRY>();
+      return JSON(ss::StreamSignature(namespace_name, struct_schema.GetSchemaInfo()));
+    }
+
+    uint64_t FirstIndex() const { return segments_.front().info.begin_index; }
+
+    std::string ManifestPath() const { return FileSystem::JoinPath(directory_, constants::kSegmentedFileManifestName); }
+
+    void SaveManifest() const {
+      SegmentedFileManifest manifest;
+      for (const auto& segment : segments_) {
+        manifest.segments.push_back(segment.info);
+      }
+      // Write the new manifest next to the current one and rename it over, so that the manifest is always valid.
+      const std::string tmp_path = FileSystem::JoinPath(directory_, constants::kSegmentedFileManifestTmpName);
+      FileSystem::WriteStringToFile(JSON(manifest), tmp_path.c_str());
+      FileSystem::RenameFile(tmp_path, ManifestPath());
+    }
+
+    // The segment file is looked up in the archive directory as well, since the process could have been stopped
+    // after the file was moved there, but before the manifest was updated.
+    std::string SegmentPath(const SegmentedFileSegment& info) const {
+      const std::string file_name = SegmentFileName(info);
+      const std::string primary_path = FileSystem::JoinPath(directory_, file_name);
+      if (segmentation_.archive_directory.empty()) {
+        return primary_path;
+      }
+      const std::string archived_path = FileSystem::JoinPath(segmentation_.archive_directory, file_name);
+      if (info.archived) {
+        return archived_path;
+      }
+      std::ifstream fi(primary_path);
+      return (fi.good() || !std::ifstream(archived_path).good()) ? primary_path : archived_path;
+    }
+
+    static std::string SegmentFileName(const SegmentedFileSegment& info) {
+      return info.compressed ? info.name + constants::kCompressedSegmentSuffix : info.name;
+    }
+
+    void LoadManifestAndReplaySegments() {
+      SegmentedFileManifest manifest;
+      try {
+        manifest = ParseJSON<SegmentedFileManifest>(FileSystem::ReadFileAsString(ManifestPath()));
+      } catch (const FileException&) {
+        // No manifest yet, a new stream.
+      } catch (const TypeSystemParseJSONException&) {
+        CURRENT_THROW(InvalidSegmentedFileManifest(ManifestPath()));
+      }
+      if (manifest.segments.empty()) {
+        SegmentedFileSegment info;
+        info.name = SegmentName(0u);
+        manifest.segments.push_back(info);
+      }
+
+      end_t end{0u, std::chrono::microseconds(-1), std::chrono::microseconds(-1)};
+      end.next_index = manifest.segments.front().begin_index;
+      for (size_t i = 0; i < manifest.segments.size(); ++i) {
+        const auto& info = manifest.segments[i];
+        // Only the last segment is the active one, and the segments must follow each other with no gaps.
+        if (info.sealed != (i + 1 < manifest.segments.size()) || info.begin_index != end.next_index) {
+          CURRENT_THROW(InvalidSegmentedFileManifest(ManifestPath()));
+        }
+        segments_.emplace_back();
+        Segment& segment = segments_.back();
+        segment.info = info;
+        segment.path = SegmentPath(info);
+        ReplaySegment(segment, end);
+        if (info.sealed) {
+          if (end.next_index != info.end_index) {
+            CURRENT_THROW(InvalidSegmentedFileManifest(ManifestPath()));
+          }
+          if (info.head > end.head) {
+            end.head = info.head;
+          }
+        }
+      }
+      end_.store(end);
+      SaveManifest();
+    }
+
+    // Replays the segment file, validating it, and extending `record_offset_`, `record_timestamp_`, and `end`.
+    // The active segment file may not exist yet.
+    void ReplaySegment(Segment& segment, end_t& end) {
+      if (segment.info.compressed) {
+        segment.compressed = std::make_shared<const CompressedSegment>(segment.path);
+        std::istringstream is(segment.compressed->Decompress());
+        ReplaySegment(segment, end, is);
+      } else {
+        std::ifstream fi(segment.path, std::ifstream::in | FileFormatImpl<FORMAT>::kOpenMode);
+        if (!fi.good()) {
+          if (segment.info.sealed) {
+            CURRENT_THROW(CannotReadFileException(segment.path));
+          }
+          return;
+        }
+        ReplaySegment(segment, end, fi);
+      }
+    }
+
+    void ReplaySegment(Segment& segment, end_t& end, std::istream& fi) {
+      const bool is_active = !segment.info.sealed;
+      IteratorOverFileOfPersistedEntries<ENTRY, FORMAT> cit(fi, 0, segment.info.begin_index);
+      const std::streampos offset_zero(0);
+      std::streampos current_offset = offset_zero;
+      while (cit.ProcessNextEntry(
+          [&](const idxts_t& current, const char*) {
+            if (!(current.us > end.head)) {
+              CURRENT_THROW(ss::InconsistentTimestampException(end.head + std::chrono::microseconds(1), current.us));
+            }
+            record_offset_.push_back(static_cast<size_t>(current_offset));
+            record_timestamp_.push_back(current.us);
+            end.next_index = current.index + 1u;
+            end.last_entry_us = end.head = current.us;
+            current_offset = fi.tellg();
+            if (is_active) {
+              head_offset_ = 0;
+            }
+          },
+          [&](const std::string& value) {
+            static const auto head_key_length = strlen(constants::kHeadDirective);
+            static const auto signature_key_length = strlen(constants::kSignatureDirective);
+            if (!value.compare(0, head_key_length, constants::kHeadDirective)) {
+              auto offset = head_key_length;
+              while (std::isspace(value[offset])) {
+                ++offset;
+              }
+              const auto us = std::chrono::microseconds(current::FromString<head_value_t>(value.c_str() + offset));
+              if (!(us > end.head)) {
+                CURRENT_THROW(ss::InconsistentTimestampException(end.head + std::chrono::microseconds(1), us));
+              }
+              end.head = us;
+              if (is_active) {
+                head_offset_ = std::streampos(static_cast<size_t>(current_offset) + offset);
+              }
+            } else if (!value.compare(0, signature_key_length, constants::kSignatureDirective)) {
+              // The signature, if present, should be at the beginning of the segment.
+              if (current_offset != offset_zero) {
+                CURRENT_THROW(InvalidSignatureLocation());
+              }
+              auto offset = signature_key_length;
+              while (std::isspace(value[offset])) {
+                ++offset;
+              }
+              if (value.compare(offset, signature_.length(), signature_)) {
+                CURRENT_THROW(InvalidStreamSignature(signature_, value.substr(offset)));
+              }
+            }
+            current_offset = fi.tellg();
+          })) {
+        ;
+      }
+      segment.size = static_cast<size_t>(current_offset);
+    }
+
+    static std::string SegmentName(uint64_t begin_index) {
+      return Printf(constants::kSegmentFileNameFormatString, static_cast<long long>(begin_index));
+    }
+
+    void OpenActiveSegment() {
+      Segment& segment = segments_.back();
+      segment_appender_.open(segment.path, std::ofstream::app | std::ofstream::ate | FileFormatImpl<FORMAT>::kOpenMode);
+      if (!segment.size) {
+        segment_appender_ << constants::kSignatureDirective << ' ' << signature_ << std::endl;
+        segment.size = static_cast<size_t>(segment_appender_.tellp());
+      }
+      head_rewriter_.open(segment.path, std::ofstream::in | std::ofstream::out | FileFormatImpl<FORMAT>::kOpenMode);
+      if (segment_appender_.bad() || head_rewriter_.bad()) {
+        CURRENT_THROW(PersistenceFileNotWritable(segment.path));
+      }
+#ifndef CURRENT_WINDOWS
+      sync_fd_ = ::open(segment.path.c_str(), O_WRONLY);
+      if (sync_fd_ < 0) {
+        CURRENT_THROW(PersistenceFileNotWritable(segment.path));
+      }
+#endif  // CURRENT_WINDOWS
+    }
+
+    void CloseActiveSegment() {
+      SyncActiveSegment();
+      segment_appender_.close();
+      head_rewriter_.close();
+#ifndef CURRENT_WINDOWS
+      if (sync_fd_ >= 0) {
+        ::close(sync_fd_);
+        sync_fd_ = -1;
+      }
+#endif  // CURRENT_WINDOWS
+    }
+
+    void SyncActiveSegment() const {
+#ifndef CURRENT_WINDOWS
+      if (sync_fd_ >= 0) {
+#ifdef CURRENT_APPLE
+        ::fsync(sync_fd_);
+#else
+        ::fdatasync(sync_fd_);
+#endif  // CURRENT_APPLE
+      }
+#endif  // CURRENT_WINDOWS
+    }
+
+    // To be called with `publish_mutex_ref_` locked, before publishing the entry with the timestamp `us`.
+    void RotateIfNeeded(std::chrono::microseconds us) {
+      const Segment& active = segments_.back();
+      if (end_.load().next_index == active.info.begin_index) {
+        return;  // Never seal an empty segment.
+      }
+      const auto first_us = record_timestamp_[static_cast<size_t>(active.info.begin_index - FirstIndex())];
+      if (active.size >= segmentation_.max_segment_bytes ||
+          (segmentation_.max_segment_duration.count() > 0 && us - first_us >= segmentation_.max_segment_duration)) {
+        Rotate();
+      }
+    }
+
+    // Seals the active segment, starts the new one, and applies the retention policy.
+    void Rotate() {
+      CloseActiveSegment();
+      const end_t end = end_.load();
+      {
+        Segment& sealed = segments_.back();
+        sealed.info.sealed = true;
+        sealed.info.end_index = end.next_index;
+        sealed.info.head = end.head;
+#ifndef CURRENT_WINDOWS
+        ::chmod(sealed.path.c_str(), S_IRUSR | S_IRGRP | S_IROTH);
+#endif  // CURRENT_WINDOWS
+      }
+      std::vector<std::string> files_to_drop;
+      if (segmentation_.compression_block_size) {
+        // The original segment file is removed once the manifest refers to the compressed one.
+        files_to_drop.push_back(segments_.back().path);
+        CompressSegment(segments_.back());
+      }
+      {
+        segments_.emplace_back();
+        Segment& active = segments_.back();
+        active.info.name = SegmentName(end.next_index);
+        active.info.begin_index = end.next_index;
+        active.path = FileSystem::JoinPath(directory_, active.info.name);
+      }
+
+      // The files are moved into the archive before the manifest is updated, and dropped after it is updated,
+      // so that the manifest never refers to the segments that are gone.
+      size_t sealed_segments_in_directory = 0u;
+      for (const auto& segment : segments_) {
+        if (segment.info.sealed && !segment.info.archived) {
+          ++sealed_segments_in_directory;
+        }
+      }
+      if (segmentation_.max_sealed_segments) {
+        while (sealed_segments_in_directory > segmentation_.max_sealed_segments) {
+          if (segmentation_.archive_directory.empty()) {
+            Segment& dropped = segments_.front();
+            const size_t count = static_cast<size_t>(dropped.info.end_index - dropped.info.begin_index);
+            record_offset_.erase(record_offset_.begin(), record_offset_.begin() + count);
+            record_timestamp_.erase(record_timestamp_.begin(), record_timestamp_.begin() + count);
+            files_to_drop.push_back(dropped.path);
+            segments_.pop_front();
+          } else {
+            for (auto& segment : segments_) {
+              if (!segment.info.archived) {
+                ArchiveSegment(segment);
+                break;
+              }
+            }
+          }
+          --sealed_segments_in_directory;
+        }
+      }
+
+      SaveManifest();
+      for (const auto& file : files_to_drop) {
+        FileSystem::RmFile(file, FileSystem::RmFileParameters::Silent);
+      }
+      head_offset_ = 0;
+      OpenActiveSegment();
+    }
+
+    // Compresses the sealed segment. Done synchronously, as part of sealing the segment, so the block size should be
+    // chosen with the size of the segments in mind.
+    void CompressSegment(Segment& segment) {
+      SegmentedFileSegment info = segment.info;
+      info.compressed = true;
+      const std::string compressed_path = FileSystem::JoinPath(directory_, SegmentFileName(info));
+      CompressedSegment::Write<FORMAT>(FileSystem::ReadFileAsString(segment.path),
+                                       info.begin_index,
+                                       segmentation_.compression_block_size,
+                                       compressed_path);
+#ifndef CURRENT_WINDOWS
+      ::chmod(compressed_path.c_str(), S_IRUSR | S_IRGRP | S_IROTH);
+#endif  // CURRENT_WINDOWS
+      // The iterators created before keep using the mapping of the original segment file.
+      segment.compressed = std::make_shared<const CompressedSegment>(compressed_path);
+      segment.mapping = nullptr;
+      segment.info = info;
+      segment.path = compressed_path;
+    }
+
+    void ArchiveSegment(Segment& segment) {
+      const std::string archived_path =
+          FileSystem::JoinPath(segmentation_.archive_directory, SegmentFileName(segment.info));
+      try {
+        FileSystem::RenameFile(segment.path, archived_path);
+      } catch (const FileException&) {
+        // The archive directory may well be on a different device.
+        FileSystem::WriteStringToFile(FileSystem::ReadFileAsString(segment.path), archived_path.c_str());
+#ifndef CURRENT_WINDOWS
+        ::chmod(archived_path.c_str(), S_IRUSR | S_IRGRP | S_IROTH);
+#endif  // CURRENT_WINDOWS
+        FileSystem::RmFile(segment.path);
+      }
+      // The iterators created before keep using the existing mapping, which remains valid.
+      segment.info.archived = true;
+      segment.path = archived_path;
+    }
+
+    // Returns the segment containing the entry with the index `index`, for `FirstIndex() <= index < next_index`.
+    const Segment& SegmentOf(uint64_t index) const {
+      const auto it = std::upper_bound(segments_.begin(), segments_.end(), index, [](uint64_t i, const Segment& s) {
+        return i < s.info.begin_index;
+      });
+      CURRENT_ASSERT(it != segments_.begin());
+      return *std::prev(it);
+    }
+  };
+
+ public:
+  SegmentedFilePersister() = delete;
+  SegmentedFilePersister(const SegmentedFilePersister&) = delete;
+  SegmentedFilePersister(SegmentedFilePersister&&) = delete;
+  SegmentedFilePersister& operator=(const SegmentedFilePersister&) = delete;
+  SegmentedFilePersister& operator=(SegmentedFilePersister&&) = delete;
+
+  SegmentedFilePersister(std::mutex& publish_mutex_ref,
+                         const ss::StreamNamespaceName& namespace_name,
+                         const std::string& directory,
+                         FileSegmentation segmentation = FileSegmentation())
+      : impl_(MakeOwned<SegmentedFilePersisterImpl>(publish_mutex_ref, namespace_name, directory, segmentation)) {}
+
+  // A contiguous range of the entries within one segment, along with the mapping of that segment.
+  // For the compressed segments, a chunk never spans more than one block, and the offsets are within the block.
+  struct Chunk {
+    std::shared_ptr<const MemoryMappedFile> mapping;
+    std::shared_ptr<const CompressedSegment> compressed;
+    size_t block;
+    uint64_t begin_index;
+    size_t begin_offset;
+    size_t end_offset;
+  };
+  using chunks_t = std::vector<Chunk>;
+
+  // The iterators walk the chunks of the range sequentially, see `FilePersister::IteratorBase`,
+  // jumping directly to the chunk containing the requested entry.
+  class IteratorBase {
+   public:
+    IteratorBase(Borrowed<SegmentedFilePersisterImpl> impl, std::shared_ptr<const chunks_t> chunks, uint64_t i)
+        : impl_(std::move(impl)), chunks_(std::move(chunks)), i_(i), chunk_(0u) {
+      if (chunks_) {
+        EnterChunk(0u);
+      }
+    }
+
+    IteratorBase(IteratorBase&&) = default;
+    IteratorBase& operator=(IteratorBase&&) = default;
+
+    bool operator==(const IteratorBase& rhs) const { return i_ == rhs.i_; }
+    bool operator!=(const IteratorBase& rhs) const { return !operator==(rhs); }
+    operator bool() const { return impl_; }
+
+   protected:
+    void EnterChunk(size_t chunk) const {
+      const Chunk& c = (*chunks_)[chunk];
+      const char* data;
+      if (c.compressed) {
+        // The block is decompressed when the iterator reaches it, and only then.
+        if (!block_buffer_) {
+          block_buffer_ = std::make_shared<std::string>();
+        }
+        c.compressed->DecompressBlock(c.block, *block_buffer_);
+        data = block_buffer_->data();
+      } else {
+        data = c.mapping->data();
+      }
+      chunk_ = chunk;
+      cursor_index_ = c.begin_index;
+      cursor_ = data + c.begin_offset;
+      end_ = data + c.end_offset;
+    }
+
+    // Returns the beginning of the entry with the index `i_`, and sets `next` to where it ends.
+    const char* Seek(const char*& next) const {
+      if (chunk_ + 1u < chunks_->size() && (*chunks_)[chunk_ + 1u].begin_index <= i_) {
+        size_t chunk = chunk_ + 1u;
+        while (chunk + 1u < chunks_->size() && (*chunks_)[chunk + 1u].begin_index <= i_) {
+          ++chunk;
+        }
+        EnterChunk(chunk);
+      }
+      while (true) {
+        if (!(cursor_ < end_)) {
+          // End of the range. Should never happen as long as the user only iterates over valid ranges.
+          CURRENT_THROW(current::Exception());  // LCOV_EXCL_LINE
+        }
+        bool is_directive;
+        next = FileFormatImpl<FORMAT>::NextRecord(cursor_, end_, is_directive);
+        if (!is_directive) {
+          if (cursor_index_ == i_) {
+            const char* result = cursor_;
+            cursor_ = next;
+            ++cursor_index_;
+            return result;
+          }
+          ++cursor_index_;
+        }
+        cursor_ = next;
+      }
+    }
+
+    Borrowed<SegmentedFilePersisterImpl> impl_;
+    std::shared_ptr<const chunks_t> chunks_;
+    uint64_t i_;
+    mutable size_t chunk_;
+    mutable uint64_t cursor_index_ = 0u;
+    mutable const char* cursor_ = nullptr;
+    mutable const char* end_ = nullptr;
+    mutable std::shared_ptr<std::string> block_buffer_;  // Not an `std::string`, to keep `cursor_` valid on moves.
+  };
+
+  class Iterator final : public IteratorBase {
+   public:
+    struct Entry {
+      idxts_t idx_ts;
+      ENTRY entry;
+    };
+
+    Iterator() = delete;
+    Iterator(const Iterator&) = delete;
+    Iterator& operator=(const Iterator&) = delete;
+
+    Iterator(Iterator&&) = default;
+    Iterator& operator=(Iterator&&) = default;
+
+    using IteratorBase::IteratorBase;
+
+    // `operator*` relies on the fact each entry will be requested at most once.
+    Entry operator*() const {
+      const char* next;
+      const char* begin = IteratorBase::Seek(next);
+      PersistedRecord record;
+      FileFormatImpl<FORMAT>::ParseEntry(begin, next, record, buffer_);
+      if (record.idxts.index != IteratorBase::i_) {
+        CURRENT_THROW(ss::InconsistentIndexException(IteratorBase::i_, record.idxts.index));  // LCOV_EXCL_LINE
+      }
+      Entry result;
+      result.idx_ts = record.idxts;
+      result.entry = ParseEntryPayload<ENTRY>(record);
+      return result;
+    }
+
+    Iterator& operator++() {
+      ++IteratorBase::i_;
+      return *this;
+    }
+
+   private:
+    mutable std::string buffer_;
+  };
+
+  class IteratorUnsafe final : public IteratorBase {
+   public:
+    IteratorUnsafe() = delete;
+    IteratorUnsafe(const IteratorUnsafe&) = delete;
+    IteratorUnsafe(IteratorUnsafe&&) = default;
+    IteratorUnsafe& operator=(const IteratorUnsafe&) = delete;
+    IteratorUnsafe& operator=(IteratorUnsafe&&) = default;
+
+    using IteratorBase::IteratorBase;
+
+    // `operator*` relies on the fact each entry will be requested at most once.
+    std::string operator*() const {
+      if (current_entry_.empty()) {
+        const char* next;
+        const char* begin = IteratorBase::Seek(next);
+        FileFormatImpl<FORMAT>::template RawEntry<ENTRY>(begin, next, current_entry_);
+      }
+      return current_entry_;
+    }
+
+    IteratorUnsafe& operator++() {
+      ++IteratorBase::i_;
+      current_entry_.clear();
+      return *this;
+    }
+
+   private:
+    mutable std::string current_entry_;
+  };
+
+  template <typename ITERATOR>
+  class IterableRangeImpl {
+   public:
+    IterableRangeImpl(Borrowed<SegmentedFilePersisterImpl> impl,
+                      std::shared_ptr<const chunks_t> chunks,
+                      uint64_t begin,
+                      uint64_t end)
+        : impl_(std::move(impl)), chunks_(std::move(chunks)), begin_(begin), end_(end) {}
+
+    IterableRangeImpl(IterableRangeImpl&& rhs)
+        : impl_(std::move(rhs.impl_)), chunks_(std::move(rhs.chunks_)), begin_(rhs.begin_), end_(rhs.end_) {}
+
+    ITERATOR begin() const {
+      if (begin_ == end_) {
+        return ITERATOR(impl_, nullptr, 0);
+      } else {
+        return ITERATOR(impl_, chunks_, begin_);
+      }
+    }
+    ITERATOR end() const {
+      if (begin_ == end_) {
+        return ITERATOR(impl_, nullptr, 0);
+      } else {
+        return ITERATOR(impl_, nullptr, end_);
+      }
+    }
+
+    operator bool() const { return impl_; }
+
+   private:
+    const Borrowed<SegmentedFilePersisterImpl> impl_;
+    std::shared_ptr<const chunks_t> chunks_;
+    const uint64_t begin_;
+    const uint64_t end_;
+  };
+
+  // The index of the first entry still available to the iterators, non-zero once retention has dropped segments.
+  uint64_t FirstAvailableIndex() const {
+    std::lock_guard<std::mutex> lock(impl_->publish_mutex_ref_);
+    return impl_->FirstIndex();
+  }
+
+  // A copy of the manifest.
+  SegmentedFileManifest Manifest() const {
+    std::lock_guard<std::mutex> lock(impl_->publish_mutex_ref_);
+    SegmentedFileManifest manifest;
+    for (const auto& segment : impl_->segments_) {
+      manifest.segments.push_back(segment.info);
+    }
+    return manifest;
+  }
+
+  // The entry is serialized before the publishing mutex is locked, if it is to be locked here.
+  template <current::locks::MutexLockStatus MLS, typename E, typename TIMESTAMP>
+  idxts_t PersisterPublishImpl(E&& entry, const TIMESTAMP provided_timestamp) {
+    return PersisterPublishPayloadImpl<MLS>(
+        SerializeEntryPayload<FORMAT, ENTRY>(
+            MakeSureTheRightTypeIsSerialized<ENTRY, decay_t<E>>::DoIt(std::forward<E>(entry))),
+        provided_timestamp,
+        FileFormatImpl<FORMAT>::kBinaryPayloads);
+  }
+
+  // See `EntryPersister::PublishSerialized()`.
+  template <current::locks::MutexLockStatus MLS, typename TIMESTAMP>
+  idxts_t PersisterPublishSerializedImpl(const std::string& entry_json, const TIMESTAMP provided_timestamp) {
+    return PersisterPublishPayloadImpl<MLS>(entry_json, provided_timestamp, false);
+  }
+
+  template <current::locks::MutexLockStatus MLS, typename TIMESTAMP>
+  idxts_t PersisterPublishPayloadImpl(const std::string& payload, const TIMESTAMP provided_timestamp, bool binary) {
+    current::locks::SmartMutexLockGuard<MLS> lock(impl_->publish_mutex_ref_);
+
+    end_t iterator = impl_->end_.load();
+    const auto timestamp = current::time::TimestampAsMicroseconds(provided_timestamp);
+    if (!(timestamp > iterator.head)) {
+      CURRENT_THROW(ss::InconsistentTimestampException(iterator.head + std::chrono::microseconds(1), timestamp));
+    }
+    impl_->RotateIfNeeded(timestamp);
+
+    iterator.last_entry_us = iterator.head = timestamp;
+    const auto idxts = idxts_t(iterator.next_index, iterator.last_entry_us);
+    Segment& active = impl_->segments_.back();
+    impl_->record_offset_.push_back(active.size);
+    impl_->record_timestamp_.push_back(timestamp);
+    active.size += FileFormatImpl<FORMAT>::AppendEntry(impl_->segment_appender_, idxts, payload, binary);
+    impl_->segment_appender_.flush();
+    ++iterator.next_index;
+    impl_->head_offset_ = 0;
+    impl_->end_.store(iterator);
+
+    return idxts;
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  idxts_t PersisterPublishUnsafeImpl(const std::string& raw_log_line) {
+    current::locks::SmartMutexLockGuard<MLS> lock(impl_->publish_mutex_ref_);
+
+    end_t iterator = impl_->end_.load();
+    const auto tab_pos = raw_log_line.find('\t');
+    if (tab_pos == std::string::npos) {
+      CURRENT_THROW(MalformedEntryException(raw_log_line));
+    }
+    const idxts_t idxts = ParseIdxTs(raw_log_line.data(), raw_log_line.data() + tab_pos);
+    if (idxts.index != iterator.next_index) {
+      CURRENT_THROW(UnsafePublishBadIndexTimestampException(iterator.next_index, idxts.index));
+    }
+    if (!(idxts.us > iterator.head)) {
+      CURRENT_THROW(ss::InconsistentTimestampException(iterator.head + std::chrono::microseconds(1), idxts.us));
+    }
+    impl_->RotateIfNeeded(idxts.us);
+
+    iterator.last_entry_us = iterator.head = idxts.us;
+    Segment& active = impl_->segments_.back();
+    impl_->record_offset_.push_back(active.size);
+    impl_->record_timestamp_.push_back(idxts.us);
+    active.size += FileFormatImpl<FORMAT>::AppendRawEntry(impl_->segment_appender_, raw_log_line, idxts, tab_pos);
+    impl_->segment_appender_.flush();
+    ++iterator.next_index;
+    impl_->head_offset_ = 0;
+    impl_->end_.store(iterator);
+
+    return idxts;
+  }
+
+  template <current::locks::MutexLockStatus MLS, typename TIMESTAMP>
+  void PersisterUpdateHeadImpl(const TIMESTAMP provided_timestamp) {
+    current::locks::SmartMutexLockGuard<MLS> lock(impl_->publish_mutex_ref_);
+
+    end_t iterator = impl_->end_.load();
+    const auto timestamp = current::time::TimestampAsMicroseconds(provided_timestamp);
+    if (!(timestamp > iterator.head)) {
+      CURRENT_THROW(ss::InconsistentTimestampException(iterator.head + std::chrono::microseconds(1), timestamp));
+    }
+    iterator.head = timestamp;
+    const auto head_str = Printf(constants::kHeadFormatString, static_cast<long long>(timestamp.count()));
+    if (impl_->head_offset_) {
+      impl_->head_rewriter_.seekp(impl_->head_offset_, std::ios_base::beg);
+      impl_->head_rewriter_ << head_str << std::endl;
+    } else {
+      Segment& active = impl_->segments_.back();
+      impl_->segment_appender_ << constants::kHeadDirective << ' ';
+      impl_->head_offset_ = impl_->segment_appender_.tellp();
+      impl_->segment_appender_ << head_str << std::endl;
+      active.size += strlen(constants::kHeadDirective) + 1 + head_str.length() + 1;
+    }
+    impl_->end_.store(iterator);
+  }
+
+  // Every entry is flushed as it is published, and the segments are synced as they are sealed.
+  // This call syncs the active segment. Must not be called from under the publish mutex.
+  void PersisterWaitUntilDurableImpl(uint64_t index) const {
+    std::lock_guard<std::mutex> lock(impl_->publish_mutex_ref_);
+    if (!(index < impl_->end_.load().next_index)) {
+      CURRENT_THROW(InvalidIterableRangeException());
+    }
+    if (!(index < impl_->segments_.back().info.begin_index)) {
+      impl_->SyncActiveSegment();
+    }
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  bool PersisterEmptyImpl() const {
+    return !impl_->end_.load().next_index;
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  uint64_t PersisterSizeImpl() const noexcept {
+    return impl_->end_.load().next_index;
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  std::chrono::microseconds PersisterCurrentHeadImpl() const noexcept {
+    return impl_->end_.load().head;
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  idxts_t PersisterLastPublishedIndexAndTimestampImpl() const {
+    const auto iterator = impl_->end_.load();
+    if (iterator.next_index) {
+      return idxts_t(iterator.next_index - 1, iterator.last_entry_us);
+    } else {
+      CURRENT_THROW(NoEntriesPublishedYet());
+    }
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  head_optidxts_t PersisterHeadAndLastPublishedIndexAndTimestampImpl() const noexcept {
+    const auto iterator = impl_->end_.load();
+    if (iterator.next_index) {
+      return head_optidxts_t(iterator.head, iterator.next_index - 1, iterator.last_entry_us);
+    } else {
+      return head_optidxts_t(iterator.head);
+    }
+  }
+
+  // Only the entries still available, see `FirstAvailableIndex()`, are considered.
+  template <current::locks::MutexLockStatus MLS>
+  std::pair<uint64_t, uint64_t> PersisterIndexRangeByTimestampRangeImpl(std::chrono::microseconds from,
+                                                                        std::chrono::microseconds till) const {
+    std::pair<uint64_t, uint64_t> result{static_cast<uint64_t>(-1), static_cast<uint64_t>(-1)};
+    current::locks::SmartMutexLockGuard<MLS> lock(impl_->publish_mutex_ref_);
+    const auto& timestamps = impl_->record_timestamp_;
+    const uint64_t first_index = impl_->FirstIndex();
+    const auto begin_it = std::lower_bound(timestamps.begin(), timestamps.end(), from);
+    if (begin_it != timestamps.end()) {
+      result.first = first_index + std::distance(timestamps.begin(), begin_it);
+    }
+    if (till.count() > 0) {
+      const auto end_it = std::upper_bound(timestamps.begin(), timestamps.end(), till);
+      if (end_it != timestamps.end()) {
+        result.second = first_index + std::distance(timestamps.begin(), end_it);
+      }
+    }
+    return result;
+  }
+
+  using IterableRange = IterableRangeImpl<Iterator>;
+  using IterableRangeUnsafe = IterableRangeImpl<IteratorUnsafe>;
+
+  template <current::locks::MutexLockStatus MLS>
+  IterableRange PersisterIterate(uint64_t begin_index, uint64_t end_index) const {
+    return PersisterIterateImpl<MLS, IterableRange>(begin_index, end_index);
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  IterableRangeUnsafe PersisterIterateUnsafe(uint64_t begin_index, uint64_t end_index) const {
+    return PersisterIterateImpl<MLS, IterableRangeUnsafe>(begin_index, end_index);
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  IterableRange PersisterIterate(std::chrono::microseconds from, std::chrono::microseconds till) const {
+    return PersisterIterateImpl<MLS, IterableRange>(from, till);
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  IterableRangeUnsafe PersisterIterateUnsafe(std::chrono::microseconds from, std::chrono::microseconds till) const {
+    return PersisterIterateImpl<MLS, IterableRangeUnsafe>(from, till);
+  }
+
+ private:
+  template <current::locks::MutexLockStatus MLS, typename ITERABLE>
+  ITERABLE PersisterIterateImpl(uint64_t begin_index, uint64_t end_index) const {
+    const uint64_t current_size = impl_->end_.load().next_index;
+    if (end_index == static_cast<uint64_t>(-1)) {
+      end_index = current_size;
+    }
+    if (end_index > current_size) {
+      CURRENT_THROW(InvalidIterableRangeException());
+    }
+    if (begin_index == end_index) {
+      return ITERABLE(impl_, nullptr, 0, 0);
+    }
+    if (end_index < begin_index) {
+      CURRENT_THROW(InvalidIterableRangeException());
+    }
+
+    current::locks::SmartMutexLockGuard<MLS> lock(impl_->publish_mutex_ref_);
+
+    const uint64_t first_index = impl_->FirstIndex();
+    if (begin_index < first_index) {
+      CURRENT_THROW(EntryDroppedByRetentionException(begin_index, first_index));
+    }
+    auto chunks = std::make_shared<chunks_t>();
+    for (uint64_t i = begin_index; i < end_index;) {
+      const Segment& segment = impl_->SegmentOf(i);
+      const uint64_t segment_end_index =
+          segment.info.sealed ? segment.info.end_index : impl_->end_.load().next_index;
+      const uint64_t chunk_end_index = std::min(end_index, segment_end_index);
+      const size_t begin_offset = impl_->record_offset_[static_cast<size_t>(i - first_index)];
+      const size_t end_offset = (chunk_end_index < segment_end_index)
+                                    ? impl_->record_offset_[static_cast<size_t>(chunk_end_index - first_index)]
+                                    : segment.size;
+      if (segment.compressed) {
+        // Only the blocks covering the range are visited, starting from the one containing its first entry.
+        const auto& blocks = segment.compressed->blocks();
+        for (size_t b = segment.compressed->BlockOf(begin_offset);
+             b < blocks.size() && blocks[b].raw_offset < end_offset;
+             ++b) {
+          const size_t block_begin = static_cast<size_t>(blocks[b].raw_offset);
+          const size_t block_end = block_begin + blocks[b].raw_size;
+          Chunk chunk;
+          chunk.compressed = segment.compressed;
+          chunk.block = b;
+          chunk.begin_index = (block_begin <= begin_offset) ? i : blocks[b].first_index;
+          chunk.begin_offset = std::max(begin_offset, block_begin) - block_begin;
+          chunk.end_offset = std::min(end_offset, block_end) - block_begin;
+          chunks->push_back(std::move(chunk));
+        }
+      } else {
+        Chunk chunk;
+        chunk.block = 0u;
+        chunk.begin_index = i;
+        chunk.begin_offset = begin_offset;
+        chunk.end_offset = end_offset;
+        chunk.mapping = segment.MappingCovering(end_offset);
+        chunks->push_back(std::move(chunk));
+      }
+      i = chunk_end_index;
+    }
+    return ITERABLE(impl_, std::move(chunks), begin_index, end_index);
+  }
+
+  template <current::locks::MutexLockStatus MLS, typename ITERABLE>
+  ITERABLE PersisterIterateImpl(std::chrono::microseconds from, std::chrono::microseconds till) const {
+    if (till.count() > 0 && till < from) {
+      CURRENT_THROW(InvalidIterableRangeException());
+    }
+
+    const auto index_range = PersisterIndexRangeByTimestampRangeImpl<MLS>(from, till);
+    if (index_range.first != static_cast<uint64_t>(-1)) {
+      return PersisterIterateImpl<MLS, ITERABLE>(index_range.first, index_range.second);
+    } else {  // No entries found in the requested range.
+      return ITERABLE(impl_, nullptr, 0, 0);
+    }
+  }
+
+ private:
+  Owned<SegmentedFilePersisterImpl> impl_;  // `Owned`, as iterators borrow it.
+};
+
+}  // namespace impl
+
+template <typename ENTRY>
+using SegmentedFile = ss::EntryPersister<impl::SegmentedFilePersister<ENTRY>, ENTRY>;
+
+}  // namespace persistence
+}  // namespace current
+
+#endif  // BLOCKS_PERSISTENCE_SEGMENTED_H
@@ -30,7 +30,10 @@ SOFTWARE.
 #define CURRENT_MOCK_TIME  // `SetNow()`.
 
 #include "memory.h"
+#include "lock_free_memory.h"
 #include "file.h"
+#include "hybrid.h"
+#include "segmented.h"
 
 #include "../ss/ss.h"
 
@@ -149,6 +152,99 @@ TEST(PersistenceLayer, Memory) {
   }
 }
 
+TEST(PersistenceLayer, LockFreeMemory) {
+  current::time::ResetToZero();
+
+  using namespace persistence_test;
+
+  using IMPL = current::persistence::LockFreeMemory<std::string>;
+
+  const auto namespace_name = current::ss::StreamNamespaceName("namespace", "entry_name");
+
+  std::mutex mutex;
+  IMPL impl(mutex, namespace_name);
+  EXPECT_TRUE(impl.Empty());
+  EXPECT_EQ(-1, impl.CurrentHead().count());
+  ASSERT_THROW(impl.LastPublishedIndexAndTimestamp(), current::persistence::NoEntriesPublishedYet);
+
+  // Span several chunks, the first one holding 1024 entries, each next one twice as many.
+  const int n = 10000;
+  for (int i = 0; i < n; ++i) {
+    impl.Publish(current::ToString(i), std::chrono::microseconds((i + 1) * 10));
+  }
+  ASSERT_THROW(impl.Publish("nope", std::chrono::microseconds(n * 10)), current::ss::InconsistentTimestampException);
+  impl.UpdateHead(std::chrono::microseconds(n * 10 + 5));
+  EXPECT_EQ(static_cast<uint64_t>(n), impl.Size());
+  EXPECT_EQ(n * 10 + 5, impl.CurrentHead().count());
+  EXPECT_EQ(static_cast<uint64_t>(n - 1), impl.LastPublishedIndexAndTimestamp().index);
+  EXPECT_EQ(n * 10, impl.LastPublishedIndexAndTimestamp().us.count());
+  EXPECT_EQ(n * 10 + 5, impl.HeadAndLastPublishedIndexAndTimestamp().head.count());
+
+  {
+    int i = 0;
+    for (const auto& e : impl.Iterate()) {
+      ASSERT_EQ(static_cast<uint64_t>(i), e.idx_ts.index);
+      ASSERT_EQ((i + 1) * 10, e.idx_ts.us.count());
+      ASSERT_EQ(current::ToString(i), e.entry);
+      ++i;
+    }
+    EXPECT_EQ(n, i);
+  }
+  {
+    std::vector<std::string> around_chunk_boundary;
+    for (const auto& e : impl.Iterate(1022, 1026)) {
+      around_chunk_boundary.push_back(e.entry);
+    }
+    EXPECT_EQ("1022,1023,1024,1025", Join(around_chunk_boundary, ","));
+    std::vector<std::string> unsafe;
+    for (const auto& e : impl.IterateUnsafe(3071, 3073)) {
+      unsafe.push_back(e);
+    }
+    EXPECT_EQ("{\"index\":3071,\"us\":30720}\t\"3071\",{\"index\":3072,\"us\":30730}\t\"3072\"", Join(unsafe, ","));
+  }
+  {
+    std::vector<std::string> by_timestamp;
+    for (const auto& e : impl.Iterate(std::chrono::microseconds(20005), std::chrono::microseconds(20030))) {
+      by_timestamp.push_back(e.entry);
+    }
+    EXPECT_EQ("2000,2001,2002", Join(by_timestamp, ","));
+    EXPECT_EQ(0u, impl.IndexRangeByTimestampRange(std::chrono::microseconds(0)).first);
+    EXPECT_EQ(static_cast<uint64_t>(-1), impl.IndexRangeByTimestampRange(std::chrono::microseconds(n * 10 + 1)).first);
+  }
+  ASSERT_THROW(impl.Iterate(0, n + 1), current::persistence::InvalidIterableRangeException);
+
+  {
+    // The readers never lock, and see the entries published concurrently.
+    std::atomic_bool done(false);
+    std::atomic_int errors(0);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r) {
+      readers.emplace_back([&]() {
+        while (!done) {
+          const auto head_and_last = impl.HeadAndLastPublishedIndexAndTimestamp();
+          if (!Exists(head_and_last.idxts) || head_and_last.head < Value(head_and_last.idxts).us) {
+            ++errors;
+          }
+          const uint64_t size = impl.Size();
+          const auto e = *impl.Iterate(size - 1u, size).begin();
+          if (e.entry != current::ToString(size - 1u)) {
+            ++errors;
+          }
+        }
+      });
+    }
+    for (int i = n; i < 5 * n; ++i) {
+      impl.Publish(current::ToString(i), std::chrono::microseconds((i + 1) * 10));
+    }
+    done = true;
+    for (auto& reader : readers) {
+      reader.join();
+    }
+    EXPECT_EQ(0, errors);
+    EXPECT_EQ(static_cast<uint64_t>(5 * n), impl.Size());
+  }
+}
+
 TEST(PersistenceLayer, MemoryExceptions) {
   using namespace persistence_test;
 
@@ -889,6 +985,1031 @@ void IteratorPerformanceTest(IMPL& impl, bool publish = true) {
 
 }  // namespace persistence_test
 
+TEST(PersistenceLayer, FramedFile) {
+  current::time::ResetToZero();
+
+  using namespace persistence_test;
+
+  using IMPL = current::persistence::FramedFile<StorableString>;
+
+  const auto namespace_name = current::ss::StreamNamespaceName("namespace", "entry_name");
+  const std::string persistence_file_name = current::FileSystem::JoinPath(FLAGS_persistence_test_tmpdir, "data");
+  const auto file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+
+  const auto CollectEntries = [](const IMPL& impl) {
+    std::vector<std::string> result;
+    for (const auto& e : impl.Iterate()) {
+      result.push_back(Printf(
+          "%s %d %d", e.entry.s.c_str(), static_cast<int>(e.idx_ts.index), static_cast<int>(e.idx_ts.us.count())));
+    }
+    return Join(result, ",");
+  };
+
+  const auto CollectRawEntries = [](const IMPL& impl) {
+    std::vector<std::string> result;
+    for (const auto& e : impl.IterateUnsafe()) {
+      result.push_back(e);
+    }
+    return Join(result, ",");
+  };
+
+  {
+    std::mutex mutex;
+    IMPL impl(mutex, namespace_name, persistence_file_name);
+    EXPECT_EQ(0u, impl.Size());
+    current::time::SetNow(std::chrono::microseconds(100));
+    impl.Publish(StorableString("foo"));
+    current::time::SetNow(std::chrono::microseconds(200));
+    impl.Publish(StorableString("bar\nwith\ttabs"));
+    current::time::SetNow(std::chrono::microseconds(300));
+    impl.UpdateHead();
+    current::time::SetNow(std::chrono::microseconds(400));
+    impl.UpdateHead();
+    // This is how `Stream` publishes raw log lines, for instance, when following a replicated stream.
+    constexpr auto NeedToLock = current::locks::MutexLockStatus::NeedToLock;
+    impl.PersisterPublishUnsafeImpl<NeedToLock>("{\"index\":2,\"us\":500}\t{\"s\":\"meh\"}");
+    EXPECT_EQ(3u, impl.Size());
+    EXPECT_EQ(500, impl.CurrentHead().count());
+
+    EXPECT_EQ("foo 0 100,bar\nwith\ttabs 1 200,meh 2 500", CollectEntries(impl));
+    EXPECT_EQ(
+        "{\"index\":0,\"us\":100}\t{\"s\":\"foo\"},"
+        "{\"index\":1,\"us\":200}\t{\"s\":\"bar\\nwith\\ttabs\"},"
+        "{\"index\":2,\"us\":500}\t{\"s\":\"meh\"}",
+        CollectRawEntries(impl));
+
+    ASSERT_THROW(impl.PersisterPublishUnsafeImpl<NeedToLock>("{\"index\":2,\"us\":600}\t{\"s\":\"bad\"}"),
+                 current::persistence::UnsafePublishBadIndexTimestampException);
+
+    current::time::SetNow(std::chrono::microseconds(600));
+    impl.UpdateHead();
+  }
+
+  {
+    // The directives remain text lines, the entries are not.
+    const std::string contents = current::FileSystem::ReadFileAsString(persistence_file_name);
+    EXPECT_EQ(0u, contents.find("#signature "));
+    EXPECT_EQ(contents.length() - 27, contents.rfind("#head 00000000000000000600\n"));
+    EXPECT_EQ(std::string::npos, contents.find("{\"index\":0,\"us\":100}"));
+    EXPECT_NE(std::string::npos, contents.find("#head 00000000000000000400\n"));
+    // The published entries are binary frames, while the raw log line is kept as a JSON frame.
+    EXPECT_EQ(std::string::npos, contents.find("{\"s\":\"foo\"}"));
+    EXPECT_NE(std::string::npos, contents.find("{\"s\":\"meh\"}"));
+  }
+
+  {
+    // Confirm the data has been saved and can be replayed.
+    std::mutex mutex;
+    IMPL impl(mutex, namespace_name, persistence_file_name);
+    EXPECT_EQ(3u, impl.Size());
+    EXPECT_EQ(600, impl.CurrentHead().count());
+    EXPECT_EQ("foo 0 100,bar\nwith\ttabs 1 200,meh 2 500", CollectEntries(impl));
+
+    current::time::SetNow(std::chrono::microseconds(700));
+    impl.Publish(StorableString("blah"));
+    EXPECT_EQ(4u, impl.Size());
+
+    std::vector<std::string> last_two;
+    for (const auto& e : impl.Iterate(std::chrono::microseconds(450))) {
+      last_two.push_back(e.entry.s);
+    }
+    EXPECT_EQ("meh,blah", Join(last_two, ","));
+  }
+
+  {
+    // A corrupted payload byte breaks the checksum.
+    std::string contents = current::FileSystem::ReadFileAsString(persistence_file_name);
+    const size_t pos = contents.find("\"meh\"");
+    ASSERT_NE(std::string::npos, pos);
+    contents[pos + 1] = 'M';
+    current::FileSystem::WriteStringToFile(contents, persistence_file_name.c_str());
+    std::mutex mutex;
+    ASSERT_THROW(IMPL(mutex, namespace_name, persistence_file_name),
+                 current::persistence::FrameChecksumMismatchException);
+  }
+
+  {
+    // A truncated frame is reported as a malformed entry.
+    std::string contents = current::FileSystem::ReadFileAsString(persistence_file_name);
+    current::FileSystem::WriteStringToFile(contents.substr(0, contents.length() - 3), persistence_file_name.c_str());
+    std::mutex mutex;
+    ASSERT_THROW(IMPL(mutex, namespace_name, persistence_file_name), current::persistence::MalformedEntryException);
+  }
+}
+
+TEST(PersistenceLayer, FileDurabilityPolicies) {
+  using namespace persistence_test;
+
+  using IMPL = current::persistence::File<StorableString>;
+  using current::persistence::FileDurability;
+
+  const auto namespace_name = current::ss::StreamNamespaceName("namespace", "entry_name");
+  const std::string persistence_file_name = current::FileSystem::JoinPath(FLAGS_persistence_test_tmpdir, "data");
+
+  current::reflection::StructSchema struct_schema;
+  struct_schema.AddType<StorableString>();
+  const std::string signature =
+      "#signature " + JSON(current::ss::StreamSignature(namespace_name, struct_schema.GetSchemaInfo())) + '\n';
+  const std::string expected_contents = signature +
+                                        "{\"index\":0,\"us\":100}\t{\"s\":\"foo\"}\n"
+                                        "{\"index\":1,\"us\":200}\t{\"s\":\"bar\"}\n"
+                                        "#head 00000000000000000400\n"
+                                        "{\"index\":2,\"us\":500}\t{\"s\":\"meh\"}\n";
+
+  for (const auto& durability : {FileDurability::FlushEachEntry(),
+                                 FileDurability::GroupCommit(std::chrono::milliseconds(1)),
+                                 FileDurability::GroupCommit(std::chrono::seconds(60), 1u),
+                                 FileDurability::NoSyncUntilClose()}) {
+    current::time::ResetToZero();
+    const auto file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+    {
+      std::mutex mutex;
+      IMPL impl(mutex, namespace_name, persistence_file_name, durability);
+      ASSERT_THROW(impl.WaitUntilDurable(0u), current::persistence::InvalidIterableRangeException);
+
+      impl.Publish(StorableString("foo"), std::chrono::microseconds(100));
+      impl.Publish(StorableString("bar"), std::chrono::microseconds(200));
+      impl.UpdateHead(std::chrono::microseconds(300));
+      impl.UpdateHead(std::chrono::microseconds(400));
+
+      // The entries are visible to the iterators right away, regardless of the durability policy.
+      std::vector<std::string> entries;
+      for (const auto& e : impl.Iterate()) {
+        entries.push_back(e.entry.s);
+      }
+      EXPECT_EQ("foo,bar", Join(entries, ","));
+
+      impl.Publish(StorableString("meh"), std::chrono::microseconds(500));
+      impl.WaitUntilDurable(2u);
+      EXPECT_EQ(expected_contents, current::FileSystem::ReadFileAsString(persistence_file_name));
+      impl.WaitUntilDurable(0u);
+      ASSERT_THROW(impl.WaitUntilDurable(3u), current::persistence::InvalidIterableRangeException);
+
+      impl.Publish(StorableString("blah"), std::chrono::microseconds(600));
+    }
+    EXPECT_EQ(expected_contents + "{\"index\":3,\"us\":600}\t{\"s\":\"blah\"}\n",
+              current::FileSystem::ReadFileAsString(persistence_file_name));
+    {
+      std::mutex mutex;
+      IMPL impl(mutex, namespace_name, persistence_file_name, durability);
+      EXPECT_EQ(4u, impl.Size());
+      // The entries replayed at startup are durable.
+      impl.WaitUntilDurable(3u);
+    }
+  }
+}
+
+TEST(PersistenceLayer, FileGroupCommitFromManyThreads) {
+  using namespace persistence_test;
+
+  using IMPL = current::persistence::FramedFile<StorableString>;
+
+  const auto namespace_name = current::ss::StreamNamespaceName("namespace", "entry_name");
+  const std::string persistence_file_name = current::FileSystem::JoinPath(FLAGS_persistence_test_tmpdir, "data");
+  const auto file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+
+  constexpr size_t kThreads = 4u;
+  constexpr size_t kEntriesPerThread = 250u;
+
+  {
+    std::mutex mutex;
+    IMPL impl(mutex, namespace_name, persistence_file_name, current::persistence::FileDurability::GroupCommit());
+    std::vector<std::thread> threads;
+    for (size_t t = 0u; t < kThreads; ++t) {
+      threads.emplace_back([&impl, t]() {
+        for (size_t i = 0u; i < kEntriesPerThread; ++i) {
+          const auto idxts = impl.Publish(StorableString(current::ToString(t)));
+          impl.WaitUntilDurable(idxts.index);
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    EXPECT_EQ(kThreads * kEntriesPerThread, impl.Size());
+  }
+
+  {
+    std::mutex mutex;
+    IMPL impl(mutex, namespace_name, persistence_file_name);
+    EXPECT_EQ(kThreads * kEntriesPerThread, impl.Size());
+  }
+}
+
+TEST(PersistenceLayer, FileIteratorsShareTheGrowingMapping) {
+  current::time::ResetToZero();
+
+  using namespace persistence_test;
+
+  using IMPL = current::persistence::FramedFile<StorableString>;
+
+  const auto namespace_name = current::ss::StreamNamespaceName("namespace", "entry_name");
+  const std::string persistence_file_name = current::FileSystem::JoinPath(FLAGS_persistence_test_tmpdir, "data");
+  const auto file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+
+  std::mutex mutex;
+  IMPL impl(mutex, namespace_name, persistence_file_name);
+
+  const std::string padding(1000, '.');
+  impl.Publish(StorableString("0" + padding), std::chrono::microseconds(10));
+  impl.Publish(StorableString("1" + padding), std::chrono::microseconds(20));
+
+  // Created while the file is small, this range keeps using the original mapping.
+  const auto early_range = impl.Iterate();
+  const auto early_unsafe_range = impl.IterateUnsafe(1);
+
+  // Grow the file well past the size of the initial mapping.
+  for (int i = 2; i < 3000; ++i) {
+    impl.Publish(StorableString(current::ToString(i) + padding), std::chrono::microseconds((i + 1) * 10));
+    if (i % 1000 == 0) {
+      impl.UpdateHead(std::chrono::microseconds((i + 1) * 10 + 5));
+    }
+  }
+  ASSERT_GT(current::FileSystem::ReadFileAsString(persistence_file_name).length(), static_cast<size_t>(2u << 20));
+
+  {
+    std::vector<std::string> values;
+    for (const auto& e : early_range) {
+      values.push_back(e.entry.s.substr(0, 1));
+    }
+    EXPECT_EQ("0,1", Join(values, ","));
+    std::vector<std::string> unsafe_values;
+    for (const auto& e : early_unsafe_range) {
+      unsafe_values.push_back(e.substr(0, e.find('\t')));
+    }
+    EXPECT_EQ("{\"index\":1,\"us\":20}", Join(unsafe_values, ","));
+  }
+
+  {
+    // Skipping over the entries without dereferencing the iterators.
+    size_t count = 0u;
+    auto range = impl.Iterate(1000, 3000);
+    auto it = range.begin();
+    for (int i = 1000; i < 3000; ++i, ++it) {
+      if (i % 7 == 0) {
+        const auto e = *it;
+        EXPECT_EQ(static_cast<uint64_t>(i), e.idx_ts.index);
+        EXPECT_EQ(current::ToString(i) + padding, e.entry.s);
+        ++count;
+      }
+    }
+    EXPECT_TRUE(it == range.end());
+    EXPECT_EQ(286u, count);
+  }
+
+  {
+    std::vector<std::string> raw;
+    for (const auto& e : impl.IterateUnsafe(2998)) {
+      raw.push_back(e.substr(0, e.find('\t')));
+    }
+    EXPECT_EQ("{\"index\":2998,\"us\":29990},{\"index\":2999,\"us\":30000}", Join(raw, ","));
+  }
+}
+
+TEST(PersistenceLayer, FileRawEntriesSpans) {
+  current::time::ResetToZero();
+
+  using namespace persistence_test;
+
+  using IMPL = current::persistence::File<StorableString>;
+  static_assert(current::ss::PersisterServesRawEntriesSpans<IMPL>::value, "");
+  static_assert(current::ss::PersisterServesRawEntriesSpans<current::persistence::Hybrid<StorableString>>::value, "");
+  static_assert(!current::ss::PersisterServesRawEntriesSpans<current::persistence::FramedFile<StorableString>>::value,
+                "");
+  static_assert(!current::ss::PersisterServesRawEntriesSpans<current::persistence::Memory<StorableString>>::value, "");
+
+  const auto namespace_name = current::ss::StreamNamespaceName("namespace", "entry_name");
+  const std::string persistence_file_name = current::FileSystem::JoinPath(FLAGS_persistence_test_tmpdir, "data");
+  const auto file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+
+  std::mutex mutex;
+  IMPL impl(mutex, namespace_name, persistence_file_name);
+
+  const std::string padding(1000, '.');
+  for (int i = 0; i < 2500; ++i) {
+    impl.Publish(StorableString(current::ToString(i) + padding), std::chrono::microseconds((i + 1) * 10));
+    if (i == 9 || i == 10) {
+      impl.UpdateHead(std::chrono::microseconds((i + 1) * 10 + 5));
+    }
+  }
+
+  const auto CollectSpans = [&impl](uint64_t begin, uint64_t end, std::string& bytes) {
+    std::vector<std::string> spans;
+    bytes.clear();
+    impl.IterateRawSpans(begin, end, [&](const current::ss::RawEntriesSpan& span) {
+      spans.push_back(current::ToString(span.begin_index) + ".." + current::ToString(span.end_index));
+      bytes.append(span.data, span.size);
+      return true;
+    });
+    return Join(spans, ",");
+  };
+  const auto CollectUnsafe = [&impl](uint64_t begin, uint64_t end) {
+    std::string result;
+    for (const auto& e : impl.IterateUnsafe(begin, end)) {
+      result += e + '\n';
+    }
+    return result;
+  };
+
+  std::string bytes;
+  // The directives split the spans, and so does the cap on the size of each span, which is one megabyte.
+  EXPECT_EQ("0..10,10..11,11..1023,1023..2032,2032..2500", CollectSpans(0, 2500, bytes));
+  EXPECT_EQ(CollectUnsafe(0, 2500), bytes);
+  EXPECT_EQ("5..10,10..11,11..20", CollectSpans(5, 20, bytes));
+  EXPECT_EQ(CollectUnsafe(5, 20), bytes);
+  EXPECT_EQ("2499..2500", CollectSpans(2499, static_cast<uint64_t>(-1), bytes));
+  EXPECT_EQ(CollectUnsafe(2499, 2500), bytes);
+  EXPECT_EQ("", CollectSpans(42, 42, bytes));
+  EXPECT_EQ("", bytes);
+
+  {
+    // Returning `false` stops the iteration.
+    size_t calls = 0u;
+    impl.IterateRawSpans(0, 2500, [&calls](const current::ss::RawEntriesSpan&) { return ++calls < 2u; });
+    EXPECT_EQ(2u, calls);
+  }
+
+  ASSERT_THROW(impl.IterateRawSpans(0, 2501, [](const current::ss::RawEntriesSpan&) { return true; }),
+               current::persistence::InvalidIterableRangeException);
+}
+
+TEST(PersistenceLayer, FileIndexSidecar) {
+  current::time::ResetToZero();
+
+  using namespace persistence_test;
+
+  using IMPL = current::persistence::File<StorableString>;
+  using current::persistence::FileDurability;
+  using current::persistence::FileIndexSidecar;
+
+  const auto namespace_name = current::ss::StreamNamespaceName("namespace", "entry_name");
+  const std::string persistence_file_name = current::FileSystem::JoinPath(FLAGS_persistence_test_tmpdir, "data");
+  const std::string sidecar_file_name = persistence_file_name + ".idx";
+  const auto file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+  const auto sidecar_file_remover = current::FileSystem::ScopedRmFile(sidecar_file_name);
+
+  const auto sidecar = FileIndexSidecar::Enabled(1000u);
+
+  {
+    std::mutex mutex;
+    IMPL impl(mutex, namespace_name, persistence_file_name, FileDurability(), sidecar);
+    for (int i = 0; i < 2500; ++i) {
+      impl.Publish(StorableString(current::ToString(i)), std::chrono::microseconds((i + 1) * 10));
+    }
+    // The empty block covering the signature is saved right away, and two full blocks as the entries are published.
+    EXPECT_EQ(16u + 28u + 2u * (16u + 1000u * 16u + 28u), current::FileSystem::GetFileSize(sidecar_file_name));
+    impl.UpdateHead(std::chrono::microseconds(25005));
+  }
+
+  const auto VerifyContents = [&](const FileIndexSidecar& index_sidecar, uint64_t size, int64_t head) {
+    std::mutex mutex;
+    IMPL impl(mutex, namespace_name, persistence_file_name, FileDurability(), index_sidecar);
+    EXPECT_EQ(size, impl.Size());
+    EXPECT_EQ(head, impl.CurrentHead().count());
+    EXPECT_EQ("2000", (*impl.Iterate(2000, 2001).begin()).entry.s);
+    EXPECT_EQ(2000u,
+              impl.IndexRangeByTimestampRange(std::chrono::microseconds(20010), std::chrono::microseconds(0)).first);
+  };
+
+  VerifyContents(sidecar, 2500u, 25005);
+
+  const std::string original_contents = current::FileSystem::ReadFileAsString(persistence_file_name);
+  {
+    // The part of the log covered by the sidecar is not replayed: an entry broken in place goes unnoticed.
+    std::string contents = original_contents;
+    const std::string what = "{\"index\":5,";
+    const size_t pos = contents.find(what);
+    ASSERT_NE(std::string::npos, pos);
+    contents[pos + what.length() - 2] = '7';
+    current::FileSystem::WriteStringToFile(contents, persistence_file_name.c_str());
+    VerifyContents(sidecar, 2500u, 25005);
+    ASSERT_THROW(VerifyContents(FileIndexSidecar::Disabled(), 2500u, 25005), current::ss::InconsistentIndexException);
+    current::FileSystem::WriteStringToFile(original_contents, persistence_file_name.c_str());
+  }
+
+  const std::string original_sidecar = current::FileSystem::ReadFileAsString(sidecar_file_name);
+  {
+    // A missing sidecar is rebuilt.
+    current::FileSystem::RmFile(sidecar_file_name);
+    VerifyContents(sidecar, 2500u, 25005);
+    // All the entries are saved as a single block.
+    EXPECT_EQ(16u + 2500u * 16u + 28u, current::FileSystem::GetFileSize(sidecar_file_name));
+  }
+  {
+    // A corrupted sidecar is rebuilt too.
+    std::string corrupted = original_sidecar;
+    corrupted[100] ^= 1;
+    current::FileSystem::WriteStringToFile(corrupted, sidecar_file_name.c_str());
+    VerifyContents(sidecar, 2500u, 25005);
+    EXPECT_EQ(16u + 2500u * 16u + 28u, current::FileSystem::GetFileSize(sidecar_file_name));
+  }
+  {
+    // A sidecar that does not match the log file is ignored.
+    std::string truncated = original_contents.substr(0, original_contents.find("{\"index\":2200,"));
+    current::FileSystem::WriteStringToFile(truncated, persistence_file_name.c_str());
+    VerifyContents(FileIndexSidecar::Enabled(1000000u), 2200u, 22000);
+    current::FileSystem::WriteStringToFile(original_contents, persistence_file_name.c_str());
+    current::FileSystem::WriteStringToFile(original_sidecar, sidecar_file_name.c_str());
+  }
+
+  {
+    // The entries and the head updates written with the sidecar disabled are replayed.
+    std::mutex mutex;
+    IMPL impl(mutex, namespace_name, persistence_file_name);
+    impl.UpdateHead(std::chrono::microseconds(25006));
+    impl.Publish(StorableString("2500"), std::chrono::microseconds(25010));
+    impl.UpdateHead(std::chrono::microseconds(25020));
+  }
+  VerifyContents(sidecar, 2501u, 25020);
+
+  {
+    // The head rewritten in place after the last block of the sidecar was saved is picked up.
+    {
+      std::mutex mutex;
+      IMPL impl(mutex, namespace_name, persistence_file_name, FileDurability(), sidecar);
+      EXPECT_EQ(2501u, impl.Size());
+    }
+    {
+      std::mutex mutex;
+      IMPL impl(mutex, namespace_name, persistence_file_name);
+      impl.UpdateHead(std::chrono::microseconds(25030));
+    }
+    VerifyContents(sidecar, 2501u, 25030);
+  }
+}
+
+namespace persistence_test {
+
+// Replays the file in the given mode, and returns its summary, or the description of the exception thrown.
+template <typename IMPL>
+std::string ReplayAndSummarize(const std::string& file_name, current::persistence::FileRecovery recovery) {
+  using current::persistence::FileDurability;
+  using current::persistence::FileIndexSidecar;
+  const auto namespace_name = current::ss::StreamNamespaceName("namespace", "entry_name");
+  try {
+    std::mutex mutex;
+    IMPL impl(mutex, namespace_name, file_name, FileDurability(), FileIndexSidecar(), recovery);
+    std::vector<std::string> result;
+    result.push_back(Printf("size=%d head=%d",
+                            static_cast<int>(impl.Size()),
+                            static_cast<int>(impl.CurrentHead().count())));
+    for (int64_t t = 0; t <= 25000; t += 1234) {
+      const auto range = impl.IndexRangeByTimestampRange(std::chrono::microseconds(t), std::chrono::microseconds(t));
+      result.push_back(Printf("%d:%d", static_cast<int>(range.first), static_cast<int>(range.second)));
+    }
+    for (const auto& e : impl.Iterate()) {
+      result.push_back(Printf("%s@%d", e.entry.s.c_str(), static_cast<int>(e.idx_ts.us.count())));
+    }
+    return Join(result, ',');
+  } catch (const current::Exception& e) {
+    return e.OriginalDescription();
+  }
+}
+
+template <typename IMPL>
+void FileParallelRecoveryTest() {
+  current::time::ResetToZero();
+
+  using current::persistence::FileRecovery;
+
+  const auto namespace_name = current::ss::StreamNamespaceName("namespace", "entry_name");
+  const std::string persistence_file_name = current::FileSystem::JoinPath(FLAGS_persistence_test_tmpdir, "data");
+  const auto file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+
+  {
+    std::mutex mutex;
+    IMPL impl(mutex, namespace_name, persistence_file_name);
+    for (int i = 0; i < 2000; ++i) {
+      impl.Publish(StorableString(current::ToString(i)), std::chrono::microseconds((i + 1) * 10));
+      if (i % 300 == 0) {
+        impl.UpdateHead(std::chrono::microseconds((i + 1) * 10 + 5));
+      }
+    }
+    impl.UpdateHead(std::chrono::microseconds(20005));
+  }
+
+  const auto sequential = FileRecovery::Sequential();
+  const auto parallel = FileRecovery::Parallel(4u, 1000u);
+  const auto many_chunks = FileRecovery::Parallel(64u, 1u);
+
+  const std::string expected = ReplayAndSummarize<IMPL>(persistence_file_name, sequential);
+  EXPECT_EQ(0u, expected.find("size=2000 head=20005,"));
+  EXPECT_EQ(expected, ReplayAndSummarize<IMPL>(persistence_file_name, parallel));
+  EXPECT_EQ(expected, ReplayAndSummarize<IMPL>(persistence_file_name, many_chunks));
+
+  {
+    // The `#head` directive the file ends with is found, so that it is rewritten in place, not appended.
+    const uint64_t file_size = current::FileSystem::GetFileSize(persistence_file_name);
+    {
+      std::mutex mutex;
+      IMPL impl(mutex,
+                namespace_name,
+                persistence_file_name,
+                current::persistence::FileDurability(),
+                current::persistence::FileIndexSidecar(),
+                parallel);
+      impl.UpdateHead(std::chrono::microseconds(20006));
+    }
+    EXPECT_EQ(file_size, current::FileSystem::GetFileSize(persistence_file_name));
+    EXPECT_EQ(0u, ReplayAndSummarize<IMPL>(persistence_file_name, parallel).find("size=2000 head=20006,"));
+  }
+
+  // Whatever is broken in the file, the parallel replay reports the same error as the sequential one.
+  const std::string original_contents = current::FileSystem::ReadFileAsString(persistence_file_name);
+  for (size_t i = 1; i < 20; ++i) {
+    std::string contents = original_contents;
+    const size_t pos = contents.length() * i / 20;
+    contents[pos] = (contents[pos] == '7' ? '3' : '7');
+    current::FileSystem::WriteStringToFile(contents, persistence_file_name.c_str());
+    const std::string broken = ReplayAndSummarize<IMPL>(persistence_file_name, sequential);
+    EXPECT_EQ(broken, ReplayAndSummarize<IMPL>(persistence_file_name, parallel)) << pos;
+    EXPECT_EQ(broken, ReplayAndSummarize<IMPL>(persistence_file_name, many_chunks)) << pos;
+  }
+  current::FileSystem::WriteStringToFile(original_contents, persistence_file_name.c_str());
+}
+
+}  // namespace persistence_test
+
+TEST(PersistenceLayer, FileParallelRecovery) {
+  using namespace persistence_test;
+  FileParallelRecoveryTest<current::persistence::File<StorableString>>();
+  FileParallelRecoveryTest<current::persistence::FramedFile<StorableString>>();
+}
+
+TEST(PersistenceLayer, Hybrid) {
+  current::time::ResetToZero();
+
+  using namespace persistence_test;
+
+  using IMPL = current::persistence::Hybrid<StorableString>;
+  using current::persistence::HybridMemoryTail;
+
+  const auto namespace_name = current::ss::StreamNamespaceName("namespace", "entry_name");
+  const std::string persistence_file_name = current::FileSystem::JoinPath(FLAGS_persistence_test_tmpdir, "data");
+  const auto file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+
+  const auto CollectEntries = [](const IMPL& impl, uint64_t begin, uint64_t end) {
+    std::vector<std::string> result;
+    for (const auto& e : impl.Iterate(begin, end)) {
+      result.push_back(Printf("%s:%d", e.entry.s.c_str(), static_cast<int>(e.idx_ts.us.count())));
+    }
+    return Join(result, ",");
+  };
+
+  {
+    std::mutex mutex;
+    IMPL impl(mutex, namespace_name, persistence_file_name, HybridMemoryTail::Entries(10u));
+    for (int i = 0; i < 100; ++i) {
+      impl.Publish(StorableString(current::ToString(i)), std::chrono::microseconds((i + 1) * 10));
+    }
+    EXPECT_EQ(100u, impl.Size());
+    EXPECT_EQ(10u, impl.MemoryTailSize());
+
+    // The most recent entries are served from memory, the very same objects each time, the older ones from the file.
+    EXPECT_EQ(&(*impl.Iterate(95, 96).begin()).entry, &(*impl.Iterate(95, 96).begin()).entry);
+    EXPECT_EQ("88:890,89:900,90:910,91:920", CollectEntries(impl, 88, 92));
+    EXPECT_EQ("0:10,1:20", CollectEntries(impl, 0, 2));
+    {
+      std::vector<std::string> all;
+      for (const auto& e : impl.Iterate()) {
+        all.push_back(e.entry.s);
+      }
+      ASSERT_EQ(100u, all.size());
+      EXPECT_EQ("99", all.back());
+    }
+    {
+      std::vector<std::string> by_timestamp;
+      for (const auto& e : impl.Iterate(std::chrono::microseconds(895), std::chrono::microseconds(920))) {
+        by_timestamp.push_back(e.entry.s);
+      }
+      EXPECT_EQ("89,90,91", Join(by_timestamp, ","));
+    }
+    {
+      std::vector<std::string> unsafe;
+      for (const auto& e : impl.IterateUnsafe(98)) {
+        unsafe.push_back(e);
+      }
+      EXPECT_EQ("{\"index\":98,\"us\":990}\t{\"s\":\"98\"},{\"index\":99,\"us\":1000}\t{\"s\":\"99\"}",
+                Join(unsafe, ","));
+    }
+    {
+      // The entries evicted from memory while being iterated over are read from the file.
+      std::vector<std::string> seen;
+      for (const auto& e : impl.Iterate(92, 100)) {
+        seen.push_back(e.entry.s);
+        if (e.entry.s == "94") {
+          for (int i = 100; i < 120; ++i) {
+            impl.Publish(StorableString(current::ToString(i)), std::chrono::microseconds((i + 1) * 10));
+          }
+        }
+      }
+      EXPECT_EQ("92,93,94,95,96,97,98,99", Join(seen, ","));
+    }
+    ASSERT_THROW(impl.Iterate(0, 1000), current::persistence::InvalidIterableRangeException);
+  }
+
+  {
+    // After a restart all the entries are in the file, and the memory is populated anew as more are published.
+    std::mutex mutex;
+    IMPL impl(mutex, namespace_name, persistence_file_name, HybridMemoryTail::Bytes(100u));
+    EXPECT_EQ(120u, impl.Size());
+    EXPECT_EQ(0u, impl.MemoryTailSize());
+    EXPECT_EQ("118:1190,119:1200", CollectEntries(impl, 118, 120));
+    for (int i = 120; i < 130; ++i) {
+      impl.Publish(StorableString(current::ToString(i)), std::chrono::microseconds((i + 1) * 10));
+    }
+    // Each entry takes `{"index":120,"us":1210}\t{"s":"120"}\n`, 36 bytes, in the file.
+    EXPECT_EQ(2u, impl.MemoryTailSize());
+    EXPECT_EQ("110:1110,128:1290,129:1300", CollectEntries(impl, 110, 111) + ',' + CollectEntries(impl, 128, 130));
+  }
+}
+
+TEST(PersistenceLayer, SegmentedFile) {
+  current::time::ResetToZero();
+
+  using namespace persistence_test;
+
+  using IMPL = current::persistence::SegmentedFile<StorableString>;
+  using current::persistence::FileSegmentation;
+
+  const auto namespace_name = current::ss::StreamNamespaceName("namespace", "entry_name");
+  const std::string directory = current::FileSystem::JoinPath(FLAGS_persistence_test_tmpdir, "segmented");
+  const std::string archive_directory = current::FileSystem::JoinPath(FLAGS_persistence_test_tmpdir, "archived");
+  const auto CleanUp = [&]() {
+    current::FileSystem::RmDir(
+        directory, current::FileSystem::RmDirParameters::Silent, current::FileSystem::RmDirRecursive::Yes);
+    current::FileSystem::RmDir(
+        archive_directory, current::FileSystem::RmDirParameters::Silent, current::FileSystem::RmDirRecursive::Yes);
+  };
+  const auto ListFiles = [](const std::string& dir) {
+    std::vector<std::string> files;
+    current::FileSystem::ScanDir(dir, [&files](const current::FileSystem::ScanDirItemInfo& item) {
+      files.push_back(item.basename);
+    });
+    std::sort(files.begin(), files.end());
+    return Join(files, ',');
+  };
+  const std::string padding(100, '.');
+
+  {
+    CleanUp();
+    {
+      std::mutex mutex;
+      IMPL impl(mutex, namespace_name, directory, FileSegmentation::BySize(1000u));
+      for (int i = 0; i < 50; ++i) {
+        impl.Publish(StorableString(current::ToString(i) + padding), std::chrono::microseconds((i + 1) * 10));
+      }
+      EXPECT_EQ(50u, impl.Size());
+      EXPECT_EQ(0u, impl.FirstAvailableIndex());
+
+      // The segments follow each other, and all but the last one are sealed.
+      const auto manifest = impl.Manifest();
+      ASSERT_GT(manifest.segments.size(), 3u);
+      uint64_t next_index = 0u;
+      for (size_t i = 0; i < manifest.segments.size(); ++i) {
+        const auto& segment = manifest.segments[i];
+        EXPECT_EQ(next_index, segment.begin_index);
+        EXPECT_EQ(i + 1 < manifest.segments.size(), segment.sealed);
+        EXPECT_FALSE(segment.archived);
+        if (segment.sealed) {
+          EXPECT_LT(segment.begin_index, segment.end_index);
+          next_index = segment.end_index;
+#ifndef CURRENT_WINDOWS
+          struct stat st;
+          ASSERT_EQ(0, ::stat(current::FileSystem::JoinPath(directory, segment.name).c_str(), &st));
+          EXPECT_FALSE(st.st_mode & S_IWUSR);
+#endif  // CURRENT_WINDOWS
+        }
+      }
+      EXPECT_EQ(JSON(manifest),
+                current::FileSystem::ReadFileAsString(current::FileSystem::JoinPath(directory, "manifest.json")));
+
+      // The iterators see the contiguous index space across the segments.
+      {
+        std::vector<std::string> values;
+        uint64_t expected_index = 0u;
+        for (const auto& e : impl.Iterate()) {
+          EXPECT_EQ(expected_index, e.idx_ts.index);
+          EXPECT_EQ(static_cast<int64_t>((expected_index + 1) * 10), e.idx_ts.us.count());
+          values.push_back(e.entry.s.substr(0, e.entry.s.find('.')));
+          ++expected_index;
+        }
+        EXPECT_EQ(50u, expected_index);
+        EXPECT_EQ("0,1,2,3,4,5,6,7,8,9", Join(std::vector<std::string>(values.begin(), values.begin() + 10), ','));
+      }
+      {
+        std::vector<std::string> values;
+        for (const auto& e : impl.IterateUnsafe(5, 45)) {
+          values.push_back(e.substr(0, e.find('\t')));
+        }
+        ASSERT_EQ(40u, values.size());
+        EXPECT_EQ("{\"index\":5,\"us\":60}", values.front());
+        EXPECT_EQ("{\"index\":44,\"us\":450}", values.back());
+      }
+      {
+        // Skipping over the entries, and over the whole segments, without dereferencing the iterators.
+        auto range = impl.Iterate(std::chrono::microseconds(95), std::chrono::microseconds(400));
+        auto it = range.begin();
+        for (int i = 9; i < 40; ++i, ++it) {
+          if (i % 13 == 0) {
+            EXPECT_EQ(static_cast<uint64_t>(i), (*it).idx_ts.index);
+          }
+        }
+        EXPECT_TRUE(it == range.end());
+      }
+      impl.UpdateHead(std::chrono::microseconds(1000));
+      impl.UpdateHead(std::chrono::microseconds(1001));
+    }
+    {
+      std::mutex mutex;
+      IMPL impl(mutex, namespace_name, directory, FileSegmentation::BySize(1000u));
+      EXPECT_EQ(50u, impl.Size());
+      EXPECT_EQ(1001, impl.CurrentHead().count());
+      ASSERT_THROW(impl.Publish(StorableString("nope"), std::chrono::microseconds(1001)),
+                   current::ss::InconsistentTimestampException);
+      impl.Publish(StorableString("50"), std::chrono::microseconds(1010));
+      EXPECT_EQ("50", (*impl.Iterate(50, 51).begin()).entry.s);
+      EXPECT_EQ("49" + padding, (*impl.Iterate(49, 50).begin()).entry.s);
+    }
+    {
+      // The segments of the stream are validated at startup.
+      std::mutex mutex;
+      ASSERT_THROW(IMPL(mutex, current::ss::StreamNamespaceName("namespace", "another_entry_name"), directory),
+                   current::persistence::InvalidStreamSignature);
+      current::FileSystem::WriteStringToFile("{\"segments\":[{\"name\":\"segment.00000000000000000001\"}]}",
+                                             current::FileSystem::JoinPath(directory, "manifest.json").c_str());
+      ASSERT_THROW(IMPL(mutex, namespace_name, directory), current::persistence::InvalidSegmentedFileManifest);
+    }
+  }
+
+  {
+    // The segments bounded by time.
+    CleanUp();
+    std::mutex mutex;
+    IMPL impl(mutex, namespace_name, directory, FileSegmentation::ByDuration(std::chrono::microseconds(100)));
+    for (int i = 0; i < 25; ++i) {
+      impl.Publish(StorableString(current::ToString(i)), std::chrono::microseconds((i + 1) * 10));
+    }
+    std::vector<std::string> begin_indexes;
+    for (const auto& segment : impl.Manifest().segments) {
+      begin_indexes.push_back(current::ToString(segment.begin_index));
+    }
+    EXPECT_EQ("0,10,20", Join(begin_indexes, ','));
+  }
+
+  {
+    // Dropping the old segments.
+    CleanUp();
+    {
+      std::mutex mutex;
+      IMPL impl(mutex, namespace_name, directory, FileSegmentation::BySize(1000u).Retaining(2u));
+      const auto range = impl.Iterate();
+      for (int i = 0; i < 50; ++i) {
+        impl.Publish(StorableString(current::ToString(i) + padding), std::chrono::microseconds((i + 1) * 10));
+      }
+      const auto manifest = impl.Manifest();
+      ASSERT_EQ(3u, manifest.segments.size());
+      EXPECT_EQ(manifest.segments.front().begin_index, impl.FirstAvailableIndex());
+      EXPECT_EQ("manifest.json," + manifest.segments[0].name + ',' + manifest.segments[1].name + ',' +
+                    manifest.segments[2].name,
+                ListFiles(directory));
+
+      const uint64_t first_index = impl.FirstAvailableIndex();
+      ASSERT_GT(first_index, 0u);
+      ASSERT_THROW(impl.Iterate(), current::persistence::EntryDroppedByRetentionException);
+      ASSERT_THROW(impl.IterateUnsafe(first_index - 1u), current::persistence::InvalidIterableRangeException);
+      uint64_t count = 0u;
+      for (const auto& e : impl.Iterate(first_index)) {
+        EXPECT_EQ(first_index + count, e.idx_ts.index);
+        ++count;
+      }
+      EXPECT_EQ(50u - first_index, count);
+      EXPECT_EQ(first_index,
+                impl.IndexRangeByTimestampRange(std::chrono::microseconds(0), std::chrono::microseconds(-1)).first);
+    }
+    {
+      std::mutex mutex;
+      IMPL impl(mutex, namespace_name, directory, FileSegmentation::BySize(1000u).Retaining(2u));
+      EXPECT_EQ(50u, impl.Size());
+      EXPECT_LT(0u, impl.FirstAvailableIndex());
+    }
+  }
+
+  {
+    // Archiving the old segments.
+    CleanUp();
+    {
+      std::mutex mutex;
+      IMPL impl(mutex, namespace_name, directory, FileSegmentation::BySize(1000u).Retaining(1u, archive_directory));
+      for (int i = 0; i < 50; ++i) {
+        impl.Publish(StorableString(current::ToString(i) + padding), std::chrono::microseconds((i + 1) * 10));
+      }
+      const auto manifest = impl.Manifest();
+      ASSERT_GT(manifest.segments.size(), 3u);
+      std::vector<std::string> archived;
+      for (size_t i = 0; i < manifest.segments.size(); ++i) {
+        EXPECT_EQ(i + 2 < manifest.segments.size(), manifest.segments[i].archived);
+        if (manifest.segments[i].archived) {
+          archived.push_back(manifest.segments[i].name);
+        }
+      }
+      EXPECT_EQ(Join(archived, ','), ListFiles(archive_directory));
+    }
+    {
+      std::mutex mutex;
+      IMPL impl(mutex, namespace_name, directory, FileSegmentation::BySize(1000u).Retaining(1u, archive_directory));
+      EXPECT_EQ(0u, impl.FirstAvailableIndex());
+      uint64_t count = 0u;
+      for (const auto& e : impl.Iterate()) {
+        EXPECT_EQ(count, e.idx_ts.index);
+        ++count;
+      }
+      EXPECT_EQ(50u, count);
+    }
+  }
+
+  CleanUp();
+}
+
+TEST(PersistenceLayer, SegmentedFileCompressed) {
+  current::time::ResetToZero();
+
+  using namespace persistence_test;
+
+  using IMPL = current::persistence::SegmentedFile<StorableString>;
+  using current::persistence::FileSegmentation;
+
+  const auto namespace_name = current::ss::StreamNamespaceName("namespace", "entry_name");
+  const std::string directory = current::FileSystem::JoinPath(FLAGS_persistence_test_tmpdir, "compressed");
+  current::FileSystem::RmDir(
+      directory, current::FileSystem::RmDirParameters::Silent, current::FileSystem::RmDirRecursive::Yes);
+
+  const auto segmentation = FileSegmentation::BySize(10000u).Compressed(1000u);
+  const auto Value = [](int i) {
+    return Printf("{\"event\":\"click\",\"user\":\"user_%d\",\"page\":\"home\"}", i % 5);
+  };
+  uint64_t compressed_size = 0u;
+  {
+    std::mutex mutex;
+    IMPL impl(mutex, namespace_name, directory, segmentation);
+    for (int i = 0; i < 500; ++i) {
+      impl.Publish(StorableString(Value(i)), std::chrono::microseconds((i + 1) * 10));
+      if (i % 100 == 50) {
+        impl.UpdateHead(std::chrono::microseconds((i + 1) * 10 + 5));
+      }
+    }
+
+    const auto manifest = impl.Manifest();
+    ASSERT_GT(manifest.segments.size(), 3u);
+    uint64_t raw_size = 0u;
+    for (const auto& segment : manifest.segments) {
+      if (segment.sealed) {
+        EXPECT_TRUE(segment.compressed);
+        // Only the compressed version of the sealed segment remains.
+        ASSERT_THROW(current::FileSystem::GetFileSize(current::FileSystem::JoinPath(directory, segment.name)),
+                     current::FileException);
+        compressed_size +=
+            current::FileSystem::GetFileSize(current::FileSystem::JoinPath(directory, segment.name + ".lz"));
+        raw_size += 10000u;
+      } else {
+        EXPECT_FALSE(segment.compressed);
+      }
+    }
+    EXPECT_LT(compressed_size * 3u, raw_size);
+
+    // Iterating over the whole stream.
+    {
+      int i = 0;
+      for (const auto& e : impl.Iterate()) {
+        EXPECT_EQ(static_cast<uint64_t>(i), e.idx_ts.index);
+        EXPECT_EQ(Value(i), e.entry.s);
+        ++i;
+      }
+      EXPECT_EQ(500, i);
+    }
+    // Seeking into the middle of the compressed segments, and across their blocks.
+    for (uint64_t begin : {1u, 42u, 137u, 250u, 333u}) {
+      uint64_t index = begin;
+      for (const auto& e : impl.IterateUnsafe(begin, begin + 100u)) {
+        EXPECT_EQ(JSON(idxts_t(index, std::chrono::microseconds((index + 1) * 10))) + '\t' +
+                      JSON(StorableString(Value(static_cast<int>(index)))),
+                  e);
+        ++index;
+      }
+      EXPECT_EQ(begin + 100u, index);
+    }
+    {
+      auto range = impl.Iterate(std::chrono::microseconds(1000), std::chrono::microseconds(4000));
+      auto it = range.begin();
+      for (int i = 99; i < 400; ++i, ++it) {
+        if (i % 50 == 0) {
+          EXPECT_EQ(Value(i), (*it).entry.s);
+        }
+      }
+      EXPECT_TRUE(it == range.end());
+    }
+  }
+  {
+    // The compressed segments are replayed at startup.
+    std::mutex mutex;
+    IMPL impl(mutex, namespace_name, directory, segmentation);
+    EXPECT_EQ(500u, impl.Size());
+    impl.Publish(StorableString("500"), std::chrono::microseconds(5010));
+    EXPECT_EQ(Value(499), (*impl.Iterate(499, 500).begin()).entry.s);
+  }
+  {
+    // A corrupted compressed segment is detected at startup.
+    const auto manifest = current::ParseJSON<current::persistence::SegmentedFileManifest>(
+        current::FileSystem::ReadFileAsString(current::FileSystem::JoinPath(directory, "manifest.json")));
+    const std::string path = current::FileSystem::JoinPath(directory, manifest.segments[1].name + ".lz");
+    std::string contents = current::FileSystem::ReadFileAsString(path);
+    contents[10] ^= 1;
+    current::FileSystem::RmFile(path);
+    current::FileSystem::WriteStringToFile(contents, path.c_str());
+    std::mutex mutex;
+    ASSERT_THROW(IMPL(mutex, namespace_name, directory, segmentation), current::persistence::MalformedEntryException);
+  }
+
+  current::FileSystem::RmDir(
+      directory, current::FileSystem::RmDirParameters::Silent, current::FileSystem::RmDirRecursive::Yes);
+}
+
+TEST(PersistenceLayer, CompactRecordIndex) {
+  using current::persistence::impl::CompactRecordIndex;
+  CompactRecordIndex index;
+  EXPECT_TRUE(index.empty());
+  EXPECT_EQ(0u, index.LowerBoundByTimestamp(std::chrono::microseconds(0)));
+  EXPECT_EQ(0u, index.UpperBoundByTimestamp(std::chrono::microseconds(0)));
+
+  // Offsets with occasional large gaps, timestamps with occasional duplicates.
+  const size_t n = CompactRecordIndex::kBlockSize * 100u + 7u;
+  std::vector<uint64_t> offsets;
+  std::vector<std::chrono::microseconds> timestamps;
+  uint64_t offset = 0u;
+  int64_t us = 1000;
+  for (size_t i = 0; i < n; ++i) {
+    offsets.push_back(offset);
+    timestamps.push_back(std::chrono::microseconds(us));
+    index.push_back(offset, std::chrono::microseconds(us));
+    offset += (i % 97u == 0u) ? (1ull << 40) : 30u + i % 20u;
+    us += (i % 5u == 0u) ? 0 : 1 + static_cast<int64_t>(i % 1000u);
+  }
+  ASSERT_EQ(n, index.size());
+  EXPECT_EQ(offsets.back(), index.LastOffset());
+  EXPECT_EQ(timestamps.back().count(), index.LastTimestamp().count());
+  for (size_t i = 0; i < n; ++i) {
+    ASSERT_EQ(offsets[i], index.Offset(i)) << i;
+    ASSERT_EQ(timestamps[i].count(), index.Timestamp(i).count()) << i;
+  }
+  for (int64_t t = timestamps.front().count() - 2; t <= timestamps.back().count() + 2; t += 7) {
+    const auto q = std::chrono::microseconds(t);
+    ASSERT_EQ(static_cast<size_t>(std::lower_bound(timestamps.begin(), timestamps.end(), q) - timestamps.begin()),
+              index.LowerBoundByTimestamp(q))
+        << t;
+    ASSERT_EQ(static_cast<size_t>(std::upper_bound(timestamps.begin(), timestamps.end(), q) - timestamps.begin()),
+              index.UpperBoundByTimestamp(q))
+        << t;
+  }
+  for (const auto q : timestamps) {
+    ASSERT_EQ(static_cast<size_t>(std::lower_bound(timestamps.begin(), timestamps.end(), q) - timestamps.begin()),
+              index.LowerBoundByTimestamp(q));
+    ASSERT_EQ(static_cast<size_t>(std::upper_bound(timestamps.begin(), timestamps.end(), q) - timestamps.begin()),
+              index.UpperBoundByTimestamp(q));
+  }
+
+  // Way less than the 16 bytes per record of two plain vectors of `int64_t`-s.
+  EXPECT_LT(index.MemoryUsed(), n * 8u);
+
+  index.clear();
+  EXPECT_TRUE(index.empty());
+  index.push_back(42u, std::chrono::microseconds(100));
+  EXPECT_EQ(42u, index.Offset(0));
+  EXPECT_EQ(1u, index.LowerBoundByTimestamp(std::chrono::microseconds(101)));
+}
+
+TEST(PersistenceLayer, ParseIdxTs) {
+  const auto Parse = [](const std::string& s) {
+    return JSON(current::persistence::impl::ParseIdxTs(s.data(), s.data() + s.length()));
+  };
+  EXPECT_EQ("{\"index\":0,\"us\":0}", Parse("{\"index\":0,\"us\":0}"));
+  EXPECT_EQ("{\"index\":42,\"us\":-100}", Parse("{\"index\":42,\"us\":-100}"));
+  EXPECT_EQ("{\"index\":999999999999999999,\"us\":1}", Parse("{\"index\":999999999999999999,\"us\":1}"));
+  // What is not in the very form `JSON()` writes is parsed by `ParseJSON()`.
+  EXPECT_EQ("{\"index\":18446744073709551615,\"us\":9223372036854775807}",
+            Parse("{\"index\":18446744073709551615,\"us\":9223372036854775807}"));
+  EXPECT_EQ("{\"index\":1,\"us\":2}", Parse("{\"us\":2,\"index\":1}"));
+  EXPECT_EQ("{\"index\":1,\"us\":2}", Parse(" { \"index\" : 1 , \"us\" : 2 } "));
+  EXPECT_EQ("{\"index\":1,\"us\":2}", Parse("{\"index\":1,\"us\":2,\"extra\":3}"));
+  // As are the errors.
+  EXPECT_THROW(Parse(""), current::serialization::json::InvalidJSONException);
+  EXPECT_THROW(Parse("{\"index\":1,\"us\":2"), current::serialization::json::InvalidJSONException);
+  EXPECT_THROW(Parse("{\"index\":1,\"us\":2}}"), current::serialization::json::InvalidJSONException);
+  EXPECT_THROW(Parse("{\"index\":01,\"us\":2}"), current::serialization::json::InvalidJSONException);
+  EXPECT_THROW(Parse("{\"index\":-1,\"us\":2}"), current::serialization::json::JSONSchemaException);
+  EXPECT_THROW(Parse("{\"index\":1,\"us\":-}"), current::serialization::json::InvalidJSONException);
+  EXPECT_THROW(Parse("{\"index\":1,\"us\":1.5}"), current::serialization::json::JSONSchemaException);
+}
+
 TEST(PersistenceLayer, MemoryIteratorPerformanceTest) {
   using namespace persistence_test;
   using IMPL = current::persistence::Memory<StorableString>;
@@ -36,9 +36,22 @@ SOFTWARE.
 // During startup, the binary also makes an atomic copy of the config file, making sure it is possible to make.
 //
 // On any error, an exception is thrown.
+//
+// For the config to be read from many threads while it is being reloaded or updated, each version of it is an
+// immutable snapshot, and the current one is swapped atomically. `Snapshot()` returns the current snapshot, and
+// a `SelfModifyingConfig<T>::Reader`, one per thread, returns it without as much as touching the reference counter
+// unless the config has changed since. With `WatchFile()`, the config is reloaded as soon as its file is changed,
+// with the notifications from the OS where available, and by checking the file once a second elsewhere.
 
 #include "../port.h"
 
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
 #include "exceptions.h"
 
 #include "../../typesystem/struct.h"
@@ -47,6 +60,13 @@ SOFTWARE.
 #include "../../bricks/file/file.h"
 #include "../../bricks/time/chrono.h"
 
+#if defined(CURRENT_POSIX) && !defined(CURRENT_APPLE) && __has_include(<sys/inotify.h>)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#define CURRENT_SELF_MODIFYING_CONFIG_INOTIFY
+#endif
+
 namespace current {
 
 struct SelfModifyingConfigHelper {
@@ -63,15 +83,19 @@ class SelfModifyingConfig final : public SelfModifyingConfigHelper {
 
  public:
   using config_t = CONFIG;
+  using snapshot_t = std::shared_ptr<const config_t>;
 
   // The path to the config file can be absolute or relative.
   explicit SelfModifyingConfig(const std::string& filename) : filename_(filename) {
     Reload();
-    Update(config_);  // Confirm the historical config file is writable.
+    Update(*snapshot_);  // Confirm the historical config file is writable.
   }
 
-  // Not thread-safe.
+  ~SelfModifyingConfig() { StopWatchingFile(); }
+
+  // Thread-safe. Keeps the config as is if the file has not changed.
   void Reload() {
+    std::lock_guard<std::mutex> lock(update_mutex_);
     // First, read the file.
     const std::string contents = [this]() -> std::string {
       try {
@@ -80,9 +104,12 @@ class SelfModifyingConfig final : public SelfModifyingConfigHelper {
         CURRENT_THROW(SelfModifyingConfigReadFileException(filename_));
       }
     }();
+    if (snapshot_ && contents == contents_) {
+      return;
+    }
     // Then, parse the JSON from it.
     try {
-      config_ = ParseJSON<config_t>(contents);
+      Publish(ParseJSON<config_t>(contents), contents);
     } catch (const current::serialization::json::InvalidJSONException&) {
       const std::string what = "File doesn't contain a valid JSON: '" + contents + "'";
       CURRENT_THROW(SelfModifyingConfigParseJSONException(what));
@@ -92,33 +119,155 @@ class SelfModifyingConfig final : public SelfModifyingConfigHelper {
     }
   }
 
-  // Not thread-safe.
+  // Thread-safe.
   void Update(const config_t& new_config, std::chrono::microseconds now = current::time::Now()) {
+    std::lock_guard<std::mutex> lock(update_mutex_);
     // First, save the current config under a new name.
-    // This could be atomic rename, but meh. -- D.K.
+    // This copy is only there for history, so it is not written atomically.
     const std::string new_filename = HistoricalFilename(filename_, now);
     try {
-      current::FileSystem::WriteStringToFile(JSON(config_), new_filename.c_str());
+      current::FileSystem::WriteStringToFile(JSON(*snapshot_), new_filename.c_str());
     } catch (const current::FileException&) {
       CURRENT_THROW(SelfModifyingConfigWriteFileException(new_filename));
     }
     // Then, update the config.
-    config_ = new_config;
-    // Finally, save the current config under the original config file name.
+    const std::string new_contents = JSON(new_config);
+    if (new_contents != contents_) {
+      Publish(new_config, new_contents);
+    }
+    // Finally, save the current config under the original config file name, atomically, so that a crash
+    // can not leave the config file truncated.
     try {
-      current::FileSystem::WriteStringToFile(JSON(config_), filename_.c_str());
+      current::FileSystem::WriteStringToFileAtomically(new_contents, filename_.c_str());
     } catch (const current::FileException&) {
       CURRENT_THROW(SelfModifyingConfigWriteFileException(filename_));
     }
   }
 
-  // Not thread-safe.
-  const config_t& Config() const { return config_; }
+  // Not thread-safe: the returned reference is only valid until the config is reloaded or updated.
+  const config_t& Config() const { return *snapshot_; }
   operator const config_t&() const { return Config(); }
 
+  // Thread-safe. The snapshot is immutable, and stays valid for as long as it is held.
+  snapshot_t Snapshot() const { return std::atomic_load(&snapshot_); }
+
+  // The number of the versions of the config so far, starting from one.
+  uint64_t Version() const { return version_.load(std::memory_order_acquire); }
+
+  // The lock-free accessor to the config for the hot paths. Not thread-safe itself: keep one per thread.
+  // Only checks the version of the config on each access, and takes the new snapshot if it has changed,
+  // so the returned reference is valid until the next access via the same `Reader`.
+  class Reader final {
+   public:
+    explicit Reader(const SelfModifyingConfig& config) : config_(config) {}
+
+    const config_t& operator*() {
+      const uint64_t version = config_.Version();
+      if (version != version_) {
+        snapshot_ = config_.Snapshot();
+        version_ = version;
+      }
+      return *snapshot_;
+    }
+    const config_t* operator->() { return &operator*(); }
+
+   private:
+    const SelfModifyingConfig& config_;
+    uint64_t version_ = 0u;
+    snapshot_t snapshot_;
+  };
+
+  // Reloads the config whenever its file changes, until destroyed. The contents of the file that can not be read
+  // or parsed are ignored, for the file may well be in the middle of being edited, and the config stays as is.
+  void WatchFile() {
+    std::lock_guard<std::mutex> lock(watcher_mutex_);
+    if (!watcher_.joinable()) {
+      stop_watching_ = false;
+      watcher_ = std::thread([this]() { WatcherThread(); });
+    }
+  }
+
  private:
+  // Called with `update_mutex_` locked.
+  void Publish(config_t new_config, std::string new_contents) {
+    std::atomic_store(&snapshot_, snapshot_t(std::make_shared<const config_t>(std::move(new_config))));
+    contents_ = std::move(new_contents);
+    version_.fetch_add(1u, std::memory_order_release);
+  }
+
+  void StopWatchingFile() {
+    std::lock_guard<std::mutex> lock(watcher_mutex_);
+    if (watcher_.joinable()) {
+      stop_watching_ = true;
+      watcher_.join();
+    }
+  }
+
+  void ReloadIgnoringErrors() {
+    try {
+      Reload();
+    } catch (const SelfModifyingConfigException&) {
+    }
+  }
+
+  void WatcherThread() {
+#ifdef CURRENT_SELF_MODIFYING_CONFIG_INOTIFY
+    // The directory is watched, not the file, as the updates replace the file by renaming the new one into it.
+    const size_t slash = filename_.rfind('/');
+    const std::string directory = slash == std::string::npos ? "." : (slash ? filename_.substr(0u, slash) : "/");
+    const std::string name = slash == std::string::npos ? filename_ : filename_.substr(slash + 1u);
+    const int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd >= 0 && ::inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) >= 0) {
+      alignas(struct inotify_event) char buffer[4096];
+      while (!stop_watching_) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (::poll(&pfd, 1, 100) <= 0) {
+          continue;
+        }
+        bool changed = false;
+        ssize_t length;
+        while ((length = ::read(fd, buffer, sizeof(buffer))) > 0) {
+          for (char* p = buffer; p < buffer + length;) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+            if (event->len && name == event->name) {
+              changed = true;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+          }
+        }
+        if (changed) {
+          ReloadIgnoringErrors();
+        }
+      }
+      ::close(fd);
+      return;
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+#endif  // CURRENT_SELF_MODIFYING_CONFIG_INOTIFY
+    // No notifications from the OS, so check the file once a second.
+    auto next_check = std::chrono::steady_clock::now();
+    while (!stop_watching_) {
+      if (std::chrono::steady_clock::now() >= next_check) {
+        ReloadIgnoringErrors();
+        next_check += std::chrono::seconds(1);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+  }
+
   const std::string filename_;
-  config_t config_;
+  // Guards the updates of the config, not its reads.
+  std::mutex update_mutex_;
+  snapshot_t snapshot_;
+  std::atomic<uint64_t> version_{0u};
+  // The JSON of the current config, as it is in the file.
+  std::string contents_;
+
+  std::mutex watcher_mutex_;
+  std::atomic_bool stop_watching_{false};
+  std::thread watcher_;
 };
 
 }  // namespace current
@@ -97,7 +97,7 @@ TEST(SelfModifyingConfig, ReadFileException) {
     EXPECT_EQ("SelfModifyingConfigReadFileException(filename_)", e.Caller());
     EXPECT_EQ(".current/ReadFileExceptionConfig", e.OriginalDescription());
     ExpectStringEndsWith("config.h", e.File());
-    EXPECT_EQ(80, e.Line());
+    EXPECT_EQ(104, e.Line());
   }
 }
 
@@ -125,7 +125,7 @@ TEST(SelfModifyingConfig, ParseJSONException) {
     EXPECT_EQ("SelfModifyingConfigParseJSONException(what)", e.Caller());
     EXPECT_EQ("File doesn't contain a valid JSON: 'De Louboutin.'", e.OriginalDescription());
     ExpectStringEndsWith("config.h", e.File());
-    EXPECT_EQ(88, e.Line());
+    EXPECT_EQ(115, e.Line());
   }
 }
 
@@ -155,6 +155,86 @@ TEST(SelfModifyingConfig, WriteFileException) {
     EXPECT_EQ("SelfModifyingConfigWriteFileException(new_filename)", e.Caller());
     EXPECT_EQ(".current/WriteFileExceptionConfig.19830816-000000", e.OriginalDescription());
     ExpectStringEndsWith("config.h", e.File());
-    EXPECT_EQ(103, e.Line());
+    EXPECT_EQ(131, e.Line());
   }
 }
+
+TEST(SelfModifyingConfig, SnapshotsAndReaders) {
+  current::time::ResetToZero();
+
+  const std::string config_filename =
+      current::FileSystem::JoinPath(FLAGS_self_modifying_config_test_tmpdir, CurrentTestName() + "Config");
+  const auto original_file_remover = current::FileSystem::ScopedRmFile(config_filename);
+
+  const std::string historical_filename = config_filename + ".19700101-000000";
+  const auto historical_file_remover = current::FileSystem::ScopedRmFile(historical_filename);
+
+  current::FileSystem::WriteStringToFile(JSON(UnitTestSelfModifyingConfig(1)), config_filename.c_str());
+
+  current::SelfModifyingConfig<UnitTestSelfModifyingConfig> config(config_filename);
+  EXPECT_EQ(1u, config.Version());
+
+  const auto snapshot = config.Snapshot();
+  current::SelfModifyingConfig<UnitTestSelfModifyingConfig>::Reader reader(config);
+  EXPECT_EQ(1, reader->x);
+
+  // The readers on other threads see each update in full, and in order.
+  std::atomic_bool done(false);
+  std::thread other_reader([&config, &done]() {
+    current::SelfModifyingConfig<UnitTestSelfModifyingConfig>::Reader reader(config);
+    int32_t last = 0;
+    while (!done) {
+      const int32_t x = (*reader).x;
+      EXPECT_LE(last, x);
+      last = x;
+    }
+    EXPECT_EQ(100, (*reader).x);
+  });
+  for (int32_t x = 2; x <= 100; ++x) {
+    config.Update(UnitTestSelfModifyingConfig(x), std::chrono::microseconds(0));
+  }
+  done = true;
+  other_reader.join();
+
+  EXPECT_EQ(100u, config.Version());
+  EXPECT_EQ(100, reader->x);
+  EXPECT_EQ(100, config.Snapshot()->x);
+  // The snapshots taken before are intact.
+  EXPECT_EQ(1, snapshot->x);
+
+  // Reloading the file unchanged keeps the config as is.
+  config.Reload();
+  EXPECT_EQ(100u, config.Version());
+}
+
+TEST(SelfModifyingConfig, WatchFile) {
+  current::time::ResetToZero();
+
+  const std::string config_filename =
+      current::FileSystem::JoinPath(FLAGS_self_modifying_config_test_tmpdir, CurrentTestName() + "Config");
+  const auto original_file_remover = current::FileSystem::ScopedRmFile(config_filename);
+
+  const std::string historical_filename = config_filename + ".19700101-000000";
+  const auto historical_file_remover = current::FileSystem::ScopedRmFile(historical_filename);
+
+  current::FileSystem::WriteStringToFile(JSON(UnitTestSelfModifyingConfig(1)), config_filename.c_str());
+
+  current::SelfModifyingConfig<UnitTestSelfModifyingConfig> config(config_filename);
+  config.WatchFile();
+
+  const auto wait_for_x = [&config](int32_t x) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (config.Snapshot()->x != x && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return config.Snapshot()->x;
+  };
+
+  current::FileSystem::WriteStringToFileAtomically(JSON(UnitTestSelfModifyingConfig(2)), config_filename.c_str());
+  EXPECT_EQ(2, wait_for_x(2));
+
+  // The file that does not parse is ignored, and the config stays as is until the file is fixed.
+  current::FileSystem::WriteStringToFile("{\"x\":", config_filename.c_str());
+  current::FileSystem::WriteStringToFile(JSON(UnitTestSelfModifyingConfig(3)), config_filename.c_str());
+  EXPECT_EQ(3, wait_for_x(3));
+}
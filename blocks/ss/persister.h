@@ -30,7 +30,11 @@ SOFTWARE.
 #ifndef BLOCKS_SS_PERSISTER_H
 #define BLOCKS_SS_PERSISTER_H
 
+#include <cstddef>
+#include <string>
+#include <string_view>
 #include <type_traits>
+#include <utility>
 
 #include "idx_ts.h"
 #include "types.h"
@@ -41,6 +45,15 @@ SOFTWARE.
 namespace current {
 namespace ss {
 
+// A run of consecutive entries `[begin_index, end_index)` in their persisted form, `JSON(idxts)\tJSON(entry)\n` each,
+// back to back, as `size` bytes at `data`. Points straight into the persisted data, valid for the duration of the call.
+struct RawEntriesSpan {
+  const char* data;
+  size_t size;
+  uint64_t begin_index;
+  uint64_t end_index;
+};
+
 struct GenericPersister {};
 
 template <typename ENTRY>
@@ -83,6 +96,28 @@ class EntryPersister : public GenericEntryPersister<ENTRY>, public IMPL {
     return IMPL::template PersisterPublishUnsafeImpl<MLS>(raw_log_line, us);
   }
 
+  // Publishes the entry serialized by the caller, as `JSON(ENTRY)`, without parsing and validating it, so that the
+  // serialization can take place before the publishing mutex is locked. Only available for the persisters that store
+  // the entries in this form, see `PersisterAcceptsSerializedEntries` below.
+  template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock>
+  idxts_t PublishSerialized(const std::string& entry_json,
+                            current::time::DefaultTimeArgument = current::time::DefaultTimeArgument()) {
+    return IMPL::template PersisterPublishSerializedImpl<MLS>(entry_json, current::time::DefaultTimeArgument());
+  }
+
+  template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock>
+  idxts_t PublishSerialized(const std::string& entry_json, std::chrono::microseconds us) {
+    return IMPL::template PersisterPublishSerializedImpl<MLS>(entry_json, us);
+  }
+
+  // Publishes the back-to-back raw log lines, in the form `IterateRawSpans` passes them, in one go. As with
+  // `PublishUnsafe`, only the indexes and the timestamps are checked. Only available for the persisters that
+  // store the entries in this form, see `PersisterAcceptsRawEntries` below.
+  template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock>
+  idxts_t PublishRawEntries(std::string_view raw_entries) {
+    return IMPL::template PersisterPublishRawEntriesImpl<MLS>(raw_entries);
+  }
+
   template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock>
   void UpdateHead(current::time::DefaultTimeArgument = current::time::DefaultTimeArgument()) {
     return IMPL::template PersisterUpdateHeadImpl<MLS>(current::time::DefaultTimeArgument());
@@ -93,6 +128,9 @@ class EntryPersister : public GenericEntryPersister<ENTRY>, public IMPL {
     return IMPL::template PersisterUpdateHeadImpl<MLS>(us);
   }
 
+  // Blocks until the entries up to and including `index` are durable. Only available for persisters that sync to disk.
+  void WaitUntilDurable(uint64_t index) const { IMPL::PersisterWaitUntilDurableImpl(index); }
+
   template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock>
   bool Empty() const {
     return IMPL::template PersisterEmptyImpl<MLS>();
@@ -136,6 +174,14 @@ class EntryPersister : public GenericEntryPersister<ENTRY>, public IMPL {
     return IMPL::template PersisterIterateUnsafe<MLS>(begin, end);
   }
 
+  // Calls `f(const RawEntriesSpan&)` for the entries in `[begin, end)`, in as few spans as the persister can,
+  // without parsing or copying them. Stops if `f` returns `false`. Only available for the persisters that store the
+  // entries in this form, see `PersisterServesRawEntriesSpans` below.
+  template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock, typename F>
+  void IterateRawSpans(uint64_t begin, uint64_t end, F&& f) const {
+    IMPL::template PersisterIterateRawSpans<MLS>(begin, end, std::forward<F>(f));
+  }
+
   template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock>
   IterableRange Iterate(std::chrono::microseconds from,
                         std::chrono::microseconds till = std::chrono::microseconds(-1)) const {
@@ -161,6 +207,48 @@ struct IsEntryPersister {
   static constexpr bool value = std::is_base_of_v<GenericEntryPersister<E>, T>;
 };
 
+template <typename T, typename = void>
+struct PersisterServesRawEntriesSpans {
+  static constexpr bool value = false;
+};
+
+template <typename T>
+struct PersisterServesRawEntriesSpans<
+    T,
+    std::void_t<decltype(std::declval<const T&>()
+                             .template PersisterIterateRawSpans<current::locks::MutexLockStatus::NeedToLock>(
+                                 0u, 0u, std::declval<bool (*)(const RawEntriesSpan&)>()))>> {
+  static constexpr bool value = true;
+};
+
+template <typename T, typename = void>
+struct PersisterAcceptsRawEntries {
+  static constexpr bool value = false;
+};
+
+template <typename T>
+struct PersisterAcceptsRawEntries<
+    T,
+    std::void_t<decltype(std::declval<T&>()
+                             .template PersisterPublishRawEntriesImpl<current::locks::MutexLockStatus::NeedToLock>(
+                                 std::declval<std::string_view>()))>> {
+  static constexpr bool value = true;
+};
+
+template <typename T, typename = void>
+struct PersisterAcceptsSerializedEntries {
+  static constexpr bool value = false;
+};
+
+template <typename T>
+struct PersisterAcceptsSerializedEntries<
+    T,
+    std::void_t<decltype(std::declval<T&>()
+                             .template PersisterPublishSerializedImpl<current::locks::MutexLockStatus::NeedToLock>(
+                                 std::declval<const std::string&>(), std::declval<std::chrono::microseconds>()))>> {
+  static constexpr bool value = true;
+};
+
 }  // namespace ss
 }  // namespace current
 
@@ -27,10 +27,12 @@ SOFTWARE.
 #define BLOCKS_SS_PUBSUB_H
 
 #include <type_traits>
+#include <utility>
 
 #include "../../port.h"
 
 #include "idx_ts.h"
+#include "persister.h"
 #include "types.h"
 
 #include "../../typesystem/variant.h"
@@ -80,6 +82,23 @@ class EntryPublisher : public GenericEntryPublisher<ENTRY>, public IMPL {
     return IMPL::template PublisherPublishUnsafeImpl<MLS>(raw_log_line);
   }
 
+  // Publishes the entry serialized by the caller as `JSON(ENTRY)`, see `EntryPersister::PublishSerialized()`.
+  template <MutexLockStatus MLS = MutexLockStatus::NeedToLock>
+  idxts_t PublishSerialized(const std::string& entry_json) {
+    return IMPL::template PublisherPublishSerializedImpl<MLS>(entry_json, current::time::DefaultTimeArgument());
+  }
+
+  template <MutexLockStatus MLS = MutexLockStatus::NeedToLock>
+  idxts_t PublishSerialized(const std::string& entry_json, std::chrono::microseconds us) {
+    return IMPL::template PublisherPublishSerializedImpl<MLS>(entry_json, us);
+  }
+
+  // Publishes the back-to-back raw log lines, see `EntryPersister::PublishRawEntries()`.
+  template <MutexLockStatus MLS = MutexLockStatus::NeedToLock>
+  idxts_t PublishRawEntries(std::string_view raw_entries) {
+    return IMPL::template PublisherPublishRawEntriesImpl<MLS>(raw_entries);
+  }
+
   template <MutexLockStatus MLS = MutexLockStatus::NeedToLock>
   void UpdateHead() {
     IMPL::template PublisherUpdateHeadImpl<MLS>(current::time::DefaultTimeArgument());
@@ -123,6 +142,95 @@ struct IsStreamPublisher {
 enum class EntryResponse { Done = 0, More = 1 };
 enum class TerminationResponse { Wait = 0, Terminate = 1 };
 
+// A batch of consecutive entries, passed at once to the subscribers that accept them in bulk.
+// The entries and their indexes and timestamps are two arrays of `Size()` elements each.
+// NOTE: The batch, as well as the entries it points to, is only valid for the duration of the call.
+template <typename ENTRY>
+class EntriesBatch final {
+ public:
+  struct Element {
+    const ENTRY& entry;
+    const idxts_t idx_ts;
+  };
+
+  class Iterator final {
+   public:
+    Iterator(const EntriesBatch& batch, size_t i) : batch_(batch), i_(i) {}
+    Element operator*() const { return Element{batch_.Entry(i_), batch_.IdxTs(i_)}; }
+    Iterator& operator++() {
+      ++i_;
+      return *this;
+    }
+    bool operator==(const Iterator& rhs) const { return i_ == rhs.i_; }
+    bool operator!=(const Iterator& rhs) const { return !operator==(rhs); }
+
+   private:
+    const EntriesBatch& batch_;
+    size_t i_;
+  };
+
+  EntriesBatch(const ENTRY* const* entries, const idxts_t* idx_ts, size_t size)
+      : entries_(entries), idx_ts_(idx_ts), size_(size) {}
+
+  size_t Size() const { return size_; }
+  bool Empty() const { return !size_; }
+
+  const ENTRY& Entry(size_t i) const {
+    CURRENT_ASSERT(i < size_);
+    return *entries_[i];
+  }
+  idxts_t IdxTs(size_t i) const {
+    CURRENT_ASSERT(i < size_);
+    return idx_ts_[i];
+  }
+
+  Iterator begin() const { return Iterator(*this, 0u); }
+  Iterator end() const { return Iterator(*this, size_); }
+
+ private:
+  EntriesBatch(const EntriesBatch&) = delete;
+  EntriesBatch& operator=(const EntriesBatch&) = delete;
+
+  const ENTRY* const* entries_;
+  const idxts_t* idx_ts_;
+  const size_t size_;
+};
+
+namespace impl {
+
+// Whether `T` has `EntryResponse operator()(const EntriesBatch<ENTRY>& batch, idxts_t last)`.
+template <typename T, typename ENTRY, typename = void>
+struct HasEntriesBatchOperator {
+  static constexpr bool value = false;
+};
+
+template <typename T, typename ENTRY>
+struct HasEntriesBatchOperator<
+    T,
+    ENTRY,
+    std::void_t<decltype(std::declval<T&>()(std::declval<const EntriesBatch<ENTRY>&>(), std::declval<idxts_t>()))>> {
+  static constexpr bool value =
+      std::is_same_v<decltype(std::declval<T&>()(std::declval<const EntriesBatch<ENTRY>&>(), std::declval<idxts_t>())),
+                     EntryResponse>;
+};
+
+// Whether `T` has `EntryResponse operator()(const RawEntriesSpan& span, idxts_t last)`.
+template <typename T, typename = void>
+struct HasRawEntriesSpanOperator {
+  static constexpr bool value = false;
+};
+
+template <typename T>
+struct HasRawEntriesSpanOperator<
+    T,
+    std::void_t<decltype(std::declval<T&>()(std::declval<const RawEntriesSpan&>(), std::declval<idxts_t>()))>> {
+  static constexpr bool value =
+      std::is_same_v<decltype(std::declval<T&>()(std::declval<const RawEntriesSpan&>(), std::declval<idxts_t>())),
+                     EntryResponse>;
+};
+
+}  // namespace impl
+
 struct GenericSubscriber {};
 
 template <typename ENTRY>
@@ -144,6 +252,20 @@ class EntrySubscriber : public GenericEntrySubscriber<ENTRY>, public IMPL {
   }
   EntryResponse operator()(std::chrono::microseconds ts) { return IMPL::operator()(ts); }
 
+  // The subscribers that implement the batch signature are passed the entries in batches, where possible.
+  // The response to the batch applies to all of its entries: `Done` means no more entries after this batch.
+  template <typename I = IMPL, class = std::enable_if_t<impl::HasEntriesBatchOperator<I, ENTRY>::value>>
+  EntryResponse operator()(const EntriesBatch<ENTRY>& batch, idxts_t last) {
+    return I::operator()(batch, last);
+  }
+
+  // The unchecked subscribers that implement the raw spans signature are passed the entries exactly as persisted,
+  // in spans, where the persister supports it. As with batches, the response applies to the whole span.
+  template <typename I = IMPL, class = std::enable_if_t<impl::HasRawEntriesSpanOperator<I>::value>>
+  EntryResponse operator()(const RawEntriesSpan& span, idxts_t last) {
+    return I::operator()(span, last);
+  }
+
   // If a type-filtered subscriber hits the end which it doesn't see as the last entry does not pass the filter,
   // we need a way to ask that subscriber whether it wants to terminate or continue.
   EntryResponse EntryResponseIfNoMorePassTypeFilter() const { return IMPL::EntryResponseIfNoMorePassTypeFilter(); }
@@ -175,6 +297,19 @@ struct IsStreamSubscriber {
   static constexpr bool value = std::is_base_of_v<GenericStreamSubscriber<current::decay_t<E>>, current::decay_t<T>>;
 };
 
+// Whether the subscriber to `E` accepts the entries in batches, see `EntriesBatch` above.
+template <typename T, typename E>
+struct IsBatchEntrySubscriber {
+  static constexpr bool value =
+      IsEntrySubscriber<T, E>::value && impl::HasEntriesBatchOperator<current::decay_t<T>, current::decay_t<E>>::value;
+};
+
+// Whether the subscriber accepts the raw entries in spans, see `RawEntriesSpan` in `persister.h`.
+template <typename T>
+struct IsRawEntriesSpanSubscriber {
+  static constexpr bool value = IsSubscriber<T>::value && impl::HasRawEntriesSpanOperator<current::decay_t<T>>::value;
+};
+
 namespace impl {
 
 template <typename TYPE_SUBSCRIBED_TO, typename STREAM_UNDERLYING_VARIANT>
@@ -31,9 +31,11 @@ SOFTWARE.
 #include <cctype>
 #include <cstring>
 #include <map>
+#include <memory>
 #include <set>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <vector>
 
@@ -193,11 +195,89 @@ struct URLWithoutParametersParser {
   }
 };
 
+// Sets the fields of `TOP_LEVEL_T` from the query parameters. The `SOURCE` of the parameters provides
+// `const std::string* Find(const std::string& key) const`, returning the decoded value, or `nullptr` if not present.
+template <typename TOP_LEVEL_T, FillObjectMode MODE, typename SOURCE>
+struct QueryParametersObjectFiller {
+  const SOURCE& q;
+
+  // The `std::string` is a special case, as no quotes are expected.
+  void operator()(const std::string& key, std::string& value) const {
+    if (const std::string* found = q.Find(key)) {
+      value = *found;
+    } else if (MODE == FillObjectMode::Strict) {
+      CURRENT_THROW(URLParseSpecificObjectAsURLParameterException<TOP_LEVEL_T>(key, "missing value"));
+    }
+  }
+
+  // The `bool` is a special case as well, as a) just `?b` should set `b` to true,
+  // and b) Current supports 0/1, false/true, False/True, and FALSE/TRUE.
+  void operator()(const std::string& key, bool& value) const {
+    if (const std::string* found = q.Find(key)) {
+      if (found->empty()) {
+        value = true;  // Just `?b` sets `b` to true.
+      } else if (MODE == FillObjectMode::Forgiving) {
+        current::FromString(*found, value);
+      } else {
+        try {
+          ParseJSON(*found, value);
+        } catch (const current::TypeSystemParseJSONException& exception) {
+          CURRENT_THROW(
+              URLParseSpecificObjectAsURLParameterException<TOP_LEVEL_T>(key, exception.OriginalDescription()));
+        }
+      }
+    }
+  }
+
+  // `Optional<>`-s are special cases, as they can be missing.
+  template <typename V>
+  void operator()(const std::string& key, Optional<V>& value) const {
+    if (q.Find(key)) {
+      value = V();
+      operator()(key, Value(value));
+    }
+  }
+
+  // For the remaining field types, use `ParseJSON`. Overkill, but ensures any `CURRENT_STRUCT` can be URL-encoded.
+  template <typename V>
+  void operator()(const std::string& key, V& value) const {
+    if (const std::string* found = q.Find(key)) {
+      try {
+        ParseJSON(*found, value);
+      } catch (const current::TypeSystemParseJSONException& exception) {
+        CURRENT_THROW(
+            URLParseSpecificObjectAsURLParameterException<TOP_LEVEL_T>(key, exception.OriginalDescription()));
+      }
+    } else if (MODE == FillObjectMode::Strict) {
+      CURRENT_THROW(URLParseSpecificObjectAsURLParameterException<TOP_LEVEL_T>(key, "missing value"));
+    }
+  }
+};
+
+// Populates the fields of a `CURRENT_STRUCT`, its base ones included, from the query parameters.
+template <typename T, FillObjectMode MODE>
+struct QueryParametersFillObjectImpl {
+  template <typename SOURCE>
+  static void DoIt(const SOURCE& source, T& object) {
+    using decayed_t = current::decay_t<T>;
+    using super_t = current::reflection::SuperType<decayed_t>;
+    QueryParametersFillObjectImpl<super_t, MODE>::DoIt(source, static_cast<super_t&>(object));
+    QueryParametersObjectFiller<T, MODE, SOURCE> parser{source};
+    current::reflection::VisitAllFields<T, current::reflection::FieldNameAndMutableValue>::WithObject(object, parser);
+  }
+};
+
+template <FillObjectMode MODE>
+struct QueryParametersFillObjectImpl<CurrentStruct, MODE> {
+  template <typename SOURCE>
+  static void DoIt(const SOURCE&, CurrentStruct&) {}
+};
+
 struct URLParametersExtractor {
  protected:
   URLParametersExtractor() = default;
 
-  void ExtractURLParametersFromURL(std::string url, size_t& parameters_start_index) {
+  void ExtractURLParametersFromURL(const std::string& url, size_t& parameters_start_index) {
     parameters_start_index = url.length();
     const size_t pound_sign_index = url.find('#');
     if (pound_sign_index != std::string::npos) {
@@ -206,22 +286,8 @@ struct URLParametersExtractor {
     }
     const size_t question_mark_index = url.find('?');
     if (question_mark_index != std::string::npos && question_mark_index < pound_sign_index) {
-      auto& v = parameters_vector;
-      current::strings::Split(url.substr(question_mark_index + 1, parameters_start_index - (question_mark_index + 1)),
-                              '&',
-                              [&v](const std::string& chunk) {
-                                const size_t i = chunk.find('=');
-                                if (i != std::string::npos) {
-                                  v.emplace_back(chunk.substr(0, i), chunk.substr(i + 1));
-                                } else {
-                                  v.emplace_back(chunk, "");
-                                }
-                              });
-      for (auto& it : parameters_vector) {
-        it.first = DecodeURIComponent(it.first);
-        it.second = DecodeURIComponent(it.second);
-      }
-      query = QueryParameters(parameters_vector);
+      query = QueryParameters(
+          url.substr(question_mark_index + 1, parameters_start_index - (question_mark_index + 1)));
       parameters_start_index = question_mark_index;
     }
   }
@@ -236,20 +302,48 @@ struct URLParametersExtractor {
             c == '.' || c == '~' || c == '!' || c == '\'' || c == '(' || c == ')');
   }
 
-  static std::string DecodeURIComponent(const std::string& encoded) {
-    std::ostringstream decoded;
+  static int HexDigitValue(char c) { return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10; }
+
+  // Calls `f(c)` for each character of the decoded `encoded`, for as long as `f` returns `true`.
+  // Returns `false` if stopped early.
+  template <typename F>
+  static bool ForEachDecodedCharacter(std::string_view encoded, F&& f) {
     for (size_t i = 0; i < encoded.length(); ++i) {
       const char c = encoded[i];
       if (c == '+') {
-        decoded << ' ';
+        if (!f(' ')) {
+          return false;
+        }
       } else if (c == '%' && i + 3 <= encoded.length() && IsHexDigit(encoded[i + 1]) && IsHexDigit(encoded[i + 2])) {
-        decoded << static_cast<char>(std::stoi(encoded.substr(i + 1, 2).c_str(), nullptr, 16));
+        if (!f(static_cast<char>(HexDigitValue(encoded[i + 1]) * 16 + HexDigitValue(encoded[i + 2])))) {
+          return false;
+        }
         i += 2;
-      } else {
-        decoded << c;
+      } else if (!f(c)) {
+        return false;
       }
     }
-    return decoded.str();
+    return true;
+  }
+
+  static std::string DecodeURIComponent(std::string_view encoded) {
+    std::string decoded;
+    decoded.reserve(encoded.length());
+    ForEachDecodedCharacter(encoded, [&decoded](char c) {
+      decoded += c;
+      return true;
+    });
+    return decoded;
+  }
+
+  // Whether `encoded`, once decoded, equals `decoded`. Allocates nothing.
+  static bool DecodedURIComponentEquals(std::string_view encoded, std::string_view decoded) {
+    if (decoded.length() > encoded.length()) {
+      return false;
+    }
+    size_t i = 0;
+    return ForEachDecodedCharacter(encoded, [&](char c) { return i < decoded.length() && decoded[i++] == c; }) &&
+           i == decoded.length();
   }
 
   static std::string EncodeURIComponent(const std::string& decoded) {
@@ -268,6 +362,7 @@ struct URLParametersExtractor {
 
   std::string ComposeParameters() const {
     std::string composed_parameters;
+    const auto& parameters_vector = query.AsVector();
     for (size_t i = 0; i < parameters_vector.size(); ++i) {
       composed_parameters += "?&"[i > 0];
       composed_parameters +=
@@ -279,27 +374,43 @@ struct URLParametersExtractor {
     return composed_parameters;
   }
 
+  // The query parameters are decoded from the raw query string on the first access to any of them, as most
+  // URLs parsed, those of the HTTP requests served in particular, never have their query looked at.
+  // The decoded parameters are immutable once built, and are shared by the copies of this object.
   struct QueryParameters {
     QueryParameters() = default;
+    explicit QueryParameters(std::string raw_query) : raw_query_(std::move(raw_query)) {}
     QueryParameters(const std::vector<std::pair<std::string, std::string>>& parameters_vector)
-        : parameters_(parameters_vector.begin(), parameters_vector.end()) {}
+        : decoded_(std::make_shared<const Decoded>(parameters_vector)) {}
+    QueryParameters(const QueryParameters& rhs)
+        : raw_query_(rhs.raw_query_), decoded_(std::atomic_load(&rhs.decoded_)) {}
+    QueryParameters& operator=(const QueryParameters& rhs) {
+      raw_query_ = rhs.raw_query_;
+      decoded_ = std::atomic_load(&rhs.decoded_);
+      return *this;
+    }
+
     inline std::string operator[](const std::string& key) const { return get(key, ""); }
-    inline bool has(const std::string& key) const { return parameters_.find(key) != parameters_.end(); }
+    inline bool has(const std::string& key) const { return Find(key) != nullptr; }
     inline const std::string& get(const std::string& key, const std::string& default_value) const {
-      const auto cit = parameters_.find(key);
-      if (cit != parameters_.end()) {
-        return cit->second;
-      } else {
-        return default_value;
-      }
+      const std::string* value = Find(key);
+      return value ? *value : default_value;
+    }
+    const std::map<std::string, std::string>& AsImmutableMap() const { return Decode().map; }
+    // The parameters in the order they are in the query string, with the repeated keys, if any, repeated.
+    const std::vector<std::pair<std::string, std::string>>& AsVector() const { return Decode().vector; }
+
+    // The value of the parameter `key`, or `nullptr`. For the repeated keys, the first value is the one.
+    const std::string* Find(const std::string& key) const {
+      const auto& map = Decode().map;
+      const auto cit = map.find(key);
+      return cit != map.end() ? &cit->second : nullptr;
     }
-    const std::map<std::string, std::string>& AsImmutableMap() const { return parameters_; }
-    std::map<std::string, std::string> parameters_;
 
     // NOTE: `FillObject` only populates the fields present in the URL; it doesn't erase what's not in the querystring.
     template <typename T, FillObjectMode MODE = FillObjectMode::Forgiving>
     std::enable_if_t<IS_CURRENT_STRUCT(T), const T&> FillObject(T& object) const {
-      FillObjectImpl<T, MODE>::DoIt(parameters_, object);
+      QueryParametersFillObjectImpl<T, MODE>::DoIt(*this, object);
       return object;
     }
 
@@ -311,88 +422,42 @@ struct URLParametersExtractor {
     }
 
    private:
-    template <typename T, FillObjectMode MODE>
-    struct FillObjectImpl {
-      static void DoIt(const std::map<std::string, std::string>& parameters, T& object) {
-        using decayed_t = current::decay_t<T>;
-        using super_t = current::reflection::SuperType<decayed_t>;
-        FillObjectImpl<super_t, MODE>::DoIt(parameters, static_cast<super_t&>(object));
-        QueryParametersObjectFiller<T, MODE> parser{parameters};
-        current::reflection::VisitAllFields<T, current::reflection::FieldNameAndMutableValue>::WithObject(object,
-                                                                                                          parser);
-      }
+    struct Decoded final {
+      std::vector<std::pair<std::string, std::string>> vector;
+      std::map<std::string, std::string> map;
+      explicit Decoded(std::vector<std::pair<std::string, std::string>> parameters_vector)
+          : vector(std::move(parameters_vector)), map(vector.begin(), vector.end()) {}
     };
 
-    template <FillObjectMode MODE>
-    struct FillObjectImpl<CurrentStruct, MODE> {
-      static void DoIt(const std::map<std::string, std::string>&, CurrentStruct&) {}
-    };
-
-    template <typename TOP_LEVEL_T, FillObjectMode MODE>
-    struct QueryParametersObjectFiller {
-      const std::map<std::string, std::string>& q;
-
-      // The `std::string` is a special case, as no quotes are expected.
-      void operator()(const std::string& key, std::string& value) const {
-        const auto cit = q.find(key);
-        if (cit != q.end()) {
-          value = cit->second;
-        } else if (MODE == FillObjectMode::Strict) {
-          CURRENT_THROW(URLParseSpecificObjectAsURLParameterException<TOP_LEVEL_T>(key, "missing value"));
-        }
-      }
-
-      // The `bool` is a special case as well, as a) just `?b` should set `b` to true,
-      // and b) Current supports 0/1, false/true, False/True, and FALSE/TRUE.
-      void operator()(const std::string& key, bool& value) const {
-        const auto cit = q.find(key);
-        if (cit != q.end()) {
-          if (cit->second.empty()) {
-            value = true;  // Just `?b` sets `b` to true.
-          } else if (MODE == FillObjectMode::Forgiving) {
-            current::FromString(cit->second, value);
+    // Thread-safe: should several threads decode the same parameters at once, the first one to finish wins.
+    const Decoded& Decode() const {
+      std::shared_ptr<const Decoded> decoded = std::atomic_load(&decoded_);
+      if (!decoded) {
+        std::vector<std::pair<std::string, std::string>> v;
+        current::strings::Split(raw_query_, '&', [&v](const std::string& chunk) {
+          const size_t i = chunk.find('=');
+          if (i != std::string::npos) {
+            v.emplace_back(DecodeURIComponent(std::string_view(chunk).substr(0, i)),
+                           DecodeURIComponent(std::string_view(chunk).substr(i + 1)));
           } else {
-            try {
-              ParseJSON(cit->second, value);
-            } catch (const current::TypeSystemParseJSONException& exception) {
-              CURRENT_THROW(
-                  URLParseSpecificObjectAsURLParameterException<TOP_LEVEL_T>(key, exception.OriginalDescription()));
-            }
+            v.emplace_back(DecodeURIComponent(chunk), "");
           }
+        });
+        std::shared_ptr<const Decoded> expected;
+        decoded = std::make_shared<const Decoded>(std::move(v));
+        if (!std::atomic_compare_exchange_strong(&decoded_, &expected, decoded)) {
+          decoded = std::move(expected);
         }
       }
+      return *decoded;
+    }
 
-      // `Optional<>`-s are special cases, as they can be missing.
-      template <typename T>
-      void operator()(const std::string& key, Optional<T>& value) const {
-        const auto cit = q.find(key);
-        if (cit != q.end()) {
-          value = T();
-          operator()(key, Value(value));
-        }
-      }
-
-      // For the remaining field types, use `ParseJSON`. Overkill, but ensures any `CURRENT_STRUCT` can be URL-encoded.
-      template <typename T>
-      void operator()(const std::string& key, T& value) const {
-        const auto cit = q.find(key);
-        if (cit != q.end()) {
-          try {
-            ParseJSON(cit->second, value);
-          } catch (const current::TypeSystemParseJSONException& exception) {
-            CURRENT_THROW(
-                URLParseSpecificObjectAsURLParameterException<TOP_LEVEL_T>(key, exception.OriginalDescription()));
-          }
-        } else if (MODE == FillObjectMode::Strict) {
-          CURRENT_THROW(URLParseSpecificObjectAsURLParameterException<TOP_LEVEL_T>(key, "missing value"));
-        }
-      }
-    };
+    std::string raw_query_;
+    mutable std::shared_ptr<const Decoded> decoded_;
   };
 
   const std::map<std::string, std::string>& AllQueryParameters() const { return query.AsImmutableMap(); }
 
-  std::vector<std::pair<std::string, std::string>> parameters_vector;
   QueryParameters query;
   std::string fragment;
 };
@@ -456,7 +521,6 @@ struct URL : URLParametersExtractor, URLWithoutParametersParser {
 
     url.path = target_url_parsed.path;
 
-    url.parameters_vector = target_url_parsed.parameters_vector;
     url.query = target_url_parsed.query;
     url.fragment = target_url_parsed.fragment;
 
@@ -0,0 +1,221 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 Dmitry "Dima" Korolev, <dmitry.korolev@gmail.com>.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// `URLView` is the zero-copy counterpart of `URL`, for the hot paths of the HTTP server.
+//
+// The components are views into the string parsed, which must outlive the `URLView`. Just as with `URL`, the path
+// is kept URL-encoded. The query is split into its parameters right away, with no allocations for up to
+// `QueryParametersView::kInlineParameters` of them, while the keys and the values are only decoded when asked for.
+
+#ifndef BLOCKS_URL_URL_VIEW_H
+#define BLOCKS_URL_URL_VIEW_H
+
+#include "url.h"
+
+namespace current {
+namespace url {
+
+class QueryParametersView final {
+ public:
+  // The parameters past this many are kept on the heap.
+  constexpr static size_t kInlineParameters = 8u;
+
+  // The key and the value of a query parameter, as they are in the URL, still URL-encoded.
+  struct RawParameter final {
+    std::string_view key;
+    std::string_view value;
+  };
+
+  QueryParametersView() = default;
+  explicit QueryParametersView(std::string_view raw_query) {
+    while (!raw_query.empty()) {
+      const size_t ampersand = raw_query.find('&');
+      const std::string_view chunk = raw_query.substr(0u, ampersand);
+      if (!chunk.empty()) {
+        const size_t equals = chunk.find('=');
+        Add(RawParameter{chunk.substr(0u, equals),
+                         equals == std::string_view::npos ? std::string_view() : chunk.substr(equals + 1u)});
+      }
+      raw_query = (ampersand == std::string_view::npos) ? std::string_view() : raw_query.substr(ampersand + 1u);
+    }
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return !size_; }
+
+  // The parameters in the order they are in the query string.
+  const RawParameter& Raw(size_t i) const {
+    return i < kInlineParameters ? inline_[i] : overflow_[i - kInlineParameters];
+  }
+  std::string DecodedKey(size_t i) const { return URL::DecodeURIComponent(Raw(i).key); }
+  std::string DecodedValue(size_t i) const { return URL::DecodeURIComponent(Raw(i).value); }
+
+  // The lookups by the decoded key. For the repeated keys, the first value is the one, as with `URL`.
+  bool has(std::string_view key) const { return FindRaw(key) != nullptr; }
+  bool Get(std::string_view key, std::string& value) const {
+    const RawParameter* parameter = FindRaw(key);
+    if (parameter) {
+      value = URL::DecodeURIComponent(parameter->value);
+      return true;
+    } else {
+      return false;
+    }
+  }
+  std::string get(std::string_view key, std::string default_value) const {
+    Get(key, default_value);
+    return default_value;
+  }
+  std::string operator[](std::string_view key) const { return get(key, ""); }
+
+  // Decodes all the parameters, into what `URL::AllQueryParameters()` would return.
+  std::map<std::string, std::string> AsMap() const {
+    std::map<std::string, std::string> result;
+    for (size_t i = 0u; i < size_; ++i) {
+      result.emplace(DecodedKey(i), DecodedValue(i));
+    }
+    return result;
+  }
+
+  // Same as `URL::QueryParameters::FillObject()`, decoding only the values of the fields of `T`.
+  template <typename T, FillObjectMode MODE = FillObjectMode::Forgiving>
+  std::enable_if_t<IS_CURRENT_STRUCT(T), const T&> FillObject(T& object) const {
+    impl::QueryParametersFillObjectImpl<T, MODE>::DoIt(DecodingSource{*this, std::string()}, object);
+    return object;
+  }
+
+  template <typename T, FillObjectMode MODE = FillObjectMode::Forgiving>
+  T FillObject() const {
+    T object;
+    FillObject<T, MODE>(object);
+    return object;
+  }
+
+ private:
+  // The source of the parameters for `impl::QueryParametersFillObjectImpl`, decoding the values as they are asked for.
+  struct DecodingSource final {
+    const QueryParametersView& self;
+    mutable std::string value;
+    const std::string* Find(const std::string& key) const { return self.Get(key, value) ? &value : nullptr; }
+  };
+
+  void Add(const RawParameter& parameter) {
+    if (size_ < kInlineParameters) {
+      inline_[size_] = parameter;
+    } else {
+      overflow_.push_back(parameter);
+    }
+    ++size_;
+  }
+
+  const RawParameter* FindRaw(std::string_view key) const {
+    for (size_t i = 0u; i < size_; ++i) {
+      const RawParameter& parameter = Raw(i);
+      if (URL::DecodedURIComponentEquals(parameter.key, key)) {
+        return &parameter;
+      }
+    }
+    return nullptr;
+  }
+
+  size_t size_ = 0u;
+  RawParameter inline_[kInlineParameters];
+  std::vector<RawParameter> overflow_;
+};
+
+struct URLView final {
+  std::string_view scheme;
+  std::string_view username;
+  std::string_view password;
+  std::string_view host;
+  uint16_t port = 0;
+  std::string_view path = "/";
+  std::string_view raw_query;  // Between the `?` and the `#`, still URL-encoded.
+  std::string_view fragment;
+  QueryParametersView query;
+
+  URLView() = default;
+
+  // Parses the URL the way `URL` does, see `URLWithoutParametersParser` and `URLParametersExtractor`.
+  explicit URLView(std::string_view url) {
+    size_t end = url.length();
+    const size_t pound_sign = url.find('#');
+    if (pound_sign != std::string_view::npos) {
+      fragment = url.substr(pound_sign + 1u);
+      end = pound_sign;
+    }
+    const size_t question_mark = url.find('?');
+    if (question_mark != std::string_view::npos && question_mark < pound_sign) {
+      raw_query = url.substr(question_mark + 1u, end - (question_mark + 1u));
+      query = QueryParametersView(raw_query);
+      end = question_mark;
+    }
+    url = url.substr(0u, end);
+
+    if (url.empty()) {
+      CURRENT_THROW(EmptyURLException());
+    }
+
+    size_t offset = 0u;
+    const size_t double_slash = url.find("//");
+    if (double_slash != std::string_view::npos && (double_slash == 0u || url[double_slash - 1u] == ':')) {
+      scheme = (double_slash == 0u ? std::string_view() : url.substr(0u, double_slash - 1u));
+      offset = double_slash + 2u;
+    }
+
+    const size_t host_end = url.find('/', offset);
+
+    const size_t at_sign = url.find('@', offset);
+    if (at_sign != std::string_view::npos && at_sign < host_end) {
+      const size_t user_pass_colon = url.find(':', offset);
+      if (user_pass_colon != std::string_view::npos && user_pass_colon < at_sign) {
+        username = url.substr(offset, user_pass_colon - offset);
+        password = url.substr(user_pass_colon + 1u, at_sign - (user_pass_colon + 1u));
+      } else {
+        username = url.substr(offset, at_sign - offset);
+      }
+      offset = at_sign + 1u;
+    }
+
+    const size_t port_colon = url.find(':', offset);
+    if (port_colon != std::string_view::npos && port_colon < host_end) {
+      host = url.substr(offset, port_colon - offset);
+      uint32_t value = 0u;
+      for (size_t i = port_colon + 1u; i < url.length() && url[i] >= '0' && url[i] <= '9'; ++i) {
+        value = value * 10u + static_cast<uint32_t>(url[i] - '0');
+      }
+      port = static_cast<uint16_t>(value);
+    } else {
+      host = url.substr(offset, host_end == std::string_view::npos ? std::string_view::npos : host_end - offset);
+    }
+
+    if (host_end != std::string_view::npos) {
+      path = url.substr(host_end);
+    }
+  }
+};
+
+}  // namespace url
+}  // namespace current
+
+#endif  // BLOCKS_URL_URL_VIEW_H
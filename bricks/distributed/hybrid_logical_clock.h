@@ -0,0 +1,136 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 Andrei Drozdov <sulverus@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// Hybrid logical clocks: the physical time in microseconds, plus a logical counter to order the events
+// that happen within the same microsecond, or while the physical clock of this node is behind the other nodes.
+// Unlike `VectorClock`, the state is two integers regardless of the size of the cluster, and it is totally ordered,
+// at the cost of not telling the concurrent events apart. See Kulkarni et al., "Logical Physical Clocks", 2014.
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <sstream>
+#include <string>
+
+#include "../../bricks/time/chrono.h"
+#include "../../typesystem/struct.h"
+
+#include "vector_clock.h"
+
+CURRENT_STRUCT(HybridLogicalTimestamp) {
+  CURRENT_FIELD(us, std::chrono::microseconds, std::chrono::microseconds(0));
+  CURRENT_FIELD(counter, uint64_t, 0u);
+
+  CURRENT_DEFAULT_CONSTRUCTOR(HybridLogicalTimestamp) {}
+  CURRENT_CONSTRUCTOR(HybridLogicalTimestamp)(std::chrono::microseconds us, uint64_t counter = 0u)
+      : us(us), counter(counter) {}
+
+  bool operator==(const HybridLogicalTimestamp& rhs) const { return us == rhs.us && counter == rhs.counter; }
+  bool operator!=(const HybridLogicalTimestamp& rhs) const { return !operator==(rhs); }
+  bool operator<(const HybridLogicalTimestamp& rhs) const {
+    return us < rhs.us || (us == rhs.us && counter < rhs.counter);
+  }
+  bool operator<=(const HybridLogicalTimestamp& rhs) const { return !rhs.operator<(*this); }
+};
+
+// Same API as `MergeStrategy` of `vector_clock.h`. The timestamps are compared as (`us`, `counter`) pairs.
+class HybridLogicalMergeStrategy {
+ public:
+  using CLOCK = HybridLogicalTimestamp;
+
+  static struct MergeResult Merge(const CLOCK& v1,
+                                  const CLOCK& v2,
+                                  std::function<bool(const CLOCK& v1, const CLOCK& v2)> validator) {
+    // Same as the basic strategy of `VectorClock`: always merge, report the conflict if `v1 <= v2` does not hold.
+    return MergeResult{!validator(v1, v2), true};
+  }
+  static struct MergeResult Merge(const CLOCK& v1, const CLOCK& v2) { return Merge(v1, v2, IsConflicting); }
+  static bool IsConflicting(const CLOCK& v1, const CLOCK& v2) { return !IsLte(v1, v2); }
+
+  static bool IsSame(const CLOCK& v1, const CLOCK& v2) { return v1 == v2; }
+  static bool IsLte(const CLOCK& v1, const CLOCK& v2) { return v1 <= v2; }
+  static bool IsEarly(const CLOCK& v1, const CLOCK& v2) { return v1 < v2; }
+  // The order is total, so the events are never reported as concurrent.
+  static bool IsParallel(const CLOCK&, const CLOCK&) { return false; }
+};
+
+class HybridLogicalClock {
+ protected:
+  HybridLogicalTimestamp clock_;
+  HybridLogicalMergeStrategy strategy_;
+  std::chrono::microseconds last_stream_us_ = std::chrono::microseconds(-1);
+
+ public:
+  HybridLogicalClock() = default;
+  explicit HybridLogicalClock(const HybridLogicalTimestamp& clock) : clock_(clock) {}
+
+  std::string ToString() const {
+    std::ostringstream out_str;
+    out_str << "HLC: [" << clock_.us.count() << ", " << clock_.counter << "]";
+    return out_str.str();
+  }
+
+  // A local event, or sending a message: catch up with the physical time, or, if it is behind, count the event.
+  void Step() {
+    const std::chrono::microseconds now = current::time::Now();
+    if (now > clock_.us) {
+      clock_ = HybridLogicalTimestamp(now);
+    } else {
+      ++clock_.counter;
+    }
+  }
+
+  // Returns current state for network transmission.
+  const HybridLogicalTimestamp& State() const { return clock_; }
+
+  // Receiving a message: the clock moves past both the local and the remote state, and the physical time.
+  // Returns whether the remote state was not behind the local one, as `VectorClock::AdvanceTo()` does.
+  bool AdvanceTo(const HybridLogicalTimestamp& to_compare) {
+    const auto merge_results = strategy_.Merge(clock_, to_compare);
+    if (merge_results.should_mutate_clock) {
+      const std::chrono::microseconds now = current::time::Now();
+      const std::chrono::microseconds us = std::max(now, std::max(clock_.us, to_compare.us));
+      if (us == clock_.us && us == to_compare.us) {
+        clock_.counter = std::max(clock_.counter, to_compare.counter) + 1u;
+      } else if (us == clock_.us) {
+        ++clock_.counter;
+      } else if (us == to_compare.us) {
+        clock_ = HybridLogicalTimestamp(us, to_compare.counter + 1u);
+      } else {
+        clock_ = HybridLogicalTimestamp(us);
+      }
+    }
+    return merge_results.is_valid_state;
+  }
+
+  // Steps the clock, and returns the timestamp to publish an entry into a stream with, in place of
+  // `current::time::Now()`. Streams need strictly increasing microseconds, so, while the logical counter is
+  // what keeps the events apart, the timestamp returned is bumped to one microsecond past the previous one.
+  std::chrono::microseconds StreamTimestamp() {
+    Step();
+    last_stream_us_ = std::max(clock_.us, last_stream_us_ + std::chrono::microseconds(1));
+    return last_stream_us_;
+  }
+};
@@ -25,6 +25,8 @@ SOFTWARE.
 
 #include "../../3rdparty/gtest/gtest-main.h"
 #include "../../bricks/time/chrono.h"
+#include "../../typesystem/serialization/json.h"
+#include "hybrid_logical_clock.h"
 #include "vector_clock.h"
 
 using namespace std::chrono_literals;
@@ -128,3 +130,57 @@ TEST(VectorClock, StrictMerge) {
   EXPECT_EQ(v.State()[0], cur_state[0] + 1);
   EXPECT_EQ(v.State()[1], cur_state[1]);
 }
+
+TEST(HybridLogicalClock, Step) {
+  current::time::ResetToZero();
+  current::time::SetNow(1000us);
+  HybridLogicalClock clock;
+  clock.Step();
+  EXPECT_EQ("HLC: [1000, 0]", clock.ToString());
+  clock.Step();
+  EXPECT_EQ("HLC: [1000, 1]", clock.ToString()) << "The events within the same microsecond are counted.";
+  current::time::SetNow(2000us);
+  clock.Step();
+  EXPECT_EQ("HLC: [2000, 0]", clock.ToString()) << "The counter is reset once the physical time moves on.";
+}
+
+TEST(HybridLogicalClock, Merge) {
+  current::time::ResetToZero();
+  current::time::SetNow(1000us);
+  HybridLogicalClock clock(HybridLogicalTimestamp(1000us, 5u));
+
+  EXPECT_TRUE(clock.AdvanceTo(HybridLogicalTimestamp(3000us, 2u))) << "The remote clock is ahead - ok to merge.";
+  EXPECT_EQ(HybridLogicalTimestamp(3000us, 3u), clock.State()) << "The remote physical time is taken over.";
+
+  EXPECT_TRUE(clock.AdvanceTo(HybridLogicalTimestamp(3000us, 7u)));
+  EXPECT_EQ(HybridLogicalTimestamp(3000us, 8u), clock.State()) << "Same physical time, the larger counter wins.";
+
+  EXPECT_FALSE(clock.AdvanceTo(HybridLogicalTimestamp(2000us, 100u))) << "Can't merge T > T' - incorrect update.";
+  EXPECT_EQ(HybridLogicalTimestamp(3000us, 9u), clock.State()) << "Still, the clock moves forward.";
+
+  current::time::SetNow(5000us);
+  EXPECT_TRUE(clock.AdvanceTo(HybridLogicalTimestamp(4000us, 1u)));
+  EXPECT_EQ(HybridLogicalTimestamp(5000us, 0u), clock.State()) << "The local physical time is ahead of both.";
+
+  EXPECT_TRUE(HybridLogicalMergeStrategy::IsEarly(HybridLogicalTimestamp(1us, 9u), HybridLogicalTimestamp(2us)));
+  EXPECT_TRUE(HybridLogicalMergeStrategy::IsLte(HybridLogicalTimestamp(2us, 1u), HybridLogicalTimestamp(2us, 1u)));
+  EXPECT_FALSE(HybridLogicalMergeStrategy::IsParallel(HybridLogicalTimestamp(1us), HybridLogicalTimestamp(2us)));
+}
+
+TEST(HybridLogicalClock, SerializesAsTwoIntegers) {
+  const HybridLogicalTimestamp timestamp(1000us, 2u);
+  EXPECT_EQ("{\"us\":1000,\"counter\":2}", JSON(timestamp));
+  EXPECT_EQ(timestamp, ParseJSON<HybridLogicalTimestamp>(JSON(timestamp)));
+}
+
+TEST(HybridLogicalClock, StreamTimestamps) {
+  current::time::ResetToZero();
+  current::time::SetNow(1000us);
+  HybridLogicalClock clock;
+  EXPECT_EQ(1000, clock.StreamTimestamp().count());
+  EXPECT_EQ(1001, clock.StreamTimestamp().count()) << "The stream timestamps are strictly increasing.";
+  clock.AdvanceTo(HybridLogicalTimestamp(5000us, 3u));
+  EXPECT_EQ(5000, clock.StreamTimestamp().count()) << "The timestamps follow the clock of the other nodes.";
+  current::time::SetNow(7000us);
+  EXPECT_EQ(7000, clock.StreamTimestamp().count());
+}
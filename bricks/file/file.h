@@ -41,6 +41,7 @@ SOFTWARE.
 
 #ifndef CURRENT_WINDOWS
 #include <dirent.h>
+#include <fcntl.h>
 #include <unistd.h>
 #else
 #include <direct.h>
@@ -49,6 +50,7 @@ SOFTWARE.
 #include <sys/stat.h>
 
 #include "exceptions.h"
+#include "mmap.h"
 
 #include "../util/make_scope_guard.h"
 #include "../util/random.h"
@@ -125,6 +127,138 @@ struct FileSystem {
     }
   }
 
+  // Writes the file under a temporary name next to it, flushes it to disk, and renames it over `file_name`,
+  // so that `file_name` always holds either the old or the new contents, in full, even after a crash.
+  static inline void WriteStringToFileAtomically(const std::string& contents, const char* file_name) {
+    const std::string tmp_file_name =
+        std::string(file_name) + strings::Printf(".tmp-%08x", random::CSRandomInt(0, ~0));
+    bool renamed = false;
+    const auto tmp_file_remover = MakeScopeGuard([&tmp_file_name, &renamed]() {
+      if (!renamed) {
+        ::remove(tmp_file_name.c_str());
+      }
+    });
+#ifndef CURRENT_WINDOWS
+    const int fd = ::open(tmp_file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      CURRENT_THROW(FileException(file_name));
+    }
+    bool ok = true;
+    size_t offset = 0u;
+    while (ok && offset < contents.length()) {
+      const ssize_t written = ::write(fd, contents.data() + offset, contents.length() - offset);
+      if (written > 0) {
+        offset += static_cast<size_t>(written);
+      } else if (!(written < 0 && errno == EINTR)) {
+        ok = false;
+      }
+    }
+    ok = !::fsync(fd) && ok;
+    ok = !::close(fd) && ok;
+    if (!ok || ::rename(tmp_file_name.c_str(), file_name)) {
+      CURRENT_THROW(FileException(file_name));
+    }
+    renamed = true;
+    // Persist the rename itself. Not all filesystems support `fsync()` on a directory, hence no error checking.
+    const std::string file_name_string(file_name);
+    const size_t slash = file_name_string.rfind(PathSeparator);
+    const std::string directory = (slash == std::string::npos) ? "." : file_name_string.substr(0, slash + 1);
+    const int dir_fd = ::open(directory.c_str(), O_RDONLY);
+    if (dir_fd >= 0) {
+      ::fsync(dir_fd);
+      ::close(dir_fd);
+    }
+#else
+    WriteStringToFile(contents, tmp_file_name.c_str());
+    if (!::MoveFileExA(tmp_file_name.c_str(), file_name, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+      CURRENT_THROW(FileException(file_name));
+    }
+    renamed = true;
+#endif
+  }
+
+  // Read-only, RAII, memory mapping of the whole file. See "mmap.h".
+  static inline std::unique_ptr<MemoryMappedFile> MapFile(const std::string& file_name,
+                                                          MemoryAccessHint hint = MemoryAccessHint::Normal) {
+    auto result = std::make_unique<MemoryMappedFile>(file_name);
+    result->Advise(hint);
+    return result;
+  }
+
+  // Reads the file in chunks of `chunk_size` bytes into `buffer`, which is reused across chunks and calls,
+  // calling `f(const char* data, size_t size)` for each chunk. All chunks but the last one are full.
+  // On POSIX, `hint` is passed on to the kernel via `posix_fadvise()`.
+  constexpr static size_t kDefaultReadChunkSize = 1u << 20;
+  template <typename F>
+  static inline void ReadFileInChunks(const std::string& file_name,
+                                      std::string& buffer,
+                                      F&& f,
+                                      size_t chunk_size = kDefaultReadChunkSize,
+                                      MemoryAccessHint hint = MemoryAccessHint::Sequential) {
+    if (!chunk_size) {
+      chunk_size = kDefaultReadChunkSize;
+    }
+    if (buffer.length() < chunk_size) {
+      buffer.resize(chunk_size);
+    }
+#ifndef CURRENT_WINDOWS
+    const int fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+      CURRENT_THROW(CannotReadFileException(file_name));
+    }
+    const auto closer = MakeScopeGuard([fd]() { ::close(fd); });
+#ifdef POSIX_FADV_SEQUENTIAL
+    int advice = POSIX_FADV_NORMAL;
+    if (hint == MemoryAccessHint::Sequential) {
+      advice = POSIX_FADV_SEQUENTIAL;
+    } else if (hint == MemoryAccessHint::Random) {
+      advice = POSIX_FADV_RANDOM;
+    } else if (hint == MemoryAccessHint::WillNeed) {
+      advice = POSIX_FADV_WILLNEED;
+    } else if (hint == MemoryAccessHint::DontNeed) {
+      advice = POSIX_FADV_DONTNEED;
+    }
+    ::posix_fadvise(fd, 0, 0, advice);
+#else
+    static_cast<void>(hint);
+#endif  // POSIX_FADV_SEQUENTIAL
+    bool eof = false;
+    while (!eof) {
+      size_t size = 0u;
+      while (size < chunk_size) {
+        const ssize_t n = ::read(fd, &buffer[size], chunk_size - size);
+        if (n > 0) {
+          size += static_cast<size_t>(n);
+        } else if (!n) {
+          eof = true;
+          break;
+        } else if (errno != EINTR) {
+          CURRENT_THROW(CannotReadFileException(file_name));
+        }
+      }
+      if (size) {
+        f(static_cast<const char*>(buffer.data()), size);
+      }
+    }
+#else
+    static_cast<void>(hint);
+    std::ifstream fi(file_name, std::ifstream::binary);
+    if (!fi) {
+      CURRENT_THROW(CannotReadFileException(file_name));
+    }
+    while (fi) {
+      fi.read(&buffer[0], static_cast<std::streamsize>(chunk_size));
+      const size_t size = static_cast<size_t>(fi.gcount());
+      if (size) {
+        f(static_cast<const char*>(buffer.data()), size);
+      }
+    }
+    if (fi.bad()) {
+      CURRENT_THROW(CannotReadFileException(file_name));
+    }
+#endif  // CURRENT_WINDOWS
+  }
+
   static inline std::string GenTmpFileName() {
 #ifndef CURRENT_WINDOWS
     // TODO(dkorolev): Fix temporary file names generation.
@@ -0,0 +1,155 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// The lines of a file, with no copying: the file is memory-mapped, see "mmap.h", and each line is passed to the
+// callback as the `std::string_view` into the mapping, without its '\n'. As with `GroupByLines`, the empty lines
+// are passed on, and so is the last line if it does not end with a newline, unless it is empty.
+//
+// `ForEachLineOfFile(file_name, f)` calls `f(line)` for each line, in order.
+//
+// `ParallelForEachLineOfFile(executor, file_name, f)` splits the file into blocks of about `kFileLinesBlockSize`
+// bytes, each starting right after a newline, and calls `f(line)` from the workers of the `WorkStealingExecutor`,
+// concurrently, in no particular order across the blocks.
+//
+// `ParallelMapLinesOfFile(executor, file_name, map, consume)` is the ordered mode: `map(line)` is called concurrently,
+// as above, and `consume(result)` is called from the calling thread, on the results of `map`, in the order of
+// the lines. At most `2 * executor.WorkersCount()` blocks of the results are kept in memory at any moment.
+// Do not call it from within the tasks of `executor`, as it waits on them.
+//
+// All of them return once all the callbacks have, and rethrow the first exception thrown by any of them.
+
+#ifndef BRICKS_FILE_LINES_H
+#define BRICKS_FILE_LINES_H
+
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "mmap.h"
+
+#include "../sync/executor.h"
+
+namespace current {
+
+constexpr static size_t kFileLinesBlockSize = 1u << 22;
+
+namespace impl {
+
+// Calls `f(line)` for each line of `[begin, end)`. The last line may have no newline only at the end of the file.
+template <typename F>
+void ForEachLineInRange(const char* begin, const char* end, F&& f) {
+  while (begin < end) {
+    const char* eol = static_cast<const char*>(std::memchr(begin, '\n', static_cast<size_t>(end - begin)));
+    if (!eol) {
+      f(std::string_view(begin, static_cast<size_t>(end - begin)));
+      return;
+    }
+    f(std::string_view(begin, static_cast<size_t>(eol - begin)));
+    begin = eol + 1;
+  }
+}
+
+// The offsets at which the blocks of lines start, the first one being zero, and the last one the size of the file.
+inline std::vector<size_t> FileLinesBlocks(const char* data, size_t size, size_t block_size) {
+  std::vector<size_t> blocks({0u});
+  while (size - blocks.back() > block_size) {
+    const size_t target = blocks.back() + block_size;
+    const void* eol = std::memchr(data + target, '\n', size - target);
+    if (!eol || static_cast<const char*>(eol) + 1 == data + size) {
+      break;
+    }
+    blocks.push_back(static_cast<size_t>(static_cast<const char*>(eol) - data) + 1u);
+  }
+  blocks.push_back(size);
+  return blocks;
+}
+
+}  // namespace impl
+
+template <typename F>
+void ForEachLineOfFile(const std::string& file_name, F&& f) {
+  const MemoryMappedFile file(file_name);
+  impl::ForEachLineInRange(file.data(), file.data() + file.file_size(), f);
+}
+
+template <typename F>
+void ParallelForEachLineOfFile(WorkStealingExecutor& executor,
+                               const std::string& file_name,
+                               F&& f,
+                               size_t block_size = kFileLinesBlockSize) {
+  const MemoryMappedFile file(file_name);
+  const std::vector<size_t> blocks = impl::FileLinesBlocks(file.data(), file.file_size(), block_size);
+  executor.ParallelFor(0u, blocks.size() - 1u, [&](size_t i) {
+    impl::ForEachLineInRange(file.data() + blocks[i], file.data() + blocks[i + 1u], f);
+  });
+}
+
+template <typename MAP, typename CONSUME>
+void ParallelMapLinesOfFile(WorkStealingExecutor& executor,
+                            const std::string& file_name,
+                            MAP&& map,
+                            CONSUME&& consume,
+                            size_t block_size = kFileLinesBlockSize) {
+  using result_t = std::decay_t<std::invoke_result_t<MAP&, std::string_view>>;
+  const MemoryMappedFile file(file_name);
+  const std::vector<size_t> blocks = impl::FileLinesBlocks(file.data(), file.file_size(), block_size);
+  const size_t in_flight = 2u * executor.WorkersCount();
+  std::deque<Future<std::vector<result_t>>> pending;
+  size_t next = 0u;
+  try {
+    while (next + 1u < blocks.size() || !pending.empty()) {
+      while (next + 1u < blocks.size() && pending.size() < in_flight) {
+        const char* begin = file.data() + blocks[next];
+        const char* end = file.data() + blocks[next + 1u];
+        pending.push_back(executor.Submit([begin, end, &map]() {
+          std::vector<result_t> results;
+          impl::ForEachLineInRange(begin, end, [&](std::string_view line) { results.push_back(map(line)); });
+          return results;
+        }));
+        ++next;
+      }
+      Future<std::vector<result_t>> front(std::move(pending.front()));
+      pending.pop_front();
+      std::vector<result_t> results = front.Go();
+      for (result_t& result : results) {
+        consume(std::move(result));
+      }
+    }
+  } catch (...) {
+    // The blocks still being mapped refer to the memory-mapped file, so they must be done before it is unmapped.
+    for (auto& future : pending) {
+      future.Wait();
+    }
+    throw;
+  }
+}
+
+}  // namespace current
+
+#endif  // BRICKS_FILE_LINES_H
@@ -0,0 +1,158 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// `MemoryMappedFile` is a read-only, RAII, memory mapping of a file.
+//
+// The mapping can be requested to be longer than the file itself. This is by design: an append-only file
+// can then be mapped once with some headroom, and the bytes appended later can be accessed via the same mapping.
+// It is the responsibility of the user to never access the bytes past the end of the file.
+//
+// On Windows, the "mapping" is a copy of the contents of the file, read into memory at construction.
+//
+// `Advise()` passes the expected access pattern on to the kernel via `madvise()`; it is a no-op on Windows.
+
+#ifndef BRICKS_FILE_MMAP_H
+#define BRICKS_FILE_MMAP_H
+
+#include "../../port.h"
+
+#include <string>
+
+#ifndef CURRENT_WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // CURRENT_WINDOWS
+
+#include "exceptions.h"
+
+#include "../util/make_scope_guard.h"
+
+#ifdef CURRENT_WINDOWS
+#include <fstream>
+#include <sstream>
+#endif  // CURRENT_WINDOWS
+
+namespace current {
+
+enum class MemoryAccessHint { Normal, Sequential, Random, WillNeed, DontNeed };
+
+class MemoryMappedFile final {
+ public:
+  // Maps `length` bytes of the file, or the whole file if `length` is zero.
+  explicit MemoryMappedFile(const std::string& file_name, size_t length = 0u) {
+#ifndef CURRENT_WINDOWS
+    const int fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+      CURRENT_THROW(CannotReadFileException(file_name));
+    }
+    const auto closer = MakeScopeGuard([fd]() { ::close(fd); });
+    struct stat st;
+    if (::fstat(fd, &st)) {
+      CURRENT_THROW(CannotReadFileException(file_name));  // LCOV_EXCL_LINE
+    }
+    file_size_ = static_cast<size_t>(st.st_size);
+    size_ = length ? length : file_size_;
+    if (size_) {
+      void* ptr = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+      if (ptr == MAP_FAILED) {
+        CURRENT_THROW(CannotReadFileException(file_name));  // LCOV_EXCL_LINE
+      }
+      data_ = static_cast<const char*>(ptr);
+    }
+#else
+    std::ifstream fi(file_name, std::ifstream::binary);
+    if (!fi) {
+      CURRENT_THROW(CannotReadFileException(file_name));
+    }
+    std::ostringstream os;
+    os << fi.rdbuf();
+    contents_ = os.str();
+    file_size_ = contents_.length();
+    size_ = length ? length : file_size_;
+    contents_.resize(size_);
+    data_ = contents_.data();
+#endif  // CURRENT_WINDOWS
+  }
+
+  ~MemoryMappedFile() {
+#ifndef CURRENT_WINDOWS
+    if (data_) {
+      ::munmap(const_cast<char*>(data_), size_);
+    }
+#endif  // CURRENT_WINDOWS
+  }
+
+  MemoryMappedFile(const MemoryMappedFile&) = delete;
+  MemoryMappedFile(MemoryMappedFile&&) = delete;
+  MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+  MemoryMappedFile& operator=(MemoryMappedFile&&) = delete;
+
+  const char* data() const { return data_; }
+  // The size of the mapping, which may exceed the size of the file.
+  size_t size() const { return size_; }
+  // The size of the file at the time it was mapped.
+  size_t file_size() const { return file_size_; }
+  // The number of leading bytes that reflect the file as it is being appended to: the size of the mapping,
+  // or, on Windows, where the contents is a copy, the size of the file at the time it was "mapped".
+#ifndef CURRENT_WINDOWS
+  size_t live_size() const { return size_; }
+#else
+  size_t live_size() const { return file_size_; }
+#endif  // CURRENT_WINDOWS
+
+  // The hint is advisory, hence a failed `madvise()` is not an error.
+  void Advise(MemoryAccessHint hint) const {
+#ifndef CURRENT_WINDOWS
+    if (data_) {
+      int advice = MADV_NORMAL;
+      if (hint == MemoryAccessHint::Sequential) {
+        advice = MADV_SEQUENTIAL;
+      } else if (hint == MemoryAccessHint::Random) {
+        advice = MADV_RANDOM;
+      } else if (hint == MemoryAccessHint::WillNeed) {
+        advice = MADV_WILLNEED;
+      } else if (hint == MemoryAccessHint::DontNeed) {
+        advice = MADV_DONTNEED;
+      }
+      ::madvise(const_cast<char*>(data_), size_, advice);
+    }
+#else
+    static_cast<void>(hint);
+#endif  // CURRENT_WINDOWS
+  }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0u;
+  size_t file_size_ = 0u;
+#ifdef CURRENT_WINDOWS
+  std::string contents_;
+#endif  // CURRENT_WINDOWS
+};
+
+}  // namespace current
+
+#endif  // BRICKS_FILE_MMAP_H
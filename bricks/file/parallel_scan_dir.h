@@ -0,0 +1,172 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// The parallel, recursive, counterpart of `FileSystem::ScanDir`, for huge directory trees on slow filesystems.
+//
+// `ParallelScanDir(executor, directory, f, parameters)` calls `f(item_info)` for each entry of the whole tree under
+// `directory`, with the same `FileSystem::ScanDirItemInfo` as the recursive `ScanDir` would, but from the workers
+// of the `WorkStealingExecutor`, concurrently, and in no particular order. The subdirectories are scanned
+// in parallel, and so are the `fstatat()`-s of the entries of each directory, relative to its open descriptor.
+//
+// With `ParallelScanDirStat::IfTypeUnknown`, the default, `fstatat()` is only called for the entries the type of
+// which `readdir()` does not report, and for symlinks, which are followed. `ParallelScanDirStat::Always` calls it
+// for every entry, which is what `ScanDir` does, for the filesystems that report wrong types.
+//
+// Returns once all the callbacks have, and rethrows the first exception thrown, by `f` or by the scan itself.
+
+#ifndef BRICKS_FILE_PARALLEL_SCAN_DIR_H
+#define BRICKS_FILE_PARALLEL_SCAN_DIR_H
+
+#include <string>
+#include <vector>
+
+#include "file.h"
+
+#include "../sync/executor.h"
+
+namespace current {
+
+enum class ParallelScanDirStat : bool { IfTypeUnknown = false, Always = true };
+
+namespace impl {
+
+// Below this many entries to `fstatat()` in one directory, they are not worth the tasks.
+constexpr static size_t kParallelScanDirStatBatch = 64u;
+
+struct ParallelScanDirEntry final {
+  std::string name;
+  bool is_directory = false;
+};
+
+#ifndef CURRENT_WINDOWS
+inline std::vector<ParallelScanDirEntry> ParallelScanDirRead(WorkStealingExecutor& executor,
+                                                             const std::string& directory,
+                                                             ParallelScanDirStat stat) {
+  DIR* dir = ::opendir(directory.c_str());
+  if (!dir) {
+    if (errno == ENOENT) {
+      CURRENT_THROW(DirDoesNotExistException(directory));
+    } else if (errno == ENOTDIR) {
+      CURRENT_THROW(PathNotDirException(directory));
+    } else {
+      CURRENT_THROW(FileException(directory));  // LCOV_EXCL_LINE
+    }
+  }
+  const auto closedir_guard = MakeScopeGuard([dir]() { ::closedir(dir); });
+  std::vector<ParallelScanDirEntry> entries;
+  std::vector<size_t> to_stat;
+  while (struct dirent* entry = ::readdir(dir)) {
+    const char* const name = entry->d_name;
+    if (FileSystem::ScanDirCanHandleName(name)) {
+      ParallelScanDirEntry e;
+      e.name = name;
+      if (stat == ParallelScanDirStat::Always || entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+        to_stat.push_back(entries.size());
+      } else {
+        e.is_directory = (entry->d_type == DT_DIR);
+      }
+      entries.push_back(std::move(e));
+    }
+  }
+  const int fd = ::dirfd(dir);
+  const auto stat_entry = [&](size_t i) {
+    ParallelScanDirEntry& e = entries[to_stat[i]];
+    struct stat info;
+    if (::fstatat(fd, e.name.c_str(), &info, 0)) {
+      CURRENT_THROW(FileException(FileSystem::JoinPath(directory, e.name)));
+    }
+    e.is_directory = !!(S_ISDIR(info.st_mode));
+  };
+  if (to_stat.size() < kParallelScanDirStatBatch) {
+    for (size_t i = 0u; i < to_stat.size(); ++i) {
+      stat_entry(i);
+    }
+  } else {
+    executor.ParallelFor(0u, to_stat.size(), stat_entry);
+  }
+  return entries;
+}
+#else
+inline std::vector<ParallelScanDirEntry> ParallelScanDirRead(WorkStealingExecutor&,
+                                                             const std::string& directory,
+                                                             ParallelScanDirStat) {
+  std::vector<ParallelScanDirEntry> entries;
+  FileSystem::ScanDir(
+      directory,
+      [&entries](const FileSystem::ScanDirItemInfo& item_info) {
+        ParallelScanDirEntry e;
+        e.name = item_info.basename;
+        e.is_directory = item_info.is_directory;
+        entries.push_back(std::move(e));
+      },
+      FileSystem::ScanDirParameters::ListFilesAndDirs);
+  return entries;
+}
+#endif  // CURRENT_WINDOWS
+
+template <typename F>
+void ParallelScanDirImpl(WorkStealingExecutor& executor,
+                         const std::string& directory,
+                         const std::vector<std::string>& path_components,
+                         F& f,
+                         FileSystem::ScanDirParameters parameters,
+                         ParallelScanDirStat stat) {
+  std::vector<ParallelScanDirEntry> entries = ParallelScanDirRead(executor, directory, stat);
+  std::vector<size_t> subdirectories;
+  for (size_t i = 0u; i < entries.size(); ++i) {
+    const ParallelScanDirEntry& e = entries[i];
+    const FileSystem::ScanDirParameters mask =
+        e.is_directory ? FileSystem::ScanDirParameters::ListDirsOnly : FileSystem::ScanDirParameters::ListFilesOnly;
+    if (static_cast<int>(parameters) & static_cast<int>(mask)) {
+      f(FileSystem::ScanDirItemInfo(
+          directory, e.name, FileSystem::JoinPath(directory, e.name), e.is_directory, path_components));
+    }
+    if (e.is_directory) {
+      subdirectories.push_back(i);
+    }
+  }
+  executor.ParallelFor(0u, subdirectories.size(), [&](size_t i) {
+    const std::string& name = entries[subdirectories[i]].name;
+    std::vector<std::string> subdirectory_path_components = path_components;
+    subdirectory_path_components.push_back(name);
+    ParallelScanDirImpl(
+        executor, FileSystem::JoinPath(directory, name), subdirectory_path_components, f, parameters, stat);
+  });
+}
+
+}  // namespace impl
+
+template <typename F>
+void ParallelScanDir(WorkStealingExecutor& executor,
+                     const std::string& directory,
+                     F&& f,
+                     FileSystem::ScanDirParameters parameters = FileSystem::ScanDirParameters::ListFilesOnly,
+                     ParallelScanDirStat stat = ParallelScanDirStat::IfTypeUnknown) {
+  impl::ParallelScanDirImpl(executor, directory, std::vector<std::string>(), f, parameters, stat);
+}
+
+}  // namespace current
+
+#endif  // BRICKS_FILE_PARALLEL_SCAN_DIR_H
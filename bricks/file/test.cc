@@ -23,11 +23,15 @@ SOFTWARE.
 *******************************************************************************/
 
 #include <algorithm>
+#include <atomic>
 #include <set>
 #include <string>
 #include <vector>
 
 #include "file.h"
+#include "lines.h"
+#include "mmap.h"
+#include "parallel_scan_dir.h"
 
 #include "../dflags/dflags.h"
 #include "../strings/join.h"
@@ -470,6 +474,62 @@ TEST(File, ScanDirRecursive) {
   }
 }
 
+TEST(File, ParallelScanDir) {
+  const std::string base_dir = FileSystem::JoinPath(FLAGS_file_test_tmpdir, "base_dir_parallel");
+  const auto base_dir_remover = FileSystem::ScopedRmDir(base_dir);
+
+  FileSystem::MkDir(base_dir, FileSystem::MkDirParameters::Silent);
+  for (int i = 0; i < 5; ++i) {
+    const std::string dir = FileSystem::JoinPath(base_dir, "dir" + current::ToString(i));
+    FileSystem::MkDir(dir);
+    for (int j = 0; j < i * 40; ++j) {
+      FileSystem::WriteStringToFile("", FileSystem::JoinPath(dir, "file" + current::ToString(j)).c_str());
+    }
+    const std::string sub_dir = FileSystem::JoinPath(dir, "sub_dir");
+    FileSystem::MkDir(sub_dir);
+    FileSystem::WriteStringToFile("", FileSystem::JoinPath(sub_dir, "sub_dir_file").c_str());
+  }
+  FileSystem::WriteStringToFile("", FileSystem::JoinPath(base_dir, "base_dir_file").c_str());
+
+  current::WorkStealingExecutor executor(4u);
+  for (const auto parameters : {FileSystem::ScanDirParameters::ListFilesOnly,
+                                FileSystem::ScanDirParameters::ListDirsOnly,
+                                FileSystem::ScanDirParameters::ListFilesAndDirs}) {
+    std::set<std::string> expected;
+    FileSystem::ScanDir(
+        base_dir,
+        [&expected](const FileSystem::ScanDirItemInfo& x) {
+          expected.insert(x.pathname + (x.is_directory ? "/" : "") + " @ " +
+                          current::strings::Join(x.path_components_cref, '/'));
+        },
+        parameters,
+        FileSystem::ScanDirRecursive::Yes);
+    EXPECT_FALSE(expected.empty());
+    for (const auto stat : {current::ParallelScanDirStat::IfTypeUnknown, current::ParallelScanDirStat::Always}) {
+      std::mutex mutex;
+      std::set<std::string> actual;
+      current::ParallelScanDir(
+          executor,
+          base_dir,
+          [&mutex, &actual](const FileSystem::ScanDirItemInfo& x) {
+            const std::string s = x.pathname + (x.is_directory ? "/" : "") + " @ " +
+                                  current::strings::Join(x.path_components_cref, '/');
+            std::lock_guard<std::mutex> lock(mutex);
+            actual.insert(s);
+          },
+          parameters,
+          stat);
+      EXPECT_EQ(current::strings::Join(expected, ','), current::strings::Join(actual, ','));
+    }
+  }
+
+  ASSERT_THROW(current::ParallelScanDir(executor, FileSystem::JoinPath(base_dir, "nope"), [](const auto&) {}),
+               DirDoesNotExistException);
+  ASSERT_THROW(current::ParallelScanDir(
+                   executor, base_dir, [](const FileSystem::ScanDirItemInfo&) { throw std::logic_error("stop"); }),
+               std::logic_error);
+}
+
 TEST(File, RmDirRecursive) {
   // Required for Windows tests.
   FileSystem::MkDir(FLAGS_file_test_tmpdir, FileSystem::MkDirParameters::Silent);
@@ -524,3 +584,183 @@ TEST(File, ScopedRmDir) {
   ASSERT_THROW(FileSystem::RmDir(dir_y), DirDoesNotExistException);
   ASSERT_THROW(FileSystem::RmDir(dir_x), DirDoesNotExistException);
 }
+
+TEST(File, MemoryMappedFile) {
+  // Required for Windows tests.
+  FileSystem::MkDir(FLAGS_file_test_tmpdir, FileSystem::MkDirParameters::Silent);
+
+  const std::string fn = FileSystem::JoinPath(FLAGS_file_test_tmpdir, "mmap");
+  const auto file_remover = FileSystem::ScopedRmFile(fn);
+
+  ASSERT_THROW(current::MemoryMappedFile{fn}, current::CannotReadFileException);
+
+  FileSystem::WriteStringToFile("", fn.c_str());
+  {
+    current::MemoryMappedFile empty(fn);
+    EXPECT_EQ(0u, empty.size());
+    EXPECT_EQ(0u, empty.file_size());
+  }
+
+  FileSystem::WriteStringToFile("Hello", fn.c_str());
+  {
+    current::MemoryMappedFile whole(fn);
+    EXPECT_EQ(5u, whole.size());
+    EXPECT_EQ("Hello", std::string(whole.data(), whole.size()));
+  }
+
+#ifndef CURRENT_WINDOWS
+  {
+    // A mapping with headroom sees the bytes appended to the file after it was created.
+    current::MemoryMappedFile with_headroom(fn, 1 << 16);
+    EXPECT_EQ(static_cast<size_t>(1 << 16), with_headroom.size());
+    EXPECT_EQ(5u, with_headroom.file_size());
+    FileSystem::WriteStringToFile(", World!", fn.c_str(), true);
+    EXPECT_EQ("Hello, World!", std::string(with_headroom.data(), 13));
+  }
+#endif  // CURRENT_WINDOWS
+}
+
+TEST(File, MapFile) {
+  // Required for Windows tests.
+  FileSystem::MkDir(FLAGS_file_test_tmpdir, FileSystem::MkDirParameters::Silent);
+
+  const std::string fn = FileSystem::JoinPath(FLAGS_file_test_tmpdir, "map");
+  const auto file_remover = FileSystem::ScopedRmFile(fn);
+
+  ASSERT_THROW(FileSystem::MapFile(fn), current::CannotReadFileException);
+  FileSystem::WriteStringToFile("Mapped", fn.c_str());
+  const auto mapped = FileSystem::MapFile(fn, current::MemoryAccessHint::Sequential);
+  EXPECT_EQ("Mapped", std::string(mapped->data(), mapped->size()));
+}
+
+TEST(File, ReadFileInChunks) {
+  // Required for Windows tests.
+  FileSystem::MkDir(FLAGS_file_test_tmpdir, FileSystem::MkDirParameters::Silent);
+
+  const std::string fn = FileSystem::JoinPath(FLAGS_file_test_tmpdir, "chunks");
+  const auto file_remover = FileSystem::ScopedRmFile(fn);
+
+  std::string buffer;
+  std::string unused_buffer;
+  ASSERT_THROW(FileSystem::ReadFileInChunks(fn, unused_buffer, [](const char*, size_t) {}),
+               current::CannotReadFileException);
+
+  std::string contents;
+  for (size_t i = 0u; i < 10000u; ++i) {
+    contents += static_cast<char>('a' + i % 26u);
+  }
+  FileSystem::WriteStringToFile(contents, fn.c_str());
+
+  std::string result;
+  std::vector<size_t> sizes;
+  FileSystem::ReadFileInChunks(
+      fn,
+      buffer,
+      [&result, &sizes](const char* data, size_t size) {
+        result.append(data, size);
+        sizes.push_back(size);
+      },
+      4096u);
+  EXPECT_EQ(contents, result);
+  EXPECT_EQ("4096,4096,1808", current::strings::Join(sizes, ','));
+  EXPECT_EQ(4096u, buffer.length());
+
+  // The buffer is reused as is if it is already large enough.
+  result.clear();
+  FileSystem::ReadFileInChunks(
+      fn, buffer, [&result](const char* data, size_t size) { result.append(data, size); }, 1000u);
+  EXPECT_EQ(contents, result);
+  EXPECT_EQ(4096u, buffer.length());
+
+  FileSystem::WriteStringToFile("", fn.c_str());
+  size_t calls = 0u;
+  FileSystem::ReadFileInChunks(fn, buffer, [&calls](const char*, size_t) { ++calls; });
+  EXPECT_EQ(0u, calls);
+}
+
+TEST(File, WriteStringToFileAtomically) {
+  // Required for Windows tests.
+  FileSystem::MkDir(FLAGS_file_test_tmpdir, FileSystem::MkDirParameters::Silent);
+
+  const std::string dir = FileSystem::JoinPath(FLAGS_file_test_tmpdir, "atomic");
+  const auto dir_remover = FileSystem::ScopedRmDir(dir);
+  FileSystem::MkDir(dir);
+  const std::string fn = FileSystem::JoinPath(dir, "file");
+
+  FileSystem::WriteStringToFileAtomically("first", fn.c_str());
+  EXPECT_EQ("first", FileSystem::ReadFileAsString(fn));
+  FileSystem::WriteStringToFileAtomically("second", fn.c_str());
+  EXPECT_EQ("second", FileSystem::ReadFileAsString(fn));
+
+  // No temporary files are left behind.
+  size_t files = 0u;
+  FileSystem::ScanDir(dir, [&files](const FileSystem::ScanDirItemInfo&) { ++files; });
+  EXPECT_EQ(1u, files);
+
+  ASSERT_THROW(FileSystem::WriteStringToFileAtomically("nope", FileSystem::JoinPath(fn, "file").c_str()),
+               FileException);
+  EXPECT_EQ("second", FileSystem::ReadFileAsString(fn));
+}
+
+TEST(File, ForEachLineOfFile) {
+  FileSystem::MkDir(FLAGS_file_test_tmpdir, FileSystem::MkDirParameters::Silent);
+  const std::string fn = FileSystem::JoinPath(FLAGS_file_test_tmpdir, "lines");
+  const auto file_remover = FileSystem::ScopedRmFile(fn);
+
+  const auto lines_of = [&fn](const std::string& contents) {
+    FileSystem::WriteStringToFile(contents, fn.c_str());
+    std::vector<std::string> lines;
+    current::ForEachLineOfFile(fn, [&lines](std::string_view line) { lines.emplace_back(line); });
+    return current::strings::Join(lines, '|');
+  };
+  EXPECT_EQ("", lines_of(""));
+  EXPECT_EQ("a", lines_of("a"));
+  EXPECT_EQ("a", lines_of("a\n"));
+  EXPECT_EQ("a||b", lines_of("a\n\nb"));
+  EXPECT_EQ("|a|b", lines_of("\na\nb\n"));
+
+  // Many lines, in tiny blocks, to exercise the split into blocks at the newlines.
+  std::string contents;
+  for (int i = 0; i < 10000; ++i) {
+    contents += std::string(static_cast<size_t>(i % 13), 'x') + std::to_string(i) + '\n';
+  }
+  FileSystem::WriteStringToFile(contents + "last", fn.c_str());
+  current::WorkStealingExecutor executor(4u);
+  for (size_t block_size : {1u, 7u, 100u, 4096u, 1u << 22}) {
+    std::atomic<size_t> count(0u);
+    std::atomic<size_t> total_length(0u);
+    current::ParallelForEachLineOfFile(
+        executor,
+        fn,
+        [&](std::string_view line) {
+          ++count;
+          total_length += line.length();
+        },
+        block_size);
+    EXPECT_EQ(10001u, count.load()) << block_size;
+    EXPECT_EQ(contents.length() - 10000u + 4u, total_length.load()) << block_size;
+
+    std::string reassembled;
+    current::ParallelMapLinesOfFile(
+        executor,
+        fn,
+        [](std::string_view line) { return std::string(line) + '\n'; },
+        [&reassembled](std::string&& line) { reassembled += line; },
+        block_size);
+    EXPECT_EQ(contents + "last\n", reassembled) << block_size;
+  }
+
+  // The exceptions are rethrown once the blocks in flight are done.
+  EXPECT_THROW(current::ParallelMapLinesOfFile(
+                   executor,
+                   fn,
+                   [](std::string_view line) {
+                     if (line == "1001") {
+                       throw std::logic_error("map");
+                     }
+                     return line.length();
+                   },
+                   [](size_t) {},
+                   100u),
+               std::logic_error);
+}
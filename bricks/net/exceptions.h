@@ -77,8 +77,11 @@ struct SocketResolveAddressException : ClientSocketException {
 
 struct SocketFcntlException : SocketException {};
 struct SocketReadException : SocketException {};  // LCOV_EXCL_LINE -- TODO(dkorolev): We might want to test it.
+struct SocketReadTimeoutException : SocketReadException {};
 struct SocketWriteException : SocketException {};
 struct SocketCouldNotWriteEverythingException : SocketWriteException {};
+struct SocketWriteTimeoutException : SocketCouldNotWriteEverythingException {};
+struct SocketOptionException : SocketException {};  // LCOV_EXCL_LINE -- not covered by unit tests.
 
 // We noticed some browsers, Firefox and Chrome included, may pre-open a TCP connection for performance reasons,
 // but never send any data. While it is a legitimate case, it results in an annoying warning dumped by Current.
@@ -102,6 +105,8 @@ struct HTTPRedirectLoopException : HTTPException {
 struct HTTPPayloadTooLarge : HTTPException {};
 struct HTTPRequestBodyLengthNotProvided : HTTPException {};
 struct ChunkSizeNotAValidHEXValue : HTTPException {};
+struct HTTPResponseTimeoutException : HTTPException {};
+struct HTTPClientShutDownException : HTTPException {};
 
 // AttemptedToSendHTTPResponseMoreThanOnce is a user code exception; not really an HTTP one.
 struct AttemptedToSendHTTPResponseMoreThanOnce : Exception {};
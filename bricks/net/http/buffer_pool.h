@@ -0,0 +1,204 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// `HTTPBufferPool` keeps the buffers the HTTP messages have been read into, and the chunked bodies have been
+// accumulated in, for the next messages to reuse, instead of allocating, and zeroing, new ones for each connection.
+//
+// The buffers are kept by their size class, from `kMinBufferSize` to `kMaxBufferSize` bytes, doubling, in a small
+// cache of each thread first, and in the pool shared by all the threads once the thread's cache is full. The
+// buffers larger than `kMaxBufferSize` are freed, as is everything past `kMaxSharedBytes` kept in the shared pool.
+
+#ifndef BRICKS_NET_HTTP_BUFFER_POOL_H
+#define BRICKS_NET_HTTP_BUFFER_POOL_H
+
+#include "../../port.h"
+
+#include <mutex>
+#include <vector>
+
+#include "../../util/singleton.h"
+
+namespace current {
+namespace net {
+
+class HTTPBufferPool final {
+ public:
+  constexpr static size_t kMinBufferSize = 16 * 1024;
+  constexpr static size_t kMaxBufferSize = 1024 * 1024;
+  constexpr static size_t kSizeClasses = 7u;  // 16KB, 32KB, ..., 1MB.
+  constexpr static size_t kMaxBuffersPerThreadAndClass = 2u;
+  constexpr static size_t kMaxSharedBytes = 16 * 1024 * 1024;
+
+  // Returns a buffer of at least `min_capacity` bytes of capacity, with its former contents, if any, left as is,
+  // or an empty one, to be allocated by the caller, if none is kept.
+  static std::vector<char> Acquire(size_t min_capacity) {
+    if (min_capacity > kMaxBufferSize) {
+      return std::vector<char>();
+    }
+    std::vector<char> result;
+    if (ThreadCache::Destroyed() || !ThreadLocalSingleton<ThreadCache>().Take(min_capacity, result)) {
+      Shared().Take(min_capacity, result);
+    }
+    return result;
+  }
+
+  // Keeps the buffer for the next `Acquire()`, unless it is too small or too large to be worth keeping.
+  static void Release(std::vector<char>&& buffer) {
+    const size_t capacity = buffer.capacity();
+    if (capacity < kMinBufferSize || capacity > kMaxBufferSize) {
+      return;
+    }
+    const size_t size_class = SizeClass(capacity);
+    if (ThreadCache::Destroyed() || !ThreadLocalSingleton<ThreadCache>().Put(size_class, buffer)) {
+      Shared().Put(size_class, buffer);
+    }
+  }
+
+  // The number of bytes of the buffers kept by the shared pool, and by the cache of the calling thread.
+  static size_t SharedBytes() { return Shared().Bytes(); }
+  static size_t ThreadCachedBytes() { return ThreadLocalSingleton<ThreadCache>().Bytes(); }
+
+  // Frees the buffers kept by the shared pool, and by the cache of the calling thread.
+  static void Clear() {
+    if (!ThreadCache::Destroyed()) {
+      ThreadLocalSingleton<ThreadCache>().Clear();
+    }
+    Shared().Clear();
+  }
+
+ private:
+  // The size class `i` holds the buffers of `kMinBufferSize << i` bytes of capacity, up to twice that.
+  static size_t SizeClass(size_t capacity) {
+    size_t size_class = 0u;
+    while (size_class + 1u < kSizeClasses && (kMinBufferSize << (size_class + 1u)) <= capacity) {
+      ++size_class;
+    }
+    return size_class;
+  }
+
+  // Takes the last buffer kept of the size class of `min_capacity`, if it is large enough, or of a larger one.
+  static bool TakeFrom(std::vector<std::vector<char>> (&buffers)[kSizeClasses],
+                       size_t min_capacity,
+                       std::vector<char>& result) {
+    const size_t size_class = SizeClass(min_capacity);
+    for (size_t i = size_class; i < kSizeClasses; ++i) {
+      if (!buffers[i].empty() && buffers[i].back().capacity() >= min_capacity) {
+        result = std::move(buffers[i].back());
+        buffers[i].pop_back();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  struct SharedPool;
+
+  // Never destructed, as the threads still running at exit may release their buffers after the statics are gone.
+  static SharedPool& Shared() {
+    static SharedPool* instance = new SharedPool();
+    return *instance;
+  }
+
+  struct SharedPool final {
+    std::mutex mutex;
+    std::vector<std::vector<char>> buffers[kSizeClasses];
+    size_t bytes = 0u;
+
+    bool Take(size_t min_capacity, std::vector<char>& result) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (TakeFrom(buffers, min_capacity, result)) {
+        bytes -= result.capacity();
+        return true;
+      }
+      return false;
+    }
+    void Put(size_t size_class, std::vector<char>& buffer) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (bytes + buffer.capacity() <= kMaxSharedBytes) {
+        bytes += buffer.capacity();
+        buffers[size_class].push_back(std::move(buffer));
+      }
+    }
+    size_t Bytes() {
+      std::lock_guard<std::mutex> lock(mutex);
+      return bytes;
+    }
+    void Clear() {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (auto& size_class_buffers : buffers) {
+        size_class_buffers.clear();
+      }
+      bytes = 0u;
+    }
+  };
+
+  // Hands the buffers over to the shared pool once its thread is done.
+  struct ThreadCache final {
+    std::vector<std::vector<char>> buffers[kSizeClasses];
+
+    ~ThreadCache() {
+      for (size_t i = 0u; i < kSizeClasses; ++i) {
+        for (std::vector<char>& buffer : buffers[i]) {
+          Shared().Put(i, buffer);
+        }
+      }
+      Destroyed() = true;
+    }
+
+    // Set once the cache of the calling thread is gone, for the buffers released past that point, i.e. by the
+    // destructors of other thread-local or static objects, to go straight to the shared pool.
+    static bool& Destroyed() {
+      thread_local static bool destroyed = false;
+      return destroyed;
+    }
+
+    bool Take(size_t min_capacity, std::vector<char>& result) { return TakeFrom(buffers, min_capacity, result); }
+    bool Put(size_t size_class, std::vector<char>& buffer) {
+      if (buffers[size_class].size() < kMaxBuffersPerThreadAndClass) {
+        buffers[size_class].push_back(std::move(buffer));
+        return true;
+      }
+      return false;
+    }
+    void Clear() {
+      for (auto& size_class_buffers : buffers) {
+        size_class_buffers.clear();
+      }
+    }
+    size_t Bytes() const {
+      size_t result = 0u;
+      for (const auto& size_class_buffers : buffers) {
+        for (const std::vector<char>& buffer : size_class_buffers) {
+          result += buffer.capacity();
+        }
+      }
+      return result;
+    }
+  };
+};
+
+}  // namespace net
+}  // namespace current
+
+#endif  // BRICKS_NET_HTTP_BUFFER_POOL_H
@@ -0,0 +1,143 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// The opt-in compression of the HTTP responses, with the content encodings negotiated via `Accept-Encoding`.
+// The responses of at least `min_size` bytes, of the content types listed, are compressed with gzip or deflate;
+// the chunked ones are compressed regardless of their size, as it is not known upfront, with every flushed chunk
+// decompressible by the client right away. See `HTTPServerPOSIX::SetCompression()`.
+
+#ifndef BRICKS_NET_HTTP_COMPRESSION_H
+#define BRICKS_NET_HTTP_COMPRESSION_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "constants.h"
+
+#include "../../util/deflate.h"
+
+namespace current {
+namespace net {
+
+struct HTTPCompressionOptions final {
+  // The smaller responses are not worth compressing.
+  size_t min_size = 1024u;
+  // The prefixes of the content types to compress; the images, archives and such are compressed already.
+  std::vector<std::string> content_types = {
+      "text/", "application/json", "application/javascript", "application/xml", "image/svg+xml"};
+};
+
+// Returns the content encoding to compress the response with, given the `Accept-Encoding` header of the request,
+// or `nullptr` if the client accepts neither gzip nor deflate. Prefers gzip, unless the client prefers deflate.
+inline const char* ChooseHTTPContentEncoding(const std::string& accept_encoding) {
+  double gzip = 0.0;
+  double deflate = 0.0;
+  double any = 0.0;
+  bool gzip_listed = false;
+  bool deflate_listed = false;
+  for (size_t begin = 0u; begin < accept_encoding.length();) {
+    size_t end = accept_encoding.find(',', begin);
+    if (end == std::string::npos) {
+      end = accept_encoding.length();
+    }
+    const size_t semicolon = std::min(accept_encoding.find(';', begin), end);
+    std::string coding;
+    for (size_t i = begin; i < semicolon; ++i) {
+      if (!std::isspace(static_cast<unsigned char>(accept_encoding[i]))) {
+        coding += static_cast<char>(std::tolower(static_cast<unsigned char>(accept_encoding[i])));
+      }
+    }
+    double q = 1.0;
+    const size_t q_position = accept_encoding.find("q=", semicolon);
+    if (q_position < end) {
+      q = std::strtod(accept_encoding.c_str() + q_position + 2u, nullptr);
+    }
+    if (coding == "gzip" || coding == "x-gzip") {
+      gzip = q;
+      gzip_listed = true;
+    } else if (coding == "deflate") {
+      deflate = q;
+      deflate_listed = true;
+    } else if (coding == "*") {
+      any = q;
+    }
+    begin = end + 1u;
+  }
+  if (!gzip_listed) {
+    gzip = any;
+  }
+  if (!deflate_listed) {
+    deflate = any;
+  }
+  if (gzip > 0.0 && gzip >= deflate) {
+    return constants::kContentEncodingGzipValue;
+  } else if (deflate > 0.0) {
+    return constants::kContentEncodingDeflateValue;
+  } else {
+    return nullptr;
+  }
+}
+
+inline bool IsCompressibleHTTPContentType(const HTTPCompressionOptions& options, const std::string& content_type) {
+  for (const std::string& prefix : options.content_types) {
+    if (!content_type.compare(0u, prefix.length(), prefix)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The format of the data of the content encoding: HTTP calls the zlib format "deflate".
+inline DeflateFormat HTTPContentEncodingFormat(const char* encoding) {
+  return std::string(encoding) == constants::kContentEncodingGzipValue ? DeflateFormat::Gzip : DeflateFormat::Zlib;
+}
+
+// Decompresses the body received with `Content-Encoding` of `encoding`. Some servers send raw DEFLATE data
+// as "deflate", instead of the zlib format, which is taken care of as well.
+inline std::string DecompressHTTPBody(const std::string& body, const std::string& encoding, size_t max_size) {
+  std::string lowercase;
+  for (const char c : encoding) {
+    if (!std::isspace(static_cast<unsigned char>(c))) {
+      lowercase += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+  }
+  if (lowercase == "gzip" || lowercase == "x-gzip") {
+    return DeflateDecompress(body, DeflateFormat::Gzip, max_size);
+  } else if (lowercase == "deflate") {
+    const bool zlib = body.length() >= 2u && (static_cast<uint8_t>(body[0]) & 0x0fu) == 8u &&
+                      !(((static_cast<uint8_t>(body[0]) << 8) | static_cast<uint8_t>(body[1])) % 31u);
+    return DeflateDecompress(body, zlib ? DeflateFormat::Zlib : DeflateFormat::Raw, max_size);
+  } else {
+    return body;
+  }
+}
+
+}  // namespace net
+}  // namespace current
+
+#endif  // BRICKS_NET_HTTP_COMPRESSION_H
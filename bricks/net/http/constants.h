@@ -50,6 +50,13 @@ constexpr char kContentLengthHeaderKey[] = "Content-Length";
 constexpr char kTransferEncodingHeaderKey[] = "Transfer-Encoding";
 constexpr char kTransferEncodingChunkedValue[] = "chunked";
 constexpr char kHTTPMethodOverrideHeaderKey[] = "X-HTTP-Method-Override";
+constexpr char kConnectionHeaderKey[] = "Connection";
+constexpr char kConnectionCloseValue[] = "close";
+constexpr char kConnectionKeepAliveValue[] = "keep-alive";
+constexpr char kAcceptEncodingHeaderKey[] = "Accept-Encoding";
+constexpr char kContentEncodingHeaderKey[] = "Content-Encoding";
+constexpr char kContentEncodingGzipValue[] = "gzip";
+constexpr char kContentEncodingDeflateValue[] = "deflate";
 
 // By default:
 // * HTTP responses that use `struct Response` will have the CORS header set.
@@ -65,6 +72,9 @@ constexpr size_t kMaxHTTPPayloadSizeInBytes = 1024 * 1024 * 16;
 constexpr size_t kMaxHTTPPayloadSizeInBytes = CURRENT_MAX_HTTP_PAYLOAD;
 #endif  // CURRENT_MAX_HTTP_PAYLOAD
 
+// The limit on the size of the compressed bodies the client decompresses, to not be taken down by a "zip bomb".
+constexpr size_t kMaxHTTPDecompressedBodySizeInBytes = kMaxHTTPPayloadSizeInBytes * 16;
+
 }  // namespace constants
 }  // namespace net
 }  // namespace current
@@ -42,6 +42,7 @@ inline std::string DefaultMethodNotAllowedMessage() { return "<h1>METHOD NOT ALL
 inline std::string DefaultRequestEntityTooLargeMessage() { return "<h1>ENTITY TOO LARGE</h1>\n"; }
 inline std::string DefaultLengthRequiredMessage() { return "<h1>LENGTH REQUIRED</h1>\n"; }
 inline std::string DefaultInvalidHEXChunkSizeBadRequestMessage() { return "<h1>BAD CHUNK SIZE</h1>\n"; }
+inline std::string DefaultServiceUnavailableMessage() { return "<h1>SERVICE UNAVAILABLE</h1>\n"; }
 
 }  // namespace net
 }  // namespace current
@@ -29,6 +29,7 @@ SOFTWARE.
 
 #include "body_requirement.h"
 #include "codes.h"
+#include "compression.h"
 #include "mime_type.h"
 #include "default_messages.h"
 
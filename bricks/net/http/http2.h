@@ -0,0 +1,671 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// The wire format of HTTP/2, RFC 7540, and its header compression, HPACK, RFC 7541: the framing, the Huffman code,
+// and the HPACK encoder and decoder, each of which keeps the dynamic table of its side of the connection.
+// No I/O here; see `blocks/http/impl/posix_server_http2.h` for the server that speaks HTTP/2 over a `Connection`.
+
+#ifndef BRICKS_NET_HTTP_HTTP2_H
+#define BRICKS_NET_HTTP_HTTP2_H
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "../exceptions.h"
+
+namespace current {
+namespace net {
+namespace http2 {
+
+struct HTTP2Exception : HTTPException {
+  using HTTPException::HTTPException;
+};
+
+struct HPACKDecodingException : HTTP2Exception {
+  using HTTP2Exception::HTTP2Exception;
+};
+
+// What the client sends first, before its `SETTINGS` frame, over a connection it knows to speak HTTP/2.
+constexpr char kConnectionPreface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+constexpr size_t kConnectionPrefaceLength = sizeof(kConnectionPreface) - 1u;
+
+// The protocol ID to negotiate HTTP/2 over TLS with ALPN.
+constexpr char kALPNProtocolID[] = "h2";
+
+constexpr size_t kFrameHeaderLength = 9u;
+constexpr uint32_t kDefaultMaxFrameSize = 16384u;
+constexpr uint32_t kMaxAllowedFrameSize = (1u << 24) - 1u;
+constexpr uint32_t kDefaultInitialWindowSize = 65535u;
+constexpr uint32_t kMaxWindowSize = (1u << 31) - 1u;
+constexpr size_t kDefaultHeaderTableSize = 4096u;
+
+enum class FrameType : uint8_t {
+  Data = 0x0,
+  Headers = 0x1,
+  Priority = 0x2,
+  RSTStream = 0x3,
+  Settings = 0x4,
+  PushPromise = 0x5,
+  Ping = 0x6,
+  GoAway = 0x7,
+  WindowUpdate = 0x8,
+  Continuation = 0x9
+};
+
+// The flags of the frames. `kFlagAck` is of `SETTINGS` and `PING`, `kFlagEndStream` is of `DATA` and `HEADERS`.
+constexpr uint8_t kFlagEndStream = 0x1;
+constexpr uint8_t kFlagAck = 0x1;
+constexpr uint8_t kFlagEndHeaders = 0x4;
+constexpr uint8_t kFlagPadded = 0x8;
+constexpr uint8_t kFlagPriority = 0x20;
+
+enum class Setting : uint16_t {
+  HeaderTableSize = 0x1,
+  EnablePush = 0x2,
+  MaxConcurrentStreams = 0x3,
+  InitialWindowSize = 0x4,
+  MaxFrameSize = 0x5,
+  MaxHeaderListSize = 0x6
+};
+
+enum class ErrorCode : uint32_t {
+  NoError = 0x0,
+  ProtocolError = 0x1,
+  InternalError = 0x2,
+  FlowControlError = 0x3,
+  SettingsTimeout = 0x4,
+  StreamClosed = 0x5,
+  FrameSizeError = 0x6,
+  RefusedStream = 0x7,
+  Cancel = 0x8,
+  CompressionError = 0x9,
+  ConnectError = 0xa,
+  EnhanceYourCalm = 0xb,
+  InadequateSecurity = 0xc,
+  HTTP11Required = 0xd
+};
+
+// A connection error, RFC 7540 Section 5.4.1, after which the connection is closed with a `GOAWAY` of `error_code`.
+struct HTTP2ConnectionError : HTTP2Exception {
+  const ErrorCode error_code;
+  HTTP2ConnectionError(ErrorCode error_code, const std::string& message)
+      : HTTP2Exception(message), error_code(error_code) {}
+};
+
+// The header fields, in order, with the names in lowercase, and with the pseudo-header fields, `:method` and such,
+// first. The names may repeat.
+using HeaderList = std::vector<std::pair<std::string, std::string>>;
+
+inline uint32_t ReadUInt32(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+inline void AppendUInt32(std::string& output, uint32_t value) {
+  output.push_back(static_cast<char>(value >> 24));
+  output.push_back(static_cast<char>(value >> 16));
+  output.push_back(static_cast<char>(value >> 8));
+  output.push_back(static_cast<char>(value));
+}
+
+struct FrameHeader final {
+  uint32_t length = 0u;
+  FrameType type = FrameType::Data;
+  uint8_t flags = 0u;
+  uint32_t stream_id = 0u;
+
+  FrameHeader() = default;
+  FrameHeader(uint32_t length, FrameType type, uint8_t flags, uint32_t stream_id)
+      : length(length), type(type), flags(flags), stream_id(stream_id) {}
+
+  // Parses the `kFrameHeaderLength` bytes at `p`. The reserved bit of the stream ID is ignored, as it should be.
+  static FrameHeader Parse(const uint8_t* p) {
+    return FrameHeader((static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[1]) << 8) | p[2],
+                       static_cast<FrameType>(p[3]),
+                       p[4],
+                       ReadUInt32(p + 5) & kMaxWindowSize);
+  }
+
+  // Writes the `kFrameHeaderLength` bytes to `p`.
+  void Write(uint8_t* p) const {
+    p[0] = static_cast<uint8_t>(length >> 16);
+    p[1] = static_cast<uint8_t>(length >> 8);
+    p[2] = static_cast<uint8_t>(length);
+    p[3] = static_cast<uint8_t>(type);
+    p[4] = flags;
+    p[5] = static_cast<uint8_t>(stream_id >> 24);
+    p[6] = static_cast<uint8_t>(stream_id >> 16);
+    p[7] = static_cast<uint8_t>(stream_id >> 8);
+    p[8] = static_cast<uint8_t>(stream_id);
+  }
+
+  bool HasFlag(uint8_t flag) const { return (flags & flag) != 0u; }
+};
+
+// The frame as it goes over the wire, the header followed by the payload.
+inline std::string SerializeFrame(FrameType type, uint8_t flags, uint32_t stream_id, std::string_view payload = "") {
+  std::string result(kFrameHeaderLength, '\0');
+  FrameHeader(static_cast<uint32_t>(payload.length()), type, flags, stream_id)
+      .Write(reinterpret_cast<uint8_t*>(&result[0]));
+  result.append(payload.data(), payload.length());
+  return result;
+}
+
+inline std::string SettingsPayload(const std::vector<std::pair<Setting, uint32_t>>& settings) {
+  std::string result;
+  for (const auto& setting : settings) {
+    result.push_back(static_cast<char>(static_cast<uint16_t>(setting.first) >> 8));
+    result.push_back(static_cast<char>(static_cast<uint16_t>(setting.first)));
+    AppendUInt32(result, setting.second);
+  }
+  return result;
+}
+
+// The payload of `WINDOW_UPDATE`, as well as of `RST_STREAM`, which is the error code.
+inline std::string UInt32Payload(uint32_t value) {
+  std::string result;
+  AppendUInt32(result, value);
+  return result;
+}
+
+inline std::string GoAwayPayload(uint32_t last_stream_id, ErrorCode error_code) {
+  std::string result;
+  AppendUInt32(result, last_stream_id);
+  AppendUInt32(result, static_cast<uint32_t>(error_code));
+  return result;
+}
+
+// The canonical Huffman code of HPACK, RFC 7541 Appendix B. The codes are assigned in the order of their lengths,
+// and of the symbols for the same length, so the lengths are all there is to the code. Symbol 256 is EOS.
+class HPACKHuffmanCode final {
+ public:
+  static const HPACKHuffmanCode& Instance() {
+    static const HPACKHuffmanCode instance;
+    return instance;
+  }
+
+  size_t EncodedLength(std::string_view s) const {
+    size_t bits = 0u;
+    for (const char c : s) {
+      bits += kLengths[static_cast<uint8_t>(c)];
+    }
+    return (bits + 7u) / 8u;
+  }
+
+  // Appends the encoded `s` to `output`, padded with the most significant bits of EOS, which are all ones.
+  void Encode(std::string_view s, std::string& output) const {
+    uint64_t bits = 0u;
+    uint32_t bits_count = 0u;
+    for (const char c : s) {
+      const uint8_t symbol = static_cast<uint8_t>(c);
+      bits = (bits << kLengths[symbol]) | codes_[symbol];
+      bits_count += kLengths[symbol];
+      while (bits_count >= 8u) {
+        bits_count -= 8u;
+        output.push_back(static_cast<char>(bits >> bits_count));
+      }
+      bits &= (uint64_t(1) << bits_count) - 1u;
+    }
+    if (bits_count) {
+      output.push_back(static_cast<char>((bits << (8u - bits_count)) | (0xffu >> bits_count)));
+    }
+  }
+
+  // Throws `HPACKDecodingException` on EOS, and on the padding that is longer than seven bits or is not all ones.
+  std::string Decode(std::string_view s) const {
+    std::string result;
+    result.reserve(s.length() * 8u / 5u);
+    uint32_t code = 0u;
+    uint32_t length = 0u;
+    bool all_ones = true;
+    for (const char c : s) {
+      const uint8_t byte = static_cast<uint8_t>(c);
+      for (int bit = 7; bit >= 0; --bit) {
+        const uint32_t b = (byte >> bit) & 1u;
+        code = (code << 1) | b;
+        ++length;
+        all_ones = all_ones && b;
+        // The codes of each length are consecutive, and precede the prefixes of the longer ones.
+        if (count_[length] && code - first_code_[length] < count_[length]) {
+          const uint16_t symbol = symbols_[offset_[length] + (code - first_code_[length])];
+          if (symbol == kEOS) {
+            CURRENT_THROW(HPACKDecodingException("HPACK: EOS in a Huffman-encoded string."));
+          }
+          result.push_back(static_cast<char>(symbol));
+          code = 0u;
+          length = 0u;
+          all_ones = true;
+        } else if (length == kMaxLength) {
+          CURRENT_THROW(HPACKDecodingException("HPACK: invalid Huffman code."));  // LCOV_EXCL_LINE
+        }
+      }
+    }
+    if (length > 7u || !all_ones) {
+      CURRENT_THROW(HPACKDecodingException("HPACK: invalid Huffman padding."));
+    }
+    return result;
+  }
+
+ private:
+  constexpr static uint16_t kEOS = 256u;
+  constexpr static uint32_t kMaxLength = 30u;
+  constexpr static uint8_t kLengths[257] = {
+      13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 30, 28, 28, 28,
+      28, 28, 28, 28, 28, 28, 6,  10, 10, 12, 13, 6,  8,  11, 10, 10, 8,  11, 8,  6,  6,  6,  5,  5,  5,  6,
+      6,  6,  6,  6,  6,  6,  7,  8,  15, 6,  12, 10, 13, 6,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
+      7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  8,  7,  8,  13, 19, 13, 14, 6,  15, 5,  6,  5,  6,  5,  6,  6,
+      6,  5,  7,  7,  6,  6,  6,  5,  6,  7,  6,  5,  5,  6,  7,  7,  7,  7,  7,  15, 11, 14, 13, 28, 20, 22,
+      20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23, 24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23,
+      22, 23, 23, 24, 22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23, 21, 21, 22, 21, 23, 22,
+      23, 23, 20, 22, 22, 22, 23, 22, 22, 23, 26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+      19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27, 20, 24, 20, 21, 22, 21, 21, 23, 22, 22,
+      25, 25, 24, 24, 26, 23, 26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26, 30};
+
+  HPACKHuffmanCode() {
+    std::iota(symbols_, symbols_ + 257, 0);
+    std::stable_sort(
+        symbols_, symbols_ + 257, [](uint16_t a, uint16_t b) { return kLengths[a] < kLengths[b]; });
+    uint32_t code = 0u;
+    uint32_t length = kLengths[symbols_[0]];
+    for (uint16_t i = 0u; i < 257u; ++i) {
+      const uint16_t symbol = symbols_[i];
+      code <<= (kLengths[symbol] - length);
+      length = kLengths[symbol];
+      if (!count_[length]) {
+        first_code_[length] = code;
+        offset_[length] = i;
+      }
+      ++count_[length];
+      codes_[symbol] = code++;
+    }
+  }
+
+  uint32_t codes_[257];
+  // The symbols in the order of their codes, and, per code length, the first code, and where its symbols start.
+  uint16_t symbols_[257];
+  uint32_t first_code_[kMaxLength + 1u] = {};
+  uint16_t offset_[kMaxLength + 1u] = {};
+  uint16_t count_[kMaxLength + 1u] = {};
+};
+
+// The integers of HPACK, with the `prefix_bits` least significant bits of the first byte, RFC 7541 Section 5.1.
+inline void HPACKEncodeInteger(std::string& output, uint8_t first_byte, uint8_t prefix_bits, uint64_t value) {
+  const uint64_t max_prefix = (1u << prefix_bits) - 1u;
+  if (value < max_prefix) {
+    output.push_back(static_cast<char>(first_byte | value));
+  } else {
+    output.push_back(static_cast<char>(first_byte | max_prefix));
+    value -= max_prefix;
+    while (value >= 128u) {
+      output.push_back(static_cast<char>((value % 128u) + 128u));
+      value /= 128u;
+    }
+    output.push_back(static_cast<char>(value));
+  }
+}
+
+inline uint64_t HPACKDecodeInteger(const uint8_t*& p, const uint8_t* end, uint8_t prefix_bits) {
+  if (p == end) {
+    CURRENT_THROW(HPACKDecodingException("HPACK: truncated integer."));  // LCOV_EXCL_LINE
+  }
+  const uint64_t max_prefix = (1u << prefix_bits) - 1u;
+  uint64_t value = *p++ & max_prefix;
+  if (value < max_prefix) {
+    return value;
+  }
+  for (uint32_t shift = 0u;; shift += 7u) {
+    if (p == end) {
+      CURRENT_THROW(HPACKDecodingException("HPACK: truncated integer."));
+    }
+    if (shift > 28u) {
+      CURRENT_THROW(HPACKDecodingException("HPACK: integer overflow."));
+    }
+    const uint8_t byte = *p++;
+    value += static_cast<uint64_t>(byte & 127u) << shift;
+    if (!(byte & 128u)) {
+      return value;
+    }
+  }
+}
+
+// The string literals of HPACK, Huffman-encoded if that makes them shorter, RFC 7541 Section 5.2.
+inline void HPACKEncodeString(std::string& output, std::string_view s) {
+  const HPACKHuffmanCode& huffman = HPACKHuffmanCode::Instance();
+  const size_t huffman_length = huffman.EncodedLength(s);
+  if (huffman_length < s.length()) {
+    HPACKEncodeInteger(output, 0x80, 7u, huffman_length);
+    huffman.Encode(s, output);
+  } else {
+    HPACKEncodeInteger(output, 0x00, 7u, s.length());
+    output.append(s.data(), s.length());
+  }
+}
+
+inline std::string HPACKDecodeString(const uint8_t*& p, const uint8_t* end) {
+  if (p == end) {
+    CURRENT_THROW(HPACKDecodingException("HPACK: truncated string."));  // LCOV_EXCL_LINE
+  }
+  const bool huffman = (*p & 0x80) != 0u;
+  const uint64_t length = HPACKDecodeInteger(p, end, 7u);
+  if (length > static_cast<uint64_t>(end - p)) {
+    CURRENT_THROW(HPACKDecodingException("HPACK: truncated string."));
+  }
+  const std::string_view s(reinterpret_cast<const char*>(p), static_cast<size_t>(length));
+  p += length;
+  return huffman ? HPACKHuffmanCode::Instance().Decode(s) : std::string(s);
+}
+
+// The static table, RFC 7541 Appendix A. The indexes are one-based.
+constexpr size_t kHPACKStaticTableSize = 61u;
+inline const std::pair<const char*, const char*>& HPACKStaticTableEntry(size_t index) {
+  static const std::pair<const char*, const char*> table[kHPACKStaticTableSize] = {
+      {":authority", ""},
+      {":method", "GET"},
+      {":method", "POST"},
+      {":path", "/"},
+      {":path", "/index.html"},
+      {":scheme", "http"},
+      {":scheme", "https"},
+      {":status", "200"},
+      {":status", "204"},
+      {":status", "206"},
+      {":status", "304"},
+      {":status", "400"},
+      {":status", "404"},
+      {":status", "500"},
+      {"accept-charset", ""},
+      {"accept-encoding", "gzip, deflate"},
+      {"accept-language", ""},
+      {"accept-ranges", ""},
+      {"accept", ""},
+      {"access-control-allow-origin", ""},
+      {"age", ""},
+      {"allow", ""},
+      {"authorization", ""},
+      {"cache-control", ""},
+      {"content-disposition", ""},
+      {"content-encoding", ""},
+      {"content-language", ""},
+      {"content-length", ""},
+      {"content-location", ""},
+      {"content-range", ""},
+      {"content-type", ""},
+      {"cookie", ""},
+      {"date", ""},
+      {"etag", ""},
+      {"expect", ""},
+      {"expires", ""},
+      {"from", ""},
+      {"host", ""},
+      {"if-match", ""},
+      {"if-modified-since", ""},
+      {"if-none-match", ""},
+      {"if-range", ""},
+      {"if-unmodified-since", ""},
+      {"last-modified", ""},
+      {"link", ""},
+      {"location", ""},
+      {"max-forwards", ""},
+      {"proxy-authenticate", ""},
+      {"proxy-authorization", ""},
+      {"range", ""},
+      {"referer", ""},
+      {"refresh", ""},
+      {"retry-after", ""},
+      {"server", ""},
+      {"set-cookie", ""},
+      {"strict-transport-security", ""},
+      {"transfer-encoding", ""},
+      {"user-agent", ""},
+      {"vary", ""},
+      {"via", ""},
+      {"www-authenticate", ""}};
+  return table[index - 1u];
+}
+
+// The dynamic table of either side, RFC 7541 Section 4, the most recently added entry first.
+class HPACKDynamicTable final {
+ public:
+  explicit HPACKDynamicTable(size_t max_size) : max_size_(max_size) {}
+
+  // The size of an entry is the length of its name and its value, plus 32 bytes of overhead.
+  static size_t EntrySize(const std::string& name, const std::string& value) {
+    return name.length() + value.length() + 32u;
+  }
+
+  size_t Size() const { return size_; }
+  size_t MaxSize() const { return max_size_; }
+  size_t Entries() const { return entries_.size(); }
+  const std::pair<std::string, std::string>& Entry(size_t i) const { return entries_[i]; }
+
+  void SetMaxSize(size_t max_size) {
+    max_size_ = max_size;
+    EvictTo(max_size_);
+  }
+
+  // An entry larger than the whole table empties it, and is not added.
+  void Add(std::string name, std::string value) {
+    const size_t entry_size = EntrySize(name, value);
+    if (entry_size > max_size_) {
+      EvictTo(0u);
+    } else {
+      EvictTo(max_size_ - entry_size);
+      entries_.emplace_front(std::move(name), std::move(value));
+      size_ += entry_size;
+    }
+  }
+
+ private:
+  void EvictTo(size_t size) {
+    while (size_ > size) {
+      size_ -= EntrySize(entries_.back().first, entries_.back().second);
+      entries_.pop_back();
+    }
+  }
+
+  size_t max_size_;
+  size_t size_ = 0u;
+  std::deque<std::pair<std::string, std::string>> entries_;
+};
+
+// Decodes the header blocks of one direction of a connection, in the order they have been received in.
+// Throws `HPACKDecodingException`, after which the connection can only be torn down with `COMPRESSION_ERROR`.
+class HPACKDecoder final {
+ public:
+  // `max_table_size` is the `SETTINGS_HEADER_TABLE_SIZE` this side has announced, the limit of the table size updates
+  // the peer can make. `max_header_list_size` bounds the decoded headers of a single block, as a block of a few bytes
+  // can refer to the large entries of the table over and over again.
+  explicit HPACKDecoder(size_t max_table_size = kDefaultHeaderTableSize, size_t max_header_list_size = 256u * 1024u)
+      : max_table_size_(max_table_size), max_header_list_size_(max_header_list_size), table_(max_table_size) {}
+
+  const HPACKDynamicTable& Table() const { return table_; }
+
+  HeaderList Decode(std::string_view block) {
+    HeaderList result;
+    size_t header_list_size = 0u;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(block.data());
+    const uint8_t* const end = p + block.length();
+    while (p != end) {
+      const uint8_t byte = *p;
+      if (byte & 0x80) {
+        // Indexed header field.
+        const std::pair<std::string, std::string> field = Lookup(HPACKDecodeInteger(p, end, 7u));
+        Append(result, header_list_size, field.first, field.second);
+      } else if ((byte & 0xe0) == 0x20) {
+        // Dynamic table size update. Only allowed at the beginning of the block.
+        if (!result.empty()) {
+          CURRENT_THROW(HPACKDecodingException("HPACK: table size update after a header field."));
+        }
+        const uint64_t size = HPACKDecodeInteger(p, end, 5u);
+        if (size > max_table_size_) {
+          CURRENT_THROW(HPACKDecodingException("HPACK: table size update over the limit."));
+        }
+        table_.SetMaxSize(static_cast<size_t>(size));
+      } else {
+        // Literal header field, with incremental indexing if `01`, and without indexing, or never indexed, otherwise.
+        const bool add_to_table = (byte & 0xc0) == 0x40;
+        const uint64_t index = HPACKDecodeInteger(p, end, add_to_table ? 6u : 4u);
+        std::string name = index ? Lookup(index).first : HPACKDecodeString(p, end);
+        std::string value = HPACKDecodeString(p, end);
+        Append(result, header_list_size, name, value);
+        if (add_to_table) {
+          table_.Add(std::move(name), std::move(value));
+        }
+      }
+    }
+    return result;
+  }
+
+ private:
+  std::pair<std::string, std::string> Lookup(uint64_t index) const {
+    if (index >= 1u && index <= kHPACKStaticTableSize) {
+      const auto& entry = HPACKStaticTableEntry(static_cast<size_t>(index));
+      return std::make_pair(std::string(entry.first), std::string(entry.second));
+    } else if (index > kHPACKStaticTableSize && index - kHPACKStaticTableSize <= table_.Entries()) {
+      return table_.Entry(static_cast<size_t>(index - kHPACKStaticTableSize - 1u));
+    } else {
+      CURRENT_THROW(HPACKDecodingException("HPACK: invalid index."));
+    }
+  }
+
+  void Append(HeaderList& result, size_t& header_list_size, const std::string& name, const std::string& value) const {
+    header_list_size += HPACKDynamicTable::EntrySize(name, value);
+    if (header_list_size > max_header_list_size_) {
+      CURRENT_THROW(HPACKDecodingException("HPACK: header list too large."));
+    }
+    result.emplace_back(name, value);
+  }
+
+  const size_t max_table_size_;
+  const size_t max_header_list_size_;
+  HPACKDynamicTable table_;
+};
+
+// Encodes the header blocks of one direction of a connection, to be sent in the order they have been encoded in.
+// The header names must be in lowercase. The values of the credentials are never indexed, as per RFC 7541
+// Section 7.1, and neither are the values that change from response to response, not to evict the ones that repeat.
+class HPACKEncoder final {
+ public:
+  explicit HPACKEncoder(size_t max_table_size = kDefaultHeaderTableSize) : table_(max_table_size) {}
+
+  const HPACKDynamicTable& Table() const { return table_; }
+
+  // Applies the `SETTINGS_HEADER_TABLE_SIZE` of the peer, of which no more than `kDefaultHeaderTableSize` is used.
+  // The peer is told of the change at the beginning of the next block.
+  void SetMaxTableSize(size_t max_size) {
+    max_size = std::min(max_size, kDefaultHeaderTableSize);
+    if (max_size != table_.MaxSize() || size_update_pending_) {
+      smallest_size_update_ = size_update_pending_ ? std::min(smallest_size_update_, max_size) : max_size;
+      size_update_pending_ = true;
+      table_.SetMaxSize(max_size);
+    }
+  }
+
+  std::string Encode(const HeaderList& headers) {
+    std::string result;
+    if (size_update_pending_) {
+      if (smallest_size_update_ < table_.MaxSize()) {
+        HPACKEncodeInteger(result, 0x20, 5u, smallest_size_update_);
+      }
+      HPACKEncodeInteger(result, 0x20, 5u, table_.MaxSize());
+      size_update_pending_ = false;
+    }
+    for (const auto& header : headers) {
+      const std::string& name = header.first;
+      const std::string& value = header.second;
+      size_t name_index = 0u;
+      bool exact_match = false;
+      for (size_t i = 1u; i <= kHPACKStaticTableSize && !exact_match; ++i) {
+        const auto& entry = HPACKStaticTableEntry(i);
+        if (name == entry.first) {
+          if (!name_index) {
+            name_index = i;
+          }
+          if (value == entry.second) {
+            name_index = i;
+            exact_match = true;
+          }
+        }
+      }
+      for (size_t i = 0u; i < table_.Entries() && !exact_match; ++i) {
+        const auto& entry = table_.Entry(i);
+        if (name == entry.first) {
+          if (!name_index) {
+            name_index = kHPACKStaticTableSize + 1u + i;
+          }
+          if (value == entry.second) {
+            name_index = kHPACKStaticTableSize + 1u + i;
+            exact_match = true;
+          }
+        }
+      }
+      if (exact_match) {
+        HPACKEncodeInteger(result, 0x80, 7u, name_index);
+        continue;
+      }
+      const bool never_index = IsSensitive(name);
+      const bool add_to_table = !never_index && !ChangesOften(name) &&
+                                HPACKDynamicTable::EntrySize(name, value) <= table_.MaxSize();
+      if (add_to_table) {
+        HPACKEncodeInteger(result, 0x40, 6u, name_index);
+      } else {
+        HPACKEncodeInteger(result, never_index ? 0x10 : 0x00, 4u, name_index);
+      }
+      if (!name_index) {
+        HPACKEncodeString(result, name);
+      }
+      HPACKEncodeString(result, value);
+      if (add_to_table) {
+        table_.Add(name, value);
+      }
+    }
+    return result;
+  }
+
+ private:
+  static bool IsSensitive(const std::string& name) {
+    return name == "authorization" || name == "proxy-authorization" || name == "set-cookie";
+  }
+
+  static bool ChangesOften(const std::string& name) {
+    return name == ":path" || name == "content-length" || name == "content-range" || name == "date" ||
+           name == "etag" || name == "last-modified";
+  }
+
+  HPACKDynamicTable table_;
+  bool size_update_pending_ = false;
+  size_t smallest_size_update_ = 0u;
+};
+
+}  // namespace http2
+}  // namespace net
+}  // namespace current
+
+#endif  // BRICKS_NET_HTTP_HTTP2_H
@@ -25,15 +25,24 @@ SOFTWARE.
 #ifndef BRICKS_NET_HTTP_IMPL_SERVER_H
 #define BRICKS_NET_HTTP_IMPL_SERVER_H
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <functional>
 #include <map>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <vector>
 
 #include "../body_requirement.h"
+#include "../buffer_pool.h"
 #include "../codes.h"
+#include "../compression.h"
 #include "../constants.h"
 #include "../default_messages.h"
 #include "../mime_type.h"
@@ -50,7 +59,7 @@ SOFTWARE.
 #include "../../../strings/split.h"
 #include "../../../strings/util.h"
 
-#include "../../../../blocks/url/url.h"
+#include "../../../../blocks/url/url_view.h"
 
 #ifndef CURRENT_BRICKS_DEBUG_HTTP
 
@@ -75,6 +84,9 @@ SOFTWARE.
 
 #define CURRENT_BRICKS_HTTP_DEFAULT_CHUNK_CACHE_SIZE (1024 * 1024)
 
+// The JSON of a `CURRENT_STRUCT` or `CURRENT_VARIANT` responded with is sent in pieces of this many bytes.
+#define CURRENT_BRICKS_HTTP_JSON_RESPONSE_PIECE_SIZE (64 * 1024)
+
 namespace current {
 namespace net {
 
@@ -94,33 +106,117 @@ struct EventsJournal {
 inline EventsJournal& HTTPDataJournal() { return current::Singleton<EventsJournal>(); }
 #endif  // CURRENT_BRICKS_DEBUG_HTTP
 
+// The name-value pairs of the headers of a message, in the order they go in.
+using HTTPHeaderFields = std::vector<std::pair<std::string, std::string>>;
+
+// Where the response goes if its request has not been received as HTTP/1.1 text, set on the `Connection` of the
+// request with `SetHTTPResponseSink()`. The response is handed over as its status, headers, and body, for the sink
+// to send it on the way the protocol the request has been received over has it, as the streams of HTTP/2 do, see
+// `blocks/http/impl/posix_server_http2.h`. Both calls throw `SocketException`-s once the response can not be sent.
+struct HTTPResponseSink {
+  virtual ~HTTPResponseSink() = default;
+  // Starts the response, with no body if `end` is set.
+  virtual void SendHead(HTTPResponseCodeValue code, const HTTPHeaderFields& headers, bool end) = 0;
+  // Sends the next piece of the body, maybe an empty one; the one with `end` set is the last one.
+  virtual void SendBody(const char* data, size_t length, bool end) = 0;
+};
+
 // HTTP response helpers. Used from both `GenericHTTPRequestData` and `GenericHTTPServerConnection`.
 struct HTTPResponder {
   typedef enum { ConnectionClose, ConnectionKeepAlive } ConnectionType;
-  static void PrepareHTTPResponseHeader(std::ostream& os,
+  // Appends the status line and the headers to `out`, which is reserved for them upfront, to allocate once.
+  static void PrepareHTTPResponseHeader(std::string& out,
                                         ConnectionType connection_type,
                                         HTTPResponseCodeValue code = HTTPResponseCode.OK,
                                         const http::Headers& headers = http::Headers(),
                                         const std::string& content_type = constants::kDefaultContentType) {
-    os << "HTTP/1.1 " << static_cast<int>(code);
-    os << " " << HTTPResponseCodeAsString(code) << constants::kCRLF;
-    os << "Content-Type: " << content_type << constants::kCRLF;
-    os << "Connection: " << (connection_type == ConnectionKeepAlive ? "keep-alive" : "close") << constants::kCRLF;
+    const std::string& code_as_string = HTTPResponseCodeAsString(code);
+    size_t length = 128u + code_as_string.length() + content_type.length();
     for (const auto& cit : headers) {
-      os << cit.header << ": " << cit.value << constants::kCRLF;
+      length += cit.header.length() + cit.value.length() + 4u;
     }
     for (const auto& cit : headers.cookies) {
-      os << "Set-Cookie: " << cit.first << '=' << cit.second.value;
+      length += cit.first.length() + cit.second.value.length() + 16u;
       for (const auto& cit2 : cit.second.params) {
-        os << "; " << cit2.first;
+        length += cit2.first.length() + cit2.second.length() + 3u;
+      }
+    }
+    out.reserve(out.length() + length);
+
+    out += "HTTP/1.1 ";
+    out += std::to_string(static_cast<int>(code));
+    out += ' ';
+    out += code_as_string;
+    out += constants::kCRLF;
+    out += "Content-Type: ";
+    out += content_type;
+    out += constants::kCRLF;
+    out += connection_type == ConnectionKeepAlive ? "Connection: keep-alive" : "Connection: close";
+    out += constants::kCRLF;
+    for (const auto& cit : headers) {
+      out += cit.header;
+      out += ": ";
+      out += cit.value;
+      out += constants::kCRLF;
+    }
+    for (const auto& cit : headers.cookies) {
+      out += "Set-Cookie: ";
+      out += cit.first;
+      out += '=';
+      out += cit.second.value;
+      for (const auto& cit2 : cit.second.params) {
+        out += "; ";
+        out += cit2.first;
         if (!cit2.second.empty()) {
-          os << '=' + cit2.second;
+          out += '=';
+          out += cit2.second;
         }
       }
-      os << constants::kCRLF;
+      out += constants::kCRLF;
     }
   }
 
+  // The headers `PrepareHTTPResponseHeader()` writes, but the status line and `Connection`, as the name-value pairs
+  // for an `HTTPResponseSink`, followed by the ones of the content encoding, if `encoding` is set.
+  static HTTPHeaderFields ResponseHeaderFields(const http::Headers& headers,
+                                               const std::string& content_type,
+                                               const char* encoding) {
+    HTTPHeaderFields fields;
+    fields.emplace_back("Content-Type", content_type);
+    for (const auto& cit : headers) {
+      fields.emplace_back(cit.header, cit.value);
+    }
+    for (const auto& cit : headers.cookies) {
+      std::string cookie = cit.first + '=' + cit.second.value;
+      for (const auto& cit2 : cit.second.params) {
+        cookie += "; ";
+        cookie += cit2.first;
+        if (!cit2.second.empty()) {
+          cookie += '=';
+          cookie += cit2.second;
+        }
+      }
+      fields.emplace_back("Set-Cookie", std::move(cookie));
+    }
+    if (encoding) {
+      fields.emplace_back(constants::kContentEncodingHeaderKey, encoding);
+      if (!headers.Has("Vary")) {
+        fields.emplace_back("Vary", "Accept-Encoding");
+      }
+    }
+    return fields;
+  }
+
+  static void PrepareHTTPResponseHeader(std::ostream& os,
+                                        ConnectionType connection_type,
+                                        HTTPResponseCodeValue code = HTTPResponseCode.OK,
+                                        const http::Headers& headers = http::Headers(),
+                                        const std::string& content_type = constants::kDefaultContentType) {
+    std::string header;
+    PrepareHTTPResponseHeader(header, connection_type, code, headers, content_type);
+    os << header;
+  }
+
   // The generic implementation.
   template <typename T>
   static void SendHTTPResponseImpl(Connection& connection,
@@ -129,11 +225,210 @@ struct HTTPResponder {
                                    HTTPResponseCodeValue code,
                                    const http::Headers& headers,
                                    const std::string& content_type) {
-    std::ostringstream os;
-    PrepareHTTPResponseHeader(os, ConnectionClose, code, headers, content_type);
-    os << "Content-Length: " << (end - begin) << constants::kCRLF << constants::kCRLF;
-    connection.BlockingWrite(os.str(), true);
-    connection.BlockingWrite(begin, end, false);
+    const char* body = (begin != end) ? reinterpret_cast<const char*>(&(*begin)) : nullptr;
+    size_t body_size = (end - begin) * sizeof(typename std::iterator_traits<T>::value_type);
+    std::string compressed;
+    const char* encoding = nullptr;
+    const HTTPCompressionOptions* compression = connection.HTTPResponseCompression();
+    if (compression && body_size >= compression->min_size && ShouldCompress(*compression, headers, content_type)) {
+      const char* negotiated_encoding = connection.HTTPResponseContentEncoding();
+      compressed = DeflateCompress(body, body_size, HTTPContentEncodingFormat(negotiated_encoding));
+      if (compressed.length() < body_size) {
+        encoding = negotiated_encoding;
+        body = compressed.data();
+        body_size = compressed.length();
+      }
+    }
+    if (HTTPResponseSink* sink = connection.HTTPResponseSinkIfAny()) {
+      HTTPHeaderFields fields = ResponseHeaderFields(headers, content_type, encoding);
+      fields.emplace_back(constants::kContentLengthHeaderKey, std::to_string(body_size));
+      sink->SendHead(code, fields, !body_size);
+      if (body_size) {
+        sink->SendBody(body, body_size, true);
+      }
+      return;
+    }
+    std::string header;
+    PrepareHTTPResponseHeader(
+        header, connection.HTTPKeepAlive() ? ConnectionKeepAlive : ConnectionClose, code, headers, content_type);
+    if (encoding) {
+      AppendContentEncodingHeaders(header, headers, encoding);
+    }
+    header += "Content-Length: ";
+    header += std::to_string(body_size);
+    header += constants::kCRLF;
+    header += constants::kCRLF;
+    if (body_size) {
+      // The header and the body go out in a single system call.
+      connection.BlockingWriteV({header, {body, body_size}}, false);
+    } else {
+      connection.BlockingWrite(header, false);
+    }
+  }
+
+  // Writes the size of the chunk as hex, followed by CRLF, into `out`, and returns the number of bytes written.
+  static size_t FormatChunkHeader(char* out, uint64_t size) {
+    char digits[2 * sizeof(uint64_t)];
+    size_t n = 0u;
+    do {
+      digits[n++] = "0123456789ABCDEF"[size & 0xf];
+      size >>= 4;
+    } while (size);
+    for (size_t i = 0u; i < n; ++i) {
+      out[i] = digits[n - 1u - i];
+    }
+    ::memcpy(out + n, constants::kCRLF, constants::kCRLFLength);
+    return n + constants::kCRLFLength;
+  }
+
+  // The RapidJSON output stream that sends the JSON of the response as it is being written, token by token,
+  // without it ever being turned into a string. The JSON that fits in one piece goes out as any other response, with its
+  // `Content-Length`. The larger JSON goes out chunked, a piece per chunk, compressed on the fly if it should be.
+  class JSONResponseStream final {
+   public:
+    typedef char Ch;
+
+    JSONResponseStream(Connection& connection,
+                       HTTPResponseCodeValue code,
+                       const http::Headers& headers,
+                       const std::string& content_type)
+        : connection_(connection),
+          code_(code),
+          headers_(headers),
+          content_type_(content_type),
+          buffer_(HTTPBufferPool::Acquire(CURRENT_BRICKS_HTTP_JSON_RESPONSE_PIECE_SIZE)) {
+      buffer_.resize(CURRENT_BRICKS_HTTP_JSON_RESPONSE_PIECE_SIZE);
+    }
+
+    ~JSONResponseStream() { HTTPBufferPool::Release(std::move(buffer_)); }
+
+    void Put(char c) {
+      buffer_[size_++] = c;
+      if (size_ == buffer_.size()) {
+        SendPiece();
+      }
+    }
+
+    void Flush() {}
+
+    // Sends the rest of the JSON, and ends the response.
+    void Finish() {
+      if (!chunked_) {
+        SendHTTPResponseImpl(connection_, buffer_.begin(), buffer_.begin() + size_, code_, headers_, content_type_);
+      } else {
+        std::string tail;
+        if (compressor_) {
+          tail = compressor_->Compress(buffer_.data(), size_, false);
+          tail += compressor_->Finish();
+        } else {
+          tail.assign(buffer_.data(), size_);
+        }
+        if (HTTPResponseSink* sink = connection_.HTTPResponseSinkIfAny()) {
+          sink->SendBody(tail.data(), tail.length(), true);
+          size_ = 0u;
+          return;
+        }
+        char chunk_header[2 * sizeof(uint64_t) + constants::kCRLFLength];
+        const size_t chunk_header_size = tail.empty() ? 0u : FormatChunkHeader(chunk_header, tail.size());
+        connection_.BlockingWriteV(
+            {{chunk_header, chunk_header_size}, tail, tail.empty() ? "" : constants::kCRLF, "0\r\n\r\n"}, false);
+      }
+      size_ = 0u;
+    }
+
+   private:
+    JSONResponseStream(const JSONResponseStream&) = delete;
+    JSONResponseStream& operator=(const JSONResponseStream&) = delete;
+
+    void SendPiece() {
+      HTTPResponseSink* const sink = connection_.HTTPResponseSinkIfAny();
+      std::string header;
+      if (!chunked_) {
+        chunked_ = true;
+        const char* encoding = nullptr;
+        const HTTPCompressionOptions* compression = connection_.HTTPResponseCompression();
+        if (compression && ShouldCompress(*compression, headers_, content_type_)) {
+          encoding = connection_.HTTPResponseContentEncoding();
+          compressor_ = std::make_unique<DeflateCompressor>(HTTPContentEncodingFormat(encoding));
+        }
+        if (sink) {
+          sink->SendHead(code_, ResponseHeaderFields(headers_, content_type_, encoding), false);
+        } else {
+          PrepareHTTPResponseHeader(header,
+                                    connection_.HTTPKeepAlive() ? ConnectionKeepAlive : ConnectionClose,
+                                    code_,
+                                    headers_,
+                                    content_type_);
+          if (encoding) {
+            AppendContentEncodingHeaders(header, headers_, encoding);
+          }
+          header += "Transfer-Encoding: chunked";
+          header += constants::kCRLF;
+          header += constants::kCRLF;
+        }
+      }
+      std::string compressed;
+      const char* data = buffer_.data();
+      size_t data_size = size_;
+      if (compressor_) {
+        compressed = compressor_->Compress(data, data_size, false);
+        data = compressed.data();
+        data_size = compressed.length();
+      }
+      if (sink) {
+        if (data_size) {
+          sink->SendBody(data, data_size, false);
+        }
+        size_ = 0u;
+        return;
+      }
+      char chunk_header[2 * sizeof(uint64_t) + constants::kCRLFLength];
+      const size_t chunk_header_size = data_size ? FormatChunkHeader(chunk_header, data_size) : 0u;
+      // The header of the response, if this is the first piece, and the chunk go out in a single system call.
+      connection_.BlockingWriteV(
+          {header, {chunk_header, chunk_header_size}, {data, data_size}, data_size ? constants::kCRLF : ""}, true);
+      size_ = 0u;
+    }
+
+    Connection& connection_;
+    const HTTPResponseCodeValue code_;
+    const http::Headers& headers_;
+    const std::string& content_type_;
+    std::vector<char> buffer_;
+    size_t size_ = 0u;
+    bool chunked_ = false;
+    std::unique_ptr<DeflateCompressor> compressor_;
+  };
+
+  // Serializes the object straight into the connection, see `JSONResponseStream`.
+  template <class T>
+  static void SendJSONResponseImpl(Connection& connection,
+                                   const T& object,
+                                   HTTPResponseCodeValue code,
+                                   const http::Headers& headers,
+                                   const std::string& content_type) {
+    JSONResponseStream stream(connection, code, headers, content_type);
+    serialization::json::WriteJSON(stream, object);
+    stream.Put('\n');
+    stream.Finish();
+  }
+
+  // Whether the response can be compressed: it is of the type to, and it has not been compressed by the user already.
+  static bool ShouldCompress(const HTTPCompressionOptions& options,
+                             const http::Headers& headers,
+                             const std::string& content_type) {
+    return IsCompressibleHTTPContentType(options, content_type) && !headers.Has(constants::kContentEncodingHeaderKey);
+  }
+
+  static void AppendContentEncodingHeaders(std::string& header, const http::Headers& headers, const char* encoding) {
+    header += constants::kContentEncodingHeaderKey;
+    header += ": ";
+    header += encoding;
+    header += constants::kCRLF;
+    if (!headers.Has("Vary")) {
+      header += "Vary: Accept-Encoding";
+      header += constants::kCRLF;
+    }
   }
 
   // The actual implementations of sending the HTTP response.
@@ -302,9 +597,7 @@ struct HTTPResponder {
       HTTPResponseCodeValue code,
       const http::Headers& headers,
       const std::string& content_type) {
-    // TODO(dkorolev): We should probably make this not only correct but also efficient.
-    const std::string s = JSON(std::forward<T>(object)) + '\n';
-    SendHTTPResponseImpl(connection, s.begin(), s.end(), code, headers, content_type);
+    SendJSONResponseImpl(connection, object, code, headers, content_type);
   }
 
   template <class T>
@@ -313,9 +606,7 @@ struct HTTPResponder {
       T&& object,
       HTTPResponseCodeValue code,
       const http::Headers& headers) {
-    // TODO(dkorolev): We should probably make this not only correct but also efficient.
-    const std::string s = JSON(std::forward<T>(object)) + '\n';
-    SendHTTPResponseImpl(connection, s.begin(), s.end(), code, headers, constants::kDefaultJSONContentType);
+    SendJSONResponseImpl(connection, object, code, headers, constants::kDefaultJSONContentType);
   }
 
   template <class T>
@@ -324,9 +615,7 @@ struct HTTPResponder {
       T&& object,
       HTTPResponseCodeValue code,
       const std::string& content_type) {
-    // TODO(dkorolev): We should probably make this not only correct but also efficient.
-    const std::string s = JSON(std::forward<T>(object)) + '\n';
-    SendHTTPResponseImpl(connection, s.begin(), s.end(), code, http::Headers(), content_type);
+    SendJSONResponseImpl(connection, object, code, http::Headers(), content_type);
   }
 
   template <class T>
@@ -334,23 +623,14 @@ struct HTTPResponder {
       Connection& connection,
       T&& object,
       HTTPResponseCodeValue code) {
-    // TODO(dkorolev): We should probably make this not only correct but also efficient.
-    const std::string s = JSON(std::forward<T>(object)) + '\n';
-    SendHTTPResponseImpl(connection, s.begin(), s.end(), code, http::Headers(), constants::kDefaultJSONContentType);
+    SendJSONResponseImpl(connection, object, code, http::Headers(), constants::kDefaultJSONContentType);
   }
 
   template <class T>
   static std::enable_if_t<IS_CURRENT_STRUCT_OR_VARIANT(current::decay_t<T>)> SendHTTPResponse(
       Connection& connection,
       T&& object) {
-    // TODO(dkorolev): We should probably make this not only correct but also efficient.
-    const std::string s = JSON(std::forward<T>(object)) + '\n';
-    SendHTTPResponseImpl(connection,
-                         s.begin(),
-                         s.end(),
-                         HTTPResponseCode.OK,
-                         http::Headers(),
-                         constants::kDefaultJSONContentType);
+    SendJSONResponseImpl(connection, object, HTTPResponseCode.OK, http::Headers(), constants::kDefaultJSONContentType);
   }
 };
 
@@ -359,42 +639,82 @@ struct HTTPResponder {
 // TODO(dkorolev): This is not yet the case, but will be soon once I fix HTTP parse code.
 class HTTPDefaultHelper {
  public:
-  struct ConstructionParams {};
-  HTTPDefaultHelper(const ConstructionParams&) {}
+  struct ConstructionParams {
+    // Called with the path of the request, as received, once its headers have been received. If it returns `true`,
+    // the body is not received before the request is handed over, but read by its handler with `ReadBody()`,
+    // as it is being received, and with no limit on its size. For the uploads too large to keep in memory.
+    std::function<bool(const std::string& raw_path)> stream_body;
+  };
+  HTTPDefaultHelper(const ConstructionParams& params) : stream_body_(params.stream_body) {}
+  ~HTTPDefaultHelper() { HTTPBufferPool::Release(std::move(body_)); }
 
   const http::Headers& headers() const { return headers_; }
 
+  bool StreamsBody(const std::string& raw_path) const { return stream_body_ && stream_body_(raw_path); }
+
  protected:
   HTTPDefaultHelper() = default;
 
   inline void OnHeader(const char* key, const char* value) { headers_.SetHeaderOrCookie(key, value); }
 
-  inline void OnChunk(const char* chunk, size_t length) { body_.append(chunk, length); }
+  inline void OnChunk(const char* chunk, size_t length) {
+    if (!body_.capacity()) {
+      body_ = HTTPBufferPool::Acquire(length);
+      body_.clear();
+    }
+    body_.insert(body_.end(), chunk, chunk + length);
+  }
 
   inline void OnChunkedBodyDone(const char*& begin, const char*& end) {
     if (body_.empty()) {
       begin = &dummy_;
       end = &dummy_;
     } else {
-      begin = body_.c_str();
-      end = begin + body_.length();
+      begin = body_.data();
+      end = begin + body_.size();
     }
   }
 
  private:
+  const std::function<bool(const std::string& raw_path)> stream_body_;
   http::Headers headers_;
-  std::string body_;
+  std::vector<char> body_;  // Drawn from, and returned to, `HTTPBufferPool`.
   char dummy_ = '\0';
 };
 
+// HTTPHeaderViewsHelper does not build `http::Headers` while parsing the message: `headers()` builds them on the
+// first call, and `HeaderView()` looks the headers up in the received data, with no copies made. The request line
+// is also only parsed into `URL()` on demand. For the handlers that look at a few headers, or at none at all.
+class HTTPHeaderViewsHelper : public HTTPDefaultHelper {
+ public:
+  constexpr static bool kMaterializesHeadersLazily = true;
+  using HTTPDefaultHelper::HTTPDefaultHelper;
+};
+
+namespace impl {
+template <class HELPER, class = void>
+struct MaterializesHeadersLazily : std::false_type {};
+template <class HELPER>
+struct MaterializesHeadersLazily<HELPER, std::void_t<decltype(HELPER::kMaterializesHeadersLazily)>>
+    : std::integral_constant<bool, HELPER::kMaterializesHeadersLazily> {};
+
+template <class HELPER, class = void>
+struct CanStreamBody : std::false_type {};
+template <class HELPER>
+struct CanStreamBody<HELPER, std::void_t<decltype(std::declval<const HELPER&>().StreamsBody(std::string()))>>
+    : std::true_type {};
+}  // namespace impl
+
 // In constructor, GenericHTTPRequestData parses HTTP response from `Connection&` is was provided with.
 // Extracts method, path (URL + parameters), and, if provided, the body.
 //
 // Getters:
 // * current::url::URL URL() (to access `.host`, `.path`, `.scheme` and `.port`).
+// * current::url::URLView URLView() (the same, as views into the received data, with the query decoded on demand).
 // * std::string RawPath() (the URL before parsing).
 // * std::string Method().
 // * std::string Body(), size_t BodyLength(), const char* Body{Begin,End}().
+// * std::string_view RawPathView(), PathView(), QueryView(), and HeaderView(), pointing into the received data.
 //
 // Exceptions:
 // * ConnectionResetByPeer       : When the server is using chunked transfer and doesn't fully send one.
@@ -403,12 +723,22 @@ class HTTPDefaultHelper {
 template <class HELPER>
 class GenericHTTPRequestData : public HELPER {
  public:
+  constexpr static bool kMaterializesHeadersLazily = impl::MaterializesHeadersLazily<HELPER>::value;
+
   inline GenericHTTPRequestData(
       Connection& c,
       const typename HELPER::ConstructionParams& params = typename HELPER::ConstructionParams(),
       const int initial_buffer_size = 16 * 1024 + 1,
       const double buffer_growth_k = 1.95)
-      : HELPER(params), buffer_(initial_buffer_size) {
+      : HELPER(params), buffer_(c.TakeReadBuffer()) {
+    // The buffer of the previous request on this connection, or a pooled one, is reused as is, with no need to zero
+    // it beyond its former size; the tests asking for smaller buffers than the pool keeps get a new one.
+    if (buffer_.empty() && static_cast<size_t>(initial_buffer_size) >= HTTPBufferPool::kMinBufferSize) {
+      buffer_ = HTTPBufferPool::Acquire(static_cast<size_t>(initial_buffer_size));
+    }
+    if (buffer_.size() < static_cast<size_t>(initial_buffer_size)) {
+      buffer_.resize(initial_buffer_size);
+    }
     // `offset` is the number of bytes read into `buffer_` so far.
     // `length_cap` is infinity first (size_t is unsigned), and it changes/ to the absolute offset
     // of the end of HTTP body in the buffer_, once `Content-Length` and two consecutive CRLS have been seen.
@@ -431,6 +761,11 @@ class GenericHTTPRequestData : public HELPER {
     // `receiving_body_in_chunks` is set to true when the parsing is already in the "receive body" mode.
     bool receiving_body_in_chunks = false;
 
+    // The `Connection` header, if any, overrides the default of the protocol version on whether to keep it open.
+    bool http_1_1 = false;
+    bool connection_close = false;
+    bool connection_keep_alive = false;
+
     while (offset < length_cap) {
       size_t chunk;
       size_t read_count;
@@ -469,15 +804,33 @@ class GenericHTTPRequestData : public HELPER {
         if (!first_line_parsed) {
           if (!line_is_blank) {
             // It's recommended by W3 to wait for the first line ignoring prior CRLF-s.
-            const std::vector<std::string> pieces =
-                strings::Split<strings::ByWhitespace>(&buffer_[current_line_offset]);
-            if (pieces.size() >= 1) {
-              method_ = pieces[0];
+            // Only the first three whitespace-separated pieces matter, and they are not copied.
+            std::string_view pieces[3];
+            size_t pieces_count = 0u;
+            for (const char* p = &buffer_[current_line_offset]; *p && pieces_count < 3u;) {
+              if (std::isspace(static_cast<unsigned char>(*p))) {
+                ++p;
+              } else {
+                const char* const piece = p;
+                while (*p && !std::isspace(static_cast<unsigned char>(*p))) {
+                  ++p;
+                }
+                pieces[pieces_count++] = std::string_view(piece, p - piece);
+              }
+            }
+            if (pieces_count >= 1u) {
+              method_.assign(pieces[0].data(), pieces[0].length());
+            }
+            if (pieces_count >= 2u) {
+              raw_path_offset_ = pieces[1].data() - &buffer_[0];
+              raw_path_length_ = pieces[1].length();
             }
-            if (pieces.size() >= 2) {
-              raw_path_ = pieces[1];
-              url_ = current::url::URL(raw_path_);
+            if (!kMaterializesHeadersLazily) {
+              PrepareURL();
             }
+            // The protocol version goes first in the responses, and last in the requests.
+            http_1_1 =
+                (pieces_count >= 1u && pieces[0] == "HTTP/1.1") || (pieces_count >= 3u && pieces[2] == "HTTP/1.1");
             first_line_parsed = true;
           }
         } else if (receiving_body_in_chunks) {
@@ -498,6 +851,7 @@ class GenericHTTPRequestData : public HELPER {
             }());
             if (chunk_length == 0) {
               // Done with the body.
+              body_received_at_ = std::chrono::steady_clock::now();
               HELPER::OnChunkedBodyDone(body_buffer_begin_, body_buffer_end_);
               return;
             } else {
@@ -560,31 +914,64 @@ class GenericHTTPRequestData : public HELPER {
             }
             *next_crlf_ptr = '\0';
 
-            HELPER::OnHeader(key, value);
+            header_spans_.push_back({static_cast<size_t>(key - &buffer_[0]),
+                                     static_cast<size_t>(p - 1 - key),
+                                     static_cast<size_t>(value - &buffer_[0]),
+                                     static_cast<size_t>(next_crlf_ptr - value)});
+            if constexpr (!kMaterializesHeadersLazily) {
+              HELPER::OnHeader(key, value);
+            }
             if (HeaderNameEquals(key, constants::kContentLengthHeaderKey)) {
-              body_length = static_cast<size_t>(atoi(value));
-              if (body_length > constants::kMaxHTTPPayloadSizeInBytes) {
-                HTTPResponder::SendHTTPResponse(c,
-                                                net::DefaultRequestEntityTooLargeMessage(),
-                                                HTTPResponseCode.RequestEntityTooLarge,
-                                                http::Headers(),
-                                                net::constants::kDefaultHTMLContentType);
-                CURRENT_THROW(HTTPPayloadTooLarge());
-              }
+              body_length = static_cast<size_t>(std::strtoull(value, nullptr, 10));
             } else if (HeaderNameEquals(key, constants::kHTTPMethodOverrideHeaderKey)) {
               method_ = current::strings::ToUpper(value);
             } else if (HeaderNameEquals(key, constants::kTransferEncodingHeaderKey)) {
               if (HeaderNameEquals(value, constants::kTransferEncodingChunkedValue)) {
                 chunked_transfer_encoding = true;
               }
+            } else if (HeaderNameEquals(key, constants::kConnectionHeaderKey)) {
+              const std::string options = current::strings::ToLower(value);
+              connection_close = (options.find(constants::kConnectionCloseValue) != std::string::npos);
+              connection_keep_alive = (options.find(constants::kConnectionKeepAliveValue) != std::string::npos);
             }
           }
         } else {
           CURRENT_BRICKS_LOG_HTTP_EVENT("http header is parsed\n");
+          headers_parsed_at_ = std::chrono::steady_clock::now();
           // The blank line is what separates HTTP headers from HTTP body.
+          bool stream_body = false;
+          if constexpr (impl::CanStreamBody<HELPER>::value) {
+            stream_body = (chunked_transfer_encoding || body_length != static_cast<size_t>(-1)) &&
+                          HELPER::StreamsBody(std::string(&buffer_[raw_path_offset_], raw_path_length_));
+          }
+          if (stream_body) {
+            // The handler reads the body, see `ReadBody()`. The chunked ones are read over the beginning of
+            // `buffer_`, so keep the request line and the headers elsewhere, as below.
+            if (chunked_transfer_encoding) {
+              headers_storage_.assign(&buffer_[0], next_line_offset);
+              headers_in_storage_ = true;
+            }
+            body_stream_.emplace();
+            body_stream_->chunked = chunked_transfer_encoding;
+            body_stream_->remaining = chunked_transfer_encoding ? 0u : body_length;
+            body_stream_->begin = next_line_offset;
+            body_stream_->end = offset;
+            body_stream_->done = !chunked_transfer_encoding && !body_length;
+            // The time spent reading the body is then a part of the time spent by the handler.
+            body_received_at_ = headers_parsed_at_;
+            return;
+          } else if (body_length != static_cast<size_t>(-1) && body_length > constants::kMaxHTTPPayloadSizeInBytes) {
+            HTTPResponder::SendHTTPResponse(c,
+                                            net::DefaultRequestEntityTooLargeMessage(),
+                                            HTTPResponseCode.RequestEntityTooLarge,
+                                            http::Headers(),
+                                            net::constants::kDefaultHTMLContentType);
+            CURRENT_THROW(HTTPPayloadTooLarge());
+          }
           if (!chunked_transfer_encoding) {
             // HTTP body starts right after this last CRLF.
             body_offset = next_line_offset;
+            keep_alive_requested_ = http_1_1 ? !connection_close : connection_keep_alive;
             // Non-chunked encoding. Assume BODY follows as raw data.
             // Only accept HTTP body if Content-Length has been set; ignore it otherwise.
             if (body_length != static_cast<size_t>(-1)) {
@@ -602,6 +989,9 @@ class GenericHTTPRequestData : public HELPER {
               }
               body_buffer_begin_ = &buffer_[body_offset];
               body_buffer_end_ = body_buffer_begin_ + body_length;
+              read_ahead_begin_ = std::min(length_cap, offset);
+              read_ahead_end_ = offset;
+              body_received_at_ = std::chrono::steady_clock::now();
               return;
             } else {
               if (NeedContentLengthHeader(method_)) {
@@ -612,10 +1002,16 @@ class GenericHTTPRequestData : public HELPER {
                                                 net::constants::kDefaultHTMLContentType);
                 CURRENT_THROW(HTTPRequestBodyLengthNotProvided());
               }
+              read_ahead_begin_ = body_offset;
+              read_ahead_end_ = offset;
+              body_received_at_ = headers_parsed_at_;
               return;
             }
           } else {
             receiving_body_in_chunks = true;
+            // The chunks are read over the beginning of `buffer_`: keep the request line and the headers elsewhere.
+            headers_storage_.assign(&buffer_[0], next_line_offset);
+            headers_in_storage_ = true;
           }
         }
         current_line_offset = next_line_offset;
@@ -636,9 +1032,118 @@ class GenericHTTPRequestData : public HELPER {
     }
   }
 
+  // Builds the message out of its parts received otherwise than as HTTP/1.1 text, such as the decoded headers of
+  // a stream of HTTP/2, with the body received in full. The parts are laid out in the buffer the way the parsed
+  // ones are, '\0'-terminated, so that the getters, the zero-copy ones included, work the same way.
+  GenericHTTPRequestData(const std::string& method,
+                         const std::string& raw_path,
+                         const HTTPHeaderFields& headers,
+                         const std::string& body,
+                         const typename HELPER::ConstructionParams& params = typename HELPER::ConstructionParams())
+      : HELPER(params), method_(method) {
+    size_t size = raw_path.length() + body.length() + 2u;
+    for (const auto& header : headers) {
+      size += header.first.length() + header.second.length() + 2u;
+    }
+    buffer_ = HTTPBufferPool::Acquire(size);
+    buffer_.resize(size);
+    size_t offset = 0u;
+    const auto append = [this, &offset](const std::string& s) {
+      const size_t begin = offset;
+      std::memcpy(&buffer_[offset], s.data(), s.length());
+      offset += s.length();
+      buffer_[offset++] = '\0';
+      return begin;
+    };
+    raw_path_offset_ = append(raw_path);
+    raw_path_length_ = raw_path.length();
+    for (const auto& header : headers) {
+      const size_t key_offset = append(header.first);
+      const size_t value_offset = append(header.second);
+      header_spans_.push_back({key_offset, header.first.length(), value_offset, header.second.length()});
+      if constexpr (!kMaterializesHeadersLazily) {
+        HELPER::OnHeader(&buffer_[key_offset], &buffer_[value_offset]);
+      }
+      if (HeaderNameEquals(header.first.c_str(), constants::kHTTPMethodOverrideHeaderKey)) {
+        method_ = current::strings::ToUpper(header.second);
+      }
+    }
+    body_buffer_begin_ = &buffer_[append(body)];
+    body_buffer_end_ = body_buffer_begin_ + body.length();
+    if (!kMaterializesHeadersLazily) {
+      PrepareURL();
+    }
+    headers_parsed_at_ = body_received_at_ = std::chrono::steady_clock::now();
+  }
+
   inline const std::string& Method() const { return method_; }
-  inline const current::url::URL& URL() const { return url_; }
-  inline const std::string& RawPath() const { return raw_path_; }
+  inline const current::url::URL& URL() const {
+    PrepareURL();
+    return url_;
+  }
+  inline const std::string& RawPath() const {
+    PrepareURL();
+    return raw_path_;
+  }
+
+  // The parsed headers; built on the first call, unless the `HELPER` builds them while the message is being parsed.
+  // NOTE: Just as the rest of the methods of this class, `headers()` is not safe to call from several threads at once.
+  inline decltype(auto) headers() const {
+    if constexpr (kMaterializesHeadersLazily) {
+      if (!lazy_headers_) {
+        lazy_headers_ = std::make_unique<http::Headers>();
+        for (const HeaderSpan& span : header_spans_) {
+          lazy_headers_->SetHeaderOrCookie(ViewsBase() + span.key_offset, ViewsBase() + span.value_offset);
+        }
+      }
+      return static_cast<const http::Headers&>(*lazy_headers_);
+    } else {
+      return HELPER::headers();
+    }
+  }
+
+  // The zero-copy accessors. The views are into the data received, and are valid for as long as this object is.
+  inline std::string_view RawPathView() const {
+    return std::string_view(ViewsBase() + raw_path_offset_, raw_path_length_);
+  }
+  // The parsed request target, with no copies made. Cheap enough to construct on every call.
+  inline current::url::URLView URLView() const {
+    return raw_path_length_ ? current::url::URLView(RawPathView()) : current::url::URLView();
+  }
+  // The raw path up to the `?`, still URL-encoded.
+  inline std::string_view PathView() const {
+    const std::string_view raw_path = RawPathView();
+    return raw_path.substr(0u, raw_path.find_first_of("?#"));
+  }
+  // The raw query, between the `?` and the `#`, if any, still URL-encoded.
+  inline std::string_view QueryView() const {
+    const std::string_view raw_path = RawPathView();
+    const size_t question_mark = raw_path.find('?');
+    if (question_mark == std::string_view::npos || raw_path.find('#') < question_mark) {
+      return std::string_view();
+    }
+    const std::string_view query = raw_path.substr(question_mark + 1u);
+    return query.substr(0u, query.find('#'));
+  }
+  inline size_t HeadersCount() const { return header_spans_.size(); }
+  inline std::string_view HeaderNameView(size_t index) const {
+    const HeaderSpan& span = header_spans_[index];
+    return std::string_view(ViewsBase() + span.key_offset, span.key_length);
+  }
+  inline std::string_view HeaderValueView(size_t index) const {
+    const HeaderSpan& span = header_spans_[index];
+    return std::string_view(ViewsBase() + span.value_offset, span.value_length);
+  }
+  // Finds the first header named `name`, case-insensitively, and with `_` and `-` treated as the same character.
+  inline bool HeaderView(std::string_view name, std::string_view& value) const {
+    for (size_t i = 0u; i < header_spans_.size(); ++i) {
+      if (HeaderNameEquals(HeaderNameView(i), name)) {
+        value = HeaderValueView(i);
+        return true;
+      }
+    }
+    return false;
+  }
 
   // Note that `Body*()` methods assume that the body was fully read into memory.
   // If other means of reading the body, for example, event-based chunk parsing, is used,
@@ -668,6 +1173,67 @@ class GenericHTTPRequestData : public HELPER {
     }
   }
 
+  // Whether the peer is fine with the connection kept open after this message: by default for HTTP/1.1,
+  // unless it says `Connection: close`, and only if it says `Connection: keep-alive` otherwise.
+  // Never for the messages with chunked bodies, the end of which is not tracked precisely enough,
+  // nor for the ones with the streamed bodies, which the handler may respond to before reading in full.
+  inline bool KeepAliveRequested() const { return keep_alive_requested_; }
+
+  // Whether the body is to be read with `ReadBody()`, instead of `Body()`, see `HTTPDefaultHelper::ConstructionParams`.
+  inline bool BodyIsStreamed() const { return static_cast<bool>(body_stream_); }
+
+  // Reads up to `max_length` more bytes of the streamed body into `output`, waiting for at least one of them
+  // to be received. Returns zero once all of the body has been read. Throws `ConnectionResetByPeer` if the peer
+  // has closed the connection before sending all of it, and `ChunkSizeNotAValidHEXValue`, with no response sent,
+  // if its chunked encoding is broken.
+  size_t ReadBody(Connection& c, void* output, size_t max_length) {
+    if (!body_stream_ || body_stream_->done || !max_length) {
+      return 0u;
+    }
+    BodyStream& stream = *body_stream_;
+    if (stream.chunked && !stream.remaining && !ReadBodyChunkSize(c)) {
+      return 0u;
+    }
+    const size_t length = std::min(max_length, static_cast<size_t>(stream.remaining));
+    size_t read_count;
+    if (stream.begin < stream.end) {
+      read_count = std::min(length, stream.end - stream.begin);
+      std::memcpy(output, &buffer_[stream.begin], read_count);
+      stream.begin += read_count;
+    } else {
+      read_count = c.BlockingRead(static_cast<uint8_t*>(output), length);
+      if (!read_count) {
+        CURRENT_THROW(ConnectionResetByPeer());  // LCOV_EXCL_LINE
+      }
+    }
+    stream.remaining -= read_count;
+    if (!stream.chunked && !stream.remaining) {
+      FinishBodyStream();
+    }
+    return read_count;
+  }
+
+  // When the blank line after the headers, and the end of the body, have been received and parsed.
+  inline std::chrono::steady_clock::time_point HeadersParsedAt() const { return headers_parsed_at_; }
+  inline std::chrono::steady_clock::time_point BodyReceivedAt() const { return body_received_at_; }
+
+  // The buffer goes back to `HTTPBufferPool`, unless it has been handed over with `TakeReadBuffer()`.
+  ~GenericHTTPRequestData() { HTTPBufferPool::Release(std::move(buffer_)); }
+
+  // The data received past the end of this message, i.e. the beginning of the next one, if it has been sent already.
+  inline std::string ReadAhead() const {
+    return std::string(buffer_.data() + read_ahead_begin_, buffer_.data() + read_ahead_end_);
+  }
+
+  // Hands over the buffer this message has been read into, to read the next one into, see `KeepReadBuffer()`.
+  // Invalidates the body, and the views, unless the headers of a chunked message, which are kept aside.
+  inline std::vector<char> TakeReadBuffer() {
+    body_buffer_begin_ = nullptr;
+    body_buffer_end_ = nullptr;
+    read_ahead_begin_ = read_ahead_end_ = 0u;
+    return std::move(buffer_);
+  }
+
  private:
   static char NormalizeHeaderChar(char c) { return c != '_' ? std::tolower(c) : '-'; }
   static bool HeaderNameEquals(const char* lhs, const char* rhs) {
@@ -678,16 +1244,119 @@ class GenericHTTPRequestData : public HELPER {
     }
     return !*lhs && !*rhs;
   }
+  static bool HeaderNameEquals(std::string_view lhs, std::string_view rhs) {
+    if (lhs.length() != rhs.length()) {
+      return false;
+    }
+    for (size_t i = 0u; i < lhs.length(); ++i) {
+      if (NormalizeHeaderChar(lhs[i]) != NormalizeHeaderChar(rhs[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
 
-  // Fields available to the user via getters.
+  // Where the offsets of the views are relative to.
+  const char* ViewsBase() const { return headers_in_storage_ ? headers_storage_.data() : buffer_.data(); }
+
+  void PrepareURL() const {
+    if (!url_prepared_) {
+      url_prepared_ = true;
+      if (raw_path_length_) {
+        raw_path_.assign(ViewsBase() + raw_path_offset_, raw_path_length_);
+        url_ = current::url::URL(raw_path_);
+      }
+    }
+  }
+
+  // Fields available to the user via getters. Unless `HELPER` materializes the headers lazily,
+  // the URL is parsed along with the rest of the message.
   std::string method_;
-  current::url::URL url_;
-  std::string raw_path_;
+  mutable current::url::URL url_;
+  mutable std::string raw_path_;
+  mutable bool url_prepared_ = false;
+  mutable std::unique_ptr<http::Headers> lazy_headers_;
+
+  // The zero-copy views of the request line and the headers: the keys and the values are '\0'-terminated.
+  struct HeaderSpan final {
+    size_t key_offset;
+    size_t key_length;
+    size_t value_offset;
+    size_t value_length;
+  };
+  std::vector<HeaderSpan> header_spans_;
+  size_t raw_path_offset_ = 0u;
+  size_t raw_path_length_ = 0u;
+  std::string headers_storage_;  // The request line and the headers of a chunked message, copied out of `buffer_`.
+  bool headers_in_storage_ = false;
+
+  // The state of the body read by the handler, see `ReadBody()`. The bytes of it received along with the headers,
+  // or with the sizes of the chunks, are in `buffer_`, from `begin` to `end`.
+  struct BodyStream final {
+    bool chunked = false;
+    bool done = false;
+    uint64_t remaining = 0u;  // Of the body, or of its current chunk.
+    size_t begin = 0u;
+    size_t end = 0u;
+  };
+  std::optional<BodyStream> body_stream_;
+
+  void FinishBodyStream() {
+    body_stream_->done = true;
+    body_received_at_ = std::chrono::steady_clock::now();
+  }
+
+  // Reads the size of the next chunk of the streamed body, skipping the CRLF ending the previous one.
+  // Returns `false` once the last, zero-sized, chunk has been reached; its trailers, if any, are not read.
+  bool ReadBodyChunkSize(Connection& c) {
+    BodyStream& stream = *body_stream_;
+    while (true) {
+      const char* const begin = buffer_.data() + stream.begin;
+      const char* const end = buffer_.data() + stream.end;
+      const char* const crlf = std::search(begin, end, constants::kCRLF, constants::kCRLF + constants::kCRLFLength);
+      if (crlf != end) {
+        const std::string line(begin, crlf);
+        stream.begin += line.length() + constants::kCRLFLength;
+        if (line.empty()) {
+          // The CRLF ending the previous chunk.
+          continue;
+        }
+        if (!std::isxdigit(static_cast<unsigned char>(line[0]))) {
+          CURRENT_THROW(ChunkSizeNotAValidHEXValue());
+        }
+        stream.remaining = std::strtoull(line.c_str(), nullptr, 16);
+        if (!stream.remaining) {
+          FinishBodyStream();
+          return false;
+        }
+        return true;
+      } else {
+        // Move what is left to the beginning of `buffer_`, and receive more of the line into it.
+        std::memmove(&buffer_[0], begin, end - begin);
+        stream.end -= stream.begin;
+        stream.begin = 0u;
+        if (stream.end + 1u >= buffer_.size()) {
+          // The line is too long to be the size of a chunk.
+          CURRENT_THROW(ChunkSizeNotAValidHEXValue());
+        }
+        const size_t read_count = c.BlockingRead(&buffer_[stream.end], buffer_.size() - stream.end - 1u);
+        if (!read_count) {
+          CURRENT_THROW(ConnectionResetByPeer());  // LCOV_EXCL_LINE
+        }
+        stream.end += read_count;
+      }
+    }
+  }
 
   // HTTP parsing fields that have to be caried out of the parsing routine.
   std::vector<char> buffer_;                 // The buffer into which data has been read, except for chunked case.
   const char* body_buffer_begin_ = nullptr;  // If BODY has been provided, pointer pair to it.
   const char* body_buffer_end_ = nullptr;    // Will not be nullptr if body_buffer_begin_ is not nullptr.
+  bool keep_alive_requested_ = false;        // Only set for the messages the end of which is known precisely.
+  size_t read_ahead_begin_ = 0u;             // The data in `buffer_` past the end of this message, if any.
+  size_t read_ahead_end_ = 0u;
+  std::chrono::steady_clock::time_point headers_parsed_at_;
+  std::chrono::steady_clock::time_point body_received_at_;
 
   // HTTP body gets converted to an std::string representation as it's first requested.
   // TODO(dkorolev): This pattern is worth revisiting. StringPiece?
@@ -703,9 +1372,24 @@ class GenericHTTPRequestData : public HELPER {
 
 // The default implementation is exposed as HTTPRequestData.
 using HTTPRequestData = GenericHTTPRequestData<HTTPDefaultHelper>;
+using HTTPRequestDataWithHeaderViews = GenericHTTPRequestData<HTTPHeaderViewsHelper>;
 
 enum class ChunkFlush : bool { NoFlush = false, Flush = true };
 
+// The points in time a request goes through on the server, from the connection having been accepted, or, once kept
+// alive, having started to wait for this request, to the response having been written in full. Shared by the server
+// and the connection, via `TimePhases()`, and reported once released by both. See `blocks/http/phase_timings.h`.
+struct HTTPRequestPhases {
+  using time_point_t = std::chrono::steady_clock::time_point;
+  time_point_t accepted;
+  time_point_t first_byte;
+  time_point_t headers_parsed;
+  time_point_t body_received;
+  time_point_t handler_started;
+  time_point_t handler_finished;
+  time_point_t response_flushed;  // Not set if the response has not been sent in full.
+};
+
 template <class HTTP_REQUEST_DATA>
 class GenericHTTPServerConnection final : public HTTPResponder {
  public:
@@ -717,18 +1401,46 @@ class GenericHTTPServerConnection final : public HTTPResponder {
       const int initial_buffer_size = 16 * 1024 + 1,
       const double buffer_growth_k = 1.95)
       : connection_(std::move(c)), message_(connection_, params, initial_buffer_size, buffer_growth_k) {}
+
+  // For the request received otherwise than as HTTP/1.1 text, see `GenericHTTPRequestData`. Nothing is read from `c`,
+  // and the response goes into its `HTTPResponseSink`.
+  GenericHTTPServerConnection(
+      Connection&& c,
+      const std::string& method,
+      const std::string& raw_path,
+      const HTTPHeaderFields& headers,
+      const std::string& body,
+      const typename HTTP_REQUEST_DATA::ConstructionParams& params = typename HTTP_REQUEST_DATA::ConstructionParams())
+      : connection_(std::move(c)), message_(method, raw_path, headers, body, params) {}
   ~GenericHTTPServerConnection() {
-    if (!responded_) {
+    if (responded_ && reuse_ && !responded_in_chunks_) {
+      // The response has been sent in full, and with `Connection: keep-alive`: pass the connection on,
+      // along with the beginning of the next request, if it has been received already.
+      std::string read_ahead = message_.ReadAhead() + connection_.TakePrefetchedData();
+      // Whether to keep it open after the next response, and how to compress it, is up to the next request.
+      connection_.SetHTTPKeepAlive(false);
+      connection_.SetHTTPResponseCompression(nullptr, nullptr);
+      connection_.RestartTimings(!read_ahead.empty());
+      // Read the next request into the same buffer, unless it has grown large enough to not be worth keeping.
+      constexpr size_t kMaxKeptReadBufferSize = 1024 * 1024;
+      std::vector<char> buffer = message_.TakeReadBuffer();
+      if (buffer.size() <= kMaxKeptReadBufferSize) {
+        connection_.KeepReadBuffer(std::move(buffer));
+      }
+      reuse_(std::move(connection_), std::move(read_ahead));
+    } else if (!responded_) {
       // If a user code throws an exception in a different thread, it will not be caught.
       // But, at least, capitalized "INTERNAL SERVER ERROR" will be returned.
       // It's also a good place for a breakpoint to tell the source of that exception.
       // LCOV_EXCL_START
       try {
+        connection_.SetHTTPKeepAlive(false);
         HTTPResponder::SendHTTPResponse(connection_,
                                         DefaultInternalServerErrorMessage(),
                                         HTTPResponseCode.InternalServerError,
                                         http::Headers(),
                                         net::constants::kDefaultHTMLContentType);
+        ResponseFlushed();
       } catch (const Exception& e) {
         // No exception should ever leave the destructor.
         if (message_.RawPath() == "/healthz") {
@@ -745,6 +1457,48 @@ class GenericHTTPServerConnection final : public HTTPResponder {
     }
   }
 
+  // Called once the response has been sent with `Connection: keep-alive`, to serve the next request on this connection.
+  using reuse_t = std::function<void(Connection&&, std::string&& read_ahead)>;
+
+  // Makes the response keep the connection open, unless the client has asked to close it, and hands the connection
+  // over to `reuse` once this object is destroyed. The chunked responses still close the connection once done.
+  void KeepAlive(reuse_t reuse) {
+    if (message_.KeepAliveRequested() && !responded_) {
+      connection_.SetHTTPKeepAlive(true);
+      reuse_ = std::move(reuse);
+    }
+  }
+
+  // Reads the body of the request as it is being received, if it is not received in full before the request is
+  // handed over, see `HTTPDefaultHelper::ConstructionParams::stream_body` and `GenericHTTPRequestData::ReadBody()`.
+  size_t ReadBody(void* output, size_t max_length) { return message_.ReadBody(connection_, output, max_length); }
+
+  // Compresses the response, as long as the client accepts gzip or deflate, and the response is of at least
+  // `options->min_size` bytes, of one of `options->content_types`. See `bricks/net/http/compression.h`.
+  void CompressResponses(std::shared_ptr<const HTTPCompressionOptions> options) {
+    const char* encoding = nullptr;
+    if (options) {
+      const auto& headers = message_.headers();
+      if (headers.Has(constants::kAcceptEncodingHeaderKey)) {
+        encoding = ChooseHTTPContentEncoding(headers.Get(constants::kAcceptEncodingHeaderKey));
+      }
+    }
+    if (encoding) {
+      connection_.SetHTTPResponseCompression(std::move(options), encoding);
+    } else {
+      connection_.SetHTTPResponseCompression(nullptr, nullptr);
+    }
+  }
+
+  // Times the phases of this request into `phases`, which is then held until the response has been sent.
+  void TimePhases(std::shared_ptr<HTTPRequestPhases> phases) {
+    phases->accepted = connection_.StartedAt();
+    phases->first_byte = connection_.FirstByteAt();
+    phases->headers_parsed = message_.HeadersParsedAt();
+    phases->body_received = message_.BodyReceivedAt();
+    phases_ = std::move(phases);
+  }
+
   template <typename... ARGS>
   void SendHTTPResponse(ARGS&&... args) {
     if (responded_) {
@@ -752,6 +1506,39 @@ class GenericHTTPServerConnection final : public HTTPResponder {
     } else {
       HTTPResponder::SendHTTPResponse(connection_, std::forward<ARGS>(args)...);
       responded_ = true;
+      ResponseFlushed();
+    }
+  }
+
+  // Responds with `length` bytes of the file open as `fd`, starting from `offset`, sent with `sendfile()`,
+  // without reading them into memory. The file must not be shrunk while being sent.
+  void SendHTTPResponseFromFile(int fd,
+                                uint64_t offset,
+                                uint64_t length,
+                                HTTPResponseCodeValue code = HTTPResponseCode.OK,
+                                const http::Headers& headers = http::Headers(),
+                                const std::string& content_type = constants::kDefaultContentType) {
+    if (responded_) {
+      CURRENT_THROW(AttemptedToSendHTTPResponseMoreThanOnce());
+    } else if (HTTPResponseSink* sink = connection_.HTTPResponseSinkIfAny()) {
+      HTTPHeaderFields fields = ResponseHeaderFields(headers, content_type, nullptr);
+      fields.emplace_back(constants::kContentLengthHeaderKey, std::to_string(length));
+      responded_ = true;
+      sink->SendHead(code, fields, !length);
+      SendFileIntoSink(*sink, fd, offset, length);
+      ResponseFlushed();
+    } else {
+      std::string header;
+      PrepareHTTPResponseHeader(
+          header, connection_.HTTPKeepAlive() ? ConnectionKeepAlive : ConnectionClose, code, headers, content_type);
+      header += "Content-Length: ";
+      header += std::to_string(length);
+      header += constants::kCRLF;
+      header += constants::kCRLF;
+      connection_.BlockingWrite(header, length > 0u);
+      connection_.BlockingSendFile(fd, offset, length);
+      responded_ = true;
+      ResponseFlushed();
     }
   }
 
@@ -760,18 +1547,38 @@ class GenericHTTPServerConnection final : public HTTPResponder {
   struct ChunkedResponseSender final {
     // `struct Impl` is the logic wrapped into an `std::unique_ptr<>` to call the destructor only once.
     struct Impl final {
-      explicit Impl(Connection& connection) : connection_(connection) {}
+      Impl(Connection& connection,
+           std::unique_ptr<DeflateCompressor> compressor,
+           std::shared_ptr<HTTPRequestPhases> phases)
+          : connection_(connection),
+            sink_(connection.HTTPResponseSinkIfAny()),
+            compressor_(std::move(compressor)),
+            phases_(std::move(phases)) {}
 
       ~Impl() {
         if (!can_no_longer_write_) {
           try {
-            if (cache_size_) {
-              connection_.BlockingWrite(data_cache_, static_cast<size_t>(cache_size_), true);
+            // The zero-length chunk, followed by CRLF twice, along with what is left in the cache,
+            // and the end of the compressed data, if the response is compressed.
+            const std::string tail = compressor_ ? compressor_->Finish() : std::string();
+            if (sink_) {
+              if (cache_size_) {
+                sink_->SendBody(data_cache_, static_cast<size_t>(cache_size_), false);
+              }
+              sink_->SendBody(tail.data(), tail.length(), true);
+            } else {
+              char chunk_header[2 * sizeof(uint64_t) + constants::kCRLFLength];
+              const size_t chunk_header_size = tail.empty() ? 0u : FormatChunkHeader(chunk_header, tail.size());
+              connection_.BlockingWriteV({{data_cache_, static_cast<size_t>(cache_size_)},
+                                          {chunk_header, chunk_header_size},
+                                          tail,
+                                          tail.empty() ? "" : constants::kCRLF,
+                                          "0\r\n\r\n"},
+                                         false);
+            }
+            if (phases_) {
+              phases_->response_flushed = std::chrono::steady_clock::now();
             }
-            connection_.BlockingWrite("0", true);
-            // Should send CRLF twice.
-            connection_.BlockingWrite(constants::kCRLF, true);
-            connection_.BlockingWrite(constants::kCRLF, false);
           } catch (const SocketException& e) {                                          // LCOV_EXCL_LINE
             std::cerr << "Chunked response closure failed: " << e.what() << std::endl;  // LCOV_EXCL_LINE
           }                                                                             // LCOV_EXCL_LINE
@@ -781,22 +1588,43 @@ class GenericHTTPServerConnection final : public HTTPResponder {
       // The actual implementation of sending HTTP chunk data.
       template <typename T>
       void SendImpl(T&& data, ChunkFlush flush) {
+        if (compressor_) {
+          // What has been compressed so far goes out on each flush, for the client to decompress it right away.
+          SendChunk(compressor_->Compress(
+                        reinterpret_cast<const char*>(data.data()), data.size(), flush == ChunkFlush::Flush),
+                    flush);
+        } else {
+          SendChunk(std::forward<T>(data), flush);
+        }
+      }
+
+      template <typename T>
+      void SendChunk(T&& data, ChunkFlush flush) {
         if (!data.empty() || (flush == ChunkFlush::Flush && cache_size_)) {
           try {
-            if (!data.empty()) {
-              const auto chunk_header = strings::Printf("%lX", data.size()) + constants::kCRLF;
-              const auto chunk_size = chunk_header.size() + data.size() + constants::kCRLFLength;
-              if (cache_size_ && (flush == ChunkFlush::Flush || chunk_size > CACHE_SIZE - cache_size_)) {
-                connection_.BlockingWrite(data_cache_, static_cast<size_t>(cache_size_), true);
-                cache_size_ = 0;
-              }
+            if (sink_) {
+              SendIntoSink(data, flush);
+            } else if (!data.empty()) {
+              char chunk_header[2 * sizeof(uint64_t) + constants::kCRLFLength];
+              const size_t chunk_header_size = FormatChunkHeader(chunk_header, data.size());
+              const auto chunk_size = chunk_header_size + data.size() + constants::kCRLFLength;
+              const bool flush_cache =
+                  cache_size_ && (flush == ChunkFlush::Flush || chunk_size > CACHE_SIZE - cache_size_);
               if (flush == ChunkFlush::Flush || chunk_size > CACHE_SIZE) {
-                connection_.BlockingWrite(chunk_header, true);
-                connection_.BlockingWrite(std::forward<T>(data), true);
-                connection_.BlockingWrite(constants::kCRLF, false);
+                // The cached chunks, if any, and this chunk go out in a single system call.
+                connection_.BlockingWriteV({{data_cache_, flush_cache ? static_cast<size_t>(cache_size_) : 0u},
+                                            {chunk_header, chunk_header_size},
+                                            {&data[0], data.size()},
+                                            constants::kCRLF},
+                                           false);
+                cache_size_ = 0;
               } else {
-                ::memcpy(data_cache_ + cache_size_, chunk_header.c_str(), chunk_header.size());
-                cache_size_ += chunk_header.size();
+                if (flush_cache) {
+                  connection_.BlockingWrite(data_cache_, static_cast<size_t>(cache_size_), true);
+                  cache_size_ = 0;
+                }
+                ::memcpy(data_cache_ + cache_size_, chunk_header, chunk_header_size);
+                cache_size_ += chunk_header_size;
                 const size_t data_size = data.size();
                 if (data_size > 0u) {
                   ::memcpy(data_cache_ + cache_size_, &data[0], data_size);
@@ -818,7 +1646,25 @@ class GenericHTTPServerConnection final : public HTTPResponder {
         }
       }
 
-      // Only support STL containers of chars and bytes, this does not yet cover std::string.
+      // The data goes into the sink with no chunk headers, the pieces of it not flushed being cached as they are.
+      template <typename T>
+      void SendIntoSink(const T& data, ChunkFlush flush) {
+        const size_t data_size = data.size();
+        if (cache_size_ && (flush == ChunkFlush::Flush || data_size > CACHE_SIZE - cache_size_)) {
+          sink_->SendBody(data_cache_, static_cast<size_t>(cache_size_), false);
+          cache_size_ = 0;
+        }
+        if (flush == ChunkFlush::Flush || data_size > CACHE_SIZE) {
+          if (data_size) {
+            sink_->SendBody(reinterpret_cast<const char*>(&data[0]), data_size, false);
+          }
+        } else if (data_size) {
+          ::memcpy(data_cache_ + cache_size_, &data[0], data_size);
+          cache_size_ += data_size;
+        }
+      }
+
+      // Only support STL containers of chars and bytes, and `std::string_view`; this does not yet cover std::string.
       template <typename T>
       inline std::enable_if_t<std::is_same_v<typename T::value_type, char> ||
                               std::is_same_v<typename T::value_type, uint8_t> ||
@@ -837,6 +1683,9 @@ class GenericHTTPServerConnection final : public HTTPResponder {
       }
 
       Connection& connection_;
+      HTTPResponseSink* const sink_;  // Owned by `connection_`, if set.
+      const std::unique_ptr<DeflateCompressor> compressor_;
+      const std::shared_ptr<HTTPRequestPhases> phases_;
       bool can_no_longer_write_ = false;
       char data_cache_[CACHE_SIZE];
       uint64_t cache_size_ = 0;
@@ -848,7 +1697,10 @@ class GenericHTTPServerConnection final : public HTTPResponder {
       void operator=(Impl&&) = delete;
     };
 
-    explicit ChunkedResponseSender(Connection& connection) : impl_(new Impl(connection)) {}
+    explicit ChunkedResponseSender(Connection& connection,
+                                   std::unique_ptr<DeflateCompressor> compressor = nullptr,
+                                   std::shared_ptr<HTTPRequestPhases> phases = nullptr)
+        : impl_(new Impl(connection, std::move(compressor), std::move(phases))) {}
 
     template <typename T>
     inline ChunkedResponseSender& Send(T&& data, ChunkFlush flush = ChunkFlush::Flush) {
@@ -886,11 +1738,28 @@ class GenericHTTPServerConnection final : public HTTPResponder {
       CURRENT_THROW(AttemptedToSendHTTPResponseMoreThanOnce());
     } else {
       responded_ = true;
-      std::ostringstream os;
-      PrepareHTTPResponseHeader(os, ConnectionKeepAlive, code, headers, content_type);
-      os << "Transfer-Encoding: chunked" << constants::kCRLF << constants::kCRLF;
-      connection_.BlockingWrite(os.str(), true);
-      return ChunkedResponseSender<CACHE_SIZE>(connection_);
+      responded_in_chunks_ = true;
+      std::unique_ptr<DeflateCompressor> compressor;
+      const char* encoding = nullptr;
+      const HTTPCompressionOptions* compression = connection_.HTTPResponseCompression();
+      if (compression && ShouldCompress(*compression, headers, content_type)) {
+        encoding = connection_.HTTPResponseContentEncoding();
+        compressor = std::make_unique<DeflateCompressor>(HTTPContentEncodingFormat(encoding));
+      }
+      if (HTTPResponseSink* sink = connection_.HTTPResponseSinkIfAny()) {
+        sink->SendHead(code, ResponseHeaderFields(headers, content_type, encoding), false);
+      } else {
+        std::string header;
+        PrepareHTTPResponseHeader(header, ConnectionKeepAlive, code, headers, content_type);
+        if (encoding) {
+          AppendContentEncodingHeaders(header, headers, encoding);
+        }
+        header += "Transfer-Encoding: chunked";
+        header += constants::kCRLF;
+        header += constants::kCRLF;
+        connection_.BlockingWrite(header, true);
+      }
+      return ChunkedResponseSender<CACHE_SIZE>(connection_, std::move(compressor), phases_);
     }
   }
 
@@ -911,7 +1780,37 @@ class GenericHTTPServerConnection final : public HTTPResponder {
   Connection& RawConnection() { return connection_; }
 
  private:
+  // There is no `sendfile()` into a sink, so the file is read piece by piece.
+  static void SendFileIntoSink(HTTPResponseSink& sink, int fd, uint64_t offset, uint64_t length) {
+    std::vector<char> buffer(static_cast<size_t>(std::min(length, static_cast<uint64_t>(64 * 1024))));
+    while (length) {
+      const size_t block = static_cast<size_t>(std::min(length, static_cast<uint64_t>(buffer.size())));
+#ifndef CURRENT_WINDOWS
+      const bool read = (::pread(fd, buffer.data(), block, static_cast<off_t>(offset)) == static_cast<ssize_t>(block));
+#else
+      const bool read = (::_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) >= 0 &&
+                         ::_read(fd, buffer.data(), static_cast<unsigned int>(block)) == static_cast<int>(block));
+#endif  // CURRENT_WINDOWS
+      if (!read) {
+        // The file has been truncated since the length to send was determined.
+        CURRENT_THROW(SocketCouldNotWriteEverythingException());  // LCOV_EXCL_LINE
+      }
+      offset += block;
+      length -= block;
+      sink.SendBody(buffer.data(), block, !length);
+    }
+  }
+
+  void ResponseFlushed() {
+    if (phases_) {
+      phases_->response_flushed = std::chrono::steady_clock::now();
+    }
+  }
+
   bool responded_ = false;
+  bool responded_in_chunks_ = false;
+  reuse_t reuse_;
+  std::shared_ptr<HTTPRequestPhases> phases_;
   Connection connection_;
   GenericHTTPRequestData<HTTP_REQUEST_DATA> message_;
 
@@ -927,6 +1826,7 @@ class GenericHTTPServerConnection final : public HTTPResponder {
 };
 
 using HTTPServerConnection = GenericHTTPServerConnection<HTTPDefaultHelper>;
+using HTTPServerConnectionWithHeaderViews = GenericHTTPServerConnection<HTTPHeaderViewsHelper>;
 
 }  // namespace net
 }  // namespace current
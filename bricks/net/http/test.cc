@@ -30,6 +30,7 @@ SOFTWARE.
 
 #define CURRENT_BRICKS_DEBUG_HTTP
 #include "http.h"
+#include "http2.h"
 
 #include "../../dflags/dflags.h"
 #include "../../strings/printf.h"
@@ -329,6 +330,57 @@ TEST(PosixHTTPServerTest, SmokeWithHeaders) {
   t.join();
 }
 
+TEST(PosixHTTPServerTest, HeaderViews) {
+  for (bool chunked : {false, true}) {
+    auto reserved_port = current::net::ReserveLocalPort();
+    const int port = reserved_port;
+    std::thread t(
+        [](Socket s) {
+          current::net::HTTPServerConnectionWithHeaderViews c(s.Accept());
+          const auto& request = c.HTTPRequest();
+          EXPECT_EQ("POST", request.Method());
+          EXPECT_EQ("/views/a%20b?x=1&y=2#fragment", request.RawPathView());
+          EXPECT_EQ("/views/a%20b", request.PathView());
+          EXPECT_EQ("x=1&y=2", request.QueryView());
+          ASSERT_EQ(4u, request.HeadersCount());
+          EXPECT_EQ("Host", request.HeaderNameView(0));
+          EXPECT_EQ("localhost", request.HeaderValueView(0));
+          std::string_view value;
+          ASSERT_TRUE(request.HeaderView("x_custom-HEADER", value));
+          EXPECT_EQ("custom value", value);
+          EXPECT_FALSE(request.HeaderView("X-Missing", value));
+          // The headers and the URL are built on demand.
+          EXPECT_EQ("custom value", request.headers().Get("X-Custom-Header"));
+          EXPECT_EQ("42", request.headers().cookies.at("answer").value);
+          EXPECT_EQ("/views/a%20b", request.URL().path);
+          EXPECT_EQ("2", request.URL().query["y"]);
+          EXPECT_EQ("/views/a%20b?x=1&y=2#fragment", request.RawPath());
+          c.SendHTTPResponse("Body: " + request.Body());
+        },
+        std::move(reserved_port));
+    Connection connection(ClientSocket("localhost", port));
+    connection.BlockingWrite("POST /views/a%20b?x=1&y=2#fragment HTTP/1.1\r\n", true);
+    connection.BlockingWrite("Host: localhost\r\n", true);
+    connection.BlockingWrite("X-Custom-Header:   custom value \t\r\n", true);
+    connection.BlockingWrite("Cookie: answer=42\r\n", true);
+    if (!chunked) {
+      connection.BlockingWrite("Content-Length: 4\r\n\r\ndata", false);
+    } else {
+      connection.BlockingWrite("Transfer-Encoding: chunked\r\n\r\n", true);
+      connection.BlockingWrite("2\r\nda\r\n2\r\nta\r\n0\r\n", false);
+    }
+    ExpectToReceive(
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain\r\n"
+        "Connection: close\r\n"
+        "Content-Length: 10\r\n"
+        "\r\n"
+        "Body: data",
+        connection);
+    t.join();
+  }
+}
+
 TEST(PosixHTTPServerTest, SmokeWithLowercaseContentLength) {
   auto reserved_port = current::net::ReserveLocalPort();
   const int port = reserved_port;
@@ -1065,6 +1117,200 @@ TEST(HTTPMimeTypeTest, SmokeTest) {
   EXPECT_EQ("image/x-icon", GetFileMimeType("favicon.ico"));
 }
 
+TEST(HTTPBufferPoolTest, ReusesTheBuffersBySizeClass) {
+  using current::net::HTTPBufferPool;
+  HTTPBufferPool::Clear();
+  EXPECT_TRUE(HTTPBufferPool::Acquire(1000u).empty());
+
+  std::vector<char> buffer(40 * 1024, 'x');
+  const char* const data = buffer.data();
+  HTTPBufferPool::Release(std::move(buffer));
+  EXPECT_EQ(0u, HTTPBufferPool::SharedBytes());
+  EXPECT_LE(40u * 1024u, HTTPBufferPool::ThreadCachedBytes());
+
+  // Larger than the buffer kept.
+  EXPECT_TRUE(HTTPBufferPool::Acquire(48 * 1024).empty());
+  // The contents are kept as is, for the new message to only overwrite the part that it needs.
+  const std::vector<char> reused = HTTPBufferPool::Acquire(20 * 1024);
+  EXPECT_EQ(data, reused.data());
+  EXPECT_EQ(40u * 1024u, reused.size());
+  EXPECT_EQ('x', reused.back());
+  EXPECT_EQ(0u, HTTPBufferPool::ThreadCachedBytes());
+
+  // The default-sized buffers of the parser, of one byte more than the smallest size class, are reused too.
+  HTTPBufferPool::Release(std::vector<char>(16 * 1024 + 1));
+  EXPECT_EQ(16u * 1024u + 1u, HTTPBufferPool::Acquire(16 * 1024 + 1).size());
+
+  // The buffers too small or too large to be worth it are not kept.
+  HTTPBufferPool::Release(std::vector<char>(1000u));
+  HTTPBufferPool::Release(std::vector<char>(HTTPBufferPool::kMaxBufferSize + 1u));
+  EXPECT_EQ(0u, HTTPBufferPool::ThreadCachedBytes());
+
+  // Past the capacity of the cache of the thread, the buffers go to the shared pool, and to the other threads.
+  for (size_t i = 0u; i < HTTPBufferPool::kMaxBuffersPerThreadAndClass + 1u; ++i) {
+    HTTPBufferPool::Release(std::vector<char>(HTTPBufferPool::kMinBufferSize));
+  }
+  EXPECT_EQ(HTTPBufferPool::kMinBufferSize, HTTPBufferPool::SharedBytes());
+  std::thread([]() {
+    EXPECT_EQ(HTTPBufferPool::kMinBufferSize, HTTPBufferPool::Acquire(100u).size());
+    EXPECT_EQ(0u, HTTPBufferPool::SharedBytes());
+    HTTPBufferPool::Release(std::vector<char>(HTTPBufferPool::kMinBufferSize));
+  }).join();
+  // The cache of the thread is handed over to the shared pool once the thread is done.
+  EXPECT_EQ(HTTPBufferPool::kMinBufferSize, HTTPBufferPool::SharedBytes());
+  HTTPBufferPool::Clear();
+  EXPECT_EQ(0u, HTTPBufferPool::SharedBytes());
+  EXPECT_EQ(0u, HTTPBufferPool::ThreadCachedBytes());
+}
+
+namespace http2_test {
+
+inline std::string FromHex(const std::string& hex) {
+  std::string result;
+  for (size_t i = 0u; i < hex.length(); ++i) {
+    if (hex[i] != ' ') {
+      result.push_back(static_cast<char>(std::stoi(hex.substr(i, 2u), nullptr, 16)));
+      ++i;
+    }
+  }
+  return result;
+}
+
+}  // namespace http2_test
+
+// The examples of RFC 7541 Appendix C.4: the requests, with Huffman-encoded strings, sharing the dynamic table.
+TEST(HTTP2Test, HPACKRequestsRoundTrip) {
+  using namespace current::net::http2;
+  using http2_test::FromHex;
+  HPACKEncoder encoder;
+  HPACKDecoder decoder;
+
+  const HeaderList first = {
+      {":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}};
+  EXPECT_EQ(FromHex("8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff"), encoder.Encode(first));
+  EXPECT_EQ(57u, encoder.Table().Size());
+
+  HeaderList second = first;
+  second.emplace_back("cache-control", "no-cache");
+  EXPECT_EQ(FromHex("8286 84be 5886 a8eb 1064 9cbf"), encoder.Encode(second));
+  EXPECT_EQ(110u, encoder.Table().Size());
+
+  const HeaderList third = {{":method", "GET"},
+                            {":scheme", "https"},
+                            {":path", "/index.html"},
+                            {":authority", "www.example.com"},
+                            {"custom-key", "custom-value"}};
+  const std::string third_encoded = encoder.Encode(third);
+  EXPECT_EQ(FromHex("8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf"), third_encoded);
+  EXPECT_EQ(164u, encoder.Table().Size());
+
+  EXPECT_EQ(first, decoder.Decode(FromHex("8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff")));
+  EXPECT_EQ(second, decoder.Decode(FromHex("8286 84be 5886 a8eb 1064 9cbf")));
+  EXPECT_EQ(third, decoder.Decode(third_encoded));
+  EXPECT_EQ(164u, decoder.Table().Size());
+  EXPECT_EQ(3u, decoder.Table().Entries());
+  EXPECT_EQ("custom-key", decoder.Table().Entry(0u).first);
+}
+
+// The examples of RFC 7541 Appendix C.6: the responses, with the dynamic table of 256 bytes having to evict entries.
+TEST(HTTP2Test, HPACKResponsesWithEviction) {
+  using namespace current::net::http2;
+  using http2_test::FromHex;
+  HPACKDecoder decoder(256u);
+  const std::string date = "Mon, 21 Oct 2013 20:13:21 GMT";
+  const std::string location = "https://www.example.com";
+  EXPECT_EQ(HeaderList({{":status", "302"}, {"cache-control", "private"}, {"date", date}, {"location", location}}),
+            decoder.Decode(FromHex("4882 6402 5885 aec3 771a 4b61 96d0 7abe 9410 54d4 44a8 2005 9504 0b81 66e0"
+                                   "82a6 2d1b ff6e 919d 29ad 1718 63c7 8f0b 97c8 e9ae 82ae 43d3")));
+  EXPECT_EQ(222u, decoder.Table().Size());
+  EXPECT_EQ(HeaderList({{":status", "307"}, {"cache-control", "private"}, {"date", date}, {"location", location}}),
+            decoder.Decode(FromHex("4883 640e ffc1 c0bf")));
+  EXPECT_EQ(222u, decoder.Table().Size());
+  EXPECT_EQ(HeaderList({{":status", "200"},
+                        {"cache-control", "private"},
+                        {"date", "Mon, 21 Oct 2013 20:13:22 GMT"},
+                        {"location", location},
+                        {"content-encoding", "gzip"},
+                        {"set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1"}}),
+            decoder.Decode(FromHex("88c1 6196 d07a be94 1054 d444 a820 0595 040b 8166 e084 a62d 1bff c05a 839b"
+                                   "d9ab 77ad 94e7 821d d7f2 e6c7 b335 dfdf cd5b 3960 d5af 2708 7f36 72c1 ab27"
+                                   "0fb5 291f 9587 3160 65c0 03ed 4ee5 b106 3d50 07")));
+  EXPECT_EQ(215u, decoder.Table().Size());
+  EXPECT_EQ(3u, decoder.Table().Entries());
+}
+
+TEST(HTTP2Test, HPACKEncoderPolicies) {
+  using namespace current::net::http2;
+  HPACKEncoder encoder;
+  HPACKDecoder decoder;
+  const HeaderList headers = {{":status", "200"},
+                              {"content-type", "application/json"},
+                              {"content-length", "42"},
+                              {"set-cookie", "session=secret"}};
+  const std::string first = encoder.Encode(headers);
+  EXPECT_EQ(headers, decoder.Decode(first));
+  // Only the content type is worth indexing: the cookie is never indexed, and the length changes too often.
+  EXPECT_EQ(1u, encoder.Table().Entries());
+  EXPECT_EQ(1u, decoder.Table().Entries());
+  const std::string second = encoder.Encode(headers);
+  EXPECT_LT(second.length(), first.length());
+  EXPECT_EQ(headers, decoder.Decode(second));
+
+  // The smaller table size of the peer is announced at the beginning of the next block, and is kept by the decoder.
+  encoder.SetMaxTableSize(0u);
+  const std::string third = encoder.Encode(headers);
+  EXPECT_EQ('\x20', third[0]);
+  EXPECT_EQ(headers, decoder.Decode(third));
+  EXPECT_EQ(0u, decoder.Table().Entries());
+  EXPECT_EQ(0u, decoder.Table().MaxSize());
+
+  // All the byte values survive the Huffman code.
+  std::string all_bytes;
+  for (int c = 0; c < 256; ++c) {
+    all_bytes.push_back(static_cast<char>(c));
+  }
+  std::string encoded;
+  HPACKHuffmanCode::Instance().Encode(all_bytes, encoded);
+  EXPECT_EQ(HPACKHuffmanCode::Instance().EncodedLength(all_bytes), encoded.length());
+  EXPECT_EQ(all_bytes, HPACKHuffmanCode::Instance().Decode(encoded));
+}
+
+TEST(HTTP2Test, HPACKDecodingErrors) {
+  using namespace current::net::http2;
+  using http2_test::FromHex;
+  // The index of zero, and past the dynamic table.
+  EXPECT_THROW(HPACKDecoder().Decode(FromHex("80")), HPACKDecodingException);
+  EXPECT_THROW(HPACKDecoder().Decode(FromHex("be")), HPACKDecodingException);
+  // The string longer than the block.
+  EXPECT_THROW(HPACKDecoder().Decode(FromHex("4005 6162")), HPACKDecodingException);
+  // The integer that never ends, and the one too large.
+  EXPECT_THROW(HPACKDecoder().Decode(FromHex("ffff")), HPACKDecodingException);
+  EXPECT_THROW(HPACKDecoder().Decode(FromHex("ffff ffff ffff ff")), HPACKDecodingException);
+  // The table size update over the announced limit, and after a header field.
+  EXPECT_THROW(HPACKDecoder().Decode(FromHex("3fe2 1f")), HPACKDecodingException);
+  EXPECT_THROW(HPACKDecoder().Decode(FromHex("8220")), HPACKDecodingException);
+  // The Huffman padding of zeros, and of more than seven bits.
+  EXPECT_THROW(HPACKHuffmanCode::Instance().Decode(FromHex("00")), HPACKDecodingException);
+  EXPECT_THROW(HPACKHuffmanCode::Instance().Decode(FromHex("ffff")), HPACKDecodingException);
+  // The header list larger than allowed.
+  EXPECT_THROW(HPACKDecoder(4096u, 100u).Decode(FromHex("8282 8282")), HPACKDecodingException);
+}
+
+TEST(HTTP2Test, Frames) {
+  using namespace current::net::http2;
+  const std::string frame = SerializeFrame(FrameType::Headers, kFlagEndHeaders | kFlagEndStream, 3u, "abc");
+  ASSERT_EQ(kFrameHeaderLength + 3u, frame.length());
+  const FrameHeader header = FrameHeader::Parse(reinterpret_cast<const uint8_t*>(frame.data()));
+  EXPECT_EQ(3u, header.length);
+  EXPECT_TRUE(header.type == FrameType::Headers);
+  EXPECT_TRUE(header.HasFlag(kFlagEndHeaders));
+  EXPECT_FALSE(header.HasFlag(kFlagPadded));
+  EXPECT_EQ(3u, header.stream_id);
+  EXPECT_EQ("abc", frame.substr(kFrameHeaderLength));
+  EXPECT_EQ(std::string("\0\x04\0\x10\0\0", 6u), SettingsPayload({{Setting::InitialWindowSize, 1048576u}}));
+  EXPECT_EQ(24u, kConnectionPrefaceLength);
+}
+
 // TODO(dkorolev): Figure out a way to test ConnectionResetByPeer exceptions.
 
 #if 0
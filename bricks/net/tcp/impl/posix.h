@@ -46,8 +46,16 @@ rm -f core ; while true ; do ./.current/test --gtest_throw_on_failure --gtest_ca
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <netinet/tcp.h>
+#include <poll.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <unistd.h>
+#ifdef CURRENT_APPLE
+#include <sys/types.h>
+#include <sys/uio.h>
+#else
+#include <sys/sendfile.h>
+#endif  // CURRENT_APPLE
 
 // Bricks uses `SOCKET` for socket handles in *nix.
 // Makes it easier to have the code run on both Windows and *nix.
@@ -66,7 +74,13 @@ typedef int SOCKET;
 
 #endif  // CURRENT_WINDOWS
 
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <initializer_list>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <cstring>
 #include <string>
 #include <utility>
@@ -81,12 +95,44 @@ typedef int SOCKET;
 namespace current {
 namespace net {
 
+struct HTTPCompressionOptions;  // See `bricks/net/http/compression.h`.
+struct HTTPResponseSink;        // See `bricks/net/http/impl/server.h`.
+
 enum class NagleAlgorithm : bool { Disable, Keep };
 const NagleAlgorithm kDefaultNagleAlgorithmPolicy = NagleAlgorithm::Keep;
 
+// Whether to bind the listening socket with `SO_REUSEPORT`, to have more sockets listen on the same port.
+enum class ReusePort : bool { No = false, Yes = true };
+
 enum class MaxServerQueuedConnectionsValue : int {};
 const MaxServerQueuedConnectionsValue kMaxServerQueuedConnections = MaxServerQueuedConnectionsValue(1024);
 
+// The options of the TCP sockets to tune per service, see `SocketHandle::SetConnectionOptions()` and
+// `SocketHandle::SetListeningOptions()`. The ones not set are left as they are, the system defaults by default.
+// `quick_ack`, `defer_accept` and `busy_poll` are Linux-only, and `fast_open_queue_length` is unavailable on Windows;
+// setting them elsewhere throws `SocketOptionException`.
+struct SocketOptions final {
+  // The options of each connection.
+  // `SO_SNDBUF` and `SO_RCVBUF`, the sizes of the OS-side buffers of the data to send, and of the data received.
+  std::optional<size_t> send_buffer_size;
+  std::optional<size_t> receive_buffer_size;
+  // `TCP_NODELAY`, unless `NagleAlgorithm::Keep`.
+  std::optional<NagleAlgorithm> nagle_algorithm;
+  // `TCP_QUICKACK`, to acknowledge the data received right away, instead of delaying the ACKs. Linux may turn it
+  // back off by itself later in the life of the connection.
+  std::optional<bool> quick_ack;
+  // `SO_BUSY_POLL`, for how long the blocking reads busy-poll the device queue before sleeping.
+  std::optional<std::chrono::microseconds> busy_poll;
+
+  // The options of the listening socket.
+  // `TCP_DEFER_ACCEPT`, to not accept a connection until its first data has arrived, or for up to this long.
+  std::optional<std::chrono::seconds> defer_accept;
+  // `TCP_FASTOPEN`, the number of pending TCP Fast Open connections, the first data of which arrives with the SYN.
+  std::optional<int> fast_open_queue_length;
+  // The backlog of `listen()`, for the socket listening already.
+  std::optional<MaxServerQueuedConnectionsValue> max_queued_connections;
+};
+
 struct SocketSystemInitializer {
 #ifdef CURRENT_WINDOWS
   struct OneTimeInitializer {
@@ -156,8 +202,13 @@ class SocketHandle : private SocketSystemInitializer {
   explicit SocketHandle(BindAndListen,
                         BarePort bare_port,
                         NagleAlgorithm nagle_algorithm_policy = kDefaultNagleAlgorithmPolicy,
-                        MaxServerQueuedConnectionsValue max_connections = kMaxServerQueuedConnections)
+                        MaxServerQueuedConnectionsValue max_connections = kMaxServerQueuedConnections,
+                        ReusePort reuse_port = ReusePort::No)
       : SocketHandle(InternalInit(), nagle_algorithm_policy) {
+    if (reuse_port == ReusePort::Yes) {
+      EnableReusePort();
+    }
+
     sockaddr_in addr_server;
     memset(&addr_server, 0, sizeof(addr_server));
     addr_server.sin_family = AF_INET;
@@ -195,6 +246,10 @@ class SocketHandle : private SocketSystemInitializer {
     CURRENT_BRICKS_NET_LOG("S%05d == initialized externally.\n", socket_);
   }
 
+  // For the `Connection`-s that carry a message of another connection, written elsewhere, see `HTTPResponseSink`.
+  struct NoSocket final {};
+  explicit SocketHandle(NoSocket) : socket_(static_cast<SOCKET>(-1)) {}
+
   ~SocketHandle() {
     if (socket_ != static_cast<SOCKET>(-1)) {
       CURRENT_BRICKS_NET_LOG("S%05d close() ...\n", socket_);
@@ -211,7 +266,100 @@ class SocketHandle : private SocketSystemInitializer {
 
   explicit SocketHandle(SocketHandle&& rhs) : socket_(static_cast<SOCKET>(-1)) { std::swap(socket_, rhs.socket_); }
 
+  // Sets `SO_REUSEPORT`, for the sockets bound to the same port with it set as well to share the incoming connections.
+  // Can be set on a socket that is listening already, for the sockets bound after it to join it. Linux only, as on
+  // other systems `SO_REUSEPORT` either does not balance the incoming connections, or is not available.
+  void EnableReusePort() {
+#if !defined(CURRENT_WINDOWS) && !defined(CURRENT_APPLE) && defined(SO_REUSEPORT)
+    int just_one = 1;
+    if (::setsockopt(socket_, SOL_SOCKET, SO_REUSEPORT, &just_one, sizeof(just_one))) {
+      CURRENT_THROW(SocketOptionException());  // LCOV_EXCL_LINE -- Not covered by the unit tests.
+    }
+#else
+    CURRENT_THROW(SocketOptionException());
+#endif
+  }
+
+  // Sets the options of a connection from `options`, the ones of them that are set.
+  void SetConnectionOptions(const SocketOptions& options) {
+    if (options.send_buffer_size) {
+      SetIntegerOption(SOL_SOCKET, SO_SNDBUF, static_cast<int>(*options.send_buffer_size));
+    }
+    if (options.receive_buffer_size) {
+      SetIntegerOption(SOL_SOCKET, SO_RCVBUF, static_cast<int>(*options.receive_buffer_size));
+    }
+    if (options.nagle_algorithm) {
+      SetIntegerOption(IPPROTO_TCP, TCP_NODELAY, *options.nagle_algorithm == NagleAlgorithm::Disable ? 1 : 0);
+    }
+    if (options.quick_ack) {
+#if defined(CURRENT_POSIX) && !defined(CURRENT_APPLE) && defined(TCP_QUICKACK)
+      SetIntegerOption(IPPROTO_TCP, TCP_QUICKACK, *options.quick_ack ? 1 : 0);
+#else
+      CURRENT_THROW(SocketOptionException());
+#endif
+    }
+    if (options.busy_poll) {
+#if defined(CURRENT_POSIX) && !defined(CURRENT_APPLE) && defined(SO_BUSY_POLL)
+      SetIntegerOption(SOL_SOCKET, SO_BUSY_POLL, static_cast<int>(options.busy_poll->count()));
+#else
+      CURRENT_THROW(SocketOptionException());
+#endif
+    }
+  }
+
+  // Sets the options of a listening socket from `options`, the ones of them that are set. The options of the
+  // connections set on the listening socket are inherited by the connections it accepts on most systems.
+  void SetListeningOptions(const SocketOptions& options) {
+    if (options.defer_accept) {
+#if defined(CURRENT_POSIX) && !defined(CURRENT_APPLE) && defined(TCP_DEFER_ACCEPT)
+      SetIntegerOption(IPPROTO_TCP, TCP_DEFER_ACCEPT, static_cast<int>(options.defer_accept->count()));
+#else
+      CURRENT_THROW(SocketOptionException());
+#endif
+    }
+    if (options.fast_open_queue_length) {
+#if !defined(CURRENT_WINDOWS) && defined(TCP_FASTOPEN)
+      SetIntegerOption(IPPROTO_TCP, TCP_FASTOPEN, *options.fast_open_queue_length);
+#else
+      CURRENT_THROW(SocketOptionException());
+#endif
+    }
+    if (options.max_queued_connections) {
+      // Calling `listen()` again on the listening socket updates its backlog.
+      if (::listen(socket, static_cast<int>(*options.max_queued_connections))) {
+        CURRENT_THROW(SocketListenException());  // LCOV_EXCL_LINE -- Not covered by the unit tests.
+      }
+    }
+  }
+
+  // Returns the value of an integer option of the socket, such as `SOL_SOCKET` and `SO_RCVBUF`.
+  int GetIntegerOption(int level, int name) const {
+    int value = 0;
+#ifndef CURRENT_WINDOWS
+    socklen_t length = sizeof(value);
+    if (::getsockopt(socket_, level, name, &value, &length))
+#else
+    int length = sizeof(value);
+    if (::getsockopt(socket_, level, name, reinterpret_cast<char*>(&value), &length))
+#endif  // CURRENT_WINDOWS
+    {
+      CURRENT_THROW(SocketOptionException());  // LCOV_EXCL_LINE -- Not covered by the unit tests.
+    }
+    return value;
+  }
+
  private:
+  void SetIntegerOption(int level, int name, int value) {
+#ifndef CURRENT_WINDOWS
+    if (::setsockopt(socket_, level, name, &value, sizeof(value)))
+#else
+    if (::setsockopt(socket_, level, name, reinterpret_cast<const char*>(&value), sizeof(value)))
+#endif  // CURRENT_WINDOWS
+    {
+      CURRENT_THROW(SocketOptionException());
+    }
+  }
+
   friend class Socket;
   SOCKET socket_;
 
@@ -399,6 +547,16 @@ class ReserveLocalPortImpl final {
                                          std::move(hold_port_or_throw));
 }
 
+// A piece of the data to write with `Connection::BlockingWriteV()`. Does not own the data.
+struct WriteBuffer final {
+  const void* data;
+  size_t length;
+
+  WriteBuffer(const void* data, size_t length) : data(data), length(length) {}
+  WriteBuffer(const char* s) : data(s), length(strlen(s)) {}
+  WriteBuffer(const std::string& s) : data(s.data()), length(s.length()) {}
+};
+
 class Connection : public SocketHandle {
  public:
   Connection(SocketHandle&& rhs, IPAndPort&& local_ip_and_port, IPAndPort&& remote_ip_and_port)
@@ -412,6 +570,40 @@ class Connection : public SocketHandle {
 
   const IPAndPort& RemoteIPAndPort() const { return remote_ip_and_port_; }
 
+  // Bounds the time `BlockingWrite()` may wait for the peer to accept the data, so that a stalled peer does not
+  // block the writing thread indefinitely. Once it expires, `SocketWriteTimeoutException` is thrown.
+  // The default, zero, is no limit.
+  Connection& SetWriteTimeout(std::chrono::milliseconds timeout) {
+#ifndef CURRENT_WINDOWS
+    timeval tv;
+    tv.tv_sec = static_cast<decltype(tv.tv_sec)>(timeout.count() / 1000);
+    tv.tv_usec = static_cast<decltype(tv.tv_usec)>((timeout.count() % 1000) * 1000);
+    if (::setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)))
+#else
+    const DWORD ms = static_cast<DWORD>(timeout.count());
+    if (::setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&ms), sizeof(ms)))
+#endif  // CURRENT_WINDOWS
+    {
+      CURRENT_THROW(SocketOptionException());  // LCOV_EXCL_LINE -- Not covered by unit tests.
+    }
+    has_write_timeout_ = (timeout.count() > 0);
+    return *this;
+  }
+
+  // Bounds the size of the OS-side buffer of the data written, but not yet sent to the peer.
+  Connection& SetSendBufferSize(size_t bytes) {
+    const int size = static_cast<int>(bytes);
+#ifndef CURRENT_WINDOWS
+    if (::setsockopt(socket, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)))
+#else
+    if (::setsockopt(socket, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char*>(&size), sizeof(size)))
+#endif  // CURRENT_WINDOWS
+    {
+      CURRENT_THROW(SocketOptionException());  // LCOV_EXCL_LINE -- Not covered by unit tests.
+    }
+    return *this;
+  }
+
   // By default, BlockingRead() will return as soon as some data has been read,
   // with the exception being multibyte records (sizeof(T) > 1), where it will keep reading
   // until the boundary of the records, or max_length of them, has been read.
@@ -427,6 +619,16 @@ class Connection : public SocketHandle {
       uint8_t* buffer = reinterpret_cast<uint8_t*>(output_buffer);
       uint8_t* ptr = buffer;
       const uint8_t* end = (buffer + max_length);
+
+      if (prefetched_offset_ < prefetched_data_.length()) {
+        const size_t n = ReadPrefetchedData(ptr, max_length);
+        ptr += n;
+        if (policy == BlockingReadPolicy::ReturnASAP || ptr == end) {
+          return n;
+        }
+        const size_t remaining = BlockingRead(ptr, static_cast<size_t>(end - ptr), policy);
+        return n + remaining;
+      }
       const int flags = ((policy == BlockingReadPolicy::ReturnASAP) ? 0 : MSG_WAITALL);
 
 #ifdef CURRENT_WINDOWS
@@ -450,6 +652,7 @@ class Connection : public SocketHandle {
                                static_cast<int>(retval),
                                errno);
         if (retval > 0) {
+          OnBytesReceived();
           ptr += retval;
           if ((policy == BlockingReadPolicy::ReturnASAP) || (ptr == end)) {
             return (ptr - buffer);
@@ -526,6 +729,143 @@ class Connection : public SocketHandle {
     }
   }
 
+#ifndef CURRENT_WINDOWS
+  // Reads whatever has already been received, without waiting. Returns zero if nothing has been.
+  // Throws `ConnectionResetByPeer` once the peer has closed the connection, or on any other error.
+  size_t NonBlockingRead(void* output_buffer, size_t max_length) {
+    const ssize_t retval = ::recv(socket, output_buffer, max_length, MSG_DONTWAIT);
+    if (retval > 0) {
+      OnBytesReceived();
+      return static_cast<size_t>(retval);
+    } else if (retval < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+      return 0u;
+    } else {
+      CURRENT_THROW(ConnectionResetByPeer());
+    }
+  }
+
+  // Writes what there is room for right away, without waiting. Returns the number of bytes written, maybe zero.
+  size_t NonBlockingWrite(const void* buffer, size_t length) {
+#ifndef CURRENT_APPLE
+    const ssize_t retval = ::send(socket, buffer, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+#else
+    const ssize_t retval = ::send(socket, buffer, length, MSG_DONTWAIT);
+#endif  // CURRENT_APPLE
+    if (retval >= 0) {
+      return static_cast<size_t>(retval);
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      return 0u;
+    } else {
+      CURRENT_THROW(SocketWriteException());
+    }
+  }
+
+  // Wait for the data to read, or for the room to write, until `deadline`, and return whether it is there.
+  // The peer having closed the connection counts as the data to read, for the read to report it.
+  // `std::chrono::steady_clock::time_point::max()` is no deadline.
+  bool WaitUntilReadable(std::chrono::steady_clock::time_point deadline) {
+    return prefetched_offset_ < prefetched_data_.length() || WaitUntil(POLLIN, deadline);
+  }
+  bool WaitUntilWritable(std::chrono::steady_clock::time_point deadline) { return WaitUntil(POLLOUT, deadline); }
+
+  // The counterparts of `BlockingRead()` and `BlockingWrite()` that do not wait past `deadline`, throwing
+  // `SocketReadTimeoutException` and `SocketWriteTimeoutException` respectively once it has passed. Unlike
+  // `BlockingRead()`, `ReadWithDeadline()` throws `ConnectionResetByPeer` once the peer has closed the connection.
+  size_t ReadWithDeadline(void* output_buffer,
+                          size_t max_length,
+                          std::chrono::steady_clock::time_point deadline,
+                          BlockingReadPolicy policy = BlockingReadPolicy::ReturnASAP) {
+    uint8_t* const buffer = static_cast<uint8_t*>(output_buffer);
+    size_t offset = ReadPrefetchedData(buffer, max_length);
+    while (offset < max_length && !(offset && policy == BlockingReadPolicy::ReturnASAP)) {
+      const size_t read_count = NonBlockingRead(buffer + offset, max_length - offset);
+      if (read_count) {
+        offset += read_count;
+      } else if (!WaitUntilReadable(deadline)) {
+        CURRENT_THROW(SocketReadTimeoutException());
+      }
+    }
+    return offset;
+  }
+
+  Connection& WriteWithDeadline(const void* buffer, size_t length, std::chrono::steady_clock::time_point deadline) {
+    const uint8_t* const data = static_cast<const uint8_t*>(buffer);
+    size_t offset = 0u;
+    while (offset < length) {
+      const size_t write_count = NonBlockingWrite(data + offset, length - offset);
+      if (write_count) {
+        offset += write_count;
+      } else if (!WaitUntilWritable(deadline)) {
+        CURRENT_THROW(SocketWriteTimeoutException());
+      }
+    }
+    return *this;
+  }
+  Connection& WriteWithDeadline(const std::string& data, std::chrono::steady_clock::time_point deadline) {
+    return WriteWithDeadline(data.data(), data.length(), deadline);
+  }
+#endif  // CURRENT_WINDOWS
+
+  // Makes the subsequent `BlockingRead()`-s return `data` first, before reading from the socket. Used to
+  // parse the data that has been read ahead, as the event loop of the HTTP server does with `NonBlockingRead()`.
+  Connection& SetPrefetchedData(std::string data) {
+    prefetched_data_ = std::move(data);
+    prefetched_offset_ = 0u;
+    return *this;
+  }
+
+  // Returns the prefetched data not read yet, if any, so that it can be passed on along with this connection.
+  std::string TakePrefetchedData() {
+    std::string data = prefetched_data_.substr(std::min(prefetched_offset_, prefetched_data_.length()));
+    prefetched_data_.clear();
+    prefetched_offset_ = 0u;
+    return data;
+  }
+
+  // Whether the HTTP responses written into this connection should ask the peer to keep it open, as opposed
+  // to closing it right after the response. See `GenericHTTPServerConnection::KeepAlive()`.
+  Connection& SetHTTPKeepAlive(bool keep_alive) {
+    http_keep_alive_ = keep_alive;
+    return *this;
+  }
+  bool HTTPKeepAlive() const { return http_keep_alive_; }
+
+  // How to compress the HTTP responses written into this connection, with the content encoding negotiated for the
+  // request being served, or `nullptr` not to. See `GenericHTTPServerConnection::CompressResponses()`.
+  Connection& SetHTTPResponseCompression(std::shared_ptr<const HTTPCompressionOptions> options, const char* encoding) {
+    http_response_compression_ = std::move(options);
+    http_response_content_encoding_ = encoding;
+    return *this;
+  }
+  const HTTPCompressionOptions* HTTPResponseCompression() const { return http_response_compression_.get(); }
+  const char* HTTPResponseContentEncoding() const { return http_response_content_encoding_; }
+
+  // Where the HTTP responses go instead of being written into this connection as HTTP/1.1, if anywhere. Set for
+  // the requests received otherwise than as HTTP/1.1 text, such as the streams of HTTP/2; see `HTTPResponseSink`.
+  Connection& SetHTTPResponseSink(std::shared_ptr<HTTPResponseSink> sink) {
+    http_response_sink_ = std::move(sink);
+    return *this;
+  }
+  HTTPResponseSink* HTTPResponseSinkIfAny() const { return http_response_sink_.get(); }
+
+  // When the connection was opened, or, once kept alive, when it started to wait for the next message, and when
+  // the first byte of that message has been received; for the HTTP server to time the phases of the requests.
+  std::chrono::steady_clock::time_point StartedAt() const { return started_at_; }
+  std::chrono::steady_clock::time_point FirstByteAt() const { return first_byte_at_; }
+  Connection& RestartTimings(bool received_already) {
+    started_at_ = std::chrono::steady_clock::now();
+    first_byte_at_ = received_already ? started_at_ : std::chrono::steady_clock::time_point();
+    return *this;
+  }
+
+  // The buffer the previous message on this connection has been read into, if it has been handed back with
+  // `KeepReadBuffer()`, so that the next message is read into it, instead of a newly allocated and zeroed one.
+  std::vector<char> TakeReadBuffer() { return std::move(read_buffer_); }
+  Connection& KeepReadBuffer(std::vector<char>&& buffer) {
+    read_buffer_ = std::move(buffer);
+    return *this;
+  }
+
   Connection& BlockingWrite(const void* buffer, size_t write_length, bool more) {
 #if defined(CURRENT_APPLE) || defined(CURRENT_WINDOWS)
     static_cast<void>(more);  // Supress the 'unused parameter' warning.
@@ -542,8 +882,19 @@ class Connection : public SocketHandle {
         static_cast<int>(::send(socket, static_cast<const char*>(buffer), static_cast<int>(write_length), 0));
 #endif
     if (result < 0) {
+#ifndef CURRENT_WINDOWS
+      if (has_write_timeout_ && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+#else
+      if (has_write_timeout_ && ::WSAGetLastError() == WSAETIMEDOUT) {
+#endif  // CURRENT_WINDOWS
+        CURRENT_THROW(SocketWriteTimeoutException());
+      }
       CURRENT_THROW(SocketWriteException());  // LCOV_EXCL_LINE -- Not covered by the unit tests.
     } else if (static_cast<size_t>(result) != write_length) {
+      if (has_write_timeout_) {
+        // With the timeout set, a partial write is the timeout having expired in the middle of it.
+        CURRENT_THROW(SocketWriteTimeoutException());
+      }
       CURRENT_THROW(SocketCouldNotWriteEverythingException());  // This one is tested though.
     }
     CURRENT_BRICKS_NET_LOG(
@@ -556,6 +907,135 @@ class Connection : public SocketHandle {
     return BlockingWrite(s, strlen(s), more);
   }
 
+  // Writes several buffers, in order, with a single `sendmsg()` / `writev()` / `WSASend()` call, as opposed to one
+  // `send()` per buffer. Throws the same exceptions as `BlockingWrite()`.
+  Connection& BlockingWriteV(const WriteBuffer* buffers, size_t count, bool more) {
+#if defined(CURRENT_APPLE) || defined(CURRENT_WINDOWS)
+    static_cast<void>(more);  // Supress the 'unused parameter' warning.
+#endif
+#ifndef CURRENT_WINDOWS
+    constexpr size_t kMaxBuffersPerCall = 1024u;  // The `IOV_MAX` of both Linux and macOS.
+    struct iovec iov[kMaxBuffersPerCall];
+    while (count) {
+      const size_t n = std::min(count, kMaxBuffersPerCall);
+      size_t write_length = 0u;
+      for (size_t i = 0u; i < n; ++i) {
+        iov[i].iov_base = const_cast<void*>(buffers[i].data);
+        iov[i].iov_len = buffers[i].length;
+        write_length += buffers[i].length;
+      }
+      CURRENT_BRICKS_NET_LOG("S%05d BlockingWriteV(%d buffers, %d bytes) ...\n",
+                             static_cast<SOCKET>(socket),
+                             static_cast<int>(n),
+                             static_cast<int>(write_length));
+#ifndef CURRENT_APPLE
+      struct msghdr message;
+      ::memset(&message, 0, sizeof(message));
+      message.msg_iov = iov;
+      message.msg_iovlen = n;
+      const ssize_t result = ::sendmsg(socket, &message, MSG_NOSIGNAL | ((more || n < count) ? MSG_MORE : 0));
+#else
+      const ssize_t result = ::writev(socket, iov, static_cast<int>(n));
+#endif  // CURRENT_APPLE
+      if (result < 0) {
+        if (has_write_timeout_ && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+          CURRENT_THROW(SocketWriteTimeoutException());
+        }
+        CURRENT_THROW(SocketWriteException());  // LCOV_EXCL_LINE -- Not covered by the unit tests.
+      } else if (static_cast<size_t>(result) != write_length) {
+        if (has_write_timeout_) {
+          CURRENT_THROW(SocketWriteTimeoutException());
+        }
+        CURRENT_THROW(SocketCouldNotWriteEverythingException());  // LCOV_EXCL_LINE
+      }
+      buffers += n;
+      count -= n;
+    }
+    CURRENT_BRICKS_NET_LOG("S%05d BlockingWriteV() : OK\n", static_cast<SOCKET>(socket));
+#else
+    constexpr size_t kMaxBuffersPerCall = 1024u;  // Same as elsewhere, to keep the array on the stack.
+    WSABUF wsa_buffers[kMaxBuffersPerCall];
+    while (count) {
+      const size_t n = std::min(count, kMaxBuffersPerCall);
+      size_t write_length = 0u;
+      for (size_t i = 0u; i < n; ++i) {
+        wsa_buffers[i].buf = static_cast<CHAR*>(const_cast<void*>(buffers[i].data));
+        wsa_buffers[i].len = static_cast<ULONG>(buffers[i].length);
+        write_length += buffers[i].length;
+      }
+      CURRENT_BRICKS_NET_LOG("S%05d BlockingWriteV(%d buffers, %d bytes) ...\n",
+                             static_cast<SOCKET>(socket),
+                             static_cast<int>(n),
+                             static_cast<int>(write_length));
+      DWORD sent = 0;
+      if (::WSASend(socket, wsa_buffers, static_cast<DWORD>(n), &sent, 0, nullptr, nullptr) == SOCKET_ERROR) {
+        if (has_write_timeout_ && ::WSAGetLastError() == WSAETIMEDOUT) {
+          CURRENT_THROW(SocketWriteTimeoutException());
+        }
+        CURRENT_THROW(SocketWriteException());  // LCOV_EXCL_LINE -- Not covered by the unit tests.
+      } else if (static_cast<size_t>(sent) != write_length) {
+        if (has_write_timeout_) {
+          CURRENT_THROW(SocketWriteTimeoutException());
+        }
+        CURRENT_THROW(SocketCouldNotWriteEverythingException());  // LCOV_EXCL_LINE
+      }
+      buffers += n;
+      count -= n;
+    }
+    CURRENT_BRICKS_NET_LOG("S%05d BlockingWriteV() : OK\n", static_cast<SOCKET>(socket));
+#endif  // CURRENT_WINDOWS
+    return *this;
+  }
+
+  Connection& BlockingWriteV(std::initializer_list<WriteBuffer> buffers, bool more) {
+    return BlockingWriteV(buffers.begin(), buffers.size(), more);
+  }
+
+  // Writes `length` bytes of the file open as `fd`, starting from `offset`, with no copy of them made in the user
+  // space: via `sendfile()` on Linux and macOS, and via reading the file in blocks on Windows. Does not change
+  // the position in the file, so that the same `fd` can be sent from by several threads at once.
+  Connection& BlockingSendFile(int fd, uint64_t offset, uint64_t length) {
+    CURRENT_BRICKS_NET_LOG(
+        "S%05d BlockingSendFile(%d bytes) ...\n", static_cast<SOCKET>(socket), static_cast<int>(length));
+    while (length) {
+#if !defined(CURRENT_WINDOWS) && !defined(CURRENT_APPLE)
+      off_t file_offset = static_cast<off_t>(offset);
+      const ssize_t result = ::sendfile(socket, fd, &file_offset, static_cast<size_t>(length));
+      const bool failed = (result < 0);
+      const uint64_t sent = failed ? 0u : static_cast<uint64_t>(result);
+#elif defined(CURRENT_APPLE)
+      off_t sent_bytes = static_cast<off_t>(length);
+      const bool failed = (::sendfile(fd, socket, static_cast<off_t>(offset), &sent_bytes, nullptr, 0) < 0 &&
+                           !(errno == EAGAIN && sent_bytes > 0));
+      const uint64_t sent = static_cast<uint64_t>(sent_bytes);
+#else
+      char buffer[64 * 1024];
+      const unsigned int block = static_cast<unsigned int>(std::min(length, static_cast<uint64_t>(sizeof(buffer))));
+      const bool failed = (::_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0 ||
+                           ::_read(fd, buffer, block) != static_cast<int>(block));
+      if (!failed) {
+        BlockingWrite(buffer, block, length > block);
+      }
+      const uint64_t sent = failed ? 0u : block;
+#endif
+      if (failed) {
+#ifndef CURRENT_WINDOWS
+        if (has_write_timeout_ && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+          CURRENT_THROW(SocketWriteTimeoutException());
+        }
+#endif  // CURRENT_WINDOWS
+        CURRENT_THROW(SocketWriteException());  // LCOV_EXCL_LINE -- Not covered by the unit tests.
+      } else if (!sent) {
+        // The file has been truncated since the length to send was determined.
+        CURRENT_THROW(SocketCouldNotWriteEverythingException());  // LCOV_EXCL_LINE
+      }
+      offset += sent;
+      length -= sent;
+    }
+    CURRENT_BRICKS_NET_LOG("S%05d BlockingSendFile() : OK\n", static_cast<SOCKET>(socket));
+    return *this;
+  }
+
   template <typename T>
   Connection& BlockingWrite(const T begin, const T end, bool more) {
     if (begin != end) {
@@ -575,6 +1055,67 @@ class Connection : public SocketHandle {
  private:
   const IPAndPort local_ip_and_port_;
   const IPAndPort remote_ip_and_port_;
+  bool has_write_timeout_ = false;
+  std::string prefetched_data_;
+  size_t prefetched_offset_ = 0u;
+  bool http_keep_alive_ = false;
+  std::shared_ptr<const HTTPCompressionOptions> http_response_compression_;
+  const char* http_response_content_encoding_ = nullptr;
+  std::shared_ptr<HTTPResponseSink> http_response_sink_;
+  std::vector<char> read_buffer_;
+  std::chrono::steady_clock::time_point started_at_ = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point first_byte_at_;
+
+  // Copies into `buffer` what is left of the prefetched data, up to `max_length` bytes. Returns the number copied.
+  size_t ReadPrefetchedData(uint8_t* buffer, size_t max_length) {
+    const size_t n = std::min(max_length, prefetched_data_.length() - prefetched_offset_);
+    if (n) {
+      std::memcpy(buffer, prefetched_data_.data() + prefetched_offset_, n);
+      prefetched_offset_ += n;
+      if (prefetched_offset_ == prefetched_data_.length()) {
+        prefetched_data_.clear();
+        prefetched_offset_ = 0u;
+      }
+    }
+    return n;
+  }
+
+#ifndef CURRENT_WINDOWS
+  bool WaitUntil(short events, std::chrono::steady_clock::time_point deadline) {
+    while (true) {
+      int timeout_ms = -1;
+      if (deadline != std::chrono::steady_clock::time_point::max()) {
+        const auto now = std::chrono::steady_clock::now();
+        if (deadline <= now) {
+          timeout_ms = 0;
+        } else {
+          const long long ms = std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count();
+          timeout_ms = static_cast<int>(std::min(ms, static_cast<long long>(INT_MAX)));
+        }
+      }
+      pollfd fd;
+      fd.fd = socket;
+      fd.events = events;
+      fd.revents = 0;
+      const int retval = ::poll(&fd, 1, timeout_ms);
+      if (retval > 0) {
+        return true;
+      } else if (retval == 0) {
+        if (!timeout_ms || std::chrono::steady_clock::now() >= deadline) {
+          return false;
+        }
+      } else if (errno != EINTR) {
+        CURRENT_THROW(SocketException());  // LCOV_EXCL_LINE
+      }
+    }
+  }
+#endif  // CURRENT_WINDOWS
+
+  void OnBytesReceived() {
+    if (first_byte_at_ == std::chrono::steady_clock::time_point()) {
+      first_byte_at_ = std::chrono::steady_clock::now();
+    }
+  }
 
   Connection() = delete;
   Connection(const Connection&) = delete;
@@ -586,8 +1127,9 @@ class Socket final : public SocketHandle {
  public:
   explicit Socket(BarePort bare_port,
                   NagleAlgorithm nagle_algorithm_policy = kDefaultNagleAlgorithmPolicy,
-                  MaxServerQueuedConnectionsValue max_connections = kMaxServerQueuedConnections)
-      : SocketHandle(SocketHandle::BindAndListen(), bare_port, nagle_algorithm_policy, max_connections) {}
+                  MaxServerQueuedConnectionsValue max_connections = kMaxServerQueuedConnections,
+                  ReusePort reuse_port = ReusePort::No)
+      : SocketHandle(SocketHandle::BindAndListen(), bare_port, nagle_algorithm_policy, max_connections, reuse_port) {}
 
   explicit Socket(ReservedLocalPort&& reserved_port) : SocketHandle(std::move(reserved_port)) {}
 
@@ -604,6 +1146,16 @@ class Socket final : public SocketHandle {
   Socket(const Socket&) = delete;
   Socket& operator=(const Socket&) = delete;
 
+  // Makes the `Accept()` blocked on this socket, if any, and the subsequent ones, throw, with the socket no longer
+  // accepting the new connections, which go to the other sockets listening on the same port, if any.
+  void StopAccepting() {
+#ifndef CURRENT_WINDOWS
+    ::shutdown(socket, SHUT_RDWR);
+#else
+    ::shutdown(socket, SD_BOTH);
+#endif  // CURRENT_WINDOWS
+  }
+
   Connection Accept() {
     CURRENT_BRICKS_NET_LOG("S%05d accept() ...\n", static_cast<SOCKET>(socket));
     sockaddr_in addr_client;
@@ -0,0 +1,189 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// `SocketPoller` waits for any of many sockets to become ready to be read from or written into, via `epoll` on Linux
+// and via `kqueue` on macOS, for one or a few threads to serve many connections, instead of a thread per connection.
+// It is what the event loop of the HTTP server and `HTTPAsyncClient` wait for the sockets with.
+//
+// The sockets are waited for one-shot: once reported ready, a socket is not reported again until waited for anew,
+// so that only one of the threads polling handles it at a time. Closing a socket stops waiting for it.
+//
+// Available where `CURRENT_SOCKET_POLLER` is defined. For a single connection, see `Connection::WaitUntilReadable()`.
+
+#ifndef BRICKS_NET_TCP_POLLER_H
+#define BRICKS_NET_TCP_POLLER_H
+
+#include "../../port.h"
+
+#include <chrono>
+
+#if defined(CURRENT_POSIX)
+#define CURRENT_SOCKET_POLLER
+#define CURRENT_SOCKET_POLLER_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#elif defined(CURRENT_APPLE)
+#define CURRENT_SOCKET_POLLER
+#define CURRENT_SOCKET_POLLER_KQUEUE
+#include <sys/event.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#include "../exceptions.h"
+
+#ifdef CURRENT_SOCKET_POLLER
+
+namespace current {
+namespace net {
+
+class SocketPoller final {
+ public:
+  SocketPoller() {
+#if defined(CURRENT_SOCKET_POLLER_EPOLL)
+    poller_ = ::epoll_create1(0);
+    wake_up_fd_ = ::eventfd(0, EFD_NONBLOCK);
+    if (poller_ < 0 || wake_up_fd_ < 0) {
+      CURRENT_THROW(SocketCreateException());  // LCOV_EXCL_LINE
+    }
+    epoll_event event;
+    event.events = EPOLLIN | EPOLLET;
+    event.data.fd = wake_up_fd_;
+    ::epoll_ctl(poller_, EPOLL_CTL_ADD, wake_up_fd_, &event);
+#else
+    poller_ = ::kqueue();
+    if (poller_ < 0) {
+      CURRENT_THROW(SocketCreateException());  // LCOV_EXCL_LINE
+    }
+    struct kevent event;
+    EV_SET(&event, kWakeUpIdent, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+    ::kevent(poller_, &event, 1, nullptr, 0, nullptr);
+#endif
+  }
+
+  ~SocketPoller() {
+#if defined(CURRENT_SOCKET_POLLER_EPOLL)
+    ::close(wake_up_fd_);
+#endif
+    ::close(poller_);
+  }
+
+  // Reports `fd` once there is data to read from it, or once the peer has closed it. Pass `first_time` as `true`
+  // the first time `fd` is waited for, or waited for again after `StopWaiting()`, as `epoll` tells these apart.
+  void WaitUntilReadable(int fd, bool first_time) { Wait(fd, first_time, false); }
+  // Reports `fd` once there is room to write into it, or once the peer has closed it.
+  void WaitUntilWritable(int fd, bool first_time) { Wait(fd, first_time, true); }
+
+  // Stops waiting for `fd`, for it to no longer be reported even if waited for before, as before reusing it.
+  void StopWaiting(int fd) {
+#if defined(CURRENT_SOCKET_POLLER_EPOLL)
+    ::epoll_ctl(poller_, EPOLL_CTL_DEL, fd, nullptr);
+#else
+    struct kevent events[2];
+    EV_SET(&events[0], fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+    EV_SET(&events[1], fd, EVFILT_WRITE, EV_DELETE, 0, 0, nullptr);
+    ::kevent(poller_, events, 2, nullptr, 0, nullptr);
+#endif
+  }
+
+  // Makes one of the `Poll()`-s in progress, or the next one, return right away.
+  void WakeUp() {
+#if defined(CURRENT_SOCKET_POLLER_EPOLL)
+    const uint64_t one = 1u;
+    static_cast<void>(::write(wake_up_fd_, &one, sizeof(one)));
+#else
+    struct kevent event;
+    EV_SET(&event, kWakeUpIdent, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+    ::kevent(poller_, &event, 1, nullptr, 0, nullptr);
+#endif
+  }
+
+  // Waits for up to `timeout`, or until woken up, and calls `on_ready(fd)` for each of the sockets ready.
+  // Returns the number of the sockets reported.
+  template <typename F>
+  size_t Poll(std::chrono::milliseconds timeout, F&& on_ready) {
+    size_t reported = 0u;
+#if defined(CURRENT_SOCKET_POLLER_EPOLL)
+    epoll_event events[kMaxEventsPerPoll];
+    const int n = ::epoll_wait(poller_, events, kMaxEventsPerPoll, static_cast<int>(timeout.count()));
+    for (int i = 0; i < n; ++i) {
+      if (events[i].data.fd == wake_up_fd_) {
+        uint64_t count;
+        static_cast<void>(::read(wake_up_fd_, &count, sizeof(count)));
+      } else {
+        ++reported;
+        on_ready(events[i].data.fd);
+      }
+    }
+#else
+    struct kevent events[kMaxEventsPerPoll];
+    timespec interval;
+    interval.tv_sec = static_cast<decltype(interval.tv_sec)>(timeout.count() / 1000);
+    interval.tv_nsec = static_cast<decltype(interval.tv_nsec)>((timeout.count() % 1000) * 1000 * 1000);
+    const int n = ::kevent(poller_, nullptr, 0, events, kMaxEventsPerPoll, &interval);
+    for (int i = 0; i < n; ++i) {
+      if (events[i].filter != EVFILT_USER) {
+        ++reported;
+        on_ready(static_cast<int>(events[i].ident));
+      }
+    }
+#endif
+    return reported;
+  }
+
+ private:
+  SocketPoller(const SocketPoller&) = delete;
+  SocketPoller& operator=(const SocketPoller&) = delete;
+
+  constexpr static int kMaxEventsPerPoll = 64;
+
+  void Wait(int fd, bool first_time, bool writable) {
+#if defined(CURRENT_SOCKET_POLLER_EPOLL)
+    epoll_event event;
+    event.events = (writable ? EPOLLOUT : EPOLLIN) | EPOLLRDHUP | EPOLLONESHOT;
+    event.data.fd = fd;
+    ::epoll_ctl(poller_, first_time ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &event);
+#else
+    static_cast<void>(first_time);
+    struct kevent event;
+    EV_SET(&event, fd, writable ? EVFILT_WRITE : EVFILT_READ, EV_ADD | EV_ONESHOT, 0, 0, nullptr);
+    ::kevent(poller_, &event, 1, nullptr, 0, nullptr);
+#endif
+  }
+
+  int poller_ = -1;
+#if defined(CURRENT_SOCKET_POLLER_EPOLL)
+  int wake_up_fd_ = -1;
+#else
+  constexpr static uintptr_t kWakeUpIdent = 0u;
+#endif
+};
+
+}  // namespace net
+}  // namespace current
+
+#endif  // CURRENT_SOCKET_POLLER
+
+#endif  // BRICKS_NET_TCP_POLLER_H
@@ -22,12 +22,14 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 *******************************************************************************/
 
+#include <atomic>
 #include <chrono>
 #include <functional>
 #include <memory>
 #include <thread>
 
 #include "tcp.h"
+#include "poller.h"
 
 #include "../../dflags/dflags.h"
 
@@ -137,6 +139,37 @@ TEST(TCPTest, ReceiveMessageOfTwoParts) {
   ExpectFromSocket("BOOM", server, port_number);
 }
 
+TEST(TCPTest, ReceiveMessageWrittenFromSeveralBuffers) {
+  current::net::ReservedLocalPort port_reservation = ReserveLocalPort();
+  const uint16_t port_number = port_reservation;
+  std::thread server(
+      [](Socket socket) {
+        const std::string suffix = "OM";
+        socket.Accept().BlockingWriteV({"BO", "", suffix}, false);
+      },
+      std::move(port_reservation));
+  ExpectFromSocket("BOOM", server, port_number);
+}
+
+TEST(TCPTest, ReceiveMessageWrittenFromMoreBuffersThanOneSystemCallTakes) {
+  current::net::ReservedLocalPort port_reservation = ReserveLocalPort();
+  const uint16_t port_number = port_reservation;
+  std::string golden;
+  for (size_t i = 0; i < 3000; ++i) {
+    golden += static_cast<char>('a' + i % 26);
+  }
+  std::thread server(
+      [&golden](Socket socket) {
+        std::vector<current::net::WriteBuffer> buffers;
+        for (size_t i = 0; i < golden.length(); ++i) {
+          buffers.emplace_back(&golden[i], 1u);
+        }
+        socket.Accept().BlockingWriteV(&buffers[0], buffers.size(), false);
+      },
+      std::move(port_reservation));
+  ExpectFromSocket(golden, server, port_number);
+}
+
 TEST(TCPTest, ReceiveDelayedMessage) {
   current::net::ReservedLocalPort port_reservation = ReserveLocalPort();
   const uint16_t port_number = port_reservation;
@@ -329,6 +362,211 @@ TEST(TCPTest, WriteExceptionWhileWritingAVeryLongMessage) {
 }
 #endif
 
+#if !defined(CURRENT_WINDOWS) && !defined(CURRENT_APPLE)
+TEST(TCPTest, WriteTimeoutWhenThePeerDoesNotRead) {
+  auto port_reservation = ReserveLocalPort();
+  const uint16_t port_number = port_reservation;
+  std::atomic_bool timed_out(false);
+  std::thread server_thread(
+      [&timed_out](Socket socket) {
+        Connection connection(socket.Accept());
+        connection.SetSendBufferSize(4096u).SetWriteTimeout(milliseconds(50));
+        const std::vector<char> data(1000, '!');
+        try {
+          // The peer never reads, so the OS buffers fill up, and then writes should time out.
+          for (int i = 0; i < 100 * 1000; ++i) {
+            connection.BlockingWrite(data, true);
+          }
+        } catch (const current::net::SocketWriteTimeoutException&) {
+          timed_out = true;
+        }
+      },
+      Socket(std::move(port_reservation)));
+  Connection connection(ClientSocket("localhost", port_number));
+  server_thread.join();
+  EXPECT_TRUE(timed_out);
+}
+#endif
+
+#if !defined(CURRENT_WINDOWS)
+TEST(TCPTest, ReadWithDeadline) {
+  auto port_reservation = ReserveLocalPort();
+  const uint16_t port_number = port_reservation;
+  std::atomic_bool proceed(false);
+  std::thread server_thread(
+      [&proceed](Socket socket) {
+        Connection connection(socket.Accept());
+        connection.BlockingWrite("foo", false);
+        while (!proceed) {
+          std::this_thread::yield();
+        }
+        connection.BlockingWrite("bar", false);
+        sleep_for(milliseconds(10));
+        connection.BlockingWrite("baz", false);
+      },
+      Socket(std::move(port_reservation)));
+  Connection connection(ClientSocket("localhost", port_number));
+  using clock_t = std::chrono::steady_clock;
+  char buffer[7];
+  EXPECT_EQ(3u, connection.ReadWithDeadline(buffer, 6, clock_t::now() + std::chrono::seconds(10)));
+  EXPECT_EQ("foo", std::string(buffer, 3));
+  EXPECT_FALSE(connection.WaitUntilReadable(clock_t::now() + milliseconds(10)));
+  const auto before = clock_t::now();
+  ASSERT_THROW(connection.ReadWithDeadline(buffer, 6, before + milliseconds(20)),
+               current::net::SocketReadTimeoutException);
+  EXPECT_GE(clock_t::now() - before, milliseconds(20));
+  proceed = true;
+  EXPECT_TRUE(connection.WaitUntilReadable(clock_t::time_point::max()));
+  EXPECT_EQ(6u,
+            connection.ReadWithDeadline(
+                buffer, 6, clock_t::now() + std::chrono::seconds(10), Connection::BlockingReadPolicy::FillFullBuffer));
+  EXPECT_EQ("barbaz", std::string(buffer, 6));
+  server_thread.join();
+  ASSERT_THROW(connection.ReadWithDeadline(buffer, 1, clock_t::now() + std::chrono::seconds(10)),
+               current::net::ConnectionResetByPeer);
+}
+
+TEST(TCPTest, WriteWithDeadline) {
+  auto port_reservation = ReserveLocalPort();
+  const uint16_t port_number = port_reservation;
+  std::atomic_bool done(false);
+  std::thread server_thread(
+      [&done](Socket socket) {
+        Connection connection(socket.Accept());
+        while (!done) {
+          std::this_thread::yield();
+        }
+      },
+      Socket(std::move(port_reservation)));
+  Connection connection(ClientSocket("localhost", port_number));
+  using clock_t = std::chrono::steady_clock;
+  EXPECT_TRUE(connection.WaitUntilWritable(clock_t::now() + milliseconds(10)));
+  connection.WriteWithDeadline("Hello", clock_t::now() + std::chrono::seconds(10));
+  // The peer never reads, so the OS buffers fill up, and then the write times out instead of blocking.
+  ASSERT_THROW(connection.WriteWithDeadline(std::string(100 * 1000 * 1000, '!'), clock_t::now() + milliseconds(50)),
+               current::net::SocketWriteTimeoutException);
+  EXPECT_FALSE(connection.WaitUntilWritable(clock_t::now() + milliseconds(10)));
+  done = true;
+  server_thread.join();
+}
+#endif  // !defined(CURRENT_WINDOWS)
+
+#ifdef CURRENT_SOCKET_POLLER
+TEST(TCPTest, SocketPoller) {
+  auto port_reservation = ReserveLocalPort();
+  const uint16_t port_number = port_reservation;
+  std::atomic_bool proceed(false);
+  std::thread server_thread(
+      [&proceed](Socket socket) {
+        Connection connection(socket.Accept());
+        while (!proceed) {
+          std::this_thread::yield();
+        }
+        connection.BlockingWrite("ping", false);
+        char buffer[1];
+        connection.BlockingRead(buffer, 1);
+      },
+      Socket(std::move(port_reservation)));
+  Connection connection(ClientSocket("localhost", port_number));
+  const int fd = static_cast<int>(connection.socket);
+
+  current::net::SocketPoller poller;
+  vector<int> ready;
+  const auto record = [&ready](int ready_fd) { ready.push_back(ready_fd); };
+
+  poller.WaitUntilReadable(fd, true);
+  EXPECT_EQ(0u, poller.Poll(milliseconds(10), record));
+  EXPECT_TRUE(ready.empty());
+
+  // Woken up, the poll returns right away, with nothing to report.
+  poller.WakeUp();
+  const auto before = std::chrono::steady_clock::now();
+  EXPECT_EQ(0u, poller.Poll(std::chrono::seconds(10), record));
+  EXPECT_LT(std::chrono::steady_clock::now() - before, std::chrono::seconds(5));
+
+  proceed = true;
+  EXPECT_EQ(1u, poller.Poll(std::chrono::seconds(10), record));
+  ASSERT_EQ(1u, ready.size());
+  EXPECT_EQ(fd, ready[0]);
+
+  // One-shot: not reported again until waited for anew.
+  EXPECT_EQ(0u, poller.Poll(milliseconds(10), record));
+  poller.WaitUntilReadable(fd, false);
+  EXPECT_EQ(1u, poller.Poll(std::chrono::seconds(10), record));
+  char buffer[4];
+  connection.BlockingRead(buffer, 4, Connection::FillFullBuffer);
+  EXPECT_EQ("ping", std::string(buffer, 4));
+
+  poller.WaitUntilWritable(fd, false);
+  EXPECT_EQ(1u, poller.Poll(std::chrono::seconds(10), record));
+  EXPECT_EQ(3u, ready.size());
+
+  poller.StopWaiting(fd);
+  connection.BlockingWrite("!", false);
+  server_thread.join();
+}
+#endif  // CURRENT_SOCKET_POLLER
+
+#if defined(CURRENT_POSIX) && !defined(CURRENT_APPLE)
+TEST(TCPTest, BindTwoSocketsToTheSamePortWithReusePort) {
+  auto port_reservation = ReserveLocalPort();
+  const uint16_t port_number = port_reservation;
+  Socket s1(std::move(port_reservation));
+  s1.EnableReusePort();
+  Socket s2(current::net::BarePort(port_number),
+            current::net::kDefaultNagleAlgorithmPolicy,
+            current::net::kMaxServerQueuedConnections,
+            current::net::ReusePort::Yes);
+  // Once the first socket stops accepting, all the connections go to the second one.
+  s1.StopAccepting();
+  std::thread server([&s2]() { s2.Accept().BlockingWrite("BOOM", false); });
+  ExpectFromSocket("BOOM", server, port_number);
+}
+#endif  // defined(CURRENT_POSIX) && !defined(CURRENT_APPLE)
+
+#if defined(CURRENT_POSIX) && !defined(CURRENT_APPLE)
+TEST(TCPTest, SocketOptions) {
+  auto port_reservation = ReserveLocalPort();
+  const uint16_t port_number = port_reservation;
+  Socket socket(std::move(port_reservation));
+
+  current::net::SocketOptions options;
+  options.send_buffer_size = 64 * 1024;
+  options.receive_buffer_size = 128 * 1024;
+  options.nagle_algorithm = current::net::NagleAlgorithm::Disable;
+  options.quick_ack = true;
+  options.defer_accept = std::chrono::seconds(1);
+  options.fast_open_queue_length = 16;
+  options.max_queued_connections = current::net::MaxServerQueuedConnectionsValue(64);
+  socket.SetListeningOptions(options);
+  EXPECT_LT(0, socket.GetIntegerOption(IPPROTO_TCP, TCP_FASTOPEN));
+  EXPECT_LT(0, socket.GetIntegerOption(IPPROTO_TCP, TCP_DEFER_ACCEPT));
+
+  std::thread server_thread([&socket, &options]() {
+    Connection connection(socket.Accept());
+    connection.SetConnectionOptions(options);
+    // Linux reserves twice the buffer size requested, for the bookkeeping.
+    EXPECT_LE(64 * 1024, connection.GetIntegerOption(SOL_SOCKET, SO_SNDBUF));
+    EXPECT_LE(128 * 1024, connection.GetIntegerOption(SOL_SOCKET, SO_RCVBUF));
+    EXPECT_EQ(1, connection.GetIntegerOption(IPPROTO_TCP, TCP_NODELAY));
+    connection.BlockingWrite("OK", false);
+  });
+  Connection connection(ClientSocket("localhost", port_number));
+  // With `TCP_DEFER_ACCEPT`, the connection is only accepted once some data has arrived.
+  connection.BlockingWrite("?", false);
+  char response[2];
+  ASSERT_EQ(2u, connection.BlockingRead(response, 2u, Connection::FillFullBuffer));
+  EXPECT_EQ("OK", std::string(response, 2u));
+  server_thread.join();
+
+  // The options not set are left as they are.
+  current::net::SocketOptions keep_the_rest;
+  keep_the_rest.nagle_algorithm = current::net::NagleAlgorithm::Keep;
+  connection.SetConnectionOptions(keep_the_rest);
+  EXPECT_EQ(0, connection.GetIntegerOption(IPPROTO_TCP, TCP_NODELAY));
+}
+#endif  // defined(CURRENT_POSIX) && !defined(CURRENT_APPLE)
+
 TEST(TCPTest, PickLocalPort) {
   uint16_t i1;
   uint16_t i2;
@@ -42,6 +42,9 @@ SOFTWARE.
 // `ChunkDB` is a storage of `UniqueChunk`-s, that renders equal `Chunk`-s equal -- since the order
 // is indeed strict and total, despite very likely being not fair... err, not lexicographical.
 //
+// `InterningChunkDB` is the `ChunkDB` that owns the strings, copying them into its append-only arena, and that
+// can be used from many threads at once. Its `UniqueChunk`-s stay valid for as long as it lives.
+//
 // Both `Chunk` and `UniqueChunk` are naturally unsafe and require memory for their storage to stay allocated,
 // because every decent architect knows well what happens if `free()` is invoked a bit too prematurely in the
 // evolutionary process of a lifetime of an object.
@@ -61,10 +64,17 @@ SOFTWARE.
 #include "../port.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace current {
 namespace strings {
@@ -240,6 +250,107 @@ class ChunkDB {
   std::unordered_map<Chunk, const UniqueChunk*, Chunk::HashFunction, Chunk::Pride> map;
 };
 
+// Owns the strings it interns. Thread-safe: the strings are spread across the shards by their hashes, each with
+// its own reader-writer lock and its own arena, so the lookups of the strings already interned only share a lock,
+// and the insertions of the new ones into different shards do not contend.
+class InterningChunkDB final {
+ public:
+  constexpr static size_t kShards = 16u;
+
+  InterningChunkDB() = default;
+  InterningChunkDB(const InterningChunkDB&) = delete;
+  InterningChunkDB& operator=(const InterningChunkDB&) = delete;
+
+  // Returns the `UniqueChunk` of the string, copying it into the arena if it is new. Any `chunk` would do.
+  UniqueChunk operator[](const Chunk& chunk) { return Intern(chunk); }
+
+  UniqueChunk Intern(const Chunk& chunk) {
+    const size_t hash = Hash()(chunk);
+    Shard& shard = shards_[hash % kShards];
+    {
+      std::shared_lock<std::shared_mutex> lock(shard.mutex);
+      const auto cit = shard.chunks.find(chunk);
+      if (cit != shard.chunks.end()) {
+        return UniqueChunk(*cit);
+      }
+    }
+    std::lock_guard<std::shared_mutex> lock(shard.mutex);
+    const auto cit = shard.chunks.find(chunk);
+    if (cit != shard.chunks.end()) {
+      return UniqueChunk(*cit);
+    }
+    const Chunk owned(shard.arena.Copy(chunk.c_str(), chunk.length()), chunk.length());
+    shard.chunks.insert(owned);
+    ++size_;
+    return UniqueChunk(owned);
+  }
+
+  // `Find()`, unlike `Intern()`, does not insert the chunk if it does not exist.
+  bool Find(const Chunk& key, UniqueChunk& response) const {
+    const Shard& shard = shards_[Hash()(key) % kShards];
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    const auto cit = shard.chunks.find(key);
+    if (cit != shard.chunks.end()) {
+      response = *cit;
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  // The number of distinct strings interned.
+  size_t Size() const { return size_.load(); }
+
+ private:
+  // `Chunk::HashFunction` is kept as is for `ChunkDB`, this one is many times faster.
+  struct Hash final {
+    size_t operator()(const Chunk& chunk) const {
+      return std::hash<std::string_view>()(std::string_view(chunk.c_str(), chunk.length()));
+    }
+  };
+
+  // Append-only, with no per-string allocations; stores each string along with its terminating '\0'.
+  class Arena final {
+   public:
+    constexpr static size_t kBlockSize = 64u * 1024u;
+
+    const char* Copy(const char* s, size_t n) {
+      char* result;
+      if (n + 1u > kBlockSize / 4u) {
+        // The long strings get the blocks of their own, not to waste the rest of the current block.
+        blocks_.push_back(std::make_unique<char[]>(n + 1u));
+        result = blocks_.back().get();
+      } else {
+        if (n + 1u > left_) {
+          blocks_.push_back(std::make_unique<char[]>(kBlockSize));
+          current_ = blocks_.back().get();
+          left_ = kBlockSize;
+        }
+        result = current_;
+        current_ += n + 1u;
+        left_ -= n + 1u;
+      }
+      ::memcpy(result, s, n);
+      result[n] = '\0';
+      return result;
+    }
+
+   private:
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char* current_ = nullptr;
+    size_t left_ = 0u;
+  };
+
+  struct alignas(64) Shard final {
+    mutable std::shared_mutex mutex;
+    std::unordered_set<Chunk, Hash, Chunk::Pride> chunks;
+    Arena arena;
+  };
+
+  Shard shards_[kShards];
+  std::atomic<size_t> size_{0u};
+};
+
 }  // namespace strings
 }  // namespace current
 
@@ -26,6 +26,7 @@ SOFTWARE.
 #define BRICKS_STRINGS_DISTANCE_H
 
 #include <algorithm>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -114,6 +115,111 @@ inline size_t FastEditDistance(const std::string& a, const std::string& b, size_
   return impl.Compute();
 }
 
+// The Levenshtein distance from the "query" string to many others, computed bit-parallel, 64 characters of the query
+// at a time, per Myers (1999) as restated by Hyyro (2003), with the blocks of 64 for the longer queries.
+// The bit masks of the characters of the query are built once, so that comparing it to each candidate takes
+// O(ceil(query.length / 64) * candidate.length) word operations.
+class EditDistanceQuery final {
+ public:
+  explicit EditDistanceQuery(const std::string& query)
+      : length_(query.length()), words_((length_ + 63u) / 64u), masks_(256u * words_, 0u) {
+    for (size_t i = 0; i < length_; ++i) {
+      masks_[static_cast<unsigned char>(query[i]) * words_ + i / 64u] |= uint64_t(1u) << (i % 64u);
+    }
+  }
+
+  size_t QueryLength() const { return length_; }
+
+  size_t DistanceTo(const std::string& candidate) const {
+    if (!length_) {
+      return candidate.length();
+    } else if (words_ == 1u) {
+      return SingleWordDistanceTo(candidate);
+    } else {
+      return BlockedDistanceTo(candidate);
+    }
+  }
+
+  std::vector<size_t> DistancesTo(const std::vector<std::string>& candidates) const {
+    std::vector<size_t> result;
+    result.reserve(candidates.size());
+    for (const std::string& candidate : candidates) {
+      result.push_back(DistanceTo(candidate));
+    }
+    return result;
+  }
+
+ private:
+  size_t SingleWordDistanceTo(const std::string& candidate) const {
+    const uint64_t last = uint64_t(1u) << (length_ - 1u);
+    uint64_t vp = ~uint64_t(0u);
+    uint64_t vn = 0u;
+    size_t distance = length_;
+    for (char c : candidate) {
+      const uint64_t eq = masks_[static_cast<unsigned char>(c)];
+      const uint64_t d0 = (((eq & vp) + vp) ^ vp) | eq | vn;
+      uint64_t hp = vn | ~(d0 | vp);
+      uint64_t hn = d0 & vp;
+      distance += (hp & last) ? 1u : 0u;
+      distance -= (hn & last) ? 1u : 0u;
+      // The top row of the matrix is `0, 1, 2, ...`, hence the `1` shifted in.
+      hp = (hp << 1u) | 1u;
+      hn <<= 1u;
+      vp = hn | ~(d0 | hp);
+      vn = hp & d0;
+    }
+    return distance;
+  }
+
+  // The same, with the horizontal deltas carried from each block of 64 rows to the next one.
+  size_t BlockedDistanceTo(const std::string& candidate) const {
+    const uint64_t last = uint64_t(1u) << ((length_ - 1u) % 64u);
+    std::vector<uint64_t> vp(words_, ~uint64_t(0u));
+    std::vector<uint64_t> vn(words_, 0u);
+    size_t distance = length_;
+    for (char c : candidate) {
+      const uint64_t* eqs = &masks_[static_cast<unsigned char>(c) * words_];
+      uint64_t hp_carry = 1u;
+      uint64_t hn_carry = 0u;
+      for (size_t w = 0; w < words_; ++w) {
+        const uint64_t x = eqs[w] | hn_carry;
+        const uint64_t d0 = (((x & vp[w]) + vp[w]) ^ vp[w]) | x | vn[w];
+        uint64_t hp = vn[w] | ~(d0 | vp[w]);
+        uint64_t hn = d0 & vp[w];
+        const uint64_t hp_carry_in = hp_carry;
+        const uint64_t hn_carry_in = hn_carry;
+        if (w + 1u < words_) {
+          hp_carry = hp >> 63u;
+          hn_carry = hn >> 63u;
+        } else {
+          distance += (hp & last) ? 1u : 0u;
+          distance -= (hn & last) ? 1u : 0u;
+        }
+        hp = (hp << 1u) | hp_carry_in;
+        hn = (hn << 1u) | hn_carry_in;
+        vp[w] = hn | ~(d0 | hp);
+        vn[w] = hp & d0;
+      }
+    }
+    return distance;
+  }
+
+  const size_t length_;
+  const size_t words_;
+  std::vector<uint64_t> masks_;  // For each of the 256 characters, `words_` bit masks of where it is in the query.
+};
+
+// Computes the Levenshtein distance between two strings, same as `SlowEditDistance()`, bit-parallel.
+// Runs with the complexity of O(ceil(min(A.length, B.length) / 64) * max(A.length, B.length)).
+inline size_t EditDistance(const std::string& a, const std::string& b) {
+  return (a.length() <= b.length()) ? EditDistanceQuery(a).DistanceTo(b) : EditDistanceQuery(b).DistanceTo(a);
+}
+
+// Computes the Levenshtein distances from `query` to each of the `candidates`.
+inline std::vector<size_t> EditDistances(const std::string& query, const std::vector<std::string>& candidates) {
+  return EditDistanceQuery(query).DistancesTo(candidates);
+}
+
 }  // namespace strings
 }  // namespace current
 
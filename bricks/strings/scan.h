@@ -0,0 +1,189 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// Finds the first of the given bytes in a buffer, sixteen or thirty-two bytes at a time: with SSE2, which every
+// x86-64 has, with AVX2 if the code is built with `-mavx2`, with NEON on ARM, and byte by byte otherwise.
+// The building block of `Split()`, for the separators which are sets of characters, and of the JSON strings parsing.
+
+#ifndef BRICKS_STRINGS_SCAN_H
+#define BRICKS_STRINGS_SCAN_H
+
+#include "../../port.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if !defined(CURRENT_WINDOWS) && (defined(__SSE2__) || defined(__AVX2__))
+#include <immintrin.h>
+#define CURRENT_STRINGS_SCAN_SSE2
+#ifdef __AVX2__
+#define CURRENT_STRINGS_SCAN_AVX2
+#endif  // __AVX2__
+#elif !defined(CURRENT_WINDOWS) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CURRENT_STRINGS_SCAN_NEON
+#endif
+
+namespace current {
+namespace strings {
+namespace impl {
+
+// The C locale whitespace, as `::isspace()` sees it.
+constexpr char kWhitespaceCharacters[] = " \t\n\v\f\r";
+constexpr size_t kWhitespaceCharactersCount = sizeof(kWhitespaceCharacters) - 1u;
+
+// Returns the pointer to the first byte of `[p, end)` equal to one of `set[0 .. set_size)`, or `end` if none is.
+inline const char* FindAnyOf(const char* p, const char* end, const char* set, size_t set_size) {
+  if (set_size == 1u) {
+    const void* found = ::memchr(p, set[0], static_cast<size_t>(end - p));
+    return found ? static_cast<const char*>(found) : end;
+  }
+#ifdef CURRENT_STRINGS_SCAN_AVX2
+  while (end - p >= 32) {
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i hits = _mm256_setzero_si256();
+    for (size_t k = 0; k < set_size; ++k) {
+      hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, _mm256_set1_epi8(set[k])));
+    }
+    const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+    if (mask) {
+      return p + __builtin_ctz(mask);
+    }
+    p += 32;
+  }
+#endif  // CURRENT_STRINGS_SCAN_AVX2
+#if defined(CURRENT_STRINGS_SCAN_SSE2)
+  while (end - p >= 16) {
+    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i hits = _mm_setzero_si128();
+    for (size_t k = 0; k < set_size; ++k) {
+      hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, _mm_set1_epi8(set[k])));
+    }
+    const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+    if (mask) {
+      return p + __builtin_ctz(mask);
+    }
+    p += 16;
+  }
+#elif defined(CURRENT_STRINGS_SCAN_NEON)
+  while (end - p >= 16) {
+    const uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+    uint8x16_t hits = vdupq_n_u8(0u);
+    for (size_t k = 0; k < set_size; ++k) {
+      hits = vorrq_u8(hits, vceqq_u8(block, vdupq_n_u8(static_cast<uint8_t>(set[k]))));
+    }
+    // Four bits per byte, as NEON has no `movemask`.
+    const uint64_t mask =
+        vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)), 0);
+    if (mask) {
+      return p + (__builtin_ctzll(mask) >> 2);
+    }
+    p += 16;
+  }
+#endif
+  for (; p != end; ++p) {
+    for (size_t k = 0; k < set_size; ++k) {
+      if (*p == set[k]) {
+        return p;
+      }
+    }
+  }
+  return end;
+}
+
+// Returns the pointer to the first byte at or after `p` which ends the run of a JSON string that needs no unescaping:
+// the quote, the backslash, or a control character, the terminating zero included, as the string is zero-terminated.
+// The vectorized loads are aligned, so that reading past the terminating zero never crosses into the next page.
+inline const char* FindJSONStringSpecial(const char* p) {
+  const auto is_special = [](char c) { return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20; };
+#if defined(CURRENT_STRINGS_SCAN_SSE2) || defined(CURRENT_STRINGS_SCAN_NEON)
+#ifdef CURRENT_STRINGS_SCAN_AVX2
+  constexpr uintptr_t kAlignment = 32u;
+#else
+  constexpr uintptr_t kAlignment = 16u;
+#endif
+  for (; reinterpret_cast<uintptr_t>(p) % kAlignment; ++p) {
+    if (is_special(*p)) {
+      return p;
+    }
+  }
+#endif
+#if defined(CURRENT_STRINGS_SCAN_AVX2)
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  const __m256i control = _mm256_set1_epi8(0x1F);
+  for (;; p += 32) {
+    const __m256i block = _mm256_load_si256(reinterpret_cast<const __m256i*>(p));
+    // The byte is a control character if and only if `max(byte, 0x1F)` is `0x1F`.
+    const __m256i hits = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(block, quote), _mm256_cmpeq_epi8(block, backslash)),
+        _mm256_cmpeq_epi8(_mm256_max_epu8(block, control), control));
+    const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+    if (mask) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+#elif defined(CURRENT_STRINGS_SCAN_SSE2)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1F);
+  for (;; p += 16) {
+    const __m128i block = _mm_load_si128(reinterpret_cast<const __m128i*>(p));
+    // The byte is a control character if and only if `max(byte, 0x1F)` is `0x1F`.
+    const __m128i hits =
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)),
+                     _mm_cmpeq_epi8(_mm_max_epu8(block, control), control));
+    const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+    if (mask) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+#elif defined(CURRENT_STRINGS_SCAN_NEON)
+  const uint8x16_t quote = vdupq_n_u8('"');
+  const uint8x16_t backslash = vdupq_n_u8('\\');
+  const uint8x16_t space = vdupq_n_u8(0x20);
+  for (;; p += 16) {
+    const uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+    const uint8x16_t hits =
+        vorrq_u8(vorrq_u8(vceqq_u8(block, quote), vceqq_u8(block, backslash)), vcltq_u8(block, space));
+    const uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)), 0);
+    if (mask) {
+      return p + (__builtin_ctzll(mask) >> 2);
+    }
+  }
+#else
+  while (!is_special(*p)) {
+    ++p;
+  }
+  return p;
+#endif
+}
+
+}  // namespace impl
+}  // namespace strings
+}  // namespace current
+
+#endif  // BRICKS_STRINGS_SCAN_H
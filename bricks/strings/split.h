@@ -29,10 +29,13 @@ SOFTWARE.
 #include <cctype>
 #include <cstring>
 #include <string>
+#include <string_view>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "chunk.h"
+#include "scan.h"
 
 #include "../exception.h"
 #include "../template/weed.h"
@@ -126,6 +129,76 @@ struct DefaultSeparator<ByLines> {
   static inline ByLines value() { return ByLines::Use0Aor0D; }
 };
 
+// Finds the next separator in `[p, end)`, or returns `end`. The separators which are sets of characters are found
+// with `FindAnyOf()`, many bytes at a time; the user-provided functions are called byte by byte.
+template <typename T>
+struct SeparatorFinder {
+  template <typename SEPARATOR>
+  static const char* Find(const char* p, const char* end, SEPARATOR&& separator) {
+    while (p != end && !Match(*p, std::forward<SEPARATOR>(separator))) {
+      ++p;
+    }
+    return p;
+  }
+};
+
+template <>
+struct SeparatorFinder<char> {
+  static const char* Find(const char* p, const char* end, char c) { return FindAnyOf(p, end, &c, 1u); }
+};
+
+template <>
+struct SeparatorFinder<ByWhitespace> {
+  static const char* Find(const char* p, const char* end, ByWhitespace) {
+    return FindAnyOf(p, end, kWhitespaceCharacters, kWhitespaceCharactersCount);
+  }
+};
+
+template <>
+struct SeparatorFinder<ByLines> {
+  static const char* Find(const char* p, const char* end, ByLines) { return FindAnyOf(p, end, "\n\r", 2u); }
+};
+
+template <>
+struct SeparatorFinder<std::string> {
+  static const char* Find(const char* p, const char* end, const std::string& s) {
+    return s.empty() ? end : FindAnyOf(p, end, s.data(), s.length());
+  }
+};
+
+// As with `Match()`, the trailing '\0' of the string literal is a separator too.
+template <size_t N>
+struct SeparatorFinder<char[N]> {
+  static const char* Find(const char* p, const char* end, const char s[N]) { return FindAnyOf(p, end, s, N); }
+};
+
+template <typename SEPARATOR>
+inline const char* FindSeparator(const char* p, const char* end, SEPARATOR&& separator) {
+  return SeparatorFinder<std::remove_cv_t<std::remove_reference_t<SEPARATOR>>>::Find(
+      p, end, std::forward<SEPARATOR>(separator));
+}
+
+// Calls `emit(begin, end)` for each field of `[begin, end)`, per `empty_fields_strategy`. Returns their number.
+template <typename SEPARATOR, typename EMIT>
+inline size_t SplitRange(const char* begin,
+                         const char* end,
+                         SEPARATOR&& separator,
+                         EMIT&& emit,
+                         EmptyFields empty_fields_strategy) {
+  size_t n = 0;
+  while (true) {
+    const char* field_end = FindSeparator(begin, end, std::forward<SEPARATOR>(separator));
+    if (empty_fields_strategy == EmptyFields::Keep || field_end != begin) {
+      ++n;
+      emit(begin, field_end);
+    }
+    if (field_end == end) {
+      return n;
+    }
+    begin = field_end + 1;
+  }
+}
+
 }  // namespace impl
 
 template <typename SEPARATOR, typename PROCESSOR>
@@ -134,23 +207,12 @@ inline std::enable_if_t<!std::is_same_v<PROCESSOR, EmptyFields>, size_t> Split(
     SEPARATOR&& separator,
     PROCESSOR&& processor,
     EmptyFields empty_fields_strategy = EmptyFields::Skip) {
-  size_t i = 0;
-  size_t j = 0;
-  size_t n = 0;
-  const auto emit = [&]() {
-    if (empty_fields_strategy == EmptyFields::Keep || i != j) {
-      ++n;
-      processor(s.substr(j, i - j));
-    }
-  };
-  for (i = 0; i < s.size(); ++i) {
-    if (impl::Match(s[i], std::forward<SEPARATOR>(separator))) {
-      emit();
-      j = i + 1;
-    }
-  }
-  emit();
-  return n;
+  return impl::SplitRange(
+      s.data(),
+      s.data() + s.length(),
+      std::forward<SEPARATOR>(separator),
+      [&processor](const char* begin, const char* end) { processor(std::string(begin, end)); },
+      empty_fields_strategy);
 }
 
 // A performant version accepting a mutable string, modifying it in-place, and emitting `Chunk`-s.
@@ -162,26 +224,18 @@ inline size_t Split(char* s,
                     SEPARATOR&& separator,
                     PROCESSOR&& processor,
                     EmptyFields empty_fields_strategy = EmptyFields::Skip) {
-  size_t i = 0;
-  size_t j = 0;
-  size_t n = 0;
-  const auto emit = [&]() {
-    if (empty_fields_strategy == EmptyFields::Keep || i != j) {
-      ++n;
-      const auto save = s[i];
-      s[i] = '\0';
-      processor(Chunk(&s[j], i - j));
-      s[i] = save;
-    }
-  };
-  for (i = 0; i < length; ++i) {
-    if (impl::Match(s[i], std::forward<SEPARATOR>(separator))) {
-      emit();
-      j = i + 1;
-    }
-  }
-  emit();
-  return n;
+  return impl::SplitRange(
+      s,
+      s + length,
+      std::forward<SEPARATOR>(separator),
+      [&processor](const char* begin, const char* end) {
+        char* const mutable_end = const_cast<char*>(end);
+        const auto save = *mutable_end;
+        *mutable_end = '\0';
+        processor(Chunk(begin, end - begin));
+        *mutable_end = save;
+      },
+      empty_fields_strategy);
 }
 
 // `Split(std::string&, ...)` maps to `Split(char*, size_t, ...)`.
@@ -299,6 +353,67 @@ Split(STRING&& s,
   return result;
 }
 
+// The versions emitting `std::string_view`-s into the input, which must outlive them, and allocating nothing.
+template <typename SEPARATOR, typename PROCESSOR>
+inline std::enable_if_t<!std::is_same_v<PROCESSOR, EmptyFields>, size_t> SplitIntoViews(
+    std::string_view s,
+    SEPARATOR&& separator,
+    PROCESSOR&& processor,
+    EmptyFields empty_fields_strategy = EmptyFields::Skip) {
+  return impl::SplitRange(
+      s.data(),
+      s.data() + s.length(),
+      std::forward<SEPARATOR>(separator),
+      [&processor](const char* begin, const char* end) {
+        processor(std::string_view(begin, static_cast<size_t>(end - begin)));
+      },
+      empty_fields_strategy);
+}
+
+template <typename SEPARATOR>
+inline std::enable_if_t<impl::IsValidSeparator<SEPARATOR>::value && !std::is_same_v<SEPARATOR, EmptyFields>,
+                        std::vector<std::string_view>>
+SplitIntoViews(std::string_view s,
+               SEPARATOR&& separator = impl::DefaultSeparator<SEPARATOR>::value(),
+               EmptyFields empty_fields_strategy = EmptyFields::Skip) {
+  std::vector<std::string_view> result;
+  SplitIntoViews(
+      s,
+      std::forward<SEPARATOR>(separator),
+      [&result](std::string_view field) { result.push_back(field); },
+      empty_fields_strategy);
+  return result;
+}
+
+// Calls `processor(key, value)` for each key-value pair, as `std::string_view`-s into the input.
+template <typename KEY_VALUE_SEPARATOR, typename FIELDS_SEPARATOR, typename PROCESSOR>
+inline std::enable_if_t<!std::is_same_v<std::decay_t<PROCESSOR>, KeyValueParsing>> SplitIntoKeyValueViews(
+    std::string_view s,
+    KEY_VALUE_SEPARATOR&& key_value_separator,
+    FIELDS_SEPARATOR&& fields_separator,
+    PROCESSOR&& processor,
+    KeyValueParsing throw_mode = KeyValueParsing::Silent) {
+  SplitIntoViews(s, std::forward<FIELDS_SEPARATOR>(fields_separator), [&](std::string_view key_and_value) {
+    std::string_view parts[2];
+    const size_t count = SplitIntoViews(key_and_value, key_value_separator, [&parts](std::string_view part) {
+      if (parts[0].data() == nullptr) {
+        parts[0] = part;
+      } else if (parts[1].data() == nullptr) {
+        parts[1] = part;
+      }
+    });
+    if (count == 2u) {
+      processor(parts[0], parts[1]);
+    } else if (throw_mode == KeyValueParsing::Throw) {
+      if (count > 2u) {
+        CURRENT_THROW(KeyValueMultipleValuesException());
+      } else {
+        CURRENT_THROW(KeyValueNoValueException());
+      }
+    }
+  });
+}
+
 template <typename KEY_VALUE_SEPARATOR, typename FIELDS_SEPARATOR, typename STRING>
 inline std::vector<std::pair<std::string, std::string>> SplitIntoKeyValuePairs(
     STRING&& s,
@@ -306,23 +421,14 @@ inline std::vector<std::pair<std::string, std::string>> SplitIntoKeyValuePairs(
     FIELDS_SEPARATOR&& fields_separator = impl::DefaultSeparator<FIELDS_SEPARATOR>::value(),
     KeyValueParsing throw_mode = KeyValueParsing::Silent) {
   std::vector<std::pair<std::string, std::string>> result;
-  Split(std::forward<STRING>(s),
-        std::forward<FIELDS_SEPARATOR>(fields_separator),
-        [&result, &key_value_separator, &throw_mode](std::string&& key_and_value_as_one_string) {
-          const std::vector<std::string> key_and_value =
-              Split(key_and_value_as_one_string, std::forward<KEY_VALUE_SEPARATOR>(key_value_separator));
-          if (key_and_value.size() >= 2) {
-            if (key_and_value.size() == 2) {
-              result.emplace_back(key_and_value[0], key_and_value[1]);
-            } else if (throw_mode == KeyValueParsing::Throw) {
-              CURRENT_THROW(KeyValueMultipleValuesException());
-            }
-          } else {
-            if (throw_mode == KeyValueParsing::Throw) {
-              CURRENT_THROW(KeyValueNoValueException());
-            }
-          }
-        });
+  const auto emit = [&result](std::string_view key, std::string_view value) { result.emplace_back(key, value); };
+  if constexpr (std::is_convertible_v<STRING, std::string_view>) {
+    SplitIntoKeyValueViews(s, key_value_separator, std::forward<FIELDS_SEPARATOR>(fields_separator), emit, throw_mode);
+  } else {
+    const std::string string(std::forward<STRING>(s));
+    SplitIntoKeyValueViews(
+        string, key_value_separator, std::forward<FIELDS_SEPARATOR>(fields_separator), emit, throw_mode);
+  }
   return result;
 }
 
@@ -24,8 +24,12 @@ SOFTWARE.
 
 #include <chrono>
 #include <cmath>
+#include <functional>
+#include <limits>
+#include <random>
 #include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "strings.h"
@@ -43,6 +47,8 @@ using current::strings::EmptyFields;
 using current::strings::EscapeForCPlusPlus;
 using current::strings::EscapeForMarkdown;
 using current::strings::ExceptionFriendlyStatefulGroupByLines;
+using current::strings::EditDistance;
+using current::strings::EditDistances;
 using current::strings::FastEditDistance;
 using current::strings::FixedSizeSerializer;
 using current::strings::is_string_type;
@@ -199,13 +205,43 @@ TEST(Util, FromStringForSingleBytesThatSelfIdentifyAsNumbers) {
   EXPECT_EQ(5, current::FromString<uint16_t>("00005"));
 }
 
+TEST(Util, FromStringParsesLikeTheStreamsDid) {
+  EXPECT_EQ(42, current::FromString<int>("  42"));
+  EXPECT_EQ(42, current::FromString<int>("+42"));
+  EXPECT_EQ(-42, current::FromString<int>("-42 and more"));
+  EXPECT_EQ(static_cast<uint32_t>(-1), current::FromString<uint32_t>("-1"));
+  EXPECT_EQ(0, current::FromString<int16_t>("100000"));
+  EXPECT_EQ(0u, current::FromString<uint64_t>("100000000000000000000"));
+  EXPECT_EQ(18446744073709551615ull, current::FromString<uint64_t>("18446744073709551615"));
+  EXPECT_EQ(-9223372036854775807ll - 1, current::FromString<int64_t>("-9223372036854775808"));
+  EXPECT_EQ(44, current::FromString<int8_t>("300"));
+  EXPECT_EQ(1.5e-7, current::FromString<double>(" 1.5e-7"));
+  EXPECT_EQ(0.5f, current::FromString<float>(".5"));
+  EXPECT_EQ('x', current::FromString<char>("x"));
+  EXPECT_EQ(42, current::FromString<int>(current::strings::Chunk("42", 2)));
+}
+
+TEST(ToString, NumbersRoundTrip) {
+  EXPECT_EQ("-9223372036854775808", current::ToString(std::numeric_limits<int64_t>::min()));
+  EXPECT_EQ("18446744073709551615", current::ToString(std::numeric_limits<uint64_t>::max()));
+  EXPECT_EQ("-5", current::ToString(static_cast<int8_t>(-5)));
+  EXPECT_EQ("200", current::ToString(static_cast<uint8_t>(200)));
+  EXPECT_EQ("0.1", current::ToString(0.1));
+  EXPECT_EQ("0.1", current::ToString(0.1f));
+  EXPECT_EQ("1e+100", current::ToString(1e100));
+  EXPECT_EQ("123456", current::ToString(123456.0));
+  for (double x : {1.0 / 3, 2.0 / 3, 1e-300, 123456.789, -0.000123, std::numeric_limits<double>::max()}) {
+    EXPECT_EQ(x, current::FromString<double>(current::ToString(x))) << current::ToString(x);
+  }
+}
+
 TEST(ToString, SmokeTest) {
   EXPECT_EQ("foo", current::ToString("foo"));
   EXPECT_EQ("bar", current::ToString(std::string("bar")));
   EXPECT_EQ("one two", current::ToString("one two"));
   EXPECT_EQ("three four", current::ToString(std::string("three four")));
   EXPECT_EQ("42", current::ToString(42));
-  EXPECT_EQ("0.500000", current::ToString(0.5));
+  EXPECT_EQ("0.5", current::ToString(0.5));
   EXPECT_EQ("c", current::ToString('c'));
   EXPECT_EQ("true", current::ToString(true));
   EXPECT_EQ("false", current::ToString(false));
@@ -236,7 +272,7 @@ TEST(JoinAndSplit, Join) {
   EXPECT_EQ("a,b,b,c", Join(std::multiset<std::string>({"a", "b", "c", "b"}), ','));
 
   EXPECT_EQ("x->y->z", Join(std::set<char>({'x', 'z', 'y'}), "->"));
-  EXPECT_EQ("0.500000<0.750000<0.875000<1.000000", Join(std::multiset<double>({1, 0.5, 0.75, 0.875}), '<'));
+  EXPECT_EQ("0.5<0.75<0.875<1", Join(std::multiset<double>({1, 0.5, 0.75, 0.875}), '<'));
 
   EXPECT_EQ("one,two,three", Join(std::vector<const char*>({"one", "two", "three"}), ','));
 }
@@ -308,6 +344,63 @@ TEST(JoinAndSplit, FunctionalSplit) {
   }
 }
 
+TEST(JoinAndSplit, SplitLongStrings) {
+  // Longer than the blocks scanned at once, with the separators at every position within them.
+  std::string s;
+  for (int i = 0; i < 300; ++i) {
+    s += std::string(static_cast<size_t>(i % 37), 'a' + static_cast<char>(i % 26)) + ",\t\n;"[i % 4];
+  }
+  const auto reference = [&s](std::function<bool(char)> is_separator) {
+    std::vector<std::string> result(1u);
+    for (char c : s) {
+      if (is_separator(c)) {
+        result.emplace_back();
+      } else {
+        result.back() += c;
+      }
+    }
+    return result;
+  };
+  const auto by_comma = reference([](char c) { return c == ','; });
+  const auto by_comma_or_semicolon = reference([](char c) { return c == ',' || c == ';'; });
+  const auto by_whitespace = reference([](char c) { return c == '\t' || c == '\n'; });
+  const auto by_lines = reference([](char c) { return c == '\n'; });
+  const auto by_non_alnum = reference([](char c) { return !::isalnum(c); });
+  EXPECT_EQ(by_comma, Split(s, ',', EmptyFields::Keep));
+  EXPECT_EQ(by_comma_or_semicolon, Split(s, ",;", EmptyFields::Keep));
+  EXPECT_EQ(by_whitespace, Split(s, std::string("\t\n"), EmptyFields::Keep));
+  EXPECT_EQ(by_lines, Split(s, ByLines::Use0Aor0D, EmptyFields::Keep));
+  EXPECT_EQ(by_whitespace, Split(s, ByWhitespace::UseIsSpace, EmptyFields::Keep));
+  EXPECT_EQ(by_non_alnum, Split(s, ::isalnum, EmptyFields::Keep));
+  std::vector<std::string> chunks;
+  Split(&s[0], s.length(), ',', [&chunks](Chunk chunk) { chunks.emplace_back(chunk.c_str()); }, EmptyFields::Keep);
+  EXPECT_EQ(by_comma, chunks);
+}
+
+TEST(JoinAndSplit, SplitIntoViews) {
+  const std::string s = "one,two,,three";
+  const std::vector<std::string_view> views = current::strings::SplitIntoViews(s, ',');
+  ASSERT_EQ(3u, views.size());
+  EXPECT_EQ("one", views[0]);
+  EXPECT_EQ("three", views[2]);
+  EXPECT_EQ(s.data() + 9, views[2].data());
+  EXPECT_EQ(4u, current::strings::SplitIntoViews(s, ',', EmptyFields::Keep).size());
+
+  std::string result;
+  EXPECT_EQ(3u,
+            current::strings::SplitIntoViews(
+                "a b\tc\n", ByWhitespace::UseIsSpace, [&result](std::string_view v) { result += v; }));
+  EXPECT_EQ("abc", result);
+
+  std::vector<std::pair<std::string_view, std::string_view>> pairs;
+  current::strings::SplitIntoKeyValueViews("a=1&b=2&c&d=4=5", '=', '&', [&pairs](auto k, auto v) {
+    pairs.emplace_back(k, v);
+  });
+  ASSERT_EQ(2u, pairs.size());
+  EXPECT_EQ("b", pairs[1].first);
+  EXPECT_EQ("2", pairs[1].second);
+}
+
 TEST(JoinAndSplit, SplitIntoKeyValuePairs) {
   const auto result = SplitIntoKeyValuePairs("one=1,two=2", '=', ',');
   ASSERT_EQ(2u, result.size());
@@ -428,6 +521,44 @@ TEST(EditDistance, SmokeTest) {
   EXPECT_EQ(1u, FastEditDistance("foo", "oo", 10u));
 }
 
+TEST(EditDistance, BitParallel) {
+  EXPECT_EQ(0u, EditDistance("", ""));
+  EXPECT_EQ(3u, EditDistance("foo", ""));
+  EXPECT_EQ(3u, EditDistance("", "foo"));
+  EXPECT_EQ(3u, EditDistance("foo", "bar"));
+  EXPECT_EQ(1u, EditDistance("foo", "fwo"));
+  EXPECT_EQ(6u, EditDistance("foobarbaz", "baz"));
+
+  // Across the lengths of one, two, and three words, of both the query and the candidates, on small alphabets.
+  std::mt19937 random(42);
+  const auto random_string = [&random](size_t length, char letters) {
+    std::string s(length, ' ');
+    for (char& c : s) {
+      c = static_cast<char>('a' + random() % static_cast<uint32_t>(letters));
+    }
+    return s;
+  };
+  for (size_t length : {1u, 5u, 63u, 64u, 65u, 127u, 128u, 129u, 150u}) {
+    const std::string query = random_string(length, 4);
+    std::vector<std::string> candidates;
+    for (size_t candidate_length : {0u, 1u, 10u, 64u, 100u, 130u, 200u}) {
+      candidates.push_back(random_string(candidate_length, 4));
+    }
+    // And the candidates close to the query.
+    std::string close = query;
+    close[length / 2] = 'z';
+    candidates.push_back(close);
+    candidates.push_back(close.substr(1) + "xy");
+    const std::vector<size_t> distances = EditDistances(query, candidates);
+    ASSERT_EQ(candidates.size(), distances.size());
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      const size_t expected = SlowEditDistance(query, candidates[i]);
+      EXPECT_EQ(expected, distances[i]) << length << ' ' << candidates[i].length();
+      EXPECT_EQ(expected, EditDistance(candidates[i], query)) << length << ' ' << candidates[i].length();
+    }
+  }
+}
+
 TEST(EditDistance, MaxOffset1) {
   // Max. offset of 1 is fine, max. offset 0 is per-char comparison.
   EXPECT_EQ(2u, SlowEditDistance("abcde", "bcdef"));
@@ -581,6 +712,55 @@ TEST(Chunk, SmokeTest) {
   EXPECT_FALSE(db.Find("nope", unique_result));
 }
 
+TEST(Chunk, InterningChunkDB) {
+  current::strings::InterningChunkDB db;
+  UniqueChunk foo;
+  {
+    // The database owns the strings, so they may go away.
+    std::string temporary("foo");
+    foo = db[temporary];
+    temporary = "bar";
+  }
+  EXPECT_EQ("foo", static_cast<std::string>(foo));
+  EXPECT_EQ('\0', foo.c_str()[3]);
+  EXPECT_TRUE(foo == db.Intern(std::string("foo")));
+  EXPECT_TRUE(foo != db.Intern("bar"));
+  EXPECT_TRUE(db.Intern(Chunk("meh\0more", 3)) != db.Intern(Chunk("meh\0more", 8)));
+  EXPECT_TRUE(db.Intern(std::string(100000u, 'x')) == db.Intern(std::string(100000u, 'x')));
+  EXPECT_EQ(5u, db.Size());
+
+  UniqueChunk result;
+  EXPECT_TRUE(db.Find("foo", result));
+  EXPECT_TRUE(result == foo);
+  EXPECT_FALSE(db.Find("nope", result));
+  EXPECT_EQ(5u, db.Size());
+}
+
+TEST(Chunk, InterningChunkDBFromManyThreads) {
+  current::strings::InterningChunkDB db;
+  std::vector<std::vector<UniqueChunk>> results(8u);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < results.size(); ++t) {
+    threads.emplace_back([&db, &results, t]() {
+      for (int i = 0; i < 5000; ++i) {
+        // Each thread goes through the same strings, from a different starting point.
+        results[t].push_back(db.Intern(current::ToString((i + static_cast<int>(t) * 625) % 5000)));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(5000u, db.Size());
+  for (size_t t = 0; t < results.size(); ++t) {
+    for (int i = 0; i < 5000; ++i) {
+      const UniqueChunk& chunk = results[t][(i + 5000 - static_cast<int>(t) * 625) % 5000];
+      ASSERT_EQ(current::ToString(i), static_cast<std::string>(chunk));
+      ASSERT_TRUE(chunk == results[0][i]);
+    }
+  }
+}
+
 TEST(Rounding, SmokeTest) {
   const double pi = 2.0 * std::acos(0.0);
   EXPECT_EQ("3.1", RoundDoubleToString(pi));
@@ -741,6 +921,30 @@ TEST(Util, Escape) {
   EXPECT_EQ("Testing 'quote' and \"quote\".", EscapeForMarkdown("Testing 'quote' and \"quote\"."));
 }
 
+TEST(Util, EscapeLongStrings) {
+  const std::string run(100u, 'x');
+  EXPECT_EQ(run + "\\n" + run + "\\\"" + run, EscapeForCPlusPlus(run + "\n" + run + "\"" + run));
+  EXPECT_EQ(run + "<br>" + run + "&#124;", EscapeForMarkdown(run + "\n" + run + "|"));
+}
+
+TEST(Util, FindJSONStringSpecial) {
+  using current::strings::impl::FindJSONStringSpecial;
+  // The terminating zero is where the scan stops if nothing else is found.
+  const std::string plain(200u, 'x');
+  for (size_t i = 0u; i < 64u; ++i) {
+    EXPECT_EQ(plain.c_str() + plain.length(), FindJSONStringSpecial(plain.c_str() + i));
+  }
+  for (char special : {'"', '\\', '\n', '\x01', '\x1f'}) {
+    for (size_t position = 0u; position < 100u; ++position) {
+      std::string s = "\xd0\x9f\x7f" + plain;
+      s[position + 3u] = special;
+      for (size_t from = 0u; from <= position; from += 7u) {
+        ASSERT_EQ(s.c_str() + position + 3u, FindJSONStringSpecial(s.c_str() + from)) << position << ' ' << from;
+      }
+    }
+  }
+}
+
 TEST(IsStringType, StaticAsserts) {
   static_assert(!is_string_type<int>::value, "");
 
@@ -26,10 +26,13 @@ SOFTWARE.
 #define BRICKS_STRINGS_UTIL_H
 
 #include <algorithm>
+#include <charconv>
 #include <chrono>
 #include <cstring>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <system_error>
 #include <type_traits>
 
 #include "is_string_type.h"
@@ -66,12 +69,65 @@ constexpr auto HasMemberFromString(int) -> decltype(std::declval<T>().FromString
 
 }  // namespace sfinae
 
-// Default implepentation for arithmetic types calling `std::to_string`.
+namespace impl {
+
+// The numbers are printed and parsed with `std::to_chars` and `std::from_chars`, with no locale and no allocations
+// but the resulting string itself; the floating point ones in the shortest form that parses back to the same value.
+template <typename T>
+inline std::string ArithmeticToString(T value) {
+  char buffer[64];
+  const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  return std::string(buffer, result.ptr);
+}
+
+// Parses the number at the beginning of `input` the way `std::istringstream` would: skipping the leading whitespace
+// and the `+` sign, ignoring what follows the number, and wrapping around the negative values of unsigned types.
+// Sets `output` to zero and returns `false` if there is no number, or if it is out of the range of `T`.
+template <typename T>
+inline bool ArithmeticFromString(std::string_view input, T& output) {
+  const char* begin = input.data();
+  const char* const end = begin + input.length();
+  while (begin != end && (*begin == ' ' || (*begin >= '\t' && *begin <= '\r'))) {
+    ++begin;
+  }
+  if (begin != end && *begin == '+') {
+    ++begin;
+  }
+  bool negate = false;
+  if constexpr (std::is_unsigned_v<T>) {
+    if (begin != end && *begin == '-') {
+      negate = true;
+      ++begin;
+    }
+  }
+  const auto result = std::from_chars(begin, end, output);
+  if (result.ec != std::errc()) {
+    output = T();
+    return false;
+  }
+  if (negate) {
+    output = static_cast<T>(T(0) - output);
+  }
+  return true;
+}
+
+template <typename INPUT, typename T>
+inline bool ArithmeticFromString(const INPUT& input, T& output) {
+  if constexpr (std::is_convertible_v<const INPUT&, std::string_view>) {
+    return ArithmeticFromString(std::string_view(input), output);
+  } else {
+    return ArithmeticFromString(std::string_view(static_cast<std::string>(input)), output);
+  }
+}
+
+}  // namespace impl
+
+// Default implepentation for arithmetic types, via `std::to_chars`.
 template <typename DECAYED_T, bool HAS_MEMBER_TO_STRING, bool IS_ENUM>
 struct ToStringImpl {
   template <bool B = std::is_arithmetic_v<DECAYED_T>>
   static std::enable_if_t<B, std::string> DoIt(DECAYED_T value) {
-    return std::to_string(value);
+    return impl::ArithmeticToString(value);
   }
 };
 
@@ -91,7 +147,7 @@ struct ToStringImpl<DECAYED_T, true, false> {
 template <typename DECAYED_T>
 struct ToStringImpl<DECAYED_T, false, true> {
   static std::string DoIt(DECAYED_T value) {
-    return std::to_string(static_cast<typename std::underlying_type<DECAYED_T>::type>(value));
+    return impl::ArithmeticToString(static_cast<typename std::underlying_type<DECAYED_T>::type>(value));
   }
 };
 
@@ -130,13 +186,13 @@ struct ToStringImpl<char, false, false> {
 // `std::chrono::milliseconds`.
 template <>
 struct ToStringImpl<std::chrono::milliseconds, false, false> {
-  static std::string DoIt(std::chrono::milliseconds t) { return std::to_string(t.count()); }
+  static std::string DoIt(std::chrono::milliseconds t) { return impl::ArithmeticToString(t.count()); }
 };
 
 // `std::chrono::microseconds`.
 template <>
 struct ToStringImpl<std::chrono::microseconds, false, false> {
-  static std::string DoIt(std::chrono::microseconds t) { return std::to_string(t.count()); }
+  static std::string DoIt(std::chrono::microseconds t) { return impl::ArithmeticToString(t.count()); }
 };
 
 // `Chunk` uses its own native cast into `std::string`, but it should be enabled.
@@ -163,8 +219,20 @@ struct FromStringImpl<INPUT, OUTPUT, true, false> {
   }
 };
 
+// The arithmetic types, via `std::from_chars`. Except `char`, which is the character itself.
+template <typename INPUT,
+          typename OUTPUT,
+          bool IS_ARITHMETIC = std::is_arithmetic_v<OUTPUT> && !std::is_same_v<OUTPUT, char>>
+struct FromStringNonEnumImpl {
+  static const OUTPUT& Go(INPUT&& input, OUTPUT& output) {
+    impl::ArithmeticFromString(input, output);
+    return output;
+  }
+};
+
+// The user types, via `std::istringstream`.
 template <typename INPUT, typename OUTPUT>
-struct FromStringImpl<INPUT, OUTPUT, false, false> {
+struct FromStringNonEnumImpl<INPUT, OUTPUT, false> {
   static const OUTPUT& Go(INPUT&& input, OUTPUT& output) {
     std::istringstream is(input);
     if (!(is >> output)) {
@@ -175,16 +243,15 @@ struct FromStringImpl<INPUT, OUTPUT, false, false> {
   }
 };
 
+template <typename INPUT, typename OUTPUT>
+struct FromStringImpl<INPUT, OUTPUT, false, false> : FromStringNonEnumImpl<INPUT, OUTPUT> {};
+
 template <typename INPUT, typename OUTPUT>
 struct FromStringImpl<INPUT, OUTPUT, false, true> {
   static const OUTPUT& Go(INPUT&& input, OUTPUT& output) {
-    std::istringstream is(input);
     using underlying_output_t = typename std::underlying_type<OUTPUT>::type;
     underlying_output_t underlying_output;
-    if (!(is >> underlying_output)) {
-      // Default initializer, zero for primitive types.
-      underlying_output = underlying_output_t();
-    }
+    impl::ArithmeticFromString(input, underlying_output);
     output = static_cast<OUTPUT>(underlying_output);
     return output;
   }
@@ -200,13 +267,13 @@ struct FromStringImpl<INPUT, bool, false, false> {
 };
 
 // Well, `int8_t` and `uint8_t` are not f*cking `char`-s, contrary to what `std::istringstream` thinks they are.
+// Parsed as `int`-s, so that the out-of-range values wrap around, as they always have.
 template <typename INPUT>
 struct FromStringImpl<INPUT, int8_t, false, false> {
   // Must return a reference as the callers expects it so. -- D.K.
   static const int8_t& Go(const std::string& input, int8_t& output) {
-    std::istringstream is(input);
     int value;
-    is >> value;
+    impl::ArithmeticFromString(input, value);
     output = static_cast<int8_t>(value);
     return output;
   }
@@ -215,9 +282,8 @@ template <typename INPUT>
 struct FromStringImpl<INPUT, uint8_t, false, false> {
   // Must return a reference as the callers expects it so. -- D.K.
   static const uint8_t& Go(const std::string& input, uint8_t& output) {
-    std::istringstream is(input);
     int value;
-    is >> value;
+    impl::ArithmeticFromString(input, value);
     output = static_cast<uint8_t>(value);
     return output;
   }
@@ -226,11 +292,8 @@ struct FromStringImpl<INPUT, uint8_t, false, false> {
 template <typename INPUT>
 struct FromStringImpl<INPUT, std::chrono::milliseconds, false, false> {
   static const std::chrono::milliseconds& Go(INPUT&& input, std::chrono::milliseconds& output) {
-    std::istringstream is(input);
     int64_t underlying_output;
-    if (!(is >> underlying_output)) {
-      underlying_output = 0ll;
-    }
+    impl::ArithmeticFromString(input, underlying_output);
     output = static_cast<std::chrono::milliseconds>(underlying_output);
     return output;
   }
@@ -239,11 +302,8 @@ struct FromStringImpl<INPUT, std::chrono::milliseconds, false, false> {
 template <typename INPUT>
 struct FromStringImpl<INPUT, std::chrono::microseconds, false, false> {
   static const std::chrono::microseconds& Go(INPUT&& input, std::chrono::microseconds& output) {
-    std::istringstream is(input);
     int64_t underlying_output;
-    if (!(is >> underlying_output)) {
-      underlying_output = 0ll;
-    }
+    impl::ArithmeticFromString(input, underlying_output);
     output = static_cast<std::chrono::microseconds>(underlying_output);
     return output;
   }
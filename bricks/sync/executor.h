@@ -0,0 +1,288 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2014 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// `WorkStealingExecutor` is the general-purpose thread pool, to share among the subsystems instead of each of them
+// spawning threads of its own.
+//
+// Each worker thread has its own deque of tasks. The tasks submitted from within the worker go to its own deque,
+// and are taken by it in the LIFO order, so that they are run while their data is still in cache; the ones submitted
+// from the outside are spread across the workers. The worker out of tasks steals the oldest ones of the others.
+// The idle workers park on a `WaitableAtomic`, each on a flag of its own, so that a new task wakes one of them.
+//
+// `Submit(f)` returns the `current::Future` of the result of `f`, see "bricks/util/future.h", and `Post(f)` does not.
+// `ParallelFor(begin, end, f)` calls `f(i)` for each `i` of the range, split into chunks across the workers,
+// running the chunks itself as well while waiting for them, so that it can be called from within the tasks.
+//
+// The destructor runs all the tasks submitted so far before returning.
+
+#ifndef BRICKS_SYNC_EXECUTOR_H
+#define BRICKS_SYNC_EXECUTOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "waitable_atomic.h"
+
+#include "../util/future.h"
+
+namespace current {
+
+namespace impl {
+
+struct ExecutorTask {
+  virtual ~ExecutorTask() = default;
+  virtual void Run() = 0;
+};
+
+template <typename F>
+struct ExecutorTaskImpl final : ExecutorTask {
+  F f;
+  explicit ExecutorTaskImpl(F&& f) : f(std::move(f)) {}
+  void Run() override { f(); }
+};
+
+}  // namespace impl
+
+class WorkStealingExecutor final {
+ public:
+  // The number of the chunks per worker `ParallelFor()` splits the range into, for the faster workers to steal.
+  constexpr static size_t kParallelForChunksPerWorker = 4u;
+
+  static size_t DefaultWorkersCount() { return std::max(1u, std::thread::hardware_concurrency()); }
+
+  explicit WorkStealingExecutor(size_t workers_count = DefaultWorkersCount())
+      : parking_(Parking(std::max(workers_count, size_t(1u)))) {
+    for (size_t i = 0; i < std::max(workers_count, size_t(1u)); ++i) {
+      workers_.emplace_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      workers_[i]->thread = std::thread(&WorkStealingExecutor::WorkerThread, this, i);
+    }
+  }
+
+  ~WorkStealingExecutor() {
+    stopping_ = true;
+    parking_.MutableUse([](Parking& parking) { parking.stopping = true; });
+    for (auto& worker : workers_) {
+      worker->thread.join();
+    }
+  }
+
+  size_t WorkersCount() const { return workers_.size(); }
+
+  // Runs `f()` on one of the workers, and returns the future of its result.
+  template <typename F>
+  Future<std::invoke_result_t<std::decay_t<F>&>> Submit(F&& f) {
+    using result_t = std::invoke_result_t<std::decay_t<F>&>;
+    std::packaged_task<result_t()> task(std::forward<F>(f));
+    Future<result_t> future(task.get_future());
+    Push(std::make_unique<impl::ExecutorTaskImpl<std::packaged_task<result_t()>>>(std::move(task)));
+    return future;
+  }
+
+  // Runs `f()` on one of the workers.
+  template <typename F>
+  void Post(F&& f) {
+    Push(std::make_unique<impl::ExecutorTaskImpl<std::decay_t<F>>>(std::decay_t<F>(std::forward<F>(f))));
+  }
+
+  // Calls `f(i)` for each `i` in `[begin, end)`, from several threads at once, and returns once all the calls have.
+  // Rethrows the first exception thrown by `f`, if any, once all the chunks are done.
+  template <typename F>
+  void ParallelFor(size_t begin, size_t end, F&& f) {
+    if (begin >= end) {
+      return;
+    }
+    struct State final {
+      size_t remaining_chunks;
+      std::exception_ptr exception;
+    };
+    const size_t total = end - begin;
+    const size_t chunks = std::min(total, workers_.size() * kParallelForChunksPerWorker);
+    WaitableAtomic<State> state(State{chunks, nullptr});
+    for (size_t c = 0; c < chunks; ++c) {
+      const size_t chunk_begin = begin + total * c / chunks;
+      const size_t chunk_end = begin + total * (c + 1u) / chunks;
+      Post([chunk_begin, chunk_end, &f, &state]() {
+        try {
+          for (size_t i = chunk_begin; i < chunk_end; ++i) {
+            f(i);
+          }
+        } catch (...) {
+          std::exception_ptr exception = std::current_exception();
+          state.MutableUse([&exception](State& s) {
+            if (!s.exception) {
+              s.exception = exception;
+            }
+          });
+        }
+        state.MutableUse([](State& s) { --s.remaining_chunks; });
+      });
+    }
+    const auto done = [](const State& s) { return s.remaining_chunks == 0u; };
+    while (!state.ImmutableUse(done)) {
+      if (task_t task = TakeTask(ThisThread().executor == this ? ThisThread().index : workers_.size())) {
+        task->Run();
+      } else {
+        state.Wait(done);
+      }
+    }
+    const std::exception_ptr exception = state.ImmutableUse([](const State& s) { return s.exception; });
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+
+ private:
+  using task_t = std::unique_ptr<impl::ExecutorTask>;
+
+  struct alignas(64) Worker final {
+    std::mutex mutex;
+    std::deque<task_t> tasks;
+    std::thread thread;
+  };
+
+  // Which workers are parked, and which of them have been woken up, under the lock of `parking_`.
+  struct Parking final {
+    std::vector<char> parked;
+    std::vector<char> woken;
+    bool stopping = false;
+    explicit Parking(size_t workers_count) : parked(workers_count), woken(workers_count) {}
+  };
+
+  struct ThisThreadWorker final {
+    const WorkStealingExecutor* executor = nullptr;
+    size_t index = 0u;
+  };
+
+  static ThisThreadWorker& ThisThread() {
+    thread_local ThisThreadWorker worker;
+    return worker;
+  }
+
+  void Push(task_t task) {
+    const size_t i =
+        (ThisThread().executor == this) ? ThisThread().index : (next_worker_.fetch_add(1u) % workers_.size());
+    {
+      std::lock_guard<std::mutex> lock(workers_[i]->mutex);
+      workers_[i]->tasks.push_back(std::move(task));
+    }
+    // Pairs with the fence in `WorkerThread()`: either the parked worker sees this task, or this sees it parked.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked_count_.load()) {
+      parking_.PotentiallyMutableUse([this](Parking& parking) {
+        for (size_t j = 0; j < parking.parked.size(); ++j) {
+          if (parking.parked[j]) {
+            parking.parked[j] = false;
+            parking.woken[j] = true;
+            --parked_count_;
+            return true;
+          }
+        }
+        return false;
+      });
+    }
+  }
+
+  // Takes the most recent task of the worker `i`, if it has one, or steals the oldest one of the others.
+  // With `i == workers_.size()`, only steals.
+  task_t TakeTask(size_t i) {
+    if (i < workers_.size()) {
+      std::lock_guard<std::mutex> lock(workers_[i]->mutex);
+      if (!workers_[i]->tasks.empty()) {
+        task_t task = std::move(workers_[i]->tasks.back());
+        workers_[i]->tasks.pop_back();
+        return task;
+      }
+    }
+    for (size_t k = 1; k <= workers_.size(); ++k) {
+      Worker& victim = *workers_[(i + k) % workers_.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.tasks.empty()) {
+        task_t task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return task;
+      }
+    }
+    return nullptr;
+  }
+
+  void Unpark(Parking& parking, size_t i) {
+    if (parking.parked[i]) {
+      parking.parked[i] = false;
+      --parked_count_;
+    }
+    parking.woken[i] = false;
+  }
+
+  void WorkerThread(size_t i) {
+    ThisThread().executor = this;
+    ThisThread().index = i;
+    while (true) {
+      if (task_t task = TakeTask(i)) {
+        task->Run();
+        continue;
+      }
+      parking_.PotentiallyMutableUse([this, i](Parking& parking) {
+        parking.parked[i] = true;
+        ++parked_count_;
+        return false;
+      });
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      const bool stopping = stopping_.load();
+      if (task_t task = TakeTask(i)) {
+        parking_.PotentiallyMutableUse([this, i](Parking& parking) {
+          Unpark(parking, i);
+          return false;
+        });
+        task->Run();
+        continue;
+      }
+      if (stopping) {
+        return;
+      }
+      parking_.Wait([i](const Parking& parking) { return parking.woken[i] || parking.stopping; },
+                    [this, i](Parking& parking) { Unpark(parking, i); });
+    }
+  }
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<size_t> next_worker_{0u};
+  std::atomic<size_t> parked_count_{0u};
+  std::atomic_bool stopping_{false};
+  WaitableAtomic<Parking> parking_;
+};
+
+}  // namespace current
+
+#endif  // BRICKS_SYNC_EXECUTOR_H
@@ -27,7 +27,9 @@ SOFTWARE.
 
 #include "../../port.h"
 
+#include <functional>
 #include <mutex>
+#include <shared_mutex>
 #include <type_traits>
 
 namespace current {
@@ -46,6 +48,65 @@ using SmartMutexLockGuard = std::conditional_t<MLS == MutexLockStatus::NeedToLoc
 static_assert(std::is_same_v<std::lock_guard<std::mutex>, SmartMutexLockGuard<MutexLockStatus::NeedToLock>>, "");
 static_assert(std::is_same_v<NoOpLock, SmartMutexLockGuard<MutexLockStatus::AlreadyLocked>>, "");
 
+// The shared counterpart of `SmartMutexLockGuard`, for the read-only accessors: with the `std::shared_mutex`,
+// they run concurrently with each other, while the mutating ones, with `SmartMutexLockGuard<MLS, std::shared_mutex>`,
+// run exclusively. `AlreadyLocked` means the caller holds the mutex, in either mode.
+template <MutexLockStatus MLS, class MUTEX = std::shared_mutex>
+using SmartSharedMutexLockGuard =
+    std::conditional_t<MLS == MutexLockStatus::NeedToLock, std::shared_lock<MUTEX>, NoOpLock>;
+
+static_assert(std::is_same_v<std::shared_lock<std::shared_mutex>,
+                             SmartSharedMutexLockGuard<MutexLockStatus::NeedToLock>>,
+              "");
+static_assert(std::is_same_v<NoOpLock, SmartSharedMutexLockGuard<MutexLockStatus::AlreadyLocked>>, "");
+
+// The mutexes striped by key, for the independent keys not to contend on one mutex.
+// `For(key)` is the mutex of the stripe of the key, to lock with any of the above; `AllStripesLockGuard` locks
+// all of them, in the order of their indexes, so that it does not deadlock with another one.
+template <size_t STRIPES = 16u, class MUTEX = std::mutex>
+class StripedMutex final {
+ public:
+  static_assert(STRIPES > 0u, "");
+  constexpr static size_t kStripes = STRIPES;
+
+  StripedMutex() = default;
+  StripedMutex(const StripedMutex&) = delete;
+  StripedMutex& operator=(const StripedMutex&) = delete;
+
+  template <typename KEY>
+  MUTEX& For(const KEY& key) {
+    return Stripe(std::hash<KEY>()(key) % STRIPES);
+  }
+
+  MUTEX& Stripe(size_t stripe) { return stripes_[stripe].mutex; }
+
+  class AllStripesLockGuard final {
+   public:
+    explicit AllStripesLockGuard(StripedMutex& striped) : striped_(striped) {
+      for (size_t i = 0; i < STRIPES; ++i) {
+        striped_.Stripe(i).lock();
+      }
+    }
+    ~AllStripesLockGuard() {
+      for (size_t i = STRIPES; i > 0u; --i) {
+        striped_.Stripe(i - 1u).unlock();
+      }
+    }
+    AllStripesLockGuard(const AllStripesLockGuard&) = delete;
+    AllStripesLockGuard& operator=(const AllStripesLockGuard&) = delete;
+
+   private:
+    StripedMutex& striped_;
+  };
+
+ private:
+  // Each on a cache line of its own, for the threads locking different stripes not to share it.
+  struct alignas(64) AlignedMutex final {
+    MUTEX mutex;
+  };
+  AlignedMutex stripes_[STRIPES];
+};
+
 }  // namespace locks
 }  // namespace current
 
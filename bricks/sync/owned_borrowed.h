@@ -46,6 +46,11 @@ SOFTWARE.
 //   The lifetime of the `borrower` object will be strictly inside the lifetime of `master`.
 //   The destructor of `master` will wait until all the `borrower`-s have terminated.
 //   The callbacks, corresponding to active `borrower`-s, will be called as `master` will be destructing.
+//
+// The borrowers with callbacks are registered under the mutex of the instance, as the callbacks are to be called.
+// The ones with no callbacks, `Borrowed<T>`-s, are only counted, on the per-thread stripes of counters, so that
+// creating and destroying them from many threads at once, i.e. iterating or subscribing, does not contend.
+// The stripes take the mutex, to let the destructor know they are done, only once the instance is destructing.
 
 #ifndef BRICKS_SYNC_OWNED_BORROWED_H
 #define BRICKS_SYNC_OWNED_BORROWED_H
@@ -78,14 +83,37 @@ struct ConstructBorrowedObjectViaMoveConstructor {};
 
 struct ConstructUniqueContainerViaMoveConstructor {};
 
+// The stripe of counters for the borrowers created by this thread, spread across the threads round-robin.
+inline size_t ThisThreadBorrowersStripe(size_t stripes) {
+  static std::atomic<size_t> next_stripe(0u);
+  thread_local const size_t stripe = next_stripe++;
+  return stripe % stripes;
+}
+
 // The actual instance, kept along with its destructing status, and a list of registered borrowers.
 template <typename T>
 struct UniqueInstance final {
+  constexpr static size_t kBorrowersStripes = 16u;
+  // The bit of the key of the borrower which is counted on the stripe, which the rest of the key is the index of.
+  constexpr static size_t kStripedBorrowerKey = size_t(1u) << (sizeof(size_t) * 8u - 1u);
+  // The bit of the `released` counter of the stripe set by the destructor, for the releases to take the mutex.
+  constexpr static uint64_t kReleasedUnderMutexBit = uint64_t(1u) << 63u;
+
+  // The borrowers registered and released on this stripe throughout its lifetime, monotonic.
+  struct alignas(64) BorrowersStripe final {
+    std::atomic<uint64_t> registered{0u};
+    std::atomic<uint64_t> released{0u};
+  };
+
   // Constructor: Construct an instance of the object.
-  UniqueInstance() : destructing_(false), instance_(), total_borrowers_spawned_throughout_lifetime_(0u) {}
+  UniqueInstance()
+      : destructing_(false), instance_(), total_borrowers_spawned_throughout_lifetime_(0u), last_borrower_key_(0u) {}
   template <typename... ARGS>
   UniqueInstance(ARGS&&... args)
-      : destructing_(false), instance_(std::forward<ARGS>(args)...), total_borrowers_spawned_throughout_lifetime_(0u) {}
+      : destructing_(false),
+        instance_(std::forward<ARGS>(args)...),
+        total_borrowers_spawned_throughout_lifetime_(0u),
+        last_borrower_key_(0u) {}
 
   // Destructor: Block until all the borrowers are done.
   ~UniqueInstance() {
@@ -97,7 +125,9 @@ struct UniqueInstance final {
     {
       std::lock_guard<std::mutex> lock(mutex_);
       for (const auto& cit : borrowers_) {
-        callbacks_to_call.push_back(cit.second);
+        if (cit.second) {
+          callbacks_to_call.push_back(cit.second);
+        }
       }
     }
 
@@ -109,15 +139,72 @@ struct UniqueInstance final {
     // Wait until all the borrowers have terminated.
     {
       std::unique_lock<std::mutex> lock(mutex_);
-      condition_variable_.wait(lock, [this]() { return borrowers_.empty(); });
+      for (auto& stripe : stripes_) {
+        stripe.released |= kReleasedUnderMutexBit;
+      }
+      condition_variable_.wait(lock, [this]() { return borrowers_.empty() && !ActiveStripedBorrowers(); });
     }
   }
 
   // Register ("increase the ref-count") a newly spawned borrower, along with its termination signal callback.
   // Must be called from within a mutex-locked section.
   size_t RegisterBorrowerFromLockedSection(std::function<void()> destruction_callback) {
-    borrowers_[++total_borrowers_spawned_throughout_lifetime_] = destruction_callback;
-    return total_borrowers_spawned_throughout_lifetime_;
+    ++total_borrowers_spawned_throughout_lifetime_;
+    return RegisterMovedBorrowerFromLockedSection(destruction_callback);
+  }
+
+  // Register a borrower moved from the stripe, as it now has a termination signal callback.
+  // Must be called from within a mutex-locked section.
+  size_t RegisterMovedBorrowerFromLockedSection(std::function<void()> destruction_callback) {
+    borrowers_[++last_borrower_key_] = destruction_callback;
+    return last_borrower_key_;
+  }
+
+  static bool IsStripedBorrowerKey(size_t key) { return (key & kStripedBorrowerKey) != 0u; }
+
+  // Register a newly spawned borrower with no termination signal callback. Does not lock the mutex.
+  size_t RegisterStripedBorrower() {
+    const size_t stripe = ThisThreadBorrowersStripe(kBorrowersStripes);
+    ++stripes_[stripe].registered;
+    return kStripedBorrowerKey | stripe;
+  }
+
+  // Unregister a borrower with no termination signal callback. Locks the mutex only if the instance is destructing,
+  // in which case the release is made under it, so that the destructor neither misses it nor returns before it.
+  void UnRegisterStripedBorrower(size_t key) {
+    std::atomic<uint64_t>& released = stripes_[key & ~kStripedBorrowerKey].released;
+    uint64_t value = released.load();
+    while (!(value & kReleasedUnderMutexBit)) {
+      if (released.compare_exchange_weak(value, value + 1u)) {
+        return;
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++released;
+    condition_variable_.notify_all();
+  }
+
+  // The number of the live borrowers with no termination signal callbacks.
+  // The released ones are summed up first, so that, with the counters monotonic, zero means there was a moment
+  // with no such borrowers; and since it takes a live borrower to spawn one, there can be no more of them after it.
+  size_t ActiveStripedBorrowers() const {
+    uint64_t released = 0u;
+    for (const auto& stripe : stripes_) {
+      released += (stripe.released.load() & ~kReleasedUnderMutexBit);
+    }
+    uint64_t registered = 0u;
+    for (const auto& stripe : stripes_) {
+      registered += stripe.registered.load();
+    }
+    return static_cast<size_t>(registered - released);
+  }
+
+  size_t TotalStripedBorrowersSpawned() const {
+    uint64_t registered = 0u;
+    for (const auto& stripe : stripes_) {
+      registered += stripe.registered.load();
+    }
+    return static_cast<size_t>(registered);
   }
 
   void UpdateBorrowersCallbackFromLockedSection(size_t key, std::function<void()> destruction_callback) {
@@ -150,7 +237,9 @@ struct UniqueInstance final {
   std::mutex mutex_;                                    // The mutex to guard per-borrower info.
   std::condition_variable condition_variable_;          // The variable to notify as all the borrowers are gone.
   std::map<size_t, std::function<void()>> borrowers_;   // Map of live borrower -> termination signal callback.
-  size_t total_borrowers_spawned_throughout_lifetime_;  // A pre-increment of this value is the key in the above map.
+  size_t total_borrowers_spawned_throughout_lifetime_;  // The borrowers registered in the above map when spawned.
+  size_t last_borrower_key_;                            // A pre-increment of this value is the key in the above map.
+  BorrowersStripe stripes_[kBorrowersStripes];          // The counters of the borrowers with no callbacks.
 };
 
 }  // namespace impl
@@ -175,10 +264,15 @@ class WeakBorrowed {
   // `WeakBorrowed<T>` is meant to be initialized by `Owned<T>` | `BorrowedWithCallback<T>` | `Borrowed<T>` only.
   WeakBorrowed(impl::ConstructOwned, instance_t& actual_instance) : p_actual_instance_(&actual_instance), key_(0u) {}
 
-  WeakBorrowed(impl::ConstructBorrowed, const WeakBorrowed& rhs, std::function<void()> destruction_callback) {
-    std::lock_guard<std::mutex> lock(rhs.p_actual_instance_->mutex_);
-    p_actual_instance_ = rhs.p_actual_instance_;
-    key_ = p_actual_instance_->RegisterBorrowerFromLockedSection(destruction_callback);
+  // The borrowers with no `destruction_callback` are the striped ones, registered with no mutex locked.
+  WeakBorrowed(impl::ConstructBorrowed, const WeakBorrowed& rhs, std::function<void()> destruction_callback)
+      : p_actual_instance_(rhs.p_actual_instance_) {
+    if (destruction_callback) {
+      std::lock_guard<std::mutex> lock(p_actual_instance_->mutex_);
+      key_ = p_actual_instance_->RegisterBorrowerFromLockedSection(destruction_callback);
+    } else {
+      key_ = p_actual_instance_->RegisterStripedBorrower();
+    }
   }
 
   WeakBorrowed(impl::ConstructBorrowedObjectViaMoveConstructor,
@@ -193,10 +287,19 @@ class WeakBorrowed {
   }
 
   void MoveFrom(WeakBorrowed&& rhs, std::function<void()> destruction_callback) {
-    std::lock_guard<std::mutex> lock(rhs.p_actual_instance_->mutex_);
     p_actual_instance_ = rhs.p_actual_instance_;
     key_ = rhs.key_;
-    p_actual_instance_->UpdateBorrowersCallbackFromLockedSection(key_, destruction_callback);
+    if (!instance_t::IsStripedBorrowerKey(key_)) {
+      std::lock_guard<std::mutex> lock(p_actual_instance_->mutex_);
+      p_actual_instance_->UpdateBorrowersCallbackFromLockedSection(key_, destruction_callback);
+    } else if (destruction_callback) {
+      // The striped borrower is to have a callback now, so it is registered in the map before leaving the stripe.
+      {
+        std::lock_guard<std::mutex> lock(p_actual_instance_->mutex_);
+        key_ = p_actual_instance_->RegisterMovedBorrowerFromLockedSection(destruction_callback);
+      }
+      p_actual_instance_->UnRegisterStripedBorrower(rhs.key_);
+    }
     rhs.key_ = 0u;  // Must mark the passed in xvalue of `WeakBorrowed<>` as abandoned.
     rhs.p_actual_instance_ = nullptr;
   }
@@ -250,7 +353,7 @@ class WeakBorrowed {
   // THREAD-SAFE. NEVER THROWS.
   size_t NumberOfActiveBorrowers() const {
     std::lock_guard<std::mutex> lock(p_actual_instance_->mutex_);
-    return p_actual_instance_->borrowers_.size();
+    return p_actual_instance_->borrowers_.size() + p_actual_instance_->ActiveStripedBorrowers();
   }
 
   // Return the total number of registered borrower users registered, with some possibly already out of scope.
@@ -258,7 +361,8 @@ class WeakBorrowed {
   // THREAD-SAFE. NEVER THROWS.
   size_t TotalBorrowersSpawnedThroughoutLifetime() const {
     std::lock_guard<std::mutex> lock(p_actual_instance_->mutex_);
-    return p_actual_instance_->total_borrowers_spawned_throughout_lifetime_;
+    return p_actual_instance_->total_borrowers_spawned_throughout_lifetime_ +
+           p_actual_instance_->TotalStripedBorrowersSpawned();
   }
 
  protected:
@@ -273,7 +377,11 @@ class WeakBorrowed {
       // 2) When the object is destructing, to indicate this borrower has released it, to decrement
       //    the active borrowers counter, and trigger a condition variable `*p_actual_instance_` is waiting on
       //    if this counter has reached zero with this unregistration.
-      p_actual_instance_->UnRegisterBorrower(key_);
+      if (instance_t::IsStripedBorrowerKey(key_)) {
+        p_actual_instance_->UnRegisterStripedBorrower(key_);
+      } else {
+        p_actual_instance_->UnRegisterBorrower(key_);
+      }
       key_ = 0u;
     }
     p_actual_instance_ = nullptr;
@@ -399,19 +507,19 @@ class Borrowed final : public WeakBorrowed<T> {
   using base_t = WeakBorrowed<T>;
 
  public:
-  Borrowed(const Borrowed& rhs) : base_t(impl::ConstructBorrowed(), rhs, []() {}) {}
+  Borrowed(const Borrowed& rhs) : base_t(impl::ConstructBorrowed(), rhs, nullptr) {}
 
-  Borrowed(Borrowed&& rhs) : base_t(impl::ConstructBorrowedObjectViaMoveConstructor(), std::move(rhs), []() {}) {}
+  Borrowed(Borrowed&& rhs) : base_t(impl::ConstructBorrowedObjectViaMoveConstructor(), std::move(rhs), nullptr) {}
 
   Borrowed& operator=(Borrowed&& rhs) {
-    base_t::MoveFrom(std::move(rhs), []() {});
+    base_t::MoveFrom(std::move(rhs), nullptr);
     return *this;
   }
 
-  Borrowed(const WeakBorrowed<T>& rhs) : base_t(impl::ConstructBorrowed(), rhs, []() {}) {}
+  Borrowed(const WeakBorrowed<T>& rhs) : base_t(impl::ConstructBorrowed(), rhs, nullptr) {}
 
   Borrowed(WeakBorrowed<T>&& rhs)
-      : base_t(impl::ConstructBorrowedObjectViaMoveConstructor(), std::move(rhs), []() {}) {}
+      : base_t(impl::ConstructBorrowedObjectViaMoveConstructor(), std::move(rhs), nullptr) {}
 
   void operator=(std::nullptr_t) { base_t::InternalUnRegister(); }
 
@@ -449,7 +557,7 @@ class BorrowedOfGuaranteedLifetime final : public WeakBorrowed<T> {
   void operator=(std::nullptr_t) { base_t::InternalUnRegister(); }
 
   BorrowedOfGuaranteedLifetime(BorrowedOfGuaranteedLifetime&& rhs)
-      : base_t(impl::ConstructBorrowedObjectViaMoveConstructor(), std::move(rhs), []() {}) {}
+      : base_t(impl::ConstructBorrowedObjectViaMoveConstructor(), std::move(rhs), nullptr) {}
 
   BorrowedOfGuaranteedLifetime& operator=(BorrowedOfGuaranteedLifetime&& rhs) {
     base_t::MoveFrom(std::move(rhs), BorrowedOfGuaranteedLifetimeInvariantErrorCallback);
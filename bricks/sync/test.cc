@@ -22,10 +22,17 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 *******************************************************************************/
 
+#include "executor.h"
+#include "locks.h"
 #include "owned_borrowed.h"
 #include "waitable_atomic.h"
 
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <stdexcept>
 #include <thread>
+#include <vector>
 
 #include "../../3rdparty/gtest/gtest-main.h"
 
@@ -253,6 +260,119 @@ TEST(OwnedBorrowed, UseInternalIsDestructingGetter) {
   thread->join();
 }
 
+// `current::Borrowed<>`-s are created and destroyed from many threads at once, and the owner waits for all of them.
+TEST(OwnedBorrowed, ManyThreadsChurningBorrowed) {
+  std::atomic_int value(0);
+  std::vector<std::thread> threads;
+  {
+    current::Owned<std::atomic_int*> x(current::ConstructOwned<std::atomic_int*>(), &value);
+    for (int i = 0; i < 8; ++i) {
+      threads.emplace_back(
+          [](current::Borrowed<std::atomic_int*> y) {
+            while (y) {
+              // The borrowers spawned by the borrowers, possibly on the stripes of the other threads.
+              current::Borrowed<std::atomic_int*> z(y);
+              current::Borrowed<std::atomic_int*> w(std::move(z));
+              ++**w;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            ++**y;
+          },
+          current::Borrowed<std::atomic_int*>(x));
+    }
+    while (value < 10000) {
+      std::this_thread::yield();
+    }
+    EXPECT_GE(x.NumberOfActiveBorrowers(), 8u);
+    EXPECT_LE(x.NumberOfActiveBorrowers(), 24u);
+    EXPECT_GE(x.TotalBorrowersSpawnedThroughoutLifetime(), 10008u);
+  }
+  // All the threads have made their last increment by now.
+  const int final_value = value;
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(final_value, value);
+}
+
+// A `current::Borrowed<>` moved into a `current::BorrowedWithCallback<>` has its callback called.
+TEST(OwnedBorrowed, BorrowedMovedIntoBorrowedWithCallback) {
+  std::string log;
+  std::unique_ptr<current::BorrowedWithCallback<int>> y;
+  std::thread thread;
+  {
+    current::Owned<int> x(current::ConstructOwned<int>(), 0);
+    current::Borrowed<int> z(x);
+    EXPECT_EQ(1u, x.NumberOfActiveBorrowers());
+    EXPECT_EQ(1u, x.TotalBorrowersSpawnedThroughoutLifetime());
+    y = std::make_unique<current::BorrowedWithCallback<int>>(std::move(z), [&]() {
+      log += "Terminating.\n";
+      thread = std::thread([&y]() { y = nullptr; });
+    });
+    EXPECT_FALSE(static_cast<bool>(z));
+    EXPECT_EQ(1u, x.NumberOfActiveBorrowers());
+    EXPECT_EQ(1u, x.TotalBorrowersSpawnedThroughoutLifetime());
+  }
+  EXPECT_EQ("Terminating.\n", log);
+  thread.join();
+}
+
+TEST(Locks, SharedAndExclusive) {
+  using current::locks::MutexLockStatus;
+  std::shared_mutex mutex;
+  std::atomic_int readers(0);
+  std::atomic_int max_readers(0);
+  std::vector<std::thread> threads;
+  // The readers hold the shared lock at once, until all four are in.
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&]() {
+      current::locks::SmartSharedMutexLockGuard<MutexLockStatus::NeedToLock> lock(mutex);
+      max_readers = std::max(max_readers.load(), ++readers);
+      while (max_readers < 4) {
+        std::this_thread::yield();
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(4, max_readers);
+  {
+    current::locks::SmartMutexLockGuard<MutexLockStatus::NeedToLock, std::shared_mutex> lock(mutex);
+    EXPECT_FALSE(mutex.try_lock_shared());
+    current::locks::SmartSharedMutexLockGuard<MutexLockStatus::AlreadyLocked> no_op(mutex);
+  }
+  EXPECT_TRUE(mutex.try_lock_shared());
+  mutex.unlock_shared();
+}
+
+TEST(Locks, StripedMutex) {
+  current::locks::StripedMutex<8u> striped;
+  EXPECT_EQ(&striped.For(std::string("foo")), &striped.For(std::string("foo")));
+  {
+    std::lock_guard<std::mutex> lock(striped.For(42));
+    EXPECT_EQ(&striped.For(42), &striped.Stripe(std::hash<int>()(42) % 8u));
+  }
+  int counter = 0;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&striped, &counter, i]() {
+      for (int j = 0; j < 1000; ++j) {
+        if (j % 10 == 0) {
+          current::locks::StripedMutex<8u>::AllStripesLockGuard lock(striped);
+          ++counter;
+        } else {
+          std::lock_guard<std::mutex> lock(striped.For(i * 1000 + j));
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(400, counter);
+}
+
 TEST(WaitableAtomic, Smoke) {
   using current::WaitableAtomic;
 
@@ -388,3 +508,144 @@ TEST(WaitableAtomic, NotifiesOfChangesInWait) {
   obj.MutableScopedAccessor()->done = true;
   t.join();
 }
+
+TEST(WaitableAtomic, WakesUpTheWaitersAsTheirPredicatesHold) {
+  current::WaitableAtomic<int> value(0);
+  std::atomic_int awake(0);
+
+  // Each of the eight waiters waits for its own value, and the updates in between do not wake it up.
+  std::vector<std::thread> waiters;
+  for (int i = 1; i <= 8; ++i) {
+    waiters.emplace_back([&value, &awake, i]() {
+      value.Wait([i](int v) { return v >= i * 1000; });
+      ++awake;
+    });
+  }
+  for (int i = 1; i <= 8; ++i) {
+    for (int j = 0; j < 999; ++j) {
+      ++*value.MutableScopedAccessor();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_EQ(i - 1, awake);
+    ++*value.MutableScopedAccessor();
+    while (awake != i) {
+      std::this_thread::yield();
+    }
+  }
+  for (auto& t : waiters) {
+    t.join();
+  }
+
+  // The waits which time out leave no waiters behind.
+  EXPECT_FALSE(value.WaitFor([](int v) { return v < 0; }, std::chrono::milliseconds(5)));
+  EXPECT_TRUE(value.WaitFor([](int v) { return v == 8000; }, std::chrono::milliseconds(5)));
+  value.SetValue(42);
+  EXPECT_EQ(42, value.GetValue());
+}
+
+TEST(WaitableAtomic, ManyUpdatersAndWaiters) {
+  current::WaitableAtomic<int> value(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&value]() {
+      for (int j = 0; j < 10000; ++j) {
+        value.MutableUse([](int& v) { ++v; });
+      }
+    });
+  }
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&value, i]() { value.Wait([i](int v) { return v >= 10000 * (i + 1); }); });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(40000, value.GetValue());
+}
+
+TEST(WorkStealingExecutor, Submit) {
+  current::WorkStealingExecutor executor(4);
+  EXPECT_EQ(4u, executor.WorkersCount());
+  std::vector<current::Future<int>> futures;
+  for (int i = 0; i < 100; ++i) {
+    futures.push_back(executor.Submit([i]() { return i * i; }));
+  }
+  int total = 0;
+  for (auto& f : futures) {
+    total += f.Go();
+  }
+  EXPECT_EQ(328350, total);
+
+  // The tasks submitted from within the tasks.
+  current::Future<int> nested = executor.Submit([&executor]() { return executor.Submit([]() { return 42; }).Go(); });
+  EXPECT_EQ(42, nested.Go());
+
+  current::Future<int> failed = executor.Submit([]() -> int { throw std::logic_error("failed"); });
+  EXPECT_THROW(failed.Go(), std::logic_error);
+}
+
+TEST(WorkStealingExecutor, RunsAllThePostedTasksBeforeDestructing) {
+  std::atomic_int counter(0);
+  {
+    current::WorkStealingExecutor executor(3);
+    for (int i = 0; i < 1000; ++i) {
+      executor.Post([&counter, &executor]() {
+        ++counter;
+        executor.Post([&counter]() { ++counter; });
+      });
+    }
+  }
+  EXPECT_EQ(2000, counter);
+}
+
+TEST(WorkStealingExecutor, StealsTheTasksOfTheBusyWorker) {
+  current::WorkStealingExecutor executor(4);
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+  // All the tasks go to the deque of the worker that runs the outer one, and the idle workers steal them.
+  executor
+      .Submit([&]() {
+        std::vector<current::Future<void>> futures;
+        for (int i = 0; i < 40; ++i) {
+          futures.push_back(executor.Submit([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            std::lock_guard<std::mutex> lock(mutex);
+            threads.insert(std::this_thread::get_id());
+          }));
+        }
+        for (auto& f : futures) {
+          f.Go();
+        }
+      })
+      .Go();
+  EXPECT_GT(threads.size(), 1u);
+}
+
+TEST(WorkStealingExecutor, ParallelFor) {
+  current::WorkStealingExecutor executor(4);
+  std::vector<int> values(100000);
+  executor.ParallelFor(0u, values.size(), [&values](size_t i) { values[i] = static_cast<int>(i % 7); });
+  int64_t total = 0;
+  for (int v : values) {
+    total += v;
+  }
+  EXPECT_EQ(299995, total);
+
+  executor.ParallelFor(5u, 5u, [](size_t) { ASSERT_TRUE(false); });
+
+  // Nested, from within the tasks of the outer one.
+  std::atomic<int64_t> nested(0);
+  executor.ParallelFor(0u, 100u, [&](size_t i) { executor.ParallelFor(0u, 100u, [&](size_t j) { nested += i * j; }); });
+  EXPECT_EQ(24502500, nested);
+
+  std::atomic_int calls(0);
+  EXPECT_THROW(executor.ParallelFor(0u,
+                                    1000u,
+                                    [&calls](size_t i) {
+                                      ++calls;
+                                      if (i == 500u) {
+                                        throw std::runtime_error("500");
+                                      }
+                                    }),
+               std::runtime_error);
+  EXPECT_GT(calls, 0);
+}
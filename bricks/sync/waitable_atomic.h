@@ -24,14 +24,31 @@ SOFTWARE.
 
 // WaitableAtomic<T> acts as an atomic wrapper over type T with one additional feature: the clients
 // can wait for updates on this object instead of using spin locks or other external waiting primitives.
+//
+// The waiters register their predicates, and each update evaluates them, under the lock, to only wake up the waiters
+// whose predicates now hold. So an update with no one to wake up costs no system call, and the waiters are not
+// woken up by the updates they do not wait for. The waiters spin for a while before parking, on a futex on Linux.
 
 #ifndef BRICKS_WAITABLE_ATOMIC_H
 #define BRICKS_WAITABLE_ATOMIC_H
 
+#include "../../port.h"
+
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <map>
 #include <mutex>
+#include <thread>
+
+#ifdef CURRENT_POSIX
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif  // CURRENT_POSIX
 
 #ifdef CURRENT_FOR_CPP14
 #include "../template/weed.h"
@@ -108,6 +125,125 @@ struct WaitableAtomicSubscriberRemover {
 
 using WaitableAtomicSubscriberScope = std::unique_ptr<WaitableAtomicSubscriberRemover>;
 
+namespace impl {
+
+// The thread waiting on a `WaitableAtomic`, linked into its list of waiters while its predicate does not hold.
+// Signaled, and unlinked, by the update after which `ready()` returns `true`, with the lock of the data held.
+// The waiter needs that lock to return, so the one signaling it never outlives it.
+class WaitableAtomicWaiter final {
+ public:
+  // How many times the waiter yields before parking.
+  constexpr static int kSpinsBeforeParking = 64;
+
+  explicit WaitableAtomicWaiter(std::function<bool()> ready) : ready(std::move(ready)) {}
+
+  // Returns `true` once signaled, or `false` if `deadline` has passed first.
+  bool Park(const std::chrono::steady_clock::time_point* deadline) {
+    for (int i = 0; i < kSpinsBeforeParking; ++i) {
+      if (signaled_.load()) {
+        return true;
+      }
+      std::this_thread::yield();
+    }
+#ifdef CURRENT_POSIX
+    while (!signaled_.load()) {
+      struct timespec timeout;
+      if (deadline) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= *deadline) {
+          return false;
+        }
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(*deadline - now).count();
+        timeout.tv_sec = static_cast<time_t>(ns / 1000000000);
+        timeout.tv_nsec = static_cast<long>(ns % 1000000000);
+      }
+      ::syscall(SYS_futex,
+                reinterpret_cast<uint32_t*>(&signaled_),
+                FUTEX_WAIT_PRIVATE,
+                0u,
+                deadline ? &timeout : nullptr,
+                nullptr,
+                0);
+    }
+    return true;
+#else
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto signaled = [this]() { return signaled_.load(); };
+    if (deadline) {
+      return condition_variable_.wait_until(lock, *deadline, signaled);
+    } else {
+      condition_variable_.wait(lock, signaled);
+      return true;
+    }
+#endif  // CURRENT_POSIX
+  }
+
+  void Signal() {
+#ifdef CURRENT_POSIX
+    signaled_.store(1u);
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&signaled_), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else
+    std::lock_guard<std::mutex> lock(mutex_);
+    signaled_.store(1u);
+    condition_variable_.notify_one();
+#endif  // CURRENT_POSIX
+  }
+
+  const std::function<bool()> ready;
+  WaitableAtomicWaiter* prev = nullptr;
+  WaitableAtomicWaiter* next = nullptr;
+  bool linked = false;
+
+ private:
+  std::atomic<uint32_t> signaled_{0u};
+#ifndef CURRENT_POSIX
+  std::mutex mutex_;
+  std::condition_variable condition_variable_;
+#endif  // CURRENT_POSIX
+};
+
+// The intrusive list of waiters, accessed under the lock of the data only.
+class WaitableAtomicWaiters final {
+ public:
+  void Link(WaitableAtomicWaiter* waiter) {
+    waiter->prev = nullptr;
+    waiter->next = head_;
+    if (head_) {
+      head_->prev = waiter;
+    }
+    head_ = waiter;
+    waiter->linked = true;
+  }
+
+  void Unlink(WaitableAtomicWaiter* waiter) {
+    if (waiter->linked) {
+      (waiter->prev ? waiter->prev->next : head_) = waiter->next;
+      if (waiter->next) {
+        waiter->next->prev = waiter->prev;
+      }
+      waiter->linked = false;
+    }
+  }
+
+  // Signals, and unlinks, the waiters whose predicates now hold.
+  void SignalReady() {
+    WaitableAtomicWaiter* waiter = head_;
+    while (waiter) {
+      WaitableAtomicWaiter* next = waiter->next;
+      if (waiter->ready()) {
+        Unlink(waiter);
+        waiter->Signal();
+      }
+      waiter = next;
+    }
+  }
+
+ private:
+  WaitableAtomicWaiter* head_ = nullptr;
+};
+
+}  // namespace impl
+
 template <typename DATA>
 class WaitableAtomic {
  public:
@@ -182,8 +318,9 @@ class WaitableAtomic {
 
   MutableAccessor MutableScopedAccessor() { return MutableAccessor(this); }
 
+  // Must be called with the data locked, as the mutable accessors do, to evaluate the predicates of the waiters.
   void Notify() {
-    data_condition_variable_.notify_all();
+    waiters_.SignalReady();
     {
       // Only lock the subscribers, no need to lock the data.
       // Friendly reminder that the subscribers are expected to return quickly.
@@ -201,11 +338,7 @@ class WaitableAtomic {
 
   bool Wait(std::function<bool(const data_t&)> pred = [](const data_t& e) { return static_cast<bool>(e); }) const {
     std::unique_lock<std::mutex> lock(data_mutex_);
-    if (!pred(data_)) {
-      const data_t& data = data_;
-      data_condition_variable_.wait(lock, [&pred, &data] { return pred(data); });
-    }
-    return true;
+    return WaitLocked(lock, pred, nullptr);
   }
 
 #ifndef CURRENT_FOR_CPP14
@@ -213,51 +346,43 @@ class WaitableAtomic {
   // NOTE(dkorolev): Deliberately not bothering with C++14 for this two-lambdas `Wait()`.
   // TODO(dkorolev): The `.Wait()` above always returning `true` could use some TLC.
 
+  // As `retval_predicate` may mutate the data, the others are notified once it returns, with the data still locked.
   template <typename F>
   std::invoke_result_t<F, data_t&> DoWait(std::function<bool(const data_t&)> wait_predicate, F&& retval_predicate) {
+    struct NotifyAtScopeExit final {
+      WaitableAtomic* self;
+      ~NotifyAtScopeExit() { self->Notify(); }
+    };
     std::unique_lock<std::mutex> lock(data_mutex_);
-    if (!wait_predicate(data_)) {
-      const data_t& data = data_;
-      data_condition_variable_.wait(lock, [&wait_predicate, &data]() { return wait_predicate(data); });
-      return retval_predicate(data_);
-    } else {
-      return retval_predicate(data_);
-    }
+    WaitLocked(lock, wait_predicate, nullptr);
+    NotifyAtScopeExit notify{this};
+    return retval_predicate(data_);
   }
 
   template <typename F, class = std::enable_if_t<std::is_same_v<std::invoke_result_t<F, data_t&>, void>>>
   void Wait(std::function<bool(const data_t&)> wait_predicate, F&& retval_predicate) {
     DoWait(wait_predicate, std::forward<F>(retval_predicate));
-    Notify();
   }
 
   template <typename F, class = std::enable_if_t<!std::is_same_v<std::invoke_result_t<F, data_t&>, void>>>
   std::invoke_result_t<F, data_t&> Wait(std::function<bool(const data_t&)> wait_predicate, F&& retval_predicate) {
-    std::invoke_result_t<F, data_t&> retval = DoWait(wait_predicate, std::forward<F>(retval_predicate));
-    Notify();
-    return retval;
+    return DoWait(wait_predicate, std::forward<F>(retval_predicate));
   }
 
 #endif  // CURRENT_FOR_CPP14
 
   template <typename T>
   bool WaitFor(std::function<bool(const data_t&)> predicate, T duration) const {
+    const auto deadline = std::chrono::steady_clock::now() + duration;
     std::unique_lock<std::mutex> lock(data_mutex_);
-    if (!predicate(data_)) {
-      const data_t& data = data_;
-      return data_condition_variable_.wait_for(lock, duration, [&predicate, &data] { return predicate(data); });
-    }
-    return true;
+    return WaitLocked(lock, predicate, &deadline);
   }
 
   template <typename T>
   bool WaitFor(T duration) const {
+    const auto deadline = std::chrono::steady_clock::now() + duration;
     std::unique_lock<std::mutex> lock(data_mutex_);
-    if (!static_cast<bool>(data_)) {
-      const data_t& data = data_;
-      return data_condition_variable_.wait_for(lock, duration, [&data] { return static_cast<bool>(data); });
-    }
-    return true;
+    return WaitLocked(lock, [](const data_t& data) { return static_cast<bool>(data); }, &deadline);
   }
 
 #ifndef CURRENT_FOR_CPP14
@@ -268,10 +393,10 @@ class WaitableAtomic {
   std::invoke_result_t<F, data_t&> WaitFor(std::function<bool(const data_t&)> predicate,
                                            F&& retval_predicate,
                                            T duration) {
+    const auto deadline = std::chrono::steady_clock::now() + duration;
     std::unique_lock<std::mutex> lock(data_mutex_);
     if (!predicate(data_)) {
-      const data_t& data = data_;
-      if (data_condition_variable_.wait_for(lock, duration, [&predicate, &data] { return predicate(data); })) {
+      if (WaitLocked(lock, predicate, &deadline)) {
         return retval_predicate(data_);
       } else {
         // The three-argument `WaitFor()` assumes the default constructor for the return type indicates that
@@ -289,10 +414,10 @@ class WaitableAtomic {
                                            F&& retval_predicate,
                                            G&& wait_unsuccessul_predicate,
                                            T duration) {
+    const auto deadline = std::chrono::steady_clock::now() + duration;
     std::unique_lock<std::mutex> lock(data_mutex_);
     if (!predicate(data_)) {
-      const data_t& data = data_;
-      if (data_condition_variable_.wait_for(lock, duration, [&predicate, &data] { return predicate(data); })) {
+      if (WaitLocked(lock, predicate, &deadline)) {
         return retval_predicate(data_);
       } else {
         return wait_unsuccessul_predicate(data_);
@@ -385,10 +510,30 @@ class WaitableAtomic {
   }
 
  protected:
+  // Waits, with `lock` on `data_mutex_` held, until `predicate(data_)` holds, or `deadline`, if set, has passed.
+  // Returns whether the predicate holds. The predicate is also evaluated by the updates, to signal this waiter.
+  template <typename PRED>
+  bool WaitLocked(std::unique_lock<std::mutex>& lock,
+                  const PRED& predicate,
+                  const std::chrono::steady_clock::time_point* deadline) const {
+    while (!predicate(data_)) {
+      impl::WaitableAtomicWaiter waiter([this, &predicate]() { return predicate(data_); });
+      waiters_.Link(&waiter);
+      lock.unlock();
+      const bool signaled = waiter.Park(deadline);
+      lock.lock();
+      if (!signaled) {
+        waiters_.Unlink(&waiter);
+        return predicate(data_);
+      }
+    }
+    return true;
+  }
+
   data_t data_;
   std::mutex subscribers_mutex_;  // Declare the innermost mutex first.
   mutable std::mutex data_mutex_;
-  mutable std::condition_variable data_condition_variable_;
+  mutable impl::WaitableAtomicWaiters waiters_;
   std::map<size_t, std::function<void()>> subscribers_;
   size_t subscriber_next_id_ = 0u;
 
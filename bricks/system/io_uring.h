@@ -0,0 +1,311 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// `IOURing` submits many reads, writes, sends and syncs, to files and sockets alike, with a single system call,
+// and waits for all of them to complete, via the `io_uring` of Linux. A batch of small writes costs one
+// `io_uring_enter()` instead of a `write()` each. The buffers registered up front with `RegisterBuffers()` are not
+// mapped into the kernel anew for each operation, see `QueueWriteFixed()` and `QueueReadFixed()`.
+//
+// Talks to the kernel directly, with no dependency on `liburing`. Available where `CURRENT_IO_URING` is defined;
+// even then the kernel may have `io_uring` disabled, as some sandboxes do, in which case the constructor throws
+// `IOURingUnavailableException`, and `IOURing::Available()` returns `false`, for the caller to fall back.
+//
+// The operations of a batch may run concurrently and complete in any order. Use `LinkWithNext()` for the ones
+// that should not, such as the writes into the same socket, and `QueueSync()` to sync what was queued before it.
+// Not thread-safe: each thread submitting its own batches should use its own `IOURing`.
+
+#ifndef BRICKS_SYSTEM_IO_URING_H
+#define BRICKS_SYSTEM_IO_URING_H
+
+#include "../../port.h"
+
+#if defined(CURRENT_POSIX) && __has_include(<linux/io_uring.h>)
+#define CURRENT_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../exception.h"
+
+#ifdef CURRENT_IO_URING
+
+namespace current {
+namespace bricks {
+namespace system {
+
+struct IOURingException : Exception {
+  using Exception::Exception;
+};
+
+struct IOURingUnavailableException final : IOURingException {
+  using IOURingException::IOURingException;
+};
+
+class IOURing final {
+ public:
+  // The offset to read from or to write at the current position of the file, advancing it, as for the sockets.
+  constexpr static uint64_t kCurrentPosition = static_cast<uint64_t>(-1);
+
+  // Up to `entries` operations are submitted at once; queueing more submits the ones queued so far first.
+  explicit IOURing(uint32_t entries = 64u) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ < 0) {
+      CURRENT_THROW(IOURingUnavailableException(std::string("io_uring_setup: ") + std::strerror(errno)));
+    }
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP);
+    if (single_mmap) {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = Map(sq_ring_size_, IORING_OFF_SQ_RING);
+    cq_ring_ = (single_mmap || !sq_ring_) ? sq_ring_ : Map(cq_ring_size_, IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(cq_ring_ ? Map(sqes_size_, IORING_OFF_SQES) : nullptr);
+    if (!sqes_) {
+      const int error = errno;
+      Release();
+      CURRENT_THROW(IOURingUnavailableException(std::string("io_uring mmap: ") + std::strerror(error)));
+    }
+    uint8_t* const sq = static_cast<uint8_t*>(sq_ring_);
+    uint8_t* const cq = static_cast<uint8_t*>(cq_ring_);
+    sq_tail_ = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+    cq_head_ = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    entries_ = params.sq_entries;
+  }
+
+  ~IOURing() { Release(); }
+
+  // Whether `io_uring` can be used on this machine, checked once.
+  static bool Available() {
+    static const bool available = []() {
+      try {
+        IOURing probe(1u);
+        return true;
+      } catch (const IOURingUnavailableException&) {
+        return false;
+      }
+    }();
+    return available;
+  }
+
+  // Registers the buffers for the `...Fixed()` operations to refer to by their indexes. Replaces the ones
+  // registered before, if any. Must be called with no operations queued.
+  void RegisterBuffers(const std::vector<iovec>& buffers) {
+    UnregisterBuffers();
+    if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, buffers.data(), buffers.size()) < 0) {
+      CURRENT_THROW(IOURingException(std::string("io_uring_register: ") + std::strerror(errno)));
+    }
+    buffers_registered_ = true;
+  }
+
+  void UnregisterBuffers() {
+    if (buffers_registered_) {
+      ::syscall(__NR_io_uring_register, fd_, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+      buffers_registered_ = false;
+    }
+  }
+
+  // Each `Queue...()` returns the index of the operation, to find its result by in what `SubmitAndWait()` returns.
+  size_t QueueWrite(int fd, const void* data, size_t length, uint64_t offset = kCurrentPosition) {
+    return QueueReadOrWrite(IORING_OP_WRITE, fd, data, length, offset);
+  }
+  size_t QueueWriteV(int fd, const iovec* buffers, size_t count, uint64_t offset = kCurrentPosition) {
+    return QueueReadOrWrite(IORING_OP_WRITEV, fd, buffers, count, offset);
+  }
+  // `data` must lie within the registered buffer `buffer_index`.
+  size_t QueueWriteFixed(
+      int fd, size_t buffer_index, const void* data, size_t length, uint64_t offset = kCurrentPosition) {
+    const size_t index = QueueReadOrWrite(IORING_OP_WRITE_FIXED, fd, data, length, offset);
+    last_sqe_->buf_index = static_cast<uint16_t>(buffer_index);
+    return index;
+  }
+  size_t QueueRead(int fd, void* data, size_t length, uint64_t offset = kCurrentPosition) {
+    return QueueReadOrWrite(IORING_OP_READ, fd, data, length, offset);
+  }
+  size_t QueueReadFixed(int fd, size_t buffer_index, void* data, size_t length, uint64_t offset = kCurrentPosition) {
+    const size_t index = QueueReadOrWrite(IORING_OP_READ_FIXED, fd, data, length, offset);
+    last_sqe_->buf_index = static_cast<uint16_t>(buffer_index);
+    return index;
+  }
+  // Never raises `SIGPIPE`, the peer having closed the connection results in `-EPIPE`.
+  size_t QueueSend(int fd, const void* data, size_t length) {
+    io_uring_sqe& sqe = NextSQE(IORING_OP_SEND, fd);
+    sqe.addr = reinterpret_cast<uint64_t>(data);
+    sqe.len = static_cast<uint32_t>(length);
+    sqe.msg_flags = MSG_NOSIGNAL;
+    return results_.size() - 1u;
+  }
+  // `fdatasync()`-s, or `fsync()`-s, the file once all the operations queued before have completed.
+  size_t QueueSync(int fd, bool data_only = true) {
+    io_uring_sqe& sqe = NextSQE(IORING_OP_FSYNC, fd);
+    sqe.fsync_flags = data_only ? IORING_FSYNC_DATASYNC : 0u;
+    sqe.flags |= IOSQE_IO_DRAIN;
+    return results_.size() - 1u;
+  }
+
+  // Has the operation queued last complete before the next one queued starts. Should it fail, or transfer fewer
+  // bytes than asked to, the operations linked to it fail with `-ECANCELED`.
+  void LinkWithNext() {
+    if (last_sqe_) {
+      last_sqe_->flags |= IOSQE_IO_LINK;
+    }
+  }
+
+  size_t Queued() const { return results_.size(); }
+
+  // Submits the operations queued, waits for all of them to complete, and returns their results, in the order they
+  // were queued: the number of bytes transferred, or `-errno`, as the respective system calls would return.
+  std::vector<int32_t> SubmitAndWait() {
+    SubmitQueued();
+    last_sqe_ = nullptr;
+    next_to_submit_ = 0u;
+    std::vector<int32_t> results;
+    results.swap(results_);
+    return results;
+  }
+
+ private:
+  IOURing(const IOURing&) = delete;
+  IOURing& operator=(const IOURing&) = delete;
+
+  void* Map(size_t size, off_t offset) {
+    void* result = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+    return result == MAP_FAILED ? nullptr : result;
+  }
+
+  void Release() {
+    if (sqes_) {
+      ::munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ && cq_ring_ != sq_ring_) {
+      ::munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_) {
+      ::munmap(sq_ring_, sq_ring_size_);
+    }
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  size_t QueueReadOrWrite(uint8_t opcode, int fd, const void* data, size_t length, uint64_t offset) {
+    io_uring_sqe& sqe = NextSQE(opcode, fd);
+    sqe.addr = reinterpret_cast<uint64_t>(data);
+    sqe.len = static_cast<uint32_t>(length);
+    sqe.off = offset;
+    return results_.size() - 1u;
+  }
+
+  io_uring_sqe& NextSQE(uint8_t opcode, int fd) {
+    if (results_.size() - next_to_submit_ == entries_) {
+      // The link chains do not span the submissions, as the ones in flight would not wait for the ones queued next.
+      last_sqe_->flags &= static_cast<uint8_t>(~IOSQE_IO_LINK);
+      SubmitQueued();
+    }
+    const uint32_t tail = *sq_tail_;
+    const uint32_t index = tail & sq_mask_;
+    io_uring_sqe& sqe = sqes_[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.user_data = results_.size();
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1u, __ATOMIC_RELEASE);
+    results_.push_back(0);
+    last_sqe_ = &sqe;
+    return sqe;
+  }
+
+  void SubmitQueued() {
+    uint32_t to_submit = static_cast<uint32_t>(results_.size() - next_to_submit_);
+    uint32_t to_complete = to_submit;
+    next_to_submit_ = results_.size();
+    while (to_complete) {
+      const int submitted = static_cast<int>(
+          ::syscall(__NR_io_uring_enter, fd_, to_submit, 1u, IORING_ENTER_GETEVENTS, nullptr, 0));
+      if (submitted < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        CURRENT_THROW(IOURingException(std::string("io_uring_enter: ") + std::strerror(errno)));  // LCOV_EXCL_LINE
+      }
+      to_submit -= std::min(to_submit, static_cast<uint32_t>(submitted));
+      uint32_t head = *cq_head_;
+      const uint32_t tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      for (; head != tail; ++head) {
+        const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        results_[static_cast<size_t>(cqe.user_data)] = cqe.res;
+        --to_complete;
+      }
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+  }
+
+  int fd_ = -1;
+  void* sq_ring_ = nullptr;
+  void* cq_ring_ = nullptr;
+  io_uring_sqe* sqes_ = nullptr;
+  size_t sq_ring_size_ = 0u;
+  size_t cq_ring_size_ = 0u;
+  size_t sqes_size_ = 0u;
+  uint32_t* sq_tail_ = nullptr;
+  uint32_t sq_mask_ = 0u;
+  uint32_t* sq_array_ = nullptr;
+  uint32_t* cq_head_ = nullptr;
+  uint32_t* cq_tail_ = nullptr;
+  uint32_t cq_mask_ = 0u;
+  io_uring_cqe* cqes_ = nullptr;
+  uint32_t entries_ = 0u;
+  bool buffers_registered_ = false;
+  io_uring_sqe* last_sqe_ = nullptr;
+  // The results of the operations queued since the last `SubmitAndWait()`, the first `next_to_submit_` submitted.
+  std::vector<int32_t> results_;
+  size_t next_to_submit_ = 0u;
+};
+
+}  // namespace system
+}  // namespace bricks
+}  // namespace current
+
+#endif  // CURRENT_IO_URING
+
+#endif  // BRICKS_SYSTEM_IO_URING_H
@@ -0,0 +1,278 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// The placement of the threads of Current onto the CPUs, and of the memory they work with onto the NUMA nodes.
+//
+// By default, the threads are placed by the OS. Once `ThreadPlacementPolicy().Set(role, cpus)` is called, the threads
+// of that role started from then on restrict themselves to the CPUs of `cpus`, i.e. the HTTP server threads, the
+// stream subscriber threads, the MMQ consumer threads, or the replicator threads. The CPU sets are usually the ones
+// of the NUMA nodes, see `CPUSet::OfNUMANode()`, so that the data passed between the threads stays on one socket.
+//
+// The memory is placed onto the NUMA node of the thread that first touches it. For the memory allocated by one thread
+// and then worked with by another, `MoveMemoryToNUMANode()` migrates the pages of it to where they are used.
+//
+// All of this is Linux-only, and does nothing elsewhere.
+
+#ifndef BRICKS_SYSTEM_PLACEMENT_H
+#define BRICKS_SYSTEM_PLACEMENT_H
+
+#include "../../port.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../exception.h"
+#include "../file/file.h"
+#include "../strings/split.h"
+#include "../strings/util.h"
+#include "../util/singleton.h"
+
+#if defined(CURRENT_POSIX) && !defined(CURRENT_APPLE)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define CURRENT_THREAD_PLACEMENT
+#endif
+
+namespace current {
+namespace bricks {
+namespace system {
+
+struct CPUSetParseException final : Exception {
+  using Exception::Exception;
+};
+
+// A set of CPUs. The empty set places no restrictions.
+class CPUSet final {
+ public:
+  CPUSet() = default;
+  CPUSet(std::initializer_list<size_t> cpus) {
+    for (size_t cpu : cpus) {
+      Add(cpu);
+    }
+  }
+
+  // Parses the `cpulist` format of Linux, such as "0-3,8,10-11". Throws `CPUSetParseException` on malformed input.
+  static CPUSet Parse(const std::string& cpulist) {
+    CPUSet result;
+    for (const std::string& range : current::strings::Split(cpulist, ',')) {
+      const std::vector<std::string> bounds = current::strings::Split(range, '-', current::strings::EmptyFields::Keep);
+      if (bounds.empty() || bounds.size() > 2u) {
+        CURRENT_THROW(CPUSetParseException(cpulist));
+      }
+      const size_t first = ParseCPU(bounds.front(), cpulist);
+      const size_t last = ParseCPU(bounds.back(), cpulist);
+      if (last < first) {
+        CURRENT_THROW(CPUSetParseException(cpulist));
+      }
+      for (size_t cpu = first; cpu <= last; ++cpu) {
+        result.Add(cpu);
+      }
+    }
+    return result;
+  }
+
+  // The CPUs of the NUMA node, or the empty set if there is no such node, or no NUMA at all.
+  static CPUSet OfNUMANode(size_t node) {
+    try {
+      return Parse(current::strings::Trim(current::FileSystem::ReadFileAsString(
+          "/sys/devices/system/node/node" + current::ToString(node) + "/cpulist")));
+    } catch (const current::Exception&) {
+      return CPUSet();
+    }
+  }
+
+  // The CPUs the calling thread is allowed to run on, or the empty set if unknown.
+  static CPUSet OfCurrentThread() {
+    CPUSet result;
+#ifdef CURRENT_THREAD_PLACEMENT
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (!::pthread_getaffinity_np(::pthread_self(), sizeof(cpu_set), &cpu_set)) {
+      for (size_t cpu = 0u; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &cpu_set)) {
+          result.Add(cpu);
+        }
+      }
+    }
+#endif  // CURRENT_THREAD_PLACEMENT
+    return result;
+  }
+
+  void Add(size_t cpu) {
+    if (cpu >= bits_.size() * 64u) {
+      bits_.resize(cpu / 64u + 1u);
+    }
+    bits_[cpu / 64u] |= (1ull << (cpu % 64u));
+  }
+  bool Has(size_t cpu) const { return cpu < bits_.size() * 64u && (bits_[cpu / 64u] & (1ull << (cpu % 64u))); }
+  bool Empty() const { return CPUs().empty(); }
+
+  std::vector<size_t> CPUs() const {
+    std::vector<size_t> result;
+    for (size_t cpu = 0u; cpu < bits_.size() * 64u; ++cpu) {
+      if (Has(cpu)) {
+        result.push_back(cpu);
+      }
+    }
+    return result;
+  }
+
+  // In the `cpulist` format, as accepted by `Parse()`.
+  std::string ToString() const {
+    std::string result;
+    const std::vector<size_t> cpus = CPUs();
+    for (size_t i = 0u; i < cpus.size();) {
+      size_t j = i;
+      while (j + 1u < cpus.size() && cpus[j + 1u] == cpus[j] + 1u) {
+        ++j;
+      }
+      result += (result.empty() ? "" : ",") + current::ToString(cpus[i]);
+      if (j > i) {
+        result += '-' + current::ToString(cpus[j]);
+      }
+      i = j + 1u;
+    }
+    return result;
+  }
+
+  bool operator==(const CPUSet& rhs) const { return CPUs() == rhs.CPUs(); }
+  bool operator!=(const CPUSet& rhs) const { return !operator==(rhs); }
+
+ private:
+  static size_t ParseCPU(const std::string& s, const std::string& cpulist) {
+    if (s.empty() || s.find_first_not_of("0123456789") != std::string::npos) {
+      CURRENT_THROW(CPUSetParseException(cpulist));
+    }
+    return current::FromString<size_t>(s);
+  }
+
+  std::vector<uint64_t> bits_;
+};
+
+// Restricts the calling thread to the CPUs of `cpus`, unless the set is empty. Returns whether the OS has agreed.
+inline bool PlaceCurrentThreadOnCPUs(const CPUSet& cpus) {
+#ifdef CURRENT_THREAD_PLACEMENT
+  const std::vector<size_t> list = cpus.CPUs();
+  if (list.empty()) {
+    return false;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (size_t cpu : list) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &cpu_set);
+    }
+  }
+  return !::pthread_setaffinity_np(::pthread_self(), sizeof(cpu_set), &cpu_set);
+#else
+  static_cast<void>(cpus);
+  return false;
+#endif  // CURRENT_THREAD_PLACEMENT
+}
+
+// The NUMA node the calling thread is running on at the moment, or -1 if unknown.
+inline int CurrentNUMANode() {
+#ifdef CURRENT_THREAD_PLACEMENT
+  const int cpu = ::sched_getcpu();
+  if (cpu >= 0) {
+    for (size_t node = 0u; current::FileSystem::IsDir("/sys/devices/system/node/node" + current::ToString(node));
+         ++node) {
+      if (CPUSet::OfNUMANode(node).Has(static_cast<size_t>(cpu))) {
+        return static_cast<int>(node);
+      }
+    }
+  }
+#endif  // CURRENT_THREAD_PLACEMENT
+  return -1;
+}
+
+// Migrates the pages of the memory range, and has the ones not yet touched allocated, on the NUMA node.
+// The pages are whole, so the memory next to the range is migrated too. Returns whether the OS has agreed.
+inline bool MoveMemoryToNUMANode(const void* data, size_t size, int node) {
+#if defined(CURRENT_THREAD_PLACEMENT) && defined(SYS_mbind)
+  constexpr static int kMPOL_PREFERRED = 1;
+  constexpr static unsigned kMPOL_MF_MOVE = 1u << 1;
+  if (node < 0 || node >= 64 || !size) {
+    return false;
+  }
+  const uintptr_t page_size = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(data) & ~(page_size - 1u);
+  const uintptr_t end = reinterpret_cast<uintptr_t>(data) + size;
+  const unsigned long node_mask = 1ul << node;
+  return !::syscall(SYS_mbind, begin, end - begin, kMPOL_PREFERRED, &node_mask, 64ul, kMPOL_MF_MOVE);
+#else
+  static_cast<void>(data);
+  static_cast<void>(size);
+  static_cast<void>(node);
+  return false;
+#endif
+}
+
+// The kinds of the threads of Current that are placed according to `ThreadPlacementPolicy()`.
+enum class ThreadRole : int { HTTPServer = 0, StreamSubscriber, MMQConsumer, Replicator };
+constexpr static size_t kThreadRolesCount = 4u;
+
+class ThreadPlacement final {
+ public:
+  // Applies to the threads of the role started from now on.
+  void Set(ThreadRole role, CPUSet cpus) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cpus_[static_cast<size_t>(role)] = std::move(cpus);
+  }
+
+  CPUSet Get(ThreadRole role) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cpus_[static_cast<size_t>(role)];
+  }
+
+  // Called by the threads of Current as they start. Returns whether the thread has been placed.
+  bool PlaceCurrentThread(ThreadRole role) const { return PlaceCurrentThreadOnCPUs(Get(role)); }
+
+  // Same as above, and, once placed, moves the memory the thread works with the most, e.g. the ring buffer of an
+  // MMQ, to the NUMA node of the thread.
+  bool PlaceCurrentThread(ThreadRole role, const void* local_data, size_t local_size) const {
+    if (PlaceCurrentThread(role)) {
+      MoveMemoryToNUMANode(local_data, local_size, CurrentNUMANode());
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  CPUSet cpus_[kThreadRolesCount];
+};
+
+inline ThreadPlacement& ThreadPlacementPolicy() { return current::Singleton<ThreadPlacement>(); }
+
+}  // namespace system
+}  // namespace bricks
+}  // namespace current
+
+#endif  // BRICKS_SYSTEM_PLACEMENT_H
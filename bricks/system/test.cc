@@ -24,6 +24,8 @@ SOFTWARE.
 
 #define BRICKS_RANDOM_FIX_SEED
 
+#include "io_uring.h"
+#include "placement.h"
 #include "syscalls.h"
 
 #include "../dflags/dflags.h"
@@ -33,6 +35,10 @@ SOFTWARE.
 
 #include <thread>
 
+#ifdef CURRENT_IO_URING
+#include <fcntl.h>
+#endif  // CURRENT_IO_URING
+
 DEFINE_string(current_base_dir_for_dlopen_test,
               "",
               "If set, the top-level `current/` dir for `dlopen`-based integrations to symlink to.");
@@ -187,3 +193,121 @@ TEST(Syscalls, DLOpenExceptions) {
   }
 }
 #endif  // CURRENT_WINDOWS
+
+#ifdef CURRENT_IO_URING
+TEST(IOURing, WritesAndSyncsAFileInOneSubmission) {
+  using current::bricks::system::IOURing;
+  if (!IOURing::Available()) {
+    std::cerr << "Skipping, `io_uring` is disabled on this machine.\n";
+    return;
+  }
+  const std::string file_name = current::FileSystem::GenTmpFileName();
+  const auto file_remover = current::FileSystem::ScopedRmFile(file_name);
+  const int fd = ::open(file_name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+  ASSERT_GE(fd, 0);
+
+  // Fewer entries than operations, to have them submitted in more than one batch.
+  IOURing ring(4u);
+  const std::vector<std::string> parts = {"alpha ", "beta ", "gamma ", "delta ", "epsilon ", "zeta"};
+  uint64_t offset = 0u;
+  for (const std::string& part : parts) {
+    EXPECT_EQ(&part - &parts[0], static_cast<ptrdiff_t>(ring.QueueWrite(fd, part.data(), part.length(), offset)));
+    offset += part.length();
+  }
+  const iovec tail[2] = {{const_cast<char*>(" and"), 4u}, {const_cast<char*>(" eta"), 4u}};
+  ring.QueueWriteV(fd, tail, 2u, offset);
+  ring.QueueSync(fd);
+  EXPECT_EQ(8u, ring.Queued());
+  const std::vector<int32_t> results = ring.SubmitAndWait();
+  ASSERT_EQ(8u, results.size());
+  for (size_t i = 0u; i < parts.size(); ++i) {
+    EXPECT_EQ(static_cast<int32_t>(parts[i].length()), results[i]);
+  }
+  EXPECT_EQ(8, results[6]);
+  EXPECT_EQ(0, results[7]);
+  EXPECT_EQ(0u, ring.Queued());
+  EXPECT_EQ("alpha beta gamma delta epsilon zeta and eta", current::FileSystem::ReadFileAsString(file_name));
+
+  // The registered buffers.
+  std::vector<char> buffer(4096u);
+  ring.RegisterBuffers({{buffer.data(), buffer.size()}});
+  std::memcpy(buffer.data(), "ALPHA", 5u);
+  ring.QueueWriteFixed(fd, 0u, buffer.data(), 5u, 0u);
+  ring.LinkWithNext();
+  ring.QueueReadFixed(fd, 0u, buffer.data() + 100u, 10u, 0u);
+  EXPECT_EQ(std::vector<int32_t>({5, 10}), ring.SubmitAndWait());
+  EXPECT_EQ("ALPHA beta", std::string(buffer.data() + 100u, 10u));
+
+  // The errors are returned as `-errno`.
+  ring.QueueWrite(-1, "x", 1u);
+  EXPECT_EQ(std::vector<int32_t>({-EBADF}), ring.SubmitAndWait());
+
+  ::close(fd);
+}
+
+TEST(IOURing, SendsIntoASocketInOrder) {
+  using current::bricks::system::IOURing;
+  if (!IOURing::Available()) {
+    std::cerr << "Skipping, `io_uring` is disabled on this machine.\n";
+    return;
+  }
+  int fds[2];
+  ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  std::string data;
+  for (int i = 0; i < 100; ++i) {
+    data += std::to_string(i) + ',';
+  }
+  // More sends than the entries of the ring, linked to arrive in the order queued.
+  IOURing ring(16u);
+  for (size_t i = 0u; i < data.length(); i += 10u) {
+    ring.QueueSend(fds[0], data.data() + i, std::min(static_cast<size_t>(10u), data.length() - i));
+    ring.LinkWithNext();
+  }
+  size_t sent = 0u;
+  for (int32_t result : ring.SubmitAndWait()) {
+    ASSERT_GT(result, 0);
+    sent += static_cast<size_t>(result);
+  }
+  EXPECT_EQ(data.length(), sent);
+  std::string received(data.length(), '\0');
+  ring.QueueRead(fds[1], &received[0], received.length());
+  EXPECT_EQ(static_cast<int32_t>(data.length()), ring.SubmitAndWait()[0]);
+  EXPECT_EQ(data, received);
+
+  ::close(fds[0]);
+  ring.QueueSend(fds[1], "x", 1u);
+  EXPECT_EQ(std::vector<int32_t>({-EPIPE}), ring.SubmitAndWait());
+  ::close(fds[1]);
+}
+#endif  // CURRENT_IO_URING
+
+TEST(Placement, CPUSet) {
+  using current::bricks::system::CPUSet;
+  EXPECT_EQ("0-3,8,10-11", CPUSet::Parse("0-3,8,10-11").ToString());
+  EXPECT_EQ("1,3", CPUSet({3, 1}).ToString());
+  EXPECT_EQ(CPUSet({0, 1, 2}), CPUSet::Parse("0-2"));
+  EXPECT_TRUE(CPUSet::Parse("100").Has(100));
+  EXPECT_FALSE(CPUSet::Parse("100").Has(99));
+  EXPECT_TRUE(CPUSet().Empty());
+  EXPECT_THROW(CPUSet::Parse("1-"), current::bricks::system::CPUSetParseException);
+  EXPECT_THROW(CPUSet::Parse("3-1"), current::bricks::system::CPUSetParseException);
+  EXPECT_THROW(CPUSet::Parse("x"), current::bricks::system::CPUSetParseException);
+}
+
+TEST(Placement, ThreadRoles) {
+  using namespace current::bricks::system;
+  // No placement unless asked for.
+  EXPECT_FALSE(ThreadPlacementPolicy().PlaceCurrentThread(ThreadRole::MMQConsumer));
+
+  const CPUSet allowed = CPUSet::OfCurrentThread();
+  if (!allowed.Empty()) {
+    const CPUSet one_cpu({allowed.CPUs().front()});
+    ThreadPlacementPolicy().Set(ThreadRole::MMQConsumer, one_cpu);
+    std::thread([&one_cpu]() {
+      EXPECT_TRUE(ThreadPlacementPolicy().PlaceCurrentThread(ThreadRole::MMQConsumer));
+      EXPECT_EQ(one_cpu, CPUSet::OfCurrentThread());
+    }).join();
+    ThreadPlacementPolicy().Set(ThreadRole::MMQConsumer, CPUSet());
+    EXPECT_EQ(allowed, CPUSet::OfCurrentThread());
+  }
+}
@@ -47,6 +47,14 @@ SOFTWARE.
 #define timegm _mkgmtime
 #endif
 
+#if defined(CURRENT_POSIX) && defined(__GNUC__) && defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#include <cstdio>
+#include <cstring>
+#define CURRENT_TIME_TSC
+#endif
+
 namespace current {
 namespace time {
 
@@ -99,29 +107,198 @@ void SleepUntil(T) {}
 
 #else
 
+namespace impl {
+
+inline int64_t SystemEpochNanoseconds() {
+#ifdef CURRENT_POSIX
+  struct timespec ts;
+  ::clock_gettime(CLOCK_REALTIME, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000ll + static_cast<int64_t>(ts.tv_nsec);
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+#ifdef CURRENT_TIME_TSC
+
+// Between readings of `CLOCK_REALTIME`, the wall time is interpolated with the invariant TSC.
+// Each thread keeps its own anchor and re-reads the system clock every `kTSCAnchorLifetimeNs`, so jumps of the wall
+// clock are picked up with that delay at most. The ticks-to-nanoseconds ratio is measured against
+// `CLOCK_MONOTONIC_RAW`, which is neither stepped nor slewed, and is shared only to spare new threads the calibration.
+// Each thread measures the ratio over the span growing from `kTSCMinCalibrationSpanNs`, and only once the span
+// reaches `kTSCSharedCalibrationSpanNs` is the ratio shared, and is the span started anew. Until then, the ratio
+// shared earlier, if any, is preferred to the one measured over the shorter span.
+constexpr static int64_t kTSCAnchorLifetimeNs = 10ll * 1000ll * 1000ll;
+constexpr static int64_t kTSCMinCalibrationSpanNs = 1000ll * 1000ll;
+constexpr static int64_t kTSCSharedCalibrationSpanNs = 1000ll * 1000ll * 1000ll;
+// The clocks are read between two reads of the TSC, and re-read if these are further apart, as if preempted.
+constexpr static uint64_t kTSCMaxClockReadTicks = 50000ull;
+constexpr static int kTSCClockReadAttempts = 8;
+
+inline int64_t MonotonicRawNanoseconds() {
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000ll + static_cast<int64_t>(ts.tv_nsec);
+}
+
+// Only trust the TSC across cores if the CPU declares it invariant and the kernel itself uses it as the clocksource.
+inline bool TSCIsUsableWallClock() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000007u, &eax, &ebx, &ecx, &edx) || !(edx & (1u << 8))) {
+    return false;
+  }
+  FILE* f = ::fopen("/sys/devices/system/clocksource/clocksource0/current_clocksource", "r");
+  if (!f) {
+    return false;
+  }
+  char buffer[16] = {0};
+  const bool tsc = ::fgets(buffer, sizeof(buffer), f) && !::strcmp(buffer, "tsc\n");
+  ::fclose(f);
+  return tsc;
+}
+
+struct TSCCalibration {
+  std::atomic<uint64_t> ns_per_tick_q32;  // Fixed point, 32 fractional bits; zero until some thread has measured it.
+  TSCCalibration() : ns_per_tick_q32(0ull) {}
+};
+
+struct TSCClockReading {
+  uint64_t tsc = 0ull;
+  int64_t raw_ns = 0ll;
+  int64_t epoch_ns = 0ll;
+};
+
+// Returns `false` if each attempt took too long for the clocks to be attributed to the TSC between its two reads.
+inline bool TSCReadClocks(TSCClockReading& reading) {
+  for (int i = 0; i < kTSCClockReadAttempts; ++i) {
+    const uint64_t before = __rdtsc();
+    const int64_t raw_ns = MonotonicRawNanoseconds();
+    const int64_t epoch_ns = SystemEpochNanoseconds();
+    const uint64_t after = __rdtsc();
+    if (after - before < kTSCMaxClockReadTicks) {
+      reading.tsc = before + (after - before) / 2u;
+      reading.raw_ns = raw_ns;
+      reading.epoch_ns = epoch_ns;
+      return true;
+    }
+  }
+  return false;
+}
+
+struct TSCAnchor {
+  uint64_t tsc = 0ull;
+  int64_t epoch_ns = 0ll;
+  uint64_t ns_per_tick_q32 = 0ull;
+  uint64_t lifetime_ticks = 0ull;
+  uint64_t calibration_tsc = 0ull;
+  int64_t calibration_raw_ns = 0ll;
+};
+
+inline int64_t TSCReanchor(TSCAnchor& anchor) {
+  TSCClockReading reading;
+  if (!TSCReadClocks(reading)) {
+    // No anchor this time, the next call tries again.
+    anchor.lifetime_ticks = 0ull;
+    return SystemEpochNanoseconds();
+  }
+  auto& shared = Singleton<TSCCalibration>().ns_per_tick_q32;
+  const uint64_t shared_ns_per_tick_q32 = shared.load(std::memory_order_relaxed);
+  if (!anchor.calibration_tsc || reading.tsc <= anchor.calibration_tsc) {
+    anchor.calibration_tsc = reading.tsc;
+    anchor.calibration_raw_ns = reading.raw_ns;
+    anchor.ns_per_tick_q32 = shared_ns_per_tick_q32;
+  } else {
+    const int64_t span_ns = reading.raw_ns - anchor.calibration_raw_ns;
+    const uint64_t measured_ns_per_tick_q32 =
+        static_cast<uint64_t>((static_cast<unsigned __int128>(span_ns) << 32) /
+                              static_cast<uint64_t>(reading.tsc - anchor.calibration_tsc));
+    if (span_ns >= kTSCSharedCalibrationSpanNs) {
+      anchor.ns_per_tick_q32 = measured_ns_per_tick_q32;
+      shared.store(measured_ns_per_tick_q32, std::memory_order_relaxed);
+      anchor.calibration_tsc = reading.tsc;
+      anchor.calibration_raw_ns = reading.raw_ns;
+    } else if (shared_ns_per_tick_q32) {
+      anchor.ns_per_tick_q32 = shared_ns_per_tick_q32;
+    } else if (span_ns >= kTSCMinCalibrationSpanNs) {
+      anchor.ns_per_tick_q32 = measured_ns_per_tick_q32;
+    }
+  }
+  anchor.tsc = reading.tsc;
+  anchor.epoch_ns = reading.epoch_ns;
+  anchor.lifetime_ticks =
+      anchor.ns_per_tick_q32 ? (static_cast<uint64_t>(kTSCAnchorLifetimeNs) << 32) / anchor.ns_per_tick_q32 : 0ull;
+  return reading.epoch_ns;
+}
+
+inline int64_t TSCEpochNanoseconds() {
+  TSCAnchor& anchor = ThreadLocalSingleton<TSCAnchor>();
+  const uint64_t ticks = __rdtsc() - anchor.tsc;
+  if (ticks < anchor.lifetime_ticks) {
+    // Never past the lifetime of the anchor, even if rounded up.
+    return anchor.epoch_ns +
+           std::min(static_cast<int64_t>((ticks * anchor.ns_per_tick_q32) >> 32), kTSCAnchorLifetimeNs);
+  } else {
+    return TSCReanchor(anchor);
+  }
+}
+
+#endif  // CURRENT_TIME_TSC
+
+}  // namespace impl
+
 // Since chrono::system_clock is not monotonic, and chrono::steady_clock is not guaranteed to be Epoch,
-// use a simple wrapper around chrono::system_clock to make it strictly increasing.
+// use a simple wrapper around the system clock to make it strictly increasing.
+// The clock is read once per call, outside the compare-and-swap loop, and the atomic has its own cache line.
 struct EpochClockGuaranteeingMonotonicity {
-  mutable std::atomic<int64_t> monotonic_now_us;
+  alignas(64) mutable std::atomic<int64_t> monotonic_now_us;
+  const bool use_tsc;
+  char padding[64 - sizeof(std::atomic<int64_t>) - sizeof(bool)];
+
+  EpochClockGuaranteeingMonotonicity() : monotonic_now_us(0ll), use_tsc(UseTSC()) {}
 
-  EpochClockGuaranteeingMonotonicity() : monotonic_now_us(0ll) {}
+  static bool UseTSC() {
+#ifdef CURRENT_TIME_TSC
+    return impl::TSCIsUsableWallClock();
+#else
+    return false;
+#endif
+  }
+
+  const char* Implementation() const {
+#ifdef CURRENT_POSIX
+    return use_tsc ? "tsc" : "clock_gettime";
+#else
+    return "system_clock";
+#endif
+  }
+
+  inline int64_t WallClockMicroseconds() const {
+#ifdef CURRENT_TIME_TSC
+    if (use_tsc) {
+      return impl::TSCEpochNanoseconds() / 1000ll;
+    }
+#endif
+    return impl::SystemEpochNanoseconds() / 1000ll;
+  }
 
   inline std::chrono::microseconds Now() const {
-    int64_t now, previous_now;
+    const int64_t now = WallClockMicroseconds();
+    int64_t previous = monotonic_now_us.load(std::memory_order_relaxed);
+    int64_t next;
     do {
-      now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch())
-                .count();
-      previous_now = monotonic_now_us.load();
-      if (!(now > previous_now)) {
-        now = previous_now + 1;
-      }
-    } while (!monotonic_now_us.compare_exchange_strong(previous_now, now));
-    return std::chrono::microseconds(now);
+      next = (now > previous) ? now : previous + 1;
+    } while (
+        !monotonic_now_us.compare_exchange_weak(previous, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+    return std::chrono::microseconds(next);
   }
 };
 
 inline std::chrono::microseconds Now() { return Singleton<EpochClockGuaranteeingMonotonicity>().Now(); }
 
+// The source of the wall time behind `Now()`: "tsc", "clock_gettime", or "system_clock".
+inline const char* NowImplementation() { return Singleton<EpochClockGuaranteeingMonotonicity>().Implementation(); }
+
 template <typename T>
 inline void SleepUntil(T moment) {
   const auto now = Now();
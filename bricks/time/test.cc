@@ -22,8 +22,10 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 *******************************************************************************/
 
+#include <algorithm>
 #include <thread>
 #include <chrono>
+#include <vector>
 
 #include "chrono.h"
 
@@ -46,6 +48,59 @@ TEST(Time, SmokeTest) {
   EXPECT_LE(dt, 50000 + allowed_skew);
 }
 
+TEST(Time, NowIsStrictlyIncreasingAcrossThreads) {
+  std::cerr << "current::time::Now() implementation: " << current::time::NowImplementation() << std::endl;
+  constexpr size_t kThreads = 4u;
+  constexpr size_t kCalls = 100000u;
+  std::vector<std::vector<int64_t>> values(kThreads);
+  std::vector<std::thread> threads;
+  for (size_t t = 0u; t < kThreads; ++t) {
+    threads.emplace_back([&values, t]() {
+      values[t].reserve(kCalls);
+      for (size_t i = 0u; i < kCalls; ++i) {
+        values[t].push_back(current::time::Now().count());
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  std::vector<int64_t> all;
+  for (const auto& v : values) {
+    for (size_t i = 1u; i < v.size(); ++i) {
+      ASSERT_LT(v[i - 1u], v[i]);
+    }
+    all.insert(all.end(), v.begin(), v.end());
+  }
+  std::sort(all.begin(), all.end());
+  EXPECT_TRUE(std::adjacent_find(all.begin(), all.end()) == all.end());
+}
+
+TEST(Time, NowFollowsSystemClock) {
+  const auto system_now = []() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch());
+  };
+#if !defined(CURRENT_WINDOWS) && !defined(CURRENT_APPLE) && !defined(CURRENT_CI)
+  const int64_t allowed_skew = 3000;
+#else
+  const int64_t allowed_skew = 250000;
+#endif
+  // The strictly increasing clock runs ahead of the system one under a burst of calls, as in the test above,
+  // as no two calls return the same microsecond. Let it catch up first.
+  for (int i = 0; i < 100 && current::time::Now().count() > system_now().count(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  // Spans several re-readings of the system clock, so that the interpolated path is exercised too.
+  for (int i = 0; i < 50; ++i) {
+    const auto before = system_now();
+    const auto now = current::time::Now();
+    const auto after = system_now();
+    EXPECT_GE(now.count(), before.count() - allowed_skew);
+    EXPECT_LE(now.count(), after.count() + allowed_skew);
+    std::this_thread::sleep_for(std::chrono::milliseconds(3));
+  }
+}
+
 #else
 
 #ifndef CURRENT_COVERAGE_REPORT_MODE
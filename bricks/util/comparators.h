@@ -30,15 +30,19 @@ SOFTWARE.
 
 #include <chrono>
 #include <map>
+#include <string>
+#include <string_view>
 #include <unordered_map>
 
+#include "hash.h"
+
 namespace current {
 
-// Hash combine function.
-// Source: http://www.boost.org/doc/libs/1_55_0/doc/html/hash/reference.html#boost.hash_combine
+// Hash combine function. Mixes all the bits of both hashes, so that the composite keys of the small integers,
+// the hashes of which are often the integers themselves, are spread evenly too.
 template <typename T, class HASH = std::hash<T>>
 inline void HashCombine(std::size_t& seed, const T& v) {
-  seed ^= HASH()(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+  seed = static_cast<std::size_t>(FastHashCombine(static_cast<uint64_t>(seed), static_cast<uint64_t>(HASH()(v))));
 }
 
 namespace custom_comparator_and_hash_function {
@@ -70,8 +74,25 @@ using GenericHashFunction = typename custom_comparator_and_hash_function::Generi
 
 namespace custom_comparator_and_hash_function {
 
+// The hash function of the types with neither the `Hash()` method nor a specialization below.
+// Specialized in `typesystem/struct.h` for the `CURRENT_STRUCT`-s, to hash them field by field.
+template <typename T, typename ENABLE = void>
+struct HashFunctionWithoutHashMethod : std::hash<T> {};
+
 template <typename T>
-struct GenericHashFunctionImpl<T, false, false> : std::hash<T> {};
+struct GenericHashFunctionImpl<T, false, false> : HashFunctionWithoutHashMethod<T> {};
+
+// The strings are hashed with `FastHash()`. Deliberately not `noexcept`, which makes `std::unordered_map`-s
+// of libstdc++ cache the hashes of the keys, instead of recomputing them as the map is rehashed.
+template <>
+struct GenericHashFunctionImpl<std::string, false, false> {
+  std::size_t operator()(const std::string& s) const { return static_cast<std::size_t>(FastHash(s)); }
+};
+
+template <>
+struct GenericHashFunctionImpl<std::string_view, false, false> {
+  std::size_t operator()(std::string_view s) const { return static_cast<std::size_t>(FastHash(s)); }
+};
 
 template <typename TF, typename TS>
 struct GenericHashFunctionImpl<std::pair<TF, TS>, false, false> {
@@ -30,8 +30,18 @@ SOFTWARE.
 #ifndef BRICKS_UTIL_CRC32_H
 #define BRICKS_UTIL_CRC32_H
 
-#include <string>
+#include <cstdint>
 #include <cstring>
+#include <string>
+
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(CURRENT_WINDOWS)
+#include <cpuid.h>
+#include <immintrin.h>
+#define CURRENT_CRC32C_X86_SSE42
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CURRENT_CRC32C_ARMV8
+#endif
 
 namespace current {
 
@@ -78,6 +88,231 @@ inline uint32_t CRC32(const char* str) { return CRC32(0, str, strlen(str)); }
 
 inline uint32_t CRC32(const std::string& str) { return CRC32(0, str.c_str(), str.length()); }
 
+// CRC32C, the Castagnoli polynomial, is what the checksums of the binary storage formats use: unlike CRC32,
+// x86 with SSE4.2 and ARMv8 compute it in hardware. Same calling convention as `CRC32()`, so that
+// `CRC32C(CRC32C(0, a, n), b, m)` is the checksum of `a` followed by `b`.
+namespace impl {
+
+constexpr uint32_t kCRC32CPolynomial = 0x82f63b78;
+
+// The tables to process eight bytes at a time in software, `t[k][b]` being the CRC of byte `b` followed by `k` zeros.
+struct CRC32CTables final {
+  uint32_t t[8][256];
+
+  constexpr CRC32CTables() : t() {
+    for (uint32_t b = 0; b < 256; ++b) {
+      uint32_t crc = b;
+      for (int i = 0; i < 8; ++i) {
+        crc = (crc >> 1) ^ ((crc & 1u) ? kCRC32CPolynomial : 0u);
+      }
+      t[0][b] = crc;
+    }
+    for (uint32_t b = 0; b < 256; ++b) {
+      for (int k = 1; k < 8; ++k) {
+        t[k][b] = (t[k - 1][b] >> 8) ^ t[0][t[k - 1][b] & 0xff];
+      }
+    }
+  }
+
+  static const CRC32CTables& Instance() {
+    static constexpr CRC32CTables tables;
+    return tables;
+  }
+};
+
+// The functions below work with the CRC register itself, i.e. without the inversions before and after.
+inline uint32_t CRC32CPortable(uint32_t crc, const uint8_t* p, size_t size) {
+  const auto& t = CRC32CTables::Instance().t;
+  for (; size >= 8u; p += 8, size -= 8u) {
+    const uint32_t lo = crc ^ (static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+                               static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24);
+    crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^ t[3][p[4]] ^
+          t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+  }
+  while (size--) {
+    crc = t[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+// `a * b` modulo the polynomial, both in the bit-reflected form, where `1u << 31` stands for 1.
+inline uint32_t CRC32CMultiply(uint32_t a, uint32_t b) {
+  uint32_t product = 0u;
+  for (uint32_t m = 1u << 31; m; m >>= 1) {
+    if (a & m) {
+      product ^= b;
+    }
+    b = (b >> 1) ^ ((b & 1u) ? kCRC32CPolynomial : 0u);
+  }
+  return product;
+}
+
+// `x^n` modulo the polynomial.
+inline uint32_t CRC32CXPower(uint64_t n) {
+  uint32_t result = 1u << 31;
+  uint32_t square = 1u << 30;
+  for (; n; n >>= 1) {
+    if (n & 1u) {
+      result = CRC32CMultiply(result, square);
+    }
+    square = CRC32CMultiply(square, square);
+  }
+  return result;
+}
+
+// The register after `crc` is followed by `n` zero bytes is `CRC32CMultiply(crc, CRC32CXPower(8 * n))`.
+// Hence the CRCs of the three lanes of a stride, computed independently, are combined into the CRC of the stride.
+// The lanes keep the three-cycle latency of the CRC instruction busy, which processing a single stream does not.
+struct CRC32CLanes final {
+  constexpr static size_t kLong = 2048u;
+  constexpr static size_t kShort = 128u;
+  // `x^(8 * lane - 33)`, for the carry-less multiplication path: the CRC instruction multiplies by `x^33` again.
+  uint32_t long_shift_clmul = CRC32CXPower(8u * kLong - 33u);
+  uint32_t short_shift_clmul = CRC32CXPower(8u * kShort - 33u);
+  uint32_t long_shift = CRC32CXPower(8u * kLong);
+  uint32_t short_shift = CRC32CXPower(8u * kShort);
+
+  static const CRC32CLanes& Instance() {
+    static const CRC32CLanes instance;
+    return instance;
+  }
+};
+
+inline uint32_t CRC32CShiftPortable(uint32_t crc, bool long_lane) {
+  const CRC32CLanes& lanes = CRC32CLanes::Instance();
+  return CRC32CMultiply(crc, long_lane ? lanes.long_shift : lanes.short_shift);
+}
+
+#if defined(CURRENT_CRC32C_X86_SSE42) || defined(CURRENT_CRC32C_ARMV8)
+
+#if defined(CURRENT_CRC32C_X86_SSE42)
+
+#define CURRENT_CRC32C_TARGET __attribute__((target("sse4.2")))
+
+CURRENT_CRC32C_TARGET inline uint32_t CRC32CHardware8(uint32_t crc, const uint8_t* p) {
+  uint64_t v;
+  std::memcpy(&v, p, 8u);
+  return static_cast<uint32_t>(_mm_crc32_u64(crc, v));
+}
+
+CURRENT_CRC32C_TARGET inline uint32_t CRC32CHardware1(uint32_t crc, uint8_t c) { return _mm_crc32_u8(crc, c); }
+
+__attribute__((target("sse4.2,pclmul"))) inline uint32_t CRC32CShiftCLMUL(uint32_t crc, bool long_lane) {
+  const CRC32CLanes& lanes = CRC32CLanes::Instance();
+  const __m128i product = _mm_clmulepi64_si128(
+      _mm_cvtsi32_si128(static_cast<int>(crc)),
+      _mm_cvtsi32_si128(static_cast<int>(long_lane ? lanes.long_shift_clmul : lanes.short_shift_clmul)),
+      0x00);
+  return static_cast<uint32_t>(_mm_crc32_u64(0u, static_cast<uint64_t>(_mm_cvtsi128_si64(product))));
+}
+
+inline bool CPUHasSSE42(bool& pclmul) {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  pclmul = (ecx & bit_PCLMUL) != 0u;
+  return (ecx & bit_SSE4_2) != 0u;
+}
+
+#else
+
+#define CURRENT_CRC32C_TARGET
+
+inline uint32_t CRC32CHardware8(uint32_t crc, const uint8_t* p) {
+  uint64_t v;
+  std::memcpy(&v, p, 8u);
+  return __crc32cd(crc, v);
+}
+
+inline uint32_t CRC32CHardware1(uint32_t crc, uint8_t c) { return __crc32cb(crc, c); }
+
+#endif  // CURRENT_CRC32C_X86_SSE42
+
+template <uint32_t (*SHIFT)(uint32_t, bool)>
+CURRENT_CRC32C_TARGET inline uint32_t CRC32CHardwareLanes(uint32_t crc, const uint8_t*& p, size_t& size, size_t lane) {
+  const bool long_lane = (lane == CRC32CLanes::kLong);
+  while (size >= 3u * lane) {
+    uint32_t crc1 = 0u;
+    uint32_t crc2 = 0u;
+    for (const uint8_t* end = p + lane; p < end; p += 8) {
+      crc = CRC32CHardware8(crc, p);
+      crc1 = CRC32CHardware8(crc1, p + lane);
+      crc2 = CRC32CHardware8(crc2, p + 2u * lane);
+    }
+    crc = SHIFT(SHIFT(crc, long_lane) ^ crc1, long_lane) ^ crc2;
+    p += 2u * lane;
+    size -= 3u * lane;
+  }
+  return crc;
+}
+
+template <uint32_t (*SHIFT)(uint32_t, bool)>
+CURRENT_CRC32C_TARGET inline uint32_t CRC32CHardware(uint32_t crc, const uint8_t* p, size_t size) {
+  crc = CRC32CHardwareLanes<SHIFT>(crc, p, size, CRC32CLanes::kLong);
+  crc = CRC32CHardwareLanes<SHIFT>(crc, p, size, CRC32CLanes::kShort);
+  for (; size >= 8u; p += 8, size -= 8u) {
+    crc = CRC32CHardware8(crc, p);
+  }
+  while (size--) {
+    crc = CRC32CHardware1(crc, *p++);
+  }
+  return crc;
+}
+
+#undef CURRENT_CRC32C_TARGET
+
+#endif  // CURRENT_CRC32C_X86_SSE42 || CURRENT_CRC32C_ARMV8
+
+using crc32c_t = uint32_t (*)(uint32_t crc, const uint8_t* p, size_t size);
+
+// Picks the fastest implementation the CPU supports once, at the first use.
+struct CRC32CEngine final {
+  crc32c_t compute = CRC32CPortable;
+  const char* name = "portable";
+
+  CRC32CEngine() {
+#if defined(CURRENT_CRC32C_X86_SSE42)
+    bool pclmul = false;
+    if (CPUHasSSE42(pclmul)) {
+      if (pclmul) {
+        compute = CRC32CHardware<CRC32CShiftCLMUL>;
+        name = "SSE4.2 with PCLMUL";
+      } else {
+        compute = CRC32CHardware<CRC32CShiftPortable>;
+        name = "SSE4.2";
+      }
+    }
+#elif defined(CURRENT_CRC32C_ARMV8)
+    compute = CRC32CHardware<CRC32CShiftPortable>;
+    name = "ARMv8 CRC";
+#endif
+  }
+
+  static const CRC32CEngine& Instance() {
+    static const CRC32CEngine instance;
+    return instance;
+  }
+};
+
+}  // namespace impl
+
+inline uint32_t CRC32C(uint32_t crc, const void* buf, size_t size) {
+  return ~impl::CRC32CEngine::Instance().compute(~crc, static_cast<const uint8_t*>(buf), size);
+}
+
+inline uint32_t CRC32C(const char* str) { return CRC32C(0, str, strlen(str)); }
+
+inline uint32_t CRC32C(const std::string& str) { return CRC32C(0, str.data(), str.length()); }
+
+// The CRC32C of `a` followed by `b`, given the CRC32C of each and the length of `b`, without reading either.
+inline uint32_t CRC32CCombine(uint32_t crc_a, uint32_t crc_b, size_t length_b) {
+  return impl::CRC32CMultiply(crc_a, impl::CRC32CXPower(8u * static_cast<uint64_t>(length_b))) ^ crc_b;
+}
+
+// The name of the implementation in use, for the logs and the benchmarks.
+inline const char* CRC32CImplementation() { return impl::CRC32CEngine::Instance().name; }
+
 }  // namespace current
 
 #endif  // BRICKS_UTIL_CRC32_H
@@ -0,0 +1,879 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// DEFLATE compression and decompression, RFC 1951, with no external dependencies, along with the zlib, RFC 1950,
+// and gzip, RFC 1952, formats wrapping it. Used by the HTTP server and client for `Content-Encoding`.
+//
+// `DeflateCompressor` compresses a stream one piece at a time, matching against the previous 32KB of it, and can
+// flush what has been compressed so far to a byte boundary for the peer to decompress right away, as the chunked
+// HTTP responses need. The blocks are encoded with dynamic Huffman codes, with fixed ones, or stored, whichever is
+// the shortest. `DeflateDecompress` throws `DeflateDecompressException` if the compressed data is broken.
+
+#ifndef BRICKS_UTIL_DEFLATE_H
+#define BRICKS_UTIL_DEFLATE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "crc32.h"
+
+#include "../exception.h"
+
+namespace current {
+
+struct DeflateDecompressException : Exception {
+  using Exception::Exception;
+};
+
+// `Zlib` is what HTTP calls the "deflate" content encoding.
+enum class DeflateFormat : int { Raw = 0, Zlib = 1, Gzip = 2 };
+
+namespace deflate {
+
+constexpr size_t kWindowSize = 32768u;
+constexpr size_t kMinMatch = 3u;
+constexpr size_t kMaxMatch = 258u;
+constexpr size_t kMaxChain = 32u;
+constexpr size_t kMaxHashBits = 15u;
+constexpr size_t kMaxSymbolsPerBlock = 16384u;
+constexpr size_t kMaxStoredBlockSize = 65535u;
+constexpr size_t kEndOfBlock = 256u;
+constexpr size_t kLiteralLengthCodes = 286u;
+constexpr size_t kDistanceCodes = 30u;
+constexpr size_t kCodeLengthCodes = 19u;
+constexpr size_t kMaxCodeLength = 15u;
+constexpr size_t kMaxCodeLengthCodeLength = 7u;
+
+constexpr uint16_t kLengthBase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                      31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t kLengthExtraBits[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                          2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t kDistanceBase[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                        33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                        1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr uint8_t kDistanceExtraBits[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                            6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+constexpr uint8_t kCodeLengthOrder[kCodeLengthCodes] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+inline uint32_t Adler32(uint32_t adler, const char* data, size_t size) {
+  uint32_t a = adler & 0xffffu;
+  uint32_t b = adler >> 16;
+  while (size) {
+    // The largest number of bytes for `b` not to overflow before the modulo.
+    size_t n = std::min(size, static_cast<size_t>(5552u));
+    size -= n;
+    while (n--) {
+      a += static_cast<uint8_t>(*data++);
+      b += a;
+    }
+    a %= 65521u;
+    b %= 65521u;
+  }
+  return (b << 16) | a;
+}
+
+// The extra bits following the code length code of `symbol`: the ones for the repeat counts.
+inline size_t CodeLengthExtraBits(size_t symbol) {
+  return symbol == 16u ? 2u : symbol == 17u ? 3u : symbol == 18u ? 7u : 0u;
+}
+
+inline size_t LengthCode(size_t length) {
+  return static_cast<size_t>(std::upper_bound(kLengthBase, kLengthBase + 29, length) - kLengthBase) - 1u;
+}
+
+inline size_t DistanceCode(size_t distance) {
+  return static_cast<size_t>(std::upper_bound(kDistanceBase, kDistanceBase + 30, distance) - kDistanceBase) - 1u;
+}
+
+// The lengths of the Huffman codes, no longer than `max_length`, for the symbols of the frequencies given. At least
+// two symbols always get codes, for the code to be complete, as some decoders reject the codes with one symbol.
+inline void BuildCodeLengths(const uint32_t* frequencies, size_t n, size_t max_length, uint8_t* lengths) {
+  std::vector<uint32_t> f(frequencies, frequencies + n);
+  size_t used = static_cast<size_t>(std::count_if(f.begin(), f.end(), [](uint32_t x) { return x != 0u; }));
+  for (size_t i = 0u; i < n && used < 2u; ++i) {
+    if (!f[i]) {
+      f[i] = 1u;
+      ++used;
+    }
+  }
+  struct Node final {
+    uint64_t weight;
+    int left;
+    int right;
+    int symbol;
+  };
+  while (true) {
+    std::vector<Node> nodes;
+    nodes.reserve(2u * n);
+    using entry_t = std::pair<uint64_t, int>;
+    std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>> queue;
+    for (size_t i = 0u; i < n; ++i) {
+      if (f[i]) {
+        queue.emplace(f[i], static_cast<int>(nodes.size()));
+        nodes.push_back(Node{f[i], -1, -1, static_cast<int>(i)});
+      }
+    }
+    while (queue.size() > 1u) {
+      const entry_t a = queue.top();
+      queue.pop();
+      const entry_t b = queue.top();
+      queue.pop();
+      queue.emplace(a.first + b.first, static_cast<int>(nodes.size()));
+      nodes.push_back(Node{a.first + b.first, a.second, b.second, -1});
+    }
+    std::fill(lengths, lengths + n, static_cast<uint8_t>(0u));
+    size_t longest = 0u;
+    std::vector<std::pair<int, size_t>> stack(1u, std::make_pair(queue.top().second, static_cast<size_t>(0u)));
+    while (!stack.empty()) {
+      const auto top = stack.back();
+      stack.pop_back();
+      const Node& node = nodes[top.first];
+      if (node.symbol >= 0) {
+        lengths[node.symbol] = static_cast<uint8_t>(top.second);
+        longest = std::max(longest, top.second);
+      } else {
+        stack.emplace_back(node.left, top.second + 1u);
+        stack.emplace_back(node.right, top.second + 1u);
+      }
+    }
+    if (longest <= max_length) {
+      return;
+    }
+    // Flatten the frequencies, keeping them non-zero, until the code is short enough.
+    for (uint32_t& x : f) {
+      if (x) {
+        x = (x + 1u) / 2u;
+      }
+    }
+  }
+}
+
+// The canonical codes for the code lengths, bit-reversed, as DEFLATE writes them starting from the top bit.
+inline void BuildCodes(const uint8_t* lengths, size_t n, uint16_t* codes) {
+  uint16_t count[kMaxCodeLength + 1u] = {0};
+  for (size_t i = 0u; i < n; ++i) {
+    ++count[lengths[i]];
+  }
+  count[0] = 0u;
+  uint16_t next[kMaxCodeLength + 1u] = {0};
+  uint16_t code = 0u;
+  for (size_t bits = 1u; bits <= kMaxCodeLength; ++bits) {
+    code = static_cast<uint16_t>((code + count[bits - 1u]) << 1);
+    next[bits] = code;
+  }
+  for (size_t i = 0u; i < n; ++i) {
+    if (lengths[i]) {
+      const uint16_t c = next[lengths[i]]++;
+      uint16_t reversed = 0u;
+      for (size_t b = 0u; b < lengths[i]; ++b) {
+        reversed = static_cast<uint16_t>(reversed | (((c >> b) & 1u) << (lengths[i] - 1u - b)));
+      }
+      codes[i] = reversed;
+    } else {
+      codes[i] = 0u;
+    }
+  }
+}
+
+inline void FixedCodeLengths(uint8_t* literal_lengths, uint8_t* distance_lengths) {
+  for (size_t i = 0u; i < 288u; ++i) {
+    literal_lengths[i] = static_cast<uint8_t>(i < 144u ? 8u : i < 256u ? 9u : i < 280u ? 7u : 8u);
+  }
+  for (size_t i = 0u; i < 32u; ++i) {
+    distance_lengths[i] = 5u;
+  }
+}
+
+class BitWriter final {
+ public:
+  void Write(uint32_t bits, size_t count) {
+    buffer_ |= static_cast<uint64_t>(bits) << count_;
+    count_ += count;
+    while (count_ >= 8u) {
+      output_ += static_cast<char>(buffer_ & 0xffu);
+      buffer_ >>= 8;
+      count_ -= 8u;
+    }
+  }
+  void AlignToByte() {
+    if (count_) {
+      Write(0u, 8u - count_);
+    }
+  }
+  // Only at a byte boundary.
+  void WriteBytes(const char* data, size_t size) { output_.append(data, size); }
+  std::string TakeOutput() {
+    std::string result;
+    result.swap(output_);
+    return result;
+  }
+
+ private:
+  uint64_t buffer_ = 0u;
+  size_t count_ = 0u;
+  std::string output_;
+};
+
+// A literal if `distance` is zero, or a match of `length` bytes `distance` bytes back.
+struct Symbol final {
+  uint16_t length;
+  uint16_t distance;
+};
+
+}  // namespace deflate
+
+class DeflateCompressor final {
+ public:
+  // With `size_hint`, the size of the whole input if known upfront, the smaller inputs take less memory to compress.
+  explicit DeflateCompressor(DeflateFormat format = DeflateFormat::Gzip, size_t size_hint = 0u) : format_(format) {
+    size_t bits = 8u;
+    while (bits < deflate::kMaxHashBits && (size_hint == 0u || (static_cast<size_t>(1u) << bits) < size_hint)) {
+      ++bits;
+    }
+    hash_bits_ = bits;
+    head_.assign(static_cast<size_t>(1u) << bits, 0u);
+    prev_.assign(std::min(deflate::kWindowSize, static_cast<size_t>(1u) << bits), 0u);
+    if (format_ == DeflateFormat::Zlib) {
+      writer_.WriteBytes("\x78\x9c", 2u);
+    } else if (format_ == DeflateFormat::Gzip) {
+      writer_.WriteBytes("\x1f\x8b\x08\x00\x00\x00\x00\x00\x00\xff", 10u);
+    }
+  }
+
+  // Returns the compressed bytes that are ready. With `flush`, these are all the bytes of the input so far, for the
+  // peer to decompress it in full, at the cost of a few bytes of output.
+  std::string Compress(const char* data, size_t size, bool flush) {
+    crc32_ = CRC32(crc32_, data, size);
+    adler32_ = deflate::Adler32(adler32_, data, size);
+    total_size_ += size;
+    window_.append(data, size);
+    Encode();
+    if (flush) {
+      // An empty stored block ends at a byte boundary.
+      writer_.Write(0u, 3u);
+      writer_.AlignToByte();
+      writer_.WriteBytes("\x00\x00\xff\xff", 4u);
+    }
+    TrimWindow();
+    return writer_.TakeOutput();
+  }
+
+  std::string Compress(const std::string& data, bool flush) { return Compress(data.data(), data.length(), flush); }
+
+  // Returns the rest of the compressed data, with the trailer of the format. Nothing can be compressed after it.
+  std::string Finish() {
+    // The final block: fixed Huffman codes, with the end-of-block code only, which is seven zero bits.
+    writer_.Write(1u, 1u);
+    writer_.Write(1u, 2u);
+    writer_.Write(0u, 7u);
+    writer_.AlignToByte();
+    if (format_ == DeflateFormat::Zlib) {
+      const char trailer[4] = {static_cast<char>(adler32_ >> 24),
+                               static_cast<char>(adler32_ >> 16),
+                               static_cast<char>(adler32_ >> 8),
+                               static_cast<char>(adler32_)};
+      writer_.WriteBytes(trailer, 4u);
+    } else if (format_ == DeflateFormat::Gzip) {
+      const uint32_t size = static_cast<uint32_t>(total_size_);
+      const char trailer[8] = {static_cast<char>(crc32_),
+                               static_cast<char>(crc32_ >> 8),
+                               static_cast<char>(crc32_ >> 16),
+                               static_cast<char>(crc32_ >> 24),
+                               static_cast<char>(size),
+                               static_cast<char>(size >> 8),
+                               static_cast<char>(size >> 16),
+                               static_cast<char>(size >> 24)};
+      writer_.WriteBytes(trailer, 8u);
+    }
+    return writer_.TakeOutput();
+  }
+
+ private:
+  uint32_t Hash(size_t i) const {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(window_.data()) + i;
+    const uint32_t v = (static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[1]) << 8) | p[2];
+    return (v * 2654435761u) >> (32u - hash_bits_);
+  }
+
+  // Remembers the position `i` of the window, the three bytes at which are available.
+  void Insert(size_t i) {
+    const uint32_t h = Hash(i);
+    prev_[(window_base_ + i) & (prev_.size() - 1u)] = head_[h];
+    head_[h] = static_cast<uint32_t>(i + 1u);
+  }
+
+  // Finds the matches in the data added to the window and not encoded yet, and writes the blocks for it.
+  void Encode() {
+    const size_t end = window_.length();
+    const size_t max_distance = std::min(deflate::kWindowSize, prev_.size()) - 1u;
+    const char* w = window_.data();
+    size_t block_begin = position_;
+    size_t i = position_;
+    while (i < end) {
+      size_t best_length = 0u;
+      size_t best_distance = 0u;
+      if (end - i >= deflate::kMinMatch) {
+        const size_t limit = std::min(deflate::kMaxMatch, end - i);
+        size_t candidate = head_[Hash(i)];
+        Insert(i);
+        for (size_t chain = 0u; candidate && chain < deflate::kMaxChain; ++chain) {
+          const size_t c = candidate - 1u;
+          if (c >= i || i - c > max_distance) {
+            break;
+          }
+          if (w[c + best_length] == w[i + best_length]) {
+            size_t length = 0u;
+            while (length < limit && w[c + length] == w[i + length]) {
+              ++length;
+            }
+            if (length > best_length) {
+              best_length = length;
+              best_distance = i - c;
+              if (length == limit) {
+                break;
+              }
+            }
+          }
+          const size_t next = prev_[(window_base_ + c) & (prev_.size() - 1u)];
+          if (next >= candidate) {
+            break;
+          }
+          candidate = next;
+        }
+      }
+      if (best_length >= deflate::kMinMatch) {
+        symbols_.push_back(
+            deflate::Symbol{static_cast<uint16_t>(best_length), static_cast<uint16_t>(best_distance)});
+        for (size_t j = i + 1u; j < i + best_length && end - j >= deflate::kMinMatch; ++j) {
+          Insert(j);
+        }
+        i += best_length;
+      } else {
+        symbols_.push_back(deflate::Symbol{static_cast<uint8_t>(w[i]), 0u});
+        ++i;
+      }
+      if (symbols_.size() == deflate::kMaxSymbolsPerBlock) {
+        WriteBlock(block_begin, i);
+        block_begin = i;
+      }
+    }
+    if (!symbols_.empty()) {
+      WriteBlock(block_begin, i);
+    }
+    position_ = i;
+  }
+
+  void WriteBlock(size_t begin, size_t end) {
+    using namespace deflate;
+    uint32_t literal_frequencies[kLiteralLengthCodes] = {0};
+    uint32_t distance_frequencies[kDistanceCodes] = {0};
+    uint64_t extra_bits = 0u;
+    for (const Symbol& s : symbols_) {
+      if (s.distance) {
+        const size_t length_code = LengthCode(s.length);
+        const size_t distance_code = DistanceCode(s.distance);
+        ++literal_frequencies[257u + length_code];
+        ++distance_frequencies[distance_code];
+        extra_bits += kLengthExtraBits[length_code] + kDistanceExtraBits[distance_code];
+      } else {
+        ++literal_frequencies[s.length];
+      }
+    }
+    literal_frequencies[kEndOfBlock] = 1u;
+
+    uint8_t dynamic_literal_lengths[kLiteralLengthCodes];
+    uint8_t dynamic_distance_lengths[kDistanceCodes];
+    BuildCodeLengths(literal_frequencies, kLiteralLengthCodes, kMaxCodeLength, dynamic_literal_lengths);
+    BuildCodeLengths(distance_frequencies, kDistanceCodes, kMaxCodeLength, dynamic_distance_lengths);
+
+    // The run-length encoding of the code lengths, as the symbols of the code length code, with their extra bits.
+    size_t literal_count = kLiteralLengthCodes;
+    while (literal_count > 257u && !dynamic_literal_lengths[literal_count - 1u]) {
+      --literal_count;
+    }
+    size_t distance_count = kDistanceCodes;
+    while (distance_count > 1u && !dynamic_distance_lengths[distance_count - 1u]) {
+      --distance_count;
+    }
+    std::vector<uint8_t> all_lengths(dynamic_literal_lengths, dynamic_literal_lengths + literal_count);
+    all_lengths.insert(all_lengths.end(), dynamic_distance_lengths, dynamic_distance_lengths + distance_count);
+    std::vector<std::pair<uint8_t, uint8_t>> runs;
+    for (size_t k = 0u; k < all_lengths.size();) {
+      const uint8_t length = all_lengths[k];
+      size_t run = 1u;
+      while (k + run < all_lengths.size() && all_lengths[k + run] == length) {
+        ++run;
+      }
+      k += run;
+      if (!length) {
+        while (run >= 11u) {
+          const size_t n = std::min(run, static_cast<size_t>(138u));
+          runs.emplace_back(18u, static_cast<uint8_t>(n - 11u));
+          run -= n;
+        }
+        if (run >= 3u) {
+          runs.emplace_back(17u, static_cast<uint8_t>(run - 3u));
+          run = 0u;
+        }
+      } else {
+        runs.emplace_back(length, 0u);
+        --run;
+        while (run >= 3u) {
+          const size_t n = std::min(run, static_cast<size_t>(6u));
+          runs.emplace_back(16u, static_cast<uint8_t>(n - 3u));
+          run -= n;
+        }
+      }
+      for (; run; --run) {
+        runs.emplace_back(length, 0u);
+      }
+    }
+    uint32_t code_length_frequencies[kCodeLengthCodes] = {0};
+    for (const auto& r : runs) {
+      ++code_length_frequencies[r.first];
+    }
+    uint8_t code_length_lengths[kCodeLengthCodes];
+    BuildCodeLengths(code_length_frequencies, kCodeLengthCodes, kMaxCodeLengthCodeLength, code_length_lengths);
+    size_t code_length_count = kCodeLengthCodes;
+    while (code_length_count > 4u && !code_length_lengths[kCodeLengthOrder[code_length_count - 1u]]) {
+      --code_length_count;
+    }
+
+    uint8_t fixed_literal_lengths[288];
+    uint8_t fixed_distance_lengths[32];
+    FixedCodeLengths(fixed_literal_lengths, fixed_distance_lengths);
+
+    uint64_t dynamic_bits = 3u + 5u + 5u + 4u + 3u * code_length_count + extra_bits;
+    for (const auto& r : runs) {
+      dynamic_bits += code_length_lengths[r.first] + CodeLengthExtraBits(r.first);
+    }
+    uint64_t fixed_bits = 3u + extra_bits;
+    for (size_t k = 0u; k < kLiteralLengthCodes; ++k) {
+      dynamic_bits += static_cast<uint64_t>(literal_frequencies[k]) * dynamic_literal_lengths[k];
+      fixed_bits += static_cast<uint64_t>(literal_frequencies[k]) * fixed_literal_lengths[k];
+    }
+    for (size_t k = 0u; k < kDistanceCodes; ++k) {
+      dynamic_bits += static_cast<uint64_t>(distance_frequencies[k]) * dynamic_distance_lengths[k];
+      fixed_bits += static_cast<uint64_t>(distance_frequencies[k]) * fixed_distance_lengths[k];
+    }
+    const size_t raw_size = end - begin;
+    const uint64_t stored_bits = (raw_size + 5u * (raw_size / kMaxStoredBlockSize + 1u)) * 8u + 7u;
+
+    if (stored_bits < std::min(dynamic_bits, fixed_bits)) {
+      for (size_t offset = begin; offset < end; offset += kMaxStoredBlockSize) {
+        const size_t n = std::min(kMaxStoredBlockSize, end - offset);
+        writer_.Write(0u, 3u);
+        writer_.AlignToByte();
+        const char header[4] = {static_cast<char>(n),
+                                static_cast<char>(n >> 8),
+                                static_cast<char>(~n),
+                                static_cast<char>(~n >> 8)};
+        writer_.WriteBytes(header, 4u);
+        writer_.WriteBytes(window_.data() + offset, n);
+      }
+    } else {
+      const bool dynamic = dynamic_bits < fixed_bits;
+      const uint8_t* literal_lengths = dynamic ? dynamic_literal_lengths : fixed_literal_lengths;
+      const uint8_t* distance_lengths = dynamic ? dynamic_distance_lengths : fixed_distance_lengths;
+      uint16_t literal_codes[288];
+      uint16_t distance_codes[32];
+      BuildCodes(literal_lengths, dynamic ? kLiteralLengthCodes : 288u, literal_codes);
+      BuildCodes(distance_lengths, dynamic ? kDistanceCodes : 32u, distance_codes);
+      writer_.Write(0u, 1u);
+      writer_.Write(dynamic ? 2u : 1u, 2u);
+      if (dynamic) {
+        uint16_t code_length_codes[kCodeLengthCodes];
+        BuildCodes(code_length_lengths, kCodeLengthCodes, code_length_codes);
+        writer_.Write(static_cast<uint32_t>(literal_count - 257u), 5u);
+        writer_.Write(static_cast<uint32_t>(distance_count - 1u), 5u);
+        writer_.Write(static_cast<uint32_t>(code_length_count - 4u), 4u);
+        for (size_t k = 0u; k < code_length_count; ++k) {
+          writer_.Write(code_length_lengths[kCodeLengthOrder[k]], 3u);
+        }
+        for (const auto& r : runs) {
+          writer_.Write(code_length_codes[r.first], code_length_lengths[r.first]);
+          writer_.Write(r.second, CodeLengthExtraBits(r.first));
+        }
+      }
+      for (const Symbol& s : symbols_) {
+        if (s.distance) {
+          const size_t length_code = LengthCode(s.length);
+          const size_t distance_code = DistanceCode(s.distance);
+          writer_.Write(literal_codes[257u + length_code], literal_lengths[257u + length_code]);
+          writer_.Write(s.length - kLengthBase[length_code], kLengthExtraBits[length_code]);
+          writer_.Write(distance_codes[distance_code], distance_lengths[distance_code]);
+          writer_.Write(s.distance - kDistanceBase[distance_code], kDistanceExtraBits[distance_code]);
+        } else {
+          writer_.Write(literal_codes[s.length], literal_lengths[s.length]);
+        }
+      }
+      writer_.Write(literal_codes[kEndOfBlock], literal_lengths[kEndOfBlock]);
+    }
+    symbols_.clear();
+  }
+
+  // Keeps the last 32KB of the input only, once there is much more, for the next data to be matched against.
+  void TrimWindow() {
+    if (window_.length() < 4u * deflate::kWindowSize) {
+      return;
+    }
+    const size_t shift = window_.length() - deflate::kWindowSize;
+    window_.erase(0u, shift);
+    window_base_ += shift;
+    position_ -= shift;
+    for (uint32_t& x : head_) {
+      x = x > shift ? static_cast<uint32_t>(x - shift) : 0u;
+    }
+    for (uint32_t& x : prev_) {
+      x = x > shift ? static_cast<uint32_t>(x - shift) : 0u;
+    }
+  }
+
+  const DeflateFormat format_;
+  size_t hash_bits_;
+  // The positions in `window_` plus one, zero stands for none. The chains of `prev_` are indexed by the positions
+  // in the whole input, for them not to move as the window is trimmed.
+  std::vector<uint32_t> head_;
+  std::vector<uint32_t> prev_;
+  std::string window_;
+  uint64_t window_base_ = 0u;  // The position of the beginning of `window_` in the whole input.
+  size_t position_ = 0u;       // The position in `window_` to continue encoding from.
+  std::vector<deflate::Symbol> symbols_;
+  deflate::BitWriter writer_;
+  uint32_t crc32_ = 0u;
+  uint32_t adler32_ = 1u;
+  uint64_t total_size_ = 0u;
+};
+
+inline std::string DeflateCompress(const char* data, size_t size, DeflateFormat format = DeflateFormat::Gzip) {
+  DeflateCompressor compressor(format, size);
+  std::string result = compressor.Compress(data, size, false);
+  result += compressor.Finish();
+  return result;
+}
+
+inline std::string DeflateCompress(const std::string& data, DeflateFormat format = DeflateFormat::Gzip) {
+  return DeflateCompress(data.data(), data.length(), format);
+}
+
+namespace deflate {
+
+class Inflater final {
+ public:
+  Inflater(const uint8_t* data, size_t size, size_t max_output_size, std::string& output)
+      : data_(data), size_(size), max_output_size_(max_output_size), output_(output) {}
+
+  // Decompresses the blocks up to and including the final one, and returns the number of bytes they have taken.
+  size_t Inflate() {
+    bool final;
+    do {
+      final = Bits(1u);
+      const uint32_t type = Bits(2u);
+      if (type == 0u) {
+        Stored();
+      } else if (type == 1u) {
+        uint8_t literal_lengths[288];
+        uint8_t distance_lengths[32];
+        FixedCodeLengths(literal_lengths, distance_lengths);
+        Huffman literals(literal_lengths, 288u);
+        Huffman distances(distance_lengths, 30u);
+        Codes(literals, distances);
+      } else if (type == 2u) {
+        Dynamic();
+      } else {
+        CURRENT_THROW(DeflateDecompressException("Invalid block type."));
+      }
+    } while (!final);
+    return position_;
+  }
+
+ private:
+  struct Huffman final {
+    uint16_t count[kMaxCodeLength + 1u];
+    uint16_t symbol[288];
+    Huffman(const uint8_t* lengths, size_t n) {
+      std::fill(count, count + kMaxCodeLength + 1u, static_cast<uint16_t>(0u));
+      for (size_t i = 0u; i < n; ++i) {
+        ++count[lengths[i]];
+      }
+      int left = 1;
+      for (size_t bits = 1u; bits <= kMaxCodeLength; ++bits) {
+        left = (left << 1) - count[bits];
+        if (left < 0) {
+          CURRENT_THROW(DeflateDecompressException("Over-subscribed code."));
+        }
+      }
+      uint16_t offsets[kMaxCodeLength + 1u];
+      offsets[1] = 0u;
+      for (size_t bits = 1u; bits < kMaxCodeLength; ++bits) {
+        offsets[bits + 1u] = static_cast<uint16_t>(offsets[bits] + count[bits]);
+      }
+      for (size_t i = 0u; i < n; ++i) {
+        if (lengths[i]) {
+          symbol[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+        }
+      }
+    }
+  };
+
+  uint32_t Bits(size_t count) {
+    while (bit_count_ < count) {
+      if (position_ == size_) {
+        CURRENT_THROW(DeflateDecompressException("Truncated input."));
+      }
+      bit_buffer_ |= static_cast<uint64_t>(data_[position_++]) << bit_count_;
+      bit_count_ += 8u;
+    }
+    const uint32_t result = static_cast<uint32_t>(bit_buffer_ & ((static_cast<uint64_t>(1u) << count) - 1u));
+    bit_buffer_ >>= count;
+    bit_count_ -= count;
+    return result;
+  }
+
+  size_t Decode(const Huffman& h) {
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (size_t bits = 1u; bits <= kMaxCodeLength; ++bits) {
+      code |= static_cast<int>(Bits(1u));
+      const int count = h.count[bits];
+      if (code - count < first) {
+        return h.symbol[index + (code - first)];
+      }
+      index += count;
+      first += count;
+      first <<= 1;
+      code <<= 1;
+    }
+    CURRENT_THROW(DeflateDecompressException("Invalid code."));
+  }
+
+  void Append(const char* data, size_t size) {
+    if (output_.length() + size > max_output_size_) {
+      CURRENT_THROW(DeflateDecompressException("Decompressed data too large."));
+    }
+    output_.append(data, size);
+  }
+
+  void Stored() {
+    // Drop the bits up to the byte boundary; the whole bytes read ahead go back to the input.
+    bit_buffer_ = 0u;
+    position_ -= bit_count_ / 8u;
+    bit_count_ = 0u;
+    if (size_ - position_ < 4u) {
+      CURRENT_THROW(DeflateDecompressException("Truncated stored block."));
+    }
+    const size_t length = data_[position_] | (static_cast<size_t>(data_[position_ + 1u]) << 8);
+    const size_t complement = data_[position_ + 2u] | (static_cast<size_t>(data_[position_ + 3u]) << 8);
+    position_ += 4u;
+    if (length != (~complement & 0xffffu)) {
+      CURRENT_THROW(DeflateDecompressException("Invalid stored block length."));
+    }
+    if (size_ - position_ < length) {
+      CURRENT_THROW(DeflateDecompressException("Truncated stored block."));
+    }
+    Append(reinterpret_cast<const char*>(data_ + position_), length);
+    position_ += length;
+  }
+
+  void Dynamic() {
+    const size_t literal_count = Bits(5u) + 257u;
+    const size_t distance_count = Bits(5u) + 1u;
+    const size_t code_length_count = Bits(4u) + 4u;
+    if (literal_count > kLiteralLengthCodes || distance_count > kDistanceCodes) {
+      CURRENT_THROW(DeflateDecompressException("Too many codes."));
+    }
+    uint8_t code_length_lengths[kCodeLengthCodes] = {0};
+    for (size_t i = 0u; i < code_length_count; ++i) {
+      code_length_lengths[kCodeLengthOrder[i]] = static_cast<uint8_t>(Bits(3u));
+    }
+    const Huffman code_lengths(code_length_lengths, kCodeLengthCodes);
+    uint8_t lengths[kLiteralLengthCodes + kDistanceCodes] = {0};
+    for (size_t i = 0u; i < literal_count + distance_count;) {
+      const size_t symbol = Decode(code_lengths);
+      if (symbol < 16u) {
+        lengths[i++] = static_cast<uint8_t>(symbol);
+      } else {
+        uint8_t length = 0u;
+        size_t repeat;
+        if (symbol == 16u) {
+          if (!i) {
+            CURRENT_THROW(DeflateDecompressException("Repeating no length."));
+          }
+          length = lengths[i - 1u];
+          repeat = 3u + Bits(2u);
+        } else if (symbol == 17u) {
+          repeat = 3u + Bits(3u);
+        } else {
+          repeat = 11u + Bits(7u);
+        }
+        if (i + repeat > literal_count + distance_count) {
+          CURRENT_THROW(DeflateDecompressException("Too many lengths."));
+        }
+        for (; repeat; --repeat) {
+          lengths[i++] = length;
+        }
+      }
+    }
+    if (!lengths[kEndOfBlock]) {
+      CURRENT_THROW(DeflateDecompressException("No end-of-block code."));
+    }
+    const Huffman literals(lengths, literal_count);
+    const Huffman distances(lengths + literal_count, distance_count);
+    Codes(literals, distances);
+  }
+
+  void Codes(const Huffman& literals, const Huffman& distances) {
+    while (true) {
+      const size_t symbol = Decode(literals);
+      if (symbol < 256u) {
+        const char c = static_cast<char>(symbol);
+        Append(&c, 1u);
+      } else if (symbol == kEndOfBlock) {
+        return;
+      } else {
+        const size_t length_code = symbol - 257u;
+        if (length_code >= 29u) {
+          CURRENT_THROW(DeflateDecompressException("Invalid length code."));
+        }
+        const size_t length = kLengthBase[length_code] + Bits(kLengthExtraBits[length_code]);
+        const size_t distance_code = Decode(distances);
+        if (distance_code >= 30u) {
+          CURRENT_THROW(DeflateDecompressException("Invalid distance code."));
+        }
+        const size_t distance = kDistanceBase[distance_code] + Bits(kDistanceExtraBits[distance_code]);
+        if (distance > output_.length()) {
+          CURRENT_THROW(DeflateDecompressException("Distance too far back."));
+        }
+        if (output_.length() + length > max_output_size_) {
+          CURRENT_THROW(DeflateDecompressException("Decompressed data too large."));
+        }
+        // Byte by byte, as the match may overlap with itself, repeating a pattern.
+        size_t from = output_.length() - distance;
+        for (size_t k = 0u; k < length; ++k) {
+          output_ += output_[from++];
+        }
+      }
+    }
+  }
+
+  const uint8_t* const data_;
+  const size_t size_;
+  const size_t max_output_size_;
+  std::string& output_;
+  size_t position_ = 0u;
+  uint64_t bit_buffer_ = 0u;
+  size_t bit_count_ = 0u;
+};
+
+inline uint32_t ReadLittleEndian32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+}  // namespace deflate
+
+// Decompresses all of `data`; the gzip members following one another are decompressed one after another.
+inline std::string DeflateDecompress(const char* input,
+                                     size_t size,
+                                     DeflateFormat format = DeflateFormat::Gzip,
+                                     size_t max_size = std::numeric_limits<size_t>::max()) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(input);
+  std::string output;
+  if (format == DeflateFormat::Raw) {
+    deflate::Inflater(data, size, max_size, output).Inflate();
+  } else if (format == DeflateFormat::Zlib) {
+    if (size < 6u || (data[0] & 0x0fu) != 8u || ((data[0] << 8) | data[1]) % 31u || (data[1] & 0x20u)) {
+      CURRENT_THROW(DeflateDecompressException("Invalid zlib header."));
+    }
+    const size_t end = 2u + deflate::Inflater(data + 2u, size - 2u, max_size, output).Inflate();
+    if (size - end < 4u) {
+      CURRENT_THROW(DeflateDecompressException("Truncated zlib trailer."));
+    }
+    const uint32_t adler = (static_cast<uint32_t>(data[end]) << 24) | (static_cast<uint32_t>(data[end + 1u]) << 16) |
+                           (static_cast<uint32_t>(data[end + 2u]) << 8) | data[end + 3u];
+    if (adler != deflate::Adler32(1u, output.data(), output.length())) {
+      CURRENT_THROW(DeflateDecompressException("Adler-32 mismatch."));
+    }
+  } else {
+    size_t offset = 0u;
+    do {
+      const uint8_t* p = data + offset;
+      size_t left = size - offset;
+      if (left < 18u || p[0] != 0x1fu || p[1] != 0x8bu || p[2] != 8u) {
+        CURRENT_THROW(DeflateDecompressException("Invalid gzip header."));
+      }
+      const uint8_t flags = p[3];
+      size_t header = 10u;
+      if (flags & 4u) {
+        header += 2u + (p[10] | (static_cast<size_t>(p[11]) << 8));
+      }
+      for (const unsigned flag : {8u, 16u}) {
+        if (flags & flag) {
+          while (header < left && p[header]) {
+            ++header;
+          }
+          ++header;
+        }
+      }
+      if (flags & 2u) {
+        header += 2u;
+      }
+      if (header >= left) {
+        CURRENT_THROW(DeflateDecompressException("Truncated gzip header."));
+      }
+      const size_t begin = output.length();
+      const size_t end = header + deflate::Inflater(p + header, left - header, max_size, output).Inflate();
+      if (left - end < 8u) {
+        CURRENT_THROW(DeflateDecompressException("Truncated gzip trailer."));
+      }
+      if (deflate::ReadLittleEndian32(p + end) != CRC32(0u, output.data() + begin, output.length() - begin)) {
+        CURRENT_THROW(DeflateDecompressException("CRC-32 mismatch."));
+      }
+      if (deflate::ReadLittleEndian32(p + end + 4u) != static_cast<uint32_t>(output.length() - begin)) {
+        CURRENT_THROW(DeflateDecompressException("Size mismatch."));
+      }
+      offset += end + 8u;
+    } while (offset < size);
+  }
+  return output;
+}
+
+inline std::string DeflateDecompress(const std::string& input,
+                                     DeflateFormat format = DeflateFormat::Gzip,
+                                     size_t max_size = std::numeric_limits<size_t>::max()) {
+  return DeflateDecompress(input.data(), input.length(), format, max_size);
+}
+
+}  // namespace current
+
+#endif  // BRICKS_UTIL_DEFLATE_H
@@ -29,7 +29,9 @@ SOFTWARE.
 
 #include <iostream>
 #include <cstdlib>
+#include <exception>
 #include <future>
+#include <optional>
 
 namespace current {
 
@@ -38,12 +40,18 @@ namespace current {
 // The default, `Forgiving`, mode does not have this requirement.
 enum class StrictFuture : bool { Forgiving = false, Strict = true };
 
+// A non-void `current::Future<>` is either backed by an `std::future<>`, or, when constructed with `Ready()` or
+// `Failed()`, holds its already known value or exception inline, with no shared state allocated.
 template <typename T, StrictFuture STRICTNESS = StrictFuture::Forgiving>
 struct FutureImpl {
   FutureImpl() = delete;
   FutureImpl(std::future<T>&& rhs) : f_(std::move(rhs)), used_(false) {}
-  FutureImpl(FutureImpl<T, StrictFuture::Forgiving>&& rhs) : f_(std::move(rhs.f_)), used_(false) {}
-  FutureImpl(FutureImpl<T, StrictFuture::Strict>&& rhs) : f_(std::move(rhs.f_)), used_(false) { rhs.used_ = true; }
+  FutureImpl(FutureImpl<T, StrictFuture::Forgiving>&& rhs)
+      : f_(std::move(rhs.f_)), value_(std::move(rhs.value_)), exception_(std::move(rhs.exception_)), used_(false) {}
+  FutureImpl(FutureImpl<T, StrictFuture::Strict>&& rhs)
+      : f_(std::move(rhs.f_)), value_(std::move(rhs.value_)), exception_(std::move(rhs.exception_)), used_(false) {
+    rhs.used_ = true;
+  }
   ~FutureImpl() {
     if (STRICTNESS == StrictFuture::Strict && !used_) {
       std::cerr << "Strict future has been left hanging, while Go(), Wait(), or Detach() must have been called."
@@ -55,18 +63,37 @@ struct FutureImpl {
   FutureImpl& operator=(const FutureImpl&) = delete;
   FutureImpl& operator=(FutureImpl&&) = delete;
 
+  static FutureImpl Ready(T&& value) { return FutureImpl(std::move(value), nullptr); }
+  static FutureImpl Failed(std::exception_ptr exception) { return FutureImpl(std::nullopt, std::move(exception)); }
+
   T Go() {
     used_ = true;
+    if (value_) {
+      return std::move(*value_);
+    }
+    if (exception_) {
+      std::rethrow_exception(exception_);
+    }
     return std::forward<T>(f_.get());
   }
   void Wait() {
     used_ = true;
-    f_.wait();
+    if (!value_ && !exception_) {
+      f_.wait();
+    }
   }
   void Detach() { used_ = true; }
 
  private:
+  template <typename, StrictFuture>
+  friend struct FutureImpl;
+
+  FutureImpl(std::optional<T>&& value, std::exception_ptr exception)
+      : value_(std::move(value)), exception_(std::move(exception)), used_(false) {}
+
   std::future<T> f_;
+  std::optional<T> value_;
+  std::exception_ptr exception_;
   bool used_ = false;
 };
 
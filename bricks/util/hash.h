@@ -0,0 +1,145 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Based on wyhash by Wang Yi, released into the public domain:
+  https://github.com/wangyi-fudan/wyhash
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// `FastHash()` is a fast, well-distributed, non-cryptographic 64-bit hash of a sequence of bytes, for the hash tables.
+// It is a port of wyhash, which reads eight bytes per step and mixes them in with a 64x64->128 bit multiplication.
+//
+// The hashes are neither stable across the platforms of different endianness, nor meant to be persisted.
+
+#ifndef BRICKS_UTIL_HASH_H
+#define BRICKS_UTIL_HASH_H
+
+#include "../../port.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace current {
+
+namespace fast_hash {
+
+constexpr static uint64_t kSecret[4] = {
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+
+// Sets `a` and `b` to the lower and the upper halves of their 128-bit product.
+inline void Multiply(uint64_t& a, uint64_t& b) {
+#ifdef __SIZEOF_INT128__
+  const __uint128_t product = static_cast<__uint128_t>(a) * b;
+  a = static_cast<uint64_t>(product);
+  b = static_cast<uint64_t>(product >> 64);
+#else
+  const uint64_t a_hi = a >> 32, a_lo = static_cast<uint32_t>(a);
+  const uint64_t b_hi = b >> 32, b_lo = static_cast<uint32_t>(b);
+  const uint64_t hh = a_hi * b_hi, hl = a_hi * b_lo, lh = a_lo * b_hi, ll = a_lo * b_lo;
+  const uint64_t middle = (ll >> 32) + static_cast<uint32_t>(hl) + static_cast<uint32_t>(lh);
+  a = (middle << 32) | static_cast<uint32_t>(ll);
+  b = hh + (hl >> 32) + (lh >> 32) + (middle >> 32);
+#endif
+}
+
+inline uint64_t Mix(uint64_t a, uint64_t b) {
+  Multiply(a, b);
+  return a ^ b;
+}
+
+inline uint64_t Read8(const uint8_t* p) {
+  uint64_t v;
+  std::memcpy(&v, p, 8u);
+  return v;
+}
+
+inline uint64_t Read4(const uint8_t* p) {
+  uint32_t v;
+  std::memcpy(&v, p, 4u);
+  return v;
+}
+
+// The one, two, or three bytes, at the beginning, in the middle, and at the end.
+inline uint64_t Read3(const uint8_t* p, size_t size) {
+  return (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[size >> 1]) << 8) | p[size - 1u];
+}
+
+}  // namespace fast_hash
+
+inline uint64_t FastHash(const void* data, size_t size, uint64_t seed = 0u) {
+  using namespace fast_hash;
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  seed ^= Mix(seed ^ kSecret[0], kSecret[1]);
+  uint64_t a;
+  uint64_t b;
+  if (size <= 16u) {
+    if (size >= 4u) {
+      const size_t offset = (size >> 3) << 2;
+      a = (Read4(p) << 32) | Read4(p + offset);
+      b = (Read4(p + size - 4u) << 32) | Read4(p + size - 4u - offset);
+    } else if (size) {
+      a = Read3(p, size);
+      b = 0u;
+    } else {
+      a = b = 0u;
+    }
+  } else {
+    size_t i = size;
+    if (i > 48u) {
+      uint64_t seed1 = seed;
+      uint64_t seed2 = seed;
+      do {
+        seed = Mix(Read8(p) ^ kSecret[1], Read8(p + 8) ^ seed);
+        seed1 = Mix(Read8(p + 16) ^ kSecret[2], Read8(p + 24) ^ seed1);
+        seed2 = Mix(Read8(p + 32) ^ kSecret[3], Read8(p + 40) ^ seed2);
+        p += 48;
+        i -= 48u;
+      } while (i > 48u);
+      seed ^= seed1 ^ seed2;
+    }
+    while (i > 16u) {
+      seed = Mix(Read8(p) ^ kSecret[1], Read8(p + 8) ^ seed);
+      i -= 16u;
+      p += 16;
+    }
+    a = Read8(p + i - 16u);
+    b = Read8(p + i - 8u);
+  }
+  a ^= kSecret[1];
+  b ^= seed;
+  Multiply(a, b);
+  return Mix(a ^ kSecret[0] ^ size, b ^ kSecret[1]);
+}
+
+inline uint64_t FastHash(std::string_view s, uint64_t seed = 0u) { return FastHash(s.data(), s.length(), seed); }
+
+// Combines two 64-bit hashes into one, in the order-dependent way.
+inline uint64_t FastHashCombine(uint64_t seed, uint64_t hash) {
+  return fast_hash::Mix(seed ^ fast_hash::kSecret[0], hash ^ fast_hash::kSecret[1]);
+}
+
+}  // namespace current
+
+#endif  // BRICKS_UTIL_HASH_H
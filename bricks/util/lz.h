@@ -0,0 +1,204 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// A simple and fast LZ77-family block compressor, with no external dependencies.
+//
+// The compressed block is a sequence of `[token] [literals length bytes]* [literals] [offset] [match length bytes]*`.
+// The upper four bits of the token are the number of literals, the lower four bits are the match length minus four.
+// Either of them being 15 means the value continues in the following bytes, each adding up to 255, until the one
+// less than 255. The offset is two bytes, little endian. The last sequence only has the literals.
+//
+// The size of the original data is not stored in the compressed block: it should be kept alongside it by the user,
+// and passed to `LZDecompress`, which validates the compressed block and throws `LZDecompressException` if it's broken.
+
+#ifndef BRICKS_UTIL_LZ_H
+#define BRICKS_UTIL_LZ_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../exception.h"
+
+namespace current {
+
+struct LZDecompressException : Exception {
+  using Exception::Exception;
+};
+
+namespace lz {
+
+constexpr size_t kMinMatch = 4u;
+constexpr size_t kMaxOffset = 65535u;
+constexpr size_t kHashLog = 14u;
+
+inline uint32_t Hash(const char* p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return (v * 2654435761u) >> (32u - kHashLog);
+}
+
+inline void AppendLength(std::string& output, size_t length) {
+  while (length >= 255u) {
+    output += static_cast<char>(255);
+    length -= 255u;
+  }
+  output += static_cast<char>(length);
+}
+
+inline void AppendSequence(std::string& output,
+                           const char* literals,
+                           size_t literals_length,
+                           size_t offset,
+                           size_t match_length) {
+  const size_t match_code = match_length ? match_length - kMinMatch : 0u;
+  output += static_cast<char>(((literals_length < 15u ? literals_length : 15u) << 4) |
+                              (match_code < 15u ? match_code : 15u));
+  if (literals_length >= 15u) {
+    AppendLength(output, literals_length - 15u);
+  }
+  output.append(literals, literals_length);
+  if (match_length) {
+    output += static_cast<char>(offset & 0xff);
+    output += static_cast<char>(offset >> 8);
+    if (match_code >= 15u) {
+      AppendLength(output, match_code - 15u);
+    }
+  }
+}
+
+inline size_t ReadLength(const uint8_t*& p, const uint8_t* end) {
+  size_t result = 0u;
+  uint8_t b;
+  do {
+    if (p == end) {
+      CURRENT_THROW(LZDecompressException("Truncated length."));
+    }
+    b = *p++;
+    result += b;
+  } while (b == 255u);
+  return result;
+}
+
+}  // namespace lz
+
+inline std::string LZCompress(const char* input, size_t size) {
+  std::string output;
+  output.reserve(size / 2u + 16u);
+  std::vector<uint32_t> table(1u << lz::kHashLog, 0u);  // The position plus one, zero stands for none.
+  size_t anchor = 0u;
+  size_t i = 0u;
+  while (i + lz::kMinMatch <= size) {
+    const uint32_t h = lz::Hash(input + i);
+    const size_t candidate = table[h];
+    table[h] = static_cast<uint32_t>(i + 1u);
+    if (candidate && i - (candidate - 1u) <= lz::kMaxOffset &&
+        !std::memcmp(input + candidate - 1u, input + i, lz::kMinMatch)) {
+      const size_t match = candidate - 1u;
+      size_t length = lz::kMinMatch;
+      while (i + length < size && input[match + length] == input[i + length]) {
+        ++length;
+      }
+      lz::AppendSequence(output, input + anchor, i - anchor, i - match, length);
+      i += length;
+      anchor = i;
+      if (i >= 2u && i + lz::kMinMatch <= size) {
+        // Remember a position within the match, it helps with the repetitive data.
+        table[lz::Hash(input + i - 2u)] = static_cast<uint32_t>(i - 1u);
+      }
+    } else {
+      ++i;
+    }
+  }
+  lz::AppendSequence(output, input + anchor, size - anchor, 0u, 0u);
+  return output;
+}
+
+inline std::string LZCompress(const std::string& input) { return LZCompress(input.data(), input.length()); }
+
+inline void LZDecompressInto(const char* input, size_t size, size_t original_size, std::string& output) {
+  output.resize(original_size);
+  char* const begin = &output[0];
+  char* out = begin;
+  char* const out_end = begin + original_size;
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(input);
+  const uint8_t* const end = p + size;
+  while (p < end) {
+    const uint8_t token = *p++;
+    size_t literals_length = token >> 4;
+    if (literals_length == 15u) {
+      literals_length += lz::ReadLength(p, end);
+    }
+    if (static_cast<size_t>(end - p) < literals_length || static_cast<size_t>(out_end - out) < literals_length) {
+      CURRENT_THROW(LZDecompressException("Invalid literals length."));
+    }
+    std::memcpy(out, p, literals_length);
+    out += literals_length;
+    p += literals_length;
+    if (p == end) {
+      break;
+    }
+    if (end - p < 2) {
+      CURRENT_THROW(LZDecompressException("Truncated offset."));
+    }
+    const size_t offset = static_cast<size_t>(p[0]) | (static_cast<size_t>(p[1]) << 8);
+    p += 2;
+    size_t match_length = token & 15u;
+    if (match_length == 15u) {
+      match_length += lz::ReadLength(p, end);
+    }
+    match_length += lz::kMinMatch;
+    if (!offset || offset > static_cast<size_t>(out - begin) || static_cast<size_t>(out_end - out) < match_length) {
+      CURRENT_THROW(LZDecompressException("Invalid match."));
+    }
+    const char* from = out - offset;
+    if (offset >= match_length) {
+      std::memcpy(out, from, match_length);
+      out += match_length;
+    } else {
+      // Overlapping match, the repeating pattern.
+      for (size_t j = 0; j < match_length; ++j) {
+        *out++ = *from++;
+      }
+    }
+  }
+  if (out != out_end) {
+    CURRENT_THROW(LZDecompressException("Size mismatch."));
+  }
+}
+
+inline std::string LZDecompress(const char* input, size_t size, size_t original_size) {
+  std::string output;
+  LZDecompressInto(input, size, original_size, output);
+  return output;
+}
+
+inline std::string LZDecompress(const std::string& input, size_t original_size) {
+  return LZDecompress(input.data(), input.length(), original_size);
+}
+
+}  // namespace current
+
+#endif  // BRICKS_UTIL_LZ_H
@@ -22,15 +22,294 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 *******************************************************************************/
 
+
+// SHA-256, with the SHA extensions of x86 CPUs used if the CPU has them, as checked at runtime,
+// the ARMv8 cryptography extensions used if the code is built for them, and the portable code otherwise.
+//
+// `current::SHA256(string)` returns the hex digest. `current::SHA256Hasher` hashes the data streamed
+// into it piece by piece, and `current::SHA256Batch(strings)` hashes many buffers at once.
+
 #ifndef BRICKS_UTIL_SHA256_H
 #define BRICKS_UTIL_SHA256_H
 
-#include "../../3rdparty/stephan-brumme/sha256.h"
+#include "../../port.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(CURRENT_WINDOWS)
+#include <cpuid.h>
+#include <immintrin.h>
+#define CURRENT_SHA256_X86_SHA_NI
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+#include <arm_neon.h>
+#define CURRENT_SHA256_ARMV8
+#endif
 
 namespace current {
+namespace impl {
+
+alignas(16) constexpr uint32_t kSHA256RoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+// Processes `blocks` consecutive 64-byte blocks of `data` into `state`.
+using sha256_compress_t = void (*)(uint32_t state[8], const uint8_t* data, size_t blocks);
+
+inline uint32_t SHA256Rotr(uint32_t x, uint32_t n) { return (x >> n) | (x << (32u - n)); }
+
+inline void SHA256CompressPortable(uint32_t state[8], const uint8_t* data, size_t blocks) {
+  for (; blocks; --blocks, data += 64) {
+    uint32_t w[64];
+    for (size_t i = 0; i < 16; ++i) {
+      w[i] = (uint32_t(data[i * 4]) << 24) | (uint32_t(data[i * 4 + 1]) << 16) | (uint32_t(data[i * 4 + 2]) << 8) |
+             uint32_t(data[i * 4 + 3]);
+    }
+    for (size_t i = 16; i < 64; ++i) {
+      const uint32_t s0 = SHA256Rotr(w[i - 15], 7) ^ SHA256Rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      const uint32_t s1 = SHA256Rotr(w[i - 2], 17) ^ SHA256Rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (size_t i = 0; i < 64; ++i) {
+      const uint32_t t1 = h + (SHA256Rotr(e, 6) ^ SHA256Rotr(e, 11) ^ SHA256Rotr(e, 25)) + ((e & f) ^ (~e & g)) +
+                          kSHA256RoundConstants[i] + w[i];
+      const uint32_t t2 = (SHA256Rotr(a, 2) ^ SHA256Rotr(a, 13) ^ SHA256Rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
+
+#ifdef CURRENT_SHA256_X86_SHA_NI
+
+// Four rounds per `_mm_sha256rnds2_epu32()` pair, with the message schedule computed four words at a time.
+__attribute__((target("sha,sse4.1"))) inline void SHA256CompressSHANI(uint32_t state[8],
+                                                                       const uint8_t* data,
+                                                                       size_t blocks) {
+  const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bull, 0x0405060700010203ull);
+  // The state is kept as `ABEF` and `CDGH`, the way the instructions want it.
+  __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0])), 0xB1);
+  __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4])), 0x1B);
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+  state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+  for (; blocks; --blocks, data += 64) {
+    const __m128i abef_save = state0;
+    const __m128i cdgh_save = state1;
+    __m128i w[4];
+    for (int i = 0; i < 4; ++i) {
+      w[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 16)), byte_swap);
+    }
+    for (int g = 0; g < 16; ++g) {
+      if (g >= 4) {
+        const __m128i w9_to_w12 = _mm_alignr_epi8(w[(g + 3) % 4], w[(g + 2) % 4], 4);
+        w[g % 4] = _mm_sha256msg2_epu32(
+            _mm_add_epi32(_mm_sha256msg1_epu32(w[g % 4], w[(g + 1) % 4]), w9_to_w12), w[(g + 3) % 4]);
+      }
+      __m128i message = _mm_add_epi32(
+          w[g % 4], _mm_load_si128(reinterpret_cast<const __m128i*>(&kSHA256RoundConstants[g * 4])));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+      message = _mm_shuffle_epi32(message, 0x0E);
+      state0 = _mm_sha256rnds2_epu32(state0, state1, message);
+    }
+    state0 = _mm_add_epi32(state0, abef_save);
+    state1 = _mm_add_epi32(state1, cdgh_save);
+  }
+  tmp = _mm_shuffle_epi32(state0, 0x1B);
+  state1 = _mm_shuffle_epi32(state1, 0xB1);
+  state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+  state1 = _mm_alignr_epi8(state1, tmp, 8);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+}
+
+inline bool CPUHasSHANI() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1) || !(ecx & bit_SSSE3)) {
+    return false;
+  }
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  return (ebx & (1u << 29)) != 0u;
+}
+
+#endif  // CURRENT_SHA256_X86_SHA_NI
+
+#ifdef CURRENT_SHA256_ARMV8
+
+inline void SHA256CompressARMv8(uint32_t state[8], const uint8_t* data, size_t blocks) {
+  uint32x4_t state0 = vld1q_u32(&state[0]);
+  uint32x4_t state1 = vld1q_u32(&state[4]);
+  for (; blocks; --blocks, data += 64) {
+    const uint32x4_t abcd_save = state0;
+    const uint32x4_t efgh_save = state1;
+    uint32x4_t w[4];
+    for (int i = 0; i < 4; ++i) {
+      w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i * 16)));
+    }
+    for (int g = 0; g < 16; ++g) {
+      const uint32x4_t message = vaddq_u32(w[g % 4], vld1q_u32(&kSHA256RoundConstants[g * 4]));
+      const uint32x4_t abcd = state0;
+      state0 = vsha256hq_u32(state0, state1, message);
+      state1 = vsha256h2q_u32(state1, abcd, message);
+      if (g < 12) {
+        w[g % 4] = vsha256su1q_u32(vsha256su0q_u32(w[g % 4], w[(g + 1) % 4]), w[(g + 2) % 4], w[(g + 3) % 4]);
+      }
+    }
+    state0 = vaddq_u32(state0, abcd_save);
+    state1 = vaddq_u32(state1, efgh_save);
+  }
+  vst1q_u32(&state[0], state0);
+  vst1q_u32(&state[4], state1);
+}
+
+#endif  // CURRENT_SHA256_ARMV8
+
+struct SHA256Compressor final {
+  sha256_compress_t compress = SHA256CompressPortable;
+  const char* name = "portable";
+
+  SHA256Compressor() {
+#if defined(CURRENT_SHA256_X86_SHA_NI)
+    if (CPUHasSHANI()) {
+      compress = SHA256CompressSHANI;
+      name = "x86 SHA extensions";
+    }
+#elif defined(CURRENT_SHA256_ARMV8)
+    compress = SHA256CompressARMv8;
+    name = "ARMv8 cryptography extensions";
+#endif
+  }
+
+  static const SHA256Compressor& Instance() {
+    static const SHA256Compressor instance;
+    return instance;
+  }
+};
+
+}  // namespace impl
+
+// The name of the implementation in use, for the logs and the benchmarks.
+inline const char* SHA256Implementation() { return impl::SHA256Compressor::Instance().name; }
+
+class SHA256Hasher final {
+ public:
+  constexpr static size_t kDigestSize = 32u;
+  using digest_t = std::array<uint8_t, kDigestSize>;
+
+  SHA256Hasher() : compress_(impl::SHA256Compressor::Instance().compress) { Reset(); }
+
+  void Reset() {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    std::memcpy(state_, initial, sizeof(state_));
+    total_bytes_ = 0u;
+    buffered_ = 0u;
+  }
+
+  SHA256Hasher& Update(const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    total_bytes_ += size;
+    if (buffered_) {
+      const size_t take = std::min(size, sizeof(buffer_) - buffered_);
+      std::memcpy(buffer_ + buffered_, p, take);
+      buffered_ += take;
+      p += take;
+      size -= take;
+      if (buffered_ < sizeof(buffer_)) {
+        return *this;
+      }
+      compress_(state_, buffer_, 1u);
+      buffered_ = 0u;
+    }
+    // The whole blocks are hashed in place, with no copying.
+    if (size >= 64u) {
+      compress_(state_, p, size / 64u);
+      p += size / 64u * 64u;
+      size %= 64u;
+    }
+    std::memcpy(buffer_, p, size);
+    buffered_ = size;
+    return *this;
+  }
+
+  SHA256Hasher& Update(const std::string& data) { return Update(data.data(), data.length()); }
+
+  // Returns the digest of all the data passed in since the construction or `Reset()`, and resets the hasher.
+  digest_t Digest() {
+    const uint64_t total_bits = total_bytes_ * 8u;
+    uint8_t padding[72] = {0x80};
+    const size_t padding_size = ((buffered_ < 56u) ? 56u : 120u) - buffered_;
+    for (size_t i = 0; i < 8; ++i) {
+      padding[padding_size + i] = static_cast<uint8_t>(total_bits >> (56u - 8u * i));
+    }
+    Update(padding, padding_size + 8u);
+    digest_t digest;
+    for (size_t i = 0; i < 8; ++i) {
+      for (size_t j = 0; j < 4; ++j) {
+        digest[i * 4 + j] = static_cast<uint8_t>(state_[i] >> (24u - 8u * j));
+      }
+    }
+    Reset();
+    return digest;
+  }
+
+  std::string HexDigest() {
+    static const char hex[] = "0123456789abcdef";
+    const digest_t digest = Digest();
+    std::string result(kDigestSize * 2u, ' ');
+    for (size_t i = 0; i < kDigestSize; ++i) {
+      result[i * 2] = hex[digest[i] >> 4];
+      result[i * 2 + 1] = hex[digest[i] & 15];
+    }
+    return result;
+  }
+
+ private:
+  const impl::sha256_compress_t compress_;
+  uint32_t state_[8];
+  uint64_t total_bytes_;
+  uint8_t buffer_[64];
+  size_t buffered_;
+};
+
+inline std::string SHA256(const std::string& input) { return SHA256Hasher().Update(input).HexDigest(); }
 
-inline std::string SHA256(const std::string& input) {
-  return static_cast<std::string>(sha256_impl_by_StephanBrumme::SHA256(input));
+// The hex digests of each of the `inputs`, with one hasher reused across them.
+inline std::vector<std::string> SHA256Batch(const std::vector<std::string>& inputs) {
+  std::vector<std::string> result;
+  result.reserve(inputs.size());
+  SHA256Hasher hasher;
+  for (const std::string& input : inputs) {
+    result.push_back(hasher.Update(input).HexDigest());
+  }
+  return result;
 }
 
 }  // namespace current
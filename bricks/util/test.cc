@@ -28,8 +28,12 @@ SOFTWARE.
 #include "base64.h"
 #include "comparators.h"
 #include "crc32.h"
+#include "deflate.h"
+#include "future.h"
+#include "hash.h"
 #include "iterator.h"
 #include "lazy_instantiation.h"
+#include "lz.h"
 #include "make_scope_guard.h"
 #include "random.h"
 #include "rol.h"
@@ -43,7 +47,11 @@ SOFTWARE.
 #include "../strings/printf.h"
 
 #include "../../3rdparty/gtest/gtest-main.h"
+#include "../../3rdparty/stephan-brumme/sha256.h"
 
+#include <atomic>
+#include <chrono>
+#include <set>
 #include <thread>
 
 TEST(Util, BasicException) {
@@ -291,15 +299,258 @@ TEST(Util, Base64) {
   EXPECT_EQ(golden_file, Base64URLDecode(current::FileSystem::ReadFileAsString("golden/base64test.base64url")));
 }
 
+TEST(Util, Base64Vectorized) {
+  using current::Base64Decode;
+  using current::Base64Encode;
+  using current::Base64URLDecode;
+  using current::Base64URLEncode;
+  using canonical_t = current::base64::Impl<current::base64::EncodingType::Canonical>;
+  using url_t = current::base64::Impl<current::base64::EncodingType::URL>;
+
+  std::string data;
+  for (size_t i = 0; i < 1000; ++i) {
+    data += static_cast<char>((i * 7919u) >> 3);
+  }
+  // All the lengths around the blocks of the vectorized code, against the scalar code.
+  for (size_t length = 0; length <= 300; ++length) {
+    const std::string input = data.substr(0u, length);
+    std::string canonical(canonical_t::EncodedLength(length), ' ');
+    std::string url(url_t::EncodedLength(length), ' ');
+    canonical_t::EncodeScalar(reinterpret_cast<const uint8_t*>(input.data()), length, &canonical[0]);
+    url_t::EncodeScalar(reinterpret_cast<const uint8_t*>(input.data()), length, &url[0]);
+    ASSERT_EQ(canonical, Base64Encode(input)) << length;
+    ASSERT_EQ(url, Base64URLEncode(input)) << length;
+    ASSERT_EQ(input, Base64Decode(canonical)) << length;
+    ASSERT_EQ(input, Base64URLDecode(url)) << length;
+    // And without the padding.
+    ASSERT_EQ(input, Base64URLDecode(url.substr(0u, url.find('=')))) << length;
+  }
+
+  // The output-buffer API.
+  {
+    char encoded[canonical_t::EncodedLength(1000u)];
+    ASSERT_EQ(sizeof(encoded), current::Base64EncodedLength(data.length()));
+    EXPECT_EQ(sizeof(encoded), current::Base64EncodeToBuffer(data.data(), data.length(), encoded));
+    EXPECT_EQ(Base64Encode(data), std::string(encoded, sizeof(encoded)));
+    std::vector<char> decoded(current::Base64DecodedMaxLength(sizeof(encoded)));
+    const size_t decoded_size = current::Base64DecodeToBuffer(encoded, sizeof(encoded), &decoded[0]);
+    EXPECT_EQ(data, std::string(&decoded[0], decoded_size));
+    EXPECT_EQ(sizeof(encoded), current::Base64URLEncodeToBuffer(data.data(), data.length(), encoded));
+    EXPECT_EQ(Base64URLEncode(data), std::string(encoded, sizeof(encoded)));
+    EXPECT_EQ(data.length(), current::Base64URLDecodeToBuffer(encoded, sizeof(encoded), &decoded[0]));
+  }
+
+  // The padding, or the characters of the other alphabet, deep into the input are treated as by the scalar code.
+  const std::string encoded = Base64Encode(data.substr(0u, 299u));
+  EXPECT_EQ(data.substr(0u, 150u), Base64Decode(encoded.substr(0u, 200u) + "=" + encoded.substr(200u)));
+#ifndef NDEBUG
+  EXPECT_THROW(Base64Decode(encoded.substr(0u, 200u) + "-" + encoded.substr(201u)), current::Base64DecodeException);
+  EXPECT_THROW(Base64Decode(encoded.substr(0u, 100u) + "\x80" + encoded.substr(101u)), current::Base64DecodeException);
+#endif
+}
+
 TEST(Util, CRC32) {
   const std::string test_string = "Test string";
   EXPECT_EQ(2514197138u, current::CRC32(test_string));
   EXPECT_EQ(2514197138u, current::CRC32(test_string.c_str()));
 }
 
+TEST(Util, CRC32C) {
+  std::cerr << "Using the " << current::CRC32CImplementation() << " implementation of CRC32C.\n";
+  EXPECT_EQ(0u, current::CRC32C(""));
+  EXPECT_EQ(0xe3069283u, current::CRC32C("123456789"));
+  EXPECT_EQ(0x8a9136aau, current::CRC32C(std::string(32u, '\0')));
+  EXPECT_EQ(0x62a8ab43u, current::CRC32C(std::string(32u, '\xff')));
+
+  std::string data;
+  for (size_t i = 0; i < 20000; ++i) {
+    data += static_cast<char>((i * 7919u) >> 5);
+  }
+  // The lengths around the lanes of the hardware implementation, against the portable one.
+  for (size_t length : {1u, 7u, 8u, 9u, 383u, 384u, 385u, 391u, 6143u, 6144u, 6145u, 6528u, 6535u, 12288u, 20000u}) {
+    for (size_t offset = 0; offset < 8u; ++offset) {
+      const uint8_t* p = reinterpret_cast<const uint8_t*>(data.data()) + offset;
+      const size_t n = std::min(length, data.length() - offset);
+      EXPECT_EQ(~current::impl::CRC32CPortable(~0u, p, n), current::CRC32C(0, p, n)) << length << ' ' << offset;
+#ifdef CURRENT_CRC32C_X86_SSE42
+      bool pclmul;
+      if (current::impl::CPUHasSSE42(pclmul)) {
+        EXPECT_EQ(current::impl::CRC32CPortable(~0u, p, n),
+                  current::impl::CRC32CHardware<current::impl::CRC32CShiftPortable>(~0u, p, n));
+      }
+#endif
+    }
+  }
+  // Incrementally, and combined.
+  const uint32_t whole = current::CRC32C(data);
+  for (size_t split : {0u, 1u, 100u, 6144u, 10001u, 20000u}) {
+    const uint32_t a = current::CRC32C(0, data.data(), split);
+    EXPECT_EQ(whole, current::CRC32C(a, data.data() + split, data.length() - split)) << split;
+    const uint32_t b = current::CRC32C(0, data.data() + split, data.length() - split);
+    EXPECT_EQ(whole, current::CRC32CCombine(a, b, data.length() - split)) << split;
+  }
+}
+
+TEST(Util, LZ) {
+  using current::LZCompress;
+  using current::LZDecompress;
+
+  for (const std::string& input : {std::string(),
+                                   std::string("a"),
+                                   std::string("abcd"),
+                                   std::string(1000, 'x'),
+                                   std::string("abcabcabcabcabcabcabcabcabcabcabcabc"),
+                                   current::FileSystem::ReadFileAsString("golden/base64test.txt")}) {
+    const std::string compressed = LZCompress(input);
+    EXPECT_EQ(input, LZDecompress(compressed, input.length()));
+  }
+
+  {
+    // The repetitive JSON compresses well.
+    std::string input;
+    for (int i = 0; i < 1000; ++i) {
+      input += current::strings::Printf(
+          "{\"index\":%d,\"us\":%d}\t{\"type\":\"Event\",\"value\":%d}\n", i, i * 10, i % 7);
+    }
+    const std::string compressed = LZCompress(input);
+    EXPECT_LT(compressed.length() * 4u, input.length());
+    EXPECT_EQ(input, LZDecompress(compressed, input.length()));
+
+    // Random bytes survive the round trip as well.
+    std::string random(100000, ' ');
+    uint32_t x = 42u;
+    for (auto& c : random) {
+      x = x * 1103515245u + 12345u;
+      c = static_cast<char>(x >> 24);
+    }
+    EXPECT_EQ(random, LZDecompress(LZCompress(random), random.length()));
+
+    // Broken input is detected.
+    EXPECT_THROW(LZDecompress(compressed, input.length() + 1u), current::LZDecompressException);
+    EXPECT_THROW(LZDecompress(compressed.substr(0, compressed.length() / 2), input.length()),
+                 current::LZDecompressException);
+    EXPECT_THROW(LZDecompress(std::string("\x0f\x01\x00", 3), 100u), current::LZDecompressException);
+  }
+}
+
+TEST(Util, Deflate) {
+  using current::DeflateCompress;
+  using current::DeflateDecompress;
+  using current::DeflateFormat;
+
+  std::string json;
+  for (int i = 0; i < 1000; ++i) {
+    json += current::strings::Printf(
+        "{\"index\":%d,\"us\":%d}\t{\"type\":\"Event\",\"value\":%d}\n", i, i * 10, i % 7);
+  }
+  std::string random(100000, ' ');
+  uint32_t x = 42u;
+  for (auto& c : random) {
+    x = x * 1103515245u + 12345u;
+    c = static_cast<char>(x >> 24);
+  }
+
+  for (const DeflateFormat format : {DeflateFormat::Raw, DeflateFormat::Zlib, DeflateFormat::Gzip}) {
+    for (const std::string& input : {std::string(),
+                                     std::string("a"),
+                                     std::string("abcd"),
+                                     std::string(100000, 'x'),
+                                     std::string("abcabcabcabcabcabcabcabcabcabcabcabc"),
+                                     current::FileSystem::ReadFileAsString("golden/base64test.txt"),
+                                     json,
+                                     random}) {
+      EXPECT_EQ(input, DeflateDecompress(DeflateCompress(input, format), format));
+    }
+  }
+
+  // The repetitive JSON compresses well, and the random bytes are stored as they are.
+  EXPECT_LT(DeflateCompress(json).length() * 8u, json.length());
+  EXPECT_LT(DeflateCompress(random).length(), random.length() + 100u);
+
+  // What zlib itself has compressed is decompressed.
+  std::string hello;
+  for (int i = 0; i < 20; ++i) {
+    hello += "Hello, hello, hello, hello! ";
+  }
+  EXPECT_EQ(hello,
+            DeflateDecompress(std::string("x\xda\xf3H\xcd\xc9\xc9\xd7Q\xc8\xc0\xa4\x14\x15<F\xe5"
+                                          "F\xe5\xd0\xe4\x00\xde\x04\xba\xa5",
+                                          27u),
+                              DeflateFormat::Zlib));
+
+  // Each piece of the stream can be decompressed as soon as it has been flushed, and matches the previous ones.
+  {
+    current::DeflateCompressor compressor(DeflateFormat::Raw);
+    std::string stream;
+    std::string expected;
+    for (int i = 0; i < 100; ++i) {
+      const std::string piece = current::strings::Printf("{\"index\":%d,\"type\":\"Event\"}\n", i);
+      expected += piece;
+      const std::string compressed = compressor.Compress(piece, true);
+      stream += compressed;
+      if (i > 0) {
+        EXPECT_LT(compressed.length(), piece.length());
+      }
+      // Ending the data decompressed so far with a final empty block.
+      EXPECT_EQ(expected, DeflateDecompress(stream + std::string("\x03\x00", 2u), DeflateFormat::Raw));
+    }
+    stream += compressor.Finish();
+    EXPECT_EQ(expected, DeflateDecompress(stream, DeflateFormat::Raw));
+  }
+
+  // Broken input is detected.
+  const std::string compressed = DeflateCompress(json);
+  std::string corrupted = compressed;
+  corrupted[corrupted.length() - 6u] ^= 1;
+  EXPECT_THROW(DeflateDecompress(corrupted), current::DeflateDecompressException);
+  EXPECT_THROW(DeflateDecompress(compressed.substr(0u, compressed.length() / 2u)), current::DeflateDecompressException);
+  EXPECT_THROW(DeflateDecompress(compressed, DeflateFormat::Zlib), current::DeflateDecompressException);
+  EXPECT_THROW(DeflateDecompress(compressed, DeflateFormat::Gzip, 1000u), current::DeflateDecompressException);
+}
+
 TEST(Util, SHA256) {
   EXPECT_EQ("a591a6d40bf420404a011733cfb7b190d62c65bf0bcda32b57b277d9ad9f146e",
             static_cast<std::string>(current::SHA256("Hello World")));
+  EXPECT_EQ("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", current::SHA256(""));
+}
+
+TEST(Util, SHA256Implementations) {
+  std::cerr << "Using the " << current::SHA256Implementation() << " implementation of SHA-256.\n";
+  std::string data;
+  for (size_t i = 0; i < 1000; ++i) {
+    data += static_cast<char>((i * 7919u) >> 3);
+  }
+  // All the lengths around the block boundaries and the padding, against the portable code and the reference.
+  for (size_t length = 0; length <= 300; ++length) {
+    const std::string input = data.substr(0u, length);
+    const std::string expected = sha256_impl_by_StephanBrumme::SHA256()(input);
+    ASSERT_EQ(expected, current::SHA256(input)) << length;
+    uint32_t state[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    uint32_t portable_state[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    current::impl::SHA256Compressor::Instance().compress(state, reinterpret_cast<const uint8_t*>(data.data()), 3u);
+    current::impl::SHA256CompressPortable(portable_state, reinterpret_cast<const uint8_t*>(data.data()), 3u);
+    ASSERT_EQ(0, ::memcmp(state, portable_state, sizeof(state)));
+  }
+}
+
+TEST(Util, SHA256Streaming) {
+  std::string data;
+  for (size_t i = 0; i < 5000; ++i) {
+    data += static_cast<char>(i * 31u);
+  }
+  const std::string expected = current::SHA256(data);
+  current::SHA256Hasher hasher;
+  for (size_t piece : {1u, 7u, 63u, 64u, 65u, 200u}) {
+    for (size_t i = 0; i < data.length(); i += piece) {
+      hasher.Update(data.data() + i, std::min(piece, data.length() - i));
+    }
+    EXPECT_EQ(expected, hasher.HexDigest()) << piece;
+  }
+  const std::vector<std::string> digests = current::SHA256Batch({"", "Hello World", data});
+  ASSERT_EQ(3u, digests.size());
+  EXPECT_EQ(current::SHA256(""), digests[0]);
+  EXPECT_EQ(current::SHA256("Hello World"), digests[1]);
+  EXPECT_EQ(expected, digests[2]);
 }
 
 TEST(Util, ROL64) {
@@ -329,6 +580,78 @@ TEST(Util, RandomWithFixedSeed) {
 }
 #endif
 
+TEST(Util, Xoshiro256PlusPlus) {
+  using current::random::Xoshiro256PlusPlus;
+
+  // The reference outputs, http://prng.di.unimi.it/xoshiro256plusplus.c, for the state of { 1, 2, 3, 4 }.
+  auto reference = Xoshiro256PlusPlus::FromState(1u, 2u, 3u, 4u);
+  EXPECT_EQ(41943041ull, reference());
+  EXPECT_EQ(58720359ull, reference());
+  EXPECT_EQ(3588806011781223ull, reference());
+  EXPECT_EQ(3591011842654386ull, reference());
+  EXPECT_EQ(9228616714210784205ull, reference());
+  auto jumped = Xoshiro256PlusPlus::FromState(1u, 2u, 3u, 4u);
+  jumped.Jump();
+  EXPECT_EQ(17043750140134683703ull, jumped());
+  EXPECT_EQ(2364973248208838314ull, jumped());
+  auto long_jumped = Xoshiro256PlusPlus::FromState(1u, 2u, 3u, 4u);
+  long_jumped.LongJump();
+  EXPECT_EQ(13097851138432240629ull, long_jumped());
+
+  // The streams of the same seed are the jumps from its zeroth one.
+  Xoshiro256PlusPlus stream0(42u);
+  Xoshiro256PlusPlus stream2(42u, 2u);
+  stream0.Jump();
+  stream0.Jump();
+  EXPECT_EQ(stream0(), stream2());
+
+  Xoshiro256PlusPlus g(42u);
+  std::vector<size_t> counts(3u);
+  for (size_t i = 0u; i < 30000u; ++i) {
+    const uint64_t x = g.UniformUInt64(5u, 7u);
+    ASSERT_GE(x, 5u);
+    ASSERT_LE(x, 7u);
+    ++counts[x - 5u];
+    const int64_t y = g.UniformInt64(-3, 3);
+    ASSERT_GE(y, -3);
+    ASSERT_LE(y, 3);
+    const double z = g.UniformDouble(-1.0, 1.0);
+    ASSERT_GE(z, -1.0);
+    ASSERT_LT(z, 1.0);
+  }
+  for (size_t c : counts) {
+    EXPECT_NEAR(10000.0, static_cast<double>(c), 500.0);
+  }
+  EXPECT_EQ(-5, g.UniformInt64(-5, -5));
+  g.UniformUInt64(0u, std::numeric_limits<uint64_t>::max());
+  g.UniformInt64(std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max());
+
+  std::vector<double> doubles(1000u);
+  g.FillUniformDouble(doubles.data(), doubles.size(), 10.0, 20.0);
+  double sum = 0.0;
+  for (double d : doubles) {
+    ASSERT_GE(d, 10.0);
+    ASSERT_LT(d, 20.0);
+    sum += d;
+  }
+  EXPECT_NEAR(15.0, sum / doubles.size(), 0.5);
+  std::vector<uint64_t> ints(1000u);
+  g.FillUniformUInt64(ints.data(), ints.size(), 100u, 199u);
+  for (uint64_t x : ints) {
+    ASSERT_GE(x, 100u);
+    ASSERT_LE(x, 199u);
+  }
+
+  // The threads get different streams.
+  const uint64_t main_thread_value = current::random::xoshiro256pp_tls()();
+  uint64_t other_thread_value = main_thread_value;
+  std::thread([&other_thread_value]() { other_thread_value = current::random::xoshiro256pp_tls()(); }).join();
+  EXPECT_NE(main_thread_value, other_thread_value);
+  const int r = current::random::FastRandomInt(-100, 200);
+  EXPECT_GE(r, -100);
+  EXPECT_LE(r, 200);
+}
+
 TEST(Util, WaitableTerminateSignalGotWaitedForEvent) {
   using current::WaitableTerminateSignal;
 
@@ -442,6 +765,98 @@ TEST(Util, WaitableTerminateSignalScopedRegisterer) {
   EXPECT_FALSE(signal2);
 }
 
+TEST(Util, WaitableEpoch) {
+  using current::WaitableEpoch;
+  using current::WaitableTerminateSignal;
+
+  WaitableEpoch epoch;
+  EXPECT_EQ(0u, epoch.Value());
+
+  // Does not wait if the epoch has already advanced.
+  WaitableTerminateSignal signal;
+  epoch.Advance();
+  EXPECT_EQ(1u, epoch.Value());
+  EXPECT_FALSE(epoch.WaitForAdvance(0u, signal));
+
+  // Wakes up on `Advance()`.
+  std::atomic_size_t seen_advances(0u);
+  std::thread thread([&epoch, &signal, &seen_advances]() {
+    uint64_t value = 1u;
+    while (!epoch.WaitForAdvance(value, signal)) {
+      value = epoch.Value();
+      ++seen_advances;
+    }
+  });
+  while (seen_advances < 100u) {
+    epoch.Advance();
+    std::this_thread::yield();
+  }
+
+  // Wakes up on the terminate signal followed by a `WakeAll()`.
+  signal.SignalExternalTermination();
+  epoch.WakeAll();
+  thread.join();
+  EXPECT_TRUE(epoch.WaitForAdvance(epoch.Value(), signal));
+}
+
+TEST(Util, WaitableEpochCoalescing) {
+  using current::WaitableEpoch;
+  using current::WaitableTerminateSignal;
+
+  WaitableEpoch epoch;
+  epoch.SetCoalescingWindow(std::chrono::milliseconds(50));
+  EXPECT_EQ(50000, epoch.CoalescingWindow().count());
+
+  // The waiter woken up by the first event sleeps through the rest of the burst.
+  WaitableTerminateSignal signal;
+  std::atomic_bool woken_up(false);
+  std::atomic<uint64_t> value_after_wakeup(0u);
+  std::thread thread([&epoch, &signal, &woken_up, &value_after_wakeup]() {
+    epoch.WaitForAdvance(0u, signal);
+    value_after_wakeup = epoch.Value();
+    woken_up = true;
+  });
+  while (!woken_up && epoch.Value() < 10u) {
+    epoch.Advance();
+  }
+  thread.join();
+  EXPECT_EQ(10u, value_after_wakeup);
+
+  // The terminate signal interrupts the coalescing window.
+  epoch.SetCoalescingWindow(std::chrono::seconds(60));
+  std::thread long_window_thread([&epoch, &signal]() { EXPECT_TRUE(epoch.WaitForAdvance(10u, signal)); });
+  epoch.Advance();
+  signal.SignalExternalTermination();
+  epoch.WakeAll();
+  long_window_thread.join();
+}
+
+TEST(Util, Future) {
+  {
+    std::promise<std::string> promise;
+    current::Future<std::string, current::StrictFuture::Strict> future(promise.get_future());
+    promise.set_value("from the promise");
+    EXPECT_EQ("from the promise", future.Go());
+  }
+  {
+    auto ready = current::Future<std::string, current::StrictFuture::Strict>::Ready("ready");
+    current::Future<std::string> moved(std::move(ready));
+    moved.Wait();
+    EXPECT_EQ("ready", moved.Go());
+  }
+  {
+    auto failed = current::Future<std::string, current::StrictFuture::Strict>::Failed(
+        std::make_exception_ptr(current::Exception("failed")));
+    failed.Wait();
+    try {
+      failed.Go();
+      ASSERT_TRUE(false);
+    } catch (const current::Exception& e) {
+      EXPECT_EQ("failed", e.OriginalDescription());
+    }
+  }
+}
+
 TEST(Util, LazyInstantiation) {
   using current::DelayedInstantiate;
   using current::DelayedInstantiateFromTuple;
@@ -768,6 +1183,47 @@ TEST(CustomHashFunction, Smoke) {
   EXPECT_EQ(2u, GenericHashFunction<WithHashFunctionTestStruct>()(WithHashFunctionTestStruct()));
 }
 
+TEST(FastHash, Smoke) {
+  using current::FastHash;
+
+  EXPECT_EQ(FastHash("hello"), FastHash(std::string("hello")));
+  EXPECT_EQ(FastHash("hello"), FastHash(std::string("hello, world").substr(0u, 5u)));
+  EXPECT_NE(FastHash("hello"), FastHash("hello", 1u));
+  EXPECT_NE(FastHash(""), FastHash(std::string(1u, '\0')));
+
+  // All the code paths, by the length of the input, tell the strings differing by one bit apart.
+  std::set<uint64_t> hashes;
+  size_t total = 0u;
+  for (size_t length = 1u; length <= 150u; ++length) {
+    std::string s(length, 'x');
+    hashes.insert(FastHash(s));
+    for (size_t i = 0u; i < length; ++i) {
+      s[i] ^= 1;
+      hashes.insert(FastHash(s));
+      s[i] ^= 1;
+    }
+    total += length + 1u;
+  }
+  EXPECT_EQ(total, hashes.size());
+
+  // The keys hashed by `GenericHashFunction` are spread over the buckets evenly.
+  const auto hasher = current::GenericHashFunction<std::string>();
+  EXPECT_EQ(static_cast<size_t>(FastHash("key")), hasher("key"));
+  std::vector<size_t> buckets(16u);
+  for (int i = 0; i < 16000; ++i) {
+    ++buckets[hasher("key" + std::to_string(i)) % 16u];
+  }
+  for (size_t count : buckets) {
+    EXPECT_GT(count, 850u);
+    EXPECT_LT(count, 1150u);
+  }
+
+  // The composite keys are hashed in the order-dependent way.
+  const auto pair_hasher = current::GenericHashFunction<std::pair<int, int>>();
+  EXPECT_NE(pair_hasher(std::make_pair(1, 2)), pair_hasher(std::make_pair(2, 1)));
+  EXPECT_EQ(pair_hasher(std::make_pair(1, 2)), pair_hasher(std::make_pair(1, 2)));
+}
+
 struct ObjectWithInterface {
   int calls = 0;
   int total_calls() { return ++calls; }
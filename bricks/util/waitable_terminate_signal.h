@@ -26,6 +26,7 @@ SOFTWARE.
 #define BRICKS_UTIL_WAITABLE_TERMINATE_SIGNAL_H
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <unordered_set>
@@ -126,6 +127,71 @@ class WaitableTerminateSignalBulkNotifier {
   std::unordered_set<WaitableTerminateSignal*> active_signals_;
 };
 
+
+// A counter of events that threads can wait upon, a lighter-weight alternative to the bulk notifier above.
+// The publisher calls `Advance()` once per event, which costs one atomic increment when nobody is waiting.
+// The waiters remember the `Value()` they have observed, check their own state, and then `WaitForAdvance()`,
+// which does not hold any external mutex, so that the threads woken up by the same event do not contend on one.
+//
+// With a non-zero coalescing window, a waiter woken up by an event keeps sleeping for that long, so that
+// a burst of events results in a single wakeup, at the cost of this much extra latency. While it sleeps,
+// the waiter is not counted as waiting, so the events of the burst do not notify it, or anyone, again.
+class WaitableEpoch {
+ public:
+  // Thread-safe.
+  uint64_t Value() const noexcept { return epoch_; }
+
+  // Thread-safe.
+  void Advance() {
+    ++epoch_;
+    if (waiters_) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      condition_variable_.notify_all();
+    }
+  }
+
+  // Wakes up all the waiters, for them to re-check their terminate signals. Thread-safe.
+  void WakeAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    condition_variable_.notify_all();
+  }
+
+  // Thread-safe.
+  void SetCoalescingWindow(std::chrono::microseconds window) noexcept { coalescing_window_us_ = window.count(); }
+  std::chrono::microseconds CoalescingWindow() const noexcept {
+    return std::chrono::microseconds(coalescing_window_us_);
+  }
+
+  // Waits until `Value()` is no longer `observed_value`, or until the signal is sent. Whoever sends the signal
+  // should then call `WakeAll()`. Returns whether the signal was sent.
+  bool WaitForAdvance(uint64_t observed_value, const WaitableTerminateSignal& signal) {
+    if (signal) {
+      return true;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (epoch_ == observed_value) {
+      // Registering as a waiter before re-checking the counter makes sure `Advance()` does not skip notifying.
+      ++waiters_;
+      condition_variable_.wait(lock, [this, observed_value, &signal]() {
+        return signal || epoch_ != observed_value;
+      });
+      --waiters_;
+    }
+    const std::chrono::microseconds window = CoalescingWindow();
+    if (window.count() > 0) {
+      condition_variable_.wait_for(lock, window, [&signal]() { return static_cast<bool>(signal); });
+    }
+    return signal;
+  }
+
+ private:
+  std::atomic<uint64_t> epoch_{0u};
+  std::atomic<uint64_t> waiters_{0u};
+  std::atomic<int64_t> coalescing_window_us_{0};
+  std::mutex mutex_;
+  std::condition_variable condition_variable_;
+};
+
 }  // namespace current
 
 #endif  // BRICKS_UTIL_WAITABLE_TERMINATE_SIGNAL_H
@@ -0,0 +1,363 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// The block-structured container of `CompactTSV`-s, to unpack huge inputs in parallel, and to seek to any row.
+//
+// `CompactTSVBlockWriter` splits the rows into blocks of `rows_per_block` rows, or of `max_block_bytes` packed
+// bytes, whichever is reached first, each of which is packed as a `CompactTSV` of its own, starting with a full row,
+// and thus is decoded independently of the others. Each block is passed to the sink, be it an `std::ostream`
+// or any `void(const char*, size_t)` function, once it is complete, so that the memory used while packing
+// is bounded by one block plus the dictionary.
+//
+// The strings are either stored within each block, or, with `CompactTSVDictionary::Shared`, in the shared
+// dictionary, kept in memory while writing. Once, after a block, the shared dictionary has grown beyond
+// `max_dictionary_bytes`, it is written out, and the next blocks start a new one.
+//
+// The layout is, with all the integers little-endian `uint64_t`-s:
+//   * The "CTSVBLK1" magic.
+//   * The blocks, each followed by the shared dictionary, if it was written out after that block.
+//   * The dictionaries: `{ offset, length }` per dictionary.
+//   * The index: `{ offset, length, first_row, rows, dictionary }` per block, with `dictionary` being the index
+//     of the dictionary of the block, or `kNoDictionary` for the blocks that hold their strings themselves.
+//   * The footer: `{ index_offset, block_count, row_count, dim, dictionaries_offset, dictionary_count }`, and magic.
+//
+// `CompactTSVBlocks` reads the container from memory, and `CompactTSVBlocksFile` memory-maps it from a file.
+// `UnpackRows(begin, end, f)` only decodes the blocks the rows are in, from the start of the first one of them,
+// and `ParallelUnpack(executor, f)` decodes the blocks on the workers of the `WorkStealingExecutor`, calling `f`
+// concurrently, and in no particular order across the blocks. The rows are passed to `f` as by `CompactTSV::Unpack`.
+
+#ifndef COMPACTTSV_BLOCKS_H
+#define COMPACTTSV_BLOCKS_H
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "compact_tsv.h"
+
+#include "../bricks/exception.h"
+#include "../bricks/file/mmap.h"
+#include "../bricks/sync/executor.h"
+
+struct CompactTSVBlocksException : current::Exception {
+  using current::Exception::Exception;
+};
+
+struct CompactTSVBlocksFormatException : CompactTSVBlocksException {
+  using CompactTSVBlocksException::CompactTSVBlocksException;
+};
+
+struct CompactTSVBlocksRowOutOfRangeException : CompactTSVBlocksException {
+  using CompactTSVBlocksException::CompactTSVBlocksException;
+};
+
+enum class CompactTSVDictionary : bool { PerBlock = false, Shared = true };
+
+namespace compact_tsv_blocks {
+
+constexpr static char kMagic[8] = {'C', 'T', 'S', 'V', 'B', 'L', 'K', '1'};
+constexpr static uint64_t kNoDictionary = static_cast<uint64_t>(-1);
+
+struct DictionaryEntry final {
+  uint64_t offset;
+  uint64_t length;
+};
+
+struct IndexEntry final {
+  uint64_t offset;
+  uint64_t length;
+  uint64_t first_row;
+  uint64_t rows;
+  uint64_t dictionary;
+};
+
+struct Footer final {
+  uint64_t index_offset;
+  uint64_t block_count;
+  uint64_t row_count;
+  uint64_t dim;
+  uint64_t dictionaries_offset;
+  uint64_t dictionary_count;
+  char magic[8];
+};
+
+static_assert(sizeof(DictionaryEntry) == 16u, "");
+static_assert(sizeof(IndexEntry) == 40u, "");
+static_assert(sizeof(Footer) == 56u, "");
+
+struct MappedFile {
+  current::MemoryMappedFile mapping;
+  explicit MappedFile(const std::string& file_name) : mapping(file_name) {}
+};
+
+}  // namespace compact_tsv_blocks
+
+struct CompactTSVBlockWriterOptions final {
+  size_t rows_per_block = 1u << 16;
+  size_t max_block_bytes = 1u << 26;
+  CompactTSVDictionary dictionary = CompactTSVDictionary::PerBlock;
+  size_t max_dictionary_bytes = 1u << 28;  // Must stay below 4GB, as the strings are at 32-bit offsets within it.
+};
+
+class CompactTSVBlockWriter final {
+ public:
+  using sink_t = std::function<void(const char* data, size_t size)>;
+  constexpr static size_t kDefaultRowsPerBlock = 1u << 16;
+
+  CompactTSVBlockWriter(sink_t sink, const CompactTSVBlockWriterOptions& options)
+      : sink_(std::move(sink)), options_(options) {
+    options_.rows_per_block = std::max(options_.rows_per_block, static_cast<size_t>(1u));
+    Write(compact_tsv_blocks::kMagic, sizeof(compact_tsv_blocks::kMagic));
+  }
+
+  CompactTSVBlockWriter(std::ostream& os, const CompactTSVBlockWriterOptions& options)
+      : CompactTSVBlockWriter(
+            [&os](const char* data, size_t size) { os.write(data, static_cast<std::streamsize>(size)); }, options) {}
+
+  explicit CompactTSVBlockWriter(std::ostream& os,
+                                 size_t rows_per_block = kDefaultRowsPerBlock,
+                                 CompactTSVDictionary dictionary = CompactTSVDictionary::PerBlock)
+      : CompactTSVBlockWriter(os, Options(rows_per_block, dictionary)) {}
+
+  void operator()(const std::vector<std::string>& row) {
+    CURRENT_ASSERT(!done_);  // TODO(batman): Exception.
+    if (!dim_) {
+      dim_ = row.size();
+    }
+    if (!block_) {
+      block_ = (options_.dictionary == CompactTSVDictionary::Shared)
+                   ? std::make_unique<CompactTSV>(dictionary_, dim_)
+                   : std::make_unique<CompactTSV>(dim_);
+    }
+    (*block_)(row);
+    if (++block_rows_ == options_.rows_per_block || block_->PackedSize() >= options_.max_block_bytes) {
+      FlushBlock();
+    }
+  }
+
+  void Finalize() {
+    CURRENT_ASSERT(!done_);  // TODO(batman): Exception.
+    FlushBlock();
+    FlushDictionary();
+    compact_tsv_blocks::Footer footer;
+    footer.dictionaries_offset = offset_;
+    footer.dictionary_count = dictionaries_.size();
+    Write(dictionaries_.data(), dictionaries_.size() * sizeof(compact_tsv_blocks::DictionaryEntry));
+    footer.index_offset = offset_;
+    footer.block_count = index_.size();
+    Write(index_.data(), index_.size() * sizeof(compact_tsv_blocks::IndexEntry));
+    footer.row_count = rows_;
+    footer.dim = dim_;
+    std::memcpy(footer.magic, compact_tsv_blocks::kMagic, sizeof(footer.magic));
+    Write(&footer, sizeof(footer));
+    done_ = true;
+  }
+
+ private:
+  static CompactTSVBlockWriterOptions Options(size_t rows_per_block, CompactTSVDictionary dictionary) {
+    CompactTSVBlockWriterOptions options;
+    options.rows_per_block = rows_per_block;
+    options.dictionary = dictionary;
+    return options;
+  }
+
+  void Write(const void* data, size_t length) {
+    if (length) {
+      sink_(reinterpret_cast<const char*>(data), length);
+      offset_ += length;
+    }
+  }
+
+  void FlushBlock() {
+    if (block_) {
+      block_->Finalize();
+      const std::string& packed = block_->GetPackedString();
+      const uint64_t dictionary = (options_.dictionary == CompactTSVDictionary::Shared)
+                                      ? dictionaries_.size()
+                                      : compact_tsv_blocks::kNoDictionary;
+      index_.push_back(compact_tsv_blocks::IndexEntry{offset_, packed.length(), rows_, block_rows_, dictionary});
+      Write(packed.data(), packed.length());
+      rows_ += block_rows_;
+      block_rows_ = 0u;
+      block_ = nullptr;
+      dictionary_used_ = (dictionary != compact_tsv_blocks::kNoDictionary);
+      if (dictionary_.data.length() >= options_.max_dictionary_bytes) {
+        FlushDictionary();
+      }
+    }
+  }
+
+  void FlushDictionary() {
+    if (dictionary_used_) {
+      dictionaries_.push_back(compact_tsv_blocks::DictionaryEntry{offset_, dictionary_.data.length()});
+      Write(dictionary_.data.data(), dictionary_.data.length());
+      dictionary_ = CompactTSV::SharedDictionary();
+      dictionary_used_ = false;
+    }
+  }
+
+  const sink_t sink_;
+  CompactTSVBlockWriterOptions options_;
+  bool done_ = false;
+  size_t dim_ = 0u;
+  uint64_t offset_ = 0u;
+  uint64_t rows_ = 0u;
+  std::unique_ptr<CompactTSV> block_;
+  size_t block_rows_ = 0u;
+  CompactTSV::SharedDictionary dictionary_;
+  bool dictionary_used_ = false;
+  std::vector<compact_tsv_blocks::DictionaryEntry> dictionaries_;
+  std::vector<compact_tsv_blocks::IndexEntry> index_;
+};
+
+class CompactTSVBlocks {
+ public:
+  CompactTSVBlocks(const uint8_t* data, size_t length) : data_(data) {
+    using compact_tsv_blocks::DictionaryEntry;
+    using compact_tsv_blocks::Footer;
+    using compact_tsv_blocks::IndexEntry;
+    using compact_tsv_blocks::kMagic;
+    if (length < sizeof(kMagic) + sizeof(Footer) || std::memcmp(data, kMagic, sizeof(kMagic))) {
+      CURRENT_THROW(CompactTSVBlocksFormatException("Not a CompactTSV blocks container."));
+    }
+    std::memcpy(&footer_, data + length - sizeof(Footer), sizeof(Footer));
+    const uint64_t index_end = length - sizeof(Footer);
+    if (std::memcmp(footer_.magic, kMagic, sizeof(kMagic)) || footer_.index_offset > index_end ||
+        footer_.block_count != (index_end - footer_.index_offset) / sizeof(IndexEntry) ||
+        footer_.index_offset + footer_.block_count * sizeof(IndexEntry) != index_end ||
+        footer_.dictionaries_offset < sizeof(kMagic) || footer_.dictionaries_offset > footer_.index_offset ||
+        footer_.dictionary_count != (footer_.index_offset - footer_.dictionaries_offset) / sizeof(DictionaryEntry) ||
+        footer_.dictionaries_offset + footer_.dictionary_count * sizeof(DictionaryEntry) != footer_.index_offset) {
+      CURRENT_THROW(CompactTSVBlocksFormatException("Malformed CompactTSV blocks container footer."));
+    }
+    const uint64_t data_end = footer_.dictionaries_offset;
+    const auto in_data = [data_end](uint64_t offset, uint64_t length) {
+      return offset >= sizeof(kMagic) && offset <= data_end && length <= data_end - offset;
+    };
+    dictionaries_.resize(footer_.dictionary_count);
+    if (!dictionaries_.empty()) {
+      std::memcpy(
+          dictionaries_.data(), data + footer_.dictionaries_offset, dictionaries_.size() * sizeof(DictionaryEntry));
+    }
+    for (const DictionaryEntry& d : dictionaries_) {
+      if (!in_data(d.offset, d.length)) {
+        CURRENT_THROW(CompactTSVBlocksFormatException("Malformed CompactTSV blocks container dictionaries."));
+      }
+    }
+    index_.resize(footer_.block_count);
+    if (!index_.empty()) {
+      std::memcpy(index_.data(), data + footer_.index_offset, index_.size() * sizeof(IndexEntry));
+    }
+    uint64_t rows = 0u;
+    for (const IndexEntry& e : index_) {
+      if (!in_data(e.offset, e.length) || e.first_row != rows || !e.rows ||
+          (e.dictionary != compact_tsv_blocks::kNoDictionary && e.dictionary >= dictionaries_.size())) {
+        CURRENT_THROW(CompactTSVBlocksFormatException("Malformed CompactTSV blocks container index."));
+      }
+      rows += e.rows;
+    }
+    if (rows != footer_.row_count) {
+      CURRENT_THROW(CompactTSVBlocksFormatException("Malformed CompactTSV blocks container index."));
+    }
+  }
+
+  explicit CompactTSVBlocks(const std::string& packed)
+      : CompactTSVBlocks(reinterpret_cast<const uint8_t*>(packed.data()), packed.length()) {}
+
+  size_t Rows() const { return static_cast<size_t>(footer_.row_count); }
+  size_t Dim() const { return static_cast<size_t>(footer_.dim); }
+  size_t Blocks() const { return index_.size(); }
+  size_t Dictionaries() const { return dictionaries_.size(); }
+
+  template <typename F>
+  size_t UnpackBlock(size_t block, F&& f, size_t skip = 0u, size_t limit = static_cast<size_t>(-1)) const {
+    const compact_tsv_blocks::IndexEntry& e = index_[block];
+    const uint8_t* begin = data_ + e.offset;
+    const uint8_t* strings =
+        (e.dictionary == compact_tsv_blocks::kNoDictionary) ? begin : data_ + dictionaries_[e.dictionary].offset;
+    return CompactTSV::UnpackRange(std::forward<F>(f), strings, begin, begin + e.length, skip, limit);
+  }
+
+  template <typename F>
+  size_t Unpack(F&& f) const {
+    size_t total = 0u;
+    for (size_t block = 0u; block < index_.size(); ++block) {
+      total += UnpackBlock(block, f);
+    }
+    return total;
+  }
+
+  // Calls `f` on the rows `[begin, end)`, in order.
+  template <typename F>
+  size_t UnpackRows(size_t begin, size_t end, F&& f) const {
+    if (begin > end || end > Rows()) {
+      CURRENT_THROW(CompactTSVBlocksRowOutOfRangeException("Rows out of range."));
+    }
+    if (begin == end) {
+      return 0u;
+    }
+    size_t total = 0u;
+    auto it = std::upper_bound(index_.begin(),
+                               index_.end(),
+                               static_cast<uint64_t>(begin),
+                               [](uint64_t row, const compact_tsv_blocks::IndexEntry& e) { return row < e.first_row; });
+    for (--it; begin < end; ++it) {
+      const size_t skip = begin - static_cast<size_t>(it->first_row);
+      const size_t limit = std::min(end - begin, static_cast<size_t>(it->rows) - skip);
+      total += UnpackBlock(static_cast<size_t>(it - index_.begin()), f, skip, limit);
+      begin += limit;
+    }
+    return total;
+  }
+
+  template <typename F>
+  void UnpackRow(size_t row, F&& f) const {
+    UnpackRows(row, row + 1u, std::forward<F>(f));
+  }
+
+  template <typename F>
+  size_t ParallelUnpack(current::WorkStealingExecutor& executor, F&& f) const {
+    executor.ParallelFor(0u, index_.size(), [this, &f](size_t block) { UnpackBlock(block, f); });
+    return Rows();
+  }
+
+ private:
+  const uint8_t* const data_;
+  compact_tsv_blocks::Footer footer_;
+  std::vector<compact_tsv_blocks::DictionaryEntry> dictionaries_;
+  std::vector<compact_tsv_blocks::IndexEntry> index_;
+};
+
+class CompactTSVBlocksFile final : private compact_tsv_blocks::MappedFile, public CompactTSVBlocks {
+ public:
+  explicit CompactTSVBlocksFile(const std::string& file_name)
+      : compact_tsv_blocks::MappedFile(file_name),
+        CompactTSVBlocks(reinterpret_cast<const uint8_t*>(mapping.data()), mapping.file_size()) {}
+};
+
+#endif  // COMPACTTSV_BLOCKS_H
@@ -0,0 +1,616 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// The columnar container of TSV rows, for the readers that only need a few of the many columns.
+//
+// `CompactTSVColumnarWriter` splits the rows into blocks of `rows_per_block` rows, and stores each block
+// column by column, so that unpacking some columns of a block does not touch the bytes of the others.
+// Each column of each block is encoded on its own, with whichever of the encodings is the most compact for it:
+//   * `Dictionary`: the distinct values of the column within the block, and the bit-packed indexes into them.
+//   * `DictionaryRLE`: the same dictionary, and the runs of `{ index, length }`, for the columns of repeated values.
+//   * `DeltaInteger`: for the columns of canonically formatted integers only, the first value, followed by
+//     the bit-packed zigzag-encoded differences between the consecutive ones.
+//
+// The layout is, with all the integers little-endian:
+//   * The "CTSVCOL1" magic.
+//   * The blocks, back to back, each being `dim + 1` `uint64_t` offsets of its columns, and the columns.
+//   * The names of the columns, if set via `SetColumnNames()`, tab-separated.
+//   * The index: `{ offset, length, first_row, rows }` per block.
+//   * The footer: `{ index_offset, block_count, row_count, dim, names_offset, names_length }`, and magic.
+//
+// `CompactTSVColumnar` reads the container from memory, and `CompactTSVColumnarFile` memory-maps it from a file.
+// `Unpack(columns, f)` calls `f` with an `std::vector<std::string_view>` of the requested columns of each row,
+// in the order requested. The views are valid until `f` returns.
+
+#ifndef COMPACTTSV_COLUMNAR_H
+#define COMPACTTSV_COLUMNAR_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../bricks/exception.h"
+#include "../bricks/file/mmap.h"
+#include "../bricks/sync/executor.h"
+
+struct CompactTSVColumnarException : current::Exception {
+  using current::Exception::Exception;
+};
+
+struct CompactTSVColumnarFormatException : CompactTSVColumnarException {
+  using CompactTSVColumnarException::CompactTSVColumnarException;
+};
+
+struct CompactTSVColumnarColumnOutOfRangeException : CompactTSVColumnarException {
+  using CompactTSVColumnarException::CompactTSVColumnarException;
+};
+
+enum class CompactTSVColumnEncoding : uint8_t { Dictionary = 0, DictionaryRLE = 1, DeltaInteger = 2 };
+
+namespace compact_tsv_columnar {
+
+constexpr static char kMagic[8] = {'C', 'T', 'S', 'V', 'C', 'O', 'L', '1'};
+
+struct IndexEntry final {
+  uint64_t offset;
+  uint64_t length;
+  uint64_t first_row;
+  uint64_t rows;
+};
+
+struct Footer final {
+  uint64_t index_offset;
+  uint64_t block_count;
+  uint64_t row_count;
+  uint64_t dim;
+  uint64_t names_offset;
+  uint64_t names_length;
+  char magic[8];
+};
+
+static_assert(sizeof(IndexEntry) == 32u, "");
+static_assert(sizeof(Footer) == 56u, "");
+
+// Only the integers that print back exactly as they were are delta-encoded, so that "007" or "+1" stay strings.
+// At most 18 digits, so that the value never overflows.
+inline bool ParseCanonicalInteger(const std::string& s, int64_t& result) {
+  const bool negative = !s.empty() && s[0] == '-';
+  const size_t digits = s.length() - (negative ? 1u : 0u);
+  if (!digits || digits > 18u || (s[negative] == '0' && (digits > 1u || negative))) {
+    return false;
+  }
+  int64_t value = 0;
+  for (size_t i = negative; i < s.length(); ++i) {
+    if (s[i] < '0' || s[i] > '9') {
+      return false;
+    }
+    value = value * 10 + (s[i] - '0');
+  }
+  result = negative ? -value : value;
+  return true;
+}
+
+inline uint64_t ZigZag(int64_t x) { return (static_cast<uint64_t>(x) << 1) ^ static_cast<uint64_t>(x >> 63); }
+inline int64_t UnZigZag(uint64_t x) { return static_cast<int64_t>((x >> 1) ^ (~(x & 1u) + 1u)); }
+
+inline uint8_t BitWidth(uint64_t max_value) {
+  uint8_t width = 0u;
+  for (; max_value; max_value >>= 1) {
+    ++width;
+  }
+  return width;
+}
+
+inline size_t BitPackedBytes(size_t count, uint8_t width) { return (count * width + 63u) / 64u * 8u; }
+
+template <typename T>
+void AppendPOD(std::string& out, T x) {
+  out.append(reinterpret_cast<const char*>(&x), sizeof(T));
+}
+
+inline void BitPack(const std::vector<uint64_t>& values, uint8_t width, std::string& out) {
+  if (!width) {
+    return;
+  }
+  uint64_t word = 0u;
+  size_t bits = 0u;
+  for (uint64_t v : values) {
+    word |= v << bits;
+    if (bits + width >= 64u) {
+      AppendPOD(out, word);
+      bits = bits + width - 64u;
+      word = bits ? (v >> (width - bits)) : 0u;
+    } else {
+      bits += width;
+    }
+  }
+  if (bits) {
+    AppendPOD(out, word);
+  }
+}
+
+inline uint64_t BitGet(const uint8_t* words, size_t i, uint8_t width) {
+  if (!width) {
+    return 0u;
+  }
+  const size_t bit = i * width;
+  const size_t shift = bit % 64u;
+  uint64_t lo;
+  std::memcpy(&lo, words + bit / 64u * 8u, sizeof(lo));
+  uint64_t v = lo >> shift;
+  if (shift + width > 64u) {
+    uint64_t hi;
+    std::memcpy(&hi, words + bit / 64u * 8u + 8u, sizeof(hi));
+    v |= hi << (64u - shift);
+  }
+  return width == 64u ? v : (v & ((uint64_t(1) << width) - 1u));
+}
+
+inline void EncodeColumn(const std::vector<std::string>& cells, std::string& out) {
+  const size_t rows = cells.size();
+
+  std::vector<int64_t> integers(rows);
+  bool all_integers = true;
+  for (size_t i = 0u; all_integers && i < rows; ++i) {
+    all_integers = ParseCanonicalInteger(cells[i], integers[i]);
+  }
+
+  std::unordered_map<std::string, uint32_t> dictionary;
+  std::vector<const std::string*> values;
+  std::vector<uint64_t> codes(rows);
+  size_t total_length = 0u;
+  size_t runs = 0u;
+  for (size_t i = 0u; i < rows; ++i) {
+    const auto it = dictionary.emplace(cells[i], static_cast<uint32_t>(values.size()));
+    if (it.second) {
+      values.push_back(&it.first->first);
+      total_length += cells[i].length();
+    }
+    codes[i] = it.first->second;
+    runs += (!i || codes[i] != codes[i - 1u]);
+  }
+  const uint8_t code_width = BitWidth(values.size() - 1u);
+  const size_t dictionary_bytes = 1u + 4u + 4u * (values.size() + 1u) + total_length;
+  const size_t plain_bytes = dictionary_bytes + 1u + BitPackedBytes(rows, code_width);
+  const size_t rle_bytes = dictionary_bytes + 4u + 8u * runs;
+
+  std::vector<uint64_t> deltas;
+  uint8_t delta_width = 0u;
+  if (all_integers) {
+    deltas.resize(rows - 1u);
+    uint64_t max_delta = 0u;
+    for (size_t i = 1u; i < rows; ++i) {
+      deltas[i - 1u] = ZigZag(integers[i] - integers[i - 1u]);
+      max_delta = std::max(max_delta, deltas[i - 1u]);
+    }
+    delta_width = BitWidth(max_delta);
+  }
+  const size_t delta_bytes = 1u + 8u + 1u + BitPackedBytes(rows - 1u, delta_width);
+
+  if (all_integers && delta_bytes <= std::min(plain_bytes, rle_bytes)) {
+    out.push_back(static_cast<char>(CompactTSVColumnEncoding::DeltaInteger));
+    AppendPOD(out, integers[0]);
+    out.push_back(static_cast<char>(delta_width));
+    BitPack(deltas, delta_width, out);
+    return;
+  }
+
+  const bool rle = rle_bytes < plain_bytes;
+  out.push_back(
+      static_cast<char>(rle ? CompactTSVColumnEncoding::DictionaryRLE : CompactTSVColumnEncoding::Dictionary));
+  AppendPOD(out, static_cast<uint32_t>(values.size()));
+  uint32_t offset = 0u;
+  for (const std::string* s : values) {
+    AppendPOD(out, offset);
+    offset += static_cast<uint32_t>(s->length());
+  }
+  AppendPOD(out, offset);
+  for (const std::string* s : values) {
+    out.append(*s);
+  }
+  if (rle) {
+    AppendPOD(out, static_cast<uint32_t>(runs));
+    for (size_t i = 0u; i < rows;) {
+      size_t j = i + 1u;
+      while (j < rows && codes[j] == codes[i]) {
+        ++j;
+      }
+      AppendPOD(out, static_cast<uint32_t>(codes[i]));
+      AppendPOD(out, static_cast<uint32_t>(j - i));
+      i = j;
+    }
+  } else {
+    out.push_back(static_cast<char>(code_width));
+    BitPack(codes, code_width, out);
+  }
+}
+
+// Reads the column bytes, throwing on reads past their end, so that a corrupted container never reads out of bounds.
+class ColumnCursor final {
+ public:
+  ColumnCursor(const uint8_t* begin, const uint8_t* end) : p_(begin), end_(end) {}
+
+  const uint8_t* Take(size_t n) {
+    if (static_cast<size_t>(end_ - p_) < n) {
+      CURRENT_THROW(CompactTSVColumnarFormatException("Malformed CompactTSV columnar block."));
+    }
+    const uint8_t* result = p_;
+    p_ += n;
+    return result;
+  }
+
+  template <typename T>
+  T Read() {
+    T x;
+    std::memcpy(&x, Take(sizeof(T)), sizeof(T));
+    return x;
+  }
+
+ private:
+  const uint8_t* p_;
+  const uint8_t* const end_;
+};
+
+// Decodes one column of one block into `cells`, keeping the formatted integers, if any, in `arena`.
+inline void DecodeColumn(const uint8_t* begin,
+                         const uint8_t* end,
+                         size_t rows,
+                         std::vector<std::string_view>& cells,
+                         std::string& arena) {
+  ColumnCursor cursor(begin, end);
+  cells.resize(rows);
+  const auto encoding = static_cast<CompactTSVColumnEncoding>(cursor.Read<uint8_t>());
+  if (encoding == CompactTSVColumnEncoding::DeltaInteger) {
+    int64_t value = cursor.Read<int64_t>();
+    const uint8_t width = cursor.Read<uint8_t>();
+    if (width > 64u) {
+      CURRENT_THROW(CompactTSVColumnarFormatException("Malformed CompactTSV columnar block."));
+    }
+    const uint8_t* words = cursor.Take(BitPackedBytes(rows - 1u, width));
+    constexpr size_t kMaxIntegerLength = 20u;
+    arena.resize(rows * kMaxIntegerLength);
+    std::vector<size_t> lengths(rows);
+    for (size_t i = 0u; i < rows; ++i) {
+      if (i) {
+        value = static_cast<int64_t>(static_cast<uint64_t>(value) +
+                                     static_cast<uint64_t>(UnZigZag(BitGet(words, i - 1u, width))));
+      }
+      char* p = &arena[i * kMaxIntegerLength];
+      lengths[i] = static_cast<size_t>(std::to_chars(p, p + kMaxIntegerLength, value).ptr - p);
+    }
+    for (size_t i = 0u; i < rows; ++i) {
+      cells[i] = std::string_view(arena.data() + i * kMaxIntegerLength, lengths[i]);
+    }
+  } else if (encoding == CompactTSVColumnEncoding::Dictionary || encoding == CompactTSVColumnEncoding::DictionaryRLE) {
+    const uint32_t count = cursor.Read<uint32_t>();
+    const uint8_t* offsets = cursor.Take((static_cast<size_t>(count) + 1u) * sizeof(uint32_t));
+    uint32_t strings_length;
+    std::memcpy(&strings_length, offsets + count * sizeof(uint32_t), sizeof(uint32_t));
+    const char* strings = reinterpret_cast<const char*>(cursor.Take(strings_length));
+    std::vector<std::string_view> values(count);
+    for (uint32_t i = 0u; i < count; ++i) {
+      uint32_t from, to;
+      std::memcpy(&from, offsets + i * sizeof(uint32_t), sizeof(uint32_t));
+      std::memcpy(&to, offsets + (i + 1u) * sizeof(uint32_t), sizeof(uint32_t));
+      if (from > to || to > strings_length) {
+        CURRENT_THROW(CompactTSVColumnarFormatException("Malformed CompactTSV columnar block."));
+      }
+      values[i] = std::string_view(strings + from, to - from);
+    }
+    const auto value = [&values](uint64_t code) {
+      if (code >= values.size()) {
+        CURRENT_THROW(CompactTSVColumnarFormatException("Malformed CompactTSV columnar block."));
+      }
+      return values[static_cast<size_t>(code)];
+    };
+    if (encoding == CompactTSVColumnEncoding::Dictionary) {
+      const uint8_t width = cursor.Read<uint8_t>();
+      if (width > 32u) {
+        CURRENT_THROW(CompactTSVColumnarFormatException("Malformed CompactTSV columnar block."));
+      }
+      const uint8_t* words = cursor.Take(BitPackedBytes(rows, width));
+      for (size_t i = 0u; i < rows; ++i) {
+        cells[i] = value(BitGet(words, i, width));
+      }
+    } else {
+      const uint32_t runs = cursor.Read<uint32_t>();
+      size_t row = 0u;
+      for (uint32_t run = 0u; run < runs; ++run) {
+        const std::string_view v = value(cursor.Read<uint32_t>());
+        const uint32_t length = cursor.Read<uint32_t>();
+        if (length > rows - row) {
+          CURRENT_THROW(CompactTSVColumnarFormatException("Malformed CompactTSV columnar block."));
+        }
+        std::fill(cells.begin() + row, cells.begin() + row + length, v);
+        row += length;
+      }
+      if (row != rows) {
+        CURRENT_THROW(CompactTSVColumnarFormatException("Malformed CompactTSV columnar block."));
+      }
+    }
+  } else {
+    CURRENT_THROW(CompactTSVColumnarFormatException("Unknown CompactTSV columnar encoding."));
+  }
+}
+
+struct MappedFile {
+  current::MemoryMappedFile mapping;
+  explicit MappedFile(const std::string& file_name) : mapping(file_name) {}
+};
+
+}  // namespace compact_tsv_columnar
+
+class CompactTSVColumnarWriter final {
+ public:
+  using sink_t = std::function<void(const char* data, size_t size)>;
+  constexpr static size_t kDefaultRowsPerBlock = 1u << 16;
+
+  CompactTSVColumnarWriter(sink_t sink, size_t rows_per_block = kDefaultRowsPerBlock)
+      : sink_(std::move(sink)), rows_per_block_(std::max(rows_per_block, static_cast<size_t>(1u))) {
+    Write(compact_tsv_columnar::kMagic, sizeof(compact_tsv_columnar::kMagic));
+  }
+
+  explicit CompactTSVColumnarWriter(std::ostream& os, size_t rows_per_block = kDefaultRowsPerBlock)
+      : CompactTSVColumnarWriter(
+            [&os](const char* data, size_t size) { os.write(data, static_cast<std::streamsize>(size)); },
+            rows_per_block) {}
+
+  void operator()(const std::vector<std::string>& row) {
+    CURRENT_ASSERT(!done_);  // TODO(batman): Exception.
+    if (columns_.empty()) {
+      columns_.resize(row.size());
+    }
+    CURRENT_ASSERT(row.size() == columns_.size());
+    for (size_t i = 0u; i < row.size(); ++i) {
+      columns_[i].push_back(row[i]);
+    }
+    if (++block_rows_ == rows_per_block_) {
+      FlushBlock();
+    }
+  }
+
+  // The names must not contain tabs, and there must be as many of them as there are columns.
+  void SetColumnNames(const std::vector<std::string>& names) {
+    CURRENT_ASSERT(!done_);  // TODO(batman): Exception.
+    CURRENT_ASSERT(columns_.empty() || names.size() == columns_.size());
+    names_ = names;
+    if (columns_.empty()) {
+      columns_.resize(names_.size());
+    }
+  }
+
+  void Finalize() {
+    CURRENT_ASSERT(!done_);  // TODO(batman): Exception.
+    FlushBlock();
+    compact_tsv_columnar::Footer footer;
+    footer.names_offset = offset_;
+    for (size_t i = 0u; i < names_.size(); ++i) {
+      if (i) {
+        Write("\t", 1u);
+      }
+      Write(names_[i].data(), names_[i].length());
+    }
+    footer.names_length = offset_ - footer.names_offset;
+    footer.index_offset = offset_;
+    footer.block_count = index_.size();
+    Write(index_.data(), index_.size() * sizeof(compact_tsv_columnar::IndexEntry));
+    footer.row_count = rows_;
+    footer.dim = columns_.size();
+    std::memcpy(footer.magic, compact_tsv_columnar::kMagic, sizeof(footer.magic));
+    Write(&footer, sizeof(footer));
+    done_ = true;
+  }
+
+ private:
+  void Write(const void* data, size_t length) {
+    if (length) {
+      sink_(reinterpret_cast<const char*>(data), length);
+      offset_ += length;
+    }
+  }
+
+  void FlushBlock() {
+    if (block_rows_) {
+      block_.assign((columns_.size() + 1u) * sizeof(uint64_t), '\0');
+      for (size_t i = 0u; i < columns_.size(); ++i) {
+        const uint64_t column_offset = block_.length();
+        std::memcpy(&block_[i * sizeof(uint64_t)], &column_offset, sizeof(column_offset));
+        compact_tsv_columnar::EncodeColumn(columns_[i], block_);
+        columns_[i].clear();
+      }
+      const uint64_t block_length = block_.length();
+      std::memcpy(&block_[columns_.size() * sizeof(uint64_t)], &block_length, sizeof(block_length));
+      index_.push_back(compact_tsv_columnar::IndexEntry{offset_, block_length, rows_, block_rows_});
+      Write(block_.data(), block_.length());
+      rows_ += block_rows_;
+      block_rows_ = 0u;
+    }
+  }
+
+  const sink_t sink_;
+  const size_t rows_per_block_;
+  bool done_ = false;
+  uint64_t offset_ = 0u;
+  uint64_t rows_ = 0u;
+  std::vector<std::vector<std::string>> columns_;
+  std::vector<std::string> names_;
+  size_t block_rows_ = 0u;
+  std::string block_;
+  std::vector<compact_tsv_columnar::IndexEntry> index_;
+};
+
+class CompactTSVColumnar {
+ public:
+  CompactTSVColumnar(const uint8_t* data, size_t length) : data_(data) {
+    using compact_tsv_columnar::Footer;
+    using compact_tsv_columnar::IndexEntry;
+    using compact_tsv_columnar::kMagic;
+    if (length < sizeof(kMagic) + sizeof(Footer) || std::memcmp(data, kMagic, sizeof(kMagic))) {
+      CURRENT_THROW(CompactTSVColumnarFormatException("Not a CompactTSV columnar container."));
+    }
+    std::memcpy(&footer_, data + length - sizeof(Footer), sizeof(Footer));
+    const uint64_t index_end = length - sizeof(Footer);
+    if (std::memcmp(footer_.magic, kMagic, sizeof(kMagic)) || footer_.index_offset < sizeof(kMagic) ||
+        footer_.index_offset > index_end ||
+        footer_.block_count != (index_end - footer_.index_offset) / sizeof(IndexEntry) ||
+        footer_.index_offset + footer_.block_count * sizeof(IndexEntry) != index_end ||
+        footer_.dim > static_cast<uint64_t>(-1) / sizeof(uint64_t) - 1u ||
+        footer_.names_offset < sizeof(kMagic) || footer_.names_offset > footer_.index_offset ||
+        footer_.names_length > footer_.index_offset - footer_.names_offset) {
+      CURRENT_THROW(CompactTSVColumnarFormatException("Malformed CompactTSV columnar container footer."));
+    }
+    index_.resize(footer_.block_count);
+    if (!index_.empty()) {
+      std::memcpy(index_.data(), data + footer_.index_offset, index_.size() * sizeof(IndexEntry));
+    }
+    uint64_t rows = 0u;
+    for (const IndexEntry& e : index_) {
+      if (e.offset < sizeof(kMagic) || e.offset > footer_.names_offset || e.length > footer_.names_offset - e.offset ||
+          e.length < (footer_.dim + 1u) * sizeof(uint64_t) || e.first_row != rows || !e.rows) {
+        CURRENT_THROW(CompactTSVColumnarFormatException("Malformed CompactTSV columnar container index."));
+      }
+      rows += e.rows;
+    }
+    if (rows != footer_.row_count) {
+      CURRENT_THROW(CompactTSVColumnarFormatException("Malformed CompactTSV columnar container index."));
+    }
+    if (footer_.names_length) {
+      const char* names = reinterpret_cast<const char*>(data + footer_.names_offset);
+      const char* const names_end = names + footer_.names_length;
+      while (true) {
+        const char* tab = std::find(names, names_end, '\t');
+        names_.emplace_back(names, tab);
+        if (tab == names_end) {
+          break;
+        }
+        names = tab + 1;
+      }
+      if (names_.size() != footer_.dim) {
+        CURRENT_THROW(CompactTSVColumnarFormatException("Malformed CompactTSV columnar container column names."));
+      }
+    }
+  }
+
+  explicit CompactTSVColumnar(const std::string& packed)
+      : CompactTSVColumnar(reinterpret_cast<const uint8_t*>(packed.data()), packed.length()) {}
+
+  virtual ~CompactTSVColumnar() = default;
+
+  size_t Rows() const { return static_cast<size_t>(footer_.row_count); }
+  size_t Dim() const { return static_cast<size_t>(footer_.dim); }
+  size_t Blocks() const { return index_.size(); }
+
+  // Empty if the names of the columns were not set by the writer.
+  const std::vector<std::string>& ColumnNames() const { return names_; }
+
+  CompactTSVColumnEncoding Encoding(size_t block, size_t column) const {
+    return static_cast<CompactTSVColumnEncoding>(*Column(block, column).first);
+  }
+
+  // Calls `f` on the `columns` of each row of the block, in order.
+  template <typename F>
+  size_t UnpackBlock(size_t block, const std::vector<size_t>& columns, F&& f) const {
+    const size_t rows = static_cast<size_t>(index_[block].rows);
+    std::vector<std::vector<std::string_view>> cells(columns.size());
+    std::vector<std::string> arenas(columns.size());
+    for (size_t i = 0u; i < columns.size(); ++i) {
+      const auto column = Column(block, columns[i]);
+      compact_tsv_columnar::DecodeColumn(column.first, column.second, rows, cells[i], arenas[i]);
+    }
+    std::vector<std::string_view> row(columns.size());
+    for (size_t r = 0u; r < rows; ++r) {
+      for (size_t i = 0u; i < columns.size(); ++i) {
+        row[i] = cells[i][r];
+      }
+      f(row);
+    }
+    return rows;
+  }
+
+  template <typename F>
+  size_t Unpack(const std::vector<size_t>& columns, F&& f) const {
+    size_t total = 0u;
+    for (size_t block = 0u; block < index_.size(); ++block) {
+      total += UnpackBlock(block, columns, f);
+    }
+    return total;
+  }
+
+  template <typename F>
+  size_t Unpack(F&& f) const {
+    return Unpack(AllColumns(), std::forward<F>(f));
+  }
+
+  // Calls `f` concurrently, and in no particular order across the blocks.
+  template <typename F>
+  size_t ParallelUnpack(current::WorkStealingExecutor& executor, const std::vector<size_t>& columns, F&& f) const {
+    executor.ParallelFor(0u, index_.size(), [this, &columns, &f](size_t block) { UnpackBlock(block, columns, f); });
+    return Rows();
+  }
+
+ private:
+  std::vector<size_t> AllColumns() const {
+    std::vector<size_t> columns(Dim());
+    for (size_t i = 0u; i < columns.size(); ++i) {
+      columns[i] = i;
+    }
+    return columns;
+  }
+
+  std::pair<const uint8_t*, const uint8_t*> Column(size_t block, size_t column) const {
+    if (column >= Dim()) {
+      CURRENT_THROW(CompactTSVColumnarColumnOutOfRangeException("Column out of range."));
+    }
+    const compact_tsv_columnar::IndexEntry& e = index_[block];
+    const uint8_t* begin = data_ + e.offset;
+    uint64_t from, to;
+    std::memcpy(&from, begin + column * sizeof(uint64_t), sizeof(uint64_t));
+    std::memcpy(&to, begin + (column + 1u) * sizeof(uint64_t), sizeof(uint64_t));
+    if (from < (Dim() + 1u) * sizeof(uint64_t) || from >= to || to > e.length) {
+      CURRENT_THROW(CompactTSVColumnarFormatException("Malformed CompactTSV columnar block."));
+    }
+    return std::make_pair(begin + from, begin + to);
+  }
+
+  const uint8_t* const data_;
+  compact_tsv_columnar::Footer footer_;
+  std::vector<compact_tsv_columnar::IndexEntry> index_;
+  std::vector<std::string> names_;
+};
+
+class CompactTSVColumnarFile final : private compact_tsv_columnar::MappedFile, public CompactTSVColumnar {
+ public:
+  explicit CompactTSVColumnarFile(const std::string& file_name)
+      : compact_tsv_columnar::MappedFile(file_name),
+        CompactTSVColumnar(reinterpret_cast<const uint8_t*>(mapping.data()), mapping.file_size()) {}
+};
+
+#endif  // COMPACTTSV_COLUMNAR_H
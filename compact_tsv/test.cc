@@ -26,11 +26,19 @@ SOFTWARE.
 // TODO(batman): Test '\0'-s within input strings.
 
 #include "compact_tsv.h"
+#include "blocks.h"
+#include "columnar.h"
 #include "gen.h"
 
+#include <atomic>
+#include <mutex>
+#include <set>
+
 #include "../bricks/time/chrono.h"
 #include "../bricks/strings/util.h"
 #include "../bricks/dflags/dflags.h"
+#include "../bricks/file/file.h"
+#include "../bricks/strings/join.h"
 #include "../3rdparty/gtest/gtest-main-with-dflags.h"
 
 DEFINE_size_t(rows, 10u, "Number of rows.");
@@ -121,6 +129,17 @@ TEST(CompactTSV, Smoke) {
             CompactTSV::Unpack([](const std::vector<current::strings::UniqueChunk> &) {}, fast.GetPackedString()));
   const auto t_f_end = current::time::Now();
 
+  std::ostringstream os3;
+  EXPECT_EQ(FLAGS_rows,
+            CompactTSV::Unpack(
+                [&os3](const std::vector<std::string_view> &row) {
+                  for (size_t i = 0; i < row.size(); ++i) {
+                    os3 << std::setw(2) << row[i] << ((i + 1) == row.size() ? '\n' : ' ');
+                  }
+                },
+                fast.GetPackedString()));
+  EXPECT_EQ(golden, os3.str());
+
   if (FLAGS_benchmark) {
     // LCOV_EXCL_START
     const size_t golden_size = golden.length();
@@ -137,3 +156,221 @@ TEST(CompactTSV, Smoke) {
     // LCOV_EXCL_STOP
   }
 }
+
+TEST(CompactTSV, Blocks) {
+  std::vector<std::vector<std::string>> rows;
+  CreateTSV(
+      [&rows](const std::vector<size_t> &row) {
+        std::vector<std::string> row_of_strings(row.size());
+        for (size_t i = 0; i < row.size(); ++i) {
+          row_of_strings[i] = current::ToString(row[i]);
+        }
+        rows.push_back(row_of_strings);
+      },
+      1000u,
+      5u);
+
+  for (const auto dictionary : {CompactTSVDictionary::PerBlock, CompactTSVDictionary::Shared}) {
+    std::ostringstream os;
+    CompactTSVBlockWriter writer(os, 64u, dictionary);
+    for (const auto &row : rows) {
+      writer(row);
+    }
+    writer.Finalize();
+    const std::string packed = os.str();
+
+    const CompactTSVBlocks blocks(packed);
+    EXPECT_EQ(1000u, blocks.Rows());
+    EXPECT_EQ(5u, blocks.Dim());
+    EXPECT_EQ(16u, blocks.Blocks());
+
+    std::vector<std::vector<std::string>> unpacked;
+    EXPECT_EQ(1000u, blocks.Unpack([&unpacked](const std::vector<std::string> &row) { unpacked.push_back(row); }));
+    EXPECT_TRUE(unpacked == rows);
+
+    for (size_t i : {0u, 1u, 63u, 64u, 65u, 500u, 999u}) {
+      std::string row;
+      blocks.UnpackRow(i, [&row](const std::vector<std::string_view> &v) {
+        for (const auto &e : v) {
+          row.append(e.data(), e.length()).append(" ");
+        }
+      });
+      EXPECT_EQ(current::strings::Join(rows[i], ' ') + ' ', row) << i;
+    }
+    std::vector<std::vector<std::string>> range;
+    EXPECT_EQ(100u,
+              blocks.UnpackRows(
+                  60u, 160u, [&range](const std::vector<std::string> &row) { range.push_back(row); }));
+    EXPECT_TRUE(std::vector<std::vector<std::string>>(rows.begin() + 60, rows.begin() + 160) == range);
+    EXPECT_EQ(0u, blocks.UnpackRows(1000u, 1000u, [](const std::vector<std::string> &) {}));
+    ASSERT_THROW(blocks.UnpackRow(1000u, [](const std::vector<std::string> &) {}),
+                 CompactTSVBlocksRowOutOfRangeException);
+
+    current::WorkStealingExecutor executor(4u);
+    std::mutex mutex;
+    std::multiset<std::string> all;
+    EXPECT_EQ(1000u, blocks.ParallelUnpack(executor, [&](const std::vector<std::pair<const char *, size_t>> &row) {
+      std::string s;
+      for (const auto &e : row) {
+        s.append(e.first, e.second).append(" ");
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      all.insert(s);
+    }));
+    std::multiset<std::string> expected;
+    for (const auto &row : rows) {
+      expected.insert(current::strings::Join(row, ' ') + ' ');
+    }
+    EXPECT_TRUE(expected == all);
+
+    const std::string file_name = current::FileSystem::JoinPath(".current", "blocks.ctsv");
+    const auto file_remover = current::FileSystem::ScopedRmFile(file_name);
+    current::FileSystem::WriteStringToFile(packed, file_name.c_str());
+    const CompactTSVBlocksFile file(file_name);
+    size_t count = 0u;
+    EXPECT_EQ(1000u, file.Unpack([&count](const std::vector<current::strings::UniqueChunk> &) { ++count; }));
+    EXPECT_EQ(1000u, count);
+  }
+
+  ASSERT_THROW(CompactTSVBlocks(std::string("CTSVBLK1")), CompactTSVBlocksFormatException);
+  std::ostringstream os;
+  CompactTSVBlockWriter(os).Finalize();
+  EXPECT_EQ(0u, CompactTSVBlocks(os.str()).Rows());
+  std::string corrupted = os.str();
+  corrupted[corrupted.length() - 1] = 'X';
+  ASSERT_THROW(CompactTSVBlocks{corrupted}, CompactTSVBlocksFormatException);
+}
+
+TEST(CompactTSV, BlocksStreaming) {
+  std::vector<std::vector<std::string>> rows;
+  CreateTSV(
+      [&rows](const std::vector<size_t> &row) {
+        std::vector<std::string> row_of_strings(row.size());
+        for (size_t i = 0; i < row.size(); ++i) {
+          row_of_strings[i] = current::ToString(row[i]);
+        }
+        rows.push_back(row_of_strings);
+      },
+      1000u,
+      5u);
+
+  for (const auto dictionary : {CompactTSVDictionary::PerBlock, CompactTSVDictionary::Shared}) {
+    std::string packed;
+    size_t writes = 0u;
+    CompactTSVBlockWriterOptions options;
+    options.rows_per_block = 64u;
+    options.max_block_bytes = 256u;
+    options.dictionary = dictionary;
+    options.max_dictionary_bytes = 16u;
+    CompactTSVBlockWriter writer([&](const char *data, size_t size) {
+      packed.append(data, size);
+      ++writes;
+    }, options);
+    for (size_t i = 0; i < rows.size(); ++i) {
+      writer(rows[i]);
+      if (i == 499u) {
+        // The blocks are written out as they are complete, not kept until `Finalize()`.
+        EXPECT_LT(8u, writes);
+        EXPECT_LT(1000u, packed.length());
+      }
+    }
+    writer.Finalize();
+
+    const CompactTSVBlocks blocks(packed);
+    EXPECT_EQ(1000u, blocks.Rows());
+    EXPECT_LT(16u, blocks.Blocks());
+    if (dictionary == CompactTSVDictionary::Shared) {
+      EXPECT_LT(1u, blocks.Dictionaries());
+    } else {
+      EXPECT_EQ(0u, blocks.Dictionaries());
+    }
+
+    std::vector<std::vector<std::string>> unpacked;
+    EXPECT_EQ(1000u, blocks.Unpack([&unpacked](const std::vector<std::string> &row) { unpacked.push_back(row); }));
+    EXPECT_TRUE(unpacked == rows);
+    std::vector<std::string> row;
+    blocks.UnpackRow(777u, [&row](const std::vector<std::string> &r) { row = r; });
+    EXPECT_TRUE(rows[777u] == row);
+  }
+}
+
+TEST(CompactTSV, Columnar) {
+  std::vector<std::vector<std::string>> rows;
+  for (size_t i = 0u; i < 1000u; ++i) {
+    const int64_t big = 900000000000000000ll - static_cast<int64_t>(i * i * 1000003u);
+    rows.push_back({current::ToString(i * 3u),                        // Increasing integers.
+                    current::ToString(big) + (i == 777u ? "x" : ""),  // Integers, but not in the block with "x".
+                    (i / 100u % 2u) ? "odd hundred" : "",             // Long runs.
+                    current::ToString(i % 7u * 11u),                  // Few distinct values.
+                    "0" + current::ToString(i % 10u),                 // Not canonical integers.
+                    i == 500u ? "-0" : current::ToString(-static_cast<int64_t>(i % 13u))});
+  }
+
+  std::ostringstream os;
+  CompactTSVColumnarWriter writer(os, 256u);
+  for (const auto &row : rows) {
+    writer(row);
+  }
+  writer.SetColumnNames({"a", "b", "c", "d", "e", ""});
+  writer.Finalize();
+  const std::string packed = os.str();
+
+  const CompactTSVColumnar columnar(packed);
+  EXPECT_EQ(1000u, columnar.Rows());
+  EXPECT_EQ(6u, columnar.Dim());
+  EXPECT_EQ(4u, columnar.Blocks());
+  EXPECT_EQ("a,b,c,d,e,", current::strings::Join(columnar.ColumnNames(), ','));
+  EXPECT_EQ(CompactTSVColumnEncoding::DeltaInteger, columnar.Encoding(0u, 0u));
+  EXPECT_EQ(CompactTSVColumnEncoding::DeltaInteger, columnar.Encoding(0u, 1u));
+  EXPECT_EQ(CompactTSVColumnEncoding::Dictionary, columnar.Encoding(3u, 1u));
+  EXPECT_EQ(CompactTSVColumnEncoding::DictionaryRLE, columnar.Encoding(0u, 2u));
+  EXPECT_EQ(CompactTSVColumnEncoding::Dictionary, columnar.Encoding(0u, 4u));
+  EXPECT_EQ(CompactTSVColumnEncoding::Dictionary, columnar.Encoding(1u, 5u));
+
+  std::vector<std::vector<std::string>> unpacked;
+  EXPECT_EQ(1000u, columnar.Unpack([&unpacked](const std::vector<std::string_view> &row) {
+    unpacked.emplace_back(row.begin(), row.end());
+  }));
+  EXPECT_TRUE(unpacked == rows);
+
+  std::vector<std::string> some;
+  EXPECT_EQ(1000u, columnar.Unpack({4u, 1u}, [&some](const std::vector<std::string_view> &row) {
+    ASSERT_EQ(2u, row.size());
+    some.push_back(std::string(row[0]) + ' ' + std::string(row[1]));
+  }));
+  for (size_t i = 0u; i < 1000u; ++i) {
+    EXPECT_EQ(rows[i][4] + ' ' + rows[i][1], some[i]) << i;
+  }
+  ASSERT_THROW(columnar.Unpack({6u}, [](const std::vector<std::string_view> &) {}),
+               CompactTSVColumnarColumnOutOfRangeException);
+
+  current::WorkStealingExecutor executor(4u);
+  std::atomic_size_t sum(0u);
+  EXPECT_EQ(1000u, columnar.ParallelUnpack(executor, {0u}, [&sum](const std::vector<std::string_view> &row) {
+    sum += current::FromString<size_t>(std::string(row[0]));
+  }));
+  EXPECT_EQ(3u * 999u * 1000u / 2u, sum);
+
+  const std::string file_name = current::FileSystem::JoinPath(".current", "columnar.ctsv");
+  const auto file_remover = current::FileSystem::ScopedRmFile(file_name);
+  current::FileSystem::WriteStringToFile(packed, file_name.c_str());
+  const CompactTSVColumnarFile file(file_name);
+  size_t count = 0u;
+  EXPECT_EQ(1000u, file.Unpack({2u}, [&count](const std::vector<std::string_view> &) { ++count; }));
+  EXPECT_EQ(1000u, count);
+
+  ASSERT_THROW(CompactTSVColumnar(std::string("CTSVCOL1")), CompactTSVColumnarFormatException);
+  std::string corrupted = packed;
+  corrupted[corrupted.length() - 1] = 'X';
+  ASSERT_THROW(CompactTSVColumnar{corrupted}, CompactTSVColumnarFormatException);
+  std::ostringstream empty;
+  CompactTSVColumnarWriter(empty).Finalize();
+  EXPECT_EQ(0u, CompactTSVColumnar(empty.str()).Rows());
+  EXPECT_EQ(0u, CompactTSVColumnar(empty.str()).ColumnNames().size());
+  std::ostringstream named;
+  CompactTSVColumnarWriter named_writer(named);
+  named_writer.SetColumnNames({"x", "y"});
+  named_writer.Finalize();
+  EXPECT_EQ(2u, CompactTSVColumnar(named.str()).Dim());
+  EXPECT_EQ("x,y", current::strings::Join(CompactTSVColumnar(named.str()).ColumnNames(), ','));
+}
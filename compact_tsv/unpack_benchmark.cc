@@ -0,0 +1,141 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// Measures how fast `CompactTSV::Unpack` is, for each kind of the rows it can produce, on generated data.
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "compact_tsv.h"
+#include "blocks.h"
+#include "columnar.h"
+#include "gen.h"
+
+#include "../bricks/dflags/dflags.h"
+#include "../bricks/strings/util.h"
+
+DEFINE_size_t(rows, 1000000u, "Number of rows.");
+DEFINE_size_t(cols, 20u, "Number of cols.");
+DEFINE_double(scale, 5.0, "Exponential distribution parameter.");
+DEFINE_size_t(random_seed, 42, "Random seed.");
+DEFINE_size_t(runs, 5u, "Run each unpacking this many times, and report the fastest one.");
+DEFINE_size_t(rows_per_block, CompactTSVBlockWriter::kDefaultRowsPerBlock, "Rows per block of the blocks container.");
+DEFINE_size_t(threads, 0u, "Threads to unpack the blocks container with, zero for the number of cores.");
+
+template <typename U>
+void MeasureUnpack(const char* name, U&& unpack) {
+  double best_ms = 0.0;
+  for (size_t run = 0u; run < FLAGS_runs; ++run) {
+    const auto begin = std::chrono::steady_clock::now();
+    const size_t rows = unpack();
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    CURRENT_ASSERT(rows == FLAGS_rows);
+    if (!run || ms < best_ms) {
+      best_ms = ms;
+    }
+  }
+  std::cout << name << '\t' << best_ms << "ms\t" << static_cast<size_t>(1e-3 * FLAGS_rows / best_ms) << "M rows/s\n";
+}
+
+template <typename F>
+void Measure(const char* name, const std::string& packed, F&& f) {
+  MeasureUnpack(name, [&packed, &f]() { return CompactTSV::Unpack(f, packed); });
+}
+
+int main(int argc, char** argv) {
+  ParseDFlags(&argc, &argv);
+
+  CompactTSV packer;
+  CreateTSV(
+      [&packer](const std::vector<size_t>& row) {
+        std::vector<std::string> row_of_strings(row.size());
+        for (size_t i = 0; i < row.size(); ++i) {
+          row_of_strings[i] = current::ToString(row[i]);
+        }
+        packer(row_of_strings);
+      },
+      FLAGS_rows,
+      FLAGS_cols,
+      FLAGS_scale,
+      FLAGS_random_seed);
+  packer.Finalize();
+  const std::string& packed = packer.GetPackedString();
+  std::cout << "Packed " << FLAGS_rows << " rows of " << FLAGS_cols << " cols into " << packed.length() << " bytes.\n";
+
+  size_t checksum = 0u;
+  Measure("std::string", packed, [&checksum](const std::vector<std::string>& row) { checksum += row[0].length(); });
+  Measure("const char*", packed, [&checksum](const std::vector<const char*>& row) { checksum += *row[0]; });
+  Measure("std::pair<const char*, size_t>",
+          packed,
+          [&checksum](const std::vector<std::pair<const char*, size_t>>& row) { checksum += row[0].second; });
+  Measure("UniqueChunk", packed, [&checksum](const std::vector<current::strings::UniqueChunk>& row) {
+    checksum += row[0].length();
+  });
+  Measure("std::string_view", packed, [&checksum](const std::vector<std::string_view>& row) {
+    checksum += row[0].length();
+  });
+
+  std::ostringstream os;
+  CompactTSVBlockWriter writer(os, FLAGS_rows_per_block);
+  CompactTSV::Unpack([&writer](const std::vector<std::string>& row) { writer(row); }, packed);
+  writer.Finalize();
+  const std::string blocks_packed = os.str();
+  const CompactTSVBlocks blocks(blocks_packed);
+  std::cout << "Blocks: " << blocks.Blocks() << ", " << blocks_packed.length() << " bytes.\n";
+  MeasureUnpack("blocks, std::pair<const char*, size_t>", [&]() {
+    return blocks.Unpack([&checksum](const std::vector<std::pair<const char*, size_t>>& row) {
+      checksum += row[0].second;
+    });
+  });
+  current::WorkStealingExecutor executor(FLAGS_threads ? FLAGS_threads
+                                                       : current::WorkStealingExecutor::DefaultWorkersCount());
+  std::atomic<size_t> parallel_checksum(0u);
+  const auto parallel_f = [&parallel_checksum](const std::vector<std::pair<const char*, size_t>>& row) {
+    parallel_checksum.fetch_add(row[0].second, std::memory_order_relaxed);
+  };
+  MeasureUnpack("blocks, in parallel, std::pair<const char*, size_t>",
+                [&]() { return blocks.ParallelUnpack(executor, parallel_f); });
+
+  std::ostringstream columnar_os;
+  CompactTSVColumnarWriter columnar_writer(columnar_os, FLAGS_rows_per_block);
+  CompactTSV::Unpack([&columnar_writer](const std::vector<std::string>& row) { columnar_writer(row); }, packed);
+  columnar_writer.Finalize();
+  const std::string columnar_packed = columnar_os.str();
+  const CompactTSVColumnar columnar(columnar_packed);
+  std::cout << "Columnar: " << columnar.Blocks() << " blocks, " << columnar_packed.length() << " bytes.\n";
+  MeasureUnpack("columnar, all columns, std::string_view", [&]() {
+    return columnar.Unpack([&checksum](const std::vector<std::string_view>& row) { checksum += row[0].length(); });
+  });
+  const std::vector<size_t> three_columns = {0u, FLAGS_cols / 2u, FLAGS_cols - 1u};
+  MeasureUnpack("columnar, three columns, std::string_view", [&]() {
+    return columnar.Unpack(three_columns,
+                           [&checksum](const std::vector<std::string_view>& row) { checksum += row[0].length(); });
+  });
+  std::cerr << "Checksum: " << checksum + parallel_checksum << std::endl;
+}
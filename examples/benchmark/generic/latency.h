@@ -0,0 +1,126 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// The latencies of the benchmarked queries, in nanoseconds, kept as a log-linear histogram: exact under 32ns,
+// and within 1/32 of the value above, for the percentiles to be precise at any rate and any length of the run.
+// One per thread, merged once the run is over.
+
+#ifndef EXAMPLES_BENCHMARK_GENERIC_LATENCY_H
+#define EXAMPLES_BENCHMARK_GENERIC_LATENCY_H
+
+#include "../../../port.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "../../../typesystem/struct.h"
+
+CURRENT_STRUCT(BenchmarkLatency) {
+  CURRENT_FIELD(mean_us, double, 0.0);
+  CURRENT_FIELD(p50_us, double, 0.0);
+  CURRENT_FIELD(p90_us, double, 0.0);
+  CURRENT_FIELD(p99_us, double, 0.0);
+  CURRENT_FIELD(p999_us, double, 0.0);
+  CURRENT_FIELD(max_us, double, 0.0);
+};
+
+class LatencyHistogram final {
+ public:
+  constexpr static size_t kSubBucketBits = 5u;
+  constexpr static size_t kSubBuckets = size_t(1) << kSubBucketBits;
+
+  LatencyHistogram() : counts_((64u - kSubBucketBits + 1u) * kSubBuckets) {}
+
+  void Record(uint64_t ns) {
+    ++counts_[BucketIndex(ns)];
+    ++count_;
+    total_ns_ += ns;
+    max_ns_ = std::max(max_ns_, ns);
+  }
+
+  void Merge(const LatencyHistogram& rhs) {
+    for (size_t i = 0u; i < counts_.size(); ++i) {
+      counts_[i] += rhs.counts_[i];
+    }
+    count_ += rhs.count_;
+    total_ns_ += rhs.total_ns_;
+    max_ns_ = std::max(max_ns_, rhs.max_ns_);
+  }
+
+  uint64_t Count() const { return count_; }
+
+  // The upper bound of the bucket the `q`-th quantile is in, so that the latencies are never underreported.
+  uint64_t QuantileNanoseconds(double q) const {
+    const uint64_t rank = std::max(uint64_t(1), static_cast<uint64_t>(std::ceil(q * count_)));
+    uint64_t seen = 0u;
+    for (size_t i = 0u; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        return std::min(BucketUpperBound(i), max_ns_);
+      }
+    }
+    return max_ns_;
+  }
+
+  BenchmarkLatency Summary() const {
+    BenchmarkLatency result;
+    if (count_) {
+      result.mean_us = 1e-3 * total_ns_ / count_;
+      result.p50_us = 1e-3 * QuantileNanoseconds(0.5);
+      result.p90_us = 1e-3 * QuantileNanoseconds(0.9);
+      result.p99_us = 1e-3 * QuantileNanoseconds(0.99);
+      result.p999_us = 1e-3 * QuantileNanoseconds(0.999);
+      result.max_us = 1e-3 * max_ns_;
+    }
+    return result;
+  }
+
+ private:
+  static size_t BucketIndex(uint64_t ns) {
+    if (ns < kSubBuckets) {
+      return static_cast<size_t>(ns);
+    }
+    size_t shift = 0u;
+    while ((ns >> shift) >= 2u * kSubBuckets) {
+      ++shift;
+    }
+    return (shift + 1u) * kSubBuckets + static_cast<size_t>((ns >> shift) - kSubBuckets);
+  }
+
+  static uint64_t BucketUpperBound(size_t index) {
+    if (index < kSubBuckets) {
+      return index;
+    }
+    const size_t shift = index / kSubBuckets - 1u;
+    return ((kSubBuckets + index % kSubBuckets + 1u) << shift) - 1u;
+  }
+
+  std::vector<uint64_t> counts_;
+  uint64_t count_ = 0u;
+  uint64_t total_ns_ = 0u;
+  uint64_t max_ns_ = 0u;
+};
+
+#endif  // EXAMPLES_BENCHMARK_GENERIC_LATENCY_H
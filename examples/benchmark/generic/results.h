@@ -0,0 +1,149 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// The results of a benchmark run, with what it takes to tell whether two runs are comparable: the scenario
+// and the flags it has been run with, the revision of the code, and the host. Saved with `--output_json`,
+// and compared against with `--baseline`, which reports the metrics that got worse by more than `--tolerance`.
+
+#ifndef EXAMPLES_BENCHMARK_GENERIC_RESULTS_H
+#define EXAMPLES_BENCHMARK_GENERIC_RESULTS_H
+
+#include "../../../port.h"
+
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef CURRENT_WINDOWS
+#include <unistd.h>
+#endif  // CURRENT_WINDOWS
+
+#include "latency.h"
+
+#include "../../../bricks/system/syscalls.h"
+#include "../../../typesystem/struct.h"
+
+CURRENT_STRUCT(BenchmarkHost) {
+  CURRENT_FIELD(hostname, std::string);
+  CURRENT_FIELD(os, std::string);
+  CURRENT_FIELD(cpus, uint32_t, 0u);
+};
+
+CURRENT_STRUCT(BenchmarkResult) {
+  CURRENT_FIELD(scenario, std::string);
+  CURRENT_FIELD(parameters, (std::map<std::string, std::string>));
+  CURRENT_FIELD_DESCRIPTION(parameters, "The flags passed on the command line, other than the output ones.");
+  CURRENT_FIELD(revision, std::string);
+  CURRENT_FIELD_DESCRIPTION(revision, "The git revision the benchmark has been run from, if known.");
+  CURRENT_FIELD(host, BenchmarkHost);
+  CURRENT_FIELD(mode, std::string);
+  CURRENT_FIELD_DESCRIPTION(mode, "\"closed\" or \"open\", see `--qps`.");
+  CURRENT_FIELD(threads, uint32_t, 0u);
+  CURRENT_FIELD(seconds, double, 0.0);
+  CURRENT_FIELD(target_qps, double, 0.0);
+  CURRENT_FIELD(qps, double, 0.0);
+  CURRENT_FIELD_DESCRIPTION(qps, "The queries completed per second.");
+  CURRENT_FIELD(queries, uint64_t, 0u);
+  CURRENT_FIELD(latency, BenchmarkLatency);
+  CURRENT_FIELD_DESCRIPTION(latency, "In open-loop mode, the time spent waiting for the thread to be free included.");
+};
+
+CURRENT_STRUCT(BenchmarkMetricComparison) {
+  CURRENT_FIELD(metric, std::string);
+  CURRENT_FIELD(baseline, double, 0.0);
+  CURRENT_FIELD(current, double, 0.0);
+  CURRENT_FIELD(change, double, 0.0);
+  CURRENT_FIELD_DESCRIPTION(change, "How much worse, relative to the baseline: positive is a regression.");
+  CURRENT_FIELD(regression, bool, false);
+};
+
+CURRENT_STRUCT(BenchmarkComparison) {
+  CURRENT_FIELD(comparable, bool, true);
+  CURRENT_FIELD_DESCRIPTION(comparable, "False if the scenario or the parameters differ from the baseline's.");
+  CURRENT_FIELD(tolerance, double, 0.0);
+  CURRENT_FIELD(metrics, std::vector<BenchmarkMetricComparison>);
+  CURRENT_FIELD(regressions, uint32_t, 0u);
+};
+
+inline BenchmarkHost CurrentBenchmarkHost() {
+  BenchmarkHost host;
+  host.cpus = std::thread::hardware_concurrency();
+#ifndef CURRENT_WINDOWS
+  char hostname[256] = {0};
+  if (!::gethostname(hostname, sizeof(hostname) - 1u)) {
+    host.hostname = hostname;
+  }
+  try {
+    host.os = current::bricks::system::SystemCallReadPipe("uname -srm 2>/dev/null").ReadLine();
+  } catch (const current::Exception&) {
+  }
+#else
+  host.os = "Windows";
+#endif  // CURRENT_WINDOWS
+  return host;
+}
+
+// The revision of the working copy the benchmark is run from, empty if it is not under git.
+inline std::string CurrentBenchmarkRevision() {
+#ifndef CURRENT_WINDOWS
+  try {
+    return current::bricks::system::SystemCallReadPipe("git rev-parse HEAD 2>/dev/null").ReadLine();
+  } catch (const current::Exception&) {
+  }
+#endif  // CURRENT_WINDOWS
+  return "";
+}
+
+// Compares the QPS, the higher the better, and the latency percentiles, the lower the better, to the baseline.
+// The metrics that got worse by more than `tolerance`, relative to the baseline, are the regressions.
+inline BenchmarkComparison CompareBenchmarkResults(const BenchmarkResult& baseline,
+                                                   const BenchmarkResult& current,
+                                                   double tolerance) {
+  BenchmarkComparison comparison;
+  comparison.comparable = baseline.scenario == current.scenario && baseline.parameters == current.parameters;
+  comparison.tolerance = tolerance;
+  const auto compare = [&](const std::string& metric, double baseline_value, double current_value, bool higher_better) {
+    comparison.metrics.emplace_back();
+    BenchmarkMetricComparison& result = comparison.metrics.back();
+    result.metric = metric;
+    result.baseline = baseline_value;
+    result.current = current_value;
+    if (baseline_value > 0) {
+      const double worse_by = higher_better ? baseline_value - current_value : current_value - baseline_value;
+      result.change = worse_by / baseline_value;
+    }
+    result.regression = result.change > tolerance;
+    if (result.regression) {
+      ++comparison.regressions;
+    }
+  };
+  compare("qps", baseline.qps, current.qps, true);
+  compare("latency.p50_us", baseline.latency.p50_us, current.latency.p50_us, false);
+  compare("latency.p99_us", baseline.latency.p99_us, current.latency.p99_us, false);
+  compare("latency.p999_us", baseline.latency.p999_us, current.latency.p999_us, false);
+  return comparison;
+}
+
+#endif  // EXAMPLES_BENCHMARK_GENERIC_RESULTS_H
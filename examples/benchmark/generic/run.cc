@@ -28,9 +28,14 @@ SOFTWARE.
 #include "scenario_json.h"
 #include "scenario_simple_http.h"
 #include "scenario_storage.h"
+#include "scenario_stream.h"
 #include "scenario_nginx_client.h"
 #include "scenario_replication.h"
 
+#include "results.h"
+
+#include <random>
+
 using namespace current;
 
 DEFINE_string(scenario, "", "Benchmarking scenario to run. Leave empty for synopsis.");
@@ -43,63 +48,157 @@ DEFINE_int32(threads,
              "the measurement may be imprecise when run against a high-latency network,"
              "as more time would be spent waiting than running. Thus, this tool is only good for local tests.");
 
-static double NowInSeconds() {
-  // Don't use `current::time::Now()`, as it's under a mutex, and guaranteed to increase by at least 1 per call.
-  return 1e-6 *
-         std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch())
-             .count();
+DEFINE_double(qps,
+              0.0,
+              "If nonzero, run open-loop: start the queries at this total rate, as Poisson arrivals split evenly "
+              "across the threads, and measure the latency from when each query was due to start, not from when "
+              "the thread got to it. Zero, the default, runs closed-loop: each thread runs one query after another.");
+
+DEFINE_bool(output_json, false, "Output the QPS and the latency percentiles as JSON, instead of just the QPS.");
+
+DEFINE_string(baseline, "", "If set, the `--output_json` of an earlier run to compare this one against.");
+
+DEFINE_double(tolerance, 0.1, "How much worse than `--baseline` a metric may get, relative, to not be a regression.");
+
+// The flags which only affect the output of the benchmark, not what is being benchmarked.
+static bool IsOutputFlag(const std::string& name) {
+  return name == "output_json" || name == "baseline" || name == "tolerance";
+}
+
+// The flags passed on the command line, as `--name=value`, `--name value`, or `--name` for the boolean ones.
+static std::map<std::string, std::string> CommandLineParameters(int argc, char** argv) {
+  std::map<std::string, std::string> parameters;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.length() > 2u && arg[0] == '-' && arg[1] == '-') {
+      arg = arg.substr(2u);
+      const size_t eq = arg.find('=');
+      std::string name = arg.substr(0u, eq);
+      std::string value;
+      if (eq != std::string::npos) {
+        value = arg.substr(eq + 1u);
+      } else if (i + 1 < argc && argv[i + 1][0] != '-') {
+        value = argv[++i];
+      } else {
+        value = "true";
+      }
+      if (name != "scenario" && !IsOutputFlag(name)) {
+        parameters[name] = value;
+      }
+    }
+  }
+  return parameters;
 }
 
 template <typename SCENARIO>
-void Run(const SCENARIO& scenario) {
+BenchmarkResult Run(const SCENARIO& scenario) {
+  // Don't use `current::time::Now()`, as it's under a mutex, and guaranteed to increase by at least 1 per call.
+  using clock_t = std::chrono::steady_clock;
+
   struct Thread {
-    Thread(const SCENARIO& scenario, double total_seconds)
+    Thread(const SCENARIO& scenario, clock_t::time_point begin, clock_t::time_point end, double qps, uint64_t seed)
         : scenario_(scenario),
-          wall_time_second_end_(NowInSeconds() + total_seconds),
+          begin_(begin),
+          end_(end),
+          qps_(qps),
+          random_(seed),
           queries_completed_within_desired_timeframe_(0u),
           thread_(&Thread::ThreadFunction, this) {}
 
     void Join() { thread_.join(); }
 
     const SCENARIO& scenario_;
-    const double wall_time_second_end_;
+    const clock_t::time_point begin_;
+    const clock_t::time_point end_;
+    const double qps_;
+    std::mt19937_64 random_;
     size_t queries_completed_within_desired_timeframe_;
+    LatencyHistogram latency_;
     std::thread thread_;
 
+    static uint64_t Nanoseconds(clock_t::duration duration) {
+      return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+
     // The thread function runs the queries continuously. It only counts the queries
     // completed within the originally desired number of seconds in the final number.
     void ThreadFunction() {
+      if (qps_ > 0) {
+        OpenLoop();
+        return;
+      }
       while (true) {
+        const clock_t::time_point started = clock_t::now();
         scenario_->RunOneQuery();
+        const clock_t::time_point completed = clock_t::now();
 
-        if (NowInSeconds() >= wall_time_second_end_) {
+        if (completed >= end_) {
           break;
         }
 
         ++queries_completed_within_desired_timeframe_;
+        latency_.Record(Nanoseconds(completed - started));
+      }
+    }
+
+    // Each query is due at its own time, independent of how long the previous ones took. The one due while
+    // the thread is still busy with the previous query starts late, and its latency is counted from when it was
+    // due, for the slow queries not to hide the latency of the ones that had to wait for them.
+    void OpenLoop() {
+      std::exponential_distribution<double> interval_seconds(qps_);
+      clock_t::time_point due = begin_;
+      while (true) {
+        due += std::chrono::duration_cast<clock_t::duration>(std::chrono::duration<double>(interval_seconds(random_)));
+        if (due >= end_) {
+          break;
+        }
+        std::this_thread::sleep_until(due);
+        scenario_->RunOneQuery();
+        const clock_t::time_point completed = clock_t::now();
+
+        if (completed >= end_) {
+          break;
+        }
+
+        ++queries_completed_within_desired_timeframe_;
+        latency_.Record(Nanoseconds(completed - due));
       }
     }
   };
 
+  const clock_t::time_point begin = clock_t::now();
+  const clock_t::time_point end =
+      begin + std::chrono::duration_cast<clock_t::duration>(std::chrono::duration<double>(FLAGS_seconds));
+  std::random_device random_device;
   std::vector<std::unique_ptr<Thread>> threads(FLAGS_threads);
   for (auto& t : threads) {
-    t = std::make_unique<Thread>(scenario, FLAGS_seconds);
+    t = std::make_unique<Thread>(scenario, begin, end, FLAGS_qps / FLAGS_threads, random_device());
   }
 
   for (auto& t : threads) {
     t->Join();
   }
 
-  size_t total_queries = 0u;
+  BenchmarkResult result;
+  result.scenario = FLAGS_scenario;
+  result.revision = CurrentBenchmarkRevision();
+  result.host = CurrentBenchmarkHost();
+  result.mode = FLAGS_qps > 0 ? "open" : "closed";
+  result.threads = static_cast<uint32_t>(FLAGS_threads);
+  result.seconds = FLAGS_seconds;
+  result.target_qps = FLAGS_qps;
+  LatencyHistogram latency;
   for (auto& t : threads) {
-    total_queries += t->queries_completed_within_desired_timeframe_;
+    result.queries += t->queries_completed_within_desired_timeframe_;
+    latency.Merge(t->latency_);
   }
-
-  const double qps = total_queries / FLAGS_seconds;
-  std::cout << std::setw(3) << qps << " QPS." << std::endl;
+  result.qps = result.queries / FLAGS_seconds;
+  result.latency = latency.Summary();
+  return result;
 }
 
 int main(int argc, char** argv) {
+  const std::map<std::string, std::string> parameters = CommandLineParameters(argc, argv);
   ParseDFlags(&argc, &argv);
 
   const auto& registerer = Singleton<ScenariosRegisterer>();
@@ -108,7 +207,34 @@ int main(int argc, char** argv) {
     return 1;
   } else {
     try {
-      Run(registerer.map.at(FLAGS_scenario).second());
+      // Read the baseline first, not to find out it is not there after the run.
+      Optional<BenchmarkResult> baseline;
+      if (!FLAGS_baseline.empty()) {
+        baseline = ParseJSON<BenchmarkResult>(current::FileSystem::ReadFileAsString(FLAGS_baseline));
+      }
+      BenchmarkResult result = Run(registerer.map.at(FLAGS_scenario).second());
+      result.parameters = parameters;
+      if (FLAGS_output_json) {
+        std::cout << JSON(result) << std::endl;
+      } else {
+        std::cout << std::setw(3) << result.qps << " QPS." << std::endl;
+      }
+      if (Exists(baseline)) {
+        // To stderr with `--output_json`, for the output to be the result only, to save as the next baseline.
+        std::ostream& os = FLAGS_output_json ? std::cerr : std::cout;
+        const BenchmarkComparison comparison = CompareBenchmarkResults(Value(baseline), result, FLAGS_tolerance);
+        if (!comparison.comparable) {
+          os << "WARNING: The scenario or the parameters differ from the baseline's." << std::endl;
+        }
+        for (const BenchmarkMetricComparison& metric : comparison.metrics) {
+          os << (metric.regression ? "REGRESSION " : "OK         ") << metric.metric << ": " << metric.baseline
+             << " -> " << metric.current << ", " << std::fixed << std::setprecision(1)
+             << 100 * std::fabs(metric.change) << (metric.change > 0 ? "% worse." : "% better.") << std::endl;
+          os.unsetf(std::ios_base::floatfield);
+          os << std::setprecision(6);
+        }
+        return comparison.regressions ? 1 : 0;
+      }
       return 0;
     } catch (const std::out_of_range&) {
       std::cout << "Scenario `" << FLAGS_scenario << "` is not defined." << std::endl;
@@ -0,0 +1,39 @@
+#!/bin/bash
+
+# Runs stream and persistence performance tests in bulk.
+
+if [ ! -f .current/run ] ; then
+  echo "Building '.current/run' to run the tests. You may want to check the compilation flags."
+  make .current/run
+fi
+
+CMD="./.current/run --scenario=stream --threads=1 --seconds=2"
+
+for STREAM_PERSISTER in memory file ; do
+  echo -n "publish,$STREAM_PERSISTER : "
+  $CMD --stream_test=publish --stream_persister=$STREAM_PERSISTER
+done
+
+for STREAM_PERSISTER in memory file ; do
+  for STREAM_SUBSCRIBERS in 1 10 100 1000 ; do
+    for STREAM_DISPATCHER_THREADS in 0 4 ; do
+      echo -n "fanout,$STREAM_PERSISTER,subscribers=$STREAM_SUBSCRIBERS,dispatcher_threads=$STREAM_DISPATCHER_THREADS : "
+      $CMD \
+        --stream_test=fanout \
+        --stream_persister=$STREAM_PERSISTER \
+        --stream_subscribers=$STREAM_SUBSCRIBERS \
+        --stream_dispatcher_threads=$STREAM_DISPATCHER_THREADS
+    done
+  done
+done
+
+# Each query of these goes through the whole stream, so the entries per second are the QPS times its size.
+for STREAM_TEST in replay startup http_catchup ; do
+  for STREAM_PERSISTER in memory file ; do
+    [ $STREAM_TEST == startup ] && [ $STREAM_PERSISTER == memory ] && continue
+    for STREAM_SIZE in 1000 100000 1000000 ; do
+      echo -n "$STREAM_TEST,$STREAM_PERSISTER,size=$STREAM_SIZE : "
+      $CMD --stream_test=$STREAM_TEST --stream_persister=$STREAM_PERSISTER --stream_size=$STREAM_SIZE
+    done
+  done
+done
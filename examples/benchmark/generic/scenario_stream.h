@@ -0,0 +1,207 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#ifndef EXAMLPES_BENCHMARK_GENERIC_SCENARIO_STREAM_H
+#define EXAMLPES_BENCHMARK_GENERIC_SCENARIO_STREAM_H
+
+#include "../../../port.h"
+
+#include "benchmark.h"
+
+#include "../replication/entry.h"
+#include "../../../blocks/http/api.h"
+#include "../../../stream/stream.h"
+
+#include "../../../bricks/dflags/dflags.h"
+#include "../../../bricks/file/file.h"
+
+#ifndef CURRENT_MAKE_CHECK_MODE
+DEFINE_string(stream_test, "publish", "The stream operation to run per query, see `run_stream_tests.sh`.");
+DEFINE_string(stream_persister, "memory", "The persister of the stream, 'memory' or 'file'.");
+DEFINE_uint32(stream_size, 100000, "The number of entries in the stream to replay, to start up from, or to catch up.");
+DEFINE_uint32(stream_entry_length, 100, "The length of the string in each entry of the stream.");
+DEFINE_uint32(stream_subscribers, 1, "The number of subscribers for the 'fanout' test.");
+DEFINE_uint32(stream_dispatcher_threads, 0, "If nonzero, run the subscribers on a dispatcher of this many threads.");
+DEFINE_uint16(stream_http_port, 9760, "The local port to serve the stream on for the 'http_catchup' test.");
+#else
+DECLARE_string(stream_test);
+DECLARE_string(stream_persister);
+DECLARE_uint32(stream_size);
+DECLARE_uint32(stream_entry_length);
+DECLARE_uint32(stream_subscribers);
+DECLARE_uint32(stream_dispatcher_threads);
+DECLARE_uint16(stream_http_port);
+#endif
+
+namespace benchmark {
+namespace stream {
+
+using benchmark::replication::Entry;
+using current::ss::EntryResponse;
+using current::ss::TerminationResponse;
+
+struct EntriesCounterImpl {
+  std::atomic<uint64_t> seen{0u};
+  uint64_t done_after = 0u;  // If nonzero, the subscription is done once this many entries are seen.
+
+  EntryResponse operator()(const Entry&, idxts_t current, idxts_t) {
+    seen = current.index + 1u;
+    return done_after && current.index + 1u >= done_after ? EntryResponse::Done : EntryResponse::More;
+  }
+
+  EntryResponse operator()(std::chrono::microseconds) const { return EntryResponse::More; }
+
+  static EntryResponse EntryResponseIfNoMorePassTypeFilter() { return EntryResponse::More; }
+
+  TerminationResponse Terminate() { return TerminationResponse::Terminate; }
+};
+
+using EntriesCounter = current::ss::StreamSubscriber<EntriesCounterImpl, Entry>;
+
+struct Test {
+  virtual ~Test() = default;
+  virtual void RunOneQuery() = 0;
+};
+
+template <template <typename> class PERSISTER>
+struct TestImpl;
+
+template <>
+struct TestImpl<current::persistence::Memory> {
+  using stream_t = current::stream::Stream<Entry, current::persistence::Memory>;
+  static current::Owned<stream_t> CreateStream(const std::string&) { return stream_t::CreateStream(); }
+};
+
+template <>
+struct TestImpl<current::persistence::File> {
+  using stream_t = current::stream::Stream<Entry, current::persistence::File>;
+  static current::Owned<stream_t> CreateStream(const std::string& filename) {
+    return stream_t::CreateStream(filename);
+  }
+};
+
+template <template <typename> class PERSISTER>
+class StreamTest final : public Test {
+ public:
+  using stream_t = typename TestImpl<PERSISTER>::stream_t;
+
+  explicit StreamTest(const std::string& test)
+      : filename_(current::FileSystem::GenTmpFileName()),
+        filename_remover_(filename_),
+        stream_(TestImpl<PERSISTER>::CreateStream(filename_)),
+        entry_(std::string(FLAGS_stream_entry_length, '.')) {
+    if (FLAGS_stream_dispatcher_threads) {
+      dispatcher_ = std::make_unique<current::stream::SubscriberDispatcher>(FLAGS_stream_dispatcher_threads);
+      stream_->SetSubscriberDispatcher(dispatcher_.get());
+    }
+    if (test == "publish") {
+      f_ = [this]() { stream_->Publisher()->Publish(entry_); };
+    } else if (test == "fanout") {
+      // Each query publishes an entry, and waits for every subscriber to have seen it.
+      for (uint32_t i = 0; i < FLAGS_stream_subscribers; ++i) {
+        subscribers_.push_back(std::make_unique<EntriesCounter>());
+        subscriber_scopes_.push_back(stream_->Subscribe(*subscribers_.back()));
+      }
+      f_ = [this]() {
+        const uint64_t size = stream_->Publisher()->Publish(entry_).index + 1u;
+        for (const auto& subscriber : subscribers_) {
+          while (subscriber->seen.load() < size) {
+            std::this_thread::yield();
+          }
+        }
+      };
+    } else {
+      Populate();
+      if (test == "replay") {
+        // Each query subscribes to the stream, and reads it through, from the file for the file persister.
+        f_ = [this]() {
+          EntriesCounter subscriber;
+          subscriber.done_after = FLAGS_stream_size;
+          const auto scope = stream_->Subscribe(subscriber);
+          while (subscriber.seen.load() < FLAGS_stream_size) {
+            std::this_thread::yield();
+          }
+        };
+      } else if (test == "startup") {
+        // Each query starts up a stream from the file, the entries of which are read and checked on startup.
+        CURRENT_ASSERT((std::is_same<stream_t, TestImpl<current::persistence::File>::stream_t>::value));
+        f_ = [this]() { CURRENT_ASSERT(TestImpl<PERSISTER>::CreateStream(filename_)->Data()->Size() > 0u); };
+      } else if (test == "http_catchup") {
+        // Each query fetches the whole stream over HTTP, as a subscriber catching up would.
+        http_scope_ += HTTP(current::net::BarePort(FLAGS_stream_http_port)).Register("/stream", *stream_);
+        url_ = current::strings::Printf("http://localhost:%d/stream?nowait", FLAGS_stream_http_port);
+        f_ = [this]() { CURRENT_ASSERT(!HTTP(GET(url_)).body.empty()); };
+      } else {
+        std::cerr << "The `--stream_test` flag must be 'publish', 'fanout', 'replay', 'startup', or 'http_catchup'."
+                  << std::endl;
+        CURRENT_ASSERT(false);
+      }
+    }
+  }
+
+  void RunOneQuery() override { f_(); }
+
+ private:
+  void Populate() {
+    for (uint32_t i = 0; i < FLAGS_stream_size; ++i) {
+      stream_->Publisher()->Publish(entry_);
+    }
+  }
+
+  const std::string filename_;
+  const current::FileSystem::ScopedRmFile filename_remover_;
+  std::unique_ptr<current::stream::SubscriberDispatcher> dispatcher_;
+  current::Owned<stream_t> stream_;
+  const Entry entry_;
+  // Declared before the scopes, for the subscriptions to be over before the subscribers are destroyed.
+  std::vector<std::unique_ptr<EntriesCounter>> subscribers_;
+  std::vector<typename stream_t::template SubscriberScope<EntriesCounter>> subscriber_scopes_;
+  HTTPRoutesScope http_scope_;
+  std::string url_;
+  std::function<void()> f_;
+};
+
+}  // namespace stream
+}  // namespace benchmark
+
+SCENARIO(stream, "Stream publish, fan-out, replay, startup, and HTTP catch-up test.") {
+  std::unique_ptr<benchmark::stream::Test> test;
+
+  stream() {
+    if (FLAGS_stream_persister == "memory") {
+      test = std::make_unique<benchmark::stream::StreamTest<current::persistence::Memory>>(FLAGS_stream_test);
+    } else if (FLAGS_stream_persister == "file") {
+      test = std::make_unique<benchmark::stream::StreamTest<current::persistence::File>>(FLAGS_stream_test);
+    } else {
+      std::cerr << "The `--stream_persister` flag must be 'memory' or 'file'." << std::endl;
+      CURRENT_ASSERT(false);
+    }
+  }
+
+  void RunOneQuery() override { test->RunOneQuery(); }
+};
+
+REGISTER_SCENARIO(stream);
+
+#endif  // EXAMLPES_BENCHMARK_GENERIC_SCENARIO_STREAM_H
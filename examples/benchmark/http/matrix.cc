@@ -0,0 +1,201 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// Sweeps the HTTP server over a matrix of workloads: the number of concurrent connections, keep-alive on and off,
+// the response size, fixed versus chunked responses, and the latency of the handler itself. Reports the QPS and the
+// latency percentiles per cell, for the changes to the server to be quantified, and for the regressions to be caught.
+//
+// The load is closed-loop: each connection sends its next request once the response to the previous one is in.
+// The requests are sent via `HTTPAsyncClient`, so that thousands of them are outstanding from a few threads.
+
+#include "../../../current.h"
+#include "../../../bricks/dflags/dflags.h"
+#include "../../../blocks/http/async_client.h"
+
+#include "../generic/latency.h"
+
+using namespace current;
+
+DEFINE_double(seconds, 1.0, "Run the load test for this many seconds for each cell of the matrix.");
+DEFINE_string(connections, "1,10,100,1000,10000", "The numbers of concurrent connections, comma-separated.");
+DEFINE_string(keep_alive, "on,off", "Whether to keep the connections open between the requests, comma-separated.");
+DEFINE_string(sizes, "64,4096,65536", "The sizes of the response bodies, in bytes, comma-separated.");
+DEFINE_string(modes, "fixed,chunked", "Whether the responses are sent with `Content-Length` or chunked.");
+DEFINE_string(handler_delays_us, "0,1000", "How long the handler takes before it responds, in microseconds.");
+DEFINE_uint32(chunk_size, 4096, "The size of each chunk of the chunked responses, in bytes.");
+DEFINE_uint32(client_threads, 4, "The number of threads of `HTTPAsyncClient`.");
+DEFINE_uint32(io_threads, 8, "The number of server threads to read requests and run the handlers on.");
+
+CURRENT_STRUCT(HTTPMatrixCell) {
+  CURRENT_FIELD(connections, uint32_t, 0u);
+  CURRENT_FIELD(keep_alive, bool, false);
+  CURRENT_FIELD(size, uint32_t, 0u);
+  CURRENT_FIELD(chunked, bool, false);
+  CURRENT_FIELD(handler_delay_us, uint32_t, 0u);
+};
+
+template <typename T>
+std::vector<T> ParseList(const std::string& flag) {
+  std::vector<T> result;
+  for (const std::string& value : strings::Split(flag, ',')) {
+    result.push_back(FromString<T>(value));
+  }
+  return result;
+}
+
+std::vector<bool> ParseOnOff(const std::string& flag, const std::string& on, const std::string& off) {
+  std::vector<bool> result;
+  for (const std::string& value : strings::Split(flag, ',')) {
+    if (value == on) {
+      result.push_back(true);
+    } else if (value == off) {
+      result.push_back(false);
+    } else {
+      std::cerr << "Expected `" << on << "` or `" << off << "`, got `" << value << "`." << std::endl;
+      std::exit(-1);
+    }
+  }
+  return result;
+}
+
+// The endpoint the matrix is run against: `/matrix?size=N&chunked=0|1&delay_us=D`.
+void Respond(Request r) {
+  const size_t size = FromString<size_t>(r.url.query.get("size", "0"));
+  const bool chunked = r.url.query.get("chunked", "0") == "1";
+  const uint32_t delay_us = FromString<uint32_t>(r.url.query.get("delay_us", "0"));
+  if (delay_us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(delay_us));
+  }
+  if (!chunked) {
+    r(std::string(size, '.'));
+  } else {
+    auto response = r.SendChunkedResponse();
+    const std::string chunk(std::min(size, static_cast<size_t>(FLAGS_chunk_size)), '.');
+    for (size_t sent = 0u; sent < size; sent += chunk.length()) {
+      response(chunk.substr(0u, std::min(chunk.length(), size - sent)));
+    }
+  }
+}
+
+struct CellResult final {
+  LatencyHistogram latencies;
+  uint64_t errors = 0u;
+};
+
+CellResult Run(int port, const HTTPMatrixCell& cell) {
+  http::HTTPClientConnections().Clear();
+  http::HTTPClientConnections().SetMaxIdleConnectionsPerHost(cell.keep_alive ? cell.connections : 0u);
+
+  const std::string url = strings::Printf("http://localhost:%d/matrix?size=%u&chunked=%d&delay_us=%u",
+                                          port,
+                                          cell.size,
+                                          cell.chunked ? 1 : 0,
+                                          cell.handler_delay_us);
+  const auto end =
+      std::chrono::steady_clock::now() + std::chrono::microseconds(static_cast<int64_t>(1e6 * FLAGS_seconds));
+
+  CellResult result;
+  std::mutex mutex;
+  std::condition_variable done;
+  uint32_t active = cell.connections;
+
+  http::HTTPAsyncClient client(FLAGS_client_threads);
+  std::function<void()> send_next;
+  send_next = [&]() {
+    const auto begin = std::chrono::steady_clock::now();
+    const auto complete = [&, begin](bool ok) {
+      const auto now = std::chrono::steady_clock::now();
+      bool more;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (ok) {
+          result.latencies.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - begin).count());
+        } else {
+          ++result.errors;
+        }
+        more = now < end;
+        if (!more && !--active) {
+          done.notify_all();
+        }
+      }
+      if (more) {
+        send_next();
+      }
+    };
+    client.Send(
+        GET(url),
+        [complete, &cell](http::HTTPResponseWithBuffer&& response) {
+          complete(response.code == HTTPResponseCode.OK && response.body.length() == cell.size);
+        },
+        [complete](std::exception_ptr) { complete(false); });
+  };
+  for (uint32_t i = 0u; i < cell.connections; ++i) {
+    send_next();
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [&active]() { return active == 0u; });
+  return result;
+}
+
+int main(int argc, char** argv) {
+  ParseDFlags(&argc, &argv);
+
+  auto reserved_port = net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  http_server.SetIOThreads(FLAGS_io_threads);
+  const auto scope = http_server.Register("/matrix", Respond);
+
+  std::cout << std::right << std::setw(7) << "conns" << std::setw(6) << "k-a" << std::setw(8) << "size"
+            << std::setw(9) << "mode" << std::setw(10) << "delay, us" << std::setw(10) << "QPS" << std::setw(10)
+            << "p50, us" << std::setw(10) << "p99, us" << std::setw(12) << "p99.9, us" << std::setw(8) << "errors"
+            << std::endl;
+  for (uint32_t connections : ParseList<uint32_t>(FLAGS_connections)) {
+    for (bool keep_alive : ParseOnOff(FLAGS_keep_alive, "on", "off")) {
+      http_server.SetKeepAlive(keep_alive ? std::chrono::milliseconds(5000) : std::chrono::milliseconds(0),
+                               static_cast<size_t>(-1));
+      for (uint32_t size : ParseList<uint32_t>(FLAGS_sizes)) {
+        for (bool chunked : ParseOnOff(FLAGS_modes, "chunked", "fixed")) {
+          for (uint32_t handler_delay_us : ParseList<uint32_t>(FLAGS_handler_delays_us)) {
+            HTTPMatrixCell cell;
+            cell.connections = connections;
+            cell.keep_alive = keep_alive;
+            cell.size = size;
+            cell.chunked = chunked;
+            cell.handler_delay_us = handler_delay_us;
+            const CellResult result = Run(port, cell);
+            const BenchmarkLatency latency = result.latencies.Summary();
+            std::cout << std::right << std::setw(7) << connections << std::setw(6) << (keep_alive ? "on" : "off")
+                      << std::setw(8) << size << std::setw(9) << (chunked ? "chunked" : "fixed") << std::setw(10)
+                      << handler_delay_us << std::setw(10)
+                      << static_cast<int64_t>(result.latencies.Count() / FLAGS_seconds) << std::setw(10)
+                      << static_cast<int64_t>(latency.p50_us) << std::setw(10) << static_cast<int64_t>(latency.p99_us)
+                      << std::setw(12) << static_cast<int64_t>(latency.p999_us) << std::setw(8) << result.errors
+                      << std::endl;
+          }
+        }
+      }
+    }
+  }
+}
@@ -43,6 +43,8 @@ class BenchmarkTestServer {
 
   void Join() { http_server_.Join(); }
 
+  current::http::HTTPServerPOSIX& HTTPServer() { return http_server_; }
+
  private:
   const uint16_t port_;
   current::http::HTTPServerPOSIX& http_server_;
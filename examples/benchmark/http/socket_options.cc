@@ -0,0 +1,141 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// Sweeps the `current::net::SocketOptions` of the "A+B over HTTP" server, reporting the QPS and the latency
+// percentiles for each of them, for the options to tune the service with to be picked based on the numbers.
+// Each request is sent over a new connection, for the options of the listening socket to matter as well.
+
+#include <algorithm>
+
+#include "../../../current.h"
+#include "../../../bricks/dflags/dflags.h"
+
+#include "server.h"
+
+using namespace current;
+
+DEFINE_double(seconds, 2.0, "Run the load test for this many seconds for each set of options.");
+DEFINE_int32(threads, 16, "The number of threads to send the requests from.");
+DEFINE_string(only, "", "If set, only run the set of options with this name.");
+
+struct Scenario final {
+  std::string name;
+  net::SocketOptions options;
+};
+
+std::vector<Scenario> Scenarios() {
+  std::vector<Scenario> scenarios;
+  const auto Add = [&scenarios](const std::string& name, std::function<void(net::SocketOptions&)> f) {
+    Scenario scenario;
+    scenario.name = name;
+    f(scenario.options);
+    scenarios.push_back(std::move(scenario));
+  };
+  Add("defaults", [](net::SocketOptions&) {});
+  Add("nodelay", [](net::SocketOptions& o) { o.nagle_algorithm = net::NagleAlgorithm::Disable; });
+  Add("buffers_16k", [](net::SocketOptions& o) { o.send_buffer_size = o.receive_buffer_size = 16 * 1024; });
+  Add("buffers_1m", [](net::SocketOptions& o) { o.send_buffer_size = o.receive_buffer_size = 1024 * 1024; });
+  Add("backlog_16", [](net::SocketOptions& o) { o.max_queued_connections = net::MaxServerQueuedConnectionsValue(16); });
+  Add("backlog_4096",
+      [](net::SocketOptions& o) { o.max_queued_connections = net::MaxServerQueuedConnectionsValue(4096); });
+#if defined(CURRENT_POSIX) && !defined(CURRENT_APPLE)
+  Add("quickack", [](net::SocketOptions& o) { o.quick_ack = true; });
+  Add("defer_accept", [](net::SocketOptions& o) { o.defer_accept = std::chrono::seconds(1); });
+  Add("busy_poll_50us", [](net::SocketOptions& o) { o.busy_poll = std::chrono::microseconds(50); });
+#endif
+#ifndef CURRENT_WINDOWS
+  Add("fast_open", [](net::SocketOptions& o) { o.fast_open_queue_length = 256; });
+#endif
+  Add("nodelay_quickack_defer_accept", [](net::SocketOptions& o) {
+    o.nagle_algorithm = net::NagleAlgorithm::Disable;
+#if defined(CURRENT_POSIX) && !defined(CURRENT_APPLE)
+    o.quick_ack = true;
+    o.defer_accept = std::chrono::seconds(1);
+#endif
+  });
+  return scenarios;
+}
+
+// Runs the requests from `FLAGS_threads` threads for `FLAGS_seconds`, and returns the latencies, in microseconds.
+std::vector<int64_t> Run(int port) {
+  std::vector<std::vector<int64_t>> per_thread(FLAGS_threads);
+  std::vector<std::thread> threads;
+  const std::chrono::microseconds end =
+      time::Now() + std::chrono::microseconds(static_cast<int64_t>(1e6 * FLAGS_seconds));
+  for (auto& latencies : per_thread) {
+    threads.emplace_back([port, end, &latencies]() {
+      while (time::Now() < end) {
+        const int a = random::RandomIntegral(-1000000, +1000000);
+        const int b = random::RandomIntegral(-1000000, +1000000);
+        const std::chrono::microseconds begin = time::Now();
+        const auto r = HTTP(GET(strings::Printf("http://localhost:%d/add?a=%d&b=%d", port, a, b)));
+        latencies.push_back((time::Now() - begin).count());
+        CURRENT_ASSERT(r.code == HTTPResponseCode.OK);
+        CURRENT_ASSERT(ParseJSON<AddResult>(r.body).sum == a + b);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  std::vector<int64_t> latencies;
+  for (const auto& thread_latencies : per_thread) {
+    latencies.insert(latencies.end(), thread_latencies.begin(), thread_latencies.end());
+  }
+  std::sort(latencies.begin(), latencies.end());
+  return latencies;
+}
+
+int main(int argc, char** argv) {
+  ParseDFlags(&argc, &argv);
+
+  std::cout << std::left << std::setw(32) << "options" << std::right << std::setw(10) << "QPS" << std::setw(10)
+            << "p50, us" << std::setw(10) << "p99, us" << std::setw(12) << "p99.9, us" << std::endl;
+  for (const Scenario& scenario : Scenarios()) {
+    if (!FLAGS_only.empty() && scenario.name != FLAGS_only) {
+      continue;
+    }
+    auto reserved_port = net::ReserveLocalPort();
+    const int port = reserved_port;
+    BenchmarkTestServer server(std::move(reserved_port), "/add");
+    try {
+      server.HTTPServer().SetSocketOptions(scenario.options);
+    } catch (const net::SocketOptionException&) {
+      // Such as `busy_poll` without `CAP_NET_ADMIN`.
+      std::cout << std::left << std::setw(32) << scenario.name << "not available" << std::endl;
+      continue;
+    }
+    const std::vector<int64_t> latencies = Run(port);
+    const auto Percentile = [&latencies](double p) -> int64_t {
+      if (latencies.empty()) {
+        return 0;
+      }
+      return latencies[std::min(latencies.size() - 1u, static_cast<size_t>(p * latencies.size()))];
+    };
+    std::cout << std::left << std::setw(32) << scenario.name << std::right << std::setw(10)
+              << static_cast<int64_t>(latencies.size() / FLAGS_seconds) << std::setw(10) << Percentile(0.5)
+              << std::setw(10) << Percentile(0.99) << std::setw(12) << Percentile(0.999) << std::endl;
+  }
+}
@@ -0,0 +1,216 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// Measures the throughput and the allocations of serializing and parsing the `CURRENT_STRUCT`-s of various shapes,
+// in each format supported. Prints one JSON per line, per shape, format and operation, for the results to be compared
+// across revisions, i.e.: `./.current/benchmark --seconds=1 > results.jsonl`.
+
+#include "../../../port.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <set>
+
+#include "../../../bricks/dflags/dflags.h"
+#include "../../../bricks/strings/split.h"
+#include "../../../typesystem/serialization/binary.h"
+#include "../../../typesystem/serialization/json.h"
+
+#include "schema.h"
+
+DEFINE_double(seconds, 0.5, "Run each measurement for at least this many seconds.");
+DEFINE_string(shapes, "", "Comma-separated shapes to benchmark: flat,nested,variant_heavy,map_heavy,large_vectors.");
+DEFINE_string(formats, "", "Comma-separated formats to benchmark: binary,json,json_minimalistic,json_js,json_fsharp.");
+
+// Counted by the global `operator new` replaced below.
+static std::atomic<uint64_t> allocations(0u);
+static std::atomic<uint64_t> allocated_bytes(0u);
+
+void* operator new(size_t size) {
+  allocations.fetch_add(1u, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  void* result = std::malloc(size ? size : 1u);
+  if (!result) {
+    throw std::bad_alloc();
+  }
+  return result;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace serialization_benchmark {
+
+CURRENT_STRUCT(Measurement) {
+  CURRENT_FIELD(shape, std::string);
+  CURRENT_FIELD(format, std::string);
+  CURRENT_FIELD(operation, std::string);
+  CURRENT_FIELD(payload_bytes, uint64_t, 0u);
+  CURRENT_FIELD(iterations, uint64_t, 0u);
+  CURRENT_FIELD(ns_per_op, double, 0.0);
+  CURRENT_FIELD(mb_per_second, double, 0.0);
+  CURRENT_FIELD(allocations_per_op, double, 0.0);
+  CURRENT_FIELD(allocated_bytes_per_op, double, 0.0);
+};
+
+struct BinaryFormat {
+  static const char* Name() { return "binary"; }
+  template <typename T>
+  static std::string Serialize(const T& object) {
+    return current::serialization::binary::SaveIntoBinary(object);
+  }
+  template <typename T>
+  static T Parse(const std::string& payload) {
+    T result;
+    current::serialization::binary::LoadFromBinary(payload, result);
+    return result;
+  }
+};
+
+template <class J>
+struct GenericJSONFormat {
+  template <typename T>
+  static std::string Serialize(const T& object) {
+    return JSON<J>(object);
+  }
+  template <typename T>
+  static T Parse(const std::string& payload) {
+    return ParseJSON<T, J>(payload);
+  }
+};
+
+struct CurrentJSONFormat : GenericJSONFormat<JSONFormat::Current> {
+  static const char* Name() { return "json"; }
+};
+
+struct MinimalisticJSONFormat : GenericJSONFormat<JSONFormat::Minimalistic> {
+  static const char* Name() { return "json_minimalistic"; }
+};
+
+struct JavaScriptJSONFormat : GenericJSONFormat<JSONFormat::JavaScript> {
+  static const char* Name() { return "json_js"; }
+};
+
+struct NewtonsoftFSharpJSONFormat : GenericJSONFormat<JSONFormat::NewtonsoftFSharp> {
+  static const char* Name() { return "json_fsharp"; }
+};
+
+// Empty means all, otherwise only the names listed are run.
+struct Selection {
+  std::set<std::string> names;
+  Selection(const std::string& flag, const std::set<std::string>& known) {
+    for (const std::string& name : current::strings::Split(flag, ',')) {
+      if (!known.count(name)) {
+        std::cerr << "Unknown name: `" << name << "`." << std::endl;
+        std::exit(-1);
+      }
+      names.insert(name);
+    }
+  }
+  bool Contains(const std::string& name) const { return names.empty() || names.count(name); }
+};
+
+// Runs `f` for at least `--seconds`, after one warm-up run, and outputs the results.
+template <typename F>
+void Measure(Measurement& measurement, F&& f) {
+  static volatile size_t sink = 0u;
+  sink = sink + f();
+  const uint64_t allocations_begin = allocations.load();
+  const uint64_t allocated_bytes_begin = allocated_bytes.load();
+  const auto begin = std::chrono::steady_clock::now();
+  uint64_t iterations = 0u;
+  double seconds;
+  do {
+    sink = sink + f();
+    ++iterations;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  } while (seconds < FLAGS_seconds);
+  measurement.iterations = iterations;
+  measurement.ns_per_op = seconds * 1e9 / iterations;
+  measurement.mb_per_second = 1e-6 * measurement.payload_bytes * iterations / seconds;
+  measurement.allocations_per_op = static_cast<double>(allocations.load() - allocations_begin) / iterations;
+  measurement.allocated_bytes_per_op = static_cast<double>(allocated_bytes.load() - allocated_bytes_begin) / iterations;
+  std::cout << JSON<JSONFormat::Minimalistic>(measurement) << std::endl;
+}
+
+template <class FORMAT, typename T>
+void BenchmarkFormat(const Selection& formats, const std::string& shape, const T& object) {
+  if (!formats.Contains(FORMAT::Name())) {
+    return;
+  }
+  const std::string payload = FORMAT::Serialize(object);
+  // The round trip should not lose anything, though the order of the unordered containers may change.
+  if (FORMAT::Serialize(FORMAT::template Parse<T>(payload)).length() != payload.length()) {
+    std::cerr << "The `" << shape << "` shape does not survive the round trip via `" << FORMAT::Name() << "`."
+              << std::endl;
+    std::exit(-1);
+  }
+  Measurement measurement;
+  measurement.shape = shape;
+  measurement.format = FORMAT::Name();
+  measurement.payload_bytes = payload.length();
+  measurement.operation = "serialize";
+  Measure(measurement, [&object]() { return FORMAT::Serialize(object).length(); });
+  measurement.operation = "parse";
+  Measure(measurement, [&payload]() {
+    FORMAT::template Parse<T>(payload);
+    return size_t(1u);
+  });
+}
+
+template <typename T>
+void BenchmarkShape(const Selection& shapes, const Selection& formats, const std::string& shape, T&& make) {
+  if (!shapes.Contains(shape)) {
+    return;
+  }
+  const auto object = make();
+  BenchmarkFormat<BinaryFormat>(formats, shape, object);
+  BenchmarkFormat<CurrentJSONFormat>(formats, shape, object);
+  BenchmarkFormat<MinimalisticJSONFormat>(formats, shape, object);
+  BenchmarkFormat<JavaScriptJSONFormat>(formats, shape, object);
+  BenchmarkFormat<NewtonsoftFSharpJSONFormat>(formats, shape, object);
+}
+
+}  // namespace serialization_benchmark
+
+int main(int argc, char** argv) {
+  ParseDFlags(&argc, &argv);
+
+  using namespace serialization_benchmark;
+
+  const Selection shapes(FLAGS_shapes, {"flat", "nested", "variant_heavy", "map_heavy", "large_vectors"});
+  const Selection formats(FLAGS_formats, {"binary", "json", "json_minimalistic", "json_js", "json_fsharp"});
+
+  BenchmarkShape(shapes, formats, "flat", []() { return MakeFlat(42u); });
+  BenchmarkShape(shapes, formats, "nested", MakeNested);
+  BenchmarkShape(shapes, formats, "variant_heavy", MakeVariantHeavy);
+  BenchmarkShape(shapes, formats, "map_heavy", MakeMapHeavy);
+  BenchmarkShape(shapes, formats, "large_vectors", MakeLargeVectors);
+
+  return 0;
+}
@@ -0,0 +1,185 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// The `CURRENT_STRUCT` shapes the serialization benchmark runs on, with their contents generated deterministically.
+
+#ifndef EXAMPLES_BENCHMARK_SERIALIZATION_SCHEMA_H
+#define EXAMPLES_BENCHMARK_SERIALIZATION_SCHEMA_H
+
+#include "../../../port.h"
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../../../bricks/strings/util.h"
+#include "../../../typesystem/struct.h"
+#include "../../../typesystem/optional.h"
+#include "../../../typesystem/variant.h"
+
+namespace serialization_benchmark {
+
+CURRENT_ENUM(Priority, uint8_t){Low = 0u, Normal = 1u, High = 2u};
+
+// The primitives, the strings, an enum and an `Optional`, with no nesting.
+CURRENT_STRUCT(Flat) {
+  CURRENT_FIELD(id, uint64_t, 0u);
+  CURRENT_FIELD(count, int32_t, 0);
+  CURRENT_FIELD(ratio, double, 0.0);
+  CURRENT_FIELD(enabled, bool, false);
+  CURRENT_FIELD(priority, Priority, Priority::Normal);
+  CURRENT_FIELD(name, std::string);
+  CURRENT_FIELD(description, std::string);
+  CURRENT_FIELD(comment, Optional<std::string>);
+};
+
+CURRENT_STRUCT(Inner) {
+  CURRENT_FIELD(flat, Flat);
+  CURRENT_FIELD(tags, std::vector<std::string>);
+};
+
+CURRENT_STRUCT(Nested) {
+  CURRENT_FIELD(header, Flat);
+  CURRENT_FIELD(children, std::vector<Inner>);
+  CURRENT_FIELD(parent, Optional<Inner>);
+};
+
+CURRENT_STRUCT(Created) {
+  CURRENT_FIELD(id, uint64_t, 0u);
+  CURRENT_FIELD(name, std::string);
+};
+
+CURRENT_STRUCT(Updated) {
+  CURRENT_FIELD(id, uint64_t, 0u);
+  CURRENT_FIELD(field, std::string);
+  CURRENT_FIELD(value, std::string);
+};
+
+CURRENT_STRUCT(Deleted) { CURRENT_FIELD(id, uint64_t, 0u); };
+
+CURRENT_STRUCT(VariantHeavy) { CURRENT_FIELD(events, (std::vector<Variant<Created, Updated, Deleted, Flat>>)); };
+
+CURRENT_STRUCT(MapHeavy) {
+  CURRENT_FIELD(by_name, (std::map<std::string, Flat>));
+  CURRENT_FIELD(counters, (std::map<std::string, uint64_t>));
+  CURRENT_FIELD(labels, (std::unordered_map<uint64_t, std::string>));
+};
+
+CURRENT_STRUCT(LargeVectors) {
+  CURRENT_FIELD(ids, std::vector<uint64_t>);
+  CURRENT_FIELD(values, std::vector<double>);
+  CURRENT_FIELD(names, std::vector<std::string>);
+  CURRENT_FIELD(rows, std::vector<Flat>);
+};
+
+inline Flat MakeFlat(uint64_t i) {
+  Flat result;
+  result.id = i;
+  result.count = static_cast<int32_t>(i * 7u) - 1000;
+  result.ratio = 0.125 * static_cast<double>(i);
+  result.enabled = (i % 2u) == 0u;
+  result.priority = static_cast<Priority>(i % 3u);
+  result.name = "name_" + current::ToString(i);
+  result.description = "The description of the entry number " + current::ToString(i) + ", with \"quotes\".";
+  if (i % 3u) {
+    result.comment = "comment_" + current::ToString(i);
+  }
+  return result;
+}
+
+inline Inner MakeInner(uint64_t i) {
+  Inner result;
+  result.flat = MakeFlat(i);
+  for (uint64_t j = 0u; j < 4u; ++j) {
+    result.tags.push_back("tag_" + current::ToString(i * 4u + j));
+  }
+  return result;
+}
+
+inline Nested MakeNested() {
+  Nested result;
+  result.header = MakeFlat(0u);
+  for (uint64_t i = 1u; i <= 16u; ++i) {
+    result.children.push_back(MakeInner(i));
+  }
+  result.parent = MakeInner(100u);
+  return result;
+}
+
+inline VariantHeavy MakeVariantHeavy() {
+  VariantHeavy result;
+  for (uint64_t i = 0u; i < 256u; ++i) {
+    if (i % 4u == 0u) {
+      Created created;
+      created.id = i;
+      created.name = "created_" + current::ToString(i);
+      result.events.push_back(std::move(created));
+    } else if (i % 4u == 1u) {
+      Updated updated;
+      updated.id = i;
+      updated.field = "field_" + current::ToString(i % 10u);
+      updated.value = "value_" + current::ToString(i);
+      result.events.push_back(std::move(updated));
+    } else if (i % 4u == 2u) {
+      Deleted deleted;
+      deleted.id = i;
+      result.events.push_back(std::move(deleted));
+    } else {
+      result.events.push_back(MakeFlat(i));
+    }
+  }
+  return result;
+}
+
+inline MapHeavy MakeMapHeavy() {
+  MapHeavy result;
+  for (uint64_t i = 0u; i < 256u; ++i) {
+    const std::string key = "key_" + current::ToString(i);
+    result.by_name[key] = MakeFlat(i);
+    result.counters[key] = i * i;
+    result.labels[i * 1000003u] = "label_" + current::ToString(i);
+  }
+  return result;
+}
+
+inline LargeVectors MakeLargeVectors() {
+  LargeVectors result;
+  for (uint64_t i = 0u; i < 100000u; ++i) {
+    result.ids.push_back(i * 2654435761u);
+    result.values.push_back(static_cast<double>(i) / 1024.0);
+  }
+  for (uint64_t i = 0u; i < 10000u; ++i) {
+    result.names.push_back("name_" + current::ToString(i));
+  }
+  for (uint64_t i = 0u; i < 1000u; ++i) {
+    result.rows.push_back(MakeFlat(i));
+  }
+  return result;
+}
+
+}  // namespace serialization_benchmark
+
+#endif  // EXAMPLES_BENCHMARK_SERIALIZATION_SCHEMA_H
@@ -0,0 +1,134 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2016 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// Converts the `Stream<T>` file into the columnar one, and prints a few of its columns, with the times it takes to
+// replay the stream parsing each entry, and to read the columns from the columnar file.
+//
+// Generate a sample stream, and convert it:
+//   ./.current/columnar_export --generate 1000000 --columns session,action.Purchase.cents
+// Convert an existing stream of `columnar_export::Event`-s, or of the type of your own, changing `entry_t` below:
+//   ./.current/columnar_export --input events.stream --output events.columnar
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+#include "schema.h"
+
+#include "../../bricks/dflags/dflags.h"
+#include "../../bricks/file/file.h"
+#include "../../bricks/strings/split.h"
+#include "../../stream/stream.h"
+#include "../../typesystem/columnar/columnar.h"
+
+DEFINE_string(input, "events.stream", "The input `Stream<T>` file.");
+DEFINE_string(output, "events.columnar", "The output columnar file.");
+DEFINE_size_t(generate, 0u, "If nonzero, first overwrite `--input` with this many randomly generated events.");
+DEFINE_size_t(rows_per_block, CompactTSVColumnarWriter::kDefaultRowsPerBlock, "Rows per block of the output.");
+DEFINE_string(columns, "", "The comma-separated columns to read from the output; lists the columns if empty.");
+DEFINE_size_t(print, 10u, "The number of rows of `--columns` to print.");
+
+using entry_t = columnar_export::Event;
+using stream_t = current::stream::Stream<entry_t, current::persistence::File>;
+
+void Generate() {
+  current::FileSystem::RmFile(FLAGS_input, current::FileSystem::RmFileParameters::Silent);
+  auto stream = stream_t::CreateStream(FLAGS_input);
+  auto publisher = stream->BorrowPublisher();
+  for (size_t i = 0u; i < FLAGS_generate; ++i) {
+    columnar_export::Event event;
+    event.user = "user" + current::ToString(i * 7919u % 1000u);
+    event.session = 1000000u + i / 20u;
+    if (i % 3u) {
+      event.geo = columnar_export::Geo();
+      Value(event.geo).lat = 37.0 + 0.001 * static_cast<double>(i % 1000u);
+      Value(event.geo).lon = -122.0 - 0.001 * static_cast<double>(i % 777u);
+    }
+    if (i % 10u) {
+      columnar_export::PageView view;
+      view.url = "/page/" + current::ToString(i % 50u);
+      view.duration_ms = static_cast<uint32_t>(i * 31u % 5000u);
+      event.action = view;
+    } else {
+      columnar_export::Purchase purchase;
+      purchase.sku = "sku" + current::ToString(i % 123u);
+      purchase.cents = static_cast<int64_t>(i % 10000u) * 10;
+      if (i % 7u == 0u) {
+        purchase.coupon = "SAVE10";
+      }
+      event.action = purchase;
+    }
+    publisher->Publish(std::move(event));
+  }
+}
+
+int main(int argc, char** argv) {
+  ParseDFlags(&argc, &argv);
+
+  if (FLAGS_generate) {
+    Generate();
+  }
+
+  const auto t_replay_begin = std::chrono::steady_clock::now();
+  size_t entries = 0u;
+  {
+    auto stream = stream_t::CreateStream(FLAGS_input);
+    std::ofstream os(FLAGS_output, std::ios::binary);
+    current::columnar::ColumnarWriter<entry_t> writer(os, FLAGS_rows_per_block);
+    for (const auto& e : stream->Data()->Iterate()) {
+      writer(e.entry);
+      ++entries;
+    }
+    writer.Finalize();
+  }
+  const auto t_replay_end = std::chrono::steady_clock::now();
+  std::cerr << "Converted " << entries << " entries, " << current::FileSystem::GetFileSize(FLAGS_input)
+            << " bytes, into " << current::FileSystem::GetFileSize(FLAGS_output) << " bytes in "
+            << std::chrono::duration<double>(t_replay_end - t_replay_begin).count() << "s.\n";
+
+  const current::columnar::ColumnarFileReader<entry_t> reader(FLAGS_output);
+  if (FLAGS_columns.empty()) {
+    for (const std::string& column : reader.Columns()) {
+      std::cout << column << '\n';
+    }
+    return 0;
+  }
+
+  const std::vector<std::string> columns = current::strings::Split(FLAGS_columns, ',');
+  size_t printed = 0u;
+  const auto t_read_begin = std::chrono::steady_clock::now();
+  reader.Unpack(columns, [&printed](const std::vector<std::string_view>& row) {
+    if (printed < FLAGS_print) {
+      for (size_t i = 0u; i < row.size(); ++i) {
+        std::cout << (i ? "\t" : "") << row[i];
+      }
+      std::cout << '\n';
+      ++printed;
+    }
+  });
+  const auto t_read_end = std::chrono::steady_clock::now();
+  std::cerr << "Read " << columns.size() << " of " << reader.Columns().size() << " columns of " << reader.Rows()
+            << " rows in " << std::chrono::duration<double>(t_read_end - t_read_begin).count() << "s.\n";
+}
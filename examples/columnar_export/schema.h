@@ -0,0 +1,61 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2016 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+#ifndef EXAMPLES_COLUMNAR_EXPORT_SCHEMA_H
+#define EXAMPLES_COLUMNAR_EXPORT_SCHEMA_H
+
+#include "../../typesystem/struct.h"
+#include "../../typesystem/optional.h"
+#include "../../typesystem/variant.h"
+
+namespace columnar_export {
+
+CURRENT_STRUCT(Geo) {
+  CURRENT_FIELD(lat, double);
+  CURRENT_FIELD(lon, double);
+};
+
+CURRENT_STRUCT(PageView) {
+  CURRENT_FIELD(url, std::string);
+  CURRENT_FIELD(duration_ms, uint32_t);
+};
+
+CURRENT_STRUCT(Purchase) {
+  CURRENT_FIELD(sku, std::string);
+  CURRENT_FIELD(cents, int64_t);
+  CURRENT_FIELD(coupon, Optional<std::string>);
+};
+
+CURRENT_STRUCT(Event) {
+  CURRENT_FIELD(user, std::string);
+  CURRENT_FIELD(session, uint64_t);
+  CURRENT_FIELD(geo, Optional<Geo>);
+  CURRENT_FIELD(action, (Variant<PageView, Purchase>));
+  CURRENT_FIELD(labels, std::vector<std::string>);
+};
+
+}  // namespace columnar_export
+
+#endif  // EXAMPLES_COLUMNAR_EXPORT_SCHEMA_H
@@ -26,6 +26,8 @@ SOFTWARE.
 
 #include "schema.h"
 
+#include "../../stream/read_model.h"
+
 using namespace current;
 
 DEFINE_string(db_dir, ".current", "Local path to the data storage location.");
@@ -35,33 +37,32 @@ DEFINE_bool(legend, true, "Print example usage patterns.");
 
 DEFINE_bool(verbose, true, "Dump extra information to stderr.");
 
-// Example eventually consistent read model.
+// Example eventually consistent read model, maintained incrementally, see `current::stream::ReadModel`.
+CURRENT_STRUCT(UserNicknames) {
+  CURRENT_FIELD(nicknames, (std::unordered_map<std::string, std::string>));
+
+  // The mutator. Ignore all other types of events.
+  void Apply(const Event& e, idxts_t) {
+    if (Exists<UserAdded>(e.event)) {
+      const UserAdded& user = Value<UserAdded>(e.event);
+      nicknames[user.user_id] = user.nickname;
+    }
+  }
+};
+
+template <typename STREAM>
 struct UserNicknamesReadModel {
-  // The in-memory state and exclusive operations on it.
-  struct State {
-    // The mutable state.
-    std::unordered_map<std::string, std::string> nicknames;
-
-    // The mutator.
-    void operator()(const UserAdded& user) { nicknames[user.user_id] = user.nickname; }
-
-    // Ignore all other types of events.
-    void operator()(const CurrentSuper&) {}
-  };
-
-  // Mutex-locked state for eventually consistent read model.
-  State state_;
-  mutable std::mutex mutex_;
-  std::atomic_bool replay_done_;
+  // Checkpointed next to the event log, to not replay it from the very start on restart.
+  current::stream::ReadModel<UserNicknames, STREAM> read_model_;
   HTTPRoutesScope endpoints_;
 
-  UserNicknamesReadModel(int port)
-      : replay_done_(false),
+  UserNicknamesReadModel(int port, const STREAM& stream, current::stream::ReadModelCheckpointing checkpointing)
+      : read_model_(stream, std::move(checkpointing)),
         endpoints_(HTTP(port).Register("/ready", [this](Request r) { OnReady(std::move(r)); }) +
                    HTTP(port).Register("/nickname", [this](Request r) { OnNickname(std::move(r)); })) {}
 
   void OnReady(Request r) const {
-    if (replay_done_) {
+    if (read_model_.Ready()) {
       r("", HTTPResponseCode.NoContent);
     } else {
       NotYetReady(std::move(r));
@@ -69,11 +70,11 @@ struct UserNicknamesReadModel {
   }
 
   void OnNickname(Request r) const {
-    if (replay_done_) {
+    if (read_model_.Ready()) {
       const std::string user_id = r.url.query["id"];
-      std::lock_guard<std::mutex> lock(mutex_);
-      const auto cit = state_.nicknames.find(user_id);
-      if (cit != state_.nicknames.end()) {
+      const auto snapshot = read_model_.Snapshot();
+      const auto cit = snapshot->model.nicknames.find(user_id);
+      if (cit != snapshot->model.nicknames.end()) {
         r(UserNickname(user_id, cit->second));
       } else {
         r(UserNicknameNotFound(user_id), HTTPResponseCode.NotFound);
@@ -86,21 +87,6 @@ struct UserNicknamesReadModel {
   void NotYetReady(Request r) const {
     r(Error("Nicknames read model is still replaying the log. Try again soon."), HTTPResponseCode.BadRequest);
   }
-
-  // A new event from the event log. Process it in a polymorphic way, ignore everything but `UserAdded`.
-  current::ss::EntryResponse operator()(const Event& e, idxts_t current, idxts_t total) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    e.event.Call(state_);
-    if (current.index + 1 == total.index) {
-      replay_done_ = true;
-    }
-    return current::ss::EntryResponse::More;
-  }
-  current::ss::EntryResponse operator()(std::chrono::microseconds) const { return current::ss::EntryResponse::More; }
-
-  current::ss::EntryResponse EntryResponseIfNoMorePassTypeFilter() const { return current::ss::EntryResponse::More; }
-
-  current::ss::TerminationResponse Terminate() { return current::ss::TerminationResponse::Terminate; }
 };
 
 int main(int argc, char** argv) {
@@ -112,8 +98,8 @@ int main(int argc, char** argv) {
   auto& http_server = HTTP(std::move(reserved_port));
   static_cast<void>(http_server);
 
-  auto stream = current::stream::Stream<Event, current::persistence::File>::CreateStream(
-      FileSystem::JoinPath(FLAGS_db_dir, FLAGS_db_filename));
+  using stream_t = current::stream::Stream<Event, current::persistence::File>;
+  auto stream = stream_t::CreateStream(FileSystem::JoinPath(FLAGS_db_dir, FLAGS_db_filename));
 
   // Example command lines to get started.
   if (FLAGS_legend) {
@@ -185,8 +171,9 @@ int main(int argc, char** argv) {
   });
 
   // Read model.
-  current::ss::StreamSubscriber<UserNicknamesReadModel, Event> read_model(port);
-  const auto subscriber_scope = stream->Subscribe(read_model);
+  current::stream::ReadModelCheckpointing checkpointing;
+  checkpointing.file_name = FileSystem::JoinPath(FLAGS_db_dir, FLAGS_db_filename + ".nicknames");
+  UserNicknamesReadModel<stream_t> read_model(port, *stream, std::move(checkpointing));
 
   // Run forever.
   HTTP(port).Join();
@@ -25,11 +25,14 @@ SOFTWARE.
 #ifndef EXAMPLES_EVENT_COLLECTOR_H
 #define EXAMPLES_EVENT_COLLECTOR_H
 
+#include <algorithm>
 #include <functional>
 #include <map>
 #include <ostream>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #include "../../blocks/http/api.h"
 #include "../../bricks/time/chrono.h"
@@ -62,15 +65,122 @@ CURRENT_STRUCT(LogEntryWithHeaders) {
   // TODO(dkorolev): Resolve geolocation from IP?
 };
 
-class EventCollectorHTTPServer {
+// Compact version: the query parameters and the allowlisted HTTP headers only, as flat vectors sorted by the key.
+// The headers are keyed by the indexes of their names in `CompactEventCapture::HeaderNames()` of the collector.
+CURRENT_STRUCT(CompactLogEntry) {
+  CURRENT_FIELD(t, uint64_t);                                            // Unix epoch time in microseconds.
+  CURRENT_FIELD(m, std::string);                                         // HTTP method.
+  CURRENT_FIELD(u, std::string);                                         // URL without fragments and query parameters.
+  CURRENT_FIELD(q, (std::vector<std::pair<std::string, std::string>>));  // URL query parameters.
+  CURRENT_FIELD(h, (std::vector<std::pair<uint16_t, std::string>>));     // Allowlisted HTTP headers.
+  CURRENT_FIELD(c, std::string);                                         // HTTP cookies, as string.
+  CURRENT_FIELD(b, std::string);                                         // HTTP body.
+  CURRENT_FIELD(f, std::string);                                         // URL fragment.
+};
+
+// Captures the requests into `LogEntryWithHeaders`, with all the query parameters and HTTP headers.
+struct FullEventCapture {
+  using entry_t = LogEntryWithHeaders;
+
+  entry_t Capture(std::chrono::microseconds now, const Request& r) const {
+    entry_t entry;
+    entry.t = now.count();
+    entry.m = r.method;
+    entry.u = r.url.ComposeURLWithoutParameters();
+    entry.q = r.url.AllQueryParameters();
+    entry.h = r.headers.AsMap();
+    entry.c = r.headers.CookiesAsString();
+    entry.b = r.body;
+    entry.f = r.url.fragment;
+    return entry;
+  }
+
+  entry_t Tick(std::chrono::microseconds now) const {
+    entry_t entry;
+    entry.t = now.count();
+    entry.m = "TICK";
+    return entry;
+  }
+};
+
+// Captures the requests into `CompactLogEntry`, keeping only the HTTP headers from the allowlist, which is interned
+// once: the names are sorted and deduplicated case-insensitively, keeping the first spelling, and the headers refer
+// to them by index.
+class CompactEventCapture {
  public:
-  EventCollectorHTTPServer(int http_port,
-                           std::ostream& ostream,
-                           std::chrono::microseconds tick_interval_us,
-                           const std::string& route = "/log",
-                           const std::string& response_text = "OK\n",
-                           std::function<void(const LogEntryWithHeaders&)> callback = {})
-      : http_port_(http_port),
+  using entry_t = CompactLogEntry;
+
+  explicit CompactEventCapture(std::vector<std::string> header_names = DefaultHeaderNames())
+      : header_names_(std::move(header_names)) {
+    const current::net::http::Header::KeyComparator less;
+    // Cookies are captured separately, and `Headers` do not hold them.
+    header_names_.erase(std::remove_if(header_names_.begin(),
+                                       header_names_.end(),
+                                       [&less](const std::string& name) {
+                                         return name.empty() || (!less(name, "Cookie") && !less("Cookie", name));
+                                       }),
+                        header_names_.end());
+    std::stable_sort(header_names_.begin(), header_names_.end(), less);
+    header_names_.erase(std::unique(header_names_.begin(),
+                                    header_names_.end(),
+                                    [&less](const std::string& a, const std::string& b) {
+                                      return !less(a, b) && !less(b, a);
+                                    }),
+                        header_names_.end());
+  }
+
+  static std::vector<std::string> DefaultHeaderNames() {
+    return {"Accept-Language", "Host", "Referer", "User-Agent", "X-Forwarded-For", "X-Real-IP"};
+  }
+
+  const std::vector<std::string>& HeaderNames() const { return header_names_; }
+  const std::string& HeaderName(uint16_t index) const { return header_names_[index]; }
+
+  entry_t Capture(std::chrono::microseconds now, const Request& r) const {
+    entry_t entry;
+    entry.t = now.count();
+    entry.m = r.method;
+    entry.u = r.url.ComposeURLWithoutParameters();
+    const auto& q = r.url.AllQueryParameters();
+    entry.q.assign(q.begin(), q.end());
+    for (size_t i = 0u; i < header_names_.size(); ++i) {
+      if (r.headers.Has(header_names_[i])) {
+        entry.h.emplace_back(static_cast<uint16_t>(i), r.headers.Get(header_names_[i]));
+      }
+    }
+    entry.c = r.headers.CookiesAsString();
+    entry.b = r.body;
+    entry.f = r.url.fragment;
+    return entry;
+  }
+
+  entry_t Tick(std::chrono::microseconds now) const {
+    entry_t entry;
+    entry.t = now.count();
+    entry.m = "TICK";
+    return entry;
+  }
+
+ private:
+  std::vector<std::string> header_names_;
+};
+
+// The requests are captured into the entries by `CAPTURE`, and serialized, with no lock taken.
+// The lock is only held to write the serialized entries into the stream, and to call the callback.
+template <class CAPTURE>
+class GenericEventCollectorHTTPServer {
+ public:
+  using entry_t = typename CAPTURE::entry_t;
+
+  GenericEventCollectorHTTPServer(int http_port,
+                                  std::ostream& ostream,
+                                  std::chrono::microseconds tick_interval_us,
+                                  const std::string& route = "/log",
+                                  const std::string& response_text = "OK\n",
+                                  std::function<void(const entry_t&)> callback = {},
+                                  CAPTURE capture = CAPTURE())
+      : capture_(std::move(capture)),
+        http_port_(http_port),
         ostream_(ostream),
         route_(route),
         response_text_(response_text),
@@ -79,23 +189,16 @@ class EventCollectorHTTPServer {
         send_ticks_(tick_interval_us_.count() > 0),
         last_event_t_(0u),
         events_pushed_(0u),
-        timer_thread_(&EventCollectorHTTPServer::TimerThreadFunction, this),
+        timer_thread_(&GenericEventCollectorHTTPServer::TimerThreadFunction, this),
         http_route_scope_(HTTP(http_port_).Register(route_, [this](Request r) {
-          LogEntryWithHeaders entry;
+          const auto now = current::time::Now();
+          const entry_t entry = capture_.Capture(now, r);
+          const std::string json = JSON(entry);
           {
-            const auto now = current::time::Now();
             std::lock_guard<std::mutex> lock(mutex_);
-            entry.t = now.count();
-            entry.m = r.method;
-            entry.u = r.url.ComposeURLWithoutParameters();
-            entry.q = r.url.AllQueryParameters();
-            entry.h = r.headers.AsMap();
-            entry.c = r.headers.CookiesAsString();
-            entry.b = r.body;
-            entry.f = r.url.fragment;
-            ostream_ << JSON(entry) << std::endl;
+            ostream_ << json << std::endl;
             ++events_pushed_;
-            last_event_t_ = now;
+            last_event_t_ = std::max(last_event_t_, now);
             if (callback_) {
               callback_(entry);
             }
@@ -103,12 +206,12 @@ class EventCollectorHTTPServer {
           r(response_text_);
         })) {}
 
-  EventCollectorHTTPServer(const EventCollectorHTTPServer&) = delete;
-  EventCollectorHTTPServer(EventCollectorHTTPServer&&) = delete;
-  void operator=(const EventCollectorHTTPServer&) = delete;
-  void operator=(EventCollectorHTTPServer&&) = delete;
+  GenericEventCollectorHTTPServer(const GenericEventCollectorHTTPServer&) = delete;
+  GenericEventCollectorHTTPServer(GenericEventCollectorHTTPServer&&) = delete;
+  void operator=(const GenericEventCollectorHTTPServer&) = delete;
+  void operator=(GenericEventCollectorHTTPServer&&) = delete;
 
-  ~EventCollectorHTTPServer() {
+  ~GenericEventCollectorHTTPServer() {
     send_ticks_ = false;
     timer_thread_.join();
   }
@@ -123,9 +226,7 @@ class EventCollectorHTTPServer {
         const std::chrono::microseconds now = current::time::Now();
         const std::chrono::microseconds dt = now - last_event_t_;
         if (dt >= tick_interval_us_) {
-          LogEntryWithHeaders entry;
-          entry.t = now.count();
-          entry.m = "TICK";
+          const entry_t entry = capture_.Tick(now);
           ostream_ << JSON(entry) << std::endl;
           ++events_pushed_;
           last_event_t_ = now;
@@ -145,13 +246,16 @@ class EventCollectorHTTPServer {
 
   size_t EventsPushed() const { return events_pushed_; }
 
+  const CAPTURE& Capture() const { return capture_; }
+
  private:
+  const CAPTURE capture_;
   std::mutex mutex_;
   const int http_port_;
   std::ostream& ostream_;
   const std::string route_;
   const std::string response_text_;
-  std::function<void(const LogEntryWithHeaders&)> callback_;
+  std::function<void(const entry_t&)> callback_;
 
   const std::chrono::microseconds tick_interval_us_;
   std::atomic_bool send_ticks_;
@@ -161,4 +265,7 @@ class EventCollectorHTTPServer {
   HTTPRoutesScope http_route_scope_;
 };
 
+using EventCollectorHTTPServer = GenericEventCollectorHTTPServer<FullEventCapture>;
+using CompactEventCollectorHTTPServer = GenericEventCollectorHTTPServer<CompactEventCapture>;
+
 #endif  // EXAMPLES_EVENT_COLLECTOR_H
@@ -33,6 +33,7 @@ SOFTWARE.
 
 #include "event_collector.h"
 
+#include "../../bricks/strings/join.h"
 #include "../../bricks/strings/printf.h"
 
 #include "../../bricks/dflags/dflags.h"
@@ -149,3 +150,40 @@ TEST(EventCollector, Headers) {
   EXPECT_EQ("bar", e.h["foo"]);
   EXPECT_EQ("meh", e.h["baz"]);
 }
+
+TEST(EventCollector, CompactHeaders) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  static_cast<void>(http_server);
+
+  std::ostringstream os;
+  CompactEventCollectorHTTPServer collector(port,
+                                            os,
+                                            std::chrono::microseconds(0),
+                                            "/compact",
+                                            "!",
+                                            nullptr,
+                                            CompactEventCapture({"X-Foo", "bar", "x_foo", "Cookie", "Missing"}));
+  // The names are sorted and deduplicated case-insensitively, and the cookies are not among them.
+  EXPECT_EQ("bar,Missing,X-Foo", current::strings::Join(collector.Capture().HeaderNames(), ','));
+
+  EXPECT_EQ("!",
+            HTTP(GET(Printf("http://localhost:%d/compact?z=1&a=2", port))
+                     .SetHeader("x-foo", "foo")
+                     .SetHeader("Bar", "bar")
+                     .SetHeader("Baz", "baz"))
+                .body);
+  const auto e = ParseJSON<CompactLogEntry>(os.str());
+  EXPECT_EQ("GET", e.m);
+  ASSERT_EQ(2u, e.q.size());
+  EXPECT_EQ("a", e.q[0].first);
+  EXPECT_EQ("2", e.q[0].second);
+  EXPECT_EQ("z", e.q[1].first);
+  EXPECT_EQ("1", e.q[1].second);
+  ASSERT_EQ(2u, e.h.size());
+  EXPECT_EQ("bar", collector.Capture().HeaderName(e.h[0].first));
+  EXPECT_EQ("bar", e.h[0].second);
+  EXPECT_EQ("X-Foo", collector.Capture().HeaderName(e.h[1].first));
+  EXPECT_EQ("foo", e.h[1].second);
+}
@@ -0,0 +1,65 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2017 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#ifndef EXAMPLES_GRADIENT_BOOSTED_TREES_BIT_PACKED_MATRIX_H
+#define EXAMPLES_GRADIENT_BOOSTED_TREES_BIT_PACKED_MATRIX_H
+
+#include "../../current.h"
+
+// The dense 0/1 matrix, row-major, with each row stored as a contiguous run of 64-bit words within a single buffer.
+// Replaces `std::vector<std::vector<bool>>`: one allocation instead of one per row, and the bit lookup is a shift
+// and a mask on a plain `uint64_t`, with no `std::vector<bool>` proxy references involved.
+class BitPackedMatrix {
+ public:
+  class Row {
+   public:
+    explicit Row(const uint64_t* words) : words_(words) {}
+    bool operator[](size_t i) const { return (words_[i >> 6] >> (i & 63u)) & 1u; }
+
+   private:
+    const uint64_t* words_;
+  };
+
+  BitPackedMatrix(size_t rows, size_t cols)
+      : rows_(rows), cols_(cols), words_per_row_((cols + 63u) >> 6), words_(rows_ * words_per_row_, 0ull) {}
+
+  size_t Rows() const { return rows_; }
+  size_t Cols() const { return cols_; }
+
+  void Set(size_t row, size_t col) {
+    CURRENT_ASSERT(row < rows_);
+    CURRENT_ASSERT(col < cols_);
+    words_[row * words_per_row_ + (col >> 6)] |= (1ull << (col & 63u));
+  }
+
+  Row operator[](size_t row) const { return Row(words_.data() + row * words_per_row_); }
+
+ private:
+  const size_t rows_;
+  const size_t cols_;
+  const size_t words_per_row_;
+  std::vector<uint64_t> words_;
+};
+
+#endif  // EXAMPLES_GRADIENT_BOOSTED_TREES_BIT_PACKED_MATRIX_H
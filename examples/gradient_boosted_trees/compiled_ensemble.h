@@ -0,0 +1,140 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2017 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#ifndef EXAMPLES_GRADIENT_BOOSTED_TREES_COMPILED_ENSEMBLE_H
+#define EXAMPLES_GRADIENT_BOOSTED_TREES_COMPILED_ENSEMBLE_H
+
+#include "schema.h"
+#include "bit_packed_matrix.h"
+
+// The `TreeEnsemble` compiled for evaluation.
+//
+// The nodes of each tree are laid out contiguously, breadth first, as a flat array of `{ feature, child[2] }`.
+// Each leaf points to itself from both its children slots, so that every tree is traversed in exactly as many steps as
+// is its depth, with no branches: `i = nodes[i].child[x[nodes[i].feature]]`.
+//
+// The batch evaluation walks the trees level by level for a block of rows at once, so that the independent lookups
+// of the rows of the block can be pipelined, or vectorized with gathers where the compiler and the CPU support it.
+class CompiledEnsemble {
+ public:
+  constexpr static size_t kBatchBlockSize = 16u;
+
+  struct Node {
+    uint32_t feature;   // For a leaf, zero, as the value of the feature does not matter.
+    uint32_t child[2];  // The "no" and "yes" children, in this order. For a leaf, both are the index of the leaf itself.
+  };
+
+  struct Tree {
+    uint32_t root;
+    uint32_t depth;
+  };
+
+  explicit CompiledEnsemble(const TreeEnsemble& ensemble) {
+    std::vector<size_t> queue;
+    for (TreeIndex tree_index : ensemble.trees) {
+      const size_t root = static_cast<size_t>(tree_index);
+      CURRENT_ASSERT(root < ensemble.nodes.size());
+      // Breadth first: `queue[i]` is the index in `ensemble.nodes` of the `nodes_[offset + i]`, along with its depth.
+      const size_t offset = nodes_.size();
+      std::vector<size_t> depth(1u, 0u);
+      queue.assign(1u, root);
+      for (size_t i = 0u; i < queue.size(); ++i) {
+        const TreeNode& node = ensemble.nodes[queue[i]];
+        const uint32_t self = static_cast<uint32_t>(offset + i);
+        if (node.leaf) {
+          nodes_.push_back(Node{0u, {self, self}});
+          values_.push_back(node.value);
+        } else {
+          CURRENT_ASSERT(node.no < ensemble.nodes.size());
+          CURRENT_ASSERT(node.yes < ensemble.nodes.size());
+          nodes_.push_back(Node{node.feature,
+                                {static_cast<uint32_t>(offset + queue.size()),
+                                 static_cast<uint32_t>(offset + queue.size() + 1u)}});
+          values_.push_back(0.0);
+          queue.push_back(node.no);
+          queue.push_back(node.yes);
+          depth.push_back(depth[i] + 1u);
+          depth.push_back(depth[i] + 1u);
+          features_required_ = std::max(features_required_, static_cast<size_t>(node.feature) + 1u);
+        }
+      }
+      trees_.push_back(Tree{static_cast<uint32_t>(offset), static_cast<uint32_t>(depth.back())});
+    }
+  }
+
+  const std::vector<Node>& Nodes() const { return nodes_; }
+  const std::vector<Tree>& Trees() const { return trees_; }
+
+  // The minimum number of features, `BitPackedMatrix::Cols()`, the input should have.
+  size_t FeaturesRequired() const { return features_required_; }
+
+  // Evaluates the ensemble on a single row.
+  double operator()(BitPackedMatrix::Row x) const {
+    double result = 0.0;
+    for (const Tree& tree : trees_) {
+      uint32_t i = tree.root;
+      for (uint32_t level = 0u; level < tree.depth; ++level) {
+        i = nodes_[i].child[x[nodes_[i].feature]];
+      }
+      result += values_[i];
+    }
+    return result;
+  }
+
+  // Evaluates the ensemble on each row of `x`, which is the [point][feature] -> 0/1 matrix.
+  std::vector<double> Evaluate(const BitPackedMatrix& x) const {
+    CURRENT_ASSERT(x.Cols() >= features_required_);
+    std::vector<double> result(x.Rows(), 0.0);
+    uint32_t i[kBatchBlockSize];
+    double sum[kBatchBlockSize];
+    size_t row = 0u;
+    for (; row + kBatchBlockSize <= x.Rows(); row += kBatchBlockSize) {
+      std::fill(sum, sum + kBatchBlockSize, 0.0);
+      for (const Tree& tree : trees_) {
+        std::fill(i, i + kBatchBlockSize, tree.root);
+        for (uint32_t level = 0u; level < tree.depth; ++level) {
+          for (size_t k = 0u; k < kBatchBlockSize; ++k) {
+            i[k] = nodes_[i[k]].child[x[row + k][nodes_[i[k]].feature]];
+          }
+        }
+        for (size_t k = 0u; k < kBatchBlockSize; ++k) {
+          sum[k] += values_[i[k]];
+        }
+      }
+      std::copy(sum, sum + kBatchBlockSize, result.begin() + row);
+    }
+    for (; row < x.Rows(); ++row) {
+      result[row] = (*this)(x[row]);
+    }
+    return result;
+  }
+
+ private:
+  std::vector<Node> nodes_;
+  std::vector<double> values_;  // Per node, `.size()` == `nodes_.size()`, only meaningful for the leaves.
+  std::vector<Tree> trees_;
+  size_t features_required_ = 0u;
+};
+
+#endif  // EXAMPLES_GRADIENT_BOOSTED_TREES_COMPILED_ENSEMBLE_H
@@ -23,11 +23,14 @@ SOFTWARE.
 *******************************************************************************/
 
 #include "schema.h"
+#include "compiled_ensemble.h"
+#include "fncas_ensemble.h"
 #include "../../bricks/graph/gnuplot.h"
 
 DEFINE_string(ensemble, "ensemble.json", "The name of the model ensemble file.");
 DEFINE_string(input, "test.json", "The name of the file containing the dataset to test the model against.");
 DEFINE_string(chart, ".current/pr.png", "The name of the output plot file.");
+DEFINE_bool(fncas_jit, false, "Set to true to evaluate the ensemble as a FnCAS JIT-compiled function.");
 
 int main(int argc, char** argv) {
   ParseDFlags(&argc, &argv);
@@ -39,30 +42,38 @@ int main(int argc, char** argv) {
   const size_t N = input.labels.size();
   const size_t M = input.GetNumberOfFeatures();
 
-  std::vector<std::vector<bool>> X(N, std::vector<bool>(M));
-  for (size_t point = 0; point < N; ++point) {
-    for (int32_t feature : input.matrix[point]) {
-      X[point][feature] = true;
+  std::vector<double> score;
+  if (!FLAGS_fncas_jit) {
+    const CompiledEnsemble compiled_ensemble(ensemble);
+    BitPackedMatrix X(N, std::max(M, compiled_ensemble.FeaturesRequired()));
+    for (size_t point = 0; point < N; ++point) {
+      for (int32_t feature : input.matrix[point]) {
+        X.Set(point, feature);
+      }
     }
-  }
-
-  std::vector<int64_t> score(N, 0ll);
-  for (size_t point = 0; point < N; ++point) {
-    for (TreeIndex index : ensemble.trees) {
-      size_t i = static_cast<size_t>(index);
-      CURRENT_ASSERT(i < ensemble.nodes.size());
-      while (!ensemble.nodes[i].leaf) {
-        i = X[point][ensemble.nodes[i].feature] ? ensemble.nodes[i].yes : ensemble.nodes[i].no;
-        CURRENT_ASSERT(i != static_cast<uint32_t>(-1));
-        CURRENT_ASSERT(i < ensemble.nodes.size());
+    score = compiled_ensemble.Evaluate(X);
+  } else {
+    const fncas::variables_vector_t x(M);
+    const fncas::function_t<fncas::JIT::Blueprint> blueprint = FnCASEnsembleTerm(ensemble, x);
+    const fncas::function_t<fncas::JIT::Default> compiled_function(blueprint);
+    std::vector<std::vector<double>> X(N, std::vector<double>(M, 0.0));
+    for (size_t point = 0; point < N; ++point) {
+      for (int32_t feature : input.matrix[point]) {
+        X[point][feature] = 1.0;
       }
-      score[point] += ensemble.nodes[i].value;
     }
+#ifdef FNCAS_X64_NATIVE_JIT_ENABLED
+    score = compiled_function.batch(X);
+#else
+    for (const std::vector<double>& point : X) {
+      score.push_back(compiled_function(point));
+    }
+#endif  // FNCAS_X64_NATIVE_JIT_ENABLED
   }
 
   size_t total_points = 0u;
   size_t total_positives = 0u;
-  std::map<int64_t, std::pair<size_t, size_t>, std::greater<int64_t>> sorted;
+  std::map<double, std::pair<size_t, size_t>, std::greater<double>> sorted;
   for (size_t point = 0; point < N; ++point) {
     const auto label = static_cast<bool>(input.labels[point]);
     auto& rhs = sorted[score[point]];
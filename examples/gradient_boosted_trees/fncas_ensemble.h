@@ -0,0 +1,59 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2017 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#ifndef EXAMPLES_GRADIENT_BOOSTED_TREES_FNCAS_ENSEMBLE_H
+#define EXAMPLES_GRADIENT_BOOSTED_TREES_FNCAS_ENSEMBLE_H
+
+#include "schema.h"
+
+#include "../../fncas/fncas/fncas.h"
+
+// The `TreeEnsemble` as a FnCAS expression of `x`, the vector of 0/1 features. With binary features, each split is
+// the exact `x[feature] * yes + (1 - x[feature]) * no`, so the ensemble is a polynomial of its inputs, and, once
+// JIT-compiled into `fncas::function_t<fncas::JIT::Default>`, it is evaluated by straight-line code with no branches
+// and no memory lookups, several rows at once with `.batch()` where the native JIT supports it.
+//
+// The straight-line code computes every node of every tree, so it pays off for shallow trees, and is opt-in.
+// The default way to evaluate an ensemble fast is `CompiledEnsemble`, see `compiled_ensemble.h`.
+inline fncas::term_t FnCASTreeTerm(const TreeEnsemble& ensemble, size_t node_index, const fncas::term_vector_t& x) {
+  CURRENT_ASSERT(node_index < ensemble.nodes.size());
+  const TreeNode& node = ensemble.nodes[node_index];
+  if (node.leaf) {
+    return fncas::term_t(node.value);
+  } else {
+    CURRENT_ASSERT(node.feature < x.size());
+    const fncas::term_t& feature = x[node.feature];
+    return feature * FnCASTreeTerm(ensemble, node.yes, x) + (1.0 - feature) * FnCASTreeTerm(ensemble, node.no, x);
+  }
+}
+
+inline fncas::term_t FnCASEnsembleTerm(const TreeEnsemble& ensemble, const fncas::term_vector_t& x) {
+  fncas::term_t result(0.0);
+  for (TreeIndex tree : ensemble.trees) {
+    result = result + FnCASTreeTerm(ensemble, static_cast<size_t>(tree), x);
+  }
+  return result;
+}
+
+#endif  // EXAMPLES_GRADIENT_BOOSTED_TREES_FNCAS_ENSEMBLE_H
@@ -42,6 +42,7 @@ DEFINE_uint32(tree_depth, 5, "If nonzero, the maximum depth of each tree.");
 DEFINE_double(fraction_of_features_to_use_per_iteration, 0.4, "The fraction of features to use per tree.");
 DEFINE_int32(debug_iterations_frequency, 25, "If nonzero, debug output each N-th iteration.");
 DEFINE_bool(log_trees, false, "Set to true to log each tree in a pseudo-JSON (node.js-friendly) format.");
+DEFINE_uint32(threads, 0, "The number of threads to build the histograms and evaluate splits on, zero for all cores.");
 
 // TODO(dkorolev): Rand seed?
 
@@ -127,11 +128,11 @@ int main(int argc, char** argv) {
   }
 
   std::vector<std::vector<uint32_t>> transposed_adjacency_lists(M);
-  std::vector<std::vector<bool>> dense_transposed_matrix(M, std::vector<bool>(N, false));
+  BitPackedMatrix dense_transposed_matrix(M, N);
   for (size_t i = 0; i < N; ++i) {
     for (uint32_t f : input.matrix[i]) {
       transposed_adjacency_lists[f].push_back(i);
-      dense_transposed_matrix[f][i] = true;
+      dense_transposed_matrix.Set(f, i);
     }
   }
 
@@ -170,7 +171,8 @@ int main(int argc, char** argv) {
                       dense_transposed_matrix,
                       input.weights,
                       input.feature_names,
-                      logging_ostream);
+                      logging_ostream,
+                      static_cast<size_t>(FLAGS_threads));
   const double param_ff = FLAGS_fraction_of_features_to_use_per_iteration;
   CURRENT_ASSERT(param_ff > 0);
   CURRENT_ASSERT(param_ff <= 1);
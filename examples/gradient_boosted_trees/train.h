@@ -37,16 +37,32 @@ SOFTWARE.
 
 #include "schema.h"
 #include "iterable_subset.h"
+#include "bit_packed_matrix.h"
+
+#include "../../fncas/fncas/thread_pool.h"
 
 #define GBT_LARGE_EPSILON 0.001  // For relative improvements in standard deviation, which is computed in doubles.
 
+// Nodes with fewer points, or with fewer features to evaluate, are processed on the calling thread alone.
+#define GBT_MIN_POINTS_TO_PARALLELIZE 10000
+#define GBT_MIN_FEATURES_TO_PARALLELIZE 1000
+
+// The per-feature "histogram" of a tree node: the objective function stats over the points of this node that have
+// this feature set. The features are binary, so the single "1" bin is enough, as the "0" bin is the node total minus
+// it. The histogram of the larger child is computed as the histogram of its parent minus that of the smaller child.
+struct HistogramBin {
+  int64_t sum_p1 = 0;
+  int64_t sum_p2 = 0;
+  uint64_t n = 0;
+};
+
 class TreeBuilder {
  private:
   // Immutable members: The data to operate upon.
   const size_t n_;                                 // The total number of training examples (not all may be in use).
   const size_t m_;                                 // The total number of features (not all may be in use).
   const std::vector<std::vector<uint32_t>>& g_;    // The features-to-points adjacency lists, `.size()` == m_.
-  const std::vector<std::vector<bool>>& matrix_;   // The dense representation of the [feature][points] -> 0/1 matrix.
+  const BitPackedMatrix& matrix_;                  // The dense representation of the [feature][points] -> 0/1 matrix.
   const Optional<std::vector<double>>& weights_;   // If provided, per-point weights.
   std::ostream* dump_ostream_ = nullptr;           // If set, the node.js-compliant JSON with the tree will be dumped.
 
@@ -60,6 +76,18 @@ class TreeBuilder {
   size_t* features_to_consider_begin_;
   size_t* features_to_consider_end_;
 
+  // The points-to-features adjacency lists, in the CSR form: point `i` has features
+  // `row_features_[row_begin_[i]] ... row_features_[row_begin_[i + 1] - 1]`, sorted.
+  std::vector<size_t> row_begin_;
+  std::vector<uint32_t> row_features_;
+
+  // The per-node histograms, each of `.size()` == m_, two per depth level: the node at depth `d` which is the "yes"
+  // child of its parent uses the slot `2 * d`, and the "no" one uses `2 * d + 1`. The root uses slot zero.
+  std::vector<std::vector<HistogramBin>> histograms_;
+
+  // The histograms are built and the splits are evaluated in shards, one contiguous range of features per thread.
+  fncas::impl::thread_pool thread_pool_;
+
   // Output members: The tree(s) being built. The trees are stored in a single array of nodes or leaves.
   TreeEnsemble ensemble_;
 
@@ -83,10 +111,11 @@ class TreeBuilder {
  public:
   TreeBuilder(size_t n,
               const std::vector<std::vector<uint32_t>>& transposed_matrix_adjacency_lists,
-              const std::vector<std::vector<bool>>& transposed_matrix,
+              const BitPackedMatrix& transposed_matrix,
               const Optional<std::vector<double>> weights,
               const Optional<std::vector<std::string>>& feature_names,
-              std::ostream* dump_ostream = nullptr)
+              std::ostream* dump_ostream = nullptr,
+              size_t threads = 0u)
       : n_(n),
         m_(transposed_matrix_adjacency_lists.size()),
         g_(transposed_matrix_adjacency_lists),
@@ -94,15 +123,30 @@ class TreeBuilder {
         weights_(weights),
         dump_ostream_(dump_ostream),
         feature_names_(feature_names),
-        points_to_consider_(n_) {
+        points_to_consider_(n_),
+        thread_pool_(threads) {
+    CURRENT_ASSERT(matrix_.Rows() == m_);
+    CURRENT_ASSERT(matrix_.Cols() == n_);
+    row_begin_.assign(n_ + 1u, 0u);
     for (const auto& col : g_) {
       for (uint32_t point_index : col) {
         CURRENT_ASSERT(point_index < static_cast<uint32_t>(n_));
+        ++row_begin_[point_index + 1u];
       }
       for (size_t i = 1; i < col.size(); ++i) {
         CURRENT_ASSERT(col[i] > col[i - 1]);  // The transposed matrix's adjacency lists should be sorted.
       }
     }
+    for (size_t i = 0; i < n_; ++i) {
+      row_begin_[i + 1u] += row_begin_[i];
+    }
+    row_features_.resize(row_begin_[n_]);
+    std::vector<size_t> row_end(row_begin_.begin(), row_begin_.end() - 1);
+    for (size_t feature = 0; feature < m_; ++feature) {
+      for (uint32_t point_index : g_[feature]) {
+        row_features_[row_end[point_index]++] = static_cast<uint32_t>(feature);
+      }
+    }
   }
 
   TreeIndex BuildTree(const std::vector<int64_t>& goal,
@@ -135,7 +179,9 @@ class TreeBuilder {
     if (dump_ostream_) {
       *dump_ostream_ << "console.log(JSON.stringify({\n";
     }
-    const TreeIndex result = BuildTreeRecursively(0u);
+    EnsureHistogramSlots(0u);
+    BuildHistogram(0u, [](size_t) { return true; });
+    const TreeIndex result = BuildTreeRecursively(0u, 0u);
     ensemble_.trees.push_back(result);
     if (dump_ostream_) {
       *dump_ostream_ << "}, null, 1));" << std::endl;
@@ -160,7 +206,64 @@ class TreeBuilder {
   }
 
  private:
-  TreeIndex BuildTreeRecursively(size_t depth) {
+  void EnsureHistogramSlots(size_t depth) {
+    while (histograms_.size() < 2u * (depth + 1u)) {
+      histograms_.emplace_back(m_);
+    }
+  }
+
+  // Calls `f(shard, shards)` for each shard on the thread pool if `parallel` is set, or just `f(0, 1)` otherwise.
+  template <typename F>
+  void RunSharded(bool parallel, F&& f) {
+    const size_t shards = parallel ? thread_pool_.threads_count() : 1u;
+    if (shards > 1u) {
+      thread_pool_.for_each(shards, [&](size_t shard) { f(shard, shards); });
+    } else {
+      f(0u, 1u);
+    }
+  }
+
+  // Builds the histogram in `slot` over the points under consideration for which `take_point(point)` is true.
+  // If `parent_slot` is set, also stores the `parent_slot` histogram minus the one just built into `complement_slot`.
+  template <typename PREDICATE>
+  void BuildHistogram(size_t slot,
+                      PREDICATE&& take_point,
+                      size_t parent_slot = static_cast<size_t>(-1),
+                      size_t complement_slot = static_cast<size_t>(-1)) {
+    std::vector<HistogramBin>& histogram = histograms_[slot];
+    RunSharded(points_to_consider_.size() >= GBT_MIN_POINTS_TO_PARALLELIZE, [&](size_t shard, size_t shards) {
+      // Each shard owns its own contiguous range of features, so the shards never write into the same bins.
+      const uint32_t lo = static_cast<uint32_t>(m_ * shard / shards);
+      const uint32_t hi = static_cast<uint32_t>(m_ * (shard + 1u) / shards);
+      std::fill(histogram.begin() + lo, histogram.begin() + hi, HistogramBin());
+      for (size_t point : points_to_consider_) {
+        if (take_point(point)) {
+          const uint32_t* const row = row_features_.data();
+          const uint32_t* const row_end = row + row_begin_[point + 1u];
+          const int64_t y = (*py_)[point];
+          for (const uint32_t* it = std::lower_bound(row + row_begin_[point], row_end, lo);
+               it != row_end && *it < hi;
+               ++it) {
+            HistogramBin& bin = histogram[*it];
+            bin.sum_p1 += y;
+            bin.sum_p2 += y * y;
+            ++bin.n;
+          }
+        }
+      }
+      if (parent_slot != static_cast<size_t>(-1)) {
+        const std::vector<HistogramBin>& parent = histograms_[parent_slot];
+        std::vector<HistogramBin>& complement = histograms_[complement_slot];
+        for (uint32_t feature = lo; feature < hi; ++feature) {
+          complement[feature].sum_p1 = parent[feature].sum_p1 - histogram[feature].sum_p1;
+          complement[feature].sum_p2 = parent[feature].sum_p2 - histogram[feature].sum_p2;
+          complement[feature].n = parent[feature].n - histogram[feature].n;
+        }
+      }
+    });
+  }
+
+  TreeIndex BuildTreeRecursively(size_t depth, size_t histogram_slot) {
     static const size_t indent_max_spaces = 1000u * 100u;
     static const std::string indent_placeholder(indent_max_spaces, ' ');
     const size_t indent_size = ((depth + 1) * 2);
@@ -212,7 +315,7 @@ class TreeBuilder {
         int64_t p2 = 0;
         for (size_t point = 0; point < n_; ++point) {
           if (points_to_consider_[point]) {
-            const int64_t y = y_[point];
+            const int64_t y = (*py_)[point];
             p1 += y;
             p2 += y * y;
           }
@@ -224,7 +327,7 @@ class TreeBuilder {
         double mean = 1.0 * sum_p1 / total_weight;
         for (size_t point = 0; point < n_; ++point) {
           if (points_to_consider_[point]) {
-            const double d = y_[point] - mean;
+            const double d = (*py_)[point] - mean;
             slowly_computed_penalty += d * d;
           }
         }
@@ -234,78 +337,101 @@ class TreeBuilder {
 
       // Find the best features to split the tree by.
       // The best feature is the one that minimizes the sum of penalties in the left and right subtrees.
-      std::pair<double, size_t*> best_candidate(1.0 - GBT_LARGE_EPSILON, nullptr);
-      for (size_t* feature_it = features_to_consider_begin_; feature_it != features_to_consider_end_; ++feature_it) {
-        const size_t feature = *feature_it;
-        int64_t candidate_lhs_sum_p1 = 0;
-        int64_t candidate_lhs_sum_p2 = 0;
-        uint64_t candidate_lhs_n = 0;
-        for (const int32_t point : g_[feature]) {
-          if (points_to_consider_[point]) {
-            const int64_t y = (*py_)[point];
-            candidate_lhs_sum_p1 += y;
-            candidate_lhs_sum_p2 += y * y;
-            ++candidate_lhs_n;
-          }
-        }
-        GBT_EXTRA_CHECK(CURRENT_ASSERT(candidate_lhs_n <= n_points));
-        if (candidate_lhs_n > 0 && candidate_lhs_n < n_points) {
-          // TODO(dkorolev): Better check by weight here; maybe even have weights as integers too, and carry them down.
-          const int64_t candidate_rhs_sum_p1 = sum_p1 - candidate_lhs_sum_p1;
-          const int64_t candidate_rhs_sum_p2 = sum_p2 - candidate_lhs_sum_p2;
-          const uint64_t candidate_rhs_n = n_points - candidate_lhs_n;
-
-          const double candidate_penalty =
-              (candidate_lhs_sum_p2 - candidate_lhs_sum_p1 * candidate_lhs_sum_p1 * (1.0 / candidate_lhs_n)) +
-              (candidate_rhs_sum_p2 - candidate_rhs_sum_p1 * candidate_rhs_sum_p1 * (1.0 / candidate_rhs_n));
-
-          const double ratio = candidate_penalty / baseline_penalty;
+      // The nodes at the maximum depth are not split, so their histograms are not built, and not evaluated.
+      const std::vector<HistogramBin>& histogram = histograms_[histogram_slot];
+      const size_t features_count = static_cast<size_t>(features_to_consider_end_ - features_to_consider_begin_);
+      std::vector<std::pair<double, size_t*>> best_candidate_per_shard(thread_pool_.threads_count(),
+                                                                       std::make_pair(1.0, nullptr));
+      const bool parallel = depth < max_depth_ && features_count >= GBT_MIN_FEATURES_TO_PARALLELIZE;
+      RunSharded(parallel, [&](size_t shard, size_t shards) {
+        std::pair<double, size_t*> best_candidate(1.0 - GBT_LARGE_EPSILON, nullptr);
+        size_t* const shard_begin = features_to_consider_begin_ + features_count * shard / shards;
+        size_t* const shard_end = features_to_consider_begin_ + features_count * (shard + 1u) / shards;
+        for (size_t* feature_it = shard_begin; depth < max_depth_ && feature_it != shard_end; ++feature_it) {
+          const size_t feature = *feature_it;
+          const int64_t candidate_lhs_sum_p1 = histogram[feature].sum_p1;
+          const int64_t candidate_lhs_sum_p2 = histogram[feature].sum_p2;
+          const uint64_t candidate_lhs_n = histogram[feature].n;
           GBT_EXTRA_CHECK({
-            int64_t lhs_p1 = 0;
-            int64_t lhs_p2 = 0;
-            int64_t rhs_p1 = 0;
-            int64_t rhs_p2 = 0;
-            for (size_t point = 0; point < n_; ++point) {
+            int64_t p1 = 0;
+            int64_t p2 = 0;
+            uint64_t n = 0;
+            for (const int32_t point : g_[feature]) {
               if (points_to_consider_[point]) {
-                CURRENT_ASSERT(std::binary_search(g_[feature].begin(), g_[feature].end(), point) ==
-                               matrix_[feature][point]);
-                const int64_t y = y_[point];
-                if (matrix_[feature][point]) {
-                  lhs_p1 += y;
-                  lhs_p2 += y * y;
-                } else {
-                  rhs_p1 += y;
-                  rhs_p2 += y * y;
-                }
+                const int64_t y = (*py_)[point];
+                p1 += y;
+                p2 += y * y;
+                ++n;
               }
             }
-            CURRENT_ASSERT(lhs_p1 + rhs_p1 == sum_p1);
-            CURRENT_ASSERT(lhs_p2 + rhs_p2 == sum_p2);
+            CURRENT_ASSERT(p1 == candidate_lhs_sum_p1);
+            CURRENT_ASSERT(p2 == candidate_lhs_sum_p2);
+            CURRENT_ASSERT(n == candidate_lhs_n);
+          });
+          GBT_EXTRA_CHECK(CURRENT_ASSERT(candidate_lhs_n <= n_points));
+          if (candidate_lhs_n > 0 && candidate_lhs_n < n_points) {
+            // TODO(dkorolev): Better check by weight here; maybe even have weights as integers too,
+            //                and carry them down.
+            const int64_t candidate_rhs_sum_p1 = sum_p1 - candidate_lhs_sum_p1;
+            const int64_t candidate_rhs_sum_p2 = sum_p2 - candidate_lhs_sum_p2;
+            const uint64_t candidate_rhs_n = n_points - candidate_lhs_n;
+
+            const double candidate_penalty =
+                (candidate_lhs_sum_p2 - candidate_lhs_sum_p1 * candidate_lhs_sum_p1 * (1.0 / candidate_lhs_n)) +
+                (candidate_rhs_sum_p2 - candidate_rhs_sum_p1 * candidate_rhs_sum_p1 * (1.0 / candidate_rhs_n));
+
+            const double ratio = candidate_penalty / baseline_penalty;
+            GBT_EXTRA_CHECK({
+              int64_t lhs_p1 = 0;
+              int64_t lhs_p2 = 0;
+              int64_t rhs_p1 = 0;
+              int64_t rhs_p2 = 0;
+              for (size_t point = 0; point < n_; ++point) {
+                if (points_to_consider_[point]) {
+                  CURRENT_ASSERT(std::binary_search(g_[feature].begin(), g_[feature].end(), point) ==
+                                 matrix_[feature][point]);
+                  const int64_t y = (*py_)[point];
+                  if (matrix_[feature][point]) {
+                    lhs_p1 += y;
+                    lhs_p2 += y * y;
+                  } else {
+                    rhs_p1 += y;
+                    rhs_p2 += y * y;
+                  }
+                }
+              }
+              CURRENT_ASSERT(lhs_p1 + rhs_p1 == sum_p1);
+              CURRENT_ASSERT(lhs_p2 + rhs_p2 == sum_p2);
 
-            CURRENT_ASSERT(lhs_p1 == candidate_lhs_sum_p1);
-            CURRENT_ASSERT(lhs_p2 == candidate_lhs_sum_p2);
+              CURRENT_ASSERT(lhs_p1 == candidate_lhs_sum_p1);
+              CURRENT_ASSERT(lhs_p2 == candidate_lhs_sum_p2);
 
-            CURRENT_ASSERT(rhs_p1 == candidate_rhs_sum_p1);
-            CURRENT_ASSERT(rhs_p2 == candidate_rhs_sum_p2);
-          });
+              CURRENT_ASSERT(rhs_p1 == candidate_rhs_sum_p1);
+              CURRENT_ASSERT(rhs_p2 == candidate_rhs_sum_p2);
+            });
 
 #define GBT_DEBUG_DUMP(x) std::cerr << __LINE__ << ' ' << #x << " = " << x << std::endl  // Only used in debug mode.
-          // Total penalty should be the same or better than the baseline, but keep machine precision in mind.
-          GBT_EXTRA_CHECK(if (!(ratio < 1.0 + GBT_LARGE_EPSILON)) {
-            std::cerr << ratio << std::endl;
-            std::cerr << baseline_penalty << ' ' << candidate_penalty << std::endl;
-            GBT_DEBUG_DUMP(candidate_lhs_sum_p2);
-            GBT_DEBUG_DUMP(candidate_lhs_sum_p1 * candidate_lhs_sum_p1);
-            GBT_DEBUG_DUMP(candidate_lhs_n);
-            GBT_DEBUG_DUMP(candidate_rhs_sum_p2);
-            GBT_DEBUG_DUMP(candidate_rhs_sum_p1 * candidate_rhs_sum_p1);
-            GBT_DEBUG_DUMP(candidate_rhs_n);
-          });
+            // Total penalty should be the same or better than the baseline, but keep machine precision in mind.
+            GBT_EXTRA_CHECK(if (!(ratio < 1.0 + GBT_LARGE_EPSILON)) {
+              std::cerr << ratio << std::endl;
+              std::cerr << baseline_penalty << ' ' << candidate_penalty << std::endl;
+              GBT_DEBUG_DUMP(candidate_lhs_sum_p2);
+              GBT_DEBUG_DUMP(candidate_lhs_sum_p1 * candidate_lhs_sum_p1);
+              GBT_DEBUG_DUMP(candidate_lhs_n);
+              GBT_DEBUG_DUMP(candidate_rhs_sum_p2);
+              GBT_DEBUG_DUMP(candidate_rhs_sum_p1 * candidate_rhs_sum_p1);
+              GBT_DEBUG_DUMP(candidate_rhs_n);
+            });
 #undef GBT_DEBUG_DUMP
-          CURRENT_ASSERT(ratio < 1.0 + GBT_LARGE_EPSILON);
-          best_candidate = std::min(best_candidate, std::make_pair(ratio, feature_it));
+            CURRENT_ASSERT(ratio < 1.0 + GBT_LARGE_EPSILON);
+            best_candidate = std::min(best_candidate, std::make_pair(ratio, feature_it));
+          }
         }
-      }
+        best_candidate_per_shard[shard] = best_candidate;
+      });
+      // Ties are broken by the position in `features_to_consider_`, as they would be by a single-threaded scan.
+      const std::pair<double, size_t*> best_candidate =
+          *std::min_element(best_candidate_per_shard.begin(), best_candidate_per_shard.end());
 
       if (best_candidate.second && depth < max_depth_) {
         size_t pivot_feature = *best_candidate.second;
@@ -318,9 +444,21 @@ class TreeBuilder {
         }
         std::swap(*best_candidate.second, *features_to_consider_begin_);
         ++features_to_consider_begin_;
-        const std::vector<bool>& matrix_row = matrix_[pivot_feature];
+        const BitPackedMatrix::Row matrix_row = matrix_[pivot_feature];
         ensemble_.nodes[node_index].leaf = false;
         ensemble_.nodes[node_index].feature = static_cast<uint64_t>(pivot_feature);
+        // Build the histogram of the smaller child directly, and derive the one of the larger child by subtraction.
+        // No need to build either when the children are leaves by depth.
+        const size_t yes_slot = 2u * (depth + 1u);
+        const size_t no_slot = yes_slot + 1u;
+        if (depth + 1u < max_depth_) {
+          const bool yes_is_smaller = histogram[pivot_feature].n * 2u <= n_points;
+          EnsureHistogramSlots(depth + 1u);  // NOTE: Invalidates `histogram`, which is not used past this point.
+          BuildHistogram(yes_is_smaller ? yes_slot : no_slot,
+                         [&](size_t point) { return matrix_row[point] == yes_is_smaller; },
+                         histogram_slot,
+                         yes_is_smaller ? no_slot : yes_slot);
+        }
         points_to_consider_.Partition(
             [&](size_t point) {
               GBT_EXTRA_CHECK(CURRENT_ASSERT(std::binary_search(g_[pivot_feature].begin(),
@@ -330,12 +468,12 @@ class TreeBuilder {
               //       Which means the code can support huge inputs as long as they are sparse. -- D.K.
               return matrix_row[point];
             },
-            [&]() { ensemble_.nodes[node_index].yes = static_cast<size_t>(BuildTreeRecursively(depth + 1)); },
+            [&]() { ensemble_.nodes[node_index].yes = static_cast<size_t>(BuildTreeRecursively(depth + 1, yes_slot)); },
             [&]() {
               if (dump_ostream_) {
                 *dump_ostream_ << indent << "}, no: {\n";
               }
-              ensemble_.nodes[node_index].no = static_cast<size_t>(BuildTreeRecursively(depth + 1));
+              ensemble_.nodes[node_index].no = static_cast<size_t>(BuildTreeRecursively(depth + 1, no_slot));
               if (dump_ostream_) {
                 *dump_ostream_ << indent << "} },\n";
               }
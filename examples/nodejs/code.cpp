@@ -4,6 +4,13 @@
 // so that the node-based build and test, which can be run with just `make` from this directory, does the job.
 #include "javascript.hpp"
 
+// The C++ object exposed to JavaScript with no copying, see `cppReturnsLazyObject`.
+struct LazyObjectExample final {
+  int id;
+  std::string name;
+  std::vector<int> values;
+};
+
 Napi::Object Init(Napi::Env env, Napi::Object unwrapped_exports) {
   using namespace current::javascript;
 
@@ -137,6 +144,46 @@ Napi::Object Init(Napi::Env env, Napi::Object unwrapped_exports) {
     }
   };
 
+  // The C++-owned bytes are handed over to JavaScript as they are, with no copying.
+  exports["cppReturnsBuffer"] = [](std::string s) { return JSBuffer("{\"s\":\"" + s + "\"}"); };
+  exports["cppReturnsBytes"] = [](int n) {
+    std::vector<uint8_t> bytes;
+    for (int i = 0; i < n; ++i) {
+      bytes.push_back(static_cast<uint8_t>(i));
+    }
+    return bytes;
+  };
+
+  // And the bytes from JavaScript are read by C++ where they are, again with no copying.
+  exports["cppSumsBytes"] = [](JSBufferView bytes) {
+    int sum = 0;
+    for (uint8_t c : bytes) {
+      sum += c;
+    }
+    return sum;
+  };
+
+  // The fields of the C++ object are only converted as JavaScript reads them.
+  exports["cppReturnsLazyObject"] = [](int id) {
+    auto object = std::make_shared<LazyObjectExample>();
+    object->id = id;
+    object->name = "Object " + std::to_string(id);
+    object->values = {1, 2, 3};
+    return JSLazyObject<LazyObjectExample>(object)
+        .Field("id", &LazyObjectExample::id)
+        .Field("name", &LazyObjectExample::name)
+        .Field("values", &LazyObjectExample::values)
+        .Add("total", [](const LazyObjectExample& o) { return o.values[0] + o.values[1] + o.values[2]; });
+  };
+
+  // A batch of values crosses the C++ <=> JavaScript boundary with a single call.
+  exports["cppSquaresBatch"] = [](std::vector<int> batch) {
+    for (int& x : batch) {
+      x *= x;
+    }
+    return batch;
+  };
+
   // A "native" lambda can be "returned", and the magic behind the scenes will work its way.
   exports["cppWrapsFunction"] = [](int x, JSFunctionReturning<std::string> f) {
     // This test case exposes a function, but only to be called within the call scope of the outer function.
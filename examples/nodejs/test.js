@@ -103,6 +103,35 @@ test('cppReturnsAny', () => {
   expect(lib.cppReturnsAny('')).toEqual(null);
 });
 
+test('cppReturnsBuffer', () => {
+  const buffer = lib.cppReturnsBuffer('foo');
+  expect(buffer instanceof Uint8Array).toEqual(true);
+  expect(JSON.parse(Buffer.from(buffer).toString())).toEqual({s: 'foo'});
+  expect(Array.from(lib.cppReturnsBytes(5))).toEqual([0, 1, 2, 3, 4]);
+  expect(lib.cppReturnsBytes(0).length).toEqual(0);
+});
+
+test('cppSumsBytes', () => {
+  expect(lib.cppSumsBytes(new Uint8Array([1, 2, 3]))).toEqual(6);
+  expect(lib.cppSumsBytes(Buffer.from('ab'))).toEqual(97 + 98);
+  expect(lib.cppSumsBytes(new Uint8Array([0, 10, 20, 30]).subarray(1, 3))).toEqual(30);
+  expect(lib.cppSumsBytes(new ArrayBuffer(4))).toEqual(0);
+  expect(() => lib.cppSumsBytes('not bytes')).toThrow();
+});
+
+test('cppReturnsLazyObject', () => {
+  const o = lib.cppReturnsLazyObject(42);
+  expect(Object.keys(o)).toEqual(['id', 'name', 'values', 'total']);
+  expect(o.name).toEqual('Object 42');
+  expect(o.name).toEqual('Object 42');
+  expect(o).toEqual({id: 42, name: 'Object 42', values: [1, 2, 3], total: 6});
+});
+
+test('cppSquaresBatch', () => {
+  expect(lib.cppSquaresBatch([1, 2, 3])).toEqual([1, 4, 9]);
+  expect(lib.cppSquaresBatch([])).toEqual([]);
+});
+
 test('cppWrapsFunction', () => {
   expect(lib.cppWrapsFunction(1, (f) => { return f(2); })).toEqual('Outer 1, inner 2.');
   expect(lib.cppWrapsFunction(100, (f) => { return f(42); })).toEqual('Outer 100, inner 42.');
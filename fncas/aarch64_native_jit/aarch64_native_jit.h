@@ -0,0 +1,297 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2023 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// The AArch64 counterpart of `x64_native_jit/x64_native_jit.h`, with the same calling convention, see `JIT.md`.
+//
+// Each AArch64 instruction is a single little-endian 32-bit word, so, unlike on x64, the code is a vector of
+// `uint32_t`-s, and there is no need to shift the input and output arrays to even up the opcode lengths.
+//
+// The opcodes are plain functions of their operands, available on every platform, so that the code generator
+// can be tested on x64 too. Only `CallableVectorUInt32`, which runs the code, requires an AArch64 CPU.
+
+#ifndef FNCAS_AARCH64_NATIVE_JIT_AARCH64_NATIVE_JIT_H
+#define FNCAS_AARCH64_NATIVE_JIT_AARCH64_NATIVE_JIT_H
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#if defined(__aarch64__) && (defined(__linux__) || defined(__APPLE__))
+
+#define FNCAS_AARCH64_NATIVE_JIT_ENABLED
+
+#include <sys/mman.h>
+
+#ifdef __APPLE__
+#include <libkern/OSCacheControl.h>
+#include <pthread.h>
+#endif
+
+#endif  // defined(__aarch64__) && (defined(__linux__) || defined(__APPLE__))
+
+#ifndef NDEBUG
+#define AARCH64_JIT_ASSERT(x) assert(x)
+#else
+#define AARCH64_JIT_ASSERT(x)
+#endif
+
+static_assert(sizeof(double) == 8, "FnCAS AArch64 native JIT compiler requires `double` to be 8 bytes.");
+
+namespace current {
+namespace fncas {
+namespace aarch64_native_jit {
+
+// The signature is the same as `x64_native_jit::pf_t`:
+// * Returns a `double`:              The value of the function, in `d0`.
+// * Uses the `double const* x`:      Input, the parameters vector `x[i]`, passed in `x0`, kept in `x20`.
+// * Uses the `double* o`:            Output, then the temporary memory buffer, passed in `x1`, kept in `x19`.
+// * Uses the `double (*f[])(double): External functions, passed in `x2`, kept in `x21`.
+typedef double (*pf_t)(double const* x, double* o, double (*f[])(double));
+
+constexpr static size_t const kAArch64NativeJITExecutablePageSize = 4096;
+
+// The `d0` .. `d31` registers are the low halves of the NEON `v0` .. `v31` ones.
+constexpr static uint8_t const kAArch64NativeJITNumberOfDRegisters = 32;
+
+// The `d31` register is reserved as the scratch one, for the operands loaded from memory.
+constexpr static uint8_t const kAArch64NativeJITScratchDRegister = 31;
+
+// The `ldr` and `str` opcodes take up to a 12-bit unsigned offset, in doubles. Larger ones go via `x9`.
+constexpr static size_t const kAArch64NativeJITMaxImmediateOffset = 4095;
+
+#ifdef FNCAS_AARCH64_NATIVE_JIT_ENABLED
+
+struct CallableVectorUInt32 final {
+  size_t const allocated_size_;
+  void* buffer_ = nullptr;
+
+  explicit CallableVectorUInt32(std::vector<uint32_t> const& data)
+      : allocated_size_(kAArch64NativeJITExecutablePageSize *
+                        ((data.size() * sizeof(uint32_t) + kAArch64NativeJITExecutablePageSize - 1) /
+                         kAArch64NativeJITExecutablePageSize)) {
+#ifdef __APPLE__
+    // Apple Silicon only allows the `MAP_JIT` pages to be executable, and they are writable per thread, on demand.
+    buffer_ = ::mmap(
+        NULL, allocated_size_, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANON | MAP_JIT, -1, 0);
+    if (buffer_ == MAP_FAILED) {
+      std::cerr << "`mmap()` failed.\n";
+      std::exit(-1);
+    }
+    ::pthread_jit_write_protect_np(0);
+    ::memcpy(buffer_, &data[0], data.size() * sizeof(uint32_t));
+    ::pthread_jit_write_protect_np(1);
+    ::sys_icache_invalidate(buffer_, data.size() * sizeof(uint32_t));
+#else
+    buffer_ = ::mmap(NULL, allocated_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (buffer_ == MAP_FAILED) {
+      std::cerr << "`mmap()` failed.\n";
+      std::exit(-1);
+    }
+    ::memcpy(buffer_, &data[0], data.size() * sizeof(uint32_t));
+    if (::mprotect(buffer_, allocated_size_, PROT_READ | PROT_EXEC)) {
+      std::cerr << "`mprotect()` failed.\n";
+      std::exit(-1);
+    }
+    // The instruction cache is not coherent with the data one on AArch64.
+    char* const begin = static_cast<char*>(buffer_);
+    __builtin___clear_cache(begin, begin + data.size() * sizeof(uint32_t));
+#endif
+  }
+
+  CallableVectorUInt32(CallableVectorUInt32 const&) = delete;
+  CallableVectorUInt32(CallableVectorUInt32&) = delete;
+  CallableVectorUInt32(CallableVectorUInt32&&) = delete;
+  CallableVectorUInt32& operator=(CallableVectorUInt32 const&) = delete;
+  CallableVectorUInt32& operator=(CallableVectorUInt32&) = delete;
+  CallableVectorUInt32& operator=(CallableVectorUInt32&&) = delete;
+
+  double operator()(double const* x, double* o, double (*f[])(double)) const {
+    return reinterpret_cast<pf_t>(buffer_)(x, o, f);
+  }
+
+  ~CallableVectorUInt32() {
+    if (buffer_ && buffer_ != MAP_FAILED) {
+      ::munmap(buffer_, allocated_size_);
+    }
+  }
+};
+
+#endif  // FNCAS_AARCH64_NATIVE_JIT_ENABLED
+
+namespace opcodes {
+
+// The general purpose registers used by the generated code.
+constexpr static uint8_t const kX = 20;        // `x20`, the input array, callee-saved.
+constexpr static uint8_t const kO = 19;        // `x19`, the output array, callee-saved.
+constexpr static uint8_t const kF = 21;        // `x21`, the external functions array, callee-saved.
+constexpr static uint8_t const kScratch = 9;   // `x9`, the scratch register for large offsets and call targets.
+constexpr static uint8_t const kFP = 29;       // `x29`, the frame pointer.
+constexpr static uint8_t const kLR = 30;       // `x30`, the link register.
+constexpr static uint8_t const kSPorXZR = 31;  // `sp` or `xzr`, depending on the instruction.
+
+template <typename C>
+void internal_emit(C& c, uint32_t instruction) {
+  c.push_back(instruction);
+}
+
+// `stp x29, x30, [sp, #-48]!`, `mov x29, sp`, `stp x19, x20, [sp, #16]`, `str x21, [sp, #32]`,
+// and then `mov x20, x0`, `mov x19, x1`, `mov x21, x2`.
+template <typename C>
+void prologue(C& c) {
+  internal_emit(c, 0xa9800000 | ((-6 & 0x7f) << 15) | (kLR << 10) | (kSPorXZR << 5) | kFP);
+  internal_emit(c, 0x91000000 | (kSPorXZR << 5) | kFP);
+  internal_emit(c, 0xa9000000 | (2 << 15) | (kX << 10) | (kSPorXZR << 5) | kO);
+  internal_emit(c, 0xf9000000 | (4 << 10) | (kSPorXZR << 5) | kF);
+  internal_emit(c, 0xaa0003e0 | (0 << 16) | kX);
+  internal_emit(c, 0xaa0003e0 | (1 << 16) | kO);
+  internal_emit(c, 0xaa0003e0 | (2 << 16) | kF);
+}
+
+// `ldr x21, [sp, #32]`, `ldp x19, x20, [sp, #16]`, `ldp x29, x30, [sp], #48`, `ret`.
+template <typename C>
+void epilogue_and_ret(C& c) {
+  internal_emit(c, 0xf9400000 | (4 << 10) | (kSPorXZR << 5) | kF);
+  internal_emit(c, 0xa9400000 | (2 << 15) | (kX << 10) | (kSPorXZR << 5) | kO);
+  internal_emit(c, 0xa8c00000 | (6 << 15) | (kLR << 10) | (kSPorXZR << 5) | kFP);
+  internal_emit(c, 0xd65f03c0);
+}
+
+// `movz` and up to three `movk`-s of the 64-bit value into the general purpose register `x`.
+template <typename C>
+void load_immediate_to_x(C& c, uint8_t x, uint64_t v) {
+  AARCH64_JIT_ASSERT(x < 31);
+  internal_emit(c, 0xd2800000 | static_cast<uint32_t>((v & 0xffff) << 5) | x);
+  for (uint32_t hw = 1; hw < 4; ++hw) {
+    uint32_t const imm16 = static_cast<uint32_t>((v >> (hw * 16)) & 0xffff);
+    if (imm16) {
+      internal_emit(c, 0xf2800000 | (hw << 21) | (imm16 << 5) | x);
+    }
+  }
+}
+
+// `ldr` or `str` of `d` from/to `[base, #offset * 8]`, or `[base, x9, lsl #3]` if the offset does not fit.
+// The `immediate_opcode` and `register_opcode` are the respective 64-bit FP/SIMD forms of the instruction.
+template <typename C, typename O>
+void internal_d_memory_by_offset(
+    C& c, uint32_t immediate_opcode, uint32_t register_opcode, uint8_t d, uint8_t base, O offset) {
+  AARCH64_JIT_ASSERT(d < kAArch64NativeJITNumberOfDRegisters);
+  AARCH64_JIT_ASSERT(static_cast<int64_t>(offset) >= 0);
+  uint64_t const o = static_cast<uint64_t>(offset);
+  if (o <= kAArch64NativeJITMaxImmediateOffset) {
+    internal_emit(c, immediate_opcode | static_cast<uint32_t>(o << 10) | (base << 5) | d);
+  } else {
+    load_immediate_to_x(c, kScratch, o);
+    internal_emit(c, register_opcode | (kScratch << 16) | (base << 5) | d);
+  }
+}
+
+template <typename C, typename O>
+void load_from_memory_by_x20_offset_to_d(C& c, uint8_t d, O offset) {
+  internal_d_memory_by_offset(c, 0xfd400000, 0xfc607800, d, kX, offset);
+}
+
+template <typename C, typename O>
+void load_from_memory_by_x19_offset_to_d(C& c, uint8_t d, O offset) {
+  internal_d_memory_by_offset(c, 0xfd400000, 0xfc607800, d, kO, offset);
+}
+
+template <typename C, typename O>
+void store_d_to_memory_by_x19_offset(C& c, uint8_t d, O offset) {
+  internal_d_memory_by_offset(c, 0xfd000000, 0xfc207800, d, kO, offset);
+}
+
+// `fmov d, x9` after loading the bits of `v` into `x9`, or `fmov d, xzr` for the positive zero.
+template <typename C>
+void load_immediate_to_d(C& c, uint8_t d, double v) {
+  AARCH64_JIT_ASSERT(d < kAArch64NativeJITNumberOfDRegisters);
+  uint64_t x;
+  ::memcpy(&x, &v, sizeof(x));
+  if (!x) {
+    internal_emit(c, 0x9e670000 | (kSPorXZR << 5) | d);
+  } else {
+    load_immediate_to_x(c, kScratch, x);
+    internal_emit(c, 0x9e670000 | (kScratch << 5) | d);
+  }
+}
+
+template <typename C>
+void mov_d_to_d(C& c, uint8_t dst, uint8_t src) {
+  AARCH64_JIT_ASSERT(dst < kAArch64NativeJITNumberOfDRegisters);
+  AARCH64_JIT_ASSERT(src < kAArch64NativeJITNumberOfDRegisters);
+  internal_emit(c, 0x1e604000 | (src << 5) | dst);
+}
+
+// The three-operand `f{op} dst, lhs, rhs`, the `op` is the 4-bit opcode field of the instruction.
+template <typename C>
+void internal_d_operation(C& c, uint32_t op, uint8_t dst, uint8_t lhs, uint8_t rhs) {
+  AARCH64_JIT_ASSERT(dst < kAArch64NativeJITNumberOfDRegisters);
+  AARCH64_JIT_ASSERT(lhs < kAArch64NativeJITNumberOfDRegisters);
+  AARCH64_JIT_ASSERT(rhs < kAArch64NativeJITNumberOfDRegisters);
+  internal_emit(c, 0x1e600800 | (rhs << 16) | (op << 12) | (lhs << 5) | dst);
+}
+
+template <typename C>
+void add_d_d_to_d(C& c, uint8_t dst, uint8_t lhs, uint8_t rhs) {
+  internal_d_operation(c, 2, dst, lhs, rhs);
+}
+
+template <typename C>
+void sub_d_d_to_d(C& c, uint8_t dst, uint8_t lhs, uint8_t rhs) {
+  internal_d_operation(c, 3, dst, lhs, rhs);
+}
+
+template <typename C>
+void mul_d_d_to_d(C& c, uint8_t dst, uint8_t lhs, uint8_t rhs) {
+  internal_d_operation(c, 0, dst, lhs, rhs);
+}
+
+template <typename C>
+void div_d_d_to_d(C& c, uint8_t dst, uint8_t lhs, uint8_t rhs) {
+  internal_d_operation(c, 1, dst, lhs, rhs);
+}
+
+template <typename C>
+void sqrt_d_to_d(C& c, uint8_t dst, uint8_t src) {
+  AARCH64_JIT_ASSERT(dst < kAArch64NativeJITNumberOfDRegisters);
+  AARCH64_JIT_ASSERT(src < kAArch64NativeJITNumberOfDRegisters);
+  internal_emit(c, 0x1e61c000 | (src << 5) | dst);
+}
+
+// `ldr x9, [x21, #index * 8]`, `blr x9`. The argument and the result are in `d0`.
+// The `x19` .. `x21` registers are callee-saved, so they need not be preserved around the call.
+template <typename C>
+void call_function_from_x21_pointers_array_by_index(C& c, uint8_t index) {
+  internal_emit(c, 0xf9400000 | (static_cast<uint32_t>(index) << 10) | (kF << 5) | kScratch);
+  internal_emit(c, 0xd63f0000 | (kScratch << 5));
+}
+
+}  // namespace opcodes
+
+}  // namespace aarch64_native_jit
+}  // namespace fncas
+}  // namespace current
+
+#endif  // FNCAS_AARCH64_NATIVE_JIT_AARCH64_NATIVE_JIT_H
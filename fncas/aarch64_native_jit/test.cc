@@ -0,0 +1,115 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2023 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// NOTE(dkorolev): This header file is `#include`-d by other tests, so keep it safe from ODR.
+
+#ifndef AARCH64_NATIVE_JIT_TEST_CC_INCLUDED
+#define AARCH64_NATIVE_JIT_TEST_CC_INCLUDED
+
+#include "../../3rdparty/gtest/gtest-main.h"
+
+#include "aarch64_native_jit.h"
+
+// The encodings are checked against `llvm-mc -triple=aarch64 -show-encoding`, so this test runs on every platform.
+TEST(AArch64NativeJIT, Opcodes) {
+  using namespace current::fncas::aarch64_native_jit;
+
+  std::vector<uint32_t> code;
+
+  opcodes::load_from_memory_by_x20_offset_to_d(code, 3, 0);
+  opcodes::load_from_memory_by_x20_offset_to_d(code, 17, 4095);
+  opcodes::load_from_memory_by_x20_offset_to_d(code, 30, 4096);
+  opcodes::store_d_to_memory_by_x19_offset(code, 5, 7);
+  opcodes::load_from_memory_by_x19_offset_to_d(code, 31, 100000);
+  opcodes::load_immediate_to_d(code, 0, 0.0);
+  opcodes::load_immediate_to_d(code, 16, 1.0);
+  opcodes::mov_d_to_d(code, 0, 22);
+  opcodes::add_d_d_to_d(code, 1, 2, 3);
+  opcodes::sub_d_d_to_d(code, 4, 5, 6);
+  opcodes::mul_d_d_to_d(code, 7, 16, 31);
+  opcodes::div_d_d_to_d(code, 30, 29, 28);
+  opcodes::sqrt_d_to_d(code, 2, 18);
+  opcodes::call_function_from_x21_pointers_array_by_index(code, 5);
+
+  // clang-format off
+  const std::vector<uint32_t> expected({
+    0xfd400283,  // ldr   d3, [x20]
+    0xfd7ffe91,  // ldr   d17, [x20, #32760]
+    0xd2820009,  // mov   x9, #4096
+    0xfc697a9e,  // ldr   d30, [x20, x9, lsl #3]
+    0xfd001e65,  // str   d5, [x19, #56]
+    0xd290d409,  // mov   x9, #34464
+    0xf2a00029,  // movk  x9, #1, lsl #16
+    0xfc697a7f,  // ldr   d31, [x19, x9, lsl #3]
+    0x9e6703e0,  // fmov  d0, xzr
+    0xd2800009,  // mov   x9, #0
+    0xf2e7fe09,  // movk  x9, #16368, lsl #48
+    0x9e670130,  // fmov  d16, x9
+    0x1e6042c0,  // fmov  d0, d22
+    0x1e632841,  // fadd  d1, d2, d3
+    0x1e6638a4,  // fsub  d4, d5, d6
+    0x1e7f0a07,  // fmul  d7, d16, d31
+    0x1e7c1bbe,  // fdiv  d30, d29, d28
+    0x1e61c242,  // fsqrt d2, d18
+    0xf94016a9,  // ldr   x9, [x21, #40]
+    0xd63f0120   // blr   x9
+  });
+  // clang-format on
+
+  ASSERT_EQ(expected.size(), code.size());
+  for (size_t i = 0; i < code.size(); ++i) {
+    EXPECT_EQ(expected[i], code[i]) << i;
+  }
+}
+
+#ifdef FNCAS_AARCH64_NATIVE_JIT_ENABLED
+
+// Tests the `mmap()` and `mprotect()` combination, as well as the calling convention.
+TEST(AArch64NativeJIT, ComputesAndCallsExternalFunctions) {
+  using namespace current::fncas::aarch64_native_jit;
+
+  std::vector<uint32_t> code;
+  opcodes::prologue(code);
+  opcodes::load_from_memory_by_x20_offset_to_d(code, 0, 0);
+  opcodes::call_function_from_x21_pointers_array_by_index(code, 1);
+  opcodes::load_from_memory_by_x20_offset_to_d(code, 1, 1);
+  opcodes::mul_d_d_to_d(code, 0, 0, 1);
+  opcodes::store_d_to_memory_by_x19_offset(code, 0, 5000);
+  opcodes::load_immediate_to_d(code, 2, 0.5);
+  opcodes::add_d_d_to_d(code, 0, 0, 2);
+  opcodes::epilogue_and_ret(code);
+
+  CallableVectorUInt32 const f(code);
+
+  double (*functions[])(double) = {[](double x) { return x; }, [](double x) { return x * 10; }};
+  std::vector<double> o(6000);
+
+  double const x[2] = {2.0, 3.0};
+  EXPECT_EQ(60.5, f(x, &o[0], functions));
+  EXPECT_EQ(60.0, o[5000]);
+}
+
+#endif  // FNCAS_AARCH64_NATIVE_JIT_ENABLED
+
+#endif  // AARCH64_NATIVE_JIT_TEST_CC_INCLUDED
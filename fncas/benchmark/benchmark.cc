@@ -0,0 +1,268 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * *******************************************************************************/
+
+// Measures, for a few representative expressions, how long it takes to build the node graph, to differentiate it,
+// to compile the function and its gradient with each JIT backend, and how fast the compiled code then evaluates.
+//
+// The results are printed as one JSON object per line, one line per expression and backend, for example:
+//
+//   ./.current/benchmark --expressions=logistic --backends=blueprint,native --seconds=1 >results.jsonl
+//
+// The `*_max_abs_diff` fields are the largest differences from the `blueprint`, interpreted, evaluations,
+// to make sure the faster backends compute what they are expected to.
+
+#include "../fncas.h"
+
+#include "../../bricks/dflags/dflags.h"
+#include "../../bricks/strings/split.h"
+#include "../../bricks/system/syscalls.h"
+#include "../../bricks/time/chrono.h"
+#include "../../bricks/util/random.h"
+
+DEFINE_string(expressions, "polynomial,logistic,nested", "The expressions to benchmark, `polynomial|logistic|nested`.");
+DEFINE_string(backends,
+              "blueprint,native,as,nasm,clang",
+              "The backends to benchmark, `blueprint|native|as|nasm|clang`. The unavailable ones are skipped.");
+
+DEFINE_uint32(dim, 100, "The number of variables.");
+DEFINE_uint32(examples, 1000, "The number of training examples for the `logistic` expression.");
+DEFINE_uint32(features, 10, "The number of nonzero features per training example for the `logistic` expression.");
+DEFINE_uint32(depth, 20, "The depth of the `exp`/`log` nesting for the `nested` expression.");
+
+DEFINE_uint32(points, 16, "The number of random points to evaluate the functions and the gradients on.");
+DEFINE_double(seconds, 0.5, "The time to spend measuring each evaluation throughput, in seconds.");
+DEFINE_int32(random_seed, 42, "The random seed to use.");
+
+CURRENT_STRUCT(BenchmarkResult) {
+  CURRENT_FIELD(expression, std::string);
+  CURRENT_FIELD(backend, std::string);
+  CURRENT_FIELD(dim, uint32_t, 0u);
+  CURRENT_FIELD(nodes, uint64_t, 0u);
+  CURRENT_FIELD(build_ms, double, 0.0);
+  CURRENT_FIELD(differentiate_ms, double, 0.0);
+  CURRENT_FIELD(compile_f_ms, double, 0.0);
+  CURRENT_FIELD(compile_g_ms, double, 0.0);
+  CURRENT_FIELD(f_evaluations_per_second, double, 0.0);
+  CURRENT_FIELD(g_evaluations_per_second, double, 0.0);
+  CURRENT_FIELD(f_max_abs_diff, double, 0.0);
+  CURRENT_FIELD(g_max_abs_diff, double, 0.0);
+};
+
+inline double MillisecondsSince(std::chrono::microseconds begin) {
+  return 1e-3 * (current::time::Now() - begin).count();
+}
+
+// `sum_i (1 + x_i * (2 + x_i * (3 + x_i * 4))) * x_{i+1}`: plenty of arithmetic, no external functions.
+fncas::term_t PolynomialExpression(const fncas::variables_vector_t& x) {
+  fncas::term_t result = 0.0;
+  for (size_t i = 0; i < x.size(); ++i) {
+    result += (1.0 + x[i] * (2.0 + x[i] * (3.0 + x[i] * 4.0))) * x[(i + 1) % x.size()];
+  }
+  return result;
+}
+
+// The logistic loss, `sum_e log(1 + exp(-y_e * (a_e, x)))`, over the sparse random training examples.
+fncas::term_t LogisticExpression(const fncas::variables_vector_t& x) {
+  fncas::term_t result = 0.0;
+  for (size_t e = 0; e < FLAGS_examples; ++e) {
+    fncas::term_t z = 0.0;
+    for (size_t k = 0; k < FLAGS_features; ++k) {
+      z += x[current::random::RandomUInt(0u, static_cast<uint32_t>(x.size() - 1u))] *
+           current::random::RandomReal(-1.0, 1.0);
+    }
+    double const y = current::random::RandomInt(0, 1) ? 1.0 : -1.0;
+    result += fncas::log(1.0 + fncas::exp(z * -y));
+  }
+  return result;
+}
+
+// `sum_i t_i`, where `t_i` is `x_i` passed `--depth` times through `t = log(1 + exp(t / 2 + x_j / 10))`.
+fncas::term_t NestedExpression(const fncas::variables_vector_t& x) {
+  fncas::term_t result = 0.0;
+  for (size_t i = 0; i < x.size(); ++i) {
+    fncas::term_t t = x[i];
+    for (size_t k = 0; k < FLAGS_depth; ++k) {
+      t = fncas::log(1.0 + fncas::exp(t * 0.5 + x[(i + k + 1) % x.size()] * 0.1));
+    }
+    result += t;
+  }
+  return result;
+}
+
+fncas::term_t BuildExpression(const std::string& expression, const fncas::variables_vector_t& x) {
+  if (expression == "polynomial") {
+    return PolynomialExpression(x);
+  } else if (expression == "logistic") {
+    return LogisticExpression(x);
+  } else if (expression == "nested") {
+    return NestedExpression(x);
+  } else {
+    std::cerr << "Invalid expression `" << expression << "`, try `--help`." << std::endl;
+    std::exit(-1);
+  }
+}
+
+// Calls `f(point_index)` for all the points, over and over, for `--seconds`, and returns the calls per second.
+template <typename F>
+double EvaluationsPerSecond(F&& f) {
+  size_t evaluations = 0u;
+  auto const begin = current::time::Now();
+  std::chrono::microseconds elapsed;
+  do {
+    for (size_t i = 0; i < FLAGS_points; ++i) {
+      f(i);
+    }
+    evaluations += FLAGS_points;
+    elapsed = current::time::Now() - begin;
+  } while (elapsed.count() < FLAGS_seconds * 1e6);
+  return evaluations * 1e6 / elapsed.count();
+}
+
+struct Benchmark {
+  fncas::function_t<fncas::JIT::Blueprint> const& fi;
+  fncas::gradient_t<fncas::JIT::Blueprint> const& gi;
+  std::vector<std::vector<double>> const& points;
+  std::vector<double> const& f_values;
+  std::vector<std::vector<double>> const& g_values;
+
+  template <typename F, typename G>
+  void Measure(BenchmarkResult& result, F const& f, G const& g) const {
+    double sink = 0.0;
+    result.f_evaluations_per_second = EvaluationsPerSecond([&](size_t i) { sink += f(points[i]); });
+    result.g_evaluations_per_second = EvaluationsPerSecond([&](size_t i) { sink += g(points[i])[0]; });
+    for (size_t i = 0; i < points.size(); ++i) {
+      result.f_max_abs_diff = std::max(result.f_max_abs_diff, std::abs(f(points[i]) - f_values[i]));
+      std::vector<double> const gradient = g(points[i]);
+      for (size_t j = 0; j < gradient.size(); ++j) {
+        result.g_max_abs_diff = std::max(result.g_max_abs_diff, std::abs(gradient[j] - g_values[i][j]));
+      }
+    }
+    // Keeps the evaluations from being optimized away.
+    if (sink == 42.0) {
+      std::cerr << "The answer." << std::endl;
+    }
+  }
+
+  template <fncas::JIT JIT_IMPLEMENTATION>
+  void MeasureCompiled(BenchmarkResult& result) const {
+#ifdef FNCAS_JIT_COMPILED
+    // To measure the compilation itself, not the lookup.
+    fncas::impl::compiled_code_cache::instance().Clear();
+#endif
+    auto const compile_f_begin = current::time::Now();
+    fncas::function_t<JIT_IMPLEMENTATION> const f(fi);
+    result.compile_f_ms = MillisecondsSince(compile_f_begin);
+    auto const compile_g_begin = current::time::Now();
+    fncas::gradient_t<JIT_IMPLEMENTATION> const g(fi, gi);
+    result.compile_g_ms = MillisecondsSince(compile_g_begin);
+    Measure(result, f, g);
+  }
+
+  // Returns `false` if the backend is not available in this build or on this machine.
+  bool Run(std::string const& backend, BenchmarkResult& result) const {
+    if (backend == "blueprint") {
+      Measure(result, fi, gi);
+      return true;
+    }
+#if defined(FNCAS_X64_NATIVE_JIT_ENABLED) && defined(FNCAS_JIT_COMPILED)
+    if (backend == "native") {
+      MeasureCompiled<fncas::JIT::X64NativeJIT>(result);
+      return true;
+    }
+#elif defined(FNCAS_AARCH64_NATIVE_JIT_COMPILED)
+    if (backend == "native") {
+      MeasureCompiled<fncas::JIT::AArch64NativeJIT>(result);
+      return true;
+    }
+#endif
+#ifdef FNCAS_JIT_COMPILED
+    if (backend == "as" && ToolIsAvailable("gcc")) {
+      MeasureCompiled<fncas::JIT::AS>(result);
+      return true;
+    }
+    if (backend == "nasm" && ToolIsAvailable("nasm")) {
+      MeasureCompiled<fncas::JIT::NASM>(result);
+      return true;
+    }
+    if (backend == "clang" && ToolIsAvailable("clang")) {
+      MeasureCompiled<fncas::JIT::CLANG>(result);
+      return true;
+    }
+#endif
+    return false;
+  }
+
+  static bool ToolIsAvailable(std::string const& tool) {
+    return !current::bricks::system::SystemCall("which " + tool + " >/dev/null 2>&1");
+  }
+};
+
+int main(int argc, char** argv) {
+  ParseDFlags(&argc, &argv);
+
+  std::vector<std::string> const expressions = current::strings::Split(FLAGS_expressions, ',');
+  std::vector<std::string> const backends = current::strings::Split(FLAGS_backends, ',');
+
+  for (std::string const& expression : expressions) {
+    // The same training examples and points for every run with the same flags.
+    current::random::SetRandomSeed(FLAGS_random_seed);
+
+    BenchmarkResult prototype;
+    prototype.expression = expression;
+    prototype.dim = FLAGS_dim;
+
+    auto const build_begin = current::time::Now();
+    fncas::variables_vector_t const x(FLAGS_dim);
+    fncas::function_t<fncas::JIT::Blueprint> const fi = BuildExpression(expression, x);
+    prototype.build_ms = MillisecondsSince(build_begin);
+    prototype.nodes = fncas::impl::node_vector_singleton().size();
+
+    auto const differentiate_begin = current::time::Now();
+    fncas::gradient_t<fncas::JIT::Blueprint> const gi(x, fi);
+    prototype.differentiate_ms = MillisecondsSince(differentiate_begin);
+
+    std::vector<std::vector<double>> points(FLAGS_points, std::vector<double>(FLAGS_dim));
+    std::vector<double> f_values(FLAGS_points);
+    std::vector<std::vector<double>> g_values(FLAGS_points);
+    for (size_t i = 0; i < FLAGS_points; ++i) {
+      for (double& v : points[i]) {
+        v = current::random::RandomReal(-1.0, 1.0);
+      }
+      f_values[i] = fi(points[i]);
+      g_values[i] = gi(points[i]);
+    }
+
+    Benchmark const benchmark{fi, gi, points, f_values, g_values};
+    for (std::string const& backend : backends) {
+      BenchmarkResult result = prototype;
+      result.backend = backend;
+      if (benchmark.Run(backend, result)) {
+        std::cout << JSON(result) << std::endl;
+      } else {
+        std::cerr << "Skipping `" << backend << "` for `" << expression << "`, it is not available." << std::endl;
+      }
+    }
+  }
+}
@@ -84,7 +84,8 @@ using namespace fncas_docu;
   
   // Create the blueprint of this function: its internal tree representation.
   // The scope of `x` would be where the blueprint and its uses are valid
-  // from within this particular thread. It uses a thread-local singleton.
+  // from within this particular thread. It uses a thread-local singleton,
+  // unless an `expression_context_t` is activated via an `expression_context_scope_t`.
   variables_vector_t x(2);
   number_of_calls = 0;
   function_t<JIT::Blueprint> blueprint = simple_function(x);
@@ -33,6 +33,7 @@
 #include <cstdint>
 
 #include "../x64_native_jit/x64_native_jit.h"
+#include "../aarch64_native_jit/aarch64_native_jit.h"
 
 namespace fncas {
 
@@ -78,13 +79,18 @@ enum class JIT {
   CLANG,          // JIT via `clang++`.
   AS,             // JIT via `as`.
   NASM,           // JIT via `nasm`.
-#ifndef FNCAS_X64_NATIVE_JIT_ENABLED
-  // The JIT used by default by the optimization algorithms is the `as` one ...
-  Default = AS
-#else
-  // ... unless we are on a platform where the x64 native JIT is available (Linux or MacOS).
+#if defined(FNCAS_X64_NATIVE_JIT_ENABLED)
+  // The JIT used by default by the optimization algorithms is the x64 native one on x64 Linux or MacOS ...
   X64NativeJIT,
   Default = X64NativeJIT
+#else
+#if defined(FNCAS_AARCH64_NATIVE_JIT_ENABLED)
+  // NOTE(dkorolev): The AArch64 native JIT is opt-in, via `JIT::AArch64NativeJIT` explicitly, until its executing
+  // tests are run on AArch64 hardware, or under `qemu-aarch64`, as part of the CI.
+  AArch64NativeJIT,
+#endif
+  // ... and the `as` one otherwise.
+  Default = AS
 #endif
 };
 
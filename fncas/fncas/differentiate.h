@@ -66,32 +66,40 @@ std::vector<double_t> approximate_gradient(F&& f,
   return g;
 }
 
+inline V simplified_add(const V& x, const V& y) {
+  if (x.is_value() && y.is_value()) {
+    return x.value() + y.value();
+  } else if (y.equals_to(0)) {
+    return x;
+  } else if (x.equals_to(0)) {
+    return y;
+  } else {
+    return x + y;
+  }
+}
+
+inline V simplified_sub(const V& x, const V& y) {
+  if (x.is_value() && y.is_value()) {
+    return x.value() - y.value();
+  } else if (y.equals_to(0)) {
+    return x;
+  } else if (x.equals_to(0)) {
+    return -y;
+  } else {
+    return x - y;
+  }
+}
+
 inline V d_add(const V& a, const V& b, const V& da, const V& db) {
   static_cast<void>(a);
   static_cast<void>(b);
-  if (da.is_value() && db.is_value()) {
-    return da.value() + db.value();
-  } else if (db.equals_to(0)) {
-    return da;
-  } else if (da.equals_to(0)) {
-    return db;
-  } else {
-    return da + db;
-  }
+  return simplified_add(da, db);
 }
 
 inline V d_sub(const V& a, const V& b, const V& da, const V& db) {
   static_cast<void>(a);
   static_cast<void>(b);
-  if (da.is_value() && db.is_value()) {
-    return da.value() - db.value();
-  } else if (db.equals_to(0)) {
-    return da;
-  } else if (da.equals_to(0)) {
-    return -db;
-  } else {
-    return da - db;
-  }
+  return simplified_sub(da, db);
 }
 
 inline V simplified_mul(const V& x, const V& y) {
@@ -268,6 +276,139 @@ inline node_index_t differentiate_node(node_index_t index, size_t var_index, siz
   return result;
 }
 
+// Reverse-mode differentiation: builds the nodes for the whole gradient of `index` in one adjoint sweep.
+//
+// Unlike `differentiate_node()`, which is called once per variable, and thus records up to `dim` times the nodes of
+// the function, this sweep visits each node of the function once, in reverse topological order, adding up its
+// contributions to the adjoints of its arguments. The gradient thus has at most a few nodes per node of the function,
+// and these nodes are shared by all its components, so that computing them in one go, interpreted with the nodes
+// cache, or JIT-compiled, costs a small constant times computing the function itself.
+//
+// The subtrees that do not depend on any variable are skipped altogether.
+inline std::vector<node_index_t> differentiate_node_reverse_mode(node_index_t index, size_t dim) {
+  // The nodes of the function in topological order, the arguments before the nodes that use them.
+  std::vector<node_index_t> order;
+  std::vector<int8_t> visited;  // Zero for not yet visited, `1` for depends on variables, `-1` for does not.
+  {
+    std::stack<node_index_t> stack;
+    stack.push(index);
+    while (!stack.empty()) {
+      const node_index_t i = stack.top();
+      stack.pop();
+      const node_index_t dependent_i = ~i;
+      if (i > dependent_i) {
+        if (growing_vector_access(visited, i, static_cast<int8_t>(0))) {
+          continue;
+        }
+        node_impl& f = node_vector_singleton()[static_cast<size_t>(i)];
+        if (f.type() == NodeType::variable) {
+          visited[i] = 1;
+          order.push_back(i);
+        } else if (f.type() == NodeType::value) {
+          visited[i] = -1;
+        } else if (f.type() == NodeType::operation) {
+          visited[i] = -1;  // Updated once the arguments are visited, and guards against visiting this node twice.
+          stack.push(~i);
+          stack.push(f.lhs_index());
+          stack.push(f.rhs_index());
+        } else if (f.type() == NodeType::function) {
+          visited[i] = -1;
+          stack.push(~i);
+          stack.push(f.argument_index());
+        } else {
+          CURRENT_ASSERT(false);
+        }
+      } else {
+        node_impl& f = node_vector_singleton()[static_cast<size_t>(dependent_i)];
+        const bool depends = f.type() == NodeType::operation
+                                 ? (visited[f.lhs_index()] > 0 || visited[f.rhs_index()] > 0)
+                                 : visited[f.argument_index()] > 0;
+        if (depends) {
+          visited[dependent_i] = 1;
+          order.push_back(dependent_i);
+        }
+      }
+    }
+  }
+
+  // The adjoints, `-1` for the nodes to which nothing has been added yet, which stands for zero.
+  std::vector<node_index_t> adjoint;
+  const auto add_to_adjoint = [&adjoint](node_index_t i, const V& delta, bool negate) {
+    node_index_t& a = growing_vector_access(adjoint, i, static_cast<node_index_t>(-1));
+    if (a == -1) {
+      a = (negate ? (delta.is_value() ? V(-delta.value()) : -delta) : delta).index();
+    } else {
+      a = (negate ? simplified_sub(from_index(a), delta) : simplified_add(from_index(a), delta)).index();
+    }
+  };
+
+  std::vector<V> gradient(dim, V(0.0));
+  if (!order.empty()) {
+    CURRENT_ASSERT(order.back() == index);
+    add_to_adjoint(index, V(1.0), false);
+  }
+  for (auto cit = order.rbegin(); cit != order.rend(); ++cit) {
+    const node_index_t i = *cit;
+    const V a = from_index(growing_vector_access(adjoint, i, static_cast<node_index_t>(-1)));
+    node_impl& f = node_vector_singleton()[static_cast<size_t>(i)];
+    if (f.type() == NodeType::variable) {
+      const size_t v = static_cast<size_t>(f.variable());
+      CURRENT_ASSERT(v < dim);
+      gradient[v] = simplified_add(gradient[v], a);
+    } else if (f.type() == NodeType::operation) {
+      const node_index_t lhs = f.lhs_index();
+      const node_index_t rhs = f.rhs_index();
+      const bool lhs_depends = visited[lhs] > 0;
+      const bool rhs_depends = visited[rhs] > 0;
+      if (f.operation() == MathOperation::add) {
+        if (lhs_depends) {
+          add_to_adjoint(lhs, a, false);
+        }
+        if (rhs_depends) {
+          add_to_adjoint(rhs, a, false);
+        }
+      } else if (f.operation() == MathOperation::subtract) {
+        if (lhs_depends) {
+          add_to_adjoint(lhs, a, false);
+        }
+        if (rhs_depends) {
+          add_to_adjoint(rhs, a, true);
+        }
+      } else if (f.operation() == MathOperation::multiply) {
+        if (lhs_depends) {
+          add_to_adjoint(lhs, simplified_mul(a, from_index(rhs)), false);
+        }
+        if (rhs_depends) {
+          add_to_adjoint(rhs, simplified_mul(a, from_index(lhs)), false);
+        }
+      } else if (f.operation() == MathOperation::divide) {
+        // With `t = a / rhs`, the adjoint of `lhs` gets `t`, and that of `rhs` gets `-t * (lhs / rhs)`.
+        const V t = a / from_index(rhs);
+        if (lhs_depends) {
+          add_to_adjoint(lhs, t, false);
+        }
+        if (rhs_depends) {
+          add_to_adjoint(rhs, simplified_mul(t, from_index(i)), true);
+        }
+      } else {
+        CURRENT_ASSERT(false);
+      }
+    } else if (f.type() == NodeType::function) {
+      // The argument has to depend on the variables, as otherwise this node would not be in `order`.
+      const node_index_t x = f.argument_index();
+      add_to_adjoint(x, from_index(d_f(f.function(), from_index(i), from_index(x), a)), false);
+    } else {
+      CURRENT_ASSERT(false);
+    }
+  }
+
+  std::vector<node_index_t> result(dim);
+  for (size_t v = 0; v < dim; ++v) {
+    result[v] = gradient[v].index();
+  }
+  return result;
+}
+
 template <JIT>
 struct g_impl;
 
@@ -304,10 +445,12 @@ struct g_impl<JIT::Blueprint> : g_super {
   std::vector<V> g_;  // `g_[i]` holds the node index for the value of the derivative by variable `i`.
   g_impl(const X& x_ref, const V& f) : f_(f) {
     CURRENT_ASSERT(&x_ref == internals_singleton().x_ptr_);
-    const size_t dim = internals_singleton().dim_;
-    g_.resize(dim);
-    for (size_t i = 0; i < dim; ++i) {
-      g_[i] = f_.template differentiate<X>(x_ref, i);
+    // The reverse mode, in one sweep for all the variables, as `f_.differentiate(x_ref, i)` per variable is
+    // prohibitively expensive for the functions of many variables.
+    const std::vector<node_index_t> g = differentiate_node_reverse_mode(f_.index(), internals_singleton().dim_);
+    g_.resize(g.size());
+    for (size_t i = 0; i < g.size(); ++i) {
+      g_[i] = from_index(g[i]);
     }
     internals_singleton().node_vector_.shrink_to_fit();
   }
@@ -57,6 +57,12 @@ struct BacktrackingException : FnCASOptimizationException {
   using FnCASOptimizationException::FnCASOptimizationException;
 };
 
+// This exception is thrown when the call to `StrongWolfeLineSearch` in `mathutil.h` finds no acceptable step,
+// or is given a direction along which the function does not decrease.
+struct StrongWolfeLineSearchException : FnCASOptimizationException {
+  using FnCASOptimizationException::FnCASOptimizationException;
+};
+
 }  // namespace exceptions
 }  // namespace fncas
 
@@ -31,7 +31,9 @@
 #include "base.h"
 #include "node.h"
 #include "differentiate.h"
+#include "simplify.h"
 #include "optimize.h"
 #include "jit.h"
+#include "jit_aarch64.h"
 
 #endif  // FNCAS_FNCAS_FNCAS_H
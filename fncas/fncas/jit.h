@@ -35,11 +35,15 @@
 
 #define FNCAS_JIT_COMPILED
 
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <stack>
 #include <string>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 #include <dlfcn.h>
@@ -47,10 +51,13 @@
 #include "../../bricks/strings/printf.h"
 #include "../../bricks/file/file.h"
 #include "../../bricks/system/syscalls.h"
+#include "../../bricks/util/sha256.h"
+#include "../../bricks/util/singleton.h"
 
 #include "base.h"
 #include "node.h"
 #include "differentiate.h"
+#include "simplify.h"
 
 namespace fncas {
 namespace impl {
@@ -70,6 +77,20 @@ inline const char* operation_as_assembler_opcode(MathOperation operation) {
   return operation < MathOperation::end ? representation[static_cast<size_t>(operation)] : "?";
 }
 
+// The per-thread scratch memory to evaluate the compiled functions. The compiled functions themselves are immutable,
+// so that each of them can be evaluated from many threads concurrently.
+struct compiled_evaluation_scratch final {
+  std::vector<double> heap;
+  std::vector<double> batch_x;  // The interleaved input for the batch evaluations, see `pf_batch_t`.
+  double* heap_of_size(size_t size) {
+    if (heap.size() < size) {
+      heap.resize(size);
+    }
+    return &heap[0];
+  }
+  static compiled_evaluation_scratch& tls() { return current::ThreadLocalSingleton<compiled_evaluation_scratch>(); }
+};
+
 struct compiled_expression final : noncopyable {
   typedef long long (*DIM)();
   typedef long long (*HEAP_SIZE)();
@@ -118,7 +139,8 @@ struct compiled_expression final : noncopyable {
         heap_size_(std::move(rhs.heap_size_)),
         function_(std::move(rhs.function_)),
         gradient_(std::move(rhs.gradient_)),
-        lib_filename_(std::move(rhs.lib_filename_)) {
+        lib_filename_(std::move(rhs.lib_filename_)),
+        gradient_indexes_(std::move(rhs.gradient_indexes_)) {
     rhs.lib_ = nullptr;
   }
 
@@ -127,13 +149,7 @@ struct compiled_expression final : noncopyable {
     CURRENT_ASSERT(heap_size_);
     CURRENT_ASSERT(function_);
 
-    std::vector<double>& heap = internals_singleton().heap_for_compiled_evaluations_;
-    const size_t desired_heap_size = heap_size_();
-    if (heap.size() < desired_heap_size) {
-      heap.resize(desired_heap_size);
-    }
-
-    return function_(x, &heap[0]);
+    return function_(x, compiled_evaluation_scratch::tls().heap_of_size(heap_size_()));
   }
 
   double compute_compiled_f(const std::vector<double>& x) const { return compute_compiled_f(&x[0]); }
@@ -145,18 +161,15 @@ struct compiled_expression final : noncopyable {
     const auto dim = static_cast<size_t>(dim_());
     CURRENT_ASSERT(gradient_indexes_.size() == dim);
 
-    std::vector<double>& heap = internals_singleton().heap_for_compiled_evaluations_;
-    const size_t desired_heap_size = heap_size_();
-    if (heap.size() < desired_heap_size) {
-      heap.resize(desired_heap_size);
-    }
+    const size_t heap_size = static_cast<size_t>(heap_size_());
+    double* heap = compiled_evaluation_scratch::tls().heap_of_size(heap_size);
 
-    gradient_(x, &heap[0]);
+    gradient_(x, heap);
 
     CURRENT_ASSERT(gradient_indexes_.size() == dim);
     std::vector<double> result(dim);
     for (size_t i = 0; i < gradient_indexes_.size(); ++i) {
-      CURRENT_ASSERT(static_cast<size_t>(gradient_indexes_[i]) < heap.size());
+      CURRENT_ASSERT(static_cast<size_t>(gradient_indexes_[i]) < heap_size);
       result[i] = heap[gradient_indexes_[i]];
     }
 
@@ -708,68 +721,225 @@ class JITImplementation<JIT::CLANG> final {
   }
 };
 
-template <JIT JIT_IMPLEMENTATION>
-compiled_expression compile_eval_f(node_index_t index) {
-  const std::string filebase(current::FileSystem::GenTmpFileName());
+// The process-wide cache of the compiled functions and gradients, keyed by the canonical form of their expressions,
+// so that compiling the same expression again, from any thread and in any `expression_context`, reuses the code.
+// With the disk directory set, the `.so`-s built by the external compilers are also kept there, across runs.
+class compiled_code_cache final {
+ public:
+  struct Stats final {
+    size_t hits = 0u;       // Found in memory.
+    size_t disk_hits = 0u;  // Loaded from the disk directory.
+    size_t misses = 0u;     // Compiled.
+  };
+
+  static compiled_code_cache& instance() { return current::Singleton<compiled_code_cache>(); }
+
+  // The key of the expressions of `indexes`, compiled as `kind`, which should name both the backend and the entry.
+  static std::string key(const std::string& kind, const std::vector<node_index_t>& indexes) {
+    return kind + ' ' + std::to_string(internals_singleton().dim_) + ' ' + canonical_expression_key(indexes);
+  }
+
+  // Returns the cached `T` for `key`, or the one returned by `create()`, which is called without the lock held.
+  template <typename T, typename F>
+  std::shared_ptr<const T> get(const std::string& key, F&& create) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto const cit = entries_.find(key);
+      if (cit != entries_.end()) {
+        ++stats_.hits;
+        return std::static_pointer_cast<const T>(cit->second);
+      }
+    }
+    std::shared_ptr<const T> created = create();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto const cit = entries_.find(key);
+    if (cit != entries_.end()) {
+      // Another thread has compiled the same expression meanwhile, keep the first one.
+      return std::static_pointer_cast<const T>(cit->second);
+    }
+    entries_[key] = created;
+    order_.push_back(key);
+    evict();
+    return created;
+  }
+
+  // The maximum number of entries kept in memory, the oldest ones go first. The evicted code stays alive for as long
+  // as the functions and gradients using it do.
+  void SetCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacity;
+    evict();
+  }
+
+  // The directory to keep the compiled `.so`-s in, or an empty string, the default, to not use the disk.
+  void SetDiskDirectory(const std::string& directory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    disk_directory_ = directory;
+  }
+
+  std::string DiskDirectory() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return disk_directory_;
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    order_.clear();
+    stats_ = Stats();
+  }
+
+  Stats GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+  void RegisterMiss() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.misses;
+  }
+
+  void RegisterDiskHit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.disk_hits;
+  }
+
+ private:
+  void evict() {
+    while (order_.size() > capacity_) {
+      entries_.erase(order_.front());
+      order_.pop_front();
+    }
+  }
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, std::shared_ptr<const void>> entries_;
+  std::deque<std::string> order_;
+  size_t capacity_ = 1000u;
+  std::string disk_directory_;
+  Stats stats_;
+};
+
+// Builds the `.so` for `key` with `generate(filebase)`, or loads the one built before from the disk cache directory.
+// The gradient indexes are the heap indexes of the build, so they are stored next to the `.so` as part of its key.
+template <typename F>
+std::shared_ptr<const compiled_expression> load_or_build_compiled_expression(
+    const std::string& key, const compiled_expression::gradient_indexes_t& gradient_indexes, F&& generate) {
+  const std::string directory = compiled_code_cache::instance().DiskDirectory();
+  if (directory.empty()) {
+    compiled_code_cache::instance().RegisterMiss();
+    const std::string filebase(current::FileSystem::GenTmpFileName());
+    const std::string filename_so = filebase + ".so";
+    current::FileSystem::RmFile(filename_so, current::FileSystem::RmFileParameters::Silent);
+    generate(filebase);
+    return std::make_shared<const compiled_expression>(filename_so, gradient_indexes);
+  }
+
+  const std::string filebase = current::FileSystem::JoinPath(directory, "fncas_" + current::SHA256(key).substr(0, 32));
   const std::string filename_so = filebase + ".so";
-  current::FileSystem::RmFile(filename_so, current::FileSystem::RmFileParameters::Silent);
-  {
-    JITImplementation<JIT_IMPLEMENTATION> code_generator(filebase, false);
-    code_generator.compile_eval_f(index);
+  const std::string filename_key = filebase + ".key";
+  try {
+    const std::string contents = current::FileSystem::ReadFileAsString(filename_key);
+    const size_t newline = contents.find('\n');
+    if (newline != std::string::npos && contents.substr(newline + 1u) == key) {
+      compiled_expression::gradient_indexes_t stored_gradient_indexes;
+      std::istringstream is(contents.substr(0u, newline));
+      node_index_t i;
+      while (is >> i) {
+        stored_gradient_indexes.push_back(i);
+      }
+      compiled_code_cache::instance().RegisterDiskHit();
+      return std::make_shared<const compiled_expression>(filename_so, stored_gradient_indexes);
+    }
+  } catch (const current::FileException&) {
+    // Not in the disk cache yet.
+  }
+
+  compiled_code_cache::instance().RegisterMiss();
+  const std::string tmp_filebase(current::FileSystem::GenTmpFileName());
+  generate(tmp_filebase);
+  current::FileSystem::WriteStringToFileAtomically(current::FileSystem::ReadFileAsString(tmp_filebase + ".so"),
+                                                   filename_so.c_str());
+  current::FileSystem::RmFile(tmp_filebase + ".so", current::FileSystem::RmFileParameters::Silent);
+  std::ostringstream os;
+  for (node_index_t i : gradient_indexes) {
+    os << i << ' ';
   }
-  return compiled_expression(filename_so);
+  os << '\n' << key;
+  // The key goes last, so that it only matches once the `.so` is in place.
+  current::FileSystem::WriteStringToFileAtomically(os.str(), filename_key.c_str());
+  return std::make_shared<const compiled_expression>(filename_so, gradient_indexes);
 }
 
 template <JIT JIT_IMPLEMENTATION>
-inline compiled_expression compile_eval_f(const V& node) {
-  return compile_eval_f<JIT_IMPLEMENTATION>(node.index_);
+std::shared_ptr<const compiled_expression> compile_eval_f(node_index_t index) {
+  const std::string key =
+      compiled_code_cache::key("f" + std::to_string(static_cast<int>(JIT_IMPLEMENTATION)), {index});
+  return compiled_code_cache::instance().get<compiled_expression>(key, [&]() {
+    return load_or_build_compiled_expression(key, {}, [index](const std::string& filebase) {
+      JITImplementation<JIT_IMPLEMENTATION> code_generator(filebase, false);
+      code_generator.compile_eval_f(index);
+    });
+  });
 }
 
 template <JIT JIT_IMPLEMENTATION>
-compiled_expression compile_eval_g(node_index_t f_index, const std::vector<node_index_t>& g_indexes) {
-  const std::string filebase(current::FileSystem::GenTmpFileName());
-  const std::string filename_so = filebase + ".so";
-  current::FileSystem::RmFile(filename_so, current::FileSystem::RmFileParameters::Silent);
-  {
-    JITImplementation<JIT_IMPLEMENTATION> code_generator(filebase, true);
-    code_generator.compile_eval_g(f_index, g_indexes);
-  }
-  return compiled_expression(filename_so, g_indexes);
+inline std::shared_ptr<const compiled_expression> compile_eval_f(const V& node) {
+  return compile_eval_f<JIT_IMPLEMENTATION>(simplify_node(node).index_);
 }
 
 template <JIT JIT_IMPLEMENTATION>
-inline compiled_expression compile_eval_g(const V& f_node, const std::vector<V>& g_nodes) {
+std::shared_ptr<const compiled_expression> compile_eval_g(node_index_t f_index,
+                                                          const std::vector<node_index_t>& g_indexes) {
+  std::vector<node_index_t> indexes(g_indexes);
+  indexes.push_back(f_index);
+  const std::string key = compiled_code_cache::key("g" + std::to_string(static_cast<int>(JIT_IMPLEMENTATION)), indexes);
+  return compiled_code_cache::instance().get<compiled_expression>(key, [&]() {
+    return load_or_build_compiled_expression(key, g_indexes, [f_index, &g_indexes](const std::string& filebase) {
+      JITImplementation<JIT_IMPLEMENTATION> code_generator(filebase, true);
+      code_generator.compile_eval_g(f_index, g_indexes);
+    });
+  });
+}
+
+template <JIT JIT_IMPLEMENTATION>
+inline std::shared_ptr<const compiled_expression> compile_eval_g(const V& f_node, const std::vector<V>& g_nodes) {
+  // The function goes last, and is simplified along with the gradient, to share the common subexpressions.
   std::vector<node_index_t> g_node_indexes;
-  g_node_indexes.reserve(g_nodes.size());
+  g_node_indexes.reserve(g_nodes.size() + 1u);
   for (const auto& gi : g_nodes) {
     g_node_indexes.push_back(gi.index_);
   }
-  return compile_eval_g<JIT_IMPLEMENTATION>(f_node.index_, g_node_indexes);
+  g_node_indexes.push_back(f_node.index_);
+  simplify_nodes(g_node_indexes);
+  const node_index_t f_index = g_node_indexes.back();
+  g_node_indexes.pop_back();
+  return compile_eval_g<JIT_IMPLEMENTATION>(f_index, g_node_indexes);
 }
 
 struct f_compiled_super : f_super {};
 
 template <JIT JIT_IMPLEMENTATION>
 struct f_compiled final : f_compiled_super {
-  fncas::impl::compiled_expression c_;
+  std::shared_ptr<const fncas::impl::compiled_expression> c_;  // Shared with `compiled_code_cache`.
 
   explicit f_compiled(const V& node) : c_(compile_eval_f<JIT_IMPLEMENTATION>(node)) {
-    CURRENT_ASSERT(c_.HasFunction());
+    CURRENT_ASSERT(c_->HasFunction());
   }
   explicit f_compiled(const f_impl<JIT::Blueprint>& f) : c_(compile_eval_f<JIT_IMPLEMENTATION>(f.f_)) {
-    CURRENT_ASSERT(c_.HasFunction());
+    CURRENT_ASSERT(c_->HasFunction());
   }
 
   f_compiled(const f_compiled&) = delete;
   void operator=(const f_compiled&) = delete;
-  f_compiled(f_compiled&& rhs) : c_(std::move(rhs.c_)) { CURRENT_ASSERT(c_.HasFunction()); }
+  f_compiled(f_compiled&& rhs) : c_(std::move(rhs.c_)) { CURRENT_ASSERT(c_->HasFunction()); }
 
-  double operator()(const std::vector<double>& x) const override { return c_.compute_compiled_f(x); }
+  double operator()(const std::vector<double>& x) const override { return c_->compute_compiled_f(x); }
 
-  size_t dim() const override { return c_.dim(); }
-  size_t heap_size() const override { return c_.heap_size(); }
+  size_t dim() const override { return c_->dim(); }
+  size_t heap_size() const override { return c_->heap_size(); }
 
-  const std::string& lib_filename() const { return c_.lib_filename(); }
+  const std::string& lib_filename() const { return c_->lib_filename(); }
 };
 
 #ifdef FNCAS_X64_NATIVE_JIT_ENABLED
@@ -780,38 +950,46 @@ struct f_compiled final : f_compiled_super {
 #error "Someone forgot to un-#define `FNCAS_DEBUG_NATIVE_JIT`."
 #endif
 
+// The native JIT code generator, with a register allocator over `xmm0` .. `xmm15`.
+//
+// First, `jit_compile_node()`, `jit_store_node()`, and `jit_return_node()` record the steps to perform, with the nodes
+// in their evaluation order. Then `jit_generate_code()` emits the code in one linear-scan-style pass: each value lives
+// in a register from where it is computed to its last use, and is written to its `rbx`-addressed slot only if it has
+// to be spilled. A value is spilled when all the registers are taken, in which case the one used the latest goes, or
+// when an external function is called, as the System V ABI preserves none of the `xmm` registers across calls.
+// The input variables and the constants are never spilled, as they can always be re-loaded.
+//
+// In the `batch` mode the very same code is generated for `kX64NativeJITBatchSize` points at once, with the packed
+// AVX2 ops on the `ymm` registers, and with each slot of the input and output arrays being that many doubles.
+// The external functions are then called in place on the slot of their result, and `sqrt` is inlined as `vsqrtpd`.
 struct JITCodeGenerator final {
   std::vector<uint8_t>& code;
   size_t const dim;  // "Pre-allocated" in the output vector, 0 for function computation, dim. of `x` for gradients.
+  bool const batch;  // Whether to generate the `kX64NativeJITBatchSize`-points code, see `pf_batch_t`.
 
   std::vector<bool> computed;
   node_index_t max_dim = 0;
 
-  JITCodeGenerator(std::vector<uint8_t>& code, size_t dim) : code(code), dim(dim) {
-    using namespace current::fncas::x64_native_jit;
-
-    opcodes::push_rbx(code);
-    opcodes::mov_rsi_rbx(code);
-
-#ifdef FNCAS_DEBUG_NATIVE_JIT
-    std::cerr << "begin();\n";
-#endif
-  }
+  enum class StepType : uint8_t { Compute, Store, Return };
+  struct Step {
+    StepType type;
+    node_index_t node;
+    size_t output_index;
+  };
+  std::vector<Step> steps;
 
-  ~JITCodeGenerator() {
-    using namespace current::fncas::x64_native_jit;
+  constexpr static uint8_t const kNoRegister = 0xff;
+  constexpr static node_index_t const kFreeRegister = -1;
+  constexpr static uint8_t const kRegisters = current::fncas::x64_native_jit::kX64NativeJITNumberOfXMMRegisters;
 
-    opcodes::pop_rbx(code);
-    opcodes::ret(code);
+  std::vector<size_t> last_use;         // The index of the last step that uses the value of this node.
+  std::vector<uint8_t> register_of;     // The register holding the value of this node, or `kNoRegister`.
+  std::vector<bool> in_memory;          // Whether the value of this node is in its `rbx`-addressed slot.
+  node_index_t value_in[kRegisters];    // The node the value of which is in this register, or `kFreeRegister`.
 
-#ifdef FNCAS_DEBUG_NATIVE_JIT
-    std::cerr << "end();\n";
-#endif
-  }
+  JITCodeGenerator(std::vector<uint8_t>& code, size_t dim, bool batch = false) : code(code), dim(dim), batch(batch) {}
 
   void jit_compile_node(node_index_t index) {
-    using namespace current::fncas::x64_native_jit;
-
     std::stack<node_index_t> stack;
     stack.push(index);
 
@@ -827,24 +1005,8 @@ struct JITCodeGenerator final {
         if (!computed[i]) {
           computed[i] = true;
           node_impl& node = node_vector_singleton()[i];
-          if (node.type() == NodeType::variable) {
-            int32_t v = node.variable();
-            // Load input variable `v` by address `i + dim`, because the first `dim` of the output are the gradient.
-            // NOTE(dkorolev) / HACK(dkorolev): Perhaps use `rax`, not `xmm0`, for mere value transfer?
-            opcodes::load_from_memory_by_rdi_offset_to_xmm0(code, v);
-            opcodes::store_xmm0_to_memory_by_rbx_offset(code, i + dim);
-#ifdef FNCAS_DEBUG_NATIVE_JIT
-            std::cerr << "# Z[" << i << " + " << dim << "] = X[" << v << "];\n";
-            std::cerr << "load_from_memory_by_rdi_offset_to_xmm0(" << v << ");\n";
-            std::cerr << "store_xmm0_to_memory_by_rbx_offset(" << i + dim << ");\n";
-#endif
-          } else if (node.type() == NodeType::value) {
-            // Load value `node.value()` by address `i + dim`, because the first `dim` of the output are the gradient.
-            opcodes::load_immediate_to_memory_by_rbx_offset(code, i + dim, node.value());
-#ifdef FNCAS_DEBUG_NATIVE_JIT
-            std::cerr << "# Z[" << i << " + " << dim << "] = " << node.value() << ";\n";
-            std::cerr << "load_immediate_to_memory_by_rbx_offset(" << i + dim << ", " << node.value() << ");\n";
-#endif
+          if (node.type() == NodeType::variable || node.type() == NodeType::value) {
+            steps.push_back(Step{StepType::Compute, i, 0u});
           } else if (node.type() == NodeType::operation) {
             stack.push(~i);
             stack.push(node.lhs_index());
@@ -857,58 +1019,434 @@ struct JITCodeGenerator final {
           }
         }
       } else {
-        node_impl& node = node_vector_singleton()[dependent_i];
+        steps.push_back(Step{StepType::Compute, dependent_i, 0u});
+      }
+    }
+  }
+
+  // Stores the value of the already compiled node into the `output_index`-th double of the output, `G[output_index]`.
+  void jit_store_node(node_index_t index, size_t output_index) {
+    steps.push_back(Step{StepType::Store, index, output_index});
+  }
+
+  // Returns the value of the already compiled node, in `xmm0`. Must be the last step. Not available in `batch` mode.
+  void jit_return_node(node_index_t index) {
+    CURRENT_ASSERT(!batch);
+    steps.push_back(Step{StepType::Return, index, 0u});
+  }
+
+  void jit_generate_code() {
+    using namespace current::fncas::x64_native_jit;
+
+    size_t const n = static_cast<size_t>(max_dim) + 1;
+    last_use.assign(n, 0u);
+    register_of.assign(n, kNoRegister);
+    in_memory.assign(n, false);
+    std::fill(std::begin(value_in), std::end(value_in), kFreeRegister);
+
+    for (size_t s = 0; s < steps.size(); ++s) {
+      Step const& step = steps[s];
+      if (step.type == StepType::Compute) {
+        node_impl& node = node_vector_singleton()[step.node];
         if (node.type() == NodeType::operation) {
-          // Perform add/sub/mul/div, all in the operating memory, shifted by `dim`.
-          auto const op = node.operation();
-          opcodes::load_from_memory_by_rbx_offset_to_xmm0(code, node.lhs_index() + dim);
-#ifdef FNCAS_DEBUG_NATIVE_JIT
-          std::cerr << "# Z[" << dependent_i << " + " << dim << "] = Z[" << node.lhs_index() << " + " << dim << "] "
-                    << operation_as_string(op) << " Z[" << node.rhs_index() << " + " << dim << "];\n";
+          last_use[node.lhs_index()] = s;
+          last_use[node.rhs_index()] = s;
+        } else if (node.type() == NodeType::function) {
+          last_use[node.argument_index()] = s;
+        }
+      } else {
+        CURRENT_ASSERT(step.type != StepType::Return || s + 1 == steps.size());
+        last_use[step.node] = s;
+      }
+    }
 
-          std::cerr << "load_from_memory_by_rbx_offset_to_xmm0(" << node.lhs_index() + dim << ");\n";
+    opcodes::push_rbx(code);
+    opcodes::mov_rsi_rbx(code);
+#ifdef FNCAS_DEBUG_NATIVE_JIT
+    std::cerr << "begin();\n";
 #endif
-          if (op == MathOperation::add) {
-            opcodes::add_from_memory_by_rbx_offset_to_xmm0(code, node.rhs_index() + dim);
-          } else if (op == MathOperation::subtract) {
-            opcodes::sub_from_memory_by_rbx_offset_to_xmm0(code, node.rhs_index() + dim);
-          } else if (op == MathOperation::multiply) {
-            opcodes::mul_from_memory_by_rbx_offset_to_xmm0(code, node.rhs_index() + dim);
-          } else if (op == MathOperation::divide) {
-            opcodes::div_from_memory_by_rbx_offset_to_xmm0(code, node.rhs_index() + dim);
+
+    for (size_t s = 0; s < steps.size(); ++s) {
+      Step const& step = steps[s];
+      node_index_t const i = step.node;
+      if (step.type == StepType::Compute) {
+        node_impl& node = node_vector_singleton()[i];
+        if (node.type() == NodeType::operation) {
+          generate_operation(s, i, node.operation(), node.lhs_index(), node.rhs_index());
+        } else if (node.type() == NodeType::function) {
+          if (node.function() == MathFunction::sqr) {
+            // Inline `sqr(x)` as `x * x`, which saves a call, and thus the spills before it.
+            generate_operation(s, i, MathOperation::multiply, node.argument_index(), node.argument_index());
+          } else if (batch && node.function() == MathFunction::sqrt) {
+            generate_batch_sqrt(s, i, node.argument_index());
           } else {
-            CURRENT_ASSERT(false);
+            generate_function_call(s, i, node.function(), node.argument_index());
           }
-          opcodes::store_xmm0_to_memory_by_rbx_offset(code, dependent_i + dim);
+        }
+        // The variables and the constants are loaded lazily, when and if they need to be in a register.
+      } else if (step.type == StepType::Store) {
+        if (!batch && register_of[i] == kNoRegister && node_vector_singleton()[i].type() == NodeType::value) {
+          opcodes::load_immediate_to_memory_by_rbx_offset(code, step.output_index, node_vector_singleton()[i].value());
+        } else {
+          generate_store(ensure_in_register(i, 0u), step.output_index);
+        }
 #ifdef FNCAS_DEBUG_NATIVE_JIT
-          std::cerr << std::string(operation_as_assembler_opcode(op)).substr(0, 3)
-                    << "_from_memory_by_rbx_offset_to_xmm0(" << node.rhs_index() + dim << ");\n";
-          std::cerr << "store_xmm0_to_memory_by_rbx_offset(" << dependent_i + dim << ");\n";
+        std::cerr << "# G[" << step.output_index << "] = Z[" << i << " + " << dim << "];\n";
 #endif
-        } else if (node.type() == NodeType::function) {
-          opcodes::load_from_memory_by_rbx_offset_to_xmm0(code, node.argument_index() + dim);
-          opcodes::push_rdi(code);
-          opcodes::push_rdx(code);
-          opcodes::call_function_from_rdx_pointers_array_by_index(code, static_cast<uint8_t>(node.function()));
-          opcodes::pop_rdx(code);
-          opcodes::pop_rdi(code);
-          opcodes::store_xmm0_to_memory_by_rbx_offset(code, dependent_i + dim);
+        release_if_last_use(i, s);
+      } else {
+        if (register_of[i] == kNoRegister) {
+          load_into_register(i, 0);
+        } else if (register_of[i] != 0) {
+          opcodes::mov_xmm_to_xmm(code, 0, register_of[i]);
+        }
 #ifdef FNCAS_DEBUG_NATIVE_JIT
-          std::cerr << "# Z[" << dependent_i << " + " << dim << "] = " << function_as_string(node.function()) << "(Z["
-                    << node.argument_index() << " + " << dim << "]);\n";
-          std::cerr << "load_from_memory_by_rbx_offset_to_xmm0(" << node.argument_index() + dim << ");\n";
-          std::cerr << "push_rdi();\n";
-          std::cerr << "push_rdx();\n";
-          std::cerr << "call_function_from_rdx_pointers_array_by_index(" << static_cast<int>(node.function()) << ");\n";
-          std::cerr << "pop_rdx();\n";
-          std::cerr << "pop_rdi();\n";
-          std::cerr << "store_xmm0_to_memory_by_rbx_offset(" << dependent_i + dim << ");\n";
+        std::cerr << "# return Z[" << i << " + " << dim << "];\n";
 #endif
-        } else {
-          CURRENT_ASSERT(false);
+      }
+    }
+
+    if (batch) {
+      opcodes::vzeroupper(code);  // The caller may well be the legacy SSE code.
+    }
+    opcodes::pop_rbx(code);
+    opcodes::ret(code);
+#ifdef FNCAS_DEBUG_NATIVE_JIT
+    std::cerr << "end();\n";
+#endif
+  }
+
+ private:
+  static bool is_reloadable(node_index_t i) {
+    NodeType const type = node_vector_singleton()[i].type();
+    return type == NodeType::variable || type == NodeType::value;
+  }
+
+  bool dies_in_register(node_index_t i, size_t s) const { return register_of[i] != kNoRegister && last_use[i] == s; }
+
+  void bind(uint8_t r, node_index_t i) {
+    value_in[r] = i;
+    register_of[i] = r;
+  }
+
+  void unbind(uint8_t r) {
+    register_of[value_in[r]] = kNoRegister;
+    value_in[r] = kFreeRegister;
+  }
+
+  void spill_if_needed(uint8_t r) {
+    using namespace current::fncas::x64_native_jit;
+    node_index_t const i = value_in[r];
+    if (!in_memory[i] && !is_reloadable(i)) {
+      generate_store(r, i + dim);
+      in_memory[i] = true;
+#ifdef FNCAS_DEBUG_NATIVE_JIT
+      std::cerr << "# spill Z[" << i << " + " << dim << "] from xmm" << static_cast<int>(r) << ";\n";
+#endif
+    }
+  }
+
+  // Returns a free register, other than the `pinned` ones, evicting the value with the farthest last use if needed.
+  uint8_t allocate_register(uint16_t pinned) {
+    uint8_t victim = kNoRegister;
+    for (uint8_t r = 0; r < kRegisters; ++r) {
+      if (!(pinned & (1u << r))) {
+        if (value_in[r] == kFreeRegister) {
+          return r;
+        }
+        if (victim == kNoRegister || last_use[value_in[r]] > last_use[value_in[victim]]) {
+          victim = r;
         }
       }
     }
+    CURRENT_ASSERT(victim != kNoRegister);
+    spill_if_needed(victim);
+    unbind(victim);
+    return victim;
+  }
+
+  static uint16_t mask_of(uint8_t r) { return r == kNoRegister ? 0u : static_cast<uint16_t>(1u << r); }
+
+  // Loads the value of the node, which is not in any register, into the register `r`, without binding it.
+  void load_into_register(node_index_t i, uint8_t r) {
+    using namespace current::fncas::x64_native_jit;
+    node_impl& node = node_vector_singleton()[i];
+    if (node.type() == NodeType::variable) {
+      if (!batch) {
+        opcodes::load_from_memory_by_rdi_offset_to_xmm(code, r, node.variable());
+      } else {
+        opcodes::load_from_memory_by_rdi_offset_to_ymm(code, r, node.variable());
+      }
+    } else if (node.type() == NodeType::value) {
+      if (!batch) {
+        opcodes::load_immediate_to_xmm(code, r, node.value());
+      } else {
+        opcodes::load_immediate_to_ymm(code, r, node.value());
+      }
+    } else {
+      CURRENT_ASSERT(in_memory[i]);
+      if (!batch) {
+        opcodes::load_from_memory_by_rbx_offset_to_xmm(code, r, i + dim);
+      } else {
+        opcodes::load_from_memory_by_rbx_offset_to_ymm(code, r, i + dim);
+      }
+    }
+  }
+
+  void generate_store(uint8_t r, size_t offset) {
+    using namespace current::fncas::x64_native_jit;
+    if (!batch) {
+      opcodes::store_xmm_to_memory_by_rbx_offset(code, r, offset);
+    } else {
+      opcodes::store_ymm_to_memory_by_rbx_offset(code, r, offset);
+    }
+  }
+
+  void generate_mov(uint8_t dst, uint8_t src) {
+    using namespace current::fncas::x64_native_jit;
+    if (!batch) {
+      opcodes::mov_xmm_to_xmm(code, dst, src);
+    } else {
+      opcodes::mov_ymm_to_ymm(code, dst, src);
+    }
+  }
+
+  uint8_t ensure_in_register(node_index_t i, uint16_t pinned) {
+    if (register_of[i] == kNoRegister) {
+      uint8_t const r = allocate_register(pinned);
+      load_into_register(i, r);
+      bind(r, i);
+    }
+    return register_of[i];
+  }
+
+  void release_if_last_use(node_index_t i, size_t s) {
+    if (dies_in_register(i, s)) {
+      unbind(register_of[i]);
+    }
+  }
+
+  // `Z[i] = Z[lhs] {op} Z[rhs]`, computed in the register of `lhs` if this is its last use, or in a fresh one.
+  void generate_operation(size_t s, node_index_t i, MathOperation op, node_index_t lhs, node_index_t rhs) {
+    using namespace current::fncas::x64_native_jit;
+
+    if ((op == MathOperation::add || op == MathOperation::multiply) && !dies_in_register(lhs, s) &&
+        dies_in_register(rhs, s)) {
+      std::swap(lhs, rhs);
+    }
+
+    uint8_t dst;
+    if (dies_in_register(lhs, s)) {
+      dst = register_of[lhs];
+      register_of[lhs] = kNoRegister;
+    } else {
+      uint8_t const lhs_register = register_of[lhs];
+      dst = allocate_register(mask_of(lhs_register) | mask_of(register_of[rhs]));
+      if (lhs_register != kNoRegister) {
+        generate_mov(dst, lhs_register);
+      } else {
+        load_into_register(lhs, dst);
+      }
+    }
+    value_in[dst] = i;  // Keeps `dst` taken, in case `rhs` has to be loaded into a register.
+
+    if (rhs == lhs) {
+      generate_xmm_operation(op, dst, dst);
+    } else if (register_of[rhs] != kNoRegister) {
+      generate_xmm_operation(op, dst, register_of[rhs]);
+    } else if (node_vector_singleton()[rhs].type() == NodeType::variable) {
+      int32_t const v = node_vector_singleton()[rhs].variable();
+      if (batch) {
+        generate_ymm_operation_from_rdi_offset(op, dst, v);
+      } else if (op == MathOperation::add) {
+        opcodes::add_from_memory_by_rdi_offset_to_xmm(code, dst, v);
+      } else if (op == MathOperation::subtract) {
+        opcodes::sub_from_memory_by_rdi_offset_to_xmm(code, dst, v);
+      } else if (op == MathOperation::multiply) {
+        opcodes::mul_from_memory_by_rdi_offset_to_xmm(code, dst, v);
+      } else if (op == MathOperation::divide) {
+        opcodes::div_from_memory_by_rdi_offset_to_xmm(code, dst, v);
+      } else {
+        CURRENT_ASSERT(false);
+      }
+    } else if (in_memory[rhs]) {
+      if (batch) {
+        generate_ymm_operation_from_rbx_offset(op, dst, rhs + dim);
+      } else if (op == MathOperation::add) {
+        opcodes::add_from_memory_by_rbx_offset_to_xmm(code, dst, rhs + dim);
+      } else if (op == MathOperation::subtract) {
+        opcodes::sub_from_memory_by_rbx_offset_to_xmm(code, dst, rhs + dim);
+      } else if (op == MathOperation::multiply) {
+        opcodes::mul_from_memory_by_rbx_offset_to_xmm(code, dst, rhs + dim);
+      } else if (op == MathOperation::divide) {
+        opcodes::div_from_memory_by_rbx_offset_to_xmm(code, dst, rhs + dim);
+      } else {
+        CURRENT_ASSERT(false);
+      }
+    } else {
+      generate_xmm_operation(op, dst, ensure_in_register(rhs, mask_of(dst)));
+    }
+
+    release_if_last_use(lhs, s);
+    release_if_last_use(rhs, s);
+    bind(dst, i);
+    in_memory[i] = false;
+
+#ifdef FNCAS_DEBUG_NATIVE_JIT
+    std::cerr << "# Z[" << i << " + " << dim << "] = Z[" << lhs << " + " << dim << "] " << operation_as_string(op)
+              << " Z[" << rhs << " + " << dim << "];  // In xmm" << static_cast<int>(dst) << ".\n";
+#endif
+  }
+
+  void generate_xmm_operation(MathOperation op, uint8_t dst, uint8_t src) {
+    using namespace current::fncas::x64_native_jit;
+    if (batch) {
+      generate_ymm_operation(op, dst, src);
+    } else if (op == MathOperation::add) {
+      opcodes::add_xmm_to_xmm(code, dst, src);
+    } else if (op == MathOperation::subtract) {
+      opcodes::sub_xmm_from_xmm(code, dst, src);
+    } else if (op == MathOperation::multiply) {
+      opcodes::mul_xmm_by_xmm(code, dst, src);
+    } else if (op == MathOperation::divide) {
+      opcodes::div_xmm_by_xmm(code, dst, src);
+    } else {
+      CURRENT_ASSERT(false);
+    }
+  }
+
+  void generate_ymm_operation(MathOperation op, uint8_t dst, uint8_t src) {
+    using namespace current::fncas::x64_native_jit;
+    if (op == MathOperation::add) {
+      opcodes::add_ymm_to_ymm(code, dst, src);
+    } else if (op == MathOperation::subtract) {
+      opcodes::sub_ymm_from_ymm(code, dst, src);
+    } else if (op == MathOperation::multiply) {
+      opcodes::mul_ymm_by_ymm(code, dst, src);
+    } else if (op == MathOperation::divide) {
+      opcodes::div_ymm_by_ymm(code, dst, src);
+    } else {
+      CURRENT_ASSERT(false);
+    }
+  }
+
+  void generate_ymm_operation_from_rdi_offset(MathOperation op, uint8_t dst, int32_t offset) {
+    using namespace current::fncas::x64_native_jit;
+    if (op == MathOperation::add) {
+      opcodes::add_from_memory_by_rdi_offset_to_ymm(code, dst, offset);
+    } else if (op == MathOperation::subtract) {
+      opcodes::sub_from_memory_by_rdi_offset_to_ymm(code, dst, offset);
+    } else if (op == MathOperation::multiply) {
+      opcodes::mul_from_memory_by_rdi_offset_to_ymm(code, dst, offset);
+    } else if (op == MathOperation::divide) {
+      opcodes::div_from_memory_by_rdi_offset_to_ymm(code, dst, offset);
+    } else {
+      CURRENT_ASSERT(false);
+    }
+  }
+
+  void generate_ymm_operation_from_rbx_offset(MathOperation op, uint8_t dst, size_t offset) {
+    using namespace current::fncas::x64_native_jit;
+    if (op == MathOperation::add) {
+      opcodes::add_from_memory_by_rbx_offset_to_ymm(code, dst, offset);
+    } else if (op == MathOperation::subtract) {
+      opcodes::sub_from_memory_by_rbx_offset_to_ymm(code, dst, offset);
+    } else if (op == MathOperation::multiply) {
+      opcodes::mul_from_memory_by_rbx_offset_to_ymm(code, dst, offset);
+    } else if (op == MathOperation::divide) {
+      opcodes::div_from_memory_by_rbx_offset_to_ymm(code, dst, offset);
+    } else {
+      CURRENT_ASSERT(false);
+    }
+  }
+
+  // `Z[i] = sqrt(Z[argument])` in `batch` mode, as `vsqrtpd` is exact, same as `std::sqrt()`, unlike `exp`, `log`, etc.
+  void generate_batch_sqrt(size_t s, node_index_t i, node_index_t argument) {
+    using namespace current::fncas::x64_native_jit;
+    uint8_t const src = ensure_in_register(argument, 0u);
+    uint8_t dst;
+    if (dies_in_register(argument, s)) {
+      dst = src;
+      unbind(src);
+    } else {
+      dst = allocate_register(mask_of(src));
+    }
+    opcodes::sqrt_ymm_to_ymm(code, dst, src);
+    bind(dst, i);
+    in_memory[i] = false;
+  }
+
+  void spill_before_call(size_t s) {
+    for (uint8_t r = 0; r < kRegisters; ++r) {
+      if (value_in[r] != kFreeRegister && last_use[value_in[r]] > s) {
+        spill_if_needed(r);
+      }
+    }
+  }
+
+  void unbind_all_registers() {
+    for (uint8_t r = 0; r < kRegisters; ++r) {
+      if (value_in[r] != kFreeRegister) {
+        unbind(r);
+      }
+    }
+  }
+
+  // `Z[i] = f(Z[argument])`. Spills the values still needed after the call, as it clobbers all the `xmm` registers.
+  void generate_function_call(size_t s, node_index_t i, MathFunction function, node_index_t argument) {
+    using namespace current::fncas::x64_native_jit;
+
+    if (batch) {
+      generate_batch_function_call(s, i, function, argument);
+      return;
+    }
+
+    spill_before_call(s);
+
+    if (register_of[argument] == kNoRegister) {
+      load_into_register(argument, 0);
+    } else if (register_of[argument] != 0) {
+      opcodes::mov_xmm_to_xmm(code, 0, register_of[argument]);
+    }
+
+    opcodes::push_rdi(code);
+    opcodes::push_rdx(code);
+    opcodes::call_function_from_rdx_pointers_array_by_index(code, static_cast<uint8_t>(function));
+    opcodes::pop_rdx(code);
+    opcodes::pop_rdi(code);
+
+    unbind_all_registers();
+    bind(0, i);
+    in_memory[i] = false;
+
+#ifdef FNCAS_DEBUG_NATIVE_JIT
+    std::cerr << "# Z[" << i << " + " << dim << "] = " << function_as_string(function) << "(Z[" << argument << " + "
+              << dim << "]);  // In xmm0.\n";
+#endif
+  }
+
+  // `Z[i] = f(Z[argument])` in `batch` mode: the argument is copied into the slot of `Z[i]`, and `f` works in place.
+  void generate_batch_function_call(size_t s, node_index_t i, MathFunction function, node_index_t argument) {
+    using namespace current::fncas::x64_native_jit;
+
+    spill_before_call(s);
+    generate_store(ensure_in_register(argument, 0u), i + dim);
+
+    opcodes::push_rdi(code);
+    opcodes::push_rdx(code);
+    opcodes::lea_rbx_offset_to_rdi(code, i + dim);
+    opcodes::vzeroupper(code);
+    opcodes::call_function_from_rdx_pointers_array_by_index(code, static_cast<uint8_t>(function));
+    opcodes::pop_rdx(code);
+    opcodes::pop_rdi(code);
+
+    unbind_all_registers();
+    in_memory[i] = true;
+
+#ifdef FNCAS_DEBUG_NATIVE_JIT
+    std::cerr << "# Z[" << i << " + " << dim << "] = " << function_as_string(function) << "(Z[" << argument << " + "
+              << dim << "]);  // In memory.\n";
+#endif
   }
 };
 
@@ -924,22 +1462,79 @@ struct x64_native_jit_function_pointers {
   }
 };
 
+// The batch flavor of an external function: applies it in place to `kX64NativeJITBatchSize` consecutive doubles.
+// NOTE(dkorolev): This is the place to plug in a SIMD math library, the generated code would not change.
+template <double (*F)(double)>
+void x64_native_jit_batch_function(double* p) {
+  for (size_t k = 0; k < current::fncas::x64_native_jit::kX64NativeJITBatchSize; ++k) {
+    p[k] = F(p[k]);
+  }
+}
+
+struct x64_native_jit_batch_function_pointers {
+  std::vector<void (*)(double* x)> p;
+  x64_native_jit_batch_function_pointers() {
+#define FNCAS_FUNCTION(f) p.push_back(x64_native_jit_batch_function<fncas::f>);
+#include "fncas_functions.dsl.h"
+#undef FNCAS_FUNCTION
+  }
+  static x64_native_jit_batch_function_pointers& tls() {
+    return current::ThreadLocalSingleton<x64_native_jit_batch_function_pointers>();
+  }
+};
+
+// Interleaves up to `kX64NativeJITBatchSize` points, starting from `points[begin]`, into the `pf_batch_t` layout.
+// The missing trailing points, if any, are filled by repeating the last one.
+inline void x64_native_jit_interleave_batch(const std::vector<std::vector<double>>& points,
+                                            size_t begin,
+                                            std::vector<double>& x) {
+  using current::fncas::x64_native_jit::kX64NativeJITBatchSize;
+  size_t const dim = points[begin].size();
+  x.resize(dim * kX64NativeJITBatchSize);
+  for (size_t k = 0; k < kX64NativeJITBatchSize; ++k) {
+    std::vector<double> const& point = points[std::min(begin + k, points.size() - 1)];
+    CURRENT_ASSERT(point.size() == dim);
+    for (size_t i = 0; i < dim; ++i) {
+      x[i * kX64NativeJITBatchSize + k] = point[i];
+    }
+  }
+}
+
 struct f_compiled_x64_native_jit final {
-  std::unique_ptr<current::fncas::x64_native_jit::CallableVectorUInt8> jit_compiled_code;
-  mutable std::vector<double> actual_heap;
+  // The code is immutable, and is shared with the copies made from `compiled_code_cache`.
+  std::shared_ptr<const current::fncas::x64_native_jit::CallableVectorUInt8> jit_compiled_code;
+  size_t heap_size = 0u;  // In doubles, for the per-thread `compiled_evaluation_scratch`.
+
+  // The `kX64NativeJITBatchSize`-points code, if the CPU supports AVX2, and the size of its heap.
+  std::shared_ptr<const current::fncas::x64_native_jit::CallableVectorUInt8> jit_compiled_batch_code;
+  size_t batch_heap_size = 0u;
+
+  struct uncached_t final {};
+
+  void generate_batch_code_for_f(V const& v) {
+    using current::fncas::x64_native_jit::kX64NativeJITBatchSize;
+    std::vector<uint8_t> code;
+    size_t required_heap_size;
+    {
+      // The result goes into `G[0]`, so the intermediate values are shifted by one.
+      JITCodeGenerator code_generator(code, 1u, true);
+      code_generator.jit_compile_node(v.index());
+      code_generator.jit_store_node(v.index(), 0u);
+      code_generator.jit_generate_code();
+      required_heap_size = 1u + code_generator.max_dim + 1;
+    }
+    jit_compiled_batch_code = std::make_shared<const current::fncas::x64_native_jit::CallableVectorUInt8>(code);
+    batch_heap_size = required_heap_size * kX64NativeJITBatchSize;
+  }
 
   void generate_code_for_f(V const& v) {
     std::vector<uint8_t> code;
     size_t required_heap_size;
     {
-      using namespace current::fncas::x64_native_jit;
       JITCodeGenerator code_generator(code, 0);
       code_generator.jit_compile_node(v.index());
-      opcodes::load_from_memory_by_rbx_offset_to_xmm0(code, v.index());
-#ifdef FNCAS_DEBUG_NATIVE_JIT
-      std::cerr << "# return Z[" << v.index() << "];\n";
-      std::cerr << "load_from_memory_by_rbx_offset_to_xmm0(" << v.index() << ");\n";
-#endif
+      code_generator.jit_return_node(v.index());
+      code_generator.jit_generate_code();
       required_heap_size = code_generator.max_dim + 1;
     }
 #ifdef FNCAS_DEBUG_NATIVE_JIT
@@ -950,16 +1545,54 @@ struct f_compiled_x64_native_jit final {
     std::cerr << "\nHeap size: " << required_heap_size << '\n';
     std::cerr << "Desired index: " << v.index() << '\n';
 #endif
-    jit_compiled_code = std::make_unique<current::fncas::x64_native_jit::CallableVectorUInt8>(code);
-    actual_heap.resize(required_heap_size);
+    jit_compiled_code = std::make_shared<const current::fncas::x64_native_jit::CallableVectorUInt8>(code);
+    heap_size = required_heap_size;
+    if (current::fncas::x64_native_jit::X64NativeJITBatchSupported()) {
+      generate_batch_code_for_f(v);
+    }
   }
 
-  explicit f_compiled_x64_native_jit(V const& node) { generate_code_for_f(node); }
+  f_compiled_x64_native_jit(uncached_t, V const& simplified_node) { generate_code_for_f(simplified_node); }
 
-  explicit f_compiled_x64_native_jit(const f_impl<JIT::Blueprint>& f) { generate_code_for_f(f.f_); }
+  static std::shared_ptr<const f_compiled_x64_native_jit> cached(V const& node) {
+    V const simplified_node = simplify_node(node);
+    return compiled_code_cache::instance().get<f_compiled_x64_native_jit>(
+        compiled_code_cache::key("f_x64_native_jit", {simplified_node.index_}), [&simplified_node]() {
+          compiled_code_cache::instance().RegisterMiss();
+          return std::make_shared<const f_compiled_x64_native_jit>(uncached_t(), simplified_node);
+        });
+  }
+
+  explicit f_compiled_x64_native_jit(V const& node) : f_compiled_x64_native_jit(*cached(node)) {}
+
+  explicit f_compiled_x64_native_jit(const f_impl<JIT::Blueprint>& f) : f_compiled_x64_native_jit(*cached(f.f_)) {}
 
   double operator()(const std::vector<double>& x) const {
-    return (*jit_compiled_code)(&x[0], &actual_heap[0], &x64_native_jit_function_pointers::tls().p[0]);
+    return (*jit_compiled_code)(&x[0],
+                                compiled_evaluation_scratch::tls().heap_of_size(heap_size),
+                                &x64_native_jit_function_pointers::tls().p[0]);
+  }
+
+  // Evaluates the function on many points, `kX64NativeJITBatchSize` at a time if the CPU supports AVX2.
+  std::vector<double> batch(const std::vector<std::vector<double>>& points) const {
+    using current::fncas::x64_native_jit::kX64NativeJITBatchSize;
+    std::vector<double> result(points.size());
+    if (!jit_compiled_batch_code) {
+      for (size_t j = 0; j < points.size(); ++j) {
+        result[j] = operator()(points[j]);
+      }
+      return result;
+    }
+    compiled_evaluation_scratch& scratch = compiled_evaluation_scratch::tls();
+    double* heap = scratch.heap_of_size(batch_heap_size);
+    for (size_t j = 0; j < points.size(); j += kX64NativeJITBatchSize) {
+      x64_native_jit_interleave_batch(points, j, scratch.batch_x);
+      jit_compiled_batch_code->batch(&scratch.batch_x[0], heap, &x64_native_jit_batch_function_pointers::tls().p[0]);
+      for (size_t k = 0; k < kX64NativeJITBatchSize && j + k < points.size(); ++k) {
+        result[j + k] = heap[k];
+      }
+    }
+    return result;
   }
 
   // For backwards "compatibility" with the unit tests. -- D.K.
@@ -968,49 +1601,103 @@ struct f_compiled_x64_native_jit final {
 
 struct g_compiled_x64_native_jit final {
   size_t const dim;
-  std::unique_ptr<current::fncas::x64_native_jit::CallableVectorUInt8> jit_compiled_code;
-  mutable std::vector<double> actual_heap;
+  // The code is immutable, and is shared with the copies made from `compiled_code_cache`.
+  std::shared_ptr<const current::fncas::x64_native_jit::CallableVectorUInt8> jit_compiled_code;
+  size_t heap_size = 0u;  // In doubles, for the per-thread `compiled_evaluation_scratch`.
+
+  // The `kX64NativeJITBatchSize`-points code, if the CPU supports AVX2, and the size of its heap.
+  std::shared_ptr<const current::fncas::x64_native_jit::CallableVectorUInt8> jit_compiled_batch_code;
+  size_t batch_heap_size = 0u;
 
   void generate_code_for_g(JITCodeGenerator& code_generator, V const& v, size_t output_index) {
-    using namespace current::fncas::x64_native_jit;
     code_generator.jit_compile_node(v.index());
-    opcodes::load_from_memory_by_rbx_offset_to_xmm0(code_generator.code, v.index() + dim);
-    opcodes::store_xmm0_to_memory_by_rbx_offset(code_generator.code, output_index);
-#ifdef FNCAS_DEBUG_NATIVE_JIT
-    std::cerr << "# G[" << output_index << "] = Z[" << v.index() << " + " << dim << "];\n";
-    std::cerr << "load_from_memory_by_rbx_offset_to_xmm0(" << v.index() + dim << ");\n";
-    std::cerr << "store_xmm0_to_memory_by_rbx_offset(" << output_index << ");\n";
-#endif
+    code_generator.jit_store_node(v.index(), output_index);
+  }
+
+  static std::shared_ptr<const g_compiled_x64_native_jit> cached(const g_impl<JIT::Blueprint>& g) {
+    CURRENT_ASSERT(g.g_.size() == internals_singleton().dim_);
+    std::vector<node_index_t> g_indexes(g.g_.size());
+    for (size_t i = 0; i < g_indexes.size(); ++i) {
+      g_indexes[i] = g.g_[i].index_;
+    }
+    simplify_nodes(g_indexes);
+    return compiled_code_cache::instance().get<g_compiled_x64_native_jit>(
+        compiled_code_cache::key("g_x64_native_jit", g_indexes), [&g_indexes]() {
+          compiled_code_cache::instance().RegisterMiss();
+          return std::make_shared<const g_compiled_x64_native_jit>(g_indexes);
+        });
   }
 
   g_compiled_x64_native_jit(const f_impl<JIT::Blueprint>& unused_f, const g_impl<JIT::Blueprint>& g)
-      : dim(g.g_.size()) {
-    CURRENT_ASSERT(dim == internals_singleton().dim_);
+      : g_compiled_x64_native_jit(*cached(g)) {
+    static_cast<void>(unused_f);
+  }
+
+  // Generates the code for the already simplified `g_indexes`, bypassing the cache.
+  explicit g_compiled_x64_native_jit(const std::vector<node_index_t>& g_indexes) : dim(g_indexes.size()) {
     std::vector<uint8_t> code;
     {
       JITCodeGenerator code_generator(code, dim);
-      static_cast<void>(unused_f);
       for (size_t i = 0; i < dim; ++i) {
-        generate_code_for_g(code_generator, g.g_[i], i);
+        generate_code_for_g(code_generator, from_index(g_indexes[i]), i);
       }
+      code_generator.jit_generate_code();
       CURRENT_ASSERT(static_cast<size_t>(code_generator.max_dim + 1) >= dim);
-      actual_heap.resize(dim + code_generator.max_dim + 1);
+      heap_size = dim + code_generator.max_dim + 1;
     }
 #ifdef FNCAS_DEBUG_NATIVE_JIT
     std::cerr << "Code:";
     for (uint8_t c : code) {
       fprintf(stderr, " %02x", int(c));
     }
-    std::cerr << "\nHeap size: " << actual_heap.size() << '\n';
+    std::cerr << "\nHeap size: " << heap_size << '\n';
 #endif
-    jit_compiled_code = std::make_unique<current::fncas::x64_native_jit::CallableVectorUInt8>(code);
+    jit_compiled_code = std::make_shared<const current::fncas::x64_native_jit::CallableVectorUInt8>(code);
+
+    if (current::fncas::x64_native_jit::X64NativeJITBatchSupported()) {
+      using current::fncas::x64_native_jit::kX64NativeJITBatchSize;
+      std::vector<uint8_t> batch_code;
+      JITCodeGenerator code_generator(batch_code, dim, true);
+      for (size_t i = 0; i < dim; ++i) {
+        generate_code_for_g(code_generator, from_index(g_indexes[i]), i);
+      }
+      code_generator.jit_generate_code();
+      jit_compiled_batch_code = std::make_shared<const current::fncas::x64_native_jit::CallableVectorUInt8>(batch_code);
+      batch_heap_size = (dim + code_generator.max_dim + 1) * kX64NativeJITBatchSize;
+    }
   }
 
-  // NOTE(dkorolev): Perhaps just return a pointer to `&actual_heap[0]` to avoid a copy?
+  // NOTE(dkorolev): Perhaps just return a pointer to the heap to avoid a copy?
   // NOTE(dkorolev): This would require looking into the optimizer(s) code, I'll do it some time later.
   std::vector<double> operator()(const std::vector<double>& x) const {
-    (*jit_compiled_code)(&x[0], &actual_heap[0], &x64_native_jit_function_pointers::tls().p[0]);
-    return std::vector<double>(&actual_heap[0], &actual_heap[0] + dim);
+    double* heap = compiled_evaluation_scratch::tls().heap_of_size(heap_size);
+    (*jit_compiled_code)(&x[0], heap, &x64_native_jit_function_pointers::tls().p[0]);
+    return std::vector<double>(heap, heap + dim);
+  }
+
+  // Evaluates the gradient on many points, `kX64NativeJITBatchSize` at a time if the CPU supports AVX2.
+  std::vector<std::vector<double>> batch(const std::vector<std::vector<double>>& points) const {
+    using current::fncas::x64_native_jit::kX64NativeJITBatchSize;
+    std::vector<std::vector<double>> result(points.size());
+    if (!jit_compiled_batch_code) {
+      for (size_t j = 0; j < points.size(); ++j) {
+        result[j] = operator()(points[j]);
+      }
+      return result;
+    }
+    compiled_evaluation_scratch& scratch = compiled_evaluation_scratch::tls();
+    double* heap = scratch.heap_of_size(batch_heap_size);
+    for (size_t j = 0; j < points.size(); j += kX64NativeJITBatchSize) {
+      x64_native_jit_interleave_batch(points, j, scratch.batch_x);
+      jit_compiled_batch_code->batch(&scratch.batch_x[0], heap, &x64_native_jit_batch_function_pointers::tls().p[0]);
+      for (size_t k = 0; k < kX64NativeJITBatchSize && j + k < points.size(); ++k) {
+        result[j + k].resize(dim);
+        for (size_t i = 0; i < dim; ++i) {
+          result[j + k][i] = heap[i * kX64NativeJITBatchSize + k];
+        }
+      }
+    }
+    return result;
   }
 
   // For backwards "compatibility" with the unit tests. -- D.K.
@@ -1023,23 +1710,23 @@ struct g_compiled_super : g_super {};
 
 template <JIT JIT_IMPLEMENTATION>
 struct g_compiled final : g_compiled_super {
-  fncas::impl::compiled_expression c_;
+  std::shared_ptr<const fncas::impl::compiled_expression> c_;  // Shared with `compiled_code_cache`.
 
   explicit g_compiled(const f_impl<JIT::Blueprint>& f, const g_impl<JIT::Blueprint>& g)
       : c_(compile_eval_g<JIT_IMPLEMENTATION>(f.f_, g.g_)) {
-    CURRENT_ASSERT(c_.HasGradient());
+    CURRENT_ASSERT(c_->HasGradient());
   }
 
   g_compiled(const g_compiled&) = delete;
   void operator=(const g_compiled&) = delete;
-  g_compiled(g_compiled&& rhs) : c_(std::move(rhs.c_)) { CURRENT_ASSERT(c_.HasGradient()); }
+  g_compiled(g_compiled&& rhs) : c_(std::move(rhs.c_)) { CURRENT_ASSERT(c_->HasGradient()); }
 
-  std::vector<double> operator()(const std::vector<double>& x) const override { return c_.compute_compiled_g(x); }
+  std::vector<double> operator()(const std::vector<double>& x) const override { return c_->compute_compiled_g(x); }
 
-  size_t dim() const override { return c_.dim(); }
-  size_t heap_size() const override { return c_.heap_size(); }
+  size_t dim() const override { return c_->dim(); }
+  size_t heap_size() const override { return c_->heap_size(); }
 
-  const std::string& lib_filename() const { return c_.lib_filename(); }
+  const std::string& lib_filename() const { return c_->lib_filename(); }
 };
 
 // Expose JIT-compiled functions as `fncas::function_t<JIT::*>`.
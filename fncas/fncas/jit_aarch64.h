@@ -0,0 +1,462 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2023 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// The AArch64 native JIT, `JIT::AArch64NativeJIT`, the counterpart of `JIT::X64NativeJIT` from `jit.h`.
+//
+// The code generator is available on every platform, so that its output can be tested on x64 as well.
+// The `function_t<>` and `gradient_t<>` wrappers, which run the code, are only available on AArch64.
+
+#ifndef FNCAS_FNCAS_JIT_AARCH64_H
+#define FNCAS_FNCAS_JIT_AARCH64_H
+
+#ifndef FNCAS_USE_LONG_DOUBLE
+
+#include <algorithm>
+#include <memory>
+#include <stack>
+#include <vector>
+
+#include "../../bricks/util/singleton.h"
+
+#include "../aarch64_native_jit/aarch64_native_jit.h"
+
+#include "base.h"
+#include "node.h"
+#include "differentiate.h"
+#include "simplify.h"
+
+namespace fncas {
+namespace impl {
+
+// The AArch64 code generator, with the same steps and the same linear-scan register allocator as `JITCodeGenerator`.
+//
+// The allocator works with 23 registers, which are `d0` .. `d7` and `d16` .. `d30`. None of them are callee-saved,
+// so the generated code does not have to preserve them, and all of them are clobbered by the external calls.
+// The `d8` .. `d15` registers are not used, and `d31` is the scratch one, for the operands that are not in registers.
+//
+// Unlike on x64, the arithmetic instructions have three register operands, so the result goes directly into
+// the register of the operand that is used for the last time, if any, with no extra `mov`-s. Also, `sqrt` is inlined
+// as `fsqrt`, which is exact, same as `std::sqrt()`.
+struct AArch64JITCodeGenerator final {
+  std::vector<uint32_t>& code;
+  size_t const dim;  // "Pre-allocated" in the output vector, 0 for function computation, dim. of `x` for gradients.
+
+  std::vector<bool> computed;
+  node_index_t max_dim = 0;
+
+  enum class StepType : uint8_t { Compute, Store, Return };
+  struct Step {
+    StepType type;
+    node_index_t node;
+    size_t output_index;
+  };
+  std::vector<Step> steps;
+
+  constexpr static uint8_t const kNoRegister = 0xff;
+  constexpr static node_index_t const kFreeRegister = -1;
+  constexpr static uint8_t const kRegisters = 23;
+
+  std::vector<size_t> last_use;       // The index of the last step that uses the value of this node.
+  std::vector<uint8_t> register_of;   // The register holding the value of this node, or `kNoRegister`.
+  std::vector<bool> in_memory;        // Whether the value of this node is in its `x19`-addressed slot.
+  node_index_t value_in[kRegisters];  // The node the value of which is in this register, or `kFreeRegister`.
+
+  AArch64JITCodeGenerator(std::vector<uint32_t>& code, size_t dim) : code(code), dim(dim) {}
+
+  void jit_compile_node(node_index_t index) {
+    std::stack<node_index_t> stack;
+    stack.push(index);
+
+    while (!stack.empty()) {
+      const node_index_t i = stack.top();
+      stack.pop();
+      const node_index_t dependent_i = ~i;
+      if (i > dependent_i) {
+        max_dim = std::max(max_dim, static_cast<node_index_t>(i));
+        if (computed.size() <= static_cast<size_t>(i)) {
+          computed.resize(static_cast<size_t>(i) + 1);
+        }
+        if (!computed[i]) {
+          computed[i] = true;
+          node_impl& node = node_vector_singleton()[i];
+          if (node.type() == NodeType::variable || node.type() == NodeType::value) {
+            steps.push_back(Step{StepType::Compute, i, 0u});
+          } else if (node.type() == NodeType::operation) {
+            stack.push(~i);
+            stack.push(node.lhs_index());
+            stack.push(node.rhs_index());
+          } else if (node.type() == NodeType::function) {
+            stack.push(~i);
+            stack.push(node.argument_index());
+          } else {
+            CURRENT_ASSERT(false);
+          }
+        }
+      } else {
+        steps.push_back(Step{StepType::Compute, dependent_i, 0u});
+      }
+    }
+  }
+
+  // Stores the value of the already compiled node into the `output_index`-th double of the output, `G[output_index]`.
+  void jit_store_node(node_index_t index, size_t output_index) {
+    steps.push_back(Step{StepType::Store, index, output_index});
+  }
+
+  // Returns the value of the already compiled node, in `d0`. Must be the last step.
+  void jit_return_node(node_index_t index) { steps.push_back(Step{StepType::Return, index, 0u}); }
+
+  void jit_generate_code() {
+    using namespace current::fncas::aarch64_native_jit;
+
+    size_t const n = static_cast<size_t>(max_dim) + 1;
+    last_use.assign(n, 0u);
+    register_of.assign(n, kNoRegister);
+    in_memory.assign(n, false);
+    std::fill(std::begin(value_in), std::end(value_in), kFreeRegister);
+
+    for (size_t s = 0; s < steps.size(); ++s) {
+      Step const& step = steps[s];
+      if (step.type == StepType::Compute) {
+        node_impl& node = node_vector_singleton()[step.node];
+        if (node.type() == NodeType::operation) {
+          last_use[node.lhs_index()] = s;
+          last_use[node.rhs_index()] = s;
+        } else if (node.type() == NodeType::function) {
+          last_use[node.argument_index()] = s;
+        }
+      } else {
+        CURRENT_ASSERT(step.type != StepType::Return || s + 1 == steps.size());
+        last_use[step.node] = s;
+      }
+    }
+
+    opcodes::prologue(code);
+
+    for (size_t s = 0; s < steps.size(); ++s) {
+      Step const& step = steps[s];
+      node_index_t const i = step.node;
+      if (step.type == StepType::Compute) {
+        node_impl& node = node_vector_singleton()[i];
+        if (node.type() == NodeType::operation) {
+          generate_operation(s, i, node.operation(), node.lhs_index(), node.rhs_index());
+        } else if (node.type() == NodeType::function) {
+          if (node.function() == MathFunction::sqr) {
+            generate_operation(s, i, MathOperation::multiply, node.argument_index(), node.argument_index());
+          } else if (node.function() == MathFunction::sqrt) {
+            generate_sqrt(s, i, node.argument_index());
+          } else {
+            generate_function_call(s, i, node.function(), node.argument_index());
+          }
+        }
+        // The variables and the constants are loaded lazily, when and if they need to be in a register.
+      } else if (step.type == StepType::Store) {
+        opcodes::store_d_to_memory_by_x19_offset(code, source_register(i, kAArch64NativeJITScratchDRegister),
+                                                 step.output_index);
+        release_if_last_use(i, s);
+      } else {
+        uint8_t const r = source_register(i, 0u);
+        if (r != 0u) {
+          opcodes::mov_d_to_d(code, 0u, r);
+        }
+      }
+    }
+
+    opcodes::epilogue_and_ret(code);
+  }
+
+  // The allocator's register `r` is `d{r}` for `r` up to 7, and `d{r+8}` from there on, skipping `d8` .. `d15`.
+  static uint8_t d(uint8_t r) { return r < 8u ? r : static_cast<uint8_t>(r + 8u); }
+
+ private:
+  static bool is_reloadable(node_index_t i) {
+    NodeType const type = node_vector_singleton()[i].type();
+    return type == NodeType::variable || type == NodeType::value;
+  }
+
+  bool dies_in_register(node_index_t i, size_t s) const { return register_of[i] != kNoRegister && last_use[i] == s; }
+
+  void bind(uint8_t r, node_index_t i) {
+    value_in[r] = i;
+    register_of[i] = r;
+  }
+
+  void unbind(uint8_t r) {
+    register_of[value_in[r]] = kNoRegister;
+    value_in[r] = kFreeRegister;
+  }
+
+  void spill_if_needed(uint8_t r) {
+    using namespace current::fncas::aarch64_native_jit;
+    node_index_t const i = value_in[r];
+    if (!in_memory[i] && !is_reloadable(i)) {
+      opcodes::store_d_to_memory_by_x19_offset(code, d(r), i + dim);
+      in_memory[i] = true;
+    }
+  }
+
+  // Returns a free register, other than the `pinned` ones, evicting the value with the farthest last use if needed.
+  uint8_t allocate_register(uint32_t pinned) {
+    uint8_t victim = kNoRegister;
+    for (uint8_t r = 0; r < kRegisters; ++r) {
+      if (!(pinned & (1u << r))) {
+        if (value_in[r] == kFreeRegister) {
+          return r;
+        }
+        if (victim == kNoRegister || last_use[value_in[r]] > last_use[value_in[victim]]) {
+          victim = r;
+        }
+      }
+    }
+    CURRENT_ASSERT(victim != kNoRegister);
+    spill_if_needed(victim);
+    unbind(victim);
+    return victim;
+  }
+
+  static uint32_t mask_of(uint8_t r) { return r == kNoRegister ? 0u : (1u << r); }
+
+  // Loads the value of the node, which is not in any register, into the physical register `dst`, without binding it.
+  void load_into_d(node_index_t i, uint8_t dst) {
+    using namespace current::fncas::aarch64_native_jit;
+    node_impl& node = node_vector_singleton()[i];
+    if (node.type() == NodeType::variable) {
+      opcodes::load_from_memory_by_x20_offset_to_d(code, dst, node.variable());
+    } else if (node.type() == NodeType::value) {
+      opcodes::load_immediate_to_d(code, dst, node.value());
+    } else {
+      CURRENT_ASSERT(in_memory[i]);
+      opcodes::load_from_memory_by_x19_offset_to_d(code, dst, i + dim);
+    }
+  }
+
+  // Returns the physical register with the value of the node, loading it into `fallback` if it is not in a register.
+  uint8_t source_register(node_index_t i, uint8_t fallback) {
+    if (register_of[i] != kNoRegister) {
+      return d(register_of[i]);
+    }
+    load_into_d(i, fallback);
+    return fallback;
+  }
+
+  void release_if_last_use(node_index_t i, size_t s) {
+    if (dies_in_register(i, s)) {
+      unbind(register_of[i]);
+    }
+  }
+
+  // `Z[i] = Z[lhs] {op} Z[rhs]`, computed in the register of `lhs` or `rhs` if this is its last use, or in a fresh one.
+  void generate_operation(size_t s, node_index_t i, MathOperation op, node_index_t lhs, node_index_t rhs) {
+    using namespace current::fncas::aarch64_native_jit;
+
+    uint8_t const lhs_register = register_of[lhs];
+    uint8_t const rhs_register = register_of[rhs];
+    uint8_t dst;
+    if (dies_in_register(lhs, s)) {
+      dst = lhs_register;
+    } else if (dies_in_register(rhs, s)) {
+      dst = rhs_register;
+    } else {
+      dst = allocate_register(mask_of(lhs_register) | mask_of(rhs_register));
+    }
+
+    // If `lhs` is not in a register, it is loaded into `dst`, unless `dst` still holds `rhs`, then into the scratch.
+    uint8_t const lhs_d =
+        source_register(lhs, dst == rhs_register ? kAArch64NativeJITScratchDRegister : d(dst));
+    uint8_t const rhs_d = rhs == lhs ? lhs_d : source_register(rhs, kAArch64NativeJITScratchDRegister);
+
+    if (op == MathOperation::add) {
+      opcodes::add_d_d_to_d(code, d(dst), lhs_d, rhs_d);
+    } else if (op == MathOperation::subtract) {
+      opcodes::sub_d_d_to_d(code, d(dst), lhs_d, rhs_d);
+    } else if (op == MathOperation::multiply) {
+      opcodes::mul_d_d_to_d(code, d(dst), lhs_d, rhs_d);
+    } else if (op == MathOperation::divide) {
+      opcodes::div_d_d_to_d(code, d(dst), lhs_d, rhs_d);
+    } else {
+      CURRENT_ASSERT(false);
+    }
+
+    release_if_last_use(lhs, s);
+    release_if_last_use(rhs, s);
+    bind(dst, i);
+    in_memory[i] = false;
+  }
+
+  // `Z[i] = sqrt(Z[argument])`, computed in the register of `argument` if this is its last use, or in a fresh one.
+  void generate_sqrt(size_t s, node_index_t i, node_index_t argument) {
+    using namespace current::fncas::aarch64_native_jit;
+    uint8_t dst;
+    if (dies_in_register(argument, s)) {
+      dst = register_of[argument];
+    } else {
+      dst = allocate_register(mask_of(register_of[argument]));
+    }
+    opcodes::sqrt_d_to_d(code, d(dst), source_register(argument, d(dst)));
+    release_if_last_use(argument, s);
+    bind(dst, i);
+    in_memory[i] = false;
+  }
+
+  // `Z[i] = f(Z[argument])`. Spills the values still needed after the call, as it clobbers all the used registers.
+  void generate_function_call(size_t s, node_index_t i, MathFunction function, node_index_t argument) {
+    using namespace current::fncas::aarch64_native_jit;
+
+    for (uint8_t r = 0; r < kRegisters; ++r) {
+      if (value_in[r] != kFreeRegister && last_use[value_in[r]] > s) {
+        spill_if_needed(r);
+      }
+    }
+
+    uint8_t const argument_d = source_register(argument, 0u);
+    if (argument_d != 0u) {
+      opcodes::mov_d_to_d(code, 0u, argument_d);
+    }
+
+    opcodes::call_function_from_x21_pointers_array_by_index(code, static_cast<uint8_t>(function));
+
+    for (uint8_t r = 0; r < kRegisters; ++r) {
+      if (value_in[r] != kFreeRegister) {
+        unbind(r);
+      }
+    }
+    bind(0, i);
+    in_memory[i] = false;
+  }
+};
+
+#ifdef FNCAS_AARCH64_NATIVE_JIT_ENABLED
+
+// The functions and the gradients can be JIT-compiled into `function_t<JIT::AArch64NativeJIT>` and such.
+#define FNCAS_AARCH64_NATIVE_JIT_COMPILED
+
+struct aarch64_native_jit_scratch final {
+  std::vector<double> heap;
+  double* heap_of_size(size_t size) {
+    if (heap.size() < size) {
+      heap.resize(size);
+    }
+    return &heap[0];
+  }
+  static aarch64_native_jit_scratch& tls() { return current::ThreadLocalSingleton<aarch64_native_jit_scratch>(); }
+};
+
+struct aarch64_native_jit_function_pointers {
+  std::vector<double (*)(double x)> p;
+  aarch64_native_jit_function_pointers() {
+#define FNCAS_FUNCTION(f) p.push_back(fncas::f);
+#include "fncas_functions.dsl.h"
+#undef FNCAS_FUNCTION
+  }
+  static aarch64_native_jit_function_pointers& tls() {
+    return current::ThreadLocalSingleton<aarch64_native_jit_function_pointers>();
+  }
+};
+
+struct f_compiled_aarch64_native_jit final {
+  // The code is immutable, so the copies share it.
+  std::shared_ptr<const current::fncas::aarch64_native_jit::CallableVectorUInt32> jit_compiled_code;
+  size_t heap_size = 0u;  // In doubles, for the per-thread `aarch64_native_jit_scratch`.
+
+  explicit f_compiled_aarch64_native_jit(V const& node) {
+    V const simplified_node = simplify_node(node);
+    std::vector<uint32_t> code;
+    {
+      AArch64JITCodeGenerator code_generator(code, 0);
+      code_generator.jit_compile_node(simplified_node.index());
+      code_generator.jit_return_node(simplified_node.index());
+      code_generator.jit_generate_code();
+      heap_size = code_generator.max_dim + 1;
+    }
+    jit_compiled_code = std::make_shared<const current::fncas::aarch64_native_jit::CallableVectorUInt32>(code);
+  }
+
+  explicit f_compiled_aarch64_native_jit(const f_impl<JIT::Blueprint>& f) : f_compiled_aarch64_native_jit(f.f_) {}
+
+  double operator()(const std::vector<double>& x) const {
+    return (*jit_compiled_code)(&x[0],
+                                aarch64_native_jit_scratch::tls().heap_of_size(heap_size),
+                                &aarch64_native_jit_function_pointers::tls().p[0]);
+  }
+
+  // For backwards "compatibility" with the unit tests. -- D.K.
+  static const char* lib_filename() { return ""; }
+};
+
+struct g_compiled_aarch64_native_jit final {
+  size_t dim;
+  // The code is immutable, so the copies share it.
+  std::shared_ptr<const current::fncas::aarch64_native_jit::CallableVectorUInt32> jit_compiled_code;
+  size_t heap_size = 0u;  // In doubles, for the per-thread `aarch64_native_jit_scratch`.
+
+  g_compiled_aarch64_native_jit(const f_impl<JIT::Blueprint>& unused_f, const g_impl<JIT::Blueprint>& g)
+      : dim(g.g_.size()) {
+    static_cast<void>(unused_f);
+    CURRENT_ASSERT(dim == internals_singleton().dim_);
+    std::vector<node_index_t> g_indexes(dim);
+    for (size_t i = 0; i < dim; ++i) {
+      g_indexes[i] = g.g_[i].index_;
+    }
+    simplify_nodes(g_indexes);
+    std::vector<uint32_t> code;
+    {
+      AArch64JITCodeGenerator code_generator(code, dim);
+      for (size_t i = 0; i < dim; ++i) {
+        code_generator.jit_compile_node(g_indexes[i]);
+        code_generator.jit_store_node(g_indexes[i], i);
+      }
+      code_generator.jit_generate_code();
+      heap_size = dim + code_generator.max_dim + 1;
+    }
+    jit_compiled_code = std::make_shared<const current::fncas::aarch64_native_jit::CallableVectorUInt32>(code);
+  }
+
+  std::vector<double> operator()(const std::vector<double>& x) const {
+    double* heap = aarch64_native_jit_scratch::tls().heap_of_size(heap_size);
+    (*jit_compiled_code)(&x[0], heap, &aarch64_native_jit_function_pointers::tls().p[0]);
+    return std::vector<double>(heap, heap + dim);
+  }
+
+  // For backwards "compatibility" with the unit tests. -- D.K.
+  static const char* lib_filename() { return ""; }
+};
+
+template <>
+struct f_impl_selector<JIT::AArch64NativeJIT> {
+  using type = f_compiled_aarch64_native_jit;
+};
+
+template <>
+struct g_impl_selector<JIT::AArch64NativeJIT> {
+  using type = g_compiled_aarch64_native_jit;
+};
+
+#endif  // FNCAS_AARCH64_NATIVE_JIT_ENABLED
+
+}  // namespace impl
+}  // namespace fncas
+
+#endif  // FNCAS_USE_LONG_DOUBLE
+
+#endif  // #ifndef FNCAS_FNCAS_JIT_AARCH64_H
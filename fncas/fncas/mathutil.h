@@ -32,6 +32,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <deque>
 #include <functional>
 #include <numeric>
 #include <vector>
@@ -189,6 +190,159 @@ ValueAndPoint Backtracking(F&& f,
   }
 }
 
+// The point found by `StrongWolfeLineSearch()`, with the value and the gradient there, both to minimize,
+// i.e. with the sign flipped when maximizing.
+struct LineSearchResult {
+  ValueAndPoint value_and_point;
+  std::vector<double_t> gradient;
+  double_t step;
+};
+
+// Line search satisfying the strong Wolfe conditions, Nocedal & Wright, "Numerical Optimization", algorithms 3.5, 3.6.
+// Starts in `current`, where the value to minimize and its gradient are known, and searches along `direction`,
+// first expanding the step from `initial_step`, then zooming in with safeguarded quadratic interpolation.
+// Algorithm parameters: 0 < c1 < c2 < 1.
+template <OptimizationDirection DIRECTION, class F, class G>
+LineSearchResult StrongWolfeLineSearch(F&& f,
+                                       G&& g,
+                                       const ValueAndPoint& current,
+                                       const std::vector<double_t>& current_gradient,
+                                       const std::vector<double_t>& direction,
+                                       optimize::OptimizerStats& stats,
+                                       const double_t initial_step = 1.0,
+                                       const double_t c1 = 1e-4,
+                                       const double_t c2 = 0.9,
+                                       const size_t max_steps = 40) {
+  const double sign = (DIRECTION == OptimizationDirection::Minimize ? +1 : -1);
+  stats.JournalBacktrackingCall();
+
+  const double_t value0 = current.value;
+  const double_t slope0 = DotProduct(current_gradient, direction);
+  if (!(slope0 < 0)) {
+    CURRENT_THROW(exceptions::StrongWolfeLineSearchException("Not a descent direction."));
+  }
+
+  // The gradient, and the slope along `direction`, are only computed for the steps that decrease the value enough.
+  struct Trial {
+    double_t step;
+    double_t value;
+    double_t slope;
+    std::vector<double_t> point;
+    std::vector<double_t> gradient;
+  };
+  const auto evaluate_value = [&](double_t step) {
+    Trial trial;
+    trial.step = step;
+    trial.slope = 0.0;
+    trial.point = SumVectors(current.point, direction, step);
+    stats.JournalFunction();
+    trial.value = f(trial.point) * sign;
+    return trial;
+  };
+  const auto evaluate_gradient = [&](Trial& trial) {
+    stats.JournalGradient();
+    trial.gradient = g(trial.point);
+    if (DIRECTION == OptimizationDirection::Maximize) {
+      FlipSign(trial.gradient);
+    }
+    trial.slope = DotProduct(trial.gradient, direction);
+  };
+  const auto insufficient_decrease = [&](const Trial& trial) {
+    return !IsNormal(trial.value) || trial.value > value0 + c1 * trial.step * slope0;
+  };
+  const auto satisfies_curvature = [&](const Trial& trial) { return std::abs(trial.slope) <= -c2 * slope0; };
+  const auto result = [](const Trial& trial) {
+    return LineSearchResult{ValueAndPoint(trial.value, trial.point), trial.gradient, trial.step};
+  };
+
+  size_t steps = 0;
+
+  // The minimum is between `lo`, the best step so far, with a known gradient, and `hi`.
+  const auto zoom = [&](Trial lo, Trial hi) {
+    while (steps++ < max_steps) {
+      stats.JournalBacktrackingStep();
+      const double_t d = hi.step - lo.step;
+      double_t step = lo.step + 0.5 * d;
+      if (IsNormal(hi.value)) {
+        const double_t denominator = 2.0 * (hi.value - lo.value - lo.slope * d);
+        if (denominator > 0) {
+          const double_t interpolated = lo.step - lo.slope * d * d / denominator;
+          const double_t a = std::min(lo.step, hi.step) + 0.1 * std::abs(d);
+          const double_t b = std::max(lo.step, hi.step) - 0.1 * std::abs(d);
+          if (interpolated >= a && interpolated <= b) {
+            step = interpolated;
+          }
+        }
+      }
+      Trial trial = evaluate_value(step);
+      if (insufficient_decrease(trial) || trial.value >= lo.value) {
+        hi = std::move(trial);
+      } else {
+        evaluate_gradient(trial);
+        if (satisfies_curvature(trial)) {
+          return result(trial);
+        }
+        if (trial.slope * d >= 0) {
+          hi = std::move(lo);
+        }
+        lo = std::move(trial);
+      }
+    }
+    // Out of steps: the best step found still decreases the value enough, unless it is the starting point.
+    if (!(lo.step > 0)) {
+      CURRENT_THROW(exceptions::StrongWolfeLineSearchException("No step satisfying the sufficient decrease condition."));
+    }
+    return result(lo);
+  };
+
+  Trial previous{0.0, value0, slope0, current.point, current_gradient};
+  double_t step = initial_step;
+  while (steps++ < max_steps) {
+    Trial trial = evaluate_value(step);
+    if (insufficient_decrease(trial) || (previous.step > 0 && trial.value >= previous.value)) {
+      return zoom(std::move(previous), std::move(trial));
+    }
+    evaluate_gradient(trial);
+    if (satisfies_curvature(trial)) {
+      return result(trial);
+    }
+    if (trial.slope >= 0) {
+      return zoom(std::move(trial), std::move(previous));
+    }
+    previous = std::move(trial);
+    step *= 2.0;
+  }
+  return result(previous);  // Still descending after `max_steps` expansions, take the longest step.
+}
+
+// The L-BFGS two-loop recursion: the quasi-Newton direction to minimize the function with this `gradient`, given
+// the history of the last steps `s` and of the changes of the gradient `y` over them, oldest first.
+inline std::vector<double_t> LBFGSDirection(const std::vector<double_t>& gradient,
+                                            const std::deque<std::vector<double_t>>& s,
+                                            const std::deque<std::vector<double_t>>& y) {
+#ifndef NDEBUG
+  CURRENT_ASSERT(s.size() == y.size());
+#endif
+  std::vector<double_t> q(gradient);
+  std::vector<double_t> alpha(s.size());
+  std::vector<double_t> rho(s.size());
+  for (size_t i = s.size(); i--;) {
+    rho[i] = 1.0 / DotProduct(y[i], s[i]);
+    alpha[i] = rho[i] * DotProduct(s[i], q);
+    q = SumVectors(q, y[i], -alpha[i]);
+  }
+  if (!s.empty()) {
+    // Scale the initial inverse Hessian approximation by the most recent curvature.
+    q = SumVectors(q, q, DotProduct(s.back(), y.back()) / L2Norm(y.back()), 0.0);
+  }
+  for (size_t i = 0; i < s.size(); ++i) {
+    const double_t beta = rho[i] * DotProduct(y[i], q);
+    q = SumVectors(q, s[i], alpha[i] - beta);
+  }
+  FlipSign(q);
+  return q;
+}
+
 }  // namespace impl
 }  // namespace fncas
 
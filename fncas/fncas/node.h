@@ -30,10 +30,13 @@
 #include <exception>
 #include <functional>
 #include <limits>
+#include <atomic>
 #include <map>
+#include <memory>
 #include <stack>
 #include <string>
 #include <sstream>
+#include <thread>
 #include <type_traits>
 #include <unordered_map>
 #include <vector>
@@ -80,8 +83,10 @@ namespace impl {
 // Parsed expressions are stored in an array of node_impl objects.
 // Instances of `node_impl` take 10 bytes each and are packed.
 // Each node_impl refers to a value, an input variable, an operation or math function invocation.
-// The `ThreadLocalSingleton` containing `vector<node_impl>` is the allocator, thus
-// at most one expression per thread (at most one scope of `fncas::impl::X`) can be "recorded" at a time.
+// The `internals_impl` containing `vector<node_impl>` is the allocator, thus at most one expression per
+// `internals_impl` (at most one scope of `fncas::impl::X`) can be "recorded" at a time.
+// By default, each thread uses its own `ThreadLocalSingleton` one. An `expression_context`, activated on the current
+// thread via `expression_context_scope`, owns its own `internals_impl` instead, see below.
 
 inline const char* operation_as_string(MathOperation operation) {
   static const char* representation[static_cast<size_t>(MathOperation::end)] = {"+", "-", "*", "/"};
@@ -125,9 +130,6 @@ struct internals_impl {
   // df_[var_index][node_index] => node index for d (node[node_index]) / d (x[variable_index]), -1 if unknown.
   std::vector<std::vector<node_index_t>> df_;
 
-  // A block of RAM to be used as the buffer for externally compiled functions.
-  std::vector<double_t> heap_for_compiled_evaluations_;
-
   // A hashmap of per-immediate-value-created nodes, to not create constants such as zeroes and ones way too often.
   std::unordered_map<double_t, node_index_t> allocated_values_map_;
 
@@ -136,12 +138,74 @@ struct internals_impl {
     x_ptr_ = nullptr;
     node_vector_.clear();
     df_.clear();
-    heap_for_compiled_evaluations_.clear();
     allocated_values_map_.clear();
   }
 };
 
-inline internals_impl& internals_singleton() { return current::ThreadLocalSingleton<internals_impl>(); }
+// The `internals_impl` of the `expression_context` active on this thread, if any.
+struct active_internals_impl final {
+  internals_impl* ptr = nullptr;
+};
+
+inline internals_impl& internals_singleton() {
+  internals_impl* active = current::ThreadLocalSingleton<active_internals_impl>().ptr;
+  return active ? *active : current::ThreadLocalSingleton<internals_impl>();
+}
+
+// An explicit, movable expression context, which owns its node storage. Functions recorded within different contexts
+// are independent, so they can be recorded concurrently, from different threads, or interleaved on one thread.
+// The recorded nodes are freed with the context. The JIT-compiled functions do not depend on the context they
+// were compiled from, and can be evaluated from any thread, concurrently, after the context is gone.
+class expression_context final {
+ private:
+  friend class expression_context_scope;
+  struct state final {
+    internals_impl internals;
+    std::atomic<std::thread::id> owner;  // The thread on which this context is active, if any.
+    size_t depth = 0u;                   // The number of nested scopes activating this context on the `owner` thread.
+    state() { internals.reset(); }
+  };
+  std::unique_ptr<state> state_;
+
+ public:
+  expression_context() : state_(std::make_unique<state>()) {}
+  expression_context(expression_context&&) = default;
+  expression_context& operator=(expression_context&&) = default;
+  ~expression_context() {
+    // Destroying or overwriting an active context is a bug, as the nodes recorded within it would dangle.
+    CURRENT_ASSERT(!state_ || state_->owner.load() == std::thread::id());
+  }
+};
+
+// Activates the `expression_context` on the current thread for the lifetime of this scope: recording, differentiating,
+// evaluating via `JIT::Blueprint` and JIT-compiling the functions all use its nodes. The scopes can be nested.
+// A context can be active on one thread at a time, `FnCASConcurrentEvaluationAttemptException` is thrown otherwise.
+class expression_context_scope final : noncopyable {
+ private:
+  expression_context::state& state_;
+  internals_impl* const previous_;
+
+ public:
+  explicit expression_context_scope(expression_context& context)
+      : state_(*context.state_), previous_(current::ThreadLocalSingleton<active_internals_impl>().ptr) {
+    std::thread::id const this_thread = std::this_thread::get_id();
+    if (state_.owner.load() != this_thread) {
+      std::thread::id unowned;
+      if (!state_.owner.compare_exchange_strong(unowned, this_thread)) {
+        CURRENT_THROW(exceptions::FnCASConcurrentEvaluationAttemptException());
+      }
+    }
+    ++state_.depth;
+    current::ThreadLocalSingleton<active_internals_impl>().ptr = &state_.internals;
+  }
+
+  ~expression_context_scope() {
+    current::ThreadLocalSingleton<active_internals_impl>().ptr = previous_;
+    if (!--state_.depth) {
+      state_.owner.store(std::thread::id());
+    }
+  }
+};
 
 inline std::vector<node_impl>& node_vector_singleton() { return internals_singleton().node_vector_; }
 
@@ -416,9 +480,12 @@ namespace impl {
 struct X final : std::vector<V>, noncopyable {
   using super_t = std::vector<V>;
 
-  explicit X(size_t dim) {
+  // The `internals_impl` this `X` is recorded into, which may no longer be the active one by the time it is destroyed.
+  internals_impl& meta_;
+
+  explicit X(size_t dim) : meta_(internals_singleton()) {
     CURRENT_ASSERT(dim > 0);
-    auto& meta = internals_singleton();
+    auto& meta = meta_;
     if (meta.x_ptr_) {
       CURRENT_THROW(exceptions::FnCASConcurrentEvaluationAttemptException());
     }
@@ -436,7 +503,7 @@ struct X final : std::vector<V>, noncopyable {
   }
 
   virtual ~X() {
-    auto& meta = internals_singleton();
+    auto& meta = meta_;
     if (meta.x_ptr_ == this) {
       // The condition is required to correctly handle the case when the constructor did `throw`.
       meta.x_ptr_ = nullptr;
@@ -602,6 +669,10 @@ using term_vector_t = std::vector<term_t>;
 // point in time.
 using variables_vector_t = impl::X;
 
+// Explicit expression contexts, to record and compile many functions in parallel, see `impl::expression_context`.
+using expression_context_t = impl::expression_context;
+using expression_context_scope_t = impl::expression_context_scope;
+
 template <JIT JIT_IMPLEMENTATION = JIT::Super>
 using function_t = typename impl::f_impl_selector<JIT_IMPLEMENTATION>::type;
 
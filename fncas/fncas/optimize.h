@@ -27,7 +27,10 @@ SOFTWARE.
 #define FNCAS_FNCAS_OPTIMIZE_H
 
 #include <algorithm>
+#include <deque>
+#include <functional>
 #include <map>
+#include <memory>
 #include <numeric>
 #include <string>
 #include <type_traits>
@@ -39,6 +42,8 @@ SOFTWARE.
 #include "mathutil.h"
 #include "node.h"
 #include "jit.h"
+#include "jit_aarch64.h"
+#include "thread_pool.h"
 
 #include "../../bricks/template/decay.h"
 #include "../../typesystem/struct.h"
@@ -48,6 +53,19 @@ SOFTWARE.
 namespace fncas {
 namespace optimize {
 
+// Whether `function_t<J>` and `gradient_t<J>` are compiled into this binary. The JITs of `jit.h` are x64-only,
+// and the AArch64 native one, being opt-in, is never the `JIT::Default`.
+template <JIT J>
+constexpr bool IsJITCompiled() {
+#if defined(FNCAS_JIT_COMPILED)
+  return true;
+#elif defined(FNCAS_AARCH64_NATIVE_JIT_COMPILED)
+  return J == JIT::AArch64NativeJIT;
+#else
+  return false;
+#endif
+}
+
 // clang-format off
 CURRENT_STRUCT_T(ObjectiveFunctionValue) {
   using value_t = T;
@@ -300,16 +318,16 @@ class OptimizeInvoker : public Optimizer<F, DIRECTION> {
     if (JIT_IMPLEMENTATION != fncas::JIT::Blueprint &&
         (!Exists(super_t::Parameters()) || Value(super_t::Parameters()).IsJITEnabled())) {
       logger.Log("Optimizer: Compiling the objective function.");
-#ifdef FNCAS_JIT_COMPILED
-      const auto compile_f_begin_gradient = current::time::Now();
-      fncas::function_t<JIT_IMPLEMENTATION> f(f_i);
-      logger.Log("Optimizer: Done compiling the objective function, took " +
-                 current::ToString((current::time::Now() - compile_f_begin_gradient).count() * 1e-6) + " seconds.");
-      return DoOptimize(objective_function, f_i, f, starting_point, gradient_helper);
-#else
-      std::cerr << "Attempted to use FnCAS JIT when it's not compiled into the binary. Check your -D flags.\n";
-      std::exit(-1);
-#endif
+      if constexpr (IsJITCompiled<JIT_IMPLEMENTATION>()) {
+        const auto compile_f_begin_gradient = current::time::Now();
+        fncas::function_t<JIT_IMPLEMENTATION> f(f_i);
+        logger.Log("Optimizer: Done compiling the objective function, took " +
+                   current::ToString((current::time::Now() - compile_f_begin_gradient).count() * 1e-6) + " seconds.");
+        return DoOptimize(objective_function, f_i, f, starting_point, gradient_helper);
+      } else {
+        std::cerr << "Attempted to use FnCAS JIT when it's not compiled into the binary. Check your -D flags.\n";
+        std::exit(-1);
+      }
     } else {
       logger.Log("Optimizer: JIT has been disabled via `DisableJIT()`, falling back to interpreted evalutions.");
       return DoOptimize(objective_function, f_i, f_i, starting_point, gradient_helper);
@@ -331,16 +349,16 @@ class OptimizeInvoker : public Optimizer<F, DIRECTION> {
     if (JIT_IMPLEMENTATION != fncas::JIT::Blueprint &&
         (!Exists(super_t::Parameters()) || Value(super_t::Parameters()).IsJITEnabled())) {
       logger.Log("Optimizer: Compiling the gradient.");
-#ifdef FNCAS_JIT_COMPILED
-      const auto compile_g_begin_gradient = current::time::Now();
-      fncas::gradient_t<JIT_IMPLEMENTATION> g(f_i, g_i);
-      logger.Log("Optimizer: Done compiling the gradient, took " +
-                 current::ToString((current::time::Now() - compile_g_begin_gradient).count() * 1e-6) + " seconds.");
-      return OptimizeImpl<IMPL, DIRECTION>::template RunOptimize<F>(*this, original_f, f, g, starting_point);
-#else
-      std::cerr << "Attempted to use FnCAS JIT when it's not compiled into the binary. Check your -D flags.\n";
-      std::exit(-1);
-#endif
+      if constexpr (IsJITCompiled<JIT_IMPLEMENTATION>()) {
+        const auto compile_g_begin_gradient = current::time::Now();
+        fncas::gradient_t<JIT_IMPLEMENTATION> g(f_i, g_i);
+        logger.Log("Optimizer: Done compiling the gradient, took " +
+                   current::ToString((current::time::Now() - compile_g_begin_gradient).count() * 1e-6) + " seconds.");
+        return OptimizeImpl<IMPL, DIRECTION>::template RunOptimize<F>(*this, original_f, f, g, starting_point);
+      } else {
+        std::cerr << "Attempted to use FnCAS JIT when it's not compiled into the binary. Check your -D flags.\n";
+        std::exit(-1);
+      }
     } else {
       return OptimizeImpl<IMPL, DIRECTION>::template RunOptimize<F>(*this, original_f, f, g_i, starting_point);
     }
@@ -824,6 +842,298 @@ struct OptimizeImpl<ConjugateGradientOptimizerSelector, DIRECTION> {
   }
 };
 
+// Limited-memory BFGS optimizer with the strong Wolfe line search to find a local minimum of `F::ObjectiveFunction`.
+// Generally takes several times fewer function and gradient evaluations than `ConjugateGradientOptimizer`.
+struct LBFGSOptimizerSelector;
+
+template <class F,
+          OptimizationDirection DIRECTION = OptimizationDirection::Minimize,
+          JIT JIT_IMPLEMENTATION = JIT::Default>
+class LBFGSOptimizer final : public OptimizeInvoker<F, DIRECTION, JIT_IMPLEMENTATION, LBFGSOptimizerSelector> {
+ public:
+  using super_t = OptimizeInvoker<F, DIRECTION, JIT_IMPLEMENTATION, LBFGSOptimizerSelector>;
+  using super_t::super_t;
+};
+
+template <OptimizationDirection DIRECTION>
+struct OptimizeImpl<LBFGSOptimizerSelector, DIRECTION> {
+  template <typename ORIGINAL_F, typename F, typename G>
+  static OptimizationResult RunOptimize(const Optimizer<ORIGINAL_F, DIRECTION>& super,
+                                        const ORIGINAL_F& original_f,
+                                        F&& f,
+                                        G&& g,
+                                        const std::vector<double_t>& starting_point) {
+    const auto& logger = impl::OptimizerLogger();
+
+    size_t min_steps = 3;               // Minimum number of optimization steps (ignoring early stopping).
+    size_t max_steps = 250;             // Maximum number of optimization steps.
+    size_t lbfgs_history = 10;          // The number of the most recent steps to approximate the Hessian with.
+    double_t wolfe_c1 = 1e-4;           // The sufficient decrease parameter of the line search.
+    double_t wolfe_c2 = 0.9;            // The curvature parameter of the line search.
+    size_t line_search_max_steps = 40;  // Maximum number of function evaluations per line search.
+    double_t grad_eps = 1e-8;           // Magnitude of gradient for early stopping.
+    double_t min_absolute_per_step_improvement = 1e-25;  // Terminate early if the absolute improvement is small.
+    double_t min_relative_per_step_improvement = 1e-25;  // Terminate early if the relative improvement is small.
+    double_t no_improvement_steps_to_terminate = 2;      // Wait for this # of consecutive no improvement iterations.
+
+    bool track_progress = false;
+
+    if (Exists(super.Parameters())) {
+      const auto& parameters = Value(super.Parameters());
+      min_steps = parameters.GetValue("min_steps", min_steps);
+      max_steps = parameters.GetValue("max_steps", max_steps);
+      lbfgs_history = parameters.GetValue("lbfgs_history", lbfgs_history);
+      wolfe_c1 = parameters.GetValue("wolfe_c1", wolfe_c1);
+      wolfe_c2 = parameters.GetValue("wolfe_c2", wolfe_c2);
+      line_search_max_steps = parameters.GetValue("line_search_max_steps", line_search_max_steps);
+      grad_eps = parameters.GetValue("grad_eps", grad_eps);
+      min_relative_per_step_improvement =
+          parameters.GetValue("min_relative_per_step_improvement", min_relative_per_step_improvement);
+      min_absolute_per_step_improvement =
+          parameters.GetValue("min_absolute_per_step_improvement", min_absolute_per_step_improvement);
+      no_improvement_steps_to_terminate =
+          parameters.GetValue("no_improvement_steps_to_terminate", no_improvement_steps_to_terminate);
+
+      track_progress = parameters.ShouldTrackProgress();
+    }
+
+    logger.Log("LBFGSOptimizer: The objective function with its gradient is " +
+               current::ToString(impl::node_vector_singleton().size()) + " nodes.");
+
+    ValueAndPoint current(f(starting_point), starting_point);
+    logger.Log("LBFGSOptimizer: Original objective function = " + current::ToString(current.value));
+    if (!fncas::IsNormal(current.value)) {
+      CURRENT_THROW(exceptions::FnCASOptimizationException("!fncas::IsNormal(current.value)"));
+    }
+
+    OptimizationProgress progress;
+
+    std::vector<double_t> current_gradient = g(current.point);
+
+    if (DIRECTION == OptimizationDirection::Maximize) {
+      current.value *= -1;
+      fncas::impl::FlipSign(current_gradient);
+    }
+
+    // The last `lbfgs_history` steps, and the changes of the gradient over them, oldest first.
+    std::deque<std::vector<double_t>> s_history;
+    std::deque<std::vector<double_t>> y_history;
+
+    logger.Log("LBFGSOptimizer: Begin at " + super.PointAsString(starting_point));
+    size_t iteration;
+    int no_improvement_steps = 0;
+    {
+      OptimizerStats stats("LBFGSOptimizer");
+      for (iteration = 0; iteration < max_steps; ++iteration) {
+        if (super.StoppingCriterionSatisfied(iteration, current, current_gradient) ==
+            EarlyStoppingCriterion::StopOptimization) {
+          logger.Log("LBFGSOptimizer: External stopping criterion satisfied, terminating.");
+          break;
+        }
+
+        if (track_progress) {
+          progress.TrackIteration(original_f.ObjectiveFunction(current.point));
+        }
+
+        stats.JournalIteration();
+        if (logger) {
+          // `PointAsString()` is an expensive call, don't make it if `logger` is not initialized.
+          logger.Log("LBFGSOptimizer: Iteration " + current::ToString(iteration + 1) + ", OF = " +
+                     current::ToString(current.value) + " @ " + super.PointAsString(current.point));
+        }
+
+        // Simple early stopping by the norm of the gradient.
+        const double_t gradient_norm = std::sqrt(impl::L2Norm(current_gradient));
+        if (gradient_norm < grad_eps && iteration >= min_steps) {
+          logger.Log("LBFGSOptimizer: Terminating due to small gradient norm.");
+          break;
+        }
+
+        // With no history yet, the first step is against the gradient, and of unit length.
+        const std::vector<double_t> s = impl::LBFGSDirection(current_gradient, s_history, y_history);
+        const double_t initial_step = s_history.empty() ? std::min(1.0, 1.0 / gradient_norm) : 1.0;
+
+        try {
+          const impl::LineSearchResult next = impl::StrongWolfeLineSearch<DIRECTION>(
+              f, g, current, current_gradient, s, stats, initial_step, wolfe_c1, wolfe_c2, line_search_max_steps);
+
+          std::vector<double_t> step = impl::SumVectors(next.value_and_point.point, current.point, -1.0);
+          std::vector<double_t> gradient_change = impl::SumVectors(next.gradient, current_gradient, -1.0);
+          // Only keep the steps along which the function is convex, for the Hessian approximation to stay positive.
+          if (impl::DotProduct(step, gradient_change) > 1e-10 * impl::L2Norm(gradient_change)) {
+            s_history.push_back(std::move(step));
+            y_history.push_back(std::move(gradient_change));
+            if (s_history.size() > lbfgs_history) {
+              s_history.pop_front();
+              y_history.pop_front();
+            }
+          }
+
+          if (NoImprovement(next.value_and_point,
+                            current,
+                            min_relative_per_step_improvement,
+                            min_absolute_per_step_improvement)) {
+            ++no_improvement_steps;
+            if (no_improvement_steps >= no_improvement_steps_to_terminate) {
+              logger.Log("LBFGSOptimizer: Terminating due to no improvement.");
+              break;
+            }
+          } else {
+            no_improvement_steps = 0;
+          }
+
+          current = next.value_and_point;
+          current_gradient = next.gradient;
+        } catch (const exceptions::StrongWolfeLineSearchException&) {
+          if (s_history.empty()) {
+            logger.Log("LBFGSOptimizer: Terminating due to no line search step possible.");
+            break;
+          }
+          // The Hessian approximation may be off, start over from the steepest descent.
+          logger.Log("LBFGSOptimizer: No line search step possible, resetting the history.");
+          s_history.clear();
+          y_history.clear();
+        }
+      }
+    }
+
+    if (DIRECTION == OptimizationDirection::Maximize) {
+      current.value *= -1;
+    }
+
+    logger.Log("LBFGSOptimizer: Result = " + super.PointAsString(current.point));
+    logger.Log("LBFGSOptimizer: Objective function = " + current::ToString(current.value));
+
+    OptimizationResult result(current);
+    result.optimization_iterations = static_cast<uint32_t>(iteration);
+
+    if (track_progress) {
+      result.progress = std::move(progress);
+    }
+
+    return result;
+  }
+};
+
+// The base class for the objective functions that are sums of independent terms, such as the losses over the shards
+// of the data. `F` should provide `size_t Shards() const` and `T ShardObjectiveFunction(const std::vector<T>& x,
+// size_t shard) const`, returning `T` or `ObjectiveFunctionValue<T>`. The sum over all the shards is exposed as
+// `ObjectiveFunction()`, so that `F` can be optimized by any optimizer, and by `ShardedOptimizer` in parallel.
+template <class F>
+struct ShardedObjectiveFunction {
+  template <typename T>
+  T ObjectiveFunction(const std::vector<T>& x) const {
+    const F& f = static_cast<const F&>(*this);
+    const size_t shards = f.Shards();
+    CURRENT_ASSERT(shards > 0u);
+    T result = ExtractValueFromObjectiveFunctionValue(f.ShardObjectiveFunction(x, 0u));
+    for (size_t shard = 1u; shard < shards; ++shard) {
+      result = result + ExtractValueFromObjectiveFunctionValue(f.ShardObjectiveFunction(x, shard));
+    }
+    return result;
+  }
+};
+
+// One shard of a `ShardedObjectiveFunction`, recorded and differentiated in its own expression context,
+// and JIT-compiled unless JIT is disabled. Can be evaluated from any thread, but from one thread at a time.
+struct ObjectiveFunctionShard final {
+  expression_context_t context;
+  std::unique_ptr<fncas::impl::X> x;
+  std::unique_ptr<fncas::impl::f_impl<JIT::Blueprint>> f_i;
+  std::unique_ptr<fncas::impl::g_impl<JIT::Blueprint>> g_i;
+  std::function<double_t(const std::vector<double_t>&)> f;
+  std::function<std::vector<double_t>(const std::vector<double_t>&)> g;
+
+  template <JIT JIT_IMPLEMENTATION, class F>
+  void Build(const F& objective_function, size_t shard, size_t dim, bool jit) {
+    expression_context_scope_t scope(context);
+    x = std::make_unique<fncas::impl::X>(dim);
+    f_i = std::make_unique<fncas::impl::f_impl<JIT::Blueprint>>(
+        ExtractValueFromObjectiveFunctionValue(objective_function.ShardObjectiveFunction(*x, shard)));
+    g_i = std::make_unique<fncas::impl::g_impl<JIT::Blueprint>>(*x, *f_i);
+    if constexpr (JIT_IMPLEMENTATION != JIT::Blueprint && IsJITCompiled<JIT_IMPLEMENTATION>()) {
+      if (jit) {
+        auto compiled_f = std::make_shared<const fncas::function_t<JIT_IMPLEMENTATION>>(*f_i);
+        auto compiled_g = std::make_shared<const fncas::gradient_t<JIT_IMPLEMENTATION>>(*f_i, *g_i);
+        f = [compiled_f](const std::vector<double_t>& p) { return (*compiled_f)(p); };
+        g = [compiled_g](const std::vector<double_t>& p) { return (*compiled_g)(p); };
+        return;
+      }
+    } else {
+      static_cast<void>(jit);
+    }
+    f = [this](const std::vector<double_t>& p) {
+      expression_context_scope_t scope(context);
+      return (*f_i)(p);
+    };
+    g = [this](const std::vector<double_t>& p) {
+      expression_context_scope_t scope(context);
+      return (*g_i)(p);
+    };
+  }
+};
+
+// Optimizer of a `ShardedObjectiveFunction` that uses all the CPU cores. Each shard is recorded and compiled once,
+// concurrently, then the function and its gradient are evaluated shard by shard on a pool of threads, and summed
+// in the order of the shards, so that the result does not depend on the number of threads. The "threads" parameter
+// is the size of the pool, one thread per CPU core by default. `IMPL` is the algorithm, L-BFGS by default.
+template <class F,
+          OptimizationDirection DIRECTION = OptimizationDirection::Minimize,
+          JIT JIT_IMPLEMENTATION = JIT::Default,
+          class IMPL = LBFGSOptimizerSelector>
+class ShardedOptimizer final : public Optimizer<F, DIRECTION> {
+ public:
+  using super_t = Optimizer<F, DIRECTION>;
+  using super_t::super_t;
+
+  OptimizationResult Optimize(const std::vector<double_t>& starting_point) const override {
+    const auto& logger = impl::OptimizerLogger();
+    const auto& objective_function = super_t::Function();
+
+    const size_t shards_count = objective_function.Shards();
+    if (!shards_count) {
+      CURRENT_THROW(exceptions::FnCASOptimizationException("No shards in the objective function."));
+    }
+    const bool jit = JIT_IMPLEMENTATION != fncas::JIT::Blueprint &&
+                     (!Exists(super_t::Parameters()) || Value(super_t::Parameters()).IsJITEnabled());
+    if (jit && !IsJITCompiled<JIT_IMPLEMENTATION>()) {
+      std::cerr << "Attempted to use FnCAS JIT when it's not compiled into the binary. Check your -D flags.\n";
+      std::exit(-1);
+    }
+
+    impl::thread_pool pool(Exists(super_t::Parameters()) ? Value(super_t::Parameters()).GetValue("threads", 0u)
+                                                          : 0u);
+    logger.Log("ShardedOptimizer: " + current::ToString(shards_count) + " shards on " +
+               current::ToString(pool.threads_count()) + " threads.");
+
+    const auto build_begin = current::time::Now();
+    std::vector<ObjectiveFunctionShard> shards(shards_count);
+    pool.for_each(shards_count, [&](size_t shard) {
+      shards[shard].template Build<JIT_IMPLEMENTATION>(objective_function, shard, starting_point.size(), jit);
+    });
+    logger.Log(std::string("ShardedOptimizer: Done ") + (jit ? "compiling" : "differentiating") + " the shards, took " +
+               current::ToString((current::time::Now() - build_begin).count() * 1e-6) + " seconds.");
+
+    const auto f = [&shards, &pool](const std::vector<double_t>& x) {
+      std::vector<double_t> values(shards.size());
+      pool.for_each(shards.size(), [&](size_t shard) { values[shard] = shards[shard].f(x); });
+      return std::accumulate(values.begin(), values.end(), static_cast<double_t>(0));
+    };
+    const auto g = [&shards, &pool](const std::vector<double_t>& x) {
+      std::vector<std::vector<double_t>> gradients(shards.size());
+      pool.for_each(shards.size(), [&](size_t shard) { gradients[shard] = shards[shard].g(x); });
+      std::vector<double_t> result(std::move(gradients[0]));
+      for (size_t shard = 1u; shard < gradients.size(); ++shard) {
+        for (size_t i = 0u; i < result.size(); ++i) {
+          result[i] += gradients[shard][i];
+        }
+      }
+      return result;
+    };
+    return OptimizeImpl<IMPL, DIRECTION>::template RunOptimize<F>(*this, objective_function, f, g, starting_point);
+  }
+};
+
 template <class F,
           OptimizationDirection DIRECTION = OptimizationDirection::Minimize,
           JIT JIT_IMPLEMENTATION = JIT::Default>
@@ -0,0 +1,293 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * *******************************************************************************/
+
+
+// The simplifier of the expression graph, run before JIT compilation.
+//
+// Merges common subexpressions (hash consing: one node per distinct operation or function of the same arguments,
+// with the arguments of `+` and `*` ordered), folds constants, and drops the trivial `x + 0`, `x - 0`, `x * 1`, `x / 1`.
+// All the rewrites preserve the result bit for bit, except for the sign of zero in `-0 + 0`, same as `d_add()` does.
+// Notably, `x * 0` is not folded, since `inf * 0` and `nan * 0` are not zero.
+//
+// The original nodes are not modified, the rewritten ones are appended to the end of the node vector.
+
+#ifndef FNCAS_FNCAS_SIMPLIFY_H
+#define FNCAS_FNCAS_SIMPLIFY_H
+
+#include <cstring>
+#include <sstream>
+#include <stack>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "base.h"
+#include "node.h"
+
+namespace fncas {
+namespace impl {
+
+struct node_simplifier final {
+  struct node_key final {
+    NodeType type;
+    uint8_t operation_or_function;
+    node_index_t lhs;
+    node_index_t rhs;  // Or the bits of the value, for `NodeType::value`.
+    bool operator==(const node_key& rhs_key) const {
+      return type == rhs_key.type && operation_or_function == rhs_key.operation_or_function && lhs == rhs_key.lhs &&
+             rhs == rhs_key.rhs;
+    }
+  };
+
+  struct node_key_hash final {
+    size_t operator()(const node_key& key) const {
+      uint64_t h = (static_cast<uint64_t>(key.type) << 8) | key.operation_or_function;
+      h = h * 0x9e3779b97f4a7c15ull + static_cast<uint64_t>(key.lhs);
+      h = h * 0x9e3779b97f4a7c15ull + static_cast<uint64_t>(key.rhs);
+      return static_cast<size_t>(h ^ (h >> 29));
+    }
+  };
+
+  // `rewritten[i]` is the index of the node equivalent to node `i`, or -1 if not yet known.
+  std::vector<node_index_t> rewritten;
+  std::unordered_map<node_key, node_index_t, node_key_hash> unique;
+
+  static node_key value_key(double_t value) {
+    node_index_t bits;
+    static_assert(sizeof(bits) == sizeof(value), "`node_index_t` and `double_t` should be of the same size.");
+    std::memcpy(&bits, &value, sizeof(bits));
+    return node_key{NodeType::value, 0u, 0, bits};
+  }
+
+  // Returns the existing node for this key, or uses `candidate`, or creates a new node if `candidate` is -1.
+  template <typename F>
+  node_index_t unique_node(const node_key& key, node_index_t candidate, F&& create) {
+    auto const cit = unique.find(key);
+    if (cit != unique.end()) {
+      return cit->second;
+    }
+    if (candidate == -1) {
+      candidate = static_cast<node_index_t>(node_vector_singleton().size());
+      node_vector_singleton().resize(static_cast<size_t>(candidate) + 1u);
+      create(node_vector_singleton()[static_cast<size_t>(candidate)]);
+    }
+    unique[key] = candidate;
+    return candidate;
+  }
+
+  node_index_t value_node(double_t value, node_index_t candidate) {
+    return unique_node(value_key(value), candidate, [value](node_impl& node) {
+      node.type() = NodeType::value;
+      node.value() = value;
+    });
+  }
+
+  static bool is_value(node_index_t i, double_t expected_value) {
+    node_impl& node = node_vector_singleton()[static_cast<size_t>(i)];
+    return node.type() == NodeType::value && node.value() == expected_value;
+  }
+
+  node_index_t simplify_operation(node_index_t original, MathOperation op, node_index_t lhs, node_index_t rhs) {
+    node_impl& a = node_vector_singleton()[static_cast<size_t>(lhs)];
+    node_impl& b = node_vector_singleton()[static_cast<size_t>(rhs)];
+    if (a.type() == NodeType::value && b.type() == NodeType::value) {
+      return value_node(apply_operation<double_t>(op, a.value(), b.value()), -1);
+    }
+    if (op == MathOperation::add || op == MathOperation::subtract) {
+      if (is_value(rhs, 0.0)) {
+        return lhs;
+      } else if (op == MathOperation::add && is_value(lhs, 0.0)) {
+        return rhs;
+      }
+    } else if (op == MathOperation::multiply || op == MathOperation::divide) {
+      if (is_value(rhs, 1.0)) {
+        return lhs;
+      } else if (op == MathOperation::multiply && is_value(lhs, 1.0)) {
+        return rhs;
+      }
+    }
+    bool const commutative = (op == MathOperation::add || op == MathOperation::multiply);
+    node_impl& node = node_vector_singleton()[static_cast<size_t>(original)];
+    bool const unchanged = (node.lhs_index() == lhs && node.rhs_index() == rhs) ||
+                           (commutative && node.lhs_index() == rhs && node.rhs_index() == lhs);
+    if (commutative && lhs > rhs) {
+      std::swap(lhs, rhs);
+    }
+    return unique_node(node_key{NodeType::operation, static_cast<uint8_t>(op), lhs, rhs},
+                       unchanged ? original : -1,
+                       [op, lhs, rhs](node_impl& new_node) {
+                         new_node.type() = NodeType::operation;
+                         new_node.operation() = op;
+                         new_node.lhs_index() = lhs;
+                         new_node.rhs_index() = rhs;
+                       });
+  }
+
+  node_index_t simplify_function(node_index_t original, MathFunction function, node_index_t argument) {
+    node_impl& x = node_vector_singleton()[static_cast<size_t>(argument)];
+    if (x.type() == NodeType::value) {
+      return value_node(::fncas::apply_function<double_t>(function, x.value()), -1);
+    }
+    bool const unchanged = node_vector_singleton()[static_cast<size_t>(original)].argument_index() == argument;
+    return unique_node(node_key{NodeType::function, static_cast<uint8_t>(function), argument, 0},
+                       unchanged ? original : -1,
+                       [function, argument](node_impl& new_node) {
+                         new_node.type() = NodeType::function;
+                         new_node.function() = function;
+                         new_node.argument_index() = argument;
+                       });
+  }
+
+  // Same manual stack as in `eval_node()`, to not overflow the stack on deep expressions.
+  node_index_t simplify(node_index_t index) {
+    std::stack<node_index_t> stack;
+    stack.push(index);
+    while (!stack.empty()) {
+      const node_index_t i = stack.top();
+      stack.pop();
+      const node_index_t dependent_i = ~i;
+      if (i > dependent_i) {
+        if (growing_vector_access(rewritten, i, static_cast<node_index_t>(-1)) == -1) {
+          node_impl& f = node_vector_singleton()[static_cast<size_t>(i)];
+          if (f.type() == NodeType::variable) {
+            rewritten[i] = unique_node(node_key{NodeType::variable, 0u, f.variable(), 0}, i, [](node_impl&) {});
+          } else if (f.type() == NodeType::value) {
+            rewritten[i] = value_node(f.value(), i);
+          } else if (f.type() == NodeType::operation) {
+            stack.push(~i);
+            stack.push(f.lhs_index());
+            stack.push(f.rhs_index());
+          } else if (f.type() == NodeType::function) {
+            stack.push(~i);
+            stack.push(f.argument_index());
+          } else {
+            CURRENT_ASSERT(false);
+          }
+        }
+      } else if (rewritten[dependent_i] == -1) {
+        // The very same node may be pushed more than once before it is rewritten, if it is reachable via several paths.
+        node_impl& f = node_vector_singleton()[static_cast<size_t>(dependent_i)];
+        node_index_t result;
+        if (f.type() == NodeType::operation) {
+          result = simplify_operation(dependent_i, f.operation(), rewritten[f.lhs_index()], rewritten[f.rhs_index()]);
+        } else {
+          result = simplify_function(dependent_i, f.function(), rewritten[f.argument_index()]);
+        }
+        growing_vector_access(rewritten, dependent_i, static_cast<node_index_t>(-1)) = result;
+      }
+    }
+    return rewritten[index];
+  }
+};
+
+// Replaces each of the `indexes` by the index of the simplified node, sharing the common subexpressions among them.
+inline void simplify_nodes(std::vector<node_index_t>& indexes) {
+  node_simplifier simplifier;
+  for (node_index_t& index : indexes) {
+    index = simplifier.simplify(index);
+  }
+}
+
+inline V simplify_node(const V& node) {
+  std::vector<node_index_t> indexes({node.index_});
+  simplify_nodes(indexes);
+  return from_index(indexes.front());
+}
+
+// The number of distinct nodes the `indexes` depend on, themselves included. To measure the effect of `simplify_nodes`.
+inline size_t count_distinct_nodes(const std::vector<node_index_t>& indexes) {
+  std::unordered_set<node_index_t> visited;
+  std::stack<node_index_t> stack;
+  for (node_index_t index : indexes) {
+    stack.push(index);
+  }
+  while (!stack.empty()) {
+    const node_index_t i = stack.top();
+    stack.pop();
+    if (visited.insert(i).second) {
+      node_impl& f = node_vector_singleton()[static_cast<size_t>(i)];
+      if (f.type() == NodeType::operation) {
+        stack.push(f.lhs_index());
+        stack.push(f.rhs_index());
+      } else if (f.type() == NodeType::function) {
+        stack.push(f.argument_index());
+      }
+    }
+  }
+  return visited.size();
+}
+
+// The canonical form of the expressions of the `indexes`, independent of the node indexes: equal for two sets of
+// roots if and only if their expressions are the same, node for node. Used as the key to cache the compiled code.
+inline std::string canonical_expression_key(const std::vector<node_index_t>& indexes) {
+  std::unordered_map<node_index_t, size_t> id;
+  std::ostringstream os;
+  for (node_index_t index : indexes) {
+    std::stack<node_index_t> stack;
+    stack.push(index);
+    while (!stack.empty()) {
+      const node_index_t i = stack.top();
+      stack.pop();
+      const node_index_t dependent_i = ~i;
+      if (i > dependent_i) {
+        if (!id.count(i)) {
+          node_impl& f = node_vector_singleton()[static_cast<size_t>(i)];
+          if (f.type() == NodeType::variable) {
+            os << 'x' << f.variable() << ';';
+            id[i] = id.size();
+          } else if (f.type() == NodeType::value) {
+            os << 'v' << node_simplifier::value_key(f.value()).rhs << ';';
+            id[i] = id.size();
+          } else if (f.type() == NodeType::operation) {
+            stack.push(~i);
+            stack.push(f.lhs_index());
+            stack.push(f.rhs_index());
+          } else if (f.type() == NodeType::function) {
+            stack.push(~i);
+            stack.push(f.argument_index());
+          } else {
+            CURRENT_ASSERT(false);
+          }
+        }
+      } else if (!id.count(dependent_i)) {
+        node_impl& f = node_vector_singleton()[static_cast<size_t>(dependent_i)];
+        if (f.type() == NodeType::operation) {
+          os << 'o' << static_cast<int>(f.operation()) << ',' << id[f.lhs_index()] << ',' << id[f.rhs_index()] << ';';
+        } else {
+          os << 'f' << static_cast<int>(f.function()) << ',' << id[f.argument_index()] << ';';
+        }
+        id[dependent_i] = id.size();
+      }
+    }
+    os << 'r' << id[index] << ';';
+  }
+  return os.str();
+}
+
+}  // namespace impl
+}  // namespace fncas
+
+#endif  // #ifndef FNCAS_FNCAS_SIMPLIFY_H
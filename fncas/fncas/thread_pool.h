@@ -0,0 +1,135 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2023 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * *******************************************************************************/
+
+// The pool of threads to evaluate the shards of an objective function concurrently, see `ShardedOptimizer`.
+
+#ifndef FNCAS_FNCAS_THREAD_POOL_H
+#define FNCAS_FNCAS_THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base.h"
+
+namespace fncas {
+namespace impl {
+
+class thread_pool final : noncopyable {
+ public:
+  // `threads` is the total number of threads to run on, the calling one included; zero is one per CPU core.
+  explicit thread_pool(size_t threads = 0u) {
+    const size_t total = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 1u; i < total; ++i) {
+      threads_.emplace_back(&thread_pool::thread, this);
+    }
+  }
+
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      terminating_ = true;
+    }
+    work_available_.notify_all();
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  size_t threads_count() const { return threads_.size() + 1u; }
+
+  // Calls `f(i)` for each `i` in `[0, n)`, concurrently, and returns once all the calls have returned.
+  // The first exception thrown by `f`, if any, is rethrown. Should only be called from one thread at a time.
+  void for_each(size_t n, const std::function<void(size_t)>& f) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    job_ = &f;
+    n_ = n;
+    next_ = 0u;
+    pending_ = n;
+    exception_ = nullptr;
+    work_available_.notify_all();
+    run_tasks(lock);
+    all_done_.wait(lock, [this]() { return pending_ == 0u; });
+    job_ = nullptr;
+    if (exception_) {
+      std::exception_ptr exception = nullptr;
+      std::swap(exception, exception_);
+      std::rethrow_exception(exception);
+    }
+  }
+
+ private:
+  void run_tasks(std::unique_lock<std::mutex>& lock) {
+    while (job_ && next_ < n_) {
+      const size_t i = next_++;
+      const std::function<void(size_t)>& f = *job_;
+      lock.unlock();
+      std::exception_ptr exception = nullptr;
+      try {
+        f(i);
+      } catch (...) {
+        exception = std::current_exception();
+      }
+      lock.lock();
+      if (exception && !exception_) {
+        exception_ = exception;
+      }
+      if (!--pending_) {
+        all_done_.notify_all();
+      }
+    }
+  }
+
+  void thread() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      work_available_.wait(lock, [this]() { return terminating_ || (job_ && next_ < n_); });
+      if (terminating_) {
+        return;
+      }
+      run_tasks(lock);
+    }
+  }
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::condition_variable all_done_;
+  const std::function<void(size_t)>* job_ = nullptr;
+  size_t n_ = 0u;
+  size_t next_ = 0u;
+  size_t pending_ = 0u;
+  std::exception_ptr exception_ = nullptr;
+  bool terminating_ = false;
+};
+
+}  // namespace impl
+}  // namespace fncas
+
+#endif  // #ifndef FNCAS_FNCAS_THREAD_POOL_H
@@ -38,6 +38,7 @@ SOFTWARE.
 
 #include "fncas.h"
 
+#include <array>
 #include <functional>
 #include <thread>
 
@@ -47,6 +48,7 @@ SOFTWARE.
 #endif
 
 #include "x64_native_jit/test.cc"
+#include "aarch64_native_jit/test.cc"
 
 template <typename T>
 T ParametrizedFunction(const std::vector<T>& x, size_t c) {
@@ -200,6 +202,57 @@ TEST(FnCAS, GradientsWrapper) {
   EXPECT_EQ(36, d_3_3_intermediate[1]);
 }
 
+TEST(FnCAS, ReverseModeGradientMatchesPerVariableDifferentiation) {
+  const fncas::variables_vector_t x(3);
+  // All the functions and operations, with shared subterms, and with a constant-only subterm.
+  const fncas::term_t t = x[0] * x[1] - x[2] / (x[0] + 3.0);
+  const fncas::term_t f = fncas::sqr(t) + fncas::sqrt(fncas::exp(t) + x[2] * x[2]) + fncas::log(2.0 + fncas::sin(t)) +
+                          fncas::cos(x[1]) * fncas::tan(x[0] * 0.1) + fncas::asin(x[2] * 0.1) -
+                          fncas::acos(x[0] * 0.2) / fncas::atan(x[1] + 5.0) + fncas::ramp(t) + fncas::sqrt(16.0) * t;
+  const fncas::function_t<fncas::JIT::Blueprint> fi(f);
+  const fncas::gradient_t<fncas::JIT::Blueprint> gi(x, fi);
+  for (const std::vector<double>& p : {std::vector<double>({1.0, 2.0, 3.0}), std::vector<double>({-0.5, 0.25, 1.5})}) {
+    const std::vector<double> g = gi(p);
+    ASSERT_EQ(3u, g.size());
+    for (size_t i = 0; i < 3u; ++i) {
+      const fncas::term_t d = f.differentiate(x, i);
+      EXPECT_NEAR(d(p), g[i], 1e-9) << i;
+      EXPECT_NEAR(fncas::impl::approximate_derivative(fi, p, i), g[i], 1e-5) << i;
+    }
+  }
+}
+
+TEST(FnCAS, ReverseModeGradientSizeIsProportionalToFunctionSize) {
+  using fncas::impl::count_distinct_nodes;
+  const size_t n = 10000u;
+  const fncas::variables_vector_t x(n);
+  fncas::term_t sum = 0.0;
+  fncas::term_t f = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    sum += x[i];
+    f += fncas::sqr(x[i] - x[(i + 1) % n]);
+  }
+  // Each term of `f` depends on all the variables, via `sum`.
+  f += fncas::log(1.0 + fncas::exp(sum * 1e-3));
+  const fncas::function_t<fncas::JIT::Blueprint> fi(f);
+  const fncas::gradient_t<fncas::JIT::Blueprint> gi(x, fi);
+  std::vector<fncas::impl::node_index_t> g(n);
+  for (size_t i = 0; i < n; ++i) {
+    g[i] = gi.g_[i].index();
+  }
+  EXPECT_LT(count_distinct_nodes(g), 5u * count_distinct_nodes({f.index()}));
+
+  std::vector<double> p(n);
+  for (size_t i = 0; i < n; ++i) {
+    p[i] = 1e-3 * i;
+  }
+  const std::vector<double> actual = gi(p);
+  const double s = 1e-3 * (0.5 * n * (n - 1)) * 1e-3;
+  const double softplus_derivative = 1e-3 / (1.0 + std::exp(-s));
+  EXPECT_NEAR(2.0 * (p[0] - p[1]) - 2.0 * (p[n - 1] - p[0]) + softplus_derivative, actual[0], 1e-9);
+  EXPECT_NEAR(2.0 * (p[5] - p[6]) - 2.0 * (p[4] - p[5]) + softplus_derivative, actual[5], 1e-9);
+}
+
 #ifdef FNCAS_JIT_COMPILED
 TEST(FnCAS, JITGradientsWrapper) {
   std::vector<fncas::double_t> p_3_3({3.0, 3.0});
@@ -256,6 +309,158 @@ TEST(FnCAS, CannotEvaluateMoreThanOneFunctionPerThreadAtOnce) {
   ASSERT_THROW(fncas::variables_vector_t x(2), fncas::exceptions::FnCASConcurrentEvaluationAttemptException);
 }
 
+TEST(FnCAS, ExpressionContexts) {
+  // Two functions recorded at once on the same thread, each in its own context.
+  fncas::expression_context_t c1;
+  fncas::expression_context_t c2;
+  std::unique_ptr<fncas::function_t<fncas::JIT::Blueprint>> f1;
+  std::unique_ptr<fncas::function_t<fncas::JIT::Blueprint>> f2;
+  {
+    fncas::expression_context_scope_t s1(c1);
+    fncas::variables_vector_t x1(2);
+    {
+      fncas::expression_context_scope_t s2(c2);
+      fncas::variables_vector_t x2(2);
+      f2 = std::make_unique<fncas::function_t<fncas::JIT::Blueprint>>(ParametrizedFunction(x2, 2));
+    }
+    f1 = std::make_unique<fncas::function_t<fncas::JIT::Blueprint>>(ParametrizedFunction(x1, 1));
+  }
+
+  // The contexts are movable, and the functions recorded within them stay valid.
+  fncas::expression_context_t moved(std::move(c1));
+  {
+    fncas::expression_context_scope_t scope(moved);
+    EXPECT_EQ(fncas::sqr(1.0 + 2.0 * 1), (*f1)({1.0, 2.0}));
+  }
+  {
+    fncas::expression_context_scope_t scope(c2);
+    EXPECT_EQ(fncas::sqr(1.0 + 2.0 * 2), (*f2)({1.0, 2.0}));
+  }
+
+  // The default, thread-local, context is not affected.
+  fncas::variables_vector_t x(1);
+
+  // A context can only be active on one thread at a time.
+  {
+    fncas::expression_context_scope_t scope(c2);
+    std::thread([&c2]() {
+      ASSERT_THROW(fncas::expression_context_scope_t another_scope(c2),
+                   fncas::exceptions::FnCASConcurrentEvaluationAttemptException);
+    }).join();
+  }
+  std::thread([&c2]() { fncas::expression_context_scope_t scope(c2); }).join();
+}
+
+#ifdef FNCAS_JIT_COMPILED
+TEST(FnCAS, ExpressionContextsRecordAndCompileConcurrently) {
+  // Each thread records and compiles its own function in its own context, then the compiled functions are shared.
+  std::vector<std::unique_ptr<fncas::function_t<fncas::JIT::Default>>> compiled(4);
+  std::vector<std::unique_ptr<fncas::gradient_t<fncas::JIT::Default>>> compiled_gradients(4);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < compiled.size(); ++i) {
+    threads.emplace_back([i, &compiled, &compiled_gradients]() {
+      fncas::expression_context_t context;
+      fncas::expression_context_scope_t scope(context);
+      fncas::variables_vector_t x(2);
+      const fncas::function_t<fncas::JIT::Blueprint> fi = ParametrizedFunction(x, i + 1);
+      const fncas::gradient_t<fncas::JIT::Blueprint> gi(x, fi);
+      compiled[i] = std::make_unique<fncas::function_t<fncas::JIT::Default>>(fi);
+      compiled_gradients[i] = std::make_unique<fncas::gradient_t<fncas::JIT::Default>>(fi, gi);
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+
+  // The contexts are gone by now, and each compiled function is evaluated from several threads at once.
+  threads.clear();
+  for (size_t t = 0; t < 4u; ++t) {
+    threads.emplace_back([&compiled, &compiled_gradients]() {
+      for (size_t iteration = 0; iteration < 1000; ++iteration) {
+        for (size_t i = 0; i < compiled.size(); ++i) {
+          const double k = 2.0 * (i + 1);
+          EXPECT_EQ(fncas::sqr(1.0 + k), (*compiled[i])({1.0, 2.0}));
+          const std::vector<double> g = (*compiled_gradients[i])({1.0, 2.0});
+          EXPECT_EQ(2.0 * (1.0 + k), g[0]);
+          EXPECT_EQ(2.0 * (1.0 + k) * (i + 1), g[1]);
+        }
+      }
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+}
+
+TEST(FnCAS, JITCompiledCodeCache) {
+  using fncas::impl::compiled_code_cache;
+  compiled_code_cache& cache = compiled_code_cache::instance();
+  cache.Clear();
+
+  // The same expression, recorded in two different contexts, with different node indexes, is compiled once.
+  const auto compile = [](size_t padding) {
+    fncas::expression_context_t context;
+    fncas::expression_context_scope_t scope(context);
+    fncas::variables_vector_t x(2);
+    for (size_t i = 0; i < padding; ++i) {
+      static_cast<void>(x[0] + static_cast<double>(i));
+    }
+    const fncas::function_t<fncas::JIT::Blueprint> fi = SimpleFunction(x);
+    const fncas::gradient_t<fncas::JIT::Blueprint> gi(x, fi);
+    const fncas::function_t<fncas::JIT::Default> fc(fi);
+    const fncas::gradient_t<fncas::JIT::Default> gc(fi, gi);
+    EXPECT_EQ(81, fc({3.0, 3.0}));
+    EXPECT_EQ(36, gc({3.0, 3.0})[1]);
+  };
+  compile(0u);
+  EXPECT_EQ(2u, cache.GetStats().misses);
+  EXPECT_EQ(0u, cache.GetStats().hits);
+  compile(10u);
+  EXPECT_EQ(2u, cache.GetStats().misses);
+  EXPECT_EQ(2u, cache.GetStats().hits);
+
+  // A different expression is not a hit.
+  {
+    fncas::variables_vector_t x(2);
+    const fncas::function_t<fncas::JIT::Blueprint> fi = ParametrizedFunction(x, 3);
+    const fncas::function_t<fncas::JIT::Default> fc(fi);
+    EXPECT_EQ(fncas::sqr(1.0 + 2.0 * 3), fc({1.0, 2.0}));
+    EXPECT_EQ(3u, cache.GetStats().misses);
+  }
+
+  // With the disk directory set, the `.so`-s built by `as` are reused after the memory cache is cleared.
+  const std::string directory = current::FileSystem::GenTmpFileName();
+  current::FileSystem::MkDir(directory);
+  cache.SetDiskDirectory(directory);
+  cache.Clear();
+  std::string lib_filename;
+  for (size_t pass = 0; pass < 2u; ++pass) {
+    fncas::variables_vector_t x(2);
+    const fncas::function_t<fncas::JIT::Blueprint> fi = SimpleFunction(x);
+    const fncas::gradient_t<fncas::JIT::Blueprint> gi(x, fi);
+    const fncas::function_t<fncas::JIT::AS> fc(fi);
+    const fncas::gradient_t<fncas::JIT::AS> gc(fi, gi);
+    EXPECT_EQ(81, fc({3.0, 3.0}));
+    EXPECT_EQ(18, gc({3.0, 3.0})[0]);
+    EXPECT_EQ(36, gc({3.0, 3.0})[1]);
+    if (!pass) {
+      lib_filename = fc.lib_filename();
+      cache.Clear();
+    } else {
+      EXPECT_EQ(lib_filename, fc.lib_filename());
+    }
+  }
+  EXPECT_EQ(2u, cache.GetStats().disk_hits);
+  EXPECT_EQ(0u, cache.GetStats().misses);
+
+  cache.SetDiskDirectory("");
+  cache.Clear();
+  current::FileSystem::RmDir(directory,
+                             current::FileSystem::RmDirParameters::Silent,
+                             current::FileSystem::RmDirRecursive::Yes);
+}
+#endif  // FNCAS_JIT_COMPILED
+
 // An obviously convex function with a single minimum `f(3, 4) == 1`.
 struct StaticFunction {
   template <typename T>
@@ -548,6 +753,42 @@ TEST(FnCAS, JITOptimizationOfHimmelblauUsingConjugateGradient) {
   EXPECT_NEAR(3.584428, min4.point[0], 1e-6);
   EXPECT_NEAR(-1.848126, min4.point[1], 1e-6);
 }
+
+TEST(FnCAS, JITOptimizationOfRosenbrockUsingLBFGS) {
+  const auto result = fncas::optimize::LBFGSOptimizer<RosenbrockFunction>().Optimize({-3.0, -4.0});
+  EXPECT_NEAR(0.0, result.value, 1e-6);
+  ASSERT_EQ(2u, result.point.size());
+  EXPECT_NEAR(1.0, result.point[0], 1e-6);
+  EXPECT_NEAR(1.0, result.point[1], 1e-6);
+}
+
+TEST(FnCAS, JITOptimizationOfHimmelblauUsingLBFGS) {
+  fncas::optimize::LBFGSOptimizer<HimmelblauFunction> optimizer;
+
+  const auto min1 = optimizer.Optimize({5.0, 5.0});
+  EXPECT_NEAR(0.0, min1.value, 1e-6);
+  ASSERT_EQ(2u, min1.point.size());
+  EXPECT_NEAR(3.0, min1.point[0], 1e-6);
+  EXPECT_NEAR(2.0, min1.point[1], 1e-6);
+
+  const auto min2 = optimizer.Optimize({-3.0, 5.0});
+  EXPECT_NEAR(0.0, min2.value, 1e-6);
+  ASSERT_EQ(2u, min2.point.size());
+  EXPECT_NEAR(-2.805118, min2.point[0], 1e-6);
+  EXPECT_NEAR(3.131312, min2.point[1], 1e-6);
+
+  const auto min3 = optimizer.Optimize({-5.0, -5.0});
+  EXPECT_NEAR(0.0, min3.value, 1e-6);
+  ASSERT_EQ(2u, min3.point.size());
+  EXPECT_NEAR(-3.779310, min3.point[0], 1e-6);
+  EXPECT_NEAR(-3.283186, min3.point[1], 1e-6);
+
+  const auto min4 = optimizer.Optimize({5.0, -5.0});
+  EXPECT_NEAR(0.0, min4.value, 1e-6);
+  ASSERT_EQ(2u, min4.point.size());
+  EXPECT_NEAR(3.584428, min4.point[0], 1e-6);
+  EXPECT_NEAR(-1.848126, min4.point[1], 1e-6);
+}
 #endif  // FNCAS_JIT_COMPILED
 
 TEST(FnCAS, OptimizationOfAPolynomialMemberFunctionNoJIT) {
@@ -669,6 +910,79 @@ TEST(FnCAS, ConjugateGDvsBacktrackingGDOnRosenbrockFunction100StepsNoJIT) {
   EXPECT_NEAR(1.0, result_cg.point[1], 1e-6);
 }
 
+TEST(FnCAS, OptimizationOfAPolynomialUsingLBFGSNoJIT) {
+  const auto result =
+      fncas::optimize::LBFGSOptimizer<PolynomialFunction>(fncas::optimize::OptimizerParameters().DisableJIT())
+          .Optimize({5.0, 20.0});
+  EXPECT_NEAR(0.0, result.value, 1e-6);
+  ASSERT_EQ(2u, result.point.size());
+  EXPECT_NEAR(0.0, result.point[0], 1e-6);
+  EXPECT_NEAR(0.0, result.point[1], 1e-6);
+}
+
+// Check that L-BFGS takes fewer steps than the conjugate gradient optimizer to minimize the Rosenbrock function.
+TEST(FnCAS, LBFGSvsConjugateGDOnRosenbrockFunctionNoJIT) {
+  fncas::optimize::OptimizerParameters params;
+  params.DisableJIT();
+  const auto result_lbfgs = fncas::optimize::LBFGSOptimizer<RosenbrockFunction>(params).Optimize({-3.0, -4.0});
+  const auto result_cg = fncas::optimize::ConjugateGradientOptimizer<RosenbrockFunction>(params).Optimize({-3.0, -4.0});
+  EXPECT_NEAR(1.0, result_lbfgs.point[0], 1e-6);
+  EXPECT_NEAR(1.0, result_lbfgs.point[1], 1e-6);
+  EXPECT_LT(result_lbfgs.optimization_iterations, result_cg.optimization_iterations);
+}
+
+// Least squares fit of `y = a * x + b` over the points `(i, 3 * i - 5 + noise)`, split into shards of 25 points.
+struct ShardedLinearRegression : fncas::optimize::ShardedObjectiveFunction<ShardedLinearRegression> {
+  size_t Shards() const { return 8u; }
+  template <typename T>
+  T ShardObjectiveFunction(const std::vector<T>& p, size_t shard) const {
+    T result = 0.0 * p[0];
+    for (size_t j = 0; j < 25u; ++j) {
+      const double x = 0.01 * static_cast<double>(shard * 25u + j);
+      const double y = 3.0 * x - 5.0 + ((j % 3u) ? +0.1 : -0.2);
+      const T d = p[0] * x + p[1] - y;
+      result = result + d * d;
+    }
+    return result;
+  }
+};
+
+TEST(FnCAS, ShardedOptimizationNoJIT) {
+  const auto baseline = fncas::optimize::LBFGSOptimizer<ShardedLinearRegression>(
+                            fncas::optimize::OptimizerParameters().DisableJIT())
+                            .Optimize({0.0, 0.0});
+  EXPECT_NEAR(3.0, baseline.point[0], 0.1);
+  EXPECT_NEAR(-5.0, baseline.point[1], 0.1);
+  for (size_t threads : {1u, 3u, 8u}) {
+    fncas::optimize::OptimizerParameters params;
+    params.DisableJIT();
+    params.SetValue("threads", threads);
+    const auto result = fncas::optimize::ShardedOptimizer<ShardedLinearRegression>(params).Optimize({0.0, 0.0});
+    EXPECT_NEAR(baseline.value, result.value, 1e-9) << threads;
+    ASSERT_EQ(2u, result.point.size());
+    EXPECT_NEAR(baseline.point[0], result.point[0], 1e-6) << threads;
+    EXPECT_NEAR(baseline.point[1], result.point[1], 1e-6) << threads;
+  }
+}
+
+#ifdef FNCAS_JIT_COMPILED
+TEST(FnCAS, JITShardedOptimization) {
+  // The shards are summed in their order, so the result does not depend on the number of threads.
+  std::vector<fncas::optimize::OptimizationResult> results;
+  for (size_t threads : {1u, 4u}) {
+    fncas::optimize::OptimizerParameters params;
+    params.SetValue("threads", threads);
+    params.TrackOptimizationProgress();
+    results.push_back(fncas::optimize::ShardedOptimizer<ShardedLinearRegression>(params).Optimize({0.0, 0.0}));
+  }
+  EXPECT_NEAR(3.0, results[0].point[0], 0.1);
+  EXPECT_NEAR(-5.0, results[0].point[1], 0.1);
+  EXPECT_EQ(JSON(results[0]), JSON(results[1]));
+  ASSERT_TRUE(Exists(results[0].progress));
+  EXPECT_NEAR(results[0].value, Value(results[0].progress).objective_function_values.back(), 1e-9);
+}
+#endif  // FNCAS_JIT_COMPILED
+
 // To test evaluation and differentiation.
 template <typename T>
 T ZeroOrXFunction(const std::vector<T> x) {
@@ -832,6 +1146,20 @@ TEST(FnCAS, OptimizationInMaximizingDirection) {
     EXPECT_NEAR(6.0, result.point[0], 5e-2);
     EXPECT_NEAR(7.0, result.point[1], 5e-2);
   }
+
+  {
+    MemberFunction f;
+    f.a = 8.0;
+    f.b = 9.0;
+    f.k = -1;
+    const auto result = fncas::optimize::LBFGSOptimizer<MemberFunction, fncas::OptimizationDirection::Maximize>(
+                            fncas::optimize::OptimizerParameters().DisableJIT(), f)
+                            .Optimize({0, 0});
+    EXPECT_NEAR(-1, result.value, 1e-3);
+    ASSERT_EQ(2u, result.point.size());
+    EXPECT_NEAR(8.0, result.point[0], 5e-2);
+    EXPECT_NEAR(9.0, result.point[1], 5e-2);
+  }
 }
 
 #ifdef FNCAS_X64_NATIVE_JIT_ENABLED
@@ -879,6 +1207,25 @@ T SoftmaxFunction(const std::vector<T>& x) {
   return penalty - (2.0 - std::log(2.0));
 }
 
+template <typename T>
+T ManyLiveValuesFunction(const std::vector<T>& x) {
+  // More intermediate values are alive at once than there are `xmm` registers, and external calls are interleaved,
+  // so that the native JIT has to spill both because it runs out of registers and because of the calls.
+  CURRENT_ASSERT(x.size() == 3u);
+  std::array<T, 40> t;
+  for (size_t k = 0; k < t.size(); ++k) {
+    t[k] = x[k % 3] * (k + 1.0) + x[(k + 1) % 3];
+    if (k % 7 == 3) {
+      t[k] = t[k] + fncas::exp(t[k] * 0.01);
+    }
+  }
+  T result = 0.0;
+  for (size_t k = 0; k < t.size(); ++k) {
+    result += t[k] * t[t.size() - 1 - k] - fncas::sqr(t[k] - x[2]) / (k + 2.0);
+  }
+  return result;
+}
+
 }  // namespace x64_native_jit_test
 
 TEST(FnCASX64NativeJIT, TrivialFunctions) {
@@ -993,6 +1340,64 @@ TEST(FnCASX64NativeJIT, GradientOfSoftmaxFunction) {
   EXPECT_NEAR(gi({0.0})[0], gc({0.0})[0], 1e-6);
 }
 
+TEST(FnCASX64NativeJIT, SpillsWhenOutOfRegisters) {
+  const fncas::variables_vector_t x(3);
+  const fncas::function_t<fncas::JIT::Blueprint> fi = x64_native_jit_test::ManyLiveValuesFunction(x);
+  const fncas::gradient_t<fncas::JIT::Blueprint> gi(x, fi);
+
+  const fncas::function_t<fncas::JIT::X64NativeJIT> fc(fi);
+  const fncas::gradient_t<fncas::JIT::X64NativeJIT> gc(fi, gi);
+
+  for (const std::vector<double>& p : {std::vector<double>({0.0, 0.0, 0.0}),
+                                       std::vector<double>({1.0, -2.0, 3.0}),
+                                       std::vector<double>({-0.5, 0.25, 7.5})}) {
+    EXPECT_EQ(x64_native_jit_test::ManyLiveValuesFunction(p), fc(p));
+    EXPECT_EQ(fi(p), fc(p));
+    const std::vector<double> expected = gi(p);
+    const std::vector<double> actual = gc(p);
+    ASSERT_EQ(3u, actual.size());
+    for (size_t i = 0; i < 3u; ++i) {
+      EXPECT_EQ(expected[i], actual[i]) << i;
+    }
+  }
+}
+
+TEST(FnCASX64NativeJIT, BatchEvaluation) {
+  const fncas::variables_vector_t x(3);
+  const fncas::function_t<fncas::JIT::Blueprint> fi = x64_native_jit_test::ManyLiveValuesFunction(x);
+  const fncas::gradient_t<fncas::JIT::Blueprint> gi(x, fi);
+
+  const fncas::function_t<fncas::JIT::X64NativeJIT> fc(fi);
+  const fncas::gradient_t<fncas::JIT::X64NativeJIT> gc(fi, gi);
+
+  // Seven points, so that the last batch of four is incomplete.
+  std::vector<std::vector<double>> points;
+  for (size_t j = 0; j < 7u; ++j) {
+    points.push_back({0.5 * j, 1.0 - 0.25 * j, std::sqrt(j + 1.0)});
+  }
+
+  const std::vector<double> values = fc.batch(points);
+  const std::vector<std::vector<double>> gradients = gc.batch(points);
+  ASSERT_EQ(points.size(), values.size());
+  ASSERT_EQ(points.size(), gradients.size());
+  for (size_t j = 0; j < points.size(); ++j) {
+    EXPECT_EQ(fc(points[j]), values[j]) << j;
+    const std::vector<double> expected = gc(points[j]);
+    ASSERT_EQ(3u, gradients[j].size());
+    for (size_t i = 0; i < 3u; ++i) {
+      EXPECT_EQ(expected[i], gradients[j][i]) << j << ' ' << i;
+    }
+  }
+
+  // The inlined `sqrt`, and the external functions called in place, in the batch code.
+  const fncas::function_t<fncas::JIT::Blueprint> hi = fncas::sqrt(x[0] * x[0] + 1.0) + fncas::log(fncas::exp(x[1]) + x[2]);
+  const fncas::function_t<fncas::JIT::X64NativeJIT> hc(hi);
+  const std::vector<double> h = hc.batch(points);
+  for (size_t j = 0; j < points.size(); ++j) {
+    EXPECT_EQ(hi(points[j]), h[j]) << j;
+  }
+}
+
 namespace functions_to_simplify_gradients {
 
 template <typename T>
@@ -1056,4 +1461,169 @@ TEST(FnCASGradientSimplification, Smoke) {
   }
 }
 
+TEST(FnCASGradientSimplification, CommonSubexpressionsAndTrivialOperations) {
+  using fncas::impl::count_distinct_nodes;
+  using fncas::impl::node_index_t;
+  using fncas::impl::simplify_node;
+  using fncas::impl::simplify_nodes;
+  {
+    const fncas::variables_vector_t x(2);
+    // The same `exp(x[0] * x[1])` is recorded three times, and `x[1] * x[0]` is the same product.
+    const fncas::term_t f = fncas::exp(x[0] * x[1]) * 1.0 + fncas::exp(x[1] * x[0]) / 1.0 - 0.0 +
+                            (fncas::exp(x[0] * x[1]) + (2.0 * 3.0 - 6.0)) * (fncas::sqrt(4.0) + x[0]);
+    const fncas::term_t s = simplify_node(f);
+    EXPECT_EQ("(((2+x[0])*exp((x[0]*x[1])))+(exp((x[0]*x[1]))+exp((x[0]*x[1]))))", s.debug_as_string());
+    EXPECT_EQ(19u, count_distinct_nodes({f.index()}));
+    EXPECT_EQ(9u, count_distinct_nodes({s.index()}));
+    EXPECT_EQ(f({0.5, 3.0}), s({0.5, 3.0}));
+    EXPECT_EQ(s.index(), simplify_node(s).index());
+  }
+  {
+    const fncas::variables_vector_t x(3);
+    const fncas::function_t<fncas::JIT::Blueprint> fi = x64_native_jit_test::ManyLiveValuesFunction(x);
+    const fncas::gradient_t<fncas::JIT::Blueprint> gi(x, fi);
+    std::vector<node_index_t> g({gi.g_[0].index(), gi.g_[1].index(), gi.g_[2].index()});
+    const size_t original_size = count_distinct_nodes(g);
+    simplify_nodes(g);
+    EXPECT_LT(count_distinct_nodes(g), original_size);
+    const std::vector<double> p({1.0, -2.0, 3.0});
+    const std::vector<double> expected = gi(p);
+    for (size_t i = 0; i < 3u; ++i) {
+      EXPECT_EQ(expected[i], fncas::term_t(fncas::impl::from_index(g[i]))(p)) << i;
+    }
+  }
+}
+
 #endif  // FNCAS_X64_NATIVE_JIT_ENABLED
+
+// The AArch64 code generator runs on every platform, so its output is tested here against the disassembly.
+TEST(FnCASAArch64NativeJIT, GeneratesCode) {
+  const fncas::variables_vector_t x(2);
+  const fncas::term_t f = x[0] * x[1] + fncas::sin(x[0]) / (x[1] - 2.0) + fncas::sqrt(x[1]);
+
+  std::vector<uint32_t> code;
+  fncas::impl::AArch64JITCodeGenerator code_generator(code, 0);
+  code_generator.jit_compile_node(f.index_);
+  code_generator.jit_return_node(f.index_);
+  code_generator.jit_generate_code();
+
+  // clang-format off
+  const std::vector<uint32_t> expected({
+    0xa9bd7bfd,  // stp   x29, x30, [sp, #-48]!
+    0x910003fd,  // mov   x29, sp
+    0xa90153f3,  // stp   x19, x20, [sp, #16]
+    0xf90013f5,  // str   x21, [sp, #32]
+    0xaa0003f4,  // mov   x20, x0
+    0xaa0103f3,  // mov   x19, x1
+    0xaa0203f5,  // mov   x21, x2
+    0xfd400680,  // ldr   d0, [x20, #8]
+    0x1e61c000,  // fsqrt d0, d0
+    0xfd400681,  // ldr   d1, [x20, #8]
+    0xd2800009,  // mov   x9, #0
+    0xf2e80009,  // movk  x9, #16384, lsl #48
+    0x9e67013f,  // fmov  d31, x9
+    0x1e7f3821,  // fsub  d1, d1, d31
+    0xfd001260,  // str   d0, [x19, #32]
+    0xfd001a61,  // str   d1, [x19, #48]
+    0xfd400280,  // ldr   d0, [x20]
+    0xf94012a9,  // ldr   x9, [x21, #32]
+    0xd63f0120,  // blr   x9
+    0xfd401a7f,  // ldr   d31, [x19, #48]
+    0x1e7f1800,  // fdiv  d0, d0, d31
+    0xfd400281,  // ldr   d1, [x20]
+    0xfd40069f,  // ldr   d31, [x20, #8]
+    0x1e7f0821,  // fmul  d1, d1, d31
+    0x1e602821,  // fadd  d1, d1, d0
+    0xfd40127f,  // ldr   d31, [x19, #32]
+    0x1e7f2821,  // fadd  d1, d1, d31
+    0x1e604020,  // fmov  d0, d1
+    0xf94013f5,  // ldr   x21, [sp, #32]
+    0xa94153f3,  // ldp   x19, x20, [sp, #16]
+    0xa8c37bfd,  // ldp   x29, x30, [sp], #48
+    0xd65f03c0   // ret
+  });
+  // clang-format on
+
+  ASSERT_EQ(expected.size(), code.size());
+  for (size_t i = 0; i < code.size(); ++i) {
+    EXPECT_EQ(expected[i], code[i]) << i;
+  }
+}
+
+#ifdef FNCAS_AARCH64_NATIVE_JIT_ENABLED
+
+namespace aarch64_native_jit_test {
+
+template <typename T>
+T SmokeTestFunction(const std::vector<T>& x) {
+  return fncas::sqr(x[0]) + fncas::ramp(x[1]) + fncas::unit_step(x[2]);
+}
+
+template <typename T>
+T ManyLiveValuesFunction(const std::vector<T>& x) {
+  // More intermediate values are alive at once than there are registers, and external calls are interleaved.
+  CURRENT_ASSERT(x.size() == 3u);
+  std::array<T, 40> t;
+  for (size_t k = 0; k < t.size(); ++k) {
+    t[k] = x[k % 3] * (k + 1.0) + x[(k + 1) % 3];
+    if (k % 7 == 3) {
+      t[k] = t[k] + fncas::exp(t[k] * 0.01) + fncas::sqrt(fncas::sqr(t[k]) + 1.0);
+    }
+  }
+  T result = 0.0;
+  for (size_t k = 0; k < t.size(); ++k) {
+    result += t[k] * t[t.size() - 1 - k] - fncas::sqr(t[k] - x[2]) / (k + 2.0);
+  }
+  return result;
+}
+
+}  // namespace aarch64_native_jit_test
+
+TEST(FnCASAArch64NativeJIT, SimpleFunctions) {
+  {
+    fncas::function_t<fncas::JIT::AArch64NativeJIT> const fn(SimpleFunction(fncas::variables_vector_t(2)));
+    EXPECT_EQ(25.0, fn({1.0, 2.0}));
+  }
+
+  {
+    fncas::function_t<fncas::JIT::AArch64NativeJIT> const fn(
+        aarch64_native_jit_test::SmokeTestFunction(fncas::variables_vector_t(3)));
+    EXPECT_EQ(0.0, fn({0.0, 0.0, -2.0}));
+    EXPECT_EQ(1.0, fn({0.0, 0.0, +2.0}));
+    EXPECT_EQ(2.0, fn({0.0, +2.0, -1.0}));
+    EXPECT_EQ(9.0, fn({3.0, 0.0, -1.0}));
+  }
+}
+
+TEST(FnCASAArch64NativeJIT, GradientOfSimpleFunction) {
+  const fncas::variables_vector_t x(2);
+  const fncas::function_t<fncas::JIT::Blueprint> fi = SimpleFunction(x);
+  const fncas::gradient_t<fncas::JIT::Blueprint> gi(x, fi);
+  const fncas::gradient_t<fncas::JIT::AArch64NativeJIT> gc(fi, gi);
+
+  EXPECT_EQ(18, gc({3.0, 3.0})[0]);
+  EXPECT_EQ(36, gc({3.0, 3.0})[1]);
+}
+
+TEST(FnCASAArch64NativeJIT, SpillsWhenOutOfRegisters) {
+  const fncas::variables_vector_t x(3);
+  const fncas::function_t<fncas::JIT::Blueprint> fi = aarch64_native_jit_test::ManyLiveValuesFunction(x);
+  const fncas::gradient_t<fncas::JIT::Blueprint> gi(x, fi);
+
+  const fncas::function_t<fncas::JIT::AArch64NativeJIT> fc(fi);
+  const fncas::gradient_t<fncas::JIT::AArch64NativeJIT> gc(fi, gi);
+
+  for (const std::vector<double>& p : {std::vector<double>({0.0, 0.0, 0.0}),
+                                       std::vector<double>({1.0, -2.0, 3.0}),
+                                       std::vector<double>({-0.5, 0.25, 7.5})}) {
+    EXPECT_EQ(fi(p), fc(p));
+    const std::vector<double> expected = gi(p);
+    const std::vector<double> actual = gc(p);
+    ASSERT_EQ(3u, actual.size());
+    for (size_t i = 0; i < 3u; ++i) {
+      EXPECT_EQ(expected[i], actual[i]) << i;
+    }
+  }
+}
+
+#endif  // FNCAS_AARCH64_NATIVE_JIT_ENABLED
@@ -430,6 +430,137 @@ TEST(X64NativeJIT, LogExpFunctionsCombination) {
   EXPECT_EQ(a(), j());
 }
 
+TEST(X64NativeJIT, UsesAllXMMRegisters) {
+  using namespace current::fncas::x64_native_jit;
+
+  std::vector<uint8_t> code;
+
+  opcodes::push_rbx(code);
+  opcodes::mov_rsi_rbx(code);
+
+  // Let `xmm{i}` be `x[i]`, and overwrite `xmm15` with an immediate value.
+  for (uint8_t r = 0; r < kX64NativeJITNumberOfXMMRegisters; ++r) {
+    opcodes::load_from_memory_by_rdi_offset_to_xmm(code, r, r);
+  }
+  opcodes::load_immediate_to_xmm(code, 15, 0.5);
+
+  // Let y[0] = x[0] + ... + x[14] + 0.5, summed into `xmm8`, to have both the low and the high registers involved.
+  opcodes::mov_xmm_to_xmm(code, 8, 0);
+  for (uint8_t r = 1; r < kX64NativeJITNumberOfXMMRegisters; ++r) {
+    if (r != 8) {
+      opcodes::add_xmm_to_xmm(code, 8, r);
+    }
+  }
+  opcodes::add_from_memory_by_rdi_offset_to_xmm(code, 8, 8);
+  opcodes::store_xmm_to_memory_by_rbx_offset(code, 8, 0);
+
+  // Let y[1] = (x[13] - x[2]) * x[10] / x[3], computed in `xmm13`.
+  opcodes::sub_xmm_from_xmm(code, 13, 2);
+  opcodes::mul_xmm_by_xmm(code, 13, 10);
+  opcodes::div_xmm_by_xmm(code, 13, 3);
+  opcodes::store_xmm_to_memory_by_rbx_offset(code, 13, 1);
+
+  // Let y[2] = ((x[4] + y[1]) - x[5]) * x[6] / y[1], computed in `xmm12`, with the memory operands.
+  opcodes::load_from_memory_by_rdi_offset_to_xmm(code, 12, 4);
+  opcodes::add_from_memory_by_rbx_offset_to_xmm(code, 12, 1);
+  opcodes::sub_from_memory_by_rdi_offset_to_xmm(code, 12, 5);
+  opcodes::mul_from_memory_by_rdi_offset_to_xmm(code, 12, 6);
+  opcodes::div_from_memory_by_rbx_offset_to_xmm(code, 12, 1);
+  opcodes::store_xmm_to_memory_by_rbx_offset(code, 12, 2);
+
+  // Let y[3] = (y[2] - y[1]) * y[1] / x[7], computed in `xmm1`, and return it via `xmm0`.
+  opcodes::load_from_memory_by_rbx_offset_to_xmm(code, 1, 2);
+  opcodes::sub_from_memory_by_rbx_offset_to_xmm(code, 1, 1);
+  opcodes::mul_from_memory_by_rbx_offset_to_xmm(code, 1, 1);
+  opcodes::div_from_memory_by_rdi_offset_to_xmm(code, 1, 7);
+  opcodes::store_xmm_to_memory_by_rbx_offset(code, 1, 3);
+  opcodes::mov_xmm_to_xmm(code, 0, 1);
+
+  opcodes::pop_rbx(code);
+  opcodes::ret(code);
+
+  std::vector<double> x(kX64NativeJITNumberOfXMMRegisters);
+  for (size_t i = 0; i < x.size(); ++i) {
+    x[i] = static_cast<double>(i + 1);
+  }
+  std::vector<double> y(4);
+
+  double const r = (current::fncas::x64_native_jit::CallableVectorUInt8(code))(&x[0], &y[0], nullptr);
+
+  EXPECT_EQ(120.5, y[0]);  // 1 + ... + 15 + 0.5, where `x[8]`, overwritten in `xmm8`, is added back from memory.
+  EXPECT_EQ((14.0 - 3.0) * 11.0 / 4.0, y[1]);
+  EXPECT_EQ(((5.0 + y[1]) - 6.0) * 7.0 / y[1], y[2]);
+  EXPECT_EQ((y[2] - y[1]) * y[1] / 8.0, y[3]);
+  EXPECT_EQ(y[3], r);
+}
+
+TEST(X64NativeJIT, BatchOfFourPointsWithYMMRegisters) {
+  using namespace current::fncas::x64_native_jit;
+
+  if (!X64NativeJITBatchSupported()) {
+    std::cerr << "Skipping the batch test, as this CPU does not support AVX2.\n";
+    return;
+  }
+
+  std::vector<uint8_t> code;
+
+  opcodes::push_rbx(code);
+  opcodes::mov_rsi_rbx(code);
+
+  // Let y[0] = sqrt((x[0] + 0.5) * x[1] - x[0]) / x[1], computed in `ymm9`, and using `ymm2` for `x[1]`.
+  opcodes::load_from_memory_by_rdi_offset_to_ymm(code, 2, 1);
+  opcodes::load_immediate_to_ymm(code, 9, 0.5);
+  opcodes::add_from_memory_by_rdi_offset_to_ymm(code, 9, 0);
+  opcodes::mul_ymm_by_ymm(code, 9, 2);
+  opcodes::sub_from_memory_by_rdi_offset_to_ymm(code, 9, 0);
+  opcodes::sqrt_ymm_to_ymm(code, 14, 9);
+  opcodes::div_ymm_by_ymm(code, 14, 2);
+  opcodes::mov_ymm_to_ymm(code, 3, 14);
+  opcodes::store_ymm_to_memory_by_rbx_offset(code, 3, 0);
+
+  // Let y[1] = (y[0] * x[0] + y[0]) / y[0], with the memory operands, computed in `ymm0`.
+  opcodes::load_from_memory_by_rbx_offset_to_ymm(code, 0, 0);
+  opcodes::mul_from_memory_by_rdi_offset_to_ymm(code, 0, 0);
+  opcodes::add_from_memory_by_rbx_offset_to_ymm(code, 0, 0);
+  opcodes::div_from_memory_by_rbx_offset_to_ymm(code, 0, 0);
+  opcodes::store_ymm_to_memory_by_rbx_offset(code, 0, 1);
+
+  // Let y[2] = exp(y[1]), in place, via the external function called with the pointer to `y[2]` in `rdi`.
+  opcodes::store_ymm_to_memory_by_rbx_offset(code, 0, 2);
+  opcodes::push_rdi(code);
+  opcodes::push_rdx(code);
+  opcodes::lea_rbx_offset_to_rdi(code, 2);
+  opcodes::vzeroupper(code);
+  opcodes::call_function_from_rdx_pointers_array_by_index(code, 0);
+  opcodes::pop_rdx(code);
+  opcodes::pop_rdi(code);
+
+  opcodes::pop_rbx(code);
+  opcodes::ret(code);
+
+  // Two parameters, four points, interleaved.
+  std::vector<double> x({1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0});
+  std::vector<double> y(3 * kX64NativeJITBatchSize);
+
+  void (*f[])(double*) = {[](double* p) {
+    for (size_t k = 0; k < kX64NativeJITBatchSize; ++k) {
+      p[k] = std::exp(p[k]);
+    }
+  }};
+
+  CallableVectorUInt8(code).batch(&x[0], &y[0], f);
+
+  for (size_t k = 0; k < kX64NativeJITBatchSize; ++k) {
+    double const x0 = x[k];
+    double const x1 = x[kX64NativeJITBatchSize + k];
+    double const y0 = std::sqrt((x0 + 0.5) * x1 - x0) / x1;
+    double const y1 = (y0 * x0 + y0) / y0;
+    EXPECT_EQ(y0, y[k]) << k;
+    EXPECT_EQ(y1, y[kX64NativeJITBatchSize + k]) << k;
+    EXPECT_EQ(std::exp(y1), y[2 * kX64NativeJITBatchSize + k]) << k;
+  }
+}
+
 #endif  // FNCAS_X64_NATIVE_JIT_ENABLED
 
 #endif  // X64_NATIVE_JIT_TEST_CC_INCLUDED
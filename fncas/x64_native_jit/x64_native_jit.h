@@ -62,8 +62,19 @@ namespace x64_native_jit {
 // * Uses the `double (*f[])(double): External functions (`sin`, `exp`, etc.) to be called, to avoid dealing with PLT.
 typedef double (*pf_t)(double const* x, double* o, double (*f[])(double));
 
+// The batch signature, for `kX64NativeJITBatchSize` points at once, with the `ymm` registers (AVX2):
+// * The `x` and `o` arrays are interleaved: `x[i * kX64NativeJITBatchSize + k]` is the `i`-th parameter of point `k`.
+// * The external functions work in place, on `kX64NativeJITBatchSize` consecutive doubles.
+// * The return value is unused, the result is in `o`.
+typedef void (*pf_batch_t)(double const* x, double* o, void (*f[])(double*));
+
+constexpr static size_t const kX64NativeJITBatchSize = 4;
+
 constexpr static size_t const kX64NativeJITExecutablePageSize = 4096;
 
+// The `xmm0` .. `xmm15` registers are all available, the ones from `xmm8` up need the REX prefix.
+constexpr static uint8_t const kX64NativeJITNumberOfXMMRegisters = 16;
+
 struct CallableVectorUInt8 final {
   size_t const allocated_size_;
   void* buffer_ = nullptr;
@@ -96,6 +107,11 @@ struct CallableVectorUInt8 final {
     return reinterpret_cast<pf_t>(buffer_)(x - 16, o - 16, f - 1);
   }
 
+  void batch(double const* x, double* o, void (*f[])(double*)) const {
+    // Same shifts as above, by 16 doubles and by one function.
+    reinterpret_cast<pf_batch_t>(buffer_)(x - 16, o - 16, f - 1);
+  }
+
   ~CallableVectorUInt8() {
     if (buffer_) {
       ::munmap(buffer_, allocated_size_);
@@ -103,6 +119,12 @@ struct CallableVectorUInt8 final {
   }
 };
 
+// Whether the batch code, which uses AVX2, can run on this CPU.
+inline bool X64NativeJITBatchSupported() {
+  static bool const supported = __builtin_cpu_supports("avx2");
+  return supported;
+}
+
 namespace opcodes {
 
 template <typename C>
@@ -157,6 +179,19 @@ void ret(C& c) {
   c.push_back(0xc3);
 }
 
+template <typename C, typename O>
+void internal_push_offset(C& c, O offset) {
+  auto o = static_cast<int64_t>(offset);
+  o += 16;  // HACK(dkorolev): Shift by 16 doubles to have the opcodes have the same length.
+  o *= 8;   // Double is eight bytes, signed multiplication by design.
+  X64_JIT_ASSERT(o >= 0x80);
+  X64_JIT_ASSERT(o <= 0x7fffffff);
+  for (size_t i = 0; i < 4; ++i) {
+    c.push_back(o & 0xff);
+    o >>= 8;
+  }
+}
+
 template <typename C, typename O>
 void internal_load_immediate_to_memory_by_someregister_offset(C& c, uint8_t reg, O offset, double v) {
   uint64_t x = *reinterpret_cast<uint64_t const*>(&v);
@@ -169,16 +204,7 @@ void internal_load_immediate_to_memory_by_someregister_offset(C& c, uint8_t reg,
   c.push_back(0x48);
   c.push_back(0x89);
   c.push_back(reg);
-
-  auto o = static_cast<int64_t>(offset);
-  o += 16;  // HACK(dkorolev): Shift by 16 doubles to have the opcodes have the same length.
-  o *= 8;   // Double is eight bytes, signed multiplication by design.
-  X64_JIT_ASSERT(o >= 0x80);
-  X64_JIT_ASSERT(o <= 0x7fffffff);
-  for (size_t i = 0; i < 4; ++i) {
-    c.push_back(o & 0xff);
-    o >>= 8;
-  }
+  internal_push_offset(c, offset);
 }
 
 // NOTE(dkorolev): The `unsafe` prefix is becase the usecase is unit test only; FnCAS should not overwrite that memory.
@@ -197,21 +223,37 @@ void load_immediate_to_memory_by_rbx_offset(C& c, O offset, double v) {
   internal_load_immediate_to_memory_by_someregister_offset(c, 0x83, offset, v);
 }
 
+// `{prefix} [REX] 0f {opcode} {modrm} {offset}`, where `reg` is the ModRM byte for `[base + disp32]`, sans `xmm`.
 template <typename C, typename O>
-void internal_load_from_memory_by_offset_to_xmm0(C& c, uint8_t reg, O offset) {
-  auto o = static_cast<int64_t>(offset);
-  o += 16;  // HACK(dkorolev): Shift by 16 doubles to have the opcodes have the same length.
-  o *= 8;   // Double is eight bytes, signed multiplication by design.
-  X64_JIT_ASSERT(o >= 0x80);
-  X64_JIT_ASSERT(o <= 0x7fffffff);
-  c.push_back(0xf2);
+void internal_xmm_and_memory_by_offset(C& c, uint8_t prefix, uint8_t opcode, uint8_t xmm, uint8_t reg, O offset) {
+  X64_JIT_ASSERT(xmm < kX64NativeJITNumberOfXMMRegisters);
+  c.push_back(prefix);
+  if (xmm >= 8) {
+    c.push_back(0x44);  // REX.R.
+  }
   c.push_back(0x0f);
-  c.push_back(0x10);
-  c.push_back(reg);
-  for (size_t i = 0; i < 4; ++i) {
-    c.push_back(o & 0xff);
-    o >>= 8;
+  c.push_back(opcode);
+  c.push_back(reg | ((xmm & 7) << 3));
+  internal_push_offset(c, offset);
+}
+
+// `{prefix} [REX] 0f {opcode} {modrm}`, with `dst` in the `reg` field and `src` in the `r/m` field of the ModRM.
+template <typename C>
+void internal_xmm_and_xmm(C& c, uint8_t prefix, uint8_t opcode, uint8_t dst, uint8_t src) {
+  X64_JIT_ASSERT(dst < kX64NativeJITNumberOfXMMRegisters);
+  X64_JIT_ASSERT(src < kX64NativeJITNumberOfXMMRegisters);
+  c.push_back(prefix);
+  if (dst >= 8 || src >= 8) {
+    c.push_back(0x40 | (dst >= 8 ? 0x04 : 0x00) | (src >= 8 ? 0x01 : 0x00));  // REX.R and REX.B.
   }
+  c.push_back(0x0f);
+  c.push_back(opcode);
+  c.push_back(0xc0 | ((dst & 7) << 3) | (src & 7));
+}
+
+template <typename C, typename O>
+void internal_load_from_memory_by_offset_to_xmm0(C& c, uint8_t reg, O offset) {
+  internal_xmm_and_memory_by_offset(c, 0xf2, 0x10, 0, reg, offset);
 }
 
 template <typename C, typename O>
@@ -231,19 +273,7 @@ void load_from_memory_by_rbx_offset_to_xmm0(C& c, O offset) {
 
 template <typename C, typename O>
 void internal_op_from_memory_by_offset_to_xmm0(uint8_t add_sub_mul_div_code, C& c, uint8_t reg, O offset) {
-  auto o = static_cast<int64_t>(offset);
-  o += 16;  // HACK(dkorolev): Shift by 16 doubles to have the opcodes have the same length.
-  o *= 8;   // Double is eight bytes, signed multiplication by design.
-  X64_JIT_ASSERT(o >= 0x80);
-  X64_JIT_ASSERT(o <= 0x7fffffff);
-  c.push_back(0xf2);
-  c.push_back(0x0f);
-  c.push_back(add_sub_mul_div_code);
-  c.push_back(reg);
-  for (size_t i = 0; i < 4; ++i) {
-    c.push_back(o & 0xff);
-    o >>= 8;
-  }
+  internal_xmm_and_memory_by_offset(c, 0xf2, add_sub_mul_div_code, 0, reg, offset);
 }
 
 template <typename C, typename O>
@@ -308,19 +338,7 @@ void div_from_memory_by_rbx_offset_to_xmm0(C& c, O offset) {
 
 template <typename C, typename O>
 void internal_store_xmm0_to_memory_by_reg_offset(C& c, uint8_t reg, O offset) {
-  auto o = static_cast<int64_t>(offset);
-  o += 16;  // HACK(dkorolev): Shift by 16 doubles to have the opcodes have the same length.
-  o *= 8;   // Double is eight bytes, signed multiplication by design.
-  X64_JIT_ASSERT(o >= 0x80);
-  X64_JIT_ASSERT(o <= 0x7fffffff);
-  c.push_back(0xf2);
-  c.push_back(0x0f);
-  c.push_back(0x11);
-  c.push_back(reg);
-  for (size_t i = 0; i < 4; ++i) {
-    c.push_back(o & 0xff);
-    o >>= 8;
-  }
+  internal_xmm_and_memory_by_offset(c, 0xf2, 0x11, 0, reg, offset);
 }
 
 template <typename C, typename O>
@@ -333,6 +351,256 @@ void store_xmm0_to_memory_by_rbx_offset(C& c, O offset) {
   internal_store_xmm0_to_memory_by_reg_offset(c, 0x83, offset);
 }
 
+// The `xmm`-parameterized versions of the above, used by the register allocator in `fncas/jit.h`.
+template <typename C, typename O>
+void load_from_memory_by_rdi_offset_to_xmm(C& c, uint8_t xmm, O offset) {
+  internal_xmm_and_memory_by_offset(c, 0xf2, 0x10, xmm, 0x87, offset);
+}
+
+template <typename C, typename O>
+void load_from_memory_by_rbx_offset_to_xmm(C& c, uint8_t xmm, O offset) {
+  internal_xmm_and_memory_by_offset(c, 0xf2, 0x10, xmm, 0x83, offset);
+}
+
+template <typename C, typename O>
+void store_xmm_to_memory_by_rbx_offset(C& c, uint8_t xmm, O offset) {
+  internal_xmm_and_memory_by_offset(c, 0xf2, 0x11, xmm, 0x83, offset);
+}
+
+template <typename C, typename O>
+void add_from_memory_by_rdi_offset_to_xmm(C& c, uint8_t xmm, O offset) {
+  internal_xmm_and_memory_by_offset(c, 0xf2, 0x58, xmm, 0x87, offset);
+}
+
+template <typename C, typename O>
+void sub_from_memory_by_rdi_offset_to_xmm(C& c, uint8_t xmm, O offset) {
+  internal_xmm_and_memory_by_offset(c, 0xf2, 0x5c, xmm, 0x87, offset);
+}
+
+template <typename C, typename O>
+void mul_from_memory_by_rdi_offset_to_xmm(C& c, uint8_t xmm, O offset) {
+  internal_xmm_and_memory_by_offset(c, 0xf2, 0x59, xmm, 0x87, offset);
+}
+
+template <typename C, typename O>
+void div_from_memory_by_rdi_offset_to_xmm(C& c, uint8_t xmm, O offset) {
+  internal_xmm_and_memory_by_offset(c, 0xf2, 0x5e, xmm, 0x87, offset);
+}
+
+template <typename C, typename O>
+void add_from_memory_by_rbx_offset_to_xmm(C& c, uint8_t xmm, O offset) {
+  internal_xmm_and_memory_by_offset(c, 0xf2, 0x58, xmm, 0x83, offset);
+}
+
+template <typename C, typename O>
+void sub_from_memory_by_rbx_offset_to_xmm(C& c, uint8_t xmm, O offset) {
+  internal_xmm_and_memory_by_offset(c, 0xf2, 0x5c, xmm, 0x83, offset);
+}
+
+template <typename C, typename O>
+void mul_from_memory_by_rbx_offset_to_xmm(C& c, uint8_t xmm, O offset) {
+  internal_xmm_and_memory_by_offset(c, 0xf2, 0x59, xmm, 0x83, offset);
+}
+
+template <typename C, typename O>
+void div_from_memory_by_rbx_offset_to_xmm(C& c, uint8_t xmm, O offset) {
+  internal_xmm_and_memory_by_offset(c, 0xf2, 0x5e, xmm, 0x83, offset);
+}
+
+// `dst = dst {op} src`, the `sd` (scalar double) flavors.
+template <typename C>
+void add_xmm_to_xmm(C& c, uint8_t dst, uint8_t src) {
+  internal_xmm_and_xmm(c, 0xf2, 0x58, dst, src);
+}
+
+template <typename C>
+void sub_xmm_from_xmm(C& c, uint8_t dst, uint8_t src) {
+  internal_xmm_and_xmm(c, 0xf2, 0x5c, dst, src);
+}
+
+template <typename C>
+void mul_xmm_by_xmm(C& c, uint8_t dst, uint8_t src) {
+  internal_xmm_and_xmm(c, 0xf2, 0x59, dst, src);
+}
+
+template <typename C>
+void div_xmm_by_xmm(C& c, uint8_t dst, uint8_t src) {
+  internal_xmm_and_xmm(c, 0xf2, 0x5e, dst, src);
+}
+
+// `movapd`, not `movsd`, to copy the whole register and not depend on the upper half of `dst`.
+template <typename C>
+void mov_xmm_to_xmm(C& c, uint8_t dst, uint8_t src) {
+  internal_xmm_and_xmm(c, 0x66, 0x28, dst, src);
+}
+
+// Via `rax`: `mov rax, imm64`, then `movq xmm, rax`.
+template <typename C>
+void load_immediate_to_xmm(C& c, uint8_t xmm, double v) {
+  X64_JIT_ASSERT(xmm < kX64NativeJITNumberOfXMMRegisters);
+  uint64_t x = *reinterpret_cast<uint64_t const*>(&v);
+  c.push_back(0x48);
+  c.push_back(0xb8);
+  for (size_t i = 0; i < 8; ++i) {
+    c.push_back(x & 0xff);
+    x >>= 8;
+  }
+  c.push_back(0x66);
+  c.push_back(xmm >= 8 ? 0x4c : 0x48);  // REX.W, and REX.R for `xmm8` and above.
+  c.push_back(0x0f);
+  c.push_back(0x6e);
+  c.push_back(0xc0 | ((xmm & 7) << 3));
+}
+
+// `c4 {RXB.mmmmm} {W.vvvv.L.pp} {opcode}`, the three-byte VEX prefix and the opcode, with the `66` implied prefix.
+// The `reg` goes to ModRM.reg, the `rm` register, if any, to ModRM.r/m, and `vvvv` is the extra source register.
+template <typename C>
+void internal_vex_66(C& c, uint8_t map, bool w, bool l, uint8_t reg, uint8_t vvvv, uint8_t rm, uint8_t opcode) {
+  X64_JIT_ASSERT(reg < kX64NativeJITNumberOfXMMRegisters);
+  X64_JIT_ASSERT(vvvv < kX64NativeJITNumberOfXMMRegisters);
+  X64_JIT_ASSERT(rm < kX64NativeJITNumberOfXMMRegisters);
+  c.push_back(0xc4);
+  c.push_back((reg < 8 ? 0x80 : 0x00) | 0x40 | (rm < 8 ? 0x20 : 0x00) | map);  // The R, X, B bits are inverted.
+  c.push_back((w ? 0x80 : 0x00) | ((~vvvv & 0x0f) << 3) | (l ? 0x04 : 0x00) | 0x01);
+  c.push_back(opcode);
+}
+
+// `{vex} {modrm} {offset}`, the 256-bit `ymm` and memory ops, where `reg` is the ModRM byte for `[base + disp32]`.
+// NOTE(dkorolev): The offsets of the `ymm` ops are in packs of `kX64NativeJITBatchSize` doubles, not in doubles.
+template <typename C, typename O>
+void internal_ymm_and_memory_by_offset(C& c, uint8_t opcode, uint8_t ymm, uint8_t vvvv, uint8_t reg, O offset) {
+  internal_vex_66(c, 0x01, false, true, ymm, vvvv, 0, opcode);
+  c.push_back(reg | ((ymm & 7) << 3));
+  internal_push_offset(c, static_cast<int64_t>(offset) * static_cast<int64_t>(kX64NativeJITBatchSize));
+}
+
+// `{vex} {modrm}`, the 256-bit `dst = vvvv {op} src` ops on the `ymm` registers.
+template <typename C>
+void internal_ymm_and_ymm(C& c, uint8_t opcode, uint8_t dst, uint8_t vvvv, uint8_t src) {
+  internal_vex_66(c, 0x01, false, true, dst, vvvv, src, opcode);
+  c.push_back(0xc0 | ((dst & 7) << 3) | (src & 7));
+}
+
+// `vmovupd`, so that the interleaved arrays do not have to be 32-byte aligned.
+template <typename C, typename O>
+void load_from_memory_by_rdi_offset_to_ymm(C& c, uint8_t ymm, O offset) {
+  internal_ymm_and_memory_by_offset(c, 0x10, ymm, 0, 0x87, offset);
+}
+
+template <typename C, typename O>
+void load_from_memory_by_rbx_offset_to_ymm(C& c, uint8_t ymm, O offset) {
+  internal_ymm_and_memory_by_offset(c, 0x10, ymm, 0, 0x83, offset);
+}
+
+template <typename C, typename O>
+void store_ymm_to_memory_by_rbx_offset(C& c, uint8_t ymm, O offset) {
+  internal_ymm_and_memory_by_offset(c, 0x11, ymm, 0, 0x83, offset);
+}
+
+template <typename C, typename O>
+void add_from_memory_by_rdi_offset_to_ymm(C& c, uint8_t ymm, O offset) {
+  internal_ymm_and_memory_by_offset(c, 0x58, ymm, ymm, 0x87, offset);
+}
+
+template <typename C, typename O>
+void sub_from_memory_by_rdi_offset_to_ymm(C& c, uint8_t ymm, O offset) {
+  internal_ymm_and_memory_by_offset(c, 0x5c, ymm, ymm, 0x87, offset);
+}
+
+template <typename C, typename O>
+void mul_from_memory_by_rdi_offset_to_ymm(C& c, uint8_t ymm, O offset) {
+  internal_ymm_and_memory_by_offset(c, 0x59, ymm, ymm, 0x87, offset);
+}
+
+template <typename C, typename O>
+void div_from_memory_by_rdi_offset_to_ymm(C& c, uint8_t ymm, O offset) {
+  internal_ymm_and_memory_by_offset(c, 0x5e, ymm, ymm, 0x87, offset);
+}
+
+template <typename C, typename O>
+void add_from_memory_by_rbx_offset_to_ymm(C& c, uint8_t ymm, O offset) {
+  internal_ymm_and_memory_by_offset(c, 0x58, ymm, ymm, 0x83, offset);
+}
+
+template <typename C, typename O>
+void sub_from_memory_by_rbx_offset_to_ymm(C& c, uint8_t ymm, O offset) {
+  internal_ymm_and_memory_by_offset(c, 0x5c, ymm, ymm, 0x83, offset);
+}
+
+template <typename C, typename O>
+void mul_from_memory_by_rbx_offset_to_ymm(C& c, uint8_t ymm, O offset) {
+  internal_ymm_and_memory_by_offset(c, 0x59, ymm, ymm, 0x83, offset);
+}
+
+template <typename C, typename O>
+void div_from_memory_by_rbx_offset_to_ymm(C& c, uint8_t ymm, O offset) {
+  internal_ymm_and_memory_by_offset(c, 0x5e, ymm, ymm, 0x83, offset);
+}
+
+// `dst = dst {op} src`, the `pd` (packed double) flavors, to mirror the `xmm` ones above.
+template <typename C>
+void add_ymm_to_ymm(C& c, uint8_t dst, uint8_t src) {
+  internal_ymm_and_ymm(c, 0x58, dst, dst, src);
+}
+
+template <typename C>
+void sub_ymm_from_ymm(C& c, uint8_t dst, uint8_t src) {
+  internal_ymm_and_ymm(c, 0x5c, dst, dst, src);
+}
+
+template <typename C>
+void mul_ymm_by_ymm(C& c, uint8_t dst, uint8_t src) {
+  internal_ymm_and_ymm(c, 0x59, dst, dst, src);
+}
+
+template <typename C>
+void div_ymm_by_ymm(C& c, uint8_t dst, uint8_t src) {
+  internal_ymm_and_ymm(c, 0x5e, dst, dst, src);
+}
+
+template <typename C>
+void sqrt_ymm_to_ymm(C& c, uint8_t dst, uint8_t src) {
+  internal_ymm_and_ymm(c, 0x51, dst, 0, src);
+}
+
+template <typename C>
+void mov_ymm_to_ymm(C& c, uint8_t dst, uint8_t src) {
+  internal_ymm_and_ymm(c, 0x28, dst, 0, src);
+}
+
+// Via `rax` and `xmm`: `mov rax, imm64`, `vmovq xmm, rax`, then `vbroadcastsd ymm, xmm` into all the doubles.
+template <typename C>
+void load_immediate_to_ymm(C& c, uint8_t ymm, double v) {
+  uint64_t x = *reinterpret_cast<uint64_t const*>(&v);
+  c.push_back(0x48);
+  c.push_back(0xb8);
+  for (size_t i = 0; i < 8; ++i) {
+    c.push_back(x & 0xff);
+    x >>= 8;
+  }
+  internal_vex_66(c, 0x01, true, false, ymm, 0, 0, 0x6e);
+  c.push_back(0xc0 | ((ymm & 7) << 3));
+  internal_vex_66(c, 0x02, false, true, ymm, 0, ymm, 0x19);
+  c.push_back(0xc0 | ((ymm & 7) << 3) | (ymm & 7));
+}
+
+// `lea rdi, [rbx + disp32]`, to pass a pointer into the output array to an external batch function.
+template <typename C, typename O>
+void lea_rbx_offset_to_rdi(C& c, O offset) {
+  c.push_back(0x48);
+  c.push_back(0x8d);
+  c.push_back(0xbb);
+  internal_push_offset(c, static_cast<int64_t>(offset) * static_cast<int64_t>(kX64NativeJITBatchSize));
+}
+
+// Before calling external functions, which may use the legacy SSE encoding, to avoid the AVX/SSE transition penalty.
+template <typename C>
+void vzeroupper(C& c) {
+  c.push_back(0xc5);
+  c.push_back(0xf8);
+  c.push_back(0x77);
+}
+
 template <typename C>
 void call_function_from_rdx_pointers_array_by_index(C& c, uint8_t index) {
   X64_JIT_ASSERT(index < 31);  // Should fit one byte after adding one and multiplying by 8. -- D.K.
@@ -27,6 +27,8 @@ SOFTWARE.
 
 #include "exceptions.h"
 
+#include "../delivery.h"
+
 #include "../../blocks/http/api.h"
 
 #include "../../typesystem/struct.h"
@@ -45,6 +47,7 @@ CURRENT_STRUCT(AdWordsConversionTrackingParams) {
 };
 
 constexpr static int16_t kDefaultAdWordsIntegrationPort = 24002;
+constexpr static const char* kAdWordsDeliveryDestination = "adwords";
 
 class AdWordsMobileConversionEventsSender final {
  public:
@@ -109,6 +112,30 @@ server {
 #endif  // CURRENT_CI
   }
 
+  // Same as the above, without waiting for the response: the event is sent, and retried if need be, by `engine`,
+  // which then calls `on_done`, if set, with whether the event has been delivered.
+  void SendConversionEvent(IntegrationDeliveryEngine& engine,
+                           const std::string& rdid,
+                           IntegrationDeliveryEngine::on_done_t on_done = nullptr) const {
+#ifdef CURRENT_CI
+    static_cast<void>(engine);
+    static_cast<void>(rdid);
+    if (on_done) {
+      on_done(true);
+    }
+#else
+    engine.Deliver(kAdWordsDeliveryDestination,
+                   GET(get_url_ + rdid),
+                   std::move(on_done),
+                   [](const current::http::HTTPResponseWithBuffer& response) {
+                     const DeliveryOutcome outcome = DefaultDeliveryOutcome(response);
+                     return (outcome == DeliveryOutcome::Delivered && response.code != HTTPResponseCode.OK)
+                                ? DeliveryOutcome::Rejected
+                                : outcome;
+                   });
+#endif  // CURRENT_CI
+  }
+
  private:
   const std::string get_url_;
 };
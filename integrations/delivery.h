@@ -0,0 +1,505 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2016 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// `IntegrationDeliveryEngine` delivers the events to third-party APIs in the background, instead of making
+// the caller wait for each round trip, as `HTTP(POST(...))` does. The requests are sent via `HTTPAsyncClient`,
+// at most `max_in_flight` at a time per destination, and retried with exponential backoff on network errors,
+// on "429 Too Many Requests", and on "5xx" responses. Enable `HTTPClientConnections()` to reuse the connections.
+//
+//   current::integrations::IntegrationDeliveryEngine engine;
+//   engine.Deliver("adwords", GET(url), [](bool delivered) { ... });
+//
+// The outcomes are counted in the `integration_deliveries_total` metric, labeled by the destination and the outcome,
+// along with `integration_delivery_attempts_total` and `integration_delivery_latency_ms`; `Status()` has the queues.
+// For the APIs that accept many events at once, `IntegrationDeliveryBatcher` groups the events into requests.
+
+#ifndef INTEGRATIONS_DELIVERY_H
+#define INTEGRATIONS_DELIVERY_H
+
+#include "../port.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../blocks/http/api.h"
+#include "../blocks/http/async_client.h"
+#include "../blocks/metrics/metrics.h"
+
+#include "../typesystem/struct.h"
+
+namespace current {
+namespace integrations {
+
+enum class DeliveryOutcome : int { Delivered = 0, Retry = 1, Rejected = 2 };
+
+// What the response means for the delivery, unless the destination says otherwise.
+inline DeliveryOutcome DefaultDeliveryOutcome(const current::http::HTTPResponseWithBuffer& response) {
+  const int code = static_cast<int>(response.code);
+  if (code >= 200 && code < 300) {
+    return DeliveryOutcome::Delivered;
+  } else if (code == 429 || code >= 500) {
+    return DeliveryOutcome::Retry;
+  } else {
+    return DeliveryOutcome::Rejected;
+  }
+}
+
+struct DeliveryPolicy {
+  size_t max_in_flight = 8u;
+  size_t max_attempts = 5u;
+  std::chrono::milliseconds initial_backoff = std::chrono::milliseconds(100);
+  std::chrono::milliseconds max_backoff = std::chrono::seconds(30);
+
+  // The requests being sent to the destination at once, including the ones waiting to be retried.
+  DeliveryPolicy& SetMaxInFlight(size_t value) {
+    max_in_flight = std::max(value, static_cast<size_t>(1u));
+    return *this;
+  }
+  // Including the first one.
+  DeliveryPolicy& SetMaxAttempts(size_t value) {
+    max_attempts = std::max(value, static_cast<size_t>(1u));
+    return *this;
+  }
+  // The delay before the first retry, doubled for each next one, up to `max_backoff`.
+  DeliveryPolicy& SetBackoff(std::chrono::milliseconds initial, std::chrono::milliseconds max) {
+    initial_backoff = initial;
+    max_backoff = max;
+    return *this;
+  }
+};
+
+CURRENT_STRUCT(IntegrationDestinationStatus) {
+  CURRENT_FIELD(destination, std::string);
+  CURRENT_FIELD(queued, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(queued, "The events waiting for the in-flight requests to the destination to complete.");
+  CURRENT_FIELD(in_flight, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(in_flight, "The requests sent or waiting to be retried.");
+};
+
+CURRENT_STRUCT(IntegrationDeliveryStatus) {
+  CURRENT_FIELD(destinations, std::vector<IntegrationDestinationStatus>);
+};
+
+class IntegrationDeliveryEngine final {
+ public:
+  using on_done_t = std::function<void(bool delivered)>;
+  using classify_t = std::function<DeliveryOutcome(const current::http::HTTPResponseWithBuffer&)>;
+
+  explicit IntegrationDeliveryEngine(DeliveryPolicy default_policy = DeliveryPolicy(), size_t client_threads = 2u)
+      : default_policy_(default_policy),
+        client_(std::make_unique<current::http::HTTPAsyncClient>(client_threads)),
+        timer_thread_(&IntegrationDeliveryEngine::TimerThread, this) {}
+
+  // The events not yet delivered are reported as not delivered.
+  ~IntegrationDeliveryEngine() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      terminating_ = true;
+    }
+    condition_variable_.notify_all();
+    timer_thread_.join();
+    // Fails the requests in flight, which are then not retried.
+    std::unique_ptr<current::http::HTTPAsyncClient> client;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      client = std::move(client_);
+    }
+    client = nullptr;
+    std::vector<std::shared_ptr<Delivery>> undelivered;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto& task : timer_) {
+        if (task.second.delivery) {
+          undelivered.push_back(std::move(task.second.delivery));
+        }
+      }
+      for (auto& destination : destinations_) {
+        for (auto& delivery : destination.second.queue) {
+          undelivered.push_back(std::move(delivery));
+        }
+      }
+    }
+    for (const auto& delivery : undelivered) {
+      Done(*delivery, false);
+    }
+  }
+
+  // Applies to the events delivered to `destination` from now on.
+  void SetPolicy(const std::string& destination, DeliveryPolicy policy) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    DestinationLocked(destination).policy = policy;
+  }
+
+  // Sends `request`, such as `GET(url)` or `POST(url, body)`, to `destination`, which names the API for the policy
+  // and the metrics. `on_done`, if set, is called on one of the threads of the engine once the request has been
+  // delivered, or rejected, or has run out of attempts.
+  template <typename REQUEST>
+  void Deliver(const std::string& destination,
+               REQUEST request,
+               on_done_t on_done = nullptr,
+               classify_t classify = DefaultDeliveryOutcome) {
+    auto delivery = std::make_shared<Delivery>();
+    delivery->destination = destination;
+    delivery->send = [request = std::move(request)](current::http::HTTPAsyncClient& client,
+                                                    current::http::HTTPAsyncClient::on_response_t on_response,
+                                                    current::http::HTTPAsyncClient::on_error_t on_error) {
+      client.Send(request, std::move(on_response), std::move(on_error));
+    };
+    delivery->classify = std::move(classify);
+    delivery->on_done = std::move(on_done);
+    delivery->enqueued = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<Delivery>> to_send;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!terminating_) {
+        Destination& d = DestinationLocked(destination);
+        delivery->metrics = &d.metrics;
+        d.queue.push_back(delivery);
+        ++pending_;
+        PumpLocked(d, to_send);
+      }
+    }
+    if (!delivery->metrics) {
+      // Not accepted, as the engine is being destructed.
+      Done(*delivery, false);
+      return;
+    }
+    for (auto& d : to_send) {
+      Send(std::move(d));
+    }
+  }
+
+  // Calls `f` on the thread of the engine at `at`, or soon after. For the batchers, to flush on time.
+  void Schedule(std::chrono::steady_clock::time_point at, std::function<void()> f) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      timer_.emplace(at, Task{nullptr, std::move(f)});
+    }
+    condition_variable_.notify_all();
+  }
+
+  // Blocks until all the events passed to `Deliver()` so far are done with.
+  void WaitUntilIdle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_condition_variable_.wait(lock, [this]() { return !pending_; });
+  }
+
+  IntegrationDeliveryStatus Status() const {
+    IntegrationDeliveryStatus status;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& destination : destinations_) {
+      status.destinations.emplace_back();
+      IntegrationDestinationStatus& s = status.destinations.back();
+      s.destination = destination.first;
+      s.queued = destination.second.queue.size();
+      s.in_flight = destination.second.in_flight;
+    }
+    return status;
+  }
+
+ private:
+  IntegrationDeliveryEngine(const IntegrationDeliveryEngine&) = delete;
+  IntegrationDeliveryEngine& operator=(const IntegrationDeliveryEngine&) = delete;
+
+  struct DestinationMetrics final {
+    current::metrics::Counter& attempts;
+    current::metrics::Counter& delivered;
+    current::metrics::Counter& rejected;
+    current::metrics::Counter& failed;
+    current::metrics::Histogram& latency_ms;
+
+    explicit DestinationMetrics(const std::string& destination)
+        : attempts(current::metrics::ProcessMetrics().GetCounter(
+              "integration_delivery_attempts_total",
+              {{"destination", destination}},
+              "The requests sent to the third-party API, including the retries.")),
+          delivered(Outcome(destination, "delivered")),
+          rejected(Outcome(destination, "rejected")),
+          failed(Outcome(destination, "failed")),
+          latency_ms(current::metrics::ProcessMetrics().GetHistogram(
+              "integration_delivery_latency_ms",
+              {{"destination", destination}},
+              "From the event passed to the engine to it being done with, in milliseconds.")) {}
+
+    static current::metrics::Counter& Outcome(const std::string& destination, const std::string& outcome) {
+      return current::metrics::ProcessMetrics().GetCounter(
+          "integration_deliveries_total",
+          {{"destination", destination}, {"outcome", outcome}},
+          "The events done with: delivered, rejected by the API, or failed after all the attempts.");
+    }
+  };
+
+  struct Delivery final {
+    std::string destination;
+    std::function<void(current::http::HTTPAsyncClient&,
+                       current::http::HTTPAsyncClient::on_response_t,
+                       current::http::HTTPAsyncClient::on_error_t)>
+        send;
+    classify_t classify;
+    on_done_t on_done;
+    DestinationMetrics* metrics = nullptr;
+    size_t attempts = 0u;
+    std::chrono::steady_clock::time_point enqueued;
+  };
+
+  struct Destination final {
+    DeliveryPolicy policy;
+    DestinationMetrics metrics;
+    std::deque<std::shared_ptr<Delivery>> queue;
+    size_t in_flight = 0u;
+    Destination(DeliveryPolicy policy, const std::string& name) : policy(policy), metrics(name) {}
+  };
+
+  // Either a delivery to retry, or a function to call.
+  struct Task final {
+    std::shared_ptr<Delivery> delivery;
+    std::function<void()> f;
+  };
+
+  Destination& DestinationLocked(const std::string& destination) {
+    auto it = destinations_.find(destination);
+    if (it == destinations_.end()) {
+      it = destinations_.emplace(std::piecewise_construct,
+                                 std::forward_as_tuple(destination),
+                                 std::forward_as_tuple(default_policy_, destination))
+               .first;
+    }
+    return it->second;
+  }
+
+  // Takes the queued deliveries the destination has the room in flight for.
+  static void PumpLocked(Destination& d, std::vector<std::shared_ptr<Delivery>>& to_send) {
+    while (!d.queue.empty() && d.in_flight < d.policy.max_in_flight) {
+      ++d.in_flight;
+      to_send.push_back(std::move(d.queue.front()));
+      d.queue.pop_front();
+    }
+  }
+
+  void Send(std::shared_ptr<Delivery> delivery) {
+    ++delivery->attempts;
+    delivery->metrics->attempts.Increment();
+    Delivery& d = *delivery;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!client_) {
+      lock.unlock();
+      Finish(std::move(delivery), false);
+      return;
+    }
+    current::http::HTTPAsyncClient& client = *client_;
+    lock.unlock();
+    d.send(
+        client,
+        [this, delivery](current::http::HTTPResponseWithBuffer&& response) {
+          OnAttempt(delivery, delivery->classify(response));
+        },
+        [this, delivery](std::exception_ptr) { OnAttempt(delivery, DeliveryOutcome::Retry); });
+  }
+
+  void OnAttempt(std::shared_ptr<Delivery> delivery, DeliveryOutcome outcome) {
+    if (outcome == DeliveryOutcome::Retry) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      const DeliveryPolicy& policy = DestinationLocked(delivery->destination).policy;
+      if (!terminating_ && delivery->attempts < policy.max_attempts) {
+        std::chrono::milliseconds backoff = policy.initial_backoff;
+        for (size_t i = 1u; i < delivery->attempts && backoff < policy.max_backoff; ++i) {
+          backoff *= 2;
+        }
+        timer_.emplace(std::chrono::steady_clock::now() + std::min(backoff, policy.max_backoff),
+                       Task{std::move(delivery), nullptr});
+        lock.unlock();
+        condition_variable_.notify_all();
+        return;
+      }
+    }
+    Finish(std::move(delivery), outcome == DeliveryOutcome::Delivered, outcome == DeliveryOutcome::Rejected);
+  }
+
+  // Frees the slot of the delivery, and sends the next queued one in its place.
+  void Finish(std::shared_ptr<Delivery> delivery, bool delivered, bool rejected = false) {
+    std::vector<std::shared_ptr<Delivery>> to_send;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      Destination& d = DestinationLocked(delivery->destination);
+      --d.in_flight;
+      if (!terminating_) {
+        PumpLocked(d, to_send);
+      }
+    }
+    (delivered ? delivery->metrics->delivered : rejected ? delivery->metrics->rejected : delivery->metrics->failed)
+        .Increment();
+    Done(*delivery, delivered);
+    for (auto& d : to_send) {
+      Send(std::move(d));
+    }
+  }
+
+  void Done(Delivery& delivery, bool delivered) {
+    if (delivery.metrics) {
+      delivery.metrics->latency_ms.Record(static_cast<double>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - delivery.enqueued)
+              .count()));
+    }
+    if (delivery.on_done) {
+      delivery.on_done(delivered);
+    }
+    if (delivery.metrics) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!--pending_) {
+        idle_condition_variable_.notify_all();
+      }
+    }
+  }
+
+  void TimerThread() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!terminating_) {
+      if (timer_.empty()) {
+        condition_variable_.wait(lock);
+      } else if (timer_.begin()->first > std::chrono::steady_clock::now()) {
+        condition_variable_.wait_until(lock, timer_.begin()->first);
+      } else {
+        Task task = std::move(timer_.begin()->second);
+        timer_.erase(timer_.begin());
+        lock.unlock();
+        if (task.delivery) {
+          Send(std::move(task.delivery));
+        } else {
+          task.f();
+        }
+        lock.lock();
+      }
+    }
+  }
+
+  const DeliveryPolicy default_policy_;
+  mutable std::mutex mutex_;
+  std::condition_variable condition_variable_;
+  std::condition_variable idle_condition_variable_;
+  bool terminating_ = false;
+  size_t pending_ = 0u;
+  std::map<std::string, Destination> destinations_;
+  std::multimap<std::chrono::steady_clock::time_point, Task> timer_;
+  std::unique_ptr<current::http::HTTPAsyncClient> client_;
+  std::thread timer_thread_;
+};
+
+// Groups the events for the APIs that accept many of them in one request: `send` is called with up to
+// `max_batch_size` events at a time, once there are this many, or `max_delay` after the first of them was added,
+// and is to pass the request it makes of them to `IntegrationDeliveryEngine::Deliver()`.
+template <typename ITEM>
+class IntegrationDeliveryBatcher final {
+ public:
+  using send_t = std::function<void(std::vector<ITEM>&&)>;
+
+  IntegrationDeliveryBatcher(IntegrationDeliveryEngine& engine,
+                             size_t max_batch_size,
+                             std::chrono::milliseconds max_delay,
+                             send_t send)
+      : engine_(engine), state_(std::make_shared<State>(std::max(max_batch_size, static_cast<size_t>(1u)), send)),
+        max_delay_(max_delay) {}
+
+  // The events added so far are sent right away.
+  ~IntegrationDeliveryBatcher() { state_->Flush(); }
+
+  void Add(ITEM item) {
+    std::vector<ITEM> batch;
+    uint64_t generation_to_flush = 0u;
+    {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      state_->items.push_back(std::move(item));
+      if (state_->items.size() >= state_->max_batch_size) {
+        batch = state_->TakeLocked();
+      } else if (state_->items.size() == 1u) {
+        generation_to_flush = ++state_->generation;
+      }
+    }
+    if (!batch.empty()) {
+      state_->send(std::move(batch));
+    } else if (generation_to_flush) {
+      std::weak_ptr<State> weak_state = state_;
+      engine_.Schedule(std::chrono::steady_clock::now() + max_delay_, [weak_state, generation_to_flush]() {
+        const std::shared_ptr<State> state = weak_state.lock();
+        if (state) {
+          state->Flush(generation_to_flush);
+        }
+      });
+    }
+  }
+
+  // Sends the events added so far.
+  void Flush() { state_->Flush(); }
+
+ private:
+  struct State final {
+    const size_t max_batch_size;
+    const send_t send;
+    std::mutex mutex;
+    std::vector<ITEM> items;
+    // Incremented as each batch is begun and taken, for the timer of an earlier batch to not flush a later one.
+    uint64_t generation = 0u;
+
+    State(size_t max_batch_size, send_t send) : max_batch_size(max_batch_size), send(std::move(send)) {}
+
+    std::vector<ITEM> TakeLocked() {
+      ++generation;
+      std::vector<ITEM> batch;
+      batch.swap(items);
+      return batch;
+    }
+
+    // Sends the events added so far, or, if `only_generation` is set, only if they are still that batch.
+    void Flush(uint64_t only_generation = 0u) {
+      std::vector<ITEM> batch;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (only_generation && only_generation != generation) {
+          return;
+        }
+        batch = TakeLocked();
+      }
+      if (!batch.empty()) {
+        send(std::move(batch));
+      }
+    }
+  };
+
+  IntegrationDeliveryEngine& engine_;
+  const std::shared_ptr<State> state_;
+  const std::chrono::milliseconds max_delay_;
+};
+
+}  // namespace integrations
+}  // namespace current
+
+#endif  // INTEGRATIONS_DELIVERY_H
@@ -3,11 +3,13 @@
 #include "javascript_any.hpp"
 #include "javascript_async.hpp"
 #include "javascript_async_eventloop.hpp"
+#include "javascript_buffer.hpp"
 #include "javascript_cpp2js.hpp"
 #include "javascript_env.hpp"
 #include "javascript_function.hpp"
 #include "javascript_function_cont.hpp"
 #include "javascript_js2cpp.hpp"
+#include "javascript_lazy_object.hpp"
 #include "javascript_object.hpp"
 #include "javascript_promise.hpp"
 
@@ -21,6 +23,10 @@ using impl::Undefined;
 using impl::JSAny;
 using impl::JSObject;
 
+using impl::JSBuffer;
+using impl::JSBufferView;
+using impl::JSLazyObject;
+
 using impl::JSFunction;
 using impl::JSFunctionReturning;
 
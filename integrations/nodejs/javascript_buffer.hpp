@@ -0,0 +1,85 @@
+#pragma once
+
+#include "javascript_cpp2js.hpp"
+#include "javascript_env.hpp"
+#include "javascript_js2cpp.hpp"
+
+namespace current {
+namespace javascript {
+namespace impl {
+
+// NOTE(dkorolev): `JSBuffer` hands C++-owned bytes over to JavaScript with no copying, as the backing store of
+// an external `ArrayBuffer`, which JavaScript sees as a `Uint8Array`. This is the way to pass the serialized JSON
+// or binary payloads, i.e. `return JSBuffer(JSON(object));`, for JavaScript to decode them, or to just pass them on.
+//
+// The bytes are shared, so the same `JSBuffer` can be passed to JavaScript any number of times, still with no copying.
+// They are freed once both the C++ copies of the `JSBuffer` and the `ArrayBuffer`-s over it are gone. JavaScript
+// should treat these bytes as read-only, as they may well be shared with other `ArrayBuffer`-s and with C++.
+class JSBuffer final {
+ private:
+  std::shared_ptr<const std::string> data_;
+
+ public:
+  explicit JSBuffer(std::string data) : data_(std::make_shared<const std::string>(std::move(data))) {}
+  explicit JSBuffer(std::shared_ptr<const std::string> data) : data_(std::move(data)) {}
+
+  const std::string& Data() const { return *data_; }
+  const std::shared_ptr<const std::string>& SharedData() const { return data_; }
+};
+
+template <>
+struct CPP2JSImpl<false, JSBuffer> {
+  using type = Napi::Uint8Array;
+  static type DoIt(const JSBuffer& b) {
+    if (b.Data().empty()) {
+      return type::New(JSEnv(), 0u);
+    }
+    std::shared_ptr<const std::string>* owner = new std::shared_ptr<const std::string>(b.SharedData());
+    Napi::ArrayBuffer buffer =
+        Napi::ArrayBuffer::New(JSEnv(), const_cast<char*>((*owner)->data()), (*owner)->size(), Free, owner);
+    return type::New(JSEnv(), buffer.ByteLength(), buffer, 0u);
+  }
+  static void Free(Napi::Env, void*, std::shared_ptr<const std::string>* owner) { delete owner; }
+};
+
+// NOTE(dkorolev): `JSBufferView` is the other direction: the bytes of a JavaScript `ArrayBuffer`, typed array,
+// or NodeJS `Buffer`, accessed from C++ where they are, with no copying. The view is only valid while the C++ function
+// that has received it as an argument is running, so copy the bytes, with `AsString()`, to keep them for longer.
+class JSBufferView final {
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0u;
+
+ public:
+  JSBufferView() = default;
+  JSBufferView(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return !size_; }
+
+  const uint8_t* begin() const { return data_; }
+  const uint8_t* end() const { return data_ + size_; }
+
+  std::string AsString() const { return std::string(reinterpret_cast<const char*>(data_), size_); }
+};
+
+template <>
+struct JS2CPPImpl<JSBufferView> {
+  static JSBufferView DoIt(const Napi::Value& v) {
+    const uint8_t* data;
+    size_t size;
+    if (JSBytesInPlace(v, data, size)) {
+      return JSBufferView(data, size);
+    } else {
+      // Same as for the other types, a mismatch results in an exception on the JavaScript side.
+      Napi::TypeError::New(JSEnv(), "Expected an `ArrayBuffer`, a typed array, or a `Buffer`.")
+          .ThrowAsJavaScriptException();
+      return JSBufferView();
+    }
+  }
+};
+
+}  // namespace impl
+}  // namespace javascript
+}  // namespace current
@@ -102,6 +102,44 @@ struct CPP2JSImpl<false, Undefined> {
   static type DoIt(Undefined) { return JSEnv().Undefined(); }
 };
 
+// The arrays are converted element by element, but in one call, so that a batch of values crosses the C++ <=> JS
+// boundary once, as opposed to once per value.
+template <typename T>
+struct CPP2JSImpl<false, std::vector<T>> {
+  using type = Napi::Array;
+  static type DoIt(const std::vector<T>& v) {
+    type result = type::New(JSEnv(), v.size());
+    for (size_t i = 0u; i < v.size(); ++i) {
+      result.Set(static_cast<uint32_t>(i), CPP2JS(v[i]));
+    }
+    return result;
+  }
+  static type DoIt(std::vector<T>&& v) {
+    type result = type::New(JSEnv(), v.size());
+    for (size_t i = 0u; i < v.size(); ++i) {
+      result.Set(static_cast<uint32_t>(i), CPP2JS(std::move(v[i])));
+    }
+    return result;
+  }
+};
+
+// The bytes become the backing store of an external `ArrayBuffer`, with no copying, and are freed once it is
+// garbage-collected. Pass the vector by an rvalue reference to avoid the one copy made of it otherwise.
+template <>
+struct CPP2JSImpl<false, std::vector<uint8_t>> {
+  using type = Napi::Uint8Array;
+  static type DoIt(const std::vector<uint8_t>& v) { return DoIt(std::vector<uint8_t>(v)); }
+  static type DoIt(std::vector<uint8_t>&& v) {
+    if (v.empty()) {
+      return type::New(JSEnv(), 0u);
+    }
+    std::vector<uint8_t>* owned = new std::vector<uint8_t>(std::move(v));
+    Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(JSEnv(), owned->data(), owned->size(), Free, owned);
+    return type::New(JSEnv(), buffer.ByteLength(), buffer, 0u);
+  }
+  static void Free(Napi::Env, void*, std::vector<uint8_t>* owned) { delete owned; }
+};
+
 // NOTE(dkorolev): See also `javascript_function_cont.hpp` for `CPP2JS` support for lambdas.
 
 }  // namespace impl
@@ -34,6 +34,60 @@ struct JS2CPPImpl<std::string> {
   static std::string DoIt(const Napi::Value& v) { return v.As<Napi::String>(); }
 };
 
+// The arrays are converted in one call, see `CPP2JSImpl<false, std::vector<T>>`.
+template <typename T>
+struct JS2CPPImpl<std::vector<T>> {
+  static std::vector<T> DoIt(const Napi::Value& v) {
+    const Napi::Array array = v.As<Napi::Array>();
+    const uint32_t length = array.Length();
+    std::vector<T> result;
+    result.reserve(length);
+    for (uint32_t i = 0u; i < length; ++i) {
+      result.push_back(JS2CPP<T>(array.Get(i)));
+    }
+    return result;
+  }
+};
+
+// The bytes of an `ArrayBuffer`, of a typed array, or of a NodeJS `Buffer`, where they are, with no copying.
+// Returns `false` if the value is none of the above.
+inline bool JSBytesInPlace(const Napi::Value& v, const uint8_t*& data, size_t& size) {
+  if (v.IsArrayBuffer()) {
+    Napi::ArrayBuffer buffer = v.As<Napi::ArrayBuffer>();
+    data = static_cast<const uint8_t*>(buffer.Data());
+    size = buffer.ByteLength();
+    return true;
+  } else if (v.IsTypedArray()) {
+    Napi::TypedArray array = v.As<Napi::TypedArray>();
+    data = static_cast<const uint8_t*>(array.ArrayBuffer().Data()) + array.ByteOffset();
+    size = array.ByteLength();
+    return true;
+  } else {
+    return false;
+  }
+}
+
+// The bytes are copied once, in bulk. Plain JavaScript arrays of numbers are accepted too.
+template <>
+struct JS2CPPImpl<std::vector<uint8_t>> {
+  static std::vector<uint8_t> DoIt(const Napi::Value& v) {
+    const uint8_t* data;
+    size_t size;
+    if (JSBytesInPlace(v, data, size)) {
+      return std::vector<uint8_t>(data, data + size);
+    } else {
+      std::vector<uint8_t> result;
+      const Napi::Array array = v.As<Napi::Array>();
+      const uint32_t length = array.Length();
+      result.reserve(length);
+      for (uint32_t i = 0u; i < length; ++i) {
+        result.push_back(static_cast<uint8_t>(static_cast<int>(array.Get(i).As<Napi::Number>())));
+      }
+      return result;
+    }
+  }
+};
+
 template <typename T>
 struct JS2CPPImpl<JSFunctionReferenceReturning<T>> {
   static JSFunctionReferenceReturning<T> DoIt(const Napi::Value& v) {
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+
+#include "javascript_cpp2js.hpp"
+#include "javascript_env.hpp"
+
+namespace current {
+namespace javascript {
+namespace impl {
+
+// NOTE(dkorolev): `JSLazyObject<T>` exposes a C++ object, such as a `CURRENT_STRUCT`, to JavaScript as an object
+// the fields of which are only converted as they are read. The C++ object is held by a `shared_ptr<const T>`,
+// and is not copied either. This pays off for the large objects of which JavaScript only looks at a few fields.
+//
+// The fields are listed explicitly, as the headers in this directory do not depend on Current's type system:
+//
+//   return JSLazyObject<Record>(record).Field("id", &Record::id).Field("name", &Record::name);
+//
+// or, for the fields that need some computation, `.Add("key", [](const Record& r) { return r.values.size(); })`.
+//
+// Each field is converted once, on its first read, after which it is a plain read-only property of the object.
+// The C++ object is released once the JavaScript object is garbage-collected.
+template <typename T>
+class JSLazyObject final {
+ public:
+  using getter_t = std::function<Napi::Value(const T&)>;
+
+  explicit JSLazyObject(std::shared_ptr<const T> object) : impl_(std::make_shared<Impl>(std::move(object))) {}
+
+  template <typename F>
+  JSLazyObject& Add(std::string key, F&& f) {
+    impl_->fields.emplace_back(impl_.get(), std::move(key), [f](const T& object) -> Napi::Value {
+      return CPP2JS(f(object));
+    });
+    return *this;
+  }
+
+  template <typename V>
+  JSLazyObject& Field(std::string key, V T::*field) {
+    return Add(std::move(key), [field](const T& object) -> const V& { return object.*field; });
+  }
+
+  Napi::Object ToJS() const {
+    Napi::Env env = JSEnv();
+    Napi::Object result = Napi::Object::New(env);
+    std::vector<napi_property_descriptor> descriptors;
+    descriptors.reserve(impl_->fields.size());
+    for (FieldImpl& field : impl_->fields) {
+      descriptors.push_back({field.key.c_str(),
+                             nullptr,
+                             nullptr,
+                             &FieldImpl::Get,
+                             nullptr,
+                             nullptr,
+                             static_cast<napi_property_attributes>(napi_enumerable | napi_configurable),
+                             &field});
+    }
+    napi_define_properties(env, result, descriptors.size(), descriptors.data());
+    // The JavaScript object holds on to the `Impl`, which the accessors refer to, until it is garbage-collected.
+    napi_wrap(env, result, new std::shared_ptr<Impl>(impl_), Free, nullptr, nullptr);
+    return result;
+  }
+
+ private:
+  struct Impl;
+  struct FieldImpl final {
+    const Impl* impl;
+    std::string key;
+    getter_t getter;
+    FieldImpl(const Impl* impl, std::string key, getter_t getter)
+        : impl(impl), key(std::move(key)), getter(std::move(getter)) {}
+
+    static napi_value Get(napi_env env, napi_callback_info info) {
+      napi_value self;
+      void* data;
+      napi_get_cb_info(env, info, nullptr, nullptr, &self, &data);
+      const FieldImpl& field = *static_cast<const FieldImpl*>(data);
+      JSEnvScope scope(Napi::Env{env});
+      const Napi::Value value = field.getter(*field.impl->object);
+      // Replace the accessor by the value itself, so that the field is converted only once.
+      const napi_property_descriptor descriptor = {
+          field.key.c_str(), nullptr, nullptr, nullptr, nullptr, value, napi_enumerable, nullptr};
+      napi_define_properties(env, self, 1u, &descriptor);
+      return value;
+    }
+  };
+  struct Impl final {
+    const std::shared_ptr<const T> object;
+    // A `std::deque`, as the fields are referred to by their addresses.
+    std::deque<FieldImpl> fields;
+    explicit Impl(std::shared_ptr<const T> object) : object(std::move(object)) {}
+  };
+
+  static void Free(napi_env, void* impl, void*) { delete static_cast<std::shared_ptr<Impl>*>(impl); }
+
+  // Shared, so that `JSLazyObject`-s can be returned by value from the C++ functions exposed to JavaScript.
+  std::shared_ptr<Impl> impl_;
+};
+
+template <typename T>
+struct CPP2JSImpl<false, JSLazyObject<T>> {
+  using type = Napi::Object;
+  static type DoIt(const JSLazyObject<T>& o) { return o.ToJS(); }
+};
+
+}  // namespace impl
+}  // namespace javascript
+}  // namespace current
@@ -27,6 +27,8 @@ SOFTWARE.
 
 #include "exceptions.h"
 
+#include "../delivery.h"
+
 #include "../../blocks/http/api.h"
 
 #include "../../typesystem/struct.h"
@@ -67,6 +69,7 @@ CURRENT_STRUCT(OneSignalNotificationResponse) {
 };
 
 constexpr static int16_t kDefaultOneSignalIntegrationPort = 24001;
+constexpr static const char* kOneSignalDeliveryDestination = "onesignal";
 
 class IOSPushNotificationsSender final {
  public:
@@ -122,21 +125,7 @@ server {
     if (message.empty() && !increase_counter) {
       return true;
     } else {
-      OneSignalNotificationRequest request;
-
-      request.app_id = app_id_;
-      request.include_player_ids.push_back(recipient_player_id);
-
-      if (!message.empty()) {
-        request.contents = OneSignalNotificationRequestMessage(message);
-      } else {
-        request.content_available = true;
-      }
-
-      if (increase_counter) {
-        request.ios_badgeType = "Increase";
-        request.ios_badgeCount = increase_counter;
-      }
+      const OneSignalNotificationRequest request = MakeRequest(recipient_player_id, message, increase_counter);
 
       try {
         const auto response = HTTP(POST(post_url_, JSON<JSONFormat::Minimalistic>(request))
@@ -179,7 +168,75 @@ server {
     return Push(recipient_player_id, "", increase_counter);
   }
 
+  // Same as `Push()`, without waiting for the response: the notification is sent, and retried if need be,
+  // by `engine`, which then calls `on_done`, if set, with whether the notification has reached exactly one user.
+  // Unlike `Push()`, the unexpected responses are not thrown on, but counted as rejected in the metrics of `engine`.
+  void Push(IntegrationDeliveryEngine& engine,
+            const std::string& recipient_player_id,
+            const std::string& message,
+            int32_t increase_counter = 0,
+            IntegrationDeliveryEngine::on_done_t on_done = nullptr) const {
+#ifdef CURRENT_CI
+    static_cast<void>(engine);
+    static_cast<void>(recipient_player_id);
+    static_cast<void>(message);
+    static_cast<void>(increase_counter);
+    if (on_done) {
+      on_done(true);
+    }
+#else
+    if (message.empty() && !increase_counter) {
+      if (on_done) {
+        on_done(true);
+      }
+      return;
+    }
+    const OneSignalNotificationRequest request = MakeRequest(recipient_player_id, message, increase_counter);
+    engine.Deliver(kOneSignalDeliveryDestination,
+                   POST(post_url_, JSON<JSONFormat::Minimalistic>(request))
+                       .SetHeader("Content-Type", net::constants::kDefaultJSONContentType),
+                   std::move(on_done),
+                   [](const current::http::HTTPResponseWithBuffer& response) {
+                     const DeliveryOutcome outcome = DefaultDeliveryOutcome(response);
+                     if (outcome != DeliveryOutcome::Delivered) {
+                       return outcome;
+                     }
+                     OneSignalNotificationResponse parsed_response;
+                     try {
+                       ParseJSON(response.body, parsed_response);
+                     } catch (const Exception&) {
+                       return DeliveryOutcome::Rejected;
+                     }
+                     return (Exists(parsed_response.recipients) && Value(parsed_response.recipients) == 1)
+                                ? DeliveryOutcome::Delivered
+                                : DeliveryOutcome::Rejected;
+                   });
+#endif  // CURRENT_CI
+  }
+
  private:
+  OneSignalNotificationRequest MakeRequest(const std::string& recipient_player_id,
+                                           const std::string& message,
+                                           int32_t increase_counter) const {
+    OneSignalNotificationRequest request;
+
+    request.app_id = app_id_;
+    request.include_player_ids.push_back(recipient_player_id);
+
+    if (!message.empty()) {
+      request.contents = OneSignalNotificationRequestMessage(message);
+    } else {
+      request.content_available = true;
+    }
+
+    if (increase_counter) {
+      request.ios_badgeType = "Increase";
+      request.ios_badgeCount = increase_counter;
+    }
+
+    return request;
+  }
+
   const std::string app_id_;
   const std::string post_url_;
 };
@@ -0,0 +1,280 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2016 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#include "../port.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "delivery.h"
+
+#include "../bricks/strings/join.h"
+#include "../bricks/strings/printf.h"
+
+#include "../3rdparty/gtest/gtest-main.h"
+
+using current::integrations::DeliveryPolicy;
+using current::integrations::IntegrationDeliveryBatcher;
+using current::integrations::IntegrationDeliveryEngine;
+using current::strings::Printf;
+
+namespace {
+
+// Records when each request to the endpoint has come in, and responds with the next code of `codes`,
+// or with the last one once they run out.
+struct ScriptedEndpoint final {
+  std::mutex mutex;
+  std::vector<int> codes;
+  std::vector<std::chrono::steady_clock::time_point> calls;
+
+  explicit ScriptedEndpoint(std::vector<int> codes) : codes(std::move(codes)) {}
+
+  void operator()(Request r) {
+    int code;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      code = codes[std::min(calls.size(), codes.size() - 1u)];
+      calls.push_back(std::chrono::steady_clock::now());
+    }
+    r("", HTTPResponseCode(code));
+  }
+
+  std::vector<std::chrono::steady_clock::time_point> Calls() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return calls;
+  }
+};
+
+int64_t Milliseconds(std::chrono::steady_clock::duration d) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+}
+
+}  // namespace
+
+TEST(IntegrationDelivery, RetriesWithBackoff) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  const std::string base_url = Printf("http://localhost:%d", port);
+
+  ScriptedEndpoint flaky({503, 429, 500, 200});
+  ScriptedEndpoint down({502});
+  ScriptedEndpoint bad({400});
+  HTTPRoutesScope scope;
+  scope += http_server.Register("/flaky", [&flaky](Request r) { flaky(std::move(r)); });
+  scope += http_server.Register("/down", [&down](Request r) { down(std::move(r)); });
+  scope += http_server.Register("/bad", [&bad](Request r) { bad(std::move(r)); });
+
+  IntegrationDeliveryEngine engine(
+      DeliveryPolicy().SetMaxAttempts(5u).SetBackoff(std::chrono::milliseconds(20), std::chrono::milliseconds(50)));
+  engine.SetPolicy("down", DeliveryPolicy().SetMaxAttempts(3u).SetBackoff(std::chrono::milliseconds(10),
+                                                                          std::chrono::milliseconds(10)));
+
+  std::atomic_int flaky_done(-1);
+  std::atomic_int down_done(-1);
+  std::atomic_int bad_done(-1);
+  engine.Deliver("flaky", GET(base_url + "/flaky"), [&flaky_done](bool delivered) { flaky_done = delivered; });
+  engine.Deliver("down", POST(base_url + "/down", "event"), [&down_done](bool delivered) { down_done = delivered; });
+  engine.Deliver("bad", GET(base_url + "/bad"), [&bad_done](bool delivered) { bad_done = delivered; });
+  engine.WaitUntilIdle();
+
+  // The 503, 429 and 500 responses are retried, after 20ms, 40ms, and then 50ms, as capped by `max_backoff`.
+  EXPECT_EQ(1, flaky_done);
+  const auto flaky_calls = flaky.Calls();
+  ASSERT_EQ(4u, flaky_calls.size());
+  EXPECT_GE(Milliseconds(flaky_calls[1] - flaky_calls[0]), 20);
+  EXPECT_GE(Milliseconds(flaky_calls[2] - flaky_calls[1]), 40);
+  EXPECT_GE(Milliseconds(flaky_calls[3] - flaky_calls[2]), 50);
+
+  // The destination that keeps failing is given up on after `max_attempts`.
+  EXPECT_EQ(0, down_done);
+  const auto down_calls = down.Calls();
+  ASSERT_EQ(3u, down_calls.size());
+  EXPECT_GE(Milliseconds(down_calls[1] - down_calls[0]), 10);
+  EXPECT_GE(Milliseconds(down_calls[2] - down_calls[1]), 10);
+
+  // The 4xx responses, other than 429, are not retried.
+  EXPECT_EQ(0, bad_done);
+  EXPECT_EQ(1u, bad.Calls().size());
+}
+
+TEST(IntegrationDelivery, MaxInFlight) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  const std::string base_url = Printf("http://localhost:%d", port);
+
+  std::mutex held_mutex;
+  std::vector<std::unique_ptr<Request>> held;
+  size_t max_held = 0u;
+  const auto HeldCount = [&]() {
+    std::lock_guard<std::mutex> lock(held_mutex);
+    return held.size();
+  };
+  HTTPRoutesScope scope;
+  scope += http_server.Register("/held", [&](Request r) {
+    std::lock_guard<std::mutex> lock(held_mutex);
+    held.push_back(std::make_unique<Request>(std::move(r)));
+    max_held = std::max(max_held, held.size());
+  });
+  http_server.SetIOThreads(4u);
+
+  {
+    IntegrationDeliveryEngine engine(DeliveryPolicy().SetMaxInFlight(3u));
+    std::atomic_int delivered(0);
+    for (int i = 0; i < 10; ++i) {
+      engine.Deliver("held", GET(base_url + "/held"), [&delivered](bool ok) { delivered += ok; });
+    }
+    while (HeldCount() != 3u) {
+      std::this_thread::yield();
+    }
+    // No more requests are sent until some of those in flight are responded to.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(3u, HeldCount());
+    const auto status = engine.Status();
+    ASSERT_EQ(1u, status.destinations.size());
+    EXPECT_EQ("held", status.destinations[0].destination);
+    EXPECT_EQ(3u, status.destinations[0].in_flight);
+    EXPECT_EQ(7u, status.destinations[0].queued);
+
+    while (delivered != 10) {
+      std::vector<std::unique_ptr<Request>> to_respond;
+      {
+        std::lock_guard<std::mutex> lock(held_mutex);
+        to_respond.swap(held);
+      }
+      for (auto& r : to_respond) {
+        (*r)("OK");
+      }
+      std::this_thread::yield();
+    }
+    engine.WaitUntilIdle();
+    EXPECT_EQ(3u, max_held);
+  }
+
+  http_server.SetIOThreads(0u);
+}
+
+TEST(IntegrationDelivery, UndeliveredOnDestruction) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  const std::string base_url = Printf("http://localhost:%d", port);
+
+  std::mutex held_mutex;
+  std::vector<std::unique_ptr<Request>> held;
+  const auto HeldCount = [&]() {
+    std::lock_guard<std::mutex> lock(held_mutex);
+    return held.size();
+  };
+  ScriptedEndpoint down({503});
+  HTTPRoutesScope scope;
+  scope += http_server.Register("/held", [&](Request r) {
+    std::lock_guard<std::mutex> lock(held_mutex);
+    held.push_back(std::make_unique<Request>(std::move(r)));
+  });
+  scope += http_server.Register("/down", [&down](Request r) { down(std::move(r)); });
+  http_server.SetIOThreads(4u);
+
+  std::atomic_int delivered(0);
+  std::atomic_int undelivered(0);
+  const auto on_done = [&](bool ok) { ++(ok ? delivered : undelivered); };
+  {
+    IntegrationDeliveryEngine engine(DeliveryPolicy().SetMaxInFlight(1u));
+    engine.SetPolicy("down", DeliveryPolicy().SetBackoff(std::chrono::seconds(100), std::chrono::seconds(100)));
+    // One in flight and two queued, and one waiting a long time to be retried.
+    for (int i = 0; i < 3; ++i) {
+      engine.Deliver("held", GET(base_url + "/held"), on_done);
+    }
+    engine.Deliver("down", GET(base_url + "/down"), on_done);
+    while (HeldCount() != 1u || down.Calls().size() != 1u) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ(0, delivered + undelivered);
+  }
+  EXPECT_EQ(0, delivered);
+  EXPECT_EQ(4, undelivered);
+
+  {
+    std::lock_guard<std::mutex> lock(held_mutex);
+    held.clear();
+  }
+  http_server.SetIOThreads(0u);
+}
+
+TEST(IntegrationDelivery, Batcher) {
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  const std::string base_url = Printf("http://localhost:%d", port);
+
+  std::mutex bodies_mutex;
+  std::vector<std::string> bodies;
+  HTTPRoutesScope scope;
+  scope += http_server.Register("/batch", [&](Request r) {
+    {
+      std::lock_guard<std::mutex> lock(bodies_mutex);
+      bodies.push_back(r.body);
+    }
+    r("OK");
+  });
+  const auto Bodies = [&]() {
+    std::lock_guard<std::mutex> lock(bodies_mutex);
+    return bodies;
+  };
+
+  IntegrationDeliveryEngine engine;
+  {
+    IntegrationDeliveryBatcher<std::string> batcher(
+        engine, 3u, std::chrono::milliseconds(50), [&](std::vector<std::string>&& events) {
+          engine.Deliver("batch", POST(base_url + "/batch", current::strings::Join(events, ',')));
+        });
+
+    // Flushed once there are `max_batch_size` events.
+    batcher.Add("a");
+    batcher.Add("b");
+    batcher.Add("c");
+    engine.WaitUntilIdle();
+    EXPECT_EQ(std::vector<std::string>({"a,b,c"}), Bodies());
+
+    // Flushed `max_delay` after the first event of the batch.
+    const auto added = std::chrono::steady_clock::now();
+    batcher.Add("d");
+    batcher.Add("e");
+    while (Bodies().size() != 2u) {
+      std::this_thread::yield();
+    }
+    EXPECT_GE(Milliseconds(std::chrono::steady_clock::now() - added), 50);
+    EXPECT_EQ(std::vector<std::string>({"a,b,c", "d,e"}), Bodies());
+
+    // And on destruction.
+    batcher.Add("f");
+  }
+  engine.WaitUntilIdle();
+  EXPECT_EQ(std::vector<std::string>({"a,b,c", "d,e", "f"}), Bodies());
+}
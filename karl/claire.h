@@ -47,6 +47,8 @@ SOFTWARE.
 
 #include "../blocks/http/api.h"
 
+#include "../typesystem/serialization/binary.h"
+
 #include "../bricks/time/chrono.h"
 #include "../bricks/sync/locks.h"
 #include "../bricks/util/random.h"
@@ -77,6 +79,24 @@ inline std::string KeepaliveAttemptResultAsString(const InternalKeepaliveAttempt
   }
 }
 
+// The fields of the keepalive which a delta keepalive omits while they are unchanged, see `ClaireStatus`.
+struct DeltaKeepaliveFields {
+  std::string build;
+  std::string runtime;
+  std::string cloud_instance_name;
+  std::string cloud_availability_group;
+  std::string dependencies;
+
+  DeltaKeepaliveFields() = default;
+  template <typename STATUS>
+  explicit DeltaKeepaliveFields(const STATUS& status)
+      : build(JSON(status.build)),
+        runtime(JSON(status.runtime)),
+        cloud_instance_name(JSON(status.cloud_instance_name)),
+        cloud_availability_group(JSON(status.cloud_availability_group)),
+        dependencies(JSON(status.dependencies)) {}
+};
+
 // Interface to implement for receiving callbacks/notifications from Claire.
 class IClaireNotifiable {
  public:
@@ -198,6 +218,14 @@ class GenericClaire final : private DummyClaireNotifiable {
 
   const std::string& Codename() const { return codename_; }
 
+  // Send the delta keepalives, which omit the rarely changing fields, such as the build info, while they are unchanged.
+  // The full keepalive is sent first, and then again whenever Karl has no state to apply the delta to.
+  void SendDeltaKeepalives(bool value = true) { delta_keepalives_ = value; }
+
+  // Send the keepalives in the binary format, which is more compact, and cheaper for Karl to parse.
+  // Karl must be built with the same runtime status types, as the binary format stores no field names.
+  void SendBinaryKeepalives(bool value = true) { binary_keepalives_ = value; }
+
   void ForceSendKeepalive(ForceSendKeepaliveWaitRequest wait_for_keepalive = ForceSendKeepaliveWaitRequest::DoNotWait) {
     {
       std::lock_guard<std::mutex> lock(keepalive_thread_running_status_mutex_);
@@ -239,6 +267,7 @@ class GenericClaire final : private DummyClaireNotifiable {
       std::lock_guard<std::mutex> lock(keepalive_mutex_);
       karl_ = new_karl_locator;
       karl_keepalive_route_ = KarlKeepaliveRoute(karl_, codename_, port_);
+      has_acknowledged_fields_ = false;  // The new Karl needs the full keepalive.
       notifiable_ref_.OnKarlLocatorChanged(new_karl_locator);
     }
     ForceSendKeepalive(wait_for_keepalive);
@@ -362,6 +391,7 @@ class GenericClaire final : private DummyClaireNotifiable {
   void SendKeepaliveToKarl(std::unique_lock<std::mutex>&, const std::string& route) {
     // Basically, throw in case of any error, and throw only one type: `ClaireRegistrationException`.
     const auto keepalive_body = GenerateKeepaliveStatus();
+    const DeltaKeepaliveFields keepalive_fields(keepalive_body);
 
     std::string error_message = "";
 
@@ -373,7 +403,23 @@ class GenericClaire final : private DummyClaireNotifiable {
         last_keepalive_attempt_result_.http_code = static_cast<uint16_t>(net::HTTPResponseCodeValue::InvalidCode);
       }
 
-      const auto code = HTTP(POST(route, keepalive_body)).code;
+      const auto code = [&]() {
+        if (!delta_keepalives_) {
+          return PostKeepalive(route, keepalive_body);
+        }
+        if (has_acknowledged_fields_) {
+          specific_status_t delta_body = keepalive_body;
+          if (OmitUnchangedFields(delta_body, acknowledged_fields_)) {
+            const auto delta_code =
+                PostKeepalive(route + "&delta&seq=" + current::ToString(++keepalive_sequence_number_), delta_body);
+            if (delta_code != HTTPResponseCode.Conflict) {
+              return delta_code;
+            }
+            // Karl has no state to apply this delta to, so send the full keepalive right away.
+          }
+        }
+        return PostKeepalive(route + "&seq=" + current::ToString(++keepalive_sequence_number_), keepalive_body);
+      }();
 
       {
         std::lock_guard<std::mutex> lock(status_mutex_);
@@ -382,6 +428,8 @@ class GenericClaire final : private DummyClaireNotifiable {
           last_keepalive_attempt_result_.status = KeepaliveAttemptStatus::Success;
           last_successful_keepalive_timestamp_ = last_keepalive_attempt_result_.timestamp;
           last_successful_keepalive_ping_ = current::time::Now() - last_keepalive_attempt_result_.timestamp;
+          has_acknowledged_fields_ = true;
+          acknowledged_fields_ = keepalive_fields;
           return;
         } else {
           last_keepalive_attempt_result_.status = KeepaliveAttemptStatus::ErrorCodeReturned;
@@ -390,6 +438,8 @@ class GenericClaire final : private DummyClaireNotifiable {
       }
     } catch (const current::Exception& e) {
       last_keepalive_attempt_result_.status = KeepaliveAttemptStatus::CouldNotConnect;
+      // Whether the last delta has been applied is unknown, so the next keepalive is the full one.
+      has_acknowledged_fields_ = false;
       error_message = e.DetailedDescription();
     }
     // OK to throw here. In the thread that sends repeated keepalives, this exception would be caught,
@@ -398,6 +448,46 @@ class GenericClaire final : private DummyClaireNotifiable {
     CURRENT_THROW(ClaireRegistrationException(service_, route, error_message));
   }
 
+  net::HTTPResponseCodeValue PostKeepalive(const std::string& route, const specific_status_t& body) const {
+    if (binary_keepalives_) {
+      return HTTP(POST(route + "&binary", SaveIntoBinary(body), "application/octet-stream")).code;
+    } else {
+      return HTTP(POST(route, body)).code;
+    }
+  }
+
+  // Clears the fields of `status` unchanged since the keepalive Karl has acknowledged last, for a delta keepalive.
+  // Returns `false` if a field has become empty, as the delta keepalive can not tell it from an unchanged one.
+  static bool OmitUnchangedFields(specific_status_t& status, const DeltaKeepaliveFields& acknowledged) {
+    const DeltaKeepaliveFields fields(status);
+    if (fields.build == acknowledged.build) {
+      status.build = nullptr;
+    } else if (!Exists(status.build)) {
+      return false;
+    }
+    if (fields.runtime == acknowledged.runtime) {
+      status.runtime = nullptr;
+    } else if (!Exists(status.runtime)) {
+      return false;
+    }
+    if (fields.cloud_instance_name == acknowledged.cloud_instance_name) {
+      status.cloud_instance_name = nullptr;
+    } else if (!Exists(status.cloud_instance_name)) {
+      return false;
+    }
+    if (fields.cloud_availability_group == acknowledged.cloud_availability_group) {
+      status.cloud_availability_group = nullptr;
+    } else if (!Exists(status.cloud_availability_group)) {
+      return false;
+    }
+    if (fields.dependencies == acknowledged.dependencies) {
+      status.dependencies.clear();
+    } else if (status.dependencies.empty()) {
+      return false;
+    }
+    return true;
+  }
+
   // The semantic to ensure keepalives only happen from a locked section.
   void SendKeepaliveToKarl(const std::string& route) {
     std::unique_lock<std::mutex> lock(keepalive_mutex_);
@@ -520,6 +610,12 @@ class GenericClaire final : private DummyClaireNotifiable {
 
  private:
   std::atomic_bool in_beacon_mode_;
+  std::atomic_bool binary_keepalives_{false};
+  std::atomic_bool delta_keepalives_{false};
+  // The state of the delta keepalives, guarded by `keepalive_mutex_`.
+  uint64_t keepalive_sequence_number_ = 0u;
+  bool has_acknowledged_fields_ = false;
+  DeltaKeepaliveFields acknowledged_fields_;
 
   Locator karl_;
   const std::string service_;
@@ -46,6 +46,7 @@ SOFTWARE.
 
 #include "../port.h"
 
+#include <cctype>
 #include <type_traits>
 
 // The `current_build.h` file from this local `Current/Karl` dir makes no sense for external users of Karl.
@@ -64,6 +65,8 @@ SOFTWARE.
 #include "../storage/storage.h"
 #include "../storage/persister/stream.h"
 
+#include "../blocks/persistence/segmented.h"
+
 #include "../bricks/net/http/impl/server.h"
 #include "../bricks/util/base64.h"
 
@@ -78,6 +81,118 @@ SOFTWARE.
 namespace current {
 namespace karl {
 
+namespace impl {
+
+// Splits the JSON object of a keepalive into the JSON of its top-level fields other than `runtime`, and the raw JSON
+// of `runtime`, left empty if there is none. This way the envelope of the keepalive is parsed without the runtime
+// status of the service, which is as rich as the service makes it. Returns `false` if the JSON could not be split,
+// for it to be parsed as a whole.
+inline bool SplitOffKeepaliveRuntime(const std::string& json, std::string& envelope, std::string& runtime) {
+  const char* p = json.data();
+  const char* const end = p + json.length();
+  const auto skip_whitespace = [&]() {
+    while (p != end && std::isspace(static_cast<unsigned char>(*p))) {
+      ++p;
+    }
+  };
+  // Expects `p` at the opening quote, leaves it past the closing one.
+  const auto skip_string = [&]() -> bool {
+    for (++p; p != end; ++p) {
+      if (*p == '\\') {
+        if (++p == end) {
+          return false;
+        }
+      } else if (*p == '"') {
+        ++p;
+        return true;
+      }
+    }
+    return false;
+  };
+  const auto skip_value = [&]() -> bool {
+    const char* const begin = p;
+    size_t depth = 0u;
+    while (p != end) {
+      const char c = *p;
+      if (c == '"') {
+        if (!skip_string()) {
+          return false;
+        } else if (!depth) {
+          return true;
+        }
+      } else if (c == '{' || c == '[') {
+        ++depth;
+        ++p;
+      } else if (c == '}' || c == ']') {
+        if (!depth) {
+          return p != begin;
+        }
+        ++p;
+        if (!--depth) {
+          return true;
+        }
+      } else if (!depth && (c == ',' || std::isspace(static_cast<unsigned char>(c)))) {
+        return p != begin;
+      } else {
+        ++p;
+      }
+    }
+    return false;
+  };
+
+  skip_whitespace();
+  if (p == end || *p != '{') {
+    return false;
+  }
+  ++p;
+  envelope = "{";
+  runtime.clear();
+  while (true) {
+    skip_whitespace();
+    if (p != end && *p == '}' && envelope.length() == 1u && runtime.empty()) {
+      break;
+    }
+    if (p == end || *p != '"') {
+      return false;
+    }
+    const char* const member_begin = p;
+    if (!skip_string()) {
+      return false;
+    }
+    const bool is_runtime = std::string(member_begin, p) == "\"runtime\"";
+    skip_whitespace();
+    if (p == end || *p != ':') {
+      return false;
+    }
+    ++p;
+    skip_whitespace();
+    const char* const value_begin = p;
+    if (!skip_value()) {
+      return false;
+    }
+    if (is_runtime) {
+      runtime.assign(value_begin, p);
+    } else {
+      if (envelope.length() > 1u) {
+        envelope += ',';
+      }
+      envelope.append(member_begin, p);
+    }
+    skip_whitespace();
+    if (p != end && *p == ',') {
+      ++p;
+    } else if (p != end && *p == '}') {
+      break;
+    } else {
+      return false;
+    }
+  }
+  envelope += '}';
+  return true;
+}
+
+}  // namespace impl
+
 CURRENT_STRUCT_T(KarlPersistedKeepalive) {
   CURRENT_FIELD(location, ClaireServiceKey);
   CURRENT_FIELD(keepalive, T);
@@ -222,6 +337,8 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
   using karl_status_t = GenericKarlStatus<runtime_status_variant_t>;
   using persisted_keepalive_t = KarlPersistedKeepalive<claire_status_t>;
   using stream_t = stream::Stream<persisted_keepalive_t, current::persistence::File>;
+  using segmented_stream_t = stream::Stream<persisted_keepalive_t, current::persistence::SegmentedFile>;
+  using summary_stream_t = stream::Stream<KarlServiceSummary, current::persistence::File>;
   using storage_t = typename KarlStorage<STORAGE_TYPE>::storage_t;
   using karl_notifiable_t = IKarlNotifiable<runtime_status_variant_t>;
   using fleet_view_renderer_t = IKarlFleetViewRenderer<runtime_status_variant_t>;
@@ -276,7 +393,15 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
                                : parameters_.public_url),
         notifiable_ref_(notifiable),
         fleet_view_renderer_ref_(renderer),
-        keepalives_stream_(stream_t::CreateStream(parameters_.stream_persistence_file)),
+        fleet_view_complete_since_(current::time::Now()),
+        fleet_version_(0u),
+        keepalives_stream_(CreateKeepalivesStream(parameters_)),
+        segmented_keepalives_stream_(CreateSegmentedKeepalivesStream(parameters_)),
+        summary_stream_((parameters_.summary_persistence_file.empty() || parameters_.summary_interval.count() <= 0)
+                            ? nullptr
+                            : Optional<Owned<summary_stream_t>>(
+                                  summary_stream_t::CreateStream(parameters_.summary_persistence_file))),
+        pending_summaries_from_(0),
         state_update_thread_running_(false),
         state_update_thread_force_wakeup_(false),
         state_update_thread_([this]() {
@@ -303,6 +428,10 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
                         .Register(parameters_.fleet_view_url + "snapshot",
                                   URLPathArgs::CountMask::One,
                                   [this](Request r) { ServeSnapshot(std::move(r)); }) +
+                    HTTP(current::net::BarePort(parameters_.fleet_view_port))
+                        .Register(parameters_.fleet_view_url + "history",
+                                  URLPathArgs::CountMask::None,
+                                  [this](Request r) { ServeHistory(std::move(r)); }) +
                     HTTP(current::net::BarePort(parameters_.fleet_view_port))
                         .Register(parameters_.fleet_view_url + "favicon.png", http::CurrentFaviconHandler())) {
     while (!state_update_thread_running_) {
@@ -311,6 +440,9 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
       // A condition variable or a `WaitableAtomic` is a cleaner solution here; for now, just sleep.
       std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
+    if (parameters_.keepalives_batch_interval.count() > 0) {
+      keepalives_batch_thread_ = std::thread([this]() { KeepalivesBatchThread(); });
+    }
     if (parameters_.keepalives_port == parameters_.fleet_view_port) {
       std::cerr << "It's advised to start Karl with two different ports: "
                 << "one to accept keepalives and one to serve status. "
@@ -320,11 +452,13 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
     // Report this Karl as up and running.
     storage_
         ->ReadWriteTransaction([this](MutableFields<storage_t> fields) {
-          const auto& keepalives_data = keepalives_stream_->Data();
           KarlInfo self_info;
-          if (!keepalives_data->Empty()) {
-            self_info.persisted_keepalives_info = keepalives_data->LastPublishedIndexAndTimestamp();
-          }
+          WithKeepalivesStream([&self_info](const auto& stream) {
+            const auto& keepalives_data = stream->Data();
+            if (!keepalives_data->Empty()) {
+              self_info.persisted_keepalives_info = keepalives_data->LastPublishedIndexAndTimestamp();
+            }
+          });
           fields.karl.Add(self_info);
 
           const auto now = current::time::Now();
@@ -342,6 +476,19 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
  public:
   ~GenericKarl() {
     destructing_ = true;
+    if (keepalives_batch_thread_.joinable()) {
+      {
+        // Apply the keepalives pending in the batch.
+        std::lock_guard<std::mutex> lock(pending_keepalives_mutex_);
+        pending_keepalives_condition_variable_.notify_one();
+      }
+      keepalives_batch_thread_.join();
+    }
+    if (Exists(summary_stream_)) {
+      // The summaries of the last, incomplete, interval are persisted too, and merged with their continuation, if any.
+      std::lock_guard<std::mutex> lock(summaries_mutex_);
+      PersistPendingSummaries();
+    }
     storage_
         ->ReadWriteTransaction([](MutableFields<storage_t> fields) {
           KarlInfo self_info;
@@ -375,6 +522,108 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
   Borrowed<storage_t> BorrowStorage() const { return storage_; }
 
  private:
+  // A keepalive parsed from its inbound request, to be applied on its own, or as part of a batch.
+  struct ReceivedKeepalive {
+    Request request;
+    std::chrono::microseconds now;
+    ClaireServiceKey location;
+    claire_status_t keepalive;
+    Optional<std::chrono::microseconds> optional_behind_this_by;
+    idxts_t idx_ts;  // Set once published into the stream.
+    explicit ReceivedKeepalive(Request&& request) : request(std::move(request)) {}
+  };
+
+  // The summary of the keepalives of one service within the interval not yet persisted, see `SummarizeKeepalive()`.
+  struct PendingServiceSummary {
+    uint64_t keepalives = 0u;
+    std::set<std::string> codenames;
+    std::set<std::string> git_commits;
+  };
+
+  static bool HasSegmentedKeepalivesStream(const KarlParameters& parameters) {
+    return parameters.stream_segment_bytes || parameters.stream_segment_duration.count() > 0;
+  }
+
+  static Optional<Owned<stream_t>> CreateKeepalivesStream(const KarlParameters& parameters) {
+    if (HasSegmentedKeepalivesStream(parameters)) {
+      return nullptr;
+    }
+    return stream_t::CreateStream(
+        parameters.stream_persistence_file,
+        // The batched keepalives are flushed together, not one by one.
+        parameters.keepalives_batch_interval.count() > 0
+            ? current::persistence::FileDurability::GroupCommit(parameters.keepalives_batch_interval)
+            : current::persistence::FileDurability::FlushEachEntry());
+  }
+
+  static Optional<Owned<segmented_stream_t>> CreateSegmentedKeepalivesStream(const KarlParameters& parameters) {
+    if (!HasSegmentedKeepalivesStream(parameters)) {
+      return nullptr;
+    }
+    auto segmentation = parameters.stream_segment_bytes
+                            ? current::persistence::FileSegmentation::BySize(parameters.stream_segment_bytes)
+                            : current::persistence::FileSegmentation();
+    segmentation.max_segment_duration = parameters.stream_segment_duration;
+    return segmented_stream_t::CreateStream(
+        parameters.stream_persistence_file,
+        segmentation.Retaining(parameters.stream_retained_segments, parameters.stream_archive_directory));
+  }
+
+  // Calls `f` with the stream of keepalives, whichever of the two kinds it is.
+  template <typename F>
+  void WithKeepalivesStream(F&& f) {
+    if (Exists(segmented_keepalives_stream_)) {
+      f(Value(segmented_keepalives_stream_));
+    } else {
+      f(Value(keepalives_stream_));
+    }
+  }
+
+  template <typename PERSISTER>
+  static uint64_t FirstAvailableKeepaliveIndex(const PERSISTER&) {
+    return 0u;
+  }
+  static uint64_t FirstAvailableKeepaliveIndex(const typename segmented_stream_t::persistence_layer_t& persister) {
+    return persister.FirstAvailableIndex();
+  }
+
+  // Adds the keepalive into the summary of its service for the interval it belongs to, persisting the summaries of
+  // the previous interval first, if it has ended. To be called with `summaries_mutex_` locked.
+  void SummarizeKeepalive(const ReceivedKeepalive& received) {
+    const auto from = received.idx_ts.us - received.idx_ts.us % parameters_.summary_interval;
+    if (from != pending_summaries_from_) {
+      PersistPendingSummaries();
+      pending_summaries_from_ = from;
+    }
+    PendingServiceSummary& summary = pending_summaries_[received.keepalive.service];
+    ++summary.keepalives;
+    summary.codenames.insert(received.keepalive.codename);
+    if (Exists(received.keepalive.build) && Exists(Value(received.keepalive.build).git_commit_hash)) {
+      summary.git_commits.insert(Value(Value(received.keepalive.build).git_commit_hash));
+    }
+  }
+
+  KarlServiceSummary PendingSummary(const std::string& service, const PendingServiceSummary& pending) const {
+    KarlServiceSummary summary;
+    summary.service = service;
+    summary.from = pending_summaries_from_;
+    summary.to = pending_summaries_from_ + parameters_.summary_interval;
+    summary.keepalives = pending.keepalives;
+    summary.codenames.assign(pending.codenames.begin(), pending.codenames.end());
+    summary.git_commits.assign(pending.git_commits.begin(), pending.git_commits.end());
+    return summary;
+  }
+
+  // To be called with `summaries_mutex_` locked.
+  void PersistPendingSummaries() {
+    if (!pending_summaries_.empty()) {
+      for (const auto& pending : pending_summaries_) {
+        Value(summary_stream_)->Publisher()->Publish(PendingSummary(pending.first, pending.second));
+      }
+      pending_summaries_.clear();
+    }
+  }
+
   void StateUpdateThread() {
     while (!destructing_) {
       const auto now = current::time::Now();
@@ -414,6 +663,11 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
                   }
                 })
             .Wait();
+        ++fleet_version_;
+        std::lock_guard<std::mutex> lock(parsed_runtime_statuses_mutex_);
+        for (const auto& codename : timeouted_codenames) {
+          parsed_runtime_statuses_.erase(codename);
+        }
       }
       UpdateNginxIfNeeded();
 #ifdef CURRENT_MOCK_TIME
@@ -485,8 +739,13 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
           std::lock_guard<std::mutex> lock(services_keepalive_cache_mutex_);
           services_keepalive_time_cache_.erase(codename);
           state_update_thread_force_wakeup_ = true;
+          ++fleet_version_;
           update_thread_condition_variable_.notify_one();
         }
+        {
+          std::lock_guard<std::mutex> lock(parsed_runtime_statuses_mutex_);
+          parsed_runtime_statuses_.erase(codename);
+        }
       } else {
         // Respond with "200 OK" in any case.
         r("NOP\n");
@@ -497,8 +756,12 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
         // If `&confirm` is set, along with `codename` and `port`, Karl calls the service back
         // via the URL from the inbound request and the port the service has provided,
         // to confirm two-way communication.
+        // With `&binary`, the body is the keepalive in the binary format, of the `claire_status_t` of this Karl.
+        const bool binary = qs.has("binary") && !qs.has("confirm");
         const std::string json = [&]() -> std::string {
-          if (qs.has("confirm") && qs.has("port")) {
+          if (binary) {
+            return "";
+          } else if (qs.has("confirm") && qs.has("port")) {
             const std::string url = "http://" + remote_ip + ':' + qs["port"] + "/.current";
             // Send a GET request, with a random component in the URL to prevent caching.
             return HTTP(GET(url + "?all&rnd" +
@@ -510,7 +773,20 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
           }
         }();
 
-        const auto parsed_status = ParseJSON<ClaireStatus>(json);
+        // The envelope of the keepalive is parsed first, and the runtime status is only parsed if it has changed
+        // since the previous keepalive of the same codename, see `ParseRuntimeStatus()`.
+        Optional<claire_status_t> binary_status;
+        std::string envelope_json;
+        std::string runtime_json;
+        bool envelope_split_off = false;
+        if (binary) {
+          binary_status = LoadFromBinary<claire_status_t>(r.body);
+        } else {
+          envelope_split_off = impl::SplitOffKeepaliveRuntime(json, envelope_json, runtime_json);
+        }
+        const ClaireStatus parsed_status =
+            binary ? static_cast<const ClaireStatus&>(Value(binary_status))
+                   : ParseJSON<ClaireStatus>(envelope_split_off ? envelope_json : json);
         if ((!qs.has("codename") || parsed_status.codename == qs["codename"]) &&
             (!qs.has("port") || parsed_status.local_port == current::FromString<uint16_t>(qs["port"]))) {
           ClaireServiceKey location;
@@ -520,7 +796,15 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
 
           // If the received status can be parsed in detail, including the "runtime" variant, persist it.
           // If no, no big deal, keep the top-level one regardless.
-          const auto detailed_parsed_status = [&]() -> claire_status_t {
+          auto detailed_parsed_status = [&]() -> claire_status_t {
+            if (binary) {
+              return Value(binary_status);
+            }
+            if (envelope_split_off) {
+              claire_status_t status(parsed_status);
+              status.runtime = ParseRuntimeStatus(parsed_status.codename, runtime_json);
+              return status;
+            }
             Optional<claire_status_t> parsed_opt = TryParseJSON<claire_status_t>(json);
             if (!Exists(parsed_opt)) {  // Can't parse in Current format. Trying `Minimalistic`.
               parsed_opt = TryParseJSON<claire_status_t, JSONFormat::Minimalistic>(json);
@@ -543,132 +827,43 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
             }
           }();
 
-          const auto now = current::time::Now();
-
-          {
-            persisted_keepalive_t record;
-            record.location = location;
-            record.keepalive = detailed_parsed_status;
-            {
-              std::lock_guard<std::mutex> lock(latest_keepalive_index_mutex_);
-              latest_keepalive_index_plus_one_[parsed_status.codename] =
-                  keepalives_stream_->Publisher()->Publish(std::move(record)).index;
+          // The delta keepalives are applied to the previous keepalive of the same codename, see `ClaireStatus`.
+          if (qs.has("seq")) {
+            const uint64_t seq = current::FromString<uint64_t>(qs["seq"]);
+            std::lock_guard<std::mutex> lock(delta_keepalive_bases_mutex_);
+            if (qs.has("delta")) {
+              const auto cit = delta_keepalive_bases_.find(parsed_status.codename);
+              if (cit == delta_keepalive_bases_.end() || cit->second.seq + 1u != seq) {
+                r("Full keepalive required.\n", HTTPResponseCode.Conflict);
+                return;
+              }
+              FillOmittedKeepaliveFields(detailed_parsed_status, cit->second.keepalive);
             }
+            DeltaKeepaliveBase& base = delta_keepalive_bases_[parsed_status.codename];
+            base.seq = seq;
+            base.keepalive = detailed_parsed_status;
           }
 
-          Optional<std::chrono::microseconds> optional_behind_this_by;
+          ReceivedKeepalive received(std::move(r));
+          received.now = current::time::Now();
+          received.location = location;
+          received.keepalive = detailed_parsed_status;
           if (Exists(parsed_status.last_successful_keepalive_ping_us)) {
-            optional_behind_this_by =
-                now - parsed_status.now - Value(parsed_status.last_successful_keepalive_ping_us) / 2;
+            received.optional_behind_this_by =
+                received.now - parsed_status.now - Value(parsed_status.last_successful_keepalive_ping_us) / 2;
           }
 
-          auto& notifiable_ref = notifiable_ref_;
-          storage_
-              ->ReadWriteTransaction(
-                  [now, location, &parsed_status, &detailed_parsed_status, optional_behind_this_by, &notifiable_ref](
-                      MutableFields<storage_t> fields) -> Response {
-                    // OK to call from within a transaction.
-                    // The call is fast, and `storage_`'s transaction guarantees thread safety. -- D.K.
-                    notifiable_ref.OnKeepalive(now, location, parsed_status.codename, detailed_parsed_status);
-
-                    const auto& service = parsed_status.service;
-                    const auto& codename = parsed_status.codename;
-                    const auto& optional_build = parsed_status.build;
-                    const auto& optional_instance = parsed_status.cloud_instance_name;
-                    const auto& optional_av_group = parsed_status.cloud_availability_group;
-
-                    // Update per-server information in the `DB`.
-                    ServerInfo server;
-                    server.ip = location.ip;
-                    bool need_to_update_server_info = false;
-                    const ImmutableOptional<ServerInfo> current_server_info = fields.servers[location.ip];
-                    if (Exists(current_server_info)) {
-                      server = Value(current_server_info);
-                    }
-                    // Check the instance name.
-                    if (Exists(optional_instance)) {
-                      if (!Exists(server.cloud_instance_name) ||
-                          Value(server.cloud_instance_name) != Value(optional_instance)) {
-                        server.cloud_instance_name = Value(optional_instance);
-                        need_to_update_server_info = true;
-                      }
-                    }
-                    // Check the availability group.
-                    if (Exists(optional_av_group)) {
-                      if (!Exists(server.cloud_availability_group) ||
-                          Value(server.cloud_availability_group) != Value(optional_av_group)) {
-                        server.cloud_availability_group = Value(optional_av_group);
-                        need_to_update_server_info = true;
-                      }
-                    }
-                    // Check the time skew.
-                    if (Exists(optional_behind_this_by)) {
-                      const std::chrono::microseconds behind_this_by = Value(optional_behind_this_by);
-                      const auto time_skew_difference = server.behind_this_by - behind_this_by;
-                      if (static_cast<uint64_t>(std::abs(time_skew_difference.count())) >=
-                          kUpdateServerInfoThresholdByTimeSkewDifference) {
-                        server.behind_this_by = behind_this_by;
-                        need_to_update_server_info = true;
-                      }
-                    }
-                    if (need_to_update_server_info) {
-                      fields.servers.Add(server);
-                    }
-
-                    // Update the `DB` if the build information was not stored there yet.
-                    const ImmutableOptional<ClaireBuildInfo> current_claire_build_info = fields.builds[codename];
-                    if (Exists(optional_build) && (!Exists(current_claire_build_info) ||
-                                                   Value(current_claire_build_info).build != Value(optional_build))) {
-                      ClaireBuildInfo build;
-                      build.codename = codename;
-                      build.build = Value(optional_build);
-                      fields.builds.Add(build);
-                    }
-
-                    // Update the `DB` if "codename", "location", or "dependencies" differ.
-                    const ImmutableOptional<ClaireInfo> current_claire_info = fields.claires[codename];
-                    if ([&]() {
-                          if (!Exists(current_claire_info)) {
-                            return true;
-                          } else if (Value(current_claire_info).location != location) {
-                            return true;
-                          } else if (Value(current_claire_info).registered_state != ClaireRegisteredState::Active) {
-                            return true;
-                          } else {
-                            return false;
-                          }
-                        }()) {
-                      ClaireInfo claire;
-                      if (Exists(current_claire_info)) {
-                        // Do not overwrite `build` with `null`.
-                        claire = Value(current_claire_info);
-                      }
-
-                      claire.codename = codename;
-                      claire.service = service;
-                      claire.location = location;
-                      claire.reported_timestamp = now;
-                      claire.url_status_page_direct = location.StatusPageURL();
-                      claire.registered_state = ClaireRegisteredState::Active;
-
-                      fields.claires.Add(claire);
-                    }
-                    return Response("OK\n");
-                  },
-                  std::move(r))
-              .Wait();
-          {
-            std::lock_guard<std::mutex> lock(services_keepalive_cache_mutex_);
-            auto& placeholder = services_keepalive_time_cache_[parsed_status.codename];
-            if (placeholder.count() == 0) {
-              placeholder = now;
-              // Wake up state update thread only if the new codename has appeared in the cache.
-              state_update_thread_force_wakeup_ = true;
-              update_thread_condition_variable_.notify_one();
-            } else {
-              placeholder = now;
+          if (parameters_.keepalives_batch_interval.count() > 0) {
+            std::lock_guard<std::mutex> lock(pending_keepalives_mutex_);
+            if (!destructing_) {
+              pending_keepalives_.push_back(std::move(received));
+              pending_keepalives_condition_variable_.notify_one();
+              return;
             }
           }
+          std::vector<ReceivedKeepalive> keepalives;
+          keepalives.push_back(std::move(received));
+          ApplyKeepalives(keepalives);
         } else {
           r("Inconsistent URL/body parameters.\n", HTTPResponseCode.BadRequest);
         }
@@ -676,12 +871,249 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
         r("Callback error.\n", HTTPResponseCode.BadRequest);
       } catch (const TypeSystemParseJSONException&) {
         r("JSON parse error.\n", HTTPResponseCode.BadRequest);
+      } catch (const serialization::binary::BinaryException&) {
+        r("Binary parse error.\n", HTTPResponseCode.BadRequest);
       } catch (const Exception&) {
         r("Karl registration error.\n", HTTPResponseCode.InternalServerError);
       }
     }
   }
 
+  // Parses the raw JSON of the runtime status of the keepalive, or reuses the result of parsing the previous one
+  // of this codename, if it is the very same JSON. The runtime status that can not be parsed is left empty.
+  Optional<runtime_status_variant_t> ParseRuntimeStatus(const std::string& codename, const std::string& json) {
+    if (json.empty() || json == "null") {
+      return nullptr;
+    }
+    {
+      std::lock_guard<std::mutex> lock(parsed_runtime_statuses_mutex_);
+      const auto cit = parsed_runtime_statuses_.find(codename);
+      if (cit != parsed_runtime_statuses_.end() && cit->second.json == json) {
+        return cit->second.runtime;
+      }
+    }
+    Optional<runtime_status_variant_t> runtime = TryParseJSON<runtime_status_variant_t>(json);
+    if (!Exists(runtime)) {  // Can't parse in Current format. Trying `Minimalistic`.
+      runtime = TryParseJSON<runtime_status_variant_t, JSONFormat::Minimalistic>(json);
+    }
+#ifdef EXTRA_KARL_LOGGING
+    if (!Exists(runtime)) {
+      std::cerr << "Could not parse the runtime status: " << json << '\n';
+    }
+#endif
+    std::lock_guard<std::mutex> lock(parsed_runtime_statuses_mutex_);
+    ParsedRuntimeStatus& parsed = parsed_runtime_statuses_[codename];
+    parsed.json = json;
+    parsed.runtime = runtime;
+    return runtime;
+  }
+
+  static void FillOmittedKeepaliveFields(claire_status_t& keepalive, const claire_status_t& previous) {
+    if (!Exists(keepalive.build)) {
+      keepalive.build = previous.build;
+    }
+    if (!Exists(keepalive.runtime)) {
+      keepalive.runtime = previous.runtime;
+    }
+    if (!Exists(keepalive.cloud_instance_name)) {
+      keepalive.cloud_instance_name = previous.cloud_instance_name;
+    }
+    if (!Exists(keepalive.cloud_availability_group)) {
+      keepalive.cloud_availability_group = previous.cloud_availability_group;
+    }
+    if (keepalive.dependencies.empty()) {
+      keepalive.dependencies = previous.dependencies;
+    }
+  }
+
+  // Waits for the first keepalive of the batch, then for `keepalives_batch_interval` more, and applies them all.
+  void KeepalivesBatchThread() {
+    while (true) {
+      std::vector<ReceivedKeepalive> keepalives;
+      {
+        std::unique_lock<std::mutex> lock(pending_keepalives_mutex_);
+        pending_keepalives_condition_variable_.wait(lock,
+                                                    [this]() { return destructing_ || !pending_keepalives_.empty(); });
+        if (!destructing_) {
+          pending_keepalives_condition_variable_.wait_for(
+              lock, parameters_.keepalives_batch_interval, [this]() { return static_cast<bool>(destructing_); });
+        }
+        keepalives.swap(pending_keepalives_);
+      }
+      if (!keepalives.empty()) {
+        ApplyKeepalives(keepalives);
+      } else if (destructing_) {
+        return;
+      }
+    }
+  }
+
+  // Publishes the keepalives into the stream in one locked section, applies them to the storage in one transaction,
+  // and responds to their requests.
+  void ApplyKeepalives(std::vector<ReceivedKeepalive>& keepalives) {
+    try {
+      {
+        std::lock_guard<std::mutex> lock(latest_keepalive_index_mutex_);
+        WithKeepalivesStream([this, &keepalives](auto& stream) {
+          std::lock_guard<std::mutex> publishing_lock(stream->Impl()->publishing_mutex);
+          auto& publisher = stream->template Publisher<current::locks::MutexLockStatus::AlreadyLocked>();
+          for (auto& received : keepalives) {
+            persisted_keepalive_t record;
+            record.location = received.location;
+            record.keepalive = received.keepalive;
+            received.idx_ts =
+                publisher->template Publish<current::locks::MutexLockStatus::AlreadyLocked>(std::move(record));
+            latest_keepalive_index_plus_one_[received.keepalive.codename] = received.idx_ts.index + 1;
+          }
+        });
+      }
+      if (Exists(summary_stream_)) {
+        std::lock_guard<std::mutex> lock(summaries_mutex_);
+        for (const auto& received : keepalives) {
+          SummarizeKeepalive(received);
+        }
+      }
+      {
+        // Only the entries of these codenames change in the fleet view.
+        std::lock_guard<std::mutex> lock(fleet_view_entries_mutex_);
+        for (const auto& received : keepalives) {
+          FleetViewEntry& entry = fleet_view_entries_[received.keepalive.codename];
+          entry.us = received.idx_ts.us;
+          entry.location = received.location;
+          entry.keepalive = received.keepalive;
+        }
+      }
+
+      auto& notifiable_ref = notifiable_ref_;
+      storage_
+          ->ReadWriteTransaction([&keepalives, &notifiable_ref](MutableFields<storage_t> fields) -> void {
+            for (const auto& received : keepalives) {
+              ApplyKeepaliveToStorage(fields, notifiable_ref, received);
+            }
+          })
+          .Wait();
+
+      {
+        std::lock_guard<std::mutex> lock(services_keepalive_cache_mutex_);
+        for (const auto& received : keepalives) {
+          auto& placeholder = services_keepalive_time_cache_[received.keepalive.codename];
+          if (placeholder.count() == 0) {
+            placeholder = received.now;
+            // Wake up state update thread only if the new codename has appeared in the cache.
+            state_update_thread_force_wakeup_ = true;
+            ++fleet_version_;
+            update_thread_condition_variable_.notify_one();
+          } else {
+            placeholder = received.now;
+          }
+        }
+      }
+    } catch (const Exception&) {
+      for (auto& received : keepalives) {
+        received.request("Karl registration error.\n", HTTPResponseCode.InternalServerError);
+      }
+      return;
+    }
+    for (auto& received : keepalives) {
+      received.request("OK\n");
+    }
+  }
+
+  static void ApplyKeepaliveToStorage(MutableFields<storage_t> fields,
+                                      IKarlNotifiable<runtime_status_variant_t>& notifiable_ref,
+                                      const ReceivedKeepalive& received) {
+    const auto now = received.now;
+    const auto& location = received.location;
+    const auto& keepalive = received.keepalive;
+    const auto& optional_behind_this_by = received.optional_behind_this_by;
+
+    // OK to call from within a transaction.
+    // The call is fast, and `storage_`'s transaction guarantees thread safety. -- D.K.
+    notifiable_ref.OnKeepalive(now, location, keepalive.codename, keepalive);
+
+    const auto& service = keepalive.service;
+    const auto& codename = keepalive.codename;
+    const auto& optional_build = keepalive.build;
+    const auto& optional_instance = keepalive.cloud_instance_name;
+    const auto& optional_av_group = keepalive.cloud_availability_group;
+
+    // Update per-server information in the `DB`.
+    ServerInfo server;
+    server.ip = location.ip;
+    bool need_to_update_server_info = false;
+    const ImmutableOptional<ServerInfo> current_server_info = fields.servers[location.ip];
+    if (Exists(current_server_info)) {
+      server = Value(current_server_info);
+    }
+    // Check the instance name.
+    if (Exists(optional_instance)) {
+      if (!Exists(server.cloud_instance_name) || Value(server.cloud_instance_name) != Value(optional_instance)) {
+        server.cloud_instance_name = Value(optional_instance);
+        need_to_update_server_info = true;
+      }
+    }
+    // Check the availability group.
+    if (Exists(optional_av_group)) {
+      if (!Exists(server.cloud_availability_group) ||
+          Value(server.cloud_availability_group) != Value(optional_av_group)) {
+        server.cloud_availability_group = Value(optional_av_group);
+        need_to_update_server_info = true;
+      }
+    }
+    // Check the time skew.
+    if (Exists(optional_behind_this_by)) {
+      const std::chrono::microseconds behind_this_by = Value(optional_behind_this_by);
+      const auto time_skew_difference = server.behind_this_by - behind_this_by;
+      if (static_cast<uint64_t>(std::abs(time_skew_difference.count())) >=
+          kUpdateServerInfoThresholdByTimeSkewDifference) {
+        server.behind_this_by = behind_this_by;
+        need_to_update_server_info = true;
+      }
+    }
+    if (need_to_update_server_info) {
+      fields.servers.Add(server);
+    }
+
+    // Update the `DB` if the build information was not stored there yet.
+    const ImmutableOptional<ClaireBuildInfo> current_claire_build_info = fields.builds[codename];
+    if (Exists(optional_build) &&
+        (!Exists(current_claire_build_info) || Value(current_claire_build_info).build != Value(optional_build))) {
+      ClaireBuildInfo build;
+      build.codename = codename;
+      build.build = Value(optional_build);
+      fields.builds.Add(build);
+    }
+
+    // Update the `DB` if "codename", "location", or "dependencies" differ.
+    const ImmutableOptional<ClaireInfo> current_claire_info = fields.claires[codename];
+    if ([&]() {
+          if (!Exists(current_claire_info)) {
+            return true;
+          } else if (Value(current_claire_info).location != location) {
+            return true;
+          } else if (Value(current_claire_info).registered_state != ClaireRegisteredState::Active) {
+            return true;
+          } else {
+            return false;
+          }
+        }()) {
+      ClaireInfo claire;
+      if (Exists(current_claire_info)) {
+        // Do not overwrite `build` with `null`.
+        claire = Value(current_claire_info);
+      }
+
+      claire.codename = codename;
+      claire.service = service;
+      claire.location = location;
+      claire.reported_timestamp = now;
+      claire.url_status_page_direct = location.StatusPageURL();
+      claire.registered_state = ClaireRegisteredState::Active;
+
+      fields.claires.Add(claire);
+    }
+  }
+
   void ServeFleetStatus(Request r) {
     const auto& qs = r.url.query;
     if (qs.has("schema")) {
@@ -738,43 +1170,98 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
       return std::ref(latest_keepalive_index_plus_one_[codename]);
     }();
 
-    const auto& keepalives_data = keepalives_stream_->Data();
+    WithKeepalivesStream([&](const auto& stream) {
+      const auto& keepalives_data = stream->Data();
+      const uint64_t first_index = FirstAvailableKeepaliveIndex(*keepalives_data);
 
-    uint64_t index = index_placeholder;
-    if (!index) {
-      // If no latest keepalive index in cache, go through the whole log.
-      for (const auto& e : keepalives_data->Iterate()) {
-        if (e.entry.keepalive.codename == codename) {
-          index = e.idx_ts.index + 1;
+      uint64_t index = index_placeholder;
+      if (!index) {
+        // If no latest keepalive index in cache, go through the whole log, as much of it as is retained.
+        for (const auto& e : keepalives_data->Iterate(first_index)) {
+          if (e.entry.keepalive.codename == codename) {
+            index = e.idx_ts.index + 1;
+          }
+        }
+        if (index) {
+          std::lock_guard<std::mutex> lock(latest_keepalive_index_mutex_);
+          index_placeholder = std::max(index_placeholder, index);
         }
       }
-      if (index) {
-        std::lock_guard<std::mutex> lock(latest_keepalive_index_mutex_);
-        index_placeholder = std::max(index_placeholder, index);
-      }
-    }
 
-    if (index) {
-      const auto e = *(keepalives_data->Iterate(index - 1).begin());
-      if (!r.url.query.has("nobuild")) {
-        r(JSON<JSONFormat::Minimalistic>(
-              SnapshotOfKeepalive<runtime_status_variant_t>(e.idx_ts.us - current::time::Now(), e.entry.keepalive)),
-          HTTPResponseCode.OK,
-          current::net::http::Headers(),
-          current::net::constants::kDefaultJSONContentType);
+      if (index && index - 1 >= first_index) {
+        const auto e = *(keepalives_data->Iterate(index - 1).begin());
+        if (!r.url.query.has("nobuild")) {
+          r(JSON<JSONFormat::Minimalistic>(
+                SnapshotOfKeepalive<runtime_status_variant_t>(e.idx_ts.us - current::time::Now(), e.entry.keepalive)),
+            HTTPResponseCode.OK,
+            current::net::http::Headers(),
+            current::net::constants::kDefaultJSONContentType);
+        } else {
+          auto tmp = e.entry.keepalive;
+          tmp.build = nullptr;
+          r(JSON<JSONFormat::Minimalistic>(
+                SnapshotOfKeepalive<runtime_status_variant_t>(e.idx_ts.us - current::time::Now(), tmp)),
+            HTTPResponseCode.OK,
+            current::net::http::Headers(),
+            current::net::constants::kDefaultJSONContentType);
+        }
+      } else if (index) {
+        r(current_service_state::Error("The keepalives from '" + codename + "' are beyond retention."),
+          HTTPResponseCode.NotFound);
       } else {
-        auto tmp = e.entry.keepalive;
-        tmp.build = nullptr;
-        r(JSON<JSONFormat::Minimalistic>(
-              SnapshotOfKeepalive<runtime_status_variant_t>(e.idx_ts.us - current::time::Now(), tmp)),
-          HTTPResponseCode.OK,
-          current::net::http::Headers(),
-          current::net::constants::kDefaultJSONContentType);
+        r(current_service_state::Error("No keepalives from '" + codename + "' have been received."),
+          HTTPResponseCode.NotFound);
+      }
+    });
+  }
+
+  void ServeHistory(Request r) {
+    if (!Exists(summary_stream_)) {
+      r(current_service_state::Error("The keepalives are not summarized."), HTTPResponseCode.NotFound);
+      return;
+    }
+    const auto& qs = r.url.query;
+    const auto now = current::time::Now();
+    KarlFleetHistory history;
+    // The last day by default.
+    history.from = qs.has("from") ? current::FromString<std::chrono::microseconds>(qs["from"])
+                                  : now - std::chrono::microseconds(static_cast<int64_t>(1e6 * 60 * 60 * 24));
+    history.to = qs.has("to") ? current::FromString<std::chrono::microseconds>(qs["to"]) : now;
+
+    // The summaries of the same service and interval, persisted before and after a restart, are merged.
+    std::map<std::pair<std::chrono::microseconds, std::string>, KarlServiceSummary> merged;
+    const auto unite = [](std::vector<std::string>& into, const std::vector<std::string>& values) {
+      std::set<std::string> united(into.begin(), into.end());
+      united.insert(values.begin(), values.end());
+      into.assign(united.begin(), united.end());
+    };
+    const auto merge = [&](const KarlServiceSummary& summary) {
+      if (summary.from >= history.from && summary.from < history.to &&
+          (!qs.has("service") || summary.service == qs["service"])) {
+        KarlServiceSummary& placeholder = merged[std::make_pair(summary.from, summary.service)];
+        if (!placeholder.keepalives) {
+          placeholder = summary;
+        } else {
+          placeholder.keepalives += summary.keepalives;
+          unite(placeholder.codenames, summary.codenames);
+          unite(placeholder.git_commits, summary.git_commits);
+        }
+      }
+    };
+    {
+      std::lock_guard<std::mutex> lock(summaries_mutex_);
+      // The summaries are persisted once their intervals have ended, so none of them is older than its timestamp.
+      for (const auto& e : Value(summary_stream_)->Data()->Iterate(history.from)) {
+        merge(e.entry);
+      }
+      for (const auto& pending : pending_summaries_) {
+        merge(PendingSummary(pending.first, pending.second));
       }
-    } else {
-      r(current_service_state::Error("No keepalives from '" + codename + "' have been received."),
-        HTTPResponseCode.NotFound);
     }
+    for (auto& summary : merged) {
+      history.summaries.push_back(std::move(summary.second));
+    }
+    r(history);
   }
 
   void BuildStatusAndRespondWithIt(Request r) {
@@ -810,6 +1297,46 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
       return now;
     }();
 
+    // To list only the services that are currently in `Active` state.
+    const bool active_only = r.url.query.has("active_only");
+
+    const auto response_format = [&r]() -> FleetViewResponseFormat {
+      if (r.url.query.has("full")) {
+        return FleetViewResponseFormat::JSONFull;
+      }
+      if (r.url.query.has("json")) {
+        return FleetViewResponseFormat::JSONMinimalistic;
+      }
+      if (r.url.query.has("html")) {
+        return FleetViewResponseFormat::HTMLFormat;
+      }
+      const char* kAcceptHeader = "Accept";
+      if (r.headers.Has(kAcceptHeader)) {
+        for (const auto& h : strings::Split(r.headers[kAcceptHeader].value, ',')) {
+          if (strings::Split(h, ';').front() == "text/html") {  // Allow "text/html; charset=...", etc.
+            return FleetViewResponseFormat::HTMLFormat;
+          }
+        }
+      }
+      return FleetViewResponseFormat::JSONMinimalistic;
+    }();
+
+    // Only the views of the default, "the last five minutes", window are cached.
+    const auto& qs = r.url.query;
+    const bool cacheable = parameters_.fleet_view_cache_interval.count() > 0 && !qs.has("from") && !qs.has("m") &&
+                           !qs.has("h") && !qs.has("d") && !qs.has("to") && !qs.has("interval_us");
+    const uint64_t fleet_version = fleet_version_;
+    const auto cache_key = std::make_pair(response_format, active_only);
+    if (cacheable) {
+      std::lock_guard<std::mutex> lock(cached_fleet_views_mutex_);
+      const auto cit = cached_fleet_views_.find(cache_key);
+      if (cit != cached_fleet_views_.end() && cit->second.fleet_version == fleet_version &&
+          now - cit->second.rendered_at < parameters_.fleet_view_cache_interval) {
+        r(Response(cit->second.response));
+        return;
+      }
+    }
+
     // Codenames to resolve to `ClaireServiceKey`-s later, in a `ReadOnlyTransaction`.
     std::unordered_set<std::string> codenames_to_resolve;
 
@@ -823,62 +1350,61 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
     std::map<std::string, std::set<std::string>> codenames_per_service;
     std::map<ClaireServiceKey, std::string> service_key_into_codename;
 
-    CURRENT_ASSERT(to >= from);
-    const auto& keepalives_data(keepalives_stream_->Data());
-    for (const auto& e : keepalives_data->Iterate(from, to)) {
-      const claire_status_t& keepalive = e.entry.keepalive;
-
+    // Called for the keepalives in the order of their timestamps, the later ones overriding the earlier ones.
+    const auto add_keepalive = [&](std::chrono::microseconds us,
+                                   const ClaireServiceKey& location,
+                                   const claire_status_t& keepalive) {
       codenames_to_resolve.insert(keepalive.codename);
-      service_key_into_codename[e.entry.location] = keepalive.codename;
+      service_key_into_codename[location] = keepalive.codename;
 
       codenames_per_service[keepalive.service].insert(keepalive.codename);
       // DIMA: More per-codename reporting fields go here; tailored to specific type, `.Call(populator)`, etc.
       ProtoReport report;
-      const std::string last_keepalive =
-          current::strings::TimeIntervalAsHumanReadableString(now - e.idx_ts.us) + " ago";
-      if ((now - e.idx_ts.us) < parameters_.service_timeout_interval) {
+      const std::string last_keepalive = current::strings::TimeIntervalAsHumanReadableString(now - us) + " ago";
+      if ((now - us) < parameters_.service_timeout_interval) {
         // Service is up.
-        const auto projected_uptime_us =
-            (keepalive.now - keepalive.start_time_epoch_microseconds) + (now - e.idx_ts.us);
+        const auto projected_uptime_us = (keepalive.now - keepalive.start_time_epoch_microseconds) + (now - us);
         report.currently =
             current_service_state::up(keepalive.start_time_epoch_microseconds,
                                       last_keepalive,
-                                      e.idx_ts.us,
+                                      us,
                                       current::strings::TimeIntervalAsHumanReadableString(projected_uptime_us));
       } else {
         // Service is down.
         // TODO(dkorolev): Graceful shutdown case for `done`.
         report.currently = current_service_state::down(
-            keepalive.start_time_epoch_microseconds, last_keepalive, e.idx_ts.us, keepalive.uptime);
+            keepalive.start_time_epoch_microseconds, last_keepalive, us, keepalive.uptime);
       }
       report.dependencies = keepalive.dependencies;
       report.runtime = keepalive.runtime;
       report_for_codename[keepalive.codename] = report;
-    }
-
-    // To list only the services that are currently in `Active` state.
-    const bool active_only = r.url.query.has("active_only");
+    };
 
-    const auto response_format = [&r]() -> FleetViewResponseFormat {
-      if (r.url.query.has("full")) {
-        return FleetViewResponseFormat::JSONFull;
+    CURRENT_ASSERT(to >= from);
+    if (!qs.has("to") && !qs.has("interval_us") && from >= fleet_view_complete_since_) {
+      // The window ends now, and begins after Karl has started, so the most recent keepalive of each codename
+      // is in `fleet_view_entries_`, and the stream need not be walked.
+      std::lock_guard<std::mutex> lock(fleet_view_entries_mutex_);
+      std::vector<const FleetViewEntry*> entries;
+      entries.reserve(fleet_view_entries_.size());
+      for (const auto& e : fleet_view_entries_) {
+        if (e.second.us >= from && e.second.us < to) {
+          entries.push_back(&e.second);
+        }
       }
-      if (r.url.query.has("json")) {
-        return FleetViewResponseFormat::JSONMinimalistic;
+      std::sort(entries.begin(), entries.end(), [](const FleetViewEntry* lhs, const FleetViewEntry* rhs) {
+        return lhs->us < rhs->us;
+      });
+      for (const FleetViewEntry* e : entries) {
+        add_keepalive(e->us, e->location, e->keepalive);
       }
-      if (r.url.query.has("html")) {
-        return FleetViewResponseFormat::HTMLFormat;
-      }
-      const char* kAcceptHeader = "Accept";
-      if (r.headers.Has(kAcceptHeader)) {
-        for (const auto& h : strings::Split(r.headers[kAcceptHeader].value, ',')) {
-          if (strings::Split(h, ';').front() == "text/html") {  // Allow "text/html; charset=...", etc.
-            return FleetViewResponseFormat::HTMLFormat;
-          }
+    } else {
+      WithKeepalivesStream([&](const auto& stream) {
+        for (const auto& e : stream->Data()->Iterate(from, to)) {
+          add_keepalive(e.idx_ts.us, e.entry.location, e.entry.keepalive);
         }
-      }
-      return FleetViewResponseFormat::JSONMinimalistic;
-    }();
+      });
+    }
 
     const std::string public_url = actual_public_url_;
     storage_
@@ -889,6 +1415,9 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
              to,
              active_only,
              response_format,
+             cacheable,
+             cache_key,
+             fleet_version,
              public_url,
              codenames_to_resolve,
              report_for_codename,
@@ -978,7 +1507,16 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
                 }
               }
               result.generation_time = current::time::Now() - now;
-              return fleet_view_renderer_ref_.RenderResponse(response_format, parameters_, std::move(result));
+              Response response =
+                  fleet_view_renderer_ref_.RenderResponse(response_format, parameters_, std::move(result));
+              if (cacheable) {
+                std::lock_guard<std::mutex> lock(cached_fleet_views_mutex_);
+                CachedFleetView& placeholder = cached_fleet_views_[cache_key];
+                placeholder.rendered_at = now;
+                placeholder.fleet_version = fleet_version;
+                placeholder.response = response;
+              }
+              return response;
             },
             std::move(r))
         .Wait();  // NOTE(dkorolev): Could be `.Detach()`, but staying "safe" within Karl for now.
@@ -999,7 +1537,60 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
   // Plus one to have `0` == "no keepalives", and avoid the corner case of record at index 0 being the one.
   std::unordered_map<std::string, uint64_t> latest_keepalive_index_plus_one_;
 
-  current::Owned<stream_t> keepalives_stream_;
+  // codename -> the most recent keepalive from this codename, updated as the keepalives arrive, to build the fleet
+  // view from without walking the stream. Has all the keepalives received since `fleet_view_complete_since_`.
+  struct FleetViewEntry {
+    std::chrono::microseconds us;
+    ClaireServiceKey location;
+    claire_status_t keepalive;
+  };
+  const std::chrono::microseconds fleet_view_complete_since_;
+  std::unordered_map<std::string, FleetViewEntry> fleet_view_entries_;
+  std::mutex fleet_view_entries_mutex_;
+
+  // The rendered fleet views, per response format and `active_only`, reused for `fleet_view_cache_interval`,
+  // unless `fleet_version_` changes, as the services appear, deregister, or time out.
+  struct CachedFleetView {
+    std::chrono::microseconds rendered_at;
+    uint64_t fleet_version;
+    Response response;
+  };
+  std::atomic<uint64_t> fleet_version_;
+  std::map<std::pair<FleetViewResponseFormat, bool>, CachedFleetView> cached_fleet_views_;
+  std::mutex cached_fleet_views_mutex_;
+
+  // codename -> the sequence number and the contents of the most recent keepalive, to apply the delta keepalives to.
+  struct DeltaKeepaliveBase {
+    uint64_t seq;
+    claire_status_t keepalive;
+  };
+  std::unordered_map<std::string, DeltaKeepaliveBase> delta_keepalive_bases_;
+  std::mutex delta_keepalive_bases_mutex_;
+
+  // codename -> the raw JSON of the runtime status of the most recent keepalive, and the result of parsing it.
+  struct ParsedRuntimeStatus {
+    std::string json;
+    Optional<runtime_status_variant_t> runtime;
+  };
+  std::unordered_map<std::string, ParsedRuntimeStatus> parsed_runtime_statuses_;
+  std::mutex parsed_runtime_statuses_mutex_;
+
+  // The keepalives received within `keepalives_batch_interval`, to be applied together by `keepalives_batch_thread_`.
+  std::vector<ReceivedKeepalive> pending_keepalives_;
+  std::mutex pending_keepalives_mutex_;
+  std::condition_variable pending_keepalives_condition_variable_;
+  std::thread keepalives_batch_thread_;
+
+  // Exactly one of the two is set: the keepalives are kept either in a single file, or in a directory of segments,
+  // with the segments beyond `stream_retained_segments` dropped or archived.
+  Optional<Owned<stream_t>> keepalives_stream_;
+  Optional<Owned<segmented_stream_t>> segmented_keepalives_stream_;
+
+  // The per-service summaries of the keepalives, persisted into `summary_stream_` as their intervals end.
+  Optional<Owned<summary_stream_t>> summary_stream_;
+  std::chrono::microseconds pending_summaries_from_;  // The beginning of the interval `pending_summaries_` cover.
+  std::map<std::string, PendingServiceSummary> pending_summaries_;
+  mutable std::mutex summaries_mutex_;
   std::atomic_bool state_update_thread_running_;
   std::atomic_bool state_update_thread_force_wakeup_;
   std::condition_variable update_thread_condition_variable_;
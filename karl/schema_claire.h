@@ -87,6 +87,11 @@ CURRENT_ENUM(KeepaliveAttemptStatus, uint8_t) {
 
 // The generic status.
 // Persisted by Karl, except for the `build` part, which is only persisted on the first call, or if changed.
+//
+// The keepalives sent with `&seq=N` can be followed by the delta ones, sent with `&delta&seq=N+1`, and so on.
+// A delta keepalive omits `build`, `runtime`, `cloud_instance_name`, `cloud_availability_group`, and `dependencies`
+// while they are unchanged, and Karl takes them from the previous keepalive of the same codename. If Karl has not
+// received the previous keepalive, it responds with "409 Conflict", and the full keepalive is to be sent.
 CURRENT_STRUCT(ClaireStatus) {
   CURRENT_FIELD(service, std::string);
   CURRENT_FIELD_DESCRIPTION(service, "The name of the service, as christened by its intelligent designer.");
@@ -161,8 +166,8 @@ CURRENT_STRUCT(status) {
 };
 }  // namespace default_user_status
 
-// For now, Karl parses the passed in JSON twice: once as `ClaireStatus` for generic response,
-// and once as `ClaireServiceStatus<T>`, where `T` is a `Variant` containing the client-, service-side blob.
+// Karl parses the passed in JSON as `ClaireStatus` for generic response, and its `runtime` separately, as `T`,
+// which is a `Variant` containing the client-, service-side blob, to make up the `ClaireServiceStatus<T>`.
 // clang-format off
 CURRENT_STRUCT_T_DERIVED(ClaireServiceStatus, ClaireStatus) {
   CURRENT_DEFAULT_CONSTRUCTOR_T(ClaireServiceStatus) {}
@@ -52,6 +52,7 @@ CURRENT_STRUCT(KarlNginxParameters) {
 // Karl's startup parameters.
 constexpr static const char* kDefaultFleetViewURL = "http://localhost:%d";  // Defaults to the nginx port.
 constexpr static std::chrono::microseconds k45Seconds = std::chrono::microseconds(1000ll * 1000ll * 45);
+constexpr static std::chrono::microseconds k1Minute = std::chrono::microseconds(1000ll * 1000ll * 60);
 CURRENT_STRUCT(KarlParameters) {
   CURRENT_FIELD(keepalives_port, uint16_t);
   CURRENT_FIELD_DESCRIPTION(keepalives_port, "The port on which keepalives are listened to.");
@@ -81,6 +82,35 @@ CURRENT_STRUCT(KarlParameters) {
   CURRENT_FIELD_DESCRIPTION(service_timeout_interval,
                             "The default period of keepalive-free inactivity, after which a service is "
                             "considered down for fleet browsability purposes.");
+  CURRENT_FIELD(keepalives_batch_interval, std::chrono::microseconds, std::chrono::microseconds(0));
+  CURRENT_FIELD_DESCRIPTION(keepalives_batch_interval,
+                            "The period to accumulate the keepalives for, to persist and apply them together. "
+                            "Zero to apply each keepalive as it is received.");
+  CURRENT_FIELD(fleet_view_cache_interval, std::chrono::microseconds, std::chrono::microseconds(0));
+  CURRENT_FIELD_DESCRIPTION(fleet_view_cache_interval,
+                            "The period for which the rendered fleet view is reused, unless services appear or go "
+                            "away. Zero to render each fleet view request anew.");
+  CURRENT_FIELD(stream_segment_bytes, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(stream_segment_bytes,
+                            "If this or `stream_segment_duration` is non-zero, the keepalives are kept in the "
+                            "`stream_persistence_file` directory, in segments of about this many bytes each. "
+                            "Zero for both to keep the keepalives in a single file.");
+  CURRENT_FIELD(stream_segment_duration, std::chrono::microseconds, std::chrono::microseconds(0));
+  CURRENT_FIELD_DESCRIPTION(stream_segment_duration,
+                            "The longest period of time a segment of keepalives spans. Zero for no time bound.");
+  CURRENT_FIELD(stream_retained_segments, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(stream_retained_segments,
+                            "The number of sealed segments of keepalives to retain, the older ones are dropped, or "
+                            "moved into `stream_archive_directory`. Zero to retain all the segments.");
+  CURRENT_FIELD(stream_archive_directory, std::string, "");
+  CURRENT_FIELD_DESCRIPTION(stream_archive_directory,
+                            "The directory to move the segments of keepalives beyond retention into, if not empty.");
+  CURRENT_FIELD(summary_persistence_file, std::string, "");
+  CURRENT_FIELD_DESCRIPTION(summary_persistence_file,
+                            "The file name to store the per-service summaries of keepalives, which the fleet history "
+                            "is served from. Empty to not summarize the keepalives.");
+  CURRENT_FIELD(summary_interval, std::chrono::microseconds, k1Minute);
+  CURRENT_FIELD_DESCRIPTION(summary_interval, "The period of time each per-service summary of keepalives covers.");
 
   KarlParameters& SetKeepalivesPort(uint16_t port) {
     keepalives_port = port;
@@ -114,6 +144,30 @@ CURRENT_STRUCT(KarlParameters) {
     nginx_parameters = value;
     return *this;
   }
+  KarlParameters& SetKeepalivesBatchInterval(std::chrono::microseconds value) {
+    keepalives_batch_interval = value;
+    return *this;
+  }
+  KarlParameters& SetFleetViewCacheInterval(std::chrono::microseconds value) {
+    fleet_view_cache_interval = value;
+    return *this;
+  }
+  KarlParameters& SetStreamSegmentation(uint64_t segment_bytes,
+                                        std::chrono::microseconds segment_duration = std::chrono::microseconds(0)) {
+    stream_segment_bytes = segment_bytes;
+    stream_segment_duration = segment_duration;
+    return *this;
+  }
+  KarlParameters& SetStreamRetention(uint64_t retained_segments, const std::string& archive_directory = "") {
+    stream_retained_segments = retained_segments;
+    stream_archive_directory = archive_directory;
+    return *this;
+  }
+  KarlParameters& SetSummaryFile(const std::string& value, std::chrono::microseconds interval = k1Minute) {
+    summary_persistence_file = value;
+    summary_interval = interval;
+    return *this;
+  }
 };
 
 // Karl's persisted storage schema.
@@ -190,6 +244,23 @@ CURRENT_STRUCT(ServerInfo) {
                             "The availability group in the cloud as reported by any of the services.");
 };
 
+// Per-service summary of the keepalives received within one `summary_interval`, persisted into its own stream,
+// to serve the fleet history without walking the keepalives themselves.
+CURRENT_STRUCT(KarlServiceSummary) {
+  CURRENT_FIELD(service, std::string);
+  CURRENT_FIELD_DESCRIPTION(service, "The name of the service.");
+  CURRENT_FIELD(from, std::chrono::microseconds);
+  CURRENT_FIELD_DESCRIPTION(from, "Unix epoch microseconds of the beginning of the period this summary covers.");
+  CURRENT_FIELD(to, std::chrono::microseconds);
+  CURRENT_FIELD_DESCRIPTION(to, "Unix epoch microseconds of the end of the period this summary covers.");
+  CURRENT_FIELD(keepalives, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(keepalives, "The number of keepalives received from the service within the period.");
+  CURRENT_FIELD(codenames, std::vector<std::string>);
+  CURRENT_FIELD_DESCRIPTION(codenames, "The codenames of the instances of the service that have sent keepalives.");
+  CURRENT_FIELD(git_commits, std::vector<std::string>);
+  CURRENT_FIELD_DESCRIPTION(git_commits, "The git commits the instances of the service have been built from.");
+};
+
 CURRENT_STORAGE_FIELD_ENTRY(OrderedDictionary, KarlInfo, KarlInfoDictionary);
 CURRENT_STORAGE_FIELD_ENTRY(UnorderedDictionary, ClaireInfo, ClaireInfoDictionary);
 CURRENT_STORAGE_FIELD_ENTRY(UnorderedDictionary, ClaireBuildInfo, BuildInfoDictionary);
@@ -364,6 +435,15 @@ CURRENT_STRUCT(KarlUpStatus) {
   CURRENT_CONSTRUCTOR(KarlUpStatus)(const KarlParameters& parameters) : parameters(parameters) {}
 };
 
+CURRENT_STRUCT(KarlFleetHistory) {
+  CURRENT_FIELD(from, std::chrono::microseconds);
+  CURRENT_FIELD_DESCRIPTION(from, "Unix epoch microseconds of the beginning of the time range this history covers.");
+  CURRENT_FIELD(to, std::chrono::microseconds);
+  CURRENT_FIELD_DESCRIPTION(to, "Unix epoch microseconds of the end of the time range this history covers.");
+  CURRENT_FIELD(summaries, std::vector<KarlServiceSummary>);
+  CURRENT_FIELD_DESCRIPTION(summaries, "The per-service summaries of keepalives, ordered by time, then by service.");
+};
+
 CURRENT_STRUCT_T(SnapshotOfKeepalive) {
   CURRENT_FIELD(age, std::string);
   CURRENT_FIELD_DESCRIPTION(age, "How long ago was this snapshot saved, human-readable.");
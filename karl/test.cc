@@ -562,7 +562,294 @@ TEST(Karl, DisconnectedByTimout) {
   }
 }
 
+TEST(Karl, FleetViewCache) {
+  current::time::ResetToZero();
+
+  auto params = UnittestKarlParameters();
+  params.SetFleetViewCacheInterval(std::chrono::microseconds(60 * 1000 * 1000));
+  const auto stream_file_remover = current::FileSystem::ScopedRmFile(params.stream_persistence_file);
+  const auto storage_file_remover = current::FileSystem::ScopedRmFile(params.storage_persistence_file);
+  const unittest_karl_t karl(params);
+  const current::karl::Locator karl_locator(Printf("http://localhost:%d/", FLAGS_karl_test_keepalives_port));
+
+  // Past the five minutes since Karl has started, for the default fleet view to be built from the keepalives cached.
+  current::time::SetNow(std::chrono::microseconds(600 * 1000 * 1000), std::chrono::microseconds(601 * 1000 * 1000));
+
+  const auto send_keepalive = [&karl_locator](const std::string& codename) {
+    current::karl::ClaireStatus claire;
+    claire.service = "unittest";
+    claire.codename = codename;
+    claire.local_port = 8888;
+    const std::string keepalive_url = Printf(
+        "%s?codename=%s&port=%d", karl_locator.address_port_route.c_str(), claire.codename.c_str(), claire.local_port);
+    EXPECT_EQ(200, static_cast<int>(HTTP(POST(keepalive_url, claire)).code));
+  };
+  const std::string fleet_view_url = Printf("http://localhost:%d?full", FLAGS_karl_test_fleet_view_port);
+
+  send_keepalive("ABCDEF");
+  while (karl.ActiveServicesCount() != 1u) {
+    std::this_thread::yield();
+  }
+  const std::string first_view = HTTP(GET(fleet_view_url)).body;
+  {
+    const auto status = ParseJSON<unittest_karl_status_t>(first_view);
+    ASSERT_TRUE(status.machines.count("127.0.0.1")) << first_view;
+    EXPECT_EQ(1u, status.machines.at("127.0.0.1").services.size());
+    EXPECT_TRUE(status.machines.at("127.0.0.1").services.count("ABCDEF"));
+  }
+
+  // Another keepalive from the same service keeps the rendered view, while the new fleet view window is not cached.
+  send_keepalive("ABCDEF");
+  EXPECT_EQ(first_view, HTTP(GET(fleet_view_url)).body);
+  EXPECT_NE(first_view, HTTP(GET(fleet_view_url + "&m=5")).body);
+
+  // A new service invalidates the rendered view.
+  send_keepalive("GHIJKL");
+  while (karl.ActiveServicesCount() != 2u) {
+    std::this_thread::yield();
+  }
+  {
+    const std::string second_view = HTTP(GET(fleet_view_url)).body;
+    const auto status = ParseJSON<unittest_karl_status_t>(second_view);
+    ASSERT_TRUE(status.machines.count("127.0.0.1")) << second_view;
+    EXPECT_EQ(2u, status.machines.at("127.0.0.1").services.size());
+  }
+}
+
+TEST(Karl, BatchedAndBinaryKeepalives) {
+  current::time::ResetToZero();
+
+  auto params = UnittestKarlParameters();
+  params.SetKeepalivesBatchInterval(std::chrono::milliseconds(50));
+  const auto stream_file_remover = current::FileSystem::ScopedRmFile(params.stream_persistence_file);
+  const auto storage_file_remover = current::FileSystem::ScopedRmFile(params.storage_persistence_file);
+  const unittest_karl_t karl(params);
+  const current::karl::Locator karl_locator(Printf("http://localhost:%d/", FLAGS_karl_test_keepalives_port));
+
+  const auto keepalive_url = [&karl_locator](const current::karl::ClaireStatus& claire) {
+    return Printf(
+        "%s?codename=%s&port=%d", karl_locator.address_port_route.c_str(), claire.codename.c_str(), claire.local_port);
+  };
+
+  // The keepalives sent together are applied together, and each is responded to once it has been applied.
+  {
+    std::atomic_int responded_ok(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; ++i) {
+      threads.emplace_back([&keepalive_url, &responded_ok, i]() {
+        current::karl::ClaireStatus claire;
+        claire.service = "unittest";
+        claire.codename = std::string("BATCH") + static_cast<char>('A' + i);
+        claire.local_port = static_cast<uint16_t>(8888 + i);
+        if (static_cast<int>(HTTP(POST(keepalive_url(claire), claire)).code) == 200) {
+          ++responded_ok;
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    EXPECT_EQ(3, responded_ok);
+    EXPECT_EQ(3u, karl.ActiveServicesCount());
+  }
+
+  // The keepalives can be sent in the binary format.
+  {
+    unittest_karl_t::claire_status_t claire;
+    claire.service = "unittest";
+    claire.codename = "BINARY";
+    claire.local_port = 9999;
+    EXPECT_EQ(200,
+              static_cast<int>(
+                  HTTP(POST(keepalive_url(claire) + "&binary", SaveIntoBinary(claire), "application/octet-stream"))
+                      .code));
+    EXPECT_EQ(400,
+              static_cast<int>(
+                  HTTP(POST(keepalive_url(claire) + "&binary", std::string("nope"), "application/octet-stream")).code));
+    EXPECT_EQ(4u, karl.ActiveServicesCount());
+  }
+
+  // Including by Claire.
+  current::karl::GenericClaire<unittest_karl_t::runtime_status_variant_t> claire(
+      karl_locator, "unittest", FLAGS_karl_generator_test_port);
+  claire.SendBinaryKeepalives();
+  claire.Register();
+  claire.ForceSendKeepalive(current::karl::ForceSendKeepaliveWaitRequest::Wait);
+  while (karl.ActiveServicesCount() != 5u) {
+    std::this_thread::yield();
+  }
+
+  const auto result =
+      karl.BorrowStorage()
+          ->ReadOnlyTransaction([&](ImmutableFields<unittest_karl_t::storage_t> fields) {
+            for (const std::string codename : {"BATCHA", "BATCHB", "BATCHC", "BINARY", claire.Codename().c_str()}) {
+              ASSERT_TRUE(Exists(fields.claires[codename])) << codename;
+              EXPECT_EQ(current::karl::ClaireRegisteredState::Active, Value(fields.claires[codename]).registered_state);
+            }
+          })
+          .Go();
+  EXPECT_TRUE(WasCommitted(result));
+}
+
+TEST(Karl, SplitOffKeepaliveRuntime) {
+  using current::karl::impl::SplitOffKeepaliveRuntime;
+  std::string envelope;
+  std::string runtime;
+
+  ASSERT_TRUE(SplitOffKeepaliveRuntime(
+      "{\"codename\":\"A\",\"runtime\":{\"X\":{\"s\":\"}{\\\"]\"}},\"deps\":[1,{\"c\":[]}]}", envelope, runtime));
+  EXPECT_EQ("{\"codename\":\"A\",\"deps\":[1,{\"c\":[]}]}", envelope);
+  EXPECT_EQ("{\"X\":{\"s\":\"}{\\\"]\"}}", runtime);
+
+  ASSERT_TRUE(SplitOffKeepaliveRuntime(" { \"runtime\" : null , \"local_port\" : 42 } ", envelope, runtime));
+  EXPECT_EQ("{\"local_port\" : 42}", envelope);
+  EXPECT_EQ("null", runtime);
+
+  ASSERT_TRUE(SplitOffKeepaliveRuntime("{\"codename\":\"B\"}", envelope, runtime));
+  EXPECT_EQ("{\"codename\":\"B\"}", envelope);
+  EXPECT_EQ("", runtime);
+
+  ASSERT_TRUE(SplitOffKeepaliveRuntime("{}", envelope, runtime));
+  EXPECT_EQ("{}", envelope);
+
+  // Whatever is not a well-formed JSON object is left for the JSON parser to report.
+  EXPECT_FALSE(SplitOffKeepaliveRuntime("[1]", envelope, runtime));
+  EXPECT_FALSE(SplitOffKeepaliveRuntime("{\"a\":1", envelope, runtime));
+  EXPECT_FALSE(SplitOffKeepaliveRuntime("{\"a\":}", envelope, runtime));
+  EXPECT_FALSE(SplitOffKeepaliveRuntime("{\"a\":1,}", envelope, runtime));
+  EXPECT_FALSE(SplitOffKeepaliveRuntime("{\"a\":\"unterminated}", envelope, runtime));
+}
+
+TEST(Karl, DeltaKeepalives) {
+  current::time::ResetToZero();
+
+  // Collects the build info of the keepalives, as Karl sees them.
+  struct BuildsCollector : current::karl::DummyKarlNotifiable<unittest_karl_t::runtime_status_variant_t> {
+    std::mutex mutex;
+    std::vector<std::string> builds;
+    void OnKeepalive(std::chrono::microseconds,
+                     const current::karl::ClaireServiceKey&,
+                     const std::string&,
+                     const claire_status_t& keepalive) override {
+      std::lock_guard<std::mutex> lock(mutex);
+      builds.push_back(Exists(keepalive.build) ? JSON(Value(keepalive.build).git_commit_hash) : "NO BUILD");
+    }
+  };
+  BuildsCollector collector;
+
+  const auto params = UnittestKarlParameters();
+  const auto stream_file_remover = current::FileSystem::ScopedRmFile(params.stream_persistence_file);
+  const auto storage_file_remover = current::FileSystem::ScopedRmFile(params.storage_persistence_file);
+  const unittest_karl_t karl(params, collector);
+  const current::karl::Locator karl_locator(Printf("http://localhost:%d/", FLAGS_karl_test_keepalives_port));
+
+  {
+    current::karl::ClaireStatus claire;
+    claire.service = "unittest";
+    claire.codename = "DELTAS";
+    claire.local_port = 8888;
+    const std::string keepalive_url = Printf(
+        "%s?codename=%s&port=%d", karl_locator.address_port_route.c_str(), claire.codename.c_str(), claire.local_port);
+
+    // The delta keepalive is rejected unless it follows the previous keepalive of the same codename.
+    EXPECT_EQ(409, static_cast<int>(HTTP(POST(keepalive_url + "&delta&seq=1", claire)).code));
+
+    claire.build = current::build::BuildInfo();
+    Value(claire.build).git_commit_hash = std::string("deadbeef");
+    EXPECT_EQ(200, static_cast<int>(HTTP(POST(keepalive_url + "&seq=1", claire)).code));
+
+    // The omitted fields of the delta keepalive are taken from the previous keepalive.
+    claire.build = nullptr;
+    EXPECT_EQ(200, static_cast<int>(HTTP(POST(keepalive_url + "&delta&seq=2", claire)).code));
+    EXPECT_EQ(409, static_cast<int>(HTTP(POST(keepalive_url + "&delta&seq=4", claire)).code));
+    EXPECT_EQ(200, static_cast<int>(HTTP(POST(keepalive_url + "&delta&seq=3", claire)).code));
+
+    std::lock_guard<std::mutex> lock(collector.mutex);
+    EXPECT_EQ("\"deadbeef\",\"deadbeef\",\"deadbeef\"", current::strings::Join(collector.builds, ','));
+    collector.builds.clear();
+  }
+
+  // Claire sends the delta keepalives once the full one has been accepted.
+  current::karl::GenericClaire<unittest_karl_t::runtime_status_variant_t> claire(
+      karl_locator, "unittest", FLAGS_karl_generator_test_port);
+  claire.SendDeltaKeepalives();
+  claire.Register();
+  for (int i = 0; i < 3; ++i) {
+    claire.ForceSendKeepalive(current::karl::ForceSendKeepaliveWaitRequest::Wait);
+  }
+  while (karl.ActiveServicesCount() != 2u) {
+    std::this_thread::yield();
+  }
+  {
+    std::lock_guard<std::mutex> lock(collector.mutex);
+    ASSERT_LE(3u, collector.builds.size());
+    for (const auto& build : collector.builds) {
+      EXPECT_NE("NO BUILD", build);
+    }
+  }
+}
+
 #ifndef CURRENT_CI
+TEST(Karl, StreamRetentionAndHistory) {
+  current::time::ResetToZero();
+
+  auto params = UnittestKarlParameters();
+  // One keepalive per segment, the two most recent sealed segments retained.
+  params.SetStreamFile(params.stream_persistence_file + "_segments").SetStreamSegmentation(1u).SetStreamRetention(2u);
+  params.SetSummaryFile(params.stream_persistence_file + "_summary");
+  const auto stream_dir_remover = current::FileSystem::ScopedRmDir(params.stream_persistence_file);
+  const auto summary_file_remover = current::FileSystem::ScopedRmFile(params.summary_persistence_file);
+  const auto storage_file_remover = current::FileSystem::ScopedRmFile(params.storage_persistence_file);
+  const unittest_karl_t karl(params);
+  const current::karl::Locator karl_locator(Printf("http://localhost:%d/", FLAGS_karl_test_keepalives_port));
+
+  const auto send_keepalive = [&karl_locator](const std::string& service, const std::string& codename) {
+    current::karl::ClaireStatus claire;
+    claire.service = service;
+    claire.codename = codename;
+    claire.local_port = 8888;
+    const std::string keepalive_url = Printf(
+        "%s?codename=%s&port=%d", karl_locator.address_port_route.c_str(), claire.codename.c_str(), claire.local_port);
+    EXPECT_EQ(200, static_cast<int>(HTTP(POST(keepalive_url, claire)).code));
+  };
+
+  current::time::SetNow(std::chrono::microseconds(600 * 1000 * 1000), std::chrono::microseconds(601 * 1000 * 1000));
+  send_keepalive("other", "CCCCCC");
+  send_keepalive("unittest", "AAAAAA");
+  send_keepalive("unittest", "BBBBBB");
+  current::time::SetNow(std::chrono::microseconds(660 * 1000 * 1000), std::chrono::microseconds(661 * 1000 * 1000));
+  send_keepalive("unittest", "AAAAAA");
+  send_keepalive("unittest", "AAAAAA");
+
+  // The very first keepalive is beyond retention, while the most recent ones are still served.
+  const std::string snapshot_url = Printf("http://localhost:%d/snapshot/", FLAGS_karl_test_fleet_view_port);
+  EXPECT_EQ(404, static_cast<int>(HTTP(GET(snapshot_url + "CCCCCC")).code));
+  EXPECT_EQ(200, static_cast<int>(HTTP(GET(snapshot_url + "AAAAAA")).code));
+
+  // The history is served from the per-minute summaries, including those of the minute still in progress.
+  const std::string history_url = Printf("http://localhost:%d/history?from=0", FLAGS_karl_test_fleet_view_port);
+  {
+    const auto history = ParseJSON<current::karl::KarlFleetHistory>(HTTP(GET(history_url)).body);
+    ASSERT_EQ(3u, history.summaries.size());
+    EXPECT_EQ("other", history.summaries[0].service);
+    EXPECT_EQ(600ll * 1000 * 1000, history.summaries[0].from.count());
+    EXPECT_EQ(1u, history.summaries[0].keepalives);
+    EXPECT_EQ("unittest", history.summaries[1].service);
+    EXPECT_EQ(600ll * 1000 * 1000, history.summaries[1].from.count());
+    EXPECT_EQ(2u, history.summaries[1].keepalives);
+    EXPECT_EQ("AAAAAA,BBBBBB", current::strings::Join(history.summaries[1].codenames, ','));
+    EXPECT_EQ("unittest", history.summaries[2].service);
+    EXPECT_EQ(660ll * 1000 * 1000, history.summaries[2].from.count());
+    EXPECT_EQ(2u, history.summaries[2].keepalives);
+    EXPECT_EQ("AAAAAA", current::strings::Join(history.summaries[2].codenames, ','));
+  }
+  {
+    const auto history = ParseJSON<current::karl::KarlFleetHistory>(HTTP(GET(history_url + "&service=other")).body);
+    ASSERT_EQ(1u, history.summaries.size());
+    EXPECT_EQ("CCCCCC", current::strings::Join(history.summaries[0].codenames, ','));
+  }
+}
+
 TEST(Karl, DisconnectedByTimoutWithNginx) {
   // Run the test only if `karl_nginx_config_file` flag is set.
   if (FLAGS_karl_nginx_config_file.empty()) {
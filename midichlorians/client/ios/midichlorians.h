@@ -45,6 +45,10 @@ SOFTWARE.
 // Can be called from anywhere after `setup` has been called.
 + (void)trackEvent:(NSString *)event source:(NSString *)eventSource properties:(NSDictionary *)eventProperties;
 
+// The events are sent in batches. Sends the buffered ones right away, e.g. before the app is suspended.
+// Losing focus, as reported via `focusEvent`, sends them as well.
++ (void)flush;
+
 @end
 
 #endif  // CURRENT_MAKE_CHECK_MODE
@@ -57,4 +57,8 @@
     [midichlorians_impl emit:iOSGenericEvent(event, eventSource, eventProperties)];
 }
 
++ (void)flush {
+    [midichlorians_impl flush];
+}
+
 @end
@@ -74,6 +74,9 @@ using current::midichlorians::ios::iOSIdentifyEvent;
 // Identifies the user.
 + (void)identify:(NSString*)identifier;
 
+// Sends the buffered events without waiting for the batch to fill up.
++ (void)flush;
+
 @end
 
 #else
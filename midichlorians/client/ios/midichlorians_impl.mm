@@ -34,6 +34,8 @@
 #include <thread>
 #include <mutex>
 #include <queue>
+#include <chrono>
+#include <condition_variable>
 
 #include <sys/xattr.h>
 
@@ -53,6 +55,8 @@
 #import <AdSupport/ASIdentifierManager.h>  // Need to add AdSupport.Framework to the project.
 #endif  // (TARGET_OS_IPHONE > 0)
 
+#include "../../../bricks/util/deflate.h"
+
 namespace current {
 namespace midichlorians {
 namespace ios {
@@ -119,34 +123,41 @@ namespace impl {
                 void SetClientId(const std::string &client_id) { client_id_ = client_id; }
                 const std::string &GetClientId() const { return client_id_; }
                 
-                void OnMessage(const std::string &message) {
+                // Sends the compressed batch of events, one per line, identified by `batch_id`, so that the server
+                // would not log them twice if the request is retried. Returns whether the server has accepted them.
+                bool OnBatch(const std::string &compressed_body, const std::string &batch_id) {
                     @autoreleasepool {
-                        if (!server_url_.empty()) {
-                            CURRENT_NSLOG(@"LogEvent HTTP: `%s`", message.c_str());
-                            
-                            NSMutableURLRequest *req = [NSMutableURLRequest
-                                                        requestWithURL:[NSURL URLWithString:[NSString stringWithUTF8String:server_url_.c_str()]]];
-                            // TODO(dkorolev): Add `cachePolicy:NSURLRequestReloadIgnoringLocalCacheData`. I can't make it compile.
-                            
-                            req.HTTPMethod = @"POST";
-                            req.HTTPBody = [NSData dataWithBytes:message.data() length:message.length()];
-                            [req setValue:@"application/json" forHTTPHeaderField:@"Content-Type"];
-                            
-                            NSHTTPURLResponse *res = nil;
-                            NSError *err = nil;
-                            NSData *url_data = [NSURLConnection sendSynchronousRequest:req returningResponse:&res error:&err];
-                            // TODO(mzhurovich): Switch to `NSURLSession`.
-                            
-                            // TODO(dkorolev): A bit more detailed error handling.
-                            // TODO(dkorolev): If the message queue is persistent, consider keeping unsent entries within it.
-                            static_cast<void>(url_data);
-                            if (!res) {
-                                CURRENT_NSLOG(@"LogEvent HTTP: Fail.");
-                            } else {
-                                CURRENT_NSLOG(@"LogEvent HTTP: OK.");
-                            }
-                        } else {
+                        if (server_url_.empty()) {
                             CURRENT_NSLOG(@"LogEvent HTTP: No `server_url_` set.");
+                            return false;
+                        }
+                        CURRENT_NSLOG(@"LogEvent HTTP: Batch `%s`, %d bytes.",
+                                      batch_id.c_str(),
+                                      static_cast<int>(compressed_body.length()));
+                        
+                        NSMutableURLRequest *req = [NSMutableURLRequest
+                                                    requestWithURL:[NSURL URLWithString:[NSString stringWithUTF8String:server_url_.c_str()]]];
+                        // TODO(dkorolev): Add `cachePolicy:NSURLRequestReloadIgnoringLocalCacheData`. I can't make it compile.
+                        
+                        req.HTTPMethod = @"POST";
+                        req.HTTPBody = [NSData dataWithBytes:compressed_body.data() length:compressed_body.length()];
+                        [req setValue:@"application/json" forHTTPHeaderField:@"Content-Type"];
+                        [req setValue:@"gzip" forHTTPHeaderField:@"Content-Encoding"];
+                        [req setValue:[NSString stringWithUTF8String:batch_id.c_str()]
+                   forHTTPHeaderField:@"X-Midichlorians-Batch-Id"];
+                        
+                        NSHTTPURLResponse *res = nil;
+                        NSError *err = nil;
+                        NSData *url_data = [NSURLConnection sendSynchronousRequest:req returningResponse:&res error:&err];
+                        // TODO(mzhurovich): Switch to `NSURLSession`.
+                        
+                        static_cast<void>(url_data);
+                        if (!res || res.statusCode != 200) {
+                            CURRENT_NSLOG(@"LogEvent HTTP: Fail.");
+                            return false;
+                        } else {
+                            CURRENT_NSLOG(@"LogEvent HTTP: OK.");
+                            return true;
                         }
                     }  // @autoreleasepool
                 }
@@ -158,15 +169,26 @@ namespace impl {
             };
         }
         
-        // A straightforward implementation for wrapping calls from multiple sources into a single thread,
-        // preserving the order.
-        // NOTE: In production, a more advanced implementation should be used,
-        // with more efficient in-memory message queue and with optionally persistent storage of events.
+        // Wraps calls from multiple sources into a single thread, preserving the order, and sends the events
+        // in batches: one per `kMaxBatchEvents` events, `kMaxBatchBytes` bytes, or `kMaxBatchDelay` since
+        // the first event of the batch, whichever comes first, or on `Flush()`. Each batch is compressed once
+        // and retried with the same id, with exponential backoff, up to `kMaxSendAttempts` times.
+        // NOTE: The batches not accepted by the server after all the attempts are dropped.
+        // TODO(dkorolev): Consider keeping them in a persistent storage of events.
         template <class SINGLE_THREADED_IMPL>
-        class SimplestThreadSafeWrapper : public SINGLE_THREADED_IMPL {
+        class BatchingThreadSafeWrapper : public SINGLE_THREADED_IMPL {
         public:
-            SimplestThreadSafeWrapper() : up_(true), thread_(&SimplestThreadSafeWrapper::Thread, this) {}
-            ~SimplestThreadSafeWrapper() {
+            constexpr static size_t kMaxBatchEvents = 100u;
+            constexpr static size_t kMaxBatchBytes = 64u * 1024u;
+            constexpr static std::chrono::seconds kMaxBatchDelay = std::chrono::seconds(10);
+            constexpr static size_t kMaxSendAttempts = 5u;
+            constexpr static std::chrono::milliseconds kInitialRetryDelay = std::chrono::milliseconds(500);
+            
+            BatchingThreadSafeWrapper()
+                : up_(true),
+                  launch_id_(ToStdString([[[NSUUID UUID] UUIDString] UTF8String])),
+                  thread_(&BatchingThreadSafeWrapper::Thread, this) {}
+            ~BatchingThreadSafeWrapper() {
                 {
                     std::unique_lock<std::mutex> lock(mutex_);
                     up_ = false;
@@ -177,44 +199,90 @@ namespace impl {
             void OnMessage(const std::string &message) {
                 {
                     std::unique_lock<std::mutex> lock(mutex_);
-                    queue_.push_back(message);
+                    if (buffer_.empty()) {
+                        first_buffered_ = std::chrono::steady_clock::now();
+                    }
+                    buffer_ += message;
+                    buffer_ += '\n';
+                    ++buffered_events_;
+                    if (buffered_events_ < kMaxBatchEvents && buffer_.length() < kMaxBatchBytes) {
+                        return;
+                    }
+                    flush_requested_ = true;
+                }
+                cv_.notify_all();
+            }
+            // Sends the buffered events without waiting for the batch to fill up, e.g. when the app loses focus.
+            void Flush() {
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    flush_requested_ = true;
                 }
                 cv_.notify_all();
             }
             
         private:
             void Thread() {
-                std::string message;
                 while (true) {
-                    // Mutex-locked section: Retrieve the next message, or wait for one.
+                    std::string body;
+                    bool terminating;
+                    // Mutex-locked section: Wait for the batch to be complete, and take it.
                     {
                         std::unique_lock<std::mutex> lock(mutex_);
-                        if (!up_) {
-                            // Terminating.
-                            return;
-                        }
-                        if (queue_.empty()) {
-                            cv_.wait(lock);
-                            continue;
-                        } else {
-                            message = queue_.front();
-                            queue_.pop_front();
+                        while (up_ && !flush_requested_ &&
+                               (buffer_.empty() || std::chrono::steady_clock::now() < first_buffered_ + kMaxBatchDelay)) {
+                            if (buffer_.empty()) {
+                                cv_.wait(lock);
+                            } else {
+                                cv_.wait_until(lock, first_buffered_ + kMaxBatchDelay);
+                            }
                         }
+                        terminating = !up_;
+                        flush_requested_ = false;
+                        body.swap(buffer_);
+                        buffered_events_ = 0u;
+                    }
+                    // Mutex-free section: Send this batch. The remaining events are sent on termination too.
+                    if (!body.empty()) {
+                        SendBatch(body);
+                    }
+                    if (terminating) {
+                        return;
+                    }
+                }
+            }
+            
+            void SendBatch(const std::string &body) {
+                const std::string compressed_body = current::DeflateCompress(body, current::DeflateFormat::Gzip);
+                const std::string batch_id =
+                    SINGLE_THREADED_IMPL::GetDeviceId() + ':' + launch_id_ + ':' + std::to_string(++batches_);
+                std::chrono::milliseconds retry_delay = kInitialRetryDelay;
+                for (size_t attempt = 1u; !SINGLE_THREADED_IMPL::OnBatch(compressed_body, batch_id); ++attempt) {
+                    if (attempt == kMaxSendAttempts) {
+                        CURRENT_NSLOG(@"LogEvent HTTP: Dropping batch `%s`.", batch_id.c_str());
+                        return;
                     }
-                    // Mutex-free section: Process this message.
-                    SINGLE_THREADED_IMPL::OnMessage(message);
+                    // Back off, unless terminating, in which case the remaining attempts are made right away.
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait_for(lock, retry_delay, [this]() { return !up_; });
+                    retry_delay *= 2;
                 }
             }
             
             std::atomic_bool up_;
-            std::deque<std::string> queue_;
+            const std::string launch_id_;  // Unique per launch, so that the ids of the batches are unique per device.
+            size_t batches_ = 0u;          // Only accessed from the thread.
+            std::string buffer_;           // The events of the current batch, one per line.
+            size_t buffered_events_ = 0u;
+            std::chrono::steady_clock::time_point first_buffered_;
+            bool flush_requested_ = false;
             std::condition_variable cv_;
             std::mutex mutex_;
             std::thread thread_;
         };
         
         template <typename T>
-        using ThreadSafeWrapper = SimplestThreadSafeWrapper<T>;
+        using ThreadSafeWrapper = BatchingThreadSafeWrapper<T>;
         
         using POSTviaHTTP = ThreadSafeWrapper<thread_unsafe::POSTviaHTTP>;
         
@@ -337,6 +405,14 @@ using namespace current::midichlorians::ios::impl;
     Value<iOSBaseEvent>(v).client_id = instance.GetClientId();
     Value<iOSBaseEvent>(v).user_ms = std::chrono::duration_cast<std::chrono::milliseconds>(current::time::Now());
     instance.OnMessage(JSON(v));
+    // The app may not get the CPU back after losing focus, so the events collected so far are sent right away.
+    if (Exists<iOSFocusEvent>(v) && !Value<iOSFocusEvent>(v).gained_focus) {
+        instance.Flush();
+    }
+}
+
++ (void)flush {
+    current::Singleton<Stats>().Flush();
 }
 
 // Identifies the user.
@@ -46,6 +46,9 @@ SOFTWARE.
 
 #include "../../blocks/http/api.h"
 
+#include "../../bricks/net/http/compression.h"
+#include "../../bricks/strings/split.h"
+
 #include "../../bricks/strings/join.h"
 #include "../../bricks/template/rtti_dynamic_call.h"
 
@@ -57,13 +60,17 @@ class Server {
 
   Server(current::net::ReservedLocalPort reserved_port, const std::string& http_route)
       : http_server_(HTTP(std::move(reserved_port))), routes_(http_server_.Register(http_route, [this](Request r) {
-          events_variant_t event;
+          // The client sends the events in gzip-compressed batches, one event per line.
           try {
-            event = ParseJSON<events_variant_t>(r.body);
+            const std::string body = current::net::DecompressHTTPBody(
+                r.body, r.headers.GetOrDefault(current::net::constants::kContentEncodingHeaderKey, ""), 1024 * 1024);
             std::lock_guard<std::mutex> lock(mutex_);
-            event.Call(*this);
+            for (const std::string& line : current::strings::Split<current::strings::ByLines>(body)) {
+              ParseJSON<events_variant_t>(line).Call(*this);
+            }
           } catch (const current::Exception&) {
           }
+          r("OK\n");
         })) {}
 
   void operator()(const iOSAppLaunchEvent& event) {
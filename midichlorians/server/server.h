@@ -30,13 +30,28 @@ SOFTWARE.
 #include "../../typesystem/serialization/json.h"
 
 #include "../../blocks/http/api.h"
+#include "../../blocks/mmq/mmq.h"
+#include "../../bricks/net/http/compression.h"
 #include "../../bricks/strings/strings.h"
+#include "../../bricks/sync/waitable_atomic.h"
 #include "../../bricks/time/chrono.h"
 
+#include <deque>
+#include <unordered_set>
+
 namespace current {
 namespace midichlorians {
 namespace server {
 
+// The requests are parsed in the threads of the HTTP server, with no locks taken, into the batches of log entries,
+// one batch per request. The batches are passed to the `LOG_ENTRY_CONSUMER` through an MMQ, from a single thread,
+// in the order they were parsed in. The only lock taken by a request is to publish its batch into the queue.
+//
+// The clients may send their events in batches, one event per line, with the bodies compressed with gzip or deflate,
+// as `Content-Encoding` says, and retry the batches with the same `X-Midichlorians-Batch-Id` header. The batches
+// with the ids of the `kRecentBatchIds` most recent ones are acknowledged, but not logged again.
+constexpr char kBatchIdHeader[] = "X-Midichlorians-Batch-Id";
+
 template <class LOG_ENTRY_CONSUMER>
 class midichloriansHTTPServer {
  public:
@@ -53,48 +68,90 @@ class midichloriansHTTPServer {
         send_ticks_(tick_interval_us_.count() > 0),
         last_event_t_(0u),
         events_pushed_(0u),
+        dispatcher_(*this),
+        queue_(dispatcher_),
         timer_thread_(&midichloriansHTTPServer::TimerThreadFunction, this),
         routes_(HTTP(http_port_).Register(route_, [this](Request r) { ProcessRequest(std::move(r)); })) {}
 
   ~midichloriansHTTPServer() {
+    routes_ = nullptr;
     send_ticks_ = false;
     timer_thread_.join();
+    // Pass all the published entries to the consumer before the queue is gone.
+    batches_.Wait([](const BatchesCounters& counters) { return counters.dispatched == counters.published; });
   }
 
   void Join() { HTTP(http_port_).Join(); }
 
   size_t EventsPushed() const { return events_pushed_; }
 
+  constexpr static size_t kRecentBatchIds = 100000u;
+  constexpr static size_t kMaxDecompressedBodySize = 16u * 1024u * 1024u;
+
  private:
+  using log_entries_batch_t = std::vector<log_entry_variant_t>;
+
   void ProcessRequest(Request r) {
-    {
-      std::lock_guard<std::mutex> lock(mutex_);
-      if (r.method == "POST" && !r.body.empty()) {
-        // POST request could be either iOS or web event.
-        // In case of iOS there could be a bunch of events in the body.
-        std::istringstream iss(r.body);
-        std::string line;
-        while (std::getline(iss, line)) {
-          if (!ParseBodyLineAsiOSEvent(line)) {
-            if (!ParseRequestAsWebEvent(r)) {
-              LogUnparsableRequest(r);
+    if (IsRetriedBatch(r)) {
+      r(response_text_);
+      return;
+    }
+    log_entries_batch_t batch;
+    std::string decompressed_body;
+    const std::string* body = &r.body;
+    if (r.headers.Has(current::net::constants::kContentEncodingHeaderKey)) {
+      try {
+        decompressed_body = current::net::DecompressHTTPBody(
+            r.body, r.headers.Get(current::net::constants::kContentEncodingHeaderKey), kMaxDecompressedBodySize);
+        body = &decompressed_body;
+      } catch (const DeflateDecompressException&) {
+        body = nullptr;
+      }
+    }
+    if (!body) {
+      LogUnparsableRequest(r, batch);
+    } else if (r.method == "POST" && !body->empty()) {
+      // POST request could be either iOS or web event.
+      // In case of iOS there could be a bunch of events in the body, split into lines in place.
+      current::strings::Split<current::strings::ByLines>(
+          *body, [this, &r, &batch](const current::strings::Chunk& line) {
+            if (!ParseBodyLineAsiOSEvent(line, batch)) {
+              if (!ParseRequestAsWebEvent(r, batch)) {
+                LogUnparsableRequest(r, batch);
+              }
             }
-          }
-        }
-      } else if (r.method == "GET" || r.method == "HEAD") {
-        // GET and HEAD requests could be only web events.
-        if (!ParseRequestAsWebEvent(r)) {
-          LogUnparsableRequest(r);  // LCOV_EXCL_LINE
-        }
-      } else {
-        // Wrong HTTP method or empty body in POST request.
-        LogUnparsableRequest(r);  // LCOV_EXCL_LINE
+          });
+    } else if (r.method == "GET" || r.method == "HEAD") {
+      // GET and HEAD requests could be only web events.
+      if (!ParseRequestAsWebEvent(r, batch)) {
+        LogUnparsableRequest(r, batch);  // LCOV_EXCL_LINE
       }
+    } else {
+      // Wrong HTTP method or empty body in POST request.
+      LogUnparsableRequest(r, batch);  // LCOV_EXCL_LINE
     }
+    PublishBatch(std::move(batch));
     r(response_text_);
   }
 
-  bool ParseBodyLineAsiOSEvent(const std::string& line) {
+  bool IsRetriedBatch(const Request& r) {
+    if (!r.headers.Has(kBatchIdHeader)) {
+      return false;
+    }
+    const std::string& id = r.headers.Get(kBatchIdHeader);
+    std::lock_guard<std::mutex> lock(recent_batch_ids_mutex_);
+    if (!recent_batch_ids_.insert(id).second) {
+      return true;
+    }
+    recent_batch_ids_order_.push_back(id);
+    if (recent_batch_ids_order_.size() > kRecentBatchIds) {
+      recent_batch_ids_.erase(recent_batch_ids_order_.front());
+      recent_batch_ids_order_.pop_front();
+    }
+    return false;
+  }
+
+  bool ParseBodyLineAsiOSEvent(const current::strings::Chunk& line, log_entries_batch_t& batch) {
     using namespace current::midichlorians::ios;
 
     Variant<ios_events_t> ios_event;
@@ -104,11 +161,11 @@ class midichloriansHTTPServer {
       return false;
     }
 
-    PassLogEntryToConsumer(EventLogEntry(current::time::Now(), std::move(ios_event)));
+    batch.emplace_back(EventLogEntry(current::time::Now(), std::move(ios_event)));
     return true;
   }
 
-  bool ParseRequestAsWebEvent(const Request& r) {
+  bool ParseRequestAsWebEvent(const Request& r, log_entries_batch_t& batch) {
     using namespace current::midichlorians::web;
 
     std::map<std::string, std::string> extracted_q;  // Manually extracted query parameters.
@@ -156,7 +213,7 @@ class midichloriansHTTPServer {
       return false;  // LCOV_EXCL_LINE
     }
 
-    PassLogEntryToConsumer(EventLogEntry(current::time::Now(), std::move(web_event)));
+    batch.emplace_back(EventLogEntry(current::time::Now(), std::move(web_event)));
     return true;
   }
 
@@ -188,37 +245,77 @@ class midichloriansHTTPServer {
     return true;
   }
 
-  template <typename LOG_ENTRY>
-  void PassLogEntryToConsumer(LOG_ENTRY&& entry, bool is_valid_entry = true) {
-    log_entry_variant_t entry_variant(std::move(entry));
-    entry_variant.Call(log_entry_consumer_);
-    if (is_valid_entry) {
-      ++events_pushed_;
-      last_event_t_ = Value<LogEntryBase>(entry_variant).server_us;
-    }
+  void LogUnparsableRequest(const Request& r, log_entries_batch_t& batch) {
+    batch.emplace_back(UnparsableLogEntry(current::time::Now(), r));
   }
 
-  void LogUnparsableRequest(const Request& r) {
-    PassLogEntryToConsumer(UnparsableLogEntry(current::time::Now(), r), false);
+  static bool IsValidEntry(const log_entry_variant_t& entry) { return !Exists<UnparsableLogEntry>(entry); }
+
+  // The timestamps of the MMQ should be strictly increasing, so they are assigned under `publish_mutex_`, which is
+  // also what keeps the order of the batches and of the `last_event_t_` updates consistent.
+  void PublishBatch(log_entries_batch_t&& batch) {
+    if (batch.empty()) {
+      return;  // LCOV_EXCL_LINE
+    }
+    std::lock_guard<std::mutex> lock(publish_mutex_);
+    for (const log_entry_variant_t& entry : batch) {
+      if (IsValidEntry(entry)) {
+        last_event_t_ = std::max(last_event_t_, Value<LogEntryBase>(entry).server_us);
+      }
+    }
+    last_published_us_ = std::max(current::time::Now(), last_published_us_ + std::chrono::microseconds(1));
+    batches_.MutableUse([](BatchesCounters& counters) { ++counters.published; });
+    queue_.Publish(std::move(batch), last_published_us_);
   }
 
   void TimerThreadFunction() {
     // TODO(dkorolev): Use "cron" here.
     while (send_ticks_) {
-      std::unique_lock<std::mutex> lock(mutex_);
+      std::unique_lock<std::mutex> lock(publish_mutex_);
       const std::chrono::microseconds now = current::time::Now();
       const std::chrono::microseconds dt = now - last_event_t_;
+      lock.unlock();
       if (dt >= tick_interval_us_) {
-        PassLogEntryToConsumer(TickLogEntry(now));
+        log_entries_batch_t batch;
+        batch.emplace_back(TickLogEntry(now));
+        PublishBatch(std::move(batch));
       } else {
-        lock.unlock();
         std::this_thread::sleep_for(tick_interval_us_ - dt + std::chrono::microseconds(1));
       }
     }
   }
 
+  // Passes the batches of log entries from the queue to the consumer.
+  class BatchesDispatcherImpl {
+   public:
+    explicit BatchesDispatcherImpl(midichloriansHTTPServer& self) : self_(self) {}
+
+    ss::EntryResponse operator()(log_entries_batch_t&& batch, idxts_t, idxts_t) {
+      for (log_entry_variant_t& entry : batch) {
+        entry.Call(self_.log_entry_consumer_);
+        if (IsValidEntry(entry)) {
+          ++self_.events_pushed_;
+        }
+      }
+      self_.batches_.MutableUse([](BatchesCounters& counters) { ++counters.dispatched; });
+      return ss::EntryResponse::More;
+    }
+
+   private:
+    midichloriansHTTPServer& self_;
+  };
+  using dispatcher_t = ss::EntrySubscriber<BatchesDispatcherImpl, log_entries_batch_t>;
+
+  struct BatchesCounters final {
+    size_t published = 0u;
+    size_t dispatched = 0u;
+  };
+
  private:
-  std::mutex mutex_;
+  std::mutex publish_mutex_;
+  std::mutex recent_batch_ids_mutex_;
+  std::unordered_set<std::string> recent_batch_ids_;
+  std::deque<std::string> recent_batch_ids_order_;
   const int http_port_;
   LOG_ENTRY_CONSUMER& log_entry_consumer_;
   const std::string route_;
@@ -226,8 +323,12 @@ class midichloriansHTTPServer {
 
   const std::chrono::microseconds tick_interval_us_;
   std::atomic_bool send_ticks_;
-  std::chrono::microseconds last_event_t_;
+  std::chrono::microseconds last_event_t_;  // Guarded by `publish_mutex_`.
+  std::chrono::microseconds last_published_us_ = std::chrono::microseconds(-1);  // Guarded by `publish_mutex_`.
   std::atomic_size_t events_pushed_;
+  current::WaitableAtomic<BatchesCounters> batches_;
+  dispatcher_t dispatcher_;
+  mmq::MMQ<log_entries_batch_t, dispatcher_t> queue_;
   std::thread timer_thread_;
 
   HTTPRoutesScope routes_;
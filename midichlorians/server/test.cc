@@ -370,4 +370,138 @@ TEST(midichloriansServer, WebEventsFromCPPSmokeTest) {
       Join(consumer.Events(), ','));
 }
 
+TEST(midichloriansServer, ConcurrentBatchedRequests) {
+  current::time::ResetToZero();
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  static_cast<void>(http_server);
+
+  using namespace midichlorians_server_test;
+
+  using namespace current::midichlorians::server;
+  using namespace current::midichlorians::ios;
+
+  // The consumer is called from one thread at a time, and the events of each request are passed to it together.
+  struct SequentialConsumer {
+    std::atomic_bool in_call{false};
+    std::atomic_size_t concurrent_calls{0u};
+    std::map<std::string, size_t> events_per_client;  // Only accessed by the consumer.
+    size_t out_of_order = 0u;
+    size_t errors = 0u;
+
+    void operator()(const TickLogEntry&) {}
+    void operator()(const UnparsableLogEntry&) { ++errors; }
+    void operator()(const EventLogEntry& e) {
+      if (in_call.exchange(true)) {
+        ++concurrent_calls;
+      }
+      const iOSIdentifyEvent& event = Value<iOSIdentifyEvent>(e.event);
+      // The events of a client go in the order of the user timestamps, as each client posts sequentially.
+      if (events_per_client[event.client_id] != static_cast<size_t>(event.user_ms.count())) {
+        ++out_of_order;
+      }
+      ++events_per_client[event.client_id];
+      in_call = false;
+    }
+  };
+
+  const size_t clients = 4u;
+  const size_t requests_per_client = 25u;
+  const size_t events_per_request = 8u;
+
+  SequentialConsumer consumer;
+  {
+    midichloriansHTTPServer<SequentialConsumer> server(port, consumer, std::chrono::microseconds(0), "/log", "OK\n");
+    const std::string server_url = Printf("http://localhost:%d/log", port);
+
+    std::vector<std::thread> threads;
+    for (size_t c = 0u; c < clients; ++c) {
+      threads.emplace_back([&server_url, c, requests_per_client, events_per_request]() {
+        for (size_t r = 0u; r < requests_per_client; ++r) {
+          std::string body;
+          for (size_t e = 0u; e < events_per_request; ++e) {
+            iOSIdentifyEvent event;
+            event.user_ms = std::chrono::milliseconds(r * events_per_request + e);
+            event.client_id = "client" + current::ToString(c);
+            body += JSON(ios_variant_t(std::move(event))) + '\n';
+          }
+          EXPECT_EQ("OK\n", HTTP(POST(server_url, body)).body);
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    // No waiting: the server passes all the published events to the consumer before it is destructed.
+  }
+  size_t events_pushed = 0u;
+  for (const auto& e : consumer.events_per_client) {
+    EXPECT_EQ(requests_per_client * events_per_request, e.second) << e.first;
+    events_pushed += e.second;
+  }
+  EXPECT_EQ(clients * requests_per_client * events_per_request, events_pushed);
+  EXPECT_EQ(clients, consumer.events_per_client.size());
+  EXPECT_EQ(0u, consumer.concurrent_calls);
+  EXPECT_EQ(0u, consumer.out_of_order);
+  EXPECT_EQ(0u, consumer.errors);
+}
+
+TEST(midichloriansServer, CompressedRetriedBatches) {
+  current::time::ResetToZero();
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  static_cast<void>(http_server);
+
+  using namespace midichlorians_server_test;
+
+  using namespace current::midichlorians::server;
+  using namespace current::midichlorians::ios;
+
+  struct CountingConsumer {
+    std::vector<std::string> client_ids;
+    size_t errors = 0u;
+
+    void operator()(const TickLogEntry&) {}
+    void operator()(const UnparsableLogEntry&) { ++errors; }
+    void operator()(const EventLogEntry& e) { client_ids.push_back(Value<iOSIdentifyEvent>(e.event).client_id); }
+  };
+
+  const auto batch_body = [](const std::string& client_id, size_t count) {
+    std::string body;
+    for (size_t i = 0u; i < count; ++i) {
+      iOSIdentifyEvent event;
+      event.client_id = client_id;
+      body += JSON(ios_variant_t(std::move(event))) + '\n';
+    }
+    return body;
+  };
+
+  CountingConsumer consumer;
+  {
+    midichloriansHTTPServer<CountingConsumer> server(port, consumer, std::chrono::microseconds(0), "/log", "OK\n");
+    const std::string server_url = Printf("http://localhost:%d/log", port);
+
+    const std::string gzipped = current::DeflateCompress(batch_body("gzip", 3u), current::DeflateFormat::Gzip);
+    const std::string deflated = current::DeflateCompress(batch_body("deflate", 2u), current::DeflateFormat::Zlib);
+
+    const auto post = [&server_url](const std::string& body, const std::string& encoding, const std::string& id) {
+      return HTTP(POST(server_url, body).SetHeader("Content-Encoding", encoding).SetHeader(kBatchIdHeader, id)).body;
+    };
+    EXPECT_EQ("OK\n", post(gzipped, "gzip", "A"));
+    // A retry of the same batch, e.g. after the response was lost, is acknowledged and not logged again.
+    EXPECT_EQ("OK\n", post(gzipped, "gzip", "A"));
+    EXPECT_EQ("OK\n", post(deflated, "deflate", "B"));
+    // Plain bodies are accepted as before.
+    EXPECT_EQ("OK\n", HTTP(POST(server_url, batch_body("plain", 1u))).body);
+    // A body that is not what `Content-Encoding` says is logged as unparsable.
+    EXPECT_EQ("OK\n", post("not gzip", "gzip", "C"));
+  }
+  EXPECT_EQ("gzip,gzip,gzip,deflate,deflate,plain", current::strings::Join(consumer.client_ids, ','));
+  EXPECT_EQ(1u, consumer.errors);
+}
+
 #endif  // CURRENT_MIDICHLORIANS_CLIENT_SERVER_CC
@@ -32,6 +32,8 @@ SOFTWARE.
 //
 //    Stateless process that tokenizes the query into terms, normalizes each term (`ToLower()`), and performs basic
 //    annotation via simple matching. N-grams and regular expression matches also belong to this phase.
+//    The dictionary entries, including the multi-word ones, are matched in a single left-to-right pass over the query
+//    terms, using the Aho-Corasick automaton built from all the dictionaries of the schema.
 //
 // 2) Annotation.
 //
@@ -44,6 +46,10 @@ SOFTWARE.
 // 3) Matching.
 //
 //    This is the stage where the schema is applied to the marked and annotated query.
+//    To match many schemas against the same query, use a `MatchingChart`, which evaluates each subschema once per
+//    span of query terms, and shares the results within and across the schemas.
+//    To match many queries, use `MatchQueriesBatch()`, which annotates and matches each distinct query once,
+//    on several threads.
 //
 //    The schema consists of blocks. Each block has its own `emitted_t` type, which is the type of object it can yield
 //    while being applied to a [sub]query. I.e. any schema block can be applied to any [sub]query, yielding zero, one
@@ -75,7 +81,17 @@ SOFTWARE.
 #include "../bricks/template/tuple.h"
 #include "../typesystem/struct.h"
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
 
 namespace current {
 namespace nlp {
@@ -88,6 +104,11 @@ CURRENT_STRUCT(AnnotatedQueryTerm) {
 
   CURRENT_FIELD(original_term, std::string);
   CURRENT_FIELD_DESCRIPTION(original_term, "This query term before normalization.");
+
+  CURRENT_FIELD(dictionary_spans, (std::map<std::string, uint32_t>));
+  CURRENT_FIELD_DESCRIPTION(dictionary_spans,
+                            "The number of terms in the multi-word dictionary entries starting from this term, "
+                            "by the name of the dictionary.");
 };
 
 // Template class `AnnotatedQuery` is a central part for all schema evaluations.
@@ -108,6 +129,172 @@ CURRENT_STRUCT(Unit){};
 
 namespace impl {
 
+// The number of terms the dictionary annotation `field_name` of the term spans, one unless it is a multi-word one.
+inline size_t DictionarySpan(const AnnotatedQueryTerm& term, const std::string& field_name) {
+  const auto cit = term.dictionary_spans.find(field_name);
+  return cit != term.dictionary_spans.end() ? cit->second : 1u;
+}
+
+inline void SetDictionarySpan(AnnotatedQueryTerm& term, const std::string& field_name, size_t span) {
+  if (span > 1u) {
+    term.dictionary_spans[field_name] = static_cast<uint32_t>(span);
+  } else {
+    term.dictionary_spans.erase(field_name);
+  }
+}
+
+// The Aho-Corasick automaton over the sequences of terms: matches all the entries, single- and multi-word, in a single
+// left-to-right pass over the query terms. The entries are the nodes, identified by their indexes.
+class TermsAutomaton final {
+ public:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  TermsAutomaton() : nodes_(1u) {}
+
+  // Returns the node of the entry, the sequence of `terms`, to match.
+  size_t Add(const std::vector<std::string>& terms) {
+    size_t node = 0u;
+    for (const std::string& term : terms) {
+      const auto it = nodes_[node].next.find(term);
+      if (it != nodes_[node].next.end()) {
+        node = it->second;
+      } else {
+        const size_t child = nodes_.size();
+        nodes_[node].next[term] = child;
+        nodes_.emplace_back();
+        nodes_.back().depth = nodes_[node].depth + 1u;
+        node = child;
+      }
+    }
+    nodes_[node].is_entry = true;
+    return node;
+  }
+
+  // Builds the failure and the entry links, to be called after the last `Add()`, and before `Scan()`.
+  void Build() {
+    std::queue<size_t> queue;
+    for (const auto& e : nodes_[0u].next) {
+      nodes_[e.second].fail = 0u;
+      nodes_[e.second].entry_link = npos;
+      queue.push(e.second);
+    }
+    while (!queue.empty()) {
+      const size_t node = queue.front();
+      queue.pop();
+      for (const auto& e : nodes_[node].next) {
+        const size_t child = e.second;
+        size_t fail = nodes_[node].fail;
+        while (fail && !nodes_[fail].next.count(e.first)) {
+          fail = nodes_[fail].fail;
+        }
+        const auto it = nodes_[fail].next.find(e.first);
+        nodes_[child].fail = (it != nodes_[fail].next.end()) ? it->second : 0u;
+        const Node& suffix = nodes_[nodes_[child].fail];
+        nodes_[child].entry_link = suffix.is_entry ? nodes_[child].fail : suffix.entry_link;
+        queue.push(child);
+      }
+    }
+  }
+
+  // Calls `f(node, first_term_index)` for each entry matched by the `terms`, the entries ending earlier first.
+  template <typename TERMS, typename F>
+  void Scan(const TERMS& terms, F&& f) const {
+    size_t state = 0u;
+    for (size_t i = 0u; i < terms.size(); ++i) {
+      const std::string& term = terms[i];
+      auto it = nodes_[state].next.find(term);
+      while (state && it == nodes_[state].next.end()) {
+        state = nodes_[state].fail;
+        it = nodes_[state].next.find(term);
+      }
+      state = (it != nodes_[state].next.end()) ? it->second : 0u;
+      for (size_t node = nodes_[state].is_entry ? state : nodes_[state].entry_link; node != npos;
+           node = nodes_[node].entry_link) {
+        f(node, i + 1u - nodes_[node].depth);
+      }
+    }
+  }
+
+ private:
+  struct Node final {
+    std::unordered_map<std::string, size_t> next;
+    size_t depth = 0u;
+    size_t fail = 0u;
+    size_t entry_link = npos;  // The longest proper suffix of this node which is an entry.
+    bool is_entry = false;
+  };
+  std::vector<Node> nodes_;
+};
+
+// The results of the subschemas evaluated over the spans of a single query, see `MatchingChart` below.
+// The schema blocks are static, and the combined ones are shared by their types, so the address of the `IMPL` of
+// a block identifies its subschema.
+class MatchingChartBase {
+ public:
+  explicit MatchingChartBase(const void* query) : query_(query) {}
+  MatchingChartBase(const MatchingChartBase&) = delete;
+  MatchingChartBase& operator=(const MatchingChartBase&) = delete;
+
+  bool IsChartOf(const void* query) const { return query == query_; }
+
+  // The number of { subschema, span } pairs evaluated, and the number of those evaluations reused.
+  size_t Evaluated() const { return memo_.size(); }
+  size_t Reused() const { return reused_; }
+
+  template <typename T, typename F>
+  const std::vector<T>& Results(const void* impl, size_t begin, size_t end, F&& compute) {
+    const key_t key(impl, begin, end);
+    auto it = memo_.find(key);
+    if (it == memo_.end()) {
+      auto results = std::make_shared<std::vector<T>>();
+      compute(*results);
+      it = memo_.emplace(key, results).first;
+    } else {
+      ++reused_;
+    }
+    return *static_cast<const std::vector<T>*>(it->second.get());
+  }
+
+ private:
+  using key_t = std::tuple<const void*, size_t, size_t>;
+  const void* const query_;
+  std::map<key_t, std::shared_ptr<void>> memo_;  // `std::map`, as the results are replayed while it is extended.
+  size_t reused_ = 0u;
+};
+
+// The chart the schemas are being matched with in this thread, if any.
+struct ActiveMatchingChart final {
+  MatchingChartBase* chart = nullptr;
+
+  struct Scope final {
+    MatchingChartBase* const previous;
+    explicit Scope(MatchingChartBase& chart) : previous(ThreadLocalSingleton<ActiveMatchingChart>().chart) {
+      ThreadLocalSingleton<ActiveMatchingChart>().chart = &chart;
+    }
+    ~Scope() { ThreadLocalSingleton<ActiveMatchingChart>().chart = previous; }
+  };
+};
+
+// Evaluates the subschema `impl` over the [begin, end) span of the query, or replays its results, if the query is
+// being matched with a chart. The results are replayed in the order they were emitted in, so the schemas that stop
+// at the first result, such as the `Unit` ones, still stop at the same one.
+template <class IMPL, class QUERY, class EMIT>
+void EvalSubschema(const IMPL& impl, const QUERY& query, size_t begin, size_t end, EMIT&& emit) {
+  using emitted_t = typename IMPL::emitted_t;
+  MatchingChartBase* chart = ThreadLocalSingleton<ActiveMatchingChart>().chart;
+  if (chart && chart->IsChartOf(&query)) {
+    const std::vector<emitted_t>& results =
+        chart->template Results<emitted_t>(&impl, begin, end, [&](std::vector<emitted_t>& output) {
+          impl.EvalImpl(query, begin, end, [&output](const emitted_t& e) { output.push_back(e); });
+        });
+    for (const emitted_t& e : results) {
+      emit(e);
+    }
+  } else {
+    impl.EvalImpl(query, begin, end, std::forward<EMIT>(emit));
+  }
+}
+
 template <typename ANNOTATED_QUERY_TERM, class IMPL>
 struct UnitImpl {
   using annotated_query_term_t = ANNOTATED_QUERY_TERM;
@@ -120,7 +307,7 @@ struct UnitImpl {
                 std::function<void(const emitted_t&)> emit) const {
     struct SignalUnitEmitted {};
     try {
-      impl_.EvalImpl(query, begin, end, [&emit](const typename IMPL::emitted_t&) {
+      EvalSubschema(impl_, query, begin, end, [&emit](const typename IMPL::emitted_t&) {
         emit(Unit());
         throw SignalUnitEmitted();
       });
@@ -146,8 +333,8 @@ struct OrImplWithVariant {
                 size_t begin,
                 size_t end,
                 std::function<void(const emitted_t&)> emit) const {
-    lhs_impl_.EvalImpl(query, begin, end, [&emit](const LHS_TYPE& value) { emit(emitted_t(value)); });
-    rhs_impl_.EvalImpl(query, begin, end, [&emit](const RHS_TYPE& value) { emit(emitted_t(value)); });
+    EvalSubschema(lhs_impl_, query, begin, end, [&emit](const LHS_TYPE& value) { emit(emitted_t(value)); });
+    EvalSubschema(rhs_impl_, query, begin, end, [&emit](const RHS_TYPE& value) { emit(emitted_t(value)); });
   }
 };
 
@@ -163,8 +350,8 @@ struct OrImplSameType {
                 size_t begin,
                 size_t end,
                 std::function<void(const emitted_t&)> emit) const {
-    lhs_impl_.EvalImpl(query, begin, end, [&emit](const TYPE& value) { emit(emitted_t(value)); });
-    rhs_impl_.EvalImpl(query, begin, end, [&emit](const TYPE& value) { emit(emitted_t(value)); });
+    EvalSubschema(lhs_impl_, query, begin, end, [&emit](const TYPE& value) { emit(emitted_t(value)); });
+    EvalSubschema(rhs_impl_, query, begin, end, [&emit](const TYPE& value) { emit(emitted_t(value)); });
   }
 };
 
@@ -181,8 +368,8 @@ struct OrImplUnitUnit {
                 std::function<void(const emitted_t&)> emit) const {
     struct SignalUnitShouldBeEmittedFromOr {};
     try {
-      lhs_impl_.EvalImpl(query, begin, end, [](const Unit&) { throw SignalUnitShouldBeEmittedFromOr(); });
-      rhs_impl_.EvalImpl(query, begin, end, [](const Unit&) { throw SignalUnitShouldBeEmittedFromOr(); });
+      EvalSubschema(lhs_impl_, query, begin, end, [](const Unit&) { throw SignalUnitShouldBeEmittedFromOr(); });
+      EvalSubschema(rhs_impl_, query, begin, end, [](const Unit&) { throw SignalUnitShouldBeEmittedFromOr(); });
     } catch (const SignalUnitShouldBeEmittedFromOr&) {
       emit(Unit());
     }
@@ -276,12 +463,13 @@ struct AndImpl {
                 size_t begin,
                 size_t end,
                 std::function<void(const emitted_t&)> emit) const {
-    lhs_impl_.EvalImpl(query, begin, end, [this, &query, begin, end, &emit](const typename LHS_IMPL::emitted_t& lhs) {
-      rhs_impl_.EvalImpl(query, begin, end, [&lhs, &emit](const typename RHS_IMPL::emitted_t& rhs) {
-        emit(std::tuple_cat(current::metaprogramming::wrapped_into_tuple_t<typename LHS_IMPL::emitted_t>(lhs),
-                            current::metaprogramming::wrapped_into_tuple_t<typename RHS_IMPL::emitted_t>(rhs)));
-      });
-    });
+    EvalSubschema(
+        lhs_impl_, query, begin, end, [this, &query, begin, end, &emit](const typename LHS_IMPL::emitted_t& lhs) {
+          EvalSubschema(rhs_impl_, query, begin, end, [&lhs, &emit](const typename RHS_IMPL::emitted_t& rhs) {
+            emit(std::tuple_cat(current::metaprogramming::wrapped_into_tuple_t<typename LHS_IMPL::emitted_t>(lhs),
+                                current::metaprogramming::wrapped_into_tuple_t<typename RHS_IMPL::emitted_t>(rhs)));
+          });
+        });
   }
 };
 
@@ -309,8 +497,8 @@ struct SeqImpl<L2R, ANNOTATED_QUERY_TERM, LHS_IMPL, RHS_IMPL, LHS_TYPE, RHS_TYPE
                 size_t end,
                 std::function<void(const emitted_t&)> emit) const {
     for (size_t i = begin; i <= end; ++i) {
-      lhs_impl_.EvalImpl(query, begin, i, [this, &query, i, end, &emit](const LHS_TYPE& lhs) {
-        rhs_impl_.EvalImpl(query, i, end, [&lhs, &emit](const RHS_TYPE& rhs) {
+      EvalSubschema(lhs_impl_, query, begin, i, [this, &query, i, end, &emit](const LHS_TYPE& lhs) {
+        EvalSubschema(rhs_impl_, query, i, end, [&lhs, &emit](const RHS_TYPE& rhs) {
           emit(std::tuple_cat(current::metaprogramming::wrapped_into_tuple_t<LHS_TYPE>(lhs),
                               current::metaprogramming::wrapped_into_tuple_t<RHS_TYPE>(rhs)));
         });
@@ -333,8 +521,8 @@ struct SeqImpl<R2L, ANNOTATED_QUERY_TERM, LHS_IMPL, RHS_IMPL, LHS_TYPE, RHS_TYPE
                 size_t end,
                 std::function<void(const emitted_t&)> emit) const {
     for (size_t i = begin; i <= end; ++i) {
-      rhs_impl_.EvalImpl(query, i, end, [this, &query, begin, i, &emit](const RHS_TYPE& rhs) {
-        lhs_impl_.EvalImpl(query, begin, i, [&rhs, &emit](const LHS_TYPE& lhs) {
+      EvalSubschema(rhs_impl_, query, i, end, [this, &query, begin, i, &emit](const RHS_TYPE& rhs) {
+        EvalSubschema(lhs_impl_, query, begin, i, [&rhs, &emit](const LHS_TYPE& lhs) {
           emit(std::tuple_cat(current::metaprogramming::wrapped_into_tuple_t<LHS_TYPE>(lhs),
                               current::metaprogramming::wrapped_into_tuple_t<RHS_TYPE>(rhs)));
         });
@@ -359,8 +547,9 @@ struct SeqImplUnitInRHS {
       // Rely on the fact that only a single `Unit` will be emitted.
       // Start from testing the right hand side, as it's faster, and the order does not matter when a `Unit` is
       // present.
-      rhs_impl_.EvalImpl(
-          query, i, end, [this, &query, begin, i, &emit](const Unit&) { lhs_impl_.EvalImpl(query, begin, i, emit); });
+      EvalSubschema(rhs_impl_, query, i, end, [this, &query, begin, i, &emit](const Unit&) {
+        EvalSubschema(lhs_impl_, query, begin, i, emit);
+      });
     }
   }
 };
@@ -379,8 +568,9 @@ struct SeqImplUnitInLHS {
                 std::function<void(const emitted_t&)> emit) const {
     for (size_t i = begin; i <= end; ++i) {
       // Rely on the fact that only a single `Unit` will be emitted.
-      lhs_impl_.EvalImpl(
-          query, begin, i, [this, &query, i, end, &emit](const Unit&) { rhs_impl_.EvalImpl(query, i, end, emit); });
+      EvalSubschema(lhs_impl_, query, begin, i, [this, &query, i, end, &emit](const Unit&) {
+        EvalSubschema(rhs_impl_, query, i, end, emit);
+      });
     }
   }
 };
@@ -399,8 +589,8 @@ struct SeqImplUnitUnit {
     struct SignalUnitWasEmittedFromSeq {};
     try {
       for (size_t i = begin; i <= end; ++i) {
-        lhs_impl_.EvalImpl(query, begin, i, [this, &query, i, end, &emit](const Unit&) {
-          rhs_impl_.EvalImpl(query, i, end, [&emit](const Unit& unit) {
+        EvalSubschema(lhs_impl_, query, begin, i, [this, &query, i, end, &emit](const Unit&) {
+          EvalSubschema(rhs_impl_, query, i, end, [&emit](const Unit& unit) {
             emit(unit);
             throw SignalUnitWasEmittedFromSeq();
           });
@@ -467,7 +657,7 @@ struct MapImpl {
                 size_t begin,
                 size_t end,
                 std::function<void(const emitted_t&)> emit) const {
-    impl_.EvalImpl(query, begin, end, [this, &emit](const input_t& input) {
+    EvalSubschema(impl_, query, begin, end, [this, &emit](const input_t& input) {
       emitted_t output;
       map_function_(input, output);
       emit(output);
@@ -488,7 +678,7 @@ struct FilterImpl {
                 size_t begin,
                 size_t end,
                 std::function<void(const emitted_t&)> emit) const {
-    impl_.EvalImpl(query, begin, end, [this, &emit](const emitted_t& input) {
+    EvalSubschema(impl_, query, begin, end, [this, &emit](const emitted_t& input) {
       if (filter_function_(input)) {
         emit(input);
       }
@@ -516,7 +706,7 @@ struct SchemaBlock {
             size_t begin,
             size_t end,
             std::function<void(const emitted_t&)> emit) const {
-    impl_.EvalImpl(query, begin, end, emit);
+    impl::EvalSubschema(impl_, query, begin, end, emit);
   }
 
   const std::string& DebugName() const { return name_; }
@@ -583,6 +773,9 @@ inline void DefaultAnnotateQueryTerm(const std::string& original_term, Annotated
   output.normalized_term = current::strings::ToLower(original_term);
 }
 
+// The dictionary entries of all the dictionaries are compiled into a single `TermsAutomaton`. A multi-word entry
+// annotates the first of its terms, the annotator recording the span of the entry, see `SetDictionarySpan()`.
+// Where the entries overlap at the same first term, the annotator of the one ending later is applied last.
 template <typename ANNOTATED_QUERY_TERM>
 struct StaticQueryTermAnnotators {
   using annotated_query_term_t = ANNOTATED_QUERY_TERM;
@@ -590,24 +783,42 @@ struct StaticQueryTermAnnotators {
   using per_term_annotator_t = std::function<void(annotated_query_term_t&)>;
 
   annotator_t annotator_ = nullptr;
-  std::unordered_map<std::string, std::vector<per_term_annotator_t>> annotators_;
+  impl::TermsAutomaton automaton_;
+  std::unordered_map<size_t, std::vector<per_term_annotator_t>> annotators_;  // By the node of the entry.
+  std::atomic_bool automaton_built_{false};
+  std::mutex automaton_mutex_;
 
   void SetAnnotator(annotator_t annotator) {
     // NOTE: Assert no `annotator_` is set.
     annotator_ = std::move(annotator);
   }
 
-  void Add(const std::string& term, per_term_annotator_t annotator) {
-    annotators_[term].push_back(std::move(annotator));
+  // The `entry` is one or more whitespace-separated normalized terms.
+  void Add(const std::string& entry, per_term_annotator_t annotator) {
+    std::lock_guard<std::mutex> lock(automaton_mutex_);
+    const size_t node = automaton_.Add(current::strings::Split<current::strings::ByWhitespace>(entry));
+    annotators_[node].push_back(std::move(annotator));
+    automaton_built_ = false;
   }
 
-  void StaticallyAnnotateQueryTerm(annotated_query_term_t& term) {
-    const auto cit = annotators_.find(term.normalized_term);
-    if (cit != annotators_.end()) {
-      for (const auto& a : cit->second) {
-        a(term);
+  void StaticallyAnnotateQueryTerms(std::vector<annotated_query_term_t>& terms) {
+    if (!automaton_built_) {
+      std::lock_guard<std::mutex> lock(automaton_mutex_);
+      if (!automaton_built_) {
+        automaton_.Build();
+        automaton_built_ = true;
       }
     }
+    struct NormalizedTerms final {
+      const std::vector<annotated_query_term_t>& terms;
+      size_t size() const { return terms.size(); }
+      const std::string& operator[](size_t i) const { return terms[i].normalized_term; }
+    };
+    automaton_.Scan(NormalizedTerms{terms}, [this, &terms](size_t node, size_t first_term_index) {
+      for (const auto& a : annotators_.at(node)) {
+        a(terms[first_term_index]);
+      }
+    });
   }
 };
 
@@ -625,27 +836,44 @@ AnnotatedQuery<ANNOTATED_QUERY_TERM> AnnotateQuery(S&& query_string) {
     if (static_annotators.annotator_) {
       static_annotators.annotator_(query_terms[i], annotated_query.annotated_terms[i]);
     }
-    static_annotators.StaticallyAnnotateQueryTerm(annotated_query.annotated_terms[i]);
   }
+  static_annotators.StaticallyAnnotateQueryTerms(annotated_query.annotated_terms);
   return annotated_query;
 }
 
-template <typename ANNOTATED_QUERY_TERM, typename IMPL, typename S>
-std::vector<typename IMPL::emitted_t> MatchQueryIntoVector(const SchemaBlock<ANNOTATED_QUERY_TERM, IMPL>& schema_block,
-                                                           S&& query_string) {
+// `MatchingChart` is the annotated query along with the results of the subschemas evaluated over its spans.
+// Matching the schemas with the chart, instead of with the query string, evaluates each subschema, i.e. each keyword,
+// annotation, or combination of blocks, once per span of the query, however many schemas it is part of.
+// The chart is meant to be used by one thread, and the `Map`-s and `Filter`-s of the schemas should be pure functions.
+template <typename ANNOTATED_QUERY_TERM = AnnotatedQueryTerm>
+class MatchingChart final : public impl::MatchingChartBase {
+ public:
+  template <typename S>
+  explicit MatchingChart(S&& query_string)
+      : impl::MatchingChartBase(&query_), query_(AnnotateQuery<ANNOTATED_QUERY_TERM>(std::forward<S>(query_string))) {}
+
+  const AnnotatedQuery<ANNOTATED_QUERY_TERM>& Query() const { return query_; }
+
+ private:
+  const AnnotatedQuery<ANNOTATED_QUERY_TERM> query_;
+};
+
+namespace impl {
+
+template <typename ANNOTATED_QUERY_TERM, typename IMPL>
+std::vector<typename IMPL::emitted_t> MatchIntoVector(const SchemaBlock<ANNOTATED_QUERY_TERM, IMPL>& schema_block,
+                                                      const AnnotatedQuery<ANNOTATED_QUERY_TERM>& query) {
   using emitted_t = typename IMPL::emitted_t;
-  const AnnotatedQuery<ANNOTATED_QUERY_TERM> query = AnnotateQuery<ANNOTATED_QUERY_TERM>(std::forward<S>(query_string));
   std::vector<emitted_t> results;
   schema_block.Eval(
       query, 0u, query.annotated_terms.size(), [&results](const emitted_t& result) { results.emplace_back(result); });
   return results;
 }
 
-template <typename ANNOTATED_QUERY_TERM, typename IMPL, typename S>
-Optional<typename IMPL::emitted_t> JustMatchQuery(const SchemaBlock<ANNOTATED_QUERY_TERM, IMPL>& schema_block,
-                                                  S&& query_string) {
+template <typename ANNOTATED_QUERY_TERM, typename IMPL>
+Optional<typename IMPL::emitted_t> JustMatch(const SchemaBlock<ANNOTATED_QUERY_TERM, IMPL>& schema_block,
+                                             const AnnotatedQuery<ANNOTATED_QUERY_TERM>& query) {
   using emitted_t = typename IMPL::emitted_t;
-  const AnnotatedQuery<ANNOTATED_QUERY_TERM> query = AnnotateQuery<ANNOTATED_QUERY_TERM>(std::forward<S>(query_string));
   Optional<emitted_t> return_value;
   struct SignalEvalSucceeded {};
   try {
@@ -660,6 +888,118 @@ Optional<typename IMPL::emitted_t> JustMatchQuery(const SchemaBlock<ANNOTATED_QU
   }
 }
 
+}  // namespace impl
+
+template <typename ANNOTATED_QUERY_TERM, typename IMPL, typename S>
+std::vector<typename IMPL::emitted_t> MatchQueryIntoVector(const SchemaBlock<ANNOTATED_QUERY_TERM, IMPL>& schema_block,
+                                                           S&& query_string) {
+  return impl::MatchIntoVector(schema_block, AnnotateQuery<ANNOTATED_QUERY_TERM>(std::forward<S>(query_string)));
+}
+
+template <typename ANNOTATED_QUERY_TERM, typename IMPL>
+std::vector<typename IMPL::emitted_t> MatchQueryIntoVector(const SchemaBlock<ANNOTATED_QUERY_TERM, IMPL>& schema_block,
+                                                           MatchingChart<ANNOTATED_QUERY_TERM>& chart) {
+  const impl::ActiveMatchingChart::Scope scope(chart);
+  return impl::MatchIntoVector(schema_block, chart.Query());
+}
+
+template <typename ANNOTATED_QUERY_TERM, typename IMPL, typename S>
+Optional<typename IMPL::emitted_t> JustMatchQuery(const SchemaBlock<ANNOTATED_QUERY_TERM, IMPL>& schema_block,
+                                                  S&& query_string) {
+  return impl::JustMatch(schema_block, AnnotateQuery<ANNOTATED_QUERY_TERM>(std::forward<S>(query_string)));
+}
+
+template <typename ANNOTATED_QUERY_TERM, typename IMPL>
+Optional<typename IMPL::emitted_t> JustMatchQuery(const SchemaBlock<ANNOTATED_QUERY_TERM, IMPL>& schema_block,
+                                                  MatchingChart<ANNOTATED_QUERY_TERM>& chart) {
+  const impl::ActiveMatchingChart::Scope scope(chart);
+  return impl::JustMatch(schema_block, chart.Query());
+}
+
+// Calls `f(chart)` with the `MatchingChart` of each of the `queries`, and returns the results in the order of queries.
+// Each distinct query is annotated and passed to `f` once, and the distinct queries are processed on `threads` threads,
+// zero being one per CPU core. Thus, `f` should be thread-safe, return the same result for the same query, and its
+// result type should be default-constructible. The first exception thrown by `f`, if any, is rethrown.
+// The threads are started for each call, so the queries are best passed in batches of thousands or more.
+template <typename ANNOTATED_QUERY_TERM = AnnotatedQueryTerm, typename F>
+std::vector<std::invoke_result_t<F, MatchingChart<ANNOTATED_QUERY_TERM>&>> MatchQueriesBatch(
+    const std::vector<std::string>& queries, F&& f, size_t threads = 0u) {
+  using result_t = std::invoke_result_t<F, MatchingChart<ANNOTATED_QUERY_TERM>&>;
+
+  std::unordered_map<std::string, size_t> distinct_index;
+  std::vector<const std::string*> distinct_queries;
+  std::vector<size_t> query_index(queries.size());
+  for (size_t i = 0u; i < queries.size(); ++i) {
+    const auto it = distinct_index.emplace(queries[i], distinct_queries.size());
+    if (it.second) {
+      distinct_queries.push_back(&queries[i]);
+    }
+    query_index[i] = it.first->second;
+  }
+
+  std::vector<result_t> distinct_results(distinct_queries.size());
+  std::atomic_size_t next(0u);
+  std::exception_ptr exception = nullptr;
+  std::mutex exception_mutex;
+  const auto worker = [&]() {
+    for (size_t i = next++; i < distinct_queries.size(); i = next++) {
+      try {
+        MatchingChart<ANNOTATED_QUERY_TERM> chart(*distinct_queries[i]);
+        distinct_results[i] = f(chart);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(exception_mutex);
+        if (!exception) {
+          exception = std::current_exception();
+        }
+        next = distinct_queries.size();
+      }
+    }
+  };
+  const size_t total_threads =
+      std::min(std::max(size_t(1u), distinct_queries.size()),
+               threads ? threads : std::max(size_t(1u), size_t(std::thread::hardware_concurrency())));
+  std::vector<std::thread> workers;
+  for (size_t t = 1u; t < total_threads; ++t) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : workers) {
+    thread.join();
+  }
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+
+  std::vector<result_t> results;
+  results.reserve(queries.size());
+  for (size_t i : query_index) {
+    results.push_back(distinct_results[i]);
+  }
+  return results;
+}
+
+template <typename ANNOTATED_QUERY_TERM, typename IMPL>
+std::vector<std::vector<typename IMPL::emitted_t>> MatchQueriesIntoVectors(
+    const SchemaBlock<ANNOTATED_QUERY_TERM, IMPL>& schema_block,
+    const std::vector<std::string>& queries,
+    size_t threads = 0u) {
+  return MatchQueriesBatch<ANNOTATED_QUERY_TERM>(
+      queries,
+      [&schema_block](MatchingChart<ANNOTATED_QUERY_TERM>& chart) { return MatchQueryIntoVector(schema_block, chart); },
+      threads);
+}
+
+template <typename ANNOTATED_QUERY_TERM, typename IMPL>
+std::vector<Optional<typename IMPL::emitted_t>> JustMatchQueries(
+    const SchemaBlock<ANNOTATED_QUERY_TERM, IMPL>& schema_block,
+    const std::vector<std::string>& queries,
+    size_t threads = 0u) {
+  return MatchQueriesBatch<ANNOTATED_QUERY_TERM>(
+      queries,
+      [&schema_block](MatchingChart<ANNOTATED_QUERY_TERM>& chart) { return JustMatchQuery(schema_block, chart); },
+      threads);
+}
+
 }  // namespace nlp
 }  // namespace current
 
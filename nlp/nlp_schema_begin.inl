@@ -43,8 +43,12 @@
       for (const auto& e : field_name##_values) {                                                             \
         const auto& key = e.first;                                                                            \
         const auto& value = e.second;                                                                         \
+        const size_t span = ::current::strings::Split<::current::strings::ByWhitespace>(key).size();          \
         ::current::Singleton<::current::nlp::StaticQueryTermAnnotators<annotated_query_term_t>>().Add(        \
-            key, [&value](annotated_query_term_t& annotated) { annotated.field_name = value; });              \
+            key, [&value, span](annotated_query_term_t& annotated) {                                          \
+              annotated.field_name = value;                                                                   \
+              ::current::nlp::impl::SetDictionarySpan(annotated, #field_name, span);                          \
+            });                                                                                               \
       }                                                                                                       \
     }                                                                                                         \
   };                                                                                                          \
@@ -54,7 +58,8 @@
                   size_t begin,                                                                               \
                   size_t end,                                                                                 \
                   std::function<void(const typename field_name##_values_initializer::field_t&)> emit) const { \
-      if (end == begin + 1u && Exists(query.annotated_terms[begin].field_name)) {                             \
+      if (end > begin && Exists(query.annotated_terms[begin].field_name) &&                                   \
+          end == begin + ::current::nlp::impl::DictionarySpan(query.annotated_terms[begin], #field_name)) {   \
         emit(Value(query.annotated_terms[begin].field_name));                                                 \
       }                                                                                                       \
     }                                                                                                         \
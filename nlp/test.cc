@@ -230,6 +230,83 @@ TEST(NLP, TrivialSingleTermMatching) {
 
 #include "nlp_schema_end.inl"
 
+/**********************************************************************************************************************
+
+  NLP.MultiWordDictionaryAnnotation
+  The dictionary entries of several terms, overlapping with one another and with the single-term ones.
+
+**********************************************************************************************************************/
+
+#include "nlp_schema_begin.inl"
+
+NLPSchema(MultiWordDictionaryAnnotation, CityAnnotatedQueryTerm) {
+  CURRENT_STRUCT(City) {
+    CURRENT_FIELD(city, std::string);
+    CURRENT_CONSTRUCTOR(City)(std::string city = "") : city(std::move(city)) {}
+  };
+
+  CURRENT_STRUCT(CityAnnotatedQueryTerm, AnnotatedQueryTerm) { CURRENT_FIELD(city, Optional<City>); };
+
+  DictionaryAnnotation(city,
+                       {"york", {"York"}},
+                       {"new york", {"New York"}},
+                       {"new york city", {"New York City"}},
+                       {"salt lake city", {"Salt Lake City"}},
+                       {"lake city", {"Lake City"}});
+
+  Keyword(in);
+  Keyword(weather);
+
+  Term(weather_in_city, weather >> in >> city);
+}
+
+TEST(NLP, MultiWordDictionaryAnnotation) {
+  UseNLPSchema(MultiWordDictionaryAnnotation);
+
+  {
+    const auto result = AnnotateQuery<CityAnnotatedQueryTerm>("York New York new york city");
+    ASSERT_EQ(6u, result.annotated_terms.size());
+    EXPECT_EQ("York", Value(result.annotated_terms[0].city).city);
+    EXPECT_TRUE(result.annotated_terms[0].dictionary_spans.empty());
+    EXPECT_EQ("New York", Value(result.annotated_terms[1].city).city);
+    EXPECT_EQ(2u, result.annotated_terms[1].dictionary_spans.at("city"));
+    EXPECT_EQ("York", Value(result.annotated_terms[2].city).city);
+    // The longest of the entries starting from the same term wins.
+    EXPECT_EQ("New York City", Value(result.annotated_terms[3].city).city);
+    EXPECT_EQ(3u, result.annotated_terms[3].dictionary_spans.at("city"));
+    EXPECT_EQ("York", Value(result.annotated_terms[4].city).city);
+    EXPECT_FALSE(Exists(result.annotated_terms[5].city));
+  }
+
+  {
+    // The entries which are the suffixes of other entries are matched too.
+    const auto result = AnnotateQuery<CityAnnotatedQueryTerm>("salt lake city");
+    EXPECT_EQ("Salt Lake City", Value(result.annotated_terms[0].city).city);
+    EXPECT_EQ("Lake City", Value(result.annotated_terms[1].city).city);
+    EXPECT_EQ(2u, result.annotated_terms[1].dictionary_spans.at("city"));
+    EXPECT_FALSE(Exists(result.annotated_terms[2].city));
+  }
+
+  {
+    // The automaton restarts from the longest matching suffix after a mismatch.
+    const auto result = AnnotateQuery<CityAnnotatedQueryTerm>("salt new york lake city");
+    EXPECT_FALSE(Exists(result.annotated_terms[0].city));
+    EXPECT_EQ("New York", Value(result.annotated_terms[1].city).city);
+    EXPECT_EQ("York", Value(result.annotated_terms[2].city).city);
+    EXPECT_EQ("Lake City", Value(result.annotated_terms[3].city).city);
+  }
+
+  // The multi-word dictionary entries match the spans of their terms.
+  EXPECT_EQ("[{\"city\":\"New York City\"}]",
+            JSON<JSONFormat::Minimalistic>(MatchQueryIntoVector(weather_in_city, "weather in New York City")));
+  EXPECT_EQ("[{\"city\":\"York\"}]",
+            JSON<JSONFormat::Minimalistic>(MatchQueryIntoVector(weather_in_city, "weather in York")));
+  EXPECT_FALSE(Exists(JustMatchQuery(weather_in_city, "weather in new")));
+  EXPECT_FALSE(Exists(JustMatchQuery(weather_in_city, "weather in lake")));
+}
+
+#include "nlp_schema_end.inl"
+
 /**********************************************************************************************************************
 
  NLP.SchemaCompositionMechamisms
@@ -519,6 +596,16 @@ TEST(NLP, EvaluationOrder) {
     EXPECT_EQ("[{\"z\":\"{(p q) (p q)}\"}]",
               JSON<JSONFormat::Minimalistic>(MatchQueryIntoVector(repeated2, "p q p q")));
   }
+
+  {
+    // The same orders when matching with a chart.
+    MatchingChart<ThreeWayAnnotation> chart("p q p");
+    EXPECT_EQ("[{\"z\":\"{p (q p)}\"},{\"z\":\"{(p q) p}\"}]",
+              JSON<JSONFormat::Minimalistic>(MatchQueryIntoVector(repeated2, chart)));
+    MatchingChart<ThreeWayAnnotation> another_chart("a a");
+    EXPECT_EQ("[[{\"X\":{}},{\"X\":{}}],[{\"Y\":{}},{\"X\":{}}],[{\"X\":{}},{\"Y\":{}}],[{\"Y\":{}},{\"Y\":{}}]]",
+              JSON<JSONFormat::Minimalistic>(MatchQueryIntoVector(sequence2, another_chart)));
+  }
 }
 
 #include "nlp_schema_end.inl"
@@ -842,6 +929,95 @@ TEST(NLP, CalculatorExample) {
   }
 }
 
+TEST(NLP, MatchingChart) {
+  UseNLPSchema(Calculator);
+
+  MatchingChart<CalculatorAnnotation> chart("what is two plus three");
+  EXPECT_EQ(5u, chart.Query().annotated_terms.size());
+  EXPECT_EQ(0u, chart.Evaluated());
+
+  {
+    const Optional<Number> result = JustMatchQuery(formula, chart);
+    ASSERT_TRUE(Exists(result));
+    EXPECT_EQ(5, Value(result).x);
+  }
+
+  // The `digit`-s over the same spans are shared by the alternatives of the `formula`.
+  const size_t evaluated = chart.Evaluated();
+  const size_t reused = chart.Reused();
+  EXPECT_LT(0u, evaluated);
+  EXPECT_LT(0u, reused);
+
+  // Matching the same schema again just replays its results.
+  EXPECT_EQ(JSON(MatchQueryIntoVector(formula, "what is two plus three")),
+            JSON(MatchQueryIntoVector(formula, chart)));
+  EXPECT_EQ(evaluated, chart.Evaluated());
+  EXPECT_EQ(reused + 1u, chart.Reused());
+
+  // Another schema only evaluates what the chart does not have yet, here, the `Filter` over the `digit`.
+  EXPECT_FALSE(Exists(JustMatchQuery(odd_digit, chart)));
+  EXPECT_EQ(evaluated + 1u, chart.Evaluated());
+
+  {
+    MatchingChart<CalculatorAnnotation> another_chart("three");
+    const Optional<Digit> result = JustMatchQuery(odd_digit, another_chart);
+    ASSERT_TRUE(Exists(result));
+    EXPECT_EQ(3u, Value(result).d);
+    EXPECT_EQ(2u, another_chart.Evaluated());
+  }
+}
+
+TEST(NLP, MatchQueriesBatch) {
+  UseNLPSchema(Calculator);
+
+  std::vector<std::string> queries;
+  std::vector<int32_t> expected;
+  for (size_t i = 0u; i < 1000u; ++i) {
+    static const std::vector<std::pair<std::string, int32_t>> formulas = {
+        {"two plus three", 5}, {"what is one minus three", -2}, {"how many is two times three", 6}, {"two", 2}};
+    const auto& formula = formulas[i % formulas.size()];
+    queries.push_back(formula.first);
+    expected.push_back(formula.second);
+  }
+  queries.push_back("what is love");
+
+  for (size_t threads : {1u, 4u, 0u}) {
+    const std::vector<Optional<Number>> results = JustMatchQueries(formula, queries, threads);
+    ASSERT_EQ(queries.size(), results.size());
+    for (size_t i = 0u; i < expected.size(); ++i) {
+      ASSERT_TRUE(Exists(results[i]));
+      EXPECT_EQ(expected[i], Value(results[i]).x) << queries[i];
+    }
+    EXPECT_FALSE(Exists(results.back()));
+  }
+
+  {
+    // Several schemas per query, and each distinct query only once.
+    std::atomic_size_t calls(0u);
+    const std::vector<std::pair<size_t, size_t>> results = MatchQueriesBatch<CalculatorAnnotation>(
+        queries,
+        [&calls](MatchingChart<CalculatorAnnotation>& chart) {
+          ++calls;
+          return std::make_pair(MatchQueryIntoVector(formula, chart).size(),
+                                MatchQueryIntoVector(odd_digit, chart).size());
+        },
+        4u);
+    EXPECT_EQ(5u, calls);
+    ASSERT_EQ(queries.size(), results.size());
+    EXPECT_EQ(std::make_pair(size_t(1u), size_t(0u)), results[0]);
+    EXPECT_EQ(std::make_pair(size_t(1u), size_t(0u)), results[3]);
+    EXPECT_EQ(std::make_pair(size_t(0u), size_t(0u)), results.back());
+  }
+
+  {
+    // The first exception thrown by the user code is rethrown.
+    struct TestException {};
+    ASSERT_THROW(MatchQueriesBatch(queries, [](MatchingChart<>&) -> int { throw TestException(); }, 4u), TestException);
+  }
+
+  EXPECT_TRUE(MatchQueriesIntoVectors(formula, std::vector<std::string>()).empty());
+}
+
 #include "nlp_schema_end.inl"
 
 /**********************************************************************************************************************
@@ -26,6 +26,13 @@ SOFTWARE.
 // a `CURRENT_PROFILER_HTTP_ROUTE(http_scopes_variable, port, "/route")` macro to define an HTTP endpoint
 // exposing a full snapshot of how much time did each thread spend in each scope.
 // Scopes are hierarchical, represented in the output as a full call stack tree.
+// Each thread keeps its scopes in its own state, updated with no locks taken; the report reads them as they are.
+// With `Profiler::SetSamplingInterval(N)`, only every N-th entry of each scope is timed, and the rest are extrapolated.
+// The timed entries also go into per-scope latency histograms, exported as percentiles in JSON, and, with
+// `?format=prometheus`, in the Prometheus text format.
+// The tries are also exported as folded stacks for the flame graph tools, with `?format=folded`. With `?capture=N`,
+// the individual entries and exits of the last N seconds are kept, exported in the Chrome trace format with
+// `?format=chrome`.
 
 #ifndef CURRENT_PROFILER_H
 #define CURRENT_PROFILER_H
@@ -41,7 +48,14 @@ SOFTWARE.
 #error "No `CURRENT_PROFILER` in `CURRENT_COVERAGE_REPORT_MODE` please."
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include "../blocks/http/api.h"
 #include "../bricks/time/chrono.h"
@@ -54,6 +68,114 @@ SOFTWARE.
 namespace current {
 namespace profiler {
 
+CURRENT_STRUCT(LatencyPercentiles) {
+  CURRENT_FIELD(p50_us, double);
+  CURRENT_FIELD(p90_us, double);
+  CURRENT_FIELD(p99_us, double);
+  CURRENT_FIELD(p999_us, double);
+  CURRENT_FIELD(max_us, double);
+};
+
+// The latencies of the scope across all the threads. The scope is the full path, as "outer/inner".
+CURRENT_STRUCT(ScopeLatencyReporting) {
+  CURRENT_FIELD(scope, std::string);
+  CURRENT_FIELD(entries, uint64_t);
+  CURRENT_FIELD(sampled_entries, uint64_t);
+  CURRENT_FIELD(latency, LatencyPercentiles);
+};
+
+// A log-linear histogram of durations in nanoseconds: each power of two is split into `kSubBuckets` equal buckets,
+// so the values are kept with the relative precision of `1 / kSubBuckets`, up to `2^kMaxValueBits` nanoseconds.
+// Only the thread owning the histogram records into it; the snapshots are taken concurrently, and added up.
+class LatencyHistogram final {
+ public:
+  constexpr static size_t kSubBucketBits = 3u;
+  constexpr static size_t kSubBuckets = 1u << kSubBucketBits;
+  constexpr static size_t kMaxValueBits = 40u;
+  constexpr static size_t kBuckets = (kMaxValueBits - kSubBucketBits + 1u) * kSubBuckets;
+
+  using snapshot_t = std::vector<uint64_t>;
+
+  LatencyHistogram() {
+    for (auto& count : counts_) {
+      count.store(0u, std::memory_order_relaxed);
+    }
+  }
+
+  void Record(int64_t ns) {
+    std::atomic<uint64_t>& count = counts_[BucketIndex(ns)];
+    count.store(count.load(std::memory_order_relaxed) + 1u, std::memory_order_relaxed);
+  }
+
+  snapshot_t Snapshot() const {
+    snapshot_t snapshot(kBuckets);
+    for (size_t i = 0u; i < kBuckets; ++i) {
+      snapshot[i] = counts_[i].load(std::memory_order_relaxed);
+    }
+    return snapshot;
+  }
+
+  static size_t BucketIndex(int64_t ns) {
+    const uint64_t v = std::min(static_cast<uint64_t>(std::max(ns, static_cast<int64_t>(0))),
+                                (static_cast<uint64_t>(1u) << kMaxValueBits) - 1u);
+    if (v < kSubBuckets) {
+      return static_cast<size_t>(v);
+    }
+    const size_t shift = HighestBit(v) - kSubBucketBits;
+    return (shift + 1u) * kSubBuckets + static_cast<size_t>((v >> shift) - kSubBuckets);
+  }
+
+  // The highest value that goes into the bucket.
+  static uint64_t BucketUpperBound(size_t index) {
+    if (index < kSubBuckets) {
+      return index;
+    }
+    const size_t shift = index / kSubBuckets - 1u;
+    return ((kSubBuckets + index % kSubBuckets + 1u) << shift) - 1u;
+  }
+
+  static LatencyPercentiles Percentiles(const snapshot_t& snapshot) {
+    uint64_t total = 0u;
+    for (uint64_t count : snapshot) {
+      total += count;
+    }
+    const auto percentile = [&snapshot, total](double q) {
+      if (!total) {
+        return 0.0;
+      }
+      const uint64_t rank = std::max(static_cast<uint64_t>(std::ceil(q * total)), static_cast<uint64_t>(1u));
+      uint64_t seen = 0u;
+      for (size_t i = 0u; i < snapshot.size(); ++i) {
+        seen += snapshot[i];
+        if (seen >= rank) {
+          return 1e-3 * BucketUpperBound(i);
+        }
+      }
+      return 1e-3 * BucketUpperBound(snapshot.size() - 1u);  // LCOV_EXCL_LINE
+    };
+    LatencyPercentiles result;
+    result.p50_us = percentile(0.5);
+    result.p90_us = percentile(0.9);
+    result.p99_us = percentile(0.99);
+    result.p999_us = percentile(0.999);
+    result.max_us = percentile(1.0);
+    return result;
+  }
+
+ private:
+  static size_t HighestBit(uint64_t x) {
+#ifdef CURRENT_WINDOWS
+    unsigned long result;
+    _BitScanReverse64(&result, x);
+    return static_cast<size_t>(result);
+#else
+    return static_cast<size_t>(63 - __builtin_clzll(x));
+#endif  // CURRENT_WINDOWS
+  }
+
+  std::atomic<uint64_t> counts_[kBuckets];
+};
+
 CURRENT_STRUCT(PerThreadReporting) {
   CURRENT_FIELD(scope, std::string);
   CURRENT_FIELD(entries, uint64_t);
@@ -63,6 +185,7 @@ CURRENT_STRUCT(PerThreadReporting) {
   CURRENT_FIELD(ratio_of_parent, double);
   CURRENT_FIELD(subscope, std::vector<PerThreadReporting>);
   CURRENT_FIELD(subscope_total_ratio_of_parent, double);
+  CURRENT_FIELD(latency, LatencyPercentiles);
   bool operator<(const PerThreadReporting& rhs) const {
     return us > rhs.us;  // Naturally sort in reverse order of `us`.
   }
@@ -70,184 +193,533 @@ CURRENT_STRUCT(PerThreadReporting) {
 
 CURRENT_STRUCT(ProfilingReport) {
   CURRENT_FIELD(thread, std::vector<PerThreadReporting>);
+  CURRENT_FIELD(scope, std::vector<ScopeLatencyReporting>);
   CURRENT_FIELD(profiling_overhead, std::chrono::microseconds);
   CURRENT_FIELD(profiling_mutex_overhead, std::chrono::microseconds);
   CURRENT_FIELD(reporting_overhead, std::chrono::microseconds);
 };
 
+// The Chrome trace event format, as understood by `chrome://tracing` and Perfetto.
+CURRENT_STRUCT(ChromeTraceEvent) {
+  CURRENT_FIELD(name, std::string);
+  CURRENT_FIELD(ph, std::string);  // "B" for entering the scope, "E" for leaving it.
+  CURRENT_FIELD(ts, double);       // Microseconds.
+  CURRENT_FIELD(pid, uint32_t);
+  CURRENT_FIELD(tid, uint32_t);
+};
+
+CURRENT_STRUCT(ChromeTrace) { CURRENT_FIELD(traceEvents, std::vector<ChromeTraceEvent>); };
+
 struct Profiler {
   class StateMaintainer {
    private:
-    struct State {
-      struct PerThread {
-        struct Trie {
-          // `Now()` if within it, `0` if currently not there.
-          std::chrono::microseconds us_entered = std::chrono::microseconds(0);
-          // Total across all the times this scope was entered.
-          std::chrono::microseconds us_total = std::chrono::microseconds(0);
-          // The number of times this scope was entered.
-          uint64_t entries = 0;
-          // Sub-scopes within this scope, if any.
-          std::map<const char*, Trie> children;
-
-          std::chrono::microseconds ComputeTotalMicroseconds(std::chrono::microseconds now) const {
-            if (us_entered.count()) {
-              CURRENT_ASSERT(now >= us_entered);
-              return std::chrono::microseconds(us_total.count() + (now - us_entered).count());
-            } else {
-              return us_total;
-            }
+    // The durations are measured with `steady_clock`, which, unlike `current::time::Now()`, does not touch an atomic
+    // shared by all the threads.
+    static int64_t Ticks() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+    }
+
+    // The scopes of one thread. Only this thread modifies its trie, with no locks taken, while the report is being
+    // generated concurrently. Hence the counters are atomics written with relaxed stores, and the children are an
+    // append-only list, with the new nodes published by release stores.
+    struct Trie {
+      const char* const scope;
+      // `Ticks()` if within a sampled entry of this scope, `0` otherwise.
+      std::atomic<int64_t> ns_entered;
+      // Total across all the sampled entries of this scope.
+      std::atomic<int64_t> ns_total;
+      // The number of times this scope was entered, and how many of them were timed.
+      std::atomic<uint64_t> entries;
+      std::atomic<uint64_t> sampled_entries;
+      // Sub-scopes within this scope, if any. Each `next_sibling` is immutable once the node is published.
+      std::atomic<Trie*> first_child;
+      Trie* next_sibling = nullptr;
+      // The durations of the sampled entries.
+      LatencyHistogram histogram;
+      // The values as of the last reset, only accessed by the reporting code, under the mutex.
+      int64_t reset_ns_total = 0;
+      uint64_t reset_entries = 0u;
+      uint64_t reset_sampled_entries = 0u;
+      LatencyHistogram::snapshot_t reset_histogram;
+
+      explicit Trie(const char* scope)
+          : scope(scope), ns_entered(0), ns_total(0), entries(0u), sampled_entries(0u), first_child(nullptr) {}
+      ~Trie() {
+        Trie* child = first_child.load(std::memory_order_relaxed);
+        while (child) {
+          Trie* next = child->next_sibling;
+          delete child;
+          child = next;
+        }
+      }
+
+      // Called from the thread owning this trie only.
+      Trie& Child(const char* child_scope) {
+        Trie* const head = first_child.load(std::memory_order_relaxed);
+        for (Trie* child = head; child; child = child->next_sibling) {
+          if (child->scope == child_scope) {
+            return *child;
           }
-          void RecursiveReset(std::chrono::microseconds now) {
-            us_total = std::chrono::microseconds(0);
-            if (us_entered.count()) {
-              us_entered = now;
-            }
-            entries = 1;
-            for (auto& e : children) {
-              e.second.RecursiveReset(now);
-            }
+        }
+        Trie* child = new Trie(child_scope);
+        child->next_sibling = head;
+        first_child.store(child, std::memory_order_release);
+        return *child;
+      }
+
+      std::chrono::microseconds ComputeTotalMicroseconds(int64_t now) const {
+        const int64_t entered = ns_entered.load(std::memory_order_relaxed);
+        const int64_t ns = ns_total.load(std::memory_order_relaxed) - reset_ns_total + (entered ? now - entered : 0);
+        const uint64_t n = entries.load(std::memory_order_relaxed) - reset_entries;
+        const uint64_t sampled = sampled_entries.load(std::memory_order_relaxed) - reset_sampled_entries;
+        // With sampling, the time of the scope is extrapolated from its sampled entries to all of them.
+        return std::chrono::microseconds(sampled ? static_cast<int64_t>(1e-3 * ns * n / sampled) : 0);
+      }
+
+      LatencyHistogram::snapshot_t HistogramSnapshot() const {
+        LatencyHistogram::snapshot_t snapshot = histogram.Snapshot();
+        if (!reset_histogram.empty()) {
+          for (size_t i = 0u; i < snapshot.size(); ++i) {
+            snapshot[i] -= reset_histogram[i];
           }
-        };
-        Trie trie;
-        std::stack<std::pair<const char*, Trie*> > stack;
-        PerThread() {
-          trie.us_entered = current::time::Now();
-          trie.entries = 1;
-          stack.push(std::make_pair("", &trie));
         }
+        return snapshot;
+      }
+
+      void RecursiveReset() {
+        reset_histogram = histogram.Snapshot();
+        reset_ns_total = ns_total.load(std::memory_order_relaxed);
+        reset_entries = entries.load(std::memory_order_relaxed);
+        reset_sampled_entries = sampled_entries.load(std::memory_order_relaxed);
+        for (Trie* child = first_child.load(std::memory_order_acquire); child; child = child->next_sibling) {
+          child->RecursiveReset();
+        }
+      }
+    };
+
+    // The most recent entries and exits of the scopes of one thread, written by this thread only, and read
+    // concurrently. Before overwriting a slot, the writer claims the next index, so that the reader can tell
+    // which of the slots it has read might have been overwritten meanwhile.
+    class TraceRingBuffer {
+     public:
+      struct Event {
+        const char* scope;
+        int64_t ns;
+        bool enter;
       };
-      std::unordered_map<std::thread::id, PerThread> per_thread;
-      std::chrono::microseconds total_spent_in_profiling = std::chrono::microseconds(0);
-      std::chrono::microseconds spent_in_reporting = std::chrono::microseconds(0);
-      std::chrono::microseconds spent_in_mutex_locking = std::chrono::microseconds(0);
-      void Reset() {
-        total_spent_in_profiling = std::chrono::microseconds(0);
-        spent_in_reporting = std::chrono::microseconds(0);
-        spent_in_mutex_locking = std::chrono::microseconds(0);
-        for (auto& e : per_thread) {
-          e.second.trie.RecursiveReset(current::time::Now());
+
+      explicit TraceRingBuffer(size_t capacity) : capacity_(capacity), slots_(capacity), claimed_(0u), head_(0u) {}
+
+      void Push(const char* scope, int64_t ns, bool enter) {
+        const uint64_t index = head_.load(std::memory_order_relaxed);
+        claimed_.store(index + 1u, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        Slot& slot = slots_[index % capacity_];
+        slot.scope.store(scope, std::memory_order_relaxed);
+        slot.ns.store(ns, std::memory_order_relaxed);
+        slot.enter.store(enter, std::memory_order_relaxed);
+        head_.store(index + 1u, std::memory_order_release);
+      }
+
+      std::vector<Event> Snapshot() const {
+        const uint64_t head = head_.load(std::memory_order_acquire);
+        const uint64_t begin = head > capacity_ ? head - capacity_ : 0u;
+        std::vector<Event> events;
+        events.reserve(static_cast<size_t>(head - begin));
+        for (uint64_t index = begin; index < head; ++index) {
+          const Slot& slot = slots_[index % capacity_];
+          events.push_back(Event{slot.scope.load(std::memory_order_relaxed),
+                                 slot.ns.load(std::memory_order_relaxed),
+                                 slot.enter.load(std::memory_order_relaxed)});
         }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // The slots of the indexes up to `claimed - capacity` might have been overwritten while being read.
+        const uint64_t claimed = claimed_.load(std::memory_order_relaxed);
+        const uint64_t valid_begin = claimed > capacity_ ? claimed - capacity_ : 0u;
+        if (valid_begin > begin) {
+          events.erase(events.begin(), events.begin() + static_cast<ptrdiff_t>(std::min(valid_begin, head) - begin));
+        }
+        return events;
       }
-      ProfilingReport GenerateReport() const {
-        const std::chrono::microseconds now = current::time::Now();
-        ProfilingReport report;
-        report.profiling_overhead = total_spent_in_profiling - spent_in_reporting;
-        report.reporting_overhead = spent_in_reporting;
-        report.profiling_mutex_overhead = spent_in_mutex_locking;
-        std::vector<PerThreadReporting> thread;
-        thread.reserve(per_thread.size());
-        for (const auto& per_thread_element : per_thread) {
-          std::function<void(const PerThread::Trie& input,
-                             std::chrono::microseconds total_us,
-                             PerThreadReporting& output,
-                             const char* stack)>
-              recursive_fill;
-          recursive_fill = [now, &recursive_fill](const PerThread::Trie& input,
-                                                  std::chrono::microseconds total_us,
-                                                  PerThreadReporting& output,
-                                                  const char* stack) {
-            output.scope = stack;
-            output.entries = input.entries;
-            CURRENT_ASSERT(output.entries);
-            output.us = input.ComputeTotalMicroseconds(now);
-            output.us_per_entry = 1.0 * output.us.count() / output.entries;
-            output.absolute_best_possible_qps = output.us.count() ? (1e6 / output.us_per_entry) : 1e6;
-            output.ratio_of_parent = total_us.count() ? (1.0 * output.us.count() / total_us.count()) : 1.0;
-            output.subscope.reserve(input.children.size());
-            for (const auto& scope : input.children) {
-              output.subscope.resize(output.subscope.size() + 1);
-              recursive_fill(scope.second, output.us, output.subscope.back(), scope.first);
-            }
-            CURRENT_ASSERT(output.subscope.size() == input.children.size());
-            std::chrono::microseconds subscope_total = std::chrono::microseconds(0);
-            for (const auto& subscope : output.subscope) {
-              subscope_total += subscope.us;
-            }
-            CURRENT_ASSERT(subscope_total <= output.us);
-            output.subscope_total_ratio_of_parent =
-                output.us.count() ? (1.0 * subscope_total.count() / output.us.count()) : 1.0;
-            std::sort(output.subscope.begin(), output.subscope.end());
-          };
-          thread.resize(thread.size() + 1);
-          std::ostringstream thread_id_as_string;
-          thread_id_as_string << "C++ thread with internal ID " << per_thread_element.first;
-          recursive_fill(per_thread_element.second.trie,
-                         per_thread_element.second.trie.ComputeTotalMicroseconds(now),
-                         thread.back(),
-                         thread_id_as_string.str().c_str());
+
+     private:
+      struct Slot {
+        std::atomic<const char*> scope;
+        std::atomic<int64_t> ns;
+        std::atomic<bool> enter;
+        Slot() : scope(nullptr), ns(0), enter(false) {}
+      };
+
+      const uint64_t capacity_;
+      std::vector<Slot> slots_;
+      std::atomic<uint64_t> claimed_;
+      std::atomic<uint64_t> head_;
+    };
+
+    struct PerThread {
+      const std::string name;
+      const uint32_t index;
+      Trie trie;
+      // Only accessed by the thread itself.
+      std::vector<Trie*> stack;
+      // The number of `Ticks()` calls made by the profiler in this thread.
+      std::atomic<uint64_t> clock_reads;
+      // Created by the thread itself once the trace is being captured, and kept from then on.
+      std::atomic<TraceRingBuffer*> trace;
+
+      PerThread(std::string name, uint32_t index)
+          : name(std::move(name)), index(index), trie(""), clock_reads(1u), trace(nullptr) {
+        trie.ns_entered.store(Ticks(), std::memory_order_relaxed);
+        trie.entries.store(1u, std::memory_order_relaxed);
+        trie.sampled_entries.store(1u, std::memory_order_relaxed);
+        stack.push_back(&trie);
+      }
+      ~PerThread() { delete trace.load(std::memory_order_relaxed); }
+
+      int64_t Now() {
+        clock_reads.store(clock_reads.load(std::memory_order_relaxed) + 1u, std::memory_order_relaxed);
+        return Ticks();
+      }
+
+      void Trace(const char* scope, int64_t ns, bool enter, size_t capacity) {
+        TraceRingBuffer* buffer = trace.load(std::memory_order_relaxed);
+        if (!buffer) {
+          buffer = new TraceRingBuffer(capacity);
+          trace.store(buffer, std::memory_order_release);
         }
-        CURRENT_ASSERT(thread.size() == per_thread.size());
-        report.thread = thread;
-        return report;
+        buffer->Push(scope, ns, enter);
       }
     };
 
+    // The state of the current thread, registered with the profiler the first time this thread enters a scope.
+    // The profiler keeps it after the thread is done, so that the report covers all the threads.
+    struct ThisThread {
+      std::shared_ptr<PerThread> state;
+      ThisThread() : state(current::Singleton<StateMaintainer>().RegisterThread()) {}
+    };
+
+    static PerThread& CurrentThread() { return *current::ThreadLocalSingleton<ThisThread>().state; }
+
    public:
+    StateMaintainer() : sampling_interval_(1u), trace_events_per_thread_(0u), trace_window_ns_(0) {
+      // Measure the cost of the clock, to estimate the profiling overhead without taking extra measurements.
+      constexpr int kCalibrationReads = 1000;
+      const int64_t begin = Ticks();
+      int64_t end = begin;
+      for (int i = 0; i < kCalibrationReads; ++i) {
+        end = Ticks();
+      }
+      ns_per_clock_read_ = 1.0 * (end - begin) / kCalibrationReads;
+    }
+
+    // Only time every `interval`-th entry of each scope, and extrapolate the rest. The entries are still counted.
+    void SetSamplingInterval(uint32_t interval) { sampling_interval_ = std::max(interval, 1u); }
+    uint32_t SamplingInterval() const { return sampling_interval_; }
+
     void EnterScope(const char* scope) {
       CURRENT_ASSERT(scope);
       CURRENT_ASSERT(*scope);
-      Guarded([scope](std::chrono::microseconds now, State::PerThread& per_thread) {
-        CURRENT_ASSERT(now.count());
-        CURRENT_ASSERT(!per_thread.stack.empty());
-        State::PerThread::Trie& node = (*per_thread.stack.top().second).children[scope];
-        node.us_entered = now;
-        ++node.entries;
-        per_thread.stack.push(std::make_pair(scope, &node));
-      });
+      PerThread& per_thread = CurrentThread();
+      CURRENT_ASSERT(!per_thread.stack.empty());
+      Trie& node = per_thread.stack.back()->Child(scope);
+      const uint64_t entries = node.entries.load(std::memory_order_relaxed) + 1u;
+      node.entries.store(entries, std::memory_order_relaxed);
+      const bool sampled = !(entries % sampling_interval_.load(std::memory_order_relaxed));
+      const size_t trace_capacity = trace_events_per_thread_.load(std::memory_order_relaxed);
+      if (sampled || trace_capacity) {
+        const int64_t now = per_thread.Now();
+        if (sampled) {
+          node.ns_entered.store(now, std::memory_order_relaxed);
+          node.sampled_entries.store(node.sampled_entries.load(std::memory_order_relaxed) + 1u,
+                                     std::memory_order_relaxed);
+        }
+        if (trace_capacity) {
+          per_thread.Trace(scope, now, true, trace_capacity);
+        }
+      }
+      per_thread.stack.push_back(&node);
     }
 
     void LeaveScope(const char* scope) {
       CURRENT_ASSERT(scope);
       CURRENT_ASSERT(*scope);
-      Guarded([scope](std::chrono::microseconds now, State::PerThread& per_thread) {
-        CURRENT_ASSERT(now.count());
-        CURRENT_ASSERT(!per_thread.stack.empty());
-        CURRENT_ASSERT(scope == per_thread.stack.top().first);
-        State::PerThread::Trie& node = (*per_thread.stack.top().second);
-        CURRENT_ASSERT(node.us_entered <= now);
-        node.us_total += (now - node.us_entered);
-        node.us_entered = std::chrono::microseconds(0);
-        per_thread.stack.pop();
-        CURRENT_ASSERT(!per_thread.stack.empty());  // Should have at least the root trie node left in the stack.
-      });
+      PerThread& per_thread = CurrentThread();
+      CURRENT_ASSERT(per_thread.stack.size() > 1u);  // Should have at least the root trie node left in the stack.
+      Trie& node = *per_thread.stack.back();
+      CURRENT_ASSERT(scope == node.scope);
+      const int64_t entered = node.ns_entered.load(std::memory_order_relaxed);
+      const size_t trace_capacity = trace_events_per_thread_.load(std::memory_order_relaxed);
+      if (entered || trace_capacity) {
+        const int64_t now = per_thread.Now();
+        if (entered) {
+          CURRENT_ASSERT(entered <= now);
+          node.ns_total.store(node.ns_total.load(std::memory_order_relaxed) + (now - entered),
+                              std::memory_order_relaxed);
+          node.histogram.Record(now - entered);
+          node.ns_entered.store(0, std::memory_order_relaxed);
+        }
+        if (trace_capacity) {
+          per_thread.Trace(scope, now, false, trace_capacity);
+        }
+      }
+      per_thread.stack.pop_back();
     }
 
     void Report(Request request) {
-      Guarded([this, &request](std::chrono::microseconds unused_now, const State::PerThread& unused_per_thread_state) {
-        static_cast<void>(unused_now);
-        static_cast<void>(unused_per_thread_state);
-        if (request.url.query.has("reset")) {
-          state_.Reset();
-          request("The profiler has been reset.\n");
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (request.url.query.has("sampling")) {
+        SetSamplingInterval(static_cast<uint32_t>(std::max(0, atoi(request.url.query["sampling"].c_str()))));
+      }
+      if (request.url.query.has("capture")) {
+        const int seconds = std::max(0, atoi(request.url.query["capture"].c_str()));
+        CaptureTrace(seconds ? kDefaultTraceEventsPerThread : 0u, std::chrono::seconds(seconds));
+      }
+      const std::string& format = request.url.query["format"];
+      if (request.url.query.has("reset")) {
+        Reset();
+        request("The profiler has been reset.\n");
+      } else if (request.url.query.has("sampling")) {
+        request("The profiler samples every " + current::ToString(SamplingInterval()) + " entries.\n");
+      } else if (request.url.query.has("capture")) {
+        request("The profiler captures the trace of the last " + request.url.query["capture"] + " seconds.\n");
+      } else if (format == "prometheus" || format == "folded" || format == "chrome") {
+        const int64_t pre_report = Ticks();
+        if (format == "prometheus") {
+          request(Response(PrometheusReport(GenerateReport())).ContentType("text/plain; version=0.0.4"));
+        } else if (format == "folded") {
+          request(FoldedStacksReport(GenerateReport()));
         } else {
-          const std::chrono::microseconds pre_report = current::time::Now();
-          request(state_.GenerateReport());
-          const std::chrono::microseconds post_report = current::time::Now();
-          state_.spent_in_reporting += (post_report - pre_report);
+          request(GenerateChromeTrace());
         }
-      });
+        spent_in_reporting_ += std::chrono::microseconds((Ticks() - pre_report) / 1000);
+      } else {
+        const int64_t pre_report = Ticks();
+        request(GenerateReport());
+        spent_in_reporting_ += std::chrono::microseconds((Ticks() - pre_report) / 1000);
+      }
+    }
+
+    constexpr static size_t kDefaultTraceEventsPerThread = 1u << 16;
+
+    // Keep up to `events_per_thread` of the most recent entries and exits per thread, and export those of them that
+    // are not older than `window`. Zero `events_per_thread` stops capturing. The buffers of the threads that
+    // have captured something already keep their sizes.
+    void CaptureTrace(size_t events_per_thread, std::chrono::seconds window) {
+      trace_window_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(window).count();
+      trace_events_per_thread_ = events_per_thread;
     }
 
    private:
-    template <typename F>
-    void Guarded(F&& f) {
-      const std::chrono::microseconds pre_mutex_lock = current::time::Now();
+    std::shared_ptr<PerThread> RegisterThread() {
+      const int64_t pre_mutex_lock = Ticks();
+      std::ostringstream thread_id_as_string;
+      thread_id_as_string << "C++ thread with internal ID " << std::this_thread::get_id();
       std::lock_guard<std::mutex> lock(mutex_);
-      const std::chrono::microseconds post_mutex_lock = current::time::Now();
-      f(post_mutex_lock, state_.per_thread[std::this_thread::get_id()]);
-      const std::chrono::microseconds post_guarded_code = current::time::Now();
-      state_.total_spent_in_profiling += (post_guarded_code - pre_mutex_lock);
-      state_.spent_in_mutex_locking += (post_mutex_lock - pre_mutex_lock);
+      auto per_thread = std::make_shared<PerThread>(thread_id_as_string.str(), static_cast<uint32_t>(threads_.size()));
+      threads_.push_back(per_thread);
+      spent_in_mutex_locking_ += std::chrono::microseconds((Ticks() - pre_mutex_lock) / 1000);
+      return per_thread;
+    }
+
+    // The entries in progress at the time of the reset are accounted for in full once they are done.
+    void Reset() {
+      spent_in_reporting_ = std::chrono::microseconds(0);
+      spent_in_mutex_locking_ = std::chrono::microseconds(0);
+      for (const auto& per_thread : threads_) {
+        per_thread->trie.RecursiveReset();
+        per_thread->trie.reset_entries = 0u;  // The root is always "entered" once, even after the reset.
+        per_thread->trie.reset_sampled_entries = 0u;
+        per_thread->trie.ns_total.store(0, std::memory_order_relaxed);
+        per_thread->trie.reset_ns_total = 0;
+        per_thread->trie.ns_entered.store(Ticks(), std::memory_order_relaxed);
+        reset_clock_reads_[per_thread.get()] = per_thread->clock_reads.load(std::memory_order_relaxed);
+      }
     }
 
-    struct Scope {
-      Scope(const char*) {}
-      const char* scope;
+    struct MergedScope {
+      uint64_t entries = 0u;
+      uint64_t sampled_entries = 0u;
+      LatencyHistogram::snapshot_t histogram = LatencyHistogram::snapshot_t(LatencyHistogram::kBuckets);
     };
 
+    ProfilingReport GenerateReport() const {
+      const int64_t now = Ticks();
+      ProfilingReport report;
+      uint64_t clock_reads = 0u;
+      std::map<std::string, MergedScope> merged;
+      std::vector<PerThreadReporting> thread;
+      thread.reserve(threads_.size());
+      for (const auto& per_thread : threads_) {
+        std::function<void(const Trie& input,
+                           std::chrono::microseconds total_us,
+                           PerThreadReporting& output,
+                           const char* stack,
+                           const std::string& path)>
+            recursive_fill;
+        recursive_fill = [now, &merged, &recursive_fill](const Trie& input,
+                                                         std::chrono::microseconds total_us,
+                                                         PerThreadReporting& output,
+                                                         const char* stack,
+                                                         const std::string& path) {
+          output.scope = stack;
+          output.entries = input.entries.load(std::memory_order_relaxed) - input.reset_entries;
+          output.us = input.ComputeTotalMicroseconds(now);
+          output.us_per_entry = output.entries ? 1.0 * output.us.count() / output.entries : 0.0;
+          output.absolute_best_possible_qps = output.us.count() ? (1e6 / output.us_per_entry) : 1e6;
+          output.ratio_of_parent = total_us.count() ? (1.0 * output.us.count() / total_us.count()) : 1.0;
+          if (!path.empty()) {
+            const LatencyHistogram::snapshot_t histogram = input.HistogramSnapshot();
+            output.latency = LatencyHistogram::Percentiles(histogram);
+            MergedScope& scope = merged[path];
+            scope.entries += output.entries;
+            scope.sampled_entries +=
+                input.sampled_entries.load(std::memory_order_relaxed) - input.reset_sampled_entries;
+            for (size_t i = 0u; i < histogram.size(); ++i) {
+              scope.histogram[i] += histogram[i];
+            }
+          }
+          for (const Trie* child = input.first_child.load(std::memory_order_acquire); child;
+               child = child->next_sibling) {
+            output.subscope.resize(output.subscope.size() + 1);
+            const std::string child_path = path.empty() ? std::string(child->scope) : path + '/' + child->scope;
+            recursive_fill(*child, output.us, output.subscope.back(), child->scope, child_path);
+          }
+          // NOTE: The sub-scopes may add up to slightly more than the scope itself, as the threads are not stopped
+          // while the report is being generated, and as the sampled times are extrapolated.
+          std::chrono::microseconds subscope_total = std::chrono::microseconds(0);
+          for (const auto& subscope : output.subscope) {
+            subscope_total += subscope.us;
+          }
+          output.subscope_total_ratio_of_parent =
+              output.us.count() ? (1.0 * subscope_total.count() / output.us.count()) : 1.0;
+          std::sort(output.subscope.begin(), output.subscope.end());
+        };
+        thread.resize(thread.size() + 1);
+        recursive_fill(per_thread->trie,
+                       per_thread->trie.ComputeTotalMicroseconds(now),
+                       thread.back(),
+                       per_thread->name.c_str(),
+                       "");
+        const auto reset_cit = reset_clock_reads_.find(per_thread.get());
+        clock_reads += per_thread->clock_reads.load(std::memory_order_relaxed) -
+                       (reset_cit != reset_clock_reads_.end() ? reset_cit->second : 0u);
+      }
+      CURRENT_ASSERT(thread.size() == threads_.size());
+      report.thread = thread;
+      for (const auto& scope : merged) {
+        ScopeLatencyReporting latency;
+        latency.scope = scope.first;
+        latency.entries = scope.second.entries;
+        latency.sampled_entries = scope.second.sampled_entries;
+        latency.latency = LatencyHistogram::Percentiles(scope.second.histogram);
+        report.scope.push_back(std::move(latency));
+      }
+      report.profiling_overhead =
+          std::chrono::microseconds(static_cast<int64_t>(1e-3 * ns_per_clock_read_ * clock_reads));
+      report.profiling_mutex_overhead = spent_in_mutex_locking_;
+      report.reporting_overhead = spent_in_reporting_;
+      return report;
+    }
+
+    static std::string PrometheusReport(const ProfilingReport& report) {
+      std::ostringstream os;
+      const auto label = [](const std::string& scope) {
+        std::string escaped;
+        for (char c : scope) {
+          if (c == '\\' || c == '"') {
+            escaped += '\\';
+          }
+          escaped += (c == '\n') ? ' ' : c;
+        }
+        return "scope=\"" + escaped + '"';
+      };
+      os << "# HELP current_profiler_scope_latency_us The latency of the sampled entries of the scope.\n"
+         << "# TYPE current_profiler_scope_latency_us summary\n";
+      for (const auto& scope : report.scope) {
+        const std::string scope_label = label(scope.scope);
+        const LatencyPercentiles& p = scope.latency;
+        for (const auto& q : std::vector<std::pair<const char*, double>>{
+                 {"0.5", p.p50_us}, {"0.9", p.p90_us}, {"0.99", p.p99_us}, {"0.999", p.p999_us}, {"1", p.max_us}}) {
+          os << "current_profiler_scope_latency_us{" << scope_label << ",quantile=\"" << q.first << "\"} " << q.second
+             << '\n';
+        }
+        os << "current_profiler_scope_latency_us_count{" << scope_label << "} " << scope.sampled_entries << '\n';
+      }
+      os << "# HELP current_profiler_scope_entries_total The number of entries into the scope.\n"
+         << "# TYPE current_profiler_scope_entries_total counter\n";
+      for (const auto& scope : report.scope) {
+        os << "current_profiler_scope_entries_total{" << label(scope.scope) << "} " << scope.entries << '\n';
+      }
+      return os.str();
+    }
+
+    // One line per stack, "thread;outer;inner 42", with the self time of the innermost scope in microseconds.
+    // Each scope has its line, with the self time of zero if its sub-scopes add up to more than the scope itself,
+    // which they may, see `GenerateReport()`.
+    static std::string FoldedStacksReport(const ProfilingReport& report) {
+      std::ostringstream os;
+      std::function<void(const PerThreadReporting&, const std::string&)> recursive_fold;
+      recursive_fold = [&os, &recursive_fold](const PerThreadReporting& node, const std::string& stack) {
+        std::string frame = node.scope;
+        std::replace(frame.begin(), frame.end(), ';', ':');
+        const std::string path = stack.empty() ? frame : stack + ';' + frame;
+        std::chrono::microseconds self = node.us;
+        for (const auto& subscope : node.subscope) {
+          self -= subscope.us;
+          recursive_fold(subscope, path);
+        }
+        os << path << ' ' << std::max(self, std::chrono::microseconds(0)).count() << '\n';
+      };
+      for (const auto& thread : report.thread) {
+        recursive_fold(thread, "");
+      }
+      return os.str();
+    }
+
+    ChromeTrace GenerateChromeTrace() const {
+      const int64_t oldest = Ticks() - trace_window_ns_.load(std::memory_order_relaxed);
+      ChromeTrace trace;
+      for (const auto& per_thread : threads_) {
+        const TraceRingBuffer* buffer = per_thread->trace.load(std::memory_order_acquire);
+        if (!buffer) {
+          continue;
+        }
+        size_t depth = 0u;
+        for (const auto& event : buffer->Snapshot()) {
+          if (event.ns < oldest) {
+            continue;
+          }
+          // Skip the exits of the scopes entered before the oldest captured event.
+          if (event.enter) {
+            ++depth;
+          } else if (depth) {
+            --depth;
+          } else {
+            continue;
+          }
+          ChromeTraceEvent chrome_event;
+          chrome_event.name = event.scope;
+          chrome_event.ph = event.enter ? "B" : "E";
+          chrome_event.ts = 1e-3 * event.ns;
+          chrome_event.pid = 1u;
+          chrome_event.tid = per_thread->index;
+          trace.traceEvents.push_back(std::move(chrome_event));
+        }
+      }
+      return trace;
+    }
+
+    std::atomic<uint32_t> sampling_interval_;
+    std::atomic<size_t> trace_events_per_thread_;
+    std::atomic<int64_t> trace_window_ns_;
+    double ns_per_clock_read_;
+    // Guards the list of threads, which is only changed when a thread enters its very first scope, and the reporting.
     std::mutex mutex_;
-    State state_;
+    std::vector<std::shared_ptr<PerThread>> threads_;
+    std::map<const PerThread*, uint64_t> reset_clock_reads_;
+    std::chrono::microseconds spent_in_reporting_ = std::chrono::microseconds(0);
+    std::chrono::microseconds spent_in_mutex_locking_ = std::chrono::microseconds(0);
   };
 
   class ScopedStateMaintainer {
@@ -264,6 +736,18 @@ struct Profiler {
     const char* const scope_;
   };
 
+  // Time only every `interval`-th entry of each scope, to keep the profiler on in production. Also settable via
+  // the `?sampling=N` query parameter of the HTTP route.
+  static void SetSamplingInterval(uint32_t interval) {
+    current::Singleton<StateMaintainer>().SetSamplingInterval(interval);
+  }
+
+  // Keep the individual entries and exits of the scopes, exported in the Chrome trace format. Also settable via
+  // the `?capture=N` query parameter of the HTTP route, for the last N seconds.
+  static void CaptureTrace(size_t events_per_thread, std::chrono::seconds window) {
+    current::Singleton<StateMaintainer>().CaptureTrace(events_per_thread, window);
+  }
+
   static void HTTPRoute(Request request) { current::Singleton<StateMaintainer>().Report(std::move(request)); }
 };
 
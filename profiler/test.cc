@@ -0,0 +1,286 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#define CURRENT_PROFILER
+
+#include "../port.h"
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "profiler.h"
+
+#include "../bricks/strings/printf.h"
+#include "../bricks/strings/split.h"
+
+#include "../3rdparty/gtest/gtest-main.h"
+
+using current::profiler::ChromeTrace;
+using current::profiler::PerThreadReporting;
+using current::profiler::Profiler;
+using current::profiler::ProfilingReport;
+using current::profiler::ScopeLatencyReporting;
+
+namespace {
+
+// The scopes are told apart by the pointers to their names, so each is entered from one place only.
+void Inner() {
+  CURRENT_PROFILER_SCOPE("inner");
+  std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+
+void Outer(int inner_entries) {
+  CURRENT_PROFILER_SCOPE("outer");
+  for (int i = 0; i < inner_entries; ++i) {
+    Inner();
+  }
+}
+
+void RunThreads(size_t threads_count, int outer_entries, int inner_entries) {
+  std::vector<std::thread> threads;
+  for (size_t t = 0u; t < threads_count; ++t) {
+    threads.emplace_back([outer_entries, inner_entries]() {
+      for (int i = 0; i < outer_entries; ++i) {
+        Outer(inner_entries);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+const ScopeLatencyReporting* FindScope(const ProfilingReport& report, const std::string& scope) {
+  for (const auto& s : report.scope) {
+    if (s.scope == scope) {
+      return &s;
+    }
+  }
+  return nullptr;
+}
+
+const PerThreadReporting* FindSubscope(const PerThreadReporting& node, const std::string& scope) {
+  for (const auto& s : node.subscope) {
+    if (s.scope == scope) {
+      return &s;
+    }
+  }
+  return nullptr;
+}
+
+struct ProfilerEndpoint final {
+  current::net::ReservedLocalPort reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  HTTPRoutesScope scope;
+
+  ProfilerEndpoint() {
+    HTTP(std::move(reserved_port));
+    CURRENT_PROFILER_HTTP_ROUTE(scope, port, "/profiler");
+  }
+
+  std::string Get(const std::string& query) {
+    const auto response = HTTP(GET(current::strings::Printf("http://localhost:%d/profiler%s", port, query.c_str())));
+    EXPECT_EQ(200, static_cast<int>(response.code));
+    return response.body;
+  }
+};
+
+}  // namespace
+
+TEST(Profiler, NestedScopesAcrossThreads) {
+  ProfilerEndpoint endpoint;
+  EXPECT_EQ("The profiler has been reset.\n", endpoint.Get("?reset"));
+  RunThreads(3u, 10, 5);
+
+  const auto report = ParseJSON<ProfilingReport>(endpoint.Get(""));
+  size_t threads_with_scopes = 0u;
+  for (const auto& thread : report.thread) {
+    const PerThreadReporting* outer = FindSubscope(thread, "outer");
+    if (outer && outer->entries) {
+      ++threads_with_scopes;
+      EXPECT_EQ(10u, outer->entries);
+      const PerThreadReporting* inner = FindSubscope(*outer, "inner");
+      ASSERT_TRUE(inner != nullptr);
+      EXPECT_EQ(50u, inner->entries);
+      EXPECT_GE(inner->us.count(), 50 * 100);
+      EXPECT_GE(outer->us, inner->us);
+      EXPECT_GT(inner->latency.p50_us, 0.0);
+    }
+  }
+  EXPECT_EQ(3u, threads_with_scopes);
+
+  // The latencies are also merged across the threads, per full path of the scope.
+  const ScopeLatencyReporting* outer = FindScope(report, "outer");
+  const ScopeLatencyReporting* inner = FindScope(report, "outer/inner");
+  ASSERT_TRUE(outer != nullptr);
+  ASSERT_TRUE(inner != nullptr);
+  EXPECT_EQ(30u, outer->entries);
+  EXPECT_EQ(150u, inner->entries);
+  EXPECT_EQ(150u, inner->sampled_entries);
+  EXPECT_GE(inner->latency.p50_us, 100.0);
+  EXPECT_LE(inner->latency.p50_us, inner->latency.p99_us);
+  EXPECT_LE(inner->latency.p99_us, inner->latency.max_us);
+
+  // Once reset, the scopes entered before are no longer counted.
+  endpoint.Get("?reset");
+  const auto after_reset = ParseJSON<ProfilingReport>(endpoint.Get(""));
+  for (const auto& thread : after_reset.thread) {
+    const PerThreadReporting* outer_after_reset = FindSubscope(thread, "outer");
+    if (outer_after_reset) {
+      EXPECT_EQ(0u, outer_after_reset->entries);
+      EXPECT_EQ(0, outer_after_reset->us.count());
+    }
+  }
+  const ScopeLatencyReporting* inner_after_reset = FindScope(after_reset, "outer/inner");
+  ASSERT_TRUE(inner_after_reset != nullptr);
+  EXPECT_EQ(0u, inner_after_reset->entries);
+  EXPECT_EQ(0.0, inner_after_reset->latency.max_us);
+}
+
+TEST(Profiler, Sampling) {
+  ProfilerEndpoint endpoint;
+  endpoint.Get("?reset");
+  Profiler::SetSamplingInterval(10u);
+  RunThreads(2u, 10, 10);
+  {
+    const auto report = ParseJSON<ProfilingReport>(endpoint.Get(""));
+    const ScopeLatencyReporting* inner = FindScope(report, "outer/inner");
+    ASSERT_TRUE(inner != nullptr);
+    EXPECT_EQ(200u, inner->entries);
+    EXPECT_EQ(20u, inner->sampled_entries);
+    // The time of the entries not timed is extrapolated.
+    for (const auto& thread : report.thread) {
+      const PerThreadReporting* outer = FindSubscope(thread, "outer");
+      if (outer && outer->entries) {
+        EXPECT_GE(FindSubscope(*outer, "inner")->us.count(), 100 * 100);
+      }
+    }
+  }
+
+  EXPECT_EQ("The profiler samples every 1 entries.\n", endpoint.Get("?sampling=1"));
+  endpoint.Get("?reset");
+  RunThreads(1u, 1, 10);
+  {
+    const auto report = ParseJSON<ProfilingReport>(endpoint.Get(""));
+    const ScopeLatencyReporting* inner = FindScope(report, "outer/inner");
+    ASSERT_TRUE(inner != nullptr);
+    EXPECT_EQ(10u, inner->entries);
+    EXPECT_EQ(10u, inner->sampled_entries);
+  }
+}
+
+TEST(Profiler, PrometheusFormat) {
+  ProfilerEndpoint endpoint;
+  endpoint.Get("?reset");
+  RunThreads(2u, 2, 3);
+  const std::string prometheus = endpoint.Get("?format=prometheus");
+  EXPECT_NE(std::string::npos, prometheus.find("# TYPE current_profiler_scope_latency_us summary\n"));
+  EXPECT_NE(std::string::npos,
+            prometheus.find("current_profiler_scope_latency_us{scope=\"outer/inner\",quantile=\"0.99\"} "));
+  EXPECT_NE(std::string::npos, prometheus.find("current_profiler_scope_latency_us_count{scope=\"outer/inner\"} 12\n"));
+  EXPECT_NE(std::string::npos, prometheus.find("current_profiler_scope_entries_total{scope=\"outer\"} 4\n"));
+  EXPECT_NE(std::string::npos, prometheus.find("current_profiler_scope_entries_total{scope=\"outer/inner\"} 12\n"));
+}
+
+TEST(Profiler, FoldedFormat) {
+  ProfilerEndpoint endpoint;
+  endpoint.Get("?reset");
+  RunThreads(1u, 2, 3);
+  const std::string folded = endpoint.Get("?format=folded");
+  // The threads of the tests above keep their lines, with no time since the reset.
+  size_t inner_lines_with_time = 0u;
+  for (const std::string& line : current::strings::Split(folded, '\n')) {
+    const int64_t us = current::FromString<int64_t>(line.substr(line.rfind(' ') + 1u));
+    const std::vector<std::string> stack = current::strings::Split(line.substr(0u, line.rfind(' ')), ';');
+    ASSERT_FALSE(stack.empty());
+    if (stack.size() == 3u && stack[1] == "outer" && stack[2] == "inner" && us) {
+      ++inner_lines_with_time;
+      EXPECT_GE(us, 6 * 100);
+    }
+  }
+  EXPECT_EQ(1u, inner_lines_with_time);
+
+  // The scope the extrapolated sub-scopes of which add up to more than the scope itself keeps its line.
+  // With every second entry timed, the only timed entry of `mid` is the short one, while the timed entries
+  // of `leaf`, all within the first entry of `mid`, are long.
+  endpoint.Get("?sampling=2");
+  endpoint.Get("?reset");
+  std::thread([]() {
+    for (int i = 0; i < 2; ++i) {
+      CURRENT_PROFILER_SCOPE("mid");
+      for (int j = 0; j < (i ? 0 : 2); ++j) {
+        CURRENT_PROFILER_SCOPE("leaf");
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+  }).join();
+  endpoint.Get("?sampling=1");
+  const std::string extrapolated = endpoint.Get("?format=folded");
+  size_t mid_lines = 0u;
+  for (const std::string& line : current::strings::Split(extrapolated, '\n')) {
+    const std::vector<std::string> stack = current::strings::Split(line.substr(0u, line.rfind(' ')), ';');
+    if (stack.size() == 2u && stack[1] == "mid") {
+      ++mid_lines;
+      EXPECT_EQ(" 0", line.substr(line.rfind(' ')));
+    }
+  }
+  EXPECT_EQ(1u, mid_lines);
+}
+
+TEST(Profiler, ChromeFormat) {
+  ProfilerEndpoint endpoint;
+  EXPECT_EQ("The profiler captures the trace of the last 10 seconds.\n", endpoint.Get("?capture=10"));
+  RunThreads(2u, 2, 3);
+  const auto trace = ParseJSON<ChromeTrace>(endpoint.Get("?format=chrome"));
+  endpoint.Get("?capture=0");
+
+  std::map<uint32_t, std::vector<std::string>> stacks;
+  std::map<uint32_t, size_t> inner_entries;
+  for (const auto& event : trace.traceEvents) {
+    std::vector<std::string>& stack = stacks[event.tid];
+    if (event.ph == "B") {
+      stack.push_back(event.name);
+      if (event.name == "inner") {
+        ++inner_entries[event.tid];
+        ASSERT_EQ(2u, stack.size());
+        EXPECT_EQ("outer", stack[0]);
+      }
+    } else {
+      ASSERT_EQ("E", event.ph);
+      ASSERT_FALSE(stack.empty());
+      EXPECT_EQ(stack.back(), event.name);
+      stack.pop_back();
+    }
+  }
+  size_t threads_with_scopes = 0u;
+  for (const auto& thread : inner_entries) {
+    ++threads_with_scopes;
+    EXPECT_EQ(6u, thread.second);
+    EXPECT_TRUE(stacks[thread.first].empty());
+  }
+  EXPECT_EQ(2u, threads_with_scopes);
+}
@@ -0,0 +1,206 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// The metrics of a running RipCurrent flow, collected if requested with `ExecutionOptions::WithMetrics()`:
+// the messages passed into and emitted by each user block, the time spent in its user code, and, for each queue
+// between the blocks, the depth of its backlog and the time the messages wait in it, see "blocks/mmq/metrics.h".
+// The blocks and the queues are named by the statements which define them, and by the blocks they pass messages to.
+//
+// Use `scope.Metrics()` of the `RipCurrentScope`, serve them as JSON with
+// `HTTP(port).Register("/ripcurrent", [&scope](Request r) { r(scope.Metrics()); });`, or publish them into the
+// process-wide metrics registry, "blocks/metrics/metrics.h", with `scope.PublishMetrics("flow_name")`.
+
+#ifndef CURRENT_RIPCURRENT_METRICS_H
+#define CURRENT_RIPCURRENT_METRICS_H
+
+#include "../port.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../blocks/mmq/metrics.h"
+
+#include "../typesystem/struct.h"
+
+namespace current {
+namespace ripcurrent {
+
+CURRENT_STRUCT(RipCurrentBlockMetrics) {
+  CURRENT_FIELD(block, std::string);
+  CURRENT_FIELD(source, std::string);
+  CURRENT_FIELD_DESCRIPTION(source, "The file and the line the block is defined at.");
+  CURRENT_FIELD(messages_in, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(messages_in, "The messages passed to the block, a batch counting as one.");
+  CURRENT_FIELD(messages_out, uint64_t, 0u);
+  CURRENT_FIELD_DESCRIPTION(messages_out, "The messages emitted, posted, or scheduled by the block.");
+  CURRENT_FIELD(user_code, std::chrono::microseconds, std::chrono::microseconds(0));
+  CURRENT_FIELD_DESCRIPTION(user_code, "The time spent in the user code of the block, its constructor included.");
+};
+
+CURRENT_STRUCT(RipCurrentQueueMetrics) {
+  CURRENT_FIELD(into, std::string);
+  CURRENT_FIELD_DESCRIPTION(into, "The block, simple or composite, the queue passes the messages to.");
+  CURRENT_FIELD(queue, mmq::MMQMetrics);
+};
+
+CURRENT_STRUCT(RipCurrentMetrics) {
+  CURRENT_FIELD(blocks, std::vector<RipCurrentBlockMetrics>);
+  CURRENT_FIELD(queues, std::vector<RipCurrentQueueMetrics>);
+};
+
+// The counters of a user block, updated from the thread the block is run in.
+struct BlockMetricsCounters final {
+  using clock_t = std::chrono::steady_clock;
+
+  std::atomic<uint64_t> messages_in{0u};
+  std::atomic<uint64_t> messages_out{0u};
+  std::atomic<uint64_t> user_code_ns{0u};
+
+  // Runs `f`, the user code, accounting for the time spent in it.
+  template <typename F>
+  auto Timed(F&& f) {
+    struct Timer final {
+      std::atomic<uint64_t>& ns;
+      const clock_t::time_point begin = clock_t::now();
+      ~Timer() { ns += std::chrono::duration_cast<std::chrono::nanoseconds>(clock_t::now() - begin).count(); }
+    } timer{user_code_ns};
+    return f();
+  }
+};
+
+// The metrics of a queue, read from the queue while it is there, and as of its destruction after.
+class QueueMetricsSource final {
+ public:
+  void Attach(std::function<mmq::MMQMetrics()> live) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    live_ = live;
+  }
+
+  void Freeze() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (live_) {
+      frozen_ = live_();
+      live_ = nullptr;
+    }
+  }
+
+  mmq::MMQMetrics Snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return live_ ? live_() : frozen_;
+  }
+
+  // The recorder for a queue of `capacity` messages to update, see "queue.h".
+  std::shared_ptr<mmq::impl::MMQMetricsRecorder> Recorder(uint64_t capacity) {
+    auto recorder = std::make_shared<mmq::impl::MMQMetricsRecorder>(capacity);
+    Attach([recorder]() { return recorder->Snapshot(); });
+    return recorder;
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::function<mmq::MMQMetrics()> live_;
+  mmq::MMQMetrics frozen_;
+};
+
+// The blocks and the queues of a flow, in the order they have been started in, the downstream ones first.
+class MetricsRegistry final {
+ public:
+  std::shared_ptr<BlockMetricsCounters> AddBlock(const std::string& block, const std::string& source) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    blocks_.push_back(Block{block, source, std::make_shared<BlockMetricsCounters>()});
+    return blocks_.back().counters;
+  }
+
+  std::shared_ptr<QueueMetricsSource> AddQueue(const std::string& into) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queues_.push_back(Queue{into, std::make_shared<QueueMetricsSource>()});
+    return queues_.back().source;
+  }
+
+  RipCurrentMetrics Snapshot() const {
+    RipCurrentMetrics metrics;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Block& e : blocks_) {
+      metrics.blocks.emplace_back();
+      RipCurrentBlockMetrics& block = metrics.blocks.back();
+      block.block = e.block;
+      block.source = e.source;
+      block.messages_in = e.counters->messages_in.load();
+      block.messages_out = e.counters->messages_out.load();
+      block.user_code = std::chrono::microseconds(e.counters->user_code_ns.load() / 1000u);
+    }
+    for (const Queue& e : queues_) {
+      metrics.queues.emplace_back();
+      metrics.queues.back().into = e.into;
+      metrics.queues.back().queue = e.source->Snapshot();
+    }
+    return metrics;
+  }
+
+ private:
+  struct Block final {
+    std::string block;
+    std::string source;
+    std::shared_ptr<BlockMetricsCounters> counters;
+  };
+  struct Queue final {
+    std::string into;
+    std::shared_ptr<QueueMetricsSource> source;
+  };
+
+  mutable std::mutex mutex_;
+  std::vector<Block> blocks_;
+  std::vector<Queue> queues_;
+};
+
+// Adds `metrics` to the snapshot of the process-wide metrics registry, labeled `flow="<flow>"`, and by the blocks.
+inline void AddRipCurrentMetrics(current::metrics::MetricsSnapshot& snapshot,
+                                 const std::string& flow,
+                                 const RipCurrentMetrics& metrics) {
+  using namespace current::metrics;
+  for (const RipCurrentBlockMetrics& block : metrics.blocks) {
+    const labels_t labels = {{"flow", flow}, {"block", block.block}, {"source", block.source}};
+    AddCounter(snapshot, "ripcurrent_messages_in_total", labels, block.messages_in, "The messages passed to it.");
+    AddCounter(snapshot, "ripcurrent_messages_out_total", labels, block.messages_out, "The messages it emitted.");
+    AddCounter(snapshot,
+               "ripcurrent_user_code_us_total",
+               labels,
+               static_cast<double>(block.user_code.count()),
+               "The time spent in the user code of the block.");
+  }
+  for (const RipCurrentQueueMetrics& queue : metrics.queues) {
+    mmq::AddMMQMetrics(snapshot, {{"flow", flow}, {"queue", queue.into}}, queue.queue);
+  }
+}
+
+}  // namespace ripcurrent
+}  // namespace current
+
+#endif  // CURRENT_RIPCURRENT_METRICS_H
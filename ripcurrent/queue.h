@@ -0,0 +1,136 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// The bounded queue to hand the messages over from one RipCurrent block to another in the threaded mode.
+//
+// The messages are kept in the same ring as the one of `LockFreeMMQ`, see "blocks/mmq/ring.h", holding up to
+// `capacity` messages. The publishers claim the positions in the ring with an atomic increment, so no mutex is taken
+// while pushing, unless the consumer thread is parked waiting for the messages, or the publisher has to wait for
+// the room in the ring. Thus a block that emits faster than the next one can process is slowed down instead of
+// the queue growing.
+//
+// The consumer thread is owned by the queue. The destructor lets the consumer process everything pushed before
+// returning.
+//
+// If given the recorder, the queue keeps the same metrics as MMQ does, see "blocks/mmq/metrics.h".
+
+#ifndef CURRENT_RIPCURRENT_QUEUE_H
+#define CURRENT_RIPCURRENT_QUEUE_H
+
+#include "../port.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../blocks/mmq/metrics.h"
+#include "../blocks/mmq/ring.h"
+
+namespace current {
+namespace ripcurrent {
+
+template <typename T, typename CONSUMER>
+class BoundedQueue final {
+ public:
+  BoundedQueue(CONSUMER& consumer,
+               size_t capacity,
+               std::shared_ptr<mmq::impl::MMQMetricsRecorder> metrics = nullptr)
+      : consumer_(consumer),
+        ring_(capacity),
+        metrics_(metrics),
+        consumer_thread_(&BoundedQueue::ConsumerThread, this) {}
+
+  ~BoundedQueue() {
+    ring_.Stop();
+    consumer_thread_.join();
+  }
+
+  // THREAD SAFE. Blocks the calling thread while the ring is full.
+  void Push(T&& x) {
+    const uint64_t position = head_.fetch_add(1u);
+    if (!ring_.HasRoom(position)) {
+      const auto wait_begin = mmq::impl::MMQMetricsRecorder::Now();
+      ring_.WaitForRoom([this, position]() { return ring_.HasRoom(position); });
+      if (metrics_) {
+        metrics_->Blocked(wait_begin);
+      }
+    }
+    Slot& slot = ring_[position];
+    slot.value = std::move(x);
+    if (metrics_) {
+      slot.published_at = mmq::impl::MMQMetricsRecorder::Now();
+      metrics_->Published();
+    }
+    ring_.MarkReady(position);
+  }
+
+ private:
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue(BoundedQueue&&) = delete;
+  void operator=(const BoundedQueue&) = delete;
+  void operator=(BoundedQueue&&) = delete;
+
+  struct Slot {
+    std::atomic<uint64_t> ready{0u};
+    mmq::impl::MMQMetricsRecorder::clock_t::time_point published_at;
+    T value;
+  };
+
+  void ConsumerThread() {
+    // The `tail` position is local to the processing thread.
+    uint64_t tail = 0u;
+    std::vector<Slot*> run;
+    // Once the queue is being destructed, everything pushed before is still processed.
+    while (ring_.WaitForReady(tail)) {
+      tail = ring_.CollectReady(tail, run);
+      if (metrics_) {
+        metrics_->Consuming(run);
+      }
+      for (Slot* slot : run) {
+        consumer_(std::move(slot->value));
+      }
+      run.clear();
+      ring_.Release(tail);
+    }
+  }
+
+  CONSUMER& consumer_;
+
+  mmq::impl::MPSCRing<Slot> ring_;
+
+  const std::shared_ptr<mmq::impl::MMQMetricsRecorder> metrics_;
+
+  // The position to be claimed by the next message.
+  alignas(64) std::atomic<uint64_t> head_{0u};
+
+  // The thread in which the consuming process is running. Declared last to be started last.
+  std::thread consumer_thread_;
+};
+
+}  // namespace ripcurrent
+}  // namespace current
+
+#endif  // CURRENT_RIPCURRENT_QUEUE_H
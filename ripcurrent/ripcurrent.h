@@ -33,6 +33,12 @@ SOFTWARE.
 // Finally, the `scope` variable can be called `.Async()` on, which eliminates the need to explicitly call `.Join()`
 // at the end of its lifetime; and the syntax of `auto scope = (...).RipCurrent().Async();` is supported as well.
 //
+// By default, each `|` is backed by an MMPQ with its own thread, and the blocks combined with `+` share the thread
+// of their input. With `(...).RipCurrent(current::ripcurrent::Threaded())`, each `|`, as well as each `+` branch that
+// accepts messages, is backed by a bounded lock-free queue with its own thread instead, see "queue.h". The blocks of
+// a pipeline and the branches of a fan-out then run in parallel, and the blocks emitting into a full queue wait.
+// Adjacent blocks can also be fused with `&` instead of `|`, to have the messages passed right on, with no queue.
+//
 // HI-PRI:
 // TOOD(dkorolev): Add `RipCurrent/builtin` for our standard flow blocks library.
 //                 Some `ParseFileByLines<T>()`, `StreamSubscriber<T>()`, `Dump<T>()`, `CountDistinct<T>()` would be
@@ -47,10 +53,15 @@ SOFTWARE.
 
 #include "../port.h"
 
+#include "metrics.h"
+#include "queue.h"
 #include "types.h"
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <sstream>
@@ -81,6 +92,7 @@ struct Definition {
   std::vector<std::pair<std::string, FileLine>> sources;
 
   struct Pipe final {};  // A helper to describe a composite block built with '|'.
+  struct Fuse final {};  // A helper to describe a composite block built with '&'.
   struct Plus final {};  // A helper to describe a composite block built with '+'.
 
   static std::vector<std::pair<std::string, FileLine>> CombineSources(const Definition& a, const Definition& b) {
@@ -99,6 +111,8 @@ struct Definition {
       : statement(statement), sources({{statement, FileLine{file, line}}}) {}
   Definition(Pipe, const Definition& from, const Definition& into)
       : statement(from.statement + " | " + into.statement), sources(CombineSources(from, into)) {}
+  Definition(Fuse, const Definition& from, const Definition& into)
+      : statement(from.statement + " & " + into.statement), sources(CombineSources(from, into)) {}
   Definition(Plus, const Definition& a, const Definition& b)
       : statement(a.statement + " + " + b.statement), sources(CombineSources(a, b)) {}
   virtual ~Definition() = default;
@@ -217,6 +231,54 @@ class SharedDefinition<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>> {
   mutable std::shared_ptr<impl_t> unique_definition_;
 };
 
+// How the RipCurrent flow is run: with an MMPQ behind each `|`, or with the blocks on their own threads,
+// connected by bounded queues of `queue_capacity` messages each. Also, whether to collect the metrics, see "metrics.h".
+enum class ExecutionMode : int { MMPQ = 0, Threaded = 1 };
+
+struct ExecutionOptions final {
+  ExecutionMode mode = ExecutionMode::MMPQ;
+  size_t queue_capacity = 1024u;
+  bool collect_metrics = false;
+  std::shared_ptr<MetricsRegistry> metrics;  // Set by `RipCurrent()` for the run, if `collect_metrics` is.
+
+  ExecutionOptions WithMetrics() const {
+    ExecutionOptions options = *this;
+    options.collect_metrics = true;
+    return options;
+  }
+};
+
+inline ExecutionOptions Threaded(size_t queue_capacity = 1024u) {
+  ExecutionOptions options;
+  options.mode = ExecutionMode::Threaded;
+  options.queue_capacity = queue_capacity;
+  return options;
+}
+
+// A batch of messages of the same type, emitted at once with `emit_batch<>` or `post_batch<>`. The batch is passed
+// between the blocks as a single message, with one timestamp, and thus one head update, for all of its messages.
+// The blocks that define `f_batch(std::vector<T>&&)` receive the batches of `T` as they are, and the other blocks
+// receive the messages of the batch one by one.
+template <typename T>
+struct MessagesBatch final : CurrentSuper {
+  std::vector<T> messages;
+  explicit MessagesBatch(std::vector<T>&& messages) : messages(std::move(messages)) {}
+};
+
+template <typename T>
+struct BatchedMessageTypeImpl {
+  using type = T;
+};
+
+template <typename T>
+struct BatchedMessageTypeImpl<MessagesBatch<T>> {
+  using type = T;
+};
+
+// The type of the messages of the batch, or the type itself for the individual messages.
+template <typename T>
+using BatchedMessageType = typename BatchedMessageTypeImpl<T>::type;
+
 // The interfaces to pass messages between the blocks. There are two: an asynchronous one and a synchronous one.
 // The asynchronous one, which captures thread-unsafe messages from the user code, is `BlockOutgoingInterface`.
 // The synchronous one, which thread-safely lines up the messages for the user code, is `BlockIncomingInterface'.
@@ -229,6 +291,9 @@ class GenericBlockOutgoingInterface {
   virtual void OnThreadUnsafeEmitted(movable_message_t&&, std::chrono::microseconds) = 0;
   virtual void OnThreadUnsafeScheduled(movable_message_t&&, std::chrono::microseconds) = 0;
   virtual void OnThreadUnsafeHeadUpdated(std::chrono::microseconds) = 0;
+  // `emit<>` leaves it to the receiving end to pick the timestamp, to keep the timestamps from concurrently emitting
+  // blocks increasing. Unless overridden, it is the current time.
+  virtual void OnThreadUnsafeEmittedNow(movable_message_t&& x) { OnThreadUnsafeEmitted(std::move(x), time::Now()); }
 };
 
 template <class>
@@ -313,16 +378,38 @@ class RipCurrentScope final {
  public:
   using scope_t = SubCurrentScope<LHSTypes<>, RHSTypes<>>;
 
-  RipCurrentScope(std::shared_ptr<scope_t> scope, const std::string& description_as_text)
-      : scope_(scope), legitimately_terminated_(false), description_as_text_(description_as_text) {}
+  RipCurrentScope(std::shared_ptr<scope_t> scope,
+                  const std::string& description_as_text,
+                  std::shared_ptr<MetricsRegistry> metrics = nullptr)
+      : scope_(scope),
+        legitimately_terminated_(false),
+        description_as_text_(description_as_text),
+        metrics_(metrics) {}
 
   RipCurrentScope(RipCurrentScope&& rhs)
       : scope_(std::move(rhs.scope_)),
         legitimately_terminated_(rhs.legitimately_terminated_),
-        description_as_text_(std::move(rhs.description_as_text_)) {
+        description_as_text_(std::move(rhs.description_as_text_)),
+        metrics_(std::move(rhs.metrics_)) {
     rhs.legitimately_terminated_ = true;
   }
 
+  // THREAD SAFE. The metrics of the flow, empty unless requested with `ExecutionOptions::WithMetrics()`.
+  // After `Join()`, the final ones.
+  RipCurrentMetrics Metrics() const { return metrics_ ? metrics_->Snapshot() : RipCurrentMetrics(); }
+
+  // THREAD SAFE. Publishes `Metrics()` into the process-wide metrics registry, for as long as the returned scope
+  // is alive, which may be longer than the flow is run for.
+  [[nodiscard]] current::metrics::CollectorScope PublishMetrics(
+      const std::string& flow, current::metrics::Registry& registry = current::metrics::ProcessMetrics()) const {
+    std::shared_ptr<MetricsRegistry> metrics = metrics_;
+    return registry.AddCollector([flow, metrics](current::metrics::MetricsSnapshot& snapshot) {
+      if (metrics) {
+        AddRipCurrentMetrics(snapshot, flow, metrics->Snapshot());
+      }
+    });
+  }
+
   void Join() {
     if (legitimately_terminated_) {
       current::Singleton<RipCurrentMockableErrorHandler>().HandleError(
@@ -355,6 +442,7 @@ class RipCurrentScope final {
   std::shared_ptr<scope_t> scope_;
   bool legitimately_terminated_ = false;
   std::string description_as_text_;
+  std::shared_ptr<MetricsRegistry> metrics_;
 };
 
 // Template logic to wrap runnable RipCurrent flows into abstract classes of templated types,
@@ -374,7 +462,8 @@ class AbstractCurrent<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>>
   virtual ~AbstractCurrent() = default;
 
   virtual std::shared_ptr<SubCurrentScope<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>>> Run(
-      std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>>) const = 0;
+      std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>>,
+      const ExecutionOptions&) const = 0;
 
   struct Traits final {
     using input_t = LHSTypes<LHS_TYPES...>;
@@ -399,17 +488,24 @@ class SharedCurrent<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>>
   explicit SharedCurrent(std::shared_ptr<super_t> spawner) : super_t(spawner->GetUniqueDefinition()), super_(spawner) {}
 
   std::shared_ptr<SubCurrentScope<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>>> Run(
-      std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>> next) const override {
-    return super_->Run(next);
+      std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>> next,
+      const ExecutionOptions& options) const override {
+    return super_->Run(next, options);
   }
 
   // User-facing `RipCurrent()` method, only for "closed", end-to-end flows.
   template <int IN_N = sizeof...(LHS_TYPES), int OUT_N = sizeof...(RHS_TYPES)>
-  std::enable_if_t<IN_N == 0 && OUT_N == 0, RipCurrentScope> RipCurrent() const {
+  std::enable_if_t<IN_N == 0 && OUT_N == 0, RipCurrentScope> RipCurrent(
+      const ExecutionOptions& options = ExecutionOptions()) const {
     std::ostringstream os;
     super_t::GetDefinition().FullDescription(os);
 
-    return RipCurrentScope(Run(std::make_shared<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<>>>()), os.str());
+    ExecutionOptions run_options = options;
+    run_options.metrics = options.collect_metrics ? std::make_shared<MetricsRegistry>() : nullptr;
+    return RipCurrentScope(
+        Run(std::make_shared<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<>>>(), run_options),
+        os.str(),
+        run_options.metrics);
   }
 
  private:
@@ -492,8 +588,7 @@ class CallsGeneratingBlock<EmittableTypes<EMITTED_TYPES...>> : public GenericCal
   template <typename T, typename... ARGS>
   std::enable_if_t<TypeListContains<TypeListImpl<EMITTED_TYPES...>, T>::value> emit(ARGS&&... args) const {
     // A seemingly unnecessary `release()` is due to `std::make_unique()` not supporting a custom deleter. -- D.K
-    handler_->OnThreadUnsafeEmitted(movable_message_t(std::make_unique<T>(std::forward<ARGS>(args)...).release()),
-                                    time::Now());
+    handler_->OnThreadUnsafeEmittedNow(movable_message_t(std::make_unique<T>(std::forward<ARGS>(args)...).release()));
   }
 
   template <typename T, typename... ARGS>
@@ -510,6 +605,21 @@ class CallsGeneratingBlock<EmittableTypes<EMITTED_TYPES...>> : public GenericCal
     handler_->OnThreadUnsafeScheduled(movable_message_t(std::make_unique<T>(std::forward<ARGS>(args)...).release()), t);
   }
 
+  template <typename T>
+  std::enable_if_t<TypeListContains<TypeListImpl<EMITTED_TYPES...>, T>::value> emit_batch(std::vector<T> xs) const {
+    if (!xs.empty()) {
+      handler_->OnThreadUnsafeEmittedNow(movable_message_t(new MessagesBatch<T>(std::move(xs))));
+    }
+  }
+
+  template <typename T>
+  std::enable_if_t<TypeListContains<TypeListImpl<EMITTED_TYPES...>, T>::value> post_batch(std::chrono::microseconds t,
+                                                                                          std::vector<T> xs) const {
+    if (!xs.empty()) {
+      handler_->OnThreadUnsafeEmitted(movable_message_t(new MessagesBatch<T>(std::move(xs))), t);
+    }
+  }
+
   void head(std::chrono::microseconds t) const { handler_->OnThreadUnsafeHeadUpdated(t); }
 
  private:
@@ -537,7 +647,7 @@ class UserClassInstantiator<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>, USER
       : scope_(&impl_, next.get()), impl_(std::forward<ARGS>(args)...) {}
 
   void OnThreadSafeMessage(movable_message_t&& x) override {
-    RTTIDynamicCall<TypeListImpl<LHS_TYPES...>, CurrentSuper>(std::move(*x), *this);
+    RTTIDynamicCall<TypeListImpl<LHS_TYPES..., MessagesBatch<LHS_TYPES>...>, CurrentSuper>(std::move(*x), *this);
   }
 
   template <typename X>
@@ -545,6 +655,11 @@ class UserClassInstantiator<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>, USER
     impl_.f(std::forward<X>(x));
   }
 
+  template <typename X>
+  void operator()(MessagesBatch<X>&& batch) {
+    PassBatch<X>(std::move(batch.messages), 0);
+  }
+
   void operator()(CurrentSuper&&) {
     // Should define this method to make sure the `RTTIDynamicCall<>` construct compiles.
     // Given type list magic is done at compile time, this method would never get called.
@@ -552,6 +667,19 @@ class UserClassInstantiator<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>, USER
   }
 
  private:
+  // The `int` overload, preferred, is only there if the user code accepts the batches of `X`.
+  template <typename X, typename U = USER_CLASS>
+  auto PassBatch(std::vector<X>&& xs, int) -> decltype(std::declval<U&>().f_batch(std::move(xs))) {
+    return impl_.f_batch(std::move(xs));
+  }
+
+  template <typename X>
+  void PassBatch(std::vector<X>&& xs, long) {
+    for (X& x : xs) {
+      impl_.f(std::move(x));
+    }
+  }
+
   const BlockCallsConsumersManager::CallsConsumerLifetimeScope scope_;
   USER_CLASS impl_;
 };
@@ -602,24 +730,68 @@ class UserCodeInstantiator<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>, USER_
    public:
     virtual ~Scope() = default;
 
-    explicit Scope(const current::LazilyInstantiated<
-                       UserClassInstantiator<instantiator_input_t, instantiator_output_t, USER_CLASS>,
-                       std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>>>& lazy_instance,
-                   std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>> next)
-        : spawned_user_class_instance_(lazy_instance.InstantiateAsUniquePtrWithExtraParameter(next)) {}
+    Scope(const current::LazilyInstantiated<
+              UserClassInstantiator<instantiator_input_t, instantiator_output_t, USER_CLASS>,
+              std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>>>& lazy_instance,
+          std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>> next,
+          std::shared_ptr<BlockMetricsCounters> counters)
+        : counters_(counters),
+          next_(counters_ ? std::make_shared<CountingOutgoing>(next, counters_) : next),
+          spawned_user_class_instance_(counters_ ? counters_->Timed([&]() {
+            return lazy_instance.InstantiateAsUniquePtrWithExtraParameter(next_);
+          })
+                                                 : lazy_instance.InstantiateAsUniquePtrWithExtraParameter(next_)) {}
 
     void OnThreadSafeMessage(movable_message_t&& x) override {
-      spawned_user_class_instance_->OnThreadSafeMessage(std::move(x));
+      if (counters_) {
+        ++counters_->messages_in;
+        counters_->Timed([&]() { spawned_user_class_instance_->OnThreadSafeMessage(std::move(x)); });
+      } else {
+        spawned_user_class_instance_->OnThreadSafeMessage(std::move(x));
+      }
     }
 
    private:
+    // Counts the messages emitted by the user code, to collect the metrics of the block.
+    struct CountingOutgoing final : BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>> {
+      std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>> next;
+      std::shared_ptr<BlockMetricsCounters> counters;
+      CountingOutgoing(std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>> next,
+                       std::shared_ptr<BlockMetricsCounters> counters)
+          : next(next), counters(counters) {}
+      void OnThreadUnsafeEmitted(movable_message_t&& x, std::chrono::microseconds t) override {
+        ++counters->messages_out;
+        next->OnThreadUnsafeEmitted(std::move(x), t);
+      }
+      void OnThreadUnsafeScheduled(movable_message_t&& x, std::chrono::microseconds t) override {
+        ++counters->messages_out;
+        next->OnThreadUnsafeScheduled(std::move(x), t);
+      }
+      void OnThreadUnsafeHeadUpdated(std::chrono::microseconds t) override { next->OnThreadUnsafeHeadUpdated(t); }
+      void OnThreadUnsafeEmittedNow(movable_message_t&& x) override {
+        ++counters->messages_out;
+        next->OnThreadUnsafeEmittedNow(std::move(x));
+      }
+    };
+
+    // Construction / destruction order matters: { counters, next, user code }.
+    std::shared_ptr<BlockMetricsCounters> counters_;
+    std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>> next_;
     std::unique_ptr<UserClassInstantiator<instantiator_input_t, instantiator_output_t, USER_CLASS>>
         spawned_user_class_instance_;
   };
 
   std::shared_ptr<SubCurrentScope<instantiator_input_t, instantiator_output_t>> Run(
-      std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>> next) const override {
-    return std::make_shared<Scope>(lazy_instance_, next);
+      std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>> next,
+      const ExecutionOptions& options) const override {
+    std::shared_ptr<BlockMetricsCounters> counters;
+    if (options.metrics) {
+      const auto& definition = this->GetDefinition();
+      const FileLine& source = definition.sources.front().second;
+      counters = options.metrics->AddBlock(definition.statement,
+                                           std::string(source.file) + ':' + current::ToString(source.line));
+    }
+    return std::make_shared<Scope>(lazy_instance_, next, counters);
   }
 
  private:
@@ -668,18 +840,22 @@ class UserCodeImpl<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>, USER_CLASS>
   USER_CLASS UnderlyingType() const;
 };
 
-// The implementation of the `A | B` combiner building block.
-template <class LHS_TYPELIST, class RHS_TYPELIST, class VIA_TYPELIST>
+// The implementation of the `A | B` and `A & B` combiner building blocks.
+// The latter, the fused sequence, passes the messages emitted by `A` right on to `B`, in the thread of `A`, with no
+// queue, thread, or timestamps involved, regardless of the execution mode. It is meant for the tiny transforms,
+// which cost less than passing a message through a queue does. As `B` is called from wherever `A` emits from,
+// the origin blocks that emit from more than one thread should not be fused with the next block.
+template <class LHS_TYPELIST, class RHS_TYPELIST, class VIA_TYPELIST, class COMBINER = Definition::Pipe>
 class SharedSequenceImpl;
 
-template <class... LHS_TYPES, class... RHS_TYPES, typename VIA_X, typename... VIA_XS>
-class SharedSequenceImpl<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>, VIATypes<VIA_X, VIA_XS...>>
+template <class... LHS_TYPES, class... RHS_TYPES, typename VIA_X, typename... VIA_XS, class COMBINER>
+class SharedSequenceImpl<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>, VIATypes<VIA_X, VIA_XS...>, COMBINER>
     : public AbstractCurrent<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>> {
  public:
   SharedSequenceImpl(SharedCurrent<LHSTypes<LHS_TYPES...>, RHSTypes<VIA_X, VIA_XS...>> from,
                      SharedCurrent<LHSTypes<VIA_X, VIA_XS...>, RHSTypes<RHS_TYPES...>> into)
       : AbstractCurrent<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>>(
-            Definition(Definition::Pipe(), from.GetDefinition(), into.GetDefinition())),
+            Definition(COMBINER(), from.GetDefinition(), into.GetDefinition())),
         from_(from),
         into_(into) {
     from.MarkAs(BlockUsageBit::UsedInLargerBlock);
@@ -691,25 +867,177 @@ class SharedSequenceImpl<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>, VIAType
     virtual ~Scope() = default;
 
     Scope(const SharedSequenceImpl* self,
-          std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>> next)
+          std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>> next,
+          const ExecutionOptions& options)
         : next_(next),
-          into_(self->Into().Run(next_)),
-          into_mmpq_(std::make_shared<MMPQWrapper>(into_)),
-          from_(self->From().Run(into_mmpq_)) {
+          into_(self->Into().Run(next_, options)),
+          into_queue_(MakeQueue(into_, options, self->Into().GetDefinition().statement)),
+          from_(self->From().Run(into_queue_, options)) {
       self->MarkAs(BlockUsageBit::HasBeenRun);
     }
 
     void OnThreadSafeMessage(movable_message_t&& x) override { from_->OnThreadSafeMessage(std::move(x)); }
 
    private:
+    using via_outgoing_t = BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<VIA_X, VIA_XS...>>;
+    using via_incoming_t = BlockIncomingInterface<ThreadSafeIncomingTypes<VIA_X, VIA_XS...>>;
+
+    static std::shared_ptr<via_outgoing_t> MakeQueue(std::shared_ptr<via_incoming_t> destination,
+                                                     const ExecutionOptions& options,
+                                                     const std::string& into) {
+      if (std::is_same_v<COMBINER, Definition::Fuse>) {
+        return std::make_shared<DirectPassOn>(destination);
+      }
+      std::shared_ptr<QueueMetricsSource> metrics = options.metrics ? options.metrics->AddQueue(into) : nullptr;
+      if (options.mode == ExecutionMode::Threaded) {
+        return std::make_shared<BoundedQueueWrapper>(destination, options.queue_capacity, metrics);
+      } else {
+        return std::make_shared<MMPQWrapper>(destination, metrics);
+      }
+    }
+
+    // The fused sequence passes the messages on as they are emitted or posted. Nothing is held, so the head is moot.
+    class DirectPassOn final : public via_outgoing_t {
+     public:
+      explicit DirectPassOn(std::shared_ptr<via_incoming_t> destination) : destination_(destination) {}
+
+      void OnThreadUnsafeEmitted(movable_message_t&& x, std::chrono::microseconds) override {
+        destination_->OnThreadSafeMessage(std::move(x));
+      }
+
+      void OnThreadUnsafeEmittedNow(movable_message_t&& x) override {
+        destination_->OnThreadSafeMessage(std::move(x));
+      }
+
+      void OnThreadUnsafeScheduled(movable_message_t&&, std::chrono::microseconds) override {
+        current::Singleton<RipCurrentMockableErrorHandler>().HandleError(
+            "Attempted to `schedule<>` a message across `&`, which has no queue to hold it. Use `|` instead.\n");
+      }
+
+      void OnThreadUnsafeHeadUpdated(std::chrono::microseconds) override {}
+
+     private:
+      std::shared_ptr<via_incoming_t> destination_;
+    };
+
+    // The threaded mode counterpart of `MMPQWrapper`, with the same `schedule<>` and `head<>` semantics.
+    // The timestamps are checked and the head is moved on the emitting side, with a compare-and-swap, and the messages
+    // scheduled past the head are held by the consuming thread until the head reaches them. Thus the messages that
+    // are emitted or posted, not scheduled, go through the bounded queue with no locks taken, and in order.
+    // The scheduled messages the head has not reached by the time the flow is done with are dropped.
+    class BoundedQueueWrapper final : public via_outgoing_t {
+     public:
+      BoundedQueueWrapper(std::shared_ptr<via_incoming_t> destination,
+                          size_t capacity,
+                          std::shared_ptr<QueueMetricsSource> metrics)
+          : processor_(destination), queue_(processor_, capacity, metrics ? metrics->Recorder(capacity) : nullptr) {}
+
+      void OnThreadUnsafeEmitted(movable_message_t&& x, std::chrono::microseconds t) override {
+        if (AdvanceHead(t)) {
+          queue_.Push(Envelope(std::move(x), t, false));
+        }
+      }
+
+      // The timestamp of an emitted message is the current time, or right past the head, whichever is greater,
+      // as the blocks that emit into the same queue run on different threads.
+      void OnThreadUnsafeEmittedNow(movable_message_t&& x) override {
+        const int64_t now = time::Now().count();
+        int64_t head = head_us_.load();
+        int64_t t;
+        do {
+          t = std::max(now, head + 1);
+        } while (!head_us_.compare_exchange_weak(head, t));
+        queue_.Push(Envelope(std::move(x), std::chrono::microseconds(t), false));
+      }
+
+      void OnThreadUnsafeScheduled(movable_message_t&& x, std::chrono::microseconds t) override {
+        queue_.Push(Envelope(std::move(x), t, true));
+      }
+
+      void OnThreadUnsafeHeadUpdated(std::chrono::microseconds t) override {
+        if (AdvanceHead(t)) {
+          queue_.Push(Envelope(nullptr, t, false));
+        }
+      }
+
+     private:
+      // The head update, if `message` is null, or the message emitted or scheduled at `t`.
+      struct Envelope {
+        movable_message_t message;
+        std::chrono::microseconds t;
+        bool scheduled = false;
+        Envelope() = default;
+        Envelope(movable_message_t&& message, std::chrono::microseconds t, bool scheduled)
+            : message(std::move(message)), t(t), scheduled(scheduled) {}
+      };
+
+      bool AdvanceHead(std::chrono::microseconds t) {
+        int64_t head = head_us_.load();
+        do {
+          if (!(t.count() > head)) {
+            current::Singleton<RipCurrentMockableErrorHandler>().HandleError(
+                ss::InconsistentTimestampException(std::chrono::microseconds(head + 1), t).DetailedDescription());
+            return false;
+          }
+        } while (!head_us_.compare_exchange_weak(head, t.count()));
+        return true;
+      }
+
+      // Runs in the thread of the queue. Passes on the messages in the order of their timestamps, then arrival.
+      class Processor final {
+       public:
+        explicit Processor(std::shared_ptr<via_incoming_t> destination) : destination_(destination) {}
+
+        void operator()(Envelope&& e) {
+          if (e.scheduled) {
+            if (e.t <= head_) {
+              destination_->OnThreadSafeMessage(std::move(e.message));
+            } else {
+              scheduled_.emplace(std::make_pair(e.t, ++scheduled_count_), std::move(e.message));
+            }
+          } else {
+            if (e.t > head_) {
+              head_ = e.t;
+            }
+            while (!scheduled_.empty() && scheduled_.begin()->first.first <= head_) {
+              destination_->OnThreadSafeMessage(std::move(scheduled_.begin()->second));
+              scheduled_.erase(scheduled_.begin());
+            }
+            if (e.message) {
+              destination_->OnThreadSafeMessage(std::move(e.message));
+            }
+          }
+        }
+
+       private:
+        std::shared_ptr<via_incoming_t> destination_;
+        std::chrono::microseconds head_ = std::chrono::microseconds(-1);
+        uint64_t scheduled_count_ = 0u;
+        std::map<std::pair<std::chrono::microseconds, uint64_t>, movable_message_t> scheduled_;
+      };
+
+      std::atomic<int64_t> head_us_{-1};
+      Processor processor_;
+      BoundedQueue<Envelope, Processor> queue_;
+    };
+
     class MMPQWrapper final : public BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<VIA_X, VIA_XS...>> {
      public:
-      explicit MMPQWrapper(
-          std::shared_ptr<BlockIncomingInterface<ThreadSafeIncomingTypes<VIA_X, VIA_XS...>>> destination)
-          : single_threaded_processor_(waitable_counters_, destination), mmpq_(single_threaded_processor_) {}
+      MMPQWrapper(std::shared_ptr<BlockIncomingInterface<ThreadSafeIncomingTypes<VIA_X, VIA_XS...>>> destination,
+                  std::shared_ptr<QueueMetricsSource> metrics)
+          : single_threaded_processor_(waitable_counters_, destination),
+            mmpq_(single_threaded_processor_),
+            metrics_(metrics) {
+        if (metrics_) {
+          metrics_->Attach([this]() { return mmpq_.Metrics(); });
+        }
+      }
 
       ~MMPQWrapper() {
         waitable_counters_.Wait([](const ThreadMessageCounters& counters) { return counters.ProcessedEverything(); });
+        if (metrics_) {
+          metrics_->Freeze();
+        }
       }
 
       void OnThreadUnsafeEmitted(movable_message_t&& x, std::chrono::microseconds t) override {
@@ -778,18 +1106,20 @@ class SharedSequenceImpl<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>, VIAType
       WaitableAtomic<ThreadMessageCounters> waitable_counters_;
       current::ss::EntrySubscriber<SingleThreadedProcessorImpl, movable_message_t> single_threaded_processor_;
       mmq::MMPQ<movable_message_t, current::ss::EntrySubscriber<SingleThreadedProcessorImpl, movable_message_t>> mmpq_;
+      std::shared_ptr<QueueMetricsSource> metrics_;
     };
 
     // Construction / destruction order matters: { next, into, from }.
     std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>> next_;
     std::shared_ptr<SubCurrentScope<LHSTypes<VIA_X, VIA_XS...>, RHSTypes<RHS_TYPES...>>> into_;
-    std::shared_ptr<MMPQWrapper> into_mmpq_;
+    std::shared_ptr<via_outgoing_t> into_queue_;
     std::shared_ptr<SubCurrentScope<LHSTypes<LHS_TYPES...>, RHSTypes<VIA_X, VIA_XS...>>> from_;
   };
 
   std::shared_ptr<SubCurrentScope<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>>> Run(
-      std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>> next) const override {
-    return std::make_shared<Scope>(this, next);
+      std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>> next,
+      const ExecutionOptions& options) const override {
+    return std::make_shared<Scope>(this, next, options);
   }
 
  protected:
@@ -802,18 +1132,19 @@ class SharedSequenceImpl<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>, VIAType
 };
 
 // `SharedSequence` requires `VIA_TYPELIST` to be a nonempty type list.
-// This is enforced by the `operator|()` declaration below.
-template <class LHS_TYPELIST, class RHS_TYPELIST, class VIA_TYPELIST>
+// This is enforced by the `operator|()` and `operator&()` declarations below.
+template <class LHS_TYPELIST, class RHS_TYPELIST, class VIA_TYPELIST, class COMBINER = Definition::Pipe>
 class SharedSequence;
 
-template <class LHS_TYPELIST, class RHS_TYPELIST, typename... VIA_XS>
-class SharedSequence<LHS_TYPELIST, RHS_TYPELIST, VIATypes<VIA_XS...>>
+template <class LHS_TYPELIST, class RHS_TYPELIST, typename... VIA_XS, class COMBINER>
+class SharedSequence<LHS_TYPELIST, RHS_TYPELIST, VIATypes<VIA_XS...>, COMBINER>
     : public SharedCurrent<LHS_TYPELIST, RHS_TYPELIST> {
  public:
   using base_t = SharedCurrent<LHS_TYPELIST, RHS_TYPELIST>;
   SharedSequence(SharedCurrent<LHS_TYPELIST, RHSTypes<VIA_XS...>> from,
                  SharedCurrent<LHSTypes<VIA_XS...>, RHS_TYPELIST> into)
-      : base_t(std::make_shared<SharedSequenceImpl<LHS_TYPELIST, RHS_TYPELIST, VIATypes<VIA_XS...>>>(from, into)) {}
+      : base_t(std::make_shared<SharedSequenceImpl<LHS_TYPELIST, RHS_TYPELIST, VIATypes<VIA_XS...>, COMBINER>>(
+            from, into)) {}
 };
 
 // SharedCurrent sequence combiner, `A | B`.
@@ -823,6 +1154,53 @@ SharedCurrent<LHS_TYPELIST, RHS_TYPELIST> operator|(SharedCurrent<LHS_TYPELIST,
   return SharedSequence<LHS_TYPELIST, RHS_TYPELIST, VIATypes<VIA_X, VIA_XS...>>(from, into);
 }
 
+// SharedCurrent fused sequence combiner, `A & B`. Binds tighter than `|` and looser than `+`.
+template <class LHS_TYPELIST, class RHS_TYPELIST, typename VIA_X, typename... VIA_XS>
+SharedCurrent<LHS_TYPELIST, RHS_TYPELIST> operator&(SharedCurrent<LHS_TYPELIST, RHSTypes<VIA_X, VIA_XS...>> from,
+                                                    SharedCurrent<LHSTypes<VIA_X, VIA_XS...>, RHS_TYPELIST> into) {
+  return SharedSequence<LHS_TYPELIST, RHS_TYPELIST, VIATypes<VIA_X, VIA_XS...>, Definition::Fuse>(from, into);
+}
+
+// In the threaded mode, each block combined with `+` that accepts messages runs on its own thread,
+// with the messages routed to it passed over via a bounded queue.
+template <class LHS_TYPELIST, class RHS_TYPELIST>
+class QueuedSubCurrentScope;
+
+template <class... LHS_TYPES, class... RHS_TYPES>
+class QueuedSubCurrentScope<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>> final
+    : public SubCurrentScope<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>> {
+ public:
+  using scope_t = SubCurrentScope<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>>;
+
+  QueuedSubCurrentScope(std::shared_ptr<scope_t> scope,
+                        size_t capacity,
+                        std::shared_ptr<QueueMetricsSource> metrics = nullptr)
+      : processor_(scope), queue_(processor_, capacity, metrics ? metrics->Recorder(capacity) : nullptr) {}
+
+  void OnThreadSafeMessage(movable_message_t&& x) override { queue_.Push(std::move(x)); }
+
+  static std::shared_ptr<scope_t> WrapIfThreaded(std::shared_ptr<scope_t> scope,
+                                                 const ExecutionOptions& options,
+                                                 const std::string& into) {
+    if (options.mode == ExecutionMode::Threaded && sizeof...(LHS_TYPES)) {
+      return std::make_shared<QueuedSubCurrentScope>(
+          scope, options.queue_capacity, options.metrics ? options.metrics->AddQueue(into) : nullptr);
+    } else {
+      return scope;
+    }
+  }
+
+ private:
+  struct Processor final {
+    explicit Processor(std::shared_ptr<scope_t> scope) : scope(scope) {}
+    void operator()(movable_message_t&& x) { scope->OnThreadSafeMessage(std::move(x)); }
+    std::shared_ptr<scope_t> scope;
+  };
+
+  Processor processor_;
+  BoundedQueue<movable_message_t, Processor> queue_;
+};
+
 // The implementation of the `A + B` combiner building block.
 template <class LHS_TYPELIST, class RHS_TYPELIST, class A_LHS, class A_RHS, class B_LHS, class B_RHS>
 class SharedParallelImpl;
@@ -850,12 +1228,15 @@ class SharedParallelImpl<LHSTypes<AB_LHS...>,
     virtual ~Scope() = default;
 
     Scope(const SharedParallelImpl* self,
-          std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<AB_RHS...>>> next)
+          std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<AB_RHS...>>> next,
+          const ExecutionOptions& options)
         : next_(next),
           next_a_(std::make_shared<PassOnToNextA>(next)),
           next_b_(std::make_shared<PassOnToNextB>(next)),
-          a_(self->A().Run(next_a_)),
-          b_(self->B().Run(next_b_)) {
+          a_(QueuedSubCurrentScope<LHSTypes<A_LHS...>, RHSTypes<A_RHS...>>::WrapIfThreaded(
+              self->A().Run(next_a_, options), options, self->A().GetDefinition().statement)),
+          b_(QueuedSubCurrentScope<LHSTypes<B_LHS...>, RHSTypes<B_RHS...>>::WrapIfThreaded(
+              self->B().Run(next_b_, options), options, self->B().GetDefinition().statement)) {
       self->MarkAs(BlockUsageBit::HasBeenRun);
     }
 
@@ -863,10 +1244,11 @@ class SharedParallelImpl<LHSTypes<AB_LHS...>,
      public:
       explicit Router(Scope* self) : self_(self) {}
 
+      // The batches are routed as they are, by the type of their messages.
       template <typename X>
       void operator()(X&& x) {
-        constexpr bool a = metaprogramming::TypeListContains<TypeListImpl<A_LHS...>, X>::value;
-        constexpr bool b = metaprogramming::TypeListContains<TypeListImpl<B_LHS...>, X>::value;
+        constexpr bool a = metaprogramming::TypeListContains<TypeListImpl<A_LHS...>, BatchedMessageType<X>>::value;
+        constexpr bool b = metaprogramming::TypeListContains<TypeListImpl<B_LHS...>, BatchedMessageType<X>>::value;
         static_assert(a != b, "Type X should be either in A's input, or in B's input, but not both.");
         // This is to be cleaned up. -- D.K., TODO(dkorolev), FIXME DIMA.
         auto y = movable_message_t(std::make_unique<X>(std::move(x)).release());
@@ -887,8 +1269,9 @@ class SharedParallelImpl<LHSTypes<AB_LHS...>,
     };
 
     void OnThreadSafeMessage(movable_message_t&& x) override {
-      RTTIDynamicCall<metaprogramming::TypeListUnion<TypeListImpl<A_LHS...>, TypeListImpl<B_LHS...>>, CurrentSuper>(
-          std::move(*x), Router(this));
+      RTTIDynamicCall<metaprogramming::TypeListUnion<TypeListImpl<A_LHS..., MessagesBatch<A_LHS>...>,
+                                                     TypeListImpl<B_LHS..., MessagesBatch<B_LHS>...>>,
+                      CurrentSuper>(std::move(*x), Router(this));
     }
 
    private:
@@ -903,6 +1286,7 @@ class SharedParallelImpl<LHSTypes<AB_LHS...>,
         next->OnThreadUnsafeScheduled(std::move(x), t);
       }
       void OnThreadUnsafeHeadUpdated(std::chrono::microseconds t) override { next->OnThreadUnsafeHeadUpdated(t); }
+      void OnThreadUnsafeEmittedNow(movable_message_t&& x) override { next->OnThreadUnsafeEmittedNow(std::move(x)); }
     };
     struct PassOnToNextB : BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<B_RHS...>> {
       std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<AB_RHS...>>> next;
@@ -914,6 +1298,7 @@ class SharedParallelImpl<LHSTypes<AB_LHS...>,
         next->OnThreadUnsafeScheduled(std::move(x), t);
       }
       void OnThreadUnsafeHeadUpdated(std::chrono::microseconds t) override { next->OnThreadUnsafeHeadUpdated(t); }
+      void OnThreadUnsafeEmittedNow(movable_message_t&& x) override { next->OnThreadUnsafeEmittedNow(std::move(x)); }
     };
 
     // Construction / destruction order matters: { `next_a_`, `next_b_` } before { `a_`, `b_` }.
@@ -925,8 +1310,9 @@ class SharedParallelImpl<LHSTypes<AB_LHS...>,
   };
 
   std::shared_ptr<SubCurrentScope<LHSTypes<AB_LHS...>, RHSTypes<AB_RHS...>>> Run(
-      std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<AB_RHS...>>> next) const override {
-    return std::make_shared<Scope>(this, next);
+      std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<AB_RHS...>>> next,
+      const ExecutionOptions& options) const override {
+    return std::make_shared<Scope>(this, next, options);
   }
 
  protected:
@@ -985,6 +1371,10 @@ struct PassImpl final : UserCode<LHSTypes<T, TS...>, RHSTypes<T, TS...>, PassImp
   void f(X&& x) {
     super_t::template emit<current::decay_t<X>>(std::forward<X>(x));
   }
+  template <typename X>
+  void f_batch(std::vector<X>&& xs) {
+    super_t::template emit_batch<X>(std::move(xs));
+  }
 };
 
 // Note: `struct Pass` will only be used if the user chooses it over the `RIPCURRENT_PASS` one. The latter option
@@ -1008,6 +1398,8 @@ struct DropImpl final : UserCode<LHSTypes<T, TS...>, RHSTypes<>, DropImplClassNa
   void f(X&& x) {
     static_cast<void>(x);  // It is drop. Drop, it is.
   }
+  template <typename X>
+  void f_batch(std::vector<X>&&) {}
 };
 
 // Note: `struct Drop` will only be used if the user chooses it over the `RIPCURRENT_PASS` one. The latter option
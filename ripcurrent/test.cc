@@ -1031,3 +1031,421 @@ TEST(RipCurrent, TemplatedFlow) {
   ((TemplatedEmitter(Integer) + TemplatedEmitter(String)) | DumpIntegerAndString(std::ref(result))).RipCurrent().Join();
   EXPECT_EQ("42, 'The Answer'", current::strings::Join(result, ", "));
 }
+
+namespace ripcurrent_unittest {
+
+// clang-format off
+RIPCURRENT_NODE(RCEmitMany, void, Integer) {
+  RCEmitMany(int n) {
+    for (int i = 1; i <= n; ++i) {
+      emit<Integer>(i);
+    }
+  }
+};
+#define RCEmitMany(...) RIPCURRENT_MACRO(RCEmitMany, __VA_ARGS__)
+
+// `RCRendezvousInteger` and `RCRendezvousString` each wait for the other one to have received its message,
+// which only succeeds if they are run in parallel.
+static bool RendezvousOfTwo(std::atomic_int& arrived) {
+  ++arrived;
+  const auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (arrived < 2 && std::chrono::steady_clock::now() < give_up) {
+    std::this_thread::yield();
+  }
+  return arrived == 2;
+}
+
+RIPCURRENT_NODE(RCRendezvousInteger, Integer, ()) {
+  std::atomic_int* arrived;
+  std::atomic_bool* met;
+  RCRendezvousInteger() : arrived(nullptr), met(nullptr) {}  // LCOV_EXCL_LINE
+  RCRendezvousInteger(std::atomic_int& arrived, std::atomic_bool& met) : arrived(&arrived), met(&met) {}
+  void f(Integer) {
+    *met = RendezvousOfTwo(*arrived);
+  }
+};
+#define RCRendezvousInteger(...) RIPCURRENT_MACRO(RCRendezvousInteger, __VA_ARGS__)
+
+RIPCURRENT_NODE(RCRendezvousString, String, ()) {
+  std::atomic_int* arrived;
+  std::atomic_bool* met;
+  RCRendezvousString() : arrived(nullptr), met(nullptr) {}  // LCOV_EXCL_LINE
+  RCRendezvousString(std::atomic_int& arrived, std::atomic_bool& met) : arrived(&arrived), met(&met) {}
+  void f(String) {
+    *met = RendezvousOfTwo(*arrived);
+  }
+};
+#define RCRendezvousString(...) RIPCURRENT_MACRO(RCRendezvousString, __VA_ARGS__)
+// clang-format on
+
+}  // namespace ripcurrent_unittest
+
+TEST(RipCurrent, ThreadedChainFlow) {
+  current::time::ResetToZero();
+
+  using namespace ripcurrent_unittest;
+
+  {
+    std::vector<int> result;
+    (RCEmit(1, 2, 3) | RCMult(2) | RCMult(5) | RCMult(10) | RCDump(std::ref(result)))
+        .RipCurrent(current::ripcurrent::Threaded())
+        .Join();
+    EXPECT_EQ("100,200,300", current::strings::Join(result, ','));
+  }
+
+  {
+    // The queues of four messages each make the emitting blocks wait for the next ones all the time.
+    std::vector<int> result;
+    (RCEmitMany(10000) | RCMult(2) | RCMult(3) | RCDump(std::ref(result)))
+        .RipCurrent(current::ripcurrent::Threaded(4))
+        .Join();
+    ASSERT_EQ(10000u, result.size());
+    for (int i = 0; i < 10000; ++i) {
+      ASSERT_EQ((i + 1) * 6, result[i]);
+    }
+  }
+}
+
+TEST(RipCurrent, Metrics) {
+  current::time::ResetToZero();
+
+  using namespace ripcurrent_unittest;
+
+  for (const auto& options :
+       {current::ripcurrent::ExecutionOptions().WithMetrics(), current::ripcurrent::Threaded(4).WithMetrics()}) {
+    std::vector<int> result;
+    auto scope = (RCEmitMany(1000) | RCMult(2) | RCDump(std::ref(result))).RipCurrent(options);
+    scope.Join();
+    ASSERT_EQ(1000u, result.size());
+
+    const current::ripcurrent::RipCurrentMetrics metrics = scope.Metrics();
+    std::map<std::string, std::pair<uint64_t, uint64_t>> blocks;
+    for (const auto& block : metrics.blocks) {
+      blocks[block.block] = std::make_pair(block.messages_in, block.messages_out);
+      EXPECT_NE(std::string::npos, block.source.find("test.cc:")) << block.source;
+    }
+    ASSERT_EQ(3u, blocks.size());
+    EXPECT_EQ(std::make_pair(uint64_t(0u), uint64_t(1000u)), blocks["RCEmitMany(1000)"]);
+    EXPECT_EQ(std::make_pair(uint64_t(1000u), uint64_t(1000u)), blocks["RCMult(2)"]);
+    EXPECT_EQ(std::make_pair(uint64_t(1000u), uint64_t(0u)), blocks["RCDump(std::ref(result))"]);
+
+    std::map<std::string, current::mmq::MMQMetrics> queues;
+    for (const auto& queue : metrics.queues) {
+      queues[queue.into] = queue.queue;
+    }
+    ASSERT_EQ(2u, queues.size());
+    EXPECT_EQ(1000u, queues["RCMult(2)"].published);
+    EXPECT_EQ(1000u, queues["RCMult(2)"].consumed);
+    EXPECT_EQ(1000u, queues["RCDump(std::ref(result))"].consumed);
+    EXPECT_EQ(0u, queues["RCDump(std::ref(result))"].depth);
+
+    // The metrics serialize to JSON, to be served over HTTP.
+    EXPECT_NE(std::string::npos, JSON(metrics).find("\"messages_in\":1000"));
+
+    // The metrics are published into the metrics registry, with the queues labeled as the MMQ ones are.
+    current::metrics::Registry registry;
+    {
+      const auto published = scope.PublishMetrics("flow", registry);
+      const current::metrics::MetricsSnapshot snapshot = registry.Snapshot();
+      std::map<std::string, double> values;
+      for (const auto& metric : snapshot.metrics) {
+        if (metric.name == "ripcurrent_messages_in_total") {
+          values[metric.labels.at("block")] = metric.value;
+        } else if (metric.name == "mmq_consumed_total") {
+          EXPECT_EQ("flow", metric.labels.at("flow"));
+          values[metric.labels.at("queue")] = metric.value;
+        }
+      }
+      EXPECT_EQ(1000.0, values["RCMult(2)"]);
+      EXPECT_EQ(1000.0, values["RCDump(std::ref(result))"]);
+    }
+    EXPECT_TRUE(registry.Snapshot().metrics.empty());
+  }
+
+  {
+    // No metrics unless requested.
+    std::vector<int> result;
+    auto scope = (RCEmit(1, 2, 3) | RCDump(std::ref(result))).RipCurrent();
+    scope.Join();
+    EXPECT_TRUE(scope.Metrics().blocks.empty());
+    EXPECT_TRUE(scope.Metrics().queues.empty());
+  }
+}
+
+TEST(RipCurrent, ThreadedPlusFlow) {
+  current::time::ResetToZero();
+
+  using namespace ripcurrent_unittest;
+
+  {
+    std::vector<std::string> result;
+    ((EmitInteger() + EmitString()) | DumpIntegerAndString(std::ref(result)))
+        .RipCurrent(current::ripcurrent::Threaded())
+        .Join();
+    EXPECT_EQ("42, 'Answer'", current::strings::Join(result, ", "));
+  }
+
+  {
+    // The blocks combined with `+` run in parallel, so they are given separate outputs.
+    std::vector<std::string> integers;
+    std::vector<std::string> strings;
+    std::vector<std::string> bools;
+    ((EmitInteger() + EmitBool(false) + EmitString() + EmitBool(true)) |
+     (DumpInteger(std::ref(integers)) + (DumpBool(std::ref(bools)) + DumpString(std::ref(strings)))))
+        .RipCurrent(current::ripcurrent::Threaded())
+        .Join();
+    EXPECT_EQ("42", current::strings::Join(integers, ", "));
+    EXPECT_EQ("'Answer'", current::strings::Join(strings, ", "));
+    EXPECT_EQ("False, True", current::strings::Join(bools, ", "));
+  }
+
+  {
+    std::vector<std::string> result;
+    ((EmitInteger() + EmitBool() + EmitString()) | (RIPCURRENT_DROP(Integer, Bool) + RIPCURRENT_PASS(String)) |
+     DumpString(std::ref(result)))
+        .RipCurrent(current::ripcurrent::Threaded())
+        .Join();
+    EXPECT_EQ("'Answer'", current::strings::Join(result, ", "));
+  }
+}
+
+TEST(RipCurrent, ThreadedPlusBranchesRunInParallel) {
+  current::time::ResetToZero();
+
+  using namespace ripcurrent_unittest;
+
+  std::atomic_int arrived(0);
+  std::atomic_bool integer_met(false);
+  std::atomic_bool string_met(false);
+  (EmitIntegerAndString() |
+   (RCRendezvousInteger(std::ref(arrived), std::ref(integer_met)) +
+    RCRendezvousString(std::ref(arrived), std::ref(string_met))))
+      .RipCurrent(current::ripcurrent::Threaded())
+      .Join();
+  EXPECT_TRUE(integer_met);
+  EXPECT_TRUE(string_met);
+}
+
+TEST(RipCurrent, ThreadedSchedulingEventsIntoTheFuture) {
+  using namespace ripcurrent_unittest;
+
+  std::function<void(int, std::chrono::microseconds)> post;
+  std::function<void(int, std::chrono::microseconds)> schedule;
+  std::function<void(std::chrono::microseconds)> head;
+  std::atomic_size_t counter(0u);
+  std::vector<int> result;
+
+  current::WaitableAtomic<std::string> captured_error_message;
+  const auto mock_scope = current::Singleton<current::ripcurrent::RipCurrentMockableErrorHandler>().ScopedInjectHandler(
+      [&captured_error_message](const std::string& error_message) { captured_error_message.SetValue(error_message); });
+
+  const auto scope = std::move((RCEmitterWithTimestamps(std::ref(post), std::ref(schedule), std::ref(head)) |
+                                RCDump(std::ref(result), std::ref(counter)))
+                                   .RipCurrent(current::ripcurrent::Threaded())
+                                   .Async());
+
+  post(4, std::chrono::microseconds(4));
+  schedule(6, std::chrono::microseconds(6));
+  schedule(11, std::chrono::microseconds(11));
+  post(5, std::chrono::microseconds(5));
+  post(7, std::chrono::microseconds(7));
+
+  while (counter != 4u) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ("4,5,6,7", current::strings::Join(result, ','));
+
+  head(std::chrono::microseconds(12));
+
+  while (counter != 5u) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ("4,5,6,7,11", current::strings::Join(result, ','));
+
+  EXPECT_EQ("", captured_error_message.GetValue());
+  post(2, std::chrono::microseconds(2));
+  EXPECT_EQ("Expecting timestamp >= 13, seeing 2.", captured_error_message.GetValue());
+}
+
+TEST(RipCurrent, FusedSequenceFlow) {
+  current::time::ResetToZero();
+
+  using namespace ripcurrent_unittest;
+
+  EXPECT_EQ("RCEmit(1) & RCMult(2) | RCMult(3) & RCDump()",
+            ((RCEmit(1) & RCMult(2)) | (RCMult(3) & RCDump())).Describe());
+  EXPECT_EQ("... | { Integer } => RCMult(2) & RCMult(3) => { Integer } | ...",
+            (RCMult(2) & RCMult(3)).DescribeWithTypes());
+
+  {
+    std::vector<int> result;
+    (RCEmit(1, 2, 3) & RCMult(2) & RCMult(5) & RCMult(10) & RCDump(std::ref(result))).RipCurrent().Join();
+    EXPECT_EQ("100,200,300", current::strings::Join(result, ','));
+  }
+
+  {
+    // Fully fused, the flow is run synchronously, from the constructor of the emitting block.
+    std::vector<int> result;
+    auto scope = (RCEmit(1, 2, 3) & RCMult(2) & RCDump(std::ref(result))).RipCurrent();
+    EXPECT_EQ("2,4,6", current::strings::Join(result, ','));
+    scope.Join();
+  }
+
+  {
+    std::vector<int> result;
+    ((RCEmit(1, 2, 3) & RCMult(2)) | (RCMult(5) & RCMult(10)) | RCDump(std::ref(result))).RipCurrent().Join();
+    EXPECT_EQ("100,200,300", current::strings::Join(result, ','));
+  }
+
+  {
+    std::vector<int> result;
+    ((RCEmitMany(1000) & RCMult(2)) | (RCMult(3) & RCDump(std::ref(result))))
+        .RipCurrent(current::ripcurrent::Threaded(4))
+        .Join();
+    ASSERT_EQ(1000u, result.size());
+    EXPECT_EQ(6, result.front());
+    EXPECT_EQ(6000, result.back());
+  }
+
+  {
+    std::vector<std::string> result;
+    (EmitIntegerAndString() & (DumpInteger(std::ref(result)) + DumpString(std::ref(result)))).RipCurrent().Join();
+    EXPECT_EQ("'Answer', 42", current::strings::Join(result, ", "));
+  }
+}
+
+TEST(RipCurrent, CanNotScheduleAcrossFusedSequence) {
+  using namespace ripcurrent_unittest;
+
+  std::function<void(int, std::chrono::microseconds)> post;
+  std::function<void(int, std::chrono::microseconds)> schedule;
+  std::function<void(std::chrono::microseconds)> head;
+  std::atomic_size_t counter(0u);
+  std::vector<int> result;
+
+  std::string captured_error_message;
+  const auto mock_scope = current::Singleton<current::ripcurrent::RipCurrentMockableErrorHandler>().ScopedInjectHandler(
+      [&captured_error_message](const std::string& error_message) { captured_error_message = error_message; });
+
+  const auto scope = std::move((RCEmitterWithTimestamps(std::ref(post), std::ref(schedule), std::ref(head)) &
+                                RCDump(std::ref(result), std::ref(counter)))
+                                   .RipCurrent()
+                                   .Async());
+
+  post(2, std::chrono::microseconds(2));
+  head(std::chrono::microseconds(3));
+  post(1, std::chrono::microseconds(1));
+  EXPECT_EQ("2,1", current::strings::Join(result, ','));
+
+  EXPECT_EQ("", captured_error_message);
+  schedule(4, std::chrono::microseconds(4));
+  EXPECT_EQ("Attempted to `schedule<>` a message across `&`, which has no queue to hold it. Use `|` instead.\n",
+            captured_error_message);
+  EXPECT_EQ("2,1", current::strings::Join(result, ','));
+}
+
+namespace ripcurrent_unittest {
+
+// clang-format off
+RIPCURRENT_NODE(RCEmitBatches, void, (Integer, String)) {
+  RCEmitBatches(int batches, int batch_size) {
+    int value = 0;
+    for (int i = 0; i < batches; ++i) {
+      std::vector<Integer> batch;
+      for (int j = 0; j < batch_size; ++j) {
+        batch.emplace_back(++value);
+      }
+      emit_batch<Integer>(std::move(batch));
+    }
+    emit<String>("Done");
+  }
+};
+#define RCEmitBatches(...) RIPCURRENT_MACRO(RCEmitBatches, __VA_ARGS__)
+
+RIPCURRENT_NODE(RCPostBatches, void, Integer) {
+  RCPostBatches() {
+    post_batch<Integer>(std::chrono::microseconds(100), std::vector<Integer>({1, 2}));
+    post_batch<Integer>(std::chrono::microseconds(200), std::vector<Integer>());
+    post_batch<Integer>(std::chrono::microseconds(300), std::vector<Integer>({3}));
+  }
+};
+#define RCPostBatches(...) RIPCURRENT_MACRO(RCPostBatches, __VA_ARGS__)
+
+// `RCCountBatches`: Accepts the batches of integers, as well as the integers one by one, and counts both.
+RIPCURRENT_NODE(RCCountBatches, Integer, void) {
+  std::vector<int>* ptr;
+  size_t* batches;
+  RCCountBatches() : ptr(nullptr), batches(nullptr) {}  // LCOV_EXCL_LINE
+  RCCountBatches(std::vector<int>& ref, size_t& batches) : ptr(&ref), batches(&batches) {}
+  void f(Integer x) {
+    ptr->push_back(x.value);
+  }
+  void f_batch(std::vector<Integer>&& xs) {
+    ++(*batches);
+    for (const Integer& x : xs) {
+      ptr->push_back(x.value);
+    }
+  }
+};
+#define RCCountBatches(...) RIPCURRENT_MACRO(RCCountBatches, __VA_ARGS__)
+// clang-format on
+
+}  // namespace ripcurrent_unittest
+
+TEST(RipCurrent, BatchesFlow) {
+  current::time::ResetToZero();
+
+  using namespace ripcurrent_unittest;
+
+  {
+    // The blocks not accepting batches receive their messages one by one.
+    std::vector<std::string> result;
+    (RCEmitBatches(2, 3) | MultIntegerOrString(10) | DumpIntegerAndString(std::ref(result))).RipCurrent().Join();
+    EXPECT_EQ("10, 20, 30, 40, 50, 60, 'Yo? Done Yo!'", current::strings::Join(result, ", "));
+  }
+
+  {
+    // The batches go through `PASS`, as well as through `+`, as they are.
+    std::vector<int> integers;
+    size_t batches = 0u;
+    std::vector<std::string> strings;
+    (RCEmitBatches(3, 4) | RIPCURRENT_PASS(Integer, String) |
+     (RCCountBatches(std::ref(integers), std::ref(batches)) + DumpString(std::ref(strings))))
+        .RipCurrent()
+        .Join();
+    EXPECT_EQ(3u, batches);
+    EXPECT_EQ("1,2,3,4,5,6,7,8,9,10,11,12", current::strings::Join(integers, ','));
+    EXPECT_EQ("'Done'", current::strings::Join(strings, ", "));
+  }
+
+  {
+    std::vector<int> integers;
+    size_t batches = 0u;
+    (RCEmitBatches(100, 10) | (RCCountBatches(std::ref(integers), std::ref(batches)) + RIPCURRENT_DROP(String)))
+        .RipCurrent(current::ripcurrent::Threaded(2))
+        .Join();
+    EXPECT_EQ(100u, batches);
+    ASSERT_EQ(1000u, integers.size());
+    EXPECT_EQ(1, integers.front());
+    EXPECT_EQ(1000, integers.back());
+  }
+
+  {
+    std::vector<int> integers;
+    size_t batches = 0u;
+    (RCEmitBatches(5, 2) & (RCCountBatches(std::ref(integers), std::ref(batches)) + RIPCURRENT_DROP(String)))
+        .RipCurrent()
+        .Join();
+    EXPECT_EQ(5u, batches);
+    EXPECT_EQ("1,2,3,4,5,6,7,8,9,10", current::strings::Join(integers, ','));
+  }
+
+  {
+    // One timestamp per batch, and the empty batches are not passed on.
+    std::vector<int> integers;
+    size_t batches = 0u;
+    (RCPostBatches() | RCCountBatches(std::ref(integers), std::ref(batches))).RipCurrent().Join();
+    EXPECT_EQ(2u, batches);
+    EXPECT_EQ("1,2,3", current::strings::Join(integers, ','));
+  }
+}
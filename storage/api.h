@@ -28,11 +28,16 @@ SOFTWARE.
 
 #include "../port.h"
 
-#include <vector>
+#include <chrono>
 #include <map>
+#include <thread>
+#include <vector>
 
 #include "api_types.h"
+#include "sharded.h"
 
+#include "rest/cqs_cache.h"
+#include "rest/export.h"
 #include "rest/types.h"
 #include "rest/plain.h"
 
@@ -88,6 +93,81 @@ using storage_handlers_map_entry_t = typename storage_handlers_map_t::value_type
 
 using registerer_t = std::function<void(const storage_handlers_map_entry_t&)>;
 
+// Whether the `GET` handler of the REST implementation has the exports of whole fields streamed, see `export.h`.
+template <typename HANDLER, typename = void>
+struct StreamsFieldExports : std::false_type {};
+
+template <typename HANDLER>
+struct StreamsFieldExports<HANDLER, std::void_t<decltype(HANDLER::kStreamsFieldExports)>>
+    : std::integral_constant<bool, HANDLER::kStreamsFieldExports> {};
+
+// Passes the response of the transaction on to the client, along with the index the storage is at right after it.
+// Invoked from within the locked section of the transaction, as its second step.
+template <typename STORAGE>
+class StorageIndexResponder final {
+ public:
+  StorageIndexResponder(const STORAGE& storage, Request request) : storage_(storage), request_(std::move(request)) {}
+  void operator()(Response response) {
+    if (response.initialized) {
+      response.SetHeader(
+          kRESTfulStorageIndexHeader,
+          current::ToString(storage_.template NextStreamIndex<current::locks::MutexLockStatus::AlreadyLocked>()));
+    }
+    request_(std::move(response));
+  }
+
+ private:
+  const STORAGE& storage_;
+  Request request_;
+};
+
+template <typename STORAGE>
+StorageIndexResponder<STORAGE> RespondWithStorageIndex(const STORAGE& storage, Request request) {
+  return StorageIndexResponder<STORAGE>(storage, std::move(request));
+}
+
+// Waits, with the storage not locked, for up to `max_wait` for the storage to be at the index the request asks for.
+// Returns `false` if the storage has not caught up with that index in time.
+template <typename STORAGE>
+bool WaitForMinIndex(const STORAGE& storage, const Request& request, std::chrono::milliseconds max_wait) {
+  const uint64_t min_index = MinIndexFromRequest(request);
+  if (!min_index) {
+    return true;
+  }
+  const auto deadline = std::chrono::steady_clock::now() + max_wait;
+  while (storage.NextStreamIndex() < min_index) {
+    if (std::chrono::steady_clock::now() >= deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+// Whether the following storage should redirect the request to the master.
+inline bool RedirectsToMaster(const RESTfulReplicaParams& replica, bool is_master) {
+  return !is_master && !replica.master_url.empty();
+}
+
+// The 307 to the same resource on the master storage, which keeps the method and the body of the request.
+inline Response RedirectToMaster(const RESTfulReplicaParams& replica, const Request& request) {
+  return Response("", HTTPResponseCode.TemporaryRedirect)
+      .SetHeader("Location",
+                 replica.master_url + request.url_path_args.ComposeURLPath() + request.url.ComposeParameters());
+}
+
+// The response to the read the following storage has not caught up with in time: to the master, if it is known.
+inline Response StorageIsBehindResponse(const RESTfulReplicaParams& replica, const Request& request) {
+  if (!replica.master_url.empty()) {
+    return RedirectToMaster(replica, request);
+  } else {
+    return ErrorResponse(generic::RESTError("StorageIsBehind",
+                                            "The storage has not caught up with the requested index in time.",
+                                            {{"min_index", current::ToString(MinIndexFromRequest(request))}}),
+                         HTTPResponseCode.ServiceUnavailable);
+  }
+}
+
 template <class REST_IMPL, int INDEX, typename STORAGE>
 struct PerFieldRESTfulHandlerGenerator {
   using storage_t = STORAGE;
@@ -114,14 +194,19 @@ struct PerFieldRESTfulHandlerGenerator {
   const registerer_t registerer;
   STORAGE& storage;
   const std::string restful_url_prefix;
+  const RESTfulReplicaParams replica;
 
-  PerFieldRESTfulHandlerGenerator(registerer_t registerer, STORAGE& storage, const std::string& restful_url_prefix)
-      : registerer(registerer), storage(storage), restful_url_prefix(restful_url_prefix) {}
+  PerFieldRESTfulHandlerGenerator(registerer_t registerer,
+                                  STORAGE& storage,
+                                  const std::string& restful_url_prefix,
+                                  const RESTfulReplicaParams& replica)
+      : registerer(registerer), storage(storage), restful_url_prefix(restful_url_prefix), replica(replica) {}
 
   template <typename FIELD_TYPE, typename ENTRY_TYPE_WRAPPER>
   void operator()(const char* input_field_name, FIELD_TYPE, ENTRY_TYPE_WRAPPER) {
     auto& storage = this->storage;  // For lambdas.
     const std::string restful_url_prefix = this->restful_url_prefix;
+    const RESTfulReplicaParams replica = this->replica;
     const std::string field_name = input_field_name;
 
     using entry_t = typename ENTRY_TYPE_WRAPPER::entry_t;
@@ -134,23 +219,28 @@ struct PerFieldRESTfulHandlerGenerator {
     using PATCHHandler = DataHandlerImpl<PATCH, top_level_operation_t, specific_field_t, entry_t, key_t>;
     using DELETEHandler = DataHandlerImpl<DELETE, top_level_operation_t, specific_field_t, entry_t, key_t>;
 
-    const auto generic_data_handler = [&storage, restful_url_prefix, field_name](Request request) {
+    const auto generic_data_handler = [&storage, restful_url_prefix, replica, field_name](Request request) {
+      if (request.method == "GET" && !WaitForMinIndex(storage, request, replica.max_wait)) {
+        request(StorageIsBehindResponse(replica, request));
+        return;
+      }
+      if (StreamsFieldExports<GETHandler>::value && request.method == "GET" && request.url_path_args.empty()) {
+        const Optional<FieldExportParams> export_params = FieldExportParamsFromRequest(request);
+        if (Exists(export_params) && !Value(export_params).limit) {
+          // Not under the lock of the storage, which is only taken for each slice of the export.
+          StreamFieldExport<key_t, entry_t>(storage, Value(export_params), std::move(request));
+          return;
+        }
+      }
       // TODO(dkorolev): Pass `BorrowedWithCallback<Storage>` into the request handler.
       auto generic_input = RESTfulGenericInput<STORAGE>(storage, restful_url_prefix);
       std::lock_guard<std::mutex> lock(storage.UnderlyingStream()->Impl()->publishing_mutex);
       const bool is_master = storage.template IsMasterStorage<current::locks::MutexLockStatus::AlreadyLocked>();
-      if (request.method == "GET") {
+      if (request.method != "GET" && RedirectsToMaster(replica, is_master)) {
+        request(RedirectToMaster(replica, request));
+      } else if (request.method == "GET") {
         GETHandler handler;
-        Optional<FieldExportParams> requested_export_params;
-        if (request.url.query.has(kRESTfulExportURLQueryParameter)) {
-          FieldExportParams params;
-          if (request.url.query[kRESTfulExportURLQueryParameter] == "detailed") {
-            params.format = FieldExportFormat::Detailed;
-          }
-          params.nshards = FromString<uint32_t>(request.url.query.get(kRESTfulExportNShardsURLQueryParameter, "0"));
-          params.shard = FromString<uint32_t>(request.url.query.get(kRESTfulExportShardURLQueryParameter, "0"));
-          requested_export_params = std::move(params);
-        }
+        const Optional<FieldExportParams> requested_export_params = FieldExportParamsFromRequest(request);
         handler.Enter(
             std::move(request),
             // Capture by reference since this lambda is run synchronously.
@@ -174,7 +264,7 @@ struct PerFieldRESTfulHandlerGenerator {
                             requested_export_params);
                         return handler.Run(input);
                       },
-                      std::move(request))
+                      RespondWithStorageIndex(generic_input.storage, std::move(request)))
                   .Detach();
             });
       } else if (request.method == "POST" && is_master) {
@@ -197,7 +287,7 @@ struct PerFieldRESTfulHandlerGenerator {
                                         std::move(generic_input), fields, field, field_name, mutable_entry, overwrite);
                                     return handler.Run(input);
                                   },
-                                  std::move(request))
+                                  RespondWithStorageIndex(generic_input.storage, std::move(request)))
                               .Detach();
                         } catch (const TypeSystemParseJSONException& e) {
                           request(handler.ErrorBadJSON(e.OriginalDescription()));
@@ -226,7 +316,7 @@ struct PerFieldRESTfulHandlerGenerator {
                               std::move(generic_input), fields, field, field_name, url_key, entry, entry_key);
                           return handler.Run(input);
                         },
-                        std::move(request))
+                        RespondWithStorageIndex(generic_input.storage, std::move(request)))
                     .Detach();
               } catch (const TypeSystemParseJSONException& e) {          // LCOV_EXCL_LINE
                 request(handler.ErrorBadJSON(e.OriginalDescription()));  // LCOV_EXCL_LINE
@@ -252,7 +342,7 @@ struct PerFieldRESTfulHandlerGenerator {
                             std::move(generic_input), fields, field, field_name, url_key, patch_body);
                         return handler.Run(input);
                       },
-                      std::move(request))
+                      RespondWithStorageIndex(generic_input.storage, std::move(request)))
                   .Detach();
             });
       } else if (request.method == "DELETE" && is_master) {
@@ -272,7 +362,7 @@ struct PerFieldRESTfulHandlerGenerator {
                         const DELETEInput input(std::move(generic_input), fields, field, field_name, url_key);
                         return handler.Run(input);
                       },
-                      std::move(request))
+                      RespondWithStorageIndex(generic_input.storage, std::move(request)))
                   .Detach();
             });
       } else {
@@ -298,6 +388,52 @@ struct PerFieldRESTfulHandlerGenerator {
         });
   }
 
+  // Streams the export of the whole field as chunks, each built in a read-only transaction of its own, over up to
+  // `kRESTfulExportSliceSize` entries. The entries added or erased while the export is in progress may or may not
+  // make it into the export, just as with the paginated exports, see `container/cursor.h`.
+  template <typename KEY, typename ENTRY>
+  static void StreamFieldExport(STORAGE& storage, const FieldExportParams& params, Request request) {
+#ifndef CURRENT_ALLOW_STORAGE_EXPORT_FROM_MASTER
+    // Still only available off the followers.
+    if (storage.IsMasterStorage()) {
+      request(ErrorResponse(
+                  generic::RESTError("NotFollowerMode", "Can only request full export from a Follower storage."),
+                  HTTPResponseCode.Forbidden));
+      return;
+    }
+#endif  // CURRENT_ALLOW_STORAGE_EXPORT_FROM_MASTER
+    const specific_field_t& field = storage(::current::storage::ImmutableFieldByIndex<INDEX>());
+    FieldExporter<KEY, ENTRY> exporter(params);
+    std::string cursor;
+    std::string slice = exporter.Prefix();
+    const auto export_slice = [&]() {
+      storage
+          .ReadOnlyTransaction(
+              [&](immutable_fields_t) { cursor = exporter.Export(field, cursor, kRESTfulExportSliceSize, slice); })
+          .Go();
+    };
+    export_slice();
+    try {
+      auto response =
+          request.SendChunkedResponse(HTTPResponseCode.OK, net::http::Headers(), net::constants::kDefaultContentType);
+      while (true) {
+        if (cursor.empty()) {
+          slice += exporter.Suffix();
+        }
+        if (!slice.empty()) {
+          response(slice);
+          slice.clear();
+        }
+        if (cursor.empty()) {
+          break;
+        }
+        export_slice();
+      }
+    } catch (const current::net::NetworkException&) {  // LCOV_EXCL_LINE
+      // The client is gone, nothing more to export.
+    }
+  }
+
   template <typename FIELD_TYPE, typename ENTRY_TYPE_WRAPPER, typename GENERIC_HANDLER>
   void RegisterAdditionalFieldDataHandlers(const std::string& field_name,
                                            semantics::rest::RESTWithSingleKey,
@@ -318,11 +454,16 @@ struct PerFieldRESTfulHandlerGenerator {
                   "");
     auto& storage = this->storage;
     const std::string restful_url_prefix = this->restful_url_prefix;
+    const RESTfulReplicaParams replica = this->replica;
 
     using entry_t = typename ENTRY_TYPE_WRAPPER::entry_t;
     using key_t = typename ENTRY_TYPE_WRAPPER::key_t;
 
-    return [&storage, restful_url_prefix, field_name](Request request) {
+    return [&storage, restful_url_prefix, replica, field_name](Request request) {
+      if (request.method == "GET" && !WaitForMinIndex(storage, request, replica.max_wait)) {
+        request(StorageIsBehindResponse(replica, request));
+        return;
+      }
       // TODO(dkorolev): Pass `BorrowedWithCallback<Storage>` into the request handler.
       std::lock_guard<std::mutex> lock(storage.UnderlyingStream()->Impl()->publishing_mutex);
       auto generic_input = RESTfulGenericInput<STORAGE>(storage, restful_url_prefix);
@@ -343,7 +484,7 @@ struct PerFieldRESTfulHandlerGenerator {
                         const RowColGETInput input(std::move(generic_input), fields, field, field_name, url_key);
                         return handler.Run(input);
                       },
-                      std::move(request))
+                      RespondWithStorageIndex(generic_input.storage, std::move(request)))
                   .Detach();
             });
       } else {
@@ -384,9 +525,103 @@ struct PerFieldRESTfulHandlerGenerator {
 };
 
 template <class REST_IMPL, int INDEX, typename STORAGE>
-void GenerateRESTfulHandler(registerer_t registerer, STORAGE& storage, const std::string& restful_url_prefix) {
+void GenerateRESTfulHandler(registerer_t registerer,
+                            STORAGE& storage,
+                            const std::string& restful_url_prefix,
+                            const RESTfulReplicaParams& replica) {
   storage(::current::storage::FieldNameAndTypeByIndex<INDEX>(),
-          PerFieldRESTfulHandlerGenerator<REST_IMPL, INDEX, STORAGE>(registerer, storage, restful_url_prefix));
+          PerFieldRESTfulHandlerGenerator<REST_IMPL, INDEX, STORAGE>(registerer, storage, restful_url_prefix, replica));
+}
+
+// Applies a mutation of a batch, one line of its body, to the field the mutation is for, from within the transaction.
+template <typename STORAGE>
+using batch_mutator_t =
+    std::function<batch::RESTBatchMutationResult(STORAGE& storage, const std::string& method, const std::string& line)>;
+
+// Field name -> the mutator of that field.
+template <typename STORAGE>
+using batch_mutators_map_t = std::unordered_map<std::string, batch_mutator_t<STORAGE>>;
+
+template <int INDEX, typename STORAGE>
+struct PerFieldBatchMutatorGenerator {
+  using specific_field_extractor_t = decltype(std::declval<STORAGE>()(::current::storage::FieldTypeExtractor<INDEX>()));
+  using specific_field_t = typename specific_field_extractor_t::particular_field_t;
+
+  batch_mutators_map_t<STORAGE>& mutators;
+
+  explicit PerFieldBatchMutatorGenerator(batch_mutators_map_t<STORAGE>& mutators) : mutators(mutators) {}
+
+  template <typename FIELD_TYPE, typename ENTRY_TYPE_WRAPPER>
+  void operator()(const char* field_name, FIELD_TYPE, ENTRY_TYPE_WRAPPER) {
+    using entry_t = typename ENTRY_TYPE_WRAPPER::entry_t;
+    using key_t = typename ENTRY_TYPE_WRAPPER::key_t;
+    using field_type_dependent_impl_t = field_type_dependent_t<specific_field_t>;
+    mutators[field_name] =
+        [](STORAGE& storage, const std::string& method, const std::string& line) -> batch::RESTBatchMutationResult {
+      specific_field_t& field = storage(::current::storage::MutableFieldByIndex<INDEX>());
+      if (method == "PUT") {
+        const auto mutation = ParseJSON<batch::RESTBatchPUTMutation<entry_t>>(line);
+        if (!Exists(mutation.entry)) {
+          return batch::RESTBatchMutationResult(HTTPResponseCode.BadRequest,
+                                                generic::RESTError("MissingEntry", "The `entry` to `PUT` is missing."));
+        }
+        const entry_t& entry = Value(mutation.entry);
+        const auto key = field_type_dependent_impl_t::ExtractOrComposeKey(entry);
+        const bool existed = Exists(field[key]);
+        field.Add(entry);
+        return batch::RESTBatchMutationResult(existed ? HTTPResponseCode.OK : HTTPResponseCode.Created,
+                                              existed ? "Resource updated." : "Resource created.",
+                                              field_type_dependent_impl_t::ComposeURLKey(key));
+      } else if (method == "DELETE") {
+        const auto mutation = ParseJSON<batch::RESTBatchDELETEMutation<key_t>>(line);
+        if (!Exists(mutation.key)) {
+          return batch::RESTBatchMutationResult(HTTPResponseCode.BadRequest,
+                                                generic::RESTError("MissingKey", "The `key` to `DELETE` is missing."));
+        }
+        const key_t& key = Value(mutation.key);
+        const bool existed = Exists(field[key]);
+        field.Erase(key);
+        return batch::RESTBatchMutationResult(HTTPResponseCode.OK,
+                                              existed ? "Resource deleted." : "Resource didn't exist.",
+                                              field_type_dependent_impl_t::ComposeURLKey(key));
+      } else {
+        return batch::RESTBatchMutationResult(
+            HTTPResponseCode.MethodNotAllowed,
+            MethodNotAllowedError("The mutations of the batches are `PUT`-s or `DELETE`-s.", method));
+      }
+    };
+  }
+};
+
+template <int INDEX, typename STORAGE>
+void GenerateBatchMutator(batch_mutators_map_t<STORAGE>& mutators, STORAGE& storage) {
+  storage(::current::storage::FieldNameAndTypeByIndex<INDEX>(),
+          PerFieldBatchMutatorGenerator<INDEX, STORAGE>(mutators));
+}
+
+// Field name -> the time the field was last modified, for the caches of the CQS queries, see `rest/cqs_cache.h`.
+template <typename STORAGE>
+using field_last_modified_getters_t =
+    std::unordered_map<std::string, std::function<std::chrono::microseconds(STORAGE&)>>;
+
+template <int INDEX, typename STORAGE>
+struct PerFieldLastModifiedGetterGenerator {
+  field_last_modified_getters_t<STORAGE>& getters;
+
+  explicit PerFieldLastModifiedGetterGenerator(field_last_modified_getters_t<STORAGE>& getters) : getters(getters) {}
+
+  template <typename FIELD_TYPE, typename ENTRY_TYPE_WRAPPER>
+  void operator()(const char* field_name, FIELD_TYPE, ENTRY_TYPE_WRAPPER) {
+    getters[field_name] = [](STORAGE& storage) {
+      return storage(::current::storage::ImmutableFieldByIndex<INDEX>()).FieldLastModified();
+    };
+  }
+};
+
+template <int INDEX, typename STORAGE>
+void GenerateFieldLastModifiedGetter(field_last_modified_getters_t<STORAGE>& getters, STORAGE& storage) {
+  storage(::current::storage::FieldNameAndTypeByIndex<INDEX>(),
+          PerFieldLastModifiedGetterGenerator<INDEX, STORAGE>(getters));
 }
 
 }  // namespace impl
@@ -405,22 +640,28 @@ class RESTfulStorage {
   using cqs_command_handler_t = std::function<Response(
       mutable_fields_t, std::shared_ptr<CurrentStruct> command, const cqs::CQSParameters& cqs_parameters)>;
 
+  // With `replica`, the `RESTfulStorage` of a following storage redirects the mutations to the master, and has the
+  // reads asking for the index it has not applied yet wait for it, see `RESTfulReplicaParams` in `api_types.h`.
   RESTfulStorage(STORAGE_IMPL& storage,
                  uint16_t port,
                  const std::string& route_prefix,
-                 const std::string& restful_url_prefix_input)
-      : data_(std::make_unique<Data>(port, route_prefix)) {
+                 const std::string& restful_url_prefix_input,
+                 RESTfulReplicaParams replica = RESTfulReplicaParams())
+      : data_(std::make_unique<Data>(port, route_prefix, std::move(replica))) {
     const std::string restful_url_prefix = restful_url_prefix_input;
     if (!route_prefix.empty() && route_prefix.back() == '/') {
       CURRENT_THROW(current::Exception("`route_prefix` should not end with a slash."));  // LCOV_EXCL_LINE
     }
 
-    // Fill in the map of `Storage field name` -> `HTTP handler`.
-    ForEachFieldByIndex<void, STORAGE_IMPL::FIELDS_COUNT>::RegisterIt(storage, restful_url_prefix, data_->handlers_);
+    // Fill in the map of `Storage field name` -> `HTTP handler`, and the one of the mutators of the batches.
+    ForEachFieldByIndex<void, STORAGE_IMPL::FIELDS_COUNT>::RegisterIt(storage, restful_url_prefix, *data_);
 
     // Register the CQS handlers as well.
     RegisterCQSHandlers(storage, restful_url_prefix);
 
+    // And the batches.
+    RegisterBatchHandler(storage);
+
     // Register handlers on a specific port under a specific path prefix.
     for (const auto& endpoint : data_->handlers_) {
       RegisterRoute(endpoint.first, endpoint.second);
@@ -481,6 +722,29 @@ class RESTfulStorage {
         });
   }
 
+  // Registers the query with its results cached, see `rest/cqs_cache.h`.
+  template <class QUERY_IMPL>
+  void AddCQSQuery(const std::string& query, cqs::CQSQueryCacheParams cache_params) {
+    for (const std::string& field : cache_params.fields) {
+      if (!data_->field_last_modified_getters_.count(field)) {
+        CURRENT_THROW(current::Exception("RESTfulStorage::AddCQSQuery(), no field `" + field + "` to cache by."));
+      }
+    }
+    AddCQSQuery<QUERY_IMPL>(query);
+    std::lock_guard<std::mutex> lock(data_->cqs_handlers_mutex_);
+    data_->cqs_query_caches_[query] = std::make_unique<cqs::CQSQueryCache>(std::move(cache_params));
+  }
+
+  // The hits, misses, and the size of the cache of the query registered with one.
+  cqs::CQSQueryCacheStats CQSQueryCacheStats(const std::string& query) const {
+    std::lock_guard<std::mutex> lock(data_->cqs_handlers_mutex_);
+    const auto cit = data_->cqs_query_caches_.find(query);
+    if (cit == data_->cqs_query_caches_.end()) {
+      CURRENT_THROW(current::Exception("RESTfulStorage::CQSQueryCacheStats(), `" + query + "` is not cached."));
+    }
+    return cit->second->Stats();
+  }
+
   template <class COMMAND_IMPL>
   void AddCQSCommand(const std::string& command) {
     std::lock_guard<std::mutex> lock(data_->cqs_handlers_mutex_);
@@ -519,6 +783,7 @@ class RESTfulStorage {
   struct Data {
     const uint16_t port_;
     const std::string route_prefix_;
+    const RESTfulReplicaParams replica_;
 
     std::vector<std::pair<std::string, URLPathArgs::CountMask>> handler_routes_;
     impl::storage_handlers_map_t handlers_;
@@ -528,32 +793,40 @@ class RESTfulStorage {
     mutable std::mutex cqs_handlers_mutex_;
     std::unordered_map<std::string, std::pair<cqs_universal_parser_t, cqs_query_handler_t>> cqs_query_map_;
     std::unordered_map<std::string, std::pair<cqs_universal_parser_t, cqs_command_handler_t>> cqs_command_map_;
-
-    Data(uint16_t port, const std::string& route_prefix) : port_(port), route_prefix_(route_prefix), up_status_(true) {}
+    // Filled in by the constructor, and read-only from then on, so that the batches need no lock of their own.
+    impl::batch_mutators_map_t<STORAGE_IMPL> batch_mutators_;
+    impl::field_last_modified_getters_t<STORAGE_IMPL> field_last_modified_getters_;
+    // The caches of the CQS queries registered with them, guarded by `cqs_handlers_mutex_` along with the queries.
+    std::unordered_map<std::string, std::unique_ptr<cqs::CQSQueryCache>> cqs_query_caches_;
+
+    Data(uint16_t port, const std::string& route_prefix, RESTfulReplicaParams replica)
+        : port_(port), route_prefix_(route_prefix), replica_(std::move(replica)), up_status_(true) {}
   };
   std::unique_ptr<Data> data_;
 
   // The `BLAH` template parameter is required to fight the "explicit specialization in class scope" error.
   template <typename BLAH, int I>
   struct ForEachFieldByIndex {
-    static void RegisterIt(STORAGE_IMPL& storage,
-                           const std::string& restful_url_prefix,
-                           impl::storage_handlers_map_t& handlers) {
-      ForEachFieldByIndex<BLAH, I - 1>::RegisterIt(storage, restful_url_prefix, handlers);
+    static void RegisterIt(STORAGE_IMPL& storage, const std::string& restful_url_prefix, Data& data) {
+      ForEachFieldByIndex<BLAH, I - 1>::RegisterIt(storage, restful_url_prefix, data);
       using specific_entry_type_t =
           typename impl::PerFieldRESTfulHandlerGenerator<REST_IMPL, I - 1, STORAGE_IMPL>::specific_entry_type_t;
       current::metaprogramming::CallIf<FieldExposedViaREST<STORAGE_IMPL, specific_entry_type_t>::exposed>::With([&] {
-        const auto registerer = [&handlers](const impl::storage_handlers_map_entry_t& restful_route) {
-          handlers.insert(restful_route);
+        const auto registerer = [&data](const impl::storage_handlers_map_entry_t& restful_route) {
+          data.handlers_.insert(restful_route);
         };
-        impl::GenerateRESTfulHandler<REST_IMPL, I - 1, STORAGE_IMPL>(registerer, storage, restful_url_prefix);
+        impl::GenerateRESTfulHandler<REST_IMPL, I - 1, STORAGE_IMPL>(
+            registerer, storage, restful_url_prefix, data.replica_);
+        impl::GenerateBatchMutator<I - 1, STORAGE_IMPL>(data.batch_mutators_, storage);
       });
+      // The CQS queries may read the fields not exposed via REST too.
+      impl::GenerateFieldLastModifiedGetter<I - 1, STORAGE_IMPL>(data.field_last_modified_getters_, storage);
     }
   };
 
   template <typename BLAH>
   struct ForEachFieldByIndex<BLAH, 0> {
-    static void RegisterIt(STORAGE_IMPL&, const std::string&, impl::storage_handlers_map_t&) {}
+    static void RegisterIt(STORAGE_IMPL&, const std::string&, Data&) {}
   };
 
   void RegisterRoute(const std::string& field_name, const RESTfulRoute& route) {
@@ -588,6 +861,10 @@ class RESTfulStorage {
     const Data& data = *data_;
 
     const auto cqs_query_handler = [&data, &storage, restful_url_prefix](Request request) {
+      if (request.method == "GET" && !impl::WaitForMinIndex(storage, request, data.replica_.max_wait)) {
+        request(impl::StorageIsBehindResponse(data.replica_, request));
+        return;
+      }
       std::lock_guard<std::mutex> lock(storage.UnderlyingStream()->Impl()->publishing_mutex);
       if (request.url_path_args.empty()) {
         request(Response(cqs::CQSHandlerNotSpecified(), HTTPResponseCode.NotFound));
@@ -602,27 +879,51 @@ class RESTfulStorage {
           auto generic_input = RESTfulGenericInput<STORAGE_IMPL>(storage, restful_url_prefix);
           using CQSHandlerImpl = typename REST_IMPL::template RESTfulCQSHandler<STORAGE_IMPL>;
           CQSHandlerImpl handler;
+          const auto cache_cit = data.cqs_query_caches_.find(request.url_path_args[0]);
+          cqs::CQSQueryCache* cache = cache_cit != data.cqs_query_caches_.end() ? cache_cit->second.get() : nullptr;
           std::shared_ptr<CurrentStruct> type_erased_query = f_parse_query_body(request);
           if (type_erased_query) {
             typename CQSHandlerImpl::Context context;
-            handler.Enter(std::move(request),
-                          context,
-                          // Capture by reference since this lambda is run synchronously.
-                          [&handler, &f_run_query, &generic_input, &type_erased_query, &context](Request request) {
-                            const STORAGE_IMPL& storage = generic_input.storage;
-                            const cqs::CQSParameters cqs_parameters(generic_input.restful_url_prefix, request);
-                            storage
-                                .template ReadOnlyTransaction<current::locks::MutexLockStatus::AlreadyLocked>(
-                                    // TODO(dkorolev): Revisit this as Owned/Borrowed are the organic part of Storage.
-                                    // Capture local variables by value for safe async transactions.
-                                    [&f_run_query, handler, cqs_parameters, type_erased_query, context](
-                                        immutable_fields_t fields) -> Response {
-                                      return handler.RunQuery(
-                                          context, f_run_query, fields, std::move(type_erased_query), cqs_parameters);
-                                    },
-                                    std::move(request))
-                                .Detach();
-                          });
+            handler.Enter(
+                std::move(request),
+                context,
+                // Capture by reference since this lambda is run synchronously.
+                [&data, &handler, &f_run_query, &generic_input, &type_erased_query, &context, cache](
+                    Request request) {
+                  const STORAGE_IMPL& storage = generic_input.storage;
+                  const cqs::CQSParameters cqs_parameters(generic_input.restful_url_prefix, request);
+                  const std::string cache_key = cache ? request.url.ComposeURL() + '\n' + request.body : "";
+                  storage
+                      .template ReadOnlyTransaction<current::locks::MutexLockStatus::AlreadyLocked>(
+                          // TODO(dkorolev): Revisit this as Owned/Borrowed are the organic part of Storage.
+                          // Capture local variables by value for safe async transactions.
+                          [&data, &generic_input, &f_run_query, handler, cqs_parameters, type_erased_query, context,
+                           cache, cache_key](immutable_fields_t fields) -> Response {
+                            if (!cache) {
+                              return handler.RunQuery(
+                                  context, f_run_query, fields, std::move(type_erased_query), cqs_parameters);
+                            }
+                            std::chrono::microseconds epoch(0);
+                            if (cache->Params().fields.empty()) {
+                              epoch = generic_input.storage.template LastAppliedTimestamp<
+                                  current::locks::MutexLockStatus::AlreadyLocked>();
+                            } else {
+                              for (const std::string& field : cache->Params().fields) {
+                                epoch = std::max(epoch,
+                                                 data.field_last_modified_getters_.at(field)(generic_input.storage));
+                              }
+                            }
+                            Response response;
+                            if (!cache->Get(cache_key, epoch, response)) {
+                              response = handler.RunQuery(
+                                  context, f_run_query, fields, std::move(type_erased_query), cqs_parameters);
+                              cache->Put(cache_key, epoch, response);
+                            }
+                            return response;
+                          },
+                          impl::RespondWithStorageIndex(generic_input.storage, std::move(request)))
+                      .Detach();
+                });
           }
         } else {
           request(Response(cqs::CQSHandlerNotFound(), HTTPResponseCode.NotFound));
@@ -637,7 +938,10 @@ class RESTfulStorage {
 
     const auto cqs_command_handler = [&data, &storage, restful_url_prefix](Request request) {
       std::lock_guard<std::mutex> lock(storage.UnderlyingStream()->Impl()->publishing_mutex);
-      if (!storage.template IsMasterStorage<current::locks::MutexLockStatus::AlreadyLocked>()) {
+      const bool is_master = storage.template IsMasterStorage<current::locks::MutexLockStatus::AlreadyLocked>();
+      if (impl::RedirectsToMaster(data.replica_, is_master)) {
+        request(impl::RedirectToMaster(data.replica_, request));
+      } else if (!is_master) {
         request(Response(cqs::CQSCommandNeedsMasterStorage(), HTTPResponseCode.ServiceUnavailable));
       } else if (request.method != "POST" && request.method != "PUT" && request.method != "PATCH") {
         request(REST_IMPL::ErrorMethodNotAllowed(request.method, "CQS commands must be {POST|PUT|PATCH}-es."));
@@ -670,7 +974,7 @@ class RESTfulStorage {
                                       return handler.RunCommand(
                                           ctx, f_run_command, fields, std::move(type_erased_command), cqs_parameters);
                                     },
-                                    std::move(request))
+                                    impl::RespondWithStorageIndex(storage, std::move(request)))
                                 .Detach();
                           });
           }
@@ -685,15 +989,131 @@ class RESTfulStorage {
                                           URLPathArgs::CountMask::None | URLPathArgs::CountMask::One,
                                           cqs_command_handler));
   }
+  // The batches of mutations, `POST`-ed to `/batch`, one JSON object per line, each with the name of the `field` and
+  // the `method`, along with the `entry` to `PUT`, or the JSON of the `key` to `DELETE`. All the mutations of a batch
+  // are applied in order, in a single transaction, and in a single journal entry. If any one of them fails, the whole
+  // batch is rolled back, and the response code is that of the mutation that has failed.
+  void RegisterBatchHandler(STORAGE_IMPL& storage) {
+    const Data& data = *data_;
+    const auto batch_handler = [&data, &storage](Request request) {
+      std::lock_guard<std::mutex> lock(storage.UnderlyingStream()->Impl()->publishing_mutex);
+      const bool is_master = storage.template IsMasterStorage<current::locks::MutexLockStatus::AlreadyLocked>();
+      if (impl::RedirectsToMaster(data.replica_, is_master)) {
+        request(impl::RedirectToMaster(data.replica_, request));
+      } else if (!is_master) {
+        request(ErrorResponse(generic::RESTError("NotMasterMode", "Batches can only be applied to the master storage."),
+                              HTTPResponseCode.ServiceUnavailable));
+      } else if (request.method != "POST") {
+        request(REST_IMPL::ErrorMethodNotAllowed(request.method, "Batches must be POST-ed."));
+      } else {
+        const std::string body = request.body;
+        storage
+            .template ReadWriteTransaction<current::locks::MutexLockStatus::AlreadyLocked>(
+                [&data, &storage, &body](mutable_fields_t) -> Response {
+                  batch::RESTBatchResponse response;
+                  current::strings::Split<current::strings::ByLines>(body, [&](const std::string& line) {
+                    batch::RESTBatchMutationResult result;
+                    try {
+                      const auto header = ParseJSON<batch::RESTBatchMutationHeader>(line);
+                      const auto cit = data.batch_mutators_.find(header.field);
+                      if (cit != data.batch_mutators_.end()) {
+                        result = cit->second(storage, header.method, line);
+                      } else {
+                        result = batch::RESTBatchMutationResult(
+                            HTTPResponseCode.NotFound,
+                            generic::RESTError("FieldNotFound", "No such field.", {{"field", header.field}}));
+                      }
+                    } catch (const TypeSystemParseJSONException& e) {
+                      result = batch::RESTBatchMutationResult(
+                          HTTPResponseCode.BadRequest,
+                          ParseJSONError("Invalid JSON mutation.", e.OriginalDescription()));
+                    } catch (const StorageUniqueIndexViolationException& e) {
+                      result = batch::RESTBatchMutationResult(
+                          HTTPResponseCode.Conflict,
+                          generic::RESTError("UniqueIndexViolation", e.OriginalDescription()));
+                    }
+                    const uint16_t code = result.code;
+                    response.results.push_back(std::move(result));
+                    if (code >= 400u) {
+                      response.success = false;
+                      response.message = "Mutation " + current::ToString(response.results.size() - 1u) +
+                                         " has failed, the batch was rolled back.";
+                      CURRENT_STORAGE_THROW_ROLLBACK_WITH_VALUE(
+                          Response, response, static_cast<net::HTTPResponseCodeValue>(code));
+                    }
+                  });
+                  response.message = current::ToString(response.results.size()) + " mutations applied.";
+                  return Response(response, HTTPResponseCode.OK);
+                },
+                impl::RespondWithStorageIndex(storage, std::move(request)))
+            .Detach();
+      }
+    };
+    data_->handlers_.emplace(
+        "", RESTfulRoute(kRESTfulBatchURLComponent, "", URLPathArgs::CountMask::None, batch_handler));
+  }
+
   static void Serve503(Request r) {
     r("{\"error\":\"In graceful shutdown mode. Come back soon.\"}\n", HTTPResponseCode.ServiceUnavailable);
   }
 };
 
+// Exposes each shard of the `ShardedStorage` under `<route_prefix>/shard/<i>`, and routes the requests to the entries,
+// `<route_prefix>/data/<field>/<key>[/...]`, to the shards of their keys by 307-s, which keep the method and the body.
+// The requests that span all the shards, such as the collections, or the columns of the matrices, are 400-s, as they
+// should be made to each shard, and combined by the client.
+template <class STORAGE_IMPL, class REST_IMPL = plain::Plain>
+class ShardedRESTfulStorage {
+ public:
+  ShardedRESTfulStorage(ShardedStorage<STORAGE_IMPL>& storage,
+                        uint16_t port,
+                        const std::string& route_prefix,
+                        const std::string& restful_url_prefix) {
+    for (size_t i = 0u; i < storage.ShardsCount(); ++i) {
+      const std::string shard_path = "/shard/" + current::ToString(i);
+      shards_.push_back(std::make_unique<RESTfulStorage<STORAGE_IMPL, REST_IMPL>>(
+          storage.Shard(i), port, route_prefix + shard_path, restful_url_prefix + shard_path));
+    }
+    const size_t shards = storage.ShardsCount();
+    router_scope_ = HTTP(current::net::BarePort(port))
+                        .Register(route_prefix + '/' + kRESTfulDataURLComponent,
+                                  URLPathArgs::CountMask::Any,
+                                  [shards, restful_url_prefix](Request request) {
+                                    Route(std::move(request), shards, restful_url_prefix);
+                                  });
+  }
+
+  size_t ShardsCount() const { return shards_.size(); }
+  RESTfulStorage<STORAGE_IMPL, REST_IMPL>& Shard(size_t shard) { return *shards_.at(shard); }
+
+ private:
+  static void Route(Request request, size_t shards, const std::string& restful_url_prefix) {
+    const URLPathArgs& args = request.url_path_args;
+    // The `<field>.row/<row>` collections are within one shard, the `<field>.col/<col>` ones are not.
+    const std::string field = args.size() >= 2u ? args[0] : "";
+    if (field.empty() || (field.length() > 4u && field.substr(field.length() - 4u) == ".col")) {
+      request(helpers::ErrorResponse(
+          generic::RESTError("ShardRequired", "Only the requests with the keys in the URLs are routed to the shards."),
+          HTTPResponseCode.BadRequest));
+      return;
+    }
+    const std::string url = request.url.ComposeURL();
+    const size_t query = url.find('?');
+    const std::string location = restful_url_prefix + "/shard/" + current::ToString(ShardOfKey(args[1], shards)) +
+                                 '/' + kRESTfulDataURLComponent + args.ComposeURLPathFromArgs() +
+                                 (query == std::string::npos ? "" : url.substr(query));
+    request(Response("", HTTPResponseCode.TemporaryRedirect).SetHeader("Location", location));
+  }
+
+  std::vector<std::unique_ptr<RESTfulStorage<STORAGE_IMPL, REST_IMPL>>> shards_;
+  HTTPRoutesScope router_scope_;
+};
+
 }  // namespace rest
 }  // namespace storage
 }  // namespace current
 
 using current::storage::rest::RESTfulStorage;
+using current::storage::rest::ShardedRESTfulStorage;
 
 #endif  // CURRENT_STORAGE_REST_H
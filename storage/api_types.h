@@ -29,6 +29,8 @@ SOFTWARE.
 #include "container/sfinae.h"
 
 #include "../blocks/http/api.h"
+#include "../bricks/strings/split.h"
+#include "../bricks/strings/util.h"
 
 namespace current {
 namespace storage {
@@ -39,11 +41,21 @@ const std::string kRESTfulDataURLComponent = "data";
 const std::string kRESTfulSchemaURLComponent = "schema";
 const std::string kRESTfulCQSCommandURLComponent = "cqs/command";
 const std::string kRESTfulCQSQueryURLComponent = "cqs/query";
+const std::string kRESTfulBatchURLComponent = "batch";
 
 // Table `?export` mode, and its URL query parameters.
 const std::string kRESTfulExportURLQueryParameter = "export";
 const std::string kRESTfulExportNShardsURLQueryParameter = "nshards";  // Number of shards.
 const std::string kRESTfulExportShardURLQueryParameter = "shard";      // Shard to export.
+const std::string kRESTfulExportLimitURLQueryParameter = "limit";      // Entries per page, to paginate.
+const std::string kRESTfulExportCursorURLQueryParameter = "cursor";    // Page to export, from the previous one.
+
+// The cursor to export the next page from, set unless the page is the last one.
+const std::string kRESTfulExportCursorHeader = "X-Current-Export-Cursor";
+
+// The non-paginated exports of whole fields are streamed as chunks, each built in a read-only transaction of its own,
+// over this many entries, so that neither the storage stays locked, nor the whole export is kept in memory.
+constexpr size_t kRESTfulExportSliceSize = 10000u;
 
 enum class FieldExportFormat {
   Simple,   // Single entry object JSON or one JSON per line for collections, no timestamps.
@@ -54,8 +66,109 @@ struct FieldExportParams {
   FieldExportFormat format = FieldExportFormat::Simple;
   uint32_t nshards = 0u;
   uint32_t shard = 0u;
+  // Zero to export all the entries, and the number of entries to go over for one page otherwise.
+  // With `nshards`, the entries of the other shards count too, so the page may have fewer entries, or none.
+  size_t limit = 0u;
+  std::string cursor;
+};
+
+// The `?export` parameters of the request, if it is an export.
+inline Optional<FieldExportParams> FieldExportParamsFromRequest(const Request& request) {
+  if (!request.url.query.has(kRESTfulExportURLQueryParameter)) {
+    return nullptr;
+  }
+  FieldExportParams params;
+  if (request.url.query[kRESTfulExportURLQueryParameter] == "detailed") {
+    params.format = FieldExportFormat::Detailed;
+  }
+  params.nshards = FromString<uint32_t>(request.url.query.get(kRESTfulExportNShardsURLQueryParameter, "0"));
+  params.shard = FromString<uint32_t>(request.url.query.get(kRESTfulExportShardURLQueryParameter, "0"));
+  params.limit = FromString<size_t>(request.url.query.get(kRESTfulExportLimitURLQueryParameter, "0"));
+  params.cursor = request.url.query.get(kRESTfulExportCursorURLQueryParameter, "");
+  return params;
+}
+
+// The conditional `GET`-s. The `ETag` of an entry, or of a whole field, is the time it was last modified at.
+const std::string kETagHeader = "ETag";
+const std::string kIfNoneMatchHeader = "If-None-Match";
+const std::string kIfModifiedSinceHeader = "If-Modified-Since";
+
+inline std::string FormatETag(std::chrono::microseconds last_modified) {
+  return '"' + current::ToString(last_modified.count()) + '"';
+}
+
+struct ConditionalGETParams {
+  Optional<std::string> if_none_match;
+  Optional<std::chrono::microseconds> if_modified_since;
+
+  // Whether the resource last modified at `last_modified` is what the client already has, to respond with a 304.
+  // As per RFC 7232, `If-Modified-Since` is only looked at in the absence of `If-None-Match`.
+  bool NotModified(std::chrono::microseconds last_modified) const {
+    if (Exists(if_none_match)) {
+      const std::string etag = FormatETag(last_modified);
+      for (std::string candidate : current::strings::Split(Value(if_none_match), ',')) {
+        candidate = current::strings::Trim(candidate);
+        if (candidate.compare(0u, 2u, "W/") == 0) {
+          candidate = candidate.substr(2u);
+        }
+        if (candidate == etag || candidate == "*") {
+          return true;
+        }
+      }
+      return false;
+    } else {
+      // `ParseHTTPDate()` pads the seconds up, so it is the time within the second that gets compared against.
+      return Exists(if_modified_since) && last_modified <= Value(if_modified_since);
+    }
+  }
 };
 
+// The headers of the conditional `GET`-s of the request. An unparsable `If-Modified-Since` is ignored, as per RFC 7232.
+inline ConditionalGETParams ConditionalGETParamsFromRequest(const Request& request) {
+  ConditionalGETParams params;
+  if (request.headers.Has(kIfNoneMatchHeader)) {
+    params.if_none_match = request.headers.Get(kIfNoneMatchHeader);
+  } else if (request.headers.Has(kIfModifiedSinceHeader)) {
+    try {
+      params.if_modified_since = net::http::ParseHTTPDate(request.headers.Get(kIfModifiedSinceHeader));
+    } catch (const current::net::http::InvalidHTTPDateException&) {
+      // Respond with the resource as if the header was not there.
+    }
+  }
+  return params;
+}
+
+// The reads off the followers with bounded staleness. The responses carry the index the storage is at, the number of
+// the entries of its stream applied to it, and the `GET`-s and the CQS queries may ask for at least some index, which
+// the following storage waits for, up to `RESTfulReplicaParams::max_wait`, before serving the request.
+const std::string kRESTfulStorageIndexHeader = "X-Current-Storage-Index";
+const std::string kRESTfulMinIndexHeader = "X-Current-Min-Index";
+const std::string kRESTfulMinIndexURLQueryParameter = "min_index";
+
+// The replica-aware mode of the `RESTfulStorage` atop a following storage.
+struct RESTfulReplicaParams final {
+  // The scheme, the host, and the port of the master, as "http://master:8080", to redirect the mutations to, by 307-s,
+  // which keep the method and the body. The master is expected to expose its storage under the same route prefix.
+  // If empty, the mutations are refused by the following storage, as they are by default.
+  std::string master_url;
+  // For how long can a request wait for the following storage to catch up with the index it asks for.
+  std::chrono::milliseconds max_wait = std::chrono::milliseconds(1000);
+
+  RESTfulReplicaParams() = default;
+  explicit RESTfulReplicaParams(std::string master_url,
+                                std::chrono::milliseconds max_wait = std::chrono::milliseconds(1000))
+      : master_url(std::move(master_url)), max_wait(max_wait) {}
+};
+
+// The index the request asks the storage to be at, via the header or the URL query parameter, zero if none.
+inline uint64_t MinIndexFromRequest(const Request& request) {
+  if (request.headers.Has(kRESTfulMinIndexHeader)) {
+    return FromString<uint64_t>(request.headers.Get(kRESTfulMinIndexHeader));
+  } else {
+    return FromString<uint64_t>(request.url.query.get(kRESTfulMinIndexURLQueryParameter, "0"));
+  }
+}
+
 // TODO(dkorolev): The whole `FieldTypeDependentImpl` section below to be moved to `semantics.h`.
 template <typename>
 struct FieldTypeDependentImpl {};
@@ -28,7 +28,12 @@ SOFTWARE.
 
 #include "../port.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <functional>
+#include <memory>
+#include <new>
+#include <vector>
 
 #include "semantics.h"
 #include "transaction.h"
@@ -189,16 +194,126 @@ template <typename FIELDS, int COUNT>
 using FieldsTypeList = typename TypeListMapperImpl<FIELDS, current::variadic_indexes::generate_indexes<COUNT>>::result;
 #endif  // CURRENT_STORAGE_PATCH_SUPPORT
 
+// The index of the field the persisted event is of, for the parallel replay to apply the events of different fields
+// concurrently, see `replay.h`.
+template <typename FIELDS, typename EVENT, int N>
+constexpr bool IsEventOfField() {
+#ifndef CURRENT_FOR_CPP14
+  using info_t = std::invoke_result_t<FIELDS, FieldInfoByIndex<N>>;
+#else
+  using info_t = weed::call_with_type<FIELDS, FieldInfoByIndex<N>>;
+#endif  // CURRENT_FOR_CPP14
+  return std::is_same_v<EVENT, typename info_t::update_event_t> ||
+#ifdef CURRENT_STORAGE_PATCH_SUPPORT
+         std::is_same_v<EVENT, typename info_t::patch_event_t> ||
+#endif  // CURRENT_STORAGE_PATCH_SUPPORT
+         std::is_same_v<EVENT, typename info_t::delete_event_t>;
+}
+
+template <typename FIELDS, typename EVENT, int... NS>
+constexpr size_t FieldIndexOfEventImpl(current::variadic_indexes::indexes<NS...>) {
+  size_t index = 0u;
+  ((IsEventOfField<FIELDS, EVENT, NS>() ? (index = static_cast<size_t>(NS)) : 0u), ...);
+  return index;
+}
+
+template <typename FIELDS, int COUNT, typename EVENT>
+constexpr size_t FieldIndexOfEvent() {
+  return FieldIndexOfEventImpl<FIELDS, EVENT>(current::variadic_indexes::generate_indexes<COUNT>());
+}
+
+// The rollback records of one transaction. Each record is the very closure passed to `MutationJournal::LogMutation`,
+// kept by its type in the blocks of memory retained from one transaction to the next, so that logging a mutation
+// allocates nothing for its rollback once the blocks are there.
+class MutationJournalRollbackLog final {
+ public:
+  MutationJournalRollbackLog() = default;
+  MutationJournalRollbackLog(const MutationJournalRollbackLog&) = delete;
+  MutationJournalRollbackLog& operator=(const MutationJournalRollbackLog&) = delete;
+  ~MutationJournalRollbackLog() { Clear(); }
+
+  template <typename F>
+  void Push(F&& rollback) {
+    using record_t = Record<std::decay_t<F>>;
+    static_assert(alignof(record_t) <= alignof(std::max_align_t), "");
+    records_.push_back(new (Allocate(sizeof(record_t), alignof(record_t))) record_t(std::forward<F>(rollback)));
+  }
+
+  // Runs the rollbacks in the reverse order, and clears the log.
+  void RollbackAll() {
+    for (auto rit = records_.rbegin(); rit != records_.rend(); ++rit) {
+      (*rit)->Rollback();
+    }
+    Clear();
+  }
+
+  // Destroys the records, keeping up to `kRetainedBlocks` blocks of memory for the next transaction.
+  void Clear() {
+    for (RecordBase* record : records_) {
+      record->~RecordBase();
+    }
+    records_.clear();
+    if (blocks_.size() > kRetainedBlocks) {
+      blocks_.resize(kRetainedBlocks);
+    }
+    block_ = 0u;
+    offset_ = 0u;
+  }
+
+  bool Empty() const { return records_.empty(); }
+  size_t Size() const { return records_.size(); }
+
+ private:
+  constexpr static size_t kBlockSize = 16u * 1024u;
+  constexpr static size_t kRetainedBlocks = 64u;
+
+  struct RecordBase {
+    virtual ~RecordBase() = default;
+    virtual void Rollback() = 0;
+  };
+
+  template <typename F>
+  struct Record final : RecordBase {
+    F f;
+    template <typename G>
+    explicit Record(G&& f) : f(std::forward<G>(f)) {}
+    void Rollback() override { f(); }
+  };
+
+  void* Allocate(size_t size, size_t alignment) {
+    while (block_ < blocks_.size()) {
+      const size_t offset = (offset_ + alignment - 1u) & ~(alignment - 1u);
+      if (offset + size <= blocks_[block_].second) {
+        offset_ = offset + size;
+        return blocks_[block_].first.get() + offset;
+      }
+      ++block_;
+      offset_ = 0u;
+    }
+    const size_t capacity = std::max(kBlockSize, size);
+    blocks_.emplace_back(std::make_unique<char[]>(capacity), capacity);
+    block_ = blocks_.size() - 1u;
+    offset_ = size;
+    return blocks_.back().first.get();
+  }
+
+  std::vector<RecordBase*> records_;
+  std::vector<std::pair<std::unique_ptr<char[]>, size_t>> blocks_;
+  size_t block_ = 0u;   // The block to allocate from.
+  size_t offset_ = 0u;  // The offset of the first free byte in that block.
+};
+
 // `MutationJournal` keeps all the changes made during one transaction, as well as the way to rollback them.
 struct MutationJournal {
   TransactionMeta transaction_meta;
+  // The mutations are moved into the persisted transaction as they are, see `PersistJournalFromLockedSection()`.
   std::vector<std::unique_ptr<current::CurrentStruct>> commit_log;
-  std::vector<std::function<void()>> rollback_log;
+  MutationJournalRollbackLog rollback_log;
 
-  template <typename T>
-  void LogMutation(T&& entry, std::function<void()> rollback) {
+  template <typename T, typename F>
+  void LogMutation(T&& entry, F&& rollback) {
     commit_log.push_back(std::make_unique<T>(std::move(entry)));
-    rollback_log.push_back(rollback);
+    rollback_log.Push(std::forward<F>(rollback));
   }
 
   void BeforeTransaction() { transaction_meta.begin_us = current::time::Now(); }
@@ -206,9 +321,7 @@ struct MutationJournal {
   void AfterTransaction() { transaction_meta.end_us = current::time::Now(); }
 
   void Rollback() {
-    for (auto rit = rollback_log.rbegin(); rit != rollback_log.rend(); ++rit) {
-      (*rit)();
-    }
+    rollback_log.RollbackAll();
     Clear();
   }
 
@@ -217,7 +330,7 @@ struct MutationJournal {
     transaction_meta.end_us = std::chrono::microseconds(0);
     transaction_meta.fields.clear();
     commit_log.clear();
-    rollback_log.clear();
+    rollback_log.Clear();
   }
 
   void AssertEmpty() const {
@@ -225,7 +338,7 @@ struct MutationJournal {
     CURRENT_ASSERT(transaction_meta.end_us.count() == 0);
     CURRENT_ASSERT(transaction_meta.fields.empty());
     CURRENT_ASSERT(commit_log.empty());
-    CURRENT_ASSERT(rollback_log.empty());
+    CURRENT_ASSERT(rollback_log.Empty());
   }
 };
 
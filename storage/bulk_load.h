@@ -0,0 +1,75 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// The bulk loads seed the storage with many entries at once, see `StorageImpl::BulkLoad()`.
+//
+// The entries are not added one by one, each with its own mutation in the journal, to be rolled back with. Instead,
+// they are collected as the events that recreate them, applied to the fields the way the replay applies them, and
+// persisted as one transaction. Thus, the stream needs no special type of entry for them, and is replayed, replicated,
+// and snapshotted as usual.
+//
+// As nothing is rolled back, the entries are not checked against the unique indexes, and must satisfy them.
+// Likewise, the entries of the same key replace each other, but the matrix entries must not conflict by their rows or
+// columns where the matrix is `One` on that side, as the events replayed do not erase the conflicting entries.
+
+#ifndef CURRENT_STORAGE_BULK_LOAD_H
+#define CURRENT_STORAGE_BULK_LOAD_H
+
+#include "../port.h"
+
+#include <chrono>
+#include <vector>
+
+namespace current {
+namespace storage {
+
+template <typename FIELDS_VARIANT>
+class StorageBulkLoad final {
+ public:
+  StorageBulkLoad(std::chrono::microseconds us, std::vector<FIELDS_VARIANT>& events) : us_(us), events_(events) {}
+
+  // To presize the transaction, if the number of the entries is known in advance.
+  void Reserve(size_t entries) { events_.reserve(events_.size() + entries); }
+
+  // Adds or replaces the entry of the field, i.e. `load.Add(fields.user, user)`.
+  template <typename CONTAINER>
+  void Add(const CONTAINER&, const typename CONTAINER::entry_t& entry) {
+    events_.emplace_back(typename CONTAINER::update_event_t(us_, entry));
+  }
+
+  size_t Size() const { return events_.size(); }
+
+ private:
+  StorageBulkLoad(const StorageBulkLoad&) = delete;
+  StorageBulkLoad& operator=(const StorageBulkLoad&) = delete;
+
+  const std::chrono::microseconds us_;
+  std::vector<FIELDS_VARIANT>& events_;
+};
+
+}  // namespace storage
+}  // namespace current
+
+#endif  // CURRENT_STORAGE_BULK_LOAD_H
@@ -25,6 +25,12 @@ SOFTWARE.
 #ifndef CURRENT_STORAGE_CONTAINER_COMMON_H
 #define CURRENT_STORAGE_CONTAINER_COMMON_H
 
+#include "flat_hash_map.h"
+
+#include <chrono>
+#include <memory>
+
+#include "../../bricks/template/is_unique_ptr.h"
 #include "../../bricks/util/comparators.h"
 
 namespace current {
@@ -34,11 +40,59 @@ namespace container {
 template <typename KEY, typename VALUE>
 using Unordered = std::unordered_map<KEY, VALUE, GenericHashFunction<KEY>>;
 
+// No pointer stability, see `flat_hash_map.h`.
+template <typename KEY, typename VALUE>
+using FlatUnordered = FlatHashMap<KEY, VALUE, GenericHashFunction<KEY>>;
+
 template <typename KEY, typename VALUE>
 using Ordered = std::map<KEY, VALUE, CurrentComparator<KEY>>;
 
+// The containers keep the time each entry was last modified next to the entry itself, rather than in a map of their
+// own, which would have every key twice. Only the keys erased are kept in a separate map, with the time of erasing.
+template <typename T>
+struct EntryWithLastModified final {
+  T entry;
+  std::chrono::microseconds last_modified;
+
+  EntryWithLastModified(const T& entry, std::chrono::microseconds last_modified)
+      : entry(entry), last_modified(last_modified) {}
+};
+
+// The `OneToOne` container holds its entries by `std::unique_ptr`-s, and keeps the time each entry was last modified in
+// its deleter, so that `GenericMapIterator` and `GenericMapAccessor` iterate over its maps just as they did.
+template <typename T>
+struct DeleterWithLastModified final {
+  std::chrono::microseconds last_modified = std::chrono::microseconds(0);
+
+  void operator()(T* entry) const { std::default_delete<T>()(entry); }
+};
+
+template <typename T>
+using UniquePtrWithLastModified = std::unique_ptr<T, DeleterWithLastModified<T>>;
+
+template <typename T>
+UniquePtrWithLastModified<T> MakeUniqueWithLastModified(const T& entry, std::chrono::microseconds last_modified) {
+  UniquePtrWithLastModified<T> result(new T(entry));
+  result.get_deleter().last_modified = last_modified;
+  return result;
+}
+
 }  // namespace container
 }  // namespace storage
+
+// The `OneToMany` and `ManyToMany` containers keep their entries inline, in the nodes of the maps of their rows, and
+// the rest of their maps point to these nodes. Have `GenericMapIterator` and `GenericMapAccessor` see the entries.
+template <typename T>
+struct is_unique_ptr_impl<storage::container::EntryWithLastModified<T>> {
+  using entry_t = storage::container::EntryWithLastModified<T>;
+  enum { value = false };
+  using underlying_type = T;
+  static const T& extract(const entry_t& x) { return x.entry; }
+  static const T& extract(const entry_t* x) { return x->entry; }
+  static const T* pointer(const entry_t& x) { return &x.entry; }
+  static const T* pointer(const entry_t* x) { return &x->entry; }
+};
+
 }  // namespace current
 
 #endif  // CURRENT_STORAGE_CONTAINER_COMMON_H
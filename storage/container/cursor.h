@@ -0,0 +1,204 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// Cursors to resume iterating over the storage containers from, for the paginated exports of their contents.
+// A cursor is an opaque, URL-safe string, and the empty one stands for the beginning of the container. Each entry
+// that stays in the container all along is iterated over exactly once, while the entries added or erased in the
+// meantime may or may not be. The cursors remain valid as the containers are modified, and as they are rehashed.
+//
+// * For `std::map`-s, the cursor is the last key iterated over.
+// * For `std::unordered_map`-s, it is the number of the next bucket to go over, along with the number of buckets.
+//   Once the map is rehashed, the cursor keeps the numbers for the previous layouts too, to skip the entries that
+//   were in the buckets already gone over back then. Each call goes over whole buckets, so it may go over a few
+//   more entries than requested.
+// * For `FlatHashMap`-s, it is the hash to continue from, as it iterates in the order of the hashes, which are
+//   independent of its layout. It may go over a few more or fewer entries than requested.
+
+#ifndef CURRENT_STORAGE_CONTAINER_CURSOR_H
+#define CURRENT_STORAGE_CONTAINER_CURSOR_H
+
+#include "common.h"
+
+#include <iterator>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../exceptions.h"
+
+#include "../../bricks/strings/split.h"
+#include "../../bricks/strings/util.h"
+#include "../../bricks/template/is_unique_ptr.h"
+#include "../../bricks/util/base64.h"
+#include "../../typesystem/serialization/json.h"
+
+namespace current {
+namespace storage {
+namespace container {
+
+namespace impl {
+
+// Checks the characters here, as `Base64URLDecode()` only does so in debug builds.
+inline std::string DecodeCursor(const std::string& cursor) {
+  if (cursor.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_=") !=
+      std::string::npos) {
+    CURRENT_THROW(StorageInvalidCursorException("Malformed cursor: `" + cursor + "`."));
+  }
+  return Base64URLDecode(cursor);
+}
+
+inline uint64_t ParseCursorNumber(const std::string& cursor, const std::string& number) {
+  if (number.empty() || number.find_first_not_of("0123456789") != std::string::npos) {
+    CURRENT_THROW(StorageInvalidCursorException("Malformed cursor: `" + cursor + "`."));
+  }
+  return current::FromString<uint64_t>(number);
+}
+
+template <typename MAP>
+struct MapCursor;
+
+template <typename K, typename V, typename C, typename A>
+struct MapCursor<std::map<K, V, C, A>> {
+  template <typename F>
+  static std::string ForEach(const std::map<K, V, C, A>& map, const std::string& cursor, size_t limit, F&& f) {
+    auto it = map.begin();
+    if (!cursor.empty()) {
+      try {
+        it = map.upper_bound(ParseJSON<K, JSONFormat::Minimalistic>(DecodeCursor(cursor)));
+      } catch (const TypeSystemParseJSONException&) {
+        CURRENT_THROW(StorageInvalidCursorException("Malformed cursor: `" + cursor + "`."));
+      }
+    }
+    for (size_t i = 0u; it != map.end() && i < limit; ++i, ++it) {
+      f(it->first, it->second);
+    }
+    return it != map.end() ? Base64URLEncode(JSON<JSONFormat::Minimalistic>(std::prev(it)->first)) : "";
+  }
+};
+
+template <typename K, typename V, typename H, typename E, typename A>
+struct MapCursor<std::unordered_map<K, V, H, E, A>> {
+  // The number of buckets in each layout the map has been iterated over in, and the next bucket to go over in it.
+  // The key with the hash `h` is in the bucket `h % buckets`, as it is with all the major standard libraries.
+  using layouts_t = std::vector<std::pair<size_t, size_t>>;
+
+  template <typename F>
+  static std::string ForEach(
+      const std::unordered_map<K, V, H, E, A>& map, const std::string& cursor, size_t limit, F&& f) {
+    layouts_t layouts = Decode(cursor);
+    const size_t buckets = map.bucket_count();
+    if (layouts.empty() || layouts.back().first != buckets) {
+      layouts.emplace_back(buckets, 0u);
+    }
+    // The entries in the buckets gone over in the previous layouts have been iterated over already.
+    const auto iterated_over_before = [&map, &layouts](const K& key) {
+      const size_t hash = map.hash_function()(key);
+      for (size_t i = 0u; i + 1u < layouts.size(); ++i) {
+        if (hash % layouts[i].first < layouts[i].second) {
+          return true;
+        }
+      }
+      return false;
+    };
+    size_t& bucket = layouts.back().second;
+    for (size_t i = 0u; bucket < buckets && i < limit; ++bucket) {
+      for (auto it = map.begin(bucket); it != map.end(bucket); ++it) {
+        if (layouts.size() == 1u || !iterated_over_before(it->first)) {
+          f(it->first, it->second);
+          ++i;
+        }
+      }
+    }
+    while (bucket < buckets && !map.bucket_size(bucket)) {
+      ++bucket;
+    }
+    return bucket < buckets ? Encode(layouts) : "";
+  }
+
+  static std::string Encode(const layouts_t& layouts) {
+    std::string result;
+    for (const auto& layout : layouts) {
+      result += (result.empty() ? "" : ",") + current::ToString(layout.first) + ':' + current::ToString(layout.second);
+    }
+    return Base64URLEncode(result);
+  }
+
+  static layouts_t Decode(const std::string& cursor) {
+    layouts_t layouts;
+    if (!cursor.empty()) {
+      for (const std::string& layout : strings::Split(DecodeCursor(cursor), ',', strings::EmptyFields::Keep)) {
+        const size_t colon = layout.find(':');
+        if (colon == std::string::npos) {
+          CURRENT_THROW(StorageInvalidCursorException("Malformed cursor: `" + cursor + "`."));
+        }
+        const size_t buckets = static_cast<size_t>(ParseCursorNumber(cursor, layout.substr(0u, colon)));
+        const size_t bucket = static_cast<size_t>(ParseCursorNumber(cursor, layout.substr(colon + 1u)));
+        if (!buckets || bucket > buckets) {
+          CURRENT_THROW(StorageInvalidCursorException("Malformed cursor: `" + cursor + "`."));
+        }
+        layouts.emplace_back(buckets, bucket);
+      }
+    }
+    return layouts;
+  }
+};
+
+template <typename K, typename V, typename H, typename E>
+struct MapCursor<FlatHashMap<K, V, H, E>> {
+  template <typename F>
+  static std::string ForEach(const FlatHashMap<K, V, H, E>& map, const std::string& cursor, size_t limit, F&& f) {
+    uint64_t hash = cursor.empty() ? 0u : ParseCursorNumber(cursor, DecodeCursor(cursor));
+    size_t count = 0u;
+    bool more = true;
+    while (more && count < limit) {
+      more = map.ForEachEntryFromHash(hash, limit - count, [&f, &count](const std::pair<K, V>& entry) {
+        f(entry.first, entry.second);
+        ++count;
+      });
+    }
+    return more ? Base64URLEncode(current::ToString(hash)) : "";
+  }
+};
+
+}  // namespace impl
+
+// Calls `f(key, entry)` for about `limit` entries of the map of a container, starting from `cursor`, and returns
+// the cursor to continue from, which is empty once all the entries have been iterated over.
+template <typename MAP, typename F>
+std::string ForEachEntryFromCursor(const MAP& map, const std::string& cursor, size_t limit, F&& f) {
+  using mapped_t = std::remove_pointer_t<typename MAP::mapped_type>;
+  return impl::MapCursor<MAP>::ForEach(
+      map, cursor, limit, [&f](const typename MAP::key_type& key, const typename MAP::mapped_type& value) {
+        f(key, is_unique_ptr<mapped_t>::extract(value));
+      });
+}
+
+}  // namespace container
+}  // namespace storage
+}  // namespace current
+
+#endif  // CURRENT_STORAGE_CONTAINER_CURSOR_H
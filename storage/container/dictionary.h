@@ -27,9 +27,12 @@ SOFTWARE.
 #define CURRENT_STORAGE_CONTAINER_DICTIONARY_H
 
 #include "common.h"
+#include "cursor.h"
+#include "dictionary_index.h"
 #include "sfinae.h"
 
 #include "../base.h"
+#include "../exceptions.h"
 
 #include "../../typesystem/optional.h"
 
@@ -49,8 +52,17 @@ class GenericDictionary {
  public:
   using entry_t = T;
   using key_t = sfinae::entry_key_t<T>;
-  using map_t = MAP<key_t, T>;
+  // The time each entry was last modified is kept next to the entry, in the same node or slot of the map.
+  using map_t = MAP<key_t, EntryWithLastModified<T>>;
   using semantics_t = storage::semantics::Dictionary;
+  // The event recreating an entry, for the bulk loads, see `bulk_load.h`.
+  using update_event_t = UPDATE_EVENT;
+  using indexes_t =
+      typename dictionary_indexes_tuple<T, key_t, MAP, typename dictionary_indexes<UPDATE_EVENT>::type>::type;
+
+  // The indexes point to the entries of `map_`, which the flat maps move around as they grow.
+  static_assert(!IsFlatHashMap<map_t>::value || std::tuple_size<indexes_t>::value == 0u,
+                "The secondary indexes require a dictionary with pointer stability, not a flat one.");
 
   GenericDictionary(const std::string& field_name, MutationJournal& journal)
       : field_name_(field_name), journal_(journal) {}
@@ -61,69 +73,73 @@ class GenericDictionary {
   size_t Size() const { return map_.size(); }
   bool Has(sfinae::CF<key_t> x) const { return map_.find(x) != map_.end(); }
 
+  // With the flat dictionaries, the result only stays valid until the next entry is added.
   ImmutableOptional<T> operator[](sfinae::CF<key_t> key) const {
     const auto iterator = map_.find(key);
     if (iterator != map_.end()) {
-      return ImmutableOptional<T>(FromBarePointer(), &iterator->second);
+      return ImmutableOptional<T>(FromBarePointer(), &iterator->second.entry);
     } else {
       return nullptr;
     }
   }
 
+  // The secondary index declared with `CURRENT_STORAGE_INDEX`, see `dictionary_index.h`.
+  template <class INDEX>
+  const DictionaryIndex<INDEX, T, key_t, MAP>& Index() const {
+    return std::get<DictionaryIndex<INDEX, T, key_t, MAP>>(indexes_);
+  }
+
   ImmutableOptional<std::chrono::microseconds> LastModified(sfinae::CF<key_t> key) const {
-    const auto iterator = last_modified_.find(key);
-    if (iterator != last_modified_.end()) {
-      return ImmutableOptional<std::chrono::microseconds>(iterator->second);
+    const auto iterator = map_.find(key);
+    if (iterator != map_.end()) {
+      return ImmutableOptional<std::chrono::microseconds>(iterator->second.last_modified);
+    }
+    const auto erased_iterator = erased_last_modified_.find(key);
+    if (erased_iterator != erased_last_modified_.end()) {
+      return ImmutableOptional<std::chrono::microseconds>(erased_iterator->second);
     } else {
       return nullptr;
     }
   }
 
+  // The time any entry of this field was last added, updated, or erased at, zero if it never was. It does not move
+  // back as the transactions are rolled back, so that it changes whenever the contents of the field may have.
+  std::chrono::microseconds FieldLastModified() const { return field_last_modified_; }
+
   void Add(const T& object) {
     const auto now = current::time::Now();
     const auto key = sfinae::GetKey(object);
     const auto map_iterator = map_.find(key);
-    const auto lm_iterator = last_modified_.find(key);
+    AssertUniqueIndexes(object, map_iterator != map_.end() ? &map_iterator->second.entry : nullptr);
     if (map_iterator != map_.end()) {
-      const T& previous_object = map_iterator->second;
-      CURRENT_ASSERT(lm_iterator != last_modified_.end());
-      const auto previous_timestamp = lm_iterator->second;
+      const T& previous_object = map_iterator->second.entry;
+      const auto previous_timestamp = map_iterator->second.last_modified;
       journal_.LogMutation(UPDATE_EVENT(now, object), [this, key, previous_object, previous_timestamp]() {
-        last_modified_[key] = previous_timestamp;
-        map_[key] = previous_object;
+        DoSet(key, previous_object, previous_timestamp);
       });
     } else {
-      if (lm_iterator != last_modified_.end()) {
-        const auto previous_timestamp = lm_iterator->second;
-        journal_.LogMutation(UPDATE_EVENT(now, object), [this, key, previous_timestamp]() {
-          last_modified_[key] = previous_timestamp;
-          map_.erase(key);
-        });
+      const auto erased_iterator = erased_last_modified_.find(key);
+      if (erased_iterator != erased_last_modified_.end()) {
+        const auto previous_timestamp = erased_iterator->second;
+        journal_.LogMutation(UPDATE_EVENT(now, object),
+                             [this, key, previous_timestamp]() { DoErase(key, previous_timestamp); });
       } else {
-        journal_.LogMutation(UPDATE_EVENT(now, object), [this, key]() {
-          last_modified_.erase(key);
-          map_.erase(key);
-        });
+        journal_.LogMutation(UPDATE_EVENT(now, object), [this, key]() { DoEraseNeverModified(key); });
       }
     }
-    last_modified_[key] = now;
-    map_[key] = object;
+    DoSet(key, object, now);
   }
 
   void Erase(sfinae::CF<key_t> key) {
     const auto now = current::time::Now();
     const auto map_iterator = map_.find(key);
     if (map_iterator != map_.end()) {
-      const T& previous_object = map_iterator->second;
-      const auto lm_iterator = last_modified_.find(key);
-      CURRENT_ASSERT(lm_iterator != last_modified_.end());
-      const auto previous_timestamp = lm_iterator->second;
+      const T& previous_object = map_iterator->second.entry;
+      const auto previous_timestamp = map_iterator->second.last_modified;
       journal_.LogMutation(DELETE_EVENT(now, previous_object), [this, key, previous_object, previous_timestamp]() {
-        last_modified_[key] = previous_timestamp;
-        map_[key] = previous_object;
+        DoSet(key, previous_object, previous_timestamp);
       });
-      last_modified_[key] = now;
-      map_.erase(map_iterator);
+      DoErase(key, now);
     }
   }
 
@@ -137,17 +153,16 @@ class GenericDictionary {
     const auto now = current::time::Now();
     const auto map_iterator = map_.find(key);
     if (map_iterator != map_.end()) {
-      const T& previous_object = map_iterator->second;
-      const auto lm_iterator = last_modified_.find(key);
-      CURRENT_ASSERT(lm_iterator != last_modified_.end());
-      const auto previous_timestamp = lm_iterator->second;
+      const T& previous_object = map_iterator->second.entry;
+      const auto previous_timestamp = map_iterator->second.last_modified;
+      T patched_object = previous_object;
+      patched_object.PatchWith(patch_object);
+      AssertUniqueIndexes(patched_object, &previous_object);
       journal_.LogMutation(PATCH_EVENT_OR_VOID(now, key, patch_object),
                            [this, key, previous_object, previous_timestamp]() {
-                             last_modified_[key] = previous_timestamp;
-                             map_[key] = previous_object;
+                             DoSet(key, previous_object, previous_timestamp);
                            });
-      last_modified_[key] = now;
-      map_iterator->second.PatchWith(patch_object);
+      DoSet(key, patched_object, now);
       return true;
     } else {
       return false;
@@ -165,14 +180,22 @@ class GenericDictionary {
   }
 #endif  // CURRENT_STORAGE_PATCH_SUPPORT
 
-  void operator()(const UPDATE_EVENT& e) {
-    const auto key = sfinae::GetKey(e.data);
-    last_modified_[key] = e.us;
-    map_[key] = e.data;
-  }
-  void operator()(const DELETE_EVENT& e) {
-    last_modified_[e.key] = e.us;
-    map_.erase(e.key);
+  void operator()(const UPDATE_EVENT& e) { DoSet(sfinae::GetKey(e.data), e.data, e.us); }
+  void operator()(const DELETE_EVENT& e) { DoErase(e.key, e.us); }
+
+  // Calls `f` with the events which, replayed into an empty container, recreate this one, for the snapshots.
+  // The deletions of the keys no longer present go first, so that they can not affect the entries added after them.
+  template <typename F>
+  void ForEachSnapshotEvent(F&& f) const {
+    for (const auto& erased : erased_last_modified_) {
+      DELETE_EVENT e;
+      e.us = erased.second;
+      e.key = erased.first;
+      f(std::move(e));
+    }
+    for (const auto& element : map_) {
+      f(UPDATE_EVENT(element.second.last_modified, element.second.entry));
+    }
   }
 #ifdef CURRENT_STORAGE_PATCH_SUPPORT
   struct DummyStructForNonExistentPatch {};  // Essential, as can't form a reference to `void` even if disabled.
@@ -180,8 +203,9 @@ class GenericDictionary {
       const std::conditional_t<HasPatch<entry_t>(), PATCH_EVENT_OR_VOID, DummyStructForNonExistentPatch>& e) {
     auto it = map_.find(e.key);
     if (it != map_.end()) {
-      last_modified_[e.key] = e.us;
-      it->second.PatchWith(e.patch);
+      T patched_object = it->second.entry;
+      patched_object.PatchWith(e.patch);
+      DoSet(e.key, patched_object, e.us);
     }
   }
 #endif  // CURRENT_STORAGE_PATCH_SUPPORT
@@ -197,18 +221,85 @@ class GenericDictionary {
     // TODO(dkorolev): Replace `OuterKeyForPartialHypermediaCollectionView()` with `key()`?
     copy_free<key_t> OuterKeyForPartialHypermediaCollectionView() const { return iterator->first; }
     copy_free<key_t> key() const { return iterator->first; }
-    const T& operator*() const { return iterator->second; }
-    const T* operator->() const { return &iterator->second; }
+    const T& operator*() const { return iterator->second.entry; }
+    const T* operator->() const { return &iterator->second.entry; }
   };
 
   Iterator begin() const { return Iterator(map_.cbegin()); }
   Iterator end() const { return Iterator(map_.cend()); }
 
+  // For the paginated exports via REST, see `cursor.h`.
+  template <typename F>
+  std::string ForEachEntryFromCursor(const std::string& cursor, size_t limit, F&& f) const {
+    return container::ForEachEntryFromCursor(map_, cursor, limit, std::forward<F>(f));
+  }
+
  private:
+  template <typename F>
+  void ForEachIndex(F&& f) {
+    std::apply([&f](auto&... index) { (f(index), ...); }, indexes_);
+  }
+
+  void AssertUniqueIndexes(const T& object, const T* existing) const {
+    std::apply(
+        [this, &object, existing](const auto&... index) {
+          if ((index.Conflicts(object, existing) || ...)) {
+            CURRENT_THROW(StorageUniqueIndexViolationException("A unique index of `" + field_name_ +
+                                                               "` already has the value of the entry added."));
+          }
+        },
+        indexes_);
+  }
+
+  // All the changes to `map_` go through `DoSet()` and `DoErase()`, which keep the indexes up to date,
+  // and keep each key either in `map_`, or in `erased_last_modified_`, or in neither if it was never modified.
+  void DoSet(sfinae::CF<key_t> key, const T& object, std::chrono::microseconds us) {
+    if (us > field_last_modified_) {
+      field_last_modified_ = us;
+    }
+    const auto iterator = map_.find(key);
+    if (iterator != map_.end()) {
+      ForEachIndex([&key, &iterator](auto& index) { index.Remove(key, iterator->second.entry); });
+      iterator->second.entry = object;
+      iterator->second.last_modified = us;
+      ForEachIndex([&key, &iterator](auto& index) { index.Insert(key, iterator->second.entry); });
+    } else {
+      const T& entry = map_.emplace(key, EntryWithLastModified<T>(object, us)).first->second.entry;
+      ForEachIndex([&key, &entry](auto& index) { index.Insert(key, entry); });
+      if (!erased_last_modified_.empty()) {
+        erased_last_modified_.erase(key);
+      }
+    }
+  }
+
+  void DoErase(sfinae::CF<key_t> key, std::chrono::microseconds us) {
+    if (us > field_last_modified_) {
+      field_last_modified_ = us;
+    }
+    DoEraseNeverModified(key);
+    erased_last_modified_[key] = us;
+  }
+
+  // Erases the entry without keeping the time it was erased, to roll back adding a key that was never modified.
+  void DoEraseNeverModified(sfinae::CF<key_t> key) {
+    const auto iterator = map_.find(key);
+    if (iterator != map_.end()) {
+      ForEachIndex([&iterator](auto& index) { index.Remove(iterator->first, iterator->second.entry); });
+      map_.erase(iterator);
+    }
+  }
+
   const std::string field_name_;
   map_t map_;
-  std::unordered_map<key_t, std::chrono::microseconds, GenericHashFunction<key_t>> last_modified_;
+  // The times the keys no longer in `map_` were erased.
+  std::conditional_t<IsFlatHashMap<map_t>::value,
+                     FlatUnordered<key_t, std::chrono::microseconds>,
+                     std::unordered_map<key_t, std::chrono::microseconds, GenericHashFunction<key_t>>>
+      erased_last_modified_;
+  // The latest of the times of the mutations applied, see `FieldLastModified()`.
+  std::chrono::microseconds field_last_modified_ = std::chrono::microseconds(0);
   MutationJournal& journal_;
+  indexes_t indexes_;
 };
 
 #ifdef CURRENT_STORAGE_PATCH_SUPPORT
@@ -216,6 +307,10 @@ class GenericDictionary {
 template <typename T, typename UPDATE_EVENT, typename DELETE_EVENT, typename PATCH_EVENT_OR_VOID>
 using UnorderedDictionary = GenericDictionary<T, UPDATE_EVENT, DELETE_EVENT, PATCH_EVENT_OR_VOID, Unordered>;
 
+template <typename T, typename UPDATE_EVENT, typename DELETE_EVENT, typename PATCH_EVENT_OR_VOID>
+using FlatUnorderedDictionary =
+    GenericDictionary<T, UPDATE_EVENT, DELETE_EVENT, PATCH_EVENT_OR_VOID, FlatUnordered>;
+
 template <typename T, typename UPDATE_EVENT, typename DELETE_EVENT, typename PATCH_EVENT_OR_VOID>
 using OrderedDictionary = GenericDictionary<T, UPDATE_EVENT, DELETE_EVENT, PATCH_EVENT_OR_VOID, Ordered>;
 
@@ -224,6 +319,9 @@ using OrderedDictionary = GenericDictionary<T, UPDATE_EVENT, DELETE_EVENT, PATCH
 template <typename T, typename UPDATE_EVENT, typename DELETE_EVENT>
 using UnorderedDictionary = GenericDictionary<T, UPDATE_EVENT, DELETE_EVENT, Unordered>;
 
+template <typename T, typename UPDATE_EVENT, typename DELETE_EVENT>
+using FlatUnorderedDictionary = GenericDictionary<T, UPDATE_EVENT, DELETE_EVENT, FlatUnordered>;
+
 template <typename T, typename UPDATE_EVENT, typename DELETE_EVENT>
 using OrderedDictionary = GenericDictionary<T, UPDATE_EVENT, DELETE_EVENT, Ordered>;
 
@@ -238,6 +336,11 @@ struct StorageFieldTypeSelector<container::UnorderedDictionary<T, E1, E2, E3>> {
   static const char* HumanReadableName() { return "UnorderedDictionary"; }
 };
 
+template <typename T, typename E1, typename E2, typename E3>  // Entry, update event, delete event, patch event.
+struct StorageFieldTypeSelector<container::FlatUnorderedDictionary<T, E1, E2, E3>> {
+  static const char* HumanReadableName() { return "FlatUnorderedDictionary"; }
+};
+
 template <typename T, typename E1, typename E2, typename E3>  // Entry, update event, delete event, patch event.
 struct StorageFieldTypeSelector<container::OrderedDictionary<T, E1, E2, E3>> {
   static const char* HumanReadableName() { return "OrderedDictionary"; }
@@ -250,6 +353,11 @@ struct StorageFieldTypeSelector<container::UnorderedDictionary<T, E1, E2>> {
   static const char* HumanReadableName() { return "UnorderedDictionary"; }
 };
 
+template <typename T, typename E1, typename E2>  // Entry, update event, delete event.
+struct StorageFieldTypeSelector<container::FlatUnorderedDictionary<T, E1, E2>> {
+  static const char* HumanReadableName() { return "FlatUnorderedDictionary"; }
+};
+
 template <typename T, typename E1, typename E2>  // Entry, update event, delete event.
 struct StorageFieldTypeSelector<container::OrderedDictionary<T, E1, E2>> {
   static const char* HumanReadableName() { return "OrderedDictionary"; }
@@ -260,6 +368,7 @@ struct StorageFieldTypeSelector<container::OrderedDictionary<T, E1, E2>> {
 }  // namespace storage
 }  // namespace current
 
+using current::storage::container::FlatUnorderedDictionary;
 using current::storage::container::OrderedDictionary;
 using current::storage::container::UnorderedDictionary;
 
@@ -0,0 +1,309 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// Secondary indexes of the storage dictionaries.
+//
+// An index is declared on a field of the entry, and then attached to one or more dictionary fields of the storage,
+// before the storage itself is declared:
+//
+//   CURRENT_STORAGE_FIELD_ENTRY(UnorderedDictionary, User, PersistedUser);
+//   CURRENT_STORAGE_INDEX(UserByCountry, User, country, OrderedNonUnique);
+//   CURRENT_STORAGE_INDEX(UserByEmail, User, email, UnorderedUnique);
+//   CURRENT_STORAGE_FIELD_INDEXES(PersistedUser, UserByCountry, UserByEmail);
+//
+// The indexes are maintained by the dictionary as it is mutated, rolled back, and replayed, and are accessed
+// as `fields.users.Index<UserByCountry>()[country]`, which iterates over the users from that country, or as
+// `fields.users.Index<UserByEmail>()[email]`, which returns an `ImmutableOptional<User>`.
+
+#ifndef CURRENT_STORAGE_CONTAINER_DICTIONARY_INDEX_H
+#define CURRENT_STORAGE_CONTAINER_DICTIONARY_INDEX_H
+
+#include <tuple>
+#include <type_traits>
+
+#include "common.h"
+#include "sfinae.h"
+
+#include "../../bricks/template/typelist.h"
+#include "../../typesystem/optional.h"
+
+namespace current {
+namespace storage {
+
+// The kinds of the secondary indexes, the last argument of `CURRENT_STORAGE_INDEX`.
+// A unique index maps each value to at most one entry, and `Add()`-ing an entry with the value another entry already
+// has throws `StorageUniqueIndexViolationException`. A non-unique index maps each value to all the entries having it.
+// The ordered indexes iterate over their values in order, the unordered ones are hash-based.
+namespace index {
+
+struct OrderedUnique final {
+  constexpr static bool unique = true;
+  constexpr static bool ordered = true;
+};
+
+struct UnorderedUnique final {
+  constexpr static bool unique = true;
+  constexpr static bool ordered = false;
+};
+
+struct OrderedNonUnique final {
+  constexpr static bool unique = false;
+  constexpr static bool ordered = true;
+};
+
+struct UnorderedNonUnique final {
+  constexpr static bool unique = false;
+  constexpr static bool ordered = false;
+};
+
+}  // namespace index
+
+namespace container {
+
+template <typename VALUE, typename MAPPED, bool ORDERED>
+using IndexMap = std::conditional_t<ORDERED, Ordered<VALUE, MAPPED>, Unordered<VALUE, MAPPED>>;
+
+// The index of the entries of the dictionary, which owns them, and keeps them in place while they are indexed.
+template <class INDEX, typename T, typename KEY, template <typename...> class MAP, bool UNIQUE = INDEX::kind_t::unique>
+class DictionaryIndex;
+
+template <class INDEX, typename T, typename KEY, template <typename...> class MAP>
+class DictionaryIndex<INDEX, T, KEY, MAP, true> final {
+ public:
+  using value_t = typename INDEX::value_t;
+  using map_t = IndexMap<value_t, const T*, INDEX::kind_t::ordered>;
+
+  DictionaryIndex() = default;
+
+  bool Empty() const { return map_.empty(); }
+  size_t Size() const { return map_.size(); }
+  bool Has(sfinae::CF<value_t> value) const { return map_.find(value) != map_.end(); }
+
+  ImmutableOptional<T> operator[](sfinae::CF<value_t> value) const {
+    const auto iterator = map_.find(value);
+    if (iterator != map_.end()) {
+      return ImmutableOptional<T>(FromBarePointer(), iterator->second);
+    } else {
+      return nullptr;
+    }
+  }
+
+  struct Iterator final {
+    using iterator_t = typename map_t::const_iterator;
+    iterator_t iterator;
+    explicit Iterator(iterator_t iterator) : iterator(std::move(iterator)) {}
+    void operator++() { ++iterator; }
+    bool operator==(const Iterator& rhs) const { return iterator == rhs.iterator; }
+    bool operator!=(const Iterator& rhs) const { return !operator==(rhs); }
+    sfinae::CF<value_t> value() const { return iterator->first; }
+    const T& operator*() const { return *iterator->second; }
+    const T* operator->() const { return iterator->second; }
+  };
+
+  Iterator begin() const { return Iterator(map_.cbegin()); }
+  Iterator end() const { return Iterator(map_.cend()); }
+
+  // Whether the value of `entry` belongs to an entry other than `existing`, the one with the same key, if any.
+  bool Conflicts(const T& entry, const T* existing) const {
+    const auto iterator = map_.find(INDEX::GetValue(entry));
+    return iterator != map_.end() && iterator->second != existing;
+  }
+
+  void Insert(sfinae::CF<KEY>, const T& entry) { map_[INDEX::GetValue(entry)] = &entry; }
+
+  // When replaying the entries added before the index was declared, the last one with the value shadows the rest.
+  void Remove(sfinae::CF<KEY>, const T& entry) {
+    const auto iterator = map_.find(INDEX::GetValue(entry));
+    if (iterator != map_.end() && iterator->second == &entry) {
+      map_.erase(iterator);
+    }
+  }
+
+ private:
+  DictionaryIndex(const DictionaryIndex&) = delete;
+  DictionaryIndex& operator=(const DictionaryIndex&) = delete;
+
+  map_t map_;
+};
+
+template <class INDEX, typename T, typename KEY, template <typename...> class MAP>
+class DictionaryIndex<INDEX, T, KEY, MAP, false> final {
+ public:
+  using value_t = typename INDEX::value_t;
+  // The entries with the same value, in the order of their keys for the ordered dictionaries.
+  using entries_t = MAP<KEY, const T*>;
+  using map_t = IndexMap<value_t, entries_t, INDEX::kind_t::ordered>;
+
+  DictionaryIndex() = default;
+
+  bool Empty() const { return map_.empty(); }
+  // The number of the entries indexed, as opposed to the number of distinct values.
+  size_t Size() const { return size_; }
+  bool Has(sfinae::CF<value_t> value) const { return map_.find(value) != map_.end(); }
+
+  // The entries with the same value.
+  class Entries final {
+   public:
+    struct Iterator final {
+      using iterator_t = typename entries_t::const_iterator;
+      iterator_t iterator;
+      explicit Iterator(iterator_t iterator) : iterator(std::move(iterator)) {}
+      void operator++() { ++iterator; }
+      bool operator==(const Iterator& rhs) const { return iterator == rhs.iterator; }
+      bool operator!=(const Iterator& rhs) const { return !operator==(rhs); }
+      sfinae::CF<KEY> key() const { return iterator->first; }
+      const T& operator*() const { return *iterator->second; }
+      const T* operator->() const { return iterator->second; }
+    };
+
+    explicit Entries(const entries_t& entries) : entries_(entries) {}
+    bool Empty() const { return entries_.empty(); }
+    size_t Size() const { return entries_.size(); }
+    Iterator begin() const { return Iterator(entries_.cbegin()); }
+    Iterator end() const { return Iterator(entries_.cend()); }
+
+   private:
+    const entries_t& entries_;
+  };
+
+  Entries operator[](sfinae::CF<value_t> value) const {
+    static const entries_t no_entries;
+    const auto iterator = map_.find(value);
+    return Entries(iterator != map_.end() ? iterator->second : no_entries);
+  }
+
+  // Iterates over all the entries, grouped by their values.
+  struct Iterator final {
+    using outer_iterator_t = typename map_t::const_iterator;
+    using inner_iterator_t = typename entries_t::const_iterator;
+    outer_iterator_t outer;
+    outer_iterator_t outer_end;
+    inner_iterator_t inner;
+    Iterator(outer_iterator_t outer, outer_iterator_t outer_end)
+        : outer(std::move(outer)), outer_end(std::move(outer_end)) {
+      if (this->outer != this->outer_end) {
+        inner = this->outer->second.cbegin();
+      }
+    }
+    void operator++() {
+      ++inner;
+      if (inner == outer->second.cend()) {
+        ++outer;
+        if (outer != outer_end) {
+          inner = outer->second.cbegin();
+        }
+      }
+    }
+    bool operator==(const Iterator& rhs) const {
+      return outer == rhs.outer && (outer == outer_end || inner == rhs.inner);
+    }
+    bool operator!=(const Iterator& rhs) const { return !operator==(rhs); }
+    sfinae::CF<value_t> value() const { return outer->first; }
+    sfinae::CF<KEY> key() const { return inner->first; }
+    const T& operator*() const { return *inner->second; }
+    const T* operator->() const { return inner->second; }
+  };
+
+  Iterator begin() const { return Iterator(map_.cbegin(), map_.cend()); }
+  Iterator end() const { return Iterator(map_.cend(), map_.cend()); }
+
+  bool Conflicts(const T&, const T*) const { return false; }
+
+  void Insert(sfinae::CF<KEY> key, const T& entry) {
+    const T*& placeholder = map_[INDEX::GetValue(entry)][key];
+    if (!placeholder) {
+      ++size_;
+    }
+    placeholder = &entry;
+  }
+
+  void Remove(sfinae::CF<KEY> key, const T& entry) {
+    const auto iterator = map_.find(INDEX::GetValue(entry));
+    if (iterator != map_.end() && iterator->second.erase(key)) {
+      --size_;
+      if (iterator->second.empty()) {
+        map_.erase(iterator);
+      }
+    }
+  }
+
+ private:
+  DictionaryIndex(const DictionaryIndex&) = delete;
+  DictionaryIndex& operator=(const DictionaryIndex&) = delete;
+
+  map_t map_;
+  size_t size_ = 0u;
+};
+
+// The indexes attached to the dictionary field with `CURRENT_STORAGE_FIELD_INDEXES`, found via ADL.
+template <typename FIELD, typename = void>
+struct dictionary_field_indexes {
+  using type = metaprogramming::TypeListImpl<>;
+};
+
+template <typename FIELD>
+struct dictionary_field_indexes<FIELD,
+                                std::void_t<decltype(CurrentStorageFieldIndexes(std::declval<const FIELD*>()))>> {
+  using type = decltype(CurrentStorageFieldIndexes(std::declval<const FIELD*>()));
+};
+
+// Uses the storage field type of the update event of the dictionary, the one `CURRENT_STORAGE_FIELD_ENTRY` declares.
+template <typename UPDATE_EVENT, typename = void>
+struct dictionary_indexes {
+  using type = metaprogramming::TypeListImpl<>;
+};
+
+template <typename UPDATE_EVENT>
+struct dictionary_indexes<UPDATE_EVENT, std::void_t<typename UPDATE_EVENT::storage_field_t>> {
+  using type = typename dictionary_field_indexes<typename UPDATE_EVENT::storage_field_t>::type;
+};
+
+template <typename T, typename KEY, template <typename...> class MAP, typename INDEXES>
+struct dictionary_indexes_tuple;
+
+template <typename T, typename KEY, template <typename...> class MAP, typename... INDEXES>
+struct dictionary_indexes_tuple<T, KEY, MAP, metaprogramming::TypeListImpl<INDEXES...>> {
+  using type = std::tuple<DictionaryIndex<INDEXES, T, KEY, MAP>...>;
+};
+
+}  // namespace container
+}  // namespace storage
+}  // namespace current
+
+// Declares `index_name` as an index of the entries of type `entry_type` on their `field`, of the `kind` from above.
+#define CURRENT_STORAGE_INDEX(index_name, entry_type, field, kind)                                 \
+  struct index_name final {                                                                        \
+    using entry_t = entry_type;                                                                    \
+    using value_t = ::current::decay_t<decltype(std::declval<entry_type>().field)>;                \
+    using kind_t = ::current::storage::index::kind;                                                \
+    static ::current::copy_free<value_t> GetValue(const entry_type& entry) { return entry.field; } \
+  }
+
+// Attaches the indexes to the dictionary storage field declared as `entry_name` by `CURRENT_STORAGE_FIELD_ENTRY`.
+// Should be used in the namespace of `entry_name`, and before the storage using it is declared.
+#define CURRENT_STORAGE_FIELD_INDEXES(entry_name, ...) \
+  ::current::metaprogramming::TypeListImpl<__VA_ARGS__> CurrentStorageFieldIndexes(const entry_name*)
+
+#endif  // CURRENT_STORAGE_CONTAINER_DICTIONARY_INDEX_H
@@ -0,0 +1,393 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// `FlatHashMap<K, V>` is an open-addressing hash map, with the `std::pair<K, V>`-s stored inline, in one array,
+// and one control byte per slot, in another. A lookup touches the control bytes, which are scanned linearly and keep
+// seven bits of the hash each, and only compares the keys of the slots whose bits match. Compared to
+// `std::unordered_map`, it saves an allocation and a pointer chase per entry, at the cost of pointer stability:
+// growing or rehashing the map moves the entries, so the pointers, references, and iterators into it are invalidated
+// by any insertion. Erasing only invalidates the erased entry.
+//
+// The keys other than the numbers and the enums, such as the strings, have their hashes stored along with them, in
+// the third array, so that they are not rehashed as the map grows, and are only compared if their full hashes match.
+//
+// The subset of the `std::unordered_map` interface implemented is what the storage containers use.
+
+#ifndef CURRENT_STORAGE_CONTAINER_FLAT_HASH_MAP_H
+#define CURRENT_STORAGE_CONTAINER_FLAT_HASH_MAP_H
+
+#include "../../port.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "../../bricks/util/comparators.h"
+
+namespace current {
+namespace storage {
+namespace container {
+
+template <typename KEY, typename VALUE, typename HASH = GenericHashFunction<KEY>, typename EQUAL = std::equal_to<KEY>>
+class FlatHashMap final {
+ public:
+  using key_type = KEY;
+  using mapped_type = VALUE;
+  using value_type = std::pair<KEY, VALUE>;
+  using size_type = size_t;
+
+  template <bool CONST>
+  class IteratorImpl final {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::pair<KEY, VALUE>;
+    using map_t = std::conditional_t<CONST, const FlatHashMap, FlatHashMap>;
+    using value_t = std::conditional_t<CONST, const value_type, value_type>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = value_t*;
+    using reference = value_t&;
+
+    IteratorImpl() = default;
+    template <bool RHS_CONST, class = std::enable_if_t<CONST && !RHS_CONST>>
+    IteratorImpl(const IteratorImpl<RHS_CONST>& rhs) : map_(rhs.map_), index_(rhs.index_) {}
+
+    value_t& operator*() const { return map_->slots_[index_]; }
+    value_t* operator->() const { return &map_->slots_[index_]; }
+    IteratorImpl& operator++() {
+      index_ = map_->NextFullSlot(index_ + 1u);
+      return *this;
+    }
+    IteratorImpl operator++(int) {
+      IteratorImpl result = *this;
+      operator++();
+      return result;
+    }
+    template <bool RHS_CONST>
+    bool operator==(const IteratorImpl<RHS_CONST>& rhs) const {
+      return index_ == rhs.index_;
+    }
+    template <bool RHS_CONST>
+    bool operator!=(const IteratorImpl<RHS_CONST>& rhs) const {
+      return index_ != rhs.index_;
+    }
+
+   private:
+    friend class FlatHashMap;
+    template <bool>
+    friend class IteratorImpl;
+    IteratorImpl(map_t* map, size_t index) : map_(map), index_(index) {}
+
+    map_t* map_ = nullptr;
+    size_t index_ = 0u;
+  };
+
+  using iterator = IteratorImpl<false>;
+  using const_iterator = IteratorImpl<true>;
+
+  FlatHashMap() = default;
+  ~FlatHashMap() { Release(); }
+
+  FlatHashMap(const FlatHashMap& rhs) {
+    if (rhs.capacity_) {
+      Allocate(rhs.capacity_);
+      for (size_t i = rhs.NextFullSlot(0u); i < rhs.capacity_; i = rhs.NextFullSlot(i + 1u)) {
+        const uint64_t hash = rhs.SlotHash(i);
+        SetSlot(InsertionSlot(hash), hash, rhs.slots_[i]);
+        ++size_;
+      }
+    }
+  }
+  FlatHashMap(FlatHashMap&& rhs) noexcept { Swap(rhs); }
+  FlatHashMap& operator=(FlatHashMap rhs) noexcept {
+    Swap(rhs);
+    return *this;
+  }
+
+  bool empty() const { return !size_; }
+  size_t size() const { return size_; }
+
+  iterator begin() { return iterator(this, NextFullSlot(0u)); }
+  iterator end() { return iterator(this, capacity_); }
+  const_iterator begin() const { return const_iterator(this, NextFullSlot(0u)); }
+  const_iterator end() const { return const_iterator(this, capacity_); }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+  iterator find(const KEY& key) { return iterator(this, FindSlot(key)); }
+  const_iterator find(const KEY& key) const { return const_iterator(this, FindSlot(key)); }
+  size_t count(const KEY& key) const { return FindSlot(key) != capacity_ ? 1u : 0u; }
+
+  // Constructs the value from `args` unless the key is already present, same as `std::unordered_map::try_emplace()`.
+  template <typename K, typename... ARGS>
+  std::pair<iterator, bool> emplace(K&& key, ARGS&&... args) {
+    const uint64_t hash = Hash(key);
+    const size_t existing = FindSlot(key, hash);
+    if (existing != capacity_) {
+      return std::make_pair(iterator(this, existing), false);
+    }
+    ReserveForOneMore();
+    const size_t index = InsertionSlot(hash);
+    const bool reusing_deleted_slot = (control_[index] == kDeleted);
+    SetSlot(index,
+            hash,
+            std::piecewise_construct,
+            std::forward_as_tuple(std::forward<K>(key)),
+            std::forward_as_tuple(std::forward<ARGS>(args)...));
+    if (reusing_deleted_slot) {
+      --deleted_;
+    }
+    ++size_;
+    return std::make_pair(iterator(this, index), true);
+  }
+
+  VALUE& operator[](const KEY& key) { return emplace(key).first->second; }
+
+  iterator erase(const_iterator position) {
+    EraseSlot(position.index_);
+    return iterator(this, NextFullSlot(position.index_ + 1u));
+  }
+  iterator erase(iterator position) { return erase(const_iterator(position)); }
+  size_t erase(const KEY& key) {
+    const size_t index = FindSlot(key);
+    if (index != capacity_) {
+      EraseSlot(index);
+      return 1u;
+    } else {
+      return 0u;
+    }
+  }
+
+  void clear() { FlatHashMap().Swap(*this); }
+
+  // Iterates in the order of the hashes, rounded down to the slots they map onto, for the cursors of `cursor.h`.
+  // Calls `f(entry)` for the entries with the hashes from `hash` on, which map onto the next `slots` slots, and sets
+  // `hash` to the one to continue from. Returns `false` once there is nothing left. Unlike the positions of the
+  // entries, their hashes, and thus their order, do not change as the map is rehashed.
+  template <typename F>
+  bool ForEachEntryFromHash(uint64_t& hash, size_t slots, F&& f) const {
+    if (!capacity_) {
+      return false;
+    }
+    const size_t first = FirstSlot(hash);
+    const size_t last = first + std::min(std::max(slots, static_cast<size_t>(1u)), capacity_ - first);
+    const bool done = (last == capacity_);
+    const uint64_t end_hash = done ? 0u : (static_cast<uint64_t>(last) << shift_);
+    // Each entry is between the slot its hash maps onto and the next empty slot, possibly wrapping around.
+    for (size_t i = first, scanned = 0u; scanned < last - first || (scanned < capacity_ && control_[i] != kEmpty);
+         i = (i + 1u) & (capacity_ - 1u), ++scanned) {
+      if (control_[i] >= 0) {
+        const uint64_t entry_hash = SlotHash(i);
+        if (entry_hash >= hash && (done || entry_hash < end_hash)) {
+          f(slots_[i]);
+        }
+      }
+    }
+    hash = end_hash;
+    return !done;
+  }
+
+  // Makes room for `size` entries, so that no more than that many insertions move the existing entries.
+  void reserve(size_t size) {
+    size_t capacity = kMinCapacity;
+    while (capacity * kMaxLoadNumerator < size * kMaxLoadDenominator) {
+      capacity *= 2u;
+    }
+    if (capacity > capacity_) {
+      Rehash(capacity);
+    }
+  }
+
+ private:
+  // The control byte of a full slot is the lower seven bits of its hash, so it is never negative.
+  static constexpr int8_t kEmpty = -128;
+  static constexpr int8_t kDeleted = -2;
+  static constexpr size_t kMinCapacity = 16u;
+  // At most 7/8 of the slots are full or deleted, so that a lookup always finds an empty slot to stop at.
+  static constexpr size_t kMaxLoadNumerator = 7u;
+  static constexpr size_t kMaxLoadDenominator = 8u;
+  // Whether the hashes of the keys are stored in `hashes_`, for they may take a while to compute.
+  static constexpr bool kStoresHashes = !std::is_arithmetic_v<KEY> && !std::is_enum_v<KEY>;
+
+  // The hash functions of integers are often the identity, so their bits are mixed first: the upper bits of the
+  // product pick the slot, and the lower seven bits end up in the control byte.
+  static uint64_t Hash(const KEY& key) {
+    return static_cast<uint64_t>(HASH()(key)) * static_cast<uint64_t>(0x9e3779b97f4a7c15ull);
+  }
+  static int8_t ControlByte(uint64_t hash) { return static_cast<int8_t>(hash & 0x7f); }
+  uint64_t SlotHash(size_t index) const {
+    if constexpr (kStoresHashes) {
+      return hashes_[index];
+    } else {
+      return Hash(slots_[index].first);
+    }
+  }
+  bool SlotMatches(size_t index, const KEY& key, uint64_t hash) const {
+    if constexpr (kStoresHashes) {
+      if (hashes_[index] != hash) {
+        return false;
+      }
+    }
+    return EQUAL()(slots_[index].first, key);
+  }
+  size_t FirstSlot(uint64_t hash) const { return static_cast<size_t>(hash >> shift_); }
+
+  size_t FindSlot(const KEY& key) const { return FindSlot(key, Hash(key)); }
+  size_t FindSlot(const KEY& key, uint64_t hash) const {
+    if (!size_) {
+      return capacity_;
+    }
+    const int8_t control = ControlByte(hash);
+    for (size_t index = FirstSlot(hash);; index = (index + 1u) & (capacity_ - 1u)) {
+      if (control_[index] == control && SlotMatches(index, key, hash)) {
+        return index;
+      } else if (control_[index] == kEmpty) {
+        return capacity_;
+      }
+    }
+  }
+
+  // The first empty or deleted slot for the hash, to put a key known not to be present into.
+  size_t InsertionSlot(uint64_t hash) const {
+    size_t index = FirstSlot(hash);
+    while (control_[index] >= 0) {
+      index = (index + 1u) & (capacity_ - 1u);
+    }
+    return index;
+  }
+
+  size_t NextFullSlot(size_t index) const {
+    while (index < capacity_ && control_[index] < 0) {
+      ++index;
+    }
+    return index;
+  }
+
+  template <typename... ARGS>
+  void SetSlot(size_t index, uint64_t hash, ARGS&&... args) {
+    // The control byte is only set once the entry has been constructed, in case its constructor throws.
+    new (&slots_[index]) value_type(std::forward<ARGS>(args)...);
+    if constexpr (kStoresHashes) {
+      hashes_[index] = hash;
+    }
+    control_[index] = ControlByte(hash);
+  }
+
+  void EraseSlot(size_t index) {
+    slots_[index].~value_type();
+    // No lookup stops at a deleted slot. If the next slot is empty, the lookups passing through this one would stop
+    // there anyway, so this slot can be marked empty too.
+    if (control_[(index + 1u) & (capacity_ - 1u)] == kEmpty) {
+      control_[index] = kEmpty;
+    } else {
+      control_[index] = kDeleted;
+      ++deleted_;
+    }
+    --size_;
+  }
+
+  void ReserveForOneMore() {
+    if ((size_ + deleted_ + 1u) * kMaxLoadDenominator > capacity_ * kMaxLoadNumerator) {
+      // Rehash at the same capacity if most of the slots to reclaim are deleted ones, and grow otherwise.
+      if (!capacity_) {
+        Rehash(kMinCapacity);
+      } else if ((size_ + 1u) * kMaxLoadDenominator * 2u <= capacity_ * kMaxLoadNumerator) {
+        Rehash(capacity_);
+      } else {
+        Rehash(capacity_ * 2u);
+      }
+    }
+  }
+
+  void Rehash(size_t capacity) {
+    FlatHashMap rehashed;
+    rehashed.Allocate(capacity);
+    for (size_t i = NextFullSlot(0u); i < capacity_; i = NextFullSlot(i + 1u)) {
+      const uint64_t hash = SlotHash(i);
+      rehashed.SetSlot(rehashed.InsertionSlot(hash), hash, std::move_if_noexcept(slots_[i]));
+      ++rehashed.size_;
+    }
+    Swap(rehashed);
+  }
+
+  void Allocate(size_t capacity) {
+    slots_ = std::allocator<value_type>().allocate(capacity);
+    control_ = new int8_t[capacity];
+    std::memset(control_, kEmpty, capacity);
+    if constexpr (kStoresHashes) {
+      hashes_ = new uint64_t[capacity];
+    }
+    capacity_ = capacity;
+    shift_ = 64u;
+    while ((static_cast<size_t>(1u) << (64u - shift_)) < capacity) {
+      --shift_;
+    }
+  }
+
+  void Release() {
+    if (capacity_) {
+      for (size_t i = NextFullSlot(0u); i < capacity_; i = NextFullSlot(i + 1u)) {
+        slots_[i].~value_type();
+      }
+      std::allocator<value_type>().deallocate(slots_, capacity_);
+      delete[] control_;
+      delete[] hashes_;
+    }
+  }
+
+  void Swap(FlatHashMap& rhs) noexcept {
+    std::swap(slots_, rhs.slots_);
+    std::swap(control_, rhs.control_);
+    std::swap(hashes_, rhs.hashes_);
+    std::swap(capacity_, rhs.capacity_);
+    std::swap(size_, rhs.size_);
+    std::swap(deleted_, rhs.deleted_);
+    std::swap(shift_, rhs.shift_);
+  }
+
+  value_type* slots_ = nullptr;
+  int8_t* control_ = nullptr;
+  uint64_t* hashes_ = nullptr;  // Only allocated if `kStoresHashes`.
+  size_t capacity_ = 0u;  // Zero or a power of two.
+  size_t size_ = 0u;
+  size_t deleted_ = 0u;
+  size_t shift_ = 64u;  // `64 - log2(capacity_)`, to map the hash onto the slots.
+};
+
+template <typename>
+struct IsFlatHashMap : std::false_type {};
+
+template <typename KEY, typename VALUE, typename HASH, typename EQUAL>
+struct IsFlatHashMap<FlatHashMap<KEY, VALUE, HASH, EQUAL>> : std::true_type {};
+
+}  // namespace container
+}  // namespace storage
+}  // namespace current
+
+#endif  // CURRENT_STORAGE_CONTAINER_FLAT_HASH_MAP_H
@@ -27,6 +27,7 @@ SOFTWARE.
 #define CURRENT_STORAGE_CONTAINER_MANY_TO_MANY_H
 
 #include "common.h"
+#include "cursor.h"
 #include "sfinae.h"
 
 #include "../base.h"
@@ -56,12 +57,17 @@ class GenericManyToMany {
   using row_t = sfinae::entry_row_t<T>;
   using col_t = sfinae::entry_col_t<T>;
   using key_t = std::pair<row_t, col_t>;
-  using whole_matrix_map_t = std::unordered_map<key_t, std::unique_ptr<T>, GenericHashFunction<key_t>>;
-  using row_elements_map_t = COL_MAP<col_t, const T*>;
-  using col_elements_map_t = ROW_MAP<row_t, const T*>;
+  // The entries are stored inline, in the nodes of the maps of their rows, and the other maps point to these nodes,
+  // so that iterating over a row does not chase a pointer per entry. The nodes of both `std::unordered_map` and
+  // `std::map` stay where they are for as long as their keys are in the maps.
+  using whole_matrix_map_t = std::unordered_map<key_t, const EntryWithLastModified<T>*, GenericHashFunction<key_t>>;
+  using row_elements_map_t = COL_MAP<col_t, EntryWithLastModified<T>>;
+  using col_elements_map_t = ROW_MAP<row_t, const EntryWithLastModified<T>*>;
   using forward_map_t = ROW_MAP<row_t, row_elements_map_t>;
   using transposed_map_t = COL_MAP<col_t, col_elements_map_t>;
   using semantics_t = storage::semantics::ManyToMany;
+  // The event recreating an entry, for the bulk loads, see `bulk_load.h`.
+  using update_event_t = UPDATE_EVENT;
 
   GenericManyToMany(const std::string& field_name, MutationJournal& journal)
       : field_name_(field_name), journal_(journal) {}
@@ -80,24 +86,21 @@ class GenericManyToMany {
     const auto col = sfinae::GetCol(object);
     const auto key = std::make_pair(row, col);
     const auto map_cit = map_.find(key);
-    const auto lm_cit = last_modified_.find(key);
     if (map_cit != map_.end()) {
-      const T& previous_object = *(map_cit->second);
-      CURRENT_ASSERT(lm_cit != last_modified_.end());
-      const auto previous_timestamp = lm_cit->second;
+      const T& previous_object = map_cit->second->entry;
+      const auto previous_timestamp = map_cit->second->last_modified;
       journal_.LogMutation(UPDATE_EVENT(now, object), [this, key, previous_object, previous_timestamp]() {
         DoUpdateWithLastModified(previous_timestamp, key, previous_object);
       });
     } else {
-      if (lm_cit != last_modified_.end()) {
-        const auto previous_timestamp = lm_cit->second;
+      const auto erased_cit = erased_last_modified_.find(key);
+      if (erased_cit != erased_last_modified_.end()) {
+        const auto previous_timestamp = erased_cit->second;
         journal_.LogMutation(UPDATE_EVENT(now, object),
                              [this, key, previous_timestamp]() { DoEraseWithLastModified(previous_timestamp, key); });
       } else {
-        journal_.LogMutation(UPDATE_EVENT(now, object), [this, key]() {
-          last_modified_.erase(key);
-          DoEraseWithoutTouchingLastModified(key);
-        });
+        journal_.LogMutation(UPDATE_EVENT(now, object),
+                             [this, key]() { DoEraseWithoutTouchingLastModified(key); });
       }
     }
     DoUpdateWithLastModified(now, key, object);
@@ -108,10 +111,8 @@ class GenericManyToMany {
     const auto now = current::time::Now();
     const auto map_cit = map_.find(key);
     if (map_cit != map_.end()) {
-      const T& previous_object = *(map_cit->second);
-      const auto lm_cit = last_modified_.find(key);
-      CURRENT_ASSERT(lm_cit != last_modified_.end());
-      const auto previous_timestamp = lm_cit->second;
+      const T& previous_object = map_cit->second->entry;
+      const auto previous_timestamp = map_cit->second->last_modified;
       journal_.LogMutation(DELETE_EVENT(now, previous_object), [this, key, previous_object, previous_timestamp]() {
         DoUpdateWithLastModified(previous_timestamp, key, previous_object);
       });
@@ -123,7 +124,7 @@ class GenericManyToMany {
   ImmutableOptional<T> operator[](const key_t& key) const {
     const auto cit = map_.find(key);
     if (cit != map_.end()) {
-      return ImmutableOptional<T>(FromBarePointer(), cit->second.get());
+      return ImmutableOptional<T>(FromBarePointer(), &cit->second->entry);
     } else {
       return nullptr;
     }
@@ -133,9 +134,13 @@ class GenericManyToMany {
   }
 
   ImmutableOptional<std::chrono::microseconds> LastModified(const key_t& key) const {
-    const auto cit = last_modified_.find(key);
-    if (cit != last_modified_.end()) {
-      return cit->second;
+    const auto cit = map_.find(key);
+    if (cit != map_.end()) {
+      return cit->second->last_modified;
+    }
+    const auto erased_cit = erased_last_modified_.find(key);
+    if (erased_cit != erased_last_modified_.end()) {
+      return erased_cit->second;
     } else {
       return nullptr;
     }
@@ -144,6 +149,10 @@ class GenericManyToMany {
     return LastModified(std::make_pair(row, col));
   }
 
+  // The time any entry of this field was last added, updated, or erased at, zero if it never was. It does not move
+  // back as the transactions are rolled back, so that it changes whenever the contents of the field may have.
+  std::chrono::microseconds FieldLastModified() const { return field_last_modified_; }
+
   void operator()(const UPDATE_EVENT& e) {
     const auto row = sfinae::GetRow(e.data);
     const auto col = sfinae::GetCol(e.data);
@@ -151,6 +160,21 @@ class GenericManyToMany {
   }
   void operator()(const DELETE_EVENT& e) { DoEraseWithLastModified(e.us, std::make_pair(e.key.first, e.key.second)); }
 
+  // Calls `f` with the events which, replayed into an empty container, recreate this one, for the snapshots.
+  // The deletions of the keys no longer present go first, so that they can not affect the entries added after them.
+  template <typename F>
+  void ForEachSnapshotEvent(F&& f) const {
+    for (const auto& erased : erased_last_modified_) {
+      DELETE_EVENT e;
+      e.us = erased.second;
+      e.key = erased.first;
+      f(std::move(e));
+    }
+    for (const auto& element : map_) {
+      f(UPDATE_EVENT(element.second->last_modified, element.second->entry));
+    }
+  }
+
   template <typename OUTER_MAP>
   struct OuterAccessor final {
     using OUTER_KEY = typename OUTER_MAP::key_type;
@@ -217,13 +241,32 @@ class GenericManyToMany {
   iterator_t begin() const { return iterator_t(map_.begin()); }
   iterator_t end() const { return iterator_t(map_.end()); }
 
+  // For the paginated exports via REST, see `cursor.h`.
+  template <typename F>
+  std::string ForEachEntryFromCursor(const std::string& cursor, size_t limit, F&& f) const {
+    return container::ForEachEntryFromCursor(map_, cursor, limit, std::forward<F>(f));
+  }
+
  private:
+  // Each key is either in `map_`, or in `erased_last_modified_`, or in neither if it was never modified.
   void DoUpdateWithLastModified(std::chrono::microseconds us, const key_t& key, const T& object) {
-    last_modified_[key] = us;
-    auto& placeholder = map_[key];
-    placeholder = std::make_unique<T>(object);
-    forward_[key.first][key.second] = placeholder.get();
-    transposed_[key.second][key.first] = placeholder.get();
+    if (us > field_last_modified_) {
+      field_last_modified_ = us;
+    }
+    if (!erased_last_modified_.empty()) {
+      erased_last_modified_.erase(key);
+    }
+    auto& map_row = forward_[key.first];
+    const auto emplaced = map_row.emplace(key.second, EntryWithLastModified<T>(object, us));
+    if (!emplaced.second) {
+      // Overwrite the entry in place, so that the pointers to it remain valid.
+      emplaced.first->second.entry = object;
+      emplaced.first->second.last_modified = us;
+    } else {
+      const EntryWithLastModified<T>* entry = &emplaced.first->second;
+      map_[key] = entry;
+      transposed_[key.second][key.first] = entry;
+    }
   }
 
   void DoEraseWithoutTouchingLastModified(const key_t& key) {
@@ -241,7 +284,10 @@ class GenericManyToMany {
   }
 
   void DoEraseWithLastModified(std::chrono::microseconds us, const key_t& key) {
-    last_modified_[key] = us;
+    if (us > field_last_modified_) {
+      field_last_modified_ = us;
+    }
+    erased_last_modified_[key] = us;
     DoEraseWithoutTouchingLastModified(key);
   }
 
@@ -249,7 +295,10 @@ class GenericManyToMany {
   whole_matrix_map_t map_;
   forward_map_t forward_;
   transposed_map_t transposed_;
-  std::unordered_map<key_t, std::chrono::microseconds, GenericHashFunction<key_t>> last_modified_;
+  // The times the keys no longer in `map_` were erased.
+  std::unordered_map<key_t, std::chrono::microseconds, GenericHashFunction<key_t>> erased_last_modified_;
+  // The latest of the times of the mutations applied, see `FieldLastModified()`.
+  std::chrono::microseconds field_last_modified_ = std::chrono::microseconds(0);
   MutationJournal& journal_;
 };
 
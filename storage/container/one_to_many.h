@@ -27,6 +27,7 @@ SOFTWARE.
 #define CURRENT_STORAGE_CONTAINER_ONE_TO_MANY_H
 
 #include "common.h"
+#include "cursor.h"
 #include "sfinae.h"
 
 #include "../base.h"
@@ -56,11 +57,16 @@ class GenericOneToMany {
   using row_t = sfinae::entry_row_t<T>;
   using col_t = sfinae::entry_col_t<T>;
   using key_t = std::pair<row_t, col_t>;
-  using elements_map_t = std::unordered_map<key_t, std::unique_ptr<T>, GenericHashFunction<key_t>>;
-  using row_elements_map_t = COL_MAP<col_t, const T*>;
+  // The entries are stored inline, in the nodes of the maps of their rows, and the other maps point to these nodes,
+  // so that iterating over a row does not chase a pointer per entry. The nodes of both `std::unordered_map` and
+  // `std::map` stay where they are for as long as their keys are in the maps.
+  using elements_map_t = std::unordered_map<key_t, const EntryWithLastModified<T>*, GenericHashFunction<key_t>>;
+  using row_elements_map_t = COL_MAP<col_t, EntryWithLastModified<T>>;
   using forward_map_t = ROW_MAP<row_t, row_elements_map_t>;
-  using transposed_map_t = row_elements_map_t;
+  using transposed_map_t = COL_MAP<col_t, const EntryWithLastModified<T>*>;
   using semantics_t = storage::semantics::OneToMany;
+  // The event recreating an entry, for the bulk loads, see `bulk_load.h`.
+  using update_event_t = UPDATE_EVENT;
 
   GenericOneToMany(const std::string& field_name, MutationJournal& journal)
       : field_name_(field_name), journal_(journal) {}
@@ -82,22 +88,18 @@ class GenericOneToMany {
     const auto col = sfinae::GetCol(object);
     const auto key = std::make_pair(row, col);
     const auto map_cit = map_.find(key);
-    const auto lm_cit = last_modified_.find(key);
     if (map_cit != map_.end()) {
-      const T& previous_object = *(map_cit->second);
-      CURRENT_ASSERT(lm_cit != last_modified_.end());
-      const auto previous_timestamp = lm_cit->second;
+      const T& previous_object = map_cit->second->entry;
+      const auto previous_timestamp = map_cit->second->last_modified;
       journal_.LogMutation(UPDATE_EVENT(now, object), [this, key, previous_object, previous_timestamp]() {
         DoUpdateWithLastModified(previous_timestamp, key, previous_object);
       });
     } else {
       const auto transposed_cit = transposed_.find(col);
       if (transposed_cit != transposed_.end()) {
-        const T& conflicting_object = *(transposed_cit->second);
+        const T& conflicting_object = transposed_cit->second->entry;
         const auto conflicting_object_key = std::make_pair(sfinae::GetRow(conflicting_object), col);
-        const auto conflicting_object_lm_cit = last_modified_.find(conflicting_object_key);
-        CURRENT_ASSERT(conflicting_object_lm_cit != last_modified_.end());
-        const auto conflicting_object_timestamp = conflicting_object_lm_cit->second;
+        const auto conflicting_object_timestamp = transposed_cit->second->last_modified;
         journal_.LogMutation(DELETE_EVENT(now, conflicting_object),
                              [this, conflicting_object_key, conflicting_object, conflicting_object_timestamp]() {
                                DoUpdateWithLastModified(
@@ -106,15 +108,14 @@ class GenericOneToMany {
         DoEraseWithLastModified(now, conflicting_object_key);
         now = current::time::Now();
       }
-      if (lm_cit != last_modified_.end()) {
-        const auto previous_timestamp = lm_cit->second;
+      const auto erased_cit = erased_last_modified_.find(key);
+      if (erased_cit != erased_last_modified_.end()) {
+        const auto previous_timestamp = erased_cit->second;
         journal_.LogMutation(UPDATE_EVENT(now, object),
                              [this, key, previous_timestamp]() { DoEraseWithLastModified(previous_timestamp, key); });
       } else {
-        journal_.LogMutation(UPDATE_EVENT(now, object), [this, key]() {
-          last_modified_.erase(key);
-          DoEraseWithoutTouchingLastModified(key);
-        });
+        journal_.LogMutation(UPDATE_EVENT(now, object),
+                             [this, key]() { DoEraseWithoutTouchingLastModified(key); });
       }
     }
     DoUpdateWithLastModified(now, key, object);
@@ -125,10 +126,8 @@ class GenericOneToMany {
     const auto now = current::time::Now();
     const auto map_cit = map_.find(key);
     if (map_cit != map_.end()) {
-      const T& previous_object = *(map_cit->second);
-      const auto lm_cit = last_modified_.find(key);
-      CURRENT_ASSERT(lm_cit != last_modified_.end());
-      const auto previous_timestamp = lm_cit->second;
+      const T& previous_object = map_cit->second->entry;
+      const auto previous_timestamp = map_cit->second->last_modified;
       journal_.LogMutation(DELETE_EVENT(now, previous_object), [this, key, previous_object, previous_timestamp]() {
         DoUpdateWithLastModified(previous_timestamp, key, previous_object);
       });
@@ -141,11 +140,9 @@ class GenericOneToMany {
     const auto now = current::time::Now();
     const auto map_cit = transposed_.find(col);
     if (map_cit != transposed_.end()) {
-      const T& previous_object = *(map_cit->second);
+      const T& previous_object = map_cit->second->entry;
       const auto key = std::make_pair(sfinae::GetRow(previous_object), col);
-      const auto lm_cit = last_modified_.find(key);
-      CURRENT_ASSERT(lm_cit != last_modified_.end());
-      const auto previous_timestamp = lm_cit->second;
+      const auto previous_timestamp = map_cit->second->last_modified;
       journal_.LogMutation(DELETE_EVENT(now, previous_object), [this, key, previous_object, previous_timestamp]() {
         DoUpdateWithLastModified(previous_timestamp, key, previous_object);
       });
@@ -156,7 +153,7 @@ class GenericOneToMany {
   ImmutableOptional<T> operator[](const key_t& key) const {
     const auto cit = map_.find(key);
     if (cit != map_.end()) {
-      return ImmutableOptional<T>(FromBarePointer(), cit->second.get());
+      return ImmutableOptional<T>(FromBarePointer(), &cit->second->entry);
     } else {
       return nullptr;
     }
@@ -167,16 +164,20 @@ class GenericOneToMany {
   ImmutableOptional<T> GetEntryFromCol(sfinae::CF<col_t> col) const {
     const auto cit = transposed_.find(col);
     if (cit != transposed_.end()) {
-      return ImmutableOptional<T>(FromBarePointer(), cit->second);
+      return ImmutableOptional<T>(FromBarePointer(), &cit->second->entry);
     } else {
       return nullptr;
     }
   }
 
   ImmutableOptional<std::chrono::microseconds> LastModified(const key_t& key) const {
-    const auto cit = last_modified_.find(key);
-    if (cit != last_modified_.end()) {
-      return cit->second;
+    const auto cit = map_.find(key);
+    if (cit != map_.end()) {
+      return cit->second->last_modified;
+    }
+    const auto erased_cit = erased_last_modified_.find(key);
+    if (erased_cit != erased_last_modified_.end()) {
+      return erased_cit->second;
     } else {
       return nullptr;
     }
@@ -185,6 +186,10 @@ class GenericOneToMany {
     return LastModified(std::make_pair(row, col));
   }
 
+  // The time any entry of this field was last added, updated, or erased at, zero if it never was. It does not move
+  // back as the transactions are rolled back, so that it changes whenever the contents of the field may have.
+  std::chrono::microseconds FieldLastModified() const { return field_last_modified_; }
+
   bool DoesNotConflict(const key_t& key) const { return transposed_.find(key.second) == transposed_.end(); }
   bool DoesNotConflict(sfinae::CF<row_t> row, sfinae::CF<col_t> col) const {
     return DoesNotConflict(std::make_pair(row, col));
@@ -197,6 +202,21 @@ class GenericOneToMany {
   }
   void operator()(const DELETE_EVENT& e) { DoEraseWithLastModified(e.us, std::make_pair(e.key.first, e.key.second)); }
 
+  // Calls `f` with the events which, replayed into an empty container, recreate this one, for the snapshots.
+  // The deletions of the keys no longer present go first, so that they can not affect the entries added after them.
+  template <typename F>
+  void ForEachSnapshotEvent(F&& f) const {
+    for (const auto& erased : erased_last_modified_) {
+      DELETE_EVENT e;
+      e.us = erased.second;
+      e.key = erased.first;
+      f(std::move(e));
+    }
+    for (const auto& element : map_) {
+      f(UPDATE_EVENT(element.second->last_modified, element.second->entry));
+    }
+  }
+
   template <typename ROWS_MAP>
   struct RowsAccessor final {
     using key_t = typename ROWS_MAP::key_type;
@@ -258,13 +278,32 @@ class GenericOneToMany {
   iterator_t begin() const { return iterator_t(map_.begin()); }
   iterator_t end() const { return iterator_t(map_.end()); }
 
+  // For the paginated exports via REST, see `cursor.h`.
+  template <typename F>
+  std::string ForEachEntryFromCursor(const std::string& cursor, size_t limit, F&& f) const {
+    return container::ForEachEntryFromCursor(map_, cursor, limit, std::forward<F>(f));
+  }
+
  private:
+  // Each key is either in `map_`, or in `erased_last_modified_`, or in neither if it was never modified.
   void DoUpdateWithLastModified(std::chrono::microseconds us, const key_t& key, const T& object) {
-    last_modified_[key] = us;
-    auto& placeholder = map_[key];
-    placeholder = std::make_unique<T>(object);
-    forward_[key.first][key.second] = placeholder.get();
-    transposed_[key.second] = placeholder.get();
+    if (us > field_last_modified_) {
+      field_last_modified_ = us;
+    }
+    if (!erased_last_modified_.empty()) {
+      erased_last_modified_.erase(key);
+    }
+    auto& map_row = forward_[key.first];
+    const auto emplaced = map_row.emplace(key.second, EntryWithLastModified<T>(object, us));
+    if (!emplaced.second) {
+      // Overwrite the entry in place, so that the pointers to it remain valid.
+      emplaced.first->second.entry = object;
+      emplaced.first->second.last_modified = us;
+    } else {
+      const EntryWithLastModified<T>* entry = &emplaced.first->second;
+      map_[key] = entry;
+      transposed_[key.second] = entry;
+    }
   }
 
   void DoEraseWithoutTouchingLastModified(const key_t& key) {
@@ -278,7 +317,10 @@ class GenericOneToMany {
   }
 
   void DoEraseWithLastModified(std::chrono::microseconds us, const key_t& key) {
-    last_modified_[key] = us;
+    if (us > field_last_modified_) {
+      field_last_modified_ = us;
+    }
+    erased_last_modified_[key] = us;
     DoEraseWithoutTouchingLastModified(key);
   }
 
@@ -286,7 +328,10 @@ class GenericOneToMany {
   elements_map_t map_;
   forward_map_t forward_;
   transposed_map_t transposed_;
-  std::unordered_map<key_t, std::chrono::microseconds, GenericHashFunction<key_t>> last_modified_;
+  // The times the keys no longer in `map_` were erased.
+  std::unordered_map<key_t, std::chrono::microseconds, GenericHashFunction<key_t>> erased_last_modified_;
+  // The latest of the times of the mutations applied, see `FieldLastModified()`.
+  std::chrono::microseconds field_last_modified_ = std::chrono::microseconds(0);
   MutationJournal& journal_;
 };
 
@@ -27,6 +27,7 @@ SOFTWARE.
 #define CURRENT_STORAGE_CONTAINER_ONE_TO_ONE_H
 
 #include "common.h"
+#include "cursor.h"
 #include "sfinae.h"
 
 #include "../base.h"
@@ -55,10 +56,12 @@ class GenericOneToOne {
   using row_t = sfinae::entry_row_t<T>;
   using col_t = sfinae::entry_col_t<T>;
   using key_t = std::pair<row_t, col_t>;
-  using elements_map_t = std::unordered_map<key_t, std::unique_ptr<T>, GenericHashFunction<key_t>>;
+  using elements_map_t = std::unordered_map<key_t, UniquePtrWithLastModified<T>, GenericHashFunction<key_t>>;
   using forward_map_t = ROW_MAP<row_t, const T*>;
   using transposed_map_t = COL_MAP<col_t, const T*>;
   using semantics_t = storage::semantics::OneToOne;
+  // The event recreating an entry, for the bulk loads, see `bulk_load.h`.
+  using update_event_t = UPDATE_EVENT;
 
   GenericOneToOne(const std::string& field_name, MutationJournal& journal)
       : field_name_(field_name), journal_(journal) {}
@@ -77,11 +80,9 @@ class GenericOneToOne {
     const auto col = sfinae::GetCol(object);
     const auto key = std::make_pair(row, col);
     const auto map_cit = map_.find(key);
-    const auto lm_cit = last_modified_.find(key);
     if (map_cit != map_.end()) {
       const T& previous_object = *(map_cit->second);
-      CURRENT_ASSERT(lm_cit != last_modified_.end());
-      const auto previous_timestamp = lm_cit->second;
+      const auto previous_timestamp = map_cit->second.get_deleter().last_modified;
       journal_.LogMutation(UPDATE_EVENT(now, object), [this, key, previous_object, previous_timestamp]() {
         DoUpdateWithLastModified(previous_timestamp, key, previous_object);
       });
@@ -94,13 +95,9 @@ class GenericOneToOne {
         const T& conflicting_object_same_row = *(cit_row->second);
         const T& conflicting_object_same_col = *(cit_col->second);
         const auto key_same_row = std::make_pair(row, sfinae::GetCol(conflicting_object_same_row));
-        const auto lm_same_row_cit = last_modified_.find(key_same_row);
-        CURRENT_ASSERT(lm_same_row_cit != last_modified_.end());
-        const auto timestamp_same_row = lm_same_row_cit->second;
+        const auto timestamp_same_row = ExistingEntryLastModified(key_same_row);
         const auto key_same_col = std::make_pair(sfinae::GetRow(conflicting_object_same_col), col);
-        const auto lm_same_col_cit = last_modified_.find(key_same_col);
-        CURRENT_ASSERT(lm_same_col_cit != last_modified_.end());
-        const auto timestamp_same_col = lm_same_col_cit->second;
+        const auto timestamp_same_col = ExistingEntryLastModified(key_same_col);
         journal_.LogMutation(DELETE_EVENT(now, conflicting_object_same_row),
                              [this, key_same_row, conflicting_object_same_row, timestamp_same_row]() {
                                DoUpdateWithLastModified(timestamp_same_row, key_same_row, conflicting_object_same_row);
@@ -117,9 +114,7 @@ class GenericOneToOne {
         const T& conflicting_object = row_occupied ? *(cit_row->second) : *(cit_col->second);
         const auto conflicting_object_key =
             std::make_pair(sfinae::GetRow(conflicting_object), sfinae::GetCol(conflicting_object));
-        const auto conflicting_object_lm_cit = last_modified_.find(conflicting_object_key);
-        CURRENT_ASSERT(conflicting_object_lm_cit != last_modified_.end());
-        const auto conflicting_object_timestamp = conflicting_object_lm_cit->second;
+        const auto conflicting_object_timestamp = ExistingEntryLastModified(conflicting_object_key);
         journal_.LogMutation(DELETE_EVENT(now, conflicting_object),
                              [this, conflicting_object_key, conflicting_object, conflicting_object_timestamp]() {
                                DoUpdateWithLastModified(
@@ -129,15 +124,14 @@ class GenericOneToOne {
         now = current::time::Now();
       }
 
-      if (lm_cit != last_modified_.end()) {
-        const auto previous_timestamp = lm_cit->second;
+      const auto erased_cit = erased_last_modified_.find(key);
+      if (erased_cit != erased_last_modified_.end()) {
+        const auto previous_timestamp = erased_cit->second;
         journal_.LogMutation(UPDATE_EVENT(now, object),
                              [this, key, previous_timestamp]() { DoEraseWithLastModified(previous_timestamp, key); });
       } else {
-        journal_.LogMutation(UPDATE_EVENT(now, object), [this, key]() {
-          last_modified_.erase(key);
-          DoEraseWithoutTouchingLastModified(key);
-        });
+        journal_.LogMutation(UPDATE_EVENT(now, object),
+                             [this, key]() { DoEraseWithoutTouchingLastModified(key); });
       }
     }
     DoUpdateWithLastModified(now, key, object);
@@ -149,9 +143,7 @@ class GenericOneToOne {
     const auto map_cit = map_.find(key);
     if (map_cit != map_.end()) {
       const T& previous_object = *(map_cit->second);
-      const auto lm_cit = last_modified_.find(key);
-      CURRENT_ASSERT(lm_cit != last_modified_.end());
-      const auto previous_timestamp = lm_cit->second;
+      const auto previous_timestamp = map_cit->second.get_deleter().last_modified;
       journal_.LogMutation(DELETE_EVENT(now, previous_object), [this, key, previous_object, previous_timestamp]() {
         DoUpdateWithLastModified(previous_timestamp, key, previous_object);
       });
@@ -166,9 +158,7 @@ class GenericOneToOne {
     if (forward_cit != forward_.end()) {
       const T& previous_object = *(forward_cit->second);
       const auto key = std::make_pair(row, sfinae::GetCol(previous_object));
-      const auto lm_cit = last_modified_.find(key);
-      CURRENT_ASSERT(lm_cit != last_modified_.end());
-      const auto previous_timestamp = lm_cit->second;
+      const auto previous_timestamp = ExistingEntryLastModified(key);
       journal_.LogMutation(DELETE_EVENT(now, previous_object), [this, key, previous_object, previous_timestamp]() {
         DoUpdateWithLastModified(previous_timestamp, key, previous_object);
       });
@@ -182,9 +172,7 @@ class GenericOneToOne {
     if (transposed_cit != transposed_.end()) {
       const T& previous_object = *(transposed_cit->second);
       const auto key = std::make_pair(sfinae::GetRow(previous_object), col);
-      const auto lm_cit = last_modified_.find(key);
-      CURRENT_ASSERT(lm_cit != last_modified_.end());
-      const auto previous_timestamp = lm_cit->second;
+      const auto previous_timestamp = ExistingEntryLastModified(key);
       journal_.LogMutation(DELETE_EVENT(now, previous_object), [this, key, previous_object, previous_timestamp]() {
         DoUpdateWithLastModified(previous_timestamp, key, previous_object);
       });
@@ -221,9 +209,13 @@ class GenericOneToOne {
   }
 
   ImmutableOptional<std::chrono::microseconds> LastModified(const key_t& key) const {
-    const auto cit = last_modified_.find(key);
-    if (cit != last_modified_.end()) {
-      return cit->second;
+    const auto cit = map_.find(key);
+    if (cit != map_.end()) {
+      return cit->second.get_deleter().last_modified;
+    }
+    const auto erased_cit = erased_last_modified_.find(key);
+    if (erased_cit != erased_last_modified_.end()) {
+      return erased_cit->second;
     } else {
       return nullptr;
     }
@@ -232,6 +224,10 @@ class GenericOneToOne {
     return LastModified(std::make_pair(row, col));
   }
 
+  // The time any entry of this field was last added, updated, or erased at, zero if it never was. It does not move
+  // back as the transactions are rolled back, so that it changes whenever the contents of the field may have.
+  std::chrono::microseconds FieldLastModified() const { return field_last_modified_; }
+
   bool DoesNotConflict(const key_t& key) const {
     return forward_.find(key.first) == forward_.end() && transposed_.find(key.second) == transposed_.end();
   }
@@ -246,6 +242,21 @@ class GenericOneToOne {
   }
   void operator()(const DELETE_EVENT& e) { DoEraseWithLastModified(e.us, std::make_pair(e.key.first, e.key.second)); }
 
+  // Calls `f` with the events which, replayed into an empty container, recreate this one, for the snapshots.
+  // The deletions of the keys no longer present go first, so that they can not affect the entries added after them.
+  template <typename F>
+  void ForEachSnapshotEvent(F&& f) const {
+    for (const auto& erased : erased_last_modified_) {
+      DELETE_EVENT e;
+      e.us = erased.second;
+      e.key = erased.first;
+      f(std::move(e));
+    }
+    for (const auto& element : map_) {
+      f(UPDATE_EVENT(element.second.get_deleter().last_modified, *element.second));
+    }
+  }
+
   using rows_outer_accessor_t = GenericMapAccessor<forward_map_t>;
   rows_outer_accessor_t Rows() const { return GenericMapAccessor<forward_map_t>(forward_); }
 
@@ -258,11 +269,30 @@ class GenericOneToOne {
   iterator_t begin() const { return iterator_t(map_.begin()); }
   iterator_t end() const { return iterator_t(map_.end()); }
 
+  // For the paginated exports via REST, see `cursor.h`.
+  template <typename F>
+  std::string ForEachEntryFromCursor(const std::string& cursor, size_t limit, F&& f) const {
+    return container::ForEachEntryFromCursor(map_, cursor, limit, std::forward<F>(f));
+  }
+
  private:
+  // The time the entry, which must exist, was last modified.
+  std::chrono::microseconds ExistingEntryLastModified(const key_t& key) const {
+    const auto cit = map_.find(key);
+    CURRENT_ASSERT(cit != map_.end());
+    return cit->second.get_deleter().last_modified;
+  }
+
+  // Each key is either in `map_`, or in `erased_last_modified_`, or in neither if it was never modified.
   void DoUpdateWithLastModified(std::chrono::microseconds us, const key_t& key, const T& object) {
-    last_modified_[key] = us;
+    if (us > field_last_modified_) {
+      field_last_modified_ = us;
+    }
+    if (!erased_last_modified_.empty()) {
+      erased_last_modified_.erase(key);
+    }
     auto& placeholder = map_[key];
-    placeholder = std::make_unique<T>(object);
+    placeholder = MakeUniqueWithLastModified(object, us);
     forward_[key.first] = placeholder.get();
     transposed_[key.second] = placeholder.get();
   }
@@ -274,7 +304,10 @@ class GenericOneToOne {
   }
 
   void DoEraseWithLastModified(std::chrono::microseconds us, const key_t& key) {
-    last_modified_[key] = us;
+    if (us > field_last_modified_) {
+      field_last_modified_ = us;
+    }
+    erased_last_modified_[key] = us;
     DoEraseWithoutTouchingLastModified(key);
   }
 
@@ -282,7 +315,10 @@ class GenericOneToOne {
   elements_map_t map_;
   forward_map_t forward_;
   transposed_map_t transposed_;
-  std::unordered_map<key_t, std::chrono::microseconds, GenericHashFunction<key_t>> last_modified_;
+  // The times the keys no longer in `map_` were erased.
+  std::unordered_map<key_t, std::chrono::microseconds, GenericHashFunction<key_t>> erased_last_modified_;
+  // The latest of the times of the mutations applied, see `FieldLastModified()`.
+  std::chrono::microseconds field_last_modified_ = std::chrono::microseconds(0);
   MutationJournal& journal_;
 };
 
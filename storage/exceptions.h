@@ -72,6 +72,25 @@ struct ReadWriteTransactionInFollowerStorageException : StorageException {
   using StorageException::StorageException;
 };
 
+struct StorageUniqueIndexViolationException : StorageException {
+  using StorageException::StorageException;
+};
+
+struct StorageSnapshotsNotEnabledException : StorageException {
+  using StorageException::StorageException;
+};
+
+// LCOV_EXCL_START
+struct StorageBackgroundSnapshotException : StorageException {
+  using StorageException::StorageException;
+};
+// LCOV_EXCL_STOP
+
+// Thrown when a cursor to resume iterating over a container from, see `container/cursor.h`, is malformed.
+struct StorageInvalidCursorException : StorageException {
+  using StorageException::StorageException;
+};
+
 struct StorageInGracefulShutdownException : InGracefulShutdownException {
   using InGracefulShutdownException::InGracefulShutdownException;
 };
@@ -29,13 +29,38 @@ SOFTWARE.
 #include "common.h"
 #include "../base.h"
 #include "../exceptions.h"
+#include "../replay.h"
+#include "../snapshot.h"
 #include "../transaction.h"
 #include "../../stream/stream.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+
+#ifndef CURRENT_WINDOWS
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif  // CURRENT_WINDOWS
+
+#include "../../bricks/file/file.h"
 #include "../../bricks/sync/locks.h"
+#include "../../typesystem/serialization/binary.h"
 
 namespace current {
 namespace storage {
+
+// How far behind its stream the storage is. Always zero for the master storage, which publishes into the stream.
+struct StorageReplicationLag final {
+  // The entries in the stream not yet applied to the storage.
+  uint64_t entries = 0u;
+  // The timestamp of the last entry of the stream minus that of the last entry applied to the storage.
+  std::chrono::microseconds us = std::chrono::microseconds(0);
+};
+
 namespace persister {
 
 template <typename MUTATIONS_VARIANT, template <typename> class UNDERLYING_PERSISTER, typename STREAM_RECORD_TYPE>
@@ -46,23 +71,67 @@ class StreamStreamPersisterImpl final {
   using stream_entry_t =
       std::conditional_t<std::is_same_v<STREAM_RECORD_TYPE, NoCustomPersisterParam>, transaction_t, STREAM_RECORD_TYPE>;
   using stream_t = stream::Stream<stream_entry_t, UNDERLYING_PERSISTER>;
-  using fields_update_function_t = std::function<void(const variant_t&)>;
+  // Applies all the mutations of one transaction to the fields.
+  using fields_update_function_t = std::function<void(const transaction_t&)>;
+  // Returns the events which recreate the fields as they are, see `snapshot.h`.
+  using fields_snapshot_function_t = std::function<std::vector<variant_t>()>;
+  using snapshot_t = StorageSnapshot<variant_t>;
+  // For the parallel replay, see `replay.h`: the index of the field the mutation is of, and how to apply it alone.
+  using mutation_field_index_function_t = std::function<size_t(const variant_t&)>;
+  using mutation_apply_function_t = std::function<void(const variant_t&)>;
 
   struct StreamSubscriberImpl {
     using EntryResponse = current::ss::EntryResponse;
     using TerminationResponse = current::ss::TerminationResponse;
-    using replay_function_t = std::function<void(const transaction_t&, std::chrono::microseconds)>;
+    using replay_function_t = std::function<void(const transaction_t&, idxts_t)>;
+    // The bounds on how long a batch of replayed transactions keeps the publishing mutex locked, so that the
+    // read-only transactions of the following storage are not starved while it is catching up with the master.
+    constexpr static size_t kMaxEntriesPerLock = 250u;
+    constexpr static std::chrono::microseconds kMaxLockHold = std::chrono::milliseconds(2);
+    // The publishing mutex of the stream, locked once per entry, or once per up to `kMaxEntriesPerLock` entries.
+    std::mutex& mutex_ref_;
     replay_function_t replay_f_;
-    uint64_t next_replay_index_ = 0u;
+    // Atomic, as the replication lag is read from the outside of the subscriber thread.
+    std::atomic<uint64_t> next_replay_index_{0u};
+    std::atomic<int64_t> last_replayed_us_{0};
 
-    StreamSubscriberImpl(replay_function_t f) : replay_f_(f) {}
+    StreamSubscriberImpl(std::mutex& mutex, replay_function_t f) : mutex_ref_(mutex), replay_f_(f) {}
 
     EntryResponse operator()(const transaction_t& transaction, idxts_t current, idxts_t) {
-      replay_f_(transaction, current.us);
-      next_replay_index_ = current.index + 1u;
+      {
+        std::lock_guard<std::mutex> lock(mutex_ref_);
+        replay_f_(transaction, current);
+      }
+      MarkReplayed(current);
+      return EntryResponse::More;
+    }
+
+    EntryResponse operator()(const current::ss::EntriesBatch<transaction_t>& batch, idxts_t) {
+      size_t i = 0u;
+      while (i < batch.Size()) {
+        {
+          std::lock_guard<std::mutex> lock(mutex_ref_);
+          const auto deadline = std::chrono::steady_clock::now() + kMaxLockHold;
+          const size_t end = std::min(batch.Size(), i + kMaxEntriesPerLock);
+          do {
+            replay_f_(batch.Entry(i), batch.IdxTs(i));
+            ++i;
+          } while (i < end && std::chrono::steady_clock::now() < deadline);
+        }
+        MarkReplayed(batch.IdxTs(i - 1u));
+        if (i < batch.Size()) {
+          // Let the readers waiting on the mutex in before the rest of the batch is applied.
+          std::this_thread::yield();
+        }
+      }
       return EntryResponse::More;
     }
 
+    void MarkReplayed(idxts_t idx_ts) {
+      last_replayed_us_ = idx_ts.us.count();
+      next_replay_index_ = idx_ts.index + 1u;
+    }
+
     EntryResponse operator()(std::chrono::microseconds) const { return EntryResponse::More; }
 
     EntryResponse EntryResponseIfNoMorePassTypeFilter() const { return EntryResponse::More; }
@@ -73,36 +142,76 @@ class StreamStreamPersisterImpl final {
   struct Master {};
   struct Following {};
 
-  StreamStreamPersisterImpl(Master, fields_update_function_t f, Borrowed<stream_t> stream)
+  StreamStreamPersisterImpl(Master,
+                            fields_update_function_t f,
+                            Borrowed<stream_t> stream,
+                            StorageSnapshots snapshots = StorageSnapshots(),
+                            fields_snapshot_function_t snapshot_f = nullptr,
+                            StorageReplayParallelism replay_parallelism = StorageReplayParallelism(),
+                            mutation_field_index_function_t mutation_field_index_f = nullptr,
+                            mutation_apply_function_t mutation_apply_f = nullptr)
       : fields_update_f_(f),
+        snapshots_(std::move(snapshots)),
+        fields_snapshot_f_(std::move(snapshot_f)),
+        replay_parallelism_(std::move(replay_parallelism)),
+        mutation_field_index_f_(std::move(mutation_field_index_f)),
+        mutation_apply_f_(std::move(mutation_apply_f)),
         stream_publishing_mutex_ref_(stream->Impl()->publishing_mutex),
         stream_(std::move(stream)),
         publisher_used_(stream_->BecomeFollowingStream()) {
     subscriber_instance_ = std::make_unique<StreamSubscriber>(
-        [this](const transaction_t& transaction, std::chrono::microseconds timestamp) {
-          std::lock_guard<std::mutex> lock(stream_publishing_mutex_ref_);
-          ApplyMutationsFromLockedSectionOrConstructor(transaction, timestamp);
+        stream_publishing_mutex_ref_, [this](const transaction_t& transaction, idxts_t idx_ts) {
+          ApplyMutationsFromLockedSectionOrConstructor(transaction, idx_ts);
         });
     std::lock_guard<std::mutex> lock(stream_publishing_mutex_ref_);
-    SyncReplayStreamFromLockedSectionOrConstructor(0u);
+    const uint64_t from_idx = LoadSnapshotFromLockedSectionOrConstructor();
+    if (ReplayInParallel()) {
+      ParallelReplayStreamFromConstructor(from_idx);
+    } else {
+      SyncReplayStreamFromLockedSectionOrConstructor(from_idx);
+    }
   }
 
-  StreamStreamPersisterImpl(Following, fields_update_function_t f, Borrowed<stream_t> stream)
+  StreamStreamPersisterImpl(Following,
+                            fields_update_function_t f,
+                            Borrowed<stream_t> stream,
+                            StorageSnapshots snapshots = StorageSnapshots(),
+                            fields_snapshot_function_t snapshot_f = nullptr,
+                            StorageReplayParallelism replay_parallelism = StorageReplayParallelism(),
+                            mutation_field_index_function_t mutation_field_index_f = nullptr,
+                            mutation_apply_function_t mutation_apply_f = nullptr)
       : fields_update_f_(f),
+        snapshots_(std::move(snapshots)),
+        fields_snapshot_f_(std::move(snapshot_f)),
+        replay_parallelism_(std::move(replay_parallelism)),
+        mutation_field_index_f_(std::move(mutation_field_index_f)),
+        mutation_apply_f_(std::move(mutation_apply_f)),
         stream_publishing_mutex_ref_(stream->Impl()->publishing_mutex),
         stream_(std::move(stream)) {
     subscriber_instance_ = std::make_unique<StreamSubscriber>(
-        [this](const transaction_t& transaction, std::chrono::microseconds timestamp) {
-          std::lock_guard<std::mutex> lock(stream_publishing_mutex_ref_);
-          ApplyMutationsFromLockedSectionOrConstructor(transaction, timestamp);
+        stream_publishing_mutex_ref_, [this](const transaction_t& transaction, idxts_t idx_ts) {
+          ApplyMutationsFromLockedSectionOrConstructor(transaction, idx_ts);
         });
     std::lock_guard<std::mutex> lock(stream_publishing_mutex_ref_);
+    subscriber_instance_->next_replay_index_ = LoadSnapshotFromLockedSectionOrConstructor();
+    if (ReplayInParallel()) {
+      // What is in the stream already is replayed right away, and the subscriber only follows what comes after it.
+      subscriber_instance_->next_replay_index_ =
+          ParallelReplayStreamFromConstructor(subscriber_instance_->next_replay_index_);
+    }
+    subscriber_instance_->last_replayed_us_ = last_entry_timestamp_.count();
     SubscribeToStreamFromLockedSection();
   }
 
   ~StreamStreamPersisterImpl() {
-    std::lock_guard<std::mutex> master_follower_change_lock(master_follower_change_mutex_);
-    TerminateStreamSubscriptionFromLockedSection();
+    {
+      std::lock_guard<std::mutex> master_follower_change_lock(master_follower_change_mutex_);
+      TerminateStreamSubscriptionFromLockedSection();
+    }
+    WaitForBackgroundSnapshot();
+    if (background_snapshot_thread_.joinable()) {
+      background_snapshot_thread_.join();
+    }
   }
 
   template <current::locks::MutexLockStatus MLS>
@@ -117,6 +226,23 @@ class StreamStreamPersisterImpl final {
     return last_applied_timestamp_;
   }
 
+  uint64_t NextStreamIndexFromLockedSection() const { return next_stream_index_; }
+
+  StorageReplicationLag ReplicationLagPersister() const {
+    std::lock_guard<std::mutex> master_follower_change_lock(master_follower_change_mutex_);
+    StorageReplicationLag lag;
+    if (!Exists(publisher_used_) && subscriber_instance_) {
+      const uint64_t next_replay_index = subscriber_instance_->next_replay_index_;
+      const std::chrono::microseconds last_replayed_us(subscriber_instance_->last_replayed_us_);
+      const auto head_idxts = stream_->Data()->HeadAndLastPublishedIndexAndTimestamp();
+      if (Exists(head_idxts.idxts) && Value(head_idxts.idxts).index >= next_replay_index) {
+        lag.entries = Value(head_idxts.idxts).index + 1u - next_replay_index;
+        lag.us = Value(head_idxts.idxts).us - last_replayed_us;
+      }
+    }
+    return lag;
+  }
+
   void PersistJournalFromLockedSection(MutationJournal& journal) {
     const std::chrono::microseconds timestamp = current::time::Now();
     CURRENT_ASSERT(Exists(publisher_used_));
@@ -127,17 +253,90 @@ class StreamStreamPersisterImpl final {
       CURRENT_ASSERT(journal.transaction_meta.begin_us <= journal.transaction_meta.end_us);
 #endif
       transaction_t transaction;
+      transaction.mutations.reserve(journal.commit_log.size());
       for (auto&& entry : journal.commit_log) {
         transaction.mutations.emplace_back(BypassVariantTypeCheck(), std::move(entry));
       }
       std::swap(transaction.meta, journal.transaction_meta);
-      Value(publisher_used_)
-          ->template Publish<current::locks::MutexLockStatus::AlreadyLocked>(std::move(transaction), timestamp);
-      SetLastAppliedTimestampFromLockedSection(timestamp);
+      PublishTransactionFromLockedSection(std::move(transaction), timestamp);
     }
     journal.Clear();
   }
 
+  // Persists the transaction already applied to the fields, i.e. the one of a bulk load, see `bulk_load.h`.
+  void PersistTransactionFromLockedSection(transaction_t&& transaction) {
+    const std::chrono::microseconds timestamp = current::time::Now();
+    CURRENT_ASSERT(Exists(publisher_used_));
+    PublishTransactionFromLockedSection(std::move(transaction), timestamp);
+  }
+
+  // Saves the snapshot of the fields into `StorageSnapshots::file_name`, replacing the previous one.
+  // Returns the number of stream entries the snapshot reflects.
+  uint64_t SaveSnapshotFromLockedSection() {
+    AssertSnapshotsEnabled();
+    const uint64_t index = WriteSnapshot(".tmp");
+    transactions_since_snapshot_ = 0u;
+    return index;
+  }
+
+  // Saves the snapshot from a forked child process. The child has a copy-on-write copy of the fields as they are
+  // now, and this process returns to the transactions right away, without waiting for the snapshot to be saved.
+  // Returns `false` without doing anything if the previous snapshot saved in the background is not saved yet.
+  // On Windows, saves the snapshot in the foreground.
+  bool SaveSnapshotInBackgroundFromLockedSection() {
+    AssertSnapshotsEnabled();
+#ifndef CURRENT_WINDOWS
+    std::lock_guard<std::mutex> lock(background_snapshot_mutex_);
+    if (background_snapshot_in_progress_) {
+      return false;
+    }
+    if (background_snapshot_thread_.joinable()) {
+      background_snapshot_thread_.join();
+    }
+    // The child process only has this thread, so whatever it needs initializing lazily is initialized before forking.
+    current::serialization::binary::BinarySchemaTypeID<snapshot_t>();
+    const pid_t pid = ::fork();
+    if (!pid) {
+      int exit_code = 1;
+      try {
+        WriteSnapshot(".background.tmp");
+        exit_code = 0;
+      } catch (...) {
+      }
+      // Skip the destructors and the `atexit()` handlers, which belong to the parent process.
+      ::_exit(exit_code);
+    }
+    if (pid < 0) {
+      CURRENT_THROW(StorageBackgroundSnapshotException("Cannot fork to save the snapshot in the background."));
+    }
+    background_snapshot_in_progress_ = true;
+    background_snapshot_thread_ = std::thread([this, pid]() {
+      int status = 0;
+      while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+      }
+      {
+        std::lock_guard<std::mutex> lock(background_snapshot_mutex_);
+        background_snapshot_in_progress_ = false;
+        background_snapshot_succeeded_ = WIFEXITED(status) && !WEXITSTATUS(status);
+      }
+      background_snapshot_condition_variable_.notify_all();
+    });
+#else
+    WriteSnapshot(".tmp");
+    background_snapshot_succeeded_ = true;
+#endif  // CURRENT_WINDOWS
+    transactions_since_snapshot_ = 0u;
+    return true;
+  }
+
+  // Waits until the snapshot being saved in the background, if any, is saved. Returns whether the last snapshot
+  // saved in the background was saved successfully. Must not be called from a locked section.
+  bool WaitForBackgroundSnapshot() {
+    std::unique_lock<std::mutex> lock(background_snapshot_mutex_);
+    background_snapshot_condition_variable_.wait(lock, [this]() { return !background_snapshot_in_progress_; });
+    return background_snapshot_succeeded_;
+  }
+
   void ExposeRawLogViaHTTP(uint16_t port, const std::string& route) {
     handlers_scope_ += HTTP(current::net::BarePort(port))
                            .Register(route,
@@ -176,6 +375,15 @@ class StreamStreamPersisterImpl final {
   // TODO(dkorolev): `BecomeFollowingStorage` maybe?
 
  private:
+  void PublishTransactionFromLockedSection(transaction_t&& transaction, std::chrono::microseconds timestamp) {
+    const idxts_t idx_ts =
+        Value(publisher_used_)
+            ->template Publish<current::locks::MutexLockStatus::AlreadyLocked>(std::move(transaction), timestamp);
+    SetLastAppliedTimestampFromLockedSection(timestamp);
+    SetNextStreamIndexFromLockedSection(idx_ts);
+    MaybeSaveSnapshotFromLockedSection();
+  }
+
   // Invariant: both `subscriber_creator_destructor_mutex_` and `stream_publishing_mutex_ref_` are locked,
   // or the call is taking place from the constructor.
   void SyncReplayStreamFromLockedSectionOrConstructor(uint64_t from_idx) {
@@ -183,17 +391,117 @@ class StreamStreamPersisterImpl final {
          stream_->Data()->template Iterate<current::locks::MutexLockStatus::AlreadyLocked>(from_idx)) {
       if (Exists<transaction_t>(stream_record.entry)) {
         const transaction_t& transaction = Value<transaction_t>(stream_record.entry);
-        ApplyMutationsFromLockedSectionOrConstructor(transaction, stream_record.idx_ts.us);
+        ApplyMutationsFromLockedSectionOrConstructor(transaction, stream_record.idx_ts);
+      } else {
+        SetNextStreamIndexFromLockedSection(stream_record.idx_ts);
       }
     }
   }
 
-  void ApplyMutationsFromLockedSectionOrConstructor(const transaction_t& transaction,
-                                                    std::chrono::microseconds timestamp) {
-    for (const auto& mutation : transaction.mutations) {
-      fields_update_f_(mutation);
+  bool ReplayInParallel() const {
+    return replay_parallelism_.threads && mutation_field_index_f_ && mutation_apply_f_;
+  }
+
+  // Replays the stream on the threads of `replay_parallelism_`, see `replay.h`, while the stream is locked.
+  // Returns the index of the first stream entry not replayed. The mutations are applied to the fields directly, not
+  // through the transaction policy, so only the constructor, before anything else can access the fields, does this.
+  uint64_t ParallelReplayStreamFromConstructor(uint64_t from_idx) {
+    impl::ParallelReplayer<transaction_t> replayer(
+        replay_parallelism_.threads, replay_parallelism_.batch_size, mutation_field_index_f_, mutation_apply_f_);
+    for (auto&& stream_record :
+         stream_->Data()->template Iterate<current::locks::MutexLockStatus::AlreadyLocked>(from_idx)) {
+      if (Exists<transaction_t>(stream_record.entry)) {
+        // Moves the transaction if the persister has just parsed it, and copies it if the persister keeps it.
+        replayer.Add(std::move(Value<transaction_t>(stream_record.entry)));
+        SetLastAppliedTimestampFromLockedSection(stream_record.idx_ts.us);
+        ++transactions_since_snapshot_;
+      }
+      SetNextStreamIndexFromLockedSection(stream_record.idx_ts);
     }
-    SetLastAppliedTimestampFromLockedSection(timestamp);
+    replayer.Flush();
+    // The snapshots are not saved mid-replay, when the fields are not consistent with any one entry of the stream.
+    SaveSnapshotIfDueFromLockedSection();
+    return next_stream_index_;
+  }
+
+  void ApplyMutationsFromLockedSectionOrConstructor(const transaction_t& transaction, idxts_t idx_ts) {
+    fields_update_f_(transaction);
+    SetLastAppliedTimestampFromLockedSection(idx_ts.us);
+    SetNextStreamIndexFromLockedSection(idx_ts);
+    MaybeSaveSnapshotFromLockedSection();
+  }
+
+  // Applies the snapshot, if there is a valid one, and returns the index of the first stream entry to replay atop it.
+  uint64_t LoadSnapshotFromLockedSectionOrConstructor() {
+    if (snapshots_.file_name.empty()) {
+      return 0u;
+    }
+    snapshot_t snapshot;
+    try {
+      LoadFromBinary(current::FileSystem::ReadFileAsString(snapshots_.file_name), snapshot);
+    } catch (const current::Exception&) {
+      // No snapshot, or a corrupted one, or one of another schema.
+      return 0u;
+    }
+    if (snapshot.index) {
+      constexpr static auto kAlreadyLocked = current::locks::MutexLockStatus::AlreadyLocked;
+      if (snapshot.index > stream_->Data()->template Size<kAlreadyLocked>()) {
+        return 0u;
+      }
+      for (const auto& stream_record :
+           stream_->Data()->template Iterate<kAlreadyLocked>(snapshot.index - 1u, snapshot.index)) {
+        if (stream_record.idx_ts.us != snapshot.last_entry_us) {
+          return 0u;
+        }
+      }
+    }
+    transaction_t transaction;
+    transaction.mutations = std::move(snapshot.mutations);
+    fields_update_f_(transaction);
+    last_applied_timestamp_ = snapshot.last_applied_us;
+    next_stream_index_ = snapshot.index;
+    last_entry_timestamp_ = snapshot.last_entry_us;
+    return snapshot.index;
+  }
+
+  void MaybeSaveSnapshotFromLockedSection() {
+    ++transactions_since_snapshot_;
+    SaveSnapshotIfDueFromLockedSection();
+  }
+
+  void SaveSnapshotIfDueFromLockedSection() {
+    if (snapshots_.every_n_transactions && transactions_since_snapshot_ >= snapshots_.every_n_transactions) {
+      try {
+        if (snapshots_.in_background) {
+          // If the previous snapshot is still being saved, this is attempted again after the next transaction.
+          SaveSnapshotInBackgroundFromLockedSection();
+        } else {
+          SaveSnapshotFromLockedSection();
+        }
+      } catch (const current::Exception&) {
+        // The transaction is committed regardless, and the next attempt is made after as many transactions.
+        transactions_since_snapshot_ = 0u;
+      }
+    }
+  }
+
+  void AssertSnapshotsEnabled() const {
+    if (snapshots_.file_name.empty() || !fields_snapshot_f_) {
+      CURRENT_THROW(StorageSnapshotsNotEnabledException());
+    }
+  }
+
+  uint64_t WriteSnapshot(const std::string& temporary_file_name_suffix) const {
+    snapshot_t snapshot;
+    snapshot.index = next_stream_index_;
+    snapshot.last_entry_us = last_entry_timestamp_;
+    snapshot.last_applied_us = last_applied_timestamp_;
+    snapshot.mutations = fields_snapshot_f_();
+    // Renaming the complete file over the previous one never leaves a partially written snapshot in its place.
+    const std::string temporary_file_name = snapshots_.file_name + temporary_file_name_suffix;
+    current::FileSystem::WriteStringToFile(SaveIntoBinary(snapshot), temporary_file_name.c_str());
+    current::FileSystem::RenameFile(temporary_file_name, snapshots_.file_name);
+    return snapshot.index;
   }
 
  private:
@@ -201,7 +509,8 @@ class StreamStreamPersisterImpl final {
   void SubscribeToStreamFromLockedSection() {
     CURRENT_ASSERT(!subscriber_scope_);
     CURRENT_ASSERT(subscriber_instance_);
-    subscriber_scope_ = std::move(stream_->template Subscribe<transaction_t>(*subscriber_instance_));
+    subscriber_scope_ = std::move(
+        stream_->template Subscribe<transaction_t>(*subscriber_instance_, subscriber_instance_->next_replay_index_));
   }
 
   // Invariant: `master_follower_change_mutex_` is locked.
@@ -213,8 +522,25 @@ class StreamStreamPersisterImpl final {
     last_applied_timestamp_ = timestamp;
   }
 
+  void SetNextStreamIndexFromLockedSection(idxts_t idx_ts) {
+    next_stream_index_ = idx_ts.index + 1u;
+    last_entry_timestamp_ = idx_ts.us;
+  }
+
  private:
   fields_update_function_t fields_update_f_;
+  const StorageSnapshots snapshots_;
+  fields_snapshot_function_t fields_snapshot_f_;
+  const StorageReplayParallelism replay_parallelism_;
+  mutation_field_index_function_t mutation_field_index_f_;
+  mutation_apply_function_t mutation_apply_f_;
+  uint64_t transactions_since_snapshot_ = 0u;
+  // The process saving the snapshot in the background is waited for by `background_snapshot_thread_`.
+  std::mutex background_snapshot_mutex_;
+  std::condition_variable background_snapshot_condition_variable_;
+  bool background_snapshot_in_progress_ = false;
+  bool background_snapshot_succeeded_ = false;
+  std::thread background_snapshot_thread_;
 
   std::mutex& stream_publishing_mutex_ref_;  // == `stream_->Impl()->publishing_mutex`.
   Borrowed<stream_t> stream_;
@@ -225,6 +551,9 @@ class StreamStreamPersisterImpl final {
   current::stream::SubscriberScope subscriber_scope_;
 
   std::chrono::microseconds last_applied_timestamp_ = std::chrono::microseconds(-1);  // Replayed or from the master.
+  // The number of stream entries applied to the fields, and the timestamp of the last one, to tag the snapshots with.
+  uint64_t next_stream_index_ = 0u;
+  std::chrono::microseconds last_entry_timestamp_ = std::chrono::microseconds(0);
 
   HTTPRoutesScope handlers_scope_;
 };
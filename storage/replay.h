@@ -0,0 +1,226 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// The parallel replay applies the transactions replayed from the stream on several threads, one field per thread.
+// The mutations of different fields are independent, and those of each field are applied in the order of the stream,
+// so the fields end up exactly as if the transactions were applied one by one.
+//
+// The transactions are decoded on the thread replaying the stream, and handed over to the threads in batches, which
+// the threads apply while the next batch is being decoded. The barrier is at the end of the replay: the storage is
+// only accessed once all the threads are done.
+
+#ifndef CURRENT_STORAGE_REPLAY_H
+#define CURRENT_STORAGE_REPLAY_H
+
+#include "../port.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace current {
+namespace storage {
+
+// How many threads should the storage apply the transactions replayed on startup on.
+struct StorageReplayParallelism final {
+  // Zero is the default, to apply the transactions on the thread replaying the stream. At most one thread per field.
+  size_t threads = 0u;
+  // The number of transactions handed over to the threads at once.
+  size_t batch_size = 1000u;
+
+  StorageReplayParallelism() = default;
+  explicit StorageReplayParallelism(size_t threads, size_t batch_size = 1000u)
+      : threads(threads), batch_size(batch_size) {}
+};
+
+namespace impl {
+
+template <typename TRANSACTION>
+class ParallelReplayer final {
+ public:
+  using mutation_t = typename decltype(std::declval<TRANSACTION>().mutations)::value_type;
+  // The index of the field the mutation is of. The mutations of the same field are applied on the same thread.
+  using field_index_function_t = std::function<size_t(const mutation_t&)>;
+  // Applies one mutation, called concurrently for the mutations of different fields.
+  using apply_function_t = std::function<void(const mutation_t&)>;
+
+  ParallelReplayer(size_t threads, size_t batch_size, field_index_function_t field_index_f, apply_function_t apply_f)
+      : field_index_f_(std::move(field_index_f)),
+        apply_f_(std::move(apply_f)),
+        batch_size_(batch_size ? batch_size : 1u),
+        next_batch_(threads ? threads : 1u, 0u) {
+    threads_.reserve(next_batch_.size());
+    for (size_t i = 0; i < next_batch_.size(); ++i) {
+      threads_.emplace_back(&ParallelReplayer::Thread, this, i);
+    }
+  }
+
+  ~ParallelReplayer() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      terminating_ = true;
+    }
+    batch_added_condition_variable_.notify_all();
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  // Schedules the mutations of the transaction to be applied. Rethrows what applying the previous ones has thrown.
+  void Add(TRANSACTION transaction) {
+    if (!pending_) {
+      pending_ = std::make_unique<Batch>();
+      pending_->transactions.reserve(batch_size_);
+      pending_->mutations.resize(threads_.size());
+    }
+    pending_->transactions.push_back(std::move(transaction));
+    // Moving the transactions as the vector grows keeps their mutations where they are.
+    for (const mutation_t& mutation : pending_->transactions.back().mutations) {
+      pending_->mutations[field_index_f_(mutation) % threads_.size()].push_back(&mutation);
+    }
+    if (pending_->transactions.size() >= batch_size_) {
+      Dispatch();
+    }
+  }
+
+  // Waits until all the mutations scheduled are applied. Rethrows what applying them has thrown, if anything.
+  void Flush() {
+    if (pending_) {
+      Dispatch();
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    batch_applied_condition_variable_.wait(lock, [this]() { return batches_.empty(); });
+    RethrowFromLockedSection();
+  }
+
+ private:
+  ParallelReplayer(const ParallelReplayer&) = delete;
+  ParallelReplayer& operator=(const ParallelReplayer&) = delete;
+
+  // The decoding of the next batch overlaps with applying the previous one, and no more batches are kept in memory.
+  constexpr static size_t kMaxBatchesInFlight = 2u;
+
+  struct Batch final {
+    std::vector<TRANSACTION> transactions;
+    // Per thread, the mutations of the fields it is applying, in the order of the stream.
+    std::vector<std::vector<const mutation_t*>> mutations;
+  };
+
+  void Dispatch() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      batch_applied_condition_variable_.wait(lock,
+                                             [this]() { return batches_.size() < kMaxBatchesInFlight || exception_; });
+      RethrowFromLockedSection();
+      batches_.push_back(std::move(pending_));
+    }
+    batch_added_condition_variable_.notify_all();
+  }
+
+  void RethrowFromLockedSection() {
+    if (exception_) {
+      std::rethrow_exception(std::exchange(exception_, nullptr));
+    }
+  }
+
+  void Thread(size_t thread_index) {
+    while (true) {
+      const std::vector<const mutation_t*>* mutations;
+      bool failed;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        batch_added_condition_variable_.wait(lock, [this, thread_index]() {
+          return terminating_ || next_batch_[thread_index] < first_batch_ + batches_.size();
+        });
+        if (terminating_) {
+          return;
+        }
+        // `std::deque` keeps its elements in place as more are added, and this one stays until this thread is done.
+        mutations = &batches_[next_batch_[thread_index] - first_batch_]->mutations[thread_index];
+        failed = static_cast<bool>(exception_);
+      }
+      std::exception_ptr exception;
+      if (!failed) {
+        try {
+          for (const mutation_t* mutation : *mutations) {
+            apply_f_(*mutation);
+          }
+        } catch (...) {
+          exception = std::current_exception();
+        }
+      }
+      std::vector<std::unique_ptr<Batch>> applied;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (exception && !exception_) {
+          exception_ = exception;
+        }
+        ++next_batch_[thread_index];
+        while (!batches_.empty() && *std::min_element(next_batch_.begin(), next_batch_.end()) > first_batch_) {
+          applied.push_back(std::move(batches_.front()));
+          batches_.pop_front();
+          ++first_batch_;
+        }
+      }
+      if (!applied.empty()) {
+        batch_applied_condition_variable_.notify_all();
+      }
+      // The transactions of the batches applied by all the threads are freed outside the locked section.
+    }
+  }
+
+  const field_index_function_t field_index_f_;
+  const apply_function_t apply_f_;
+  const size_t batch_size_;
+  // Being filled by `Add()`, not yet handed over to the threads.
+  std::unique_ptr<Batch> pending_;
+  std::mutex mutex_;
+  std::condition_variable batch_added_condition_variable_;
+  std::condition_variable batch_applied_condition_variable_;
+  // The batches handed over to the threads, and not yet applied by all of them. The front one is `first_batch_`.
+  std::deque<std::unique_ptr<Batch>> batches_;
+  uint64_t first_batch_ = 0u;
+  // Per thread, the sequence number of the batch it is to apply next.
+  std::vector<uint64_t> next_batch_;
+  std::exception_ptr exception_;
+  bool terminating_ = false;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace impl
+
+}  // namespace storage
+}  // namespace current
+
+using current::storage::StorageReplayParallelism;
+
+#endif  // CURRENT_STORAGE_REPLAY_H
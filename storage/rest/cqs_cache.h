@@ -0,0 +1,156 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// The opt-in caches of the results of the CQS queries, see `RESTfulStorage::AddCQSQuery()`.
+//
+// The results are keyed by the URL and the body of the request, and are only valid as of the "epoch" of the storage
+// they were computed at: the time of its last transaction, or, if the query lists the fields it reads, the time any
+// one of these fields was last modified. As the epochs only move forward, the whole cache is dropped once a newer one
+// is seen. Within an epoch, the least recently used results are evicted first, to stay within the size limits.
+//
+// The queries cached must only depend on the contents of the storage, and on their URLs and bodies, not on the
+// headers of the requests, nor on the time.
+
+#ifndef CURRENT_STORAGE_REST_CQS_CACHE_H
+#define CURRENT_STORAGE_REST_CQS_CACHE_H
+
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../../blocks/http/response.h"
+#include "../../typesystem/struct.h"
+
+namespace current {
+namespace storage {
+namespace rest {
+namespace cqs {
+
+struct CQSQueryCacheParams {
+  // The limits on the number of the results cached, and on the total size of their bodies.
+  size_t max_entries = 1000u;
+  size_t max_bytes = 64u * 1024u * 1024u;
+  // The names of the fields the query reads, if not all of them might be.
+  std::vector<std::string> fields;
+};
+
+CURRENT_STRUCT(CQSQueryCacheStats) {
+  CURRENT_FIELD(hits, uint64_t, 0u);
+  CURRENT_FIELD(misses, uint64_t, 0u);
+  CURRENT_FIELD(invalidated, uint64_t, 0u);  // The results dropped as the epoch moved forward.
+  CURRENT_FIELD(evicted, uint64_t, 0u);      // The results dropped to stay within the size limits.
+  CURRENT_FIELD(entries, uint64_t, 0u);
+  CURRENT_FIELD(bytes, uint64_t, 0u);
+};
+
+class CQSQueryCache final {
+ public:
+  explicit CQSQueryCache(CQSQueryCacheParams params) : params_(std::move(params)) {}
+
+  const CQSQueryCacheParams& Params() const { return params_; }
+
+  // Returns whether the result of the query is cached as of `epoch`, and if it is, copies it into `response`.
+  bool Get(const std::string& key, std::chrono::microseconds epoch, Response& response) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    MoveToEpoch(epoch);
+    const auto cit = index_.find(key);
+    if (cit == index_.end()) {
+      ++stats_.misses;
+      return false;
+    }
+    ++stats_.hits;
+    lru_.splice(lru_.begin(), lru_, cit->second);
+    response = cit->second->response;
+    return true;
+  }
+
+  // Caches the result of the query as of `epoch`, unless it is an error, or is too large to ever fit.
+  void Put(const std::string& key, std::chrono::microseconds epoch, const Response& response) {
+    if (response.code != HTTPResponseCode.OK || response.body.size() > params_.max_bytes || !params_.max_entries) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    MoveToEpoch(epoch);
+    if (index_.count(key)) {
+      return;
+    }
+    while (!lru_.empty() && (lru_.size() >= params_.max_entries || bytes_ + response.body.size() > params_.max_bytes)) {
+      Erase(std::prev(lru_.end()));
+      ++stats_.evicted;
+    }
+    lru_.push_front(Entry{key, response});
+    index_[key] = lru_.begin();
+    bytes_ += response.body.size();
+  }
+
+  CQSQueryCacheStats Stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CQSQueryCacheStats stats = stats_;
+    stats.entries = lru_.size();
+    stats.bytes = bytes_;
+    return stats;
+  }
+
+ private:
+  struct Entry final {
+    std::string key;
+    Response response;
+  };
+
+  void MoveToEpoch(std::chrono::microseconds epoch) {
+    if (epoch != epoch_) {
+      stats_.invalidated += lru_.size();
+      lru_.clear();
+      index_.clear();
+      bytes_ = 0u;
+      epoch_ = epoch;
+    }
+  }
+
+  void Erase(std::list<Entry>::iterator iterator) {
+    bytes_ -= iterator->response.body.size();
+    index_.erase(iterator->key);
+    lru_.erase(iterator);
+  }
+
+  const CQSQueryCacheParams params_;
+  mutable std::mutex mutex_;
+  std::chrono::microseconds epoch_ = std::chrono::microseconds(-1);
+  // The most recently used results go first.
+  std::list<Entry> lru_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+  size_t bytes_ = 0u;
+  CQSQueryCacheStats stats_;
+};
+
+}  // namespace cqs
+}  // namespace rest
+}  // namespace storage
+}  // namespace current
+
+#endif  // CURRENT_STORAGE_REST_CQS_CACHE_H
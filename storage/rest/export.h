@@ -0,0 +1,90 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// `FieldExporter` formats the entries of a dictionary or a matrix for `?export`, one page or one slice at a time,
+// see `FieldExportParams`. The simple format is one JSON per line, and the detailed one is a JSON array.
+
+#ifndef CURRENT_STORAGE_REST_EXPORT_H
+#define CURRENT_STORAGE_REST_EXPORT_H
+
+#include <string>
+
+#include "types.h"
+
+#include "../api_types.h"
+
+#include "../../bricks/util/comparators.h"
+#include "../../typesystem/serialization/json.h"
+
+namespace current {
+namespace storage {
+namespace rest {
+
+template <typename KEY, typename ENTRY>
+class FieldExporter final {
+ public:
+  explicit FieldExporter(const FieldExportParams& params) : params_(params) {}
+
+  // What the export begins and ends with.
+  std::string Prefix() const { return params_.format == FieldExportFormat::Detailed ? "[" : ""; }
+  std::string Suffix() const { return params_.format == FieldExportFormat::Detailed ? "]\n" : ""; }
+
+  // Appends the entries for up to about `limit` entries from `cursor` on to `output`, and returns the cursor to
+  // continue from, empty once done. Throws `StorageInvalidCursorException`.
+  template <typename FIELD>
+  std::string Export(const FIELD& field, const std::string& cursor, size_t limit, std::string& output) {
+    const auto hasher = GenericHashFunction<KEY>();
+    return field.ForEachEntryFromCursor(cursor, limit, [&](const KEY& key, const ENTRY& entry) {
+      if (params_.nshards > 1u && (hasher(key) % params_.nshards) != params_.shard) {
+        return;
+      }
+      if (params_.format == FieldExportFormat::Detailed) {
+        using detailed_export_helper_t = hypermedia::DetailedExportEntryHelper<KEY, ENTRY>;
+        using detailed_export_entry_t = hypermedia::HypermediaRESTDetailedExportEntry<detailed_export_helper_t>;
+        const auto last_modified = field.LastModified(key);
+        CURRENT_ASSERT(Exists(last_modified));
+        if (!first_) {
+          output += ',';
+        }
+        output += JSON<JSONFormat::Minimalistic>(
+            detailed_export_entry_t(Value(last_modified), detailed_export_helper_t(key, entry)));
+      } else {
+        output += JSON<JSONFormat::Minimalistic>(entry);
+        output += '\n';
+      }
+      first_ = false;
+    });
+  }
+
+ private:
+  const FieldExportParams params_;
+  bool first_ = true;
+};
+
+}  // namespace rest
+}  // namespace storage
+}  // namespace current
+
+#endif  // CURRENT_STORAGE_REST_EXPORT_H
@@ -53,6 +53,8 @@ struct Plain {
 
   template <typename OPERATION, typename PARTICULAR_FIELD, typename ENTRY, typename KEY>
   struct RESTfulDataHandler<GET, OPERATION, PARTICULAR_FIELD, ENTRY, KEY> {
+    ConditionalGETParams conditional_get;
+
     template <typename F>
     void EnterByKeyCompletenessFamily(Request request,
                                       semantics::key_completeness::FullKey,
@@ -72,6 +74,7 @@ struct Plain {
 
     template <typename F>
     void Enter(Request request, F&& next) {
+      conditional_get = ConditionalGETParamsFromRequest(request);
       EnterByKeyCompletenessFamily(std::move(request),
                                    typename OPERATION::key_completeness_t(),
                                    typename OPERATION::key_completeness_t::completeness_family_t(),
@@ -99,6 +102,18 @@ struct Plain {
       return result.str();
     }
 
+    // Responds with a 304 instead of what `build()` returns if the client has the version last modified at this time.
+    template <typename F>
+    Response ConditionalResponse(std::chrono::microseconds last_modified, F&& build) const {
+      const bool not_modified = last_modified.count() && conditional_get.NotModified(last_modified);
+      Response response = not_modified ? Response("", HTTPResponseCode.NotModified) : build();
+      if (last_modified.count()) {
+        response.SetHeader("Last-Modified", FormatDateTimeAsIMFFix(last_modified));
+        response.SetHeader(kETagHeader, FormatETag(last_modified));
+      }
+      return response;
+    }
+
     // TODO(dkorolev): Or can `FIELD_SEMANTICS` be hardcoded here?
     template <class INPUT, typename FIELD_SEMANTICS>
     Response RunForFullOrPartialKey(const INPUT& input,
@@ -109,12 +124,15 @@ struct Plain {
         const auto key = field_type_dependent_t<PARTICULAR_FIELD>::template ParseURLKey<KEY>(Value(input.get_url_key));
         const ImmutableOptional<ENTRY> result = input.field[key];
         if (Exists(result)) {
-          return Value(result);
+          return ConditionalResponse(Value(input.field.LastModified(key)),
+                                     [&result]() -> Response { return Value(result); });
         } else {
           return Response("Nope.\n", HTTPResponseCode.NotFound);
         }
       } else {
-        return RunIterate(input.field, typename OPERATION::top_level_iterating_key_t());
+        return ConditionalResponse(input.field.FieldLastModified(), [this, &input]() -> Response {
+          return RunIterate(input.field, typename OPERATION::top_level_iterating_key_t());
+        });
       }
     }
 
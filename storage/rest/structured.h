@@ -26,8 +26,10 @@ SOFTWARE.
 #ifndef CURRENT_STORAGE_REST_STRUCTURED_H
 #define CURRENT_STORAGE_REST_STRUCTURED_H
 
+#include <limits>
 #include <type_traits>
 
+#include "export.h"
 #include "types.h"
 #include "plain.h"
 #include "sfinae.h"
@@ -73,6 +75,20 @@ struct Structured {
             });
   }
 
+  // The `Last-Modified` headers, along with the `ETag`, of the resources and collections returned by the `GET`-s.
+  static void SetLastModifiedHeadersOfGET(Response& response, std::chrono::microseconds last_modified) {
+    response.SetHeader(kLastModifiedHeader, FormatDateTimeAsIMFFix(last_modified));
+    response.SetHeader(kCurrentLastModifiedHeader, current::ToString(last_modified));
+    response.SetHeader(kETagHeader, FormatETag(last_modified));
+  }
+
+  // The 304 to a conditional `GET` of what the client already has, returned without serializing it again.
+  static Response NotModifiedResponse(std::chrono::microseconds last_modified) {
+    Response response("", HTTPResponseCode.NotModified);
+    SetLastModifiedHeadersOfGET(response, last_modified);
+    return response;
+  }
+
   // Returns `false` on error.
   static bool ExtractIfUnmodifiedSinceOrRespondWithError(Request& request,
                                                          Optional<std::chrono::microseconds>& destination) {
@@ -106,8 +122,14 @@ struct Structured {
 
   template <typename OPERATION, typename PARTICULAR_FIELD, typename ENTRY, typename KEY>
   struct RESTfulDataHandler<GET, OPERATION, PARTICULAR_FIELD, ENTRY, KEY> {
+    // The non-paginated `?export`-s of whole fields are streamed by `api.h`, not handled here.
+    constexpr static bool kStreamsFieldExports = true;
+
     context_t context;
 
+    // The `If-None-Match` and `If-Modified-Since` headers, for the single resources and the collections alike.
+    ConditionalGETParams conditional_get;
+
     template <typename F>
     void EnterByKeyCompletenessFamily(Request request,
                                       semantics::key_completeness::FullKey,
@@ -127,6 +149,7 @@ struct Structured {
 
     template <typename F>
     void Enter(Request request, F&& next) {
+      conditional_get = ConditionalGETParamsFromRequest(request);
       EnterByKeyCompletenessFamily(std::move(request),
                                    typename OPERATION::key_completeness_t(),
                                    typename OPERATION::key_completeness_t::completeness_family_t(),
@@ -149,15 +172,16 @@ struct Structured {
           const auto& value = Value(result);
           const auto last_modified = input.field.LastModified(key);
           if (!Exists(input.requested_export_params)) {
+            if (Exists(last_modified) && conditional_get.NotModified(Value(last_modified))) {
+              return NotModifiedResponse(Value(last_modified));
+            }
             const std::string url_collection =
                 input.restful_url_prefix + '/' + kRESTfulDataURLComponent + '/' + input.field_name;
             const std::string url =
                 url_collection + '/' + field_type_dependent_t<PARTICULAR_FIELD>::FormatURLKey(url_key_value);
             Response response = RESPONSE_FORMATTER::BuildResponseForResource(context, url, url_collection, value);
             if (Exists(last_modified)) {
-              const auto last_modified_value = Value(last_modified);
-              response.SetHeader(kLastModifiedHeader, FormatDateTimeAsIMFFix(last_modified_value));
-              response.SetHeader(kCurrentLastModifiedHeader, current::ToString(last_modified_value));
+              SetLastModifiedHeadersOfGET(response, Value(last_modified));
             }
             return response;
           } else {
@@ -178,9 +202,12 @@ struct Structured {
         if (!Exists(input.requested_export_params)) {
           // Top-level field view, identical for dictionaries and matrices.
           // Pass `url` twice, as `pagination_url` and `collection_url` are the same for this format.
-          const std::string url = input.restful_url_prefix + '/' + kRESTfulDataURLComponent + '/' + input.field_name;
-          return RESPONSE_FORMATTER::template BuildResponseWithCollection<PARTICULAR_FIELD, ENTRY, ENTRY>(
-              context, url, url, input.field);
+          return ConditionalCollectionResponse(input, [&]() {
+            const std::string url =
+                input.restful_url_prefix + '/' + kRESTfulDataURLComponent + '/' + input.field_name;
+            return RESPONSE_FORMATTER::template BuildResponseWithCollection<PARTICULAR_FIELD, ENTRY, ENTRY>(
+                context, url, url, input.field);
+          });
         } else {
 #ifndef CURRENT_ALLOW_STORAGE_EXPORT_FROM_MASTER
           // Export requested via `?export`, dump all the records.
@@ -191,36 +218,28 @@ struct Structured {
           } else
 #endif  // CURRENT_ALLOW_STORAGE_EXPORT_FROM_MASTER
           {
-            // Sadly, the `Response` must be returned.
-            // Have to create it in memory for now. -- D.K.
-            // TODO(dkorolev): Migrate to a better way.
+            // The paginated exports are built here, in full, one page at a time. The exports of whole fields are
+            // streamed in slices by `api.h` instead, and never get here.
             const auto& export_params = Value(input.requested_export_params);
-            const auto hasher = GenericHashFunction<KEY>();
-            std::ostringstream result;
-            if (export_params.format == FieldExportFormat::Detailed) {
-              result << '[';
-            }
-            for (auto cit = input.field.begin(); cit != input.field.end(); ++cit) {
-              if (export_params.nshards > 1u && (hasher(cit.key()) % export_params.nshards) != export_params.shard) {
-                continue;
-              }
-              if (export_params.format == FieldExportFormat::Detailed) {
-                const auto last_modified = input.field.LastModified(cit.key());
-                CURRENT_ASSERT(Exists(last_modified));
-                const auto detailed_entry =
-                    detailed_export_entry_t(Value(last_modified), detailed_export_helper_t(cit.key(), *cit));
-                result << JSON<JSONFormat::Minimalistic>(detailed_entry) << ',';
-              } else {
-                result << JSON<JSONFormat::Minimalistic>(*cit) << '\n';
-              }
-            }
-            if (export_params.format == FieldExportFormat::Detailed) {
-              if (result.tellp() > 1) {
-                result.seekp(-1, std::ios_base::cur);
+            FieldExporter<KEY, ENTRY> exporter(export_params);
+            std::string result = exporter.Prefix();
+            try {
+              const std::string cursor =
+                  exporter.Export(input.field,
+                                  export_params.cursor,
+                                  export_params.limit ? export_params.limit : std::numeric_limits<size_t>::max(),
+                                  result);
+              result += exporter.Suffix();
+              Response response(std::move(result));
+              if (!cursor.empty()) {
+                response.SetHeader(kRESTfulExportCursorHeader, cursor);
               }
-              result << "]\n";
+              return response;
+            } catch (const StorageInvalidCursorException&) {
+              return ErrorResponse(
+                  RESTError("InvalidExportCursor", "Malformed export cursor.", {{"cursor", export_params.cursor}}),
+                  HTTPResponseCode.BadRequest);
             }
-            return result.str();
           }
         }
       }
@@ -240,12 +259,14 @@ struct Structured {
             GenericMatrixIterator<KEY_COMPLETENESS, FIELD_SEMANTICS>::RowOrCol(input.field, row_or_col_key);
         if (!iterable.Empty()) {
           // Outer-level matrix collection view, browse the list of rows of cols.
-          return RESPONSE_FORMATTER::template BuildResponseWithCollection<PARTICULAR_FIELD, ENTRY, ENTRY>(
-              context,
-              input.restful_url_prefix + '/' + kRESTfulDataURLComponent + '/' + input.field_name + '.' +
-                  MatrixContainerProxy<KEY_COMPLETENESS>::PartialKeySuffix() + '/' + row_or_col_key_string,
-              input.restful_url_prefix + '/' + kRESTfulDataURLComponent + '/' + input.field_name,
-              iterable);
+          return ConditionalCollectionResponse(input, [&]() {
+            return RESPONSE_FORMATTER::template BuildResponseWithCollection<PARTICULAR_FIELD, ENTRY, ENTRY>(
+                context,
+                input.restful_url_prefix + '/' + kRESTfulDataURLComponent + '/' + input.field_name + '.' +
+                    MatrixContainerProxy<KEY_COMPLETENESS>::PartialKeySuffix() + '/' + row_or_col_key_string,
+                input.restful_url_prefix + '/' + kRESTfulDataURLComponent + '/' + input.field_name,
+                iterable);
+          });
         } else {
           return ErrorResponse(
               ResourceNotFoundError("The requested key has was not found.", {{"key", Value(input.rowcol_get_url_key)}}),
@@ -254,14 +275,33 @@ struct Structured {
       } else {
         // Inner-level matrix collection view, browse a specific row or specific col.
         // Pass the same `url` twice, as the collection ("specific row/col") and pagination have the same base URL.
-        const std::string url = input.restful_url_prefix + '/' + kRESTfulDataURLComponent + '/' + input.field_name +
-                                '.' + MatrixContainerProxy<KEY_COMPLETENESS>::PartialKeySuffix();
-        return RESPONSE_FORMATTER::
-            template BuildResponseWithCollection<PARTICULAR_FIELD, ENTRY, RESTSubCollection<ENTRY>>(
-                context, url, url, GenericMatrixIterator<KEY_COMPLETENESS, FIELD_SEMANTICS>::RowsOrCols(input.field));
+        return ConditionalCollectionResponse(input, [&]() {
+          const std::string url = input.restful_url_prefix + '/' + kRESTfulDataURLComponent + '/' +
+                                  input.field_name + '.' + MatrixContainerProxy<KEY_COMPLETENESS>::PartialKeySuffix();
+          return RESPONSE_FORMATTER::
+              template BuildResponseWithCollection<PARTICULAR_FIELD, ENTRY, RESTSubCollection<ENTRY>>(
+                  context,
+                  url,
+                  url,
+                  GenericMatrixIterator<KEY_COMPLETENESS, FIELD_SEMANTICS>::RowsOrCols(input.field));
+        });
       }
     }
 
+    // The collections are as fresh as the field they are the views of, see `FieldLastModified()`.
+    template <class INPUT, typename F>
+    Response ConditionalCollectionResponse(const INPUT& input, F&& build) const {
+      const std::chrono::microseconds last_modified = input.field.FieldLastModified();
+      if (last_modified.count() && conditional_get.NotModified(last_modified)) {
+        return NotModifiedResponse(last_modified);
+      }
+      Response response = build();
+      if (last_modified.count()) {
+        SetLastModifiedHeadersOfGET(response, last_modified);
+      }
+      return response;
+    }
+
     template <class INPUT>
     Response Run(const INPUT& input) const {
       return RunForFullOrPartialKey(input,
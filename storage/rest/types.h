@@ -321,6 +321,43 @@ CURRENT_STRUCT(CQSBadRequest, generic::RESTGenericResponse) {
 
 }  // namespace cqs
 
+namespace batch {
+
+// A line of the body of a batch, see `RESTfulStorage`, which is one JSON object per mutation.
+CURRENT_STRUCT(RESTBatchMutationHeader) {
+  CURRENT_FIELD(field, std::string);
+  CURRENT_FIELD(method, std::string);  // "PUT" or "DELETE".
+};
+
+// The same line, parsed again once the type of the field is known.
+CURRENT_STRUCT_T(RESTBatchPUTMutation) { CURRENT_FIELD(entry, Optional<T>); };
+CURRENT_STRUCT_T(RESTBatchDELETEMutation) { CURRENT_FIELD(key, Optional<T>); };
+
+// The outcome of a mutation, with the response code it would have had as a request of its own.
+CURRENT_STRUCT(RESTBatchMutationResult) {
+  CURRENT_FIELD(code, uint16_t, 200u);
+  CURRENT_FIELD(message, std::string);
+  CURRENT_FIELD(key, Optional<std::string>);
+  CURRENT_FIELD(error, Optional<generic::RESTError>);
+
+  CURRENT_DEFAULT_CONSTRUCTOR(RESTBatchMutationResult) {}
+  CURRENT_CONSTRUCTOR(RESTBatchMutationResult)
+  (net::HTTPResponseCodeValue code, const std::string& message, const std::string& key)
+      : code(static_cast<uint16_t>(code)), message(message), key(key) {}
+  CURRENT_CONSTRUCTOR(RESTBatchMutationResult)
+  (net::HTTPResponseCodeValue code, const generic::RESTError& error)
+      : code(static_cast<uint16_t>(code)), message(error.message), error(error) {}
+};
+
+// The results of the mutations applied, or, if the batch was rolled back, of those up to the one that has failed.
+CURRENT_STRUCT(RESTBatchResponse, generic::RESTGenericResponse) {
+  CURRENT_FIELD(results, std::vector<RESTBatchMutationResult>);
+
+  CURRENT_DEFAULT_CONSTRUCTOR(RESTBatchResponse) : SUPER(true) {}
+};
+
+}  // namespace batch
+
 }  // namespace rest
 }  // namespace storage
 }  // namespace current
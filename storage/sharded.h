@@ -0,0 +1,164 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// `ShardedStorage<STORAGE>` partitions the keys across a number of independent instances of the same storage, each
+// with its own persister, and thus its own stream and its own lock. The transactions that touch the keys of different
+// shards run concurrently, so the writes are no longer bound by the single mutex of one storage.
+//
+// The transaction on a key runs on the shard that key belongs to, and must only touch the entries of that shard.
+// There are no transactions across the shards; the read-only queries spanning all of them are run on each shard in
+// parallel, see `ReadOnlyTransactionOnAllShards()`.
+//
+// The key is assigned to the shard by the hash of its string representation, the one used in the URLs of the REST
+// API, so that the requests can be routed by the key in the URL alone, see `ShardedRESTfulStorage`. The matrix keys,
+// the `(row, col)` pairs, are assigned by their rows, so that each row is whole within one shard.
+
+#ifndef CURRENT_STORAGE_SHARDED_H
+#define CURRENT_STORAGE_SHARDED_H
+
+#include "../port.h"
+
+#include <exception>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "storage.h"
+
+#include "../bricks/strings/util.h"
+
+namespace current {
+namespace storage {
+
+struct ShardedStorageInvalidNumberOfShardsException final : Exception {
+  using Exception::Exception;
+};
+
+// The shard the key belongs to, out of `shards`.
+inline size_t ShardOfKey(const std::string& key, size_t shards) { return std::hash<std::string>()(key) % shards; }
+
+template <typename KEY>
+size_t ShardOfKey(const KEY& key, size_t shards) {
+  return ShardOfKey(current::ToString(key), shards);
+}
+
+template <typename ROW, typename COL>
+size_t ShardOfKey(const std::pair<ROW, COL>& key, size_t shards) {
+  return ShardOfKey(key.first, shards);
+}
+
+template <typename STORAGE>
+class ShardedStorage final {
+ public:
+  using storage_t = STORAGE;
+
+  // Creates `shards` instances of the storage, calling `create(i)` for each, i.e.
+  // `[](size_t i) { return storage_t::CreateMasterStorage("shard_" + current::ToString(i) + ".db"); }`.
+  template <typename F>
+  ShardedStorage(size_t shards, F&& create) {
+    if (!shards) {
+      CURRENT_THROW(ShardedStorageInvalidNumberOfShardsException("ShardedStorage needs at least one shard."));
+    }
+    shards_.reserve(shards);
+    for (size_t i = 0u; i < shards; ++i) {
+      shards_.push_back(create(i));
+    }
+  }
+
+  size_t ShardsCount() const { return shards_.size(); }
+
+  template <typename KEY>
+  size_t ShardOf(const KEY& key) const {
+    return ShardOfKey(key, shards_.size());
+  }
+
+  STORAGE& Shard(size_t shard) { return *shards_.at(shard); }
+  const STORAGE& Shard(size_t shard) const { return *shards_.at(shard); }
+
+  template <typename KEY>
+  STORAGE& ShardFor(const KEY& key) {
+    return *shards_[ShardOf(key)];
+  }
+  template <typename KEY>
+  const STORAGE& ShardFor(const KEY& key) const {
+    return *shards_[ShardOf(key)];
+  }
+
+  // The transactions on the shard of `key`, same as `STORAGE::ReadWriteTransaction()` and `ReadOnlyTransaction()`.
+  template <typename KEY, typename... ARGS>
+  auto ReadWriteTransaction(const KEY& key, ARGS&&... args) {
+    return ShardFor(key).ReadWriteTransaction(std::forward<ARGS>(args)...);
+  }
+
+  template <typename KEY, typename... ARGS>
+  auto ReadOnlyTransaction(const KEY& key, ARGS&&... args) const {
+    return ShardFor(key).ReadOnlyTransaction(std::forward<ARGS>(args)...);
+  }
+
+  // Runs `f` as a read-only transaction on each shard, in parallel, and returns the results in the order of the
+  // shards, to be combined by the caller. Rethrows the first exception thrown, once all the shards are done.
+  template <typename F>
+  std::vector<std::decay_t<typename STORAGE::template f_result_t<F>>> ReadOnlyTransactionOnAllShards(F&& f) const {
+    using result_t = std::decay_t<typename STORAGE::template f_result_t<F>>;
+    static_assert(!std::is_void_v<result_t>, "`ReadOnlyTransactionOnAllShards()` must return the results per shard.");
+    std::vector<Optional<result_t>> results(shards_.size());
+    std::vector<std::exception_ptr> exceptions(shards_.size());
+    const auto run = [this, &f, &results, &exceptions](size_t shard) {
+      try {
+        results[shard] = Value(shards_[shard]->ReadOnlyTransaction(f).Go());
+      } catch (...) {
+        exceptions[shard] = std::current_exception();
+      }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(shards_.size() - 1u);
+    for (size_t shard = 1u; shard < shards_.size(); ++shard) {
+      threads.emplace_back(run, shard);
+    }
+    run(0u);
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    std::vector<result_t> values;
+    values.reserve(shards_.size());
+    for (size_t shard = 0u; shard < shards_.size(); ++shard) {
+      if (exceptions[shard]) {
+        std::rethrow_exception(exceptions[shard]);
+      }
+      values.push_back(std::move(Value(results[shard])));
+    }
+    return values;
+  }
+
+ private:
+  std::vector<Owned<STORAGE>> shards_;
+};
+
+}  // namespace storage
+}  // namespace current
+
+#endif  // CURRENT_STORAGE_SHARDED_H
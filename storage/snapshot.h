@@ -0,0 +1,79 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// The snapshots of the storage bound the time it takes to start: instead of replaying the whole stream, the storage
+// loads the latest snapshot, and only replays the entries that follow it.
+//
+// A snapshot is the state of all the fields, as the `...Updated` and `...Deleted` events which recreate it when
+// applied to an empty storage, tagged with the number of stream entries it reflects. It is saved in the binary format,
+// whose header carries the TypeID of the storage schema. Thus, a snapshot that is of another schema, or is corrupted,
+// or does not match the stream it is loaded against, is ignored, and the stream is replayed from the very beginning.
+
+#ifndef CURRENT_STORAGE_SNAPSHOT_H
+#define CURRENT_STORAGE_SNAPSHOT_H
+
+#include "../port.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../typesystem/struct.h"
+
+namespace current {
+namespace storage {
+
+struct StorageSnapshots final {
+  // The file to save the snapshot into, and to load it from on startup. Empty to not use snapshots.
+  std::string file_name;
+  // Save a snapshot every this many transactions, or only when `SaveSnapshot()` is called if zero. By default, the
+  // snapshot is taken under the lock of the storage, which blocks the transactions until it is saved.
+  uint64_t every_n_transactions = 0u;
+  // Save the snapshots every `every_n_transactions` from a forked process, see `SaveSnapshotInBackground()`, so that
+  // the transactions are only blocked for as long as it takes to fork. Until a snapshot is saved, the memory pages
+  // modified by the transactions are copied, so this takes up to twice the memory. POSIX only.
+  bool in_background = false;
+
+  StorageSnapshots() = default;
+  explicit StorageSnapshots(std::string file_name, uint64_t every_n_transactions = 0u, bool in_background = false)
+      : file_name(std::move(file_name)), every_n_transactions(every_n_transactions), in_background(in_background) {}
+};
+
+CURRENT_STRUCT_T(StorageSnapshot) {
+  // The number of entries of the stream the snapshot reflects, the index of the first entry to replay atop it.
+  CURRENT_FIELD(index, uint64_t, 0u);
+  // The timestamp of the entry right before `index`, to make sure the snapshot is loaded against the same stream.
+  CURRENT_FIELD(last_entry_us, std::chrono::microseconds, std::chrono::microseconds(0));
+  // The timestamp of the last transaction applied.
+  CURRENT_FIELD(last_applied_us, std::chrono::microseconds, std::chrono::microseconds(-1));
+  CURRENT_FIELD(mutations, std::vector<T>);
+};
+
+}  // namespace storage
+}  // namespace current
+
+using current::storage::StorageSnapshots;
+
+#endif  // CURRENT_STORAGE_SNAPSHOT_H
@@ -46,6 +46,9 @@ SOFTWARE.
 #include <atomic>
 
 #include "base.h"
+#include "bulk_load.h"
+#include "replay.h"
+#include "snapshot.h"
 #include "transaction.h"
 #include "transaction_policy.h"
 #include "transaction_result.h"
@@ -152,6 +155,9 @@ namespace storage {
 #define CURRENT_STORAGE_FIELD_ENTRY_UnorderedDictionary(entry_type, entry_name) \
   CURRENT_STORAGE_FIELD_ENTRY_Dictionary_IMPL(UnorderedDictionary, entry_type, entry_name)
 
+#define CURRENT_STORAGE_FIELD_ENTRY_FlatUnorderedDictionary(entry_type, entry_name) \
+  CURRENT_STORAGE_FIELD_ENTRY_Dictionary_IMPL(FlatUnorderedDictionary, entry_type, entry_name)
+
 #define CURRENT_STORAGE_FIELD_ENTRY_OrderedDictionary(entry_type, entry_name) \
   CURRENT_STORAGE_FIELD_ENTRY_Dictionary_IMPL(OrderedDictionary, entry_type, entry_name)
 
@@ -307,8 +313,59 @@ class StorageImpl {
  private:
   FIELDS fields_;
   Optional<Owned<stream_t>> owned_stream_;  // Valid iff the Storage has been constructed to keep its own stream.
-  persister_t persister_;
+  // Goes before `persister_`, which replays the stream into the fields through it, possibly from its constructor.
   TRANSACTION_POLICY<persister_t> transaction_policy_;
+  persister_t persister_;
+
+  // With the transaction policies running the read-only transactions concurrently, they don't lock the stream.
+  template <current::locks::MutexLockStatus MLS>
+  constexpr static current::locks::MutexLockStatus read_only_transaction_mls_v =
+      TRANSACTION_POLICY<persister_t>::concurrent_read_only_transactions
+          ? current::locks::MutexLockStatus::AlreadyLocked
+          : MLS;
+
+  void ApplyTransaction(const typename persister_t::transaction_t& transaction) {
+    transaction_policy_.ApplyTransactionFromLockedSection([this, &transaction]() {
+      for (const auto& mutation : transaction.mutations) {
+        mutation.Call(fields_);
+      }
+    });
+  }
+
+  // The index of the field the mutation is of, and applying the mutation to it alone, for the parallel replay.
+  static size_t FieldIndexOfMutation(const fields_variant_t& mutation) {
+    size_t index = 0u;
+    mutation.Call([&index](const auto& event) {
+      constexpr size_t field_index =
+          ::current::storage::FieldIndexOfEvent<FIELDS, FIELDS_COUNT, current::decay_t<decltype(event)>>();
+      index = field_index;
+    });
+    return index;
+  }
+
+  void ApplyMutationToItsField(const fields_variant_t& mutation) { mutation.Call(fields_); }
+
+  // More threads than fields would have nothing to do.
+  static StorageReplayParallelism ClampedReplayParallelism(StorageReplayParallelism parallelism) {
+    parallelism.threads = std::min(parallelism.threads, static_cast<size_t>(FIELDS_COUNT));
+    return parallelism;
+  }
+
+  // The events which recreate all the fields, see `snapshot.h`.
+  std::vector<fields_variant_t> SnapshotEvents() const {
+    std::vector<fields_variant_t> events;
+    SnapshotEventsImpl(events, std::make_index_sequence<FIELDS_COUNT>());
+    return events;
+  }
+
+  template <size_t... INDEXES>
+  void SnapshotEventsImpl(std::vector<fields_variant_t>& events, std::index_sequence<INDEXES...>) const {
+    (fields_(::current::storage::ImmutableFieldByIndex<static_cast<int>(INDEXES)>(),
+             [&events](const auto& field) {
+               field.ForEachSnapshotEvent([&events](auto&& event) { events.emplace_back(std::move(event)); });
+             }),
+     ...);
+  }
 
  public:
   using fields_by_ref_t = FIELDS&;
@@ -318,20 +375,80 @@ class StorageImpl {
 
   template <typename... ARGS>
   static Owned<StorageImpl> CreateMasterStorage(ARGS&&... args) {
-    return MakeOwned<StorageImpl>(typename persister_t::Master(), CreateStreamAsWell(), std::forward<ARGS>(args)...);
+    return MakeOwned<StorageImpl>(
+        typename persister_t::Master(),
+        CreateStreamAsWell(),
+        StorageSnapshots(),
+        StorageReplayParallelism(),
+        std::forward<ARGS>(args)...);
   }
 
   template <typename... ARGS>
   static Owned<StorageImpl> CreateFollowingStorage(ARGS&&... args) {
-    return MakeOwned<StorageImpl>(typename persister_t::Following(), CreateStreamAsWell(), std::forward<ARGS>(args)...);
+    return MakeOwned<StorageImpl>(
+        typename persister_t::Following(),
+        CreateStreamAsWell(),
+        StorageSnapshots(),
+        StorageReplayParallelism(),
+        std::forward<ARGS>(args)...);
   }
 
-  static Owned<StorageImpl> CreateMasterStorageAtopExistingStream(Borrowed<stream_t> stream) {
-    return MakeOwned<StorageImpl>(typename persister_t::Master(), UseExistingStream(), stream);
+  // Start from the snapshot in `snapshots.file_name`, if there is a valid one, and keep saving it, see `snapshot.h`.
+  template <typename... ARGS>
+  static Owned<StorageImpl> CreateMasterStorageWithSnapshots(StorageSnapshots snapshots, ARGS&&... args) {
+    return MakeOwned<StorageImpl>(
+        typename persister_t::Master(),
+        CreateStreamAsWell(),
+        std::move(snapshots),
+        StorageReplayParallelism(),
+        std::forward<ARGS>(args)...);
   }
 
-  static Owned<StorageImpl> CreateFollowingStorageAtopExistingStream(Borrowed<stream_t> stream) {
-    return MakeOwned<StorageImpl>(typename persister_t::Following(), UseExistingStream(), stream);
+  template <typename... ARGS>
+  static Owned<StorageImpl> CreateFollowingStorageWithSnapshots(StorageSnapshots snapshots, ARGS&&... args) {
+    return MakeOwned<StorageImpl>(
+        typename persister_t::Following(),
+        CreateStreamAsWell(),
+        std::move(snapshots),
+        StorageReplayParallelism(),
+        std::forward<ARGS>(args)...);
+  }
+
+  // Apply the transactions replayed on startup on several threads, one field per thread, see `replay.h`.
+  template <typename... ARGS>
+  static Owned<StorageImpl> CreateMasterStorageWithParallelReplay(StorageReplayParallelism parallelism,
+                                                                  ARGS&&... args) {
+    return MakeOwned<StorageImpl>(typename persister_t::Master(),
+                                  CreateStreamAsWell(),
+                                  StorageSnapshots(),
+                                  std::move(parallelism),
+                                  std::forward<ARGS>(args)...);
+  }
+
+  template <typename... ARGS>
+  static Owned<StorageImpl> CreateFollowingStorageWithParallelReplay(StorageReplayParallelism parallelism,
+                                                                     ARGS&&... args) {
+    return MakeOwned<StorageImpl>(typename persister_t::Following(),
+                                  CreateStreamAsWell(),
+                                  StorageSnapshots(),
+                                  std::move(parallelism),
+                                  std::forward<ARGS>(args)...);
+  }
+
+  static Owned<StorageImpl> CreateMasterStorageAtopExistingStream(
+      Borrowed<stream_t> stream,
+      StorageSnapshots snapshots = StorageSnapshots(),
+      StorageReplayParallelism parallelism = StorageReplayParallelism()) {
+    return MakeOwned<StorageImpl>(
+        typename persister_t::Master(), UseExistingStream(), std::move(snapshots), std::move(parallelism), stream);
+  }
+
+  static Owned<StorageImpl> CreateFollowingStorageAtopExistingStream(
+      Borrowed<stream_t> stream,
+      StorageSnapshots snapshots = StorageSnapshots(),
+      StorageReplayParallelism parallelism = StorageReplayParallelism()) {
+    return MakeOwned<StorageImpl>(
+        typename persister_t::Following(), UseExistingStream(), std::move(snapshots), std::move(parallelism), stream);
   }
 
  private:
@@ -341,17 +458,39 @@ class StorageImpl {
   struct UseExistingStream {};
 
   template <typename CONSTRUCTION_TYPE>
-  StorageImpl(CONSTRUCTION_TYPE, UseExistingStream, Borrowed<stream_t> stream)
-      : persister_(
-            CONSTRUCTION_TYPE(), [this](const fields_variant_t& entry) { entry.Call(fields_); }, stream),
-        transaction_policy_(persister_, fields_.current_storage_mutation_journal_) {}
+  StorageImpl(CONSTRUCTION_TYPE,
+              UseExistingStream,
+              StorageSnapshots snapshots,
+              StorageReplayParallelism parallelism,
+              Borrowed<stream_t> stream)
+      : transaction_policy_(persister_, fields_.current_storage_mutation_journal_),
+        persister_(
+            CONSTRUCTION_TYPE(),
+            [this](const typename persister_t::transaction_t& transaction) { ApplyTransaction(transaction); },
+            stream,
+            std::move(snapshots),
+            [this]() { return SnapshotEvents(); },
+            ClampedReplayParallelism(std::move(parallelism)),
+            FieldIndexOfMutation,
+            [this](const fields_variant_t& mutation) { ApplyMutationToItsField(mutation); }) {}
 
   template <typename CONSTRUCTION_TYPE, typename... ARGS>
-  StorageImpl(CONSTRUCTION_TYPE, CreateStreamAsWell, ARGS&&... args)
+  StorageImpl(CONSTRUCTION_TYPE,
+              CreateStreamAsWell,
+              StorageSnapshots snapshots,
+              StorageReplayParallelism parallelism,
+              ARGS&&... args)
       : owned_stream_(std::move(stream_t::CreateStream(std::forward<ARGS>(args)...))),
+        transaction_policy_(persister_, fields_.current_storage_mutation_journal_),
         persister_(
-            CONSTRUCTION_TYPE(), [this](const fields_variant_t& entry) { entry.Call(fields_); }, Value(owned_stream_)),
-        transaction_policy_(persister_, fields_.current_storage_mutation_journal_) {}
+            CONSTRUCTION_TYPE(),
+            [this](const typename persister_t::transaction_t& transaction) { ApplyTransaction(transaction); },
+            Value(owned_stream_),
+            std::move(snapshots),
+            [this]() { return SnapshotEvents(); },
+            ClampedReplayParallelism(std::move(parallelism)),
+            FieldIndexOfMutation,
+            [this](const fields_variant_t& mutation) { ApplyMutationToItsField(mutation); }) {}
 
  public:
   template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock>
@@ -364,6 +503,36 @@ class StorageImpl {
     return persister_.template LastAppliedTimestampPersister<MLS>();
   }
 
+  // The index of the first entry of the stream not yet applied to the storage, i.e. the number of the entries applied.
+  template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock>
+  uint64_t NextStreamIndex() const {
+    current::locks::SmartMutexLockGuard<MLS> lock(persister_.Stream()->Impl()->publishing_mutex);
+    return persister_.NextStreamIndexFromLockedSection();
+  }
+
+  // How far behind the stream the following storage is, see `StorageReplicationLag`.
+  StorageReplicationLag ReplicationLag() const { return persister_.ReplicationLagPersister(); }
+
+  // `PublishMetrics` publishes `ReplicationLag()` into the process-wide metrics registry, labeled `storage="<name>"`,
+  // for as long as the returned scope is alive; it must not outlive the storage.
+  [[nodiscard]] current::metrics::CollectorScope PublishMetrics(
+      const std::string& name, current::metrics::Registry& registry = current::metrics::ProcessMetrics()) const {
+    return registry.AddCollector([this, name](current::metrics::MetricsSnapshot& snapshot) {
+      using namespace current::metrics;
+      const StorageReplicationLag lag = ReplicationLag();
+      AddGauge(snapshot,
+               "storage_replication_lag_entries",
+               {{"storage", name}},
+               lag.entries,
+               "The entries of the stream not yet applied to the storage.");
+      AddGauge(snapshot,
+               "storage_replication_lag_seconds",
+               {{"storage", name}},
+               static_cast<double>(lag.us.count()) * 1e-6,
+               "How far behind the last entry of the stream the last entry applied to the storage is.");
+    });
+  }
+
   // Used for applying updates by dispatching corresponding events.
 #ifndef CURRENT_FOR_CPP14
   template <typename... ARGS>
@@ -405,7 +574,8 @@ class StorageImpl {
   template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock, typename F>
   ::current::Future<::current::storage::TransactionResult<f_result_t<F>>, ::current::StrictFuture::Strict>
   ReadOnlyTransaction(F&& f) const {
-    current::locks::SmartMutexLockGuard<MLS> lock(persister_.Stream()->Impl()->publishing_mutex);
+    current::locks::SmartMutexLockGuard<read_only_transaction_mls_v<MLS>> lock(
+        persister_.Stream()->Impl()->publishing_mutex);
     return transaction_policy_.TransactionFromLockedSection(
         [&f, this]() { return f(static_cast<const FIELDS&>(fields_)); });
   }
@@ -413,11 +583,37 @@ class StorageImpl {
   template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock, typename F1, typename F2>
   ::current::Future<::current::storage::TransactionResult<void>, ::current::StrictFuture::Strict> ReadOnlyTransaction(
       F1&& f1, F2&& f2) const {
-    current::locks::SmartMutexLockGuard<MLS> lock(persister_.Stream()->Impl()->publishing_mutex);
+    current::locks::SmartMutexLockGuard<read_only_transaction_mls_v<MLS>> lock(
+        persister_.Stream()->Impl()->publishing_mutex);
     return transaction_policy_.TransactionFromLockedSection(
         [&f1, this]() { return f1(static_cast<const FIELDS&>(fields_)); }, std::forward<F2>(f2));
   }
 
+  using bulk_load_t = StorageBulkLoad<fields_variant_t>;
+
+  // Seeds the storage with the entries `f` adds, as `f(ImmutableFields<STORAGE>, bulk_load_t&)`, see `bulk_load.h`.
+  // If `f` throws, nothing is loaded. Returns the number of the entries loaded.
+  template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock, typename F>
+  size_t BulkLoad(F&& f) {
+    current::locks::SmartMutexLockGuard<MLS> lock(persister_.Stream()->Impl()->publishing_mutex);
+    if (!IsMasterStorage<current::locks::MutexLockStatus::AlreadyLocked>()) {
+      CURRENT_THROW(ReadWriteTransactionInFollowerStorageException());
+    }
+    typename persister_t::transaction_t transaction;
+    transaction.meta.begin_us = current::time::Now();
+    {
+      bulk_load_t load(transaction.meta.begin_us, transaction.mutations);
+      f(static_cast<const FIELDS&>(fields_), load);
+    }
+    const size_t entries = transaction.mutations.size();
+    if (entries) {
+      ApplyTransaction(transaction);
+      transaction.meta.end_us = current::time::Now();
+      persister_.PersistTransactionFromLockedSection(std::move(transaction));
+    }
+    return entries;
+  }
+
   void ExposeRawLogViaHTTP(int port, const std::string& route) { persister_.ExposeRawLogViaHTTP(port, route); }
 
   Borrowed<stream_t> BorrowUnderlyingStream() const { return persister_.BorrowStream(); }
@@ -446,6 +642,25 @@ class StorageImpl {
     persister_.BecomeMasterStorage();
   }
 
+  // Saves the snapshot now, for the storages created `...WithSnapshots()`.
+  // Returns the number of stream entries the snapshot reflects.
+  template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock>
+  uint64_t SaveSnapshot() {
+    current::locks::SmartMutexLockGuard<MLS> lock(persister_.Stream()->Impl()->publishing_mutex);
+    return persister_.SaveSnapshotFromLockedSection();
+  }
+
+  // Saves the snapshot from a forked process, while the transactions carry on, see `snapshot.h`.
+  // Returns `false` if the snapshot started in the background before is still being saved.
+  template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock>
+  bool SaveSnapshotInBackground() {
+    current::locks::SmartMutexLockGuard<MLS> lock(persister_.Stream()->Impl()->publishing_mutex);
+    return persister_.SaveSnapshotInBackgroundFromLockedSection();
+  }
+
+  // Returns whether the last snapshot saved in the background was saved successfully, once it is.
+  bool WaitForBackgroundSnapshot() { return persister_.WaitForBackgroundSnapshot(); }
+
   void GracefulShutdown() { transaction_policy_.GracefulShutdown(); }
 
  private:
@@ -481,7 +696,7 @@ class NullStoragePersisterImpl {
   using transaction_t = Transaction<variant_t>;
 
   // NOTE(dkorolev): Commented out to not make the compiler match the type.
-  // using fields_update_function_t = std::function<void(const variant_t&)>;
+  // using fields_update_function_t = std::function<void(const transaction_t&)>;
   // NullStoragePersisterImpl(std::mutex&, fields_update_function_t) {}
 
   void PersistJournal(MutationJournal& journal) { journal.Clear(); }
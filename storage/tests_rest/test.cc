@@ -986,6 +986,523 @@ TEST(TransactionalStorage, ShuttingDownAPIReportsUpAsFalse) {
   EXPECT_EQ(503, static_cast<int>(HTTP(GET(base_url + "/api/data/post/foo")).code));
 }
 
+TEST(TransactionalStorage, RESTfulExport) {
+  current::time::ResetToZero();
+
+  using namespace transactional_storage_test;
+  using namespace current::storage::rest;
+  using storage_t = SimpleStorage<StreamStreamPersister>;
+
+  const std::string persistence_file_name =
+      current::FileSystem::JoinPath(FLAGS_transactional_storage_test_tmpdir, "data");
+  const auto persistence_file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+
+  auto stream = storage_t::stream_t::CreateStream(persistence_file_name);
+  auto master_storage = storage_t::CreateMasterStorageAtopExistingStream(stream);
+  EXPECT_TRUE(WasCommitted(master_storage
+                               ->ReadWriteTransaction([](MutableFields<storage_t> fields) {
+                                 for (int i = 0; i < 25; ++i) {
+                                   fields.user.Add(SimpleUser(current::strings::Printf("u%02d", i), "User"));
+                                   fields.post.Add(SimplePost(current::strings::Printf("p%02d", i), "Post"));
+                                 }
+                               })
+                               .Go()));
+
+  auto storage = storage_t::CreateFollowingStorageAtopExistingStream(stream);
+  while (storage->LastAppliedTimestamp() < master_storage->LastAppliedTimestamp()) {
+    std::this_thread::yield();
+  }
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  static_cast<void>(http_server);
+  const auto base_url = current::strings::Printf("http://localhost:%d", port);
+
+  const auto rest = RESTfulStorage<storage_t, current::storage::rest::Simple>(*storage, port, "/api", "");
+  const auto master_rest =
+      RESTfulStorage<storage_t, current::storage::rest::Simple>(*master_storage, port, "/master", "");
+
+  // The whole field is streamed, one JSON per line, in the order of the keys for the ordered containers.
+  std::string golden_users;
+  for (int i = 0; i < 25; ++i) {
+    golden_users += JSON<JSONFormat::Minimalistic>(SimpleUser(current::strings::Printf("u%02d", i), "User")) + '\n';
+  }
+  {
+    const auto response = HTTP(GET(base_url + "/api/data/user?export"));
+    EXPECT_EQ(200, static_cast<int>(response.code));
+    EXPECT_EQ(golden_users, response.body);
+    EXPECT_FALSE(response.headers.Has(kRESTfulExportCursorHeader));
+  }
+
+  // The paginated export goes on for as long as there is the cursor for the next page.
+  const auto ExportPages = [](const std::string& url, std::vector<std::string>& pages) {
+    std::string cursor;
+    do {
+      const auto response = HTTP(GET(url + (cursor.empty() ? "" : "&cursor=" + cursor)));
+      ASSERT_EQ(200, static_cast<int>(response.code));
+      pages.push_back(response.body);
+      cursor = response.headers.GetOrDefault(kRESTfulExportCursorHeader, "");
+    } while (!cursor.empty() && pages.size() < 100u);
+  };
+  {
+    std::vector<std::string> pages;
+    ExportPages(base_url + "/api/data/user?export&limit=10", pages);
+    ASSERT_EQ(3u, pages.size());
+    EXPECT_EQ(golden_users, pages[0] + pages[1] + pages[2]);
+    EXPECT_EQ(5u, current::strings::Split(pages[2], '\n').size());
+  }
+  {
+    std::vector<std::string> pages;
+    ExportPages(base_url + "/api/data/post?export&limit=7", pages);
+    std::multiset<std::string> posts;
+    for (const auto& page : pages) {
+      for (const auto& line : current::strings::Split(page, '\n')) {
+        posts.insert(ParseJSON<SimplePost>(line).key);
+      }
+    }
+    EXPECT_EQ(25u, posts.size());
+    EXPECT_EQ(25u, std::set<std::string>(posts.begin(), posts.end()).size());
+  }
+
+  // The detailed format is a JSON array for each page, as well as for the whole field.
+  {
+    const auto response = HTTP(GET(base_url + "/api/data/user?export=detailed&limit=2"));
+    EXPECT_EQ(200, static_cast<int>(response.code));
+    EXPECT_EQ(0u, response.body.find("[{\"key\":\"u00\""));
+    EXPECT_EQ(response.body.length() - 2u, response.body.find("]\n"));
+    EXPECT_TRUE(response.headers.Has(kRESTfulExportCursorHeader));
+  }
+  {
+    const auto response = HTTP(GET(base_url + "/api/data/user?export=detailed"));
+    EXPECT_EQ(200, static_cast<int>(response.code));
+    EXPECT_EQ(0u, response.body.find("[{\"key\":\"u00\""));
+    EXPECT_EQ(response.body.length() - 2u, response.body.find("]\n"));
+    size_t entries = 0u;
+    for (size_t i = response.body.find("timestamp_us"); i != std::string::npos;
+         i = response.body.find("timestamp_us", i + 1u)) {
+      ++entries;
+    }
+    EXPECT_EQ(25u, entries);
+  }
+
+  EXPECT_EQ(400, static_cast<int>(HTTP(GET(base_url + "/api/data/post?export&limit=7&cursor=x_y")).code));
+  EXPECT_EQ(403, static_cast<int>(HTTP(GET(base_url + "/master/data/user?export")).code));
+  EXPECT_EQ(403, static_cast<int>(HTTP(GET(base_url + "/master/data/user?export&limit=10")).code));
+}
+
+TEST(TransactionalStorage, RESTfulConditionalGET) {
+  current::time::ResetToZero();
+
+  using namespace transactional_storage_test;
+  using namespace current::storage::rest;
+  using storage_t = SimpleStorage<StreamInMemoryStreamPersister>;
+
+  auto storage = storage_t::CreateMasterStorage();
+
+  const auto add_user = [&storage](std::chrono::microseconds now, const std::string& key) {
+    current::time::SetNow(now);
+    EXPECT_TRUE(WasCommitted(
+        storage->ReadWriteTransaction([key](MutableFields<storage_t> fields) { fields.user.Add(SimpleUser(key, key)); })
+            .Go()));
+  };
+  const std::chrono::microseconds t1(1400000000000000ll + 123);
+  const std::chrono::microseconds t2(1400000010000000ll + 456);
+  add_user(t1, "one");
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  static_cast<void>(http_server);
+  const auto base_url = current::strings::Printf("http://localhost:%d", port);
+
+  const auto rest = RESTfulStorage<storage_t, current::storage::rest::Simple>(*storage, port, "/api", "");
+  const auto plain_rest = RESTfulStorage<storage_t>(*storage, port, "/plain", "");
+
+  const std::string etag1 = "\"1400000000000123\"";
+  const std::string etag2 = "\"1400000010000456\"";
+
+  {
+    const auto response = HTTP(GET(base_url + "/api/data/user/one"));
+    EXPECT_EQ(200, static_cast<int>(response.code));
+    EXPECT_EQ(etag1, response.headers.Get("ETag"));
+    EXPECT_EQ("Tue, 13 May 2014 16:53:20 GMT", response.headers.Get("Last-Modified"));
+  }
+  {
+    const auto response = HTTP(GET(base_url + "/api/data/user/one").SetHeader("If-None-Match", etag1));
+    EXPECT_EQ(304, static_cast<int>(response.code));
+    EXPECT_EQ("", response.body);
+    EXPECT_EQ(etag1, response.headers.Get("ETag"));
+  }
+  EXPECT_EQ(304,
+            static_cast<int>(
+                HTTP(GET(base_url + "/api/data/user/one").SetHeader("If-None-Match", "\"1\", W/" + etag1)).code));
+  EXPECT_EQ(200, static_cast<int>(HTTP(GET(base_url + "/api/data/user/one").SetHeader("If-None-Match", "\"1\"")).code));
+  EXPECT_EQ(304,
+            static_cast<int>(HTTP(GET(base_url + "/api/data/user/one")
+                                      .SetHeader("If-Modified-Since", "Tue, 13 May 2014 16:53:20 GMT"))
+                                 .code));
+  EXPECT_EQ(200,
+            static_cast<int>(HTTP(GET(base_url + "/api/data/user/one")
+                                      .SetHeader("If-Modified-Since", "Tue, 13 May 2014 16:53:19 GMT"))
+                                 .code));
+  // `If-None-Match` takes precedence, and the unparsable dates are ignored.
+  EXPECT_EQ(200,
+            static_cast<int>(HTTP(GET(base_url + "/api/data/user/one")
+                                      .SetHeader("If-None-Match", "\"1\"")
+                                      .SetHeader("If-Modified-Since", "Tue, 13 May 2014 16:53:20 GMT"))
+                                 .code));
+  EXPECT_EQ(200,
+            static_cast<int>(HTTP(GET(base_url + "/api/data/user/one").SetHeader("If-Modified-Since", "Never")).code));
+
+  // The collection is as fresh as the field, and the field was last modified along with its only entry.
+  EXPECT_EQ(etag1, HTTP(GET(base_url + "/api/data/user")).headers.Get("ETag"));
+  EXPECT_EQ(304, static_cast<int>(HTTP(GET(base_url + "/api/data/user").SetHeader("If-None-Match", etag1)).code));
+  EXPECT_EQ(304, static_cast<int>(HTTP(GET(base_url + "/plain/data/user/one").SetHeader("If-None-Match", etag1)).code));
+  EXPECT_EQ(304, static_cast<int>(HTTP(GET(base_url + "/plain/data/user").SetHeader("If-None-Match", etag1)).code));
+  // The fields never modified have no `ETag`-s.
+  EXPECT_FALSE(HTTP(GET(base_url + "/api/data/post")).headers.Has("ETag"));
+
+  add_user(t2, "two");
+
+  // The entries not modified stay not modified, while the collection has changed.
+  EXPECT_EQ(304, static_cast<int>(HTTP(GET(base_url + "/api/data/user/one").SetHeader("If-None-Match", etag1)).code));
+  {
+    const auto response = HTTP(GET(base_url + "/api/data/user").SetHeader("If-None-Match", etag1));
+    EXPECT_EQ(200, static_cast<int>(response.code));
+    EXPECT_EQ(etag2, response.headers.Get("ETag"));
+  }
+  {
+    const auto response = HTTP(GET(base_url + "/plain/data/user").SetHeader("If-None-Match", etag1));
+    EXPECT_EQ(200, static_cast<int>(response.code));
+    EXPECT_EQ(etag2, response.headers.Get("ETag"));
+  }
+
+  // Erasing an entry modifies the collection too, and rolling back the transaction does not undo that.
+  current::time::SetNow(t2 + std::chrono::microseconds(1));
+  EXPECT_TRUE(WasCommitted(
+      storage->ReadWriteTransaction([](MutableFields<storage_t> fields) { fields.user.Erase("two"); }).Go()));
+  EXPECT_EQ("\"1400000010000457\"", HTTP(GET(base_url + "/api/data/user")).headers.Get("ETag"));
+  current::time::SetNow(t2 + std::chrono::microseconds(2));
+  EXPECT_FALSE(WasCommitted(storage
+                                ->ReadWriteTransaction([](MutableFields<storage_t> fields) {
+                                  fields.user.Add(SimpleUser("three", "three"));
+                                  CURRENT_STORAGE_THROW_ROLLBACK();
+                                })
+                                .Go()));
+  EXPECT_EQ("\"1400000010000458\"", HTTP(GET(base_url + "/api/data/user")).headers.Get("ETag"));
+}
+
+TEST(TransactionalStorage, RESTfulBatch) {
+  current::time::ResetToZero();
+
+  using namespace transactional_storage_test;
+  using namespace current::storage::rest;
+  using storage_t = SimpleStorage<StreamInMemoryStreamPersister>;
+
+  auto storage = storage_t::CreateMasterStorage();
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  static_cast<void>(http_server);
+  const auto base_url = current::strings::Printf("http://localhost:%d", port);
+
+  const auto rest = RESTfulStorage<storage_t, current::storage::rest::Simple>(*storage, port, "/api", "");
+
+  const auto codes = [](const batch::RESTBatchResponse& response) {
+    std::vector<std::string> result;
+    for (const auto& e : response.results) {
+      result.push_back(current::ToString(e.code));
+    }
+    return current::strings::Join(result, ',');
+  };
+  const auto users = [&storage]() {
+    return Value(storage->ReadOnlyTransaction([](ImmutableFields<storage_t> fields) {
+                                   std::vector<std::string> result;
+                                   for (const auto& user : fields.user) {
+                                     result.push_back(user.key + '=' + user.name);
+                                   }
+                                   std::sort(result.begin(), result.end());
+                                   return current::strings::Join(result, ',') + " likes=" +
+                                          current::ToString(fields.like.Size());
+                                 })
+                     .Go());
+  };
+
+  {
+    const std::string body =
+        "{\"field\":\"user\",\"method\":\"PUT\",\"entry\":{\"key\":\"max\",\"name\":\"MZ\"}}\n"
+        "{\"field\":\"user\",\"method\":\"PUT\",\"entry\":{\"key\":\"dima\",\"name\":\"DK\"}}\n"
+        "\n"
+        "{\"field\":\"like\",\"method\":\"PUT\",\"entry\":{\"row\":\"max\",\"col\":\"beer\"}}\r\n"
+        "{\"field\":\"user\",\"method\":\"PUT\",\"entry\":{\"key\":\"max\",\"name\":\"Max\"}}\n"
+        "{\"field\":\"user\",\"method\":\"DELETE\",\"key\":\"dima\"}\n"
+        "{\"field\":\"user\",\"method\":\"DELETE\",\"key\":\"nobody\"}\n";
+    const auto response = HTTP(POST(base_url + "/api/batch", body));
+    EXPECT_EQ(200, static_cast<int>(response.code)) << response.body;
+    const auto parsed = ParseJSON<batch::RESTBatchResponse>(response.body);
+    EXPECT_TRUE(parsed.success);
+    EXPECT_EQ("6 mutations applied.", Value(parsed.message));
+    EXPECT_EQ("201,201,201,200,200,200", codes(parsed));
+    EXPECT_EQ("max", Value(parsed.results[0].key));
+    EXPECT_EQ("Resource didn't exist.", parsed.results[5].message);
+  }
+  EXPECT_EQ("max=Max likes=1", users());
+  // All the mutations of the batch make a single transaction.
+  EXPECT_EQ(1u, storage->UnderlyingStream()->Data()->Size());
+
+  // All or nothing: the mutations before the failed one are rolled back.
+  const std::string put_alice = "{\"field\":\"user\",\"method\":\"PUT\",\"entry\":{\"key\":\"alice\",\"name\":\"A\"}}\n";
+  {
+    const auto response = HTTP(POST(base_url + "/api/batch",
+                                    put_alice + "{\"field\":\"nope\",\"method\":\"PUT\",\"entry\":{}}\n" + put_alice));
+    EXPECT_EQ(404, static_cast<int>(response.code));
+    const auto parsed = ParseJSON<batch::RESTBatchResponse>(response.body);
+    EXPECT_FALSE(parsed.success);
+    EXPECT_EQ("Mutation 1 has failed, the batch was rolled back.", Value(parsed.message));
+    EXPECT_EQ("201,404", codes(parsed));
+    EXPECT_EQ("FieldNotFound", Value(parsed.results[1].error).name);
+  }
+  {
+    const auto response = HTTP(POST(base_url + "/api/batch", put_alice + "{\"field\":\"user\",\"method\":\"PUT\"}"));
+    EXPECT_EQ(400, static_cast<int>(response.code));
+    EXPECT_EQ("MissingEntry", Value(ParseJSON<batch::RESTBatchResponse>(response.body).results[1].error).name);
+  }
+  {
+    const auto response = HTTP(POST(base_url + "/api/batch", put_alice + "{\"field\":\"user\",\"method\":\"PATCH\"}"));
+    EXPECT_EQ(405, static_cast<int>(response.code));
+  }
+  {
+    const auto response = HTTP(
+        POST(base_url + "/api/batch", put_alice + "{\"field\":\"user\",\"method\":\"PUT\",\"entry\":{\"key\":42}}"));
+    EXPECT_EQ(400, static_cast<int>(response.code));
+    EXPECT_EQ("ParseJSONError", Value(ParseJSON<batch::RESTBatchResponse>(response.body).results[1].error).name);
+  }
+  EXPECT_EQ(400, static_cast<int>(HTTP(POST(base_url + "/api/batch", put_alice + "not a JSON")).code));
+  EXPECT_EQ("max=Max likes=1", users());
+  EXPECT_EQ(1u, storage->UnderlyingStream()->Data()->Size());
+
+  EXPECT_EQ(405, static_cast<int>(HTTP(GET(base_url + "/api/batch")).code));
+}
+
+TEST(TransactionalStorage, CQSQueryCache) {
+  current::time::ResetToZero();
+
+  using namespace transactional_storage_test;
+  using namespace current::storage::rest;
+  using storage_t = SimpleStorage<StreamInMemoryStreamPersister>;
+
+  auto storage = storage_t::CreateMasterStorage();
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  static_cast<void>(http_server);
+  const auto base_url = current::strings::Printf("http://localhost:%d", port);
+
+  auto rest = RESTfulStorage<storage_t, current::storage::rest::Simple>(*storage, port, "/api", "http://c5t");
+
+  cqs::CQSQueryCacheParams params;
+  params.max_entries = 2u;
+  params.fields = {"user"};
+  rest.template AddCQSQuery<CQSQuery>("list", params);
+
+  try {
+    cqs::CQSQueryCacheParams bad_params;
+    bad_params.fields = {"no_such_field"};
+    rest.template AddCQSQuery<CQSQuery>("bad", bad_params);
+    ASSERT_TRUE(false);
+  } catch (const current::Exception& e) {
+    EXPECT_EQ("RESTfulStorage::AddCQSQuery(), no field `no_such_field` to cache by.", e.OriginalDescription());
+  }
+
+  const auto query = [&](const std::string& params) {
+    const auto response = HTTP(GET(base_url + "/api/cqs/query/list" + params));
+    EXPECT_EQ(200, static_cast<int>(response.code));
+    return response.body;
+  };
+  const auto stats = [&]() {
+    const auto s = rest.CQSQueryCacheStats("list");
+    return current::strings::Printf("hits=%d misses=%d invalidated=%d evicted=%d entries=%d",
+                                    static_cast<int>(s.hits),
+                                    static_cast<int>(s.misses),
+                                    static_cast<int>(s.invalidated),
+                                    static_cast<int>(s.evicted),
+                                    static_cast<int>(s.entries));
+  };
+
+  EXPECT_EQ(201, static_cast<int>(HTTP(POST(base_url + "/api/data/user", SimpleUser("dima", "DK"))).code));
+
+  EXPECT_EQ("http://c5t = DK", query(""));
+  EXPECT_EQ("http://c5t = DK", query(""));
+  EXPECT_EQ("hits=1 misses=1 invalidated=0 evicted=0 entries=1", stats());
+
+  // The URL parameters are the part of the key.
+  EXPECT_EQ("http://c5t = DK", query("?reverse_sort=true"));
+  EXPECT_EQ("hits=1 misses=2 invalidated=0 evicted=0 entries=2", stats());
+
+  // Modifying the field the query reads invalidates the cache.
+  EXPECT_EQ(201, static_cast<int>(HTTP(POST(base_url + "/api/data/user", SimpleUser("max", "MZ"))).code));
+  EXPECT_EQ("http://c5t = DK,MZ", query(""));
+  EXPECT_EQ("hits=1 misses=3 invalidated=2 evicted=0 entries=1", stats());
+
+  // Modifying other fields does not.
+  EXPECT_EQ(201, static_cast<int>(HTTP(PUT(base_url + "/api/data/like/dima/beer", SimpleLike("dima", "beer"))).code));
+  EXPECT_EQ("http://c5t = DK,MZ", query(""));
+  EXPECT_EQ("hits=2 misses=3 invalidated=2 evicted=0 entries=1", stats());
+
+  // The least recently used results are evicted once there are more than `max_entries` of them.
+  EXPECT_EQ("http://c5t = MZ,DK", query("?reverse_sort=true"));
+  EXPECT_EQ("http://c5t = DK,MZ", query("?reverse_sort=false"));
+  EXPECT_EQ("hits=2 misses=5 invalidated=2 evicted=1 entries=2", stats());
+  EXPECT_EQ("http://c5t = MZ,DK", query("?reverse_sort=true"));
+  EXPECT_EQ("hits=3 misses=5 invalidated=2 evicted=1 entries=2", stats());
+
+  // The errors are not cached.
+  EXPECT_EQ(500, static_cast<int>(HTTP(GET(base_url + "/api/cqs/query/list?test_native_exception")).code));
+  EXPECT_EQ(500, static_cast<int>(HTTP(GET(base_url + "/api/cqs/query/list?test_native_exception")).code));
+  EXPECT_EQ("hits=3 misses=7 invalidated=2 evicted=1 entries=2", stats());
+}
+
+TEST(TransactionalStorage, ShardedStorage) {
+  current::time::ResetToZero();
+
+  using namespace transactional_storage_test;
+  using namespace current::storage::rest;
+  using storage_t = SimpleStorage<StreamInMemoryStreamPersister>;
+
+  current::storage::ShardedStorage<storage_t> storage(4u, [](size_t) { return storage_t::CreateMasterStorage(); });
+  EXPECT_EQ(4u, storage.ShardsCount());
+
+  std::vector<std::string> keys;
+  for (int i = 0; i < 20; ++i) {
+    keys.push_back("user" + current::ToString(i));
+    storage.ReadWriteTransaction(keys.back(), [&keys](MutableFields<storage_t> fields) {
+      fields.user.Add(SimpleUser(keys.back(), "U"));
+    }).Wait();
+  }
+
+  // Each shard holds exactly the keys routed to it.
+  std::vector<size_t> expected_sizes(4u);
+  for (const std::string& key : keys) {
+    const size_t shard = storage.ShardOf(key);
+    ++expected_sizes[shard];
+    EXPECT_TRUE(Value(storage.Shard(shard).ReadOnlyTransaction([&key](ImmutableFields<storage_t> fields) {
+                                                return Exists(fields.user[key]);
+                                              }).Go()));
+    EXPECT_TRUE(Value(storage.ReadOnlyTransaction(key, [&key](ImmutableFields<storage_t> fields) {
+                                  return Exists(fields.user[key]);
+                                }).Go()));
+  }
+  const std::vector<size_t> sizes = storage.ReadOnlyTransactionOnAllShards(
+      [](ImmutableFields<storage_t> fields) -> size_t { return fields.user.Size(); });
+  EXPECT_EQ(current::strings::Join(expected_sizes, ','), current::strings::Join(sizes, ','));
+  EXPECT_EQ(20u, std::accumulate(sizes.begin(), sizes.end(), size_t(0)));
+
+  // The rows of the matrices are whole within their shards.
+  EXPECT_EQ(storage.ShardOf(std::string("dima")), storage.ShardOf(std::make_pair(std::string("dima"), 1)));
+
+  try {
+    current::storage::ShardedStorage<storage_t>(0u, [](size_t) { return storage_t::CreateMasterStorage(); });
+    ASSERT_TRUE(false);
+  } catch (const current::storage::ShardedStorageInvalidNumberOfShardsException&) {
+  }
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  static_cast<void>(http_server);
+  const auto base_url = current::strings::Printf("http://localhost:%d", port);
+
+  const auto rest =
+      ShardedRESTfulStorage<storage_t, current::storage::rest::Simple>(storage, port, "/api", base_url + "/api");
+
+  const std::string shard_of_dima = "/shard/" + current::ToString(storage.ShardOf(std::string("dima")));
+  {
+    const auto response =
+        HTTP(PUT(base_url + "/api/data/user/dima?foo=bar", SimpleUser("dima", "DK")).AllowRedirects());
+    EXPECT_EQ(201, static_cast<int>(response.code));
+    EXPECT_EQ(base_url + "/api" + shard_of_dima + "/data/user/dima?foo=bar", response.url);
+  }
+  EXPECT_EQ(200, static_cast<int>(HTTP(GET(base_url + "/api" + shard_of_dima + "/data/user/dima")).code));
+  EXPECT_EQ(base_url + "/api" + shard_of_dima + "/data/like/dima/beer",
+            HTTP(GET(base_url + "/api/data/like/dima/beer").AllowRedirects()).url);
+  EXPECT_EQ(base_url + "/api" + shard_of_dima + "/data/like.row/dima",
+            HTTP(GET(base_url + "/api/data/like.row/dima").AllowRedirects()).url);
+  EXPECT_EQ(400, static_cast<int>(HTTP(GET(base_url + "/api/data/like.col/beer")).code));
+  EXPECT_EQ(400, static_cast<int>(HTTP(GET(base_url + "/api/data/user")).code));
+}
+
+TEST(TransactionalStorage, RESTfulReplica) {
+  current::time::ResetToZero();
+
+  using namespace transactional_storage_test;
+  using namespace current::storage::rest;
+  using storage_t = SimpleStorage<StreamInMemoryStreamPersister>;
+
+  auto master_storage = storage_t::CreateMasterStorage();
+  auto stream = master_storage->BorrowUnderlyingStream();
+  auto storage = storage_t::CreateFollowingStorageAtopExistingStream(stream);
+
+  auto reserved_master_port = current::net::ReserveLocalPort();
+  const int master_port = reserved_master_port;
+  auto& master_http_server = HTTP(std::move(reserved_master_port));
+  static_cast<void>(master_http_server);
+  const auto master_url = current::strings::Printf("http://localhost:%d", master_port);
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  static_cast<void>(http_server);
+  const auto base_url = current::strings::Printf("http://localhost:%d", port);
+
+  const auto master_rest = RESTfulStorage<storage_t>(
+      *master_storage, master_port, "/api", "", RESTfulReplicaParams("", std::chrono::milliseconds(10)));
+  const auto rest = RESTfulStorage<storage_t>(
+      *storage, port, "/api", "", RESTfulReplicaParams(master_url, std::chrono::milliseconds(100)));
+  const auto lone_rest = RESTfulStorage<storage_t>(
+      *storage, port, "/lone", "", RESTfulReplicaParams("", std::chrono::milliseconds(10)));
+
+  // The mutations are redirected to the master, which responds with the index it is at right after them.
+  uint64_t index;
+  {
+    const auto response =
+        HTTP(PUT(base_url + "/api/data/user/dima?foo=bar", SimpleUser("dima", "DK")).AllowRedirects());
+    EXPECT_EQ(201, static_cast<int>(response.code));
+    EXPECT_EQ(master_url + "/api/data/user/dima?foo=bar", response.url);
+    ASSERT_TRUE(response.headers.Has(kRESTfulStorageIndexHeader));
+    index = current::FromString<uint64_t>(response.headers.Get(kRESTfulStorageIndexHeader));
+    EXPECT_EQ(1u, index);
+  }
+  EXPECT_EQ(master_url + "/api/batch", HTTP(POST(base_url + "/api/batch", "").AllowRedirects()).url);
+  EXPECT_EQ(405, static_cast<int>(HTTP(PUT(base_url + "/lone/data/user/dima", SimpleUser("dima", "DK"))).code));
+
+  // The reads asking for the index the follower is at are served by the follower, once it gets there.
+  {
+    const auto response = HTTP(GET(base_url + "/api/data/user/dima?min_index=" + current::ToString(index)));
+    EXPECT_EQ(200, static_cast<int>(response.code));
+    EXPECT_EQ("DK", ParseJSON<SimpleUser>(response.body).name);
+    EXPECT_EQ(current::ToString(index), response.headers.Get(kRESTfulStorageIndexHeader));
+  }
+  {
+    const auto response = HTTP(GET(base_url + "/lone/data/user/dima").SetHeader(kRESTfulMinIndexHeader, "1"));
+    EXPECT_EQ(200, static_cast<int>(response.code));
+  }
+
+  // And those asking for the index the follower is not at in time are redirected to the master, if it is known.
+  {
+    const auto response = HTTP(GET(base_url + "/api/data/user/dima?min_index=100").AllowRedirects());
+    EXPECT_EQ(503, static_cast<int>(response.code));
+    EXPECT_EQ(master_url + "/api/data/user/dima?min_index=100", response.url);
+  }
+  {
+    const auto response = HTTP(GET(base_url + "/lone/data/user/dima?min_index=100"));
+    EXPECT_EQ(503, static_cast<int>(response.code));
+    EXPECT_EQ("StorageIsBehind", Value(ParseJSON<generic::RESTGenericResponse>(response.body).error).name);
+  }
+}
+
 #ifdef CURRENT_STORAGE_PATCH_SUPPORT
 
 namespace transactional_storage_test {
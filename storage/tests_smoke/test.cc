@@ -1327,6 +1327,8 @@ TEST(TransactionalStorage, LastModifiedInDictionaryContainer) {
                               fields.d.Add(Record{"x", 100});
                               fields.d.Erase("y");
                               fields.d.Add(Record{"z", 3});
+                              // Rolling back re-adding the erased key restores the time it was erased at.
+                              fields.d.Add(Record{"y", 4});
                               CURRENT_STORAGE_THROW_ROLLBACK();
                             })
                             .Go();
@@ -1347,6 +1349,7 @@ TEST(TransactionalStorage, LastModifiedInDictionaryContainer) {
                                 ASSERT_TRUE(Exists(t));
                                 EXPECT_EQ(103, Value(t).count());
                               }
+                              EXPECT_FALSE(fields.d.Has("y"));
                               EXPECT_FALSE(Exists(fields.d.LastModified("z")));
                               current::time::SetNow(std::chrono::microseconds(301));
                               fields.d.Erase("x");
@@ -1611,6 +1614,66 @@ TEST(TransactionalStorage, LastModifiedInMatrixContainers) {
   }
 }
 
+TEST(TransactionalStorage, MatrixEntriesOverwrittenInPlace) {
+  using namespace transactional_storage_test;
+  using storage_t = TestStorage<StreamInMemoryStreamPersister>;
+
+  current::Owned<storage_t> storage = storage_t::CreateMasterStorage();
+
+  // The entries live in the maps of their rows, the columns and the whole matrix see them overwritten.
+  EXPECT_TRUE(WasCommitted(storage
+                               ->ReadWriteTransaction([](MutableFields<storage_t> fields) {
+                                 fields.umany_to_umany.Add(Cell(1, "x", 1));
+                                 fields.umany_to_umany.Add(Cell(2, "x", 2));
+                                 fields.umany_to_umany.Add(Cell(1, "x", 10));
+                                 fields.omany_to_omany.Add(Cell(1, "x", 1));
+                                 fields.omany_to_omany.Add(Cell(1, "x", 10));
+                                 fields.uone_to_umany.Add(Cell(1, "x", 1));
+                                 fields.uone_to_umany.Add(Cell(1, "x", 10));
+                               })
+                               .Go()));
+  EXPECT_TRUE(WasCommitted(storage
+                               ->ReadOnlyTransaction([](ImmutableFields<storage_t> fields) {
+                                 EXPECT_EQ(10, Value(fields.umany_to_umany.Get(1, "x")).phew);
+                                 int32_t col_sum = 0;
+                                 for (const auto& cell : fields.umany_to_umany.Col("x")) {
+                                   col_sum += cell.phew;
+                                 }
+                                 EXPECT_EQ(12, col_sum);
+                                 int32_t whole_matrix_sum = 0;
+                                 for (const auto& cell : fields.umany_to_umany) {
+                                   whole_matrix_sum += cell.phew;
+                                 }
+                                 EXPECT_EQ(12, whole_matrix_sum);
+                                 EXPECT_EQ(10, (*fields.omany_to_omany.Col("x").begin()).phew);
+                                 EXPECT_EQ(10, Value(fields.uone_to_umany.GetEntryFromCol("x")).phew);
+                                 EXPECT_EQ(10, (*fields.uone_to_umany.begin()).phew);
+                               })
+                               .Go()));
+
+  // A rolled back overwrite restores the entries the other maps point to.
+  EXPECT_FALSE(WasCommitted(storage
+                                ->ReadWriteTransaction([](MutableFields<storage_t> fields) {
+                                  fields.umany_to_umany.Add(Cell(1, "x", 100));
+                                  fields.uone_to_umany.Add(Cell(2, "x", 200));
+                                  CURRENT_STORAGE_THROW_ROLLBACK();
+                                })
+                                .Go()));
+  EXPECT_TRUE(WasCommitted(storage
+                               ->ReadOnlyTransaction([](ImmutableFields<storage_t> fields) {
+                                 int32_t col_sum = 0;
+                                 for (const auto& cell : fields.umany_to_umany.Col("x")) {
+                                   col_sum += cell.phew;
+                                 }
+                                 EXPECT_EQ(12, col_sum);
+                                 EXPECT_EQ(10, Value(fields.umany_to_umany.Get(1, "x")).phew);
+                                 EXPECT_EQ(10, Value(fields.uone_to_umany.GetEntryFromCol("x")).phew);
+                                 EXPECT_EQ(1u, fields.uone_to_umany.Rows().Size());
+                                 EXPECT_EQ(10, (*fields.uone_to_umany.Row(1).begin()).phew);
+                               })
+                               .Go()));
+}
+
 TEST(TransactionalStorage, WaitUntilLocalLogIsReplayed) {
   current::time::ResetToZero();
 
@@ -1676,6 +1739,53 @@ TEST(TransactionalStorage, WaitUntilLocalLogIsReplayed) {
   }
 }
 
+TEST(TransactionalStorage, FollowerReplicationLag) {
+  current::time::ResetToZero();
+
+  using namespace transactional_storage_test;
+  using storage_t = TestStorage<StreamStreamPersister>;
+  using stream_t = typename storage_t::stream_t;
+
+  const std::string storage_file_name =
+      current::FileSystem::JoinPath(FLAGS_transactional_storage_test_tmpdir, "storage_replication_lag");
+  const auto storage_file_remover = current::FileSystem::ScopedRmFile(storage_file_name);
+  {
+    current::Owned<storage_t> master_storage = storage_t::CreateMasterStorage(storage_file_name);
+    for (int i = 0; i < 5000; ++i) {
+      master_storage
+          ->ReadWriteTransaction([i](MutableFields<storage_t> fields) { fields.d.Add(Record{current::ToString(i), i}); })
+          .Go();
+    }
+    EXPECT_EQ(0u, master_storage->ReplicationLag().entries);
+  }
+
+  auto owned_stream(stream_t::CreateStream(storage_file_name));
+  current::Borrowed<stream_t::publisher_t> stream_publisher_owner = owned_stream->BecomeFollowingStream();
+  current::Owned<storage_t> storage = storage_t::CreateFollowingStorageAtopExistingStream(owned_stream);
+
+  // The read-only transactions go through while the following storage is catching up, and see it progress.
+  size_t previous_size = 0u;
+  while (previous_size < 5000u) {
+    const size_t size =
+        Value(storage->ReadOnlyTransaction([](ImmutableFields<storage_t> fields) { return fields.d.Size(); }).Go());
+    EXPECT_GE(size, previous_size);
+    previous_size = size;
+  }
+  while (storage->ReplicationLag().entries) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(0, storage->ReplicationLag().us.count());
+
+  current::metrics::Registry registry;
+  const auto scope = storage->PublishMetrics("follower", registry);
+  const current::metrics::MetricsSnapshot snapshot = registry.Snapshot();
+  ASSERT_EQ(2u, snapshot.metrics.size());
+  EXPECT_EQ("storage_replication_lag_entries", snapshot.metrics[0].name);
+  EXPECT_EQ("follower", snapshot.metrics[0].labels.at("storage"));
+  EXPECT_EQ(0.0, snapshot.metrics[0].value);
+  EXPECT_EQ("storage_replication_lag_seconds", snapshot.metrics[1].name);
+}
+
 TEST(TransactionalStorage, WorkWithUnderlyingStream) {
   current::time::ResetToZero();
 
@@ -1730,4 +1840,1050 @@ TEST(TransactionalStorage, GracefulShutdown) {
   ASSERT_THROW(result.Go(), current::storage::StorageInGracefulShutdownException);
 }
 
+TEST(TransactionalStorage, ConcurrentReadOnlyTransactions) {
+  current::time::ResetToZero();
+
+  using namespace transactional_storage_test;
+  using storage_t = TestStorage<StreamStreamPersister, current::storage::transaction_policy::ConcurrentReadOnly>;
+
+  const std::string persistence_file_name =
+      current::FileSystem::JoinPath(FLAGS_transactional_storage_test_tmpdir, "concurrent_read_only_data");
+  const auto persistence_file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+  constexpr int32_t kTransactions = 500;
+
+  {
+    auto storage = storage_t::CreateMasterStorage(persistence_file_name);
+
+    // Two read-only transactions run at the same time, as each of them waits for the other one to start.
+    {
+      std::promise<void> first_started;
+      std::promise<void> second_started;
+      std::future<void> first_started_future = first_started.get_future();
+      std::future<void> second_started_future = second_started.get_future();
+      std::thread first([&]() {
+        const auto result = storage
+                                ->ReadOnlyTransaction([&](ImmutableFields<storage_t>) {
+                                  first_started.set_value();
+                                  return second_started_future.wait_for(std::chrono::seconds(10)) ==
+                                         std::future_status::ready;
+                                })
+                                .Go();
+        EXPECT_TRUE(Value(result));
+      });
+      const auto result = storage
+                              ->ReadOnlyTransaction([&](ImmutableFields<storage_t>) {
+                                second_started.set_value();
+                                return first_started_future.wait_for(std::chrono::seconds(10)) ==
+                                       std::future_status::ready;
+                              })
+                              .Go();
+      EXPECT_TRUE(Value(result));
+      first.join();
+    }
+
+    // The read-only transactions only ever see the fields as of some committed read-write transaction.
+    std::atomic_bool done(false);
+    std::atomic_bool consistent(true);
+    std::vector<std::thread> readers;
+    for (size_t i = 0u; i < 2u; ++i) {
+      readers.emplace_back([&]() {
+        while (!done) {
+          const bool ok = Value(storage
+                                    ->ReadOnlyTransaction([](ImmutableFields<storage_t> fields) {
+                                      const int32_t n = static_cast<int32_t>(fields.d.Size() / 2u);
+                                      return fields.d.Size() % 2u == 0u &&
+                                             (n == 0 || (Exists(fields.d["a" + current::ToString(n - 1)]) &&
+                                                         Exists(fields.d["b" + current::ToString(n - 1)])));
+                                    })
+                                    .Go());
+          if (!ok) {
+            consistent = false;
+          }
+        }
+      });
+    }
+    for (int32_t i = 0; i < kTransactions; ++i) {
+      storage
+          ->ReadWriteTransaction([i](MutableFields<storage_t> fields) {
+            fields.d.Add(Record{"a" + current::ToString(i), i});
+            fields.d.Add(Record{"b" + current::ToString(i), i});
+          })
+          .Go();
+    }
+    const auto rolled_back = storage
+                                 ->ReadWriteTransaction([](MutableFields<storage_t> fields) {
+                                   fields.d.Add(Record{"c", 0});
+                                   CURRENT_STORAGE_THROW_ROLLBACK();
+                                 })
+                                 .Go();
+    EXPECT_FALSE(WasCommitted(rolled_back));
+    done = true;
+    for (std::thread& reader : readers) {
+      reader.join();
+    }
+    EXPECT_TRUE(consistent);
+  }
+
+  // The read-write transactions are persisted as usual, and replayed into the fields when the storage is restored.
+  {
+    auto storage = storage_t::CreateMasterStorage(persistence_file_name);
+    const auto result = storage
+                            ->ReadOnlyTransaction([](ImmutableFields<storage_t> fields) {
+                              EXPECT_EQ(2u * kTransactions, fields.d.Size());
+                              EXPECT_FALSE(Exists(fields.d["c"]));
+                              ASSERT_TRUE(Exists(fields.d["b499"]));
+                              EXPECT_EQ(499, Value(fields.d["b499"]).rhs);
+                            })
+                            .Go();
+    EXPECT_TRUE(WasCommitted(result));
+  }
+}
+
+TEST(TransactionalStorage, GroupCommitTransactions) {
+  current::time::ResetToZero();
+
+  using namespace transactional_storage_test;
+  using storage_t = TestStorage<StreamStreamPersister, current::storage::transaction_policy::GroupCommit>;
+
+  const std::string persistence_file_name =
+      current::FileSystem::JoinPath(FLAGS_transactional_storage_test_tmpdir, "group_commit_data");
+  const auto persistence_file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+  constexpr int32_t kThreads = 4;
+  constexpr int32_t kTransactionsPerThread = 100;
+
+  {
+    // The file persister would only sync on its own every ten seconds, so the transactions are made durable by the
+    // transaction policy alone.
+    auto storage = storage_t::CreateMasterStorage(
+        persistence_file_name, current::persistence::FileDurability::GroupCommit(std::chrono::seconds(10)));
+
+    // Once the future of a read-write transaction is resolved, the transaction is on disk.
+    {
+      const auto result =
+          storage->ReadWriteTransaction([](MutableFields<storage_t> fields) { fields.d.Add(Record{"first", 1}); })
+              .Go();
+      EXPECT_TRUE(WasCommitted(result));
+      EXPECT_NE(std::string::npos, current::FileSystem::ReadFileAsString(persistence_file_name).find("\"first\""));
+    }
+
+    // The futures of the concurrent read-write transactions are resolved one by one, with their own results.
+    std::atomic_bool correct(true);
+    std::vector<std::thread> writers;
+    for (int32_t t = 0; t < kThreads; ++t) {
+      writers.emplace_back([&, t]() {
+        for (int32_t i = 0; i < kTransactionsPerThread; ++i) {
+          const int32_t value = t * kTransactionsPerThread + i;
+          const auto result = storage
+                                  ->ReadWriteTransaction([value](MutableFields<storage_t> fields) {
+                                    fields.d.Add(Record{"x" + current::ToString(value), value});
+                                    return value;
+                                  })
+                                  .Go();
+          if (!WasCommitted(result) || Value(result) != value) {
+            correct = false;
+          }
+        }
+      });
+    }
+    for (std::thread& writer : writers) {
+      writer.join();
+    }
+    EXPECT_TRUE(correct);
+
+    // The rolled back read-write transactions, and the two-step ones, resolve their futures as usual.
+    const auto rolled_back = storage
+                                 ->ReadWriteTransaction([](MutableFields<storage_t> fields) -> int {
+                                   fields.d.Add(Record{"rolled_back", 0});
+                                   CURRENT_STORAGE_THROW_ROLLBACK_WITH_VALUE(int, 42);
+                                 })
+                                 .Go();
+    EXPECT_FALSE(WasCommitted(rolled_back));
+    EXPECT_EQ(42, Value(rolled_back));
+    int32_t two_step_result = 0;
+    const auto two_step = storage
+                              ->ReadWriteTransaction(
+                                  [](MutableFields<storage_t> fields) {
+                                    fields.d.Add(Record{"last", 2});
+                                    return static_cast<int32_t>(fields.d.Size());
+                                  },
+                                  [&two_step_result](int32_t size) { two_step_result = size; })
+                              .Go();
+    EXPECT_TRUE(WasCommitted(two_step));
+    EXPECT_EQ(kThreads * kTransactionsPerThread + 2, two_step_result);
+    EXPECT_NE(std::string::npos, current::FileSystem::ReadFileAsString(persistence_file_name).find("\"last\""));
+  }
+
+  // The read-write transactions are replayed into the fields when the storage is restored.
+  {
+    auto storage = storage_t::CreateMasterStorage(persistence_file_name);
+    const auto result = storage
+                            ->ReadOnlyTransaction([](ImmutableFields<storage_t> fields) {
+                              EXPECT_EQ(static_cast<size_t>(kThreads * kTransactionsPerThread + 2), fields.d.Size());
+                              EXPECT_FALSE(Exists(fields.d["rolled_back"]));
+                              ASSERT_TRUE(Exists(fields.d["x399"]));
+                              EXPECT_EQ(399, Value(fields.d["x399"]).rhs);
+                            })
+                            .Go();
+    EXPECT_TRUE(WasCommitted(result));
+  }
+
+  // With the in-memory persister there is nothing to sync, and the futures are resolved right away.
+  {
+    using in_memory_storage_t =
+        TestStorage<StreamInMemoryStreamPersister, current::storage::transaction_policy::GroupCommit>;
+    auto storage = in_memory_storage_t::CreateMasterStorage();
+    const auto result = storage
+                            ->ReadWriteTransaction([](MutableFields<in_memory_storage_t> fields) {
+                              fields.d.Add(Record{"one", 1});
+                              return 1;
+                            })
+                            .Go();
+    EXPECT_TRUE(WasCommitted(result));
+    EXPECT_EQ(1, Value(result));
+  }
+}
+
+
+namespace transactional_storage_test {
+
+CURRENT_STRUCT(IndexedUser) {
+  CURRENT_FIELD(name, std::string);
+  CURRENT_FIELD(country, std::string);
+  CURRENT_FIELD(email, std::string);
+
+  CURRENT_USE_FIELD_AS_KEY(name);
+
+  CURRENT_CONSTRUCTOR(IndexedUser)
+  (const std::string& name = "", const std::string& country = "", const std::string& email = "")
+      : name(name), country(country), email(email) {}
+};
+
+CURRENT_STORAGE_FIELD_ENTRY(OrderedDictionary, IndexedUser, IndexedUserDictionary);
+CURRENT_STORAGE_INDEX(IndexedUserByCountry, IndexedUser, country, OrderedNonUnique);
+CURRENT_STORAGE_INDEX(IndexedUserByEmail, IndexedUser, email, UnorderedUnique);
+CURRENT_STORAGE_FIELD_INDEXES(IndexedUserDictionary, IndexedUserByCountry, IndexedUserByEmail);
+
+CURRENT_STORAGE(IndexedStorage) { CURRENT_STORAGE_FIELD(users, IndexedUserDictionary); };
+
+}  // namespace transactional_storage_test
+
+TEST(TransactionalStorage, DictionarySecondaryIndexes) {
+  current::time::ResetToZero();
+
+  using namespace transactional_storage_test;
+  using storage_t = IndexedStorage<StreamStreamPersister>;
+
+  const std::string persistence_file_name =
+      current::FileSystem::JoinPath(FLAGS_transactional_storage_test_tmpdir, "secondary_indexes_data");
+  const auto persistence_file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+
+  const auto names_from = [](ImmutableFields<storage_t> fields, const std::string& country) {
+    std::vector<std::string> names;
+    for (const IndexedUser& user : fields.users.Index<IndexedUserByCountry>()[country]) {
+      names.push_back(user.name);
+    }
+    return current::strings::Join(names, ',');
+  };
+
+  {
+    auto storage = storage_t::CreateMasterStorage(persistence_file_name);
+
+    EXPECT_TRUE(WasCommitted(storage
+                                 ->ReadWriteTransaction([](MutableFields<storage_t> fields) {
+                                   fields.users.Add(IndexedUser("carol", "us", "carol@example.com"));
+                                   fields.users.Add(IndexedUser("alice", "us", "alice@example.com"));
+                                   fields.users.Add(IndexedUser("bob", "uk", "bob@example.com"));
+                                   fields.users.Add(IndexedUser("dave", "fr", "dave@example.com"));
+                                 })
+                                 .Go()));
+
+    // Updating and erasing the entries updates the indexes.
+    EXPECT_TRUE(WasCommitted(storage
+                                 ->ReadWriteTransaction([](MutableFields<storage_t> fields) {
+                                   fields.users.Add(IndexedUser("bob", "us", "bob@example.org"));
+                                   fields.users.Erase("dave");
+                                 })
+                                 .Go()));
+
+    // A rolled back transaction leaves the indexes as they were.
+    EXPECT_FALSE(WasCommitted(storage
+                                  ->ReadWriteTransaction([](MutableFields<storage_t> fields) {
+                                    fields.users.Add(IndexedUser("eve", "uk", "eve@example.com"));
+                                    fields.users.Add(IndexedUser("alice", "uk", "alice@example.org"));
+                                    fields.users.Erase("carol");
+                                    CURRENT_STORAGE_THROW_ROLLBACK();
+                                  })
+                                  .Go()));
+
+    // Adding an entry with the value of a unique index another entry has fails, and rolls back the transaction.
+    EXPECT_THROW(storage
+                     ->ReadWriteTransaction([](MutableFields<storage_t> fields) {
+                       fields.users.Add(IndexedUser("frank", "fr", "frank@example.com"));
+                       fields.users.Add(IndexedUser("mallory", "uk", "alice@example.com"));
+                     })
+                     .Go(),
+                 current::storage::StorageUniqueIndexViolationException);
+
+    const auto result = storage
+                            ->ReadOnlyTransaction([&names_from](ImmutableFields<storage_t> fields) {
+                              EXPECT_EQ("alice,bob,carol", names_from(fields, "us"));
+                              EXPECT_EQ("", names_from(fields, "uk"));
+                              EXPECT_EQ("", names_from(fields, "fr"));
+                              EXPECT_EQ(3u, fields.users.Index<IndexedUserByCountry>()["us"].Size());
+                              EXPECT_FALSE(fields.users.Index<IndexedUserByCountry>().Has("uk"));
+                              EXPECT_EQ(3u, fields.users.Index<IndexedUserByCountry>().Size());
+
+                              const auto& by_email = fields.users.Index<IndexedUserByEmail>();
+                              EXPECT_EQ(3u, by_email.Size());
+                              ASSERT_TRUE(Exists(by_email["bob@example.org"]));
+                              EXPECT_EQ("bob", Value(by_email["bob@example.org"]).name);
+                              EXPECT_FALSE(Exists(by_email["bob@example.com"]));
+                              EXPECT_FALSE(Exists(by_email["frank@example.com"]));
+                              EXPECT_FALSE(Exists(fields.users["frank"]));
+
+                              // The ordered index iterates over the values in order.
+                              std::vector<std::string> all;
+                              const auto& by_country = fields.users.Index<IndexedUserByCountry>();
+                              for (auto it = by_country.begin(); it != by_country.end(); ++it) {
+                                all.push_back(it.value() + ':' + it->name);
+                              }
+                              EXPECT_EQ("us:alice,us:bob,us:carol", current::strings::Join(all, ','));
+                            })
+                            .Go();
+    EXPECT_TRUE(WasCommitted(result));
+  }
+
+  // The indexes are rebuilt as the stream is replayed.
+  {
+    auto storage = storage_t::CreateMasterStorage(persistence_file_name);
+    const auto result = storage
+                            ->ReadOnlyTransaction([&names_from](ImmutableFields<storage_t> fields) {
+                              EXPECT_EQ("alice,bob,carol", names_from(fields, "us"));
+                              EXPECT_EQ("", names_from(fields, "uk"));
+                              const auto& by_email = fields.users.Index<IndexedUserByEmail>();
+                              ASSERT_TRUE(Exists(by_email["carol@example.com"]));
+                              EXPECT_EQ("carol", Value(by_email["carol@example.com"]).name);
+                            })
+                            .Go();
+    EXPECT_TRUE(WasCommitted(result));
+  }
+}
+
+TEST(TransactionalStorage, FlatHashMap) {
+  using current::storage::container::FlatHashMap;
+
+  // Mirror pseudo-random insertions and erasures into `std::map`, with enough erasures to exercise the tombstones.
+  FlatHashMap<uint64_t, std::string> flat;
+  std::map<uint64_t, std::string> golden;
+  uint64_t state = 42u;
+  for (int i = 0; i < 20000; ++i) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    const uint64_t key = (state >> 33) % 1000u;
+    if ((state >> 20) % 3u) {
+      const auto result = flat.emplace(key, current::ToString(i));
+      EXPECT_EQ(golden.emplace(key, current::ToString(i)).second, result.second);
+      EXPECT_EQ(golden[key], result.first->second);
+    } else {
+      EXPECT_EQ(golden.erase(key), flat.erase(key));
+    }
+    ASSERT_EQ(golden.size(), flat.size());
+  }
+  std::map<uint64_t, std::string> contents(flat.begin(), flat.end());
+  EXPECT_TRUE(golden == contents);
+  for (uint64_t key = 0u; key < 1000u; ++key) {
+    EXPECT_EQ(golden.count(key), flat.count(key));
+  }
+
+  // Copies are deep, and erasing by iterator returns the next entry.
+  FlatHashMap<uint64_t, std::string> copy(flat);
+  flat[1000u] = "extra";
+  EXPECT_EQ(golden.size(), copy.size());
+  EXPECT_EQ(golden.size() + 1u, flat.size());
+  size_t erased = 0u;
+  for (auto it = copy.begin(); it != copy.end();) {
+    it = copy.erase(it);
+    ++erased;
+  }
+  EXPECT_EQ(golden.size(), erased);
+  EXPECT_TRUE(copy.empty());
+  EXPECT_TRUE(copy.find(golden.begin()->first) == copy.end());
+  EXPECT_EQ("extra", flat[1000u]);
+}
+
+namespace transactional_storage_test {
+
+CURRENT_STORAGE_FIELD_ENTRY(FlatUnorderedDictionary, IndexedUser, FlatUserDictionary);
+
+CURRENT_STORAGE(FlatStorage) { CURRENT_STORAGE_FIELD(users, FlatUserDictionary); };
+
+}  // namespace transactional_storage_test
+
+TEST(TransactionalStorage, FlatUnorderedDictionary) {
+  current::time::ResetToZero();
+
+  using namespace transactional_storage_test;
+  using storage_t = FlatStorage<StreamStreamPersister>;
+
+  const std::string persistence_file_name =
+      current::FileSystem::JoinPath(FLAGS_transactional_storage_test_tmpdir, "flat_dictionary_data");
+  const auto persistence_file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+
+  const auto names = [](ImmutableFields<storage_t> fields) {
+    std::set<std::string> result;
+    for (const IndexedUser& user : fields.users) {
+      result.insert(user.name);
+    }
+    return result.size() == fields.users.Size() ? current::strings::Join(result, ',') : "duplicates";
+  };
+
+  {
+    auto storage = storage_t::CreateMasterStorage(persistence_file_name);
+
+    // Enough entries for the map to grow a few times.
+    current::time::SetNow(std::chrono::microseconds(100));
+    EXPECT_TRUE(WasCommitted(storage
+                                 ->ReadWriteTransaction([](MutableFields<storage_t> fields) {
+                                   for (int i = 0; i < 1000; ++i) {
+                                     fields.users.Add(IndexedUser("user" + current::ToString(i), "us"));
+                                   }
+                                 })
+                                 .Go()));
+
+    current::time::SetNow(std::chrono::microseconds(200));
+    EXPECT_TRUE(WasCommitted(storage
+                                 ->ReadWriteTransaction([](MutableFields<storage_t> fields) {
+                                   for (int i = 3; i < 1000; ++i) {
+                                     fields.users.Erase("user" + current::ToString(i));
+                                   }
+                                   fields.users.Add(IndexedUser("user1", "uk"));
+                                 })
+                                 .Go()));
+
+    current::time::SetNow(std::chrono::microseconds(300));
+    EXPECT_FALSE(WasCommitted(storage
+                                  ->ReadWriteTransaction([](MutableFields<storage_t> fields) {
+                                    fields.users.Erase("user0");
+                                    fields.users.Add(IndexedUser("user1", "fr"));
+                                    for (int i = 1000; i < 2000; ++i) {
+                                      fields.users.Add(IndexedUser("user" + current::ToString(i), "fr"));
+                                    }
+                                    CURRENT_STORAGE_THROW_ROLLBACK();
+                                  })
+                                  .Go()));
+
+    EXPECT_TRUE(WasCommitted(storage
+                                 ->ReadOnlyTransaction([&names](ImmutableFields<storage_t> fields) {
+                                   EXPECT_EQ("user0,user1,user2", names(fields));
+                                   ASSERT_TRUE(Exists(fields.users["user1"]));
+                                   EXPECT_EQ("uk", Value(fields.users["user1"]).country);
+                                   EXPECT_FALSE(Exists(fields.users["user3"]));
+                                   EXPECT_EQ(200, Value(fields.users.LastModified("user1")).count());
+                                   EXPECT_EQ(100, Value(fields.users.LastModified("user2")).count());
+                                   EXPECT_EQ(200, Value(fields.users.LastModified("user3")).count());
+                                 })
+                                 .Go()));
+  }
+
+  // The flat dictionary is rebuilt as the stream is replayed.
+  {
+    auto storage = storage_t::CreateMasterStorage(persistence_file_name);
+    EXPECT_TRUE(WasCommitted(storage
+                                 ->ReadOnlyTransaction([&names](ImmutableFields<storage_t> fields) {
+                                   EXPECT_EQ("user0,user1,user2", names(fields));
+                                   EXPECT_EQ("uk", Value(fields.users["user1"]).country);
+                                 })
+                                 .Go()));
+  }
+}
+
+TEST(TransactionalStorage, Snapshots) {
+  current::time::ResetToZero();
+
+  using namespace transactional_storage_test;
+  using storage_t = TestStorage<StreamStreamPersister>;
+
+  const std::string persistence_file_name =
+      current::FileSystem::JoinPath(FLAGS_transactional_storage_test_tmpdir, "snapshots_data");
+  const auto persistence_file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+  const std::string snapshot_file_name =
+      current::FileSystem::JoinPath(FLAGS_transactional_storage_test_tmpdir, "snapshots_snapshot");
+  const auto snapshot_file_remover = current::FileSystem::ScopedRmFile(snapshot_file_name);
+
+  const auto dump = [](ImmutableFields<storage_t> fields) {
+    std::vector<std::string> result;
+    for (const Record& record : fields.d) {
+      result.push_back(JSON(record));
+    }
+    std::vector<std::string> cells;
+    for (const Cell& cell : fields.umany_to_umany) {
+      cells.push_back(JSON(cell));
+    }
+    for (const Cell& cell : fields.oone_to_oone) {
+      cells.push_back("1:1 " + JSON(cell));
+    }
+    std::sort(cells.begin(), cells.end());
+    result.insert(result.end(), cells.begin(), cells.end());
+    for (const char* key : {"one", "two", "three", "four"}) {
+      const auto us = fields.d.LastModified(key);
+      result.push_back(std::string(key) + '@' + (Exists(us) ? current::ToString(Value(us).count()) : "none"));
+    }
+    const auto us = fields.umany_to_umany.LastModified(2, "b");
+    result.push_back(std::string("2b@") + (Exists(us) ? current::ToString(Value(us).count()) : "none"));
+    return current::strings::Join(result, '\n');
+  };
+
+  const auto transaction = [](storage_t& storage, int64_t us, std::function<void(MutableFields<storage_t>)> f) {
+    current::time::SetNow(std::chrono::microseconds(us));
+    EXPECT_TRUE(WasCommitted(storage.ReadWriteTransaction(f).Go()));
+  };
+
+  std::string expected;
+  {
+    // Save a snapshot every three transactions.
+    auto storage =
+        storage_t::CreateMasterStorageWithSnapshots(StorageSnapshots(snapshot_file_name, 3u), persistence_file_name);
+    transaction(*storage, 100, [](MutableFields<storage_t> fields) {
+      fields.d.Add(Record("one", 1));
+      fields.d.Add(Record("two", 2));
+      fields.umany_to_umany.Add(Cell(1, "a", 1));
+      fields.umany_to_umany.Add(Cell(2, "b", 2));
+    });
+    transaction(*storage, 200, [](MutableFields<storage_t> fields) {
+      fields.d.Add(Record("three", 3));
+      fields.d.Erase("two");
+      fields.oone_to_oone.Add(Cell(1, "x", 11));
+    });
+    EXPECT_FALSE(std::ifstream(snapshot_file_name).good());
+    transaction(*storage, 300, [](MutableFields<storage_t> fields) {
+      fields.umany_to_umany.Erase(2, "b");
+      fields.oone_to_oone.Add(Cell(1, "y", 12));
+    });
+    EXPECT_TRUE(std::ifstream(snapshot_file_name).good());
+    transaction(*storage, 400, [](MutableFields<storage_t> fields) { fields.d.Add(Record("one", 100)); });
+    // A rolled back transaction is neither published nor counted.
+    current::time::SetNow(std::chrono::microseconds(450));
+    EXPECT_FALSE(WasCommitted(storage
+                                  ->ReadWriteTransaction([](MutableFields<storage_t> fields) {
+                                    fields.d.Add(Record("four", 4));
+                                    CURRENT_STORAGE_THROW_ROLLBACK();
+                                  })
+                                  .Go()));
+    transaction(*storage, 500, [](MutableFields<storage_t> fields) { fields.d.Add(Record("four", 4)); });
+    expected = Value(storage->ReadOnlyTransaction(dump).Go());
+    EXPECT_EQ(500, storage->LastAppliedTimestamp().count());
+  }
+
+  const auto snapshot = LoadFromBinary<current::storage::StorageSnapshot<storage_t::fields_variant_t>>(
+      current::FileSystem::ReadFileAsString(snapshot_file_name));
+  EXPECT_EQ(3u, snapshot.index);
+  EXPECT_EQ(300, snapshot.last_entry_us.count());
+  EXPECT_EQ(300, snapshot.last_applied_us.count());
+
+  // The state after the snapshot and the tail of the stream is the same as after replaying the whole stream.
+  {
+    auto storage = storage_t::CreateMasterStorageWithSnapshots(StorageSnapshots(snapshot_file_name),
+                                                               persistence_file_name);
+    EXPECT_EQ(expected, Value(storage->ReadOnlyTransaction(dump).Go()));
+    EXPECT_EQ(500, storage->LastAppliedTimestamp().count());
+  }
+  {
+    auto storage = storage_t::CreateMasterStorage(persistence_file_name);
+    EXPECT_EQ(expected, Value(storage->ReadOnlyTransaction(dump).Go()));
+    EXPECT_THROW(storage->SaveSnapshot(), current::storage::StorageSnapshotsNotEnabledException);
+  }
+
+  // Only the tail of the stream is replayed atop the snapshot: the entry added to it shows up.
+  {
+    auto tampered = snapshot;
+    tampered.mutations.emplace_back(RecordDictionaryUpdated(std::chrono::microseconds(300), Record("snapshot", 42)));
+    current::FileSystem::WriteStringToFile(SaveIntoBinary(tampered), snapshot_file_name.c_str());
+    auto storage = storage_t::CreateMasterStorageWithSnapshots(StorageSnapshots(snapshot_file_name),
+                                                               persistence_file_name);
+    EXPECT_TRUE(Value(storage->ReadOnlyTransaction([](ImmutableFields<storage_t> fields) {
+                        return Exists(fields.d["snapshot"]) && Value(fields.d["one"]).rhs == 100;
+                      }).Go()));
+    // A transaction after the snapshot of the restarted storage, and a snapshot saved explicitly.
+    transaction(*storage, 600, [](MutableFields<storage_t> fields) { fields.d.Erase("snapshot"); });
+    EXPECT_EQ(6u, storage->SaveSnapshot());
+    expected = Value(storage->ReadOnlyTransaction(dump).Go());
+  }
+  {
+    auto storage = storage_t::CreateFollowingStorageWithSnapshots(StorageSnapshots(snapshot_file_name),
+                                                                  persistence_file_name);
+    EXPECT_EQ(600, storage->LastAppliedTimestamp().count());
+    EXPECT_EQ(expected, Value(storage->ReadOnlyTransaction(dump).Go()));
+    storage->FlipToMaster();
+    transaction(*storage, 700, [](MutableFields<storage_t> fields) { fields.d.Erase("one"); });
+    expected = Value(storage->ReadOnlyTransaction(dump).Go());
+  }
+
+  // A snapshot which is corrupted, or does not match the stream, is ignored.
+  for (const std::string& contents : {std::string("garbage"), std::string()}) {
+    current::FileSystem::WriteStringToFile(contents, snapshot_file_name.c_str());
+    auto storage = storage_t::CreateMasterStorageWithSnapshots(StorageSnapshots(snapshot_file_name),
+                                                               persistence_file_name);
+    EXPECT_EQ(expected, Value(storage->ReadOnlyTransaction(dump).Go()));
+  }
+  {
+    auto mismatching = snapshot;
+    mismatching.last_entry_us = std::chrono::microseconds(250);
+    current::FileSystem::WriteStringToFile(SaveIntoBinary(mismatching), snapshot_file_name.c_str());
+    auto storage = storage_t::CreateMasterStorageWithSnapshots(StorageSnapshots(snapshot_file_name),
+                                                               persistence_file_name);
+    EXPECT_EQ(expected, Value(storage->ReadOnlyTransaction(dump).Go()));
+  }
+  {
+    const std::string other_persistence_file_name =
+        current::FileSystem::JoinPath(FLAGS_transactional_storage_test_tmpdir, "snapshots_other_data");
+    const auto other_persistence_file_remover = current::FileSystem::ScopedRmFile(other_persistence_file_name);
+    current::FileSystem::WriteStringToFile(SaveIntoBinary(snapshot), snapshot_file_name.c_str());
+    auto storage = storage_t::CreateMasterStorageWithSnapshots(StorageSnapshots(snapshot_file_name),
+                                                               other_persistence_file_name);
+    EXPECT_TRUE(Value(storage->ReadOnlyTransaction([](ImmutableFields<storage_t> fields) {
+                        return fields.d.Empty() && fields.umany_to_umany.Empty();
+                      }).Go()));
+  }
+}
+
+#ifndef CURRENT_WINDOWS
+TEST(TransactionalStorage, BackgroundSnapshots) {
+  current::time::ResetToZero();
+
+  using namespace transactional_storage_test;
+  using storage_t = TestStorage<StreamStreamPersister>;
+  using snapshot_t = current::storage::StorageSnapshot<storage_t::fields_variant_t>;
+
+  const std::string persistence_file_name =
+      current::FileSystem::JoinPath(FLAGS_transactional_storage_test_tmpdir, "background_snapshots_data");
+  const auto persistence_file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+  const std::string snapshot_file_name =
+      current::FileSystem::JoinPath(FLAGS_transactional_storage_test_tmpdir, "background_snapshots_snapshot");
+  const auto snapshot_file_remover = current::FileSystem::ScopedRmFile(snapshot_file_name);
+
+  const auto add = [](storage_t& storage, int i) {
+    current::time::SetNow(std::chrono::microseconds(i * 100));
+    EXPECT_TRUE(WasCommitted(
+        storage.ReadWriteTransaction([i](MutableFields<storage_t> fields) { fields.d.Add(Record("x", i)); }).Go()));
+  };
+
+  {
+    auto storage = storage_t::CreateMasterStorageWithSnapshots(StorageSnapshots(snapshot_file_name),
+                                                               persistence_file_name);
+    EXPECT_FALSE(storage->WaitForBackgroundSnapshot());
+    add(*storage, 1);
+    add(*storage, 2);
+    ASSERT_TRUE(storage->SaveSnapshotInBackground());
+    // The transactions carry on while the snapshot is being saved, and do not make it into the snapshot.
+    add(*storage, 3);
+    EXPECT_TRUE(storage->WaitForBackgroundSnapshot());
+    const auto snapshot = LoadFromBinary<snapshot_t>(current::FileSystem::ReadFileAsString(snapshot_file_name));
+    EXPECT_EQ(2u, snapshot.index);
+    ASSERT_EQ(1u, snapshot.mutations.size());
+    EXPECT_EQ(2, Value<RecordDictionaryUpdated>(snapshot.mutations[0]).data.rhs);
+  }
+
+  {
+    // Save a snapshot in the background every other transaction.
+    auto storage = storage_t::CreateMasterStorageWithSnapshots(
+        StorageSnapshots(snapshot_file_name, 2u, true), persistence_file_name);
+    EXPECT_EQ(3, Value(storage->ReadOnlyTransaction([](ImmutableFields<storage_t> fields) {
+                        return Value(fields.d["x"]).rhs;
+                      }).Go()));
+    // The transaction replayed atop the snapshot on startup counts too.
+    add(*storage, 4);
+    EXPECT_TRUE(storage->WaitForBackgroundSnapshot());
+    EXPECT_EQ(4u, LoadFromBinary<snapshot_t>(current::FileSystem::ReadFileAsString(snapshot_file_name)).index);
+    add(*storage, 5);
+    add(*storage, 6);
+    EXPECT_TRUE(storage->WaitForBackgroundSnapshot());
+    EXPECT_EQ(6u, LoadFromBinary<snapshot_t>(current::FileSystem::ReadFileAsString(snapshot_file_name)).index);
+  }
+
+  {
+    auto storage = storage_t::CreateMasterStorageWithSnapshots(StorageSnapshots(snapshot_file_name),
+                                                               persistence_file_name);
+    EXPECT_EQ(6, Value(storage->ReadOnlyTransaction([](ImmutableFields<storage_t> fields) {
+                        return Value(fields.d["x"]).rhs;
+                      }).Go()));
+    EXPECT_EQ(600, storage->LastAppliedTimestamp().count());
+  }
+}
+#endif  // CURRENT_WINDOWS
+
+TEST(TransactionalStorage, ParallelReplayer) {
+  struct Transaction {
+    std::vector<int> mutations;
+  };
+  std::mutex mutex;
+  std::vector<std::vector<int>> applied(3u);
+  {
+    current::storage::impl::ParallelReplayer<Transaction> replayer(
+        3u, 2u, [](int mutation) { return static_cast<size_t>(mutation % 10); }, [&](int mutation) {
+          std::lock_guard<std::mutex> lock(mutex);
+          applied[static_cast<size_t>(mutation % 10)].push_back(mutation / 10);
+        });
+    for (int i = 1; i <= 5; ++i) {
+      replayer.Add(Transaction{{i * 10, i * 10 + 1, i * 10 + 2, i * 100}});
+    }
+    replayer.Flush();
+    // Each field sees its mutations in order.
+    EXPECT_EQ("1,10,2,20,3,30,4,40,5,50", current::strings::Join(applied[0], ','));
+    EXPECT_EQ("1,2,3,4,5", current::strings::Join(applied[1], ','));
+    EXPECT_EQ("1,2,3,4,5", current::strings::Join(applied[2], ','));
+  }
+  {
+    current::storage::impl::ParallelReplayer<Transaction> replayer(
+        2u, 1u, [](int mutation) { return static_cast<size_t>(mutation); }, [](int mutation) {
+          if (mutation == 3) {
+            CURRENT_THROW(current::Exception("Boom."));
+          }
+        });
+    // What applying the mutations has thrown is rethrown by whichever call comes next, or by the barrier.
+    bool thrown = false;
+    try {
+      for (const int mutation : {0, 1, 3, 0, 1, 0, 1}) {
+        replayer.Add(Transaction{{mutation}});
+      }
+      replayer.Flush();
+    } catch (const current::Exception& e) {
+      thrown = true;
+      EXPECT_EQ("Boom.", e.OriginalDescription());
+    }
+    EXPECT_TRUE(thrown);
+  }
+}
+
+TEST(TransactionalStorage, ParallelReplay) {
+  current::time::ResetToZero();
+
+  using namespace transactional_storage_test;
+  using storage_t = TestStorage<StreamStreamPersister>;
+
+  const std::string persistence_file_name =
+      current::FileSystem::JoinPath(FLAGS_transactional_storage_test_tmpdir, "parallel_replay_data");
+  const auto persistence_file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+  const std::string snapshot_file_name =
+      current::FileSystem::JoinPath(FLAGS_transactional_storage_test_tmpdir, "parallel_replay_snapshot");
+  const auto snapshot_file_remover = current::FileSystem::ScopedRmFile(snapshot_file_name);
+
+  const auto dump = [](ImmutableFields<storage_t> fields) {
+    std::vector<std::string> result;
+    for (const Record& record : fields.d) {
+      result.push_back(JSON(record) + '@' + current::ToString(Value(fields.d.LastModified(record.lhs)).count()));
+    }
+    std::vector<std::string> cells;
+    for (const Cell& cell : fields.umany_to_umany) {
+      cells.push_back("N:N " + JSON(cell));
+    }
+    for (const Cell& cell : fields.oone_to_oone) {
+      cells.push_back("1:1 " + JSON(cell));
+    }
+    for (const Cell& cell : fields.oone_to_omany) {
+      cells.push_back("1:N " + JSON(cell));
+    }
+    std::sort(cells.begin(), cells.end());
+    result.insert(result.end(), cells.begin(), cells.end());
+    return current::strings::Join(result, '\n');
+  };
+
+  std::string expected;
+  {
+    auto storage = storage_t::CreateMasterStorage(persistence_file_name);
+    for (int i = 1; i <= 100; ++i) {
+      current::time::SetNow(std::chrono::microseconds(i * 100));
+      EXPECT_TRUE(WasCommitted(storage
+                                   ->ReadWriteTransaction([i](MutableFields<storage_t> fields) {
+                                     const std::string key = current::ToString(i % 7);
+                                     if (i % 5) {
+                                       fields.d.Add(Record(key, i));
+                                     } else {
+                                       fields.d.Erase(key);
+                                     }
+                                     // The later cells replace the earlier ones in the same row or column.
+                                     fields.oone_to_oone.Add(Cell(i % 4, current::ToString(i % 3), i));
+                                     fields.oone_to_omany.Add(Cell(i % 3, current::ToString(i % 11), i));
+                                     if (i % 2) {
+                                       fields.umany_to_umany.Add(Cell(i % 6, key, i));
+                                     } else {
+                                       fields.umany_to_umany.Erase(i % 6, key);
+                                     }
+                                   })
+                                   .Go()));
+    }
+    expected = Value(storage->ReadOnlyTransaction(dump).Go());
+  }
+
+  {
+    auto storage = storage_t::CreateMasterStorageWithParallelReplay(StorageReplayParallelism(4u, 7u),
+                                                                    persistence_file_name);
+    EXPECT_EQ(expected, Value(storage->ReadOnlyTransaction(dump).Go()));
+    EXPECT_EQ(10000, storage->LastAppliedTimestamp().count());
+    current::time::SetNow(std::chrono::microseconds(10100));
+    EXPECT_TRUE(WasCommitted(
+        storage->ReadWriteTransaction([](MutableFields<storage_t> fields) { fields.d.Add(Record("new", 1)); }).Go()));
+    expected = Value(storage->ReadOnlyTransaction(dump).Go());
+  }
+
+  {
+    // The following storage has replayed what is in the stream by the time it is created.
+    auto storage = storage_t::CreateFollowingStorageWithParallelReplay(StorageReplayParallelism(100u),
+                                                                       persistence_file_name);
+    EXPECT_FALSE(storage->IsMasterStorage());
+    EXPECT_EQ(expected, Value(storage->ReadOnlyTransaction(dump).Go()));
+    EXPECT_EQ(10100, storage->LastAppliedTimestamp().count());
+  }
+
+  {
+    // The snapshot due by the end of the replay is saved once all the fields are replayed.
+    auto stream = storage_t::stream_t::CreateStream(persistence_file_name);
+    auto storage = storage_t::CreateMasterStorageAtopExistingStream(
+        stream, StorageSnapshots(snapshot_file_name, 50u), StorageReplayParallelism(2u));
+    EXPECT_EQ(expected, Value(storage->ReadOnlyTransaction(dump).Go()));
+    EXPECT_EQ(101u,
+              LoadFromBinary<current::storage::StorageSnapshot<storage_t::fields_variant_t>>(
+                  current::FileSystem::ReadFileAsString(snapshot_file_name))
+                  .index);
+  }
+
+  {
+    auto storage = storage_t::CreateMasterStorageWithSnapshots(StorageSnapshots(snapshot_file_name),
+                                                               persistence_file_name);
+    EXPECT_EQ(expected, Value(storage->ReadOnlyTransaction(dump).Go()));
+  }
+}
+
+TEST(TransactionalStorage, ContainerCursors) {
+  current::time::ResetToZero();
+
+  using namespace transactional_storage_test;
+
+  // Walks the whole container about `limit` entries at a time, with `between()` called after each page.
+  const auto walk = [](const auto& field, size_t limit, std::function<void()> between = nullptr) {
+    std::map<std::string, size_t> seen;
+    std::string cursor;
+    size_t pages = 0u;
+    do {
+      cursor = field.ForEachEntryFromCursor(cursor, limit, [&](const auto& key, const auto&) { ++seen[JSON(key)]; });
+      ++pages;
+      if (between) {
+        between();
+      }
+    } while (!cursor.empty());
+    return std::make_pair(seen, pages);
+  };
+  const auto all_once = [](const std::map<std::string, size_t>& seen) {
+    for (const auto& e : seen) {
+      if (e.second != 1u) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  {
+    using storage_t = TestStorage<StreamInMemoryStreamPersister>;
+    auto storage = storage_t::CreateMasterStorage();
+    EXPECT_TRUE(WasCommitted(storage
+                                 ->ReadWriteTransaction([&](MutableFields<storage_t> fields) {
+                                   for (int i = 0; i < 25; ++i) {
+                                     fields.d.Add(Record(current::ToString(i), i));
+                                     fields.umany_to_umany.Add(Cell(i % 5, current::ToString(i), i));
+                                     fields.oone_to_oone.Add(Cell(i, current::ToString(i), i));
+                                   }
+
+                                   const auto d = walk(fields.d, 10u);
+                                   EXPECT_EQ(25u, d.first.size());
+                                   EXPECT_TRUE(all_once(d.first));
+                                   EXPECT_EQ(3u, d.second);
+                                   // The ordered containers resume in the order of their keys.
+                                   EXPECT_EQ("\"0\"", d.first.begin()->first);
+
+                                   const auto m = walk(fields.umany_to_umany, 4u);
+                                   EXPECT_EQ(25u, m.first.size());
+                                   EXPECT_TRUE(all_once(m.first));
+
+                                   const auto o = walk(fields.oone_to_oone, 25u);
+                                   EXPECT_EQ(25u, o.first.size());
+                                   EXPECT_TRUE(all_once(o.first));
+
+                                   // The ordered cursors survive the key they point to being erased.
+                                   const auto nop = [](const auto&, const auto&) {};
+                                   std::string cursor = fields.d.ForEachEntryFromCursor("", 5u, nop);
+                                   fields.d.Erase("12");
+                                   size_t rest = 0u;
+                                   while (!cursor.empty()) {
+                                     cursor = fields.d.ForEachEntryFromCursor(
+                                         cursor, 5u, [&](const auto&, const auto&) { ++rest; });
+                                   }
+                                   EXPECT_EQ(20u, rest);
+
+                                   bool thrown = false;
+                                   try {
+                                     fields.umany_to_umany.ForEachEntryFromCursor("#", 1u, nop);
+                                   } catch (const current::storage::StorageInvalidCursorException&) {
+                                     thrown = true;
+                                   }
+                                   EXPECT_TRUE(thrown);
+                                 })
+                                 .Go()));
+  }
+
+  {
+    // The unordered cursors visit each of the entries present throughout exactly once, even as the map is rehashed.
+    using storage_t = FlatStorage<StreamInMemoryStreamPersister>;
+    auto storage = storage_t::CreateMasterStorage();
+    EXPECT_TRUE(WasCommitted(storage
+                                 ->ReadWriteTransaction([&](MutableFields<storage_t> fields) {
+                                   for (int i = 0; i < 100; ++i) {
+                                     fields.users.Add(IndexedUser("user" + current::ToString(i)));
+                                   }
+                                   int added = 100;
+                                   const auto w = walk(fields.users, 10u, [&]() {
+                                     for (int i = 0; i < 200 && added < 1000; ++i, ++added) {
+                                       fields.users.Add(IndexedUser("user" + current::ToString(added)));
+                                     }
+                                   });
+                                   EXPECT_TRUE(all_once(w.first));
+                                   for (int i = 0; i < 100; ++i) {
+                                     EXPECT_EQ(1u, w.first.count("\"user" + current::ToString(i) + '"')) << i;
+                                   }
+
+                                   bool thrown = false;
+                                   try {
+                                     fields.users.ForEachEntryFromCursor(
+                                         "not a hash", 1u, [](const auto&, const auto&) {});
+                                   } catch (const current::storage::StorageInvalidCursorException&) {
+                                     thrown = true;
+                                   }
+                                   EXPECT_TRUE(thrown);
+                                 })
+                                 .Go()));
+  }
+
+  {
+    using storage_t = TestStorage<StreamInMemoryStreamPersister>;
+    auto storage = storage_t::CreateMasterStorage();
+    EXPECT_TRUE(WasCommitted(storage
+                                 ->ReadWriteTransaction([&](MutableFields<storage_t> fields) {
+                                   for (int i = 0; i < 100; ++i) {
+                                     fields.umany_to_umany.Add(Cell(i, "x", i));
+                                   }
+                                   int added = 100;
+                                   const auto w = walk(fields.umany_to_umany, 7u, [&]() {
+                                     for (int i = 0; i < 150 && added < 1000; ++i, ++added) {
+                                       fields.umany_to_umany.Add(Cell(added, "x", added));
+                                     }
+                                   });
+                                   EXPECT_TRUE(all_once(w.first));
+                                   for (int i = 0; i < 100; ++i) {
+                                     EXPECT_EQ(1u, w.first.count(JSON(std::make_pair(i, std::string("x"))))) << i;
+                                   }
+                                 })
+                                 .Go()));
+  }
+}
+
+TEST(TransactionalStorage, BulkLoad) {
+  current::time::ResetToZero();
+
+  using namespace transactional_storage_test;
+  using storage_t = TestStorage<StreamStreamPersister>;
+
+  const std::string persistence_file_name =
+      current::FileSystem::JoinPath(FLAGS_transactional_storage_test_tmpdir, "bulk_load_data");
+  const auto persistence_file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+
+  const auto dump = [](ImmutableFields<storage_t> fields) {
+    std::vector<std::string> result;
+    for (const Record& record : fields.d) {
+      result.push_back(JSON(record));
+    }
+    for (const Cell& cell : fields.oone_to_oone) {
+      result.push_back("1:1 " + JSON(cell));
+    }
+    return current::strings::Join(result, '\n');
+  };
+
+  std::string expected;
+  {
+    auto storage = storage_t::CreateMasterStorage(persistence_file_name);
+    current::time::SetNow(std::chrono::microseconds(100));
+    EXPECT_TRUE(WasCommitted(
+        storage->ReadWriteTransaction([](MutableFields<storage_t> fields) { fields.d.Add(Record("a", 1)); }).Go()));
+
+    current::time::SetNow(std::chrono::microseconds(200));
+    EXPECT_EQ(1003u, storage->BulkLoad([](ImmutableFields<storage_t> fields, storage_t::bulk_load_t& load) {
+      load.Reserve(1003u);
+      for (int i = 0; i < 1000; ++i) {
+        load.Add(fields.d, Record("x" + current::ToString(i), i));
+      }
+      load.Add(fields.d, Record("a", 42));
+      // The later entries of the same key replace the earlier ones.
+      load.Add(fields.oone_to_oone, Cell(1, "one", 1));
+      load.Add(fields.oone_to_oone, Cell(1, "one", 2));
+    }));
+    // The bulk load is one transaction.
+    EXPECT_EQ(2u, storage->UnderlyingStream()->Data()->Size());
+
+    // Nothing is loaded if the loader throws.
+    try {
+      storage->BulkLoad([](ImmutableFields<storage_t> fields, storage_t::bulk_load_t& load) {
+        load.Add(fields.d, Record("y", 0));
+        CURRENT_THROW(current::Exception("Nope."));
+      });
+      ASSERT_TRUE(false);
+    } catch (const current::Exception&) {
+    }
+    EXPECT_EQ(0u, storage->BulkLoad([](ImmutableFields<storage_t>, storage_t::bulk_load_t&) {}));
+    EXPECT_EQ(2u, storage->UnderlyingStream()->Data()->Size());
+
+    expected = Value(storage->ReadOnlyTransaction([&dump](ImmutableFields<storage_t> fields) {
+                                  EXPECT_EQ(1001u, fields.d.Size());
+                                  EXPECT_EQ(42, Value(fields.d["a"]).rhs);
+                                  EXPECT_EQ(200, Value(fields.d.LastModified("a")).count());
+                                  EXPECT_EQ(1u, fields.oone_to_oone.Size());
+                                  EXPECT_EQ(2, Value(fields.oone_to_oone.Get(1, "one")).phew);
+                                  return dump(fields);
+                                }).Go());
+  }
+  {
+    auto storage = storage_t::CreateMasterStorage(persistence_file_name);
+    EXPECT_EQ(expected, Value(storage->ReadOnlyTransaction(dump).Go()));
+  }
+}
+
+TEST(TransactionalStorage, MutationJournalRollbackLog) {
+  current::storage::MutationJournalRollbackLog log;
+  std::vector<int> rolled_back;
+  const auto captured = std::make_shared<int>(0);
+
+  for (int transaction = 0; transaction < 3; ++transaction) {
+    for (int i = 0; i < 1000; ++i) {
+      log.Push([&rolled_back, captured, i]() { rolled_back.push_back(i); });
+    }
+    // The records larger than the block of memory are kept too.
+    std::array<char, 64 * 1024> large;
+    large.fill('x');
+    log.Push([&rolled_back, large]() { rolled_back.push_back(large[42] == 'x' ? -1 : -2); });
+    EXPECT_EQ(1001u, log.Size());
+    EXPECT_EQ(1001, captured.use_count());
+
+    if (transaction != 1) {
+      rolled_back.clear();
+      log.RollbackAll();
+      ASSERT_EQ(1001u, rolled_back.size());
+      EXPECT_EQ(-1, rolled_back.front());
+      EXPECT_EQ(999, rolled_back[1]);
+      EXPECT_EQ(0, rolled_back.back());
+    } else {
+      // Committed, nothing is rolled back, and the records are destroyed all the same.
+      rolled_back.clear();
+      log.Clear();
+      EXPECT_TRUE(rolled_back.empty());
+    }
+    EXPECT_TRUE(log.Empty());
+    EXPECT_EQ(1, captured.use_count());
+  }
+}
+
 #endif  // STORAGE_ONLY_RUN_RESTFUL_TESTS
@@ -25,7 +25,16 @@ SOFTWARE.
 #ifndef CURRENT_STORAGE_TRANSACTION_POLICY_H
 #define CURRENT_STORAGE_TRANSACTION_POLICY_H
 
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 #include <type_traits>
+#include <vector>
 
 #include "base.h"
 #include "exceptions.h"
@@ -40,15 +49,203 @@ namespace current {
 namespace storage {
 namespace transaction_policy {
 
-template <class PERSISTER>
-class Synchronous final {
+namespace impl {
+
+// All the transactions, and the replay of the stream, are run with the publishing mutex of the stream locked,
+// so that no extra locking is needed.
+class ExclusiveAccess final {
+ public:
+  constexpr static bool concurrent_read_only_transactions = false;
+
+  struct ReadLock final {
+    explicit ReadLock(const ExclusiveAccess&) {}
+  };
+
+  struct WriteLock final {
+    explicit WriteLock(ExclusiveAccess&) {}
+  };
+};
+
+// The read-only transactions are run without locking the publishing mutex of the stream, so that they run
+// concurrently with one another. Whatever changes the fields, which is the read-write transactions, with their
+// rollbacks, and the replay of the stream, one transaction at a time, does so exclusively, so that the read-only
+// transactions only ever see the fields as of some committed transaction.
+// The writers take the `gate_` first, and hold it while waiting for the readers to finish, so that the new readers
+// queue up behind them, and a steady flow of read-only transactions can not starve the writers.
+class SharedReadAccess final {
+ public:
+  constexpr static bool concurrent_read_only_transactions = true;
+
+  class ReadLock final {
+   public:
+    explicit ReadLock(const SharedReadAccess& access) : mutex_(access.mutex_) {
+      std::lock_guard<std::mutex> gate(access.gate_);
+      mutex_.lock_shared();
+    }
+    ~ReadLock() { mutex_.unlock_shared(); }
+
+   private:
+    ReadLock(const ReadLock&) = delete;
+    ReadLock& operator=(const ReadLock&) = delete;
+
+    std::shared_mutex& mutex_;
+  };
+
+  class WriteLock final {
+   public:
+    explicit WriteLock(SharedReadAccess& access) : gate_(access.gate_), lock_(access.mutex_) {}
+
+   private:
+    std::lock_guard<std::mutex> gate_;
+    std::lock_guard<std::shared_mutex> lock_;
+  };
+
+ private:
+  mutable std::mutex gate_;
+  mutable std::shared_mutex mutex_;
+};
+
+// Returns the result of each committed read-write transaction as an already resolved future.
+class ImmediateCommit final {
+ public:
+  template <class PERSISTER>
+  explicit ImmediateCommit(PERSISTER&) {}
+
+  template <typename T>
+  Future<T, StrictFuture::Strict> Committed(T&& result) {
+    return Future<T, StrictFuture::Strict>::Ready(std::move(result));
+  }
+};
+
+template <typename PERSISTENCE_LAYER, typename = void>
+struct persistence_layer_syncs_to_disk : std::false_type {};
+
+template <typename PERSISTENCE_LAYER>
+struct persistence_layer_syncs_to_disk<PERSISTENCE_LAYER,
+                                       std::void_t<decltype(&PERSISTENCE_LAYER::PersisterWaitUntilDurableImpl)>>
+    : std::true_type {};
+
+// Resolves the future of each committed read-write transaction once its entry in the stream is durable.
+// The transactions are still applied and published one by one, in order, but a dedicated thread makes them durable
+// in groups: it takes up to `MAX_TRANSACTIONS` of the transactions committed so far, waiting for up to
+// `MAX_DELAY_US` for more of them to arrive first, makes them durable with one `WaitUntilDurable()` call on the
+// persister of the stream, and resolves their futures, in order. With zero `MAX_DELAY_US` the group is whatever was
+// committed while the previous group was being synced.
+// For the persisters that do not sync to disk, such as the in-memory ones, the futures are resolved right away.
+template <class PERSISTER, size_t MAX_TRANSACTIONS, uint64_t MAX_DELAY_US>
+class DeferredCommit final {
+ public:
+  using stream_t = typename PERSISTER::stream_t;
+  constexpr static bool syncs_to_disk =
+      persistence_layer_syncs_to_disk<typename stream_t::persistence_layer_t>::value;
+
+  static_assert(MAX_TRANSACTIONS > 0u, "A group of transactions to commit should not be empty.");
+
+  explicit DeferredCommit(PERSISTER& persister) : persister_(persister) {}
+
+  ~DeferredCommit() {
+    if (thread_.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        terminating_ = true;
+      }
+      condition_variable_.notify_one();
+      thread_.join();
+    }
+  }
+
+  // Called from the locked section, right after the journal of the transaction has been persisted.
+  // The transactions that have not changed anything wait for the ones persisted before them, if any.
+  template <typename T>
+  Future<T, StrictFuture::Strict> Committed(T&& result) {
+    if constexpr (syncs_to_disk) {
+      const uint64_t size =
+          persister_.Stream()->Data()->template Size<current::locks::MutexLockStatus::AlreadyLocked>();
+      if (size) {
+        std::promise<T> promise;
+        Future<T, StrictFuture::Strict> future(promise.get_future());
+        auto state = std::make_shared<std::pair<std::promise<T>, T>>(std::move(promise), std::move(result));
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (!thread_.joinable()) {
+            stream_ = std::make_unique<Borrowed<stream_t>>(persister_.BorrowStream());
+            thread_ = std::thread([this]() { Thread(); });
+          }
+          pending_.push_back(Pending{size - 1u, [state](std::exception_ptr error) {
+                                       if (error) {
+                                         state->first.set_exception(error);
+                                       } else {
+                                         state->first.set_value(std::move(state->second));
+                                       }
+                                     }});
+        }
+        condition_variable_.notify_one();
+        return future;
+      }
+    }
+    return Future<T, StrictFuture::Strict>::Ready(std::move(result));
+  }
+
+ private:
+  DeferredCommit(const DeferredCommit&) = delete;
+  DeferredCommit& operator=(const DeferredCommit&) = delete;
+
+  struct Pending final {
+    uint64_t index;
+    std::function<void(std::exception_ptr)> resolve;
+  };
+
+  void Thread() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      condition_variable_.wait(lock, [this]() { return terminating_ || !pending_.empty(); });
+      if (pending_.empty()) {
+        return;
+      }
+      if (MAX_DELAY_US && !terminating_) {
+        condition_variable_.wait_for(lock, std::chrono::microseconds(MAX_DELAY_US), [this]() {
+          return terminating_ || pending_.size() >= MAX_TRANSACTIONS;
+        });
+      }
+      const size_t count = std::min(pending_.size(), MAX_TRANSACTIONS);
+      group_.assign(std::make_move_iterator(pending_.begin()), std::make_move_iterator(pending_.begin() + count));
+      pending_.erase(pending_.begin(), pending_.begin() + count);
+      lock.unlock();
+      std::exception_ptr error;
+      try {
+        (*stream_)->Data()->WaitUntilDurable(group_.back().index);
+      } catch (...) {  // The exception is passed on to the futures of the whole group.
+        error = std::current_exception();
+      }
+      for (Pending& pending : group_) {
+        pending.resolve(error);
+      }
+      group_.clear();
+      lock.lock();
+    }
+  }
+
+  PERSISTER& persister_;
+  std::unique_ptr<Borrowed<stream_t>> stream_;  // Borrowed along with starting the thread, to outlive it.
+  std::mutex mutex_;                            // Guards `pending_` and `terminating_`.
+  std::condition_variable condition_variable_;
+  std::vector<Pending> pending_;
+  std::vector<Pending> group_;  // Used by the thread only.
+  bool terminating_ = false;
+  std::thread thread_;
+};
+
+template <class PERSISTER, class ACCESS, class COMMIT>
+class SynchronousImpl final {
  public:
   using transaction_t = typename PERSISTER::transaction_t;
 
-  Synchronous(PERSISTER& persister, MutationJournal& journal)
-      : persister_(persister), journal_(journal), destructing_(false) {}
+  constexpr static bool concurrent_read_only_transactions = ACCESS::concurrent_read_only_transactions;
+
+  SynchronousImpl(PERSISTER& persister, MutationJournal& journal)
+      : persister_(persister), journal_(journal), destructing_(false), commit_(persister) {}
 
-  ~Synchronous() { destructing_ = true; }
+  ~SynchronousImpl() { destructing_ = true; }
 
 #ifndef CURRENT_FOR_CPP14
   template <typename F>
@@ -62,149 +259,93 @@ class Synchronous final {
   template <typename F, class = std::enable_if_t<!std::is_void<f_result_t<F>>::value>>
   Future<TransactionResult<f_result_t<F>>, StrictFuture::Strict> TransactionFromLockedSection(F&& f) {
     using result_t = f_result_t<F>;
+    using future_t = Future<TransactionResult<result_t>, StrictFuture::Strict>;
     journal_.AssertEmpty();
-    std::promise<TransactionResult<result_t>> promise;
     if (destructing_) {
-      promise.set_exception(std::make_exception_ptr(StorageInGracefulShutdownException()));  // LCOV_EXCL_LINE
-    } else {
-      bool successful = false;
-      result_t f_result;
-      try {
-        journal_.BeforeTransaction();
-        f_result = f();
-        journal_.AfterTransaction();
-        successful = true;
-      } catch (StorageRollbackExceptionWithValue<result_t> e) {
-        journal_.Rollback();
-        promise.set_value(TransactionResult<result_t>::RolledBack(std::move(e.value)));
-      } catch (StorageRollbackExceptionWithNoValue) {
-        journal_.Rollback();
-        promise.set_value(TransactionResult<result_t>::RolledBack(OptionalResultMissing()));
-      } catch (...) {  // The exception is captured with `std::current_exception()` below.
-        journal_.Rollback();
-        // LCOV_EXCL_START
-        try {
-          promise.set_exception(std::current_exception());
-        } catch (const std::exception& e) {
-          std::cerr << "`promise.set_exception()` failed in Synchronous::TransactionFromLockedSection: " << e.what()
-                    << std::endl;
-          std::exit(-1);
-        }
-        // LCOV_EXCL_STOP
-      }
-      if (successful) {
-        PersistJournal();
-        promise.set_value(TransactionResult<result_t>::Committed(std::move(f_result)));
-      }
+      return future_t::Failed(std::make_exception_ptr(StorageInGracefulShutdownException()));  // LCOV_EXCL_LINE
     }
-    return Future<TransactionResult<result_t>, StrictFuture::Strict>(promise.get_future());
+    typename ACCESS::WriteLock lock(access_);
+    result_t f_result;
+    try {
+      journal_.BeforeTransaction();
+      f_result = f();
+      journal_.AfterTransaction();
+    } catch (StorageRollbackExceptionWithValue<result_t>& e) {
+      journal_.Rollback();
+      return future_t::Ready(TransactionResult<result_t>::RolledBack(std::move(e.value)));
+    } catch (const StorageRollbackExceptionWithNoValue&) {
+      journal_.Rollback();
+      return future_t::Ready(TransactionResult<result_t>::RolledBack(OptionalResultMissing()));
+    } catch (...) {  // The exception is passed on to the caller with the future.
+      journal_.Rollback();
+      return future_t::Failed(std::current_exception());
+    }
+    PersistJournal();
+    return commit_.Committed(TransactionResult<result_t>::Committed(std::move(f_result)));
   }
 
   // Read-only transaction returning non-void type.
   template <typename F, class = std::enable_if_t<!std::is_void<f_result_t<F>>::value>>
   Future<TransactionResult<f_result_t<F>>, StrictFuture::Strict> TransactionFromLockedSection(F&& f) const {
     using result_t = f_result_t<F>;
-    journal_.AssertEmpty();
-    std::promise<TransactionResult<result_t>> promise;
+    using future_t = Future<TransactionResult<result_t>, StrictFuture::Strict>;
+    AssertJournalEmptyForReadOnlyTransaction();
     if (destructing_) {
-      promise.set_exception(std::make_exception_ptr(StorageInGracefulShutdownException()));  // LCOV_EXCL_LINE
-    } else {
-      bool successful = false;
-      result_t f_result;
-      try {
-        f_result = f();
-        successful = true;
-      } catch (StorageRollbackExceptionWithValue<result_t>& e) {
-        promise.set_value(TransactionResult<result_t>::RolledBack(std::move(e.value)));
-      } catch (const StorageRollbackExceptionWithNoValue&) {
-        promise.set_value(TransactionResult<result_t>::RolledBack(OptionalResultMissing()));
-      } catch (...) {  // The exception is captured with `std::current_exception()` below.
-        // LCOV_EXCL_START
-        try {
-          promise.set_exception(std::current_exception());
-        } catch (const std::exception& e) {
-          std::cerr << "`promise.set_exception()` failed in Synchronous::TransactionFromLockedSection: " << e.what()
-                    << std::endl;
-          std::exit(-1);
-        }
-        // LCOV_EXCL_STOP
-      }
-      if (successful) {
-        promise.set_value(TransactionResult<result_t>::Committed(std::move(f_result)));
-      }
+      return future_t::Failed(std::make_exception_ptr(StorageInGracefulShutdownException()));  // LCOV_EXCL_LINE
+    }
+    typename ACCESS::ReadLock lock(access_);
+    try {
+      return future_t::Ready(TransactionResult<result_t>::Committed(f()));
+    } catch (StorageRollbackExceptionWithValue<result_t>& e) {
+      return future_t::Ready(TransactionResult<result_t>::RolledBack(std::move(e.value)));
+    } catch (const StorageRollbackExceptionWithNoValue&) {
+      return future_t::Ready(TransactionResult<result_t>::RolledBack(OptionalResultMissing()));
+    } catch (...) {  // The exception is passed on to the caller with the future.
+      return future_t::Failed(std::current_exception());
     }
-    return Future<TransactionResult<result_t>, StrictFuture::Strict>(promise.get_future());
   }
 
   // Read-write transaction returning void type.
   template <typename F, class = std::enable_if_t<std::is_void<f_result_t<F>>::value>>
   Future<TransactionResult<void>, StrictFuture::Strict> TransactionFromLockedSection(F&& f) {
+    using future_t = Future<TransactionResult<void>, StrictFuture::Strict>;
     journal_.AssertEmpty();
-    std::promise<TransactionResult<void>> promise;
     if (destructing_) {
-      // LCOV_EXCL_START
-      promise.set_exception(std::make_exception_ptr(StorageInGracefulShutdownException()));
-      // LCOV_EXCL_STOP
-    } else {
-      bool successful = false;
-      try {
-        journal_.BeforeTransaction();
-        f();
-        journal_.AfterTransaction();
-        successful = true;
-      } catch (const StorageRollbackExceptionWithNoValue&) {
-        journal_.Rollback();
-        promise.set_value(TransactionResult<void>::RolledBack(OptionalResultExists()));
-      } catch (...) {  // The exception is captured with `std::current_exception()` below.
-        journal_.Rollback();
-        // LCOV_EXCL_START
-        try {
-          promise.set_exception(std::current_exception());
-        } catch (const std::exception& e) {
-          std::cerr << "`promise.set_exception()` failed in Synchronous::TransactionFromLockedSection: " << e.what()
-                    << std::endl;
-          std::exit(-1);
-        }
-        // LCOV_EXCL_STOP
-      }
-      if (successful) {
-        PersistJournal();
-        promise.set_value(TransactionResult<void>::Committed(OptionalResultExists()));
-      }
+      return future_t::Failed(std::make_exception_ptr(StorageInGracefulShutdownException()));  // LCOV_EXCL_LINE
     }
-    return Future<TransactionResult<void>, StrictFuture::Strict>(promise.get_future());
+    typename ACCESS::WriteLock lock(access_);
+    try {
+      journal_.BeforeTransaction();
+      f();
+      journal_.AfterTransaction();
+    } catch (const StorageRollbackExceptionWithNoValue&) {
+      journal_.Rollback();
+      return future_t::Ready(TransactionResult<void>::RolledBack(OptionalResultExists()));
+    } catch (...) {  // The exception is passed on to the caller with the future.
+      journal_.Rollback();
+      return future_t::Failed(std::current_exception());
+    }
+    PersistJournal();
+    return commit_.Committed(TransactionResult<void>::Committed(OptionalResultExists()));
   }
 
   // Read-only transaction returning void type.
   template <typename F, class = std::enable_if_t<std::is_void<f_result_t<F>>::value>>
   Future<TransactionResult<void>, StrictFuture::Strict> TransactionFromLockedSection(F&& f) const {
-    journal_.AssertEmpty();
-    std::promise<TransactionResult<void>> promise;
+    using future_t = Future<TransactionResult<void>, StrictFuture::Strict>;
+    AssertJournalEmptyForReadOnlyTransaction();
     if (destructing_) {
-      promise.set_exception(std::make_exception_ptr(StorageInGracefulShutdownException()));
-    } else {
-      bool successful = false;
-      try {
-        f();
-        successful = true;
-      } catch (const StorageRollbackExceptionWithNoValue&) {
-        promise.set_value(TransactionResult<void>::RolledBack(OptionalResultExists()));
-      } catch (...) {  // The exception is captured with `std::current_exception()` below.
-        // LCOV_EXCL_START
-        try {
-          promise.set_exception(std::current_exception());
-        } catch (const std::exception& e) {
-          std::cerr << "`promise.set_exception()` failed in Synchronous::TransactionFromLockedSection: " << e.what()
-                    << std::endl;
-          std::exit(-1);
-        }
-        // LCOV_EXCL_STOP
-      }
-      if (successful) {
-        promise.set_value(TransactionResult<void>::Committed(OptionalResultExists()));
-      }
+      return future_t::Failed(std::make_exception_ptr(StorageInGracefulShutdownException()));
+    }
+    typename ACCESS::ReadLock lock(access_);
+    try {
+      f();
+      return future_t::Ready(TransactionResult<void>::Committed(OptionalResultExists()));
+    } catch (const StorageRollbackExceptionWithNoValue&) {
+      return future_t::Ready(TransactionResult<void>::RolledBack(OptionalResultExists()));
+    } catch (...) {  // The exception is passed on to the caller with the future.
+      return future_t::Failed(std::current_exception());
     }
-    return Future<TransactionResult<void>, StrictFuture::Strict>(promise.get_future());
   }
 
   // TODO(mz+dk): implement proper logic here (consider rollbacks & exceptions).
@@ -212,81 +353,77 @@ class Synchronous final {
   template <typename F1, typename F2, class = std::enable_if_t<!std::is_void<f_result_t<F1>>::value>>
   Future<TransactionResult<void>, StrictFuture::Strict> TransactionFromLockedSection(F1&& f1, F2&& f2) {
     using result_t = f_result_t<F1>;
+    using future_t = Future<TransactionResult<void>, StrictFuture::Strict>;
     journal_.AssertEmpty();
-    std::promise<TransactionResult<void>> promise;
     if (destructing_) {
-      promise.set_exception(std::make_exception_ptr(StorageInGracefulShutdownException()));  // LCOV_EXCL_LINE
-    } else {
-      result_t f1_result;
-      try {
-        journal_.BeforeTransaction();
-        f1_result = f1();
-        journal_.AfterTransaction();
-        PersistJournal();
-        f2(std::move(f1_result));
-        promise.set_value(TransactionResult<void>::Committed(OptionalResultExists()));
-      } catch (const StorageRollbackExceptionWithValue<result_t>& e) {
-        // The transaction was rolled back, but returned a value, which we try to pass again to `f2`.
-        journal_.Rollback();
-        f2(std::move(e.value));
-        promise.set_value(TransactionResult<void>::RolledBack(OptionalResultMissing()));
-      } catch (const StorageRollbackExceptionWithNoValue&) {
-        // The transaction was rolled back and returned nothing we can pass to `f2`.
-        journal_.Rollback();
-        promise.set_value(TransactionResult<void>::RolledBack(OptionalResultMissing()));
-      } catch (...) {  // The exception is captured with `std::current_exception()` below.
-        // LCOV_EXCL_START
-        journal_.Rollback();
-        try {
-          promise.set_exception(std::current_exception());
-        } catch (const std::exception& e) {
-          std::cerr << "`promise.set_exception()` failed in Synchronous::TransactionFromLockedSection: " << e.what()
-                    << std::endl;
-          std::exit(-1);
-        }
-        // LCOV_EXCL_STOP
-      }
+      return future_t::Failed(std::make_exception_ptr(StorageInGracefulShutdownException()));  // LCOV_EXCL_LINE
     }
-    return Future<TransactionResult<void>, StrictFuture::Strict>(promise.get_future());
+    typename ACCESS::WriteLock lock(access_);
+    result_t f1_result;
+    try {
+      journal_.BeforeTransaction();
+      f1_result = f1();
+      journal_.AfterTransaction();
+      PersistJournal();
+      f2(std::move(f1_result));
+    } catch (StorageRollbackExceptionWithValue<result_t>& e) {
+      // The transaction was rolled back, but returned a value, which we try to pass again to `f2`.
+      journal_.Rollback();
+      f2(std::move(e.value));
+      return future_t::Ready(TransactionResult<void>::RolledBack(OptionalResultMissing()));
+    } catch (const StorageRollbackExceptionWithNoValue&) {
+      // The transaction was rolled back and returned nothing we can pass to `f2`.
+      journal_.Rollback();
+      return future_t::Ready(TransactionResult<void>::RolledBack(OptionalResultMissing()));
+    } catch (...) {  // The exception is passed on to the caller with the future.
+      journal_.Rollback();
+      return future_t::Failed(std::current_exception());
+    }
+    return commit_.Committed(TransactionResult<void>::Committed(OptionalResultExists()));
   }
 
   // Read-only two-step transaction.
   template <typename F1, typename F2, class = std::enable_if_t<!std::is_void<f_result_t<F1>>::value>>
   Future<TransactionResult<void>, StrictFuture::Strict> TransactionFromLockedSection(F1&& f1, F2&& f2) const {
     using result_t = f_result_t<F1>;
-    journal_.AssertEmpty();
-    std::promise<TransactionResult<void>> promise;
+    using future_t = Future<TransactionResult<void>, StrictFuture::Strict>;
+    AssertJournalEmptyForReadOnlyTransaction();
     if (destructing_) {
-      promise.set_exception(std::make_exception_ptr(StorageInGracefulShutdownException()));  // LCOV_EXCL_LINE
-    } else {
-      try {
-        f2(f1());
-        promise.set_value(TransactionResult<void>::Committed(OptionalResultExists()));
-      } catch (StorageRollbackExceptionWithValue<result_t>& e) {
-        // The transaction was rolled back, but returned a value, which we try to pass again to `f2`.
-        f2(std::move(e.value));
-        promise.set_value(TransactionResult<void>::RolledBack(OptionalResultMissing()));
-      } catch (const StorageRollbackExceptionWithNoValue&) {
-        // The transaction was rolled back and returned nothing we can pass to `f2`.
-        promise.set_value(TransactionResult<void>::RolledBack(OptionalResultMissing()));
-      } catch (...) {  // The exception is captured with `std::current_exception()` below.
-        // LCOV_EXCL_START
-        try {
-          promise.set_exception(std::current_exception());
-        } catch (const std::exception& e) {
-          std::cerr << "`promise.set_exception()` failed in Synchronous::TransactionFromLockedSection: " << e.what()
-                    << std::endl;
-          std::exit(-1);
-        }
-        // LCOV_EXCL_STOP
-      }
+      return future_t::Failed(std::make_exception_ptr(StorageInGracefulShutdownException()));  // LCOV_EXCL_LINE
+    }
+    typename ACCESS::ReadLock lock(access_);
+    try {
+      f2(f1());
+      return future_t::Ready(TransactionResult<void>::Committed(OptionalResultExists()));
+    } catch (StorageRollbackExceptionWithValue<result_t>& e) {
+      // The transaction was rolled back, but returned a value, which we try to pass again to `f2`.
+      f2(std::move(e.value));
+      return future_t::Ready(TransactionResult<void>::RolledBack(OptionalResultMissing()));
+    } catch (const StorageRollbackExceptionWithNoValue&) {
+      // The transaction was rolled back and returned nothing we can pass to `f2`.
+      return future_t::Ready(TransactionResult<void>::RolledBack(OptionalResultMissing()));
+    } catch (...) {  // The exception is passed on to the caller with the future.
+      return future_t::Failed(std::current_exception());
     }
-    return Future<TransactionResult<void>, StrictFuture::Strict>(promise.get_future());
   }
 
   void GracefulShutdown() { destructing_ = true; }
 
+  // Applies one replicated transaction to the fields, or, for the master storage, replays one from the stream.
+  template <typename F>
+  void ApplyTransactionFromLockedSection(F&& f) {
+    typename ACCESS::WriteLock lock(access_);
+    f();
+  }
+
  private:
+  // The concurrent read-only transactions may overlap with a read-write one, which the journal is not empty during.
+  void AssertJournalEmptyForReadOnlyTransaction() const {
+    if constexpr (!concurrent_read_only_transactions) {
+      journal_.AssertEmpty();
+    }
+  }
+
   void PersistJournal() {
     try {
       persister_.PersistJournalFromLockedSection(journal_);
@@ -306,8 +443,35 @@ class Synchronous final {
   PERSISTER& persister_;
   MutationJournal& journal_;
   std::atomic_bool destructing_;
+  mutable ACCESS access_;
+  COMMIT commit_;
 };
 
+}  // namespace impl
+
+// Runs all the transactions one by one.
+template <class PERSISTER>
+using Synchronous = impl::SynchronousImpl<PERSISTER, impl::ExclusiveAccess, impl::ImmediateCommit>;
+
+// Runs the read-write transactions one by one, and the read-only ones concurrently with one another.
+template <class PERSISTER>
+using ConcurrentReadOnly = impl::SynchronousImpl<PERSISTER, impl::SharedReadAccess, impl::ImmediateCommit>;
+
+// Runs all the transactions one by one, and only resolves the futures of the committed read-write transactions once
+// they are durable, syncing the persisted transactions to disk in groups, see `impl::DeferredCommit`.
+// Best used with the file persisters buffering their writes, i.e. with `FileDurability::GroupCommit()`, so that
+// a group of transactions is both written and synced at once.
+template <size_t MAX_TRANSACTIONS, uint64_t MAX_DELAY_US>
+struct GroupCommitWith final {
+  template <class PERSISTER>
+  using policy = impl::SynchronousImpl<PERSISTER,
+                                       impl::ExclusiveAccess,
+                                       impl::DeferredCommit<PERSISTER, MAX_TRANSACTIONS, MAX_DELAY_US>>;
+};
+
+template <class PERSISTER>
+using GroupCommit = GroupCommitWith<1000u, 0u>::policy<PERSISTER>;
+
 }  // namespace transaction_policy
 }  // namespace storage
 }  // namespace current
@@ -0,0 +1,233 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// `SubscriberDispatcher` runs stream subscribers on a fixed-size pool of threads, instead of one thread each.
+//
+// By default, each `Subscribe()` call spawns a dedicated thread. With thousands of subscribers that's thousands
+// of threads, most of them asleep, and a lot of context switching once the stream is being published into.
+// Once `stream.SetSubscriberDispatcher(&dispatcher)` is called, the subsequent subscriptions to that stream
+// are multiplexed over the threads of `dispatcher` instead.
+//
+// A dispatched subscriber is run in steps. Each step passes at most `max_entries_per_step` entries to it,
+// so that a subscriber catching up on a long stream does not starve the others. A subscriber is never run by
+// more than one thread at a time, so the order of entries, as well as the semantics of `EntryResponse` and of
+// `TerminationResponse`, are the same as with the dedicated thread. A subscriber that has nothing to process
+// does not occupy a thread; it is woken up by the stream when there are new entries, or a new head, or when
+// it is time for it to terminate.
+//
+// NOTE: A subscriber that blocks in its callback blocks one thread of the dispatcher for as long as it does.
+// NOTE: The dispatcher must outlive the subscriptions it runs, the same way the subscribers themselves must.
+
+#ifndef CURRENT_STREAM_DISPATCHER_H
+#define CURRENT_STREAM_DISPATCHER_H
+
+#include "../port.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "../bricks/system/placement.h"
+
+namespace current {
+namespace stream {
+
+class SubscriberDispatcher;
+
+namespace impl {
+
+enum class DispatchedSubscriberStep : int { Done, More, Idle };
+
+// The dispatcher-facing state of a single subscriber. The `step` function is called by one thread at a time.
+class DispatchedSubscriber final {
+ public:
+  DispatchedSubscriber(SubscriberDispatcher& dispatcher, std::function<DispatchedSubscriberStep()> step)
+      : dispatcher_(dispatcher), step_(std::move(step)) {}
+
+  // Schedules the subscriber to be run, unless it is already scheduled or done. THREAD-SAFE.
+  inline void Wake();
+
+  // Waits until the step function has returned `Done`. THREAD-SAFE.
+  void WaitUntilDone() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_condition_variable_.wait(lock, [this]() { return state_ == State::Done; });
+  }
+
+  // Called by the threads of the dispatcher.
+  inline void Run();
+
+  SubscriberDispatcher& Dispatcher() const { return dispatcher_; }
+
+ private:
+  DispatchedSubscriber(const DispatchedSubscriber&) = delete;
+  DispatchedSubscriber& operator=(const DispatchedSubscriber&) = delete;
+
+  // `RunningAndWoken` is the subscriber being woken up while it is run, so that it gets run once more
+  // even if its present step concludes there is nothing to do.
+  enum class State : int { Idle, Queued, Running, RunningAndWoken, Done };
+
+  SubscriberDispatcher& dispatcher_;
+  const std::function<DispatchedSubscriberStep()> step_;
+  std::mutex mutex_;
+  std::condition_variable done_condition_variable_;
+  State state_ = State::Idle;
+};
+
+// The set of subscribers to wake up as the stream is published into. Kept by each stream.
+class DispatchedSubscribers final {
+ public:
+  // THREAD-SAFE.
+  void Register(DispatchedSubscriber& subscriber) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscribers_.insert(&subscriber);
+  }
+
+  // THREAD-SAFE.
+  void UnRegister(DispatchedSubscriber& subscriber) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscribers_.erase(&subscriber);
+  }
+
+  // THREAD-SAFE.
+  void WakeAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (DispatchedSubscriber* subscriber : subscribers_) {
+      subscriber->Wake();
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::unordered_set<DispatchedSubscriber*> subscribers_;
+};
+
+}  // namespace impl
+
+class SubscriberDispatcher final {
+ public:
+  explicit SubscriberDispatcher(size_t threads = std::thread::hardware_concurrency(),
+                                uint64_t max_entries_per_step = 1000u)
+      : max_entries_per_step_(max_entries_per_step ? max_entries_per_step : 1u) {
+    const size_t threads_count = threads ? threads : 1u;
+    threads_.reserve(threads_count);
+    for (size_t i = 0; i < threads_count; ++i) {
+      threads_.emplace_back(&SubscriberDispatcher::Thread, this);
+    }
+  }
+
+  ~SubscriberDispatcher() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      terminating_ = true;
+    }
+    condition_variable_.notify_all();
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  size_t ThreadsCount() const { return threads_.size(); }
+  uint64_t MaxEntriesPerStep() const { return max_entries_per_step_; }
+
+  // THREAD-SAFE.
+  void Enqueue(impl::DispatchedSubscriber& subscriber) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(&subscriber);
+    }
+    condition_variable_.notify_one();
+  }
+
+ private:
+  SubscriberDispatcher(const SubscriberDispatcher&) = delete;
+  SubscriberDispatcher& operator=(const SubscriberDispatcher&) = delete;
+
+  void Thread() {
+    current::bricks::system::ThreadPlacementPolicy().PlaceCurrentThread(
+        current::bricks::system::ThreadRole::StreamSubscriber);
+    while (true) {
+      impl::DispatchedSubscriber* subscriber;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_variable_.wait(lock, [this]() { return terminating_ || !queue_.empty(); });
+        if (queue_.empty()) {
+          return;
+        }
+        subscriber = queue_.front();
+        queue_.pop_front();
+      }
+      subscriber->Run();
+    }
+  }
+
+  const uint64_t max_entries_per_step_;
+  std::mutex mutex_;
+  std::condition_variable condition_variable_;
+  std::deque<impl::DispatchedSubscriber*> queue_;
+  bool terminating_ = false;
+  std::vector<std::thread> threads_;
+};
+
+namespace impl {
+
+inline void DispatchedSubscriber::Wake() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (state_ == State::Idle) {
+    state_ = State::Queued;
+    dispatcher_.Enqueue(*this);
+  } else if (state_ == State::Running) {
+    state_ = State::RunningAndWoken;
+  }
+}
+
+inline void DispatchedSubscriber::Run() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CURRENT_ASSERT(state_ == State::Queued);
+    state_ = State::Running;
+  }
+  const DispatchedSubscriberStep step = step_();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (step == DispatchedSubscriberStep::Done) {
+    state_ = State::Done;
+    // Notify while holding the mutex, as the waiting thread may destroy this object as soon as it wakes up.
+    done_condition_variable_.notify_all();
+  } else if (step == DispatchedSubscriberStep::More || state_ == State::RunningAndWoken) {
+    state_ = State::Queued;
+    dispatcher_.Enqueue(*this);
+  } else {
+    state_ = State::Idle;
+  }
+}
+
+}  // namespace impl
+
+}  // namespace stream
+}  // namespace current
+
+#endif  // CURRENT_STREAM_DISPATCHER_H
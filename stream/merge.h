@@ -0,0 +1,317 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// `MergedSubscription<ENTRY, F>` subscribes to several streams at once, and passes their entries to `f`
+// as one sequence, ordered by timestamp. The streams can be local `Stream`-s and `SubscribableRemoteStream`-s,
+// of the same or of different entry types, as long as each of them can be converted into `ENTRY`. The common
+// choice for `ENTRY` is the `Variant<>` of the entry types of the streams.
+//
+// Each stream is subscribed to as usual, and the entries it delivers are buffered per stream. The entries are
+// passed on once their timestamps are known to be the smallest: each stream either has a buffered entry with
+// a later or the same timestamp, or has reached a later or the same timestamp or head with no entries buffered.
+// Thus, a stream that has neither entries nor head updates holds back the whole merged subscription.
+//
+// The signature of `f` is `EntryResponse f(size_t source, const ENTRY& entry, idxts_t idxts)`, where `source`
+// is the 0-based position of the stream in the constructor, and `idxts` is the index and timestamp of the entry
+// in that stream. The entries with equal timestamps are passed in the order of their sources. Returning
+// `EntryResponse::Done` from `f` ends the merged subscription, as does destructing the `MergedSubscription`.
+//
+// Example:
+//   current::stream::MergedSubscription<Variant<Click, Impression>, Counter> merged(counter, *clicks, impressions);
+// where `clicks` is an `Owned<Stream<Click>>` and `impressions` is a `SubscribableRemoteStream<Impression>`.
+
+#ifndef CURRENT_STREAM_MERGE_H
+#define CURRENT_STREAM_MERGE_H
+
+#include "../port.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "stream_impl.h"
+
+#include "../blocks/ss/ss.h"
+
+#include "../bricks/system/placement.h"
+
+namespace current {
+namespace stream {
+
+struct MergedSubscriptionParams final {
+  // The number of entries received from each stream, but not yet passed on, beyond which that stream waits.
+  size_t max_buffered_entries_per_source = 1000u;
+  // The streams are subscribed to starting from this timestamp.
+  std::chrono::microseconds from_us = std::chrono::microseconds(0);
+};
+
+template <typename ENTRY, typename F>
+class MergedSubscription final {
+ public:
+  template <typename... STREAMS>
+  MergedSubscription(F& f, const STREAMS&... streams) : MergedSubscription(f, MergedSubscriptionParams(), streams...) {}
+
+  template <typename... STREAMS>
+  MergedSubscription(F& f, const MergedSubscriptionParams& params, const STREAMS&... streams)
+      : f_(f), max_buffered_(params.max_buffered_entries_per_source ? params.max_buffered_entries_per_source : 1u) {
+    static_assert(sizeof...(STREAMS) > 0u, "`MergedSubscription` requires at least one stream to subscribe to.");
+    sources_.reserve(sizeof...(STREAMS));
+    AddSources(params.from_us, streams...);
+    Start();
+  }
+
+  // The streams of the same type can also be passed in at runtime, such as the partitions of a `PartitionedStream`.
+  template <typename STREAM>
+  MergedSubscription(F& f, const std::vector<const STREAM*>& streams)
+      : MergedSubscription(f, MergedSubscriptionParams(), streams) {}
+
+  template <typename STREAM>
+  MergedSubscription(F& f, const MergedSubscriptionParams& params, const std::vector<const STREAM*>& streams)
+      : f_(f), max_buffered_(params.max_buffered_entries_per_source ? params.max_buffered_entries_per_source : 1u) {
+    CURRENT_ASSERT(!streams.empty());
+    sources_.reserve(streams.size());
+    for (const STREAM* stream : streams) {
+      AddSource(params.from_us, *stream);
+    }
+    Start();
+  }
+
+  ~MergedSubscription() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      terminating_ = true;
+    }
+    merge_condition_variable_.notify_all();
+    space_condition_variable_.notify_all();
+    thread_.join();
+    // The scopes wait for the subscribers to the streams to terminate, and the sources must outlive them.
+    scopes_.clear();
+  }
+
+  // Whether the entries are still being passed on, i.e. `f` has not returned `EntryResponse::Done`.
+  operator bool() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !terminating_;
+  }
+
+  size_t SourcesCount() const { return sources_.size(); }
+
+ private:
+  MergedSubscription(const MergedSubscription&) = delete;
+  MergedSubscription& operator=(const MergedSubscription&) = delete;
+
+  // The key of a source in the heap: the timestamp of its first buffered entry, or the timestamp in the stream
+  // it is known to have reached if it has no entries buffered. At equal timestamps, the buffered entries go first,
+  // as the next entry of a stream has a later timestamp than its last entry or its head. The keys only increase.
+  using key_t = std::pair<std::chrono::microseconds, bool>;
+
+  struct Source {
+    std::deque<std::pair<idxts_t, ENTRY>> buffered;
+    std::chrono::microseconds reached_us = std::chrono::microseconds::min();
+
+    key_t Key() const { return buffered.empty() ? key_t(reached_us, true) : key_t(buffered.front().first.us, false); }
+  };
+
+  // The subscriber to each of the streams, passing its entries into its `Source`.
+  template <typename SOURCE_ENTRY>
+  class SourceSubscriberImpl {
+   public:
+    SourceSubscriberImpl(MergedSubscription& self, size_t source_index) : self_(self), source_index_(source_index) {}
+
+    ss::EntryResponse operator()(const SOURCE_ENTRY& e, idxts_t current, idxts_t) {
+      return self_.Push(source_index_, ENTRY(e), current);
+    }
+    ss::EntryResponse operator()(SOURCE_ENTRY&& e, idxts_t current, idxts_t) {
+      return self_.Push(source_index_, ENTRY(std::move(e)), current);
+    }
+    ss::EntryResponse operator()(std::chrono::microseconds us) { return self_.PushHead(source_index_, us); }
+
+    ss::EntryResponse EntryResponseIfNoMorePassTypeFilter() const { return ss::EntryResponse::More; }
+    ss::TerminationResponse Terminate() const { return ss::TerminationResponse::Terminate; }
+
+   private:
+    MergedSubscription& self_;
+    const size_t source_index_;
+  };
+
+  template <typename SOURCE_ENTRY>
+  using source_subscriber_t = ss::StreamSubscriber<SourceSubscriberImpl<SOURCE_ENTRY>, SOURCE_ENTRY>;
+
+  void AddSources(std::chrono::microseconds) {}
+
+  template <typename STREAM, typename... STREAMS>
+  void AddSources(std::chrono::microseconds from_us, const STREAM& stream, const STREAMS&... streams) {
+    AddSource(from_us, stream);
+    AddSources(from_us, streams...);
+  }
+
+  template <typename STREAM>
+  void AddSource(std::chrono::microseconds from_us, const STREAM& stream) {
+    using source_entry_t = typename STREAM::entry_t;
+    static_assert(std::is_constructible_v<ENTRY, const source_entry_t&>,
+                  "Each stream of a `MergedSubscription<ENTRY>` must have entries convertible into `ENTRY`.");
+    const size_t source_index = sources_.size();
+    sources_.push_back(std::make_unique<Source>());
+    auto subscriber = std::make_shared<source_subscriber_t<source_entry_t>>(*this, source_index);
+    subscribers_.push_back(subscriber);
+    subscribes_.push_back([&stream, subscriber, from_us]() -> SubscriberScope {
+      return stream.Subscribe(*subscriber, 0u, from_us);
+    });
+  }
+
+  void Start() {
+    for (size_t i = 0u; i < sources_.size(); ++i) {
+      heap_.emplace(sources_[i]->Key(), i);
+    }
+    // Subscribe after all the sources have been added, as the subscribers may start delivering entries right away.
+    for (const auto& subscribe : subscribes_) {
+      scopes_.push_back(subscribe());
+    }
+    subscribes_.clear();
+    thread_ = std::thread(&MergedSubscription::Thread, this);
+  }
+
+  ss::EntryResponse Push(size_t source_index, ENTRY&& entry, idxts_t idxts) {
+    Source& source = *sources_[source_index];
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_condition_variable_.wait(lock, [this, &source]() {
+      return terminating_ || source.buffered.size() < max_buffered_;
+    });
+    if (terminating_) {
+      return ss::EntryResponse::Done;
+    }
+    const bool was_empty = source.buffered.empty();
+    source.buffered.emplace_back(idxts, std::move(entry));
+    source.reached_us = idxts.us;
+    lock.unlock();
+    if (was_empty) {
+      merge_condition_variable_.notify_one();
+    }
+    return ss::EntryResponse::More;
+  }
+
+  ss::EntryResponse PushHead(size_t source_index, std::chrono::microseconds us) {
+    Source& source = *sources_[source_index];
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (terminating_) {
+      return ss::EntryResponse::Done;
+    }
+    const bool was_empty = source.buffered.empty();
+    if (us > source.reached_us) {
+      source.reached_us = us;
+    }
+    lock.unlock();
+    if (was_empty) {
+      merge_condition_variable_.notify_one();
+    }
+    return ss::EntryResponse::More;
+  }
+
+  // Returns the index of the source to pass on the first buffered entry of next, or `sources_.size()` if the next
+  // entry is not known yet. Must be called with `mutex_` locked.
+  size_t NextSource() {
+    while (true) {
+      const auto top = heap_.top();
+      const key_t key = sources_[top.second]->Key();
+      if (key != top.first) {
+        // The keys only increase, so an outdated key in the heap is just moved further down.
+        heap_.pop();
+        heap_.emplace(key, top.second);
+      } else {
+        return key.second ? sources_.size() : top.second;
+      }
+    }
+  }
+
+  void Thread() {
+    current::bricks::system::ThreadPlacementPolicy().PlaceCurrentThread(
+        current::bricks::system::ThreadRole::StreamSubscriber);
+    // The entries are moved out of the buffers in batches, so that `f` is called with `mutex_` unlocked.
+    std::vector<std::pair<size_t, std::pair<idxts_t, ENTRY>>> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      size_t source_index;
+      merge_condition_variable_.wait(lock, [this, &source_index]() {
+        source_index = terminating_ ? sources_.size() : NextSource();
+        return terminating_ || source_index != sources_.size();
+      });
+      if (terminating_) {
+        return;
+      }
+      bool sources_had_no_space = false;
+      do {
+        Source& source = *sources_[source_index];
+        sources_had_no_space |= (source.buffered.size() >= max_buffered_);
+        batch.emplace_back(source_index, std::move(source.buffered.front()));
+        source.buffered.pop_front();
+        source_index = NextSource();
+      } while (source_index != sources_.size() && batch.size() < max_buffered_);
+      lock.unlock();
+      if (sources_had_no_space) {
+        space_condition_variable_.notify_all();
+      }
+      bool done = false;
+      for (const auto& e : batch) {
+        if (f_(e.first, e.second.second, e.second.first) == ss::EntryResponse::Done) {
+          done = true;
+          break;
+        }
+      }
+      batch.clear();
+      lock.lock();
+      if (done) {
+        terminating_ = true;
+        space_condition_variable_.notify_all();
+        return;
+      }
+    }
+  }
+
+  F& f_;
+  const size_t max_buffered_;
+  std::vector<std::unique_ptr<Source>> sources_;
+  std::vector<std::shared_ptr<void>> subscribers_;
+  std::vector<std::function<SubscriberScope()>> subscribes_;
+  mutable std::mutex mutex_;
+  std::condition_variable merge_condition_variable_;
+  std::condition_variable space_condition_variable_;
+  std::priority_queue<std::pair<key_t, size_t>, std::vector<std::pair<key_t, size_t>>, std::greater<>> heap_;
+  bool terminating_ = false;
+  std::vector<SubscriberScope> scopes_;
+  std::thread thread_;
+};
+
+}  // namespace stream
+}  // namespace current
+
+#endif  // CURRENT_STREAM_MERGE_H
@@ -0,0 +1,185 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// `OrderedParallelParser<T>` parses lines into `T`-s on a pool of threads, and applies the results on the calling
+// thread, in the order the lines were added. Used by the followers to parse the replicated entries on more than
+// one core, while still publishing them one by one, in the order of their indexes.
+//
+// At most `depth` lines are in flight: parsed, being parsed, or waiting to be applied. Once there are that many,
+// `Add()` waits for the oldest one to be parsed, and applies it, before accepting the next one.
+
+#ifndef CURRENT_STREAM_ORDERED_PARALLEL_PARSER_H
+#define CURRENT_STREAM_ORDERED_PARALLEL_PARSER_H
+
+#include "../port.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace current {
+namespace stream {
+
+// How many threads should the followers parse the replicated entries on, see `ReplicationMode::Checked`.
+struct ReplicationParallelism final {
+  // Zero is the default, to parse the entries on the thread receiving them.
+  size_t threads = 0u;
+  // The maximum number of entries received but not yet published.
+  size_t pipeline_depth = 1000u;
+};
+
+namespace impl {
+
+template <typename T>
+class OrderedParallelParser final {
+ public:
+  // Called on the threads of the parser, must not throw.
+  using parse_t = std::function<void(std::string& line, T& result)>;
+
+  OrderedParallelParser(size_t threads, size_t depth, parse_t parse)
+      : parse_(std::move(parse)), slots_(depth ? depth : 1u) {
+    const size_t threads_count = threads ? threads : 1u;
+    threads_.reserve(threads_count);
+    for (size_t i = 0; i < threads_count; ++i) {
+      threads_.emplace_back(&OrderedParallelParser::Thread, this);
+    }
+  }
+
+  ~OrderedParallelParser() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      terminating_ = true;
+    }
+    parse_condition_variable_.notify_all();
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  // Schedules the line to be parsed, applying the results that are ready in the meantime.
+  template <typename F>
+  void Add(const char* line, size_t length, F&& apply) {
+    ApplyParsed(apply, slots_.size() - 1u);
+    Slot& slot = slots_[added_ % slots_.size()];
+    slot.line.assign(line, length);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      slot.parsed = false;
+      ++added_;
+    }
+    parse_condition_variable_.notify_one();
+  }
+
+  // Waits for all the lines added to be parsed, and applies their results.
+  template <typename F>
+  void Flush(F&& apply) {
+    ApplyParsed(apply, 0u);
+  }
+
+  // Discards the lines not applied yet, once their results are of no use, i.e. after `apply` has thrown.
+  void Clear() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (; applied_ < added_; ++applied_) {
+      const Slot& slot = slots_[applied_ % slots_.size()];
+      parsed_condition_variable_.wait(lock, [&slot]() { return slot.parsed; });
+    }
+  }
+
+ private:
+  OrderedParallelParser(const OrderedParallelParser&) = delete;
+  OrderedParallelParser& operator=(const OrderedParallelParser&) = delete;
+
+  struct Slot final {
+    std::string line;
+    T result;
+    bool parsed = false;
+  };
+
+  // Applies the results in order, for as long as they are ready, or while more than `max_in_flight` lines are.
+  template <typename F>
+  void ApplyParsed(F& apply, size_t max_in_flight) {
+    while (true) {
+      Slot* slot;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (applied_ == added_) {
+          return;
+        }
+        slot = &slots_[applied_ % slots_.size()];
+        if (!slot->parsed) {
+          if (added_ - applied_ <= max_in_flight) {
+            return;
+          }
+          parsed_condition_variable_.wait(lock, [slot]() { return slot->parsed; });
+        }
+        // Count the result as applied first, so that the state stays consistent if `apply` throws.
+        ++applied_;
+      }
+      apply(std::move(slot->result));
+    }
+  }
+
+  void Thread() {
+    while (true) {
+      Slot* slot;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        parse_condition_variable_.wait(lock, [this]() { return terminating_ || next_to_parse_ < added_; });
+        if (terminating_) {
+          return;
+        }
+        slot = &slots_[next_to_parse_ % slots_.size()];
+        ++next_to_parse_;
+      }
+      parse_(slot->line, slot->result);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slot->parsed = true;
+      }
+      parsed_condition_variable_.notify_one();
+    }
+  }
+
+  const parse_t parse_;
+  std::vector<Slot> slots_;
+  std::mutex mutex_;
+  std::condition_variable parse_condition_variable_;
+  std::condition_variable parsed_condition_variable_;
+  // The sequence numbers of the lines: `applied_ <= next_to_parse_ <= added_`.
+  uint64_t added_ = 0u;
+  uint64_t next_to_parse_ = 0u;
+  uint64_t applied_ = 0u;
+  bool terminating_ = false;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace impl
+
+}  // namespace stream
+}  // namespace current
+
+#endif  // CURRENT_STREAM_ORDERED_PARALLEL_PARSER_H
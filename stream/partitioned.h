@@ -0,0 +1,182 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// `PartitionedStream<ENTRY>` is one logical stream sharded across several `Stream<ENTRY>`-s, the partitions.
+// Each partition has its own persister and its own publishing mutex, so that publishing into different partitions
+// does not contend. The partition of each entry is chosen by a key provided by the publisher.
+//
+// The keys are hashed in a way that does not change between runs, for the persisted partitions to stay meaningful:
+// strings by their CRC32, integers by their values, and the rest of the types via `std::hash<>`.
+//
+// The order of entries, as well as the strictly increasing timestamps, are only guaranteed within each partition.
+// To subscribe:
+// * to one partition, subscribe to `Partition(i)` as to any other stream,
+// * to several partitions, or to all of them, construct a `MergedSubscription` from `Partitions({...})` or
+//   `Partitions()`, which passes the entries ordered by timestamp; see `merge.h`. An idle partition holds back
+//   such a merged view, so `UpdateHead()`, which updates the heads of all the partitions, should be called
+//   as time goes by.
+//
+// Via HTTP, the partitioned stream serves each partition as a regular stream would, selected by `?partition=i`.
+
+#ifndef CURRENT_STREAM_PARTITIONED_H
+#define CURRENT_STREAM_PARTITIONED_H
+
+#include "../port.h"
+
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "merge.h"
+#include "stream.h"
+
+#include "../bricks/util/crc32.h"
+
+namespace current {
+namespace stream {
+
+namespace impl {
+
+template <typename K, bool IS_INTEGRAL = std::is_integral_v<K> || std::is_enum_v<K>>
+struct PartitionKeyHash {
+  static uint64_t Hash(const K& key) { return static_cast<uint64_t>(std::hash<K>()(key)); }
+};
+
+template <typename K>
+struct PartitionKeyHash<K, true> {
+  static uint64_t Hash(K key) { return static_cast<uint64_t>(key); }
+};
+
+template <>
+struct PartitionKeyHash<std::string, false> {
+  static uint64_t Hash(const std::string& key) { return CRC32(key); }
+};
+
+}  // namespace impl
+
+template <typename ENTRY, template <typename> class PERSISTENCE_LAYER = DEFAULT_PERSISTENCE_LAYER>
+class PartitionedStream final {
+ public:
+  using entry_t = ENTRY;
+  using stream_t = Stream<ENTRY, PERSISTENCE_LAYER>;
+  using partition_factory_t = std::function<Owned<stream_t>(size_t partition)>;
+
+  // Creates the partitions with no construction parameters, i.e. the in-memory ones.
+  explicit PartitionedStream(size_t partitions_count)
+      : PartitionedStream(partitions_count, [](size_t) { return stream_t::CreateStream(); }) {}
+
+  // Creates the partitions via `create_partition(i)`, i.e. `stream_t::CreateStream(file_name_prefix + ToString(i))`.
+  PartitionedStream(size_t partitions_count, partition_factory_t create_partition) {
+    CURRENT_ASSERT(partitions_count > 0u);
+    partitions_.reserve(partitions_count);
+    for (size_t i = 0u; i < partitions_count; ++i) {
+      partitions_.push_back(create_partition(i));
+    }
+  }
+
+  size_t PartitionsCount() const { return partitions_.size(); }
+
+  template <typename K>
+  size_t PartitionOf(const K& key) const {
+    return static_cast<size_t>(impl::PartitionKeyHash<current::decay_t<K>>::Hash(key) % partitions_.size());
+  }
+
+  stream_t& Partition(size_t partition) { return *partitions_.at(partition); }
+  const stream_t& Partition(size_t partition) const { return *partitions_.at(partition); }
+
+  std::vector<const stream_t*> Partitions() const {
+    std::vector<const stream_t*> result;
+    for (const auto& partition : partitions_) {
+      result.push_back(&*partition);
+    }
+    return result;
+  }
+
+  std::vector<const stream_t*> Partitions(const std::vector<size_t>& partitions) const {
+    std::vector<const stream_t*> result;
+    for (size_t partition : partitions) {
+      result.push_back(&*partitions_.at(partition));
+    }
+    return result;
+  }
+
+  // Publishes the entry into the partition of `key`, returning its index and timestamp within that partition.
+  // CAN THROW `PublisherNotAvailableException`, if that partition is presently following another stream.
+  template <typename K, typename E>
+  idxts_t Publish(const K& key, E&& e) {
+    return partitions_[PartitionOf(key)]->Publisher()->Publish(std::forward<E>(e));
+  }
+
+  template <typename K, typename E>
+  idxts_t Publish(const K& key, E&& e, std::chrono::microseconds us) {
+    return partitions_[PartitionOf(key)]->Publisher()->Publish(std::forward<E>(e), us);
+  }
+
+  void UpdateHead() {
+    for (auto& partition : partitions_) {
+      partition->Publisher()->UpdateHead();
+    }
+  }
+
+  void UpdateHead(std::chrono::microseconds us) {
+    for (auto& partition : partitions_) {
+      partition->Publisher()->UpdateHead(us);
+    }
+  }
+
+  // The schema requests are the same for all the partitions, and are served without the `?partition` parameter.
+  void operator()(Request r) {
+    if (r.url.query.has("partition")) {
+      const std::string& value = r.url.query["partition"];
+      const size_t partition = current::FromString<size_t>(value);
+      if (!value.empty() && current::ToString(partition) == value && partition < partitions_.size()) {
+        (*partitions_[partition])(std::move(r));
+      } else {
+        r(InvalidPartitionMessage(), HTTPResponseCode.BadRequest);
+      }
+    } else if (!r.url_path_args.empty()) {
+      (*partitions_.front())(std::move(r));
+    } else {
+      r(InvalidPartitionMessage(), HTTPResponseCode.BadRequest);
+    }
+  }
+
+ private:
+  PartitionedStream(const PartitionedStream&) = delete;
+  PartitionedStream& operator=(const PartitionedStream&) = delete;
+
+  std::string InvalidPartitionMessage() const {
+    return "The `?partition` parameter is required, legal values are from `0` to `" +
+           current::ToString(partitions_.size() - 1u) + "`.\n";
+  }
+
+  std::vector<Owned<stream_t>> partitions_;
+};
+
+}  // namespace stream
+}  // namespace current
+
+#endif  // CURRENT_STREAM_PARTITIONED_H
@@ -28,7 +28,11 @@ SOFTWARE.
 
 #include "../port.h"
 
+#include <algorithm>
+#include <cstring>
+#include <string_view>
 #include <utility>
+#include <vector>
 
 #include "stream_impl.h"
 
@@ -37,6 +41,7 @@ SOFTWARE.
 #include "../blocks/http/api.h"
 #include "../blocks/ss/ss.h"
 
+#include "../bricks/strings/split.h"
 #include "../bricks/sync/owned_borrowed.h"
 #include "../bricks/time/chrono.h"
 
@@ -106,13 +111,28 @@ SOFTWARE.
 //
 //    `stop_after_bytes`  : If set, stop streaming as soon as total JTML response size exceeds certain size.
 //                          This flag is used for backup purposes.
-// 4. Special parameters.
+//
+// 4. Filtering by type.
+//
+//    `type` : For streams of `Variant`-s, the comma-separated list of the cases to return, i.e. `&type=A,B`.
+//             The entries of other types are skipped, and do not count towards `n` or `stop_after_bytes`.
+//
+//             Unless `checked` is set, the entries are not parsed to filter them. The case of a persisted
+//             `Variant` is the leading key of its JSON, so the raw entry is matched against `{"A":` and `{"B":`.
+//
+// 5. Special parameters.
 //
 //    `sizeonly`   : Instead of the actual data, return the total number of records in the stream.
 //
 //    HEAD request : Same as `sizeonly`, but return the total number of records in HTTP header, not body.
 //
 //    `terminate`  : Terminate HTTP connection for the subscription id passed as the value of this parameter.
+//
+//    `bulk`       : Instead of subscribing, return the entries from `i`, up to `n` of them, in one response,
+//                   as they are in the persisted file, for the new followers to catch up in bulk.
+//                   The response is capped at `stop_after_bytes`, 16MB by default, and its `X-Current-Stream-Bulk-*`
+//                   headers carry the index range and the CRC32C of the body. "204 No Content" if there are no
+//                   entries from `i` on, and "501 Not Implemented" if the persister does not keep the raw log lines.
 
 // TODO(dkorolev): Add timestamps to `sizeonly` and `HEAD` too?
 // TODO(dkorolev): Mention head updates now as we're here?
@@ -124,6 +144,8 @@ struct ParsedHTTPRequestParams {
   // If set, return current stream size.
   // Controlled by `sizeonly` URL parameter or using `HEAD` method.
   bool size_only = false;
+  // If set, return the persisted entries as is, in one response. Controlled by `bulk` URL parameter.
+  bool bulk = false;
   // If set, termination of the HTTP connection is requested.
   // Controlled by `terminate` URL parameter.
   bool terminate_requested = false;
@@ -161,6 +183,9 @@ struct ParsedHTTPRequestParams {
   // If set, parse and validate each entry before sending it.
   // If not, skip the validation (using the "unsafe" iteration) to speed up the communication.
   bool checked = false;
+  // If set, the names of the cases of the `Variant` to return, the other entries are skipped.
+  // Controlled by `type` URL parameter, comma-separated.
+  std::vector<std::string> types;
 };
 
 inline ParsedHTTPRequestParams ParsePubSubHTTPRequest(const Request& r) {
@@ -174,6 +199,10 @@ inline ParsedHTTPRequestParams ParsePubSubHTTPRequest(const Request& r) {
     result.size_only = true;
   }
 
+  if (r.url.query.has("bulk")) {
+    result.bulk = true;
+  }
+
   if (r.url.query.has("schema")) {
     result.schema_requested = true;
     result.schema_format = r.url.query["schema"];
@@ -225,10 +254,32 @@ inline ParsedHTTPRequestParams ParsePubSubHTTPRequest(const Request& r) {
   if (r.url.query.has("checked")) {
     result.checked = true;
   }
+  if (r.url.query.has("type")) {
+    result.types = current::strings::Split(r.url.query["type"], ',');
+  }
 
   return result;
 }
 
+namespace impl {
+
+// The names of the cases of the `Variant` `E`, as they are the keys in its JSON; empty if `E` is not a `Variant`.
+template <typename E, bool = IS_CURRENT_VARIANT(E)>
+struct VariantCaseNames {
+  static std::vector<std::string> Get() { return {}; }
+};
+
+template <typename E>
+struct VariantCaseNames<E, true> {
+  static std::vector<std::string> Get() { return Get(typename E::typelist_t()); }
+  template <typename... TS>
+  static std::vector<std::string> Get(current::metaprogramming::TypeListImpl<TS...>) {
+    return {reflection::CurrentTypeName<TS, reflection::NameFormat::Z>()...};
+  }
+};
+
+}  // namespace impl
+
 template <typename E, template <typename> class PERSISTENCE_LAYER, class J>
 class PubSubHTTPEndpointImpl : public AbstractSubscriberObject {
  public:
@@ -237,10 +288,12 @@ class PubSubHTTPEndpointImpl : public AbstractSubscriberObject {
   PubSubHTTPEndpointImpl(const std::string& subscription_id,
                          Borrowed<impl_t> data,
                          Request r,
-                         ParsedHTTPRequestParams params)
+                         ParsedHTTPRequestParams params,
+                         HTTPSubscriberFlowControl flow_control = HTTPSubscriberFlowControl())
       : impl_(std::move(data), [this]() { time_to_terminate_ = true; }),
         http_request_(std::move(r)),
         params_(std::move(params)),
+        flow_control_(std::move(flow_control)),
         output_started_(false),
         http_response_(http_request_.SendChunkedResponse(
             HTTPResponseCode.OK,
@@ -259,6 +312,15 @@ class PubSubHTTPEndpointImpl : public AbstractSubscriberObject {
     if (params_.n > 0u) {
       n_ = params_.n;
     }
+    for (const std::string& type : params_.types) {
+      type_prefixes_.push_back("{\"" + type + "\":");
+    }
+    if (flow_control_.send_buffer_size) {
+      http_request_.connection.RawConnection().SetSendBufferSize(flow_control_.send_buffer_size);
+    }
+    if (flow_control_.write_timeout.count()) {
+      http_request_.connection.RawConnection().SetWriteTimeout(flow_control_.write_timeout);
+    }
   }
 
   // The implementation of the subscriber in `PubSubHTTPEndpointImpl` is an example of using:
@@ -271,6 +333,11 @@ class PubSubHTTPEndpointImpl : public AbstractSubscriberObject {
       if (time_to_terminate_) {
         return ss::EntryResponse::Done;
       }
+      next_index_ = current.index + 1u;
+      // Respect `type`.
+      if (!params_.types.empty() && !EntryPassesTypeFilter(entry)) {
+        return (current.index == last.index && params_.no_wait) ? ss::EntryResponse::Done : ss::EntryResponse::More;
+      }
       // TODO(dkorolev): Should we always extract the timestamp and throw an exception if there is a mismatch?
       if (!serving_) {
         if (current.index >= params_.i &&                                           // Respect `i`.
@@ -292,14 +359,20 @@ class PubSubHTTPEndpointImpl : public AbstractSubscriberObject {
         if (to_timestamp_.count() && current.us > to_timestamp_) {
           return ss::EntryResponse::Done;
         }
-        const std::string entry_json = [this, &current, &entry]() {
-          if (params_.entries_only) {
-            return JSON<J>(entry) + '\n';
-          } else {
-            return JSON<J>(current) + '\t' + JSON<J>(entry) + '\n';
-          }
-        }();
+        // Respect the flow control policy.
+        const FlowControlDecision decision = ApplyFlowControl(current.index, last.index);
+        if (decision != FlowControlDecision::Serve) {
+          return decision == FlowControlDecision::Skip ? ss::EntryResponse::More : ss::EntryResponse::Done;
+        }
+        std::string entry_json;
+        if (!params_.entries_only) {
+          entry_json = JSON<J>(current) + '\t';
+        }
+        impl_->http_serialized_entries.template AppendJSON<J>(entry, current.index, entry_json);
+        entry_json += '\n';
         current_response_size_ += entry_json.length();
+        sent_bytes_ += entry_json.length();
+        ++sent_entries_;
         try {
           if (params_.array) {
             if (!output_started_) {
@@ -311,6 +384,7 @@ class PubSubHTTPEndpointImpl : public AbstractSubscriberObject {
           }
           http_response_(std::move(entry_json));
         } catch (const current::net::NetworkException&) {  // LCOV_EXCL_LINE
+          can_no_longer_write_ = true;                     // LCOV_EXCL_LINE
           return ss::EntryResponse::Done;                  // LCOV_EXCL_LINE
         }
         // Respect `stop_after_bytes`.
@@ -331,12 +405,8 @@ class PubSubHTTPEndpointImpl : public AbstractSubscriberObject {
       }
       return ss::EntryResponse::More;
     }();
-    if (result == ss::EntryResponse::Done && params_.array) {
-      if (!output_started_) {
-        http_response_("[]\n");
-      } else {
-        http_response_("]\n");
-      }
+    if (result == ss::EntryResponse::Done) {
+      EndResponse(false);
     }
     return result;
   }
@@ -346,6 +416,12 @@ class PubSubHTTPEndpointImpl : public AbstractSubscriberObject {
       if (time_to_terminate_) {
         return ss::EntryResponse::Done;
       }
+      next_index_ = current_index + 1u;
+      // Respect `type`.
+      if (!type_prefixes_.empty() &&
+          !RawEntryPassesTypeFilter(raw_log_line.data(), raw_log_line.data() + raw_log_line.length())) {
+        return (current_index == last.index && params_.no_wait) ? ss::EntryResponse::Done : ss::EntryResponse::More;
+      }
       auto current_us = std::chrono::microseconds(0);
       // Obtain current timestamp only when it's necessary by parsing the `raw_log_line`.
       const auto GetCurrentUs = [&current_us, &raw_log_line]() -> std::chrono::microseconds {
@@ -374,6 +450,11 @@ class PubSubHTTPEndpointImpl : public AbstractSubscriberObject {
         if (to_timestamp_.count() && GetCurrentUs() > to_timestamp_) {
           return ss::EntryResponse::Done;
         }
+        // Respect the flow control policy.
+        const FlowControlDecision decision = ApplyFlowControl(current_index, last.index);
+        if (decision != FlowControlDecision::Serve) {
+          return decision == FlowControlDecision::Skip ? ss::EntryResponse::More : ss::EntryResponse::Done;
+        }
         const std::string response_data = [this, &raw_log_line]() {
           if (!params_.entries_only) {
             return raw_log_line;
@@ -383,6 +464,8 @@ class PubSubHTTPEndpointImpl : public AbstractSubscriberObject {
           }
         }() + '\n';
         current_response_size_ += response_data.length();
+        sent_bytes_ += response_data.length();
+        ++sent_entries_;
         try {
           if (params_.array) {
             if (!output_started_) {
@@ -396,6 +479,7 @@ class PubSubHTTPEndpointImpl : public AbstractSubscriberObject {
               response_data,
               current_index == last.index ? current::net::ChunkFlush::Flush : current::net::ChunkFlush::NoFlush);
         } catch (const current::net::NetworkException&) {  // LCOV_EXCL_LINE
+          can_no_longer_write_ = true;                     // LCOV_EXCL_LINE
           return ss::EntryResponse::Done;                  // LCOV_EXCL_LINE
         }
         // Respect `stop_after_bytes`.
@@ -417,18 +501,90 @@ class PubSubHTTPEndpointImpl : public AbstractSubscriberObject {
       return ss::EntryResponse::More;
     }();
     if (result == ss::EntryResponse::Done) {
-      if (params_.array) {
-        if (!output_started_) {
-          http_response_("[]\n");
-        } else {
-          http_response_("]\n");
+      EndResponse(true);
+    }
+    return result;
+  }
+
+  // The entries exactly as persisted, in spans, sent as is when no per-entry transformation or check is needed,
+  // so that catching up on lots of data costs next to no CPU on the serving side.
+  ss::EntryResponse operator()(const ss::RawEntriesSpan& span, idxts_t last) {
+    if (time_to_terminate_) {
+      return ss::EntryResponse::Done;
+    }
+    if (!serving_ || params_.entries_only || params_.array || params_.period.count() || params_.stop_after_bytes ||
+        !type_prefixes_.empty()) {
+      // Fall back to serving entry by entry.
+      const char* p = span.data;
+      for (uint64_t index = span.begin_index; index < span.end_index; ++index) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', span.size - (p - span.data)));
+        CURRENT_ASSERT(eol);
+        // Skip the entries of other types right away, without copying them, unless it's time to stop.
+        const bool skip = !type_prefixes_.empty() && !RawEntryPassesTypeFilter(p, eol) &&
+                          !(index == last.index && params_.no_wait);
+        if (!skip && (*this)(std::string(p, eol), index, last) == ss::EntryResponse::Done) {
+          return ss::EntryResponse::Done;
         }
-      } else {
-        // flush cached response data.
-        http_response_("", current::net::ChunkFlush::Flush);
+        p = eol + 1;
       }
+      next_index_ = span.end_index;
+      return ss::EntryResponse::More;
     }
-    return result;
+    // Respect the flow control policy. The lag only decreases along the span, so only its beginning may be skipped.
+    const char* begin = span.data;
+    uint64_t begin_index = span.begin_index;
+    while (begin_index < span.end_index) {
+      const FlowControlDecision decision = ApplyFlowControl(begin_index, last.index);
+      if (decision == FlowControlDecision::Serve) {
+        break;
+      } else if (decision == FlowControlDecision::Disconnect) {
+        EndResponse(true);
+        return ss::EntryResponse::Done;
+      }
+      begin = static_cast<const char*>(std::memchr(begin, '\n', span.size - (begin - span.data))) + 1;
+      ++begin_index;
+    }
+    next_index_ = span.end_index;
+    if (begin_index == span.end_index) {
+      return ss::EntryResponse::More;
+    }
+    // Respect `n`, by cutting the span short if needed.
+    uint64_t end_index = span.end_index;
+    size_t size = span.size - static_cast<size_t>(begin - span.data);
+    if (n_ && n_ < end_index - begin_index) {
+      const char* p = begin;
+      for (uint64_t i = 0u; i < n_; ++i) {
+        p = static_cast<const char*>(std::memchr(p, '\n', span.size - (p - span.data))) + 1;
+      }
+      end_index = begin_index + n_;
+      size = static_cast<size_t>(p - begin);
+      next_index_ = end_index;
+    }
+    current_response_size_ += size;
+    sent_bytes_ += size;
+    sent_entries_ += end_index - begin_index;
+    const bool reached_last = (end_index - 1u == last.index);
+    try {
+      http_response_(std::string_view(begin, size),
+                     reached_last ? current::net::ChunkFlush::Flush : current::net::ChunkFlush::NoFlush);
+    } catch (const current::net::NetworkException&) {  // LCOV_EXCL_LINE
+      can_no_longer_write_ = true;                     // LCOV_EXCL_LINE
+      return ss::EntryResponse::Done;                  // LCOV_EXCL_LINE
+    }
+    bool done = false;
+    if (n_) {
+      n_ -= end_index - begin_index;
+      done = !n_;
+    }
+    // Respect `no_wait`.
+    if (reached_last && params_.no_wait) {
+      done = true;
+    }
+    if (done) {
+      EndResponse(true);
+      return ss::EntryResponse::Done;
+    }
+    return ss::EntryResponse::More;
   }
 
   ss::EntryResponse operator()(std::chrono::microseconds us) {
@@ -461,6 +617,15 @@ class PubSubHTTPEndpointImpl : public AbstractSubscriberObject {
     return (time_to_terminate_ || params_.no_wait) ? ss::EntryResponse::Done : ss::EntryResponse::More;
   }
 
+  HTTPSubscriberStatus Status() const override {
+    HTTPSubscriberStatus status;
+    status.next_index = next_index_;
+    status.sent_entries = sent_entries_;
+    status.skipped_entries = skipped_entries_;
+    status.sent_bytes = sent_bytes_;
+    return status;
+  }
+
   // LCOV_EXCL_START
   ss::TerminationResponse Terminate() {
     static const std::string message = "{\"error\":\"The subscriber has terminated.\"}\n";
@@ -474,6 +639,72 @@ class PubSubHTTPEndpointImpl : public AbstractSubscriberObject {
   // LCOV_EXCL_STOP
 
  private:
+  enum class FlowControlDecision : int { Serve, Skip, Disconnect };
+
+  // Respects `flow_control_.policy`, given the index of the entry to serve and the index of the last one.
+  FlowControlDecision ApplyFlowControl(uint64_t index, uint64_t last_index) {
+    if (flow_control_.policy == SlowHTTPSubscriberPolicy::Block || !flow_control_.lag_high_watermark) {
+      return FlowControlDecision::Serve;
+    }
+    if (index >= skip_until_index_ && last_index - index > flow_control_.lag_high_watermark) {
+      if (flow_control_.policy == SlowHTTPSubscriberPolicy::Disconnect) {
+        return FlowControlDecision::Disconnect;
+      }
+      skip_until_index_ = last_index - std::min(flow_control_.lag_low_watermark, flow_control_.lag_high_watermark);
+    }
+    if (index < skip_until_index_) {
+      ++skipped_entries_;
+      return FlowControlDecision::Skip;
+    }
+    return FlowControlDecision::Serve;
+  }
+
+  // Closes the JSON array if `array` is set, or flushes the cached data if `flush` is set,
+  // unless writing to the subscriber has already failed, so as to not block on a stalled one once again.
+  void EndResponse(bool flush) {
+    if (can_no_longer_write_) {
+      return;
+    }
+    try {
+      if (params_.array) {
+        if (!output_started_) {
+          http_response_("[]\n");
+        } else {
+          http_response_("]\n");
+        }
+      } else if (flush) {
+        http_response_("", current::net::ChunkFlush::Flush);
+      }
+    } catch (const current::net::NetworkException&) {  // LCOV_EXCL_LINE
+      can_no_longer_write_ = true;                     // LCOV_EXCL_LINE
+    }
+  }
+
+  bool EntryPassesTypeFilter(const E& entry) const {
+    if constexpr (IS_CURRENT_VARIANT(E)) {
+      const char* name = nullptr;
+      entry.Call([&name](const auto& value) {
+        name = reflection::CurrentTypeName<current::decay_t<decltype(value)>, reflection::NameFormat::Z>();
+      });
+      return std::find(params_.types.begin(), params_.types.end(), name) != params_.types.end();
+    } else {
+      return true;
+    }
+  }
+
+  // Tells whether the persisted entry, `{index,us}\t{JSON}`, is of one of the requested types, without parsing it.
+  bool RawEntryPassesTypeFilter(const char* begin, const char* end) const {
+    const char* tab = static_cast<const char*>(std::memchr(begin, '\t', end - begin));
+    const char* json = tab ? tab + 1 : begin;
+    const size_t length = static_cast<size_t>(end - json);
+    for (const std::string& prefix : type_prefixes_) {
+      if (prefix.length() <= length && !std::memcmp(json, prefix.data(), prefix.length())) {
+        return true;
+      }
+    }
+    return false;
+  }
+
   // The HTTP listener must register itself as a user of stream data to ensure the lifetime of stream data.
   const BorrowedWithCallback<impl_t> impl_;
   std::atomic_bool time_to_terminate_{false};
@@ -481,6 +712,7 @@ class PubSubHTTPEndpointImpl : public AbstractSubscriberObject {
   // `http_request_`:  need to keep the passed in request in scope for the lifetime of the chunked response.
   Request http_request_;
   ParsedHTTPRequestParams params_;
+  const HTTPSubscriberFlowControl flow_control_;
   // `output_started_`: will change to `true` is `params_.array` is `true` as the first piece of data
   // has already been sent, thus triggering the need to close the array at the end.
   bool output_started_ = false;
@@ -489,6 +721,8 @@ class PubSubHTTPEndpointImpl : public AbstractSubscriberObject {
       http_response_;
   // Current response size in bytes.
   size_t current_response_size_ = 0u;
+  // Set once a write has failed, or has timed out, to not attempt to end the response.
+  bool can_no_longer_write_ = false;
 
   // Conditions on which parts of the stream to serve.
   bool serving_ = true;
@@ -498,6 +732,17 @@ class PubSubHTTPEndpointImpl : public AbstractSubscriberObject {
   std::chrono::microseconds to_timestamp_ = std::chrono::microseconds(0);
   // Remaining number of records to return. Initialized if `n` URL parameter is set.
   uint64_t n_ = 0u;
+  // Set if `SlowHTTPSubscriberPolicy::SkipToHead` is being applied.
+  uint64_t skip_until_index_ = 0u;
+
+  // The numbers reported by `Status()`.
+  std::atomic<uint64_t> next_index_{0u};
+  std::atomic<uint64_t> sent_entries_{0u};
+  std::atomic<uint64_t> skipped_entries_{0u};
+  std::atomic<uint64_t> sent_bytes_{0u};
+
+  // The leading `{"Type":` of the JSONs of the entries to return. Initialized if `type` URL parameter is set.
+  std::vector<std::string> type_prefixes_;
 
   PubSubHTTPEndpointImpl() = delete;
   PubSubHTTPEndpointImpl(const PubSubHTTPEndpointImpl&) = delete;
@@ -0,0 +1,239 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2016 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// `ReadModel<MODEL, STREAM>` maintains a structure derived from the entries of a stream, incrementally.
+//
+// The `MODEL` is a `CURRENT_STRUCT` with the `void Apply(const ENTRY& entry, idxts_t idx_ts)` method. The read model
+// subscribes to the stream, applies each entry to the model, and publishes the result for the readers to access
+// concurrently via `Snapshot()`, which returns an immutable `ReadModelCheckpoint<MODEL>`: the model as of right
+// after the entry at `next_index - 1`.
+//
+// If a checkpoint file name is given, the published model is periodically saved there, along with the index and
+// the timestamp of the last entry applied to it, and on restart the read model resumes from the checkpoint instead
+// of replaying the stream from its very first entry. The checkpoint is ignored if the stream does not have the entry
+// it was taken at, with the very timestamp, i.e. if it was taken off a different stream.
+//
+// The model is double-buffered: the subscriber thread applies the entries to one copy while the readers are looking
+// at the other, and the two are swapped once a batch of entries is applied. The entries of the batch are then applied
+// to the other copy too, once no reader is holding on to it. Should the readers keep the old snapshot for longer than
+// that, the new snapshot is copied instead, so that the subscriber thread never waits on the readers.
+
+#ifndef CURRENT_STREAM_READ_MODEL_H
+#define CURRENT_STREAM_READ_MODEL_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "stream.h"
+
+#include "../blocks/ss/ss.h"
+
+#include "../bricks/file/file.h"
+#include "../bricks/time/chrono.h"
+
+#include "../typesystem/serialization/json.h"
+
+namespace current {
+namespace stream {
+
+CURRENT_STRUCT_T(ReadModelCheckpoint) {
+  CURRENT_FIELD(next_index, uint64_t, 0ull);
+  CURRENT_FIELD_DESCRIPTION(next_index, "The index of the first entry not yet applied to the model.");
+  CURRENT_FIELD(last_us, std::chrono::microseconds, std::chrono::microseconds(0));
+  CURRENT_FIELD_DESCRIPTION(last_us, "The timestamp of the last entry applied to the model.");
+  CURRENT_FIELD(model, T);
+};
+
+// When to save the checkpoint of the read model. The checkpoint is also saved as the read model is destroyed.
+struct ReadModelCheckpointing final {
+  // No checkpoints are taken if the file name is empty.
+  std::string file_name;
+  // The checkpoint is saved once either this many entries, or this much time, has passed since the previous one.
+  uint64_t every_entries = 100000u;
+  std::chrono::microseconds every_us = std::chrono::seconds(60);
+};
+
+template <typename MODEL, typename STREAM>
+class ReadModel final {
+ public:
+  using entry_t = typename STREAM::entry_t;
+  using checkpoint_t = ReadModelCheckpoint<MODEL>;
+
+  explicit ReadModel(const STREAM& stream, ReadModelCheckpointing checkpointing = ReadModelCheckpointing())
+      : checkpointing_(std::move(checkpointing)),
+        back_(LoadCheckpoint(stream)),
+        front_(back_),
+        resumed_from_index_(back_->next_index),
+        replay_end_index_(stream.Data()->Size()),
+        last_checkpoint_index_(back_->next_index),
+        last_checkpoint_us_(current::time::Now()),
+        subscriber_(*this),
+        subscriber_scope_(std::make_unique<scope_t>(stream.Subscribe(subscriber_, back_->next_index))) {}
+
+  ~ReadModel() {
+    // Stop the subscriber first, so that the final checkpoint is of the model no longer changing.
+    subscriber_scope_ = nullptr;
+    if (!checkpointing_.file_name.empty() && front_->next_index != last_checkpoint_index_) {
+      SaveCheckpoint();
+    }
+  }
+
+  // The most recently published state of the model. Immutable, and safe to keep for as long as needed.
+  std::shared_ptr<const checkpoint_t> Snapshot() const {
+    std::lock_guard<std::mutex> lock(front_mutex_);
+    return front_;
+  }
+
+  // Whether the model has caught up with the entries the stream had as the read model was created.
+  bool Ready() const { return Snapshot()->next_index >= replay_end_index_; }
+
+  // The index the read model has started from: zero, or the one of the checkpoint it has resumed from.
+  uint64_t ResumedFromIndex() const { return resumed_from_index_; }
+
+ private:
+  class SubscriberImpl {
+   public:
+    explicit SubscriberImpl(ReadModel& self) : self_(self) {}
+
+    ss::EntryResponse operator()(const entry_t& entry, idxts_t current, idxts_t) {
+      self_.Apply(entry, current);
+      self_.Publish();
+      return ss::EntryResponse::More;
+    }
+    ss::EntryResponse operator()(const ss::EntriesBatch<entry_t>& batch, idxts_t) {
+      for (const auto& e : batch) {
+        self_.Apply(e.entry, e.idx_ts);
+      }
+      self_.Publish();
+      return ss::EntryResponse::More;
+    }
+    ss::EntryResponse operator()(std::chrono::microseconds) { return ss::EntryResponse::More; }
+    ss::EntryResponse EntryResponseIfNoMorePassTypeFilter() const { return ss::EntryResponse::More; }
+    ss::TerminationResponse Terminate() const { return ss::TerminationResponse::Terminate; }
+
+   private:
+    ReadModel& self_;
+  };
+  using subscriber_t = ss::StreamSubscriber<SubscriberImpl, entry_t>;
+  using scope_t = typename STREAM::template SubscriberScope<subscriber_t>;
+
+  std::shared_ptr<checkpoint_t> LoadCheckpoint(const STREAM& stream) const {
+    auto result = std::make_shared<checkpoint_t>();
+    if (!checkpointing_.file_name.empty()) {
+      try {
+        checkpoint_t checkpoint = ParseJSON<checkpoint_t>(FileSystem::ReadFileAsString(checkpointing_.file_name));
+        if (checkpoint.next_index && checkpoint.next_index <= stream.Data()->Size()) {
+          for (const auto& e : stream.Data()->Iterate(checkpoint.next_index - 1u, checkpoint.next_index)) {
+            if (e.idx_ts.us == checkpoint.last_us) {
+              *result = std::move(checkpoint);
+            }
+          }
+        }
+      } catch (const CannotReadFileException&) {
+        // No checkpoint yet.
+      } catch (const TypeSystemParseJSONException&) {
+        // A checkpoint of some other model, or a corrupted one, is no checkpoint: replay the stream from the start.
+      }
+    }
+    return result;
+  }
+
+  // Called from the subscriber thread only, as are the rest of the methods that follow.
+  void Apply(const entry_t& entry, idxts_t idx_ts) {
+    if (back_is_behind_) {
+      CatchUpBack();
+    }
+    back_->model.Apply(entry, idx_ts);
+    back_->next_index = idx_ts.index + 1u;
+    back_->last_us = idx_ts.us;
+    pending_entries_.emplace_back(entry, idx_ts);
+  }
+
+  void Publish() {
+    if (back_is_behind_ || pending_entries_.empty()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(front_mutex_);
+      std::swap(front_, back_);
+    }
+    back_is_behind_ = true;
+    if (!checkpointing_.file_name.empty() &&
+        (front_->next_index - last_checkpoint_index_ >= checkpointing_.every_entries ||
+         current::time::Now() - last_checkpoint_us_ >= checkpointing_.every_us)) {
+      SaveCheckpoint();
+    }
+  }
+
+  // Brings the back copy of the model up to date with the front one, which is the back one from before the swap.
+  void CatchUpBack() {
+    if (back_.use_count() == 1) {
+      // No reader holds on to the snapshot. Make sure whatever they have read of it is done before it is modified.
+      std::atomic_thread_fence(std::memory_order_acquire);
+      for (const auto& e : pending_entries_) {
+        back_->model.Apply(e.first, e.second);
+      }
+      back_->next_index = front_->next_index;
+      back_->last_us = front_->last_us;
+    } else {
+      back_ = std::make_shared<checkpoint_t>(*front_);
+    }
+    pending_entries_.clear();
+    back_is_behind_ = false;
+  }
+
+  void SaveCheckpoint() {
+    FileSystem::WriteStringToFileAtomically(JSON(*front_), checkpointing_.file_name.c_str());
+    last_checkpoint_index_ = front_->next_index;
+    last_checkpoint_us_ = current::time::Now();
+  }
+
+  const ReadModelCheckpointing checkpointing_;
+
+  // The model being written to, and the one published to the readers. `front_` is only changed by the subscriber
+  // thread, under `front_mutex_`, so the subscriber thread itself reads it without locking.
+  std::shared_ptr<checkpoint_t> back_;
+  std::shared_ptr<checkpoint_t> front_;
+  mutable std::mutex front_mutex_;
+  // Whether `back_` is missing the `pending_entries_`, which are then in `front_` already.
+  bool back_is_behind_ = true;
+  std::vector<std::pair<entry_t, idxts_t>> pending_entries_;
+
+  const uint64_t resumed_from_index_;
+  const uint64_t replay_end_index_;
+  uint64_t last_checkpoint_index_;
+  std::chrono::microseconds last_checkpoint_us_;
+
+  subscriber_t subscriber_;
+  std::unique_ptr<scope_t> subscriber_scope_;
+};
+
+}  // namespace stream
+}  // namespace current
+
+#endif  // CURRENT_STREAM_READ_MODEL_H
@@ -28,11 +28,15 @@ SOFTWARE.
 #define CURRENT_STREAM_REPLICATOR_H
 
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <type_traits>
 
 #include "exceptions.h"
+#include "ordered_parallel_parser.h"
 #include "stream.h"
 #include "stream_impl.h"
 
@@ -41,6 +45,7 @@ SOFTWARE.
 
 #include "../bricks/sync/owned_borrowed.h"
 #include "../bricks/sync/waitable_atomic.h"
+#include "../bricks/system/placement.h"
 
 #include "../typesystem/reflection/types.h"
 
@@ -49,6 +54,10 @@ namespace stream {
 
 enum class ReplicationMode : bool { Checked = true, Unchecked = false };
 
+// How a new follower gets the entries the master already has: via the subscription, entry by entry,
+// or by copying them in bulk first, as they are in the persisted file of the master. See `BulkCatchUp()`.
+enum class ReplicationBootstrap : bool { EntryByEntry = false, BulkTransfer = true };
+
 template <typename STREAM_ENTRY>
 class SubscribableRemoteStream final {
  public:
@@ -88,10 +97,24 @@ class SubscribableRemoteStream final {
              (from_us.count() > 0 ? "&since=" + current::ToString(from_us) : "");
     }
 
+    std::string GetURLForBulk(uint64_t index, uint64_t max_bytes) const {
+      return url_ + "?bulk&i=" + current::ToString(index) + "&stop_after_bytes=" + current::ToString(max_bytes);
+    }
+
     std::string GetURLToTerminate(const std::string& subscription_id) const {
       return url_ + "?terminate=" + subscription_id;
     }
 
+    void SetParallelism(const ReplicationParallelism& parallelism) {
+      std::lock_guard<std::mutex> lock(parallelism_mutex_);
+      parallelism_ = parallelism;
+    }
+
+    ReplicationParallelism Parallelism() const {
+      std::lock_guard<std::mutex> lock(parallelism_mutex_);
+      return parallelism_;
+    }
+
     std::string GetFlipToMasterURL(head_optidxts_t head_idxts, uint64_t key, SubscriptionMode mode) const {
       std::string opt;
       if (Exists(head_idxts.idxts)) {
@@ -107,12 +130,22 @@ class SubscribableRemoteStream final {
    private:
     const std::string url_;
     const SubscribableStreamSchema schema_;
+    mutable std::mutex parallelism_mutex_;
+    ReplicationParallelism parallelism_;
   };
 
   template <typename F, typename TYPE_SUBSCRIBED_TO, ReplicationMode RM>
   class RemoteStreamSubscriber {
     static_assert(current::ss::IsEntrySubscriber<F, TYPE_SUBSCRIBED_TO>::value, "");
 
+    // A line of the remote stream, parsed, but not yet validated against the state of the subscription.
+    struct ParsedLine final {
+      bool malformed = false;
+      bool has_entry = false;
+      ts_optidx_t tsoptidx;
+      TYPE_SUBSCRIBED_TO entry;
+    };
+
    public:
     RemoteStreamSubscriber(Borrowed<RemoteStream> remote_stream,
                            F& subscriber,
@@ -123,47 +156,76 @@ class SubscribableRemoteStream final {
           subscriber_(subscriber),
           next_expected_index_(start_idx),
           from_us_(from_us),
-          unused_idxts_() {}
+          unused_idxts_() {
+      const ReplicationParallelism parallelism = borrowed_remote_stream_->Parallelism();
+      if (RM == ReplicationMode::Checked && parallelism.threads) {
+        parallel_parser_ = std::make_unique<impl::OrderedParallelParser<ParsedLine>>(
+            parallelism.threads, parallelism.pipeline_depth, [](std::string& line, ParsedLine& parsed) {
+              ParseLine(line, parsed);
+            });
+      }
+    }
 
-    void PassChunkToSubscriber(const std::string& chunk) {
+    // Splits the chunks into lines without allocating memory per line: the complete lines are passed on as views
+    // into the chunk, which is itself a view into the receive buffer, and only an incomplete line is copied, into
+    // `carried_over_data_`, which keeps its capacity.
+    void PassChunkToSubscriber(std::string_view chunk) {
+      const char* const data = chunk.data();
       const size_t chunk_size = chunk.size();
       size_t begin_pos = 0u;
 
       if (!carried_over_data_.empty()) {
         // The previous chunk did not complete the previous record (full line).
-        while (begin_pos < chunk_size && chunk[begin_pos] != '\n' && chunk[begin_pos] != '\r') {
+        while (begin_pos < chunk_size && data[begin_pos] != '\n' && data[begin_pos] != '\r') {
           ++begin_pos;
         }
         if (begin_pos == chunk_size) {
           // The current chunk does not complete the previous record either, so keep receiving.
-          carried_over_data_ += chunk;
+          carried_over_data_.append(data, chunk_size);
           return;
         }
         // The leftover, previously incomplete record (full line) is now complete,
         // process it and begin processing this chunk from offset `begin_pos`.
-        PassEntryToSubscriber(carried_over_data_ + chunk.substr(0u, begin_pos));
+        carried_over_data_.append(data, begin_pos);
+        if (parallel_parser_) {
+          PassLineToSubscriber(carried_over_data_.data(), carried_over_data_.length());
+        } else {
+          PassEntryToSubscriber(carried_over_data_);
+        }
         carried_over_data_.clear();
       }
 
       size_t end_pos = 0u;
       for (;;) {
-        while (begin_pos < chunk_size && (chunk[begin_pos] == '\n' || chunk[begin_pos] == '\r')) {
+        while (begin_pos < chunk_size && (data[begin_pos] == '\n' || data[begin_pos] == '\r')) {
           ++begin_pos;
         }
         if (begin_pos == chunk_size) {
           break;
         }
         end_pos = begin_pos + 1u;
-        while (end_pos < chunk_size && chunk[end_pos] != '\n' && chunk[end_pos] != '\r') {
+        while (end_pos < chunk_size && data[end_pos] != '\n' && data[end_pos] != '\r') {
           ++end_pos;
         }
         if (end_pos == chunk_size) {
-          carried_over_data_ = chunk.substr(begin_pos);
+          carried_over_data_.assign(data + begin_pos, chunk_size - begin_pos);
           break;
         }
-        PassEntryToSubscriber(chunk.substr(begin_pos, end_pos - begin_pos));  // NOTE(dkorolev): Can be `Chunk`.
+        PassLineToSubscriber(data + begin_pos, end_pos - begin_pos);
         begin_pos = end_pos + 1u;
       }
+      if (parallel_parser_) {
+        // Not to delay the entries of this chunk until the next one arrives.
+        parallel_parser_->Flush([this](ParsedLine&& parsed) { ApplyParsedLine(std::move(parsed)); });
+      }
+    }
+
+    // Discards the data of the incomplete chunk, to begin anew with the next one.
+    void ClearReceivedData() {
+      carried_over_data_.clear();
+      if (parallel_parser_) {
+        parallel_parser_->Clear();
+      }
     }
 
    protected:
@@ -173,42 +235,74 @@ class SubscribableRemoteStream final {
     std::chrono::microseconds from_us_;
     const idxts_t unused_idxts_;
     std::string carried_over_data_;
+    std::string line_;
+    // Set if the entries are to be parsed on more than one thread, see `ReplicationParallelism`.
+    std::unique_ptr<impl::OrderedParallelParser<ParsedLine>> parallel_parser_;
 
    private:
-    template <ReplicationMode MODE = RM>
-    std::enable_if_t<MODE == ReplicationMode::Checked> PassEntryToSubscriber(const std::string& raw_log_line) {
-      const auto split = current::strings::Split(raw_log_line, '\t');
-      if (split.empty()) {
-        CURRENT_THROW(RemoteStreamMalformedChunkException());
+    // Parses the line in place, with the tab, if any, replaced by '\0' to terminate the JSON before it.
+    // Stateless, so that it can be run on the threads of `parallel_parser_`.
+    static void ParseLine(std::string& raw_log_line, ParsedLine& parsed) {
+      parsed.malformed = false;
+      const size_t tab_pos = raw_log_line.find('\t');
+      parsed.has_entry = (tab_pos != std::string::npos);
+      if (parsed.has_entry) {
+        if (raw_log_line.find('\t', tab_pos + 1u) != std::string::npos) {
+          parsed.malformed = true;
+          return;
+        }
+        raw_log_line[tab_pos] = '\0';
       }
       try {
-        const auto tsoptidx = ParseJSON<ts_optidx_t>(split[0]);
-        if (from_us_.count() > 0 && tsoptidx.us < from_us_) {
-          CURRENT_THROW(RemoteStreamMalformedChunkException());
-        }
-        if (Exists(tsoptidx.index)) {
-          const auto idxts = idxts_t(Value(tsoptidx.index), tsoptidx.us);
-          if (split.size() != 2u || idxts.index != next_expected_index_) {
-            CURRENT_THROW(RemoteStreamMalformedChunkException());
-          }
-          auto entry = ParseJSON<TYPE_SUBSCRIBED_TO>(split[1]);
-          if (subscriber_(std::move(entry), idxts, unused_idxts_) == ss::EntryResponse::Done) {
-            CURRENT_THROW(StreamTerminatedBySubscriber());
-          }
-          ++next_expected_index_;
-          from_us_ = std::chrono::microseconds(0);
-        } else {
-          if (split.size() != 1u) {
-            CURRENT_THROW(RemoteStreamMalformedChunkException());
-          }
-          if (subscriber_(tsoptidx.us) == ss::EntryResponse::Done) {
-            CURRENT_THROW(StreamTerminatedBySubscriber());
-          }
-          from_us_ = tsoptidx.us + std::chrono::microseconds(1);
+        parsed.tsoptidx = ParseJSON<ts_optidx_t>(raw_log_line.c_str());
+        if (Exists(parsed.tsoptidx.index) != parsed.has_entry) {
+          parsed.malformed = true;
+        } else if (parsed.has_entry) {
+          parsed.entry = ParseJSON<TYPE_SUBSCRIBED_TO>(raw_log_line.c_str() + tab_pos + 1u);
         }
       } catch (const current::serialization::json::TypeSystemParseJSONException&) {
+        parsed.malformed = true;
+      }
+    }
+
+    // Passes the parsed line to the subscriber, if it is what is expected next.
+    void ApplyParsedLine(ParsedLine&& parsed) {
+      if (parsed.malformed || (from_us_.count() > 0 && parsed.tsoptidx.us < from_us_)) {
         CURRENT_THROW(RemoteStreamMalformedChunkException());
       }
+      if (parsed.has_entry) {
+        const auto idxts = idxts_t(Value(parsed.tsoptidx.index), parsed.tsoptidx.us);
+        if (idxts.index != next_expected_index_) {
+          CURRENT_THROW(RemoteStreamMalformedChunkException());
+        }
+        if (subscriber_(std::move(parsed.entry), idxts, unused_idxts_) == ss::EntryResponse::Done) {
+          CURRENT_THROW(StreamTerminatedBySubscriber());
+        }
+        ++next_expected_index_;
+        from_us_ = std::chrono::microseconds(0);
+      } else {
+        if (subscriber_(parsed.tsoptidx.us) == ss::EntryResponse::Done) {
+          CURRENT_THROW(StreamTerminatedBySubscriber());
+        }
+        from_us_ = parsed.tsoptidx.us + std::chrono::microseconds(1);
+      }
+    }
+
+    void PassLineToSubscriber(const char* line, size_t length) {
+      if (parallel_parser_) {
+        parallel_parser_->Add(
+            line, length, [this](ParsedLine&& parsed) { ApplyParsedLine(std::move(parsed)); });
+      } else {
+        line_.assign(line, length);
+        PassEntryToSubscriber(line_);
+      }
+    }
+
+    template <ReplicationMode MODE = RM>
+    std::enable_if_t<MODE == ReplicationMode::Checked> PassEntryToSubscriber(std::string& raw_log_line) {
+      ParsedLine parsed;
+      ParseLine(raw_log_line, parsed);
+      ApplyParsedLine(std::move(parsed));
     }
 
     template <ReplicationMode MODE = RM>
@@ -276,6 +370,8 @@ class SubscribableRemoteStream final {
     void operator=(RemoteSubscriberThread&&) = delete;
 
     void Thread() {
+      current::bricks::system::ThreadPlacementPolicy().PlaceCurrentThread(
+          current::bricks::system::ThreadRole::Replicator);
       ThreadImpl();
       subscriber_thread_done_ = true;
       subscription_id_.MutableScopedAccessor()->clear();
@@ -296,11 +392,9 @@ class SubscribableRemoteStream final {
         }
         try {
           bare_stream.CheckSchema();
-          HTTP(ChunkedGET(
-              bare_stream.GetURLToSubscribe(this->next_expected_index_, this->from_us_, subscription_mode_),
-              [this](const std::string& header, const std::string& value) { OnHeader(header, value); },
-              [this](const std::string& chunk_body) { OnChunk(chunk_body); },
-              []() {}));
+          HTTP(ChunkedGET(bare_stream.GetURLToSubscribe(this->next_expected_index_, this->from_us_, subscription_mode_))
+                   .OnHeader([this](const std::string& header, const std::string& value) { OnHeader(header, value); })
+                   .OnChunkView([this](std::string_view chunk_body) { OnChunk(chunk_body); }));
         } catch (StreamTerminatedBySubscriber&) {
           break;
         } catch (RemoteStreamMalformedChunkException&) {
@@ -312,7 +406,7 @@ class SubscribableRemoteStream final {
           }
         } catch (current::Exception&) {
         }
-        this->carried_over_data_.clear();
+        this->ClearReceivedData();
         subscription_id_.MutableScopedAccessor()->clear();
       }
     }
@@ -323,7 +417,7 @@ class SubscribableRemoteStream final {
       }
     }
 
-    void OnChunk(const std::string& chunk) {
+    void OnChunk(std::string_view chunk) {
       if (terminate_subscription_requested_) {
         return;
       }
@@ -434,6 +528,42 @@ class SubscribableRemoteStream final {
     return stream_.ObjectAccessorDespitePossiblyDestructing().GetNumberOfEntries();
   }
 
+  // Copies the entries of the remote stream from `start_idx` on into `publisher`, as they are in the persisted file
+  // of the remote stream, up to `max_bytes_per_request` at a time, verifying the checksum and the indexes of each
+  // batch. Returns the index to subscribe from to follow the remote stream live, which is `start_idx` if the remote
+  // stream is unable to serve its entries in bulk. The HEAD updates of the remote stream are not copied.
+  template <typename PUBLISHER>
+  uint64_t BulkCatchUp(PUBLISHER& publisher,
+                       uint64_t start_idx,
+                       uint64_t max_bytes_per_request = kDefaultBulkResponseMaxBytes) const {
+    const RemoteStream& remote_stream = *stream_;
+    uint64_t index = start_idx;
+    while (true) {
+      const auto response = HTTP(GET(remote_stream.GetURLForBulk(index, max_bytes_per_request)));
+      if (response.code == HTTPResponseCode.NoContent || response.code == HTTPResponseCode.NotImplemented) {
+        return index;
+      }
+      if (response.code != HTTPResponseCode.OK) {
+        CURRENT_THROW(RemoteStreamDoesNotRespondException());
+      }
+      const std::string begin = response.headers.GetOrDefault(kStreamHeaderBulkBegin, "");
+      const std::string end = response.headers.GetOrDefault(kStreamHeaderBulkEnd, "");
+      const std::string crc = response.headers.GetOrDefault(kStreamHeaderBulkCRC32C, "");
+      if (begin != current::ToString(index) || end.empty() || crc != current::ToString(CRC32C(response.body))) {
+        CURRENT_THROW(RemoteStreamMalformedChunkException());
+      }
+      const uint64_t end_index = current::FromString<uint64_t>(end);
+      if (!(end_index > index) || publisher.PublishRawEntries(response.body).index + 1u != end_index) {
+        CURRENT_THROW(RemoteStreamMalformedChunkException());
+      }
+      index = end_index;
+    }
+  }
+
+  // Makes the subsequent `ReplicationMode::Checked` subscriptions parse the received entries on a pool of threads,
+  // while still passing them to the subscriber in order. See `ordered_parallel_parser.h` for details.
+  void SetReplicationParallelism(const ReplicationParallelism& parallelism) { stream_->SetParallelism(parallelism); }
+
  private:
   Owned<RemoteStream> stream_;
 };
@@ -574,7 +704,12 @@ class MasterFlipController final {
   }
 
   // Makes the local, owned, ex-master stream follow the remote now-master one.
-  void FollowRemoteStream(const std::string& url, SubscriptionMode subscription_mode = SubscriptionMode::Unchecked) {
+  // With `ReplicationBootstrap::BulkTransfer`, the entries the remote stream already has are first copied in bulk,
+  // see `SubscribableRemoteStream::BulkCatchUp()`, and only then is the remote stream subscribed to.
+  void FollowRemoteStream(const std::string& url,
+                          SubscriptionMode subscription_mode = SubscriptionMode::Unchecked,
+                          ReplicationParallelism parallelism = ReplicationParallelism(),
+                          ReplicationBootstrap bootstrap = ReplicationBootstrap::EntryByEntry) {
     if (remote_follower_) {
       CURRENT_THROW(StreamIsAlreadyFollowingException());
     }
@@ -582,12 +717,18 @@ class MasterFlipController final {
     std::lock_guard<std::mutex> lock(mutex_);
     const bool has_borrowed_publisher = Exists(borrowed_publisher_);
     try {
+      Borrowed<publisher_t> publisher =
+          has_borrowed_publisher ? std::move(Value(borrowed_publisher_)) : stream_->BecomeFollowingStream();
+      if (bootstrap == ReplicationBootstrap::BulkTransfer) {
+        SubscribableRemoteStream<entry_t>(url).BulkCatchUp(*publisher, stream_->Data()->Size());
+      }
       remote_follower_ = std::make_unique<RemoteStreamFollower>(
-          has_borrowed_publisher ? std::move(Value(borrowed_publisher_)) : stream_->BecomeFollowingStream(),
+          std::move(publisher),
           url,
           stream_->Data()->Size(),
           stream_->Data()->CurrentHead() + std::chrono::microseconds(1),
-          subscription_mode);
+          subscription_mode,
+          parallelism);
       borrowed_publisher_ = nullptr;
     } catch (const current::Exception&) {
       // Can't follow the remote stream for some reason,
@@ -808,11 +949,15 @@ class MasterFlipController final {
                          const std::string& url,
                          uint64_t start_idx,
                          std::chrono::microseconds from_us,
-                         SubscriptionMode subscription_mode)
+                         SubscriptionMode subscription_mode,
+                         const ReplicationParallelism& parallelism)
         : subscription_mode_(subscription_mode),
           remote_stream_(url),
           replicator_(std::move(publisher)),
-          subscriber_scope_(Subscribe(start_idx, from_us)) {}
+          subscriber_scope_([&]() {
+            remote_stream_.SetReplicationParallelism(parallelism);
+            return Subscribe(start_idx, from_us);
+          }()) {}
 
     // Orders the remote stream to quit being the master and begin acting as a follower.
     //
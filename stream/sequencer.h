@@ -0,0 +1,146 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// `PublishSequencer<STREAM>` publishes into the stream from many threads at once, keeping the single total order of
+// the entries, while holding the publishing mutex of the stream for as short as possible.
+//
+// Each producer serializes its entry on its own thread, before any lock is taken, and stages it. The first producer
+// to then lock the publishing mutex becomes the sequencer for all the entries staged by then: it assigns them the
+// indexes and the timestamps, in the order they were staged in, and appends them to the persister as they are, while
+// the producers of these entries find them published once they get the mutex. So the critical section is down to
+// the appends of the bytes serialized beforehand, and a burst of producers hands over the mutex once per batch, not
+// once per entry. The persisters that do not store the entries serialized, such as the in-memory one, are given the
+// entries themselves, still in batches.
+//
+// The sequencer borrows the publisher of the stream, which must be the master stream, for as long as it lives.
+
+#ifndef CURRENT_STREAM_SEQUENCER_H
+#define CURRENT_STREAM_SEQUENCER_H
+
+#include "../port.h"
+
+#include <exception>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "stream.h"
+
+namespace current {
+namespace stream {
+
+template <typename STREAM>
+class PublishSequencer final {
+ public:
+  using entry_t = typename STREAM::entry_t;
+  using publisher_t = typename STREAM::publisher_t;
+
+  // Whether the persister of the stream takes the entries serialized, for them to be staged as their JSON-s.
+  constexpr static bool kStagesSerializedEntries =
+      ss::PersisterAcceptsSerializedEntries<typename STREAM::persistence_layer_t>::value;
+
+  explicit PublishSequencer(STREAM& stream)
+      : publisher_(stream.BorrowPublisher()), publishing_mutex_(stream.Impl()->publishing_mutex) {}
+
+  // Thread-safe. Returns once the entry is published, with its index and timestamp.
+  template <typename E, class = std::enable_if_t<ss::can_publish_v<current::decay_t<E>, entry_t>>>
+  idxts_t Publish(E&& e) {
+    Staged staged(Stage(std::forward<E>(e)));
+    {
+      std::lock_guard<std::mutex> lock(staging_mutex_);
+      staging_.push_back(&staged);
+    }
+    {
+      std::lock_guard<std::mutex> lock(publishing_mutex_);
+      if (!staged.published) {
+        PublishStagedFromLockedSection();
+      }
+    }
+    if (staged.error) {
+      std::rethrow_exception(staged.error);
+    }
+    return staged.idxts;
+  }
+
+ private:
+  using staged_entry_t = std::conditional_t<kStagesSerializedEntries, std::string, entry_t>;
+
+  // Lives on the stack of its producer, which does not return before the entry is published.
+  struct Staged final {
+    staged_entry_t entry;
+    idxts_t idxts;
+    std::exception_ptr error;
+    bool published = false;  // Guarded by the publishing mutex.
+
+    explicit Staged(staged_entry_t&& entry) : entry(std::move(entry)) {}
+  };
+
+  template <typename E>
+  static staged_entry_t Stage(E&& e) {
+    if constexpr (kStagesSerializedEntries) {
+      return JSON(
+          persistence::impl::MakeSureTheRightTypeIsSerialized<entry_t, current::decay_t<E>>::DoIt(std::forward<E>(e)));
+    } else {
+      return entry_t(std::forward<E>(e));
+    }
+  }
+
+  void PublishStagedFromLockedSection() {
+    {
+      std::lock_guard<std::mutex> lock(staging_mutex_);
+      batch_.swap(staging_);
+    }
+    for (Staged* staged : batch_) {
+      try {
+        if constexpr (kStagesSerializedEntries) {
+          staged->idxts =
+              publisher_->template PublishSerialized<current::locks::MutexLockStatus::AlreadyLocked>(staged->entry);
+        } else {
+          staged->idxts =
+              publisher_->template Publish<current::locks::MutexLockStatus::AlreadyLocked>(std::move(staged->entry));
+        }
+      } catch (...) {
+        staged->error = std::current_exception();
+      }
+      staged->published = true;
+    }
+    batch_.clear();
+  }
+
+  Borrowed<publisher_t> publisher_;
+  std::mutex& publishing_mutex_;
+
+  // The entries staged and not yet published, in the order they are to be published in.
+  std::mutex staging_mutex_;
+  std::vector<Staged*> staging_;
+  // The entries being published, swapped with `staging_` so that neither is reallocated once warmed up.
+  // Only accessed with the publishing mutex locked.
+  std::vector<Staged*> batch_;
+};
+
+}  // namespace stream
+}  // namespace current
+
+#endif  // CURRENT_STREAM_SEQUENCER_H
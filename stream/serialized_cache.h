@@ -0,0 +1,122 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2024 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// `SerializedEntriesCache` keeps the JSON-s of the entries of a stream as they are sent to its HTTP subscribers, so
+// that an entry sent to many subscribers at once is serialized once per JSON format, not once per subscriber.
+//
+// The entries are cached lazily, as they are first sent, in chunks of `kEntriesPerChunk` consecutive indexes per
+// format. Once there are more than `kMaxChunks` chunks, the least recently used one is evicted. The subscribers
+// tailing the stream are all sending the few most recent entries, so these are what the cache ends up holding.
+
+#ifndef CURRENT_STREAM_SERIALIZED_CACHE_H
+#define CURRENT_STREAM_SERIALIZED_CACHE_H
+
+#include "../port.h"
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+#include "../typesystem/serialization/json.h"
+
+namespace current {
+namespace stream {
+
+template <typename ENTRY>
+class SerializedEntriesCache final {
+ public:
+  constexpr static uint64_t kEntriesPerChunk = 256u;
+  constexpr static size_t kMaxChunks = 64u;
+
+  // Appends `JSON<J>(entry)` to `output`, where `entry` is the one at `index` in the stream.
+  template <class J>
+  void AppendJSON(const ENTRY& entry, uint64_t index, std::string& output) {
+    const key_t key(std::type_index(typeid(J)), index / kEntriesPerChunk);
+    const size_t offset = static_cast<size_t>(index % kEntriesPerChunk);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const auto cit = chunks_index_.find(key);
+      if (cit != chunks_index_.end() && !cit->second->jsons[offset].empty()) {
+        chunks_.splice(chunks_.begin(), chunks_, cit->second);
+        output += cit->second->jsons[offset];
+        ++hits_;
+        return;
+      }
+    }
+    // Serialize with the mutex unlocked. Should several subscribers miss the same entry at once, the last one wins.
+    std::string json = JSON<J>(entry);
+    output += json;
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++misses_;
+    auto cit = chunks_index_.find(key);
+    if (cit == chunks_index_.end()) {
+      if (chunks_.size() >= kMaxChunks) {
+        chunks_index_.erase(chunks_.back().key);
+        chunks_.pop_back();
+      }
+      chunks_.emplace_front(key);
+      cit = chunks_index_.emplace(key, chunks_.begin()).first;
+    } else {
+      chunks_.splice(chunks_.begin(), chunks_, cit->second);
+    }
+    cit->second->jsons[offset] = std::move(json);
+  }
+
+  uint64_t Hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+  }
+
+  uint64_t Misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+  }
+
+ private:
+  // The JSON format and the index of the chunk.
+  using key_t = std::pair<std::type_index, uint64_t>;
+
+  struct Chunk final {
+    const key_t key;
+    // An empty string is an entry not cached yet, as no JSON is empty.
+    std::vector<std::string> jsons;
+
+    explicit Chunk(const key_t& key) : key(key), jsons(static_cast<size_t>(kEntriesPerChunk)) {}
+  };
+
+  mutable std::mutex mutex_;
+  std::list<Chunk> chunks_;  // The most recently used first.
+  std::map<key_t, typename std::list<Chunk>::iterator> chunks_index_;
+  uint64_t hits_ = 0u;
+  uint64_t misses_ = 0u;
+};
+
+}  // namespace stream
+}  // namespace current
+
+#endif  // CURRENT_STREAM_SERIALIZED_CACHE_H
@@ -27,14 +27,18 @@ SOFTWARE.
 
 #include "../port.h"
 
+#include <algorithm>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <memory>
 #include <string>
 #include <thread>
 #include <type_traits>
+#include <vector>
 
+#include "dispatcher.h"
 #include "exceptions.h"
 #include "stream_impl.h"
 #include "pubsub.h"
@@ -43,11 +47,13 @@ SOFTWARE.
 #include "../typesystem/schema/schema.h"
 
 #include "../blocks/http/api.h"
+#include "../blocks/metrics/metrics.h"
 #include "../blocks/persistence/memory.h"
 #include "../blocks/persistence/file.h"
 #include "../blocks/ss/ss.h"
 #include "../blocks/ss/signature.h"
 
+#include "../bricks/strings/join.h"
 #include "../bricks/sync/locks.h"
 #include "../bricks/sync/owned_borrowed.h"
 #include "../bricks/time/chrono.h"
@@ -71,7 +77,8 @@ SOFTWARE.
 // any number of "borrowed" publishers, forked off the master one.
 //
 // Subscription is done via `auto scope = my_stream.Subscribe(my_subscriber);`, where `my_subscriber`
-// is an instance of the class doing the subscription. Stream runs each subscriber in a dedicated thread.
+// is an instance of the class doing the subscription. Stream runs each subscriber in a dedicated thread,
+// or, once `my_stream.SetSubscriberDispatcher(&dispatcher)` is called, on a shared pool of threads.
 //
 // Stack ownership of `my_subscriber` is respected, and `SubscriberScope` is returned for the user to store.
 // As the returned `scope` object leaves the scope, the subscriber is sent a signal to terminate,
@@ -120,7 +127,9 @@ CURRENT_STRUCT(StreamSchemaFormatNotFoundError) {
 template <typename ENTRY>
 using DEFAULT_PERSISTENCE_LAYER = current::persistence::Memory<ENTRY>;
 
-enum class SubscriptionMode : bool { Checked = true, Unchecked = false };
+// `Projected` is for the local subscribers to the entries parsed into a struct with some of their fields only,
+// see `SubscribeProjected()`.
+enum class SubscriptionMode : int { Unchecked = 0, Checked = 1, Projected = 2 };
 
 template <typename ENTRY, template <typename> class PERSISTENCE_LAYER = DEFAULT_PERSISTENCE_LAYER>
 class Stream final {
@@ -263,6 +272,72 @@ class Stream final {
     return RecreatePublisher();
   }
 
+  // `SetSubscriberDispatcher` makes the subsequent subscriptions to this stream, including the HTTP ones,
+  // run on the threads of `dispatcher` instead of each in a dedicated thread. Pass `nullptr` to revert.
+  // The existing subscriptions are not affected. See `dispatcher.h` for details.
+  void SetSubscriberDispatcher(SubscriberDispatcher* dispatcher) { impl_->subscriber_dispatcher = dispatcher; }
+
+  // `SetSubscriberWakeupCoalescing` makes the subscriber threads woken up by a publish wait for `window` more
+  // before processing the new entries, so that a burst of publishes wakes each of them up once. Zero, the default,
+  // disables coalescing. Applies to the existing subscriptions too, except the ones run by a dispatcher.
+  void SetSubscriberWakeupCoalescing(std::chrono::microseconds window) {
+    impl_->epoch.SetCoalescingWindow(window);
+  }
+
+  // `SetSubscriberPlacement` places the dedicated threads of the subsequent subscriptions to this stream onto
+  // the CPUs of `cpus`, instead of the ones of `ThreadRole::StreamSubscriber`, see `bricks/system/placement.h`.
+  // An empty set reverts to the default. `PlaceSubscribersNearPublisher`, called from the publishing thread,
+  // places them onto the NUMA node that thread is running on, so that the entries are read where they are written.
+  void SetSubscriberPlacement(current::bricks::system::CPUSet cpus) {
+    std::lock_guard<std::mutex> lock(impl_->subscriber_cpus_mutex);
+    impl_->subscriber_cpus = std::move(cpus);
+  }
+  void PlaceSubscribersNearPublisher() {
+    const int node = current::bricks::system::CurrentNUMANode();
+    SetSubscriberPlacement(node >= 0 ? current::bricks::system::CPUSet::OfNUMANode(static_cast<size_t>(node))
+                                     : current::bricks::system::CPUSet::OfCurrentThread());
+  }
+
+  // `SetHTTPSubscriberFlowControl` sets what to do with the subsequent HTTP subscribers that are not keeping up.
+  // The existing subscriptions are not affected. See `HTTPSubscriberFlowControl` for details.
+  void SetHTTPSubscriberFlowControl(const HTTPSubscriberFlowControl& flow_control) {
+    std::lock_guard<std::mutex> lock(impl_->http_subscriptions_mutex);
+    impl_->http_subscriber_flow_control = flow_control;
+  }
+
+  // `HTTPSubscribersStatus` returns how far behind the end of the stream each active HTTP subscriber is.
+  std::vector<HTTPSubscriberStatus> HTTPSubscribersStatus() const {
+    const uint64_t stream_size = impl_->persister.Size();
+    std::vector<HTTPSubscriberStatus> result;
+    std::lock_guard<std::mutex> lock(impl_->http_subscriptions_mutex);
+    for (const auto& subscription : impl_->http_subscriptions) {
+      if (subscription.second.second) {
+        HTTPSubscriberStatus status = subscription.second.second->Status();
+        status.subscription_id = subscription.first;
+        status.lag = stream_size > status.next_index ? stream_size - status.next_index : 0u;
+        result.push_back(std::move(status));
+      }
+    }
+    return result;
+  }
+
+  // `PublishMetrics` publishes the size of the stream and `HTTPSubscribersStatus()` into the process-wide metrics
+  // registry, labeled `stream="<name>"`, for as long as the returned scope is alive; it must not outlive the stream.
+  [[nodiscard]] current::metrics::CollectorScope PublishMetrics(
+      const std::string& name, current::metrics::Registry& registry = current::metrics::ProcessMetrics()) const {
+    return registry.AddCollector([this, name](current::metrics::MetricsSnapshot& snapshot) {
+      using namespace current::metrics;
+      AddGauge(snapshot, "stream_size", {{"stream", name}}, impl_->persister.Size(), "The entries in the stream.");
+      for (const HTTPSubscriberStatus& status : HTTPSubscribersStatus()) {
+        const labels_t labels = {{"stream", name}, {"subscription", status.subscription_id}};
+        AddGauge(snapshot, "stream_http_subscriber_lag", labels, status.lag, "The entries the subscriber is behind.");
+        AddCounter(snapshot, "stream_http_subscriber_sent_entries_total", labels, status.sent_entries, "");
+        AddCounter(snapshot, "stream_http_subscriber_skipped_entries_total", labels, status.skipped_entries, "");
+        AddCounter(snapshot, "stream_http_subscriber_sent_bytes_total", labels, status.sent_bytes, "");
+      }
+    });
+  }
+
   // TODO(dkorolev): Master-follower flip between two streams belongs in Stream first, then in Storage.
   template <typename TYPE_SUBSCRIBED_TO, typename F, SubscriptionMode SM>
   class SubscriberThreadInstance final : public current::stream::SubscriberScope::SubscriberThread {
@@ -271,10 +346,18 @@ class Stream final {
     std::function<void()> done_callback_;
     current::WaitableTerminateSignal terminate_signal_;
     bool terminate_sent_;
+    // Declared before `impl_`, so that it outlives the destruction callback of `impl_`, which wakes it up.
+    std::unique_ptr<current::stream::impl::DispatchedSubscriber> dispatched_;
     BorrowedWithCallback<impl_t> impl_;
     F& subscriber_;
     const uint64_t begin_idx_;
     const std::chrono::microseconds from_us_;
+    // The upper bound on the size of a single batch, for the subscribers that accept batches.
+    constexpr static uint64_t kMaxEntriesPerBatch = 1000u;
+    // The progress of the subscriber, carried over from one step to the next.
+    uint64_t index_;
+    std::chrono::microseconds head_;
+    bool first_step_ = true;
     std::thread thread_;
 
     SubscriberThreadInstance() = delete;
@@ -293,16 +376,28 @@ class Stream final {
           done_callback_(done_callback),
           terminate_signal_(),
           terminate_sent_(false),
+          dispatched_(MakeDispatchedSubscriber(impl->subscriber_dispatcher.load())),
           impl_(std::move(impl),
                 [this]() {
                   // NOTE(dkorolev): I'm uncertain whether this lock is necessary here. Keeping it for safety now.
                   std::lock_guard<std::mutex> lock(impl_->publishing_mutex);
                   terminate_signal_.SignalExternalTermination();
+                  if (dispatched_) {
+                    dispatched_->Wake();
+                  } else {
+                    impl_->epoch.WakeAll();
+                  }
                 }),
           subscriber_(subscriber),
           begin_idx_(begin_idx),
           from_us_(from_us),
-          thread_(&SubscriberThreadInstance::Thread, this) {
+          index_(begin_idx),
+          head_(from_us - std::chrono::microseconds(1)),
+          thread_(dispatched_ ? std::thread() : std::thread(&SubscriberThreadInstance::Thread, this)) {
+      if (dispatched_) {
+        impl_->dispatched_subscribers.Register(*dispatched_);
+        dispatched_->Wake();
+      }
       // Must guard against the constructor of `BorrowedWithCallback<impl_t> impl_` throwing.
       // NOTE(dkorolev): This is obsolete now, but keeping the logic for now, to keep it safe. -- D.K.
       this_is_valid_ = true;
@@ -311,12 +406,19 @@ class Stream final {
     ~SubscriberThreadInstance() {
       if (this_is_valid_) {
         // The constructor has completed successfully. The thread has started, and `impl_` is valid.
-        CURRENT_ASSERT(thread_.joinable());
+        CURRENT_ASSERT(dispatched_ || thread_.joinable());
         if (!subscriber_thread_done_) {
           std::lock_guard<std::mutex> lock(impl_->publishing_mutex);
           terminate_signal_.SignalExternalTermination();
         }
-        thread_.join();
+        if (dispatched_) {
+          dispatched_->Wake();
+          dispatched_->WaitUntilDone();
+          impl_->dispatched_subscribers.UnRegister(*dispatched_);
+        } else {
+          impl_->epoch.WakeAll();
+          thread_.join();
+        }
       } else {
         // The constructor has not completed successfully. The thread was not started, and `impl_` is garbage.
         if (done_callback_) {
@@ -325,10 +427,25 @@ class Stream final {
       }
     }
 
+    std::unique_ptr<current::stream::impl::DispatchedSubscriber> MakeDispatchedSubscriber(
+        SubscriberDispatcher* dispatcher) {
+      if (dispatcher) {
+        return std::make_unique<current::stream::impl::DispatchedSubscriber>(*dispatcher,
+                                                                              [this]() { return DispatchedStep(); });
+      } else {
+        return nullptr;
+      }
+    }
+
     void Thread() {
+      impl_->PlaceSubscriberThread();
       // Keep the subscriber thread exception-safe. By construction, it's guaranteed to live
       // strictly within the scope of existence of `impl_t` contained in `impl_`.
-      ThreadImpl(begin_idx_);
+      ThreadImpl();
+      OnDone();
+    }
+
+    void OnDone() {
       subscriber_thread_done_ = true;
       std::lock_guard<std::mutex> lock(impl_->http_subscriptions_mutex);
       if (done_callback_) {
@@ -336,10 +453,48 @@ class Stream final {
       }
     }
 
-    template <SubscriptionMode MODE = SM>
-    std::enable_if_t<MODE == SubscriptionMode::Checked, ss::EntryResponse> PassEntriesToSubscriber(const impl_t& impl,
-                                                                                                   uint64_t index,
-                                                                                                   uint64_t size) {
+    // The subscribers to the very type of the stream that accept batches are passed the entries in batches.
+    constexpr static bool kPassEntriesInBatches =
+        std::is_same_v<TYPE_SUBSCRIBED_TO, entry_t> && current::ss::IsBatchEntrySubscriber<F, entry_t>::value;
+
+    template <SubscriptionMode MODE = SM, bool IN_BATCHES = kPassEntriesInBatches>
+    std::enable_if_t<MODE == SubscriptionMode::Checked && IN_BATCHES, ss::EntryResponse> PassEntriesToSubscriber(
+        const impl_t& impl, uint64_t index, uint64_t size) {
+      while (index < size) {
+        if (!terminate_sent_ && terminate_signal_) {
+          terminate_sent_ = true;
+          if (subscriber_.Terminate() != ss::TerminationResponse::Wait) {
+            return ss::EntryResponse::Done;
+          }
+        }
+        const uint64_t end = std::min(size, index + kMaxEntriesPerBatch);
+        const auto iterable = impl.persister.Iterate(index, end);
+        // The entries are kept for the duration of the call, as some persisters return them by value.
+        std::vector<current::decay_t<decltype(*iterable.begin())>> elements;
+        elements.reserve(static_cast<size_t>(end - index));
+        for (auto&& e : iterable) {
+          elements.push_back(std::move(e));
+        }
+        std::vector<const entry_t*> entries;
+        std::vector<idxts_t> idx_ts;
+        entries.reserve(elements.size());
+        idx_ts.reserve(elements.size());
+        for (const auto& e : elements) {
+          entries.push_back(&e.entry);
+          idx_ts.push_back(e.idx_ts);
+        }
+        const ss::EntriesBatch<entry_t> batch(entries.data(), idx_ts.data(), entries.size());
+        if (subscriber_(batch, impl.persister.LastPublishedIndexAndTimestamp()) == ss::EntryResponse::Done) {
+          return ss::EntryResponse::Done;
+        }
+        index = end;
+      }
+      return ss::EntryResponse::More;
+    }
+
+    template <SubscriptionMode MODE = SM, bool IN_BATCHES = kPassEntriesInBatches>
+    std::enable_if_t<MODE == SubscriptionMode::Checked && !IN_BATCHES, ss::EntryResponse> PassEntriesToSubscriber(
+        const impl_t& impl, uint64_t index, uint64_t size) {
       for (const auto& e : impl.persister.Iterate(index, size)) {
         if (!terminate_sent_ && terminate_signal_) {
           terminate_sent_ = true;
@@ -359,10 +514,36 @@ class Stream final {
       return ss::EntryResponse::More;
     }
 
-    template <SubscriptionMode MODE = SM>
-    std::enable_if_t<MODE == SubscriptionMode::Unchecked, ss::EntryResponse> PassEntriesToSubscriber(const impl_t& impl,
-                                                                                                     uint64_t index,
-                                                                                                     uint64_t size) {
+    // The unchecked subscribers that accept raw spans are passed the entries straight from the persisted data,
+    // if the persister stores them in the very form they are passed on in.
+    constexpr static bool kPassRawEntriesSpans =
+        current::ss::IsRawEntriesSpanSubscriber<F>::value &&
+        current::ss::PersisterServesRawEntriesSpans<persistence_layer_t>::value;
+
+    template <SubscriptionMode MODE = SM, bool RAW_SPANS = kPassRawEntriesSpans>
+    std::enable_if_t<MODE == SubscriptionMode::Unchecked && RAW_SPANS, ss::EntryResponse> PassEntriesToSubscriber(
+        const impl_t& impl, uint64_t index, uint64_t size) {
+      ss::EntryResponse result = ss::EntryResponse::More;
+      impl.persister.IterateRawSpans(index, size, [&](const ss::RawEntriesSpan& span) {
+        if (!terminate_sent_ && terminate_signal_) {
+          terminate_sent_ = true;
+          if (subscriber_.Terminate() != ss::TerminationResponse::Wait) {
+            result = ss::EntryResponse::Done;
+            return false;
+          }
+        }
+        if (subscriber_(span, impl.persister.LastPublishedIndexAndTimestamp()) == ss::EntryResponse::Done) {
+          result = ss::EntryResponse::Done;
+          return false;
+        }
+        return true;
+      });
+      return result;
+    }
+
+    template <SubscriptionMode MODE = SM, bool RAW_SPANS = kPassRawEntriesSpans>
+    std::enable_if_t<MODE == SubscriptionMode::Unchecked && !RAW_SPANS, ss::EntryResponse> PassEntriesToSubscriber(
+        const impl_t& impl, uint64_t index, uint64_t size) {
       for (const auto& e : impl.persister.IterateUnsafe(index, size)) {
         if (!terminate_sent_ && terminate_signal_) {
           terminate_sent_ = true;
@@ -377,42 +558,110 @@ class Stream final {
       return ss::EntryResponse::More;
     }
 
-    void ThreadImpl(uint64_t begin_idx) {
-      auto head = from_us_ - std::chrono::microseconds(1);
-      uint64_t index = begin_idx;
-      uint64_t size = 0;
-      while (true) {
+    // Passes at most `max_entries` entries, and then the head, if it has moved, to the subscriber.
+    // The projected subscribers are passed the entries parsed from their JSON form into `TYPE_SUBSCRIBED_TO`,
+    // with the fields it does not have skipped over by the parser.
+    template <SubscriptionMode MODE = SM>
+    std::enable_if_t<MODE == SubscriptionMode::Projected, ss::EntryResponse> PassEntriesToSubscriber(
+        const impl_t& impl, uint64_t index, uint64_t size) {
+      for (const auto& raw_log_line : impl.persister.IterateUnsafe(index, size)) {
         if (!terminate_sent_ && terminate_signal_) {
           terminate_sent_ = true;
           if (subscriber_.Terminate() != ss::TerminationResponse::Wait) {
-            return;
+            return ss::EntryResponse::Done;
           }
         }
-        const auto head_idx = impl_->persister.HeadAndLastPublishedIndexAndTimestamp();
-        size = Exists(head_idx.idxts) ? Value(head_idx.idxts).index + 1 : 0;
-        if (head_idx.head > head) {
-          if (size > index) {
-            if (PassEntriesToSubscriber(*impl_, index, size) == ss::EntryResponse::Done) {
-              return;
+        const size_t tab_pos = raw_log_line.find('\t');
+        if (tab_pos == std::string::npos) {
+          CURRENT_THROW(current::persistence::MalformedEntryException(raw_log_line));
+        }
+        const idxts_t idxts =
+            current::persistence::impl::ParseIdxTs(raw_log_line.data(), raw_log_line.data() + tab_pos);
+        if (subscriber_(ParseJSON<TYPE_SUBSCRIBED_TO>(raw_log_line.c_str() + tab_pos + 1u),
+                        idxts,
+                        impl.persister.LastPublishedIndexAndTimestamp()) == ss::EntryResponse::Done) {
+          return ss::EntryResponse::Done;
+        }
+      }
+      return ss::EntryResponse::More;
+    }
+
+    // Returns `Idle` if there was nothing to pass, and it is time to wait until there is.
+    current::stream::impl::DispatchedSubscriberStep Step(uint64_t max_entries) {
+      using step_t = current::stream::impl::DispatchedSubscriberStep;
+      if (!terminate_sent_ && terminate_signal_) {
+        terminate_sent_ = true;
+        if (subscriber_.Terminate() != ss::TerminationResponse::Wait) {
+          return step_t::Done;
+        }
+      }
+      const auto head_idx = impl_->persister.HeadAndLastPublishedIndexAndTimestamp();
+      const uint64_t size = Exists(head_idx.idxts) ? Value(head_idx.idxts).index + 1 : 0;
+      // As in `HasSomethingToProcess()`, the head alone is passed on the first step, or once past `begin_idx`.
+      if (!(head_idx.head > head_) || (!first_step_ && size <= index_ && index_ == begin_idx_)) {
+        return step_t::Idle;
+      }
+      first_step_ = false;
+      if (size > index_) {
+        const uint64_t end = size - index_ > max_entries ? index_ + max_entries : size;
+        if (PassEntriesToSubscriber(*impl_, index_, end) == ss::EntryResponse::Done) {
+          return step_t::Done;
+        }
+        index_ = end;
+        if (end < size) {
+          // The head has not been reached yet, keep it as is until it has.
+          return step_t::More;
+        }
+        head_ = Value(head_idx.idxts).us;
+      }
+      if (size >= begin_idx_ && head_idx.head > head_ && subscriber_(head_idx.head) == ss::EntryResponse::Done) {
+        return step_t::Done;
+      }
+      head_ = head_idx.head;
+      return step_t::More;
+    }
+
+    // Whether there is something new for the subscriber. Must be called with `publishing_mutex` locked.
+    bool HasSomethingToProcess() const {
+      return terminate_signal_ ||
+             impl_->persister.template Size<current::locks::MutexLockStatus::AlreadyLocked>() > index_ ||
+             (index_ > begin_idx_ &&
+              impl_->persister.template CurrentHead<current::locks::MutexLockStatus::AlreadyLocked>() > head_);
+    }
+
+    void ThreadImpl() {
+      while (true) {
+        const auto step = Step(std::numeric_limits<uint64_t>::max());
+        if (step == current::stream::impl::DispatchedSubscriberStep::Done) {
+          return;
+        } else if (step == current::stream::impl::DispatchedSubscriberStep::Idle) {
+          // Observe the epoch first, so that whatever is published after the check below does advance it.
+          const uint64_t epoch = impl_->epoch.Value();
+          {
+            std::lock_guard<std::mutex> lock(impl_->publishing_mutex);
+            if (HasSomethingToProcess()) {
+              continue;
             }
-            index = size;
-            head = Value(head_idx.idxts).us;
-          }
-          if (size >= begin_idx && head_idx.head > head && subscriber_(head_idx.head) == ss::EntryResponse::Done) {
-            return;
           }
-          head = head_idx.head;
-        } else {
-          std::unique_lock<std::mutex> lock(impl_->publishing_mutex);
-          current::WaitableTerminateSignalBulkNotifier::Scope scope(impl_->notifier, terminate_signal_);
-          terminate_signal_.WaitUntil(lock, [this, &index, &begin_idx, &head]() {
-            return terminate_signal_ ||
-                   impl_->persister.template Size<current::locks::MutexLockStatus::AlreadyLocked>() > index ||
-                   (index > begin_idx &&
-                    impl_->persister.template CurrentHead<current::locks::MutexLockStatus::AlreadyLocked>() > head);
-          });
+          impl_->epoch.WaitForAdvance(epoch, terminate_signal_);
+        }
+      }
+    }
+
+    // A single step of the subscriber run by a `SubscriberDispatcher`. Going `Idle` is safe, as the stream
+    // wakes up its dispatched subscribers once there is more to process, and the dispatcher runs a subscriber
+    // once again if it was woken up while being run.
+    current::stream::impl::DispatchedSubscriberStep DispatchedStep() {
+      auto step = Step(dispatched_->Dispatcher().MaxEntriesPerStep());
+      if (step == current::stream::impl::DispatchedSubscriberStep::Idle) {
+        std::lock_guard<std::mutex> lock(impl_->publishing_mutex);
+        if (HasSomethingToProcess()) {
+          step = current::stream::impl::DispatchedSubscriberStep::More;
         }
+      } else if (step == current::stream::impl::DispatchedSubscriberStep::Done) {
+        OnDone();
       }
+      return step;
     }
   };
 
@@ -464,6 +713,21 @@ class Stream final {
     return SubscriberScopeUnchecked<F>(impl_, subscriber, begin_idx, from_us, done_callback);
   }
 
+  // Subscribes to the entries parsed into `PROJECTION`, a `CURRENT_STRUCT` with some of the fields of the entry,
+  // of the same names and types. The rest of the fields are skipped over, not materialized, which is what makes
+  // reading a few fields out of a large entry fast, particularly from the persisters that keep the entries as JSON.
+  template <typename PROJECTION, typename F>
+  SubscriberScopeImpl<F, PROJECTION, SubscriptionMode::Projected> SubscribeProjected(
+      F& subscriber,
+      uint64_t begin_idx = 0u,
+      std::chrono::microseconds from_us = std::chrono::microseconds(0),
+      std::function<void()> done_callback = nullptr) const {
+    static_assert(IS_CURRENT_STRUCT(PROJECTION), "The projection must be a `CURRENT_STRUCT`.");
+    static_assert(current::ss::IsStreamSubscriber<F, PROJECTION>::value, "");
+    return SubscriberScopeImpl<F, PROJECTION, SubscriptionMode::Projected>(
+        impl_, subscriber, begin_idx, from_us, done_callback);
+  }
+
   // Generates a random HTTP subscription.
   static std::string GenerateRandomHTTPSubscriptionID() {
     return current::SHA256("stream_http_subscription_" +
@@ -525,6 +789,11 @@ class Stream final {
       return;
     }
 
+    if (request_params.bulk) {
+      ServeBulkViaHTTP(std::move(r), *borrowed_impl, request_params, stream_size);
+      return;
+    }
+
     if (request_params.schema_requested) {
       const std::string& schema_format = request_params.schema_format;
       // Return the schema the user is requesting, in a top-level, or more fine-grained format.
@@ -569,6 +838,21 @@ class Stream final {
         begin_idx = std::max(begin_idx, idx_by_timestamp);
       }
 
+      if (!request_params.types.empty()) {
+        const std::vector<std::string> cases = impl::VariantCaseNames<entry_t>::Get();
+        if (cases.empty()) {
+          r("The `?type` parameter is only supported for streams of `Variant`-s.\n", HTTPResponseCode.BadRequest);
+          return;
+        }
+        for (const std::string& type : request_params.types) {
+          if (std::find(cases.begin(), cases.end(), type) == cases.end()) {
+            r("The `?type` parameter is invalid, legal values are `" + current::strings::Join(cases, "`, `") + "`.\n",
+              HTTPResponseCode.BadRequest);
+            return;
+          }
+        }
+      }
+
       if (request_params.no_wait && begin_idx >= stream_size) {
         // Return "204 No Content" if there is nothing to return now and we were asked to not wait for new entries.
         r("", HTTPResponseCode.NoContent);
@@ -577,14 +861,26 @@ class Stream final {
 
       const std::string subscription_id = GenerateRandomHTTPSubscriptionID();
 
+      const HTTPSubscriberFlowControl flow_control = [&borrowed_impl]() {
+        std::lock_guard<std::mutex> lock(borrowed_impl->http_subscriptions_mutex);
+        return borrowed_impl->http_subscriber_flow_control;
+      }();
+      // The in-memory persisters, which keep no serialized form of the entries, would serialize them for each
+      // unchecked subscriber separately, while the entries passed to the checked ones are serialized once for all
+      // subscribers, see `SerializedEntriesCache`. The outputs are the same as long as the format is the default one.
+      constexpr bool kPersisterKeepsNoSerializedEntries =
+          !current::ss::PersisterServesRawEntriesSpans<persistence_layer_t>::value &&
+          !current::ss::PersisterAcceptsSerializedEntries<persistence_layer_t>::value;
+      const bool checked = request_params.checked ||
+                           (kPersisterKeepsNoSerializedEntries && std::is_same_v<J, JSONFormat::Current>);
       auto http_chunked_subscriber = std::make_unique<PubSubHTTPEndpoint<entry_t, PERSISTENCE_LAYER, J>>(
-          subscription_id, borrowed_impl, std::move(r), std::move(request_params));
+          subscription_id, borrowed_impl, std::move(r), std::move(request_params), flow_control);
       const auto done_callback = [borrowed_impl, subscription_id]() {
         // Note: Called from a locked section of `borrowed_impl->http_subscriptions_mutex`.
         borrowed_impl->http_subscriptions[subscription_id].second = nullptr;
       };
       current::stream::SubscriberScope http_chunked_subscriber_scope =
-          request_params.checked ? static_cast<current::stream::SubscriberScope>(
+          checked ? static_cast<current::stream::SubscriberScope>(
                                        Subscribe(*http_chunked_subscriber, begin_idx, from_timestamp, done_callback))
                                  : static_cast<current::stream::SubscriberScope>(SubscribeUnchecked(
                                        *http_chunked_subscriber, begin_idx, from_timestamp, done_callback));
@@ -600,6 +896,47 @@ class Stream final {
     }
   }
 
+  // Serves the persisted entries as they are in the file, see `bulk` in `pubsub.h`.
+  static void ServeBulkViaHTTP(Request r,
+                               const impl_t& impl,
+                               const ParsedHTTPRequestParams& request_params,
+                               uint64_t stream_size) {
+    if constexpr (!current::ss::PersisterServesRawEntriesSpans<persistence_layer_t>::value) {
+      r("The `?bulk` parameter is only supported for the persisters that keep the raw log lines.\n",
+        HTTPResponseCode.NotImplemented);
+    } else {
+      const uint64_t begin_idx = request_params.i;
+      if (begin_idx >= stream_size) {
+        r("",
+          HTTPResponseCode.NoContent,
+          current::net::http::Headers({{kStreamHeaderCurrentStreamSize, current::ToString(stream_size)}}));
+        return;
+      }
+      const uint64_t end_idx =
+          request_params.n ? std::min(stream_size, begin_idx + request_params.n) : stream_size;
+      const uint64_t max_bytes =
+          request_params.stop_after_bytes ? request_params.stop_after_bytes : kDefaultBulkResponseMaxBytes;
+      std::string body;
+      uint64_t body_end_idx = begin_idx;
+      impl.persister.IterateRawSpans(begin_idx, end_idx, [&](const ss::RawEntriesSpan& span) {
+        // At least one span is returned, the spans themselves are capped in size by the persister.
+        if (!body.empty() && body.length() + span.size > max_bytes) {
+          return false;
+        }
+        body.append(span.data, span.size);
+        body_end_idx = span.end_index;
+        return true;
+      });
+      r(body,
+        HTTPResponseCode.OK,
+        current::net::http::Headers({{kStreamHeaderCurrentStreamSize, current::ToString(stream_size)},
+                                     {kStreamHeaderBulkBegin, current::ToString(begin_idx)},
+                                     {kStreamHeaderBulkEnd, current::ToString(body_end_idx)},
+                                     {kStreamHeaderBulkCRC32C, current::ToString(CRC32C(body))}}),
+        current::net::constants::kDefaultContentType);
+    }
+  }
+
   void operator()(Request r) {
     if (r.url.query.has("json")) {
       const auto& json = r.url.query["json"];
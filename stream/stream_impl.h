@@ -27,10 +27,13 @@ SOFTWARE.
 
 #include "../port.h"
 
+#include <atomic>
+#include <chrono>
 #include <map>
 #include <thread>
 #include <type_traits>
 
+#include "../bricks/system/placement.h"
 #include "../bricks/util/random.h"
 #include "../bricks/util/waitable_terminate_signal.h"
 
@@ -38,11 +41,20 @@ SOFTWARE.
 #include "../blocks/persistence/file.h"
 #include "../blocks/ss/pubsub.h"
 
+#include "../typesystem/struct.h"
+
+#include "dispatcher.h"
+#include "serialized_cache.h"
+
 namespace current {
 namespace stream {
 
 constexpr static const char* kStreamHeaderCurrentStreamSize = "X-Current-Stream-Size";
 constexpr static const char* kStreamHeaderCurrentSubscriptionId = "X-Current-Stream-Subscription-Id";
+constexpr static const char* kStreamHeaderBulkBegin = "X-Current-Stream-Bulk-Begin";
+constexpr static const char* kStreamHeaderBulkEnd = "X-Current-Stream-Bulk-End";
+constexpr static const char* kStreamHeaderBulkCRC32C = "X-Current-Stream-Bulk-CRC32C";
+constexpr static uint64_t kDefaultBulkResponseMaxBytes = 16ull * 1024 * 1024;
 
 // A generic top-level `SubscriberScope` to unite any implementations, to allow `std::move()`-ing them into one.
 // Features:
@@ -94,11 +106,44 @@ class SubscriberScope {
   std::unique_ptr<SubscriberThread> thread_;
 };
 
+// What to do with an HTTP subscriber that has fallen behind the end of the stream, see `HTTPSubscriberFlowControl`.
+enum class SlowHTTPSubscriberPolicy : int { Block = 0, Disconnect = 1, SkipToHead = 2 };
+
+// The per-stream settings to keep slow HTTP subscribers from holding the resources of the server indefinitely.
+// The default is to block: send each entry to each subscriber, waiting as long as it takes.
+struct HTTPSubscriberFlowControl final {
+  // Applied once a subscriber is more than `lag_high_watermark` entries behind the end of the stream.
+  // `Disconnect` ends the subscription, and `SkipToHead` skips the entries until the subscriber is only
+  // `lag_low_watermark` entries behind. The lag is measured as is, so a subscription that starts
+  // far behind the end of the stream is subject to the policy as well.
+  SlowHTTPSubscriberPolicy policy = SlowHTTPSubscriberPolicy::Block;
+  uint64_t lag_high_watermark = 0u;
+  uint64_t lag_low_watermark = 0u;
+  // If set, the subscriber is disconnected once a write to it blocks for longer than this.
+  std::chrono::milliseconds write_timeout = std::chrono::milliseconds(0);
+  // If set, bounds the size of the OS-side buffer of the data not yet received by the subscriber.
+  size_t send_buffer_size = 0u;
+};
+
+CURRENT_STRUCT(HTTPSubscriberStatus) {
+  CURRENT_FIELD(subscription_id, std::string);
+  CURRENT_FIELD(next_index, uint64_t, 0ull);
+  CURRENT_FIELD_DESCRIPTION(next_index, "The index of the first entry the subscriber has not been given yet.");
+  CURRENT_FIELD(lag, uint64_t, 0ull);
+  CURRENT_FIELD_DESCRIPTION(lag, "The number of entries between `next_index` and the end of the stream.");
+  CURRENT_FIELD(sent_entries, uint64_t, 0ull);
+  CURRENT_FIELD(skipped_entries, uint64_t, 0ull);
+  CURRENT_FIELD_DESCRIPTION(skipped_entries, "The entries not sent due to `SlowHTTPSubscriberPolicy::SkipToHead`.");
+  CURRENT_FIELD(sent_bytes, uint64_t, 0ull);
+};
+
 // For asynchronous HTTP subscriptions to be terminatable, they are stored as `std::unique_ptr`-s,
 // which does need an abstract base.
 class AbstractSubscriberObject {
  public:
   virtual ~AbstractSubscriberObject() = default;
+  // THREAD-SAFE. The `subscription_id` and `lag` fields are filled in by the stream.
+  virtual HTTPSubscriberStatus Status() const { return HTTPSubscriberStatus(); }
 };
 
 template <typename ENTRY, template <typename> class PERSISTENCE_LAYER>
@@ -106,16 +151,45 @@ struct StreamImpl {
   using entry_t = ENTRY;
   using persistence_layer_t = PERSISTENCE_LAYER<entry_t>;
 
-  // Publishing-related mutex and notifier are mutable to wait on them from the subscriber thread.
+  // Publishing-related mutex and epoch are mutable to wait on them from the subscriber thread.
+  // The epoch is advanced after each publish and head update, and the idle subscriber threads wait on it
+  // without holding `publishing_mutex`.
   mutable std::mutex publishing_mutex;
   persistence_layer_t persister;
-  mutable current::WaitableTerminateSignalBulkNotifier notifier;
+  mutable current::WaitableEpoch epoch;
+
+  // The subscribers run by a `SubscriberDispatcher`, if any, are woken up on the same events as `epoch` advances on.
+  // The dispatcher itself is the one to use for new subscriptions, or `nullptr` to spawn a thread for each.
+  mutable impl::DispatchedSubscribers dispatched_subscribers;
+  std::atomic<SubscriberDispatcher*> subscriber_dispatcher{nullptr};
 
   // The HTTP-subscription-related logic is `mutable` because subscribing to a stream is `const` by convention.
   using http_subscriptions_t =
       std::unordered_map<std::string, std::pair<SubscriberScope, std::unique_ptr<AbstractSubscriberObject>>>;
   mutable std::mutex http_subscriptions_mutex;
   mutable http_subscriptions_t http_subscriptions;
+  // Applies to the HTTP subscriptions made after it is set. Guarded by `http_subscriptions_mutex`.
+  HTTPSubscriberFlowControl http_subscriber_flow_control;
+  // The entries as serialized for the HTTP subscribers, shared by all of them.
+  mutable SerializedEntriesCache<entry_t> http_serialized_entries;
+
+  // The CPUs for the subscriber threads of this stream, if not the ones of `ThreadRole::StreamSubscriber`.
+  mutable std::mutex subscriber_cpus_mutex;
+  current::bricks::system::CPUSet subscriber_cpus;
+
+  // Called by the dedicated subscriber threads of this stream as they start.
+  void PlaceSubscriberThread() const {
+    const current::bricks::system::CPUSet cpus = [this]() {
+      std::lock_guard<std::mutex> lock(subscriber_cpus_mutex);
+      return subscriber_cpus;
+    }();
+    if (cpus.Empty()) {
+      current::bricks::system::ThreadPlacementPolicy().PlaceCurrentThread(
+          current::bricks::system::ThreadRole::StreamSubscriber);
+    } else {
+      current::bricks::system::PlaceCurrentThreadOnCPUs(cpus);
+    }
+  }
 
   template <typename... ARGS>
   StreamImpl(ARGS&&... args) : persister(publishing_mutex, std::forward<ARGS>(args)...) {}
@@ -138,21 +212,63 @@ class StreamPublisherImpl {
   idxts_t PublisherPublishImpl(E&& e, TIMESTAMP&& timestamp) {
     const auto result =
         data_->persister.template PersisterPublishImpl<MLS>(std::forward<E>(e), std::forward<TIMESTAMP>(timestamp));
-    data_->notifier.NotifyAllOfExternalWaitableEvent();
+    data_->epoch.Advance();
+    data_->dispatched_subscribers.WakeAll();
     return result;
   }
 
   template <current::locks::MutexLockStatus MLS>
   idxts_t PublisherPublishUnsafeImpl(const std::string& raw_log_line) {
     const auto result = data_->persister.template PersisterPublishUnsafeImpl<MLS>(raw_log_line);
-    data_->notifier.NotifyAllOfExternalWaitableEvent();
+    data_->epoch.Advance();
+    data_->dispatched_subscribers.WakeAll();
+    return result;
+  }
+
+  // The persisters that do not store the entries serialized get them parsed back.
+  template <current::locks::MutexLockStatus MLS, typename TIMESTAMP>
+  idxts_t PublisherPublishSerializedImpl(const std::string& entry_json, TIMESTAMP&& timestamp) {
+    idxts_t result;
+    if constexpr (ss::PersisterAcceptsSerializedEntries<typename data_t::persistence_layer_t>::value) {
+      result = data_->persister.template PersisterPublishSerializedImpl<MLS>(entry_json,
+                                                                              std::forward<TIMESTAMP>(timestamp));
+    } else {
+      result = data_->persister.template PersisterPublishImpl<MLS>(ParseJSON<ENTRY>(entry_json),
+                                                                   std::forward<TIMESTAMP>(timestamp));
+    }
+    data_->epoch.Advance();
+    data_->dispatched_subscribers.WakeAll();
+    return result;
+  }
+
+  // The persisters that do not store the raw log lines as they are get them one by one.
+  template <current::locks::MutexLockStatus MLS>
+  idxts_t PublisherPublishRawEntriesImpl(std::string_view raw_entries) {
+    idxts_t result;
+    if constexpr (ss::PersisterAcceptsRawEntries<typename data_t::persistence_layer_t>::value) {
+      result = data_->persister.template PersisterPublishRawEntriesImpl<MLS>(raw_entries);
+    } else {
+      current::locks::SmartMutexLockGuard<MLS> lock(data_->publishing_mutex);
+      if (raw_entries.empty()) {
+        CURRENT_THROW(persistence::MalformedEntryException(std::string()));
+      }
+      while (!raw_entries.empty()) {
+        const size_t eol = raw_entries.find('\n');
+        result = data_->persister.template PersisterPublishUnsafeImpl<current::locks::MutexLockStatus::AlreadyLocked>(
+            std::string(raw_entries.substr(0u, eol)));
+        raw_entries = eol == std::string_view::npos ? std::string_view() : raw_entries.substr(eol + 1u);
+      }
+    }
+    data_->epoch.Advance();
+    data_->dispatched_subscribers.WakeAll();
     return result;
   }
 
   template <current::locks::MutexLockStatus MLS, typename TIMESTAMP>
   void PublisherUpdateHeadImpl(TIMESTAMP&& timestamp) {
     data_->persister.template PersisterUpdateHeadImpl<MLS>(std::forward<TIMESTAMP>(timestamp));
-    data_->notifier.NotifyAllOfExternalWaitableEvent();
+    data_->epoch.Advance();
+    data_->dispatched_subscribers.WakeAll();
   }
 
  private:
@@ -27,7 +27,12 @@ SOFTWARE.
 #define CURRENT_BUILD_WITH_PARANOIC_RUNTIME_CHECKS
 
 #include "stream.h"
+#include "merge.h"
+#include "partitioned.h"
+#include "read_model.h"
 #include "replicator.h"
+#include "sequencer.h"
+#include "serialized_cache.h"
 
 #include <string>
 #include <atomic>
@@ -494,6 +499,139 @@ using RecordsUncheckedCollector = current::ss::StreamSubscriber<RecordsUnchecked
 
 }  // namespace stream_unittest
 
+TEST(Stream, SubscribersRunOnDispatcher) {
+  current::time::ResetToZero();
+
+  using namespace stream_unittest;
+
+  auto stream = current::stream::Stream<Record>::CreateStream();
+  // Two threads, and at most seven entries per step, to have the subscribers interleave.
+  current::stream::SubscriberDispatcher dispatcher(2u, 7u);
+  EXPECT_EQ(2u, dispatcher.ThreadsCount());
+  stream->SetSubscriberDispatcher(&dispatcher);
+
+  std::vector<std::string> expected;
+  const auto Publish = [&](int x) {
+    stream->Publisher()->Publish(Record(x), std::chrono::microseconds(x * 10 + 10));
+    expected.push_back(JSON(Record(x)) + '\n');
+  };
+  for (int x = 0; x < 50; ++x) {
+    Publish(x);
+  }
+
+  {
+    // The terminating subscriber that asks to `Wait` keeps receiving entries, as it does in its own thread.
+    Data d;
+    StreamTestProcessor p(d, false);
+    p.SetMax(25u);
+    stream->Subscribe(p);  // With no return value collection to capture the scope, it's a blocking call.
+    EXPECT_EQ(25u, d.seen_);
+  }
+
+  constexpr size_t kSubscribers = 40u;
+  std::vector<std::vector<std::string>> rows(kSubscribers);
+  std::vector<std::vector<std::string>> entries(kSubscribers);
+  std::vector<std::unique_ptr<RecordsCollector>> collectors;
+  std::vector<std::unique_ptr<RecordsUncheckedCollector>> unchecked_collectors;
+  std::vector<current::stream::SubscriberScope> scopes;
+  for (size_t i = 0; i < kSubscribers; i += 2u) {
+    collectors.push_back(std::make_unique<RecordsCollector>(rows[i], entries[i]));
+    scopes.push_back(stream->Subscribe(*collectors.back()));
+    unchecked_collectors.push_back(std::make_unique<RecordsUncheckedCollector>(rows[i + 1], entries[i + 1]));
+    scopes.push_back(stream->SubscribeUnchecked(*unchecked_collectors.back()));
+  }
+
+  for (int x = 50; x < 100; ++x) {
+    Publish(x);
+  }
+
+  const auto AllDone = [&]() {
+    for (const auto& c : collectors) {
+      if (c->count_ < 100u) {
+        return false;
+      }
+    }
+    for (const auto& c : unchecked_collectors) {
+      if (c->count_ < 100u) {
+        return false;
+      }
+    }
+    return true;
+  };
+  while (!AllDone()) {
+    std::this_thread::yield();
+  }
+  for (const auto& scope : scopes) {
+    EXPECT_TRUE(scope);
+  }
+  scopes.clear();
+
+  for (size_t i = 0; i < kSubscribers; ++i) {
+    EXPECT_EQ(Join(expected, ""), Join(entries[i], "")) << i;
+  }
+
+  // The subscriptions made after reverting to the default run in their own threads, and behave the same way.
+  stream->SetSubscriberDispatcher(nullptr);
+  {
+    Data d;
+    StreamTestProcessor p(d, false);
+    p.SetMax(100u);
+    stream->SubscribeUnchecked(p);
+    EXPECT_EQ(100u, d.seen_);
+  }
+}
+
+TEST(Stream, SubscriberWakeupCoalescing) {
+  current::time::ResetToZero();
+
+  using namespace stream_unittest;
+
+  auto stream = current::stream::Stream<Record>::CreateStream();
+  stream->SetSubscriberWakeupCoalescing(std::chrono::milliseconds(1));
+
+  constexpr size_t kSubscribers = 20u;
+  std::vector<std::vector<std::string>> rows(kSubscribers);
+  std::vector<std::vector<std::string>> entries(kSubscribers);
+  std::vector<std::unique_ptr<RecordsCollector>> collectors;
+  std::vector<current::stream::SubscriberScope> scopes;
+  for (size_t i = 0; i < kSubscribers; ++i) {
+    collectors.push_back(std::make_unique<RecordsCollector>(rows[i], entries[i]));
+    scopes.push_back(stream->Subscribe(*collectors.back()));
+  }
+
+  // Publish in bursts, for the subscribers to be idle, and then woken up, several times.
+  std::vector<std::string> expected;
+  for (int x = 0; x < 100; ++x) {
+    stream->Publisher()->Publish(Record(x), std::chrono::microseconds(x * 10 + 10));
+    expected.push_back(JSON(Record(x)) + '\n');
+    if (x % 25 == 24) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  }
+
+  const auto AllDone = [&]() {
+    for (const auto& c : collectors) {
+      if (c->count_ < 100u) {
+        return false;
+      }
+    }
+    return true;
+  };
+  while (!AllDone()) {
+    std::this_thread::yield();
+  }
+
+  // The idle subscribers terminate promptly, even with a coalescing window far longer than this test.
+  stream->SetSubscriberWakeupCoalescing(std::chrono::seconds(60));
+  stream->Publisher()->Publish(Record(100), std::chrono::microseconds(1010));
+  scopes.clear();
+
+  for (size_t i = 0; i < kSubscribers; ++i) {
+    EXPECT_EQ(Join(expected, ""), Join(std::vector<std::string>(entries[i].begin(), entries[i].begin() + 100), ""))
+        << i;
+  }
+}
+
 TEST(Stream, SubscribeToStreamViaHTTP) {
   current::time::ResetToZero();
 
@@ -890,6 +1028,44 @@ TEST(Stream, SubscribeToStreamViaHTTP) {
   // TODO(dkorolev): Add tests that the endpoint is not unregistered until its last client is done. (?)
 }
 
+TEST(Stream, HTTPSubscribersShareSerializedEntries) {
+  current::time::ResetToZero();
+
+  using namespace stream_unittest;
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  static_cast<void>(http_server);
+
+  auto exposed_stream = current::stream::Stream<Record>::CreateStream();
+  const std::string base_url = Printf("http://localhost:%d/exposed", port);
+  const auto scope = HTTP(port).Register("/exposed", *exposed_stream);
+
+  exposed_stream->Publisher()->Publish(Record(1), std::chrono::microseconds(100));
+  exposed_stream->Publisher()->Publish(Record(2), std::chrono::microseconds(200));
+  exposed_stream->Publisher()->Publish(Record(3), std::chrono::microseconds(300));
+
+  const std::string expected =
+      "{\"index\":0,\"us\":100}\t{\"x\":1}\n"
+      "{\"index\":1,\"us\":200}\t{\"x\":2}\n"
+      "{\"index\":2,\"us\":300}\t{\"x\":3}\n";
+  const auto& cache = exposed_stream->Impl()->http_serialized_entries;
+
+  // The first subscriber serializes the entries, the ones that follow reuse what it has serialized.
+  EXPECT_EQ(expected, HTTP(GET(base_url + "?nowait")).body);
+  EXPECT_EQ(3u, cache.Misses());
+  EXPECT_EQ(0u, cache.Hits());
+  EXPECT_EQ(expected, HTTP(GET(base_url + "?nowait&checked")).body);
+  EXPECT_EQ("{\"x\":2}\n{\"x\":3}\n", HTTP(GET(base_url + "?nowait&entries_only&i=1")).body);
+  EXPECT_EQ(3u, cache.Misses());
+  EXPECT_EQ(5u, cache.Hits());
+
+  // Each JSON format is cached on its own.
+  EXPECT_EQ("{\"x\":3}\n", HTTP(GET(base_url + "?nowait&entries_only&i=2&json=minimalistic&checked")).body);
+  EXPECT_EQ(4u, cache.Misses());
+}
+
 TEST(Stream, HTTPSubscriptionCanBeTerminated) {
   current::time::ResetToZero();
 
@@ -963,6 +1139,126 @@ TEST(Stream, HTTPSubscriptionCanBeTerminated) {
   slow_subscriber.join();
 }
 
+TEST(Stream, HTTPSubscriberFlowControl) {
+  current::time::ResetToZero();
+
+  using namespace stream_unittest;
+  using current::stream::HTTPSubscriberFlowControl;
+  using current::stream::HTTPSubscriberStatus;
+  using current::stream::SlowHTTPSubscriberPolicy;
+
+  const std::string persistence_file_name = current::FileSystem::JoinPath(FLAGS_stream_test_tmpdir, "data_flow");
+  const auto persistence_file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+
+  auto file_stream = current::stream::Stream<Record, current::persistence::File>::CreateStream(persistence_file_name);
+  auto memory_stream = current::stream::Stream<Record>::CreateStream();
+  for (int x = 0; x < 1000; ++x) {
+    file_stream->Publisher()->Publish(Record(x), std::chrono::microseconds(x + 1));
+    memory_stream->Publisher()->Publish(Record(x), std::chrono::microseconds(x + 1));
+  }
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  static_cast<void>(http_server);
+  const auto file_scope = HTTP(port).Register("/file", *file_stream);
+  const auto memory_scope = HTTP(port).Register("/memory", *memory_stream);
+
+  const auto GetIndexes = [port](const std::string& path) {
+    const auto result = HTTP(GET(Printf("http://localhost:%d%s", port, path.c_str())));
+    EXPECT_EQ(200, static_cast<int>(result.code)) << path;
+    std::vector<uint64_t> indexes;
+    for (const std::string& line : current::strings::Split(result.body, '\n')) {
+      indexes.push_back(ParseJSON<idxts_t>(line.substr(0, line.find('\t'))).index);
+    }
+    return indexes.empty() ? "" : Printf("%d..%d", int(indexes.front()), int(indexes.back()));
+  };
+
+  HTTPSubscriberFlowControl flow_control;
+  flow_control.lag_high_watermark = 100u;
+  flow_control.lag_low_watermark = 10u;
+
+  // The subscribers starting from the beginning are more than 100 entries behind.
+  flow_control.policy = SlowHTTPSubscriberPolicy::SkipToHead;
+  file_stream->SetHTTPSubscriberFlowControl(flow_control);
+  memory_stream->SetHTTPSubscriberFlowControl(flow_control);
+  for (const std::string path : {"/file?nowait", "/memory?nowait", "/file?nowait&checked"}) {
+    EXPECT_EQ("989..999", GetIndexes(path)) << path;
+    EXPECT_EQ("950..999", GetIndexes(path + "&i=950")) << path;
+    EXPECT_EQ("989..993", GetIndexes(path + "&n=5")) << path;
+  }
+
+  flow_control.policy = SlowHTTPSubscriberPolicy::Disconnect;
+  file_stream->SetHTTPSubscriberFlowControl(flow_control);
+  memory_stream->SetHTTPSubscriberFlowControl(flow_control);
+  for (const std::string path : {"/file?nowait", "/memory?nowait", "/file?nowait&checked"}) {
+    EXPECT_EQ("", GetIndexes(path)) << path;
+    EXPECT_EQ("950..999", GetIndexes(path + "&i=950")) << path;
+  }
+
+  // The status of an active subscription reflects the entries sent and skipped.
+  flow_control.policy = SlowHTTPSubscriberPolicy::SkipToHead;
+  memory_stream->SetHTTPSubscriberFlowControl(flow_control);
+  EXPECT_TRUE(memory_stream->HTTPSubscribersStatus().empty());
+
+  std::string subscription_id;
+  std::atomic_bool chunks_done(false);
+  std::thread subscriber([&]() {
+    const auto result = HTTP(ChunkedGET(
+        Printf("http://localhost:%d/memory", port),
+        [&subscription_id](const std::string& header, const std::string& value) {
+          if (header == "X-Current-Stream-Subscription-Id") {
+            subscription_id = value;
+          }
+        },
+        [](const std::string&) {},
+        [&chunks_done]() { chunks_done = true; }));
+    EXPECT_EQ(200, static_cast<int>(result));
+  });
+
+  std::vector<HTTPSubscriberStatus> status;
+  do {
+    std::this_thread::yield();
+    status = memory_stream->HTTPSubscribersStatus();
+  } while (status.empty() || status.front().next_index < 1000u);
+
+  ASSERT_EQ(1u, status.size());
+  EXPECT_EQ(1000u, status.front().next_index);
+  EXPECT_EQ(0u, status.front().lag);
+  EXPECT_EQ(11u, status.front().sent_entries);
+  EXPECT_EQ(989u, status.front().skipped_entries);
+  EXPECT_EQ(status.front().subscription_id.length(), 64u);
+
+  memory_stream->Publisher()->Publish(Record(1000), std::chrono::microseconds(1001));
+  do {
+    std::this_thread::yield();
+    status = memory_stream->HTTPSubscribersStatus();
+  } while (status.front().sent_entries < 12u);
+  EXPECT_EQ(1001u, status.front().next_index);
+
+  // The status is published into the metrics registry too.
+  {
+    current::metrics::Registry registry;
+    const auto scope = memory_stream->PublishMetrics("memory", registry);
+    const current::metrics::MetricsSnapshot snapshot = registry.Snapshot();
+    ASSERT_EQ(5u, snapshot.metrics.size());
+    EXPECT_EQ("stream_http_subscriber_lag", snapshot.metrics[0].name);
+    EXPECT_EQ(status.front().subscription_id, snapshot.metrics[0].labels.at("subscription"));
+    EXPECT_EQ("stream_size", snapshot.metrics[4].name);
+    EXPECT_EQ(1001.0, snapshot.metrics[4].value);
+  }
+
+  while (subscription_id.empty()) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(subscription_id, status.front().subscription_id);
+  const auto result = HTTP(GET(Printf("http://localhost:%d/memory?terminate=%s", port, subscription_id.c_str())));
+  EXPECT_EQ(200, static_cast<int>(result.code));
+  subscriber.join();
+  EXPECT_TRUE(chunks_done);
+  EXPECT_TRUE(memory_stream->HTTPSubscribersStatus().empty());
+}
+
 const std::string golden_signature() {
   current::reflection::StructSchema struct_schema;
   struct_schema.AddType<stream_unittest::Record>();
@@ -1304,6 +1600,133 @@ TEST(Stream, UncheckedVsCheckedSubscription) {
   }
 }
 
+TEST(Stream, ServesRawEntriesFromFileViaHTTP) {
+  current::time::ResetToZero();
+
+  using namespace stream_unittest;
+
+  using endpoint_t = current::stream::PubSubHTTPEndpoint<Record, current::persistence::File, JSONFormat::Current>;
+  static_assert(current::ss::IsRawEntriesSpanSubscriber<endpoint_t>::value, "");
+
+  const std::string persistence_file_name = current::FileSystem::JoinPath(FLAGS_stream_test_tmpdir, "data_raw");
+  const auto persistence_file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+
+  auto file_stream = current::stream::Stream<Record, current::persistence::File>::CreateStream(persistence_file_name);
+  auto memory_stream = current::stream::Stream<Record>::CreateStream();
+  for (int x = 0; x < 1000; ++x) {
+    const auto us = std::chrono::microseconds(x * 10 + 10);
+    file_stream->Publisher()->Publish(Record(x), us);
+    memory_stream->Publisher()->Publish(Record(x), us);
+    if (x % 300 == 299) {
+      file_stream->Publisher()->UpdateHead(us + std::chrono::microseconds(5));
+      memory_stream->Publisher()->UpdateHead(us + std::chrono::microseconds(5));
+    }
+  }
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  static_cast<void>(http_server);
+  const auto file_scope = HTTP(port).Register("/file", *file_stream);
+  const auto memory_scope = HTTP(port).Register("/memory", *memory_stream);
+
+  // The file-backed stream serves the persisted bytes as is, and the in-memory one serializes each entry,
+  // and the results must be the same, with or without the parameters that require looking into each entry.
+  for (const std::string query : {"?nowait",
+                                  "?nowait&i=123",
+                                  "?nowait&i=250&n=100",
+                                  "?nowait&n=1",
+                                  "?nowait&tail=5",
+                                  "?nowait&since=5000",
+                                  "?nowait&since=2000&period=500",
+                                  "?nowait&i=990&entries_only",
+                                  "?nowait&i=995&array",
+                                  "?nowait&stop_after_bytes=1000"}) {
+    const auto file_result = HTTP(GET(Printf("http://localhost:%d/file%s", port, query.c_str())));
+    const auto memory_result = HTTP(GET(Printf("http://localhost:%d/memory%s", port, query.c_str())));
+    EXPECT_EQ(200, static_cast<int>(file_result.code)) << query;
+    EXPECT_EQ(memory_result.body, file_result.body) << query;
+    EXPECT_FALSE(file_result.body.empty()) << query;
+  }
+
+  {
+    const auto result = HTTP(GET(Printf("http://localhost:%d/file?nowait&i=998", port)));
+    EXPECT_EQ(
+        "{\"index\":998,\"us\":9990}\t{\"x\":998}\n"
+        "{\"index\":999,\"us\":10000}\t{\"x\":999}\n",
+        result.body);
+  }
+}
+
+TEST(Stream, FiltersVariantEntriesByTypeViaHTTP) {
+  current::time::ResetToZero();
+
+  using namespace stream_unittest;
+  using entry_t = Variant<Record, AnotherRecord>;
+
+  const std::string persistence_file_name = current::FileSystem::JoinPath(FLAGS_stream_test_tmpdir, "data_types");
+  const auto persistence_file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+
+  auto file_stream = current::stream::Stream<entry_t, current::persistence::File>::CreateStream(persistence_file_name);
+  auto memory_stream = current::stream::Stream<entry_t>::CreateStream();
+  auto record_stream = current::stream::Stream<Record>::CreateStream();
+  for (int i = 0; i < 10; ++i) {
+    const auto us = std::chrono::microseconds(i * 10 + 10);
+    if (i % 2 == 0) {
+      file_stream->Publisher()->Publish(Record(i), us);
+      memory_stream->Publisher()->Publish(Record(i), us);
+    } else {
+      file_stream->Publisher()->Publish(AnotherRecord(i), us);
+      memory_stream->Publisher()->Publish(AnotherRecord(i), us);
+    }
+  }
+  record_stream->Publisher()->Publish(Record(0), std::chrono::microseconds(10));
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  static_cast<void>(http_server);
+  const auto file_scope = HTTP(port).Register("/file", *file_stream);
+  const auto memory_scope = HTTP(port).Register("/memory", *memory_stream);
+  const auto record_scope = HTTP(port).Register("/record", *record_stream);
+
+  const auto GetIndexes = [port](const std::string& path) {
+    const auto result = HTTP(GET(Printf("http://localhost:%d%s", port, path.c_str())));
+    EXPECT_EQ(200, static_cast<int>(result.code)) << path;
+    std::vector<std::string> indexes;
+    for (const std::string& line : current::strings::Split(result.body, '\n')) {
+      indexes.push_back(current::ToString(ParseJSON<idxts_t>(line.substr(0, line.find('\t'))).index));
+    }
+    return Join(indexes, ',');
+  };
+
+  for (const std::string stream : {"/file", "/memory"}) {
+    for (const std::string checked : {"", "&checked"}) {
+      const std::string prefix = stream + "?nowait" + checked;
+      EXPECT_EQ("0,2,4,6,8", GetIndexes(prefix + "&type=Record")) << prefix;
+      EXPECT_EQ("1,3,5,7,9", GetIndexes(prefix + "&type=AnotherRecord")) << prefix;
+      EXPECT_EQ("0,1,2,3,4,5,6,7,8,9", GetIndexes(prefix + "&type=AnotherRecord,Record")) << prefix;
+      EXPECT_EQ("3,5", GetIndexes(prefix + "&type=AnotherRecord&i=2&n=2")) << prefix;
+      EXPECT_EQ("6,8", GetIndexes(prefix + "&type=Record&tail=5")) << prefix;
+    }
+    const auto result = HTTP(GET(Printf("http://localhost:%d%s?nowait&type=AnotherRecord&n=1", port, stream.c_str())));
+    EXPECT_EQ(
+        "{\"index\":1,\"us\":20}\t{\"AnotherRecord\":{\"y\":1},\"\":\"T9201000647893547023\"}\n",
+        result.body);
+  }
+
+  {
+    const auto result = HTTP(GET(Printf("http://localhost:%d/file?type=Record,NoSuchRecord", port)));
+    EXPECT_EQ(400, static_cast<int>(result.code));
+    EXPECT_EQ("The `?type` parameter is invalid, legal values are `Record`, `AnotherRecord`.\n", result.body);
+  }
+  {
+    const auto result = HTTP(GET(Printf("http://localhost:%d/record?type=Record", port)));
+    EXPECT_EQ(400, static_cast<int>(result.code));
+    EXPECT_EQ("The `?type` parameter is only supported for streams of `Variant`-s.\n", result.body);
+  }
+}
+
 TEST(Stream, ParseArbitrarilySplitChunks) {
   using namespace stream_unittest;
 
@@ -1367,6 +1790,429 @@ TEST(Stream, ParseArbitrarilySplitChunks) {
   EXPECT_EQ(stream_golden_data, current::FileSystem::ReadFileAsString(persistence_file_name));
 }
 
+TEST(Stream, ReplicateWithParallelParsing) {
+  current::time::ResetToZero();
+
+  using namespace stream_unittest;
+  using stream_t = current::stream::Stream<Record>;
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  static_cast<void>(http_server);
+
+  auto master_stream = stream_t::CreateStream();
+  const auto scope = HTTP(port).Register(
+      "/master", URLPathArgs::CountMask::None | URLPathArgs::CountMask::One, *master_stream);
+  for (int x = 0; x < 2000; ++x) {
+    master_stream->Publisher()->Publish(Record(x), std::chrono::microseconds(x * 10 + 10));
+    if (x % 500 == 499) {
+      master_stream->Publisher()->UpdateHead(std::chrono::microseconds(x * 10 + 15));
+    }
+  }
+
+  auto replicated_stream = stream_t::CreateStream();
+  auto replicator = current::stream::StreamReplicator<stream_t>(replicated_stream);
+  current::stream::SubscribableRemoteStream<Record> remote_stream(Printf("http://localhost:%d/master", port));
+  current::stream::ReplicationParallelism parallelism;
+  parallelism.threads = 4u;
+  parallelism.pipeline_depth = 16u;
+  remote_stream.SetReplicationParallelism(parallelism);
+
+  {
+    const auto subscriber_scope = remote_stream.Subscribe(replicator);
+    // The entries published once the subscription is established are replicated as well.
+    for (int x = 2000; x < 3000; ++x) {
+      master_stream->Publisher()->Publish(Record(x), std::chrono::microseconds(x * 10 + 10));
+    }
+    master_stream->Publisher()->UpdateHead(std::chrono::microseconds(40000));
+    while (replicated_stream->Data()->CurrentHead().count() < 40000) {
+      std::this_thread::yield();
+    }
+  }
+
+  ASSERT_EQ(3000u, replicated_stream->Data()->Size());
+  uint64_t index = 0u;
+  for (const auto& e : replicated_stream->Data()->Iterate()) {
+    EXPECT_EQ(index, e.idx_ts.index);
+    EXPECT_EQ(static_cast<int>(index), e.entry.x);
+    EXPECT_EQ(static_cast<int64_t>(index * 10 + 10), e.idx_ts.us.count());
+    ++index;
+  }
+  EXPECT_EQ(3000u, index);
+}
+
+TEST(Stream, BulkCatchUpOfNewFollowers) {
+  current::time::ResetToZero();
+
+  using namespace stream_unittest;
+  using file_stream_t = current::stream::Stream<Record, current::persistence::File>;
+  using memory_stream_t = current::stream::Stream<Record>;
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  static_cast<void>(http_server);
+
+  const std::string master_file_name = current::FileSystem::JoinPath(FLAGS_stream_test_tmpdir, "bulk_master");
+  const std::string follower_file_name = current::FileSystem::JoinPath(FLAGS_stream_test_tmpdir, "bulk_follower");
+  const std::string flip_follower_file_name = current::FileSystem::JoinPath(FLAGS_stream_test_tmpdir, "bulk_flip");
+  const auto master_file_remover = current::FileSystem::ScopedRmFile(master_file_name);
+  const auto follower_file_remover = current::FileSystem::ScopedRmFile(follower_file_name);
+  const auto flip_follower_file_remover = current::FileSystem::ScopedRmFile(flip_follower_file_name);
+
+  auto master_stream = file_stream_t::CreateStream(master_file_name);
+  auto memory_master_stream = memory_stream_t::CreateStream();
+  for (int x = 0; x < 1000; ++x) {
+    master_stream->Publisher()->Publish(Record(x), std::chrono::microseconds(x * 10 + 10));
+    memory_master_stream->Publisher()->Publish(Record(x), std::chrono::microseconds(x * 10 + 10));
+    if (x % 300 == 299) {
+      master_stream->Publisher()->UpdateHead(std::chrono::microseconds(x * 10 + 15));
+    }
+  }
+  const auto scope =
+      HTTP(port).Register("/master", URLPathArgs::CountMask::None | URLPathArgs::CountMask::One, *master_stream) +
+      HTTP(port).Register(
+          "/memory_master", URLPathArgs::CountMask::None | URLPathArgs::CountMask::One, *memory_master_stream);
+  const std::string master_url = Printf("http://localhost:%d/master", port);
+
+  {
+    const auto response = HTTP(GET(master_url + "?bulk&i=998"));
+    EXPECT_EQ(200, static_cast<int>(response.code));
+    EXPECT_EQ(
+        "{\"index\":998,\"us\":9990}\t{\"x\":998}\n"
+        "{\"index\":999,\"us\":10000}\t{\"x\":999}\n",
+        response.body);
+    EXPECT_EQ("998", response.headers.GetOrDefault(current::stream::kStreamHeaderBulkBegin, ""));
+    EXPECT_EQ("1000", response.headers.GetOrDefault(current::stream::kStreamHeaderBulkEnd, ""));
+    EXPECT_EQ(current::ToString(current::CRC32C(response.body)),
+              response.headers.GetOrDefault(current::stream::kStreamHeaderBulkCRC32C, ""));
+    EXPECT_EQ(204, static_cast<int>(HTTP(GET(master_url + "?bulk&i=1000")).code));
+    EXPECT_EQ(501,
+              static_cast<int>(HTTP(GET(Printf("http://localhost:%d/memory_master?bulk", port))).code));
+  }
+
+  const auto expect_replicated = [](const auto& stream, uint64_t size) {
+    ASSERT_EQ(size, stream->Data()->Size());
+    uint64_t index = 0u;
+    for (const auto& e : stream->Data()->Iterate()) {
+      EXPECT_EQ(index, e.idx_ts.index);
+      EXPECT_EQ(static_cast<int>(index), e.entry.x);
+      EXPECT_EQ(static_cast<int64_t>(index * 10 + 10), e.idx_ts.us.count());
+      ++index;
+    }
+    EXPECT_EQ(size, index);
+  };
+
+  current::stream::SubscribableRemoteStream<Record> remote_stream(master_url);
+  {
+    // Into a file: small batches, each one a run of entries between the `#head` directives of the master.
+    auto follower_stream = file_stream_t::CreateStream(follower_file_name);
+    {
+      auto publisher = follower_stream->BecomeFollowingStream();
+      EXPECT_EQ(1000u, remote_stream.BulkCatchUp(*publisher, 0u, 1000u));
+    }
+    expect_replicated(follower_stream, 1000u);
+  }
+  {
+    // The follower is restarted from what it already has on disk.
+    auto follower_stream = file_stream_t::CreateStream(follower_file_name);
+    expect_replicated(follower_stream, 1000u);
+  }
+  {
+    // Into memory, the batches are published entry by entry.
+    auto follower_stream = memory_stream_t::CreateStream();
+    auto publisher = follower_stream->BecomeFollowingStream();
+    EXPECT_EQ(1000u, remote_stream.BulkCatchUp(*publisher, 0u));
+    expect_replicated(follower_stream, 1000u);
+  }
+  {
+    // The batch that does not continue the stream is rejected as a whole.
+    auto follower_stream = memory_stream_t::CreateStream();
+    auto publisher = follower_stream->BecomeFollowingStream();
+    EXPECT_THROW(publisher->PublishRawEntries("{\"index\":0,\"us\":10}\t{\"x\":0}\n"
+                                              "{\"index\":2,\"us\":20}\t{\"x\":2}\n"),
+                 current::persistence::UnsafePublishBadIndexTimestampException);
+  }
+  {
+    // From a master that can not serve its entries in bulk, nothing is copied.
+    auto follower_stream = memory_stream_t::CreateStream();
+    auto publisher = follower_stream->BecomeFollowingStream();
+    EXPECT_EQ(0u,
+              current::stream::SubscribableRemoteStream<Record>(Printf("http://localhost:%d/memory_master", port))
+                  .BulkCatchUp(*publisher, 0u));
+    EXPECT_EQ(0u, follower_stream->Data()->Size());
+  }
+  {
+    // The follower switches to the live subscription right where the bulk transfer has ended.
+    current::stream::MasterFlipController<file_stream_t> follower(file_stream_t::CreateStream(flip_follower_file_name));
+    follower.FollowRemoteStream(master_url,
+                                current::stream::SubscriptionMode::Checked,
+                                current::stream::ReplicationParallelism(),
+                                current::stream::ReplicationBootstrap::BulkTransfer);
+    for (int x = 1000; x < 1100; ++x) {
+      master_stream->Publisher()->Publish(Record(x), std::chrono::microseconds(x * 10 + 10));
+    }
+    while (follower->Data()->Size() < 1100u) {
+      std::this_thread::yield();
+    }
+    expect_replicated(follower.BorrowStream(), 1100u);
+  }
+}
+
+namespace stream_unittest {
+
+struct MergedEntriesCollector {
+  using entry_t = Variant<Record, AnotherRecord>;
+
+  std::vector<std::string> entries;
+  std::atomic_size_t count{0u};
+  size_t max_to_collect = static_cast<size_t>(-1);
+
+  EntryResponse operator()(size_t source, const entry_t& entry, idxts_t idxts) {
+    entries.push_back(Printf("%d:%d:", static_cast<int>(source), static_cast<int>(idxts.us.count())) +
+                      (Exists<Record>(entry) ? Printf("x=%d", Value<Record>(entry).x)
+                                             : Printf("y=%d", Value<AnotherRecord>(entry).y)));
+    ++count;
+    return count < max_to_collect ? EntryResponse::More : EntryResponse::Done;
+  }
+};
+
+}  // namespace stream_unittest
+
+TEST(Stream, MergedSubscription) {
+  current::time::ResetToZero();
+
+  using namespace stream_unittest;
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  static_cast<void>(http_server);
+
+  // Two local streams, and a remote one, with some of the timestamps equal across the streams.
+  auto records = current::stream::Stream<Record>::CreateStream();
+  auto more_records = current::stream::Stream<Record>::CreateStream();
+  auto another_records = current::stream::Stream<AnotherRecord>::CreateStream();
+  const auto scope = HTTP(port).Register(
+      "/another", URLPathArgs::CountMask::None | URLPathArgs::CountMask::One, *another_records);
+  current::stream::SubscribableRemoteStream<AnotherRecord> remote_another_records(
+      Printf("http://localhost:%d/another", port));
+
+  std::vector<std::pair<std::pair<int, int>, std::string>> expected;
+  for (int i = 0; i < 100; ++i) {
+    records->Publisher()->Publish(Record(i), std::chrono::microseconds(i * 10 + 10));
+    expected.push_back({{i * 10 + 10, 0}, Printf("0:%d:x=%d", i * 10 + 10, i)});
+  }
+  for (int i = 0; i < 50; ++i) {
+    more_records->Publisher()->Publish(Record(i + 1000), std::chrono::microseconds(i * 20 + 10));
+    expected.push_back({{i * 20 + 10, 1}, Printf("1:%d:x=%d", i * 20 + 10, i + 1000)});
+  }
+  for (int i = 0; i < 30; ++i) {
+    another_records->Publisher()->Publish(AnotherRecord(i), std::chrono::microseconds(i * 33 + 5));
+    expected.push_back({{i * 33 + 5, 2}, Printf("2:%d:y=%d", i * 33 + 5, i)});
+  }
+  std::sort(expected.begin(), expected.end());
+  std::vector<std::string> expected_entries;
+  for (const auto& e : expected) {
+    expected_entries.push_back(e.second);
+  }
+
+  {
+    // The small buffers make the streams wait for the merged subscription to catch up.
+    MergedEntriesCollector collector;
+    current::stream::MergedSubscriptionParams params;
+    params.max_buffered_entries_per_source = 4u;
+    current::stream::MergedSubscription<MergedEntriesCollector::entry_t, MergedEntriesCollector> merged(
+        collector, params, *records, *more_records, remote_another_records);
+    EXPECT_EQ(3u, merged.SourcesCount());
+
+    // The last entries are only passed on once the other streams are known to have nothing to insert before them.
+    while (collector.count < 120u) {
+      std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_GT(180u, collector.count);
+    records->Publisher()->UpdateHead(std::chrono::microseconds(10000));
+    more_records->Publisher()->UpdateHead(std::chrono::microseconds(10000));
+    another_records->Publisher()->UpdateHead(std::chrono::microseconds(10000));
+    while (collector.count < 180u) {
+      std::this_thread::yield();
+    }
+    EXPECT_TRUE(merged);
+    EXPECT_EQ(Join(expected_entries, ','), Join(collector.entries, ','));
+  }
+
+  {
+    // Returning `Done` ends the merged subscription.
+    MergedEntriesCollector collector;
+    collector.max_to_collect = 10u;
+    current::stream::MergedSubscription<MergedEntriesCollector::entry_t, MergedEntriesCollector> merged(
+        collector, *records, remote_another_records);
+    while (merged) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ(10u, collector.count);
+    EXPECT_EQ("1:5:y=0,0:10:x=0,0:20:x=1", Join(std::vector<std::string>(collector.entries.begin(),
+                                                                          collector.entries.begin() + 3),
+                                                 ','));
+  }
+}
+
+TEST(Stream, PartitionedStream) {
+  current::time::ResetToZero();
+
+  using namespace stream_unittest;
+
+  auto reserved_port = current::net::ReserveLocalPort();
+  const int port = reserved_port;
+  auto& http_server = HTTP(std::move(reserved_port));
+  static_cast<void>(http_server);
+
+  current::stream::PartitionedStream<Record> partitioned(4u);
+  EXPECT_EQ(4u, partitioned.PartitionsCount());
+
+  // The partitions of the keys are stable.
+  EXPECT_EQ(current::CRC32("foo") % 4u, partitioned.PartitionOf(std::string("foo")));
+  EXPECT_EQ(1u, partitioned.PartitionOf(5));
+  EXPECT_EQ(3u, partitioned.PartitionOf(static_cast<uint64_t>(7u)));
+
+  std::vector<std::string> expected_merged;
+  std::vector<std::vector<std::string>> expected_per_partition(4u);
+  for (int x = 0; x < 100; ++x) {
+    const std::string key = "key" + current::ToString(x % 10);
+    const auto idxts = partitioned.Publish(key, Record(x), std::chrono::microseconds(x * 10 + 10));
+    const size_t partition = partitioned.PartitionOf(key);
+    EXPECT_EQ(expected_per_partition[partition].size(), idxts.index);
+    EXPECT_EQ(x * 10 + 10, idxts.us.count());
+    expected_per_partition[partition].push_back(JSON(Record(x)));
+    expected_merged.push_back(JSON(Record(x)));
+  }
+  size_t total = 0u;
+  for (size_t i = 0u; i < 4u; ++i) {
+    EXPECT_EQ(expected_per_partition[i].size(), partitioned.Partition(i).Data()->Size());
+    total += partitioned.Partition(i).Data()->Size();
+  }
+  EXPECT_EQ(100u, total);
+
+  struct Collector {
+    std::vector<std::string> entries;
+    std::atomic_size_t count{0u};
+    EntryResponse operator()(size_t, const Record& entry, idxts_t) {
+      entries.push_back(JSON(entry));
+      ++count;
+      return EntryResponse::More;
+    }
+  };
+
+  // The merged view of all the partitions is ordered by timestamp, once all the partitions have reached its end.
+  partitioned.UpdateHead(std::chrono::microseconds(2000));
+  {
+    Collector collector;
+    current::stream::MergedSubscription<Record, Collector> merged(collector, partitioned.Partitions());
+    while (collector.count < 100u) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ(Join(expected_merged, ','), Join(collector.entries, ','));
+  }
+
+  // The merged view of some of the partitions.
+  {
+    Collector collector;
+    current::stream::MergedSubscription<Record, Collector> merged(collector, partitioned.Partitions({1u, 2u}));
+    const size_t expected_count = expected_per_partition[1].size() + expected_per_partition[2].size();
+    while (collector.count < expected_count) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ(expected_count, collector.entries.size());
+  }
+
+  // Each partition is served via HTTP.
+  const auto scope =
+      HTTP(port).Register("/partitioned", URLPathArgs::CountMask::None | URLPathArgs::CountMask::One, partitioned);
+  for (size_t i = 0u; i < 4u; ++i) {
+    const auto result =
+        HTTP(GET(Printf("http://localhost:%d/partitioned?partition=%d&n=1000&nowait", port, static_cast<int>(i))));
+    EXPECT_EQ(200, static_cast<int>(result.code));
+    std::vector<std::string> entries;
+    for (const auto& line : current::strings::Split<current::strings::ByLines>(result.body)) {
+      entries.push_back(line.substr(line.find('\t') + 1u));
+    }
+    EXPECT_EQ(Join(expected_per_partition[i], ','), Join(entries, ',')) << i;
+  }
+  {
+    const auto result = HTTP(GET(Printf("http://localhost:%d/partitioned?sizeonly", port)));
+    EXPECT_EQ(400, static_cast<int>(result.code));
+    EXPECT_EQ("The `?partition` parameter is required, legal values are from `0` to `3`.\n", result.body);
+  }
+  EXPECT_EQ(400, static_cast<int>(HTTP(GET(Printf("http://localhost:%d/partitioned?partition=4", port))).code));
+  EXPECT_EQ(200, static_cast<int>(HTTP(GET(Printf("http://localhost:%d/partitioned/schema.simple", port))).code));
+}
+
+namespace stream_unittest {
+
+template <typename STREAM>
+void RunPublishSequencerTest(STREAM& stream) {
+  constexpr static int kThreads = 8;
+  constexpr static int kEntriesPerThread = 250;
+
+  current::stream::PublishSequencer<STREAM> sequencer(stream);
+  std::vector<std::vector<idxts_t>> published(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&sequencer, &published, t]() {
+      for (int i = 0; i < kEntriesPerThread; ++i) {
+        published[t].push_back(sequencer.Publish(Record(t * kEntriesPerThread + i)));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(static_cast<uint64_t>(kThreads * kEntriesPerThread), stream.Data()->Size());
+  std::vector<int> x_by_index(kThreads * kEntriesPerThread, -1);
+  std::chrono::microseconds last_us(-1);
+  for (const auto& e : stream.Data()->Iterate()) {
+    EXPECT_GT(e.idx_ts.us, last_us);
+    last_us = e.idx_ts.us;
+    x_by_index[e.idx_ts.index] = e.entry.x;
+  }
+  for (int t = 0; t < kThreads; ++t) {
+    ASSERT_EQ(static_cast<size_t>(kEntriesPerThread), published[t].size());
+    for (int i = 0; i < kEntriesPerThread; ++i) {
+      // Each entry is where its producer was told it is, and the entries of each producer keep their order.
+      EXPECT_EQ(t * kEntriesPerThread + i, x_by_index[published[t][i].index]);
+      if (i) {
+        EXPECT_LT(published[t][i - 1].index, published[t][i].index);
+      }
+    }
+  }
+}
+
+}  // namespace stream_unittest
+
+TEST(Stream, PublishSequencer) {
+  current::time::ResetToZero();
+
+  using namespace stream_unittest;
+
+  {
+    const std::string persistence_file_name = current::FileSystem::JoinPath(FLAGS_stream_test_tmpdir, "sequenced");
+    const auto persistence_file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+    using stream_t = current::stream::Stream<Record, current::persistence::File>;
+    static_assert(current::stream::PublishSequencer<stream_t>::kStagesSerializedEntries, "");
+    auto stream = stream_t::CreateStream(persistence_file_name);
+    RunPublishSequencerTest(*stream);
+  }
+  {
+    using stream_t = current::stream::Stream<Record, current::persistence::Memory>;
+    static_assert(!current::stream::PublishSequencer<stream_t>::kStagesSerializedEntries, "");
+    auto stream = stream_t::CreateStream();
+    RunPublishSequencerTest(*stream);
+  }
+}
+
 TEST(Stream, MasterFollowerFlip) {
   current::time::ResetToZero();
 
@@ -1828,6 +2674,155 @@ TEST(Stream, MasterFollowerFlipExceptions) {
   EXPECT_TRUE(stream3.IsMasterStream());
 }
 
+namespace stream_unittest {
+
+struct BatchCollectorImpl {
+  std::vector<std::string>& batches_;
+  std::vector<int>& values_;
+  std::atomic_size_t count_;
+  size_t stop_after_;
+
+  BatchCollectorImpl(std::vector<std::string>& batches, std::vector<int>& values, size_t stop_after = 0u)
+      : batches_(batches), values_(values), count_(0u), stop_after_(stop_after) {}
+
+  EntryResponse operator()(const Record& entry, idxts_t, idxts_t) {
+    values_.push_back(entry.x);
+    ++count_;
+    return EntryResponse::More;
+  }
+
+  EntryResponse operator()(const current::ss::EntriesBatch<Record>& batch, idxts_t last) {
+    batches_.push_back(Printf("%d..%d/%d",
+                              static_cast<int>(batch.IdxTs(0u).index),
+                              static_cast<int>(batch.IdxTs(batch.Size() - 1u).index),
+                              static_cast<int>(last.index)));
+    for (const auto& e : batch) {
+      CURRENT_ASSERT(e.idx_ts.index == static_cast<uint64_t>(e.entry.x));
+      values_.push_back(e.entry.x);
+    }
+    count_ += batch.Size();
+    return (stop_after_ && count_ >= stop_after_) ? EntryResponse::Done : EntryResponse::More;
+  }
+
+  EntryResponse operator()(std::chrono::microseconds) const { return EntryResponse::More; }
+
+  static EntryResponse EntryResponseIfNoMorePassTypeFilter() { return EntryResponse::More; }
+
+  // The collector that stops by itself asks to `Wait`, to be usable without a scope, as a blocking call.
+  TerminationResponse Terminate() { return stop_after_ ? TerminationResponse::Wait : TerminationResponse::Terminate; }
+};
+
+using BatchCollector = current::ss::StreamSubscriber<BatchCollectorImpl, Record>;
+
+static_assert(current::ss::IsBatchEntrySubscriber<BatchCollector, Record>::value, "");
+static_assert(!current::ss::IsBatchEntrySubscriber<RecordsCollector, Record>::value, "");
+
+template <typename STREAM>
+void RunSubscribeInBatchesTest(STREAM& stream) {
+  for (int x = 0; x < 2500; ++x) {
+    stream.Publisher()->Publish(Record(x), std::chrono::microseconds(x + 1));
+  }
+
+  {
+    std::vector<std::string> batches;
+    std::vector<int> values;
+    BatchCollector collector(batches, values);
+    {
+      const auto scope = stream.Subscribe(collector);
+      while (collector.count_ < 2500u) {
+        std::this_thread::yield();
+      }
+    }
+    EXPECT_EQ("0..999/2499,1000..1999/2499,2000..2499/2499", Join(batches, ','));
+    ASSERT_EQ(2500u, values.size());
+    for (int x = 0; x < 2500; ++x) {
+      ASSERT_EQ(x, values[x]);
+    }
+  }
+
+  {
+    // Returning `Done` in response to a batch stops the subscription after that batch.
+    std::vector<std::string> batches;
+    std::vector<int> values;
+    BatchCollector collector(batches, values, 1u);
+    stream.Subscribe(collector, 1200u);  // With no return value collection to capture the scope, it's a blocking call.
+    EXPECT_EQ("1200..2199/2499", Join(batches, ','));
+    EXPECT_EQ(1000u, values.size());
+  }
+}
+
+}  // namespace stream_unittest
+
+TEST(Stream, SubscribeInBatches) {
+  current::time::ResetToZero();
+
+  using namespace stream_unittest;
+
+  {
+    auto stream = current::stream::Stream<Record>::CreateStream();
+    RunSubscribeInBatchesTest(*stream);
+  }
+
+  {
+    const std::string persistence_file_name = current::FileSystem::JoinPath(FLAGS_stream_test_tmpdir, "data_batches");
+    const auto persistence_file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+    auto stream = current::stream::Stream<Record, current::persistence::File>::CreateStream(persistence_file_name);
+    RunSubscribeInBatchesTest(*stream);
+  }
+}
+
+namespace stream_unittest {
+
+// Schema-compatible with `RecordWithTimestamp`: the same name and type of the field it has.
+CURRENT_STRUCT(RecordNameOnly) { CURRENT_FIELD(s, std::string); };
+
+using RecordsNameOnlyCollector = current::ss::StreamSubscriber<RecordsCollectorImpl<RecordNameOnly>, RecordNameOnly>;
+
+template <typename STREAM>
+void RunSubscribeProjectedTest(STREAM& stream) {
+  for (int x = 0; x < 10; ++x) {
+    stream.Publisher()->Publish(RecordWithTimestamp(Printf("s%d", x), std::chrono::microseconds(-1)),
+                                std::chrono::microseconds(x * 10 + 10));
+  }
+
+  std::vector<std::string> rows;
+  std::vector<std::string> entries;
+  RecordsNameOnlyCollector collector(rows, entries);
+  {
+    const auto scope = stream.template SubscribeProjected<RecordNameOnly>(collector, 7u);
+    while (collector.count_ < 3u) {
+      std::this_thread::yield();
+    }
+  }
+  EXPECT_EQ(
+      "{\"index\":7,\"us\":80}\t{\"s\":\"s7\"}\n"
+      "{\"index\":8,\"us\":90}\t{\"s\":\"s8\"}\n"
+      "{\"index\":9,\"us\":100}\t{\"s\":\"s9\"}\n",
+      Join(rows, ""));
+}
+
+}  // namespace stream_unittest
+
+TEST(Stream, SubscribeProjected) {
+  current::time::ResetToZero();
+
+  using namespace stream_unittest;
+
+  {
+    auto stream = current::stream::Stream<RecordWithTimestamp>::CreateStream();
+    RunSubscribeProjectedTest(*stream);
+  }
+
+  {
+    const std::string persistence_file_name =
+        current::FileSystem::JoinPath(FLAGS_stream_test_tmpdir, "data_projected");
+    const auto persistence_file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+    auto stream =
+        current::stream::Stream<RecordWithTimestamp, current::persistence::File>::CreateStream(persistence_file_name);
+    RunSubscribeProjectedTest(*stream);
+  }
+}
+
 TEST(Stream, SubscribeWithFilterByType) {
   current::time::ResetToZero();
 
@@ -2126,3 +3121,99 @@ TEST(Stream, SubscribingToJustTailDoesTheJob) {
   EXPECT_EQ(40, result[1].x);
   EXPECT_EQ(50, result[2].x);
 }
+
+namespace stream_unittest {
+
+// The read model of the sum and the count of the records, with the count of applications to tell replays apart.
+CURRENT_STRUCT(RecordsSumReadModel) {
+  CURRENT_FIELD(sum, int64_t, 0);
+  CURRENT_FIELD(count, uint64_t, 0u);
+  void Apply(const Record& record, idxts_t) {
+    sum += record.x;
+    ++count;
+  }
+};
+
+}  // namespace stream_unittest
+
+TEST(Stream, ReadModel) {
+  current::time::ResetToZero();
+
+  using namespace stream_unittest;
+  using stream_t = current::stream::Stream<Record, current::persistence::File>;
+  using read_model_t = current::stream::ReadModel<RecordsSumReadModel, stream_t>;
+
+  const std::string persistence_file_name = current::FileSystem::JoinPath(FLAGS_stream_test_tmpdir, "data_read_model");
+  const auto persistence_file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+  const std::string checkpoint_file_name =
+      current::FileSystem::JoinPath(FLAGS_stream_test_tmpdir, "data_read_model_checkpoint");
+  const auto checkpoint_file_remover = current::FileSystem::ScopedRmFile(checkpoint_file_name);
+
+  current::stream::ReadModelCheckpointing checkpointing;
+  checkpointing.file_name = checkpoint_file_name;
+  checkpointing.every_entries = 1000u;
+  checkpointing.every_us = std::chrono::hours(1);
+
+  const auto wait_for_count = [](const read_model_t& read_model, uint64_t count) {
+    while (read_model.Snapshot()->model.count < count) {
+      std::this_thread::yield();
+    }
+  };
+
+  {
+    auto stream = stream_t::CreateStream(persistence_file_name);
+    for (int x = 1; x <= 2500; ++x) {
+      stream->Publisher()->Publish(Record(x), std::chrono::microseconds(x));
+    }
+    read_model_t read_model(*stream, checkpointing);
+    EXPECT_EQ(0u, read_model.ResumedFromIndex());
+
+    // The snapshots are immutable, and consistent: the model as of right after some entry of the stream.
+    std::shared_ptr<const current::stream::ReadModelCheckpoint<RecordsSumReadModel>> snapshot;
+    do {
+      snapshot = read_model.Snapshot();
+      EXPECT_EQ(snapshot->next_index, snapshot->model.count);
+      EXPECT_EQ(static_cast<int64_t>(snapshot->next_index * (snapshot->next_index + 1) / 2), snapshot->model.sum);
+      EXPECT_EQ(static_cast<int64_t>(snapshot->next_index), snapshot->last_us.count());
+    } while (snapshot->next_index < 2500u);
+    EXPECT_TRUE(read_model.Ready());
+
+    // The live entries, published one by one, make it into the read model too.
+    for (int x = 2501; x <= 2600; ++x) {
+      stream->Publisher()->Publish(Record(x), std::chrono::microseconds(x));
+      wait_for_count(read_model, static_cast<uint64_t>(x));
+      EXPECT_EQ(x * (x + 1) / 2, read_model.Snapshot()->model.sum);
+    }
+    // The snapshot kept by the reader all this time is not affected.
+    EXPECT_EQ(2500 * 2501 / 2, snapshot->model.sum);
+  }
+
+  // The checkpoint is saved as the read model is destroyed.
+  EXPECT_EQ(2600u, ParseJSON<current::stream::ReadModelCheckpoint<RecordsSumReadModel>>(
+                       current::FileSystem::ReadFileAsString(checkpoint_file_name))
+                       .next_index);
+
+  {
+    // Restarted, the read model resumes from the checkpoint, and does not replay the entries before it.
+    auto stream = stream_t::CreateStream(persistence_file_name);
+    stream->Publisher()->Publish(Record(2601), std::chrono::microseconds(2601));
+    read_model_t read_model(*stream, checkpointing);
+    EXPECT_EQ(2600u, read_model.ResumedFromIndex());
+    wait_for_count(read_model, 2601u);
+    EXPECT_TRUE(read_model.Ready());
+    EXPECT_EQ(2601 * 2602 / 2, read_model.Snapshot()->model.sum);
+  }
+
+  {
+    // The checkpoint of a different stream, the one that does not have the very entry it was taken at, is ignored.
+    current::FileSystem::RmFile(persistence_file_name);
+    auto stream = stream_t::CreateStream(persistence_file_name);
+    for (int x = 1; x <= 3000; ++x) {
+      stream->Publisher()->Publish(Record(x), std::chrono::microseconds(x * 2));
+    }
+    read_model_t read_model(*stream, checkpointing);
+    EXPECT_EQ(0u, read_model.ResumedFromIndex());
+    wait_for_count(read_model, 3000u);
+    EXPECT_EQ(3000 * 3001 / 2, read_model.Snapshot()->model.sum);
+  }
+}
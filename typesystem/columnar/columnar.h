@@ -0,0 +1,503 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Maxim Zhurovich <zhurovich@gmail.com>
+          (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// Columnar files of `CURRENT_STRUCT`-s, for the analytics that read a few fields of many records.
+//
+// `ColumnarWriter<T>` flattens each record of type `T` into the row of a `CompactTSVColumnar` container, by reflection:
+//   * The fields of the nested structs, the base ones included, become the columns named "outer.inner".
+//   * An `Optional<U>` field "x" is the "x#exists" column, of ones and zeroes, which, encoded with a one-bit-wide
+//     dictionary, is the null bitmap, and the columns of `U` under "x", empty where the value is missing.
+//   * A `Variant<A, B>` field "x" is the "x#case" column, with the type name of its case or an empty string,
+//     and the columns of each case, "x.A" and "x.B", empty where the case is another one.
+//   * Numbers, `bool`-s, enums, durations and strings are stored as text, so that integers are delta-encoded.
+//     The containers and the other types are stored as their JSON.
+//
+// `ColumnarReader<T>` and `ColumnarFileReader<T>` check that the names of the columns are the ones of `T`, and unpack
+// either the strings of the requested columns, or the objects of type `T` with only the requested fields populated,
+// without decoding the other columns at all.
+
+#ifndef CURRENT_TYPE_SYSTEM_COLUMNAR_COLUMNAR_H
+#define CURRENT_TYPE_SYSTEM_COLUMNAR_COLUMNAR_H
+
+#include <algorithm>
+#include <charconv>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "../optional.h"
+#include "../struct.h"
+#include "../variant.h"
+#include "../reflection/reflection.h"
+#include "../serialization/json.h"
+
+#include "../../bricks/exception.h"
+#include "../../bricks/strings/join.h"
+#include "../../compact_tsv/columnar.h"
+
+namespace current {
+namespace columnar {
+
+struct ColumnarException : Exception {
+  using Exception::Exception;
+};
+
+struct ColumnarSchemaMismatchException : ColumnarException {
+  using ColumnarException::ColumnarException;
+};
+
+struct ColumnarUnknownColumnException : ColumnarException {
+  using ColumnarException::ColumnarException;
+};
+
+struct ColumnarInvalidValueException : ColumnarException {
+  using ColumnarException::ColumnarException;
+};
+
+namespace impl {
+
+template <typename X, typename U>
+using same_const_t = std::conditional_t<std::is_const_v<X>, const U, U>;
+
+template <typename U>
+struct IsOptional final : std::false_type {};
+
+template <typename U>
+struct IsOptional<Optional<U>> final : std::true_type {};
+
+// The values of the columns, for the types other than structs, `Optional`-s, and `Variant`-s.
+template <typename U, typename = void>
+struct Cell {
+  static void Format(const U& value, std::string& output) { output = JSON(value); }
+  static void Parse(std::string_view input, U& value) { ParseJSON(std::string(input), value); }
+};
+
+template <>
+struct Cell<std::string> {
+  static void Format(const std::string& value, std::string& output) { output = value; }
+  static void Parse(std::string_view input, std::string& value) { value.assign(input.data(), input.length()); }
+};
+
+template <>
+struct Cell<bool> {
+  static void Format(bool value, std::string& output) { output = value ? "1" : "0"; }
+  static void Parse(std::string_view input, bool& value) { value = (input == "1"); }
+};
+
+template <typename U>
+struct Cell<U, std::enable_if_t<std::is_arithmetic_v<U> && !std::is_same_v<U, bool>>> {
+  static void Format(U value, std::string& output) {
+    char buffer[32];
+    output.assign(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+  }
+  static void Parse(std::string_view input, U& value) {
+    const auto result = std::from_chars(input.data(), input.data() + input.length(), value);
+    if (result.ec != std::errc() || result.ptr != input.data() + input.length()) {
+      CURRENT_THROW(ColumnarInvalidValueException("Invalid number `" + std::string(input) + "`."));
+    }
+  }
+};
+
+template <typename U>
+struct Cell<U, std::enable_if_t<std::is_enum_v<U>>> {
+  static void Format(U value, std::string& output) {
+    Cell<std::underlying_type_t<U>>::Format(static_cast<std::underlying_type_t<U>>(value), output);
+  }
+  static void Parse(std::string_view input, U& value) {
+    std::underlying_type_t<U> underlying;
+    Cell<std::underlying_type_t<U>>::Parse(input, underlying);
+    value = static_cast<U>(underlying);
+  }
+};
+
+template <typename R, typename P>
+struct Cell<std::chrono::duration<R, P>> {
+  static void Format(std::chrono::duration<R, P> value, std::string& output) { Cell<R>::Format(value.count(), output); }
+  static void Parse(std::string_view input, std::chrono::duration<R, P>& value) {
+    R count;
+    Cell<R>::Parse(input, count);
+    value = std::chrono::duration<R, P>(count);
+  }
+};
+
+// The accessors lead from the record to the value the column is about, or to `nullptr` if the record has no such
+// value, as the `Optional` or the `Variant` on the path to it is empty or holds another case.
+struct RootAccessor final {
+  template <typename X>
+  static X* Get(X& record) {
+    return &record;
+  }
+};
+
+template <class PARENT, typename S, typename U, int N>
+struct FieldAccessor final {
+  template <typename X>
+  static same_const_t<X, U>* Get(X& record) {
+    auto* parent = PARENT::Get(record);
+    same_const_t<X, U>* result = nullptr;
+    if (parent) {
+      using field_t = std::conditional_t<std::is_const_v<X>,
+                                         reflection::FieldNameAndImmutableValue,
+                                         reflection::FieldNameAndMutableValue>;
+      static_cast<same_const_t<X, S>&>(*parent).CURRENT_REFLECTION(
+          [&result](const char*, same_const_t<X, U>& value) { result = &value; }, reflection::Index<field_t, N>());
+    }
+    return result;
+  }
+};
+
+template <class PARENT, typename U>
+struct OptionalAccessor final {
+  template <typename X>
+  static same_const_t<X, U>* Get(X& record) {
+    // The `const` `Value()` of the `Optional` of a POD type returns a copy, so the value is accessed via
+    // the non-`const` one, to be only read from if `X` is `const`.
+    auto* parent = const_cast<Optional<U>*>(PARENT::Get(record));
+    return (parent && Exists(*parent)) ? &Value(*parent) : nullptr;
+  }
+};
+
+template <class PARENT, typename U>
+struct VariantCaseAccessor final {
+  template <typename X>
+  static same_const_t<X, U>* Get(X& record) {
+    auto* parent = PARENT::Get(record);
+    return (parent && Exists<U>(*parent)) ? &Value<U>(*parent) : nullptr;
+  }
+};
+
+template <typename V, typename TYPELIST = typename V::typelist_t>
+struct VariantCases;
+
+template <typename V, typename... XS>
+struct VariantCases<V, TypeListImpl<XS...>> final {
+  static void Construct(V& value, std::string_view name) {
+    if (!((name == reflection::CurrentTypeName<XS>() ? (ConstructCase<XS>(value), true) : false) || ...)) {
+      CURRENT_THROW(ColumnarInvalidValueException("Unknown `Variant` case `" + std::string(name) + "`."));
+    }
+  }
+
+ private:
+  template <typename X>
+  static void ConstructCase(V& value) {
+    if (!Exists<X>(value)) {
+      value.template Construct<X>();
+    }
+  }
+};
+
+}  // namespace impl
+
+constexpr static size_t kNoGate = static_cast<size_t>(-1);
+
+template <typename T>
+struct Column final {
+  std::string name;
+  void (*format)(const T&, std::string&);
+  void (*parse)(T&, std::string_view);
+  // The index of the "#exists" or the "#case" column of the innermost `Optional` or `Variant` this column is within.
+  size_t gate;
+};
+
+// The columns of `T`, built once per type, in the order in which the "#exists" and "#case" columns precede
+// the columns within them, so that parsing the row in order constructs the values before populating them.
+template <typename T>
+class Schema final {
+ public:
+  static const Schema& Instance() {
+    static const Schema instance;
+    return instance;
+  }
+
+  const std::vector<Column<T>>& Columns() const { return columns_; }
+  const std::vector<std::string>& Names() const { return names_; }
+
+  size_t Find(const std::string& name) const {
+    const auto it = std::find(names_.begin(), names_.end(), name);
+    if (it == names_.end()) {
+      CURRENT_THROW(ColumnarUnknownColumnException("Unknown column `" + name + "`."));
+    }
+    return static_cast<size_t>(it - names_.begin());
+  }
+
+  // The indexes of the `columns`, and of the "#exists" and "#case" columns they are within, in ascending order.
+  std::vector<size_t> WithGates(const std::vector<std::string>& columns) const {
+    std::vector<bool> selected(columns_.size());
+    for (const std::string& name : columns) {
+      for (size_t i = Find(name); i != kNoGate && !selected[i]; i = columns_[i].gate) {
+        selected[i] = true;
+      }
+    }
+    std::vector<size_t> result;
+    for (size_t i = 0u; i < selected.size(); ++i) {
+      if (selected[i]) {
+        result.push_back(i);
+      }
+    }
+    return result;
+  }
+
+ private:
+  Schema() {
+    Add<T, impl::RootAccessor>("", kNoGate);
+    for (const Column<T>& column : columns_) {
+      names_.push_back(column.name);
+    }
+  }
+
+  static std::string Join(const std::string& prefix, const std::string& name) {
+    return prefix.empty() ? name : prefix + '.' + name;
+  }
+
+  template <typename U, class ACCESSOR>
+  void Add(const std::string& name, size_t gate) {
+    if constexpr (IS_CURRENT_STRUCT(U)) {
+      AddFields<U, ACCESSOR>(name, gate);
+    } else if constexpr (IS_CURRENT_VARIANT(U)) {
+      columns_.push_back(Column<T>{name + "#case", &FormatCase<U, ACCESSOR>, &ParseCase<U, ACCESSOR>, gate});
+      AddCases<U, ACCESSOR>(name, columns_.size() - 1u, static_cast<typename U::typelist_t*>(nullptr));
+    } else if constexpr (impl::IsOptional<U>::value) {
+      columns_.push_back(Column<T>{name + "#exists", &FormatExists<U, ACCESSOR>, &ParseExists<U, ACCESSOR>, gate});
+      using value_t = typename U::optional_underlying_t;
+      Add<value_t, impl::OptionalAccessor<ACCESSOR, value_t>>(name, columns_.size() - 1u);
+    } else {
+      columns_.push_back(
+          Column<T>{name.empty() ? "value" : name, &FormatCell<U, ACCESSOR>, &ParseCell<U, ACCESSOR>, gate});
+    }
+  }
+
+  template <typename S, class ACCESSOR>
+  void AddFields(const std::string& prefix, size_t gate) {
+    if constexpr (!std::is_same_v<S, CurrentStruct>) {
+      AddFields<reflection::SuperType<S>, ACCESSOR>(prefix, gate);
+      reflection::VisitAllFields<S, reflection::FieldTypeAndNameAndIndex>::WithoutObject(
+          FieldsAdder<S, ACCESSOR>{*this, prefix, gate});
+    }
+  }
+
+  template <typename S, class ACCESSOR>
+  struct FieldsAdder final {
+    Schema& self;
+    const std::string& prefix;
+    size_t gate;
+    template <typename U, int N>
+    void operator()(reflection::TypeSelector<U>, const char* name, reflection::SimpleIndex<N>) const {
+      self.template Add<U, impl::FieldAccessor<ACCESSOR, S, U, N>>(Join(prefix, name), gate);
+    }
+  };
+
+  template <typename V, class ACCESSOR, typename... XS>
+  void AddCases(const std::string& name, size_t gate, TypeListImpl<XS...>*) {
+    (Add<XS, impl::VariantCaseAccessor<ACCESSOR, XS>>(Join(name, reflection::CurrentTypeName<XS>()), gate), ...);
+  }
+
+  template <typename U, class ACCESSOR>
+  static void FormatCell(const T& record, std::string& output) {
+    const U* value = ACCESSOR::Get(record);
+    if (value) {
+      impl::Cell<U>::Format(*value, output);
+    } else {
+      output.clear();
+    }
+  }
+
+  template <typename U, class ACCESSOR>
+  static void ParseCell(T& record, std::string_view input) {
+    U* value = ACCESSOR::Get(record);
+    if (value) {
+      impl::Cell<U>::Parse(input, *value);
+    }
+  }
+
+  template <typename U, class ACCESSOR>
+  static void FormatExists(const T& record, std::string& output) {
+    const U* value = ACCESSOR::Get(record);
+    output = value ? (Exists(*value) ? "1" : "0") : "";
+  }
+
+  template <typename U, class ACCESSOR>
+  static void ParseExists(T& record, std::string_view input) {
+    U* value = ACCESSOR::Get(record);
+    if (value) {
+      if (input != "1") {
+        *value = nullptr;
+      } else if (!Exists(*value)) {
+        *value = typename U::optional_underlying_t();
+      }
+    }
+  }
+
+  template <typename U, class ACCESSOR>
+  static void FormatCase(const T& record, std::string& output) {
+    const U* value = ACCESSOR::Get(record);
+    output.clear();
+    if (value && Exists(*value)) {
+      value->Call([&output](const auto& x) { output = reflection::CurrentTypeName<current::decay_t<decltype(x)>>(); });
+    }
+  }
+
+  template <typename U, class ACCESSOR>
+  static void ParseCase(T& record, std::string_view input) {
+    U* value = ACCESSOR::Get(record);
+    if (value) {
+      if (input.empty()) {
+        *value = nullptr;
+      } else {
+        impl::VariantCases<U>::Construct(*value, input);
+      }
+    }
+  }
+
+  std::vector<Column<T>> columns_;
+  std::vector<std::string> names_;
+};
+
+template <typename T>
+class ColumnarWriter final {
+ public:
+  explicit ColumnarWriter(CompactTSVColumnarWriter::sink_t sink,
+                          size_t rows_per_block = CompactTSVColumnarWriter::kDefaultRowsPerBlock)
+      : writer_(std::move(sink), rows_per_block), row_(schema_.Columns().size()) {
+    writer_.SetColumnNames(schema_.Names());
+  }
+
+  explicit ColumnarWriter(std::ostream& os, size_t rows_per_block = CompactTSVColumnarWriter::kDefaultRowsPerBlock)
+      : writer_(os, rows_per_block), row_(schema_.Columns().size()) {
+    writer_.SetColumnNames(schema_.Names());
+  }
+
+  void operator()(const T& record) {
+    const auto& columns = schema_.Columns();
+    for (size_t i = 0u; i < columns.size(); ++i) {
+      columns[i].format(record, row_[i]);
+    }
+    writer_(row_);
+  }
+
+  template <typename RANGE>
+  void WriteRange(const RANGE& range) {
+    for (const T& record : range) {
+      (*this)(record);
+    }
+  }
+
+  void Finalize() { writer_.Finalize(); }
+
+ private:
+  const Schema<T>& schema_ = Schema<T>::Instance();
+  CompactTSVColumnarWriter writer_;
+  std::vector<std::string> row_;
+};
+
+template <typename T>
+class ColumnarReader {
+ public:
+  // The `packed` string must outlive the reader.
+  explicit ColumnarReader(const std::string& packed) : ColumnarReader(std::make_unique<CompactTSVColumnar>(packed)) {}
+
+  size_t Rows() const { return columnar_->Rows(); }
+  const std::vector<std::string>& Columns() const { return schema_.Names(); }
+  const CompactTSVColumnar& Container() const { return *columnar_; }
+
+  // Calls `f` with the `std::vector<std::string_view>` of the values of the `columns` of each record, in order.
+  template <typename F>
+  size_t Unpack(const std::vector<std::string>& columns, F&& f) const {
+    std::vector<size_t> indexes;
+    for (const std::string& name : columns) {
+      indexes.push_back(schema_.Find(name));
+    }
+    return columnar_->Unpack(indexes, std::forward<F>(f));
+  }
+
+  // Calls `f` with each record, with only the fields of the `columns` populated, and the others as they are
+  // in a default-constructed `T`.
+  template <typename F>
+  size_t UnpackRecords(const std::vector<std::string>& columns, F&& f) const {
+    return UnpackRecordsImpl(schema_.WithGates(columns), std::forward<F>(f));
+  }
+
+  template <typename F>
+  size_t UnpackRecords(F&& f) const {
+    std::vector<size_t> all(schema_.Columns().size());
+    for (size_t i = 0u; i < all.size(); ++i) {
+      all[i] = i;
+    }
+    return UnpackRecordsImpl(all, std::forward<F>(f));
+  }
+
+ protected:
+  explicit ColumnarReader(std::unique_ptr<CompactTSVColumnar> columnar) : columnar_(std::move(columnar)) {
+    if (columnar_->ColumnNames() != schema_.Names()) {
+      std::vector<std::string> missing;
+      std::vector<std::string> unexpected;
+      for (const std::string& name : schema_.Names()) {
+        if (std::find(columnar_->ColumnNames().begin(), columnar_->ColumnNames().end(), name) ==
+            columnar_->ColumnNames().end()) {
+          missing.push_back(name);
+        }
+      }
+      for (const std::string& name : columnar_->ColumnNames()) {
+        if (std::find(schema_.Names().begin(), schema_.Names().end(), name) == schema_.Names().end()) {
+          unexpected.push_back(name);
+        }
+      }
+      CURRENT_THROW(ColumnarSchemaMismatchException(
+          "The columns of the file do not match `" + std::string(reflection::CurrentTypeName<T>()) + "`; missing: [" +
+          strings::Join(missing, ", ") + "], unexpected: [" + strings::Join(unexpected, ", ") +
+          (missing.empty() && unexpected.empty() ? "], in a different order." : "].")));
+    }
+  }
+
+ private:
+  template <typename F>
+  size_t UnpackRecordsImpl(const std::vector<size_t>& indexes, F&& f) const {
+    const auto& columns = schema_.Columns();
+    return columnar_->Unpack(indexes, [&](const std::vector<std::string_view>& row) {
+      T record;
+      for (size_t i = 0u; i < indexes.size(); ++i) {
+        columns[indexes[i]].parse(record, row[i]);
+      }
+      f(record);
+    });
+  }
+
+  const Schema<T>& schema_ = Schema<T>::Instance();
+  const std::unique_ptr<CompactTSVColumnar> columnar_;
+};
+
+template <typename T>
+class ColumnarFileReader final : public ColumnarReader<T> {
+ public:
+  explicit ColumnarFileReader(const std::string& file_name)
+      : ColumnarReader<T>(std::make_unique<CompactTSVColumnarFile>(file_name)) {}
+};
+
+}  // namespace columnar
+}  // namespace current
+
+#endif  // CURRENT_TYPE_SYSTEM_COLUMNAR_COLUMNAR_H
@@ -0,0 +1,191 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Maxim Zhurovich <zhurovich@gmail.com>
+          (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// This `test.cc` file is `#include`-d from `../test.cc`, and thus needs a header guard.
+
+#ifndef CURRENT_TYPE_SYSTEM_COLUMNAR_TEST_CC
+#define CURRENT_TYPE_SYSTEM_COLUMNAR_TEST_CC
+
+#include "columnar.h"
+
+#include "../../bricks/file/file.h"
+#include "../../bricks/strings/join.h"
+
+#include "../../3rdparty/gtest/gtest-main.h"
+
+namespace columnar_test {
+
+CURRENT_STRUCT(Point) {
+  CURRENT_FIELD(x, int32_t);
+  CURRENT_FIELD(y, double);
+};
+
+CURRENT_STRUCT(Click) {
+  CURRENT_FIELD(button, std::string);
+  CURRENT_FIELD(at, Point);
+};
+
+CURRENT_STRUCT(Scroll) { CURRENT_FIELD(delta, int64_t); };
+
+// clang-format off
+CURRENT_ENUM(Device, uint8_t) { Desktop = 1u, Mobile = 2u };
+// clang-format on
+
+CURRENT_STRUCT(EventBase) { CURRENT_FIELD(user, std::string); };
+
+CURRENT_STRUCT(Event, EventBase) {
+  CURRENT_FIELD(us, std::chrono::microseconds);
+  CURRENT_FIELD(device, Device);
+  CURRENT_FIELD(ok, bool);
+  CURRENT_FIELD(location, Optional<Point>);
+  CURRENT_FIELD(score, Optional<double>);
+  CURRENT_FIELD(action, (Variant<Click, Scroll>));
+  CURRENT_FIELD(tags, std::vector<std::string>);
+};
+
+CURRENT_STRUCT(OtherEvent) {
+  CURRENT_FIELD(user, std::string);
+  CURRENT_FIELD(score, double);
+};
+
+inline Event MakeEvent(size_t i) {
+  Event event;
+  event.user = "user" + current::ToString(i % 17u);
+  event.us = std::chrono::microseconds(1500000000000000ll + static_cast<int64_t>(i * 1000u));
+  event.device = (i % 3u) ? Device::Desktop : Device::Mobile;
+  event.ok = (i % 5u) != 0u;
+  if (i % 4u) {
+    event.location = Point();
+    Value(event.location).x = -static_cast<int32_t>(i);
+    Value(event.location).y = 0.1 * static_cast<double>(i);
+  }
+  if (i % 7u == 1u) {
+    event.score = 1.0 / static_cast<double>(i);
+  }
+  if (i % 2u) {
+    Click click;
+    click.button = (i % 3u) ? "left" : "";
+    click.at.x = static_cast<int32_t>(i);
+    click.at.y = -1e100;
+    event.action = click;
+  } else if (i % 10u) {
+    Scroll scroll;
+    scroll.delta = static_cast<int64_t>(i) - 500;
+    event.action = scroll;
+  }
+  if (i % 6u == 0u) {
+    event.tags = {"a", "b\tc", current::ToString(i)};
+  }
+  return event;
+}
+
+}  // namespace columnar_test
+
+TEST(Columnar, Schema) {
+  using namespace columnar_test;
+  EXPECT_EQ(
+      "user,us,device,ok,location#exists,location.x,location.y,score#exists,score,action#case,action.Click.button,"
+      "action.Click.at.x,action.Click.at.y,action.Scroll.delta,tags",
+      current::strings::Join(current::columnar::Schema<Event>::Instance().Names(), ','));
+  EXPECT_EQ("#case,Click.button,Click.at.x,Click.at.y,Scroll.delta",
+            current::strings::Join(current::columnar::Schema<Variant<Click, Scroll>>::Instance().Names(), ','));
+  EXPECT_EQ("value", current::strings::Join(current::columnar::Schema<int>::Instance().Names(), ','));
+}
+
+TEST(Columnar, WriteAndRead) {
+  using namespace columnar_test;
+
+  std::vector<Event> events;
+  for (size_t i = 0u; i < 1000u; ++i) {
+    events.push_back(MakeEvent(i));
+  }
+
+  std::ostringstream os;
+  current::columnar::ColumnarWriter<Event> writer(os, 300u);
+  writer.WriteRange(events);
+  writer.Finalize();
+  const std::string packed = os.str();
+
+  const current::columnar::ColumnarReader<Event> reader(packed);
+  EXPECT_EQ(1000u, reader.Rows());
+  EXPECT_EQ(4u, reader.Container().Blocks());
+  EXPECT_EQ(CompactTSVColumnEncoding::DeltaInteger, reader.Container().Encoding(0u, 1u));
+
+  size_t index = 0u;
+  EXPECT_EQ(1000u, reader.UnpackRecords([&](const Event& event) {
+    EXPECT_EQ(JSON(events[index]), JSON(event)) << index;
+    ++index;
+  }));
+  EXPECT_EQ(1000u, index);
+
+  index = 0u;
+  EXPECT_EQ(1000u, reader.UnpackRecords({"action.Scroll.delta", "score", "location.y"}, [&](const Event& event) {
+    const Event& expected = events[index];
+    EXPECT_EQ(Exists<Scroll>(expected.action), Exists<Scroll>(event.action)) << index;
+    EXPECT_EQ(Exists<Click>(expected.action), Exists<Click>(event.action)) << index;
+    if (Exists<Scroll>(expected.action)) {
+      EXPECT_EQ(Value<Scroll>(expected.action).delta, Value<Scroll>(event.action).delta) << index;
+    }
+    EXPECT_EQ(JSON(expected.score), JSON(event.score)) << index;
+    ASSERT_EQ(Exists(expected.location), Exists(event.location)) << index;
+    if (Exists(expected.location)) {
+      EXPECT_EQ(Value(expected.location).y, Value(event.location).y) << index;
+    }
+    ++index;
+  }));
+  EXPECT_EQ(1000u, index);
+
+  std::vector<std::string> cells;
+  EXPECT_EQ(1000u,
+            reader.Unpack({"us", "score#exists", "action#case"}, [&cells](const std::vector<std::string_view>& row) {
+              cells.push_back(std::string(row[0]) + ' ' + std::string(row[1]) + ' ' + std::string(row[2]));
+            }));
+  EXPECT_EQ("1500000000000000 0 ", cells[0]);
+  EXPECT_EQ("1500000000001000 1 Click", cells[1]);
+  EXPECT_EQ("1500000000002000 0 Scroll", cells[2]);
+
+  ASSERT_THROW(reader.Unpack({"nope"}, [](const std::vector<std::string_view>&) {}),
+               current::columnar::ColumnarUnknownColumnException);
+  ASSERT_THROW(current::columnar::ColumnarReader<OtherEvent>{packed},
+               current::columnar::ColumnarSchemaMismatchException);
+  try {
+    current::columnar::ColumnarReader<OtherEvent>{packed};
+  } catch (const current::columnar::ColumnarSchemaMismatchException& e) {
+    EXPECT_NE(std::string::npos, e.OriginalDescription().find("missing: [], unexpected: [us, device,"))
+        << e.OriginalDescription();
+  }
+
+  const std::string file_name = current::FileSystem::JoinPath(".current", "events.columnar");
+  const auto file_remover = current::FileSystem::ScopedRmFile(file_name);
+  current::FileSystem::WriteStringToFile(packed, file_name.c_str());
+  const current::columnar::ColumnarFileReader<Event> file_reader(file_name);
+  size_t clicks = 0u;
+  EXPECT_EQ(1000u, file_reader.UnpackRecords({"action#case"}, [&clicks](const Event& event) {
+    clicks += Exists<Click>(event.action);
+  }));
+  EXPECT_EQ(500u, clicks);
+}
+
+#endif  // CURRENT_TYPE_SYSTEM_COLUMNAR_TEST_CC
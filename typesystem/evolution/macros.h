@@ -35,9 +35,12 @@ SOFTWARE.
 
 // `CURRENT_EVOLVE` and `CURRENT_NATURAL_EVOLVE` are the syntaxes to eliminate the need
 // to write `::current::type_evolution::Evolve<...>::template Go<...>(from_object, into_object)`.
-#define CURRENT_EVOLVE_IMPL(evolver, from_namespace, into_namespace, from_object, into_object)                        \
-  ::current::type_evolution::Evolve<from_namespace, ::current::decay_t<decltype(from_object)>, evolver>::template Go< \
-      into_namespace>(from_object, into_object)
+#define CURRENT_EVOLVE_IMPL(evolver, from_namespace, into_namespace, from_object, into_object) \
+  ::current::type_evolution::EvolveOrMove<from_namespace,                                      \
+                                          ::current::decay_t<decltype(from_object)>,           \
+                                          evolver,                                             \
+                                          into_namespace,                                      \
+                                          ::current::decay_t<decltype(into_object)>>::Go(from_object, into_object)
 
 // `CURRENT_EVOLVE` uses the `evolver` provided explicitly as the first parameter.
 #define CURRENT_EVOLVE(evolver, from_namespace, into_namespace, from_object, into_object) \
@@ -50,8 +53,9 @@ SOFTWARE.
   CURRENT_EVOLVE_IMPL(CURRENT_ACTIVE_EVOLVER, from_namespace, into_namespace, from_object, into_object)
 
 // Making the syntax shorter. -- D.K.
-#define CURRENT_COPY_FIELD(f) \
-  ::current::type_evolution::Evolve<FROM, decltype(from.f), CURRENT_ACTIVE_EVOLVER>::template Go<INTO>(from.f, into.f)
+#define CURRENT_COPY_FIELD(f)                                                                                    \
+  ::current::type_evolution::EvolveOrMove<FROM, decltype(from.f), CURRENT_ACTIVE_EVOLVER, INTO, decltype(into.f)>:: \
+      Go(from.f, into.f)
 
 #define CURRENT_COPY_SUPER(t)                                                                  \
   ::current::type_evolution::Evolve<FROM, FROM::t, CURRENT_ACTIVE_EVOLVER>::template Go<INTO>( \
@@ -898,6 +898,84 @@ EXPECT_EQ("Zhurovich", into.w[1].last);
 }
 #endif  // CURRENT_WINDOWS
 
+#ifndef JUST_GENERATE_THAT_GOLDEN_FILE
+TEST(TypeEvolutionTest, IdenticalTypesAreMovedNotEvolved) {
+  using namespace type_evolution_test;
+  using current::type_evolution::AddFortyTwoToX;
+  using current::type_evolution::NaturalEvolver;
+
+  {
+    // Same type on both ends with the natural evolver: the object, including its vector, is moved over.
+    typename SchemaXX::StructWithVectorOfNames from;
+    typename SchemaXX::StructWithVectorOfNames into;
+    from.w.resize(3);
+    from.w[2].first = "Dima";
+    const auto* const data = from.w.data();
+    CURRENT_EVOLVE(NaturalEvolver, SchemaXX, SchemaXX, std::move(from), into);
+    ASSERT_EQ(3u, into.w.size());
+    EXPECT_EQ("Dima", into.w[2].first);
+    EXPECT_EQ(data, into.w.data());
+  }
+  {
+    // A const source is copied.
+    typename SchemaXX::SimpleStruct from;
+    typename SchemaXX::SimpleStruct into;
+    from.x = 1;
+    from.z = "max";
+    CURRENT_EVOLVE(NaturalEvolver, SchemaXX, SchemaXX, static_cast<const SchemaXX::SimpleStruct&>(from), into);
+    EXPECT_EQ(1, into.x);
+    EXPECT_EQ("max", into.z);
+    EXPECT_EQ("max", from.z);
+  }
+  {
+    // Custom evolvers still apply to identical types.
+    typename SchemaXX::SimpleStruct from;
+    typename SchemaXX::SimpleStruct into;
+    from.x = 1;
+    CURRENT_EVOLVE(AddFortyTwoToX, SchemaXX, SchemaXX, std::move(from), into);
+    EXPECT_EQ(43, into.x);
+  }
+}
+
+TEST(TypeEvolutionTest, EvolveRange) {
+  using namespace type_evolution_test;
+  using current::type_evolution::EvolveRange;
+  using current::type_evolution::V1ToV2Evolver;
+
+  {
+    // Identical entry types: the block of entries is handed over as is.
+    std::vector<typename SchemaXX::Name> from(2);
+    from[1].last = "Korolev";
+    const auto* const data = from.data();
+    std::vector<typename SchemaXX::Name> into;
+    EvolveRange<SchemaXX, SchemaXX>::Go(std::move(from), into);
+    ASSERT_EQ(2u, into.size());
+    EXPECT_EQ("Korolev", into[1].last);
+    EXPECT_EQ(data, into.data());
+    EXPECT_TRUE(from.empty());
+
+    // Further blocks are appended.
+    std::vector<typename SchemaXX::Name> more(1);
+    more[0].first = "Max";
+    EvolveRange<SchemaXX, SchemaXX>::Go(std::move(more), into);
+    ASSERT_EQ(3u, into.size());
+    EXPECT_EQ("Max", into[2].first);
+  }
+  {
+    // Changing entry types: each entry is evolved directly into its destination slot.
+    std::vector<typename SchemaV1::Name> from;
+    from.emplace_back("Dima", "Korolev");
+    from.emplace_back("Max", "Zhurovich");
+    std::vector<typename SchemaV2::Name> into;
+    EvolveRange<SchemaV1, SchemaV2, V1ToV2Evolver>::Go(from, into);
+    ASSERT_EQ(2u, into.size());
+    EXPECT_EQ("Dima Korolev", into[0].full);
+    EXPECT_EQ("Max Zhurovich", into[1].full);
+    EXPECT_EQ(2u, from.size());
+  }
+}
+#endif  // JUST_GENERATE_THAT_GOLDEN_FILE
+
 namespace type_evolution_test {
 namespace pre_evolution {
 CURRENT_STRUCT(User, SchemaV1::Name) { CURRENT_FIELD(key, std::string); };
@@ -120,6 +120,66 @@ struct Evolve<FROM_NAMESPACE, Optional<OPTIONAL_INNER_TYPE>, EVOLVER> {
   }
 };
 
+// Evolvers which never alter a type evolving into itself. The exported schema names each type after its type ID,
+// so structurally identical types from two schemas are the very same C++ type, and, for these evolvers,
+// evolving such a type is a plain copy, or a move when the source is an rvalue. `NaturalEvolver` qualifies;
+// a custom evolver that only handles the types which do change can opt in via `CURRENT_EVOLVER_PRESERVES_IDENTITY`.
+template <typename EVOLVER>
+struct EvolverPreservesIdentity : std::false_type {};
+
+template <>
+struct EvolverPreservesIdentity<NaturalEvolver> : std::true_type {};
+
+// The entry point used by `CURRENT_EVOLVE` and `CURRENT_COPY_FIELD`: resolves to a copy or a move at compile time
+// when the source and the destination types are identical, and to the field-by-field `Evolve` otherwise.
+template <typename FROM_NAMESPACE,
+          typename FROM_TYPE,
+          typename EVOLVER,
+          typename INTO_NAMESPACE,
+          typename INTO_TYPE,
+          bool IDENTITY = std::is_same_v<FROM_TYPE, INTO_TYPE> && EvolverPreservesIdentity<EVOLVER>::value>
+struct EvolveOrMove {
+  static void Go(const FROM_TYPE& from, INTO_TYPE& into) {
+    Evolve<FROM_NAMESPACE, FROM_TYPE, EVOLVER>::template Go<INTO_NAMESPACE>(from, into);
+  }
+};
+
+template <typename FROM_NAMESPACE, typename T, typename EVOLVER, typename INTO_NAMESPACE>
+struct EvolveOrMove<FROM_NAMESPACE, T, EVOLVER, INTO_NAMESPACE, T, true> {
+  static void Go(const T& from, T& into) { into = from; }
+  static void Go(T&& from, T& into) { into = std::move(from); }
+};
+
+// Evolves a range of entries, such as a block of stream records, appending them to `into`.
+// The destination entries are evolved into in place, with no intermediate per-entry objects. When the entry type
+// does not change, an rvalue source vector is moved over wholesale, and the entries themselves are never touched.
+template <typename FROM_NAMESPACE, typename INTO_NAMESPACE, typename EVOLVER = NaturalEvolver>
+struct EvolveRange {
+  template <typename FROM_TYPE, typename INTO_TYPE>
+  static void Go(const std::vector<FROM_TYPE>& from, std::vector<INTO_TYPE>& into) {
+    const size_t offset = into.size();
+    into.resize(offset + from.size());
+    auto placeholder = into.begin() + offset;
+    for (const auto& e : from) {
+      EvolveOrMove<FROM_NAMESPACE, FROM_TYPE, EVOLVER, INTO_NAMESPACE, INTO_TYPE>::Go(e, *placeholder++);
+    }
+  }
+
+  template <typename FROM_TYPE, typename INTO_TYPE>
+  static void Go(std::vector<FROM_TYPE>&& from, std::vector<INTO_TYPE>& into) {
+    if constexpr (std::is_same_v<FROM_TYPE, INTO_TYPE> && EvolverPreservesIdentity<EVOLVER>::value) {
+      if (into.empty()) {
+        into = std::move(from);
+      } else {
+        into.insert(into.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
+      }
+    } else {
+      Go(static_cast<const std::vector<FROM_TYPE>&>(from), into);
+    }
+    from.clear();
+  }
+};
+
 }  // namespace type_evolution
 }  // namespace current
 
@@ -141,4 +201,13 @@ struct Evolve<FROM_NAMESPACE, Optional<OPTIONAL_INNER_TYPE>, EVOLVER> {
 
 #define CURRENT_STRUCT_EVOLVER CURRENT_TYPE_EVOLVER
 
+#define CURRENT_EVOLVER_PRESERVES_IDENTITY(evolver)             \
+  namespace current {                                           \
+  namespace type_evolution {                                    \
+  struct evolver;                                               \
+  template <>                                                   \
+  struct EvolverPreservesIdentity<evolver> : std::true_type {}; \
+  }                                                             \
+  }
+
 #endif  // CURRENT_TYPE_SYSTEM_EVOLUTION_TYPE_EVOLUTION_H
@@ -38,6 +38,7 @@ SOFTWARE.
 #include "../port.h"  // `make_unique<>`.
 
 #include <memory>
+#include <new>
 #include <type_traits>
 
 #include "types.h"
@@ -51,6 +52,116 @@ namespace current {
 // construct itself from a bare pointer.
 struct FromBarePointer {};
 
+// The non-POD objects of at most this many bytes, which can be moved without throwing, are kept within
+// the `Optional` or `ImmutableOptional` itself, and the other ones are allocated on the heap.
+// Zero keeps them all on the heap.
+#ifndef CURRENT_OPTIONAL_INLINE_STORAGE_SIZE
+#define CURRENT_OPTIONAL_INLINE_STORAGE_SIZE 64
+#endif  // CURRENT_OPTIONAL_INLINE_STORAGE_SIZE
+
+namespace optional {
+
+// The object owned by the non-POD `Optional` or `ImmutableOptional`, if any.
+// `Emplace()` constructs the new object before destroying the old one, as the arguments may refer to the latter.
+template <typename T,
+          bool INLINE = (sizeof(T) <= CURRENT_OPTIONAL_INLINE_STORAGE_SIZE && std::is_nothrow_move_constructible_v<T>)>
+class OwnedObject;
+
+template <typename T>
+class OwnedObject<T, false> final {
+ public:
+  OwnedObject() = default;
+
+  T* Get() { return object_.get(); }
+
+  template <typename... ARGS>
+  T* Emplace(ARGS&&... args) {
+    object_ = std::make_unique<T>(std::forward<ARGS>(args)...);
+    return object_.get();
+  }
+
+  T* Adopt(std::unique_ptr<T>&& object) {
+    object_ = std::move(object);
+    return object_.get();
+  }
+
+  T* MoveFrom(OwnedObject& rhs) noexcept {
+    object_ = std::move(rhs.object_);
+    return object_.get();
+  }
+
+  void Reset() { object_ = nullptr; }
+
+ private:
+  OwnedObject(const OwnedObject&) = delete;
+  OwnedObject& operator=(const OwnedObject&) = delete;
+
+  std::unique_ptr<T> object_;
+};
+
+template <typename T>
+class OwnedObject<T, true> final {
+ public:
+  OwnedObject() {}
+  ~OwnedObject() { Reset(); }
+
+  T* Get() { return exists_ ? &value_ : nullptr; }
+
+  template <typename... ARGS>
+  T* Emplace(ARGS&&... args) {
+    if (exists_) {
+      T replacement(std::forward<ARGS>(args)...);
+      Reset();
+      return EmplaceIntoVacant(std::move(replacement));
+    } else {
+      return EmplaceIntoVacant(std::forward<ARGS>(args)...);
+    }
+  }
+
+  T* Adopt(std::unique_ptr<T>&& object) {
+    if (object) {
+      return Emplace(std::move(*object));
+    } else {
+      Reset();
+      return nullptr;
+    }
+  }
+
+  T* MoveFrom(OwnedObject& rhs) noexcept {
+    Reset();
+    if (rhs.exists_) {
+      EmplaceIntoVacant(std::move(rhs.value_));
+      rhs.Reset();
+    }
+    return Get();
+  }
+
+  void Reset() {
+    if (exists_) {
+      value_.~T();
+      exists_ = false;
+    }
+  }
+
+ private:
+  OwnedObject(const OwnedObject&) = delete;
+  OwnedObject& operator=(const OwnedObject&) = delete;
+
+  template <typename... ARGS>
+  T* EmplaceIntoVacant(ARGS&&... args) {
+    ::new (static_cast<void*>(&value_)) T(std::forward<ARGS>(args)...);
+    exists_ = true;
+    return &value_;
+  }
+
+  union {
+    T value_;
+  };
+  bool exists_ = false;
+};
+
+}  // namespace optional
+
 // `ImmutableOptional` class holds immutable optional value of `T`.
 template <typename, typename Enable = void>
 class ImmutableOptional;
@@ -88,15 +199,22 @@ class ImmutableOptional<T, std::enable_if_t<!std::is_pod<T>::value>> final {
 
   ImmutableOptional(const FromBarePointer&, const T* ptr) : optional_object_(ptr) {}
 
-  ImmutableOptional(const T& object)
-      : owned_optional_object_(std::make_unique<T>(object)), optional_object_(owned_optional_object_.get()) {}
+  ImmutableOptional(const T& object) : optional_object_(owned_optional_object_.Emplace(object)) {}
+
+  ImmutableOptional(T&& object) : optional_object_(owned_optional_object_.Emplace(std::move(object))) {}
+
+  ImmutableOptional(std::unique_ptr<T>&& uptr) : optional_object_(owned_optional_object_.Adopt(std::move(uptr))) {}
 
-  ImmutableOptional(T&& object)
-      : owned_optional_object_(std::make_unique<T>(std::move(object))),
-        optional_object_(owned_optional_object_.get()) {}
+  // The object owned is moved over, and the bare pointer, if that is what `rhs` holds, is copied.
+  ImmutableOptional(ImmutableOptional&& rhs) noexcept { MoveFrom(rhs); }
 
-  ImmutableOptional(std::unique_ptr<T>&& uptr)
-      : owned_optional_object_(std::move(uptr)), optional_object_(owned_optional_object_.get()) {}
+  ImmutableOptional& operator=(ImmutableOptional&& rhs) noexcept {
+    if (&rhs != this) {
+      owned_optional_object_.Reset();
+      MoveFrom(rhs);
+    }
+    return *this;
+  }
 
   bool ExistsImpl() const { return optional_object_ != nullptr; }
 
@@ -109,8 +227,17 @@ class ImmutableOptional<T, std::enable_if_t<!std::is_pod<T>::value>> final {
   }
 
  private:
-  std::unique_ptr<T> owned_optional_object_;
-  const T* optional_object_;
+  void MoveFrom(ImmutableOptional& rhs) noexcept {
+    if (rhs.optional_object_ && rhs.optional_object_ == rhs.owned_optional_object_.Get()) {
+      optional_object_ = owned_optional_object_.MoveFrom(rhs.owned_optional_object_);
+    } else {
+      optional_object_ = rhs.optional_object_;
+    }
+    rhs.optional_object_ = nullptr;
+  }
+
+  optional::OwnedObject<T> owned_optional_object_;
+  const T* optional_object_ = nullptr;
 };
 
 // Compare `ImmutableOptional<T>` with `ImmutableOptional<T>`.
@@ -225,7 +352,7 @@ class Optional<T, std::enable_if_t<std::is_pod<T>::value>> final {
     exists_ = rhs.exists_;
   }
 
-  Optional(Optional<T>&& rhs) {
+  Optional(Optional<T>&& rhs) noexcept {
     value_ = rhs.value_;
     exists_ = rhs.exists_;
     rhs.exists_ = false;
@@ -312,110 +439,96 @@ class Optional<T, std::enable_if_t<!std::is_pod<T>::value>> final {
 
   Optional(const FromBarePointer&, T* ptr) : optional_object_(ptr) {}
 
-  Optional(const T& object)
-      : owned_optional_object_(std::make_unique<T>(object)), optional_object_(owned_optional_object_.get()) {}
+  Optional(const T& object) : optional_object_(owned_optional_object_.Emplace(object)) {}
 
-  Optional(T&& object)
-      : owned_optional_object_(std::make_unique<T>(std::move(object))),
-        optional_object_(owned_optional_object_.get()) {}
+  Optional(T&& object) : optional_object_(owned_optional_object_.Emplace(std::move(object))) {}
 
-  Optional(std::unique_ptr<T>&& uptr)
-      : owned_optional_object_(std::move(uptr)), optional_object_(owned_optional_object_.get()) {}
+  Optional(std::unique_ptr<T>&& uptr) : optional_object_(owned_optional_object_.Adopt(std::move(uptr))) {}
 
   Optional(const Optional<T>& rhs) {
     if (rhs.ExistsImpl()) {
-      owned_optional_object_ = std::make_unique<T>(rhs.ValueImpl());
-    } else {
-      owned_optional_object_ = nullptr;
+      optional_object_ = owned_optional_object_.Emplace(rhs.ValueImpl());
     }
-    optional_object_ = owned_optional_object_.get();
   }
 
-  Optional(Optional<T>&& rhs) {
+  Optional(Optional<T>&& rhs) noexcept {
     if (rhs.ExistsImpl()) {
-      owned_optional_object_ = std::move(rhs.owned_optional_object_);
+      optional_object_ = owned_optional_object_.MoveFrom(rhs.owned_optional_object_);
       rhs = nullptr;
-    } else {
-      owned_optional_object_ = nullptr;
     }
-    optional_object_ = owned_optional_object_.get();
   }
 
   Optional(const ImmutableOptional<T>& rhs) {
     if (rhs.ExistsImpl()) {
-      owned_optional_object_ = std::make_unique<T>(rhs.ValueImpl());
-    } else {
-      owned_optional_object_ = nullptr;
+      optional_object_ = owned_optional_object_.Emplace(rhs.ValueImpl());
     }
-    optional_object_ = owned_optional_object_.get();
   }
 
   Optional<T>& operator=(std::nullptr_t) {
-    owned_optional_object_ = nullptr;
+    owned_optional_object_.Reset();
     optional_object_ = nullptr;
     return *this;
   }
 
   Optional<T>& operator=(const T& object) {
-    if (!owned_optional_object_) {
-      owned_optional_object_ = std::make_unique<T>(object);
+    if (!owned_optional_object_.Get()) {
+      optional_object_ = owned_optional_object_.Emplace(object);
     } else {
-      *owned_optional_object_ = object;
+      *owned_optional_object_.Get() = object;
+      optional_object_ = owned_optional_object_.Get();
     }
-    optional_object_ = owned_optional_object_.get();
     return *this;
   }
 
   Optional<T>& operator=(T&& object) {
-    if (!owned_optional_object_) {
-      owned_optional_object_ = std::make_unique<T>(std::move(object));
+    if (!owned_optional_object_.Get()) {
+      optional_object_ = owned_optional_object_.Emplace(std::move(object));
     } else {
-      *owned_optional_object_ = std::move(object);
+      *owned_optional_object_.Get() = std::move(object);
+      optional_object_ = owned_optional_object_.Get();
     }
-    optional_object_ = owned_optional_object_.get();
     return *this;
   }
 
   Optional<T>& operator=(T* ptr) {
-    owned_optional_object_ = nullptr;
+    owned_optional_object_.Reset();
     optional_object_ = ptr;
     return *this;
   }
 
   Optional<T>& operator=(std::unique_ptr<T>&& uptr) {
-    owned_optional_object_ = std::move(uptr);
-    optional_object_ = owned_optional_object_.get();
+    optional_object_ = owned_optional_object_.Adopt(std::move(uptr));
     return *this;
   }
 
   Optional<T>& operator=(const Optional<T>& rhs) {
     if (rhs.ExistsImpl()) {
-      owned_optional_object_ = std::make_unique<T>(rhs.ValueImpl());
+      optional_object_ = owned_optional_object_.Emplace(rhs.ValueImpl());
     } else {
-      owned_optional_object_ = nullptr;
+      owned_optional_object_.Reset();
+      optional_object_ = nullptr;
     }
-    optional_object_ = owned_optional_object_.get();
     return *this;
   }
 
   Optional<T>& operator=(Optional<T>&& rhs) {
     if (rhs.ExistsImpl()) {
-      owned_optional_object_ = std::move(rhs.owned_optional_object_);
+      optional_object_ = owned_optional_object_.MoveFrom(rhs.owned_optional_object_);
       rhs = nullptr;
     } else {
-      owned_optional_object_ = nullptr;
+      owned_optional_object_.Reset();
+      optional_object_ = nullptr;
     }
-    optional_object_ = owned_optional_object_.get();
     return *this;
   }
 
   Optional<T>& operator=(const ImmutableOptional<T>& rhs) {
     if (rhs.ExistsImpl()) {
-      owned_optional_object_ = std::make_unique<T>(rhs.ValueImpl());
+      optional_object_ = owned_optional_object_.Emplace(rhs.ValueImpl());
     } else {
-      owned_optional_object_ = nullptr;
+      owned_optional_object_.Reset();
+      optional_object_ = nullptr;
     }
-    optional_object_ = owned_optional_object_.get();
     return *this;
   }
 
@@ -438,7 +551,7 @@ class Optional<T, std::enable_if_t<!std::is_pod<T>::value>> final {
   }
 
  private:
-  std::unique_ptr<T> owned_optional_object_;
+  optional::OwnedObject<T> owned_optional_object_;
   T* optional_object_ = nullptr;
 };
 
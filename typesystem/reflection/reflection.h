@@ -29,7 +29,10 @@ SOFTWARE.
 #include "typeid.h"
 
 #include <array>
+#include <atomic>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <typeindex>
 #include <type_traits>
@@ -67,11 +70,30 @@ reflection::TypeID InternalCurrentTypeID(std::type_index top_level_type, const c
 // of correponding calls to `InternalCurrentTypeID` may and will be different in case of cyclic dependencies,
 // as the order of their resolution by definition depends on which part of the cycle was the starting point.
 
+// The "user-facing" type ID of `T` depends neither on the thread nor on what has been reflected upon before,
+// so, once computed on any thread, it is kept as a process-wide constant, read with a single atomic load.
+// Constant-initialized, so that reading it involves no function-local static guard.
+template <typename T>
+struct CurrentTypeIDCache final {
+  static std::atomic<uint64_t> value;
+};
+
+template <typename T>
+std::atomic<uint64_t> CurrentTypeIDCache<T>::value(static_cast<uint64_t>(TypeID::UninitializedType));
+
 // Called from `CurrentTypeID<T>()` defined in `typeid.h`, to be lightweight-injectable.
 template <typename T>
 struct DefaultCurrentTypeIDImpl final {
   static TypeID GetTypeID() {
-    return InternalCurrentTypeID<T>(typeid(T), CurrentTypeName<T, NameFormat::Z>());
+    const uint64_t cached = CurrentTypeIDCache<T>::value.load(std::memory_order_relaxed);
+    if (cached != static_cast<uint64_t>(TypeID::UninitializedType)) {
+      return static_cast<TypeID>(cached);
+    }
+    const TypeID type_id = InternalCurrentTypeID<T>(typeid(T), CurrentTypeName<T, NameFormat::Z>());
+    if (type_id != TypeID::UninitializedType) {
+      CurrentTypeIDCache<T>::value.store(static_cast<uint64_t>(type_id), std::memory_order_relaxed);
+    }
+    return type_id;
   }
 };
 
@@ -320,9 +342,69 @@ reflection::TypeID InternalCurrentTypeID(std::type_index top_level_type, const c
   return type_id;
 }
 
+// The `ReflectedType`-s computed by any thread so far, for the other threads to not reflect on them anew.
+// Read without locks: the readers load the pointer to the current immutable snapshot of the map, and the writers,
+// under the mutex, publish the new snapshot with the types they have added. The snapshots are never freed, as the
+// readers may still be using them; their number is bounded by the number of types the program reflects upon.
+class ReflectedTypesRegistry final {
+ public:
+  using map_t = std::unordered_map<TypeID, const ReflectedType*, GenericHashFunction<TypeID>>;
+
+  static ReflectedTypesRegistry& Instance() { return Singleton<ReflectedTypesRegistry>(); }
+
+  const ReflectedType* Find(TypeID type_id) const {
+    const map_t* snapshot = snapshot_.load(std::memory_order_acquire);
+    if (snapshot) {
+      const auto cit = snapshot->find(type_id);
+      if (cit != snapshot->end()) {
+        return cit->second;
+      }
+    }
+    return nullptr;
+  }
+
+  // Returns the published instance for each of `types`, in the same order. It is the one passed in,
+  // unless another thread has published this type first.
+  std::vector<const ReflectedType*> Publish(std::vector<std::pair<TypeID, std::unique_ptr<ReflectedType>>>&& types) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const map_t* current = snapshot_.load(std::memory_order_relaxed);
+    auto next = current ? std::make_unique<map_t>(*current) : std::make_unique<map_t>();
+    std::vector<const ReflectedType*> result;
+    for (auto& type : types) {
+      const ReflectedType*& placeholder = (*next)[type.first];
+      if (!placeholder) {
+        placeholder = type.second.get();
+        owned_.push_back(std::move(type.second));
+      }
+      result.push_back(placeholder);
+    }
+    snapshot_.store(next.get(), std::memory_order_release);
+    snapshots_.push_back(std::move(next));
+    return result;
+  }
+
+ private:
+  std::atomic<const map_t*> snapshot_{nullptr};
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<const map_t>> snapshots_;
+  std::vector<std::unique_ptr<ReflectedType>> owned_;
+};
+
+// Once published, the `ReflectedType` of `T` is returned by `Reflector().ReflectType<T>()` on any thread
+// with a single atomic load.
+template <typename T>
+struct ReflectedTypeCache final {
+  static std::atomic<const ReflectedType*> value;
+};
+
+template <typename T>
+std::atomic<const ReflectedType*> ReflectedTypeCache<T>::value(nullptr);
+
 // Stage two of two: `ReflectorImpl`, or just `Reflector()` reflects on types and returns
 // their info as the `ReflectedType` variant type.
-// `ReflectorImpl` is a thread-local singleton to generate reflected types metadata at runtime.
+// `ReflectorImpl` is a thread-local singleton to generate reflected types metadata at runtime. The types it has
+// reflected upon are published into `ReflectedTypesRegistry` once the outermost `ReflectType<T>()` call returns,
+// as only then are all the types `T` refers to, including through cyclic dependencies, reflected upon in full.
 struct ReflectorImpl {
   static ReflectorImpl& ThreadLocalInstance() { return ThreadLocalSingleton<ReflectorImpl>(); }
 
@@ -350,20 +432,43 @@ struct ReflectorImpl {
 
   template <typename T>
   const ReflectedType& ReflectType() {
+    const ReflectedType* published = ReflectedTypeCache<T>::value.load(std::memory_order_acquire);
+    if (published) {
+      return *published;
+    }
     // Fill in the internal thread-local structures for type `T` if they have not been filled yet.
     const TypeID type_id = CurrentTypeID<T>();
     Optional<ReflectedType>& optional_placeholder = map_[type_id];
     if (!Exists(optional_placeholder)) {
       optional_placeholder = std::make_unique<ReflectedType>();
-      Value(optional_placeholder) = operator()(TypeSelector<T>());
+      ++depth_;
+      try {
+        Value(optional_placeholder) = operator()(TypeSelector<T>());
+      } catch (...) {
+        if (!--depth_) {
+          to_publish_.clear();
+        }
+        throw;
+      }
+      --depth_;
+      to_publish_.emplace_back(type_id, &ReflectedTypeCache<T>::value);
+      if (!depth_) {
+        PublishReflectedTypes();
+      }
     }
-    return Value(optional_placeholder);
+    // Once published, the instance outlives this thread, and is the same on all the threads.
+    published = ReflectedTypeCache<T>::value.load(std::memory_order_acquire);
+    return published ? *published : Value(optional_placeholder);
   }
 
   const ReflectedType& ReflectedTypeByTypeID(const TypeID type_id) const {
     const auto cit = map_.find(type_id);
     if (cit != map_.end()) {
       return Value(cit->second);
+    }
+    const ReflectedType* published = ReflectedTypesRegistry::Instance().Find(type_id);
+    if (published) {
+      return *published;
     } else {
       CURRENT_THROW(UnknownTypeIDException(current::ToString(static_cast<uint64_t>(type_id))));
     }
@@ -515,9 +620,25 @@ struct ReflectorImpl {
     return CurrentTypeID<TemplateInnerType<T>>();
   }
 
+  void PublishReflectedTypes() {
+    std::vector<std::pair<TypeID, std::unique_ptr<ReflectedType>>> types;
+    for (const auto& type : to_publish_) {
+      types.emplace_back(type.first, std::make_unique<ReflectedType>(Value(map_[type.first])));
+    }
+    const std::vector<const ReflectedType*> published = ReflectedTypesRegistry::Instance().Publish(std::move(types));
+    for (size_t i = 0u; i < published.size(); ++i) {
+      to_publish_[i].second->store(published[i], std::memory_order_release);
+    }
+    to_publish_.clear();
+  }
+
   // The right hand side of this `unordered_map` is to make sure the underlying instance
   // has a fixed in-memory location, allowing returning it by const reference.
   std::unordered_map<TypeID, Optional<ReflectedType>, GenericHashFunction<TypeID>> map_;
+
+  // The types reflected upon by the outermost `ReflectType<T>()` call in progress, to publish once it is done.
+  size_t depth_ = 0u;
+  std::vector<std::pair<TypeID, std::atomic<const ReflectedType*>*>> to_publish_;
 };
 
 inline ReflectorImpl& Reflector() { return ReflectorImpl::ThreadLocalInstance(); }
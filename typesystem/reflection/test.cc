@@ -397,6 +397,25 @@ TEST(Reflection, SelfContainingStructIntrospection) {
   EXPECT_EQ(static_cast<uint64_t>(va.type_id), static_cast<uint64_t>(a.fields[0].type_id));
 }
 
+TEST(Reflection, ReflectedTypesAreSharedAcrossThreads) {
+  using namespace reflection_test;
+  using current::reflection::ReflectedType;
+  using current::reflection::ReflectedType_Struct;
+
+  const ReflectedType* derived = nullptr;
+  std::thread([&derived]() { derived = &Reflector().ReflectType<DerivedFromFoo>(); }).join();
+
+  std::thread([derived]() {
+    // Published once the first thread is done: the same instance, and its dependencies are known by their type IDs.
+    EXPECT_EQ(derived, &Reflector().ReflectType<DerivedFromFoo>());
+    const auto& s = Value<ReflectedType_Struct>(*derived);
+    EXPECT_EQ("DerivedFromFoo", s.native_name);
+    EXPECT_EQ("Foo", Value<ReflectedType_Struct>(Reflector().ReflectedTypeByTypeID(Value(s.super_id))).native_name);
+    ASSERT_EQ(1u, s.fields.size());
+    EXPECT_EQ("Bar", Value<ReflectedType_Struct>(Reflector().ReflectedTypeByTypeID(s.fields[0].type_id)).native_name);
+  }).join();
+}
+
 TEST(Reflection, TemplatedStruct) {
   using namespace reflection_test;
   using current::reflection::ReflectedType_Struct;
@@ -835,7 +854,7 @@ TEST(Reflection, VisitAllFieldsWithObject) {
       "1e+38,1e+308,"
       "The String,"
       "2,"
-      "Minus eight point five:-9.500000,"
+      "Minus eight point five:-9.5,"
       "[-1,-2,-4],"
       "[key1:value1,key2:value2],"
       "128,null",
@@ -931,21 +950,32 @@ CURRENT_STRUCT(Two) { CURRENT_FIELD(one, std::vector<One>); };
 
 }  // namespace reflection_test
 
+template <typename T>
+uint64_t UncachedCurrentTypeID() {
+  return static_cast<uint64_t>(current::reflection::InternalCurrentTypeID<T>(
+      typeid(T), current::reflection::CurrentTypeName<T, current::reflection::NameFormat::Z>()));
+}
+
 TEST(Reflection, OrderDoesNotMatter) {
   using namespace reflection_test;
   auto const one = current::reflection::CurrentTypeID<One>();
   auto const two = current::reflection::CurrentTypeID<Two>();
   EXPECT_EQ(9201293424144532153ull, static_cast<uint64_t>(one));
   EXPECT_EQ(9207292435550686765ull, static_cast<uint64_t>(two));
-  // `Reflector` is thread local, so starting another thread is the easiest way to ensure a stateless run.
+  // The internal state of type traversal is thread local, so starting another thread is the easiest way to ensure
+  // a stateless run. `CurrentTypeID<T>()` is cached process-wide, so `InternalCurrentTypeID<T>()` is called directly.
   // Also note that the order of computations of TypeIDs is flipped in the two threads.
   std::thread([one, two]() {
-    EXPECT_EQ(static_cast<uint64_t>(one), static_cast<uint64_t>(current::reflection::CurrentTypeID<One>()));
-    EXPECT_EQ(static_cast<uint64_t>(two), static_cast<uint64_t>(current::reflection::CurrentTypeID<Two>()));
+    EXPECT_EQ(static_cast<uint64_t>(one), UncachedCurrentTypeID<One>());
+    EXPECT_EQ(static_cast<uint64_t>(two), UncachedCurrentTypeID<Two>());
+  }).join();
+  std::thread([one, two]() {
+    EXPECT_EQ(static_cast<uint64_t>(two), UncachedCurrentTypeID<Two>());
+    EXPECT_EQ(static_cast<uint64_t>(one), UncachedCurrentTypeID<One>());
   }).join();
   std::thread([one, two]() {
-    EXPECT_EQ(static_cast<uint64_t>(two), static_cast<uint64_t>(current::reflection::CurrentTypeID<Two>()));
     EXPECT_EQ(static_cast<uint64_t>(one), static_cast<uint64_t>(current::reflection::CurrentTypeID<One>()));
+    EXPECT_EQ(static_cast<uint64_t>(two), static_cast<uint64_t>(current::reflection::CurrentTypeID<Two>()));
   }).join();
 }
 
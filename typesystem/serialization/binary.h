@@ -25,6 +25,13 @@ SOFTWARE.
 #ifndef CURRENT_TYPE_SYSTEM_SERIALIZATION_BINARY_H
 #define CURRENT_TYPE_SYSTEM_SERIALIZATION_BINARY_H
 
-// TBD.
+#include "serialization.h"
+
+#include "binary/binary.h"
+#include "binary/containers.h"
+#include "binary/optional.h"
+#include "binary/primitives.h"
+#include "binary/struct.h"
+#include "binary/variant.h"
 
 #endif  // CURRENT_TYPE_SYSTEM_SERIALIZATION_BINARY_H
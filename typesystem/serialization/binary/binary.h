@@ -0,0 +1,348 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Maxim Zhurovich <zhurovich@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// The binary format of Current: compact, not human-readable, and only meant to be read back by the same schema.
+//
+// * Unsigned integers are LEB128 varints, signed ones are zigzag-encoded varints; single bytes are stored as is.
+// * `float`-s and `double`-s are stored as their IEEE 754 bits, little-endian.
+// * Strings and containers are prefixed by their lengths, as varints.
+// * The fields of `CURRENT_STRUCT`-s follow each other in the order of their declaration, base struct first.
+// * `Optional`-s are one byte of `0` or `1`, followed by the value if it is present.
+// * `Variant`-s are the one-based index of the case in the typelist, as a varint, followed by the value,
+//   or just `0` for an uninitialized `Variant`.
+//
+// No field names or type IDs are stored inside the object. Instead, each top-level object is prefixed by
+// a header of four magic bytes, the TypeID of its type, which changes whenever its schema does, and the size
+// of the payload. Thus, loading an object of a different type, or of a different version of the same type,
+// fails loudly instead of yielding garbage.
+
+#ifndef CURRENT_TYPE_SYSTEM_SERIALIZATION_BINARY_BINARY_H
+#define CURRENT_TYPE_SYSTEM_SERIALIZATION_BINARY_BINARY_H
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+#include "exceptions.h"
+
+#include "../serialization.h"
+
+#include "../../struct.h"
+#include "../../optional.h"
+#include "../../helpers.h"
+#include "../../reflection/reflection.h"
+
+#include "../../../bricks/strings/util.h"
+#include "../../../bricks/util/crc32.h"
+
+namespace current {
+namespace serialization {
+namespace binary {
+
+constexpr static const char kBinaryFormatMagic[4] = {'C', '5', 'T', 'B'};
+constexpr static size_t kBinaryFormatMagicSize = sizeof(kBinaryFormatMagic);
+constexpr static size_t kBinaryFormatTypeIDSize = sizeof(uint64_t);
+constexpr static size_t kBinaryFormatMaxVarintSize = 10u;
+
+class BinarySerializer final {
+ public:
+  explicit BinarySerializer(std::string& output) : output_(output) {}
+
+  void WriteByte(uint8_t byte) { output_.push_back(static_cast<char>(byte)); }
+
+  void WriteBytes(const char* data, size_t size) { output_.append(data, size); }
+
+  void WriteVarint(uint64_t value) {
+    char buffer[kBinaryFormatMaxVarintSize];
+    size_t size = 0u;
+    while (value >= 0x80u) {
+      buffer[size++] = static_cast<char>(static_cast<uint8_t>(value) | 0x80u);
+      value >>= 7;
+    }
+    buffer[size++] = static_cast<char>(value);
+    output_.append(buffer, size);
+  }
+
+  void WriteSignedVarint(int64_t value) {
+    WriteVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+  }
+
+  void WriteFixed64(uint64_t value) {
+    char buffer[sizeof(uint64_t)];
+    for (size_t i = 0u; i < sizeof(uint64_t); ++i) {
+      buffer[i] = static_cast<char>(static_cast<uint8_t>(value >> (8u * i)));
+    }
+    output_.append(buffer, sizeof(uint64_t));
+  }
+
+  void WriteFixed32(uint32_t value) {
+    char buffer[sizeof(uint32_t)];
+    for (size_t i = 0u; i < sizeof(uint32_t); ++i) {
+      buffer[i] = static_cast<char>(static_cast<uint8_t>(value >> (8u * i)));
+    }
+    output_.append(buffer, sizeof(uint32_t));
+  }
+
+ private:
+  std::string& output_;
+};
+
+class BinaryDeserializer final {
+ public:
+  BinaryDeserializer(const char* begin, const char* end) : current_(begin), end_(end) {}
+  explicit BinaryDeserializer(std::string_view data) : BinaryDeserializer(data.data(), data.data() + data.size()) {}
+
+  size_t Remaining() const { return static_cast<size_t>(end_ - current_); }
+  bool AtEnd() const { return current_ == end_; }
+
+  uint8_t ReadByte() {
+    if (current_ == end_) {
+      CURRENT_THROW(BinaryLoadFromStreamException("Unexpected end of binary data."));
+    }
+    return static_cast<uint8_t>(*current_++);
+  }
+
+  // Returns a view into the data being deserialized, so the bytes can be copied straight into their destination.
+  const char* ReadBytes(size_t size) {
+    if (size > Remaining()) {
+      CURRENT_THROW(BinaryLoadFromStreamException("Unexpected end of binary data."));
+    }
+    const char* result = current_;
+    current_ += size;
+    return result;
+  }
+
+  uint64_t ReadVarint() {
+    uint64_t result = 0u;
+    for (size_t i = 0u; i < kBinaryFormatMaxVarintSize; ++i) {
+      const uint8_t byte = ReadByte();
+      result |= static_cast<uint64_t>(byte & 0x7fu) << (7u * i);
+      if (!(byte & 0x80u)) {
+        return result;
+      }
+    }
+    CURRENT_THROW(BinaryLoadFromStreamException("Malformed varint in binary data."));
+  }
+
+  int64_t ReadSignedVarint() {
+    const uint64_t value = ReadVarint();
+    return static_cast<int64_t>((value >> 1) ^ (~(value & 1u) + 1u));
+  }
+
+  uint64_t ReadFixed64() {
+    const char* bytes = ReadBytes(sizeof(uint64_t));
+    uint64_t result = 0u;
+    for (size_t i = 0u; i < sizeof(uint64_t); ++i) {
+      result |= static_cast<uint64_t>(static_cast<uint8_t>(bytes[i])) << (8u * i);
+    }
+    return result;
+  }
+
+  uint32_t ReadFixed32() {
+    const char* bytes = ReadBytes(sizeof(uint32_t));
+    uint32_t result = 0u;
+    for (size_t i = 0u; i < sizeof(uint32_t); ++i) {
+      result |= static_cast<uint32_t>(static_cast<uint8_t>(bytes[i])) << (8u * i);
+    }
+    return result;
+  }
+
+  // The number of elements in a string or in a container. Not trusted to pre-allocate more than the input can hold.
+  size_t ReadSize() {
+    const uint64_t size = ReadVarint();
+    if (size > static_cast<uint64_t>(std::numeric_limits<size_t>::max())) {
+      CURRENT_THROW(BinaryLoadFromStreamException("Container size out of range in binary data."));  // LCOV_EXCL_LINE
+    }
+    return static_cast<size_t>(size);
+  }
+
+  size_t ReserveSize(size_t size) const { return std::min(size, Remaining()); }
+
+ private:
+  const char* current_;
+  const char* const end_;
+};
+
+// The TypeID of `T`, to tell whether the binary data is of the very same schema. The reflection does not support
+// `std::tuple`-s, so for them it is a combination of the TypeID-s of their elements.
+template <typename T>
+struct BinarySchemaTypeIDImpl {
+  static reflection::TypeID Calculate() {
+    return Value<reflection::ReflectedTypeBase>(reflection::Reflector().ReflectType<T>()).type_id;
+  }
+};
+
+template <typename T>
+inline reflection::TypeID BinarySchemaTypeID() {
+  static const reflection::TypeID type_id = BinarySchemaTypeIDImpl<T>::Calculate();
+  return type_id;
+}
+
+template <typename... TS>
+struct BinarySchemaTypeIDImpl<std::tuple<TS...>> {
+  static reflection::TypeID Calculate() {
+    uint64_t hash = current::CRC32("std::tuple");
+    size_t i = 0u;
+    ((hash ^= current::ROL64(static_cast<uint64_t>(BinarySchemaTypeID<TS>()), ++i + 17u)), ...);
+    return static_cast<reflection::TypeID>(hash);
+  }
+};
+
+template <typename T>
+inline void SaveIntoBinary(std::string& output, const T& source) {
+  std::string payload;
+  BinarySerializer serializer(payload);
+  Serialize(serializer, source);
+  BinarySerializer header(output);
+  header.WriteBytes(kBinaryFormatMagic, kBinaryFormatMagicSize);
+  header.WriteFixed64(static_cast<uint64_t>(BinarySchemaTypeID<T>()));
+  header.WriteVarint(payload.size());
+  output.append(payload);
+}
+
+template <typename T>
+inline std::string SaveIntoBinary(const T& source) {
+  std::string output;
+  SaveIntoBinary(output, source);
+  return output;
+}
+
+template <typename T>
+inline void SaveIntoBinary(std::ostream& os, const T& source) {
+  const std::string output = SaveIntoBinary(source);
+  if (!os.write(output.data(), static_cast<std::streamsize>(output.size()))) {
+    CURRENT_THROW(BinaryException("Failed to write binary data into the stream."));  // LCOV_EXCL_LINE
+  }
+}
+
+namespace impl {
+
+inline void CheckBinaryHeader(const char* magic, uint64_t type_id, reflection::TypeID expected_type_id) {
+  if (std::memcmp(magic, kBinaryFormatMagic, kBinaryFormatMagicSize)) {
+    CURRENT_THROW(BinaryLoadFromStreamException("Not a binary-serialized object."));
+  }
+  if (type_id != static_cast<uint64_t>(expected_type_id)) {
+    CURRENT_THROW(BinarySchemaMismatchException("Expected T" + current::ToString(expected_type_id) + ", got T" +
+                                                 current::ToString(type_id) + "."));
+  }
+}
+
+template <typename T>
+inline void LoadPayloadFromBinary(std::string_view payload, T& destination) {
+  try {
+    BinaryDeserializer deserializer(payload);
+    Deserialize(deserializer, destination);
+    if (!deserializer.AtEnd()) {
+      CURRENT_THROW(BinaryLoadFromStreamException("Extra bytes at the end of a binary-serialized object."));
+    }
+    CheckIntegrity(destination);
+  } catch (UninitializedVariant) {
+    CURRENT_THROW(BinaryLoadFromStreamException("Uninitialized `Variant` in a binary-serialized object."));
+  }
+}
+
+}  // namespace impl
+
+// Loads one object from the beginning of `input`, and returns the number of bytes it took.
+template <typename T>
+inline size_t LoadFromBinary(std::string_view input, T& destination) {
+  BinaryDeserializer header(input);
+  const char* magic = header.ReadBytes(kBinaryFormatMagicSize);
+  const uint64_t type_id = header.ReadFixed64();
+  impl::CheckBinaryHeader(magic, type_id, BinarySchemaTypeID<T>());
+  const size_t size = header.ReadSize();
+  const char* payload = header.ReadBytes(size);
+  impl::LoadPayloadFromBinary(std::string_view(payload, size), destination);
+  return input.size() - header.Remaining();
+}
+
+template <typename T>
+inline void LoadFromBinary(std::istream& is, T& destination) {
+  char magic[kBinaryFormatMagicSize];
+  char type_id[kBinaryFormatTypeIDSize];
+  if (!is.read(magic, kBinaryFormatMagicSize) || !is.read(type_id, kBinaryFormatTypeIDSize)) {
+    CURRENT_THROW(BinaryLoadFromStreamException("Unexpected end of binary data."));
+  }
+  impl::CheckBinaryHeader(
+      magic, BinaryDeserializer(type_id, type_id + kBinaryFormatTypeIDSize).ReadFixed64(), BinarySchemaTypeID<T>());
+  uint64_t size = 0u;
+  for (size_t i = 0u; ; ++i) {
+    char c;
+    if (i == kBinaryFormatMaxVarintSize || !is.get(c)) {
+      CURRENT_THROW(BinaryLoadFromStreamException("Unexpected end of binary data."));
+    }
+    size |= static_cast<uint64_t>(static_cast<uint8_t>(c) & 0x7fu) << (7u * i);
+    if (!(static_cast<uint8_t>(c) & 0x80u)) {
+      break;
+    }
+  }
+  // Read in pieces, so that a corrupted size does not make it allocate more memory than the stream has data for.
+  constexpr static size_t kPieceSize = 64u * 1024u;
+  std::string payload;
+  while (payload.size() < size) {
+    const size_t offset = payload.size();
+    const size_t piece = static_cast<size_t>(std::min(static_cast<uint64_t>(kPieceSize), size - offset));
+    payload.resize(offset + piece);
+    if (!is.read(&payload[offset], static_cast<std::streamsize>(piece))) {
+      CURRENT_THROW(BinaryLoadFromStreamException("Unexpected end of binary data."));
+    }
+  }
+  impl::LoadPayloadFromBinary(payload, destination);
+}
+
+// Loads the object that is the whole of `input`.
+template <typename T>
+inline T LoadFromBinary(std::string_view input) {
+  T result;
+  if (LoadFromBinary(input, result) != input.size()) {
+    CURRENT_THROW(BinaryLoadFromStreamException("Extra bytes after a binary-serialized object."));
+  }
+  return result;
+}
+
+template <typename T>
+inline T LoadFromBinary(std::istream& is) {
+  T result;
+  LoadFromBinary(is, result);
+  return result;
+}
+
+}  // namespace binary
+}  // namespace serialization
+
+// Keep top-level symbols both in `current::` and in global namespace.
+using serialization::binary::LoadFromBinary;
+using serialization::binary::SaveIntoBinary;
+}  // namespace current
+
+using current::LoadFromBinary;
+using current::SaveIntoBinary;
+
+#endif  // CURRENT_TYPE_SYSTEM_SERIALIZATION_BINARY_BINARY_H
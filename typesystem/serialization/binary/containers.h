@@ -0,0 +1,222 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Maxim Zhurovich <zhurovich@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+#ifndef CURRENT_TYPE_SYSTEM_SERIALIZATION_BINARY_CONTAINERS_H
+#define CURRENT_TYPE_SYSTEM_SERIALIZATION_BINARY_CONTAINERS_H
+
+#include <array>
+#include <map>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "binary.h"
+
+namespace current {
+namespace serialization {
+
+namespace binary {
+
+template <typename CONTAINER>
+inline void SerializeBinaryElements(BinarySerializer& serializer, const CONTAINER& container) {
+  serializer.WriteVarint(container.size());
+  for (const auto& element : container) {
+    Serialize(serializer, element);
+  }
+}
+
+// For maps and sets, the elements are deserialized one by one, and then moved into the container.
+template <typename ELEMENT, typename CONTAINER>
+inline void DeserializeBinaryElementsIntoAssociativeContainer(BinaryDeserializer& deserializer,
+                                                              CONTAINER& destination) {
+  destination.clear();
+  const size_t size = deserializer.ReadSize();
+  for (size_t i = 0u; i < size; ++i) {
+    ELEMENT element;
+    Deserialize(deserializer, element);
+    destination.insert(std::move(element));
+  }
+}
+
+template <class TUPLE, size_t I, size_t N>
+struct BinaryTupleImpl {
+  static void DoSerialize(BinarySerializer& serializer, const TUPLE& value) {
+    Serialize(serializer, std::get<I>(value));
+    BinaryTupleImpl<TUPLE, I + 1u, N>::DoSerialize(serializer, value);
+  }
+  static void DoDeserialize(BinaryDeserializer& deserializer, TUPLE& destination) {
+    Deserialize(deserializer, std::get<I>(destination));
+    BinaryTupleImpl<TUPLE, I + 1u, N>::DoDeserialize(deserializer, destination);
+  }
+};
+
+template <class TUPLE, size_t N>
+struct BinaryTupleImpl<TUPLE, N, N> {
+  static void DoSerialize(BinarySerializer&, const TUPLE&) {}
+  static void DoDeserialize(BinaryDeserializer&, TUPLE&) {}
+};
+
+}  // namespace binary
+
+template <typename T, typename TA>
+struct SerializeImpl<binary::BinarySerializer, std::vector<T, TA>> {
+  static void DoSerialize(binary::BinarySerializer& serializer, const std::vector<T, TA>& value) {
+    serializer.WriteVarint(value.size());
+    for (const auto& element : value) {
+      Serialize(serializer, static_cast<const T&>(element));
+    }
+  }
+};
+
+template <typename T, typename TA>
+struct DeserializeImpl<binary::BinaryDeserializer, std::vector<T, TA>> {
+  static void DoDeserialize(binary::BinaryDeserializer& deserializer, std::vector<T, TA>& destination) {
+    const size_t size = deserializer.ReadSize();
+    destination.clear();
+    destination.reserve(deserializer.ReserveSize(size));
+    for (size_t i = 0u; i < size; ++i) {
+      T element;
+      Deserialize(deserializer, element);
+      destination.push_back(std::move(element));
+    }
+  }
+};
+
+// `std::array`-s are of fixed size, so no size is stored for them.
+template <typename T, size_t N>
+struct SerializeImpl<binary::BinarySerializer, std::array<T, N>> {
+  static void DoSerialize(binary::BinarySerializer& serializer, const std::array<T, N>& value) {
+    for (const T& element : value) {
+      Serialize(serializer, element);
+    }
+  }
+};
+
+template <typename T, size_t N>
+struct DeserializeImpl<binary::BinaryDeserializer, std::array<T, N>> {
+  static void DoDeserialize(binary::BinaryDeserializer& deserializer, std::array<T, N>& destination) {
+    for (T& element : destination) {
+      Deserialize(deserializer, element);
+    }
+  }
+};
+
+template <typename TF, typename TS>
+struct SerializeImpl<binary::BinarySerializer, std::pair<TF, TS>> {
+  static void DoSerialize(binary::BinarySerializer& serializer, const std::pair<TF, TS>& value) {
+    Serialize(serializer, value.first);
+    Serialize(serializer, value.second);
+  }
+};
+
+template <typename TF, typename TS>
+struct DeserializeImpl<binary::BinaryDeserializer, std::pair<TF, TS>> {
+  static void DoDeserialize(binary::BinaryDeserializer& deserializer, std::pair<TF, TS>& destination) {
+    Deserialize(deserializer, destination.first);
+    Deserialize(deserializer, destination.second);
+  }
+};
+
+template <typename... TS>
+struct SerializeImpl<binary::BinarySerializer, std::tuple<TS...>> {
+  static void DoSerialize(binary::BinarySerializer& serializer, const std::tuple<TS...>& value) {
+    binary::BinaryTupleImpl<std::tuple<TS...>, 0u, sizeof...(TS)>::DoSerialize(serializer, value);
+  }
+};
+
+template <typename... TS>
+struct DeserializeImpl<binary::BinaryDeserializer, std::tuple<TS...>> {
+  static void DoDeserialize(binary::BinaryDeserializer& deserializer, std::tuple<TS...>& destination) {
+    binary::BinaryTupleImpl<std::tuple<TS...>, 0u, sizeof...(TS)>::DoDeserialize(deserializer, destination);
+  }
+};
+
+template <typename TK, typename TV, typename TC, typename TA>
+struct SerializeImpl<binary::BinarySerializer, std::map<TK, TV, TC, TA>> {
+  static void DoSerialize(binary::BinarySerializer& serializer, const std::map<TK, TV, TC, TA>& value) {
+    binary::SerializeBinaryElements(serializer, value);
+  }
+};
+
+template <typename TK, typename TV, typename TC, typename TA>
+struct DeserializeImpl<binary::BinaryDeserializer, std::map<TK, TV, TC, TA>> {
+  static void DoDeserialize(binary::BinaryDeserializer& deserializer, std::map<TK, TV, TC, TA>& destination) {
+    binary::DeserializeBinaryElementsIntoAssociativeContainer<std::pair<TK, TV>>(deserializer, destination);
+  }
+};
+
+template <typename TK, typename TV, class HASH, class EQ, class ALLOCATOR>
+struct SerializeImpl<binary::BinarySerializer, std::unordered_map<TK, TV, HASH, EQ, ALLOCATOR>> {
+  static void DoSerialize(binary::BinarySerializer& serializer,
+                          const std::unordered_map<TK, TV, HASH, EQ, ALLOCATOR>& value) {
+    binary::SerializeBinaryElements(serializer, value);
+  }
+};
+
+template <typename TK, typename TV, class HASH, class EQ, class ALLOCATOR>
+struct DeserializeImpl<binary::BinaryDeserializer, std::unordered_map<TK, TV, HASH, EQ, ALLOCATOR>> {
+  static void DoDeserialize(binary::BinaryDeserializer& deserializer,
+                            std::unordered_map<TK, TV, HASH, EQ, ALLOCATOR>& destination) {
+    binary::DeserializeBinaryElementsIntoAssociativeContainer<std::pair<TK, TV>>(deserializer, destination);
+  }
+};
+
+template <typename T, typename TC, typename TA>
+struct SerializeImpl<binary::BinarySerializer, std::set<T, TC, TA>> {
+  static void DoSerialize(binary::BinarySerializer& serializer, const std::set<T, TC, TA>& value) {
+    binary::SerializeBinaryElements(serializer, value);
+  }
+};
+
+template <typename T, typename TC, typename TA>
+struct DeserializeImpl<binary::BinaryDeserializer, std::set<T, TC, TA>> {
+  static void DoDeserialize(binary::BinaryDeserializer& deserializer, std::set<T, TC, TA>& destination) {
+    binary::DeserializeBinaryElementsIntoAssociativeContainer<T>(deserializer, destination);
+  }
+};
+
+template <typename T, class HASH, class EQ, class ALLOCATOR>
+struct SerializeImpl<binary::BinarySerializer, std::unordered_set<T, HASH, EQ, ALLOCATOR>> {
+  static void DoSerialize(binary::BinarySerializer& serializer,
+                          const std::unordered_set<T, HASH, EQ, ALLOCATOR>& value) {
+    binary::SerializeBinaryElements(serializer, value);
+  }
+};
+
+template <typename T, class HASH, class EQ, class ALLOCATOR>
+struct DeserializeImpl<binary::BinaryDeserializer, std::unordered_set<T, HASH, EQ, ALLOCATOR>> {
+  static void DoDeserialize(binary::BinaryDeserializer& deserializer,
+                            std::unordered_set<T, HASH, EQ, ALLOCATOR>& destination) {
+    binary::DeserializeBinaryElementsIntoAssociativeContainer<T>(deserializer, destination);
+  }
+};
+
+}  // namespace serialization
+}  // namespace current
+
+#endif  // CURRENT_TYPE_SYSTEM_SERIALIZATION_BINARY_CONTAINERS_H
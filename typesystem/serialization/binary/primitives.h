@@ -0,0 +1,189 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Maxim Zhurovich <zhurovich@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+#ifndef CURRENT_TYPE_SYSTEM_SERIALIZATION_BINARY_PRIMITIVES_H
+#define CURRENT_TYPE_SYSTEM_SERIALIZATION_BINARY_PRIMITIVES_H
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include "binary.h"
+
+namespace current {
+namespace serialization {
+
+// `bool`, `char`, `uint8_t`, and `int8_t` are single bytes.
+template <typename T>
+struct SerializeImpl<binary::BinarySerializer, T, std::enable_if_t<std::is_integral_v<T> && sizeof(T) == 1u>> {
+  static void DoSerialize(binary::BinarySerializer& serializer, T value) {
+    serializer.WriteByte(static_cast<uint8_t>(value));
+  }
+};
+
+template <typename T>
+struct DeserializeImpl<binary::BinaryDeserializer, T, std::enable_if_t<std::is_integral_v<T> && sizeof(T) == 1u>> {
+  static void DoDeserialize(binary::BinaryDeserializer& deserializer, T& destination) {
+    destination = static_cast<T>(deserializer.ReadByte());
+  }
+};
+
+// `uint*_t`.
+template <typename T>
+struct SerializeImpl<binary::BinarySerializer,
+                     T,
+                     std::enable_if_t<std::is_integral_v<T> && !std::is_signed_v<T> && (sizeof(T) > 1u)>> {
+  static void DoSerialize(binary::BinarySerializer& serializer, T value) {
+    serializer.WriteVarint(static_cast<uint64_t>(value));
+  }
+};
+
+template <typename T>
+struct DeserializeImpl<binary::BinaryDeserializer,
+                       T,
+                       std::enable_if_t<std::is_integral_v<T> && !std::is_signed_v<T> && (sizeof(T) > 1u)>> {
+  static void DoDeserialize(binary::BinaryDeserializer& deserializer, T& destination) {
+    const uint64_t value = deserializer.ReadVarint();
+    if (value > static_cast<uint64_t>(std::numeric_limits<T>::max())) {
+      CURRENT_THROW(BinaryLoadFromStreamException("Unsigned integer out of range in binary data."));
+    }
+    destination = static_cast<T>(value);
+  }
+};
+
+// `int*_t`.
+template <typename T>
+struct SerializeImpl<binary::BinarySerializer,
+                     T,
+                     std::enable_if_t<std::is_integral_v<T> && std::is_signed_v<T> && (sizeof(T) > 1u)>> {
+  static void DoSerialize(binary::BinarySerializer& serializer, T value) {
+    serializer.WriteSignedVarint(static_cast<int64_t>(value));
+  }
+};
+
+template <typename T>
+struct DeserializeImpl<binary::BinaryDeserializer,
+                       T,
+                       std::enable_if_t<std::is_integral_v<T> && std::is_signed_v<T> && (sizeof(T) > 1u)>> {
+  static void DoDeserialize(binary::BinaryDeserializer& deserializer, T& destination) {
+    const int64_t value = deserializer.ReadSignedVarint();
+    if (value < static_cast<int64_t>(std::numeric_limits<T>::min()) ||
+        value > static_cast<int64_t>(std::numeric_limits<T>::max())) {
+      CURRENT_THROW(BinaryLoadFromStreamException("Signed integer out of range in binary data."));
+    }
+    destination = static_cast<T>(value);
+  }
+};
+
+template <>
+struct SerializeImpl<binary::BinarySerializer, float> {
+  static void DoSerialize(binary::BinarySerializer& serializer, float value) {
+    static_assert(sizeof(float) == sizeof(uint32_t), "");
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    serializer.WriteFixed32(bits);
+  }
+};
+
+template <>
+struct DeserializeImpl<binary::BinaryDeserializer, float> {
+  static void DoDeserialize(binary::BinaryDeserializer& deserializer, float& destination) {
+    const uint32_t bits = deserializer.ReadFixed32();
+    std::memcpy(&destination, &bits, sizeof(bits));
+  }
+};
+
+template <>
+struct SerializeImpl<binary::BinarySerializer, double> {
+  static void DoSerialize(binary::BinarySerializer& serializer, double value) {
+    static_assert(sizeof(double) == sizeof(uint64_t), "");
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    serializer.WriteFixed64(bits);
+  }
+};
+
+template <>
+struct DeserializeImpl<binary::BinaryDeserializer, double> {
+  static void DoDeserialize(binary::BinaryDeserializer& deserializer, double& destination) {
+    const uint64_t bits = deserializer.ReadFixed64();
+    std::memcpy(&destination, &bits, sizeof(bits));
+  }
+};
+
+template <>
+struct SerializeImpl<binary::BinarySerializer, std::string> {
+  static void DoSerialize(binary::BinarySerializer& serializer, const std::string& value) {
+    serializer.WriteVarint(value.length());
+    serializer.WriteBytes(value.data(), value.length());
+  }
+};
+
+template <>
+struct DeserializeImpl<binary::BinaryDeserializer, std::string> {
+  static void DoDeserialize(binary::BinaryDeserializer& deserializer, std::string& destination) {
+    const size_t length = deserializer.ReadSize();
+    destination.assign(deserializer.ReadBytes(length), length);
+  }
+};
+
+// `std::chrono::microseconds` and `std::chrono::milliseconds`.
+template <typename R, typename P>
+struct SerializeImpl<binary::BinarySerializer, std::chrono::duration<R, P>> {
+  static void DoSerialize(binary::BinarySerializer& serializer, std::chrono::duration<R, P> value) {
+    Serialize(serializer, value.count());
+  }
+};
+
+template <typename R, typename P>
+struct DeserializeImpl<binary::BinaryDeserializer, std::chrono::duration<R, P>> {
+  static void DoDeserialize(binary::BinaryDeserializer& deserializer, std::chrono::duration<R, P>& destination) {
+    R count;
+    Deserialize(deserializer, count);
+    destination = std::chrono::duration<R, P>(count);
+  }
+};
+
+template <typename T>
+struct SerializeImpl<binary::BinarySerializer, T, std::enable_if_t<std::is_enum_v<T>>> {
+  static void DoSerialize(binary::BinarySerializer& serializer, T value) {
+    Serialize(serializer, static_cast<std::underlying_type_t<T>>(value));
+  }
+};
+
+template <typename T>
+struct DeserializeImpl<binary::BinaryDeserializer, T, std::enable_if_t<std::is_enum_v<T>>> {
+  static void DoDeserialize(binary::BinaryDeserializer& deserializer, T& destination) {
+    std::underlying_type_t<T> value;
+    Deserialize(deserializer, value);
+    destination = static_cast<T>(value);
+  }
+};
+
+}  // namespace serialization
+}  // namespace current
+
+#endif  // CURRENT_TYPE_SYSTEM_SERIALIZATION_BINARY_PRIMITIVES_H
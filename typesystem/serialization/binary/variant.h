@@ -0,0 +1,139 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Maxim Zhurovich <zhurovich@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+#ifndef CURRENT_TYPE_SYSTEM_SERIALIZATION_BINARY_VARIANT_H
+#define CURRENT_TYPE_SYSTEM_SERIALIZATION_BINARY_VARIANT_H
+
+#include <type_traits>
+#include <vector>
+
+#include "binary.h"
+
+#include "../../variant.h"
+
+#include "../../../bricks/strings/util.h"
+#include "../../../bricks/template/call_all_constructors.h"
+
+namespace current {
+namespace serialization {
+
+namespace binary {
+
+// The one-based index of `X` in the typelist of a `Variant`, as zero is reserved for an uninitialized one.
+template <typename X, typename TYPELIST>
+struct BinaryVariantCaseIndex;
+
+template <typename X, typename... TS>
+struct BinaryVariantCaseIndex<X, TypeListImpl<X, TS...>> {
+  constexpr static uint64_t value = 1u;
+};
+
+template <typename X, typename T, typename... TS>
+struct BinaryVariantCaseIndex<X, TypeListImpl<T, TS...>> {
+  constexpr static uint64_t value = 1u + BinaryVariantCaseIndex<X, TypeListImpl<TS...>>::value;
+};
+
+template <typename VARIANT>
+class BinaryVariantSerializer {
+ public:
+  explicit BinaryVariantSerializer(BinarySerializer& serializer) : serializer_(serializer) {}
+
+  template <typename X>
+  void operator()(const X& object) {
+    serializer_.WriteVarint(BinaryVariantCaseIndex<X, typename VARIANT::typelist_t>::value);
+    Serialize(serializer_, object);
+  }
+
+ private:
+  BinarySerializer& serializer_;
+};
+
+template <typename VARIANT>
+class BinaryVariantDeserializer {
+ public:
+  using case_deserializer_t = void (*)(BinaryDeserializer&, VARIANT&);
+  using case_deserializers_t = std::vector<case_deserializer_t>;
+
+  template <typename X>
+  struct Registerer {
+    Registerer(case_deserializers_t& deserializers) { deserializers.push_back(&DeserializeCase<X>); }
+  };
+
+  // The typelist is walked in order, so the deserializer of the case with index `i` goes into `deserializers_[i - 1]`.
+  BinaryVariantDeserializer() {
+    current::metaprogramming::
+        call_all_constructors_with<Registerer, case_deserializers_t, typename VARIANT::typelist_t>(deserializers_);
+  }
+
+  void DoLoadVariant(BinaryDeserializer& deserializer, VARIANT& destination) const {
+    const uint64_t index = deserializer.ReadVarint();
+    if (!index) {
+      destination = nullptr;
+    } else if (index <= deserializers_.size()) {
+      deserializers_[index - 1u](deserializer, destination);
+    } else {
+      CURRENT_THROW(BinaryLoadFromStreamException("Unknown `Variant` case " + current::ToString(index) + "."));
+    }
+  }
+
+  static const BinaryVariantDeserializer& Instance() {
+    static BinaryVariantDeserializer impl;
+    return impl;
+  }
+
+ private:
+  template <typename X>
+  static void DeserializeCase(BinaryDeserializer& deserializer, VARIANT& destination) {
+    Deserialize(deserializer, destination.template Construct<X>());
+  }
+
+  case_deserializers_t deserializers_;
+};
+
+}  // namespace binary
+
+template <typename T>
+struct SerializeImpl<binary::BinarySerializer, T, std::enable_if_t<IS_CURRENT_VARIANT(T)>> {
+  static void DoSerialize(binary::BinarySerializer& serializer, const T& value) {
+    if (Exists(value)) {
+      binary::BinaryVariantSerializer<T> impl(serializer);
+      value.Call(impl);
+    } else {
+      serializer.WriteVarint(0u);
+    }
+  }
+};
+
+template <typename T>
+struct DeserializeImpl<binary::BinaryDeserializer, T, std::enable_if_t<IS_CURRENT_VARIANT(T)>> {
+  static void DoDeserialize(binary::BinaryDeserializer& deserializer, T& value) {
+    binary::BinaryVariantDeserializer<T>::Instance().DoLoadVariant(deserializer, value);
+  }
+};
+
+}  // namespace serialization
+}  // namespace current
+
+#endif  // CURRENT_TYPE_SYSTEM_SERIALIZATION_BINARY_VARIANT_H
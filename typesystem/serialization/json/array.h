@@ -44,6 +44,17 @@ struct SerializeImpl<json::JSONStringifier<JSON_FORMAT>, std::array<T, N>> {
   }
 };
 
+template <class JSON_FORMAT, class STREAM, typename T, size_t N>
+struct SerializeImpl<json::JSONWriter<JSON_FORMAT, STREAM>, std::array<T, N>> {
+  static void DoSerialize(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer, const std::array<T, N>& value) {
+    json_writer.StartArray();
+    for (const auto& element : value) {
+      json_writer.Inner(element);
+    }
+    json_writer.EndArray();
+  }
+};
+
 template <class JSON_FORMAT, typename T, size_t N>
 struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, std::array<T, N>> {
   static void DoDeserialize(json::JSONParser<JSON_FORMAT>& json_parser, std::array<T, N>& destination) {
@@ -57,6 +68,20 @@ struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, std::array<T, N>> {
   }
 };
 
+template <class JSON_FORMAT, typename T, size_t N>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, std::array<T, N>> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, std::array<T, N>& destination) {
+    json_reader.StartArray();
+    for (size_t i = 0; i < N; ++i) {
+      Deserialize(json_reader, destination[i]);
+    }
+    // As with `JSONParser`, the extra elements are ignored.
+    while (!json_reader.EndArray()) {
+      json_reader.SkipValue();
+    }
+  }
+};
+
 namespace json {
 template <typename T, size_t N>
 struct IsJSONSerializable<std::array<T, N>> {
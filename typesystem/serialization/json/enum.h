@@ -40,6 +40,14 @@ struct SerializeImpl<json::JSONStringifier<JSON_FORMAT>, T, std::enable_if_t<std
   }
 };
 
+template <class JSON_FORMAT, class STREAM, typename T>
+struct SerializeImpl<json::JSONWriter<JSON_FORMAT, STREAM>, T, std::enable_if_t<std::is_enum_v<T>>> {
+  static void DoSerialize(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer, const T enum_value) {
+    using underlying_t = typename std::underlying_type<T>::type;
+    json::JSONWriterValueImpl<underlying_t>::WriteValue(json_writer, static_cast<underlying_t>(enum_value));
+  }
+};
+
 template <class JSON_FORMAT, typename T>
 struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, T, std::enable_if_t<std::is_enum_v<T>>> {
   static void DoDeserialize(json::JSONParser<JSON_FORMAT>& json_parser, T& destination) {
@@ -63,6 +71,24 @@ struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, T, std::enable_if_t<std::i
   }
 };
 
+template <class JSON_FORMAT, typename T>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, T, std::enable_if_t<std::is_enum_v<T>>> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, T& destination) {
+    if (std::numeric_limits<typename std::underlying_type<T>::type>::is_signed) {
+      if (!json_reader.IsInt64()) {
+        json_reader.Mismatch();
+      }
+      destination = static_cast<T>(json_reader.Int64Value());
+    } else {
+      if (!json_reader.IsUint64()) {
+        json_reader.Mismatch();
+      }
+      destination = static_cast<T>(json_reader.Uint64Value());
+    }
+    json_reader.Next();
+  }
+};
+
 }  // namespace serialization
 }  // namespace current
 
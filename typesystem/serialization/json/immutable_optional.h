@@ -86,6 +86,48 @@ struct SerializeImpl<json::JSONStringifier<json::JSONFormat::NewtonsoftFSharp>,
   }
 };
 
+template <class JSON_FORMAT, class STREAM, typename T>
+struct SerializeImpl<json::JSONWriter<JSON_FORMAT, STREAM>, ImmutableOptional<T>> {
+  static void DoSerialize(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer, const ImmutableOptional<T>& value) {
+    if (Exists(value)) {
+      Serialize(json_writer, Value(value));
+    } else {
+      json_writer.Null();
+    }
+  }
+};
+
+template <class STREAM, typename T>
+struct SerializeImpl<json::JSONWriter<json::JSONFormat::Minimalistic, STREAM>, ImmutableOptional<T>> {
+  static void DoSerialize(json::JSONWriter<json::JSONFormat::Minimalistic, STREAM>& json_writer,
+                          const ImmutableOptional<T>& value) {
+    if (Exists(value)) {
+      Serialize(json_writer, Value(value));
+    } else {
+      json_writer.MarkAsAbsentValue();
+    }
+  }
+};
+
+template <class STREAM, typename T>
+struct SerializeImpl<json::JSONWriter<json::JSONFormat::NewtonsoftFSharp, STREAM>, ImmutableOptional<T>> {
+  static void DoSerialize(json::JSONWriter<json::JSONFormat::NewtonsoftFSharp, STREAM>& json_writer,
+                          const ImmutableOptional<T>& value) {
+    if (Exists(value)) {
+      json_writer.StartObject();
+      json_writer.Key("Case");
+      json_writer.String("Some", 4u);
+      json_writer.Key("Fields");
+      json_writer.StartArray();
+      json_writer.Inner(Value(value));
+      json_writer.EndArray();
+      json_writer.EndObject();
+    } else {
+      json_writer.MarkAsAbsentValue();
+    }
+  }
+};
+
 template <class JSON_FORMAT, typename T>
 struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, ImmutableOptional<T>> {
   static void DoDeserialize(json::JSONParser<JSON_FORMAT>& json_parser, ImmutableOptional<T>& destination) {
@@ -105,6 +147,29 @@ struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, ImmutableOptional<T>> {
   }
 };
 
+template <class JSON_FORMAT, typename T>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, ImmutableOptional<T>> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, ImmutableOptional<T>& destination) {
+    if (!json_reader.IsNull()) {
+      destination = T();
+      Deserialize(json_reader, Value(destination));
+    } else {
+      destination = nullptr;
+      json_reader.Next();
+    }
+  }
+};
+
+namespace json {
+template <class JSON_FORMAT, typename T>
+struct JSONReaderMissingField<JSON_FORMAT, ImmutableOptional<T>> {
+  static bool Handle(ImmutableOptional<T>& destination) {
+    destination = nullptr;
+    return true;
+  }
+};
+}  // namespace json
+
 template <typename T>
 struct DeserializeImpl<json::JSONParser<JSONFormat::NewtonsoftFSharp>, ImmutableOptional<T>> {
   static void DoDeserialize(json::JSONParser<JSONFormat::NewtonsoftFSharp>& json_parser,
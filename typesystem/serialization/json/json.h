@@ -26,6 +26,10 @@ SOFTWARE.
 #ifndef CURRENT_TYPE_SYSTEM_SERIALIZATION_JSON_JSON_H
 #define CURRENT_TYPE_SYSTEM_SERIALIZATION_JSON_JSON_H
 
+#include <cstring>
+#include <string>
+#include <string_view>
+
 #include "exceptions.h"
 #include "rapidjson.h"
 
@@ -36,6 +40,7 @@ SOFTWARE.
 #include "../../helpers.h"
 
 #include "../../../bricks/strings/chunk.h"
+#include "../../../bricks/strings/scan.h"
 #include "../../../bricks/template/pod.h"  // `current::copy_free`.
 
 namespace current {
@@ -174,11 +179,107 @@ class JSONStringifier final {
     return string_buffer.GetString();
   }
 
+  // Writes the resulting JSON into `stream`, a RapidJSON output stream, as it is being generated.
+  template <class STREAM>
+  void WriteResultingJSON(STREAM& stream) const {
+    rapidjson::Writer<STREAM> writer(stream);
+    document_.Accept(writer);
+  }
+
  private:
   rapidjson::Value* current_;
   rapidjson::Document document_;
 };
 
+// Writes the JSON straight into `STREAM`, a RapidJSON output stream, token by token, with no DOM built in between.
+// The resulting JSON is byte-for-byte the one `JSONStringifier` would produce, in every `JSONFormat`.
+// To skip the absent values of the `struct` fields, the key of a field is only written out with the first token
+// of its value, if there is one.
+template <class JSON_FORMAT, class STREAM = rapidjson::StringBuffer>
+class JSONWriter final {
+ public:
+  explicit JSONWriter(STREAM& stream) : writer_(stream) {}
+
+  void Null() {
+    WritePendingKey();
+    writer_.Null();
+  }
+  void Bool(bool value) {
+    WritePendingKey();
+    writer_.Bool(value);
+  }
+  void Int64(int64_t value) {
+    WritePendingKey();
+    writer_.Int64(value);
+  }
+  void Uint64(uint64_t value) {
+    WritePendingKey();
+    writer_.Uint64(value);
+  }
+  void Double(double value) {
+    WritePendingKey();
+    writer_.Double(value);
+  }
+  void String(const char* value, size_t length) {
+    WritePendingKey();
+    writer_.String(value, static_cast<rapidjson::SizeType>(length));
+  }
+  void String(const std::string& value) { String(value.data(), value.length()); }
+  void StartObject() {
+    WritePendingKey();
+    writer_.StartObject();
+  }
+  void Key(const char* key) { writer_.Key(key); }
+  void Key(const std::string& key) { writer_.Key(key.data(), static_cast<rapidjson::SizeType>(key.length())); }
+  void EndObject() { writer_.EndObject(); }
+  void StartArray() {
+    WritePendingKey();
+    writer_.StartArray();
+  }
+  void EndArray() { writer_.EndArray(); }
+
+  // Serialize another object, as a value. The absent value, if the object ends up one, is written as `null`.
+  template <typename T>
+  void Inner(T&& x) {
+    Serialize(*this, std::forward<T>(x));
+    if (absent_) {
+      absent_ = false;
+      Null();
+    }
+  }
+
+  // Serialize another object, as the value of the field `name`, omitting the field if the value is absent.
+  // Example: A `Variant` or `Optional` in the `Minimalistic` format.
+  void MarkAsAbsentValue() { absent_ = true; }
+  template <typename T>
+  void Field(const char* name, T&& x) {
+    pending_key_ = name;
+    Serialize(*this, std::forward<T>(x));
+    absent_ = false;
+    pending_key_ = nullptr;
+  }
+
+  // Completes the JSON, which, as with `JSONStringifier`, is `null` if the top-level value is absent.
+  void Finish() {
+    if (absent_) {
+      absent_ = false;
+      Null();
+    }
+  }
+
+ private:
+  void WritePendingKey() {
+    if (pending_key_) {
+      writer_.Key(pending_key_);
+      pending_key_ = nullptr;
+    }
+  }
+
+  rapidjson::Writer<STREAM> writer_;
+  const char* pending_key_ = nullptr;
+  bool absent_ = false;
+};
+
 enum class JSONVariantStyle : int { Current, Simple, NewtonsoftFSharp };
 
 template <JSONVariantStyle>
@@ -323,17 +424,387 @@ class JSONParser final {
   rapidjson::Document document_;
 };
 
+// Thrown by `JSONReader` whenever the input is not what it expects: from invalid JSON to a schema mismatch.
+// Not an `Exception` on purpose: `ParseJSON` catches it, and re-parses the input via `JSONParser`, which then
+// reports the error exactly as it always has.
+struct JSONReaderMismatch final {};
+
+enum class JSONReaderToken : int {
+  None,
+  Null,
+  Bool,
+  Number,
+  String,
+  StartObject,
+  Key,
+  EndObject,
+  StartArray,
+  EndArray
+};
+
+// Tokenizes the JSON for the `DeserializeImpl`-s to populate the objects straight away, with no DOM built in between.
+// Each `DeserializeImpl` is invoked with the first token of its value being the current one, and returns with
+// the token following its value being the current one. The patch mode, `JSONPatcher<>`, is not supported.
+//
+// The structure of the JSON, the literals, the strings with no escape sequences, and the short integers are taken
+// care of here, and the strings are then the views into the input. The rest of the strings and numbers are parsed
+// by RapidJSON, one by one, so that their values, as well as the `IsInt64()` / `IsUint64()` semantics of the numbers,
+// are exactly those of `rapidjson::Value`. Any input RapidJSON would reject is rejected too, while the valid
+// inputs that are not handled here, if there are any, are rejected as well, to be parsed by `JSONParser` instead.
+template <class JSON_FORMAT>
+class JSONReader final {
+ public:
+  explicit JSONReader(const char* json) : p_(json), handler_(*this) { Next(); }
+
+  JSONReaderToken CurrentToken() const { return token_; }
+
+  bool IsNull() const { return token_ == JSONReaderToken::Null; }
+  bool IsBool() const { return token_ == JSONReaderToken::Bool; }
+  bool IsNumber() const { return token_ == JSONReaderToken::Number; }
+  bool IsInt64() const { return token_ == JSONReaderToken::Number && is_int64_; }
+  bool IsUint64() const { return token_ == JSONReaderToken::Number && is_uint64_; }
+  bool IsString() const { return token_ == JSONReaderToken::String; }
+
+  bool BoolValue() const { return bool_; }
+  int64_t Int64Value() const { return int64_; }
+  uint64_t Uint64Value() const { return uint64_; }
+  double DoubleValue() const { return double_; }
+  // The value of the current `String` or `Key` token, valid until `Next()` is called.
+  // Points either into the input or into `unescaped_`, and is followed by a '"' or by a '\0' respectively.
+  std::string_view StringValue() const { return string_; }
+
+  void Next() {
+    SkipWhitespace();
+    switch (state_) {
+      case State::Value:
+        NextValue();
+        break;
+      case State::ValueOrEnd:
+        if (*p_ == ']') {
+          EndContainer();
+        } else {
+          NextValue();
+        }
+        break;
+      case State::KeyOrEnd:
+        if (*p_ == '}') {
+          EndContainer();
+        } else {
+          NextKey();
+        }
+        break;
+      case State::CommaOrEnd:
+        if (*p_ == ',') {
+          ++p_;
+          SkipWhitespace();
+          if (nesting_.back() == '{') {
+            NextKey();
+          } else {
+            NextValue();
+          }
+        } else if (*p_ == (nesting_.back() == '{' ? '}' : ']')) {
+          EndContainer();
+        } else {
+          Mismatch();
+        }
+        break;
+      case State::Done:
+        token_ = JSONReaderToken::None;
+        break;
+    }
+  }
+
+  // Whether the whole input has been consumed.
+  bool Done() const { return state_ == State::Done && token_ == JSONReaderToken::None; }
+
+  void Mismatch() const { throw JSONReaderMismatch(); }
+
+  void ExpectToken(JSONReaderToken token) const {
+    if (token_ != token) {
+      Mismatch();
+    }
+  }
+
+  // The `{ ... }` and `[ ... ]` loops: `StartObject(); while (!EndObject()) { key; value; }`.
+  void StartObject() {
+    ExpectToken(JSONReaderToken::StartObject);
+    Next();
+  }
+  bool EndObject() {
+    if (token_ == JSONReaderToken::EndObject) {
+      Next();
+      return true;
+    } else {
+      ExpectToken(JSONReaderToken::Key);
+      return false;
+    }
+  }
+  void StartArray() {
+    ExpectToken(JSONReaderToken::StartArray);
+    Next();
+  }
+  bool EndArray() {
+    if (token_ == JSONReaderToken::EndArray) {
+      Next();
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  // Skips the value the current token starts, nested objects and arrays included.
+  void SkipValue() {
+    size_t depth = 0u;
+    do {
+      if (token_ == JSONReaderToken::StartObject || token_ == JSONReaderToken::StartArray) {
+        ++depth;
+      } else if (token_ == JSONReaderToken::EndObject || token_ == JSONReaderToken::EndArray) {
+        if (!depth) {
+          Mismatch();
+        }
+        --depth;
+      } else if (token_ == JSONReaderToken::None || (token_ == JSONReaderToken::Key && !depth)) {
+        Mismatch();
+      }
+      Next();
+    } while (depth);
+  }
+
+ private:
+  JSONReader(const JSONReader&) = delete;
+  JSONReader& operator=(const JSONReader&) = delete;
+
+  // What comes next: the value, the key, or the comma, possibly substituted by the end of the object or array.
+  enum class State : int { Value, ValueOrEnd, KeyOrEnd, CommaOrEnd, Done };
+
+  void SkipWhitespace() {
+    while (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t') {
+      ++p_;
+    }
+  }
+
+  void NextValue() {
+    const char c = *p_;
+    if (c == '{' || c == '[') {
+      ++p_;
+      nesting_.push_back(c);
+      token_ = (c == '{') ? JSONReaderToken::StartObject : JSONReaderToken::StartArray;
+      state_ = (c == '{') ? State::KeyOrEnd : State::ValueOrEnd;
+      return;
+    } else if (c == '"') {
+      ParseString();
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+      ParseNumber();
+    } else if (c == 't' && !std::strncmp(p_, "true", 4u)) {
+      p_ += 4u;
+      bool_ = true;
+      token_ = JSONReaderToken::Bool;
+    } else if (c == 'f' && !std::strncmp(p_, "false", 5u)) {
+      p_ += 5u;
+      bool_ = false;
+      token_ = JSONReaderToken::Bool;
+    } else if (c == 'n' && !std::strncmp(p_, "null", 4u)) {
+      p_ += 4u;
+      token_ = JSONReaderToken::Null;
+    } else {
+      Mismatch();
+    }
+    AfterValue();
+  }
+
+  void NextKey() {
+    if (*p_ != '"') {
+      Mismatch();
+    }
+    ParseString();
+    SkipWhitespace();
+    if (*p_ != ':') {
+      Mismatch();
+    }
+    ++p_;
+    token_ = JSONReaderToken::Key;
+    state_ = State::Value;
+  }
+
+  void EndContainer() {
+    ++p_;
+    token_ = (nesting_.back() == '{') ? JSONReaderToken::EndObject : JSONReaderToken::EndArray;
+    nesting_.pop_back();
+    AfterValue();
+  }
+
+  void AfterValue() {
+    if (!nesting_.empty()) {
+      state_ = State::CommaOrEnd;
+    } else {
+      SkipWhitespace();
+      if (*p_) {
+        Mismatch();
+      }
+      state_ = State::Done;
+    }
+  }
+
+  void ParseString() {
+    const char* begin = p_ + 1;
+    const char* end = current::strings::impl::FindJSONStringSpecial(begin);
+    if (*end == '"') {
+      string_ = std::string_view(begin, static_cast<size_t>(end - begin));
+      token_ = JSONReaderToken::String;
+      p_ = end + 1;
+    } else {
+      ParseViaRapidJSON();
+    }
+  }
+
+  void ParseNumber() {
+    const char* end = p_ + (*p_ == '-');
+    uint64_t value = 0u;
+    if (*end == '0') {
+      ++end;
+    } else {
+      // Up to 18 digits, for the value to fit into an `int64_t` whatever its sign.
+      const char* const limit = end + 18;
+      while (end < limit && *end >= '0' && *end <= '9') {
+        value = value * 10u + static_cast<uint64_t>(*end - '0');
+        ++end;
+      }
+    }
+    if ((*end >= '0' && *end <= '9') || *end == '.' || *end == 'e' || *end == 'E' || end == p_ + (*p_ == '-')) {
+      ParseViaRapidJSON();
+    } else {
+      if (*p_ == '-') {
+        handler_.Int64(-static_cast<int64_t>(value));
+      } else {
+        handler_.Uint64(value);
+      }
+      p_ = end;
+    }
+  }
+
+  // Parses the string or the number starting at `p_` as a standalone JSON value, to stay true to RapidJSON.
+  void ParseViaRapidJSON() {
+    rapidjson::StringStream stream(p_);
+    if (reader_.Parse<rapidjson::kParseStopWhenDoneFlag>(stream, handler_).IsError()) {
+      Mismatch();
+    }
+    p_ += stream.Tell();
+  }
+
+  // The handler of the RapidJSON SAX events, for the above, as well as for the short integers parsed here.
+  class Handler final {
+   public:
+    explicit Handler(JSONReader& self) : self_(self) {}
+
+    bool Null() { return false; }
+    bool Bool(bool) { return false; }
+    bool Int(int value) { return Int64(value); }
+    bool Uint(unsigned value) { return Uint64(value); }
+    bool Int64(int64_t value) {
+      self_.int64_ = value;
+      self_.uint64_ = static_cast<uint64_t>(value);
+      self_.double_ = static_cast<double>(value);
+      self_.is_int64_ = true;
+      self_.is_uint64_ = (value >= 0);
+      return Token(JSONReaderToken::Number);
+    }
+    bool Uint64(uint64_t value) {
+      self_.int64_ = static_cast<int64_t>(value);
+      self_.uint64_ = value;
+      self_.double_ = static_cast<double>(value);
+      self_.is_int64_ = (value <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max()));
+      self_.is_uint64_ = true;
+      return Token(JSONReaderToken::Number);
+    }
+    bool Double(double value) {
+      self_.double_ = value;
+      self_.is_int64_ = false;
+      self_.is_uint64_ = false;
+      return Token(JSONReaderToken::Number);
+    }
+    bool RawNumber(const char*, rapidjson::SizeType, bool) { return false; }  // Only with `kParseNumbersAsStrings`.
+    bool String(const char* value, rapidjson::SizeType length, bool) {
+      self_.unescaped_.assign(value, length);
+      self_.string_ = self_.unescaped_;
+      return Token(JSONReaderToken::String);
+    }
+    bool StartObject() { return false; }
+    bool Key(const char*, rapidjson::SizeType, bool) { return false; }
+    bool EndObject(rapidjson::SizeType) { return false; }
+    bool StartArray() { return false; }
+    bool EndArray(rapidjson::SizeType) { return false; }
+
+   private:
+    bool Token(JSONReaderToken token) {
+      self_.token_ = token;
+      return true;
+    }
+
+    JSONReader& self_;
+  };
+
+  const char* p_;
+  rapidjson::Reader reader_;
+  Handler handler_;
+  State state_ = State::Value;
+  // The '{'-s and '['-s of the objects and arrays the current token is in.
+  std::string nesting_;
+  JSONReaderToken token_ = JSONReaderToken::None;
+  bool bool_ = false;
+  int64_t int64_ = 0;
+  uint64_t uint64_ = 0u;
+  double double_ = 0.0;
+  bool is_int64_ = false;
+  bool is_uint64_ = false;
+  std::string_view string_;
+  std::string unescaped_;
+};
+
+// What `JSONReader` does with the `CURRENT_STRUCT` fields missing from the input. As with `JSONParser`, only
+// the `Optional`-s and the `Simple`-style `Variant`-s can be missing; returns `false` for the other types.
+template <class JSON_FORMAT, typename T, typename ENABLE = void>
+struct JSONReaderMissingField {
+  static bool Handle(T&) { return false; }
+};
+
 template <class J, typename T>
 void ParseJSONViaRapidJSON(const char* json, T& destination) {
   JSONParser<J> json_parser(json);
   Deserialize(json_parser, destination);
 }
 
+// Parses the JSON straight into `destination`, with no DOM built. Returns `false` if the input is not what
+// `JSONReader` expects, for `ParseJSONViaRapidJSON` to do the job instead, and to report the error if there is one.
+// The `NewtonsoftFSharp` format always goes through the DOM.
+template <class J, typename T>
+bool ParseJSONViaReader(const char* json, T& destination) {
+  if constexpr (J::variant_style == JSONVariantStyle::NewtonsoftFSharp) {
+    static_cast<void>(json);
+    static_cast<void>(destination);
+    return false;
+  } else {
+    try {
+      JSONReader<J> json_reader(json);
+      Deserialize(json_reader, destination);
+      return json_reader.Done();
+    } catch (const JSONReaderMismatch&) {
+      return false;
+    }
+  }
+}
+
+template <class J = JSONFormat::Current, typename T, class STREAM>
+inline void WriteJSON(STREAM& stream, const T& source) {
+  JSONWriter<J, STREAM> json_writer(stream);
+  Serialize(json_writer, source);
+  json_writer.Finish();
+}
+
 template <class J = JSONFormat::Current, typename T>
 inline std::string JSON(const T& source) {
-  JSONStringifier<J> json_stringifier;
-  Serialize(json_stringifier, source);
-  return json_stringifier.ResultingJSON();
+  rapidjson::StringBuffer string_buffer;
+  WriteJSON<J>(string_buffer, source);
+  return std::string(string_buffer.GetString(), string_buffer.GetSize());
 }
 
 template <class J = JSONFormat::Current>
@@ -344,7 +815,9 @@ inline std::string JSON(const char* special_case_bare_c_string) {
 template <typename T, class J = JSONFormat::Current>
 inline void ParseJSON(const char* source, T& destination) {
   try {
-    ParseJSONViaRapidJSON<J>(source, destination);
+    if (!ParseJSONViaReader<J>(source, destination)) {
+      ParseJSONViaRapidJSON<J>(source, destination);
+    }
     CheckIntegrity(destination);
   } catch (UninitializedVariant) {
     CURRENT_THROW(JSONUninitializedVariantObjectException());
@@ -66,6 +66,33 @@ struct SerializeImpl<json::JSONStringifier<JSON_FORMAT>, std::map<std::string, T
   }
 };
 
+template <class JSON_FORMAT, class STREAM, typename TK, typename TV, typename TC, typename TA>
+struct SerializeImpl<json::JSONWriter<JSON_FORMAT, STREAM>, std::map<TK, TV, TC, TA>> {
+  static void DoSerialize(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer, const std::map<TK, TV, TC, TA>& value) {
+    json_writer.StartArray();
+    for (const auto& element : value) {
+      json_writer.StartArray();
+      json_writer.Inner(element.first);
+      json_writer.Inner(element.second);
+      json_writer.EndArray();
+    }
+    json_writer.EndArray();
+  }
+};
+
+template <class JSON_FORMAT, class STREAM, typename TV, typename TC, typename TA>
+struct SerializeImpl<json::JSONWriter<JSON_FORMAT, STREAM>, std::map<std::string, TV, TC, TA>> {
+  static void DoSerialize(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer,
+                          const std::map<std::string, TV, TC, TA>& value) {
+    json_writer.StartObject();
+    for (const auto& element : value) {
+      json_writer.Key(element.first);
+      json_writer.Inner(element.second);
+    }
+    json_writer.EndObject();
+  }
+};
+
 template <class JSON_FORMAT, typename TK, typename TV, typename TC, typename TA, class J>
 struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, std::map<TK, TV, TC, TA>, J> {
   template <typename K = TK>
@@ -112,6 +139,37 @@ struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, std::map<TK, TV, TC, TA>,
   }
 };
 
+template <class JSON_FORMAT, typename TK, typename TV, typename TC, typename TA>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, std::map<TK, TV, TC, TA>> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, std::map<TK, TV, TC, TA>& destination) {
+    destination.clear();
+    if constexpr (std::is_same_v<std::string, TK>) {
+      json_reader.StartObject();
+      TK k;
+      TV v;
+      while (!json_reader.EndObject()) {
+        k.assign(json_reader.StringValue().data(), json_reader.StringValue().length());
+        json_reader.Next();
+        Deserialize(json_reader, v);
+        destination.emplace(std::move(k), std::move(v));
+      }
+    } else {
+      json_reader.StartArray();
+      while (!json_reader.EndArray()) {
+        TK k;
+        TV v;
+        json_reader.StartArray();
+        Deserialize(json_reader, k);
+        Deserialize(json_reader, v);
+        if (!json_reader.EndArray()) {
+          json_reader.Mismatch();
+        }
+        destination.emplace(std::move(k), std::move(v));
+      }
+    }
+  }
+};
+
 namespace json {
 template <typename K, typename V, typename CMP, typename ALLOC>
 struct IsJSONSerializable<std::map<K, V, CMP, ALLOC>> {
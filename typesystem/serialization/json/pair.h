@@ -60,6 +60,29 @@ struct SerializeImpl<json::JSONStringifier<json::JSONFormat::NewtonsoftFSharp>,
   }
 };
 
+template <class JSON_FORMAT, class STREAM, typename TF, typename TS>
+struct SerializeImpl<json::JSONWriter<JSON_FORMAT, STREAM>, std::pair<TF, TS>> {
+  static void DoSerialize(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer, const std::pair<TF, TS>& value) {
+    json_writer.StartArray();
+    json_writer.Inner(value.first);
+    json_writer.Inner(value.second);
+    json_writer.EndArray();
+  }
+};
+
+template <class STREAM, typename TF, typename TS>
+struct SerializeImpl<json::JSONWriter<json::JSONFormat::NewtonsoftFSharp, STREAM>, std::pair<TF, TS>> {
+  static void DoSerialize(json::JSONWriter<json::JSONFormat::NewtonsoftFSharp, STREAM>& json_writer,
+                          const std::pair<TF, TS>& value) {
+    json_writer.StartObject();
+    json_writer.Key("Item1");
+    json_writer.Inner(value.first);
+    json_writer.Key("Item2");
+    json_writer.Inner(value.second);
+    json_writer.EndObject();
+  }
+};
+
 template <class JSON_FORMAT, typename TF, typename TS>
 struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, std::pair<TF, TS>> {
   static void DoDeserialize(json::JSONParser<JSON_FORMAT>& json_parser, std::pair<TF, TS>& destination) {
@@ -87,6 +110,18 @@ struct DeserializeImpl<json::JSONParser<JSONFormat::NewtonsoftFSharp>, std::pair
   }
 };
 
+template <class JSON_FORMAT, typename TF, typename TS>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, std::pair<TF, TS>> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, std::pair<TF, TS>& destination) {
+    json_reader.StartArray();
+    Deserialize(json_reader, destination.first);
+    Deserialize(json_reader, destination.second);
+    if (!json_reader.EndArray()) {
+      json_reader.Mismatch();
+    }
+  }
+};
+
 namespace json {
 template <typename F, typename S>
 struct IsJSONSerializable<std::pair<F, S>> {
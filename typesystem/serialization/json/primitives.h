@@ -56,6 +56,47 @@ struct JSONValueAssignerImpl<std::chrono::milliseconds> {
     destination.SetInt64(value.count());
   }
 };
+
+// The `JSONWriter` counterpart of `JSONValueAssignerImpl`, writing out the tokens RapidJSON's DOM would.
+template <typename T>
+struct JSONWriterValueImpl {
+  template <class JSON_FORMAT, class STREAM>
+  static void WriteValue(JSONWriter<JSON_FORMAT, STREAM>& json_writer, T value) {
+    if constexpr (std::is_same_v<T, bool>) {
+      json_writer.Bool(value);
+    } else if constexpr (std::is_floating_point_v<T>) {
+      json_writer.Double(static_cast<double>(value));
+    } else if constexpr (std::is_signed_v<T>) {
+      json_writer.Int64(static_cast<int64_t>(value));
+    } else {
+      json_writer.Uint64(static_cast<uint64_t>(value));
+    }
+  }
+};
+
+template <>
+struct JSONWriterValueImpl<std::string> {
+  template <class JSON_FORMAT, class STREAM>
+  static void WriteValue(JSONWriter<JSON_FORMAT, STREAM>& json_writer, const std::string& value) {
+    json_writer.String(value);
+  }
+};
+
+template <>
+struct JSONWriterValueImpl<std::chrono::microseconds> {
+  template <class JSON_FORMAT, class STREAM>
+  static void WriteValue(JSONWriter<JSON_FORMAT, STREAM>& json_writer, std::chrono::microseconds value) {
+    json_writer.Int64(value.count());
+  }
+};
+
+template <>
+struct JSONWriterValueImpl<std::chrono::milliseconds> {
+  template <class JSON_FORMAT, class STREAM>
+  static void WriteValue(JSONWriter<JSON_FORMAT, STREAM>& json_writer, std::chrono::milliseconds value) {
+    json_writer.Int64(value.count());
+  }
+};
 }  // namespace json
 
 #define CURRENT_DECLARE_PRIMITIVE_TYPE(typeid_index, cpp_type, current_type, fs_type, md_type, typescript_type) \
@@ -65,6 +106,12 @@ struct JSONValueAssignerImpl<std::chrono::milliseconds> {
       json_stringifier = value;                                                                                 \
     }                                                                                                           \
   };                                                                                                            \
+  template <class JSON_FORMAT, class STREAM>                                                                    \
+  struct SerializeImpl<json::JSONWriter<JSON_FORMAT, STREAM>, cpp_type> {                                       \
+    static void DoSerialize(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer, copy_free<cpp_type> value) {    \
+      json::JSONWriterValueImpl<cpp_type>::WriteValue(json_writer, value);                                      \
+    }                                                                                                           \
+  };                                                                                                            \
   namespace json {                                                                                              \
   template <>                                                                                                   \
   struct IsJSONSerializable<cpp_type> {                                                                         \
@@ -176,6 +223,81 @@ struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, std::chrono::microseconds>
   }
 };
 
+// The `JSONReader` counterparts of the above, with the same semantics.
+template <class JSON_FORMAT, typename T>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>,
+                       T,
+                       std::enable_if_t<std::numeric_limits<T>::is_integer && !std::numeric_limits<T>::is_signed &&
+                                        !std::is_same_v<T, bool>>> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, T& destination) {
+    if (!json_reader.IsUint64()) {
+      json_reader.Mismatch();
+    }
+    destination = static_cast<T>(json_reader.Uint64Value());
+    json_reader.Next();
+  }
+};
+
+template <class JSON_FORMAT, typename T>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>,
+                       T,
+                       std::enable_if_t<std::numeric_limits<T>::is_integer && std::numeric_limits<T>::is_signed>> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, T& destination) {
+    if (!json_reader.IsInt64()) {
+      json_reader.Mismatch();
+    }
+    destination = static_cast<T>(json_reader.Int64Value());
+    json_reader.Next();
+  }
+};
+
+template <class JSON_FORMAT, typename T>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, T, std::enable_if_t<std::is_floating_point_v<T>>> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, T& destination) {
+    if (!json_reader.IsNumber()) {
+      json_reader.Mismatch();
+    }
+    destination = static_cast<T>(json_reader.DoubleValue());
+    json_reader.Next();
+  }
+};
+
+template <class JSON_FORMAT>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, std::string> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, std::string& destination) {
+    if (!json_reader.IsString()) {
+      json_reader.Mismatch();
+    }
+    destination.assign(json_reader.StringValue().data(), json_reader.StringValue().length());
+    json_reader.Next();
+  }
+};
+
+template <class JSON_FORMAT>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, bool> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, bool& destination) {
+    if (!json_reader.IsBool()) {
+      json_reader.Mismatch();
+    }
+    destination = json_reader.BoolValue();
+    json_reader.Next();
+  }
+};
+
+template <class JSON_FORMAT, typename R, typename P>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, std::chrono::duration<R, P>> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, std::chrono::duration<R, P>& destination) {
+    static_assert(std::is_same_v<std::chrono::duration<R, P>, std::chrono::milliseconds> ||
+                      std::is_same_v<std::chrono::duration<R, P>, std::chrono::microseconds>,
+                  "Only `std::chrono::milliseconds` and `std::chrono::microseconds` are supported.");
+    if (!json_reader.IsInt64()) {
+      json_reader.Mismatch();
+    }
+    destination = std::chrono::duration<R, P>(json_reader.Int64Value());
+    json_reader.Next();
+  }
+};
+
 }  // namespace serialization
 }  // namespace current
 
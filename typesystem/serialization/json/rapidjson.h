@@ -36,6 +36,18 @@ inline void RapidJSONAssertThrow(const char* text, const char* file, int line) {
 }
 
 #define RAPIDJSON_HAS_STDSTRING 1
+
+// The vectorized scans of the strings, for their characters to escape when writing and to unescape when parsing,
+// as well as of the whitespace. Only what the target the code is built for has, as RapidJSON does not check at runtime.
+#if !defined(RAPIDJSON_SSE2) && !defined(RAPIDJSON_SSE42) && !defined(RAPIDJSON_NEON) && !defined(CURRENT_WINDOWS)
+#if defined(__SSE4_2__)
+#define RAPIDJSON_SSE42
+#elif defined(__SSE2__)
+#define RAPIDJSON_SSE2
+#elif defined(__ARM_NEON)
+#define RAPIDJSON_NEON
+#endif
+#endif
 #define RAPIDJSON_ASSERT(x) ((x) ? static_cast<void>(0) : RapidJSONAssertThrow(#x, __FILE__, __LINE__))
 
 #include "../../../3rdparty/rapidjson/document.h"
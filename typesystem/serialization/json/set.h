@@ -47,6 +47,17 @@ struct SerializeImpl<json::JSONStringifier<JSON_FORMAT>, std::set<T, EQ, ALLOCAT
   }
 };
 
+template <class JSON_FORMAT, class STREAM, typename T, class EQ, class ALLOCATOR>
+struct SerializeImpl<json::JSONWriter<JSON_FORMAT, STREAM>, std::set<T, EQ, ALLOCATOR>> {
+  static void DoSerialize(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer, const std::set<T, EQ, ALLOCATOR>& value) {
+    json_writer.StartArray();
+    for (const auto& element : value) {
+      json_writer.Inner(element);
+    }
+    json_writer.EndArray();
+  }
+};
+
 template <class JSON_FORMAT, typename T, class EQ, class ALLOCATOR>
 struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, std::set<T, EQ, ALLOCATOR>> {
   static void DoDeserialize(json::JSONParser<JSON_FORMAT>& json_parser, std::set<T, EQ, ALLOCATOR>& destination) {
@@ -64,6 +75,19 @@ struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, std::set<T, EQ, ALLOCATOR>
   }
 };
 
+template <class JSON_FORMAT, typename T, class EQ, class ALLOCATOR>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, std::set<T, EQ, ALLOCATOR>> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, std::set<T, EQ, ALLOCATOR>& destination) {
+    destination.clear();
+    json_reader.StartArray();
+    while (!json_reader.EndArray()) {
+      T element;
+      Deserialize(json_reader, element);
+      destination.insert(std::move(element));
+    }
+  }
+};
+
 namespace json {
 template <typename T, typename CMP, typename ALLOC>
 struct IsJSONSerializable<std::set<T, CMP, ALLOC>> {
@@ -26,7 +26,10 @@ SOFTWARE.
 #ifndef CURRENT_TYPE_SYSTEM_SERIALIZATION_JSON_STRUCT_H
 #define CURRENT_TYPE_SYSTEM_SERIALIZATION_JSON_STRUCT_H
 
+#include <array>
+#include <string_view>
 #include <type_traits>
+#include <vector>
 
 #include "json.h"
 
@@ -75,6 +78,180 @@ struct SerializeStructImpl<JSON_FORMAT, CurrentStruct> {
   static void SerializeStruct(JSONStructFieldsSerializer<JSON_FORMAT>&, const CurrentStruct&) {}
 };
 
+template <class JSON_FORMAT, class STREAM>
+class JSONStructFieldsWriter {
+ public:
+  explicit JSONStructFieldsWriter(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer) : json_writer_(json_writer) {}
+
+  template <typename U>
+  void operator()(const char* name, const U& source) const {
+    json_writer_.Field(name, source);
+  }
+
+ private:
+  json::JSONWriter<JSON_FORMAT, STREAM>& json_writer_;
+};
+
+template <class JSON_FORMAT, class STREAM, typename T>
+struct WriteStructImpl {
+  static void WriteStruct(const JSONStructFieldsWriter<JSON_FORMAT, STREAM>& visitor, const T& source) {
+    using decayed_t = current::decay_t<T>;
+    using super_t = current::reflection::SuperType<decayed_t>;
+
+    WriteStructImpl<JSON_FORMAT, STREAM, super_t>::WriteStruct(visitor, source);
+
+    current::reflection::VisitAllFields<decayed_t, current::reflection::FieldNameAndImmutableValue>::WithObject(
+        source, visitor);
+  }
+};
+
+template <class JSON_FORMAT, class STREAM>
+struct WriteStructImpl<JSON_FORMAT, STREAM, CurrentStruct> {
+  static void WriteStruct(const JSONStructFieldsWriter<JSON_FORMAT, STREAM>&, const CurrentStruct&) {}
+};
+
+// The fields of a `CURRENT_STRUCT` for `JSONReader`, the ones of its base structs included, in the order of
+// `JSONParser`: starting from the base-most struct, and in the order of declaration within each struct.
+// The keys of the input are matched against the names of the fields via a perfect hash table, built once per type,
+// with the field following the previously matched one checked first, as the keys usually come in this very order.
+template <class JSON_FORMAT, typename T>
+class JSONReaderStructFields final {
+ public:
+  struct Field final {
+    std::string_view name;
+    void (*deserialize)(JSONReader<JSON_FORMAT>&, T&);
+    bool (*missing)(T&);
+  };
+
+  template <typename S = T>
+  constexpr static size_t TotalFieldsCount() {
+    if constexpr (std::is_same_v<S, CurrentStruct>) {
+      return 0u;
+    } else {
+      return TotalFieldsCount<current::reflection::SuperType<S>>() + current::reflection::FieldCounter<S>::value;
+    }
+  }
+
+  static const JSONReaderStructFields& Instance() {
+    static const JSONReaderStructFields instance;
+    return instance;
+  }
+
+  const std::vector<Field>& Fields() const { return fields_; }
+
+  // Returns the index of the field named `key`, or `Fields().size()` if there is no such field.
+  size_t Find(std::string_view key, size_t expected) const {
+    if (expected < fields_.size() && fields_[expected].name == key) {
+      return expected;
+    } else if (!table_.empty()) {
+      const uint32_t i = table_[Hash(key, seed_) & (table_.size() - 1u)];
+      return (i < fields_.size() && fields_[i].name == key) ? i : fields_.size();
+    } else {
+      // The names are not unique, when the field of a derived struct shadows the field of its base one.
+      size_t i = 0u;
+      while (i < fields_.size() && fields_[i].name != key) {
+        ++i;
+      }
+      return i;
+    }
+  }
+
+ private:
+  JSONReaderStructFields() {
+    fields_.reserve(TotalFieldsCount());
+    AddFields<T>();
+    BuildTable();
+  }
+
+  static uint64_t Hash(std::string_view key, uint64_t seed) {
+    uint64_t hash = seed ^ (static_cast<uint64_t>(key.length()) * 0x9e3779b97f4a7c15ull);
+    for (const char c : key) {
+      hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+    }
+    return hash ^ (hash >> 29);
+  }
+
+  // Looks for the seed with which the names of the fields hash into distinct slots of the table, which is
+  // from two to sixteen times the number of fields in size. Leaves the table empty if the names are not unique.
+  void BuildTable() {
+    const uint32_t empty = static_cast<uint32_t>(fields_.size());
+    for (size_t size = 2u; size <= 16u * fields_.size(); size *= 2u) {
+      if (size < 2u * fields_.size()) {
+        continue;
+      }
+      for (uint64_t seed = 1u; seed <= 100u; ++seed) {
+        std::vector<uint32_t> table(size, empty);
+        bool ok = true;
+        for (uint32_t i = 0u; ok && i < empty; ++i) {
+          uint32_t& slot = table[Hash(fields_[i].name, seed) & (size - 1u)];
+          if (slot == empty) {
+            slot = i;
+          } else {
+            ok = false;
+          }
+        }
+        if (ok) {
+          table_ = std::move(table);
+          seed_ = seed;
+          return;
+        }
+      }
+    }
+  }
+
+  template <typename S>
+  void AddFields() {
+    if constexpr (!std::is_same_v<S, CurrentStruct>) {
+      AddFields<current::reflection::SuperType<S>>();
+      current::reflection::VisitAllFields<S, current::reflection::FieldTypeAndNameAndIndex>::WithoutObject(
+          FieldsAdder<S>{fields_});
+    }
+  }
+
+  template <typename S>
+  struct FieldsAdder final {
+    std::vector<Field>& fields;
+    template <typename U, int N>
+    void operator()(current::reflection::TypeSelector<U>, const char* name, current::reflection::SimpleIndex<N>) const {
+      fields.push_back(Field{name, &DeserializeField<S, N>, &MissingField<S, U, N>});
+    }
+  };
+
+  struct FieldDeserializer final {
+    JSONReader<JSON_FORMAT>& json_reader;
+    template <typename U>
+    void operator()(const char*, U& value) const {
+      Deserialize(json_reader, value);
+    }
+  };
+
+  template <typename U>
+  struct MissingFieldHandler final {
+    bool& result;
+    void operator()(const char*, U& value) const { result = JSONReaderMissingField<JSON_FORMAT, U>::Handle(value); }
+  };
+
+  template <typename S, int N>
+  static void DeserializeField(JSONReader<JSON_FORMAT>& json_reader, T& destination) {
+    static_cast<S&>(destination)
+        .CURRENT_REFLECTION(FieldDeserializer{json_reader},
+                            current::reflection::Index<current::reflection::FieldNameAndMutableValue, N>());
+  }
+
+  template <typename S, typename U, int N>
+  static bool MissingField(T& destination) {
+    bool result = false;
+    static_cast<S&>(destination)
+        .CURRENT_REFLECTION(MissingFieldHandler<U>{result},
+                            current::reflection::Index<current::reflection::FieldNameAndMutableValue, N>());
+    return result;
+  }
+
+  std::vector<Field> fields_;
+  std::vector<uint32_t> table_;
+  uint64_t seed_ = 0u;
+};
+
 }  // namespace json
 
 template <class JSON_FORMAT, typename T>
@@ -88,6 +265,18 @@ struct SerializeImpl<json::JSONStringifier<JSON_FORMAT>,
   }
 };
 
+template <class JSON_FORMAT, class STREAM, typename T>
+struct SerializeImpl<json::JSONWriter<JSON_FORMAT, STREAM>,
+                     T,
+                     std::enable_if_t<IS_CURRENT_STRUCT(T) && !std::is_same_v<T, CurrentStruct>>> {
+  static void DoSerialize(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer, const T& value) {
+    json_writer.StartObject();
+    const json::JSONStructFieldsWriter<JSON_FORMAT, STREAM> visitor(json_writer);
+    json::WriteStructImpl<JSON_FORMAT, STREAM, T>::WriteStruct(visitor, value);
+    json_writer.EndObject();
+  }
+};
+
 template <class JSON_FORMAT>
 struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, CurrentStruct> {
   static void DoDeserialize(json::JSONParser<JSON_FORMAT>&, CurrentStruct&) {}
@@ -132,6 +321,43 @@ struct DeserializeImpl<json::JSONParser<JSON_FORMAT>,
   }
 };
 
+template <class JSON_FORMAT>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, CurrentStruct> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, CurrentStruct&) { json_reader.SkipValue(); }
+};
+
+template <class JSON_FORMAT, typename T>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>,
+                       T,
+                       std::enable_if_t<IS_CURRENT_STRUCT(T) && !std::is_same_v<T, CurrentStruct>>> {
+  using fields_t = json::JSONReaderStructFields<JSON_FORMAT, T>;
+
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, T& destination) {
+    const fields_t& instance = fields_t::Instance();
+    const auto& fields = instance.Fields();
+    std::array<bool, fields_t::TotalFieldsCount()> seen{};
+    size_t expected = 0u;
+    json_reader.StartObject();
+    while (!json_reader.EndObject()) {
+      const size_t i = instance.Find(json_reader.StringValue(), expected);
+      json_reader.Next();
+      if (i < fields.size() && !seen[i]) {
+        seen[i] = true;
+        expected = i + 1u;
+        fields[i].deserialize(json_reader, destination);
+      } else {
+        // The unknown keys, as well as the repeated ones, are ignored, since `JSONParser` only looks at the first one.
+        json_reader.SkipValue();
+      }
+    }
+    for (size_t i = 0u; i < fields.size(); ++i) {
+      if (!seen[i] && !fields[i].missing(destination)) {
+        json_reader.Mismatch();
+      }
+    }
+  }
+};
+
 }  // namespace serialization
 }  // namespace current
 
@@ -56,6 +56,28 @@ struct SerializeImpl<json::JSONStringifier<JSON_FORMAT>, std::tuple<TS...>> {
   }
 };
 
+template <class JSON_FORMAT, class STREAM, class TUPLE, int I, int N>
+struct WriteTupleImpl {
+  static void DoIt(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer, const TUPLE& value) {
+    json_writer.Inner(std::get<I>(value));
+    WriteTupleImpl<JSON_FORMAT, STREAM, TUPLE, I + 1, N>::DoIt(json_writer, value);
+  }
+};
+
+template <class JSON_FORMAT, class STREAM, class TUPLE, int N>
+struct WriteTupleImpl<JSON_FORMAT, STREAM, TUPLE, N, N> {
+  static void DoIt(json::JSONWriter<JSON_FORMAT, STREAM>&, const TUPLE&) {}
+};
+
+template <class JSON_FORMAT, class STREAM, typename... TS>
+struct SerializeImpl<json::JSONWriter<JSON_FORMAT, STREAM>, std::tuple<TS...>> {
+  static void DoSerialize(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer, const std::tuple<TS...>& value) {
+    json_writer.StartArray();
+    WriteTupleImpl<JSON_FORMAT, STREAM, std::tuple<TS...>, 0, sizeof...(TS)>::DoIt(json_writer, value);
+    json_writer.EndArray();
+  }
+};
+
 template <class JSON_FORMAT, class TUPLE, int I, int N>
 struct DeserializeTupleImpl {
   static void DoIt(json::JSONParser<JSON_FORMAT>& json_parser, TUPLE& destination) {
@@ -85,6 +107,17 @@ struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, std::tuple<TS...>> {
   }
 };
 
+template <class JSON_FORMAT, typename... TS>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, std::tuple<TS...>> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, std::tuple<TS...>& destination) {
+    json_reader.StartArray();
+    std::apply([&json_reader](TS&... elements) { (Deserialize(json_reader, elements), ...); }, destination);
+    if (!json_reader.EndArray()) {
+      json_reader.Mismatch();
+    }
+  }
+};
+
 namespace json {
 template <>
 struct IsJSONSerializable<std::tuple<>> {
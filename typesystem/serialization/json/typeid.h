@@ -42,6 +42,13 @@ struct SerializeImpl<json::JSONStringifier<JSON_FORMAT>, reflection::TypeID> {
   }
 };
 
+template <class JSON_FORMAT, class STREAM>
+struct SerializeImpl<json::JSONWriter<JSON_FORMAT, STREAM>, reflection::TypeID> {
+  static void DoSerialize(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer, reflection::TypeID value) {
+    json_writer.String("T" + current::ToString(value));
+  }
+};
+
 template <class JSON_FORMAT>
 struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, reflection::TypeID> {
   static void DoDeserialize(json::JSONParser<JSON_FORMAT>& json_parser, reflection::TypeID& destination) {
@@ -55,6 +62,17 @@ struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, reflection::TypeID> {
   }
 };
 
+template <class JSON_FORMAT>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, reflection::TypeID> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, reflection::TypeID& destination) {
+    if (!json_reader.IsString() || json_reader.StringValue().data()[0] != 'T') {
+      json_reader.Mismatch();
+    }
+    destination = static_cast<reflection::TypeID>(current::FromString<uint64_t>(json_reader.StringValue().data() + 1));
+    json_reader.Next();
+  }
+};
+
 namespace json {
 template <>
 struct IsJSONSerializable<reflection::TypeID> {
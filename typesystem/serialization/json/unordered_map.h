@@ -68,6 +68,34 @@ struct SerializeImpl<json::JSONStringifier<JSON_FORMAT>, std::unordered_map<std:
   }
 };
 
+template <class JSON_FORMAT, class STREAM, typename TK, typename TV, class HASH, class EQ, class ALLOCATOR>
+struct SerializeImpl<json::JSONWriter<JSON_FORMAT, STREAM>, std::unordered_map<TK, TV, HASH, EQ, ALLOCATOR>> {
+  static void DoSerialize(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer,
+                          const std::unordered_map<TK, TV, HASH, EQ, ALLOCATOR>& value) {
+    json_writer.StartArray();
+    for (const auto& element : value) {
+      json_writer.StartArray();
+      json_writer.Inner(element.first);
+      json_writer.Inner(element.second);
+      json_writer.EndArray();
+    }
+    json_writer.EndArray();
+  }
+};
+
+template <class JSON_FORMAT, class STREAM, typename TV, class HASH, class EQ, class ALLOCATOR>
+struct SerializeImpl<json::JSONWriter<JSON_FORMAT, STREAM>, std::unordered_map<std::string, TV, HASH, EQ, ALLOCATOR>> {
+  static void DoSerialize(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer,
+                          const std::unordered_map<std::string, TV, HASH, EQ, ALLOCATOR>& value) {
+    json_writer.StartObject();
+    for (const auto& element : value) {
+      json_writer.Key(element.first);
+      json_writer.Inner(element.second);
+    }
+    json_writer.EndObject();
+  }
+};
+
 template <class JSON_FORMAT, typename TK, typename TV, class HASH, class EQ, class ALLOCATOR, class J>
 struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, std::unordered_map<TK, TV, HASH, EQ, ALLOCATOR>, J> {
   template <typename K = TK>
@@ -116,6 +144,38 @@ struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, std::unordered_map<TK, TV,
   }
 };
 
+template <class JSON_FORMAT, typename TK, typename TV, class HASH, class EQ, class ALLOCATOR>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, std::unordered_map<TK, TV, HASH, EQ, ALLOCATOR>> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader,
+                            std::unordered_map<TK, TV, HASH, EQ, ALLOCATOR>& destination) {
+    destination.clear();
+    if constexpr (std::is_same_v<std::string, TK>) {
+      json_reader.StartObject();
+      TK k;
+      TV v;
+      while (!json_reader.EndObject()) {
+        k.assign(json_reader.StringValue().data(), json_reader.StringValue().length());
+        json_reader.Next();
+        Deserialize(json_reader, v);
+        destination.emplace(std::move(k), std::move(v));
+      }
+    } else {
+      json_reader.StartArray();
+      while (!json_reader.EndArray()) {
+        TK k;
+        TV v;
+        json_reader.StartArray();
+        Deserialize(json_reader, k);
+        Deserialize(json_reader, v);
+        if (!json_reader.EndArray()) {
+          json_reader.Mismatch();
+        }
+        destination.emplace(std::move(k), std::move(v));
+      }
+    }
+  }
+};
+
 namespace json {
 template <typename K, typename V, typename HASH, typename ALLOC>
 struct IsJSONSerializable<std::unordered_map<K, V, HASH, ALLOC>> {
@@ -47,6 +47,18 @@ struct SerializeImpl<json::JSONStringifier<JSON_FORMAT>, std::unordered_set<T, H
   }
 };
 
+template <class JSON_FORMAT, class STREAM, typename T, class HASH, class EQ, class ALLOCATOR>
+struct SerializeImpl<json::JSONWriter<JSON_FORMAT, STREAM>, std::unordered_set<T, HASH, EQ, ALLOCATOR>> {
+  static void DoSerialize(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer,
+                          const std::unordered_set<T, HASH, EQ, ALLOCATOR>& value) {
+    json_writer.StartArray();
+    for (const auto& element : value) {
+      json_writer.Inner(element);
+    }
+    json_writer.EndArray();
+  }
+};
+
 template <class JSON_FORMAT, typename T, class HASH, class EQ, class ALLOCATOR>
 struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, std::unordered_set<T, HASH, EQ, ALLOCATOR>> {
   static void DoDeserialize(json::JSONParser<JSON_FORMAT>& json_parser,
@@ -65,6 +77,20 @@ struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, std::unordered_set<T, HASH
   }
 };
 
+template <class JSON_FORMAT, typename T, class HASH, class EQ, class ALLOCATOR>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, std::unordered_set<T, HASH, EQ, ALLOCATOR>> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader,
+                            std::unordered_set<T, HASH, EQ, ALLOCATOR>& destination) {
+    destination.clear();
+    json_reader.StartArray();
+    while (!json_reader.EndArray()) {
+      T element;
+      Deserialize(json_reader, element);
+      destination.insert(std::move(element));
+    }
+  }
+};
+
 namespace json {
 template <typename T, typename HASH, typename ALLOC>
 struct IsJSONSerializable<std::unordered_set<T, HASH, ALLOC>> {
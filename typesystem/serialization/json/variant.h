@@ -26,6 +26,8 @@ SOFTWARE.
 #ifndef CURRENT_TYPE_SYSTEM_SERIALIZATION_JSON_VARIANT_H
 #define CURRENT_TYPE_SYSTEM_SERIALIZATION_JSON_VARIANT_H
 
+#include <map>
+#include <string_view>
 #include <type_traits>
 
 #include "primitives.h"
@@ -127,6 +129,67 @@ class JSONVariantSerializer<json::JSONVariantStyle::NewtonsoftFSharp, JSON_FORMA
   json::JSONStringifier<JSON_FORMAT>& json_stringifier_;
 };
 
+template <json::JSONVariantStyle, class JSON_FORMAT, class STREAM>
+class JSONVariantWriter;
+
+template <class JSON_FORMAT, class STREAM>
+class JSONVariantWriter<json::JSONVariantStyle::Current, JSON_FORMAT, STREAM> {
+ public:
+  explicit JSONVariantWriter(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer) : json_writer_(json_writer) {}
+
+  template <typename X>
+  std::enable_if_t<IS_CURRENT_STRUCT_OR_VARIANT(X)> operator()(const X& object) {
+    const char* name = reflection::CurrentTypeName<X, reflection::NameFormat::Z>();
+    json_writer_.StartObject();
+    json_writer_.Key(name);
+    json_writer_.Inner(object);
+    if (json::JSONVariantTypeIDInEmptyKey<JSON_FORMAT>::value) {
+      using namespace ::current::reflection;
+      static const TypeID type_id = Value<ReflectedTypeBase>(Reflector().ReflectType<X>()).type_id;
+      json_writer_.Key("");
+      json_writer_.Inner(type_id);
+    }
+    if (json::JSONVariantTypeNameInDollarKey<JSON_FORMAT>::value) {
+      json_writer_.Key("$");
+      json_writer_.String(name, strlen(name));
+    }
+    json_writer_.EndObject();
+  }
+
+ private:
+  json::JSONWriter<JSON_FORMAT, STREAM>& json_writer_;
+};
+
+template <class JSON_FORMAT, class STREAM>
+class JSONVariantWriter<json::JSONVariantStyle::Simple, JSON_FORMAT, STREAM>
+    : public JSONVariantWriter<json::JSONVariantStyle::Current, JSON_FORMAT, STREAM> {
+  using JSONVariantWriter<json::JSONVariantStyle::Current, JSON_FORMAT, STREAM>::JSONVariantWriter;
+};
+
+template <class JSON_FORMAT, class STREAM>
+class JSONVariantWriter<json::JSONVariantStyle::NewtonsoftFSharp, JSON_FORMAT, STREAM> {
+ public:
+  explicit JSONVariantWriter(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer) : json_writer_(json_writer) {}
+
+  template <typename X>
+  std::enable_if_t<IS_CURRENT_STRUCT_OR_VARIANT(X)> operator()(const X& object) {
+    const char* name = reflection::CurrentTypeName<X, reflection::NameFormat::Z>();
+    json_writer_.StartObject();
+    json_writer_.Key("Case");
+    json_writer_.String(name, strlen(name));
+    if (IS_CURRENT_VARIANT(X) || !IS_EMPTY_CURRENT_STRUCT(X)) {
+      json_writer_.Key("Fields");
+      json_writer_.StartArray();
+      json_writer_.Inner(object);
+      json_writer_.EndArray();
+    }
+    json_writer_.EndObject();
+  }
+
+ private:
+  json::JSONWriter<JSON_FORMAT, STREAM>& json_writer_;
+};
+
 template <class JSON_FORMAT>
 class JSONVariantCaseAbstractBase {
  public:
@@ -398,6 +461,80 @@ class JSONVariantPerStyle<JSONVariantStyle::NewtonsoftFSharp, JSON_FORMAT, VARIA
   }
 };
 
+// The `JSONReader` counterpart of `JSONVariantPerStyle`, for the `Current` and `Simple` styles.
+// The case is chosen by the first key that is the name of one of the types, and, in the `Current` style,
+// the type ID under the empty key, wherever it is in the object, must then be the one of this very type.
+template <class JSON_FORMAT, typename VARIANT>
+class JSONVariantReader final {
+ public:
+  static void DoReadVariant(JSONReader<JSON_FORMAT>& json_reader, VARIANT& destination) {
+    static const JSONVariantReader instance;
+    constexpr bool type_id_required = (JSON_FORMAT::variant_style == JSONVariantStyle::Current);
+    const Case* parsed_case = nullptr;
+    bool has_type_id = false;
+    reflection::TypeID type_id = static_cast<reflection::TypeID>(0);
+    json_reader.StartObject();
+    while (!json_reader.EndObject()) {
+      const std::string_view key = json_reader.StringValue();
+      if (key.empty() && type_id_required && !has_type_id) {
+        json_reader.Next();
+        Deserialize(json_reader, type_id);
+        has_type_id = true;
+      } else if (key.empty() || key == "$") {
+        json_reader.Next();
+        json_reader.SkipValue();
+      } else {
+        const auto cit = instance.cases_.find(key);
+        json_reader.Next();
+        if (cit == instance.cases_.end() && type_id_required) {
+          // The `Current` style ignores the keys other than the names of the types.
+          json_reader.SkipValue();
+        } else if (cit != instance.cases_.end() && !parsed_case) {
+          cit->second.deserialize(json_reader, destination);
+          parsed_case = &cit->second;
+        } else {
+          json_reader.Mismatch();
+        }
+      }
+    }
+    if (!parsed_case || (type_id_required && !(has_type_id && type_id == parsed_case->type_id))) {
+      json_reader.Mismatch();
+    }
+  }
+
+ private:
+  struct Case final {
+    reflection::TypeID type_id = static_cast<reflection::TypeID>(0);
+    void (*deserialize)(JSONReader<JSON_FORMAT>&, VARIANT&);
+  };
+  using cases_map_t = std::map<std::string, Case, std::less<>>;
+
+  template <typename X>
+  struct Registerer {
+    Registerer(cases_map_t& cases) {
+      reflection::TypeID type_id = static_cast<reflection::TypeID>(0);
+      if (JSON_FORMAT::variant_style == JSONVariantStyle::Current) {
+        type_id = Value<reflection::ReflectedTypeBase>(reflection::Reflector().ReflectType<X>()).type_id;
+      }
+      // As with `JSONVariantPerStyle`, should types share the name, the last one wins, although in the `Current`
+      // style such inputs rather end up parsed the way `JSONParser` does it: by the type ID.
+      cases[reflection::CurrentTypeName<X, reflection::NameFormat::Z>()] = Case{type_id, &DeserializeCase<X>};
+    }
+  };
+
+  template <typename X>
+  static void DeserializeCase(JSONReader<JSON_FORMAT>& json_reader, VARIANT& destination) {
+    Deserialize(json_reader, destination.template Construct<X>());
+  }
+
+  JSONVariantReader() {
+    current::metaprogramming::call_all_constructors_with<Registerer, cases_map_t, typename VARIANT::typelist_t>(
+        cases_);
+  }
+
+  cases_map_t cases_;
+};
+
 }  // namespace json
 
 template <class JSON_FORMAT, typename T>
@@ -416,6 +553,22 @@ struct SerializeImpl<json::JSONStringifier<JSON_FORMAT>, T, std::enable_if_t<IS_
   }
 };
 
+template <class JSON_FORMAT, class STREAM, typename T>
+struct SerializeImpl<json::JSONWriter<JSON_FORMAT, STREAM>, T, std::enable_if_t<IS_CURRENT_VARIANT(T)>> {
+  static void DoSerialize(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer, const T& value) {
+    if (Exists(value)) {
+      json::JSONVariantWriter<JSON_FORMAT::variant_style, JSON_FORMAT, STREAM> impl(json_writer);
+      value.Call(impl);
+    } else {
+      if (json::JSONVariantStyleUseNulls<JSON_FORMAT::variant_style>::value) {
+        json_writer.Null();
+      } else {
+        json_writer.MarkAsAbsentValue();
+      }
+    }
+  }
+};
+
 template <class JSON_FORMAT, typename T>
 struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, T, std::enable_if_t<IS_CURRENT_VARIANT(T)>> {
   static void DoDeserialize(json::JSONParser<JSON_FORMAT>& json_parser, T& value) {
@@ -430,6 +583,28 @@ struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, T, std::enable_if_t<IS_CUR
   }
 };
 
+template <class JSON_FORMAT, typename T>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, T, std::enable_if_t<IS_CURRENT_VARIANT(T)>> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, T& value) {
+    static_assert(JSON_FORMAT::variant_style != json::JSONVariantStyle::NewtonsoftFSharp,
+                  "`JSONReader` does not support the `NewtonsoftFSharp` format.");
+    if (!json_reader.IsNull()) {
+      json::JSONVariantReader<JSON_FORMAT, T>::DoReadVariant(json_reader, value);
+    } else if (!json::JSONVariantStyleUseNulls<JSON_FORMAT::variant_style>::value) {
+      json_reader.Next();
+    } else {
+      json_reader.Mismatch();
+    }
+  }
+};
+
+namespace json {
+template <class JSON_FORMAT, typename T>
+struct JSONReaderMissingField<JSON_FORMAT, T, std::enable_if_t<IS_CURRENT_VARIANT(T)>> {
+  static bool Handle(T&) { return !JSONVariantStyleUseNulls<JSON_FORMAT::variant_style>::value; }
+};
+}  // namespace json
+
 }  // namespace serialization
 }  // namespace current
 
@@ -26,6 +26,7 @@ SOFTWARE.
 #ifndef CURRENT_TYPE_SYSTEM_SERIALIZATION_JSON_VECTOR_H
 #define CURRENT_TYPE_SYSTEM_SERIALIZATION_JSON_VECTOR_H
 
+#include <deque>
 #include <vector>
 
 #include "json.h"
@@ -58,6 +59,29 @@ struct SerializeImpl<json::JSONStringifier<JSON_FORMAT>, std::vector<bool, TA>>
   }
 };
 
+template <class JSON_FORMAT, class STREAM, typename T, typename TA>
+struct SerializeImpl<json::JSONWriter<JSON_FORMAT, STREAM>, std::vector<T, TA>> {
+  static void DoSerialize(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer, const std::vector<T, TA>& value) {
+    json_writer.StartArray();
+    for (const auto& element : value) {
+      json_writer.Inner(element);
+    }
+    json_writer.EndArray();
+  }
+};
+
+template <class JSON_FORMAT, class STREAM, typename TA>
+struct SerializeImpl<json::JSONWriter<JSON_FORMAT, STREAM>, std::vector<bool, TA>> {
+  static void DoSerialize(json::JSONWriter<JSON_FORMAT, STREAM>& json_writer, const std::vector<bool, TA>& value) {
+    json_writer.StartArray();
+    for (const auto&& element : value) {
+      const bool tmp = element;
+      json_writer.Inner(tmp);
+    }
+    json_writer.EndArray();
+  }
+};
+
 template <class JSON_FORMAT, typename T, typename TA>
 struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, std::vector<T, TA>> {
   static void DoDeserialize(json::JSONParser<JSON_FORMAT>& json_parser, std::vector<T, TA>& destination) {
@@ -90,6 +114,59 @@ struct DeserializeImpl<json::JSONParser<JSON_FORMAT>, std::vector<bool, TA>> {
   }
 };
 
+template <class JSON_FORMAT, typename T, typename TA>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, std::vector<T, TA>> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, std::vector<T, TA>& destination) {
+    // As with `JSONParser`, the elements already in `destination` are deserialized into, not re-created.
+    size_t size = 0u;
+    json_reader.StartArray();
+    if constexpr (std::is_nothrow_move_constructible_v<T>) {
+      while (!json_reader.EndArray()) {
+        if (size == destination.size()) {
+          destination.emplace_back();
+        }
+        Deserialize(json_reader, destination[size]);
+        ++size;
+      }
+      destination.resize(size);
+    } else {
+      // Unlike with `JSONParser`, the size of the array is not known upfront, and growing the vector would copy
+      // the elements that can not be moved safely, such as the `CURRENT_STRUCT`-s with `Optional`-s.
+      std::deque<T> extra;
+      while (!json_reader.EndArray()) {
+        if (size < destination.size()) {
+          Deserialize(json_reader, destination[size]);
+        } else {
+          extra.emplace_back();
+          Deserialize(json_reader, extra.back());
+        }
+        ++size;
+      }
+      if (extra.empty()) {
+        destination.resize(size);
+      } else {
+        destination.reserve(size);
+        for (T& element : extra) {
+          destination.push_back(std::move(element));
+        }
+      }
+    }
+  }
+};
+
+template <class JSON_FORMAT, typename TA>
+struct DeserializeImpl<json::JSONReader<JSON_FORMAT>, std::vector<bool, TA>> {
+  static void DoDeserialize(json::JSONReader<JSON_FORMAT>& json_reader, std::vector<bool, TA>& destination) {
+    destination.clear();
+    json_reader.StartArray();
+    while (!json_reader.EndArray()) {
+      bool tmp;
+      Deserialize(json_reader, tmp);
+      destination.push_back(tmp);
+    }
+  }
+};
+
 namespace json {
 template <typename T, typename ALLOC>
 struct IsJSONSerializable<std::vector<T, ALLOC>> {
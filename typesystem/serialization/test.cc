@@ -182,8 +182,6 @@ CURRENT_STRUCT(WithInnerVariant) { CURRENT_FIELD(v, InnerVariant); };
 }  // namespace named_variant
 }  // namespace serialization_test
 
-#if 0
-// TODO(dkorolev): DIMA FIXME binary format.
 TEST(Serialization, Binary) {
   using namespace serialization_test;
 
@@ -254,7 +252,82 @@ TEST(Serialization, Binary) {
     ASSERT_THROW(LoadFromBinary<ComplexSerializable>(is), BinaryLoadFromStreamException);
   }
 }
-#endif
+
+TEST(Serialization, BinaryFormat) {
+  using namespace serialization_test;
+
+  {
+    // Small numbers take a byte, large ones take more, and signed ones are zigzag-encoded.
+    Serializable object(1, "", false, Enum::DEFAULT);
+    EXPECT_EQ(std::string("\x01\x00\x00\x00", 4u), SaveIntoBinary(object).substr(13u));
+    object.i = 300u;
+    object.e = Enum::SET;
+    EXPECT_EQ(std::string("\xac\x02\x00\x00\x64", 5u), SaveIntoBinary(object).substr(13u));
+    Int negative;
+    negative.x = -2;
+    EXPECT_EQ("\x03", SaveIntoBinary(negative).substr(13u));
+  }
+
+  {
+    // Variants, containers, pairs, tuples, and the extreme values of the primitive types round-trip.
+    ContainsVariant with_variant;
+    ComplexSerializable complex('a', 'c');
+    complex.j = 1u;
+    complex.z = Serializable(2, "two", true, Enum::SET);
+    with_variant.variant = std::move(complex);
+    const ContainsVariant parsed_with_variant = LoadFromBinary<ContainsVariant>(SaveIntoBinary(with_variant));
+    ASSERT_TRUE(Exists<ComplexSerializable>(parsed_with_variant.variant));
+    EXPECT_EQ(JSON(with_variant), JSON(parsed_with_variant));
+
+    WithVectorOfPairs with_pairs;
+    with_pairs.v.emplace_back(std::numeric_limits<int32_t>::min(), "min");
+    with_pairs.v.emplace_back(std::numeric_limits<int32_t>::max(), std::string("max\0max", 7));
+    EXPECT_EQ(JSON(with_pairs), JSON(LoadFromBinary<WithVectorOfPairs>(SaveIntoBinary(with_pairs))));
+
+    std::tuple<int64_t, double, float, std::set<std::string>, std::map<std::string, Optional<bool>>> tuple;
+    std::get<0>(tuple) = std::numeric_limits<int64_t>::min();
+    std::get<1>(tuple) = -0.1;
+    std::get<2>(tuple) = 1e-30f;
+    std::get<3>(tuple) = {"foo", "bar"};
+    std::get<4>(tuple)["yes"] = true;
+    std::get<4>(tuple)["no"] = nullptr;
+    using tuple_t = decltype(tuple);
+    EXPECT_EQ(JSON(tuple), JSON(LoadFromBinary<tuple_t>(SaveIntoBinary(tuple))));
+
+    const std::unordered_map<std::string, std::vector<bool>> unordered_map{{"a", {true}}, {"b", {false, true}}};
+    using unordered_map_t = std::unordered_map<std::string, std::vector<bool>>;
+    EXPECT_TRUE(unordered_map == LoadFromBinary<unordered_map_t>(SaveIntoBinary(unordered_map)));
+  }
+
+  {
+    // The binary format is more compact than JSON.
+    ComplexSerializable object('a', 'z');
+    object.j = 1000000u;
+    EXPECT_LT(SaveIntoBinary(object).length() * 2u, JSON(object).length());
+  }
+
+  {
+    // Objects do not load as the objects of other types, and malformed input is rejected.
+    const std::string binary = SaveIntoBinary(Serializable(42, "foo", true, Enum::SET));
+    EXPECT_EQ(42ull, LoadFromBinary<Serializable>(binary).i);
+    ASSERT_THROW(LoadFromBinary<DerivedSerializable>(binary), BinarySchemaMismatchException);
+    ASSERT_THROW(LoadFromBinary<Serializable>(binary.substr(0u, binary.length() - 1u)), BinaryLoadFromStreamException);
+    ASSERT_THROW(LoadFromBinary<Serializable>(binary + "x"), BinaryLoadFromStreamException);
+    ASSERT_THROW(LoadFromBinary<Serializable>("C5TB"), BinaryLoadFromStreamException);
+    std::string corrupted = binary;
+    corrupted[0] = 'X';
+    ASSERT_THROW(LoadFromBinary<Serializable>(corrupted), BinaryLoadFromStreamException);
+    std::istringstream truncated(binary.substr(0u, binary.length() - 1u));
+    ASSERT_THROW(LoadFromBinary<Serializable>(truncated), BinaryLoadFromStreamException);
+
+    ContainsVariant with_variant;
+    with_variant.variant = Empty();
+    std::string bad_case = SaveIntoBinary(with_variant);
+    ASSERT_EQ("\x01", bad_case.substr(13u));
+    bad_case[13u] = '\x05';
+    ASSERT_THROW(LoadFromBinary<ContainsVariant>(bad_case), BinaryLoadFromStreamException);
+  }
+}
 
 TEST(JSONSerialization, CPPTypes) {
   using namespace serialization_test;
@@ -368,8 +441,6 @@ TEST(JSONSerialization, Tuple) {
   }
 }
 
-#if 0
-// TODO(dkorolev): DIMA FIXME binary format.
 TEST(Serialization, OptionalAsBinary) {
   using namespace serialization_test;
 
@@ -412,7 +483,6 @@ TEST(Serialization, OptionalAsBinary) {
     EXPECT_TRUE(Value(parsed_with_b.b));
   }
 }
-#endif
 
 TEST(JSONSerialization, CurrentStructs) {
   using namespace serialization_test;
@@ -881,8 +951,6 @@ TEST(JSONSerialization, Time) {
   }
 }
 
-#if 0
-// TODO(dkorolev): DIMA FIXME binary format.
 TEST(Serialization, TimeAsBinary) {
   using namespace serialization_test;
 
@@ -890,7 +958,8 @@ TEST(Serialization, TimeAsBinary) {
     WithTime zero;
     std::ostringstream oss;
     SaveIntoBinary(oss, zero);
-    EXPECT_EQ(16u, oss.str().length());
+    // The 13-byte header, of four magic bytes, eight bytes of TypeID, and the size of the payload, plus two zeroes.
+    EXPECT_EQ(15u, oss.str().length());
   }
 
   {
@@ -905,7 +974,6 @@ TEST(Serialization, TimeAsBinary) {
     EXPECT_EQ(6ll, parsed.micros.count());
   }
 }
-#endif
 
 TEST(JSONSerialization, Optional) {
   using namespace serialization_test;
@@ -1427,6 +1495,387 @@ CURRENT_STRUCT(CrashingStruct) {
 
 }  // namespace serialization_test
 
+namespace serialization_test {
+
+template <class J, typename T>
+std::string JSONViaDOM(const T& source) {
+  current::serialization::json::JSONStringifier<J> json_stringifier;
+  current::serialization::Serialize(json_stringifier, source);
+  return json_stringifier.ResultingJSON();
+}
+
+template <typename T>
+void ExpectJSONWriterMatchesDOM(const T& source) {
+  EXPECT_EQ(JSONViaDOM<JSONFormat::Current>(source), JSON<JSONFormat::Current>(source));
+  EXPECT_EQ(JSONViaDOM<JSONFormat::Minimalistic>(source), JSON<JSONFormat::Minimalistic>(source));
+  EXPECT_EQ(JSONViaDOM<JSONFormat::JavaScript>(source), JSON<JSONFormat::JavaScript>(source));
+  EXPECT_EQ(JSONViaDOM<JSONFormat::NewtonsoftFSharp>(source), JSON<JSONFormat::NewtonsoftFSharp>(source));
+}
+
+}  // namespace serialization_test
+
+TEST(JSONSerialization, WriterMatchesDOM) {
+  using namespace serialization_test;
+
+  const Serializable simple(42, "foo \"bar\"\n\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82", true, Enum::SET);
+  ExpectJSONWriterMatchesDOM(simple);
+  ExpectJSONWriterMatchesDOM(std::string("with\0zero", 9u));
+
+  ComplexSerializable complex('a', 'e');
+  complex.j = std::numeric_limits<uint64_t>::max();
+  complex.q = "";
+  complex.z = simple;
+  ExpectJSONWriterMatchesDOM(complex);
+
+  DerivedSerializable derived;
+  derived.i = 1u;
+  derived.s = "derived";
+  derived.b = false;
+  derived.e = Enum::DEFAULT;
+  derived.d = -0.1;
+  ExpectJSONWriterMatchesDOM(derived);
+
+  Int i;
+  i.x = std::numeric_limits<int32_t>::min();
+  ExpectJSONWriterMatchesDOM(i);
+  Float f;
+  f.x = 0.1f;
+  ExpectJSONWriterMatchesDOM(f);
+  Double d;
+  d.x = 1e-300;
+  ExpectJSONWriterMatchesDOM(d);
+
+  WithVectorOfPairs with_pairs;
+  with_pairs.v.emplace_back(-1, "minus one");
+  with_pairs.v.emplace_back(1, "one");
+  ExpectJSONWriterMatchesDOM(with_pairs);
+
+  WithTrivialMap with_trivial_map;
+  with_trivial_map.m["a"] = "b";
+  with_trivial_map.m[""] = "empty";
+  ExpectJSONWriterMatchesDOM(with_trivial_map);
+
+  WithNontrivialMap with_nontrivial_map;
+  with_nontrivial_map.q[simple] = "simple";
+  ExpectJSONWriterMatchesDOM(with_nontrivial_map);
+
+  WithOptional with_optional;
+  ExpectJSONWriterMatchesDOM(with_optional);
+  with_optional.i = 42;
+  ExpectJSONWriterMatchesDOM(with_optional);
+  with_optional.b = false;
+  ExpectJSONWriterMatchesDOM(with_optional);
+
+  WithTime with_time;
+  with_time.micros = std::chrono::microseconds(-5);
+  ExpectJSONWriterMatchesDOM(with_time);
+
+  ContainsVariant contains_variant;
+  ExpectJSONWriterMatchesDOM(contains_variant);
+  contains_variant.variant = Empty();
+  ExpectJSONWriterMatchesDOM(contains_variant);
+  contains_variant.variant = simple;
+  ExpectJSONWriterMatchesDOM(contains_variant);
+  contains_variant.variant = complex;
+  ExpectJSONWriterMatchesDOM(contains_variant);
+
+  named_variant::WithInnerVariant with_inner_variant;
+  with_inner_variant.v = with_optional;
+  ExpectJSONWriterMatchesDOM(with_inner_variant);
+  named_variant::WrappedQ wrapped = named_variant::OuterB();
+  ExpectJSONWriterMatchesDOM(wrapped);
+  Value<named_variant::OuterB>(wrapped).b = named_variant::T();
+  ExpectJSONWriterMatchesDOM(wrapped);
+
+  // The absent values are `null`-s outside the fields of `CURRENT_STRUCT`-s, including the top-level one.
+  ExpectJSONWriterMatchesDOM(Optional<int>());
+  ExpectJSONWriterMatchesDOM(std::vector<Optional<int>>({Optional<int>(1), Optional<int>()}));
+  ExpectJSONWriterMatchesDOM(std::map<std::string, Optional<bool>>({{"yes", true}, {"no", nullptr}}));
+  ExpectJSONWriterMatchesDOM(std::vector<simple_variant_t>(2u));
+  ExpectJSONWriterMatchesDOM(std::make_pair(Optional<std::string>("x"), Optional<std::string>()));
+  ExpectJSONWriterMatchesDOM(std::make_tuple(1, std::string("two"), std::vector<bool>({true, false}), complex));
+  ExpectJSONWriterMatchesDOM(std::array<int8_t, 3>({-1, 0, 1}));
+  ExpectJSONWriterMatchesDOM(std::set<uint16_t>({1u, 65535u}));
+  ExpectJSONWriterMatchesDOM(std::unordered_map<std::string, int>({{"a", 1}}));
+  ExpectJSONWriterMatchesDOM(std::unordered_map<int, int>({{1, 2}}));
+  ExpectJSONWriterMatchesDOM(std::unordered_set<std::string>({"a"}));
+  ExpectJSONWriterMatchesDOM(std::vector<char>({'a', '\0'}));
+  ExpectJSONWriterMatchesDOM(current::reflection::TypeID::Int32);
+}
+
+namespace serialization_test {
+
+template <class J, typename T>
+bool ParsedViaReader(const std::string& json, T& destination) {
+  return current::serialization::json::ParseJSONViaReader<J>(json.c_str(), destination);
+}
+
+template <class J, typename T>
+void ExpectJSONReaderMatchesDOM(const std::string& json) {
+  T via_reader;
+  ASSERT_TRUE(ParsedViaReader<J>(json, via_reader)) << json;
+  T via_dom;
+  current::serialization::json::ParseJSONViaRapidJSON<J>(json.c_str(), via_dom);
+  EXPECT_EQ(JSON<J>(via_dom), JSON<J>(via_reader)) << json;
+}
+
+template <typename T>
+void ExpectJSONReaderMatchesDOM(const T& source) {
+  ExpectJSONReaderMatchesDOM<JSONFormat::Current, T>(JSON<JSONFormat::Current>(source));
+  ExpectJSONReaderMatchesDOM<JSONFormat::Minimalistic, T>(JSON<JSONFormat::Minimalistic>(source));
+  ExpectJSONReaderMatchesDOM<JSONFormat::JavaScript, T>(JSON<JSONFormat::JavaScript>(source));
+}
+
+template <class J, typename T>
+bool ParsedViaReader(const std::string& json) {
+  T destination;
+  return ParsedViaReader<J>(json, destination);
+}
+
+}  // namespace serialization_test
+
+TEST(JSONSerialization, ReaderMatchesDOM) {
+  using namespace serialization_test;
+
+  const Serializable simple(42, "foo \"bar\"\n\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82", true, Enum::SET);
+  ExpectJSONReaderMatchesDOM(simple);
+  ExpectJSONReaderMatchesDOM(std::string("with\0zero", 9u));
+
+  ComplexSerializable complex('a', 'e');
+  complex.j = std::numeric_limits<uint64_t>::max();
+  complex.z = simple;
+  ExpectJSONReaderMatchesDOM(complex);
+
+  DerivedSerializable derived;
+  derived.i = 1u;
+  derived.s = "derived";
+  derived.b = false;
+  derived.e = Enum::DEFAULT;
+  derived.d = -0.1;
+  ExpectJSONReaderMatchesDOM(derived);
+
+  Int i;
+  i.x = std::numeric_limits<int32_t>::min();
+  ExpectJSONReaderMatchesDOM(i);
+  Float f;
+  f.x = 0.1f;
+  ExpectJSONReaderMatchesDOM(f);
+  Double d;
+  d.x = 1e-300;
+  ExpectJSONReaderMatchesDOM(d);
+
+  WithVectorOfPairs with_pairs;
+  with_pairs.v.emplace_back(-1, "minus one");
+  with_pairs.v.emplace_back(1, "one");
+  ExpectJSONReaderMatchesDOM(with_pairs);
+
+  WithNontrivialMap with_nontrivial_map;
+  with_nontrivial_map.q[simple] = "simple";
+  ExpectJSONReaderMatchesDOM(with_nontrivial_map);
+
+  WithOptional with_optional;
+  ExpectJSONReaderMatchesDOM(with_optional);
+  with_optional.i = 42;
+  with_optional.b = false;
+  ExpectJSONReaderMatchesDOM(with_optional);
+
+  WithTime with_time;
+  with_time.micros = std::chrono::microseconds(-5);
+  ExpectJSONReaderMatchesDOM(with_time);
+
+  ContainsVariant contains_variant;
+  contains_variant.variant = Empty();
+  ExpectJSONReaderMatchesDOM(contains_variant);
+  contains_variant.variant = complex;
+  ExpectJSONReaderMatchesDOM(contains_variant);
+
+  named_variant::WrappedQ wrapped = named_variant::OuterB();
+  Value<named_variant::OuterB>(wrapped).b = named_variant::T();
+  ExpectJSONReaderMatchesDOM(wrapped);
+
+  ExpectJSONReaderMatchesDOM(std::vector<Optional<int>>({Optional<int>(1), Optional<int>()}));
+  ExpectJSONReaderMatchesDOM(std::map<std::string, Optional<bool>>({{"yes", true}, {"no", nullptr}}));
+  ExpectJSONReaderMatchesDOM(std::make_tuple(1, std::string("two"), std::vector<bool>({true, false}), complex));
+  ExpectJSONReaderMatchesDOM(std::array<int8_t, 3>({-1, 0, 1}));
+  ExpectJSONReaderMatchesDOM(std::set<uint16_t>({1u, 65535u}));
+  ExpectJSONReaderMatchesDOM(std::unordered_map<int, int>({{1, 2}}));
+  ExpectJSONReaderMatchesDOM(current::reflection::TypeID::Int32);
+
+  // The inputs `JSON()` would not produce: the keys in any order, the unknown keys, the repeated ones.
+  ExpectJSONReaderMatchesDOM<JSONFormat::Current, Serializable>(
+      "{\"e\":100,\"x\":[{},[null]],\"b\":true,\"s\":\"first\",\"i\":1,\"s\":\"second\"}");
+  ExpectJSONReaderMatchesDOM<JSONFormat::Current, WithOptional>("{\"b\":null}");
+  ExpectJSONReaderMatchesDOM<JSONFormat::Current, std::map<std::string, int>>("{\"a\":1,\"a\":2}");
+  ExpectJSONReaderMatchesDOM<JSONFormat::Current, std::array<int, 2>>("[1,2,3]");
+  ExpectJSONReaderMatchesDOM<JSONFormat::Current, Double>("{\"x\":42}");
+  ExpectJSONReaderMatchesDOM<JSONFormat::Current, ContainsVariant>(
+      "{\"variant\":{\"\":\"T9200000002835747520\",\"Empty\":{},\"$\":\"Empty\"}}");
+  ExpectJSONReaderMatchesDOM<JSONFormat::Minimalistic, ContainsVariant>("{}");
+  ExpectJSONReaderMatchesDOM<JSONFormat::Minimalistic, ContainsVariant>("{\"variant\":{\"\":0,\"Empty\":{}}}");
+  ExpectJSONReaderMatchesDOM<JSONFormat::Current, std::vector<std::string>>(
+      " [ \"\\\"a\\n\\u00e9\\ud83d\\ude00\\u0000\" ,\"\",\t\"\xd0\x9f\" ]\n");
+  ExpectJSONReaderMatchesDOM<JSONFormat::Current, std::map<std::string, int>>("{\"\\u0041\":1,\"A\":2}");
+  ExpectJSONReaderMatchesDOM<JSONFormat::Current, std::vector<double>>(
+      "[0,-0,1.5,-2e3,0.1E-5,123456789012345678901234,18446744073709551615,-9223372036854775808]");
+  ExpectJSONReaderMatchesDOM<JSONFormat::Current, std::vector<int64_t>>(
+      "[-0,0,123456789012345678,-123456789012345678,9223372036854775807,-9223372036854775808]");
+  ExpectJSONReaderMatchesDOM<JSONFormat::Current, std::vector<uint64_t>>("[18446744073709551615,1234567890123456789]");
+
+  // The inputs `JSONReader` gives up on, for `JSONParser` to report the error, or to handle the corner case.
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, Serializable>("{")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, Serializable>("{} {}")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, std::vector<int>>("")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, std::vector<int>>("[1,]")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, std::vector<int>>("[1 2]")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, std::vector<int>>("[01]")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, std::vector<int>>("[-]")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, std::vector<int>>("[1]]")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, std::vector<int>>("[1e999]")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, std::vector<bool>>("[tru]")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, std::vector<std::string>>("[\"\x01\"]")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, std::vector<std::string>>("[\"\\x\"]")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, std::vector<std::string>>("[\"unterminated]")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, std::map<std::string, int>>("{\"a\" 1}")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, std::map<std::string, int>>("{\"a\":1,}")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, Serializable>("{\"i\":-1,\"s\":\"\",\"b\":true,\"e\":0}")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, Serializable>("{\"i\":1,\"s\":\"\",\"b\":true}")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, Int>("{\"x\":0.5}")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, std::array<int, 2>>("[1]")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, std::pair<int, int>>("[1,2,3]")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, ContainsVariant>("{\"variant\":null}")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, ContainsVariant>("{\"variant\":{\"Empty\":{}}}")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Minimalistic, ContainsVariant>("{\"variant\":{\"Nope\":{}}}")));
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Minimalistic, ContainsVariant>(
+      "{\"variant\":{\"Empty\":{},\"AlternativeEmpty\":{}}}")));
+  EXPECT_FALSE(
+      (ParsedViaReader<JSONFormat::NewtonsoftFSharp, Serializable>(JSON<JSONFormat::NewtonsoftFSharp>(simple))));
+
+  // And `ParseJSON` still reports the errors the way it always has.
+  try {
+    ParseJSON<Serializable>("{\"i\":1,\"s\":\"\",\"b\":true}");
+    ASSERT_TRUE(false);  // LCOV_EXCL_LINE
+  } catch (const JSONSchemaException& e) {
+    EXPECT_EQ(std::string("Expected number for `e`, got: missing field."), e.OriginalDescription());
+  }
+  EXPECT_THROW(ParseJSON<ContainsVariant>("{\"variant\":null}"), JSONUninitializedVariantObjectException);
+  EXPECT_THROW(ParseJSON<std::vector<int>>("[1,]"), InvalidJSONException);
+}
+
+namespace serialization_test {
+
+CURRENT_STRUCT(ManyFields) {
+  CURRENT_FIELD(field_00, uint32_t, 0u);
+  CURRENT_FIELD(field_01, uint32_t, 1u);
+  CURRENT_FIELD(field_02, uint32_t, 2u);
+  CURRENT_FIELD(field_03, uint32_t, 3u);
+  CURRENT_FIELD(field_04, uint32_t, 4u);
+  CURRENT_FIELD(field_05, uint32_t, 5u);
+  CURRENT_FIELD(field_06, uint32_t, 6u);
+  CURRENT_FIELD(field_07, uint32_t, 7u);
+  CURRENT_FIELD(field_08, uint32_t, 8u);
+  CURRENT_FIELD(field_09, uint32_t, 9u);
+  CURRENT_FIELD(field_10, uint32_t, 10u);
+  CURRENT_FIELD(field_11, uint32_t, 11u);
+  CURRENT_FIELD(field_12, uint32_t, 12u);
+  CURRENT_FIELD(field_13, uint32_t, 13u);
+  CURRENT_FIELD(field_14, uint32_t, 14u);
+  CURRENT_FIELD(field_15, uint32_t, 15u);
+  CURRENT_FIELD(field_16, uint32_t, 16u);
+  CURRENT_FIELD(field_17, uint32_t, 17u);
+  CURRENT_FIELD(field_18, uint32_t, 18u);
+  CURRENT_FIELD(field_19, uint32_t, 19u);
+  CURRENT_FIELD(field_20, uint32_t, 20u);
+  CURRENT_FIELD(field_21, uint32_t, 21u);
+  CURRENT_FIELD(field_22, uint32_t, 22u);
+  CURRENT_FIELD(field_23, uint32_t, 23u);
+  CURRENT_FIELD(field_24, uint32_t, 24u);
+  CURRENT_FIELD(field_25, uint32_t, 25u);
+  CURRENT_FIELD(field_26, uint32_t, 26u);
+  CURRENT_FIELD(field_27, uint32_t, 27u);
+  CURRENT_FIELD(field_28, uint32_t, 28u);
+  CURRENT_FIELD(field_29, uint32_t, 29u);
+  CURRENT_FIELD(field_30, uint32_t, 30u);
+  CURRENT_FIELD(field_31, uint32_t, 31u);
+  CURRENT_FIELD(field_32, uint32_t, 32u);
+  CURRENT_FIELD(field_33, uint32_t, 33u);
+  CURRENT_FIELD(field_34, uint32_t, 34u);
+  CURRENT_FIELD(field_35, uint32_t, 35u);
+  CURRENT_FIELD(field_36, uint32_t, 36u);
+  CURRENT_FIELD(field_37, uint32_t, 37u);
+  CURRENT_FIELD(field_38, uint32_t, 38u);
+  CURRENT_FIELD(field_39, uint32_t, 39u);
+};
+
+CURRENT_STRUCT(ShadowingField, Serializable) { CURRENT_FIELD(s, std::string); };
+
+}  // namespace serialization_test
+
+TEST(JSONSerialization, LongStrings) {
+  // The characters to escape, and the ones not to, at every offset within and around the vectorized blocks.
+  const std::vector<std::pair<std::string, std::string>> cases = {{"\"", "\\\""},
+                                                                   {"\\", "\\\\"},
+                                                                   {"\n", "\\n"},
+                                                                   {"\t", "\\t"},
+                                                                   {"\x01", "\\u0001"},
+                                                                   {"\x1f", "\\u001F"},
+                                                                   {std::string(1u, '\0'), "\\u0000"},
+                                                                   {"\xd0\x9f", "\xd0\x9f"},
+                                                                   {"\x7f", "\x7f"}};
+  for (const auto& c : cases) {
+    for (size_t offset = 0u; offset < 80u; ++offset) {
+      const std::string prefix(offset, 'a');
+      const std::string suffix(70u, 'b');
+      const std::string value = prefix + c.first + suffix + c.first;
+      const std::string json = '"' + prefix + c.second + suffix + c.second + '"';
+      ASSERT_EQ(json, JSON(value)) << offset;
+      ASSERT_EQ(value, ParseJSON<std::string>(json)) << offset;
+    }
+  }
+  const std::string long_text(100000u, 'x');
+  EXPECT_EQ(long_text, ParseJSON<std::string>(JSON(long_text)));
+}
+
+TEST(JSONSerialization, ReaderMatchesFieldsInAnyOrder) {
+  using namespace serialization_test;
+
+  ManyFields many_fields;
+  ExpectJSONReaderMatchesDOM(many_fields);
+
+  std::vector<std::string> keys;
+  for (uint32_t i = 0u; i < 40u; ++i) {
+    keys.push_back(current::strings::Printf("\"field_%02d\":%u", i, 100u + i));
+  }
+  const auto object = [](const std::vector<std::string>& keys) {
+    return '{' + current::strings::Join(keys, ',') + '}';
+  };
+  ExpectJSONReaderMatchesDOM<JSONFormat::Current, ManyFields>(object(keys));
+  EXPECT_EQ(139u, ParseJSON<ManyFields>(object(keys)).field_39);
+
+  std::reverse(keys.begin(), keys.end());
+  ExpectJSONReaderMatchesDOM<JSONFormat::Current, ManyFields>(object(keys));
+
+  std::vector<std::string> shuffled;
+  for (size_t i = 0u; i < keys.size(); ++i) {
+    shuffled.push_back(keys[(i * 7u) % keys.size()]);
+    if (i % 5u == 0u) {
+      shuffled.push_back("\"field_\":0,\"field_4\":0,\"FIELD_01\":0,\"field_000\":0");
+      shuffled.push_back(keys[i]);
+    }
+  }
+  ExpectJSONReaderMatchesDOM<JSONFormat::Current, ManyFields>(object(shuffled));
+
+  keys.resize(39u);
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, ManyFields>(object(keys))));
+
+  // The names of the fields are not unique when a derived struct shadows the field of its base one. The value of
+  // such a key goes into both fields, which is left to `JSONParser`.
+  const std::string shadowing_json = "{\"b\":true,\"i\":1,\"e\":0,\"s\":\"shadowed\"}";
+  EXPECT_FALSE((ParsedViaReader<JSONFormat::Current, ShadowingField>(shadowing_json)));
+  const auto shadowing = ParseJSON<ShadowingField>(shadowing_json);
+  EXPECT_EQ("shadowed", shadowing.s);
+  EXPECT_EQ("shadowed", static_cast<const Serializable&>(shadowing).s);
+}
+
 TEST(JSONSerialization, JSONCrashTests) {
   EXPECT_EQ("{\"i\":0,\"o\":null,\"e\":0}", JSON(serialization_test::CrashingStruct()));
 
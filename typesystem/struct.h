@@ -40,6 +40,8 @@ SOFTWARE.
 #include "helpers.h"
 #include "variant.h"
 
+#include "../bricks/util/comparators.h"
+
 namespace crnt {
 namespace r {
 
@@ -447,4 +449,40 @@ using ::crnt::r::FieldTypeWrapper;
 }  // namespace reflection
 }  // namespace current
 
+namespace current {
+namespace custom_comparator_and_hash_function {
+
+// The `CURRENT_STRUCT`-s without the `Hash()` method, and with no `std::hash` specialized for them, are hashed
+// field by field, the fields of the base structs first, so that they can be used as the keys of the hash maps.
+template <typename T>
+struct HashFunctionWithoutHashMethod<
+    T,
+    std::enable_if_t<IS_CURRENT_STRUCT(T) && !std::is_default_constructible_v<std::hash<T>>>> {
+  std::size_t operator()(const T& object) const {
+    std::size_t seed = 0u;
+    CombineFields<T>(seed, object);
+    return seed;
+  }
+
+ private:
+  struct FieldsHasher final {
+    std::size_t& seed;
+    template <typename U>
+    void operator()(const char*, const U& value) const {
+      HashCombine<U, GenericHashFunction<U>>(seed, value);
+    }
+  };
+
+  template <typename S>
+  static void CombineFields(std::size_t& seed, const S& object) {
+    if constexpr (!std::is_same_v<S, ::crnt::CurrentStruct>) {
+      CombineFields<reflection::SuperType<S>>(seed, object);
+      reflection::VisitAllFields<S, reflection::FieldNameAndImmutableValue>::WithObject(object, FieldsHasher{seed});
+    }
+  }
+};
+
+}  // namespace custom_comparator_and_hash_function
+}  // namespace current
+
 #endif  // CURRENT_TYPE_SYSTEM_STRUCT_H
@@ -41,6 +41,7 @@ SOFTWARE.
 #include "serialization/test.cc"
 #include "schema/test.cc"
 #include "evolution/test.cc"
+#include "columnar/test.cc"
 
 namespace struct_definition_test {
 
@@ -341,6 +342,46 @@ TEST(TypeSystemTest, CopyDoesItsJob) {
   EXPECT_EQ(3u, c.i);
 }
 
+namespace struct_definition_test {
+
+CURRENT_STRUCT(CompositeKey) {
+  CURRENT_FIELD(name, std::string);
+  CURRENT_FIELD(id, uint32_t, 0u);
+  CURRENT_CONSTRUCTOR(CompositeKey)(std::string name = "", uint32_t id = 0u) : name(std::move(name)), id(id) {}
+  bool operator==(const CompositeKey& rhs) const { return name == rhs.name && id == rhs.id; }
+};
+
+CURRENT_STRUCT(DerivedCompositeKey, CompositeKey) {
+  CURRENT_FIELD(inner, CompositeKey);
+  CURRENT_CONSTRUCTOR(DerivedCompositeKey)(std::string name = "", uint32_t id = 0u)
+      : SUPER(name, id), inner(name, id) {}
+};
+
+}  // namespace struct_definition_test
+
+TEST(TypeSystemTest, StructsAreHashedFieldByField) {
+  using namespace struct_definition_test;
+
+  const auto hasher = current::GenericHashFunction<CompositeKey>();
+  EXPECT_EQ(hasher(CompositeKey("foo", 1u)), hasher(CompositeKey("foo", 1u)));
+  EXPECT_NE(hasher(CompositeKey("foo", 1u)), hasher(CompositeKey("foo", 2u)));
+  EXPECT_NE(hasher(CompositeKey("foo", 1u)), hasher(CompositeKey("bar", 1u)));
+
+  // The fields of the base struct are hashed too, as are the nested structs.
+  const auto derived_hasher = current::GenericHashFunction<DerivedCompositeKey>();
+  EXPECT_NE(derived_hasher(DerivedCompositeKey("foo", 1u)), derived_hasher(DerivedCompositeKey("foo", 2u)));
+  DerivedCompositeKey derived("foo", 1u);
+  const size_t derived_hash = derived_hasher(derived);
+  derived.inner.id = 2u;
+  EXPECT_NE(derived_hash, derived_hasher(derived));
+
+  std::unordered_map<CompositeKey, int, current::GenericHashFunction<CompositeKey>> map;
+  map[CompositeKey("foo", 1u)] = 1;
+  map[CompositeKey("foo", 2u)] = 2;
+  EXPECT_EQ(2u, map.size());
+  EXPECT_EQ(2, map[CompositeKey("foo", 2u)]);
+}
+
 TEST(TypeSystemTest, ConstructingViaInitializerListIncludingSuper) {
   using namespace struct_definition_test;
 
@@ -910,6 +951,75 @@ void TestComparisonOperatorsForNonPOD() {
 
 }  // namespace optionals_test
 
+TEST(TypeSystemTest, OptionalInlineStorage) {
+  using namespace struct_definition_test;
+
+  const auto IsInline = [](const auto& optional, const auto& value) {
+    const char* const begin = reinterpret_cast<const char*>(&optional);
+    const char* const p = reinterpret_cast<const char*>(&value);
+    return p >= begin && p < begin + sizeof(optional);
+  };
+
+  static_assert(std::is_nothrow_move_constructible_v<Optional<std::string>>, "");
+  static_assert(std::is_nothrow_move_constructible_v<Optional<Baz>>, "");
+
+  {
+    Optional<std::string> a(std::string("inline"));
+    EXPECT_TRUE(IsInline(a, Value(a)));
+    Optional<std::string> b(a);
+    EXPECT_TRUE(IsInline(b, Value(b)));
+    EXPECT_EQ("inline", Value(b));
+    Optional<std::string> c(std::move(b));
+    EXPECT_FALSE(Exists(b));
+    EXPECT_TRUE(IsInline(c, Value(c)));
+    EXPECT_EQ("inline", Value(c));
+    c = std::make_unique<std::string>("adopted");
+    EXPECT_TRUE(IsInline(c, Value(c)));
+    EXPECT_EQ("adopted", Value(c));
+    const auto& self = c;
+    c = self;
+    EXPECT_EQ("adopted", Value(c));
+    c = Value(c) + '!';
+    EXPECT_EQ("adopted!", Value(c));
+    c = nullptr;
+    EXPECT_FALSE(Exists(c));
+
+    // The bare pointers are still not owned.
+    std::string bare("bare");
+    c = &bare;
+    EXPECT_EQ(&bare, &Value(c));
+  }
+
+  {
+    // The objects too large to be inline are on the heap, and are moved as they are.
+    Baz baz;
+    baz.v1.push_back(42u);
+    Optional<Baz> a(baz);
+    EXPECT_FALSE(IsInline(a, Value(a)));
+    const Baz* const heap_object = &Value(a);
+    Optional<Baz> b(std::move(a));
+    EXPECT_FALSE(Exists(a));
+    EXPECT_EQ(heap_object, &Value(b));
+    EXPECT_EQ(42u, Value(b).v1[0]);
+  }
+
+  {
+    ImmutableOptional<std::string> a(std::string("inline"));
+    EXPECT_TRUE(IsInline(a, Value(a)));
+    ImmutableOptional<std::string> b(std::move(a));
+    EXPECT_FALSE(Exists(a));
+    EXPECT_TRUE(IsInline(b, Value(b)));
+    EXPECT_EQ("inline", Value(b));
+
+    const std::string bare("bare");
+    ImmutableOptional<std::string> c(FromBarePointer(), &bare);
+    b = std::move(c);
+    EXPECT_EQ(&bare, &Value(b));
+    const Optional<std::string> copied(b);
+    EXPECT_EQ("bare", Value(copied));
+  }
+}
+
 TEST(TypeSystemTest, OptionalComparisonOperators) {
   using namespace optionals_test;
 
@@ -1254,6 +1364,123 @@ TEST(TypeSystemTest, VariantSmokeTestOneType) {
   }
 }
 
+TEST(TypeSystemTest, VariantInlineStorage) {
+  using namespace struct_definition_test;
+  using current::variant::ObjectStorage;
+
+  static_assert(ObjectStorage::kInline<Foo>, "");
+  static_assert(ObjectStorage::kInline<Bar>, "");
+  static_assert(!ObjectStorage::kInline<Baz>, "");
+  static_assert(std::is_nothrow_move_constructible_v<Optional<std::string>>, "");
+  static_assert(std::is_nothrow_move_constructible_v<Variant<Foo, Baz>>, "");
+
+  const auto IsInline = [](const auto& variant, const auto& value) {
+    const char* const begin = reinterpret_cast<const char*>(&variant);
+    const char* const p = reinterpret_cast<const char*>(&value);
+    return p >= begin && p < begin + sizeof(variant);
+  };
+
+  Variant<Foo, Baz> a(Foo(1u));
+  EXPECT_TRUE(IsInline(a, Value<Foo>(a)));
+
+  // Copied and moved inline, into the `Variant` of the very type, or into another one that contains the type.
+  Variant<Foo, Baz> b(a);
+  EXPECT_TRUE(IsInline(b, Value<Foo>(b)));
+  EXPECT_EQ(1u, Value<Foo>(b).i);
+  Variant<Foo, Bar> c(std::move(b));
+  EXPECT_FALSE(Exists(b));
+  EXPECT_TRUE(IsInline(c, Value<Foo>(c)));
+  EXPECT_EQ(1u, Value<Foo>(c).i);
+  Variant<Foo, Baz> d;
+  d = std::move(c);
+  EXPECT_FALSE(Exists(c));
+  EXPECT_EQ(1u, Value<Foo>(d).i);
+
+  // The objects too large to be inline are on the heap, and are moved from one `Variant` into another as they are.
+  Baz baz;
+  baz.v1.push_back(42u);
+  a = baz;
+  EXPECT_FALSE(IsInline(a, Value<Baz>(a)));
+  const Baz* const heap_object = &Value<Baz>(a);
+  Variant<Foo, Baz> e(std::move(a));
+  EXPECT_FALSE(Exists(a));
+  EXPECT_EQ(heap_object, &Value<Baz>(e));
+  e = Foo(2u);
+  EXPECT_TRUE(IsInline(e, Value<Foo>(e)));
+  EXPECT_EQ(2u, Value<Foo>(e).i);
+
+  // Assigning the `Variant`, or its value, to itself works whether the object is inline or not.
+  e = Value<Foo>(e);
+  EXPECT_EQ(2u, Value<Foo>(e).i);
+  const auto& self = e;
+  e = self;
+  EXPECT_EQ(2u, Value<Foo>(e).i);
+  e = baz;
+  e = Value<Baz>(e);
+  ASSERT_EQ(1u, Value<Baz>(e).v1.size());
+  EXPECT_EQ(42u, Value<Baz>(e).v1[0]);
+
+  Foo& foo = e.Construct<Foo>(3u);
+  EXPECT_EQ(&foo, &Value<Foo>(e));
+  EXPECT_EQ(3u, Value<Foo>(e).i);
+  e = nullptr;
+  EXPECT_FALSE(Exists(e));
+
+  // And so do the nested `Variant`-s.
+  Variant<Variant<Foo, Bar>, Baz> nested(Variant<Foo, Bar>(Bar(4u)));
+  EXPECT_EQ(4u, Value<Bar>(Value<Variant<Foo, Bar>>(nested)).j);
+  Variant<Variant<Foo, Bar>, Baz> nested_moved(std::move(nested));
+  EXPECT_FALSE(Exists(nested));
+  EXPECT_EQ(4u, Value<Bar>(Value<Variant<Foo, Bar>>(nested_moved)).j);
+}
+
+TEST(TypeSystemTest, VariantDispatchesOnTheTypeOfTheObject) {
+  using namespace struct_definition_test;
+  using current::BypassVariantTypeCheck;
+  using variant_t = Variant<Bar, Foo, DerivedFromFoo>;
+
+  struct Visitor {
+    std::string s;
+    void operator()(Bar&) { s = "Bar"; }
+    void operator()(Foo& foo) { s = "Foo " + current::ToString(foo.i); }
+    void operator()(DerivedFromFoo& object) { s = "DerivedFromFoo " + current::ToString(object.i); }
+  };
+  Visitor v;
+
+  // The exact type of the object is dispatched on, however the object got into the `Variant`.
+  variant_t p(DerivedFromFoo(1u));
+  p.Call(v);
+  EXPECT_EQ("DerivedFromFoo 1001", v.s);
+  p.UncheckedMoveFromUniquePtr(std::make_unique<Foo>(2u));
+  p.Call(v);
+  EXPECT_EQ("Foo 2", v.s);
+  p.UncheckedMoveFromUniquePtr(std::make_unique<DerivedFromFoo>(3u));
+  p.Call(v);
+  EXPECT_EQ("DerivedFromFoo 3003", v.s);
+  variant_t q(BypassVariantTypeCheck(), std::make_unique<Bar>());
+  q.Call(v);
+  EXPECT_EQ("Bar", v.s);
+  q = std::move(p);
+  q.Call(v);
+  EXPECT_EQ("DerivedFromFoo 3003", v.s);
+  Variant<Foo, DerivedFromFoo> r(q);
+  r.Call(v);
+  EXPECT_EQ("DerivedFromFoo 3003", v.s);
+  q.Construct<Foo>(4u);
+  static_cast<const variant_t&>(q).Call(v);
+  EXPECT_EQ("Foo 4", v.s);
+
+  // A derived type is still retrieved as its base one.
+  EXPECT_TRUE(Exists<Foo>(r));
+  EXPECT_EQ(3003u, Value<Foo>(r).i);
+  EXPECT_FALSE(Exists<Bar>(r));
+
+  // An object of the type not in the `Variant` can only get there unchecked, and can not be dispatched on.
+  Variant<Bar, Foo> s(BypassVariantTypeCheck(), std::make_unique<DerivedFromFoo>());
+  EXPECT_TRUE(Exists<Foo>(s));
+  EXPECT_THROW(s.Call(v), current::metaprogramming::UnlistedTypeException);
+}
+
 TEST(TypeSystemTest, VariantSmokeTestMultipleTypes) {
   using namespace struct_definition_test;
 
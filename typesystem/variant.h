@@ -34,8 +34,11 @@ SOFTWARE.
 
 #include "../port.h"  // `make_unique`.
 
+#include <cstddef>
 #include <memory>
+#include <new>
 #include <type_traits>
+#include <typeinfo>
 
 #ifdef VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
 // For runtime, not compile-time, extra checks.
@@ -67,6 +70,111 @@ using object_base_t = CurrentSuper;
 
 struct BypassVariantTypeCheck {};
 
+// The objects of at most this many bytes, which can be moved without throwing, are kept within the `Variant` itself,
+// and the other ones are allocated on the heap. Zero keeps them all on the heap.
+#ifndef CURRENT_VARIANT_INLINE_STORAGE_SIZE
+#define CURRENT_VARIANT_INLINE_STORAGE_SIZE 64
+#endif  // CURRENT_VARIANT_INLINE_STORAGE_SIZE
+
+namespace variant {
+
+// Owns the object of a `Variant`, either inline or on the heap. Type-unaware, as the object is only ever
+// created via `Emplace<T>()` with its exact type, and, if on the heap, may also be adopted as a `std::unique_ptr`.
+// The size of the inline storage is the same for all the `Variant`-s, so that an object can be moved inline
+// from one `Variant` into another, of a different type, that contains it as well.
+class ObjectStorage final {
+ public:
+  template <typename T>
+  static constexpr bool kInline = sizeof(T) <= CURRENT_VARIANT_INLINE_STORAGE_SIZE &&
+                                  alignof(T) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<T>;
+
+  ObjectStorage() = default;
+  explicit ObjectStorage(std::unique_ptr<object_base_t>&& object) : object_(object.release()) {}
+  ObjectStorage(ObjectStorage&& rhs) noexcept { MoveFrom(rhs); }
+  ObjectStorage& operator=(ObjectStorage&& rhs) noexcept {
+    if (&rhs != this) {
+      Reset();
+      MoveFrom(rhs);
+    }
+    return *this;
+  }
+  ~ObjectStorage() { Reset(); }
+
+  object_base_t* Get() const { return object_; }
+
+  // Replaces the object with the newly constructed one. Should the constructor throw, the object is left as is.
+  // The arguments may refer to the very object being replaced, which is thus destroyed last.
+  template <typename T, typename... ARGS>
+  T& Emplace(ARGS&&... args) {
+    if constexpr (kInline<T>) {
+      if (move_inline_) {
+        T replacement(std::forward<ARGS>(args)...);
+        Reset();
+        return EmplaceInline<T>(std::move(replacement));
+      } else {
+        object_base_t* previous = object_;
+        T& result = EmplaceInline<T>(std::forward<ARGS>(args)...);
+        delete previous;
+        return result;
+      }
+    } else {
+      auto object = std::make_unique<T>(std::forward<ARGS>(args)...);
+      T& result = *object;
+      Reset();
+      object_ = object.release();
+      return result;
+    }
+  }
+
+  void Reset() {
+    if (move_inline_) {
+      object_->~object_base_t();
+      move_inline_ = nullptr;
+    } else {
+      delete object_;
+    }
+    object_ = nullptr;
+  }
+
+ private:
+  ObjectStorage(const ObjectStorage&) = delete;
+  ObjectStorage& operator=(const ObjectStorage&) = delete;
+
+  // Requires the inline storage to be vacant, as it is when the object is on the heap, or there is none.
+  template <typename T, typename... ARGS>
+  T& EmplaceInline(ARGS&&... args) {
+    T* result = ::new (static_cast<void*>(buffer_)) T(std::forward<ARGS>(args)...);
+    object_ = result;
+    move_inline_ = &MoveInline<T>;
+    return *result;
+  }
+
+  template <typename T>
+  static object_base_t* MoveInline(object_base_t* from, void* into) noexcept {
+    return ::new (into) T(std::move(*static_cast<T*>(from)));
+  }
+
+  void MoveFrom(ObjectStorage& rhs) noexcept {
+    if (rhs.move_inline_) {
+      object_ = rhs.move_inline_(rhs.object_, buffer_);
+      move_inline_ = rhs.move_inline_;
+      rhs.Reset();
+    } else {
+      object_ = rhs.object_;
+      rhs.object_ = nullptr;
+    }
+  }
+
+  object_base_t* object_ = nullptr;
+  // Set if and only if the object is inline, to move it into another `ObjectStorage`.
+  object_base_t* (*move_inline_)(object_base_t*, void*) noexcept = nullptr;
+  alignas(std::max_align_t) unsigned char buffer_[CURRENT_VARIANT_INLINE_STORAGE_SIZE > 0u
+                                                       ? CURRENT_VARIANT_INLINE_STORAGE_SIZE
+                                                       : 1u];
+};
+
+}  // namespace variant
+
 namespace variant {
 
 #ifdef VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
@@ -144,7 +252,9 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
   VariantImpl() {}
 
   VariantImpl(BypassVariantTypeCheck, std::unique_ptr<current::variant::object_base_t>&& rhs)
-      : object_(std::move(rhs)) {}
+      : object_(std::move(rhs)) {
+    case_ = object_.Get() ? DynamicCaseOf(*object_.Get()) : kNoCase;
+  }
 
   // Use deep copy helper for all Variant types, including our own.
   VariantImpl(const VariantImpl& rhs) { CopyFrom(rhs); }
@@ -173,17 +283,19 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
   VariantImpl(X&& input) {
     using decayed_t = current::decay_t<X>;
     variant::RuntimeTypeListHelpers<typelist_t>::template AssertContains<decayed_t>();
-    object_ = std::make_unique<decayed_t>(std::forward<X>(input));
+    object_.template Emplace<decayed_t>(std::forward<X>(input));
+    case_ = CaseOf<decayed_t>();
   }
 #else
   template <typename X, class ENABLE = std::enable_if_t<TypeListContains<typelist_t, current::decay_t<X>>::value>>
   VariantImpl(X&& input) {
     using decayed_t = current::decay_t<X>;
-    object_ = std::make_unique<decayed_t>(std::forward<X>(input));
+    object_.template Emplace<decayed_t>(std::forward<X>(input));
+    case_ = CaseOf<decayed_t>();
   }
 #endif  // VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
 
-  void operator=(std::nullptr_t) { object_ = nullptr; }
+  void operator=(std::nullptr_t) { object_.Reset(); }
 
   VariantImpl& operator=(const VariantImpl& rhs) {
     CopyFrom(rhs);
@@ -192,6 +304,7 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
 
   VariantImpl& operator=(VariantImpl&& rhs) {
     object_ = std::move(rhs.object_);
+    case_ = rhs.case_;
     return *this;
   }
 
@@ -205,12 +318,15 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
 #ifdef VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
     variant::RuntimeTypeListHelpers<typelist_t>::template AssertContains<decayed_t>();
 #endif  // VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
-    object_ = std::make_unique<decayed_t>(std::forward<X>(input));
+    object_.template Emplace<decayed_t>(std::forward<X>(input));
+    case_ = CaseOf<decayed_t>();
     return *this;
   }
 
   void UncheckedMoveFromUniquePtr(std::unique_ptr<current::variant::object_base_t> input) override {
-    object_ = std::move(input);
+    const size_t input_case = input ? DynamicCaseOf(*input) : kNoCase;
+    object_ = current::variant::ObjectStorage(std::move(input));
+    case_ = input_case;
   }
 
 #ifdef VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
@@ -219,27 +335,20 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
   template <typename T, typename... ARGS, class ENABLE = std::enable_if_t<TypeListContains<typelist_t, T>::value>>
 #endif  // VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
   T& Construct(ARGS&&... args) {
-    object_ = std::make_unique<T>(std::forward<ARGS>(args)...);
-    return *dynamic_cast<T*>(object_.get());
+    T& result = object_.template Emplace<T>(std::forward<ARGS>(args)...);
+    case_ = CaseOf<T>();
+    return result;
   }
-  operator bool() const { return object_ ? true : false; }
+  operator bool() const { return object_.Get() ? true : false; }
 
   template <typename F>
   void Call(F&& f) {
-    if (object_) {
-      current::metaprogramming::RTTIDynamicCall<typelist_t>(*object_, std::forward<F>(f));
-    } else {
-      CURRENT_THROW(UninitializedVariantOfTypeException<TYPES...>());
-    }
+    DispatchCall(std::forward<F>(f));
   }
 
   template <typename F>
   void Call(F&& f) const {
-    if (object_) {
-      current::metaprogramming::RTTIDynamicCall<typelist_t>(*object_, std::forward<F>(f));
-    } else {
-      CURRENT_THROW(UninitializedVariantOfTypeException<TYPES...>());
-    }
+    DispatchCall(std::forward<F>(f));
   }
 
   // By design, `VariantExistsImpl<T>()` and `VariantValueImpl<T>()` do not check
@@ -248,16 +357,16 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
   // regardless of whether the base one is present in `typelist_t`.
   // Use `Call()` to run a strict check.
 
-  bool ExistsImpl() const { return (object_.get() != nullptr); }
+  bool ExistsImpl() const { return (object_.Get() != nullptr); }
 
   template <typename X>
   std::enable_if_t<!std::is_same_v<X, current::variant::object_base_t>, bool> VariantExistsImpl() const {
-    return dynamic_cast<const X*>(object_.get()) != nullptr;
+    return PointerTo<X>() != nullptr;
   }
 
   template <typename X>
   std::enable_if_t<!std::is_same_v<X, current::variant::object_base_t>, X&> VariantValueImpl() {
-    X* ptr = dynamic_cast<X*>(object_.get());
+    X* ptr = PointerTo<X>();
     if (ptr) {
       return *ptr;
     } else {
@@ -267,7 +376,7 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
 
   template <typename X>
   const X& VariantValueImpl() const {
-    const X* ptr = dynamic_cast<const X*>(object_.get());
+    const X* ptr = PointerTo<X>();
     if (ptr) {
       return *ptr;
     } else {
@@ -285,21 +394,88 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
   }
 
  private:
+  // The index of the type of the object in `TYPES...`, for `Call()` to dispatch on without RTTI.
+  // Is `kNoCase` if the object is of a type not in `TYPES...`, which only a `BypassVariantTypeCheck`-ed or an unchecked
+  // move can result in, and then `Call()` resorts to `RTTIDynamicCall`, to throw exactly as it would.
+  static constexpr size_t kNoCase = static_cast<size_t>(-1);
+
+  template <typename T>
+  static constexpr size_t CaseOf() {
+    constexpr bool matches[] = {false, std::is_same_v<T, TYPES>...};
+    for (size_t i = 1u; i <= typelist_size; ++i) {
+      if (matches[i]) {
+        return i - 1u;
+      }
+    }
+    return kNoCase;
+  }
+
+  static size_t DynamicCaseOf(const current::variant::object_base_t& object) {
+    static const std::type_info* const types[] = {&typeid(TYPES)...};
+    const std::type_info& type = typeid(object);
+    for (size_t i = 0u; i < typelist_size; ++i) {
+      if (*types[i] == type) {
+        return i;
+      }
+    }
+    return kNoCase;
+  }
+
+  template <typename T, typename F>
+  static void CallCase(current::variant::object_base_t& object, F&& f) {
+    f(static_cast<T&>(object));
+  }
+
+  template <typename F>
+  void DispatchCall(F&& f) const {
+    current::variant::object_base_t* object = object_.Get();
+    if (object) {
+      if (case_ != kNoCase) {
+        static constexpr void (*const dispatch[])(current::variant::object_base_t&, F&&) = {&CallCase<TYPES, F>...};
+        dispatch[case_](*object, std::forward<F>(f));
+      } else {
+        current::metaprogramming::RTTIDynamicCall<typelist_t>(*object, std::forward<F>(f));
+      }
+    } else {
+      CURRENT_THROW(UninitializedVariantOfTypeException<TYPES...>());
+    }
+  }
+
+  // The exact type is checked first, as it is what the object usually is retrieved as. Unless some other type
+  // in `TYPES...` derives from `X`, the object of any other known type is then not an `X` either.
+  template <typename X>
+  X* PointerTo() const {
+    using decayed_t = current::decay_t<X>;
+    if constexpr (CaseOf<decayed_t>() != kNoCase) {
+      if (case_ == CaseOf<decayed_t>()) {
+        return static_cast<X*>(object_.Get());
+      }
+      if constexpr ((static_cast<size_t>(std::is_base_of_v<decayed_t, TYPES>) + ...) == 1u) {
+        if (case_ != kNoCase) {
+          return nullptr;
+        }
+      }
+    }
+    return dynamic_cast<X*>(object_.Get());
+  }
+
   struct TypeAwareClone {
-    std::unique_ptr<current::variant::object_base_t>& into;
-    TypeAwareClone(std::unique_ptr<current::variant::object_base_t>& into) : into(into) {}
+    VariantImpl& into;
+    TypeAwareClone(VariantImpl& into) : into(into) {}
 
 #ifdef VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
     template <typename U>
     void operator()(const U& instance) {
       using decayed_u = current::decay_t<U>;
       variant::RuntimeTypeListHelpers<typelist_t>::template AssertContains<decayed_u>();
-      into = std::make_unique<decayed_u>(instance);
+      into.object_.template Emplace<decayed_u>(instance);
+      into.case_ = CaseOf<decayed_u>();
     }
 #else
     template <typename U>
     std::enable_if_t<TypeListContains<typelist_t, current::decay_t<U>>::value> operator()(const U& instance) {
-      into = std::make_unique<current::decay_t<U>>(instance);
+      into.object_.template Emplace<current::decay_t<U>>(instance);
+      into.case_ = CaseOf<current::decay_t<U>>();
     }
 
     template <typename U>
@@ -311,23 +487,23 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
 
   struct TypeAwareMove {
     // `from` should not be an rvalue reference, as the move operation in `operator()` may still throw.
-    std::unique_ptr<current::variant::object_base_t>& from;
-    std::unique_ptr<current::variant::object_base_t>& into;
-    TypeAwareMove(std::unique_ptr<current::variant::object_base_t>& from,
-                  std::unique_ptr<current::variant::object_base_t>& into)
-        : from(from), into(into) {}
+    current::variant::ObjectStorage& from;
+    VariantImpl& into;
+    TypeAwareMove(current::variant::ObjectStorage& from, VariantImpl& into) : from(from), into(into) {}
 
 #ifdef VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
     template <typename U>
     void operator()(U&&) {
       using decayed_u = current::decay_t<U>;
       variant::RuntimeTypeListHelpers<typelist_t>::template AssertContains<decayed_u>();
-      into = std::move(from);
+      into.object_ = std::move(from);
+      into.case_ = CaseOf<decayed_u>();
     }
 #else
     template <typename U>
     std::enable_if_t<TypeListContains<typelist_t, current::decay_t<U>>::value> operator()(U&&) {
-      into = std::move(from);
+      into.object_ = std::move(from);
+      into.case_ = CaseOf<current::decay_t<U>>();
     }
 
     template <typename U>
@@ -339,26 +515,28 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
 
   template <typename... RHS>
   void CopyFrom(const VariantImpl<RHS...>& rhs) {
-    if (rhs.object_) {
-      TypeAwareClone cloner(object_);
+    if (rhs.object_.Get()) {
+      TypeAwareClone cloner(*this);
       rhs.Call(cloner);
     } else {
-      object_ = nullptr;
+      object_.Reset();
     }
   }
 
   template <typename... RHS>
   void MoveFrom(VariantImpl<RHS...>&& rhs) {
-    if (rhs.object_) {
-      TypeAwareMove mover(rhs.object_, object_);
+    if (rhs.object_.Get()) {
+      TypeAwareMove mover(rhs.object_, *this);
       rhs.Call(mover);
     } else {
-      object_ = nullptr;
+      object_.Reset();
     }
   }
 
  private:
-  std::unique_ptr<current::variant::object_base_t> object_;
+  // Goes first, to fill the padding before the aligned `object_`.
+  size_t case_ = kNoCase;
+  current::variant::ObjectStorage object_;
 };
 
 // `Variant<...>` can accept either a list of types, or a `TypeList<...>`.